@@ -12,6 +12,8 @@
 #include <fizz/client/PskCache.h>
 #include <fizz/protocol/Actions.h>
 #include <fizz/protocol/Params.h>
+#include <folly/futures/Future.h>
+#include <folly/small_vector.h>
 
 namespace fizz {
 namespace client {
@@ -77,8 +79,8 @@ using Action = boost::variant<
     MutateState,
     WaitForData,
     NewCachedPsk>;
-// TODO use small_vector once we are sure it is portable.
-using Actions = std::vector<Action>;
+using Actions = folly::small_vector<Action, 4>;
+using AsyncActions = boost::variant<Actions, folly::Future<Actions>>;
 
 namespace detail {
 
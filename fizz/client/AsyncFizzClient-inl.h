@@ -18,7 +18,9 @@ AsyncFizzClientT<SM>::AsyncFizzClientT(
       fizzContext_(std::move(fizzContext)),
       extensions_(extensions),
       visitor_(*this),
-      fizzClient_(state_, transportReadBuf_, visitor_, this) {}
+      fizzClient_(state_, transportReadBuf_, visitor_, this) {
+  state_.executor() = getEventBase();
+}
 
 template <typename SM>
 AsyncFizzClientT<SM>::AsyncFizzClientT(
@@ -30,7 +32,9 @@ AsyncFizzClientT<SM>::AsyncFizzClientT(
       fizzContext_(std::move(fizzContext)),
       extensions_(extensions),
       visitor_(*this),
-      fizzClient_(state_, transportReadBuf_, visitor_, this) {}
+      fizzClient_(state_, transportReadBuf_, visitor_, this) {
+  state_.executor() = getEventBase();
+}
 
 template <typename SM>
 void AsyncFizzClientT<SM>::connect(
@@ -76,16 +80,57 @@ void AsyncFizzClientT<SM>::connect(
 
   startTransportReads();
 
-  folly::Optional<CachedPsk> cachedPsk = folly::none;
-  if (pskIdentity) {
-    cachedPsk = fizzContext_->getPsk(*pskIdentity);
+  connectWithPsk(lookupPsk(), std::move(verifier));
+}
+
+/**
+ * Completes a promise with the outcome of the handshake, deleting itself once
+ * done.
+ */
+template <typename SM>
+class AsyncFizzClientT<SM>::FutureHandshakeCallback
+    : public AsyncFizzClientT<SM>::HandshakeCallback {
+ public:
+  folly::Future<folly::Unit> getFuture() {
+    return promise_.getFuture();
+  }
+
+  void fizzHandshakeSuccess(AsyncFizzClientT* /* transport */) noexcept
+      override {
+    complete(folly::Try<folly::Unit>(folly::unit));
+  }
+
+  void fizzHandshakeError(
+      AsyncFizzClientT* /* transport */,
+      folly::exception_wrapper ex) noexcept override {
+    complete(folly::Try<folly::Unit>(std::move(ex)));
   }
-  fizzClient_.connect(
-      fizzContext_,
+
+ private:
+  void complete(folly::Try<folly::Unit> result) {
+    auto promise = std::move(promise_);
+    delete this;
+    promise.setTry(std::move(result));
+  }
+
+  folly::Promise<folly::Unit> promise_;
+};
+
+template <typename SM>
+folly::Future<folly::Unit> AsyncFizzClientT<SM>::connect(
+    std::shared_ptr<const CertificateVerifier> verifier,
+    folly::Optional<std::string> sni,
+    folly::Optional<std::string> pskIdentity,
+    std::chrono::milliseconds timeout) {
+  auto callback = new FutureHandshakeCallback();
+  auto future = callback->getFuture();
+  connect(
+      callback,
       std::move(verifier),
       std::move(sni),
-      std::move(cachedPsk),
-      extensions_);
+      std::move(pskIdentity),
+      timeout);
+  return future;
 }
 
 template <typename SM>
@@ -116,7 +161,25 @@ void AsyncFizzClientT<SM>::connect(
   auto underlyingSocket =
       transport_->getUnderlyingTransport<folly::AsyncSocket>();
   if (underlyingSocket) {
+    if (prepareClientHelloDuringConnect_) {
+      // A PSK lookup that has to wait runs alongside the TCP connect instead,
+      // and the ClientHello is built once both are done.
+      auto cachedPsk = lookupPsk();
+      if (cachedPsk.isReady()) {
+        fizzClient_.prepareConnect(
+            fizzContext_,
+            std::move(verifier_),
+            sni_,
+            std::move(cachedPsk.value()),
+            extensions_);
+      } else {
+        pendingPsk_ = std::move(cachedPsk);
+      }
+    }
     underlyingSocket->disableTransparentTls();
+    if (tfoEnabled_) {
+      underlyingSocket->enableTFO();
+    }
     underlyingSocket->connect(
         this,
         connectAddr,
@@ -151,6 +214,12 @@ bool AsyncFizzClientT<SM>::error() const {
   return transport_->error() || fizzClient_.inErrorState();
 }
 
+template <typename SM>
+void AsyncFizzClientT<SM>::attachEventBase(folly::EventBase* evb) {
+  state_.executor() = evb;
+  AsyncFizzBase::attachEventBase(evb);
+}
+
 template <typename SM>
 folly::ssl::X509UniquePtr AsyncFizzClientT<SM>::getPeerCert() const {
   auto serverCert = getPeerCertificate();
@@ -214,10 +283,11 @@ std::string AsyncFizzClientT<SM>::getApplicationProtocol() noexcept {
 
 template <typename SM>
 void AsyncFizzClientT<SM>::close() {
-  if (transport_->good()) {
+  DelayedDestruction::DestructorGuard dg(this);
+  flushCorkedWrites();
+  if (transport_->good() && !kTLSEnabled()) {
     fizzClient_.appClose();
   } else {
-    DelayedDestruction::DestructorGuard dg(this);
     folly::AsyncSocketException ase(
         folly::AsyncSocketException::END_OF_FILE, "socket closed locally");
     deliverAllErrors(ase, false);
@@ -228,7 +298,8 @@ void AsyncFizzClientT<SM>::close() {
 template <typename SM>
 void AsyncFizzClientT<SM>::closeWithReset() {
   DelayedDestruction::DestructorGuard dg(this);
-  if (transport_->good()) {
+  flushCorkedWrites();
+  if (transport_->good() && !kTLSEnabled()) {
     fizzClient_.appClose();
   }
   folly::AsyncSocketException ase(
@@ -240,7 +311,8 @@ void AsyncFizzClientT<SM>::closeWithReset() {
 template <typename SM>
 void AsyncFizzClientT<SM>::closeNow() {
   DelayedDestruction::DestructorGuard dg(this);
-  if (transport_->good()) {
+  flushCorkedWrites();
+  if (transport_->good() && !kTLSEnabled()) {
     fizzClient_.appClose();
   }
   folly::AsyncSocketException ase(
@@ -249,20 +321,153 @@ void AsyncFizzClientT<SM>::closeNow() {
   transport_->closeNow();
 }
 
+template <typename SM>
+void AsyncFizzClientT<SM>::releaseIdleResources() {
+  fizzClient_.releaseIdleResources();
+  AsyncFizzBase::releaseIdleResources();
+}
+
+template <typename SM>
+MemoryUsage AsyncFizzClientT<SM>::getMemoryUsage() const {
+  auto usage = AsyncFizzBase::getMemoryUsage();
+  usage.stateBytes += sizeof(*this);
+  fizzClient_.addMemoryUsage(usage);
+  if (state_.hasUnverifiedCertChain()) {
+    usage.peerCertBytes += getCertChainBytes(
+        state_.unverifiedCertChain(), getPeerCertificate());
+  }
+  return usage;
+}
+
+template <typename SM>
+bool AsyncFizzClientT<SM>::enableKTLS(const KTLSOptions& options) {
+  if (kTLSEnabled()) {
+    return true;
+  }
+  // Everything the record layers have processed so far must have been handed
+  // to the app or the socket, so that the exported sequence numbers line up
+  // with what the kernel will see next.
+  if (error() || state_.state() != StateEnum::Established ||
+      fizzClient_.actionProcessing() || !transportReadBuf_.empty() ||
+      !state_.cipher() || !state_.readRecordLayer() ||
+      state_.readRecordLayer()->hasUnparsedHandshakeData() ||
+      transport_->getRawBytesBuffered() != 0) {
+    return false;
+  }
+  auto socket = transport_->getUnderlyingTransport<folly::AsyncSocket>();
+  if (!socket) {
+    return false;
+  }
+  auto rx = KTLS::extractReadParams(state_.readRecordLayer(), *state_.cipher());
+  auto tx =
+      KTLS::extractWriteParams(state_.writeRecordLayer(), *state_.cipher());
+  if (!rx || !tx) {
+    return false;
+  }
+  if (!KTLS::setupSocket(socket->getFd(), *rx, *tx, options)) {
+    return false;
+  }
+  startKTLSPassthrough();
+  return true;
+}
+
 template <typename SM>
 void AsyncFizzClientT<SM>::connectSuccess() noexcept {
+  DelayedDestruction::DestructorGuard dg(this);
+
   startTransportReads();
 
-  folly::Optional<CachedPsk> cachedPsk = folly::none;
-  if (pskIdentity_) {
-    cachedPsk = fizzContext_->getPsk(*pskIdentity_);
+  // With TFO only the first write is sent with the SYN, so collect the
+  // ClientHello and any early data written from the connect callback (which
+  // is called synchronously from processing the connect) into one write.
+  if (tfoEnabled_) {
+    firstFlight_.emplace();
+  }
+
+  if (fizzClient_.hasPreparedConnect()) {
+    fizzClient_.connectPrepared();
+    writeFirstFlight();
+  } else {
+    auto cachedPsk = pendingPsk_ ? std::move(*pendingPsk_) : lookupPsk();
+    pendingPsk_.clear();
+    connectWithPsk(std::move(cachedPsk), std::move(verifier_));
+  }
+}
+
+template <typename SM>
+folly::Future<folly::Optional<CachedPsk>> AsyncFizzClientT<SM>::lookupPsk() {
+  if (!pskIdentity_ || !fizzContext_->getPskCache()) {
+    return folly::Optional<CachedPsk>();
+  }
+  auto cachedPsk = folly::makeFutureWith([this]() {
+    return fizzContext_->getPskCache()->getPskFuture(*pskIdentity_);
+  });
+  if (!cachedPsk.isReady()) {
+    cachedPsk = std::move(cachedPsk)
+                    .within(fizzContext_->getPskLookupTimeout())
+                    .via(transport_->getEventBase());
+  }
+  return std::move(cachedPsk).then(
+      [](folly::Try<folly::Optional<CachedPsk>>&& result) {
+        if (result.hasException()) {
+          VLOG(4) << "psk lookup failed: " << result.exception().what();
+          return folly::Optional<CachedPsk>();
+        }
+        return std::move(result.value());
+      });
+}
+
+template <typename SM>
+void AsyncFizzClientT<SM>::connectWithPsk(
+    folly::Future<folly::Optional<CachedPsk>> cachedPsk,
+    std::shared_ptr<const CertificateVerifier> verifier) {
+  if (cachedPsk.isReady()) {
+    fizzClient_.connect(
+        fizzContext_,
+        std::move(verifier),
+        sni_,
+        std::move(cachedPsk.value()),
+        extensions_);
+    writeFirstFlight();
+    return;
+  }
+  DelayedDestruction::DestructorGuard dg(this);
+  std::move(cachedPsk).then(
+      [this, dg, verifier = std::move(verifier)](
+          folly::Optional<CachedPsk>&& psk) mutable {
+        // The connection may have been closed while waiting.
+        if (!callback_ || error()) {
+          return;
+        }
+        fizzClient_.connect(
+            fizzContext_,
+            std::move(verifier),
+            sni_,
+            std::move(psk),
+            extensions_);
+        writeFirstFlight();
+      });
+}
+
+template <typename SM>
+void AsyncFizzClientT<SM>::writeFirstFlight() {
+  if (!firstFlight_) {
+    return;
+  }
+  auto firstFlight = std::move(*firstFlight_);
+  firstFlight_.clear();
+  if (!firstFlight.data.empty() || !firstFlight.callbacks.empty()) {
+    auto data = firstFlight.data.move();
+    if (!data) {
+      data = folly::IOBuf::create(0);
+    }
+    // The flight is a single write, so nothing follows to release a cork
+    // set on one of its parts.
+    writeRecordsToTransport(
+        combineWriteCallbacks(std::move(firstFlight.callbacks)),
+        std::move(data),
+        firstFlight.flags & ~folly::WriteFlags::CORK);
   }
-  fizzClient_.connect(
-      fizzContext_,
-      std::move(verifier_),
-      sni_,
-      std::move(cachedPsk),
-      extensions_);
 }
 
 template <typename SM>
@@ -306,13 +511,13 @@ void AsyncFizzClientT<SM>::writeAppData(
 
       if (earlyDataRejectionPolicy_ ==
           EarlyDataRejectionPolicy::AutomaticResend) {
-        // We need to call unshare() to make a copy of the data here since we
-        // may need to resend it after we've already called writeSuccess().
-        // Particularly when using the write and writev interfaces, the
-        // application is allowed to delete the underlying buffer after getting
-        // the write callback.
+        // We may need to resend the data after we've already called
+        // writeSuccess(). Buffers we own are kept by reference, but with the
+        // write and writev interfaces the application is allowed to delete
+        // the underlying buffer after getting the write callback, so
+        // makeManaged() copies any segments we don't own.
         auto writeCopy = w.data->clone();
-        writeCopy->unshare();
+        writeCopy->makeManaged();
         earlyDataState_->resendBuffer.append(std::move(writeCopy));
       }
 
@@ -324,6 +529,7 @@ void AsyncFizzClientT<SM>::writeAppData(
     w.callback = callback;
     w.data = std::move(buf);
     w.flags = flags;
+    w.iovecs = makeWriteIovecs();
     fizzClient_.appWrite(std::move(w));
   }
 }
@@ -337,7 +543,21 @@ void AsyncFizzClientT<SM>::transportError(
 
 template <typename SM>
 void AsyncFizzClientT<SM>::transportDataAvailable() {
+  typename FizzClient<ActionMoveVisitor, SM>::OwnerGuardedScope guarded(
+      fizzClient_);
+  // The Finished is written while processing the server's flight, and app
+  // writes made from the handshake callback are processed right after it,
+  // still within newTransportData().
+  bool collectFlight = coalesceFinishedWithAppData_ && !firstFlight_ &&
+      state_.state() != StateEnum::Established &&
+      state_.state() != StateEnum::Error;
+  if (collectFlight) {
+    firstFlight_.emplace();
+  }
   fizzClient_.newTransportData();
+  if (collectFlight) {
+    writeFirstFlight();
+  }
 }
 
 template <typename SM>
@@ -345,6 +565,8 @@ void AsyncFizzClientT<SM>::deliverAllErrors(
     const folly::AsyncSocketException& ex,
     bool closeTransport) {
   DelayedDestruction::DestructorGuard dg(this);
+  // Anything already collected, such as an alert, goes out before closing.
+  writeFirstFlight();
   deliverHandshakeError(ex);
 
   if (replaySafetyCallback_) {
@@ -399,7 +621,23 @@ void AsyncFizzClientT<SM>::ActionMoveVisitor::operator()(DeliverAppData& data) {
 
 template <typename SM>
 void AsyncFizzClientT<SM>::ActionMoveVisitor::operator()(WriteToSocket& data) {
-  client_.transport_->writeChain(
+  if (client_.firstFlight_) {
+    // The flight is written as one chain, so app data records encoded into
+    // iovecs are copied into it.
+    auto records =
+        data.iovecs ? data.iovecs->copyRecords() : std::move(data.data);
+    client_.firstFlight_->callbacks.push_back(
+        {data.callback, records ? records->computeChainDataLength() : 0});
+    client_.firstFlight_->data.append(std::move(records));
+    client_.firstFlight_->flags = client_.firstFlight_->flags | data.flags;
+    return;
+  }
+  if (data.iovecs) {
+    client_.writeRecordsToTransport(
+        data.callback, std::move(data.iovecs), data.flags);
+    return;
+  }
+  client_.writeRecordsToTransport(
       data.callback, std::move(data.data), data.flags);
 }
 
@@ -523,12 +761,16 @@ void AsyncFizzClientT<SM>::ActionMoveVisitor::operator()(WaitForData&) {
   if (client_.callback_) {
     // Make sure that the read callback is installed.
     client_.startTransportReads();
+  } else {
+    client_.checkBufLen();
   }
 }
 
 template <typename SM>
 void AsyncFizzClientT<SM>::ActionMoveVisitor::operator()(MutateState& mutator) {
   mutator(client_.state_);
+  client_.attachReadRecordLayer(client_.state_.readRecordLayer());
+  client_.scheduleMemoryUsageReport();
 }
 
 template <typename SM>
@@ -537,6 +779,14 @@ void AsyncFizzClientT<SM>::ActionMoveVisitor::operator()(
   if (client_.pskIdentity_) {
     client_.fizzContext_->putPsk(
         *client_.pskIdentity_, std::move(newCachedPsk.psk));
+    client_.ticketStored(*client_.pskIdentity_);
+  }
+}
+
+template <typename SM>
+void AsyncFizzClientT<SM>::ticketStored(const std::string& pskIdentity) {
+  if (newTicketCallback_) {
+    newTicketCallback_(pskIdentity);
   }
 }
 
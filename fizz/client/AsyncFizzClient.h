@@ -15,6 +15,7 @@
 #include <fizz/client/FizzClientContext.h>
 #include <fizz/protocol/AsyncFizzBase.h>
 #include <fizz/protocol/Exporter.h>
+#include <fizz/protocol/KTLS.h>
 
 namespace fizz {
 namespace client {
@@ -66,6 +67,16 @@ class AsyncFizzClientT : public AsyncFizzBase,
       folly::Optional<std::string> pskIdentity,
       std::chrono::milliseconds = std::chrono::milliseconds(0));
 
+  /**
+   * Same as the connect() above, completing the returned future instead of
+   * calling a HandshakeCallback.
+   **/
+  folly::Future<folly::Unit> connect(
+      std::shared_ptr<const CertificateVerifier> verifier,
+      folly::Optional<std::string> sni,
+      folly::Optional<std::string> pskIdentity,
+      std::chrono::milliseconds = std::chrono::milliseconds(0));
+
   /**
    * Opens a socket to the given address and performs a TLS handshake.
    **/
@@ -94,6 +105,7 @@ class AsyncFizzClientT : public AsyncFizzBase,
   bool readable() const override;
   bool connecting() const override;
   bool error() const override;
+  void attachEventBase(folly::EventBase* evb) override;
 
   folly::ssl::X509UniquePtr getPeerCert() const override;
   const X509* getSelfCert() const override;
@@ -110,6 +122,31 @@ class AsyncFizzClientT : public AsyncFizzBase,
   void closeWithReset() override;
   void closeNow() override;
 
+  void releaseIdleResources() override;
+
+  MemoryUsage getMemoryUsage() const override;
+
+  /**
+   * Merge app writes that queue up behind the state machine into a single
+   * write. See FizzBase::setCoalesceAppWrites().
+   */
+  void setCoalesceAppWrites(bool enabled) {
+    fizzClient_.setCoalesceAppWrites(enabled);
+  }
+
+  /**
+   * Hand record protection over to the kernel (see KTLS.h) and pass app data
+   * through to the socket from now on. Only possible once the handshake is
+   * complete, with no buffered reads or writes in flight, and when the
+   * underlying transport is an AsyncSocket. Returns false (and keeps using
+   * userspace record protection) if kTLS could not be enabled.
+   *
+   * Once enabled, closing the transport no longer sends a close_notify alert.
+   * options are passed on to the kernel, and mostly matter when the NIC
+   * offloads record protection.
+   */
+  bool enableKTLS(const KTLSOptions& options = KTLSOptions());
+
   /**
    * Set the policy for dealing with rejected early data.
    *
@@ -121,6 +158,45 @@ class AsyncFizzClientT : public AsyncFizzBase,
     earlyDataRejectionPolicy_ = policy;
   }
 
+  /**
+   * When set, connect() with an address builds the ClientHello while the TCP
+   * connect is in flight, so the first flight is written as soon as the
+   * socket connects. Has no effect on an already open socket.
+   */
+  void setPrepareClientHelloDuringConnect(bool prepare) {
+    prepareClientHelloDuringConnect_ = prepare;
+  }
+
+  /**
+   * When set, connect() with an address uses TCP Fast Open on the underlying
+   * socket. The ClientHello and any early data written from the connect
+   * callback are sent in a single write so that they can ride the SYN.
+   */
+  void setTFOEnabled(bool enabled) {
+    tfoEnabled_ = enabled;
+  }
+
+  /**
+   * When set, the client's Finished and whatever the app writes from the
+   * handshake success callback (or before then, when it is queued behind the
+   * handshake) are sent in a single write instead of one write each. Request
+   * and response protocols then usually send their first request in the
+   * same segment as the Finished.
+   */
+  void setCoalesceFinishedWithAppData(bool enabled) {
+    coalesceFinishedWithAppData_ = enabled;
+  }
+
+  /**
+   * Called with the PSK identity each time a ticket from the server has been
+   * stored in the context's PskCache.
+   */
+  using NewTicketCallback = std::function<void(const std::string&)>;
+
+  void setNewTicketCallback(NewTicketCallback callback) {
+    newTicketCallback_ = std::move(callback);
+  }
+
   /**
    * Internal state access for logging/testing.
    */
@@ -134,6 +210,16 @@ class AsyncFizzClientT : public AsyncFizzBase,
   Buf getEarlyEkm(folly::StringPiece label, const Buf& context, uint16_t length)
       const;
 
+  /**
+   * Same as getEkm(), writing out.size() bytes into out.
+   */
+  void getEkm(
+      folly::StringPiece label,
+      folly::ByteRange context,
+      folly::MutableByteRange out) const {
+    fizzClient_.getEkm(label, context, out);
+  }
+
   bool pskResumed() const;
 
  protected:
@@ -146,12 +232,36 @@ class AsyncFizzClientT : public AsyncFizzBase,
 
   void transportDataAvailable() override;
 
+  void ticketStored(const std::string& pskIdentity);
+
  private:
   void deliverAllErrors(
       const folly::AsyncSocketException& ex,
       bool closeTransport = true);
   void deliverHandshakeError(folly::exception_wrapper ex);
 
+  /**
+   * Writes out the flight collected in firstFlight_, if any.
+   */
+  void writeFirstFlight();
+
+  /**
+   * Looks up the PSK for pskIdentity_. A lookup that can't complete right
+   * away gets the context's PSK lookup timeout and completes on the
+   * EventBase. Completes with none on failure or timeout.
+   */
+  folly::Future<folly::Optional<CachedPsk>> lookupPsk();
+
+  /**
+   * Starts the handshake, and writes out the first flight, once cachedPsk
+   * completes.
+   */
+  void connectWithPsk(
+      folly::Future<folly::Optional<CachedPsk>> cachedPsk,
+      std::shared_ptr<const CertificateVerifier> verifier);
+
+  class FutureHandshakeCallback;
+
   void connectErr(const folly::AsyncSocketException& ex) noexcept override;
   void connectSuccess() noexcept override;
 
@@ -215,8 +325,28 @@ class AsyncFizzClientT : public AsyncFizzBase,
 
   folly::AsyncTransport::ReplaySafetyCallback* replaySafetyCallback_{nullptr};
 
+  NewTicketCallback newTicketCallback_;
+
   // Set when using socket connect() API to later pass into the state machine
   std::shared_ptr<const CertificateVerifier> verifier_;
+
+  // PSK lookup started during the TCP connect that hadn't completed yet.
+  folly::Optional<folly::Future<folly::Optional<CachedPsk>>> pendingPsk_;
+
+  bool prepareClientHelloDuringConnect_{false};
+
+  bool tfoEnabled_{false};
+
+  bool coalesceFinishedWithAppData_{false};
+
+  // Set while a flight is being collected into a single write: the first
+  // flight with TFO, or the Finished and the first app data.
+  struct FirstFlight {
+    folly::IOBufQueue data{folly::IOBufQueue::cacheChainLength()};
+    std::vector<MergedWrite> callbacks;
+    folly::WriteFlags flags{folly::WriteFlags::NONE};
+  };
+  folly::Optional<FirstFlight> firstFlight_;
 };
 
 using AsyncFizzClient = AsyncFizzClientT<ClientStateMachine>;
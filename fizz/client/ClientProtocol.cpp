@@ -10,10 +10,16 @@
 
 #include <fizz/client/PskCache.h>
 #include <fizz/crypto/Utils.h>
+#include <fizz/protocol/AsyncCertificateVerifier.h>
 #include <fizz/protocol/CertificateVerifier.h>
+#include <fizz/protocol/DelegatedCredential.h>
+#include <fizz/protocol/HandshakeTracer.h>
+#include <fizz/protocol/LazyPeerCert.h>
 #include <fizz/protocol/Protocol.h>
 #include <fizz/protocol/StateMachine.h>
+#include <fizz/protocol/TLSStats.h>
 #include <fizz/record/Extensions.h>
+#include <folly/executors/InlineExecutor.h>
 
 using folly::Optional;
 
@@ -72,6 +78,12 @@ FIZZ_DECLARE_EVENT_HANDLER(
     Event::Certificate,
     StateEnum::ExpectingCertificateVerify);
 
+FIZZ_DECLARE_EVENT_HANDLER(
+    ClientTypes,
+    StateEnum::ExpectingCertificate,
+    Event::CompressedCertificate,
+    StateEnum::ExpectingCertificateVerify);
+
 FIZZ_DECLARE_EVENT_HANDLER(
     ClientTypes,
     StateEnum::ExpectingCertificate,
@@ -131,10 +143,19 @@ FIZZ_DECLARE_EVENT_HANDLER(
     StateEnum::Established,
     Event::KeyUpdate,
     StateEnum::Error);
+
+static AsyncActions processServerHello(const State& state, ServerHello shlo);
 } // namespace sm
 
 namespace client {
 
+namespace detail {
+static Actions processEvent(
+    const State& state,
+    sm::StateMachine<ClientTypes>::EventHandlerFun handler,
+    Param param);
+} // namespace detail
+
 Actions ClientStateMachine::processConnect(
     const State& state,
     std::shared_ptr<const FizzClientContext> context,
@@ -151,7 +172,46 @@ Actions ClientStateMachine::processConnect(
   return detail::processEvent(state, std::move(connect));
 }
 
-Actions ClientStateMachine::processSocketData(
+/**
+ * Holds on to the actions for the server Finished until the asynchronous
+ * verification of the server certificate chain completes, so that nothing is
+ * written or reported before then.
+ */
+static AsyncActions waitForCertVerification(
+    const State& state,
+    Actions finishedActions) {
+  for (const auto& action : finishedActions) {
+    if (boost::get<ReportError>(&action)) {
+      return std::move(finishedActions);
+    }
+  }
+  auto verification = state.pendingCertVerification()->getFuture();
+  if (state.executor()) {
+    // The verifier may complete on its own thread, the actions must be
+    // produced on the connection's.
+    verification = std::move(verification).via(state.executor());
+  }
+  return std::move(verification).then(
+      [&state, finishedActions = std::move(finishedActions)](
+          folly::Try<folly::Unit>&& result) mutable -> Actions {
+        if (!result.hasException()) {
+          return std::move(finishedActions);
+        }
+        auto fizzEx = result.exception().get_exception<FizzException>();
+        if (fizzEx) {
+          return detail::handleError(state, fizzEx->what(), fizzEx->getAlert());
+        }
+        auto ex = result.exception().get_exception<std::exception>();
+        return detail::handleError(
+            state,
+            folly::to<std::string>(
+                "verifier failure: ",
+                ex ? ex->what() : result.exception().what().toStdString()),
+            AlertDescription::bad_certificate);
+      });
+}
+
+AsyncActions ClientStateMachine::processSocketData(
     const State& state,
     folly::IOBufQueue& buf) {
   try {
@@ -161,10 +221,36 @@ Actions ClientStateMachine::processSocketData(
           "attempting to process data without record layer",
           folly::none);
     }
-    auto param = state.readRecordLayer()->readEvent(buf);
+    auto result = state.readRecordLayer()->tryReadEvent(buf);
+    if (result.hasError()) {
+      return detail::handleError(
+          state, result.error().message, AlertDescription::decode_error);
+    }
+    auto& param = result.value();
     if (!param.hasValue()) {
       return actions(WaitForData());
     }
+    // Once Established the server mostly sends AppData, with the occasional
+    // NewSessionTicket or KeyUpdate; go straight to the AppData handler.
+    if (state.state() == StateEnum::Established &&
+        boost::get<AppData>(&*param)) {
+      return detail::processEvent(
+          state,
+          &sm::EventHandler<
+              ClientTypes,
+              StateEnum::Established,
+              Event::AppData>::handle,
+          std::move(*param));
+    }
+    if (state.state() == StateEnum::ExpectingServerHello &&
+        boost::get<ServerHello>(&*param)) {
+      return sm::processServerHello(
+          state, std::move(boost::get<ServerHello>(*param)));
+    }
+    if (state.pendingCertVerification() && boost::get<Finished>(&*param)) {
+      return waitForCertVerification(
+          state, detail::processEvent(state, std::move(*param)));
+    }
     return detail::processEvent(state, std::move(*param));
   } catch (const std::exception& e) {
     return detail::handleError(state, e.what(), AlertDescription::decode_error);
@@ -180,6 +266,15 @@ Actions ClientStateMachine::processWriteNewSessionTicket(
 Actions ClientStateMachine::processAppWrite(
     const State& state,
     AppWrite write) {
+  if (state.state() == StateEnum::Established) {
+    return detail::processEvent(
+        state,
+        &sm::EventHandler<
+            ClientTypes,
+            StateEnum::Established,
+            Event::AppWrite>::handle,
+        std::move(write));
+  }
   return detail::processEvent(state, std::move(write));
 }
 
@@ -197,9 +292,18 @@ namespace detail {
 
 Actions processEvent(const State& state, Param param) {
   auto event = boost::apply_visitor(EventVisitor(), param);
+  return processEvent(
+      state,
+      sm::StateMachine<ClientTypes>::getHandler(state.state(), event),
+      std::move(param));
+}
+
+static Actions processEvent(
+    const State& state,
+    sm::StateMachine<ClientTypes>::EventHandlerFun handler,
+    Param param) {
   try {
-    return sm::StateMachine<ClientTypes>::getHandler(state.state(), event)(
-        state, std::move(param));
+    return handler(state, std::move(param));
   } catch (const FizzException& e) {
     return detail::handleError(state, e.what(), e.getAlert());
   } catch (const std::exception& e) {
@@ -308,25 +412,34 @@ static std::map<NamedGroup, std::unique_ptr<KeyExchange>> getKeyExchangers(
     const std::vector<NamedGroup>& groups) {
   std::map<NamedGroup, std::unique_ptr<KeyExchange>> keyExchangers;
   for (auto group : groups) {
-    auto kex = factory.makeKeyExchange(group);
+    TLSStats::Timer timer(TLSCounter::KeyExchangeNanos);
+    auto kex =
+        factory.makeKeyExchange(group, Factory::KeyExchangeMode::Client);
     kex->generateKeyPair();
     keyExchangers.emplace(group, std::move(kex));
   }
   return keyExchangers;
 }
 
+static void appendExtensions(
+    std::vector<Extension>& extensions,
+    const std::vector<Extension>& toAppend) {
+  for (const auto& ext : toAppend) {
+    Extension copy;
+    copy.extension_type = ext.extension_type;
+    copy.extension_data = ext.extension_data->clone();
+    extensions.push_back(std::move(copy));
+  }
+}
+
 static ClientHello getClientHello(
     const Factory& /*factory*/,
     const Random& random,
     bool alternateSniCodePoint,
     const std::vector<CipherSuite>& supportedCiphers,
-    const std::vector<ProtocolVersion>& supportedVersions,
-    const std::vector<NamedGroup>& supportedGroups,
+    const FizzClientContext::ClientHelloExtensions& contextExtensions,
     const std::map<NamedGroup, std::unique_ptr<KeyExchange>>& shares,
-    const std::vector<SignatureScheme>& supportedSigSchemes,
-    const std::vector<PskKeyExchangeMode>& supportedPskModes,
     const folly::Optional<std::string>& hostname,
-    const std::vector<std::string>& supportedAlpns,
     const Optional<EarlyDataParams>& earlyDataParams,
     const Buf& legacySessionId,
     ClientExtensions* extensions,
@@ -338,13 +451,14 @@ static ClientHello getClientHello(
   chlo.cipher_suites = supportedCiphers;
   chlo.legacy_compression_methods.push_back(0x00);
 
-  SupportedVersions versions;
-  versions.versions = supportedVersions;
-  chlo.extensions.push_back(encodeExtension(std::move(versions)));
+  // Room for the context's extensions, key_share, server_name, early_data,
+  // cookie and pre_shared_key.
+  chlo.extensions.reserve(
+      contextExtensions.beforeKeyShare.size() +
+      contextExtensions.beforeServerName.size() +
+      contextExtensions.afterServerName.size() + 5);
 
-  SupportedGroups groups;
-  groups.named_group_list = supportedGroups;
-  chlo.extensions.push_back(encodeExtension(std::move(groups)));
+  appendExtensions(chlo.extensions, contextExtensions.beforeKeyShare);
 
   ClientKeyShare keyShare;
   for (const auto& share : shares) {
@@ -355,9 +469,7 @@ static ClientHello getClientHello(
   }
   chlo.extensions.push_back(encodeExtension(std::move(keyShare)));
 
-  SignatureAlgorithms sigAlgs;
-  sigAlgs.supported_signature_algorithms = supportedSigSchemes;
-  chlo.extensions.push_back(encodeExtension(std::move(sigAlgs)));
+  appendExtensions(chlo.extensions, contextExtensions.beforeServerName);
 
   if (hostname) {
     ServerNameList sni;
@@ -368,21 +480,7 @@ static ClientHello getClientHello(
     chlo.extensions.push_back(encodeExtension(std::move(sni)));
   }
 
-  if (!supportedAlpns.empty()) {
-    ProtocolNameList alpn;
-    for (const auto& protoName : supportedAlpns) {
-      ProtocolName proto;
-      proto.name = folly::IOBuf::copyBuffer(protoName);
-      alpn.protocol_name_list.push_back(std::move(proto));
-    }
-    chlo.extensions.push_back(encodeExtension(std::move(alpn)));
-  }
-
-  if (!supportedPskModes.empty()) {
-    PskKeyExchangeModes modes;
-    modes.modes = supportedPskModes;
-    chlo.extensions.push_back(encodeExtension(std::move(modes)));
-  }
+  appendExtensions(chlo.extensions, contextExtensions.afterServerName);
 
   if (earlyDataParams) {
     chlo.extensions.push_back(encodeExtension(ClientEarlyData()));
@@ -442,34 +540,34 @@ static Buf encodeAndAddBinders(
       handshakeContext.getBlankContext());
 
   auto pskExt = getPskExtension(psk);
-  chlo.extensions.push_back(encodeExtension(pskExt));
+  auto binderSize = pskExt.binders.front().binder->length();
+  chlo.extensions.push_back(encodeExtension(std::move(pskExt)));
 
   size_t binderLength = getBinderLength(chlo);
 
-  auto preEncoded = encodeHandshake(chlo);
+  // The binder only covers the ClientHello up to the binder list, so encode
+  // once with a zeroed binder and patch the real one in afterwards.
+  auto encoded = encodeHandshake(std::move(chlo));
+  auto encodedLength = encoded->computeChainDataLength();
 
   // Add the ClientHello up to the binder list to the transcript.
   {
     folly::IOBufQueue chloQueue(folly::IOBufQueue::cacheChainLength());
-    chloQueue.append(std::move(preEncoded));
-    auto chloPrefix = chloQueue.split(chloQueue.chainLength() - binderLength);
-    handshakeContext.appendToTranscript(chloPrefix);
+    chloQueue.append(encoded->clone());
+    handshakeContext.appendToTranscript(
+        chloQueue.split(encodedLength - binderLength));
   }
 
-  PskBinder binder;
-  binder.binder = handshakeContext.getFinishedData(folly::range(binderKey));
-  pskExt.binders.clear();
-  pskExt.binders.push_back(std::move(binder));
-
-  chlo.extensions.pop_back();
-  chlo.extensions.push_back(encodeExtension(std::move(pskExt)));
-
-  auto encoded = encodeHandshake(std::move(chlo));
+  auto binder = handshakeContext.getFinishedData(folly::range(binderKey));
+  DCHECK_EQ(binder->computeChainDataLength(), binderSize);
+  folly::io::RWPrivateCursor binderCursor(encoded.get());
+  binderCursor.skip(encodedLength - binderSize);
+  binderCursor.push(binder->coalesce());
 
   // Add the binder list to the transcript.
   folly::IOBufQueue chloQueue(folly::IOBufQueue::cacheChainLength());
   chloQueue.append(encoded->clone());
-  chloQueue.split(chloQueue.chainLength() - binderLength);
+  chloQueue.split(encodedLength - binderLength);
   handshakeContext.appendToTranscript(chloQueue.move());
 
   return encoded;
@@ -530,7 +628,24 @@ EventHandler<ClientTypes, StateEnum::Uninitialized, Event::Connect>::handle(
     // psk_ke last time
     selectedShares = {};
   } else {
-    selectedShares = context->getDefaultShares();
+    // Without a PSK, use the group the server picked last time if we know
+    // it, to avoid a HelloRetryRequest and generating unused shares.
+    folly::Optional<NamedGroup> cachedGroup;
+    if (connect.sni) {
+      cachedGroup = context->getKeyShareGroup(*connect.sni);
+    }
+    if (cachedGroup &&
+        std::find(
+            context->getSupportedGroups().begin(),
+            context->getSupportedGroups().end(),
+            *cachedGroup) != context->getSupportedGroups().end()) {
+      selectedShares = {*cachedGroup};
+    } else {
+      selectedShares = context->getDefaultShares();
+      if (context->getLazyDefaultShares() && selectedShares.size() > 1) {
+        selectedShares.resize(1);
+      }
+    }
   }
 
   auto earlyDataParams = getEarlyDataParams(*context, psk);
@@ -550,13 +665,9 @@ EventHandler<ClientTypes, StateEnum::Uninitialized, Event::Connect>::handle(
       random,
       context->getUseAlternateSniCodePoint(),
       context->getSupportedCiphers(),
-      context->getSupportedVersions(),
-      context->getSupportedGroups(),
+      context->getClientHelloExtensions(),
       keyExchangers,
-      context->getSupportedSigSchemes(),
-      context->getSupportedPskModes(),
       connect.sni,
-      context->getSupportedAlpns(),
       earlyDataParams,
       legacySessionId,
       connect.extensions.get());
@@ -580,11 +691,13 @@ EventHandler<ClientTypes, StateEnum::Uninitialized, Event::Connect>::handle(
 
     if (earlyDataParams) {
       earlyWriteRecordLayer =
-          context->getFactory()->makeEncryptedWriteRecordLayer();
+          context->getFactory()->makeEncryptedWriteRecordLayer(
+              EncryptionLevel::EarlyData);
       earlyWriteRecordLayer->setProtocolVersion(psk->version);
+      std::array<uint8_t, kMaxHashLength> chloContextBuf;
       auto earlyWriteSecret = keyScheduler->getSecret(
           EarlySecrets::ClientEarlyTraffic,
-          handshakeContext->getHandshakeContext()->coalesce());
+          handshakeContext->getHandshakeContext(folly::range(chloContextBuf)));
       Protocol::setAead(
           *earlyWriteRecordLayer,
           psk->cipher,
@@ -594,7 +707,7 @@ EventHandler<ClientTypes, StateEnum::Uninitialized, Event::Connect>::handle(
 
       auto earlyExporterVector = keyScheduler->getSecret(
           EarlySecrets::EarlyExporter,
-          handshakeContext->getHandshakeContext()->coalesce());
+          handshakeContext->getHandshakeContext(folly::range(chloContextBuf)));
       earlyDataParams->earlyExporterSecret =
           folly::IOBuf::copyBuffer(folly::range(earlyExporterVector));
 
@@ -616,6 +729,11 @@ EventHandler<ClientTypes, StateEnum::Uninitialized, Event::Connect>::handle(
   EarlyDataType earlyDataType =
       earlyDataParams ? EarlyDataType::Attempted : EarlyDataType::NotAttempted;
 
+  uint64_t handshakeId = 0;
+  if (context->getHandshakeTracer()) {
+    handshakeId = HandshakeTracer::newHandshakeId();
+  }
+
   auto saveState = [context = std::move(context),
                     verifier = connect.verifier,
                     encodedClientHello = std::move(encodedClientHello),
@@ -628,8 +746,10 @@ EventHandler<ClientTypes, StateEnum::Uninitialized, Event::Connect>::handle(
                     psk = std::move(psk),
                     extensions = connect.extensions,
                     requestedExtensions = std::move(requestedExtensions),
-                    earlyDataType](State& newState) mutable {
+                    earlyDataType,
+                    handshakeId](State& newState) mutable {
     newState.context() = std::move(context);
+    newState.handshakeId() = handshakeId;
     newState.verifier() = verifier;
     newState.encodedClientHello() = std::move(encodedClientHello);
     newState.readRecordLayer() = std::move(readRecordLayer);
@@ -823,11 +943,12 @@ static NegotiatedPsk negotiatePsk(
   }
 }
 
-Actions
-EventHandler<ClientTypes, StateEnum::ExpectingServerHello, Event::ServerHello>::
-    handle(const State& state, Param param) {
-  auto shlo = std::move(boost::get<ServerHello>(param));
-
+/**
+ * Handles the ServerHello. sharedSecret is the result of the key exchange with
+ * the server's share if it has already been computed, and null otherwise.
+ */
+static Actions
+handleServerHello(const State& state, ServerHello shlo, Buf sharedSecret) {
   Protocol::checkAllowedExtensions(shlo, *state.requestedExtensions());
 
   ProtocolVersion version;
@@ -890,8 +1011,19 @@ EventHandler<ClientTypes, StateEnum::ExpectingServerHello, Event::ServerHello>::
     Buf serverShare;
     const KeyExchange* kex;
     std::tie(group, serverShare, kex) = std::move(*exchange);
-    auto sharedSecret = kex->generateSharedSecret(serverShare->coalesce());
+    if (!sharedSecret) {
+      TLSStats::Timer timer(TLSCounter::KeyExchangeNanos);
+      sharedSecret = kex->generateSharedSecret(serverShare->coalesce());
+    }
     scheduler->deriveHandshakeSecret(sharedSecret->coalesce());
+
+    // Remember the group unless it was already the only share we offered
+    // up front.
+    if (state.sni() &&
+        (*keyExchangeType == KeyExchangeType::HelloRetryRequest ||
+         state.keyExchangers()->size() > 1)) {
+      state.context()->putKeyShareGroup(*state.sni(), *group);
+    }
   } else {
     keyExchangeType = KeyExchangeType::None;
     scheduler->deriveHandshakeSecret();
@@ -903,11 +1035,13 @@ EventHandler<ClientTypes, StateEnum::ExpectingServerHello, Event::ServerHello>::
   }
 
   auto handshakeWriteRecordLayer =
-      state.context()->getFactory()->makeEncryptedWriteRecordLayer();
+      state.context()->getFactory()->makeEncryptedWriteRecordLayer(
+          EncryptionLevel::Handshake);
   handshakeWriteRecordLayer->setProtocolVersion(version);
+  std::array<uint8_t, kMaxHashLength> shloContextBuf;
   auto handshakeWriteSecret = scheduler->getSecret(
       HandshakeSecrets::ClientHandshakeTraffic,
-      handshakeContext->getHandshakeContext()->coalesce());
+      handshakeContext->getHandshakeContext(folly::range(shloContextBuf)));
   Protocol::setAead(
       *handshakeWriteRecordLayer,
       cipher,
@@ -916,11 +1050,12 @@ EventHandler<ClientTypes, StateEnum::ExpectingServerHello, Event::ServerHello>::
       *scheduler);
 
   auto handshakeReadRecordLayer =
-      state.context()->getFactory()->makeEncryptedReadRecordLayer();
+      state.context()->getFactory()->makeEncryptedReadRecordLayer(
+          EncryptionLevel::Handshake);
   handshakeReadRecordLayer->setProtocolVersion(version);
   auto handshakeReadSecret = scheduler->getSecret(
       HandshakeSecrets::ServerHandshakeTraffic,
-      handshakeContext->getHandshakeContext()->coalesce());
+      handshakeContext->getHandshakeContext(folly::range(shloContextBuf)));
   Protocol::setAead(
       *handshakeReadRecordLayer,
       cipher,
@@ -977,6 +1112,65 @@ EventHandler<ClientTypes, StateEnum::ExpectingServerHello, Event::ServerHello>::
       &Transition<StateEnum::ExpectingEncryptedExtensions>);
 }
 
+Actions
+EventHandler<ClientTypes, StateEnum::ExpectingServerHello, Event::ServerHello>::
+    handle(const State& state, Param param) {
+  return handleServerHello(
+      state, std::move(boost::get<ServerHello>(param)), nullptr);
+}
+
+/**
+ * Starts the key exchange with the server's share and handles the ServerHello
+ * once it completes, so that a KeyExchange may complete asynchronously. If it
+ * completed synchronously the ServerHello is handled inline.
+ */
+static AsyncActions processServerHello(const State& state, ServerHello shlo) {
+  const KeyExchange* kex = nullptr;
+  auto serverShare = getExtension<ServerKeyShare>(shlo.extensions);
+  if (serverShare && state.keyExchangers()) {
+    auto it = state.keyExchangers()->find(serverShare->server_share.group);
+    if (it != state.keyExchangers()->end()) {
+      kex = it->second.get();
+    }
+  }
+  if (!kex) {
+    // The handler rejects the ServerHello if it needed a share.
+    return client::detail::processEvent(state, std::move(shlo));
+  }
+
+  folly::SemiFuture<Buf> sharedSecret = [&]() {
+    try {
+      TLSStats::Timer timer(TLSCounter::KeyExchangeNanos);
+      return kex->generateSharedSecretAsync(
+          serverShare->server_share.key_exchange->coalesce());
+    } catch (const std::exception& e) {
+      return folly::makeSemiFuture<Buf>(
+          folly::exception_wrapper(std::current_exception(), e));
+    }
+  }();
+
+  auto handle = [&state, shlo = std::move(shlo)](
+                    folly::Try<Buf>&& result) mutable -> Actions {
+    try {
+      return handleServerHello(
+          state, std::move(shlo), std::move(result).value());
+    } catch (const FizzException& e) {
+      return client::detail::handleError(state, e.what(), e.getAlert());
+    } catch (const std::exception& e) {
+      return client::detail::handleError(
+          state, e.what(), AlertDescription::unexpected_message);
+    }
+  };
+  if (sharedSecret.isReady()) {
+    return handle(std::move(sharedSecret).getTry());
+  }
+  folly::Executor* executor = state.executor();
+  if (!executor) {
+    executor = &folly::InlineExecutor::instance();
+  }
+  return std::move(sharedSecret).via(executor).then(std::move(handle));
+}
+
 namespace {
 struct HrrParams {
   ProtocolVersion version;
@@ -1066,13 +1260,9 @@ Actions EventHandler<
       state.clientRandom(),
       state.context()->getUseAlternateSniCodePoint(),
       state.context()->getSupportedCiphers(),
-      state.context()->getSupportedVersions(),
-      state.context()->getSupportedGroups(),
+      state.context()->getClientHelloExtensions(),
       keyExchangers,
-      state.context()->getSupportedSigSchemes(),
-      state.context()->getSupportedPskModes(),
       state.sni(),
-      state.context()->getSupportedAlpns(),
       folly::none,
       state.legacySessionId(),
       state.extensions(),
@@ -1208,6 +1398,19 @@ Actions EventHandler<
     }
   }
 
+  Optional<CertificateType> serverCertType;
+  auto certType = getExtension<ServerCertType>(ee.extensions);
+  if (certType) {
+    const auto& offered = state.context()->getServerCertTypes();
+    if (std::find(offered.begin(), offered.end(), certType->certificate_type) ==
+        offered.end()) {
+      throw FizzException(
+          "server chose unoffered certificate type",
+          AlertDescription::illegal_parameter);
+    }
+    serverCertType = certType->certificate_type;
+  }
+
   auto serverEarly = getExtension<ServerEarlyData>(ee.extensions);
   auto earlyDataType = state.earlyDataType();
   if (state.earlyDataType() == EarlyDataType::Attempted) {
@@ -1230,8 +1433,10 @@ Actions EventHandler<
   }
 
   auto mutateState = [appProto = std::move(appProto),
+                      serverCertType,
                       earlyDataType](State& newState) mutable {
     newState.alpn() = std::move(appProto);
+    newState.serverCertType() = serverCertType;
     newState.requestedExtensions() = folly::none;
     newState.earlyDataType() = earlyDataType;
   };
@@ -1323,30 +1528,99 @@ Actions EventHandler<
       std::move(mutateState), &Transition<StateEnum::ExpectingCertificate>);
 }
 
-Actions
-EventHandler<ClientTypes, StateEnum::ExpectingCertificate, Event::Certificate>::
-    handle(const State& state, Param param) {
-  auto certMsg = std::move(boost::get<CertificateMsg>(param));
+static std::shared_ptr<const PeerCert> getDelegatedPeerCert(
+    const State& state,
+    std::shared_ptr<const PeerCert> leaf,
+    const Buf& certData,
+    const DelegatedCredential& credential) {
+  const auto& credentialSchemes =
+      state.context()->getSupportedDelegatedCredentialSchemes();
+  if (std::find(
+          credentialSchemes.begin(),
+          credentialSchemes.end(),
+          credential.expected_verify_scheme) == credentialSchemes.end()) {
+    throw FizzException(
+        "unsupported delegated credential scheme",
+        AlertDescription::illegal_parameter);
+  }
+  const auto& sigSchemes = state.context()->getSupportedSigSchemes();
+  if (std::find(
+          sigSchemes.begin(),
+          sigSchemes.end(),
+          credential.credential_scheme) == sigSchemes.end()) {
+    throw FizzException(
+        "unsupported delegated credential signature scheme",
+        AlertDescription::illegal_parameter);
+  }
 
-  state.handshakeContext()->appendToTranscript(*certMsg.originalEncoding);
+  try {
+    DelegatedCredentialUtils::verify(
+        *leaf, certData, credential, std::chrono::system_clock::now());
+    return DelegatedCredentialUtils::makeDelegatedPeerCert(
+        std::move(leaf), credential);
+  } catch (const std::exception& e) {
+    throw FizzException(
+        folly::to<std::string>("invalid delegated credential: ", e.what()),
+        AlertDescription::illegal_parameter);
+  }
+}
 
+static Actions handleCertMsg(const State& state, CertificateMsg certMsg) {
   if (!certMsg.certificate_request_context->empty()) {
     throw FizzException(
         "certificate request context must be empty",
         AlertDescription::illegal_parameter);
   }
 
+  auto rawPublicKey = state.serverCertType() == CertificateType::RawPublicKey;
+  if (rawPublicKey && certMsg.certificate_list.size() > 1) {
+    throw FizzException(
+        "raw public key with multiple entries",
+        AlertDescription::illegal_parameter);
+  }
+
+  auto offeredDelegatedCredential =
+      !state.context()->getSupportedDelegatedCredentialSchemes().empty();
+  Optional<DelegatedCredential> credential;
+  Buf leafCertData;
+
   std::vector<std::shared_ptr<const PeerCert>> serverCerts;
   for (auto& certEntry : certMsg.certificate_list) {
-    // We don't request any certificate-related extensions
-    if (!certEntry.extensions.empty()) {
-      throw FizzException(
-          "certificate extensions must be empty",
-          AlertDescription::illegal_parameter);
+    // The only certificate-related extension we request is a delegated
+    // credential on the leaf.
+    for (const auto& ext : certEntry.extensions) {
+      if (!serverCerts.empty() || !offeredDelegatedCredential ||
+          ext.extension_type != ExtensionType::delegated_credential) {
+        throw FizzException(
+            "certificate extensions must be empty",
+            AlertDescription::illegal_parameter);
+      }
+    }
+    if (serverCerts.empty() && offeredDelegatedCredential) {
+      credential = getExtension<DelegatedCredential>(certEntry.extensions);
+      if (credential) {
+        leafCertData = certEntry.cert_data->clone();
+      }
     }
 
-    serverCerts.emplace_back(state.context()->getFactory()->makePeerCert(
-        std::move(certEntry.cert_data)));
+    if (rawPublicKey) {
+      serverCerts.emplace_back(
+          state.context()->getFactory()->makeRawPublicKeyPeerCert(
+              std::move(certEntry.cert_data)));
+    } else if (serverCerts.empty()) {
+      serverCerts.emplace_back(state.context()->getFactory()->makePeerCert(
+          std::move(certEntry.cert_data)));
+    } else {
+      // Only the leaf is needed to check CertificateVerify, the rest of the
+      // chain keeps its slice of the record and is parsed if the verifier
+      // uses it. The entry may be kept past the handshake (the verifier can
+      // hold on to it), so it shares ownership of the factory.
+      serverCerts.emplace_back(std::make_shared<LazyPeerCert>(
+          std::move(certEntry.cert_data),
+          [factory = state.context()->getFactoryPtr()](Buf certData) {
+            return factory->makePeerCert(std::move(certData));
+          }));
+    }
   }
 
   if (serverCerts.empty()) {
@@ -1354,6 +1628,11 @@ EventHandler<ClientTypes, StateEnum::ExpectingCertificate, Event::Certificate>::
         "no certificates received", AlertDescription::illegal_parameter);
   }
 
+  if (credential) {
+    serverCerts.front() = getDelegatedPeerCert(
+        state, std::move(serverCerts.front()), leafCertData, *credential);
+  }
+
   ClientAuthType authType =
       state.clientAuthRequested().value_or(ClientAuthType::NotRequested);
 
@@ -1366,6 +1645,47 @@ EventHandler<ClientTypes, StateEnum::ExpectingCertificate, Event::Certificate>::
       &Transition<StateEnum::ExpectingCertificateVerify>);
 }
 
+Actions
+EventHandler<ClientTypes, StateEnum::ExpectingCertificate, Event::Certificate>::
+    handle(const State& state, Param param) {
+  auto certMsg = std::move(boost::get<CertificateMsg>(param));
+
+  state.handshakeContext()->appendToTranscript(*certMsg.originalEncoding);
+
+  return handleCertMsg(state, std::move(certMsg));
+}
+
+Actions EventHandler<
+    ClientTypes,
+    StateEnum::ExpectingCertificate,
+    Event::CompressedCertificate>::handle(const State& state, Param param) {
+  auto compressedCert = std::move(boost::get<CompressedCertificate>(param));
+
+  state.handshakeContext()->appendToTranscript(
+      *compressedCert.originalEncoding);
+
+  auto decompressor =
+      state.context()->getCertDecompressor(compressedCert.algorithm);
+  if (!decompressor) {
+    throw FizzException(
+        folly::to<std::string>(
+            "server compressed certificate with unsupported algorithm: ",
+            toString(compressedCert.algorithm)),
+        AlertDescription::illegal_parameter);
+  }
+
+  CertificateMsg certMsg;
+  try {
+    certMsg = decompressor->decompress(compressedCert);
+  } catch (const std::exception& e) {
+    throw FizzException(
+        folly::to<std::string>("certificate decompression failed: ", e.what()),
+        AlertDescription::bad_certificate);
+  }
+
+  return handleCertMsg(state, std::move(certMsg));
+}
+
 Actions EventHandler<
     ClientTypes,
     StateEnum::ExpectingCertificateVerify,
@@ -1387,15 +1707,43 @@ Actions EventHandler<
   CHECK(!state.unverifiedCertChain().empty());
   auto leaf = state.unverifiedCertChain().front();
 
+  std::array<uint8_t, kMaxHashLength> certContextBuf;
   leaf->verify(
       certVerify.algorithm,
       CertificateVerifyContext::Server,
-      state.handshakeContext()->getHandshakeContext()->coalesce(),
+      state.handshakeContext()->getHandshakeContext(
+          folly::range(certContextBuf)),
       certVerify.signature->coalesce());
 
+  std::shared_ptr<folly::SharedPromise<folly::Unit>> pendingVerification;
   if (state.verifier()) {
     try {
-      state.verifier()->verify(state.unverifiedCertChain());
+      auto asyncVerifier =
+          dynamic_cast<const AsyncCertificateVerifier*>(state.verifier());
+      if (asyncVerifier) {
+        auto verification = detail::traceAsyncStep(
+            state.context()->getHandshakeTracer(),
+            state.handshakeId(),
+            HandshakeStep::CertificateVerify,
+            [&]() {
+              return folly::makeFutureWith([&]() {
+                return asyncVerifier->verifyFuture(
+                    state.unverifiedCertChain());
+              });
+            });
+        if (verification.isReady()) {
+          verification.value();
+        } else {
+          pendingVerification =
+              std::make_shared<folly::SharedPromise<folly::Unit>>();
+          std::move(verification)
+              .then([pendingVerification](folly::Try<folly::Unit>&& result) {
+                pendingVerification->setTry(std::move(result));
+              });
+        }
+      } else {
+        state.verifier()->verify(state.unverifiedCertChain());
+      }
     } catch (const FizzException&) {
       std::rethrow_exception(std::current_exception());
     } catch (const std::exception& e) {
@@ -1407,12 +1755,18 @@ Actions EventHandler<
 
   state.handshakeContext()->appendToTranscript(*certVerify.originalEncoding);
 
+  auto serverCert = retainPeerCert(
+      std::move(leaf), state.context()->getPeerCertRetention());
+
   return actions(
       [sigScheme = certVerify.algorithm,
-       serverCert = std::move(leaf)](State& newState) mutable {
+       serverCert = std::move(serverCert),
+       pendingVerification =
+           std::move(pendingVerification)](State& newState) mutable {
         newState.sigScheme() = sigScheme;
         newState.serverCert() = std::move(serverCert);
         newState.unverifiedCertChain() = folly::none;
+        newState.pendingCertVerification() = std::move(pendingVerification);
       },
       &Transition<StateEnum::ExpectingFinished>);
 }
@@ -1462,13 +1816,17 @@ EventHandler<ClientTypes, StateEnum::ExpectingFinished, Event::Finished>::
       break;
     case ClientAuthType::Sent: {
       auto selectedCert = state.selectedClientCert();
-      encodedCertMessage = encodeHandshake(selectedCert->getCertMessage());
+      encodedCertMessage = selectedCert->getEncodedCertMessage();
       state.handshakeContext()->appendToTranscript(*encodedCertMessage);
 
       auto sigScheme = *state.clientAuthSigScheme();
       auto toSign = state.handshakeContext()->getHandshakeContext();
-      auto signature = selectedCert->sign(
-          sigScheme, CertificateVerifyContext::Client, toSign->coalesce());
+      Buf signature;
+      {
+        TLSStats::Timer timer(TLSCounter::SignNanos);
+        signature = selectedCert->sign(
+            sigScheme, CertificateVerifyContext::Client, toSign->coalesce());
+      }
 
       CertificateVerify verify;
       verify.algorithm = sigScheme;
@@ -1490,10 +1848,12 @@ EventHandler<ClientTypes, StateEnum::ExpectingFinished, Event::Finished>::
 
   auto encodedFinished = Protocol::getFinished(
       state.clientHandshakeSecret()->coalesce(), *state.handshakeContext());
+  std::array<uint8_t, kMaxHashLength> clientFinishedContextBuf;
   auto resumptionSecret =
       folly::IOBuf::copyBuffer(folly::range(state.keyScheduler()->getSecret(
           MasterSecrets::ResumptionMaster,
-          state.handshakeContext()->getHandshakeContext()->coalesce())));
+          state.handshakeContext()->getHandshakeContext(
+              folly::range(clientFinishedContextBuf)))));
 
   WriteToSocket write;
   if (auth == ClientAuthType::RequestedNoMatch) {
@@ -1527,8 +1887,11 @@ EventHandler<ClientTypes, StateEnum::ExpectingFinished, Event::Finished>::
   state.keyScheduler()->clearMasterSecret();
 
   auto writeRecordLayer =
-      state.context()->getFactory()->makeEncryptedWriteRecordLayer();
+      state.context()->getFactory()->makeEncryptedWriteRecordLayer(
+          EncryptionLevel::AppTraffic);
   writeRecordLayer->setProtocolVersion(*state.version());
+  writeRecordLayer->setParallelEncryption(
+      state.context()->getParallelEncryption());
   auto writeSecret =
       state.keyScheduler()->getSecret(AppTrafficSecrets::ClientAppTraffic);
   Protocol::setAead(
@@ -1539,8 +1902,12 @@ EventHandler<ClientTypes, StateEnum::ExpectingFinished, Event::Finished>::
       *state.keyScheduler());
 
   auto readRecordLayer =
-      state.context()->getFactory()->makeEncryptedReadRecordLayer();
+      state.context()->getFactory()->makeEncryptedReadRecordLayer(
+          EncryptionLevel::AppTraffic);
   readRecordLayer->setProtocolVersion(*state.version());
+  readRecordLayer->setCoalesceAppData(state.context()->getCoalesceAppData());
+  readRecordLayer->setParallelDecryption(
+      state.context()->getParallelDecryption());
   auto readSecret =
       state.keyScheduler()->getSecret(AppTrafficSecrets::ServerAppTraffic);
   Protocol::setAead(
@@ -1571,6 +1938,7 @@ EventHandler<ClientTypes, StateEnum::ExpectingFinished, Event::Finished>::
         newState.selectedClientCert() = nullptr;
         newState.clientCert() = std::move(clientCert);
         newState.sentCCS() = sentCCS;
+        newState.pendingCertVerification() = nullptr;
       },
       &Transition<StateEnum::Established>,
       std::move(write),
@@ -1633,7 +2001,15 @@ EventHandler<ClientTypes, StateEnum::Established, Event::AppWrite>::handle(
 
   WriteToSocket write;
   write.callback = appWrite.callback;
-  write.data = state.writeRecordLayer()->writeAppData(std::move(appWrite.data));
+  if (appWrite.iovecs) {
+    state.writeRecordLayer()->writeIovecs(
+        TLSMessage{ContentType::application_data, std::move(appWrite.data)},
+        *appWrite.iovecs);
+    write.iovecs = std::move(appWrite.iovecs);
+  } else {
+    write.data =
+        state.writeRecordLayer()->writeAppData(std::move(appWrite.data));
+  }
   write.flags = appWrite.flags;
 
   return actions(std::move(write));
@@ -1649,10 +2025,15 @@ EventHandler<ClientTypes, StateEnum::Established, Event::KeyUpdate>::handle(
     throw FizzException(
         "data after key_update", AlertDescription::unexpected_message);
   }
-  state.keyScheduler()->serverKeyUpdate();
+  auto readGeneration = state.keyScheduler()->serverKeyUpdate();
   auto readRecordLayer =
-      state.context()->getFactory()->makeEncryptedReadRecordLayer();
+      state.context()->getFactory()->makeEncryptedReadRecordLayer(
+          EncryptionLevel::AppTraffic);
+  readRecordLayer->setKeyUpdateGeneration(readGeneration);
   readRecordLayer->setProtocolVersion(*state.version());
+  readRecordLayer->setCoalesceAppData(state.context()->getCoalesceAppData());
+  readRecordLayer->setParallelDecryption(
+      state.context()->getParallelDecryption());
   auto readSecret =
       state.keyScheduler()->getSecret(AppTrafficSecrets::ServerAppTraffic);
   Protocol::setAead(
@@ -1675,11 +2056,15 @@ EventHandler<ClientTypes, StateEnum::Established, Event::KeyUpdate>::handle(
   write.data =
       state.writeRecordLayer()->writeHandshake(std::move(encodedKeyUpdated));
 
-  state.keyScheduler()->clientKeyUpdate();
+  auto writeGeneration = state.keyScheduler()->clientKeyUpdate();
 
   auto writeRecordLayer =
-      state.context()->getFactory()->makeEncryptedWriteRecordLayer();
+      state.context()->getFactory()->makeEncryptedWriteRecordLayer(
+          EncryptionLevel::AppTraffic);
+  writeRecordLayer->setKeyUpdateGeneration(writeGeneration);
   writeRecordLayer->setProtocolVersion(*state.version());
+  writeRecordLayer->setParallelEncryption(
+      state.context()->getParallelEncryption());
   auto writeSecret =
       state.keyScheduler()->getSecret(AppTrafficSecrets::ClientAppTraffic);
   Protocol::setAead(
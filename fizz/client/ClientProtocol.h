@@ -20,7 +20,7 @@ namespace client {
 class ClientStateMachine {
  public:
   using StateType = State;
-  using ProcessingActions = Actions;
+  using ProcessingActions = AsyncActions;
   using CompletedActions = Actions;
 
   virtual ~ClientStateMachine() = default;
@@ -33,7 +33,7 @@ class ClientStateMachine {
       folly::Optional<CachedPsk> cachedPsk,
       const std::shared_ptr<ClientExtensions>& extensions);
 
-  virtual Actions processSocketData(const State&, folly::IOBufQueue&);
+  virtual AsyncActions processSocketData(const State&, folly::IOBufQueue&);
 
   virtual Actions processWriteNewSessionTicket(
       const State&,
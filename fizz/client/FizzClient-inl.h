@@ -37,6 +37,34 @@ void FizzClient<ActionMoveVisitor, SM>::connect(
       std::move(pskIdentity));
 }
 
+template <typename ActionMoveVisitor, typename SM>
+void FizzClient<ActionMoveVisitor, SM>::prepareConnect(
+    std::shared_ptr<const FizzClientContext> context,
+    std::shared_ptr<const CertificateVerifier> verifier,
+    folly::Optional<std::string> sni,
+    folly::Optional<CachedPsk> cachedPsk,
+    const std::shared_ptr<ClientExtensions>& extensions) {
+  // Connect only reads the (still uninitialized) state, the actions it
+  // returns are not applied until connectPrepared().
+  preparedConnect_ = this->machine_.processConnect(
+      this->state_,
+      std::move(context),
+      std::move(verifier),
+      std::move(sni),
+      std::move(cachedPsk),
+      extensions);
+}
+
+template <typename ActionMoveVisitor, typename SM>
+void FizzClient<ActionMoveVisitor, SM>::connectPrepared() {
+  if (!preparedConnect_) {
+    throw std::runtime_error("no prepared connect");
+  }
+  auto actions = std::move(*preparedConnect_);
+  preparedConnect_.clear();
+  this->addProcessingActions(std::move(actions));
+}
+
 template <typename ActionMoveVisitor, typename SM>
 Buf FizzClient<ActionMoveVisitor, SM>::getEarlyEkm(
     folly::StringPiece label,
@@ -46,6 +74,7 @@ Buf FizzClient<ActionMoveVisitor, SM>::getEarlyEkm(
     throw std::runtime_error("early ekm not available");
   }
   return Exporter::getEkm(
+      *this->state_.context()->getFactory(),
       this->state_.earlyDataParams()->cipher,
       this->state_.earlyDataParams()->earlyExporterSecret->coalesce(),
       label,
@@ -54,8 +83,21 @@ Buf FizzClient<ActionMoveVisitor, SM>::getEarlyEkm(
 }
 
 template <typename ActionMoveVisitor, typename SM>
-void FizzClient<ActionMoveVisitor, SM>::startActions(Actions actions) {
-  this->processActions(std::move(actions));
+void FizzClient<ActionMoveVisitor, SM>::startActions(AsyncActions actions) {
+  folly::variant_match(
+      actions,
+      [this](folly::Future<Actions>& futureActions) {
+        std::move(futureActions)
+            .then(
+                &FizzClient::processActions,
+                static_cast<FizzBase<
+                    FizzClient<ActionMoveVisitor, SM>,
+                    ActionMoveVisitor,
+                    SM>*>(this));
+      },
+      [this](Actions& immediateActions) {
+        this->processActions(std::move(immediateActions));
+      });
 }
 } // namespace client
 } // namespace fizz
@@ -40,6 +40,27 @@ class FizzClient : public FizzBase<
       std::shared_ptr<const FizzClientContext> context,
       folly::Optional<std::string> hostname);
 
+  /**
+   * Builds the first flight of a connect() (key shares, client random and
+   * PSK binders) without sending it, so the work can overlap with opening the
+   * transport. connectPrepared() then sends it without rebuilding anything.
+   */
+  void prepareConnect(
+      std::shared_ptr<const FizzClientContext> context,
+      std::shared_ptr<const CertificateVerifier> verifier,
+      folly::Optional<std::string> sni,
+      folly::Optional<CachedPsk> cachedPsk,
+      const std::shared_ptr<ClientExtensions>& extensions = nullptr);
+
+  bool hasPreparedConnect() const {
+    return preparedConnect_.hasValue();
+  }
+
+  /**
+   * Sends the flight built by prepareConnect().
+   */
+  void connectPrepared();
+
   /**
    * Returns an exported key material derived from the early secret of the TLS
    * connection. Throws if the early secret is not available.
@@ -53,7 +74,9 @@ class FizzClient : public FizzBase<
       ActionMoveVisitor,
       SM>;
 
-  void startActions(Actions actions);
+  void startActions(AsyncActions actions);
+
+  folly::Optional<Actions> preparedConnect_;
 };
 } // namespace client
 } // namespace fizz
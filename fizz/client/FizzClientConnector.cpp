@@ -0,0 +1,257 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/client/FizzClientConnector.h>
+
+namespace fizz {
+namespace client {
+
+class FizzClientConnector::Attempt
+    : public folly::AsyncSocket::ConnectCallback {
+ public:
+  Attempt(
+      FizzClientConnector& connector,
+      Request request,
+      AsyncFizzClient::UniquePtr client)
+      : connector_(connector),
+        request(std::move(request)),
+        client(std::move(client)),
+        start(std::chrono::steady_clock::now()) {}
+
+  void connectSuccess() noexcept override {
+    connector_.attemptSuccess(this);
+  }
+
+  void connectErr(const folly::AsyncSocketException& ex) noexcept override {
+    connector_.attemptError(this, ex);
+  }
+
+ private:
+  FizzClientConnector& connector_;
+
+ public:
+  Request request;
+  AsyncFizzClient::UniquePtr client;
+  std::chrono::steady_clock::time_point start;
+};
+
+class FizzClientConnector::Waiter : public folly::AsyncTimeout {
+ public:
+  Waiter(FizzClientConnector& connector, Request request)
+      : folly::AsyncTimeout(connector.evb_),
+        connector_(connector),
+        request(std::move(request)) {}
+
+  void timeoutExpired() noexcept override {
+    connector_.waiterTimeout(this);
+  }
+
+ private:
+  FizzClientConnector& connector_;
+
+ public:
+  Request request;
+};
+
+FizzClientConnector::FizzClientConnector(
+    folly::EventBase* evb,
+    std::shared_ptr<FizzClientContext> context,
+    std::shared_ptr<const CertificateVerifier> verifier)
+    : evb_(evb),
+      context_(std::move(context)),
+      verifier_(std::move(verifier)),
+      self_(std::make_shared<FizzClientConnector*>(this)) {}
+
+FizzClientConnector::~FizzClientConnector() {
+  destroying_ = true;
+  self_.reset();
+
+  folly::AsyncSocketException ex(
+      folly::AsyncSocketException::NOT_OPEN, "connector destroyed");
+  auto attempts = std::move(attempts_);
+  for (auto& attempt : attempts) {
+    attempt.second->client->closeNow();
+    // closeNow() normally reports the error through attemptError().
+    if (attempt.second->request.callback) {
+      attempt.second->request.callback->fizzConnectError(ex);
+    }
+  }
+  auto origins = std::move(origins_);
+  for (auto& origin : origins) {
+    for (auto& waiter : origin.second.waiters) {
+      waiter->request.callback->fizzConnectError(ex);
+    }
+  }
+}
+
+void FizzClientConnector::connect(
+    const folly::SocketAddress& address,
+    const std::string& hostname,
+    Callback* callback,
+    std::chrono::milliseconds timeout) {
+  Request request{address, hostname, callback, timeout};
+  auto& origin = origins_[hostname];
+  // Without a cache there are no tickets to wait for.
+  if (context_->getPskCache() && !origin.ticketsReceived &&
+      origin.inFlight > 0 &&
+      resumptionWait_ > std::chrono::milliseconds::zero()) {
+    origin.stats.deferred++;
+    auto waiter = std::make_unique<Waiter>(*this, std::move(request));
+    waiter->scheduleTimeout(resumptionWait_);
+    origin.waiters.push_back(std::move(waiter));
+    return;
+  }
+  startAttempt(std::move(request));
+}
+
+folly::Optional<FizzClientConnector::OriginStats>
+FizzClientConnector::getOriginStats(const std::string& hostname) const {
+  auto it = origins_.find(hostname);
+  if (it == origins_.end()) {
+    return folly::none;
+  }
+  return it->second.stats;
+}
+
+size_t FizzClientConnector::getNumPendingConnects() const {
+  size_t pending = attempts_.size();
+  for (const auto& origin : origins_) {
+    pending += origin.second.waiters.size();
+  }
+  return pending;
+}
+
+AsyncFizzClient::UniquePtr FizzClientConnector::makeClient() {
+  return AsyncFizzClient::UniquePtr(new AsyncFizzClient(evb_, context_));
+}
+
+void FizzClientConnector::startAttempt(Request request) {
+  origins_[request.hostname].inFlight++;
+  auto attempt =
+      std::make_unique<Attempt>(*this, std::move(request), makeClient());
+  auto attemptPtr = attempt.get();
+  attempts_.emplace(attemptPtr, std::move(attempt));
+  // Tickets usually arrive after the client was handed to the callback.
+  std::weak_ptr<FizzClientConnector*> self = self_;
+  attemptPtr->client->setNewTicketCallback(
+      [self](const std::string& identity) {
+        auto connector = self.lock();
+        if (connector) {
+          (*connector)->ticketReceived(identity);
+        }
+      });
+  attemptPtr->client->connect(
+      attemptPtr->request.address,
+      attemptPtr,
+      verifier_,
+      attemptPtr->request.hostname,
+      attemptPtr->request.hostname,
+      attemptPtr->request.timeout);
+}
+
+void FizzClientConnector::attemptSuccess(Attempt* attempt) {
+  auto it = attempts_.find(attempt);
+  if (it == attempts_.end()) {
+    return;
+  }
+  auto owned = std::move(it->second);
+  attempts_.erase(it);
+
+  auto& origin = origins_[attempt->request.hostname];
+  origin.inFlight--;
+
+  const auto& state = attempt->client->getState();
+  auto& stats = origin.stats;
+  stats.connects++;
+  if (state.pskMode()) {
+    stats.resumed++;
+    // The origin gave us a ticket at some point, so it is worth waiting for
+    // the next one.
+    origin.ticketsReceived = true;
+  }
+  if (state.earlyDataType() == EarlyDataType::Attempted) {
+    stats.earlyDataAttempted++;
+  }
+  auto sample = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - attempt->start);
+  if (stats.connectTime) {
+    stats.connectTime = (*stats.connectTime * 7 + sample) / 8;
+  } else {
+    stats.connectTime = sample;
+  }
+  stats.version = state.version();
+  stats.cipher = state.cipher();
+  stats.group = state.group();
+  stats.alpn = state.alpn();
+
+  auto callback = attempt->request.callback;
+  attempt->request.callback = nullptr;
+  callback->fizzConnectSuccess(std::move(attempt->client));
+}
+
+void FizzClientConnector::attemptError(
+    Attempt* attempt,
+    const folly::AsyncSocketException& ex) {
+  auto callback = attempt->request.callback;
+  attempt->request.callback = nullptr;
+  if (destroying_) {
+    if (callback) {
+      callback->fizzConnectError(ex);
+    }
+    return;
+  }
+
+  auto it = attempts_.find(attempt);
+  if (it == attempts_.end()) {
+    return;
+  }
+  // The client may still be unwinding, let it go once this returns.
+  auto owned = std::move(it->second);
+  attempts_.erase(it);
+
+  auto& origin = origins_[attempt->request.hostname];
+  origin.inFlight--;
+  origin.stats.failures++;
+  // Nothing left in flight will bring tickets for the waiters.
+  if (origin.inFlight == 0) {
+    releaseWaiters(origin);
+  }
+  callback->fizzConnectError(ex);
+}
+
+void FizzClientConnector::waiterTimeout(Waiter* waiter) {
+  auto& origin = origins_[waiter->request.hostname];
+  for (auto it = origin.waiters.begin(); it != origin.waiters.end(); ++it) {
+    if (it->get() == waiter) {
+      auto request = std::move((*it)->request);
+      origin.waiters.erase(it);
+      startAttempt(std::move(request));
+      return;
+    }
+  }
+}
+
+void FizzClientConnector::ticketReceived(const std::string& hostname) {
+  auto it = origins_.find(hostname);
+  if (it == origins_.end()) {
+    return;
+  }
+  it->second.ticketsReceived = true;
+  releaseWaiters(it->second);
+}
+
+void FizzClientConnector::releaseWaiters(Origin& origin) {
+  auto waiters = std::move(origin.waiters);
+  origin.waiters.clear();
+  for (auto& waiter : waiters) {
+    waiter->cancelTimeout();
+    startAttempt(std::move(waiter->request));
+  }
+}
+} // namespace client
+} // namespace fizz
@@ -0,0 +1,146 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/client/AsyncFizzClient.h>
+#include <folly/io/async/AsyncTimeout.h>
+
+#include <chrono>
+#include <list>
+#include <unordered_map>
+
+namespace fizz {
+namespace client {
+
+/**
+ * Opens AsyncFizzClient connections to origins on one EventBase, scheduling
+ * the attempts so that as many of them as possible resume a session.
+ *
+ * The connector watches the tickets its connections store in the context's
+ * PskCache, leaving the context itself alone. A connect to an origin that has
+ * not handed out a ticket yet, made while another connect to it is in
+ * flight, waits for that connection's tickets instead of running a second
+ * full handshake. Like happy eyeballs, the wait is bounded by
+ * setResumptionWait(): once it expires the connect starts its own handshake,
+ * so a slow first handshake does not serialize the others.
+ *
+ * The connector also keeps per origin statistics about the connections it
+ * made. It must only be used from the EventBase thread and must not be
+ * destroyed from one of its callbacks.
+ */
+class FizzClientConnector {
+ public:
+  class Callback {
+   public:
+    virtual ~Callback() = default;
+
+    /**
+     * The connection is ready for writes. With early data this is before
+     * the handshake completes.
+     */
+    virtual void fizzConnectSuccess(
+        AsyncFizzClient::UniquePtr client) noexcept = 0;
+
+    virtual void fizzConnectError(
+        const folly::AsyncSocketException& ex) noexcept = 0;
+  };
+
+  struct OriginStats {
+    size_t connects{0};
+    size_t resumed{0};
+    size_t earlyDataAttempted{0};
+    size_t failures{0};
+    size_t deferred{0};
+
+    /**
+     * Smoothed time from starting a connection to it being ready for writes
+     * (TCP and TLS handshakes), weighted like TCP's smoothed RTT.
+     */
+    folly::Optional<std::chrono::microseconds> connectTime;
+
+    folly::Optional<ProtocolVersion> version;
+    folly::Optional<CipherSuite> cipher;
+    folly::Optional<NamedGroup> group;
+    folly::Optional<std::string> alpn;
+  };
+
+  FizzClientConnector(
+      folly::EventBase* evb,
+      std::shared_ptr<FizzClientContext> context,
+      std::shared_ptr<const CertificateVerifier> verifier);
+
+  virtual ~FizzClientConnector();
+
+  /**
+   * How long a connect waits for tickets from an in flight connection to the
+   * same origin before starting a full handshake. Zero disables waiting.
+   */
+  void setResumptionWait(std::chrono::milliseconds wait) {
+    resumptionWait_ = wait;
+  }
+
+  /**
+   * Connects to hostname at address. hostname is used as the SNI and the PSK
+   * identity. timeout bounds the connection once it is started.
+   */
+  void connect(
+      const folly::SocketAddress& address,
+      const std::string& hostname,
+      Callback* callback,
+      std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+  folly::Optional<OriginStats> getOriginStats(
+      const std::string& hostname) const;
+
+  /**
+   * Number of connects that have not completed yet, including those waiting
+   * for tickets.
+   */
+  size_t getNumPendingConnects() const;
+
+ protected:
+  virtual AsyncFizzClient::UniquePtr makeClient();
+
+ private:
+  struct Request {
+    folly::SocketAddress address;
+    std::string hostname;
+    Callback* callback;
+    std::chrono::milliseconds timeout;
+  };
+
+  class Attempt;
+  class Waiter;
+
+  struct Origin {
+    OriginStats stats;
+    bool ticketsReceived{false};
+    size_t inFlight{0};
+    std::list<std::unique_ptr<Waiter>> waiters;
+  };
+
+  void startAttempt(Request request);
+  void attemptSuccess(Attempt* attempt);
+  void attemptError(Attempt* attempt, const folly::AsyncSocketException& ex);
+  void waiterTimeout(Waiter* waiter);
+  void ticketReceived(const std::string& hostname);
+  void releaseWaiters(Origin& origin);
+
+  folly::EventBase* evb_;
+  std::shared_ptr<FizzClientContext> context_;
+  std::shared_ptr<const CertificateVerifier> verifier_;
+  // Lets connections that outlive the connector find out it is gone.
+  std::shared_ptr<FizzClientConnector*> self_;
+  std::chrono::milliseconds resumptionWait_{100};
+  std::unordered_map<std::string, Origin> origins_;
+  std::unordered_map<Attempt*, std::unique_ptr<Attempt>> attempts_;
+  bool destroying_{false};
+};
+} // namespace client
+} // namespace fizz
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/client/FizzClientContext.h>
+
+namespace fizz {
+namespace client {
+
+void FizzClientContext::updateClientHelloExtensions() {
+  auto extensions = std::make_shared<ClientHelloExtensions>();
+
+  SupportedVersions versions;
+  versions.versions = supportedVersions_;
+  extensions->beforeKeyShare.push_back(encodeExtension(std::move(versions)));
+
+  SupportedGroups groups;
+  groups.named_group_list = supportedGroups_;
+  extensions->beforeKeyShare.push_back(encodeExtension(std::move(groups)));
+
+  SignatureAlgorithms sigAlgs;
+  sigAlgs.supported_signature_algorithms = supportedSigSchemes_;
+  extensions->beforeServerName.push_back(encodeExtension(std::move(sigAlgs)));
+
+  if (!supportedAlpns_.empty()) {
+    ProtocolNameList alpn;
+    for (const auto& protoName : supportedAlpns_) {
+      ProtocolName proto;
+      proto.name = folly::IOBuf::copyBuffer(protoName);
+      alpn.protocol_name_list.push_back(std::move(proto));
+    }
+    extensions->afterServerName.push_back(encodeExtension(std::move(alpn)));
+  }
+
+  if (!supportedPskModes_.empty()) {
+    PskKeyExchangeModes modes;
+    modes.modes = supportedPskModes_;
+    extensions->afterServerName.push_back(encodeExtension(std::move(modes)));
+  }
+
+  if (!supportedCertCompressionAlgos_.empty()) {
+    CertificateCompressionAlgorithms algos;
+    algos.algorithms = supportedCertCompressionAlgos_;
+    extensions->afterServerName.push_back(encodeExtension(std::move(algos)));
+  }
+
+  if (!serverCertTypes_.empty()) {
+    ServerCertTypeList certTypes;
+    certTypes.certificate_types = serverCertTypes_;
+    extensions->afterServerName.push_back(
+        encodeExtension(std::move(certTypes)));
+  }
+
+  if (!delegatedCredentialSchemes_.empty()) {
+    DelegatedCredentialSupport credentialSupport;
+    credentialSupport.supported_signature_algorithms =
+        delegatedCredentialSchemes_;
+    extensions->afterServerName.push_back(
+        encodeExtension(std::move(credentialSupport)));
+  }
+
+  chloExtensions_ = std::move(extensions);
+}
+} // namespace client
+} // namespace fizz
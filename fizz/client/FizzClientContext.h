@@ -10,7 +10,12 @@
 
 #include <fizz/client/PskCache.h>
 #include <fizz/protocol/Certificate.h>
+#include <fizz/protocol/CertificateCompressor.h>
 #include <fizz/protocol/Factory.h>
+#include <fizz/protocol/HandshakeTracer.h>
+#include <fizz/protocol/LazyPeerCert.h>
+#include <fizz/record/EncryptedRecordLayer.h>
+#include <fizz/record/Extensions.h>
 #include <fizz/record/Types.h>
 
 namespace fizz {
@@ -18,14 +23,46 @@ namespace client {
 
 class FizzClientContext {
  public:
-  FizzClientContext() : factory_(std::make_unique<Factory>()) {}
+  FizzClientContext() : factory_(std::make_shared<Factory>()) {
+    updateClientHelloExtensions();
+  }
   virtual ~FizzClientContext() = default;
 
+  /**
+   * Copies the configuration. Components held by pointer (the factory, PSK
+   * cache, encoded ClientHello extensions, ...) are shared with the copy
+   * rather than duplicated, so per thread contexts can be made from one
+   * configured context and only differ where they are changed afterwards.
+   */
+  FizzClientContext(const FizzClientContext&) = default;
+  FizzClientContext& operator=(const FizzClientContext&) = delete;
+
+  /**
+   * ClientHello extensions that only depend on this context, encoded whenever
+   * the settings they are built from change rather than on every connect.
+   * They are grouped by where they go relative to the key_share and
+   * server_name extensions, which differ between connections.
+   */
+  struct ClientHelloExtensions {
+    // supported_versions and supported_groups.
+    std::vector<Extension> beforeKeyShare;
+    // signature_algorithms.
+    std::vector<Extension> beforeServerName;
+    // ALPN, psk_key_exchange_modes, compress_certificate,
+    // server_certificate_type and delegated_credential, if configured.
+    std::vector<Extension> afterServerName;
+  };
+
+  const ClientHelloExtensions& getClientHelloExtensions() const {
+    return *chloExtensions_;
+  }
+
   /**
    * Set the supported protocol versions, in preference order.
    */
   void setSupportedVersions(std::vector<ProtocolVersion> versions) {
     supportedVersions_ = std::move(versions);
+    updateClientHelloExtensions();
   }
 
   const auto& getSupportedVersions() const {
@@ -48,6 +85,7 @@ class FizzClientContext {
    */
   void setSupportedSigSchemes(std::vector<SignatureScheme> schemes) {
     supportedSigSchemes_ = std::move(schemes);
+    updateClientHelloExtensions();
   }
 
   const auto& getSupportedSigSchemes() const {
@@ -59,6 +97,7 @@ class FizzClientContext {
    */
   void setSupportedGroups(std::vector<NamedGroup> groups) {
     supportedGroups_ = std::move(groups);
+    updateClientHelloExtensions();
   }
 
   const auto& getSupportedGroups() const {
@@ -75,11 +114,27 @@ class FizzClientContext {
     return defaultShares_;
   }
 
+  /**
+   * If set, only a key share for the first of the default shares is generated
+   * and sent, rather than one for each. If the server wants one of the other
+   * groups it asks for it with a HelloRetryRequest, and the group it picked is
+   * remembered for the server identity (see getKeyShareGroup()), so later
+   * connections send it right away.
+   */
+  void setLazyDefaultShares(bool lazyDefaultShares) {
+    lazyDefaultShares_ = lazyDefaultShares;
+  }
+
+  bool getLazyDefaultShares() const {
+    return lazyDefaultShares_;
+  }
+
   /**
    * Set the supported psk modes, in preference order.
    */
   void setSupportedPskModes(std::vector<PskKeyExchangeMode> modes) {
     supportedPskModes_ = std::move(modes);
+    updateClientHelloExtensions();
   }
 
   const auto& getSupportedPskModes() const {
@@ -91,6 +146,7 @@ class FizzClientContext {
    */
   void setSupportedAlpns(std::vector<std::string> protocols) {
     supportedAlpns_ = std::move(protocols);
+    updateClientHelloExtensions();
   }
 
   const auto& getSupportedAlpns() const {
@@ -108,6 +164,67 @@ class FizzClientContext {
     return clientCert_;
   }
 
+  /**
+   * Sets the decompressors for the certificate compression algorithms to
+   * offer, in preference order. Certificate compression is not offered if
+   * empty.
+   */
+  void setCertDecompressors(
+      std::vector<std::shared_ptr<CertificateDecompressor>> decompressors) {
+    certDecompressors_ = std::move(decompressors);
+    supportedCertCompressionAlgos_.clear();
+    for (const auto& decompressor : certDecompressors_) {
+      supportedCertCompressionAlgos_.push_back(decompressor->getAlgorithm());
+    }
+    updateClientHelloExtensions();
+  }
+
+  const auto& getSupportedCertCompressionAlgorithms() const {
+    return supportedCertCompressionAlgos_;
+  }
+
+  /**
+   * Returns the decompressor for algorithm, or nullptr if it is not offered.
+   */
+  std::shared_ptr<CertificateDecompressor> getCertDecompressor(
+      CertificateCompressionAlgorithm algorithm) const {
+    for (const auto& decompressor : certDecompressors_) {
+      if (decompressor->getAlgorithm() == algorithm) {
+        return decompressor;
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * Sets the server certificate types (RFC 7250) to offer, in preference
+   * order. The server_certificate_type extension is not sent if empty, in
+   * which case the server must present an X509 certificate.
+   */
+  void setServerCertTypes(std::vector<CertificateType> types) {
+    serverCertTypes_ = std::move(types);
+    updateClientHelloExtensions();
+  }
+
+  const auto& getServerCertTypes() const {
+    return serverCertTypes_;
+  }
+
+  /**
+   * Sets the signature schemes to accept in a CertificateVerify made with a
+   * delegated credential, in preference order. Delegated credentials are not
+   * offered if empty.
+   */
+  void setSupportedDelegatedCredentialSchemes(
+      std::vector<SignatureScheme> schemes) {
+    delegatedCredentialSchemes_ = std::move(schemes);
+    updateClientHelloExtensions();
+  }
+
+  const auto& getSupportedDelegatedCredentialSchemes() const {
+    return delegatedCredentialSchemes_;
+  }
+
   /**
    * Set the Psk Cache to use.
    */
@@ -115,6 +232,33 @@ class FizzClientContext {
     pskCache_ = std::move(pskCache);
   }
 
+  const std::shared_ptr<PskCache>& getPskCache() const {
+    return pskCache_;
+  }
+
+  /**
+   * Sets how long AsyncFizzClient waits for a PSK from the cache's
+   * getPskFuture() before connecting without one.
+   */
+  void setPskLookupTimeout(std::chrono::milliseconds timeout) {
+    pskLookupTimeout_ = timeout;
+  }
+
+  std::chrono::milliseconds getPskLookupTimeout() const {
+    return pskLookupTimeout_;
+  }
+
+  /**
+   * Sets the tracer that receives timestamped state transitions and
+   * asynchronous step events of handshakes using this context.
+   */
+  void setHandshakeTracer(std::shared_ptr<HandshakeTracer> tracer) {
+    handshakeTracer_ = std::move(tracer);
+  }
+  const std::shared_ptr<HandshakeTracer>& getHandshakeTracer() const {
+    return handshakeTracer_;
+  }
+
   folly::Optional<CachedPsk> getPsk(const std::string& identity) const {
     if (pskCache_) {
       return pskCache_->getPsk(identity);
@@ -135,6 +279,21 @@ class FizzClientContext {
     }
   }
 
+  folly::Optional<NamedGroup> getKeyShareGroup(
+      const std::string& identity) const {
+    if (pskCache_) {
+      return pskCache_->getKeyShareGroup(identity);
+    } else {
+      return folly::none;
+    }
+  }
+
+  void putKeyShareGroup(const std::string& identity, NamedGroup group) const {
+    if (pskCache_) {
+      pskCache_->putKeyShareGroup(identity, group);
+    }
+  }
+
   /**
    * Sets whether we should attempt to send early data.
    */
@@ -170,10 +329,60 @@ class FizzClientContext {
     return useAlternateSniCodePoint_;
   }
 
+  /**
+   * Sets whether to decrypt all complete application data records available
+   * on the socket in one pass and deliver them to the app together, instead
+   * of delivering (and dispatching actions for) one record at a time.
+   */
+  void setCoalesceAppData(bool enabled) {
+    coalesceAppData_ = enabled;
+  }
+
+  bool getCoalesceAppData() const {
+    return coalesceAppData_;
+  }
+
+  /**
+   * Sets options for encrypting large application data writes on a thread
+   * pool. Disabled unless an executor is set.
+   */
+  void setParallelEncryption(ParallelEncryptionOptions options) {
+    parallelEncryption_ = std::move(options);
+  }
+
+  const ParallelEncryptionOptions& getParallelEncryption() const {
+    return parallelEncryption_;
+  }
+
+  /**
+   * Sets options for decrypting large amounts of buffered application data
+   * records on a thread pool. Disabled unless an executor is set.
+   */
+  void setParallelDecryption(ParallelDecryptionOptions options) {
+    parallelDecryption_ = std::move(options);
+  }
+
+  const ParallelDecryptionOptions& getParallelDecryption() const {
+    return parallelDecryption_;
+  }
+
+  /**
+   * Sets how much of the server's leaf certificate connections keep after
+   * verifying it. Encoded and IdentityOnly free the parsed certificate for
+   * apps that only look at the peer identity. Default is Parsed.
+   */
+  void setPeerCertRetention(PeerCertRetention retention) {
+    peerCertRetention_ = retention;
+  }
+
+  PeerCertRetention getPeerCertRetention() const {
+    return peerCertRetention_;
+  }
+
   /**
    * Set the factory to use. Should generally only be changed for testing.
    */
-  void setFactory(std::unique_ptr<Factory> factory) {
+  void setFactory(std::shared_ptr<Factory> factory) {
     factory_ = std::move(factory);
   }
 
@@ -181,8 +390,18 @@ class FizzClientContext {
     return factory_.get();
   }
 
+  /**
+   * Shared ownership of the factory, for objects that may outlive this
+   * context or a later setFactory().
+   */
+  std::shared_ptr<const Factory> getFactoryPtr() const {
+    return factory_;
+  }
+
  private:
-  std::unique_ptr<Factory> factory_;
+  void updateClientHelloExtensions();
+
+  std::shared_ptr<Factory> factory_;
 
   std::vector<ProtocolVersion> supportedVersions_ = {
       ProtocolVersion::tls_1_3_26};
@@ -199,6 +418,7 @@ class FizzClientContext {
   std::vector<NamedGroup> supportedGroups_ = {NamedGroup::x25519,
                                               NamedGroup::secp256r1};
   std::vector<NamedGroup> defaultShares_ = {NamedGroup::x25519};
+  bool lazyDefaultShares_{false};
   std::vector<PskKeyExchangeMode> supportedPskModes_ = {
       PskKeyExchangeMode::psk_dhe_ke,
       PskKeyExchangeMode::psk_ke};
@@ -208,9 +428,26 @@ class FizzClientContext {
   bool compatMode_{false};
 
   std::shared_ptr<PskCache> pskCache_;
+  std::chrono::milliseconds pskLookupTimeout_{std::chrono::milliseconds(50)};
+  std::shared_ptr<HandshakeTracer> handshakeTracer_;
   std::shared_ptr<const SelfCert> clientCert_;
 
+  std::vector<std::shared_ptr<CertificateDecompressor>> certDecompressors_;
+  std::vector<CertificateCompressionAlgorithm> supportedCertCompressionAlgos_;
+  std::vector<CertificateType> serverCertTypes_;
+  std::vector<SignatureScheme> delegatedCredentialSchemes_;
+
   bool useAlternateSniCodePoint_{false};
+
+  bool coalesceAppData_{false};
+
+  ParallelEncryptionOptions parallelEncryption_;
+  ParallelDecryptionOptions parallelDecryption_;
+
+  PeerCertRetention peerCertRetention_{PeerCertRetention::Parsed};
+
+  // Replaced rather than modified, as copies of this context share it.
+  std::shared_ptr<const ClientHelloExtensions> chloExtensions_;
 };
 } // namespace client
 } // namespace fizz
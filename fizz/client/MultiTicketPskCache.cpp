@@ -0,0 +1,97 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/client/MultiTicketPskCache.h>
+
+namespace fizz {
+namespace client {
+
+MultiTicketPskCache::MultiTicketPskCache(
+    uint64_t mapMax,
+    size_t ticketsPerIdentity)
+    : ticketsPerIdentity_(ticketsPerIdentity),
+      cache_(EvictingPskMap(mapMax)),
+      groups_(EvictingGroupMap(mapMax)) {
+  if (ticketsPerIdentity_ == 0) {
+    throw std::runtime_error("must store at least one ticket per identity");
+  }
+}
+
+folly::Optional<CachedPsk> MultiTicketPskCache::getPsk(
+    const std::string& identity) {
+  auto now = std::chrono::system_clock::now();
+  auto cacheMap = cache_.wlock();
+  auto result = cacheMap->find(identity);
+  if (result == cacheMap->end()) {
+    return folly::none;
+  }
+  auto& psks = result->second;
+  folly::Optional<CachedPsk> psk;
+  while (!psks.empty() && !psk) {
+    if (psks.front().ticketExpirationTime > now) {
+      psk = std::move(psks.front());
+    }
+    psks.pop_front();
+  }
+  if (psks.empty()) {
+    cacheMap->erase(identity);
+  }
+  return psk;
+}
+
+void MultiTicketPskCache::putPsk(const std::string& identity, CachedPsk psk) {
+  auto cacheMap = cache_.wlock();
+  auto result = cacheMap->find(identity);
+  if (result == cacheMap->end()) {
+    std::deque<CachedPsk> psks;
+    psks.push_back(std::move(psk));
+    cacheMap->set(identity, std::move(psks));
+  } else {
+    auto& psks = result->second;
+    psks.push_back(std::move(psk));
+    while (psks.size() > ticketsPerIdentity_) {
+      psks.pop_front();
+    }
+  }
+}
+
+void MultiTicketPskCache::removePsk(const std::string& identity) {
+  auto cacheMap = cache_.wlock();
+  cacheMap->erase(identity);
+}
+
+folly::Optional<NamedGroup> MultiTicketPskCache::getKeyShareGroup(
+    const std::string& identity) {
+  auto groupMap = groups_.wlock();
+  auto result = groupMap->find(identity);
+  if (result != groupMap->end()) {
+    return result->second;
+  } else {
+    return folly::none;
+  }
+}
+
+void MultiTicketPskCache::putKeyShareGroup(
+    const std::string& identity,
+    NamedGroup group) {
+  auto groupMap = groups_.wlock();
+  groupMap->set(identity, group);
+}
+
+size_t MultiTicketPskCache::getNumPsks(const std::string& identity) {
+  auto cacheMap = cache_.wlock();
+  auto result = cacheMap->find(identity);
+  if (result != cacheMap->end()) {
+    return result->second.size();
+  } else {
+    return 0;
+  }
+}
+
+} // namespace client
+} // namespace fizz
@@ -0,0 +1,66 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/client/PskCache.h>
+#include <folly/Synchronized.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <deque>
+
+namespace fizz {
+namespace client {
+
+/**
+ * PSK cache that keeps up to ticketsPerIdentity PSKs for each identity and
+ * treats them as single use: getPsk() removes the PSK it returns, so
+ * concurrent connections to the same origin each resume with a distinct
+ * ticket. This pairs with servers that issue several NewSessionTickets per
+ * connection (see FizzServerContext::setNumNewSessionTickets()).
+ *
+ * PSKs are handed out oldest first, skipping any that have expired. When an
+ * identity already holds ticketsPerIdentity PSKs the oldest one is dropped.
+ * At most mapMax identities are stored, evicted in LRU order.
+ */
+class MultiTicketPskCache : public PskCache {
+ public:
+  using EvictingPskMap =
+      folly::EvictingCacheMap<std::string, std::deque<CachedPsk>>;
+  using EvictingGroupMap = folly::EvictingCacheMap<std::string, NamedGroup>;
+  ~MultiTicketPskCache() override = default;
+  MultiTicketPskCache(uint64_t mapMax, size_t ticketsPerIdentity);
+
+  folly::Optional<CachedPsk> getPsk(const std::string& identity) override;
+
+  void putPsk(const std::string& identity, CachedPsk psk) override;
+
+  /**
+   * Removes all PSKs stored for identity.
+   */
+  void removePsk(const std::string& identity) override;
+
+  folly::Optional<NamedGroup> getKeyShareGroup(
+      const std::string& identity) override;
+
+  void putKeyShareGroup(const std::string& identity, NamedGroup group)
+      override;
+
+  /**
+   * Number of unused PSKs currently stored for identity.
+   */
+  size_t getNumPsks(const std::string& identity);
+
+ private:
+  size_t ticketsPerIdentity_;
+  folly::Synchronized<EvictingPskMap> cache_;
+  folly::Synchronized<EvictingGroupMap> groups_;
+};
+
+} // namespace client
+} // namespace fizz
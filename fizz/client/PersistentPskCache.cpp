@@ -0,0 +1,307 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/client/PersistentPskCache.h>
+
+#include <folly/Exception.h>
+#include <folly/FileUtil.h>
+#include <folly/hash/Checksum.h>
+#include <folly/io/Cursor.h>
+#include <folly/system/MemoryMapping.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace fizz {
+namespace client {
+
+namespace {
+enum class RecordType : uint8_t { Put = 1, Remove = 2 };
+
+constexpr size_t kRecordHeaderSize = 2 * sizeof(uint32_t);
+
+uint64_t toMillis(std::chrono::system_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+std::chrono::system_clock::time_point fromMillis(uint64_t millis) {
+  return std::chrono::system_clock::time_point(
+      std::chrono::milliseconds(millis));
+}
+
+void writeString(const std::string& str, folly::io::Appender& appender) {
+  fizz::detail::writeBuf<uint16_t>(folly::IOBuf::copyBuffer(str), appender);
+}
+
+std::string readString(folly::io::Cursor& cursor) {
+  Buf buf;
+  fizz::detail::readBuf<uint16_t>(buf, cursor);
+  return buf->moveToFbString().toStdString();
+}
+
+void writeCertIdentity(
+    const std::shared_ptr<const Cert>& cert,
+    folly::io::Appender& appender) {
+  writeString(cert ? cert->getIdentity() : std::string(), appender);
+}
+
+std::shared_ptr<const Cert> readCertIdentity(folly::io::Cursor& cursor) {
+  auto identity = readString(cursor);
+  if (identity.empty()) {
+    return nullptr;
+  }
+  return std::make_shared<IdentityCert>(std::move(identity));
+}
+
+Buf encodeRecord(
+    RecordType type,
+    const std::string& identity,
+    const CachedPsk* psk) {
+  auto payload = folly::IOBuf::create(256);
+  folly::io::Appender appender(payload.get(), 256);
+  fizz::detail::write(type, appender);
+  writeString(identity, appender);
+  if (psk) {
+    writeString(psk->psk, appender);
+    writeString(psk->secret, appender);
+    fizz::detail::write(static_cast<uint8_t>(psk->type), appender);
+    fizz::detail::write(psk->version, appender);
+    fizz::detail::write(psk->cipher, appender);
+    fizz::detail::write(static_cast<uint8_t>(psk->group ? 1 : 0), appender);
+    fizz::detail::write(
+        psk->group ? *psk->group : static_cast<NamedGroup>(0), appender);
+    writeCertIdentity(psk->serverCert, appender);
+    writeCertIdentity(psk->clientCert, appender);
+    fizz::detail::write(psk->maxEarlyDataSize, appender);
+    fizz::detail::write(static_cast<uint8_t>(psk->alpn ? 1 : 0), appender);
+    writeString(psk->alpn ? *psk->alpn : std::string(), appender);
+    fizz::detail::write(psk->ticketAgeAdd, appender);
+    fizz::detail::write(toMillis(psk->ticketIssueTime), appender);
+    fizz::detail::write(toMillis(psk->ticketExpirationTime), appender);
+  }
+
+  auto range = payload->coalesce();
+  auto record = folly::IOBuf::create(kRecordHeaderSize);
+  folly::io::Appender header(record.get(), kRecordHeaderSize);
+  fizz::detail::write(static_cast<uint32_t>(range.size()), header);
+  fizz::detail::write(folly::crc32c(range.data(), range.size()), header);
+  record->prependChain(std::move(payload));
+  return record;
+}
+
+CachedPsk decodePsk(folly::io::Cursor& cursor) {
+  CachedPsk psk;
+  psk.psk = readString(cursor);
+  psk.secret = readString(cursor);
+  uint8_t type;
+  fizz::detail::read(type, cursor);
+  psk.type = static_cast<PskType>(type);
+  fizz::detail::read(psk.version, cursor);
+  fizz::detail::read(psk.cipher, cursor);
+  uint8_t hasGroup;
+  NamedGroup group;
+  fizz::detail::read(hasGroup, cursor);
+  fizz::detail::read(group, cursor);
+  if (hasGroup) {
+    psk.group = group;
+  }
+  psk.serverCert = readCertIdentity(cursor);
+  psk.clientCert = readCertIdentity(cursor);
+  fizz::detail::read(psk.maxEarlyDataSize, cursor);
+  uint8_t hasAlpn;
+  fizz::detail::read(hasAlpn, cursor);
+  auto alpn = readString(cursor);
+  if (hasAlpn) {
+    psk.alpn = std::move(alpn);
+  }
+  fizz::detail::read(psk.ticketAgeAdd, cursor);
+  uint64_t issueTime;
+  uint64_t expirationTime;
+  fizz::detail::read(issueTime, cursor);
+  fizz::detail::read(expirationTime, cursor);
+  psk.ticketIssueTime = fromMillis(issueTime);
+  psk.ticketExpirationTime = fromMillis(expirationTime);
+  return psk;
+}
+
+bool expired(const CachedPsk& psk) {
+  return psk.ticketExpirationTime <= std::chrono::system_clock::now();
+}
+} // namespace
+
+PersistentPskCache::PersistentPskCache(std::string path, uint64_t maxEntries)
+    : path_(std::move(path)),
+      maxEntries_(maxEntries),
+      store_(Store(maxEntries)),
+      groups_(EvictingGroupMap(maxEntries)) {
+  auto store = store_.wlock();
+  store->file = folly::File(path_, O_RDWR | O_CREAT | O_APPEND, 0600);
+  load(*store);
+}
+
+void PersistentPskCache::load(Store& store) {
+  auto fileSize = lseek(store.file.fd(), 0, SEEK_END);
+  if (fileSize < 0) {
+    folly::throwSystemError("failed to size psk cache file");
+  }
+
+  size_t validLength = 0;
+  bool pruned = false;
+  if (fileSize > 0) {
+    folly::MemoryMapping mapping(store.file.dup());
+    auto data = mapping.range();
+    while (data.size() - validLength >= kRecordHeaderSize) {
+      auto headerBuf = folly::IOBuf::wrapBuffer(
+          data.subpiece(validLength, kRecordHeaderSize));
+      folly::io::Cursor header(headerBuf.get());
+      auto length = header.readBE<uint32_t>();
+      auto checksum = header.readBE<uint32_t>();
+      if (data.size() - validLength - kRecordHeaderSize < length) {
+        VLOG(4) << "Truncated record in psk cache " << path_;
+        break;
+      }
+      auto payload = data.subpiece(validLength + kRecordHeaderSize, length);
+      if (folly::crc32c(payload.data(), payload.size()) != checksum) {
+        VLOG(4) << "Corrupt record in psk cache " << path_;
+        break;
+      }
+
+      try {
+        auto buf = folly::IOBuf::wrapBuffer(payload);
+        folly::io::Cursor cursor(buf.get());
+        RecordType type;
+        fizz::detail::read(type, cursor);
+        auto identity = readString(cursor);
+        if (type == RecordType::Put) {
+          auto psk = decodePsk(cursor);
+          if (expired(psk)) {
+            store.psks.erase(identity);
+            pruned = true;
+          } else {
+            store.psks.set(identity, std::move(psk));
+          }
+        } else {
+          store.psks.erase(identity);
+        }
+      } catch (const std::exception& e) {
+        VLOG(4) << "Undecodable record in psk cache " << path_ << ": "
+                << e.what();
+        break;
+      }
+      validLength += kRecordHeaderSize + length;
+      store.records++;
+    }
+  }
+
+  if (validLength < static_cast<size_t>(fileSize) || pruned ||
+      store.records > 2 * maxEntries_) {
+    compact(store);
+  }
+}
+
+void PersistentPskCache::append(Store& store, Buf record) {
+  auto range = record->coalesce();
+  if (folly::writeFull(store.file.fd(), range.data(), range.size()) !=
+      static_cast<ssize_t>(range.size())) {
+    VLOG(4) << "Failed to append to psk cache " << path_;
+    return;
+  }
+  if (++store.records > 2 * maxEntries_) {
+    compact(store);
+  }
+}
+
+void PersistentPskCache::compact(Store& store) {
+  // Rewrite the live PSKs, least recently used first so that replaying the
+  // file restores the same eviction order.
+  std::vector<std::pair<std::string, const CachedPsk*>> live;
+  for (auto it = store.psks.begin(); it != store.psks.end(); ++it) {
+    if (!expired(it->second)) {
+      live.emplace_back(it->first, &it->second);
+    }
+  }
+
+  folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+  for (auto it = live.rbegin(); it != live.rend(); ++it) {
+    queue.append(encodeRecord(RecordType::Put, it->first, it->second));
+  }
+
+  auto tmpPath = path_ + ".tmp";
+  try {
+    folly::File tmp(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    auto buf = queue.move();
+    if (buf) {
+      auto range = buf->coalesce();
+      if (folly::writeFull(tmp.fd(), range.data(), range.size()) !=
+          static_cast<ssize_t>(range.size())) {
+        folly::throwSystemError("failed to write psk cache");
+      }
+    }
+    if (fsync(tmp.fd()) != 0) {
+      folly::throwSystemError("failed to sync psk cache");
+    }
+    if (rename(tmpPath.c_str(), path_.c_str()) != 0) {
+      folly::throwSystemError("failed to replace psk cache");
+    }
+    store.file = folly::File(path_, O_RDWR | O_APPEND);
+    store.records = live.size();
+  } catch (const std::exception& e) {
+    VLOG(4) << "Failed to compact psk cache " << path_ << ": " << e.what();
+  }
+}
+
+folly::Optional<CachedPsk> PersistentPskCache::getPsk(
+    const std::string& identity) {
+  auto store = store_.wlock();
+  auto result = store->psks.find(identity);
+  if (result == store->psks.end()) {
+    return folly::none;
+  } else if (expired(result->second)) {
+    store->psks.erase(identity);
+    return folly::none;
+  }
+  return result->second;
+}
+
+void PersistentPskCache::putPsk(const std::string& identity, CachedPsk psk) {
+  auto store = store_.wlock();
+  auto record = encodeRecord(RecordType::Put, identity, &psk);
+  store->psks.set(identity, std::move(psk));
+  append(*store, std::move(record));
+}
+
+void PersistentPskCache::removePsk(const std::string& identity) {
+  auto store = store_.wlock();
+  if (store->psks.erase(identity)) {
+    append(*store, encodeRecord(RecordType::Remove, identity, nullptr));
+  }
+}
+
+folly::Optional<NamedGroup> PersistentPskCache::getKeyShareGroup(
+    const std::string& identity) {
+  auto groupMap = groups_.wlock();
+  auto result = groupMap->find(identity);
+  if (result != groupMap->end()) {
+    return result->second;
+  } else {
+    return folly::none;
+  }
+}
+
+void PersistentPskCache::putKeyShareGroup(
+    const std::string& identity,
+    NamedGroup group) {
+  auto groupMap = groups_.wlock();
+  groupMap->set(identity, group);
+}
+
+} // namespace client
+} // namespace fizz
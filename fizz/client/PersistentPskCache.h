@@ -0,0 +1,73 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/client/PskCache.h>
+#include <folly/File.h>
+#include <folly/Synchronized.h>
+#include <folly/container/EvictingCacheMap.h>
+
+namespace fizz {
+namespace client {
+
+/**
+ * PSK cache backed by a file, so that short lived processes can resume
+ * connections made by an earlier run.
+ *
+ * Updates are appended to the file as checksummed records, and the file is
+ * read back through a memory mapping on construction. A record cut short by
+ * a crash is detected and dropped along with anything after it. Expired PSKs
+ * are pruned on load, and the file is rewritten (atomically, through a
+ * rename) once it holds many more records than live PSKs.
+ *
+ * At most maxEntries PSKs are kept, evicting the least recently used. Server
+ * and client certificates are stored by identity only, and are restored as
+ * IdentityCerts. Key share groups are kept in memory only.
+ */
+class PersistentPskCache : public PskCache {
+ public:
+  using EvictingPskMap = folly::EvictingCacheMap<std::string, CachedPsk>;
+  using EvictingGroupMap = folly::EvictingCacheMap<std::string, NamedGroup>;
+
+  PersistentPskCache(std::string path, uint64_t maxEntries);
+  ~PersistentPskCache() override = default;
+
+  folly::Optional<CachedPsk> getPsk(const std::string& identity) override;
+
+  void putPsk(const std::string& identity, CachedPsk psk) override;
+
+  void removePsk(const std::string& identity) override;
+
+  folly::Optional<NamedGroup> getKeyShareGroup(
+      const std::string& identity) override;
+
+  void putKeyShareGroup(const std::string& identity, NamedGroup group)
+      override;
+
+ private:
+  struct Store {
+    explicit Store(uint64_t maxEntries) : psks(maxEntries) {}
+
+    EvictingPskMap psks;
+    folly::File file;
+    size_t records{0};
+  };
+
+  void load(Store& store);
+  void append(Store& store, Buf record);
+  void compact(Store& store);
+
+  std::string path_;
+  uint64_t maxEntries_;
+  folly::Synchronized<Store> store_;
+  folly::Synchronized<EvictingGroupMap> groups_;
+};
+
+} // namespace client
+} // namespace fizz
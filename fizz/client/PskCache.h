@@ -11,6 +11,7 @@
 #include <fizz/protocol/Certificate.h>
 #include <fizz/protocol/Types.h>
 #include <fizz/record/Types.h>
+#include <folly/futures/Future.h>
 #include <chrono>
 #include <unordered_map>
 
@@ -45,6 +46,18 @@ class PskCache {
    */
   virtual folly::Optional<CachedPsk> getPsk(const std::string& identity) = 0;
 
+  /**
+   * Retrieve a PSK for the specified identity from a cache that may need to
+   * wait for it, for example on a remote store. AsyncFizzClient waits up to
+   * FizzClientContext::getPskLookupTimeout() for the future and otherwise
+   * connects without a PSK, so getPsk() should only return what is
+   * available without waiting. The future may be completed on any thread.
+   */
+  virtual folly::Future<folly::Optional<CachedPsk>> getPskFuture(
+      const std::string& identity) {
+    return getPsk(identity);
+  }
+
   /**
    * Add a new PSK for identity to the cache.
    */
@@ -54,6 +67,23 @@ class PskCache {
    * Remove any PSKs associated with identity from the cache.
    */
   virtual void removePsk(const std::string& identity) = 0;
+
+  /**
+   * Retrieve the group the server for identity chose for key exchange last
+   * time. Used to send a single key share that the server will accept,
+   * including on connections without a PSK.
+   */
+  virtual folly::Optional<NamedGroup> getKeyShareGroup(
+      const std::string& /* identity */) {
+    return folly::none;
+  }
+
+  /**
+   * Remember the group the server for identity chose for key exchange.
+   */
+  virtual void putKeyShareGroup(
+      const std::string& /* identity */,
+      NamedGroup /* group */) {}
 };
 
 /**
@@ -81,8 +111,24 @@ class BasicPskCache : public PskCache {
     cache_.erase(identity);
   }
 
+  folly::Optional<NamedGroup> getKeyShareGroup(
+      const std::string& identity) override {
+    auto result = groups_.find(identity);
+    if (result != groups_.end()) {
+      return result->second;
+    } else {
+      return folly::none;
+    }
+  }
+
+  void putKeyShareGroup(const std::string& identity, NamedGroup group)
+      override {
+    groups_[identity] = group;
+  }
+
  private:
   std::unordered_map<std::string, CachedPsk> cache_;
+  std::unordered_map<std::string, NamedGroup> groups_;
 };
 } // namespace client
 } // namespace fizz
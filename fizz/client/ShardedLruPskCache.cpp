@@ -0,0 +1,58 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/client/ShardedLruPskCache.h>
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace fizz {
+namespace client {
+
+ShardedLruPskCache::ShardedLruPskCache(uint64_t mapMax, size_t numShards) {
+  if (numShards == 0) {
+    throw std::runtime_error("psk cache needs at least one shard");
+  }
+  auto shardMax = std::max<uint64_t>(1, (mapMax + numShards - 1) / numShards);
+  for (size_t i = 0; i < numShards; ++i) {
+    shards_.push_back(std::make_unique<SynchronizedLruPskCache>(shardMax));
+  }
+}
+
+SynchronizedLruPskCache& ShardedLruPskCache::getShard(
+    const std::string& identity) {
+  return *shards_[std::hash<std::string>()(identity) % shards_.size()];
+}
+
+folly::Optional<CachedPsk> ShardedLruPskCache::getPsk(
+    const std::string& identity) {
+  return getShard(identity).getPsk(identity);
+}
+
+void ShardedLruPskCache::putPsk(const std::string& identity, CachedPsk psk) {
+  getShard(identity).putPsk(identity, std::move(psk));
+}
+
+void ShardedLruPskCache::removePsk(const std::string& identity) {
+  getShard(identity).removePsk(identity);
+}
+
+folly::Optional<NamedGroup> ShardedLruPskCache::getKeyShareGroup(
+    const std::string& identity) {
+  return getShard(identity).getKeyShareGroup(identity);
+}
+
+void ShardedLruPskCache::putKeyShareGroup(
+    const std::string& identity,
+    NamedGroup group) {
+  getShard(identity).putKeyShareGroup(identity, group);
+}
+
+} // namespace client
+} // namespace fizz
@@ -0,0 +1,53 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/client/SynchronizedLruPskCache.h>
+
+#include <memory>
+#include <vector>
+
+namespace fizz {
+namespace client {
+
+/**
+ * PSK cache split into independently locked LRU shards, chosen by a hash of
+ * the identity, so that connections from many threads to different origins
+ * do not contend on a single lock. mapMax is divided evenly between the
+ * shards and eviction is per shard.
+ */
+class ShardedLruPskCache : public PskCache {
+ public:
+  ~ShardedLruPskCache() override = default;
+  explicit ShardedLruPskCache(uint64_t mapMax, size_t numShards = 16);
+
+  folly::Optional<CachedPsk> getPsk(const std::string& identity) override;
+
+  void putPsk(const std::string& identity, CachedPsk psk) override;
+
+  void removePsk(const std::string& identity) override;
+
+  folly::Optional<NamedGroup> getKeyShareGroup(
+      const std::string& identity) override;
+
+  void putKeyShareGroup(const std::string& identity, NamedGroup group)
+      override;
+
+  size_t getNumShards() const {
+    return shards_.size();
+  }
+
+ private:
+  SynchronizedLruPskCache& getShard(const std::string& identity);
+
+  std::vector<std::unique_ptr<SynchronizedLruPskCache>> shards_;
+};
+
+} // namespace client
+} // namespace fizz
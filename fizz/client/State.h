@@ -14,6 +14,7 @@
 #include <fizz/protocol/KeyScheduler.h>
 #include <fizz/protocol/Types.h>
 #include <fizz/record/RecordLayer.h>
+#include <folly/futures/SharedPromise.h>
 
 namespace fizz {
 namespace client {
@@ -64,6 +65,22 @@ class State {
     return state_;
   }
 
+  /**
+   * The executor this connection is running on, if any. Asynchronous steps
+   * resume on it.
+   */
+  folly::Executor* executor() const {
+    return executor_;
+  }
+
+  /**
+   * Id passed to the context's HandshakeTracer for this connection, 0 if
+   * the context had no tracer when the connection started.
+   */
+  uint64_t handshakeId() const {
+    return handshakeId_;
+  }
+
   /**
    * The FizzClientContext used on this connection.
    */
@@ -74,7 +91,7 @@ class State {
   /**
    * The certificate used by the server for authentication.
    */
-  std::shared_ptr<const Cert> serverCert() const {
+  const std::shared_ptr<const Cert>& serverCert() const {
     return serverCert_;
   }
 
@@ -171,6 +188,15 @@ class State {
     return alpn_;
   }
 
+  /**
+   * Server certificate type (RFC 7250) negotiated on this connection. Not set
+   * if the extension was not negotiated, in which case it is an X509
+   * certificate.
+   */
+  const folly::Optional<CertificateType>& serverCertType() const {
+    return serverCertType_;
+  }
+
   /**
    * Server name that was sent in the SNI extensions.
    */
@@ -304,6 +330,21 @@ class State {
     return *unverifiedCertChain_;
   }
 
+  bool hasUnverifiedCertChain() const {
+    return unverifiedCertChain_.hasValue();
+  }
+
+  /**
+   * Asynchronous verification of the server certificate chain that has not
+   * completed yet. The client Finished is not written until it does.
+   *
+   * Should not be used outside of the state machine.
+   */
+  const std::shared_ptr<folly::SharedPromise<folly::Unit>>&
+  pendingCertVerification() const {
+    return pendingCertVerification_;
+  }
+
   /**
    * The certificate selected for client authentication (prior to being sent).
    *
@@ -429,6 +470,10 @@ class State {
     return alpn_;
   }
 
+  auto& serverCertType() {
+    return serverCertType_;
+  }
+
   auto& sni() {
     return sni_;
   }
@@ -473,6 +518,18 @@ class State {
     return unverifiedCertChain_;
   }
 
+  auto& pendingCertVerification() {
+    return pendingCertVerification_;
+  }
+
+  auto& executor() {
+    return executor_;
+  }
+
+  auto& handshakeId() {
+    return handshakeId_;
+  }
+
   auto& attemptedPsk() {
     return attemptedPsk_;
   }
@@ -516,6 +573,7 @@ class State {
   folly::Optional<KeyExchangeType> keyExchangeType_;
   folly::Optional<EarlyDataType> earlyDataType_;
   folly::Optional<std::string> alpn_;
+  folly::Optional<CertificateType> serverCertType_;
   folly::Optional<std::string> sni_;
 
   folly::Optional<EarlyDataParams> earlyDataParams_;
@@ -534,6 +592,9 @@ class State {
 
   folly::Optional<std::vector<std::shared_ptr<const PeerCert>>>
       unverifiedCertChain_;
+  std::shared_ptr<folly::SharedPromise<folly::Unit>> pendingCertVerification_;
+  folly::Executor* executor_{nullptr};
+  uint64_t handshakeId_{0};
   folly::Optional<CachedPsk> attemptedPsk_;
   folly::Optional<Buf> exporterMasterSecret_;
   std::shared_ptr<ClientExtensions> extensions_;
@@ -12,7 +12,7 @@ namespace fizz {
 namespace client {
 
 SynchronizedLruPskCache::SynchronizedLruPskCache(uint64_t mapMax)
-    : cache_(EvictingPskMap(mapMax)) {}
+    : cache_(EvictingPskMap(mapMax)), groups_(EvictingGroupMap(mapMax)) {}
 
 folly::Optional<CachedPsk> SynchronizedLruPskCache::getPsk(
     const std::string& identity) {
@@ -37,5 +37,23 @@ void SynchronizedLruPskCache::removePsk(const std::string& identity) {
   cacheMap->erase(identity);
 }
 
+folly::Optional<NamedGroup> SynchronizedLruPskCache::getKeyShareGroup(
+    const std::string& identity) {
+  auto groupMap = groups_.wlock();
+  auto result = groupMap->find(identity);
+  if (result != groupMap->end()) {
+    return result->second;
+  } else {
+    return folly::none;
+  }
+}
+
+void SynchronizedLruPskCache::putKeyShareGroup(
+    const std::string& identity,
+    NamedGroup group) {
+  auto groupMap = groups_.wlock();
+  groupMap->set(identity, group);
+}
+
 } // namespace client
 } // namespace fizz
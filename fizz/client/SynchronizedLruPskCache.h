@@ -23,6 +23,7 @@ namespace client {
 class SynchronizedLruPskCache : public PskCache {
  public:
   using EvictingPskMap = folly::EvictingCacheMap<std::string, CachedPsk>;
+  using EvictingGroupMap = folly::EvictingCacheMap<std::string, NamedGroup>;
   ~SynchronizedLruPskCache() override = default;
   explicit SynchronizedLruPskCache(uint64_t mapMax);
 
@@ -32,8 +33,15 @@ class SynchronizedLruPskCache : public PskCache {
 
   void removePsk(const std::string& identity) override;
 
+  folly::Optional<NamedGroup> getKeyShareGroup(
+      const std::string& identity) override;
+
+  void putKeyShareGroup(const std::string& identity, NamedGroup group)
+      override;
+
  private:
   folly::Synchronized<EvictingPskMap> cache_;
+  folly::Synchronized<EvictingGroupMap> groups_;
 };
 
 } // namespace client
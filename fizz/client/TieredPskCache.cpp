@@ -0,0 +1,60 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/client/TieredPskCache.h>
+
+namespace fizz {
+namespace client {
+
+TieredPskCache::TieredPskCache(
+    std::shared_ptr<PskCache> local,
+    std::shared_ptr<PskCache> remote)
+    : local_(std::move(local)), remote_(std::move(remote)) {}
+
+folly::Optional<CachedPsk> TieredPskCache::getPsk(
+    const std::string& identity) {
+  return local_->getPsk(identity);
+}
+
+folly::Future<folly::Optional<CachedPsk>> TieredPskCache::getPskFuture(
+    const std::string& identity) {
+  auto psk = local_->getPsk(identity);
+  if (psk) {
+    return std::move(psk);
+  }
+  return remote_->getPskFuture(identity).then(
+      [local = local_, identity](folly::Optional<CachedPsk>&& remotePsk) {
+        if (remotePsk) {
+          local->putPsk(identity, *remotePsk);
+        }
+        return std::move(remotePsk);
+      });
+}
+
+void TieredPskCache::putPsk(const std::string& identity, CachedPsk psk) {
+  local_->putPsk(identity, psk);
+  remote_->putPsk(identity, std::move(psk));
+}
+
+void TieredPskCache::removePsk(const std::string& identity) {
+  local_->removePsk(identity);
+  remote_->removePsk(identity);
+}
+
+folly::Optional<NamedGroup> TieredPskCache::getKeyShareGroup(
+    const std::string& identity) {
+  return local_->getKeyShareGroup(identity);
+}
+
+void TieredPskCache::putKeyShareGroup(
+    const std::string& identity,
+    NamedGroup group) {
+  local_->putKeyShareGroup(identity, group);
+}
+} // namespace client
+} // namespace fizz
@@ -0,0 +1,56 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/client/PskCache.h>
+
+namespace fizz {
+namespace client {
+
+/**
+ * PSK cache that puts a local cache in front of a remote one, typically a
+ * store of tickets shared between stateless clients that implements
+ * getPskFuture().
+ *
+ * getPsk() only consults the local cache, so it never waits on the remote.
+ * getPskFuture() returns local PSKs right away and otherwise asks the
+ * remote, storing what it returns locally. New PSKs are stored in both, and
+ * removed from both. Key share groups are only kept locally.
+ *
+ * The local cache must be thread safe if the remote completes its futures on
+ * other threads.
+ */
+class TieredPskCache : public PskCache {
+ public:
+  TieredPskCache(
+      std::shared_ptr<PskCache> local,
+      std::shared_ptr<PskCache> remote);
+  ~TieredPskCache() override = default;
+
+  folly::Optional<CachedPsk> getPsk(const std::string& identity) override;
+
+  folly::Future<folly::Optional<CachedPsk>> getPskFuture(
+      const std::string& identity) override;
+
+  void putPsk(const std::string& identity, CachedPsk psk) override;
+
+  void removePsk(const std::string& identity) override;
+
+  folly::Optional<NamedGroup> getKeyShareGroup(
+      const std::string& identity) override;
+
+  void putKeyShareGroup(const std::string& identity, NamedGroup group)
+      override;
+
+ private:
+  std::shared_ptr<PskCache> local_;
+  std::shared_ptr<PskCache> remote_;
+};
+} // namespace client
+} // namespace fizz
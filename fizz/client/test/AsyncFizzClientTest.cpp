@@ -12,7 +12,13 @@
 #include <fizz/client/AsyncFizzClient.h>
 
 #include <fizz/client/test/Mocks.h>
+#include <fizz/client/test/Utilities.h>
+#include <fizz/crypto/aead/AESGCM128.h>
+#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
 #include <fizz/protocol/test/Mocks.h>
+#include <fizz/record/EncryptedRecordLayer.h>
+#include <folly/String.h>
+#include <folly/experimental/TestUtil.h>
 #include <folly/io/async/test/AsyncSocketTest.h>
 #include <folly/io/async/test/MockAsyncSocket.h>
 #include <folly/io/async/test/MockAsyncTransport.h>
@@ -49,6 +55,24 @@ class MockConnectCallback : public AsyncSocket::ConnectCallback {
   }
 };
 
+class MockWriteBufferCallback : public AsyncFizzBase::WriteBufferCallback {
+ public:
+  MOCK_METHOD0(_writeBufferAboveHighWatermark, void());
+  void writeBufferAboveHighWatermark() noexcept override {
+    _writeBufferAboveHighWatermark();
+  }
+
+  MOCK_METHOD0(_writeBufferBelowLowWatermark, void());
+  void writeBufferBelowLowWatermark() noexcept override {
+    _writeBufferBelowLowWatermark();
+  }
+};
+
+class MockBufferPool : public BufferPool {
+ public:
+  MOCK_METHOD1(allocate, std::unique_ptr<IOBuf>(size_t));
+};
+
 class AsyncFizzClientTest : public Test {
  public:
   void SetUp() override {
@@ -99,6 +123,7 @@ class AsyncFizzClientTest : public Test {
     EXPECT_CALL(*machine_, _processSocketData(_, _))
         .WillOnce(InvokeWithoutArgs([=]() {
           auto addToState = [=](State& newState) {
+            newState.context() = context_;
             newState.exporterMasterSecret() =
                 folly::IOBuf::copyBuffer("12345678901234567890123456789012");
             newState.cipher() = CipherSuite::TLS_AES_128_GCM_SHA256;
@@ -181,6 +206,78 @@ TEST_F(AsyncFizzClientTest, TestConnect) {
   connect();
 }
 
+TEST_F(AsyncFizzClientTest, TestConnectWaitsForPsk) {
+  auto asyncPskCache = std::make_shared<MockAsyncPskCache>();
+  context_->setPskCache(asyncPskCache);
+  Promise<Optional<CachedPsk>> remotePsk;
+  EXPECT_CALL(*asyncPskCache, getPskFuture(*pskIdentity_))
+      .WillOnce(InvokeWithoutArgs([&remotePsk]() {
+        return remotePsk.getFuture();
+      }));
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb_));
+  expectTransportReadCallback();
+
+  bool connected = false;
+  EXPECT_CALL(
+      *machine_,
+      _processConnect(
+          _,
+          _,
+          _,
+          _,
+          Truly([](const Optional<CachedPsk>& psk) {
+            return psk && psk->psk == "remote";
+          }),
+          _))
+      .WillOnce(InvokeWithoutArgs([&connected]() {
+        connected = true;
+        return Actions();
+      }));
+  client_->connect(
+      &handshakeCallback_,
+      nullptr,
+      std::string("www.example.com"),
+      pskIdentity_);
+  EXPECT_FALSE(connected);
+
+  remotePsk.setValue(getTestPsk("remote", std::chrono::system_clock::now()));
+  evb_.loop();
+  EXPECT_TRUE(connected);
+}
+
+TEST_F(AsyncFizzClientTest, TestConnectPskLookupTimeout) {
+  auto asyncPskCache = std::make_shared<MockAsyncPskCache>();
+  context_->setPskCache(asyncPskCache);
+  context_->setPskLookupTimeout(std::chrono::milliseconds(1));
+  Promise<Optional<CachedPsk>> remotePsk;
+  EXPECT_CALL(*asyncPskCache, getPskFuture(*pskIdentity_))
+      .WillOnce(InvokeWithoutArgs([&remotePsk]() {
+        return remotePsk.getFuture();
+      }));
+  ON_CALL(*socket_, getEventBase()).WillByDefault(Return(&evb_));
+  expectTransportReadCallback();
+
+  EXPECT_CALL(
+      *machine_,
+      _processConnect(
+          _,
+          _,
+          _,
+          _,
+          Truly([](const Optional<CachedPsk>& psk) { return !psk; }),
+          _))
+      .WillOnce(InvokeWithoutArgs([this]() {
+        evb_.terminateLoopSoon();
+        return Actions();
+      }));
+  client_->connect(
+      &handshakeCallback_,
+      nullptr,
+      std::string("www.example.com"),
+      pskIdentity_);
+  evb_.loopForever();
+}
+
 TEST_F(AsyncFizzClientTest, TestReadSingle) {
   connect();
   EXPECT_CALL(*machine_, _processSocketData(_, _))
@@ -267,6 +364,151 @@ TEST_F(AsyncFizzClientTest, TestDeliverAppData) {
   socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("ClientHello"));
 }
 
+TEST_F(AsyncFizzClientTest, TestDecryptIntoReadBuffer) {
+  completeHandshake();
+  client_->setReadCB(&readCallback_);
+  client_->setDecryptIntoReadBuffers(true);
+  EXPECT_CALL(readCallback_, isBufferMovable_()).WillRepeatedly(Return(false));
+
+  auto makeAead = []() {
+    auto aead = std::make_unique<OpenSSLEVPCipher<AESGCM128>>();
+    aead->setKey(TrafficKey{IOBuf::copyBuffer("0123456789abcdef"),
+                            IOBuf::copyBuffer("0123456789ab")});
+    return aead;
+  };
+  EncryptedWriteRecordLayer writeLayer;
+  writeLayer.setAead(makeAead());
+
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(Invoke([&](const State&, IOBufQueue& queue) {
+        queue.move();
+        return detail::actions(
+            [&](State& newState) {
+              auto readLayer = std::make_unique<EncryptedReadRecordLayer>();
+              readLayer->setAead(makeAead());
+              newState.readRecordLayer() = std::move(readLayer);
+            },
+            WaitForData());
+      }))
+      .WillOnce(Invoke([](const State& state, IOBufQueue& queue) {
+        auto param = state.readRecordLayer()->readEvent(queue);
+        auto& appData = boost::get<AppData>(*param);
+        return detail::actions(
+            DeliverAppData{std::move(appData.data)}, WaitForData());
+      }));
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("NewKeys"));
+
+  std::array<char, 100> appBuf;
+  EXPECT_CALL(readCallback_, getReadBuffer(_, _))
+      .WillOnce(Invoke([&](void** buf, size_t* len) {
+        *buf = appBuf.data();
+        *len = appBuf.size();
+      }));
+  EXPECT_CALL(readCallback_, readDataAvailable_(2));
+  socketReadCallback_->readBufferAvailable(
+      writeLayer.writeAppData(IOBuf::copyBuffer("HI")));
+  EXPECT_EQ(std::string(appBuf.data(), 2), "HI");
+}
+
+TEST_F(AsyncFizzClientTest, TestZeroCopyWriteThreshold) {
+  completeHandshake();
+  client_->setReadCB(&readCallback_);
+  client_->setZeroCopyWriteThreshold(5);
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(InvokeWithoutArgs([]() {
+        WriteToSocket small;
+        small.data = IOBuf::copyBuffer("XYZ");
+        WriteToSocket large;
+        large.data = IOBuf::copyBuffer("LARGE");
+        return detail::actions(
+            std::move(small), std::move(large), WaitForData());
+      }));
+  Sequence s;
+  EXPECT_CALL(*socket_, writeChain(_, _, WriteFlags::NONE)).InSequence(s);
+  EXPECT_CALL(*socket_, writeChain(_, _, WriteFlags::WRITE_MSG_ZEROCOPY))
+      .InSequence(s);
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("ClientHello"));
+}
+
+TEST_F(AsyncFizzClientTest, TestWriteFile) {
+  completeHandshake();
+  TemporaryFile file;
+  std::string contents = "hello world";
+  ASSERT_EQ(
+      write(file.fd(), contents.data(), contents.size()),
+      static_cast<ssize_t>(contents.size()));
+
+  AsyncTransportWrapper::WriteCallback* callback = nullptr;
+  EXPECT_CALL(*machine_, _processAppWrite(_, _))
+      .WillOnce(Invoke([&callback](const State&, AppWrite& write) {
+        EXPECT_TRUE(IOBufEqualTo()(write.data, IOBuf::copyBuffer("world")));
+        EXPECT_FALSE(write.data->isShared());
+        callback = write.callback;
+        return detail::actions();
+      }));
+  client_->writeFile(&writeCallback_, file.fd(), 6, 5);
+  EXPECT_EQ(client_->getAppBytesWritten(), 5);
+
+  ASSERT_NE(callback, nullptr);
+  EXPECT_CALL(writeCallback_, writeSuccess_());
+  callback->writeSuccess();
+}
+
+TEST_F(AsyncFizzClientTest, TestWriteFileChunks) {
+  completeHandshake();
+  TemporaryFile file;
+  std::string contents(100 * 1024, 'a');
+  ASSERT_EQ(
+      write(file.fd(), contents.data(), contents.size()),
+      static_cast<ssize_t>(contents.size()));
+
+  std::vector<size_t> lengths;
+  AsyncTransportWrapper::WriteCallback* callback = nullptr;
+  EXPECT_CALL(*machine_, _processAppWrite(_, _))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](const State&, AppWrite& write) {
+        lengths.push_back(write.data->computeChainDataLength());
+        callback = write.callback;
+        return detail::actions();
+      }));
+  client_->writeFile(&writeCallback_, file.fd(), 0, contents.size());
+  EXPECT_EQ(lengths.size(), 1);
+
+  callback->writeSuccess();
+  EXPECT_EQ(lengths, std::vector<size_t>({64 * 1024, 36 * 1024}));
+
+  EXPECT_CALL(writeCallback_, writeSuccess_());
+  callback->writeSuccess();
+}
+
+TEST_F(AsyncFizzClientTest, TestWriteFileTruncated) {
+  completeHandshake();
+  TemporaryFile file;
+  std::string contents(100 * 1024, 'a');
+  ASSERT_EQ(
+      write(file.fd(), contents.data(), contents.size()),
+      static_cast<ssize_t>(contents.size()));
+
+  AsyncTransportWrapper::WriteCallback* callback = nullptr;
+  EXPECT_CALL(*machine_, _processAppWrite(_, _))
+      .WillOnce(Invoke([&callback](const State&, AppWrite& write) {
+        callback = write.callback;
+        return detail::actions();
+      }));
+  client_->writeFile(&writeCallback_, file.fd(), 0, contents.size());
+
+  ASSERT_EQ(ftruncate(file.fd(), 1024), 0);
+  EXPECT_CALL(writeCallback_, writeErr_(64 * 1024, _));
+  callback->writeSuccess();
+}
+
+TEST_F(AsyncFizzClientTest, TestWriteFileError) {
+  completeHandshake();
+  EXPECT_CALL(*machine_, _processAppWrite(_, _)).Times(0);
+  EXPECT_CALL(writeCallback_, writeErr_(0, _));
+  client_->writeFile(&writeCallback_, -1, 0, 5);
+}
+
 TEST_F(AsyncFizzClientTest, TestWriteToSocket) {
   completeHandshake();
   client_->setReadCB(&readCallback_);
@@ -369,6 +611,37 @@ TEST_F(AsyncFizzClientTest, TestSocketConnect) {
   evb.loop();
 }
 
+TEST_F(AsyncFizzClientTest, TestSocketConnectPrepareClientHello) {
+  MockConnectCallback cb;
+  EventBase evb;
+  auto evbClient = AsyncFizzClientT<MockClientStateMachineInstance>::UniquePtr(
+      new AsyncFizzClientT<MockClientStateMachineInstance>(&evb, context_));
+  evbClient->setPrepareClientHelloDuringConnect(true);
+
+  machine_ = MockClientStateMachineInstance::instance;
+  auto server = std::make_unique<TestServer>();
+
+  bool prepared = false;
+  EXPECT_CALL(*machine_, _processConnect(_, _, _, _, _, _))
+      .WillOnce(InvokeWithoutArgs([&prepared]() {
+        prepared = true;
+        return detail::actions(ReportHandshakeSuccess(), WaitForData());
+      }));
+  EXPECT_CALL(cb, _connectSuccess()).WillOnce(Invoke([&evbClient]() {
+    evbClient->closeNow();
+  }));
+
+  evbClient->connect(
+      server->getAddress(),
+      &cb,
+      nullptr,
+      std::string("www.example.com"),
+      pskIdentity_);
+  EXPECT_TRUE(prepared);
+
+  evb.loop();
+}
+
 TEST_F(AsyncFizzClientTest, TestSocketConnectWithUnsupportedTransport) {
   MockConnectCallback cb;
   EXPECT_CALL(cb, _connectErr(_))
@@ -432,6 +705,127 @@ TEST_F(AsyncFizzClientTest, TestSocketConnectWithOpenSocket) {
       pskIdentity_);
 }
 
+TEST_F(AsyncFizzClientTest, TestSocketConnectTFOSingleWrite) {
+  MockConnectCallback cb;
+  EventBase evb;
+  MockAsyncSocket mockSocket(&evb);
+  client_->setTFOEnabled(true);
+  EXPECT_CALL(*socket_, getWrappedTransport()).WillOnce(Return(&mockSocket));
+  EXPECT_CALL(mockSocket, connect_(_, _, _, _, _))
+      .WillOnce(Invoke([](AsyncSocket::ConnectCallback* cb,
+                          const SocketAddress&,
+                          int,
+                          const AsyncSocket::OptionMap&,
+                          const SocketAddress&) { cb->connectSuccess(); }));
+  EXPECT_CALL(*machine_, _processConnect(_, _, _, _, _, _))
+      .WillOnce(InvokeWithoutArgs([]() {
+        WriteToSocket clientHello;
+        clientHello.data = IOBuf::copyBuffer("clienthello");
+        ReportEarlyHandshakeSuccess earlySuccess;
+        earlySuccess.maxEarlyDataSize = 1000;
+        return detail::actions(
+            std::move(clientHello), std::move(earlySuccess));
+      }));
+  EXPECT_CALL(*machine_, _processEarlyAppWrite(_, _))
+      .WillOnce(Invoke([](const State&, EarlyAppWrite& write) {
+        WriteToSocket earlyData;
+        earlyData.callback = write.callback;
+        earlyData.data = std::move(write.data);
+        return detail::actions(std::move(earlyData));
+      }));
+  EXPECT_CALL(cb, _connectSuccess()).WillOnce(Invoke([this]() {
+    client_->writeChain(&writeCallback_, IOBuf::copyBuffer("earlydata"));
+  }));
+  EXPECT_CALL(*socket_, writeChain(_, _, _))
+      .WillOnce(Invoke([](AsyncTransportWrapper::WriteCallback* callback,
+                          std::shared_ptr<IOBuf> buf,
+                          WriteFlags) {
+        EXPECT_TRUE(
+            IOBufEqualTo()(buf, IOBuf::copyBuffer("clienthelloearlydata")));
+        callback->writeSuccess();
+      }));
+  EXPECT_CALL(writeCallback_, writeSuccess_());
+  client_->connect(
+      SocketAddress(),
+      &cb,
+      nullptr,
+      std::string("www.example.com"),
+      pskIdentity_);
+}
+
+TEST_F(AsyncFizzClientTest, TestCoalesceFinishedWithAppData) {
+  client_->setCoalesceFinishedWithAppData(true);
+  connect();
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(InvokeWithoutArgs([]() {
+        WriteToSocket finished;
+        finished.data = IOBuf::copyBuffer("finished");
+        return detail::actions(
+            [](State& newState) { newState.state() = StateEnum::Established; },
+            std::move(finished),
+            ReportHandshakeSuccess(),
+            WaitForData());
+      }));
+  EXPECT_CALL(handshakeCallback_, _fizzHandshakeSuccess())
+      .WillOnce(Invoke([this]() {
+        client_->writeChain(&writeCallback_, IOBuf::copyBuffer("request"));
+      }));
+  EXPECT_CALL(*machine_, _processAppWrite(_, _))
+      .WillOnce(Invoke([](const State&, AppWrite& write) {
+        WriteToSocket appData;
+        appData.callback = write.callback;
+        appData.data = std::move(write.data);
+        return detail::actions(std::move(appData));
+      }));
+  EXPECT_CALL(*socket_, writeChain(_, _, _))
+      .WillOnce(Invoke([](AsyncTransportWrapper::WriteCallback* callback,
+                          std::shared_ptr<IOBuf> buf,
+                          WriteFlags) {
+        EXPECT_TRUE(IOBufEqualTo()(buf, IOBuf::copyBuffer("finishedrequest")));
+        callback->writeSuccess();
+      }));
+  EXPECT_CALL(writeCallback_, writeSuccess_());
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("ServerData"));
+}
+
+TEST_F(AsyncFizzClientTest, TestCoalesceFinishedWithVectoredAppData) {
+  client_->setCoalesceFinishedWithAppData(true);
+  client_->setVectoredWrites(true);
+  connect();
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(InvokeWithoutArgs([]() {
+        WriteToSocket finished;
+        finished.data = IOBuf::copyBuffer("finished");
+        return detail::actions(
+            [](State& newState) { newState.state() = StateEnum::Established; },
+            std::move(finished),
+            ReportHandshakeSuccess(),
+            WaitForData());
+      }));
+  EXPECT_CALL(handshakeCallback_, _fizzHandshakeSuccess())
+      .WillOnce(Invoke([this]() {
+        client_->writeChain(&writeCallback_, IOBuf::copyBuffer("request"));
+      }));
+  EXPECT_CALL(*machine_, _processAppWrite(_, _))
+      .WillOnce(Invoke([](const State&, AppWrite& write) {
+        EXPECT_TRUE(write.iovecs);
+        write.iovecs->append(std::move(write.data));
+        WriteToSocket appData;
+        appData.callback = write.callback;
+        appData.iovecs = std::move(write.iovecs);
+        return detail::actions(std::move(appData));
+      }));
+  EXPECT_CALL(*socket_, writeChain(_, _, _))
+      .WillOnce(Invoke([](AsyncTransportWrapper::WriteCallback* callback,
+                          std::shared_ptr<IOBuf> buf,
+                          WriteFlags) {
+        EXPECT_TRUE(IOBufEqualTo()(buf, IOBuf::copyBuffer("finishedrequest")));
+        callback->writeSuccess();
+      }));
+  EXPECT_CALL(writeCallback_, writeSuccess_());
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("ServerData"));
+}
+
 TEST_F(AsyncFizzClientTest, TestApplicationProtocol) {
   completeHandshake();
   EXPECT_EQ(client_->getApplicationProtocol(), "h2");
@@ -735,6 +1129,27 @@ TEST_F(AsyncFizzClientTest, TestEarlyHandshakeRejectedAutoResendDeletedBuffer) {
   fullHandshakeSuccess(false);
 }
 
+TEST_F(AsyncFizzClientTest, TestEarlyHandshakeRejectedAutoResendNoCopy) {
+  client_->setEarlyDataRejectionPolicy(
+      EarlyDataRejectionPolicy::AutomaticResend);
+  completeEarlyHandshake();
+
+  auto buf = IOBuf::copyBuffer("aaaa");
+  auto data = buf->data();
+  EXPECT_CALL(*machine_, _processEarlyAppWrite(_, _))
+      .WillOnce(Invoke(
+          [](const State&, EarlyAppWrite&) { return detail::actions(); }));
+  client_->writeChain(nullptr, std::move(buf));
+
+  EXPECT_CALL(*machine_, _processAppWrite(_, _))
+      .WillOnce(Invoke([data](const State&, AppWrite& write) {
+        EXPECT_TRUE(IOBufEqualTo()(write.data, IOBuf::copyBuffer("aaaa")));
+        EXPECT_EQ(write.data->data(), data);
+        return detail::actions();
+      }));
+  fullHandshakeSuccess(false);
+}
+
 TEST_F(AsyncFizzClientTest, TestEarlyRejectResendDifferentAlpn) {
   client_->setEarlyDataRejectionPolicy(
       EarlyDataRejectionPolicy::AutomaticResend);
@@ -968,6 +1383,175 @@ TEST_F(AsyncFizzClientTest, TestNewCachedPskActionsWithEmptyPskIdentity) {
       IOBuf::copyBuffer("NewSessionTicket"));
 }
 
+TEST_F(AsyncFizzClientTest, TestReadBufferWatermarks) {
+  completeHandshake();
+  client_->setReadBufferWatermarks(10, 5);
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(Invoke([](const State&, IOBufQueue& queue) {
+        queue.move();
+        return detail::actions(
+            DeliverAppData{IOBuf::copyBuffer("0123456789")}, WaitForData());
+      }));
+  EXPECT_CALL(*socket_, setReadCB(nullptr));
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("Data"));
+  Mock::VerifyAndClearExpectations(socket_);
+
+  expectTransportReadCallback();
+  EXPECT_CALL(readCallback_, readBufferAvailable_(_));
+  client_->setReadCB(&readCallback_);
+}
+
+TEST_F(AsyncFizzClientTest, TestReadBufferWatermarksBelowHigh) {
+  completeHandshake();
+  client_->setReadBufferWatermarks(20, 5);
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(Invoke([](const State&, IOBufQueue& queue) {
+        queue.move();
+        return detail::actions(
+            DeliverAppData{IOBuf::copyBuffer("0123456789")}, WaitForData());
+      }));
+  EXPECT_CALL(*socket_, setReadCB(nullptr)).Times(0);
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("Data"));
+}
+
+TEST_F(AsyncFizzClientTest, TestReadBufferWatermarksInvalid) {
+  EXPECT_THROW(client_->setReadBufferWatermarks(5, 10), std::runtime_error);
+}
+
+TEST_F(AsyncFizzClientTest, TestWriteBufferWatermarks) {
+  completeHandshake();
+  MockWriteBufferCallback bufferCallback;
+  client_->setWriteBufferWatermarks(10, 5, &bufferCallback);
+
+  std::vector<AsyncTransportWrapper::WriteCallback*> callbacks;
+  EXPECT_CALL(*machine_, _processAppWrite(_, _))
+      .WillRepeatedly(Invoke([&callbacks](const State&, AppWrite& write) {
+        callbacks.push_back(write.callback);
+        return detail::actions();
+      }));
+
+  client_->writeChain(&writeCallback_, IOBuf::copyBuffer("123456"));
+  EXPECT_EQ(client_->getWriteBufferedBytes(), 6);
+  EXPECT_CALL(bufferCallback, _writeBufferAboveHighWatermark());
+  client_->writeChain(nullptr, IOBuf::copyBuffer("123456"));
+  EXPECT_EQ(client_->getWriteBufferedBytes(), 12);
+  ASSERT_EQ(callbacks.size(), 2);
+
+  EXPECT_CALL(writeCallback_, writeSuccess_());
+  callbacks[0]->writeSuccess();
+  EXPECT_EQ(client_->getWriteBufferedBytes(), 6);
+  EXPECT_CALL(bufferCallback, _writeBufferBelowLowWatermark());
+  callbacks[1]->writeSuccess();
+  EXPECT_EQ(client_->getWriteBufferedBytes(), 0);
+}
+
+TEST_F(AsyncFizzClientTest, TestWriteBufferWatermarksReset) {
+  completeHandshake();
+  MockWriteBufferCallback bufferCallback;
+  client_->setWriteBufferWatermarks(10, 5, &bufferCallback);
+
+  AsyncTransportWrapper::WriteCallback* callback = nullptr;
+  EXPECT_CALL(*machine_, _processAppWrite(_, _))
+      .WillOnce(Invoke([&callback](const State&, AppWrite& write) {
+        callback = write.callback;
+        return detail::actions();
+      }));
+  client_->writeChain(&writeCallback_, IOBuf::copyBuffer("123456"));
+  EXPECT_EQ(client_->getWriteBufferedBytes(), 6);
+
+  client_->setWriteBufferWatermarks(10, 5, nullptr);
+  EXPECT_EQ(client_->getWriteBufferedBytes(), 0);
+  EXPECT_CALL(writeCallback_, writeErr_(0, _));
+  callback->writeErr(
+      0, AsyncSocketException(AsyncSocketException::UNKNOWN, "unit test"));
+  EXPECT_EQ(client_->getWriteBufferedBytes(), 0);
+}
+
+TEST_F(AsyncFizzClientTest, TestAdaptiveReadSize) {
+  completeHandshake();
+  client_->setReadCB(&readCallback_);
+  client_->setAdaptiveReadSize(true);
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillRepeatedly(Invoke([](const State&, IOBufQueue& queue) {
+        queue.move();
+        return detail::actions(WaitForData());
+      }));
+
+  void* buf;
+  size_t len;
+  socketReadCallback_->getReadBuffer(&buf, &len);
+  auto initialLen = len;
+  for (size_t i = 0; i < 10; i++) {
+    socketReadCallback_->getReadBuffer(&buf, &len);
+    memset(buf, 'a', len);
+    socketReadCallback_->readDataAvailable(len);
+  }
+  socketReadCallback_->getReadBuffer(&buf, &len);
+  EXPECT_GE(len, 64 * 1024);
+
+  for (size_t i = 0; i < 10; i++) {
+    socketReadCallback_->getReadBuffer(&buf, &len);
+    memset(buf, 'a', 1);
+    socketReadCallback_->readDataAvailable(1);
+  }
+  socketReadCallback_->getReadBuffer(&buf, &len);
+  EXPECT_LT(len, 2 * initialLen);
+}
+
+TEST_F(AsyncFizzClientTest, TestReadBufferPool) {
+  completeHandshake();
+  client_->setReadCB(&readCallback_);
+  auto pool = std::make_shared<MockBufferPool>();
+  client_->setReadBufferPool(pool);
+
+  uint8_t* pooled = nullptr;
+  EXPECT_CALL(*pool, allocate(_)).WillOnce(Invoke([&pooled](size_t capacity) {
+    auto buf = IOBuf::create(capacity);
+    pooled = buf->writableData();
+    return buf;
+  }));
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillRepeatedly(Invoke([&pooled](const State&, IOBufQueue& queue) {
+        EXPECT_EQ(queue.front()->data(), pooled);
+        return detail::actions(WaitForData());
+      }));
+
+  void* buf;
+  size_t len;
+  socketReadCallback_->getReadBuffer(&buf, &len);
+  EXPECT_EQ(buf, pooled);
+  memcpy(buf, "hello", 5);
+  socketReadCallback_->readDataAvailable(5);
+
+  // The rest of the pooled buffer is used for the next read.
+  socketReadCallback_->getReadBuffer(&buf, &len);
+  EXPECT_EQ(buf, pooled + 5);
+}
+
+TEST_F(AsyncFizzClientTest, TestAdaptiveReadSizePendingRecord) {
+  completeHandshake();
+  client_->setReadCB(&readCallback_);
+  client_->setAdaptiveReadSize(true);
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(Invoke([](const State&, IOBufQueue& queue) {
+        queue.move();
+        return detail::actions(WaitForData());
+      }))
+      .WillRepeatedly(InvokeWithoutArgs(
+          []() { return detail::actions(WaitForData()); }));
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("Data"));
+
+  void* buf;
+  size_t len;
+  socketReadCallback_->getReadBuffer(&buf, &len);
+  auto partialRecord = unhexlify("1703034000aabbccdd");
+  memcpy(buf, partialRecord.data(), partialRecord.size());
+  socketReadCallback_->readDataAvailable(partialRecord.size());
+
+  socketReadCallback_->getReadBuffer(&buf, &len);
+  EXPECT_GE(len, 5 + 0x4000 - partialRecord.size());
+}
+
 } // namespace test
 } // namespace client
 } // namespace fizz
@@ -12,10 +12,13 @@
 #include <fizz/client/ClientProtocol.h>
 #include <fizz/client/test/Mocks.h>
 #include <fizz/client/test/Utilities.h>
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/DelegatedCredential.h>
 #include <fizz/protocol/test/Matchers.h>
 #include <fizz/protocol/test/ProtocolTest.h>
 #include <fizz/protocol/test/TestMessages.h>
 #include <fizz/record/test/Mocks.h>
+#include <folly/executors/ManualExecutor.h>
 
 using namespace fizz::test;
 using namespace folly;
@@ -226,6 +229,15 @@ class ClientProtocolTest : public ProtocolTest<ClientTypes, Actions> {
 
   void doFinishedFlow(ClientAuthType authType);
 
+  Actions getActions(AsyncActions asyncActions) {
+    return folly::variant_match(
+        asyncActions,
+        [](folly::Future<Actions>& futureActions) {
+          return std::move(futureActions).get();
+        },
+        [](Actions& immediateActions) { return std::move(immediateActions); });
+  }
+
   std::shared_ptr<FizzClientContext> context_;
   MockPlaintextReadRecordLayer* mockRead_;
   MockPlaintextWriteRecordLayer* mockWrite_;
@@ -240,6 +252,19 @@ class ClientProtocolTest : public ProtocolTest<ClientTypes, Actions> {
   std::shared_ptr<MockPskCache> pskCache_;
 };
 
+TEST_F(ClientProtocolTest, TestCopiedContextSharesComponents) {
+  auto copy = std::make_shared<FizzClientContext>(*context_);
+  EXPECT_EQ(copy->getFactory(), context_->getFactory());
+  EXPECT_EQ(copy->getPskCache(), context_->getPskCache());
+  EXPECT_EQ(
+      &copy->getClientHelloExtensions(), &context_->getClientHelloExtensions());
+
+  copy->setSupportedAlpns({"h3"});
+  EXPECT_NE(
+      &copy->getClientHelloExtensions(), &context_->getClientHelloExtensions());
+  EXPECT_EQ(context_->getSupportedAlpns(), std::vector<std::string>({"h2"}));
+}
+
 TEST_F(ClientProtocolTest, TestInvalidTransitionNoAlert) {
   auto actions = ClientStateMachine().processAppWrite(state_, AppWrite());
   expectError(actions, none, "invalid event");
@@ -289,7 +314,9 @@ TEST_F(ClientProtocolTest, TestConnectFlow) {
     return random;
   }));
   MockKeyExchange* mockKex;
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::x25519))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Client))
       .WillOnce(InvokeWithoutArgs([&mockKex]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -351,7 +378,9 @@ TEST_F(ClientProtocolTest, TestConnectPskFlow) {
     return random;
   }));
   MockKeyExchange* mockKex;
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::x25519))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Client))
       .WillOnce(InvokeWithoutArgs([&mockKex]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -442,7 +471,9 @@ TEST_F(ClientProtocolTest, TestConnectPskEarlyFlow) {
     return random;
   }));
   MockKeyExchange* mockKex;
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::x25519))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Client))
       .WillOnce(InvokeWithoutArgs([&mockKex]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -639,6 +670,103 @@ TEST_F(ClientProtocolTest, TestConnectNoAlpn) {
       *state_.encodedClientHello(), encodeHandshake(std::move(chlo))));
 }
 
+TEST_F(ClientProtocolTest, TestConnectContextChangedBetweenConnects) {
+  Connect connect;
+  connect.context = context_;
+  connect.sni = "www.hostname.com";
+  auto actions = detail::processEvent(state_, std::move(connect));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_TRUE(IOBufEqualTo()(
+      *state_.encodedClientHello(),
+      encodeHandshake(getDefaultClientHello())));
+
+  context_->setSupportedAlpns({});
+  state_ = State();
+  Connect secondConnect;
+  secondConnect.context = context_;
+  secondConnect.sni = "www.hostname.com";
+  actions = detail::processEvent(state_, std::move(secondConnect));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  auto chlo = getDefaultClientHello();
+  TestMessages::removeExtension(
+      chlo, ExtensionType::application_layer_protocol_negotiation);
+  EXPECT_TRUE(IOBufEqualTo()(
+      *state_.encodedClientHello(), encodeHandshake(std::move(chlo))));
+}
+
+TEST_F(ClientProtocolTest, TestConnectCertCompression) {
+  auto decompressor = std::make_shared<MockCertificateDecompressor>();
+  EXPECT_CALL(*decompressor, getAlgorithm())
+      .WillRepeatedly(Return(CertificateCompressionAlgorithm::zstd));
+  context_->setCertDecompressors({decompressor});
+  Connect connect;
+  connect.context = context_;
+  connect.sni = "www.hostname.com";
+  auto actions = detail::processEvent(state_, std::move(connect));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+
+  auto encoded = (*state_.encodedClientHello())->clone();
+  encoded->trimStart(4);
+  auto chlo = decode<ClientHello>(std::move(encoded));
+  auto algos = getExtension<CertificateCompressionAlgorithms>(chlo.extensions);
+  ASSERT_TRUE(algos.hasValue());
+  EXPECT_EQ(
+      algos->algorithms,
+      std::vector<CertificateCompressionAlgorithm>(
+          {CertificateCompressionAlgorithm::zstd}));
+}
+
+TEST_F(ClientProtocolTest, TestConnectServerCertTypes) {
+  context_->setServerCertTypes(
+      {CertificateType::RawPublicKey, CertificateType::X509});
+  Connect connect;
+  connect.context = context_;
+  connect.sni = "www.hostname.com";
+  auto actions = detail::processEvent(state_, std::move(connect));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+
+  auto encoded = (*state_.encodedClientHello())->clone();
+  encoded->trimStart(4);
+  auto chlo = decode<ClientHello>(std::move(encoded));
+  auto certTypes = getExtension<ServerCertTypeList>(chlo.extensions);
+  ASSERT_TRUE(certTypes.hasValue());
+  EXPECT_EQ(
+      certTypes->certificate_types,
+      std::vector<CertificateType>(
+          {CertificateType::RawPublicKey, CertificateType::X509}));
+  EXPECT_NE(
+      std::find(
+          state_.requestedExtensions()->begin(),
+          state_.requestedExtensions()->end(),
+          ExtensionType::server_certificate_type),
+      state_.requestedExtensions()->end());
+}
+
+TEST_F(ClientProtocolTest, TestConnectDelegatedCredential) {
+  context_->setSupportedDelegatedCredentialSchemes(
+      {SignatureScheme::ecdsa_secp384r1_sha384});
+  Connect connect;
+  connect.context = context_;
+  connect.sni = "www.hostname.com";
+  auto actions = detail::processEvent(state_, std::move(connect));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+
+  auto encoded = (*state_.encodedClientHello())->clone();
+  encoded->trimStart(4);
+  auto chlo = decode<ClientHello>(std::move(encoded));
+  auto credentialSupport =
+      getExtension<DelegatedCredentialSupport>(chlo.extensions);
+  ASSERT_TRUE(credentialSupport.hasValue());
+  EXPECT_EQ(
+      credentialSupport->supported_signature_algorithms,
+      std::vector<SignatureScheme>{SignatureScheme::ecdsa_secp384r1_sha384});
+}
+
 TEST_F(ClientProtocolTest, TestConnectExtension) {
   Connect connect;
   connect.context = context_;
@@ -671,7 +799,9 @@ TEST_F(ClientProtocolTest, TestConnectExtension) {
 TEST_F(ClientProtocolTest, TestConnectMultipleShares) {
   MockKeyExchange* mockKex1;
   MockKeyExchange* mockKex2;
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::x25519))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Client))
       .WillOnce(InvokeWithoutArgs([&mockKex1]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -681,7 +811,9 @@ TEST_F(ClientProtocolTest, TestConnectMultipleShares) {
         mockKex1 = ret.get();
         return ret;
       }));
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::secp256r1))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::secp256r1, Factory::KeyExchangeMode::Client))
       .WillOnce(InvokeWithoutArgs([&mockKex2]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -705,10 +837,43 @@ TEST_F(ClientProtocolTest, TestConnectMultipleShares) {
   EXPECT_EQ(state_.keyExchangers()->at(NamedGroup::secp256r1).get(), mockKex2);
 }
 
+TEST_F(ClientProtocolTest, TestConnectLazyDefaultShares) {
+  MockKeyExchange* mockKex;
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Client))
+      .WillOnce(InvokeWithoutArgs([&mockKex]() {
+        auto ret = std::make_unique<MockKeyExchange>();
+        EXPECT_CALL(*ret, generateKeyPair());
+        EXPECT_CALL(*ret, getKeyShare()).WillOnce(InvokeWithoutArgs([]() {
+          return IOBuf::copyBuffer("x25519share");
+        }));
+        mockKex = ret.get();
+        return ret;
+      }));
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::secp256r1, Factory::KeyExchangeMode::Client))
+      .Times(0);
+
+  context_->setDefaultShares({NamedGroup::x25519, NamedGroup::secp256r1});
+  context_->setLazyDefaultShares(true);
+  Connect connect;
+  connect.context = context_;
+  connect.sni = "www.hostname.com";
+  auto actions = detail::processEvent(state_, std::move(connect));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.keyExchangers()->size(), 1);
+  EXPECT_EQ(state_.keyExchangers()->at(NamedGroup::x25519).get(), mockKex);
+}
+
 TEST_F(ClientProtocolTest, TestConnectCachedGroup) {
   context_->setDefaultShares({NamedGroup::x25519});
   MockKeyExchange* mockKex;
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::secp256r1))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::secp256r1, Factory::KeyExchangeMode::Client))
       .WillOnce(InvokeWithoutArgs([&mockKex]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -733,6 +898,53 @@ TEST_F(ClientProtocolTest, TestConnectCachedGroup) {
   EXPECT_EQ(state_.keyExchangers()->at(NamedGroup::secp256r1).get(), mockKex);
 }
 
+TEST_F(ClientProtocolTest, TestConnectCachedGroupNoPsk) {
+  context_->setDefaultShares({NamedGroup::x25519});
+  EXPECT_CALL(*pskCache_, getKeyShareGroup("www.hostname.com"))
+      .WillOnce(Return(NamedGroup::secp256r1));
+  MockKeyExchange* mockKex;
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::secp256r1, Factory::KeyExchangeMode::Client))
+      .WillOnce(InvokeWithoutArgs([&mockKex]() {
+        auto ret = std::make_unique<MockKeyExchange>();
+        EXPECT_CALL(*ret, generateKeyPair());
+        EXPECT_CALL(*ret, getKeyShare()).WillOnce(InvokeWithoutArgs([]() {
+          return IOBuf::copyBuffer("p256share");
+        }));
+        mockKex = ret.get();
+        return ret;
+      }));
+
+  Connect connect;
+  connect.context = context_;
+  connect.sni = "www.hostname.com";
+  auto actions = detail::processEvent(state_, std::move(connect));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.keyExchangers()->size(), 1);
+  EXPECT_EQ(state_.keyExchangers()->at(NamedGroup::secp256r1).get(), mockKex);
+}
+
+TEST_F(ClientProtocolTest, TestConnectCachedGroupUnsupported) {
+  context_->setDefaultShares({NamedGroup::x25519});
+  context_->setSupportedGroups({NamedGroup::x25519});
+  EXPECT_CALL(*pskCache_, getKeyShareGroup("www.hostname.com"))
+      .WillOnce(Return(NamedGroup::secp256r1));
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Client));
+
+  Connect connect;
+  connect.context = context_;
+  connect.sni = "www.hostname.com";
+  auto actions = detail::processEvent(state_, std::move(connect));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.keyExchangers()->size(), 1);
+  EXPECT_EQ(state_.keyExchangers()->count(NamedGroup::x25519), 1);
+}
+
 TEST_F(ClientProtocolTest, TestConnectNoShares) {
   context_->setDefaultShares({});
   Connect connect;
@@ -840,6 +1052,7 @@ TEST_F(ClientProtocolTest, TestConnectCompatEarly) {
 
 TEST_F(ClientProtocolTest, TestServerHelloFlow) {
   setupExpectingServerHello();
+  EXPECT_CALL(*pskCache_, putKeyShareGroup(_, _)).Times(0);
   mockKeyScheduler_ = new MockKeyScheduler();
   mockHandshakeContext_ = new MockHandshakeContext();
   EXPECT_CALL(*factory_, makeKeyScheduler(CipherSuite::TLS_AES_128_GCM_SHA256))
@@ -918,6 +1131,8 @@ TEST_F(ClientProtocolTest, TestServerHelloFlow) {
 
 TEST_F(ClientProtocolTest, TestServerHelloAfterHrrFlow) {
   setupExpectingServerHelloAfterHrr();
+  EXPECT_CALL(
+      *pskCache_, putKeyShareGroup("www.hostname.com", NamedGroup::x25519));
   mockKeyScheduler_ = new MockKeyScheduler();
   EXPECT_CALL(*factory_, makeKeyScheduler(CipherSuite::TLS_AES_128_GCM_SHA256))
       .WillOnce(InvokeWithoutArgs(
@@ -1468,7 +1683,9 @@ TEST_F(ClientProtocolTest, TestHelloRetryRequestFlow) {
   EXPECT_CALL(*mockHandshakeContext2, appendToTranscript(_))
       .InSequence(contextSeq);
   MockKeyExchange* mockKex;
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::secp256r1))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::secp256r1, Factory::KeyExchangeMode::Client))
       .WillOnce(InvokeWithoutArgs([&mockKex]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -1575,7 +1792,9 @@ TEST_F(ClientProtocolTest, TestHelloRetryRequestPskFlow) {
   EXPECT_CALL(*mockHandshakeContext2, appendToTranscript(_))
       .InSequence(contextSeq);
   MockKeyExchange* mockKex;
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::secp256r1))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::secp256r1, Factory::KeyExchangeMode::Client))
       .WillOnce(InvokeWithoutArgs([&mockKex]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -1814,6 +2033,38 @@ TEST_F(ClientProtocolTest, TestEncryptedExtensionsNoAlpn) {
   EXPECT_EQ(state_.state(), StateEnum::ExpectingCertificate);
 }
 
+TEST_F(ClientProtocolTest, TestEncryptedExtensionsServerCertType) {
+  context_->setServerCertTypes({CertificateType::RawPublicKey});
+  setupExpectingEncryptedExtensions();
+  state_.requestedExtensions()->push_back(
+      ExtensionType::server_certificate_type);
+  auto ee = TestMessages::encryptedExt();
+  ServerCertType certType;
+  certType.certificate_type = CertificateType::RawPublicKey;
+  ee.extensions.push_back(encodeExtension(std::move(certType)));
+  auto actions = detail::processEvent(state_, std::move(ee));
+  expectActions<MutateState>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(*state_.serverCertType(), CertificateType::RawPublicKey);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingCertificate);
+}
+
+TEST_F(ClientProtocolTest, TestEncryptedExtensionsServerCertTypeNotOffered) {
+  context_->setServerCertTypes({CertificateType::X509});
+  setupExpectingEncryptedExtensions();
+  state_.requestedExtensions()->push_back(
+      ExtensionType::server_certificate_type);
+  auto ee = TestMessages::encryptedExt();
+  ServerCertType certType;
+  certType.certificate_type = CertificateType::RawPublicKey;
+  ee.extensions.push_back(encodeExtension(std::move(certType)));
+  auto actions = detail::processEvent(state_, std::move(ee));
+  expectError(
+      actions,
+      AlertDescription::illegal_parameter,
+      "unoffered certificate type");
+}
+
 TEST_F(ClientProtocolTest, TestEncryptedExtensionsDisallowedExtension) {
   setupExpectingEncryptedExtensions();
   auto ee = TestMessages::encryptedExt();
@@ -1911,8 +2162,6 @@ TEST_F(ClientProtocolTest, TestCertificateFlow) {
   mockIntermediate_ = std::make_shared<MockPeerCert>();
   EXPECT_CALL(*factory_, _makePeerCert(BufMatches("cert1")))
       .WillOnce(Return(mockLeaf_));
-  EXPECT_CALL(*factory_, _makePeerCert(BufMatches("cert2")))
-      .WillOnce(Return(mockIntermediate_));
 
   auto certificate = TestMessages::certificate();
   CertificateEntry entry1;
@@ -1927,8 +2176,13 @@ TEST_F(ClientProtocolTest, TestCertificateFlow) {
   processStateMutations(actions);
   EXPECT_EQ(state_.unverifiedCertChain()->size(), 2);
   EXPECT_EQ(state_.unverifiedCertChain()->at(0), mockLeaf_);
-  EXPECT_EQ(state_.unverifiedCertChain()->at(1), mockIntermediate_);
   EXPECT_EQ(state_.state(), StateEnum::ExpectingCertificateVerify);
+
+  // The intermediate is only parsed once it is used.
+  EXPECT_CALL(*factory_, _makePeerCert(BufMatches("cert2")))
+      .WillOnce(Return(mockIntermediate_));
+  EXPECT_CALL(*mockIntermediate_, getIdentity()).WillOnce(Return("ca"));
+  EXPECT_EQ(state_.unverifiedCertChain()->at(1)->getIdentity(), "ca");
 }
 
 TEST_F(ClientProtocolTest, TestCertificate) {
@@ -1963,6 +2217,197 @@ TEST_F(ClientProtocolTest, TestCertificateEmpty) {
   expectError(actions, AlertDescription::illegal_parameter, "no cert");
 }
 
+TEST_F(ClientProtocolTest, TestCertificateRawPublicKey) {
+  setupExpectingCertificate();
+  state_.serverCertType() = CertificateType::RawPublicKey;
+  mockLeaf_ = std::make_shared<MockPeerCert>();
+  EXPECT_CALL(*factory_, _makeRawPublicKeyPeerCert(BufMatches("spki")))
+      .WillOnce(Return(mockLeaf_));
+  auto certificate = TestMessages::certificate();
+  CertificateEntry entry;
+  entry.cert_data = folly::IOBuf::copyBuffer("spki");
+  certificate.certificate_list.push_back(std::move(entry));
+  auto actions = detail::processEvent(state_, std::move(certificate));
+  expectActions<MutateState>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.unverifiedCertChain()->size(), 1);
+  EXPECT_EQ(state_.unverifiedCertChain()->at(0), mockLeaf_);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingCertificateVerify);
+}
+
+TEST_F(ClientProtocolTest, TestCertificateRawPublicKeyMultiple) {
+  setupExpectingCertificate();
+  state_.serverCertType() = CertificateType::RawPublicKey;
+  auto certificate = TestMessages::certificate();
+  CertificateEntry entry1;
+  entry1.cert_data = folly::IOBuf::copyBuffer("spki1");
+  certificate.certificate_list.push_back(std::move(entry1));
+  CertificateEntry entry2;
+  entry2.cert_data = folly::IOBuf::copyBuffer("spki2");
+  certificate.certificate_list.push_back(std::move(entry2));
+  auto actions = detail::processEvent(state_, std::move(certificate));
+  expectError(actions, AlertDescription::illegal_parameter, "raw public key");
+}
+
+TEST_F(ClientProtocolTest, TestCertificateDelegatedCredential) {
+  setupExpectingCertificate();
+  context_->setSupportedDelegatedCredentialSchemes(
+      {SignatureScheme::ecdsa_secp384r1_sha384});
+  auto parent = std::shared_ptr<const SelfCert>(CertUtils::makeSelfCert(
+      kP256DelegationCertificate.str(), kP256Key.str()));
+  auto key = getPrivateKey(kP384Key);
+  auto credential = DelegatedCredentialUtils::generate(
+      *parent,
+      SignatureScheme::ecdsa_secp256r1_sha256,
+      key.get(),
+      SignatureScheme::ecdsa_secp384r1_sha384,
+      std::chrono::hours(1));
+  auto delegated = DelegatedSelfCert::make(parent, kP384Key.str(), credential);
+  EXPECT_CALL(*factory_, _makePeerCert(_)).WillOnce(Invoke([](Buf& certData) {
+    return CertUtils::makePeerCert(std::move(certData));
+  }));
+
+  auto actions =
+      detail::processEvent(state_, delegated->getCertMessage(IOBuf::create(0)));
+  expectActions<MutateState>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.unverifiedCertChain()->size(), 1);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingCertificateVerify);
+
+  auto sig = delegated->sign(
+      SignatureScheme::ecdsa_secp384r1_sha384,
+      CertificateVerifyContext::Server,
+      range(StringPiece("hello")));
+  state_.unverifiedCertChain()->at(0)->verify(
+      SignatureScheme::ecdsa_secp384r1_sha384,
+      CertificateVerifyContext::Server,
+      range(StringPiece("hello")),
+      sig->coalesce());
+}
+
+TEST_F(ClientProtocolTest, TestCertificateDelegatedCredentialNotOffered) {
+  setupExpectingCertificate();
+  auto certificate = TestMessages::certificate();
+  CertificateEntry entry;
+  entry.cert_data = folly::IOBuf::copyBuffer("cert");
+  DelegatedCredential credential;
+  credential.expected_verify_scheme = SignatureScheme::ecdsa_secp384r1_sha384;
+  credential.public_key = IOBuf::copyBuffer("key");
+  credential.credential_scheme = SignatureScheme::ecdsa_secp256r1_sha256;
+  credential.signature = IOBuf::copyBuffer("sig");
+  entry.extensions.push_back(encodeExtension(std::move(credential)));
+  certificate.certificate_list.push_back(std::move(entry));
+  auto actions = detail::processEvent(state_, std::move(certificate));
+  expectError(
+      actions,
+      AlertDescription::illegal_parameter,
+      "certificate extensions must be empty");
+}
+
+TEST_F(ClientProtocolTest, TestCertificateDelegatedCredentialUnsupported) {
+  setupExpectingCertificate();
+  context_->setSupportedDelegatedCredentialSchemes(
+      {SignatureScheme::ecdsa_secp256r1_sha256});
+  auto certificate = TestMessages::certificate();
+  CertificateEntry entry;
+  entry.cert_data = folly::IOBuf::copyBuffer("cert");
+  DelegatedCredential credential;
+  credential.expected_verify_scheme = SignatureScheme::ecdsa_secp384r1_sha384;
+  credential.public_key = IOBuf::copyBuffer("key");
+  credential.credential_scheme = SignatureScheme::ecdsa_secp256r1_sha256;
+  credential.signature = IOBuf::copyBuffer("sig");
+  entry.extensions.push_back(encodeExtension(std::move(credential)));
+  certificate.certificate_list.push_back(std::move(entry));
+  auto actions = detail::processEvent(state_, std::move(certificate));
+  expectError(
+      actions,
+      AlertDescription::illegal_parameter,
+      "unsupported delegated credential scheme");
+}
+
+TEST_F(ClientProtocolTest, TestCertificateDelegatedCredentialInvalid) {
+  setupExpectingCertificate();
+  context_->setSupportedDelegatedCredentialSchemes(
+      {SignatureScheme::ecdsa_secp384r1_sha384});
+  auto parent = std::shared_ptr<const SelfCert>(CertUtils::makeSelfCert(
+      kP256DelegationCertificate.str(), kP256Key.str()));
+  auto key = getPrivateKey(kP384Key);
+  auto credential = DelegatedCredentialUtils::generate(
+      *parent,
+      SignatureScheme::ecdsa_secp256r1_sha256,
+      key.get(),
+      SignatureScheme::ecdsa_secp384r1_sha384,
+      std::chrono::hours(1));
+  credential.valid_time++;
+  auto delegated =
+      DelegatedSelfCert::make(parent, kP384Key.str(), std::move(credential));
+  EXPECT_CALL(*factory_, _makePeerCert(_)).WillOnce(Invoke([](Buf& certData) {
+    return CertUtils::makePeerCert(std::move(certData));
+  }));
+
+  auto actions =
+      detail::processEvent(state_, delegated->getCertMessage(IOBuf::create(0)));
+  expectError(
+      actions,
+      AlertDescription::illegal_parameter,
+      "invalid delegated credential");
+}
+
+TEST_F(ClientProtocolTest, TestCompressedCertificateFlow) {
+  setupExpectingCertificate();
+  auto decompressor = std::make_shared<MockCertificateDecompressor>();
+  EXPECT_CALL(*decompressor, getAlgorithm())
+      .WillRepeatedly(Return(CertificateCompressionAlgorithm::zstd));
+  context_->setCertDecompressors({decompressor});
+  EXPECT_CALL(
+      *mockHandshakeContext_,
+      appendToTranscript(BufMatches("compcertencoding")));
+  EXPECT_CALL(*decompressor, decompress(_))
+      .WillOnce(Invoke([](const CompressedCertificate& cc) {
+        EXPECT_TRUE(IOBufEqualTo()(
+            cc.compressed_certificate_message,
+            IOBuf::copyBuffer("compressed")));
+        auto certificate = TestMessages::certificate();
+        CertificateEntry entry;
+        entry.cert_data = folly::IOBuf::copyBuffer("cert1");
+        certificate.certificate_list.push_back(std::move(entry));
+        return certificate;
+      }));
+  mockLeaf_ = std::make_shared<MockPeerCert>();
+  EXPECT_CALL(*factory_, _makePeerCert(BufMatches("cert1")))
+      .WillOnce(Return(mockLeaf_));
+
+  auto actions = detail::processEvent(
+      state_, TestMessages::compressedCertificate());
+
+  expectActions<MutateState>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.unverifiedCertChain()->size(), 1);
+  EXPECT_EQ(state_.unverifiedCertChain()->at(0), mockLeaf_);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingCertificateVerify);
+}
+
+TEST_F(ClientProtocolTest, TestCompressedCertificateUnsupportedAlgorithm) {
+  setupExpectingCertificate();
+  auto actions = detail::processEvent(
+      state_, TestMessages::compressedCertificate());
+  expectError(
+      actions, AlertDescription::illegal_parameter, "unsupported algorithm");
+}
+
+TEST_F(ClientProtocolTest, TestCompressedCertificateDecompressionFailure) {
+  setupExpectingCertificate();
+  auto decompressor = std::make_shared<MockCertificateDecompressor>();
+  EXPECT_CALL(*decompressor, getAlgorithm())
+      .WillRepeatedly(Return(CertificateCompressionAlgorithm::zstd));
+  context_->setCertDecompressors({decompressor});
+  EXPECT_CALL(*decompressor, decompress(_))
+      .WillOnce(Throw(std::runtime_error("corrupt")));
+  auto actions = detail::processEvent(
+      state_, TestMessages::compressedCertificate());
+  expectError(actions, AlertDescription::bad_certificate, "corrupt");
+}
+
 TEST_F(ClientProtocolTest, TestCertificateVerifyFlow) {
   setupExpectingCertificateVerify();
   Sequence contextSeq;
@@ -2063,6 +2508,44 @@ TEST_F(ClientProtocolTest, TestCertificateVerifyVerifierFailureOtherException) {
       actions, AlertDescription::bad_certificate, "verifier failure: no good");
 }
 
+TEST_F(ClientProtocolTest, TestCertificateVerifyAsyncVerifier) {
+  setupExpectingCertificateVerify();
+  auto asyncVerifier = std::make_shared<MockAsyncCertificateVerifier>();
+  state_.verifier() = asyncVerifier;
+  folly::Promise<folly::Unit> verification;
+  EXPECT_CALL(*asyncVerifier, verifyFuture(_))
+      .WillOnce(Invoke(
+          [this, &verification](
+              const std::vector<std::shared_ptr<const PeerCert>>& certs) {
+            EXPECT_EQ(certs.size(), 2);
+            EXPECT_EQ(certs[0], mockLeaf_);
+            return verification.getFuture();
+          }));
+  auto actions =
+      detail::processEvent(state_, TestMessages::certificateVerify());
+  expectActions<MutateState>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+  ASSERT_TRUE(state_.pendingCertVerification());
+  EXPECT_FALSE(state_.pendingCertVerification()->isFulfilled());
+  verification.setValue();
+  EXPECT_TRUE(state_.pendingCertVerification()->isFulfilled());
+}
+
+TEST_F(ClientProtocolTest, TestCertificateVerifyAsyncVerifierReadyFailure) {
+  setupExpectingCertificateVerify();
+  auto asyncVerifier = std::make_shared<MockAsyncCertificateVerifier>();
+  state_.verifier() = asyncVerifier;
+  EXPECT_CALL(*asyncVerifier, verifyFuture(_))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return folly::makeFuture<folly::Unit>(std::runtime_error("no good"));
+      }));
+  auto actions =
+      detail::processEvent(state_, TestMessages::certificateVerify());
+  expectError(
+      actions, AlertDescription::bad_certificate, "verifier failure: no good");
+}
+
 TEST_F(ClientProtocolTest, TestCertificateRequestNoCert) {
   setupExpectingCertificate();
   auto certificateRequest = TestMessages::certificateRequest();
@@ -2573,6 +3056,166 @@ TEST_F(ClientProtocolTest, TestAppData) {
   expectSingleAction<DeliverAppData>(std::move(actions));
 }
 
+TEST_F(ClientProtocolTest, TestSocketDataAppData) {
+  setupAcceptingData();
+  EXPECT_CALL(*mockRead_, read(_)).WillOnce(InvokeWithoutArgs([]() {
+    TLSMessage msg;
+    msg.type = ContentType::application_data;
+    msg.fragment = IOBuf::copyBuffer("appdata");
+    return msg;
+  }));
+
+  IOBufQueue queue;
+  auto actions =
+      getActions(ClientStateMachine().processSocketData(state_, queue));
+
+  auto appData = expectSingleAction<DeliverAppData>(std::move(actions));
+  EXPECT_TRUE(IOBufEqualTo()(appData.data, IOBuf::copyBuffer("appdata")));
+}
+
+TEST_F(ClientProtocolTest, TestSocketDataFinishedWaitsForCertVerification) {
+  setupExpectingFinished();
+  auto verification = std::make_shared<folly::SharedPromise<folly::Unit>>();
+  state_.pendingCertVerification() = verification;
+  EXPECT_CALL(*mockRead_, read(_)).WillOnce(InvokeWithoutArgs([]() {
+    TLSMessage msg;
+    msg.type = ContentType::handshake;
+    msg.fragment = encodeHandshake(TestMessages::finished());
+    return msg;
+  }));
+
+  IOBufQueue queue;
+  auto asyncActions = ClientStateMachine().processSocketData(state_, queue);
+  auto futureActions = boost::get<folly::Future<Actions>>(&asyncActions);
+  ASSERT_TRUE(futureActions);
+  EXPECT_FALSE(futureActions->isReady());
+
+  verification->setValue();
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState, ReportHandshakeSuccess, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::Established);
+  EXPECT_FALSE(state_.pendingCertVerification());
+}
+
+TEST_F(ClientProtocolTest, TestSocketDataFinishedCertVerificationExecutor) {
+  setupExpectingFinished();
+  folly::ManualExecutor executor;
+  state_.executor() = &executor;
+  auto verification = std::make_shared<folly::SharedPromise<folly::Unit>>();
+  state_.pendingCertVerification() = verification;
+  EXPECT_CALL(*mockRead_, read(_)).WillOnce(InvokeWithoutArgs([]() {
+    TLSMessage msg;
+    msg.type = ContentType::handshake;
+    msg.fragment = encodeHandshake(TestMessages::finished());
+    return msg;
+  }));
+
+  IOBufQueue queue;
+  auto asyncActions = ClientStateMachine().processSocketData(state_, queue);
+  auto futureActions = boost::get<folly::Future<Actions>>(&asyncActions);
+  ASSERT_TRUE(futureActions);
+
+  verification->setValue();
+  EXPECT_FALSE(futureActions->isReady());
+  executor.drain();
+  ASSERT_TRUE(futureActions->isReady());
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState, ReportHandshakeSuccess, WriteToSocket>(actions);
+}
+
+TEST_F(ClientProtocolTest, TestSocketDataFinishedCertVerificationFailure) {
+  setupExpectingFinished();
+  auto verification = std::make_shared<folly::SharedPromise<folly::Unit>>();
+  state_.pendingCertVerification() = verification;
+  EXPECT_CALL(*mockRead_, read(_)).WillOnce(InvokeWithoutArgs([]() {
+    TLSMessage msg;
+    msg.type = ContentType::handshake;
+    msg.fragment = encodeHandshake(TestMessages::finished());
+    return msg;
+  }));
+
+  IOBufQueue queue;
+  auto asyncActions = ClientStateMachine().processSocketData(state_, queue);
+  verification->setException(std::runtime_error("no good"));
+  auto actions = getActions(std::move(asyncActions));
+  expectError(
+      actions, AlertDescription::bad_certificate, "verifier failure: no good");
+}
+
+TEST_F(ClientProtocolTest, TestSocketDataServerHelloSyncKeyExchange) {
+  setupExpectingServerHello();
+  folly::ManualExecutor executor;
+  state_.executor() = &executor;
+  EXPECT_CALL(*mockRead_, read(_)).WillOnce(InvokeWithoutArgs([]() {
+    TLSMessage msg;
+    msg.type = ContentType::handshake;
+    msg.fragment = encodeHandshake(TestMessages::serverHello());
+    return msg;
+  }));
+  EXPECT_CALL(*mockKex_, generateSharedSecret(_)).Times(1);
+
+  IOBufQueue queue;
+  auto asyncActions = ClientStateMachine().processSocketData(state_, queue);
+  ASSERT_TRUE(boost::get<Actions>(&asyncActions));
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingEncryptedExtensions);
+}
+
+TEST_F(ClientProtocolTest, TestSocketDataServerHelloAsyncKeyExchange) {
+  setupExpectingServerHello();
+  folly::ManualExecutor executor;
+  state_.executor() = &executor;
+  folly::Promise<std::unique_ptr<IOBuf>> sharedSecret;
+  auto mockKex = std::make_unique<MockAsyncKeyExchange>();
+  mockKex->setDefaults();
+  EXPECT_CALL(*mockKex, generateSharedSecret(_)).Times(0);
+  EXPECT_CALL(*mockKex, generateSharedSecretAsync(_))
+      .WillOnce(InvokeWithoutArgs(
+          [&sharedSecret]() { return sharedSecret.getSemiFuture(); }));
+  std::map<NamedGroup, std::unique_ptr<KeyExchange>> kexs;
+  kexs.emplace(NamedGroup::x25519, std::move(mockKex));
+  state_.keyExchangers() = std::move(kexs);
+  EXPECT_CALL(*mockRead_, read(_)).WillOnce(InvokeWithoutArgs([]() {
+    TLSMessage msg;
+    msg.type = ContentType::handshake;
+    msg.fragment = encodeHandshake(TestMessages::serverHello());
+    return msg;
+  }));
+
+  IOBufQueue queue;
+  auto asyncActions = ClientStateMachine().processSocketData(state_, queue);
+  auto futureActions = boost::get<folly::Future<Actions>>(&asyncActions);
+  ASSERT_TRUE(futureActions);
+  EXPECT_FALSE(futureActions->isReady());
+
+  sharedSecret.setValue(IOBuf::copyBuffer("sharedsecret"));
+  EXPECT_FALSE(futureActions->isReady());
+  executor.drain();
+  ASSERT_TRUE(futureActions->isReady());
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingEncryptedExtensions);
+}
+
+TEST_F(ClientProtocolTest, TestAppWriteStateMachine) {
+  setupAcceptingData();
+  EXPECT_CALL(*mockWrite_, _write(_)).WillOnce(Invoke([](TLSMessage& msg) {
+    EXPECT_EQ(msg.type, ContentType::application_data);
+    EXPECT_TRUE(IOBufEqualTo()(msg.fragment, IOBuf::copyBuffer("appdata")));
+    return IOBuf::copyBuffer("writtenappdata");
+  }));
+
+  auto actions =
+      ClientStateMachine().processAppWrite(state_, TestMessages::appWrite());
+
+  auto write = expectSingleAction<WriteToSocket>(std::move(actions));
+  EXPECT_TRUE(IOBufEqualTo()(write.data, IOBuf::copyBuffer("writtenappdata")));
+}
+
 TEST_F(ClientProtocolTest, TestAppWrite) {
   setupAcceptingData();
   EXPECT_CALL(*mockWrite_, _write(_)).WillOnce(Invoke([](TLSMessage& msg) {
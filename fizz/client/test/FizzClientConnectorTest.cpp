@@ -0,0 +1,227 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/client/FizzClientConnector.h>
+
+#include <fizz/protocol/test/Mocks.h>
+
+namespace fizz {
+namespace client {
+namespace test {
+
+using namespace fizz::test;
+using namespace folly;
+using namespace testing;
+
+static constexpr folly::StringPiece kHostname{"www.hostname.com"};
+
+class TestClient : public AsyncFizzClient {
+ public:
+  using AsyncFizzClient::AsyncFizzClient;
+  using AsyncFizzClient::connect;
+
+  void connect(
+      const folly::SocketAddress&,
+      folly::AsyncSocket::ConnectCallback* callback,
+      std::shared_ptr<const CertificateVerifier>,
+      folly::Optional<std::string> sni,
+      folly::Optional<std::string> pskIdentity,
+      std::chrono::milliseconds,
+      std::chrono::milliseconds,
+      const folly::AsyncSocket::OptionMap&,
+      const folly::SocketAddress&) override {
+    EXPECT_EQ(sni, pskIdentity);
+    connectCallback = callback;
+  }
+
+  folly::AsyncSocket::ConnectCallback* connectCallback{nullptr};
+};
+
+class TestConnector : public FizzClientConnector {
+ public:
+  using FizzClientConnector::FizzClientConnector;
+
+  AsyncFizzClient::UniquePtr makeClient() override {
+    auto client = new TestClient(evb, context);
+    clients.push_back(client);
+    return AsyncFizzClient::UniquePtr(client);
+  }
+
+  folly::EventBase* evb;
+  std::shared_ptr<FizzClientContext> context;
+  std::vector<TestClient*> clients;
+};
+
+class MockConnectorCallback : public FizzClientConnector::Callback {
+ public:
+  MOCK_METHOD0(_fizzConnectSuccess, void());
+  void fizzConnectSuccess(AsyncFizzClient::UniquePtr client) noexcept override {
+    clients.push_back(std::move(client));
+    _fizzConnectSuccess();
+  }
+
+  MOCK_METHOD1(fizzConnectError, void(const folly::AsyncSocketException&));
+
+  std::vector<AsyncFizzClient::UniquePtr> clients;
+};
+
+class FizzClientConnectorTest : public Test {
+ public:
+  void SetUp() override {
+    context_ = std::make_shared<FizzClientContext>();
+    pskCache_ = std::make_shared<BasicPskCache>();
+    context_->setPskCache(pskCache_);
+    makeConnector();
+  }
+
+ protected:
+  void makeConnector() {
+    connector_ = std::make_unique<TestConnector>(&evb_, context_, nullptr);
+    connector_->evb = &evb_;
+    connector_->context = context_;
+  }
+
+  void connect(MockConnectorCallback& callback) {
+    connector_->connect(
+        folly::SocketAddress("127.0.0.1", 443), kHostname.str(), &callback);
+  }
+
+  folly::EventBase evb_;
+  std::shared_ptr<FizzClientContext> context_;
+  std::shared_ptr<BasicPskCache> pskCache_;
+  std::unique_ptr<TestConnector> connector_;
+};
+
+TEST_F(FizzClientConnectorTest, TestConnect) {
+  MockConnectorCallback callback;
+  connect(callback);
+  ASSERT_EQ(connector_->clients.size(), 1);
+  EXPECT_EQ(connector_->getNumPendingConnects(), 1);
+
+  EXPECT_CALL(callback, _fizzConnectSuccess());
+  connector_->clients[0]->connectCallback->connectSuccess();
+  EXPECT_EQ(callback.clients.size(), 1);
+  EXPECT_EQ(connector_->getNumPendingConnects(), 0);
+
+  auto stats = connector_->getOriginStats(kHostname.str());
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(stats->connects, 1);
+  EXPECT_EQ(stats->resumed, 0);
+  EXPECT_TRUE(stats->connectTime);
+  EXPECT_FALSE(connector_->getOriginStats("other.hostname.com"));
+}
+
+TEST_F(FizzClientConnectorTest, TestWaitForTicket) {
+  MockConnectorCallback callback1;
+  MockConnectorCallback callback2;
+  connect(callback1);
+  connect(callback2);
+  EXPECT_EQ(connector_->clients.size(), 1);
+  EXPECT_EQ(connector_->getNumPendingConnects(), 2);
+  EXPECT_EQ(connector_->getOriginStats(kHostname.str())->deferred, 1);
+
+  EXPECT_CALL(callback1, _fizzConnectSuccess());
+  connector_->clients[0]->connectCallback->connectSuccess();
+  EXPECT_EQ(connector_->clients.size(), 1);
+
+  // The ticket usually arrives once the client was handed off.
+  context_->putPsk(kHostname.str(), CachedPsk());
+  connector_->clients[0]->ticketStored();
+  EXPECT_EQ(connector_->clients.size(), 2);
+
+  // Once the origin has given out tickets connects start right away.
+  MockConnectorCallback callback3;
+  connect(callback3);
+  EXPECT_EQ(connector_->clients.size(), 3);
+}
+
+TEST_F(FizzClientConnectorTest, TestWaitTimeout) {
+  connector_->setResumptionWait(std::chrono::milliseconds(10));
+  MockConnectorCallback callback1;
+  MockConnectorCallback callback2;
+  connect(callback1);
+  connect(callback2);
+  EXPECT_EQ(connector_->clients.size(), 1);
+  evb_.loop();
+  EXPECT_EQ(connector_->clients.size(), 2);
+  EXPECT_EQ(connector_->getNumPendingConnects(), 2);
+}
+
+TEST_F(FizzClientConnectorTest, TestNoWait) {
+  connector_->setResumptionWait(std::chrono::milliseconds(0));
+  MockConnectorCallback callback1;
+  MockConnectorCallback callback2;
+  connect(callback1);
+  connect(callback2);
+  EXPECT_EQ(connector_->clients.size(), 2);
+}
+
+TEST_F(FizzClientConnectorTest, TestNoPskCache) {
+  context_->setPskCache(nullptr);
+  makeConnector();
+  MockConnectorCallback callback1;
+  MockConnectorCallback callback2;
+  connect(callback1);
+  connect(callback2);
+  EXPECT_EQ(connector_->clients.size(), 2);
+}
+
+TEST_F(FizzClientConnectorTest, TestErrorReleasesWaiters) {
+  MockConnectorCallback callback1;
+  MockConnectorCallback callback2;
+  connect(callback1);
+  connect(callback2);
+  EXPECT_EQ(connector_->clients.size(), 1);
+
+  EXPECT_CALL(callback1, fizzConnectError(_));
+  connector_->clients[0]->connectCallback->connectErr(
+      folly::AsyncSocketException(
+          folly::AsyncSocketException::NETWORK_ERROR, "oops"));
+  EXPECT_EQ(connector_->clients.size(), 2);
+  EXPECT_EQ(connector_->getOriginStats(kHostname.str())->failures, 1);
+}
+
+TEST_F(FizzClientConnectorTest, TestDestroy) {
+  MockConnectorCallback callback1;
+  MockConnectorCallback callback2;
+  connect(callback1);
+  connect(callback2);
+  EXPECT_CALL(callback1, fizzConnectError(_));
+  EXPECT_CALL(callback2, fizzConnectError(_));
+  connector_.reset();
+  EXPECT_EQ(context_->getPskCache(), pskCache_);
+}
+
+TEST_F(FizzClientConnectorTest, TestTicketAfterDestroy) {
+  MockConnectorCallback callback;
+  connect(callback);
+  EXPECT_CALL(callback, _fizzConnectSuccess());
+  auto client = connector_->clients[0];
+  client->connectCallback->connectSuccess();
+  connector_.reset();
+  client->ticketStored();
+}
+
+TEST_F(FizzClientConnectorTest, TestOtherConnectionsTicket) {
+  MockConnectorCallback callback1;
+  MockConnectorCallback callback2;
+  connect(callback1);
+  connect(callback2);
+  EXPECT_EQ(connector_->clients.size(), 1);
+
+  // Tickets stored by connections the connector didn't make go unnoticed.
+  context_->putPsk(kHostname.str(), CachedPsk());
+  EXPECT_EQ(connector_->clients.size(), 1);
+  EXPECT_EQ(context_->getPskCache(), pskCache_);
+}
+} // namespace test
+} // namespace client
+} // namespace fizz
@@ -91,6 +91,21 @@ TEST_F(FizzClientTest, TestConnectPskIdentity) {
   fizzClient_->fizzClient_.connect(
       context_, nullptr, sni, std::move(cachedPsk));
 }
+
+TEST_F(FizzClientTest, TestPrepareConnect) {
+  EXPECT_CALL(
+      *MockClientStateMachineInstance::instance,
+      _processConnect(_, _, _, _, _, _))
+      .WillOnce(InvokeWithoutArgs([] { return Actions(); }));
+  const auto sni = std::string("www.example.com");
+  fizzClient_->fizzClient_.prepareConnect(context_, nullptr, sni, folly::none);
+  EXPECT_TRUE(fizzClient_->fizzClient_.hasPreparedConnect());
+  EXPECT_FALSE(fizzClient_->fizzClient_.actionProcessing());
+
+  fizzClient_->fizzClient_.connectPrepared();
+  EXPECT_FALSE(fizzClient_->fizzClient_.hasPreparedConnect());
+  EXPECT_THROW(fizzClient_->fizzClient_.connectPrepared(), std::runtime_error);
+}
 } // namespace test
 } // namespace client
 } // namespace fizz
@@ -42,7 +42,7 @@ class MockClientStateMachine : public ClientStateMachine {
   MOCK_METHOD2(
       _processSocketData,
       folly::Optional<Actions>(const State&, folly::IOBufQueue&));
-  Actions processSocketData(const State& state, folly::IOBufQueue& queue)
+  AsyncActions processSocketData(const State& state, folly::IOBufQueue& queue)
       override {
     return *_processSocketData(state, queue);
   }
@@ -111,6 +111,19 @@ class MockPskCache : public PskCache {
   MOCK_METHOD1(getPsk, folly::Optional<CachedPsk>(const std::string& identity));
   MOCK_METHOD2(putPsk, void(const std::string& identity, CachedPsk));
   MOCK_METHOD1(removePsk, void(const std::string& identity));
+  MOCK_METHOD1(
+      getKeyShareGroup,
+      folly::Optional<NamedGroup>(const std::string& identity));
+  MOCK_METHOD2(
+      putKeyShareGroup,
+      void(const std::string& identity, NamedGroup group));
+};
+
+class MockAsyncPskCache : public MockPskCache {
+ public:
+  MOCK_METHOD1(
+      getPskFuture,
+      folly::Future<folly::Optional<CachedPsk>>(const std::string& identity));
 };
 
 class MockClientExtensions : public ClientExtensions {
@@ -0,0 +1,130 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/client/MultiTicketPskCache.h>
+#include <fizz/client/test/Utilities.h>
+#include <folly/Format.h>
+
+#include <set>
+#include <thread>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace client {
+namespace test {
+
+class MultiTicketPskCacheTest : public Test {
+ public:
+  void SetUp() override {
+    cache_ = std::make_unique<MultiTicketPskCache>(2, 3);
+    ticketTime_ = std::chrono::system_clock::now();
+  }
+
+ protected:
+  CachedPsk getCachedPsk(std::string pskName = "PSK") {
+    return getTestPsk(pskName, ticketTime_);
+  }
+
+  std::unique_ptr<MultiTicketPskCache> cache_;
+  std::chrono::system_clock::time_point ticketTime_;
+};
+
+TEST_F(MultiTicketPskCacheTest, TestBasic) {
+  auto psk = getCachedPsk();
+  cache_->putPsk("fizz", psk);
+  auto cachedPsk = cache_->getPsk("fizz");
+  EXPECT_TRUE(cachedPsk);
+  pskEq(psk, *cachedPsk);
+  EXPECT_FALSE(cache_->getPsk("fizz"));
+}
+
+TEST_F(MultiTicketPskCacheTest, TestDistinctTickets) {
+  cache_->putPsk("fizz", getCachedPsk("psk 1"));
+  cache_->putPsk("fizz", getCachedPsk("psk 2"));
+  EXPECT_EQ(cache_->getNumPsks("fizz"), 2);
+  EXPECT_EQ(cache_->getPsk("fizz")->psk, "psk 1");
+  EXPECT_EQ(cache_->getPsk("fizz")->psk, "psk 2");
+  EXPECT_FALSE(cache_->getPsk("fizz"));
+  EXPECT_EQ(cache_->getNumPsks("fizz"), 0);
+}
+
+TEST_F(MultiTicketPskCacheTest, TestTicketsPerIdentityLimit) {
+  for (int i = 0; i < 5; i++) {
+    auto pskName = folly::sformat("psk {}", i);
+    cache_->putPsk("fizz", getCachedPsk(pskName));
+  }
+  EXPECT_EQ(cache_->getNumPsks("fizz"), 3);
+  EXPECT_EQ(cache_->getPsk("fizz")->psk, "psk 2");
+}
+
+TEST_F(MultiTicketPskCacheTest, TestExpiredSkipped) {
+  cache_->putPsk(
+      "fizz", getTestPsk("old", ticketTime_ - std::chrono::seconds(20)));
+  cache_->putPsk("fizz", getCachedPsk("new"));
+  EXPECT_EQ(cache_->getPsk("fizz")->psk, "new");
+  EXPECT_EQ(cache_->getNumPsks("fizz"), 0);
+}
+
+TEST_F(MultiTicketPskCacheTest, TestRemove) {
+  cache_->putPsk("fizz", getCachedPsk("psk 1"));
+  cache_->putPsk("fizz", getCachedPsk("psk 2"));
+  cache_->removePsk("fizz");
+  EXPECT_FALSE(cache_->getPsk("fizz"));
+}
+
+TEST_F(MultiTicketPskCacheTest, TestIdentityEviction) {
+  cache_->putPsk("fizz 1", getCachedPsk());
+  cache_->putPsk("fizz 2", getCachedPsk());
+  cache_->putPsk("fizz 3", getCachedPsk());
+  EXPECT_FALSE(cache_->getPsk("fizz 1"));
+  EXPECT_TRUE(cache_->getPsk("fizz 2"));
+  EXPECT_TRUE(cache_->getPsk("fizz 3"));
+}
+
+TEST_F(MultiTicketPskCacheTest, TestKeyShareGroup) {
+  EXPECT_FALSE(cache_->getKeyShareGroup("fizz"));
+  cache_->putKeyShareGroup("fizz", NamedGroup::secp256r1);
+  EXPECT_EQ(*cache_->getKeyShareGroup("fizz"), NamedGroup::secp256r1);
+}
+
+TEST_F(MultiTicketPskCacheTest, TestConcurrentConnects) {
+  cache_ = std::make_unique<MultiTicketPskCache>(2, 100);
+  for (int i = 0; i < 100; i++) {
+    cache_->putPsk("fizz", getCachedPsk(folly::sformat("psk {}", i)));
+  }
+  std::vector<std::vector<std::string>> handedOut(4);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([this, &handedOut, t]() {
+      while (auto psk = cache_->getPsk("fizz")) {
+        handedOut[t].push_back(psk->psk);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::set<std::string> all;
+  for (auto& names : handedOut) {
+    all.insert(names.begin(), names.end());
+  }
+  EXPECT_EQ(all.size(), 100);
+}
+
+TEST_F(MultiTicketPskCacheTest, TestNoTickets) {
+  EXPECT_THROW(MultiTicketPskCache(10, 0), std::runtime_error);
+}
+
+} // namespace test
+} // namespace client
+} // namespace fizz
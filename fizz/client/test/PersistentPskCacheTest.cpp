@@ -0,0 +1,177 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/client/PersistentPskCache.h>
+#include <fizz/client/test/Utilities.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/experimental/TestUtil.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace client {
+namespace test {
+
+class PersistentPskCacheTest : public Test {
+ public:
+  void SetUp() override {
+    path_ = (dir_.path() / "psks").string();
+    // Stored times have millisecond precision.
+    ticketTime_ = std::chrono::time_point_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now());
+  }
+
+ protected:
+  CachedPsk getCachedPsk(std::string pskName = "PSK") {
+    return getTestPsk(pskName, ticketTime_);
+  }
+
+  std::unique_ptr<PersistentPskCache> makeCache(uint64_t maxEntries = 3) {
+    return std::make_unique<PersistentPskCache>(path_, maxEntries);
+  }
+
+  folly::test::TemporaryDirectory dir_;
+  std::string path_;
+  std::chrono::system_clock::time_point ticketTime_;
+};
+
+TEST_F(PersistentPskCacheTest, TestBasic) {
+  auto cache = makeCache();
+  auto psk = getCachedPsk();
+  cache->putPsk("fizz", psk);
+  auto cachedPsk = cache->getPsk("fizz");
+  EXPECT_TRUE(cachedPsk);
+  pskEq(psk, *cachedPsk);
+
+  cache->removePsk("fizz");
+  EXPECT_FALSE(cache->getPsk("fizz"));
+}
+
+TEST_F(PersistentPskCacheTest, TestPersisted) {
+  auto psk = getCachedPsk();
+  psk.serverCert = std::make_shared<IdentityCert>("www.example.com");
+  {
+    auto cache = makeCache();
+    cache->putPsk("fizz", psk);
+    cache->putPsk("removed", getCachedPsk("removed"));
+    cache->removePsk("removed");
+  }
+
+  auto cache = makeCache();
+  auto cachedPsk = cache->getPsk("fizz");
+  ASSERT_TRUE(cachedPsk);
+  pskEq(psk, *cachedPsk);
+  ASSERT_TRUE(cachedPsk->serverCert);
+  EXPECT_EQ(cachedPsk->serverCert->getIdentity(), "www.example.com");
+  EXPECT_FALSE(cachedPsk->clientCert);
+  EXPECT_FALSE(cache->getPsk("removed"));
+}
+
+TEST_F(PersistentPskCacheTest, TestNoGroupOrAlpn) {
+  auto psk = getCachedPsk();
+  psk.group = folly::none;
+  psk.alpn = folly::none;
+  makeCache()->putPsk("fizz", psk);
+
+  auto cachedPsk = makeCache()->getPsk("fizz");
+  ASSERT_TRUE(cachedPsk);
+  pskEq(psk, *cachedPsk);
+}
+
+TEST_F(PersistentPskCacheTest, TestExpiredPruned) {
+  auto expired = getCachedPsk("expired");
+  expired.ticketExpirationTime =
+      std::chrono::system_clock::now() - std::chrono::seconds(1);
+  {
+    auto cache = makeCache();
+    cache->putPsk("expired", expired);
+    cache->putPsk("fizz", getCachedPsk());
+    EXPECT_FALSE(cache->getPsk("expired"));
+  }
+
+  auto cache = makeCache();
+  EXPECT_FALSE(cache->getPsk("expired"));
+  EXPECT_TRUE(cache->getPsk("fizz"));
+}
+
+TEST_F(PersistentPskCacheTest, TestTruncatedRecord) {
+  {
+    auto cache = makeCache();
+    cache->putPsk("fizz", getCachedPsk());
+    cache->putPsk("truncated", getCachedPsk("truncated"));
+  }
+  std::string contents;
+  ASSERT_TRUE(folly::readFile(path_.c_str(), contents));
+  contents.resize(contents.size() - 5);
+  ASSERT_TRUE(folly::writeFile(contents, path_.c_str()));
+
+  {
+    auto cache = makeCache();
+    EXPECT_TRUE(cache->getPsk("fizz"));
+    EXPECT_FALSE(cache->getPsk("truncated"));
+    cache->putPsk("after", getCachedPsk("after"));
+  }
+
+  auto cache = makeCache();
+  EXPECT_TRUE(cache->getPsk("fizz"));
+  EXPECT_TRUE(cache->getPsk("after"));
+}
+
+TEST_F(PersistentPskCacheTest, TestCorruptRecord) {
+  makeCache()->putPsk("fizz", getCachedPsk());
+  std::string contents;
+  ASSERT_TRUE(folly::readFile(path_.c_str(), contents));
+  contents[contents.size() - 1] ^= 0x01;
+  ASSERT_TRUE(folly::writeFile(contents, path_.c_str()));
+
+  EXPECT_FALSE(makeCache()->getPsk("fizz"));
+}
+
+TEST_F(PersistentPskCacheTest, TestEvictionAndCompaction) {
+  {
+    auto cache = makeCache();
+    for (int round = 0; round < 3; round++) {
+      for (int i : {1, 2, 3, 4}) {
+        auto pskName = folly::sformat("psk {}", i);
+        cache->putPsk(pskName, getCachedPsk(pskName));
+      }
+    }
+    EXPECT_FALSE(cache->getPsk("psk 1"));
+  }
+  std::string contents;
+  ASSERT_TRUE(folly::readFile(path_.c_str(), contents));
+  // Every record holds the secret once, compaction keeps the file bounded.
+  size_t records = 0;
+  for (auto pos = contents.find("resumptionsecret"); pos != std::string::npos;
+       pos = contents.find("resumptionsecret", pos + 1)) {
+    records++;
+  }
+  EXPECT_LE(records, 6);
+
+  auto cache = makeCache();
+  EXPECT_FALSE(cache->getPsk("psk 1"));
+  EXPECT_TRUE(cache->getPsk("psk 2"));
+  EXPECT_TRUE(cache->getPsk("psk 3"));
+  EXPECT_TRUE(cache->getPsk("psk 4"));
+}
+
+TEST_F(PersistentPskCacheTest, TestKeyShareGroup) {
+  auto cache = makeCache();
+  EXPECT_FALSE(cache->getKeyShareGroup("fizz"));
+  cache->putKeyShareGroup("fizz", NamedGroup::secp256r1);
+  EXPECT_EQ(*cache->getKeyShareGroup("fizz"), NamedGroup::secp256r1);
+}
+
+} // namespace test
+} // namespace client
+} // namespace fizz
@@ -0,0 +1,105 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/client/ShardedLruPskCache.h>
+#include <fizz/client/test/Utilities.h>
+#include <folly/Format.h>
+
+#include <thread>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace client {
+namespace test {
+
+class ShardedLruPskCacheTest : public Test {
+ public:
+  void SetUp() override {
+    cache_ = std::make_unique<ShardedLruPskCache>(64, 4);
+    ticketTime_ = std::chrono::system_clock::now();
+  }
+
+ protected:
+  CachedPsk getCachedPsk(std::string pskName = "PSK") {
+    return getTestPsk(pskName, ticketTime_);
+  }
+
+  std::unique_ptr<ShardedLruPskCache> cache_;
+  std::chrono::system_clock::time_point ticketTime_;
+};
+
+TEST_F(ShardedLruPskCacheTest, TestBasic) {
+  EXPECT_EQ(cache_->getNumShards(), 4);
+  auto psk = getCachedPsk();
+  cache_->putPsk("fizz", psk);
+  auto cachedPsk = cache_->getPsk("fizz");
+  EXPECT_TRUE(cachedPsk);
+  pskEq(psk, *cachedPsk);
+
+  cache_->removePsk("fizz");
+  EXPECT_FALSE(cache_->getPsk("fizz"));
+}
+
+TEST_F(ShardedLruPskCacheTest, TestKeyShareGroup) {
+  EXPECT_FALSE(cache_->getKeyShareGroup("fizz"));
+  cache_->putKeyShareGroup("fizz", NamedGroup::secp256r1);
+  EXPECT_EQ(*cache_->getKeyShareGroup("fizz"), NamedGroup::secp256r1);
+}
+
+TEST_F(ShardedLruPskCacheTest, TestManyIdentities) {
+  for (int i = 0; i < 32; i++) {
+    auto pskName = folly::sformat("psk {}", i);
+    cache_->putPsk(pskName, getCachedPsk(pskName));
+  }
+  for (int i = 0; i < 32; i++) {
+    auto pskName = folly::sformat("psk {}", i);
+    auto cachedPsk = cache_->getPsk(pskName);
+    ASSERT_TRUE(cachedPsk);
+    EXPECT_EQ(cachedPsk->psk, pskName);
+  }
+}
+
+TEST_F(ShardedLruPskCacheTest, TestEvictionPerShard) {
+  cache_ = std::make_unique<ShardedLruPskCache>(1, 1);
+  cache_->putPsk("psk 1", getCachedPsk("psk 1"));
+  cache_->putPsk("psk 2", getCachedPsk("psk 2"));
+  EXPECT_FALSE(cache_->getPsk("psk 1"));
+  EXPECT_TRUE(cache_->getPsk("psk 2"));
+}
+
+TEST_F(ShardedLruPskCacheTest, TestConcurrentAccess) {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([this, t]() {
+      for (int i = 0; i < 100; i++) {
+        auto pskName = folly::sformat("psk {} {}", t, i % 8);
+        cache_->putPsk(pskName, getCachedPsk(pskName));
+        auto cachedPsk = cache_->getPsk(pskName);
+        if (cachedPsk) {
+          EXPECT_EQ(cachedPsk->psk, pskName);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST_F(ShardedLruPskCacheTest, TestNoShards) {
+  EXPECT_THROW(ShardedLruPskCache(10, 0), std::runtime_error);
+}
+
+} // namespace test
+} // namespace client
+} // namespace fizz
@@ -47,6 +47,17 @@ TEST_F(SynchronizedLruPskCacheTest, TestBasic) {
   EXPECT_FALSE(cache_->getPsk("fizz"));
 }
 
+TEST_F(SynchronizedLruPskCacheTest, TestKeyShareGroup) {
+  EXPECT_FALSE(cache_->getKeyShareGroup("fizz"));
+  cache_->putKeyShareGroup("fizz", NamedGroup::secp256r1);
+  EXPECT_EQ(*cache_->getKeyShareGroup("fizz"), NamedGroup::secp256r1);
+
+  // Independent of the PSKs for the same identity.
+  cache_->putPsk("fizz", getCachedPsk());
+  cache_->removePsk("fizz");
+  EXPECT_EQ(*cache_->getKeyShareGroup("fizz"), NamedGroup::secp256r1);
+}
+
 TEST_F(SynchronizedLruPskCacheTest, TestEviction) {
   for (int i : {1, 2, 3}) {
     auto pskName = folly::sformat("psk {}", i);
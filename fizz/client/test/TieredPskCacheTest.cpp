@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/client/TieredPskCache.h>
+#include <fizz/client/test/Mocks.h>
+#include <fizz/client/test/Utilities.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace client {
+namespace test {
+
+class TieredPskCacheTest : public Test {
+ public:
+  void SetUp() override {
+    local_ = std::make_shared<BasicPskCache>();
+    remote_ = std::make_shared<MockAsyncPskCache>();
+    cache_ = std::make_unique<TieredPskCache>(local_, remote_);
+  }
+
+ protected:
+  CachedPsk getCachedPsk(std::string pskName = "PSK") {
+    return getTestPsk(pskName, std::chrono::system_clock::now());
+  }
+
+  std::shared_ptr<BasicPskCache> local_;
+  std::shared_ptr<MockAsyncPskCache> remote_;
+  std::unique_ptr<TieredPskCache> cache_;
+};
+
+TEST_F(TieredPskCacheTest, TestLocalHit) {
+  auto psk = getCachedPsk();
+  local_->putPsk("fizz", psk);
+  EXPECT_CALL(*remote_, getPskFuture(_)).Times(0);
+  auto cachedPsk = cache_->getPskFuture("fizz");
+  ASSERT_TRUE(cachedPsk.isReady());
+  ASSERT_TRUE(cachedPsk.value());
+  pskEq(psk, *cachedPsk.value());
+}
+
+TEST_F(TieredPskCacheTest, TestRemoteHit) {
+  auto psk = getCachedPsk();
+  Promise<Optional<CachedPsk>> remotePsk;
+  EXPECT_CALL(*remote_, getPskFuture("fizz"))
+      .WillOnce(InvokeWithoutArgs([&remotePsk]() {
+        return remotePsk.getFuture();
+      }));
+  auto cachedPsk = cache_->getPskFuture("fizz");
+  EXPECT_FALSE(cachedPsk.isReady());
+  EXPECT_FALSE(cache_->getPsk("fizz"));
+
+  remotePsk.setValue(psk);
+  ASSERT_TRUE(cachedPsk.isReady());
+  pskEq(psk, *cachedPsk.value());
+  auto localPsk = cache_->getPsk("fizz");
+  ASSERT_TRUE(localPsk);
+  pskEq(psk, *localPsk);
+}
+
+TEST_F(TieredPskCacheTest, TestRemoteMiss) {
+  EXPECT_CALL(*remote_, getPskFuture("fizz"))
+      .WillOnce(InvokeWithoutArgs(
+          []() { return makeFuture<Optional<CachedPsk>>(none); }));
+  auto cachedPsk = cache_->getPskFuture("fizz");
+  ASSERT_TRUE(cachedPsk.isReady());
+  EXPECT_FALSE(cachedPsk.value());
+}
+
+TEST_F(TieredPskCacheTest, TestPutRemove) {
+  EXPECT_CALL(*remote_, putPsk("fizz", _));
+  cache_->putPsk("fizz", getCachedPsk());
+  EXPECT_TRUE(local_->getPsk("fizz"));
+
+  EXPECT_CALL(*remote_, removePsk("fizz"));
+  cache_->removePsk("fizz");
+  EXPECT_FALSE(local_->getPsk("fizz"));
+}
+} // namespace test
+} // namespace client
+} // namespace fizz
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/BufferedRandom.h>
+
+#include <pthread.h>
+#include <sodium/crypto_stream_chacha20.h>
+#include <sodium/randombytes.h>
+#include <sodium/utils.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace fizz {
+
+constexpr size_t BufferedRandom::kBufferSize;
+constexpr size_t BufferedRandom::kReseedInterval;
+
+namespace {
+
+constexpr size_t kKeySize = crypto_stream_chacha20_KEYBYTES;
+
+// Plain data so that it is zero initialized without dynamic initialization.
+struct ThreadState {
+  bool seeded;
+  size_t available;
+  size_t sinceReseed;
+  uint8_t key[kKeySize];
+  uint8_t block[kKeySize + BufferedRandom::kBufferSize];
+};
+
+ThreadState& local() {
+  static thread_local ThreadState state;
+  return state;
+}
+
+void reset(ThreadState& state) {
+  sodium_memzero(&state, sizeof(state));
+}
+
+void onForkChild() {
+  // Only the forking thread exists in the child.
+  reset(local());
+}
+
+void refill(ThreadState& state) {
+  static std::once_flag registerFork;
+  std::call_once(
+      registerFork, []() { pthread_atfork(nullptr, nullptr, &onForkChild); });
+
+  if (!state.seeded || state.sinceReseed >= BufferedRandom::kReseedInterval) {
+    randombytes_buf(state.key, sizeof(state.key));
+    state.seeded = true;
+    state.sinceReseed = 0;
+  }
+
+  // Every key is used for a single block, so a zero nonce is fine.
+  static const uint8_t nonce[crypto_stream_chacha20_NONCEBYTES] = {};
+  crypto_stream_chacha20(state.block, sizeof(state.block), nonce, state.key);
+  memcpy(state.key, state.block, kKeySize);
+  sodium_memzero(state.block, kKeySize);
+  state.available = BufferedRandom::kBufferSize;
+  state.sinceReseed += BufferedRandom::kBufferSize;
+}
+} // namespace
+
+void BufferedRandom::fill(folly::MutableByteRange out) {
+  auto& state = local();
+  while (!out.empty()) {
+    if (state.available == 0) {
+      refill(state);
+    }
+    auto len = std::min(out.size(), state.available);
+    // Hand out bytes from the end of the block, erasing them as they go.
+    auto src = state.block + kKeySize + state.available - len;
+    memcpy(out.data(), src, len);
+    sodium_memzero(src, len);
+    state.available -= len;
+    out.advance(len);
+  }
+}
+} // namespace fizz
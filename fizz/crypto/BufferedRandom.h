@@ -0,0 +1,55 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+
+#include <array>
+#include <type_traits>
+
+namespace fizz {
+
+/**
+ * Per thread buffered CSPRNG, for callers that need many small random values
+ * (a handshake random, a ticket age add) and would otherwise make a system
+ * RNG call for each of them.
+ *
+ * Each thread keeps a ChaCha20 key seeded from the system RNG and generates
+ * kBufferSize bytes of output at a time. The first bytes of every block
+ * replace the key, so earlier output can't be recovered from the state, and
+ * bytes are erased from the buffer once they are handed out. The key is
+ * reseeded from the system every kReseedInterval bytes, and the state of the
+ * forking thread is discarded in a forked child so that parent and child
+ * never share output.
+ */
+class BufferedRandom {
+ public:
+  static constexpr size_t kBufferSize = 512;
+  static constexpr size_t kReseedInterval = 1024 * 1024;
+
+  static void fill(folly::MutableByteRange out);
+
+  template <size_t Size>
+  static std::array<uint8_t, Size> generateRandom() {
+    std::array<uint8_t, Size> random;
+    fill(folly::range(random));
+    return random;
+  }
+
+  template <
+      typename T,
+      typename = std::enable_if_t<std::is_integral<T>::value>>
+  static T generateRandomNum() {
+    T random;
+    fill(folly::MutableByteRange(
+        reinterpret_cast<uint8_t*>(&random), sizeof(random)));
+    return random;
+  }
+};
+} // namespace fizz
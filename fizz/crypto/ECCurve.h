@@ -12,16 +12,20 @@
 
 namespace fizz {
 
+// keyShareLength is the size of an uncompressed point on the curve.
 struct P256 {
   static const int curveNid{NID_X9_62_prime256v1};
+  static const size_t keyShareLength{65};
 };
 
 struct P384 {
   static const int curveNid{NID_secp384r1};
+  static const size_t keyShareLength{97};
 };
 
 struct P521 {
   static const int curveNid{NID_secp521r1};
+  static const size_t keyShareLength{133};
 };
 
 } // namespace fizz
@@ -12,15 +12,66 @@ template <typename Hash>
 inline std::vector<uint8_t> HkdfImpl<Hash>::extract(
     folly::ByteRange salt,
     folly::ByteRange ikm) const {
-  auto zeros = std::vector<uint8_t>(Hash::HashLen, 0);
-  // Extraction step HMAC-HASH(salt, IKM)
   std::vector<uint8_t> extractedKey(Hash::HashLen);
-  salt = salt.empty() ? folly::range(zeros) : salt;
-  Hash::hmac(
-      salt, folly::IOBuf::wrapBufferAsValue(ikm), folly::range(extractedKey));
+  extract(salt, ikm, folly::range(extractedKey));
   return extractedKey;
 }
 
+template <typename Hash>
+inline void HkdfImpl<Hash>::extract(
+    folly::ByteRange salt,
+    folly::ByteRange ikm,
+    folly::MutableByteRange out) const {
+  CHECK_EQ(out.size(), Hash::HashLen);
+  static const std::array<uint8_t, Hash::HashLen> zeros{};
+  // Extraction step HMAC-HASH(salt, IKM)
+  salt = salt.empty() ? folly::range(zeros) : salt;
+  Hash::hmac(salt, folly::IOBuf::wrapBufferAsValue(ikm), out);
+}
+
+template <typename Hash>
+inline void HkdfImpl<Hash>::expand(
+    folly::ByteRange extractedKey,
+    folly::ByteRange info,
+    folly::MutableByteRange out) const {
+  CHECK_EQ(extractedKey.size(), Hash::HashLen);
+  typename Hash::KeyedHmac keyed(extractedKey);
+  expand(keyed, info, out);
+}
+
+template <typename Hash>
+inline void HkdfImpl<Hash>::expand(
+    typename Hash::KeyedHmac& extractedKey,
+    folly::ByteRange info,
+    folly::MutableByteRange out) const {
+  if (UNLIKELY(out.size() > 255 * Hash::HashLen)) {
+    throw std::runtime_error("Output too long");
+  }
+  if (UNLIKELY(info.size() > kMaxHkdfLabelLength)) {
+    throw std::runtime_error("Info too long");
+  }
+  // Each round is HMAC-HASH(PRK, T(round - 1) | info | round), with the
+  // input assembled on the stack.
+  std::array<uint8_t, Hash::HashLen + kMaxHkdfLabelLength + 1> in;
+  std::array<uint8_t, Hash::HashLen> t;
+  size_t previousLength = 0;
+  size_t offset = 0;
+  for (size_t round = 1; offset < out.size(); ++round) {
+    memcpy(in.data(), t.data(), previousLength);
+    memcpy(in.data() + previousLength, info.data(), info.size());
+    in[previousLength + info.size()] = round;
+    extractedKey.hmac(
+        folly::IOBuf::wrapBufferAsValue(
+            in.data(), previousLength + info.size() + 1),
+        folly::range(t));
+    previousLength = Hash::HashLen;
+
+    auto length = std::min(Hash::HashLen, out.size() - offset);
+    memcpy(out.data() + offset, t.data(), length);
+    offset += length;
+  }
+}
+
 template <typename Hash>
 inline std::unique_ptr<folly::IOBuf> HkdfImpl<Hash>::expand(
     folly::ByteRange extractedKey,
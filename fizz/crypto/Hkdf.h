@@ -12,7 +12,16 @@
 #include <fizz/crypto/Sha384.h>
 #include <folly/io/IOBuf.h>
 
+#include <array>
+
 namespace fizz {
+
+/**
+ * Largest HKDF info used by TLS 1.3, an HkdfLabel with a 255 byte label and
+ * 255 byte context.
+ */
+constexpr size_t kMaxHkdfLabelLength = sizeof(uint16_t) + 1 + 255 + 1 + 255;
+
 /**
  * An HKDF implementation conformant with
  * https://tools.ietf.org/html/rfc5869.
@@ -49,9 +58,10 @@ class Hkdf {
  * The template struct requires the following parameters:
  *   - HashLen: length of the hash digest
  *   - hmac(ByteRange key, const IOBuf& in, MutableByteRange out)
+ *   - KeyedHmac: HMAC keyed once, see Sha::KeyedHmac
  */
 template <typename Hash>
-class HkdfImpl : public Hkdf {
+class HkdfImpl final : public Hkdf {
  public:
   static constexpr size_t HashLen = Hash::HashLen;
 
@@ -72,6 +82,30 @@ class HkdfImpl : public Hkdf {
   size_t hashLength() const override {
     return HashLen;
   }
+
+  /**
+   * Same as extract() and expand() above, but write the output into out
+   * instead of allocating it. out must be HashLen bytes for extract(). info
+   * can be at most kMaxHkdfLabelLength bytes.
+   */
+  void extract(
+      folly::ByteRange salt,
+      folly::ByteRange ikm,
+      folly::MutableByteRange out) const;
+
+  void expand(
+      folly::ByteRange extractedKey,
+      folly::ByteRange info,
+      folly::MutableByteRange out) const;
+
+  /**
+   * Same as above, but with the extracted key already keyed into the HMAC,
+   * for callers that expand the same key several times.
+   */
+  void expand(
+      typename Hash::KeyedHmac& extractedKey,
+      folly::ByteRange info,
+      folly::MutableByteRange out) const;
 };
 } // namespace fizz
 
@@ -14,9 +14,15 @@ Buf KeyDerivationImpl<Hash>::expandLabel(
     folly::StringPiece label,
     Buf hashValue,
     uint16_t length) {
-  HkdfLabel hkdfLabel = {
-      length, std::string(label.begin(), label.end()), std::move(hashValue)};
-  return HkdfImpl<Hash>().expand(secret, *encode(std::move(hkdfLabel)), length);
+  std::array<uint8_t, kMaxHkdfLabelLength> info;
+  auto hkdfLabel = encodeHkdfLabel(
+      labelPrefix_,
+      label,
+      hashValue ? hashValue->coalesce() : folly::ByteRange(),
+      length,
+      info);
+  return HkdfImpl<Hash>().expand(
+      secret, folly::IOBuf::wrapBufferAsValue(hkdfLabel), length);
 }
 
 template <typename Hash>
@@ -27,6 +33,59 @@ Buf KeyDerivationImpl<Hash>::hkdfExpand(
   return HkdfImpl<Hash>().expand(secret, *info, length);
 }
 
+template <typename Hash>
+folly::ByteRange KeyDerivationImpl<Hash>::encodeHkdfLabel(
+    folly::StringPiece labelPrefix,
+    folly::StringPiece label,
+    folly::ByteRange hashValue,
+    size_t length,
+    std::array<uint8_t, kMaxHkdfLabelLength>& info) {
+  auto labelLength = labelPrefix.size() + label.size();
+  if (labelLength > 255 || hashValue.size() > 255 ||
+      length > std::numeric_limits<uint16_t>::max()) {
+    throw std::runtime_error("hkdf label too long");
+  }
+  // Encode the HkdfLabel on the stack rather than through encode().
+  auto pos = info.data();
+  folly::storeUnaligned<uint16_t>(
+      pos, folly::Endian::big(static_cast<uint16_t>(length)));
+  pos += sizeof(uint16_t);
+  *pos++ = labelLength;
+  memcpy(pos, labelPrefix.data(), labelPrefix.size());
+  pos += labelPrefix.size();
+  memcpy(pos, label.data(), label.size());
+  pos += label.size();
+  *pos++ = hashValue.size();
+  memcpy(pos, hashValue.data(), hashValue.size());
+  pos += hashValue.size();
+  return folly::ByteRange(info.data(), pos);
+}
+
+template <typename Hash>
+void KeyDerivationImpl<Hash>::expandLabel(
+    folly::ByteRange secret,
+    folly::StringPiece label,
+    folly::ByteRange hashValue,
+    folly::MutableByteRange out) {
+  std::array<uint8_t, kMaxHkdfLabelLength> info;
+  HkdfImpl<Hash>().expand(
+      secret,
+      encodeHkdfLabel(labelPrefix_, label, hashValue, out.size(), info),
+      out);
+}
+
+template <typename Hash>
+void KeyDerivationImpl<Hash>::deriveSecret(
+    folly::ByteRange secret,
+    folly::StringPiece label,
+    folly::ByteRange messageHash,
+    folly::MutableByteRange out) {
+  CHECK_EQ(secret.size(), Hash::HashLen);
+  CHECK_EQ(messageHash.size(), Hash::HashLen);
+  CHECK_EQ(out.size(), Hash::HashLen);
+  expandLabel(secret, label, messageHash, out);
+}
+
 template <typename Hash>
 std::vector<uint8_t> KeyDerivationImpl<Hash>::deriveSecret(
     folly::ByteRange secret,
@@ -47,4 +106,70 @@ std::vector<uint8_t> KeyDerivationImpl<Hash>::deriveSecret(
   }
   return prk;
 }
+
+template <typename Hash>
+class KeyDerivationImpl<Hash>::KeyedSecretImpl : public KeyedSecret {
+ public:
+  KeyedSecretImpl(folly::StringPiece labelPrefix, folly::ByteRange secret)
+      : labelPrefix_(labelPrefix), hmac_(secret) {
+    CHECK_EQ(secret.size(), Hash::HashLen);
+  }
+
+  void expandLabel(
+      folly::StringPiece label,
+      folly::ByteRange hashValue,
+      folly::MutableByteRange out) override {
+    std::array<uint8_t, kMaxHkdfLabelLength> info;
+    HkdfImpl<Hash>().expand(
+        hmac_,
+        encodeHkdfLabel(labelPrefix_, label, hashValue, out.size(), info),
+        out);
+  }
+
+  void deriveSecret(
+      folly::StringPiece label,
+      folly::ByteRange messageHash,
+      folly::MutableByteRange out) override {
+    CHECK_EQ(messageHash.size(), Hash::HashLen);
+    CHECK_EQ(out.size(), Hash::HashLen);
+    expandLabel(label, messageHash, out);
+  }
+
+  void rekey(folly::ByteRange secret) override {
+    CHECK_EQ(secret.size(), Hash::HashLen);
+    hmac_.rekey(secret);
+  }
+
+ private:
+  folly::StringPiece labelPrefix_;
+  typename Hash::KeyedHmac hmac_;
+};
+
+template <typename Hash>
+std::unique_ptr<KeyedSecret> KeyDerivationImpl<Hash>::keySecret(
+    folly::ByteRange secret) {
+  return std::make_unique<KeyedSecretImpl>(labelPrefix_, secret);
+}
+
+template <typename Hash>
+folly::ByteRange KeyDerivationImpl<Hash>::noPskDerivedSecret() const {
+  if (labelPrefix_ != kTls13LabelPrefix) {
+    return folly::ByteRange();
+  }
+  // Only depends on the hash, so compute it once per hash.
+  static const auto derivedSecret = [] {
+    std::array<uint8_t, Hash::HashLen> zeros{};
+    std::array<uint8_t, Hash::HashLen> earlySecret;
+    HkdfImpl<Hash>().extract(
+        folly::range(zeros), folly::range(zeros), folly::range(earlySecret));
+    std::array<uint8_t, Hash::HashLen> derived;
+    KeyDerivationImpl<Hash>().deriveSecret(
+        folly::range(earlySecret),
+        "derived",
+        Hash::BlankHash,
+        folly::range(derived));
+    return derived;
+  }();
+  return folly::range(derivedSecret);
+}
 } // namespace fizz
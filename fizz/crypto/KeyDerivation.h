@@ -10,9 +10,88 @@
 
 #include <fizz/crypto/Hkdf.h>
 #include <fizz/record/Types.h>
+#include <folly/io/Cursor.h>
+#include <folly/lang/Bits.h>
+
+#include <array>
 
 namespace fizz {
 
+/**
+ * Largest hash length of the supported cipher suites (SHA-384).
+ */
+constexpr size_t kMaxHashLength = 48;
+
+/**
+ * Prefixes of the HkdfLabel labels of TLS 1.3 and of DTLS 1.3 (RFC 9147
+ * section 5.9).
+ */
+constexpr folly::StringPiece kTls13LabelPrefix = "tls13 ";
+constexpr folly::StringPiece kDtls13LabelPrefix = "dtls13";
+
+/**
+ * A secret of up to kMaxHashLength bytes stored inline, so that key schedule
+ * secrets can be derived, stored and copied without heap allocations.
+ */
+class InlineSecret {
+ public:
+  InlineSecret() = default;
+
+  explicit InlineSecret(size_t length) {
+    resize(length);
+  }
+
+  void resize(size_t length) {
+    if (length > kMaxHashLength) {
+      throw std::runtime_error("secret too long");
+    }
+    length_ = length;
+  }
+
+  size_t size() const {
+    return length_;
+  }
+
+  folly::ByteRange range() const {
+    return folly::ByteRange(data_.data(), length_);
+  }
+
+  folly::MutableByteRange writableRange() {
+    return folly::MutableByteRange(data_.data(), length_);
+  }
+
+ private:
+  std::array<uint8_t, kMaxHashLength> data_{};
+  size_t length_{0};
+};
+
+/**
+ * A secret prepared for repeated expansion, see KeyDerivation::keySecret().
+ */
+class KeyedSecret {
+ public:
+  virtual ~KeyedSecret() = default;
+
+  /**
+   * Same as KeyDerivation::expandLabel() and deriveSecret() with the secret
+   * this was created from.
+   */
+  virtual void expandLabel(
+      folly::StringPiece label,
+      folly::ByteRange hashValue,
+      folly::MutableByteRange out) = 0;
+
+  virtual void deriveSecret(
+      folly::StringPiece label,
+      folly::ByteRange messageHash,
+      folly::MutableByteRange out) = 0;
+
+  /**
+   * Replaces the secret, reusing the resources of this object.
+   */
+  virtual void rekey(folly::ByteRange secret) = 0;
+};
+
 /**
  * Interface for common TLS 1.3 key derivation functions.
  */
@@ -49,11 +128,87 @@ class KeyDerivation {
       folly::ByteRange ikm) = 0;
 
   virtual void hash(const folly::IOBuf& in, folly::MutableByteRange out) = 0;
+
+  /**
+   * Same as expandLabel(), deriveSecret() and hkdfExtract() above, but write
+   * the result into out instead of allocating it. out must be exactly as long
+   * as the output (hashLength() for deriveSecret() and hkdfExtract()).
+   *
+   * The default implementations copy the result of the allocating versions.
+   */
+  virtual void expandLabel(
+      folly::ByteRange secret,
+      folly::StringPiece label,
+      folly::ByteRange hashValue,
+      folly::MutableByteRange out) {
+    auto buf = expandLabel(
+        secret, label, folly::IOBuf::copyBuffer(hashValue), out.size());
+    if (buf->computeChainDataLength() != out.size()) {
+      throw std::runtime_error("derived secret length mismatch");
+    }
+    folly::io::Cursor(buf.get()).pull(out.data(), out.size());
+  }
+
+  virtual void deriveSecret(
+      folly::ByteRange secret,
+      folly::StringPiece label,
+      folly::ByteRange messageHash,
+      folly::MutableByteRange out) {
+    copySecret(deriveSecret(secret, label, messageHash), out);
+  }
+
+  virtual void hkdfExtract(
+      folly::ByteRange salt,
+      folly::ByteRange ikm,
+      folly::MutableByteRange out) {
+    copySecret(hkdfExtract(salt, ikm), out);
+  }
+
+  /**
+   * Prepares secret for several expandLabel() or deriveSecret() calls, so
+   * that work depending only on the secret (the HMAC pads) is done once.
+   *
+   * The default implementation forwards to this object's expandLabel() and
+   * deriveSecret(), which must outlive the returned object.
+   */
+  virtual std::unique_ptr<KeyedSecret> keySecret(folly::ByteRange secret);
+
+  /**
+   * Returns Derive-Secret(early secret, "derived", Hash("")) for the early
+   * secret of a handshake without a PSK, HKDF-Extract(0, 0). This is the salt
+   * of the handshake secret of every full handshake with this hash.
+   *
+   * Implementations that don't cache it return an empty range.
+   */
+  virtual folly::ByteRange noPskDerivedSecret() const {
+    return folly::ByteRange();
+  }
+
+ private:
+  class ForwardingKeyedSecret;
+
+  static void copySecret(
+      const std::vector<uint8_t>& secret,
+      folly::MutableByteRange out) {
+    if (secret.size() != out.size()) {
+      throw std::runtime_error("derived secret length mismatch");
+    }
+    memcpy(out.data(), secret.data(), out.size());
+  }
 };
 
 template <typename Hash>
-class KeyDerivationImpl : public KeyDerivation {
+class KeyDerivationImpl final : public KeyDerivation {
+  static_assert(Hash::HashLen <= kMaxHashLength, "hash too long");
+
  public:
+  /**
+   * labelPrefix is prepended to every HkdfLabel label, kDtls13LabelPrefix for
+   * the DTLS 1.3 key schedule. It must outlive this object.
+   */
+  explicit KeyDerivationImpl(folly::StringPiece labelPrefix = kTls13LabelPrefix)
+      : labelPrefix_(labelPrefix) {}
+
   size_t hashLength() const override {
     return Hash::HashLen;
   }
@@ -84,7 +239,75 @@ class KeyDerivationImpl : public KeyDerivation {
       override {
     return HkdfImpl<Hash>().extract(salt, ikm);
   }
+
+  void expandLabel(
+      folly::ByteRange secret,
+      folly::StringPiece label,
+      folly::ByteRange hashValue,
+      folly::MutableByteRange out) override;
+
+  void deriveSecret(
+      folly::ByteRange secret,
+      folly::StringPiece label,
+      folly::ByteRange messageHash,
+      folly::MutableByteRange out) override;
+
+  void hkdfExtract(
+      folly::ByteRange salt,
+      folly::ByteRange ikm,
+      folly::MutableByteRange out) override {
+    HkdfImpl<Hash>().extract(salt, ikm, out);
+  }
+
+  std::unique_ptr<KeyedSecret> keySecret(folly::ByteRange secret) override;
+
+  folly::ByteRange noPskDerivedSecret() const override;
+
+ private:
+  class KeyedSecretImpl;
+
+  static folly::ByteRange encodeHkdfLabel(
+      folly::StringPiece labelPrefix,
+      folly::StringPiece label,
+      folly::ByteRange hashValue,
+      size_t length,
+      std::array<uint8_t, kMaxHkdfLabelLength>& info);
+
+  folly::StringPiece labelPrefix_;
 };
+
+class KeyDerivation::ForwardingKeyedSecret : public KeyedSecret {
+ public:
+  ForwardingKeyedSecret(KeyDerivation& deriver, folly::ByteRange secret)
+      : deriver_(deriver), secret_(secret.begin(), secret.end()) {}
+
+  void expandLabel(
+      folly::StringPiece label,
+      folly::ByteRange hashValue,
+      folly::MutableByteRange out) override {
+    deriver_.expandLabel(folly::range(secret_), label, hashValue, out);
+  }
+
+  void deriveSecret(
+      folly::StringPiece label,
+      folly::ByteRange messageHash,
+      folly::MutableByteRange out) override {
+    deriver_.deriveSecret(folly::range(secret_), label, messageHash, out);
+  }
+
+  void rekey(folly::ByteRange secret) override {
+    secret_.assign(secret.begin(), secret.end());
+  }
+
+ private:
+  KeyDerivation& deriver_;
+  std::vector<uint8_t> secret_;
+};
+
+inline std::unique_ptr<KeyedSecret> KeyDerivation::keySecret(
+    folly::ByteRange secret) {
+  return std::make_unique<ForwardingKeyedSecret>(*this, secret);
+}
 } // namespace fizz
 
 #include <fizz/crypto/KeyDerivation-inl.h>
@@ -0,0 +1,132 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/SecretArena.h>
+
+#include <fizz/crypto/Utils.h>
+#include <glog/logging.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+namespace fizz {
+
+namespace {
+
+/**
+ * The process wide slab SecretArenas allocate from. Free slots are linked
+ * through their first bytes; a slot is zeroed whenever it is handed out.
+ */
+class SecretSlab {
+ public:
+  static SecretSlab& get() {
+    // Never destroyed: arenas may be wiped during static destruction.
+    static auto slab = new SecretSlab();
+    return *slab;
+  }
+
+  uint8_t* take() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_) {
+      grow();
+    }
+    auto slot = free_;
+    memcpy(&free_, slot, sizeof(free_));
+    memset(slot, 0, sizeof(free_));
+    ++stats_.slotsInUse;
+    return slot;
+  }
+
+  void release(uint8_t* slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memcpy(slot, &free_, sizeof(free_));
+    free_ = slot;
+    --stats_.slotsInUse;
+  }
+
+  SecretArena::Stats getStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+ private:
+  static constexpr size_t kSlotSize = SecretArena::kMaxAllocation;
+  static constexpr size_t kChunkSize = 64 * 1024;
+
+  void grow() {
+    auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto size = std::max(kChunkSize, pageSize);
+    auto data = mmap(
+        nullptr,
+        size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if (data == MAP_FAILED) {
+      throw std::runtime_error("failed to map secret slab");
+    }
+#ifdef MADV_DONTDUMP
+    madvise(data, size, MADV_DONTDUMP);
+#endif
+    ++stats_.chunks;
+    // Locking is best effort, it fails once RLIMIT_MEMLOCK is exhausted.
+    if (mlock(data, size) != 0) {
+      ++stats_.unlockedChunks;
+      PLOG(WARNING) << "Unable to lock secret slab chunk ("
+                    << stats_.unlockedChunks << " of " << stats_.chunks
+                    << " unlocked)";
+    }
+    // Link the slots so that they are handed out in address order. Chunks
+    // are kept for the life of the process.
+    auto base = static_cast<uint8_t*>(data);
+    for (size_t offset = size; offset >= kSlotSize; offset -= kSlotSize) {
+      auto slot = base + offset - kSlotSize;
+      memcpy(slot, &free_, sizeof(free_));
+      free_ = slot;
+    }
+  }
+
+  std::mutex mutex_;
+  uint8_t* free_{nullptr};
+  SecretArena::Stats stats_;
+};
+} // namespace
+
+SecretArena::~SecretArena() {
+  wipe();
+}
+
+folly::MutableByteRange SecretArena::allocate(size_t length) {
+  if (length > kMaxAllocation) {
+    throw std::runtime_error("secret too large for arena");
+  }
+  slots_.reserve(slots_.size() + 1);
+  slots_.push_back(SecretSlab::get().take());
+  return folly::MutableByteRange(slots_.back(), length);
+}
+
+void SecretArena::wipe() {
+  auto& slab = SecretSlab::get();
+  // Released in reverse so that the next allocations reuse the same slots.
+  for (auto it = slots_.rbegin(); it != slots_.rend(); ++it) {
+    CryptoUtils::clean(folly::MutableByteRange(*it, kMaxAllocation));
+    slab.release(*it);
+  }
+  slots_.clear();
+}
+
+SecretArena::Stats SecretArena::getStats() {
+  return SecretSlab::get().getStats();
+}
+} // namespace fizz
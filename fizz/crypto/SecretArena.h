@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+
+#include <vector>
+
+namespace fizz {
+
+/**
+ * Memory for secrets. Allocations are fixed size slots of a process wide
+ * slab, which is locked so that it is not swapped out (if the process is
+ * allowed to lock memory) and excluded from core dumps where supported. The
+ * slab grows a chunk at a time as needed and freed slots are kept on a free
+ * list for reuse, so an arena itself costs no mapping or locking.
+ *
+ * Allocations are not freed individually: wipe() zeroes everything handed out
+ * so far and returns it to the slab. The destructor wipes the arena.
+ */
+class SecretArena {
+ public:
+  /**
+   * Largest allocation, enough for the secrets of any supported hash.
+   */
+  static constexpr size_t kMaxAllocation = 64;
+
+  struct Stats {
+    // Chunks mapped for the slab, and how many of them could not be locked.
+    size_t chunks{0};
+    size_t unlockedChunks{0};
+    // Slots currently handed out to arenas.
+    size_t slotsInUse{0};
+  };
+
+  SecretArena() = default;
+  ~SecretArena();
+
+  SecretArena(const SecretArena&) = delete;
+  SecretArena& operator=(const SecretArena&) = delete;
+
+  /**
+   * Returns length bytes of zeroed memory that stays valid until the next
+   * wipe(). Throws if length is larger than kMaxAllocation or the slab can't
+   * grow.
+   */
+  folly::MutableByteRange allocate(size_t length);
+
+  /**
+   * Zeroes all allocations and returns them to the slab.
+   */
+  void wipe();
+
+  /**
+   * Stats of the shared slab. Chunks that could not be locked (once
+   * RLIMIT_MEMLOCK is exhausted) are also logged when they are mapped.
+   */
+  static Stats getStats();
+
+ private:
+  std::vector<uint8_t*> slots_;
+};
+} // namespace fizz
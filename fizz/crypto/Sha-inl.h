@@ -10,6 +10,18 @@
 
 namespace fizz {
 
+namespace detail {
+
+/**
+ * HMAC_Init_ex() treats a null key as "keep the previous key", which an
+ * empty ByteRange can be, so empty keys point here instead.
+ */
+inline const uint8_t* hmacKeyData(folly::ByteRange key) {
+  static const uint8_t kEmptyKey = 0;
+  return key.empty() ? &kEmptyKey : key.data();
+}
+} // namespace detail
+
 template <typename T>
 void Sha<T>::hmac(
     folly::ByteRange key,
@@ -24,4 +36,45 @@ void Sha<T>::hash(const folly::IOBuf& in, folly::MutableByteRange out) {
   CHECK_GE(out.size(), T::HashLen);
   folly::ssl::OpenSSLHash::hash(out, T::HashEngine(), in);
 }
+
+template <typename T>
+Sha<T>::KeyedHmac::KeyedHmac(folly::ByteRange key)
+    : keyed_(HMAC_CTX_new()), ctx_(HMAC_CTX_new()) {
+  if (!keyed_ || !ctx_) {
+    throw std::runtime_error("failed to allocate hmac context");
+  }
+  rekey(key);
+}
+
+template <typename T>
+void Sha<T>::KeyedHmac::rekey(folly::ByteRange key) {
+  if (HMAC_Init_ex(
+          keyed_.get(),
+          detail::hmacKeyData(key),
+          key.size(),
+          T::HashEngine(),
+          nullptr) != 1) {
+    throw std::runtime_error("failed to initialize hmac");
+  }
+}
+
+template <typename T>
+void Sha<T>::KeyedHmac::hmac(
+    const folly::IOBuf& in,
+    folly::MutableByteRange out) {
+  CHECK_GE(out.size(), T::HashLen);
+  if (HMAC_CTX_copy(ctx_.get(), keyed_.get()) != 1) {
+    throw std::runtime_error("failed to copy hmac context");
+  }
+  for (auto range : in) {
+    if (HMAC_Update(ctx_.get(), range.data(), range.size()) != 1) {
+      throw std::runtime_error("failed to update hmac");
+    }
+  }
+  unsigned int length = 0;
+  if (HMAC_Final(ctx_.get(), out.data(), &length) != 1 ||
+      length != T::HashLen) {
+    throw std::runtime_error("failed to finalize hmac");
+  }
+}
 } // namespace fizz
@@ -11,6 +11,8 @@
 #include <folly/Range.h>
 #include <folly/io/IOBuf.h>
 #include <folly/ssl/OpenSSLHash.h>
+#include <folly/ssl/OpenSSLPtrTypes.h>
+#include <openssl/hmac.h>
 
 namespace fizz {
 
@@ -36,6 +38,31 @@ struct Sha {
    * Puts Hash(in) into out. Out must be at least of size HashLen.
    */
   static void hash(const folly::IOBuf& in, folly::MutableByteRange out);
+
+  /**
+   * HMAC with a fixed key. The key is hashed into the inner and outer pad
+   * states once, and each hmac() continues from a copy of them, so repeated
+   * HMACs with the same key skip the two pad blocks. The contexts are
+   * allocated once and reused across rekey(). Not thread safe.
+   */
+  class KeyedHmac {
+   public:
+    explicit KeyedHmac(folly::ByteRange key);
+
+    /**
+     * Switches to a new key, reusing the existing HMAC contexts.
+     */
+    void rekey(folly::ByteRange key);
+
+    /**
+     * Puts HMAC(key, in) into out. Out must be at least of size HashLen.
+     */
+    void hmac(const folly::IOBuf& in, folly::MutableByteRange out);
+
+   private:
+    folly::ssl::HmacCtxUniquePtr keyed_;
+    folly::ssl::HmacCtxUniquePtr ctx_;
+  };
 };
 } // namespace fizz
 #include <fizz/crypto/Sha-inl.h>
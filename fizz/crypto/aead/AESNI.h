@@ -0,0 +1,113 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+/**
+ * AES-NI helpers shared by the native aead implementations. Only for use in
+ * their translation units.
+ */
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FIZZ_HAVE_AESNI 1
+#else
+#define FIZZ_HAVE_AESNI 0
+#endif
+
+#if FIZZ_HAVE_AESNI
+#include <immintrin.h>
+
+#define FIZZ_AESNI_TARGET __attribute__((target("aes,sse4.1")))
+
+namespace fizz {
+namespace detail {
+namespace aesni {
+
+/**
+ * Returns key ^ (key << 32) ^ (key << 64) ^ (key << 96).
+ */
+FIZZ_AESNI_TARGET inline __m128i xorShifted(__m128i key) {
+  auto shifted = _mm_slli_si128(key, 4);
+  key = _mm_xor_si128(key, shifted);
+  shifted = _mm_slli_si128(shifted, 4);
+  key = _mm_xor_si128(key, shifted);
+  shifted = _mm_slli_si128(shifted, 4);
+  return _mm_xor_si128(key, shifted);
+}
+
+FIZZ_AESNI_TARGET inline __m128i aes128KeyAssist(__m128i key, __m128i assist) {
+  assist = _mm_shuffle_epi32(assist, 0xff);
+  return _mm_xor_si128(xorShifted(key), assist);
+}
+
+/**
+ * Expands a 16 byte key into the 11 AES-128 encryption round keys.
+ */
+FIZZ_AESNI_TARGET inline void expandKey128(
+    const uint8_t* key,
+    __m128i* roundKeys) {
+  roundKeys[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+#define FIZZ_AES128_ROUND(i, rcon) \
+  roundKeys[i] = aes128KeyAssist(  \
+      roundKeys[i - 1], _mm_aeskeygenassist_si128(roundKeys[i - 1], rcon))
+  FIZZ_AES128_ROUND(1, 0x01);
+  FIZZ_AES128_ROUND(2, 0x02);
+  FIZZ_AES128_ROUND(3, 0x04);
+  FIZZ_AES128_ROUND(4, 0x08);
+  FIZZ_AES128_ROUND(5, 0x10);
+  FIZZ_AES128_ROUND(6, 0x20);
+  FIZZ_AES128_ROUND(7, 0x40);
+  FIZZ_AES128_ROUND(8, 0x80);
+  FIZZ_AES128_ROUND(9, 0x1b);
+  FIZZ_AES128_ROUND(10, 0x36);
+#undef FIZZ_AES128_ROUND
+}
+
+FIZZ_AESNI_TARGET inline __m128i aes256KeyAssist1(
+    __m128i key,
+    __m128i assist) {
+  assist = _mm_shuffle_epi32(assist, 0xff);
+  return _mm_xor_si128(xorShifted(key), assist);
+}
+
+FIZZ_AESNI_TARGET inline __m128i aes256KeyAssist2(
+    __m128i key1,
+    __m128i key2) {
+  auto assist = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(key1, 0x00), 0xaa);
+  return _mm_xor_si128(xorShifted(key2), assist);
+}
+
+/**
+ * Expands a 32 byte key into the 15 AES-256 encryption round keys.
+ */
+FIZZ_AESNI_TARGET inline void expandKey256(
+    const uint8_t* key,
+    __m128i* roundKeys) {
+  __m128i key1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+  __m128i key2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + 16));
+  roundKeys[0] = key1;
+  roundKeys[1] = key2;
+#define FIZZ_AES256_ROUND(i, rcon)                                           \
+  key1 = aes256KeyAssist1(key1, _mm_aeskeygenassist_si128(key2, rcon));     \
+  roundKeys[i] = key1;                                                       \
+  key2 = aes256KeyAssist2(key1, key2);                                       \
+  roundKeys[i + 1] = key2
+  FIZZ_AES256_ROUND(2, 0x01);
+  FIZZ_AES256_ROUND(4, 0x02);
+  FIZZ_AES256_ROUND(6, 0x04);
+  FIZZ_AES256_ROUND(8, 0x08);
+  FIZZ_AES256_ROUND(10, 0x10);
+  FIZZ_AES256_ROUND(12, 0x20);
+#undef FIZZ_AES256_ROUND
+  key1 = aes256KeyAssist1(key1, _mm_aeskeygenassist_si128(key2, 0x40));
+  roundKeys[14] = key1;
+}
+} // namespace aesni
+} // namespace detail
+} // namespace fizz
+#endif
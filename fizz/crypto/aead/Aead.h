@@ -8,14 +8,23 @@
 
 #pragma once
 
+#include <fizz/crypto/aead/BufferPool.h>
 #include <folly/Optional.h>
+#include <folly/io/Cursor.h>
 #include <folly/io/IOBuf.h>
+#include <folly/portability/SysUio.h>
+
+#include <vector>
 
 namespace fizz {
 
 struct TrafficKey {
   std::unique_ptr<folly::IOBuf> key;
   std::unique_ptr<folly::IOBuf> iv;
+
+  TrafficKey clone() const {
+    return TrafficKey{key->clone(), iv->clone()};
+  }
 };
 
 /**
@@ -41,6 +50,24 @@ class Aead {
    */
   virtual void setKey(TrafficKey key) = 0;
 
+  /**
+   * Returns a copy of the key and iv set on this aead, or none if the
+   * implementation does not support exporting them (or no key is set).
+   */
+  virtual folly::Optional<TrafficKey> getKey() const {
+    return folly::none;
+  }
+
+  /**
+   * Returns a new aead of the same type with the same key set, that can be
+   * used concurrently with this one (for example from another thread). The
+   * buffer pool and headroom are not copied. Returns nullptr if the
+   * implementation does not support this.
+   */
+  virtual std::unique_ptr<Aead> clone() const {
+    return nullptr;
+  }
+
   /**
    * Encrypts plaintext. Will throw on error.
    */
@@ -49,6 +76,91 @@ class Aead {
       const folly::IOBuf* associatedData,
       uint64_t seqNum) const = 0;
 
+  /**
+   * Encrypts a batch of plaintexts using consecutive sequence numbers starting
+   * at firstSeqNum. associatedData must have one entry per plaintext (entries
+   * may be null). Returns the ciphertexts in the same order. Will throw on
+   * error.
+   *
+   * The default implementation encrypts each plaintext individually.
+   * Implementations may override this to amortize per-record setup across the
+   * whole batch.
+   */
+  virtual std::vector<std::unique_ptr<folly::IOBuf>> encryptBatch(
+      std::vector<std::unique_ptr<folly::IOBuf>>&& plaintexts,
+      const std::vector<const folly::IOBuf*>& associatedData,
+      uint64_t firstSeqNum) const {
+    if (plaintexts.size() != associatedData.size()) {
+      throw std::runtime_error("associated data count mismatch");
+    }
+    std::vector<std::unique_ptr<folly::IOBuf>> ciphertexts;
+    ciphertexts.reserve(plaintexts.size());
+    for (size_t i = 0; i < plaintexts.size(); ++i) {
+      ciphertexts.push_back(encrypt(
+          std::move(plaintexts[i]), associatedData[i], firstSeqNum + i));
+    }
+    return ciphertexts;
+  }
+
+  /**
+   * Encrypts the plaintext described by the plaintext iovecs into the memory
+   * described by the ciphertext iovecs, and returns the number of ciphertext
+   * bytes written (plaintext length + getCipherOverhead()). The plaintext is
+   * only read, so it may point into shared buffers, and no output is
+   * allocated. The ciphertext iovecs must not overlap the plaintext and must
+   * have room for the tag, which directly follows the encrypted bytes. Will
+   * throw on error.
+   *
+   * The default implementation gathers the plaintext into a new buffer,
+   * encrypts it and scatters the result into the ciphertext iovecs.
+   */
+  virtual size_t encryptIovecs(
+      const struct iovec* plaintext,
+      size_t plaintextCount,
+      const struct iovec* ciphertext,
+      size_t ciphertextCount,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const {
+    size_t inputLength = 0;
+    for (size_t i = 0; i < plaintextCount; ++i) {
+      inputLength += plaintext[i].iov_len;
+    }
+    auto input = folly::IOBuf::create(inputLength + getCipherOverhead());
+    for (size_t i = 0; i < plaintextCount; ++i) {
+      memcpy(
+          input->writableTail(), plaintext[i].iov_base, plaintext[i].iov_len);
+      input->append(plaintext[i].iov_len);
+    }
+    auto encrypted = encrypt(std::move(input), associatedData, seqNum);
+    auto outputLength = encrypted->computeChainDataLength();
+
+    auto output = folly::IOBuf::wrapIov(ciphertext, ciphertextCount);
+    if (output->computeChainDataLength() < outputLength) {
+      throw std::runtime_error("ciphertext iovecs too small");
+    }
+    folly::io::RWPrivateCursor cursor(output.get());
+    for (auto range : *encrypted) {
+      cursor.push(range);
+    }
+    return outputLength;
+  }
+
+  /**
+   * Returns true if encryptIovecs() encrypts directly between the iovecs
+   * rather than using the copying default implementation.
+   */
+  virtual bool supportsEncryptIovecs() const {
+    return false;
+  }
+
+  /**
+   * Returns true if tryDecryptIovecs() decrypts directly into the iovecs
+   * rather than using the copying default implementation.
+   */
+  virtual bool supportsDecryptIovecs() const {
+    return false;
+  }
+
   /**
    * Set a hint to the AEAD about how much space to try to leave as headroom for
    * ciphertexts returned from encrypt.  Implementations may or may not honor
@@ -56,6 +168,27 @@ class Aead {
    */
   virtual void setEncryptedBufferHeadroom(size_t headroom) = 0;
 
+  /**
+   * Set a pool for the aead to allocate ciphertext and tag buffers from.
+   * Implementations may or may not honor this.
+   */
+  virtual void setBufferPool(std::shared_ptr<BufferPool> /* pool */) {}
+
+  /**
+   * Frees state derived from the key that can be rebuilt when the aead is
+   * next used (for example cipher contexts), keeping only the key itself.
+   * Implementations may or may not honor this.
+   */
+  virtual void releaseIdleResources() {}
+
+  /**
+   * Approximate bytes of memory held by the aead, including cipher state
+   * derived from the key. 0 if not known.
+   */
+  virtual size_t getMemoryUsage() const {
+    return 0;
+  }
+
   /**
    * Decrypt ciphertext. Will throw if the ciphertext does not decrypt
    * successfully.
@@ -83,6 +216,67 @@ class Aead {
       const folly::IOBuf* associatedData,
       uint64_t seqNum) const = 0;
 
+  /**
+   * Decrypts ciphertext into the memory described by the plaintext iovecs and
+   * returns the number of plaintext bytes written (ciphertext length -
+   * getCipherOverhead()), or none if the ciphertext does not decrypt
+   * successfully. The ciphertext is only read. The plaintext iovecs must not
+   * overlap the ciphertext, and their contents are unspecified if decryption
+   * fails. May still throw from errors unrelated to ciphertext.
+   *
+   * The default implementation decrypts a clone of the ciphertext and copies
+   * the result into the plaintext iovecs.
+   */
+  virtual folly::Optional<size_t> tryDecryptIovecs(
+      const folly::IOBuf& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum,
+      const struct iovec* plaintext,
+      size_t plaintextCount) const {
+    auto decrypted = tryDecrypt(ciphertext.clone(), associatedData, seqNum);
+    if (!decrypted) {
+      return folly::none;
+    }
+    auto outputLength = (*decrypted)->computeChainDataLength();
+
+    auto output = folly::IOBuf::wrapIov(plaintext, plaintextCount);
+    if (output->computeChainDataLength() < outputLength) {
+      throw std::runtime_error("plaintext iovecs too small");
+    }
+    folly::io::RWPrivateCursor cursor(output.get());
+    for (auto range : **decrypted) {
+      cursor.push(range);
+    }
+    return outputLength;
+  }
+
+  /**
+   * Same as decrypt() and tryDecrypt(), but the caller guarantees that nothing
+   * else will read or write the bytes referenced by ciphertext, so the aead may
+   * decrypt in place even if the IOBuf is shared (for example a record split
+   * out of a larger transport read buffer). The default implementations ignore
+   * the hint.
+   */
+  virtual std::unique_ptr<folly::IOBuf> decryptInPlace(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const {
+    return decrypt(
+        std::forward<std::unique_ptr<folly::IOBuf>>(ciphertext),
+        associatedData,
+        seqNum);
+  }
+
+  virtual folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecryptInPlace(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const {
+    return tryDecrypt(
+        std::forward<std::unique_ptr<folly::IOBuf>>(ciphertext),
+        associatedData,
+        seqNum);
+  }
+
   /**
    * Returns the number of bytes the aead will add to the plaintext (size of
    * ciphertext - size of plaintext).
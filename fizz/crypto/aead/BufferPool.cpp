@@ -0,0 +1,201 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/aead/BufferPool.h>
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+namespace fizz {
+
+namespace {
+constexpr size_t kNumSizeClasses = 10; // 64 ... 32k
+
+size_t sizeClassIndex(size_t capacity) {
+  size_t index = 0;
+  size_t classSize = SizeClassedBufferPool::kMinSizeClass;
+  while (classSize < capacity) {
+    classSize <<= 1;
+    index++;
+  }
+  return index;
+}
+
+size_t sizeClassSize(size_t index) {
+  return SizeClassedBufferPool::kMinSizeClass << index;
+}
+} // namespace
+
+namespace {
+// Every pooled block starts with a header recording where it came from. The
+// header is padded to keep the data suitably aligned.
+struct alignas(16) BlockHeader {
+  void* state;
+  size_t sizeClass;
+  BlockHeader* next;
+};
+} // namespace
+
+/**
+ * Shared between the pool and its outstanding buffers. Deleted once the pool
+ * has been destroyed and every buffer has been released.
+ *
+ * The free lists belong to the thread allocating from the pool and are used
+ * without synchronization. Buffers released on other threads (or after the
+ * pool is gone) are pushed onto a lock-free stack instead, which the owner
+ * takes over in one exchange once its own free list for a size class runs
+ * out. Only whole-stack takes ever pop from it, so it is not subject to ABA.
+ */
+struct SizeClassedBufferPool::State {
+  explicit State(size_t maxCached) : maxCachedPerSizeClass(maxCached) {}
+
+  ~State() {
+    for (auto& freeList : freeLists) {
+      freeBlocks(freeList);
+      freeList = nullptr;
+    }
+    freeBlocks(remote.exchange(nullptr));
+  }
+
+  static void freeBlocks(BlockHeader* block) {
+    while (block) {
+      auto next = block->next;
+      free(block);
+      block = next;
+    }
+  }
+
+  void release(BlockHeader* block) {
+    if (std::this_thread::get_id() == owner.load(std::memory_order_relaxed)) {
+      auto& count = cachedCounts[block->sizeClass];
+      if (count < maxCachedPerSizeClass) {
+        block->next = freeLists[block->sizeClass];
+        freeLists[block->sizeClass] = block;
+        ++count;
+      } else {
+        free(block);
+      }
+    } else {
+      auto head = remote.load(std::memory_order_relaxed);
+      do {
+        block->next = head;
+      } while (!remote.compare_exchange_weak(
+          head, block, std::memory_order_release, std::memory_order_relaxed));
+      remoteCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    unref();
+  }
+
+  /**
+   * Moves the blocks released on other threads onto the owner's free lists.
+   */
+  void collectRemote() {
+    auto block = remote.exchange(nullptr, std::memory_order_acquire);
+    while (block) {
+      remoteCount.fetch_sub(1, std::memory_order_relaxed);
+      auto next = block->next;
+      auto& count = cachedCounts[block->sizeClass];
+      if (count < maxCachedPerSizeClass) {
+        block->next = freeLists[block->sizeClass];
+        freeLists[block->sizeClass] = block;
+        ++count;
+      } else {
+        free(block);
+      }
+      block = next;
+    }
+  }
+
+  void unref() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  std::array<BlockHeader*, kNumSizeClasses> freeLists{};
+  std::array<size_t, kNumSizeClasses> cachedCounts{};
+  size_t maxCachedPerSizeClass;
+  std::atomic<std::thread::id> owner{};
+  std::atomic<BlockHeader*> remote{nullptr};
+  std::atomic<size_t> remoteCount{0};
+  // One for the pool and one for each outstanding buffer.
+  std::atomic<size_t> refs{1};
+};
+
+SizeClassedBufferPool::SizeClassedBufferPool(size_t maxCachedPerSizeClass)
+    : state_(new State(maxCachedPerSizeClass)) {
+  static_assert(
+      kMinSizeClass << (kNumSizeClasses - 1) == kMaxSizeClass,
+      "size classes do not cover the pooled range");
+}
+
+SizeClassedBufferPool::~SizeClassedBufferPool() {
+  // Buffers released from now on go to the remote stack, which is freed with
+  // the state.
+  state_->owner.store(std::thread::id(), std::memory_order_relaxed);
+  for (auto& freeList : state_->freeLists) {
+    State::freeBlocks(freeList);
+    freeList = nullptr;
+  }
+  state_->cachedCounts.fill(0);
+  state_->unref();
+}
+
+std::unique_ptr<folly::IOBuf> SizeClassedBufferPool::allocate(
+    size_t capacity) {
+  if (capacity > kMaxSizeClass) {
+    return folly::IOBuf::create(capacity);
+  }
+
+  auto thisThread = std::this_thread::get_id();
+  if (state_->owner.load(std::memory_order_relaxed) != thisThread) {
+    state_->owner.store(thisThread, std::memory_order_relaxed);
+  }
+
+  auto index = sizeClassIndex(capacity);
+  if (!state_->freeLists[index]) {
+    state_->collectRemote();
+  }
+  auto block = state_->freeLists[index];
+  if (block) {
+    state_->freeLists[index] = block->next;
+    --state_->cachedCounts[index];
+  } else {
+    block = static_cast<BlockHeader*>(
+        malloc(sizeof(BlockHeader) + sizeClassSize(index)));
+    if (!block) {
+      throw std::bad_alloc();
+    }
+    block->state = state_;
+    block->sizeClass = index;
+  }
+  state_->refs.fetch_add(1, std::memory_order_relaxed);
+
+  auto data = reinterpret_cast<uint8_t*>(block) + sizeof(BlockHeader);
+  return folly::IOBuf::takeOwnership(
+      data,
+      sizeClassSize(index),
+      0,
+      [](void* ptr, void* /* userData */) {
+        auto block = reinterpret_cast<BlockHeader*>(
+            static_cast<uint8_t*>(ptr) - sizeof(BlockHeader));
+        static_cast<State*>(block->state)->release(block);
+      },
+      nullptr);
+}
+
+size_t SizeClassedBufferPool::cachedBuffers() const {
+  size_t cached = state_->remoteCount.load(std::memory_order_relaxed);
+  for (auto count : state_->cachedCounts) {
+    cached += count;
+  }
+  return cached;
+}
+} // namespace fizz
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+
+namespace fizz {
+
+/**
+ * Source of the buffers the record layers and aeads allocate for ciphertexts,
+ * tags, and record footers.
+ */
+class BufferPool {
+ public:
+  virtual ~BufferPool() = default;
+
+  /**
+   * Returns an empty, unshared IOBuf with at least capacity bytes of tailroom.
+   */
+  virtual std::unique_ptr<folly::IOBuf> allocate(size_t capacity) = 0;
+};
+
+/**
+ * Allocates buf from pool if one is set, otherwise from the heap.
+ */
+inline std::unique_ptr<folly::IOBuf> allocateBuffer(
+    BufferPool* pool,
+    size_t capacity) {
+  return pool ? pool->allocate(capacity) : folly::IOBuf::create(capacity);
+}
+
+/**
+ * BufferPool that recycles buffers in power of two size classes. Must be
+ * allocated from and destroyed on a single thread at a time (for example one
+ * pool per EventBase); allocation and release on that thread take no locks.
+ * Buffers may be released on any thread, without locking, and may outlive the
+ * pool. Requests larger than kMaxSizeClass are served from the heap.
+ */
+class SizeClassedBufferPool : public BufferPool {
+ public:
+  static constexpr size_t kMinSizeClass = 64;
+  static constexpr size_t kMaxSizeClass = 32 * 1024;
+
+  explicit SizeClassedBufferPool(size_t maxCachedPerSizeClass = 64);
+  ~SizeClassedBufferPool() override;
+
+  SizeClassedBufferPool(const SizeClassedBufferPool&) = delete;
+  SizeClassedBufferPool& operator=(const SizeClassedBufferPool&) = delete;
+
+  std::unique_ptr<folly::IOBuf> allocate(size_t capacity) override;
+
+  /**
+   * Number of free buffers currently cached by the pool, including the ones
+   * released on other threads that have not been reused yet.
+   */
+  size_t cachedBuffers() const;
+
+ private:
+  struct State;
+
+  State* state_;
+};
+} // namespace fizz
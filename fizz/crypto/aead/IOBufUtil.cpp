@@ -8,6 +8,12 @@
 
 #include <fizz/crypto/aead/IOBufUtil.h>
 
+#include <folly/lang/Bits.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace folly;
 
 namespace fizz {
@@ -32,8 +38,32 @@ void trimBytes(IOBuf& buf, folly::MutableByteRange trimmed) {
 
 void XOR(ByteRange first, MutableByteRange second) {
   CHECK_EQ(first.size(), second.size());
-  for (size_t i = 0; i < first.size(); ++i) {
-    second[i] ^= first[i];
+  auto in = first.data();
+  auto out = second.begin();
+  auto length = first.size();
+#if defined(__SSE2__)
+  for (; length >= 4 * sizeof(__m128i); length -= 4 * sizeof(__m128i)) {
+    auto src = reinterpret_cast<const __m128i*>(in);
+    auto dst = reinterpret_cast<__m128i*>(out);
+    for (size_t i = 0; i < 4; ++i) {
+      _mm_storeu_si128(
+          dst + i,
+          _mm_xor_si128(_mm_loadu_si128(dst + i), _mm_loadu_si128(src + i)));
+    }
+    in += 4 * sizeof(__m128i);
+    out += 4 * sizeof(__m128i);
+  }
+#endif
+  for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t)) {
+    folly::storeUnaligned<uint64_t>(
+        out,
+        folly::loadUnaligned<uint64_t>(out) ^
+            folly::loadUnaligned<uint64_t>(in));
+    in += sizeof(uint64_t);
+    out += sizeof(uint64_t);
   }
-};
+  for (size_t i = 0; i < length; ++i) {
+    out[i] ^= in[i];
+  }
+}
 } // namespace fizz
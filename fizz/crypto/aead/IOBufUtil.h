@@ -59,6 +59,23 @@ void transformBuffer(const folly::IOBuf& in, folly::IOBuf& out, Func func) {
   }
 }
 
+namespace detail {
+/**
+ * Whether every buffer in the chain except the last holds a whole number of
+ * blocks.
+ */
+template <size_t BlockSize>
+bool blockAligned(const folly::IOBuf& buf) {
+  for (auto current = &buf; current->next() != &buf;
+       current = current->next()) {
+    if (current->length() % BlockSize != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace detail
+
 /**
  * Useful when we need to run a function that performs operations in chunks
  * and transforms data from in -> out, regardless of whether in or out is
@@ -73,6 +90,21 @@ void transformBuffer(const folly::IOBuf& in, folly::IOBuf& out, Func func) {
 template <size_t BlockSize, typename Func>
 folly::io::RWPrivateCursor
 transformBufferBlocks(const folly::IOBuf& in, folly::IOBuf& out, Func func) {
+  // In place on a block aligned chain every buffer is passed to func as is,
+  // only the last one can leave data buffered in func.
+  if (&in == &out && detail::blockAligned<BlockSize>(out)) {
+    size_t written = 0;
+    auto current = &out;
+    do {
+      written +=
+          func(current->writableData(), current->data(), current->length());
+      current = current->next();
+    } while (current != &out);
+    folly::io::RWPrivateCursor output(&out);
+    output.skip(written);
+    return output;
+  }
+
   size_t internallyBuffered = 0;
   folly::io::RWPrivateCursor output(&out);
   folly::io::Cursor input(&in);
@@ -0,0 +1,414 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/aead/NativeAESGCM.h>
+
+#include <fizz/crypto/aead/AESNI.h>
+
+#define FIZZ_HAVE_NATIVE_AESGCM FIZZ_HAVE_AESNI
+
+#if FIZZ_HAVE_NATIVE_AESGCM
+#include <folly/CpuId.h>
+
+#define FIZZ_AESGCM_TARGET __attribute__((target("aes,pclmul,sse4.1")))
+#endif
+
+namespace fizz {
+namespace detail {
+
+#if FIZZ_HAVE_NATIVE_AESGCM
+namespace {
+
+constexpr size_t kBlockSize = 16;
+constexpr size_t kParallelBlocks = NativeAESGCMKey::kNumHPowers;
+
+/**
+ * State for a single encryption or decryption. GHASH values are kept byte
+ * reflected, following Intel's "Carry-Less Multiplication and Its Usage for
+ * Computing the GCM Mode" white paper.
+ */
+struct GCMState {
+  __m128i roundKeys[NativeAESGCMKey::kMaxRounds + 1];
+  size_t rounds;
+  // hPowers[i] is H^(i + 1).
+  __m128i hPowers[kParallelBlocks];
+
+  // Nonce with an empty 32 bit counter.
+  __m128i counterBase;
+  uint32_t counter;
+
+  __m128i ghash;
+  bool encrypt;
+
+  // Keystream and ciphertext bytes of a block that was only partially
+  // processed so far, when the input is split across buffers.
+  alignas(16) uint8_t keystream[kBlockSize];
+  alignas(16) uint8_t partial[kBlockSize];
+  size_t partialLength;
+
+  uint64_t aadLength;
+  uint64_t textLength;
+};
+
+FIZZ_AESGCM_TARGET inline __m128i byteSwap(__m128i value) {
+  const __m128i mask =
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  return _mm_shuffle_epi8(value, mask);
+}
+
+FIZZ_AESGCM_TARGET inline __m128i
+aesEncryptBlock(const GCMState& state, __m128i block) {
+  block = _mm_xor_si128(block, state.roundKeys[0]);
+  for (size_t i = 1; i < state.rounds; ++i) {
+    block = _mm_aesenc_si128(block, state.roundKeys[i]);
+  }
+  return _mm_aesenclast_si128(block, state.roundKeys[state.rounds]);
+}
+
+FIZZ_AESGCM_TARGET inline __m128i counterBlock(
+    const GCMState& state,
+    uint32_t counter) {
+  return _mm_insert_epi32(
+      state.counterBase, static_cast<int>(__builtin_bswap32(counter)), 3);
+}
+
+/**
+ * Accumulates the unreduced carry-less product of a and b.
+ */
+FIZZ_AESGCM_TARGET inline void
+clmulAccumulate(__m128i a, __m128i b, __m128i& lo, __m128i& mid, __m128i& hi) {
+  lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+  hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+  mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x10));
+  mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x01));
+}
+
+/**
+ * Reduces an accumulated product modulo the GCM polynomial. This is linear, so
+ * several products can be accumulated and reduced once.
+ */
+FIZZ_AESGCM_TARGET inline __m128i
+reduce(__m128i lo, __m128i mid, __m128i hi) {
+  __m128i tmp3 = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+  __m128i tmp6 = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+  // Shift the 256 bit product left by one to account for the bit reflection.
+  __m128i tmp7 = _mm_srli_epi32(tmp3, 31);
+  __m128i tmp8 = _mm_srli_epi32(tmp6, 31);
+  tmp3 = _mm_slli_epi32(tmp3, 1);
+  tmp6 = _mm_slli_epi32(tmp6, 1);
+  __m128i tmp9 = _mm_srli_si128(tmp7, 12);
+  tmp8 = _mm_slli_si128(tmp8, 4);
+  tmp7 = _mm_slli_si128(tmp7, 4);
+  tmp3 = _mm_or_si128(tmp3, tmp7);
+  tmp6 = _mm_or_si128(tmp6, tmp8);
+  tmp6 = _mm_or_si128(tmp6, tmp9);
+
+  // Reduce.
+  tmp7 = _mm_slli_epi32(tmp3, 31);
+  tmp8 = _mm_slli_epi32(tmp3, 30);
+  tmp9 = _mm_slli_epi32(tmp3, 25);
+  tmp7 = _mm_xor_si128(tmp7, tmp8);
+  tmp7 = _mm_xor_si128(tmp7, tmp9);
+  tmp8 = _mm_srli_si128(tmp7, 4);
+  tmp7 = _mm_slli_si128(tmp7, 12);
+  tmp3 = _mm_xor_si128(tmp3, tmp7);
+
+  __m128i tmp2 = _mm_srli_epi32(tmp3, 1);
+  __m128i tmp4 = _mm_srli_epi32(tmp3, 2);
+  __m128i tmp5 = _mm_srli_epi32(tmp3, 7);
+  tmp2 = _mm_xor_si128(tmp2, tmp4);
+  tmp2 = _mm_xor_si128(tmp2, tmp5);
+  tmp2 = _mm_xor_si128(tmp2, tmp8);
+  tmp3 = _mm_xor_si128(tmp3, tmp2);
+  return _mm_xor_si128(tmp6, tmp3);
+}
+
+FIZZ_AESGCM_TARGET inline __m128i gfmul(__m128i a, __m128i b) {
+  __m128i lo = _mm_setzero_si128();
+  __m128i mid = _mm_setzero_si128();
+  __m128i hi = _mm_setzero_si128();
+  clmulAccumulate(a, b, lo, mid, hi);
+  return reduce(lo, mid, hi);
+}
+
+FIZZ_AESGCM_TARGET inline void ghashBlock(GCMState& state, __m128i block) {
+  state.ghash =
+      gfmul(_mm_xor_si128(state.ghash, byteSwap(block)), state.hPowers[0]);
+}
+
+/**
+ * Folds kParallelBlocks blocks into the GHASH state with a single reduction:
+ * (X + C1) * H^8 + C2 * H^7 + ... + C8 * H.
+ */
+FIZZ_AESGCM_TARGET inline void ghashBlocks(
+    GCMState& state,
+    const __m128i* blocks) {
+  __m128i lo = _mm_setzero_si128();
+  __m128i mid = _mm_setzero_si128();
+  __m128i hi = _mm_setzero_si128();
+  clmulAccumulate(
+      _mm_xor_si128(state.ghash, byteSwap(blocks[0])),
+      state.hPowers[kParallelBlocks - 1],
+      lo,
+      mid,
+      hi);
+  for (size_t i = 1; i < kParallelBlocks; ++i) {
+    clmulAccumulate(
+        byteSwap(blocks[i]),
+        state.hPowers[kParallelBlocks - 1 - i],
+        lo,
+        mid,
+        hi);
+  }
+  state.ghash = reduce(lo, mid, hi);
+}
+
+FIZZ_AESGCM_TARGET void
+initState(GCMState& state, const NativeAESGCMKey& key, folly::ByteRange nonce) {
+  state.rounds = key.rounds;
+  for (size_t i = 0; i <= key.rounds; ++i) {
+    state.roundKeys[i] = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(key.roundKeys.data() + i * 16));
+  }
+  for (size_t i = 0; i < kParallelBlocks; ++i) {
+    state.hPowers[i] = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(key.hPowers.data() + i * 16));
+  }
+  alignas(16) uint8_t base[kBlockSize] = {};
+  memcpy(base, nonce.data(), 12);
+  state.counterBase = _mm_load_si128(reinterpret_cast<const __m128i*>(base));
+  // Counter 1 is used for the tag.
+  state.counter = 2;
+  state.ghash = _mm_setzero_si128();
+  state.partialLength = 0;
+  state.aadLength = 0;
+  state.textLength = 0;
+}
+
+FIZZ_AESGCM_TARGET void hashAssociatedData(
+    GCMState& state,
+    const folly::IOBuf& associatedData) {
+  for (auto current : associatedData) {
+    auto data = current.data();
+    auto length = current.size();
+    state.aadLength += length;
+    while (length > 0) {
+      auto toCopy = std::min(length, kBlockSize - state.partialLength);
+      memcpy(state.partial + state.partialLength, data, toCopy);
+      state.partialLength += toCopy;
+      data += toCopy;
+      length -= toCopy;
+      if (state.partialLength == kBlockSize) {
+        ghashBlock(
+            state,
+            _mm_load_si128(reinterpret_cast<const __m128i*>(state.partial)));
+        state.partialLength = 0;
+      }
+    }
+  }
+  // Associated data is zero padded to a full block.
+  if (state.partialLength != 0) {
+    memset(
+        state.partial + state.partialLength,
+        0,
+        kBlockSize - state.partialLength);
+    ghashBlock(
+        state, _mm_load_si128(reinterpret_cast<const __m128i*>(state.partial)));
+    state.partialLength = 0;
+  }
+}
+
+FIZZ_AESGCM_TARGET void
+processBytes(GCMState& state, uint8_t* out, const uint8_t* in, size_t length) {
+  state.textLength += length;
+
+  // Finish a block started in a previous buffer.
+  while (state.partialLength != 0 && length > 0) {
+    uint8_t input = *in++;
+    uint8_t output = input ^ state.keystream[state.partialLength];
+    state.partial[state.partialLength] = state.encrypt ? output : input;
+    *out++ = output;
+    length--;
+    if (++state.partialLength == kBlockSize) {
+      ghashBlock(
+          state,
+          _mm_load_si128(reinterpret_cast<const __m128i*>(state.partial)));
+      state.partialLength = 0;
+    }
+  }
+
+  while (length >= kParallelBlocks * kBlockSize) {
+    __m128i blocks[kParallelBlocks];
+    for (size_t i = 0; i < kParallelBlocks; ++i) {
+      blocks[i] = _mm_xor_si128(
+          counterBlock(state, state.counter + i), state.roundKeys[0]);
+    }
+    state.counter += kParallelBlocks;
+    for (size_t round = 1; round < state.rounds; ++round) {
+      for (size_t i = 0; i < kParallelBlocks; ++i) {
+        blocks[i] = _mm_aesenc_si128(blocks[i], state.roundKeys[round]);
+      }
+    }
+    __m128i cipherBlocks[kParallelBlocks];
+    for (size_t i = 0; i < kParallelBlocks; ++i) {
+      auto keystream =
+          _mm_aesenclast_si128(blocks[i], state.roundKeys[state.rounds]);
+      auto input = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(in + i * kBlockSize));
+      auto output = _mm_xor_si128(input, keystream);
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(out + i * kBlockSize), output);
+      cipherBlocks[i] = state.encrypt ? output : input;
+    }
+    ghashBlocks(state, cipherBlocks);
+    in += kParallelBlocks * kBlockSize;
+    out += kParallelBlocks * kBlockSize;
+    length -= kParallelBlocks * kBlockSize;
+  }
+
+  while (length >= kBlockSize) {
+    auto keystream = aesEncryptBlock(state, counterBlock(state, state.counter));
+    state.counter++;
+    auto input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    auto output = _mm_xor_si128(input, keystream);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), output);
+    ghashBlock(state, state.encrypt ? output : input);
+    in += kBlockSize;
+    out += kBlockSize;
+    length -= kBlockSize;
+  }
+
+  if (length > 0) {
+    auto keystream = aesEncryptBlock(state, counterBlock(state, state.counter));
+    state.counter++;
+    _mm_store_si128(reinterpret_cast<__m128i*>(state.keystream), keystream);
+    for (size_t i = 0; i < length; ++i) {
+      uint8_t output = in[i] ^ state.keystream[i];
+      state.partial[i] = state.encrypt ? output : in[i];
+      out[i] = output;
+    }
+    state.partialLength = length;
+  }
+}
+
+FIZZ_AESGCM_TARGET void finish(GCMState& state, folly::MutableByteRange tag) {
+  if (state.partialLength != 0) {
+    memset(
+        state.partial + state.partialLength,
+        0,
+        kBlockSize - state.partialLength);
+    ghashBlock(
+        state, _mm_load_si128(reinterpret_cast<const __m128i*>(state.partial)));
+  }
+  __m128i lengths = _mm_setzero_si128();
+  lengths = _mm_insert_epi64(
+      lengths, static_cast<long long>(state.textLength * 8), 0);
+  lengths =
+      _mm_insert_epi64(lengths, static_cast<long long>(state.aadLength * 8), 1);
+  state.ghash = gfmul(_mm_xor_si128(state.ghash, lengths), state.hPowers[0]);
+
+  auto tagMask = aesEncryptBlock(state, counterBlock(state, 1));
+  alignas(16) uint8_t fullTag[kBlockSize];
+  _mm_store_si128(
+      reinterpret_cast<__m128i*>(fullTag),
+      _mm_xor_si128(byteSwap(state.ghash), tagMask));
+  memcpy(tag.begin(), fullTag, std::min(tag.size(), kBlockSize));
+}
+
+FIZZ_AESGCM_TARGET void setKeyImpl(folly::ByteRange key, NativeAESGCMKey& out) {
+  GCMState state;
+  if (key.size() == 16) {
+    state.rounds = 10;
+    aesni::expandKey128(key.data(), state.roundKeys);
+  } else if (key.size() == 32) {
+    state.rounds = 14;
+    aesni::expandKey256(key.data(), state.roundKeys);
+  } else {
+    throw std::runtime_error("Invalid key");
+  }
+  out.rounds = state.rounds;
+  for (size_t i = 0; i <= state.rounds; ++i) {
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(out.roundKeys.data() + i * 16),
+        state.roundKeys[i]);
+  }
+
+  auto h = byteSwap(aesEncryptBlock(state, _mm_setzero_si128()));
+  auto power = h;
+  for (size_t i = 0; i < kParallelBlocks; ++i) {
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(out.hPowers.data() + i * 16), power);
+    power = gfmul(power, h);
+  }
+}
+} // namespace
+
+bool nativeAESGCMSupported() {
+  static const bool supported = [] {
+    folly::CpuId cpu;
+    return cpu.aes() && cpu.pclmuldq() && cpu.sse41();
+  }();
+  return supported;
+}
+
+void nativeAESGCMSetKey(folly::ByteRange key, NativeAESGCMKey& out) {
+  if (!nativeAESGCMSupported()) {
+    throw std::runtime_error("native aes-gcm not supported");
+  }
+  setKeyImpl(key, out);
+}
+
+void nativeAESGCMCrypt(
+    const NativeAESGCMKey& key,
+    folly::ByteRange nonce,
+    const folly::IOBuf* associatedData,
+    const folly::IOBuf& in,
+    folly::IOBuf& out,
+    bool encrypt,
+    folly::MutableByteRange tag) {
+  if (key.rounds == 0) {
+    throw std::runtime_error("native aes-gcm key not set");
+  }
+  if (nonce.size() != 12) {
+    throw std::runtime_error("Invalid IV");
+  }
+  GCMState state;
+  initState(state, key, nonce);
+  state.encrypt = encrypt;
+  if (associatedData) {
+    hashAssociatedData(state, *associatedData);
+  }
+  transformBuffer(
+      in, out, [&state](uint8_t* output, const uint8_t* input, size_t len) {
+        processBytes(state, output, input, len);
+      });
+  finish(state, tag);
+}
+#else
+bool nativeAESGCMSupported() {
+  return false;
+}
+
+void nativeAESGCMSetKey(folly::ByteRange, NativeAESGCMKey&) {
+  throw std::runtime_error("native aes-gcm not supported");
+}
+
+void nativeAESGCMCrypt(
+    const NativeAESGCMKey&,
+    folly::ByteRange,
+    const folly::IOBuf*,
+    const folly::IOBuf&,
+    folly::IOBuf&,
+    bool,
+    folly::MutableByteRange) {
+  throw std::runtime_error("native aes-gcm not supported");
+}
+#endif
+} // namespace detail
+} // namespace fizz
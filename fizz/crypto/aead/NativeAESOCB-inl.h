@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <openssl/crypto.h>
+
+namespace fizz {
+
+template <typename AESImpl>
+void NativeAESOCB<AESImpl>::setKey(TrafficKey trafficKey) {
+  trafficKey.key->coalesce();
+  trafficKey.iv->coalesce();
+  if (trafficKey.key->length() != AESImpl::kKeyLength) {
+    throw std::runtime_error("Invalid key");
+  }
+  if (trafficKey.iv->length() != AESImpl::kIVLength) {
+    throw std::runtime_error("Invalid IV");
+  }
+  trafficKey_ = std::move(trafficKey);
+  memcpy(iv_.data(), trafficKey_.iv->data(), iv_.size());
+  detail::nativeAESOCBSetKey(
+      folly::range(trafficKey_.key->data(), trafficKey_.key->tail()), key_);
+}
+
+template <typename AESImpl>
+std::unique_ptr<folly::IOBuf> NativeAESOCB<AESImpl>::encrypt(
+    std::unique_ptr<folly::IOBuf>&& plaintext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  auto iv = createIV(seqNum);
+  auto inputLength = plaintext->computeChainDataLength();
+  constexpr auto tagLen = AESImpl::kTagLength;
+
+  std::unique_ptr<folly::IOBuf> output;
+  folly::IOBuf* input;
+  if (plaintext->isShared()) {
+    output =
+        allocateBuffer(bufferPool_.get(), headroom_ + inputLength + tagLen);
+    output->advance(headroom_);
+    output->append(inputLength);
+    input = plaintext.get();
+  } else {
+    output = std::move(plaintext);
+    input = output.get();
+  }
+
+  std::array<uint8_t, tagLen> tag;
+  detail::nativeAESOCBCrypt(
+      key_, folly::range(iv), associatedData, *input, *output, true, {tag});
+
+  auto lastBuf = output->prev();
+  if (lastBuf->tailroom() < tagLen) {
+    auto tagBuf = allocateBuffer(bufferPool_.get(), tagLen);
+    memcpy(tagBuf->writableData(), tag.data(), tagLen);
+    tagBuf->append(tagLen);
+    output->prependChain(std::move(tagBuf));
+  } else {
+    memcpy(lastBuf->writableTail(), tag.data(), tagLen);
+    lastBuf->append(tagLen);
+  }
+  return output;
+}
+
+template <typename AESImpl>
+size_t NativeAESOCB<AESImpl>::encryptIovecs(
+    const struct iovec* plaintext,
+    size_t plaintextCount,
+    const struct iovec* ciphertext,
+    size_t ciphertextCount,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  constexpr auto tagLen = AESImpl::kTagLength;
+  auto input = folly::IOBuf::wrapIov(plaintext, plaintextCount);
+  auto output = folly::IOBuf::wrapIov(ciphertext, ciphertextCount);
+  auto inputLength = input->computeChainDataLength();
+  if (output->computeChainDataLength() < inputLength + tagLen) {
+    throw std::runtime_error("ciphertext iovecs too small");
+  }
+
+  auto iv = createIV(seqNum);
+  std::array<uint8_t, tagLen> tag;
+  detail::nativeAESOCBCrypt(
+      key_, folly::range(iv), associatedData, *input, *output, true, {tag});
+
+  folly::io::RWPrivateCursor cursor(output.get());
+  cursor.skip(inputLength);
+  cursor.push(tag.data(), tagLen);
+  return inputLength + tagLen;
+}
+
+template <typename AESImpl>
+folly::Optional<std::unique_ptr<folly::IOBuf>>
+NativeAESOCB<AESImpl>::doDecrypt(
+    std::unique_ptr<folly::IOBuf>&& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum,
+    bool inPlace) const {
+  constexpr auto tagLen = AESImpl::kTagLength;
+  auto inputLength = ciphertext->computeChainDataLength();
+  if (inputLength < tagLen) {
+    return folly::none;
+  }
+  inputLength -= tagLen;
+
+  std::array<uint8_t, tagLen> expectedTag;
+  trimBytes(*ciphertext, {expectedTag});
+
+  std::unique_ptr<folly::IOBuf> output;
+  folly::IOBuf* input;
+  if (ciphertext->isShared() && !inPlace) {
+    output = folly::IOBuf::create(inputLength);
+    output->append(inputLength);
+    input = ciphertext.get();
+  } else {
+    output = std::move(ciphertext);
+    input = output.get();
+  }
+
+  auto iv = createIV(seqNum);
+  std::array<uint8_t, tagLen> tag;
+  detail::nativeAESOCBCrypt(
+      key_, folly::range(iv), associatedData, *input, *output, false, {tag});
+  if (CRYPTO_memcmp(tag.data(), expectedTag.data(), tagLen) != 0) {
+    return folly::none;
+  }
+  return std::move(output);
+}
+
+template <typename AESImpl>
+std::array<uint8_t, AESImpl::kIVLength> NativeAESOCB<AESImpl>::createIV(
+    uint64_t seqNum) const {
+  std::array<uint8_t, AESImpl::kIVLength> iv = iv_;
+  const size_t prefixLength = AESImpl::kIVLength - sizeof(uint64_t);
+  auto suffix = folly::loadUnaligned<uint64_t>(iv.data() + prefixLength);
+  folly::storeUnaligned<uint64_t>(
+      iv.data() + prefixLength, suffix ^ folly::Endian::big(seqNum));
+  return iv;
+}
+} // namespace fizz
@@ -0,0 +1,409 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/aead/NativeAESOCB.h>
+
+#include <fizz/crypto/aead/AESNI.h>
+
+#if FIZZ_HAVE_AESNI
+#include <folly/CpuId.h>
+#endif
+
+namespace fizz {
+namespace detail {
+
+#if FIZZ_HAVE_AESNI
+namespace {
+
+constexpr size_t kBlockSize = 16;
+constexpr size_t kParallelBlocks = 8;
+
+/**
+ * State for a single encryption or decryption. Offsets and the checksum are
+ * byte strings, so they are only ever XORed and need no byte swapping.
+ */
+struct OCBState {
+  const NativeAESOCBKey* key;
+  __m128i roundKeys[NativeAESOCBKey::kMaxRounds + 1];
+  // Only loaded when decrypting.
+  __m128i decryptRoundKeys[NativeAESOCBKey::kMaxRounds + 1];
+  size_t rounds;
+  bool encrypt;
+
+  __m128i offset;
+  __m128i checksum;
+  // Index of the last block processed, starting at 1.
+  uint64_t blockIndex;
+};
+
+FIZZ_AESNI_TARGET inline __m128i load(const uint8_t* data) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+}
+
+FIZZ_AESNI_TARGET inline void store(uint8_t* data, __m128i value) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(data), value);
+}
+
+FIZZ_AESNI_TARGET inline __m128i encipher(
+    const __m128i* roundKeys,
+    size_t rounds,
+    __m128i block) {
+  block = _mm_xor_si128(block, roundKeys[0]);
+  for (size_t i = 1; i < rounds; ++i) {
+    block = _mm_aesenc_si128(block, roundKeys[i]);
+  }
+  return _mm_aesenclast_si128(block, roundKeys[rounds]);
+}
+
+FIZZ_AESNI_TARGET inline __m128i encipherBlock(
+    const OCBState& state,
+    __m128i block) {
+  return encipher(state.roundKeys, state.rounds, block);
+}
+
+/**
+ * Enciphers blocks in place when encrypting, deciphers them when decrypting.
+ */
+FIZZ_AESNI_TARGET inline void cipherBlocks(
+    const OCBState& state,
+    __m128i* blocks,
+    size_t count) {
+  if (state.encrypt) {
+    for (size_t i = 0; i < count; ++i) {
+      blocks[i] = _mm_xor_si128(blocks[i], state.roundKeys[0]);
+    }
+    for (size_t round = 1; round < state.rounds; ++round) {
+      for (size_t i = 0; i < count; ++i) {
+        blocks[i] = _mm_aesenc_si128(blocks[i], state.roundKeys[round]);
+      }
+    }
+    for (size_t i = 0; i < count; ++i) {
+      blocks[i] =
+          _mm_aesenclast_si128(blocks[i], state.roundKeys[state.rounds]);
+    }
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      blocks[i] = _mm_xor_si128(blocks[i], state.decryptRoundKeys[0]);
+    }
+    for (size_t round = 1; round < state.rounds; ++round) {
+      for (size_t i = 0; i < count; ++i) {
+        blocks[i] = _mm_aesdec_si128(blocks[i], state.decryptRoundKeys[round]);
+      }
+    }
+    for (size_t i = 0; i < count; ++i) {
+      blocks[i] = _mm_aesdeclast_si128(
+          blocks[i], state.decryptRoundKeys[state.rounds]);
+    }
+  }
+}
+
+FIZZ_AESNI_TARGET inline __m128i nextOffset(
+    const NativeAESOCBKey& key,
+    __m128i offset,
+    uint64_t index) {
+  auto ntz = static_cast<size_t>(__builtin_ctzll(index));
+  return _mm_xor_si128(offset, load(key.l.data() + ntz * kBlockSize));
+}
+
+/**
+ * Offset_0 from the nonce, see RFC 7253 section 4.2.
+ */
+FIZZ_AESNI_TARGET __m128i
+initialOffset(const OCBState& state, folly::ByteRange nonce) {
+  // num2str(TAGLEN mod 128, 7) || zeros(120 - bitlen(N)) || 1 || N, with a
+  // 128 bit tag and a 96 bit nonce.
+  alignas(16) uint8_t block[kBlockSize] = {};
+  block[3] = 0x01;
+  memcpy(block + 4, nonce.data(), 12);
+  size_t bottom = block[kBlockSize - 1] & 0x3f;
+  block[kBlockSize - 1] &= 0xc0;
+
+  // Stretch = Ktop || (Ktop[1..64] xor Ktop[9..72])
+  uint8_t stretch[kBlockSize + 8];
+  store(stretch, encipherBlock(state, load(block)));
+  for (size_t i = 0; i < 8; ++i) {
+    stretch[kBlockSize + i] = stretch[i] ^ stretch[i + 1];
+  }
+
+  // Offset_0 = Stretch[1 + bottom..128 + bottom]
+  size_t byteShift = bottom / 8;
+  size_t bitShift = bottom % 8;
+  for (size_t i = 0; i < kBlockSize; ++i) {
+    uint8_t value = static_cast<uint8_t>(stretch[i + byteShift] << bitShift);
+    if (bitShift != 0) {
+      value |= stretch[i + byteShift + 1] >> (8 - bitShift);
+    }
+    block[i] = value;
+  }
+  return load(block);
+}
+
+FIZZ_AESNI_TARGET void initState(
+    OCBState& state,
+    const NativeAESOCBKey& key,
+    bool encrypt,
+    folly::ByteRange nonce) {
+  state.key = &key;
+  state.rounds = key.rounds;
+  state.encrypt = encrypt;
+  for (size_t i = 0; i <= key.rounds; ++i) {
+    state.roundKeys[i] = load(key.roundKeys.data() + i * kBlockSize);
+    if (!encrypt) {
+      state.decryptRoundKeys[i] =
+          load(key.decryptRoundKeys.data() + i * kBlockSize);
+    }
+  }
+  state.offset = initialOffset(state, nonce);
+  state.checksum = _mm_setzero_si128();
+  state.blockIndex = 0;
+}
+
+/**
+ * HASH(K, A) from RFC 7253 section 4.1.
+ */
+FIZZ_AESNI_TARGET __m128i
+hashAssociatedData(const OCBState& state, const folly::IOBuf& associatedData) {
+  const auto& key = *state.key;
+  __m128i sum = _mm_setzero_si128();
+  __m128i offset = _mm_setzero_si128();
+  uint64_t index = 0;
+  folly::io::Cursor cursor(&associatedData);
+  auto remaining = associatedData.computeChainDataLength();
+  alignas(16) uint8_t block[kBlockSize];
+  while (remaining >= kBlockSize) {
+    cursor.pull(block, kBlockSize);
+    offset = nextOffset(key, offset, ++index);
+    sum = _mm_xor_si128(
+        sum, encipherBlock(state, _mm_xor_si128(load(block), offset)));
+    remaining -= kBlockSize;
+  }
+  if (remaining > 0) {
+    memset(block, 0, kBlockSize);
+    cursor.pull(block, remaining);
+    block[remaining] = 0x80;
+    offset = _mm_xor_si128(offset, load(key.lStar.data()));
+    sum = _mm_xor_si128(
+        sum, encipherBlock(state, _mm_xor_si128(load(block), offset)));
+  }
+  return sum;
+}
+
+/**
+ * Processes count full blocks from in into out, which may overlap exactly.
+ */
+FIZZ_AESNI_TARGET void processBlocks(
+    OCBState& state,
+    uint8_t* out,
+    const uint8_t* in,
+    size_t count) {
+  const auto& key = *state.key;
+  while (count > 0) {
+    auto batch = std::min(count, kParallelBlocks);
+    __m128i offsets[kParallelBlocks];
+    __m128i blocks[kParallelBlocks];
+    for (size_t i = 0; i < batch; ++i) {
+      state.offset = nextOffset(key, state.offset, ++state.blockIndex);
+      offsets[i] = state.offset;
+      auto input = load(in + i * kBlockSize);
+      if (state.encrypt) {
+        state.checksum = _mm_xor_si128(state.checksum, input);
+      }
+      blocks[i] = _mm_xor_si128(input, offsets[i]);
+    }
+    cipherBlocks(state, blocks, batch);
+    for (size_t i = 0; i < batch; ++i) {
+      auto output = _mm_xor_si128(blocks[i], offsets[i]);
+      if (!state.encrypt) {
+        state.checksum = _mm_xor_si128(state.checksum, output);
+      }
+      store(out + i * kBlockSize, output);
+    }
+    in += batch * kBlockSize;
+    out += batch * kBlockSize;
+    count -= batch;
+  }
+}
+
+/**
+ * Processes the final partial block (P_* or C_*) of length bytes.
+ */
+FIZZ_AESNI_TARGET void
+processFinal(OCBState& state, uint8_t* out, const uint8_t* in, size_t length) {
+  state.offset = _mm_xor_si128(state.offset, load(state.key->lStar.data()));
+  alignas(16) uint8_t pad[kBlockSize];
+  store(pad, encipherBlock(state, state.offset));
+  alignas(16) uint8_t padded[kBlockSize] = {};
+  for (size_t i = 0; i < length; ++i) {
+    uint8_t output = in[i] ^ pad[i];
+    padded[i] = state.encrypt ? in[i] : output;
+    out[i] = output;
+  }
+  padded[length] = 0x80;
+  state.checksum = _mm_xor_si128(state.checksum, load(padded));
+}
+
+/**
+ * Walks in and out together, handing contiguous runs of full blocks to
+ * processBlocks directly and copying only blocks that straddle buffers.
+ */
+FIZZ_AESNI_TARGET void
+processBuffer(OCBState& state, const folly::IOBuf& in, folly::IOBuf& out) {
+  folly::io::Cursor input(&in);
+  folly::io::RWPrivateCursor output(&out);
+  auto remaining = in.computeChainDataLength();
+  alignas(16) uint8_t block[kBlockSize];
+  while (remaining >= kBlockSize) {
+    auto contiguous = std::min(
+        {input.peekBytes().size(), output.peekBytes().size(), remaining});
+    contiguous -= contiguous % kBlockSize;
+    if (contiguous != 0) {
+      processBlocks(
+          state, output.writableData(), input.data(), contiguous / kBlockSize);
+      input.skip(contiguous);
+      output.skip(contiguous);
+      remaining -= contiguous;
+    } else {
+      input.pull(block, kBlockSize);
+      processBlocks(state, block, block, 1);
+      output.push(block, kBlockSize);
+      remaining -= kBlockSize;
+    }
+  }
+  if (remaining > 0) {
+    input.pull(block, remaining);
+    processFinal(state, block, block, remaining);
+    output.push(block, remaining);
+  }
+}
+
+FIZZ_AESNI_TARGET void finish(
+    OCBState& state,
+    const folly::IOBuf* associatedData,
+    folly::MutableByteRange tag) {
+  auto tagInput = _mm_xor_si128(
+      _mm_xor_si128(state.checksum, state.offset),
+      load(state.key->lDollar.data()));
+  auto fullTag = encipherBlock(state, tagInput);
+  if (associatedData) {
+    fullTag =
+        _mm_xor_si128(fullTag, hashAssociatedData(state, *associatedData));
+  }
+  alignas(16) uint8_t tagBytes[kBlockSize];
+  store(tagBytes, fullTag);
+  memcpy(tag.begin(), tagBytes, std::min(tag.size(), kBlockSize));
+}
+
+/**
+ * double() from RFC 7253 section 2, on big endian byte strings.
+ */
+void doubleBlock(const uint8_t* in, uint8_t* out) {
+  uint8_t carry = in[0] >> 7;
+  for (size_t i = 0; i < kBlockSize - 1; ++i) {
+    out[i] = static_cast<uint8_t>((in[i] << 1) | (in[i + 1] >> 7));
+  }
+  out[kBlockSize - 1] =
+      static_cast<uint8_t>((in[kBlockSize - 1] << 1) ^ (carry ? 0x87 : 0));
+}
+
+FIZZ_AESNI_TARGET void setKeyImpl(folly::ByteRange key, NativeAESOCBKey& out) {
+  __m128i roundKeys[NativeAESOCBKey::kMaxRounds + 1];
+  size_t rounds;
+  if (key.size() == 16) {
+    rounds = 10;
+    aesni::expandKey128(key.data(), roundKeys);
+  } else if (key.size() == 32) {
+    rounds = 14;
+    aesni::expandKey256(key.data(), roundKeys);
+  } else {
+    throw std::runtime_error("Invalid key");
+  }
+  out.rounds = rounds;
+  for (size_t i = 0; i <= rounds; ++i) {
+    store(out.roundKeys.data() + i * kBlockSize, roundKeys[i]);
+  }
+  // The equivalent inverse cipher's round keys, for AESDEC.
+  store(out.decryptRoundKeys.data(), roundKeys[rounds]);
+  for (size_t i = 1; i < rounds; ++i) {
+    store(
+        out.decryptRoundKeys.data() + i * kBlockSize,
+        _mm_aesimc_si128(roundKeys[rounds - i]));
+  }
+  store(out.decryptRoundKeys.data() + rounds * kBlockSize, roundKeys[0]);
+
+  // L_* = ENCIPHER(K, zeros(128)), L_$ = double(L_*), L_0 = double(L_$),
+  // L_i = double(L_{i-1})
+  store(out.lStar.data(), encipher(roundKeys, rounds, _mm_setzero_si128()));
+  doubleBlock(out.lStar.data(), out.lDollar.data());
+  doubleBlock(out.lDollar.data(), out.l.data());
+  for (size_t i = 1; i < NativeAESOCBKey::kNumL; ++i) {
+    doubleBlock(
+        out.l.data() + (i - 1) * kBlockSize, out.l.data() + i * kBlockSize);
+  }
+}
+} // namespace
+
+bool nativeAESOCBSupported() {
+  static const bool supported = [] {
+    folly::CpuId cpu;
+    return cpu.aes() && cpu.sse41();
+  }();
+  return supported;
+}
+
+void nativeAESOCBSetKey(folly::ByteRange key, NativeAESOCBKey& out) {
+  if (!nativeAESOCBSupported()) {
+    throw std::runtime_error("native aes-ocb not supported");
+  }
+  setKeyImpl(key, out);
+}
+
+void nativeAESOCBCrypt(
+    const NativeAESOCBKey& key,
+    folly::ByteRange nonce,
+    const folly::IOBuf* associatedData,
+    const folly::IOBuf& in,
+    folly::IOBuf& out,
+    bool encrypt,
+    folly::MutableByteRange tag) {
+  if (key.rounds == 0) {
+    throw std::runtime_error("native aes-ocb key not set");
+  }
+  if (nonce.size() != 12) {
+    throw std::runtime_error("Invalid IV");
+  }
+  if (in.computeChainDataLength() / kBlockSize >=
+      (uint64_t(1) << NativeAESOCBKey::kNumL)) {
+    throw std::runtime_error("input too large for aes-ocb");
+  }
+  OCBState state;
+  initState(state, key, encrypt, nonce);
+  processBuffer(state, in, out);
+  finish(state, associatedData, tag);
+}
+#else
+bool nativeAESOCBSupported() {
+  return false;
+}
+
+void nativeAESOCBSetKey(folly::ByteRange, NativeAESOCBKey&) {
+  throw std::runtime_error("native aes-ocb not supported");
+}
+
+void nativeAESOCBCrypt(
+    const NativeAESOCBKey&,
+    folly::ByteRange,
+    const folly::IOBuf*,
+    const folly::IOBuf&,
+    folly::IOBuf&,
+    bool,
+    folly::MutableByteRange) {
+  throw std::runtime_error("native aes-ocb not supported");
+}
+#endif
+} // namespace detail
+} // namespace fizz
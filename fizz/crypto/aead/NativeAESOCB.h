@@ -0,0 +1,179 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/aead/AESOCB128.h>
+#include <fizz/crypto/aead/Aead.h>
+#include <fizz/crypto/aead/IOBufUtil.h>
+#include <folly/Range.h>
+#include <folly/lang/Bits.h>
+
+#include <array>
+
+namespace fizz {
+namespace detail {
+
+/**
+ * Expanded AES key schedules and the precomputed OCB offsets (L_*, L_$ and
+ * L_i) used by the native AES-OCB implementation.
+ */
+struct NativeAESOCBKey {
+  static constexpr size_t kMaxRounds = 14;
+  // Enough for messages of up to 2^kNumL blocks.
+  static constexpr size_t kNumL = 32;
+
+  alignas(16) std::array<uint8_t, (kMaxRounds + 1) * 16> roundKeys;
+  alignas(16) std::array<uint8_t, (kMaxRounds + 1) * 16> decryptRoundKeys;
+  alignas(16) std::array<uint8_t, 16> lStar;
+  alignas(16) std::array<uint8_t, 16> lDollar;
+  alignas(16) std::array<uint8_t, kNumL * 16> l;
+  size_t rounds{0};
+};
+
+/**
+ * Returns true if the native implementation was compiled in and the CPU
+ * supports the instructions it needs (AES-NI and SSE4.1).
+ */
+bool nativeAESOCBSupported();
+
+void nativeAESOCBSetKey(folly::ByteRange key, NativeAESOCBKey& out);
+
+/**
+ * Encrypts or decrypts in into out (which may be the same buffer) and writes
+ * the tag computed over associatedData and the plaintext into tag.
+ */
+void nativeAESOCBCrypt(
+    const NativeAESOCBKey& key,
+    folly::ByteRange nonce,
+    const folly::IOBuf* associatedData,
+    const folly::IOBuf& in,
+    folly::IOBuf& out,
+    bool encrypt,
+    folly::MutableByteRange tag);
+} // namespace detail
+
+/**
+ * AES-OCB (RFC 7253) implemented directly with AES-NI, instead of going
+ * through OpenSSL's EVP interface. Blocks are enciphered 8 at a time, and
+ * contiguous runs of blocks are processed in place on chained IOBufs; only
+ * blocks that straddle buffer boundaries are copied.
+ *
+ * Only usable if isSupported() returns true. AESImpl is AESOCB128.
+ */
+template <typename AESImpl>
+class NativeAESOCB : public Aead {
+ public:
+  static bool isSupported() {
+    return detail::nativeAESOCBSupported();
+  }
+
+  ~NativeAESOCB() override = default;
+
+  size_t keyLength() const override {
+    return AESImpl::kKeyLength;
+  }
+
+  size_t ivLength() const override {
+    return AESImpl::kIVLength;
+  }
+
+  void setKey(TrafficKey trafficKey) override;
+
+  folly::Optional<TrafficKey> getKey() const override {
+    if (!trafficKey_.key || !trafficKey_.iv) {
+      return folly::none;
+    }
+    return trafficKey_.clone();
+  }
+
+  std::unique_ptr<Aead> clone() const override {
+    auto copy = std::make_unique<NativeAESOCB<AESImpl>>();
+    if (trafficKey_.key && trafficKey_.iv) {
+      copy->setKey(trafficKey_.clone());
+    }
+    return std::move(copy);
+  }
+
+  std::unique_ptr<folly::IOBuf> encrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  size_t encryptIovecs(
+      const struct iovec* plaintext,
+      size_t plaintextCount,
+      const struct iovec* ciphertext,
+      size_t ciphertextCount,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  bool supportsEncryptIovecs() const override {
+    return true;
+  }
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    return doDecrypt(std::move(ciphertext), associatedData, seqNum, false);
+  }
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecryptInPlace(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    return doDecrypt(std::move(ciphertext), associatedData, seqNum, true);
+  }
+
+  std::unique_ptr<folly::IOBuf> decryptInPlace(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    auto plaintext =
+        doDecrypt(std::move(ciphertext), associatedData, seqNum, true);
+    if (!plaintext) {
+      throw std::runtime_error("decryption failed");
+    }
+    return std::move(*plaintext);
+  }
+
+  size_t getCipherOverhead() const override {
+    return AESImpl::kTagLength;
+  }
+
+  void setEncryptedBufferHeadroom(size_t headroom) override {
+    headroom_ = headroom;
+  }
+
+  void setBufferPool(std::shared_ptr<BufferPool> pool) override {
+    bufferPool_ = std::move(pool);
+  }
+
+  size_t getMemoryUsage() const override {
+    return sizeof(*this);
+  }
+
+ private:
+  std::array<uint8_t, AESImpl::kIVLength> createIV(uint64_t seqNum) const;
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> doDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum,
+      bool inPlace) const;
+
+  TrafficKey trafficKey_;
+  std::array<uint8_t, AESImpl::kIVLength> iv_{};
+  detail::NativeAESOCBKey key_;
+  size_t headroom_{5};
+  std::shared_ptr<BufferPool> bufferPool_;
+};
+} // namespace fizz
+
+#include <fizz/crypto/aead/NativeAESOCB-inl.h>
@@ -14,7 +14,18 @@ folly::Optional<std::unique_ptr<folly::IOBuf>> evpDecrypt(
     folly::ByteRange iv,
     folly::MutableByteRange tag,
     bool useBlockOps,
-    EVP_CIPHER_CTX* decryptCtx);
+    EVP_CIPHER_CTX* decryptCtx,
+    bool inPlace = false);
+
+folly::Optional<size_t> evpDecryptIovecs(
+    const folly::IOBuf& ciphertext,
+    const folly::IOBuf* associatedData,
+    folly::ByteRange iv,
+    folly::MutableByteRange tag,
+    bool useBlockOps,
+    EVP_CIPHER_CTX* decryptCtx,
+    const struct iovec* plaintext,
+    size_t plaintextCount);
 
 std::unique_ptr<folly::IOBuf> evpEncrypt(
     std::unique_ptr<folly::IOBuf>&& plaintext,
@@ -23,61 +34,107 @@ std::unique_ptr<folly::IOBuf> evpEncrypt(
     size_t tagLen,
     bool useBlockOps,
     size_t headroom,
+    EVP_CIPHER_CTX* encryptCtx,
+    BufferPool* bufferPool = nullptr);
+
+size_t evpEncryptIovecs(
+    const struct iovec* plaintext,
+    size_t plaintextCount,
+    const struct iovec* ciphertext,
+    size_t ciphertextCount,
+    const folly::IOBuf* associatedData,
+    folly::ByteRange iv,
+    folly::MutableByteRange tag,
+    bool useBlockOps,
     EVP_CIPHER_CTX* encryptCtx);
 } // namespace detail
 
 template <typename EVPImpl>
-OpenSSLEVPCipher<EVPImpl>::OpenSSLEVPCipher() {
-  encryptCtx_.reset(EVP_CIPHER_CTX_new());
-  if (encryptCtx_ == nullptr) {
-    throw std::runtime_error("Unable to allocate an EVP_CIPHER_CTX object");
-  }
-  decryptCtx_.reset(EVP_CIPHER_CTX_new());
-  if (decryptCtx_ == nullptr) {
+OpenSSLEVPCipher<EVPImpl>::OpenSSLEVPCipher(ENGINE* engine)
+    : engine_(engine) {
+  encryptCtx_ = makeCtx(true);
+  decryptCtx_ = makeCtx(false);
+}
+
+template <typename EVPImpl>
+typename OpenSSLEVPCipher<EVPImpl>::CipherCtxPtr
+OpenSSLEVPCipher<EVPImpl>::makeCtx(bool encrypt) const {
+  CipherCtxPtr ctx(EVP_CIPHER_CTX_new());
+  if (ctx == nullptr) {
     throw std::runtime_error("Unable to allocate an EVP_CIPHER_CTX object");
   }
-  if (EVP_EncryptInit_ex(
-          encryptCtx_.get(), EVPImpl::Cipher(), nullptr, nullptr, nullptr) !=
-      1) {
+  if (EVP_CipherInit_ex(
+          ctx.get(),
+          EVPImpl::Cipher(),
+          engine_,
+          nullptr,
+          nullptr,
+          encrypt ? 1 : 0) != 1) {
     throw std::runtime_error("Init error");
   }
   if (EVP_CIPHER_CTX_ctrl(
-          encryptCtx_.get(),
-          EVP_CTRL_GCM_SET_IVLEN,
-          EVPImpl::kIVLength,
-          nullptr) != 1) {
-    throw std::runtime_error("Error setting iv length");
-  }
-  if (EVP_DecryptInit_ex(
-          decryptCtx_.get(), EVPImpl::Cipher(), nullptr, nullptr, nullptr) !=
+          ctx.get(), EVP_CTRL_GCM_SET_IVLEN, EVPImpl::kIVLength, nullptr) !=
       1) {
-    throw std::runtime_error("Init error");
-  }
-  if (EVP_CIPHER_CTX_ctrl(
-          decryptCtx_.get(),
-          EVP_CTRL_GCM_SET_IVLEN,
-          EVPImpl::kIVLength,
-          nullptr) != 1) {
     throw std::runtime_error("Error setting iv length");
   }
 
   if (EVPImpl::kRequiresPresetTagLen) {
     if (EVP_CIPHER_CTX_ctrl(
-            encryptCtx_.get(),
+            ctx.get(),
             EVP_CTRL_GCM_SET_TAG,
             EVPImpl::kTagLength,
             nullptr) != 1) {
-      throw std::runtime_error("Error setting enc tag length");
+      throw std::runtime_error(
+          encrypt ? "Error setting enc tag length"
+                  : "Error setting dec tag length");
     }
+  }
 
-    if (EVP_CIPHER_CTX_ctrl(
-            decryptCtx_.get(),
-            EVP_CTRL_GCM_SET_TAG,
-            EVPImpl::kTagLength,
-            nullptr) != 1) {
-      throw std::runtime_error("Error setting dec tag length");
+  if (trafficKey_.key) {
+    if (EVP_CipherInit_ex(
+            ctx.get(),
+            nullptr,
+            nullptr,
+            trafficKey_.key->data(),
+            nullptr,
+            encrypt ? 1 : 0) != 1) {
+      throw std::runtime_error(
+          encrypt ? "Error setting encrypt key" : "Error setting decrypt key");
+    }
+  }
+  return ctx;
+}
+
+template <typename EVPImpl>
+EVP_CIPHER_CTX* OpenSSLEVPCipher<EVPImpl>::getEncryptCtx() const {
+  if (!encryptCtx_) {
+    encryptCtx_ = makeCtx(true);
+  }
+  return encryptCtx_.get();
+}
+
+template <typename EVPImpl>
+EVP_CIPHER_CTX* OpenSSLEVPCipher<EVPImpl>::getDecryptCtx() const {
+  if (!decryptCtx_) {
+    decryptCtx_ = makeCtx(false);
+  }
+  return decryptCtx_.get();
+}
+
+template <typename EVPImpl>
+size_t OpenSSLEVPCipher<EVPImpl>::getMemoryUsage() const {
+  size_t usage = sizeof(*this);
+  for (auto ctx : {encryptCtx_.get(), decryptCtx_.get()}) {
+    if (!ctx) {
+      continue;
     }
+#if FOLLY_OPENSSL_IS_110
+    usage += EVP_CIPHER_impl_ctx_size(EVP_CIPHER_CTX_cipher(ctx));
+#else
+    usage += sizeof(EVP_CIPHER_CTX) + EVP_CIPHER_CTX_cipher(ctx)->ctx_size;
+#endif
   }
+  return usage;
 }
 
 template <typename EVPImpl>
@@ -91,7 +148,15 @@ void OpenSSLEVPCipher<EVPImpl>::setKey(TrafficKey trafficKey) {
     throw std::runtime_error("Invalid IV");
   }
   trafficKey_ = std::move(trafficKey);
-  if (EVP_EncryptInit_ex(
+  memcpy(iv_.data(), trafficKey_.iv->data(), iv_.size());
+  ivSuffix_ = folly::loadUnaligned<uint64_t>(
+      iv_.data() + EVPImpl::kIVLength - sizeof(uint64_t));
+  // Setting the key here expands the key schedule (and for GCM the GHASH
+  // key) once. Each record afterwards only initializes the contexts with its
+  // nonce, which leaves the expanded key in place. Released contexts get the
+  // key when they are recreated.
+  if (encryptCtx_ &&
+      EVP_EncryptInit_ex(
           encryptCtx_.get(),
           nullptr,
           nullptr,
@@ -99,7 +164,8 @@ void OpenSSLEVPCipher<EVPImpl>::setKey(TrafficKey trafficKey) {
           nullptr) != 1) {
     throw std::runtime_error("Error setting encrypt key");
   }
-  if (EVP_DecryptInit_ex(
+  if (decryptCtx_ &&
+      EVP_DecryptInit_ex(
           decryptCtx_.get(),
           nullptr,
           nullptr,
@@ -122,7 +188,64 @@ std::unique_ptr<folly::IOBuf> OpenSSLEVPCipher<EVPImpl>::encrypt(
       EVPImpl::kTagLength,
       EVPImpl::kOperatesInBlocks,
       headroom_,
-      encryptCtx_.get());
+      getEncryptCtx(),
+      bufferPool_.get());
+}
+
+template <typename EVPImpl>
+std::vector<std::unique_ptr<folly::IOBuf>>
+OpenSSLEVPCipher<EVPImpl>::encryptBatch(
+    std::vector<std::unique_ptr<folly::IOBuf>>&& plaintexts,
+    const std::vector<const folly::IOBuf*>& associatedData,
+    uint64_t firstSeqNum) const {
+  if (plaintexts.size() != associatedData.size()) {
+    throw std::runtime_error("associated data count mismatch");
+  }
+  constexpr size_t kNoncesPerRun = 16;
+  std::array<Nonce, kNoncesPerRun> nonces;
+  std::vector<std::unique_ptr<folly::IOBuf>> ciphertexts;
+  ciphertexts.reserve(plaintexts.size());
+  for (size_t i = 0; i < plaintexts.size(); ++i) {
+    auto run = i % kNoncesPerRun;
+    if (run == 0) {
+      createIVs(
+          firstSeqNum + i,
+          std::min(kNoncesPerRun, plaintexts.size() - i),
+          nonces.data());
+    }
+    ciphertexts.push_back(detail::evpEncrypt(
+        std::move(plaintexts[i]),
+        associatedData[i],
+        nonces[run],
+        EVPImpl::kTagLength,
+        EVPImpl::kOperatesInBlocks,
+        headroom_,
+        getEncryptCtx(),
+        bufferPool_.get()));
+  }
+  return ciphertexts;
+}
+
+template <typename EVPImpl>
+size_t OpenSSLEVPCipher<EVPImpl>::encryptIovecs(
+    const struct iovec* plaintext,
+    size_t plaintextCount,
+    const struct iovec* ciphertext,
+    size_t ciphertextCount,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  auto iv = createIV(seqNum);
+  std::array<uint8_t, EVPImpl::kTagLength> tagData;
+  return detail::evpEncryptIovecs(
+      plaintext,
+      plaintextCount,
+      ciphertext,
+      ciphertextCount,
+      associatedData,
+      iv,
+      folly::range(tagData),
+      EVPImpl::kOperatesInBlocks,
+      getEncryptCtx());
 }
 
 template <typename EVPImpl>
@@ -131,6 +254,58 @@ OpenSSLEVPCipher<EVPImpl>::tryDecrypt(
     std::unique_ptr<folly::IOBuf>&& ciphertext,
     const folly::IOBuf* associatedData,
     uint64_t seqNum) const {
+  return doDecrypt(std::move(ciphertext), associatedData, seqNum, false);
+}
+
+template <typename EVPImpl>
+folly::Optional<size_t> OpenSSLEVPCipher<EVPImpl>::tryDecryptIovecs(
+    const folly::IOBuf& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum,
+    const struct iovec* plaintext,
+    size_t plaintextCount) const {
+  auto iv = createIV(seqNum);
+  std::array<uint8_t, EVPImpl::kTagLength> tagData;
+  return detail::evpDecryptIovecs(
+      ciphertext,
+      associatedData,
+      iv,
+      folly::range(tagData),
+      EVPImpl::kOperatesInBlocks,
+      getDecryptCtx(),
+      plaintext,
+      plaintextCount);
+}
+
+template <typename EVPImpl>
+std::unique_ptr<folly::IOBuf> OpenSSLEVPCipher<EVPImpl>::decryptInPlace(
+    std::unique_ptr<folly::IOBuf>&& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  auto plaintext =
+      doDecrypt(std::move(ciphertext), associatedData, seqNum, true);
+  if (!plaintext) {
+    throw std::runtime_error("decryption failed");
+  }
+  return std::move(*plaintext);
+}
+
+template <typename EVPImpl>
+folly::Optional<std::unique_ptr<folly::IOBuf>>
+OpenSSLEVPCipher<EVPImpl>::tryDecryptInPlace(
+    std::unique_ptr<folly::IOBuf>&& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  return doDecrypt(std::move(ciphertext), associatedData, seqNum, true);
+}
+
+template <typename EVPImpl>
+folly::Optional<std::unique_ptr<folly::IOBuf>>
+OpenSSLEVPCipher<EVPImpl>::doDecrypt(
+    std::unique_ptr<folly::IOBuf>&& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum,
+    bool inPlace) const {
   auto iv = createIV(seqNum);
   // buffer to copy the tag into when we decrypt
   std::array<uint8_t, EVPImpl::kTagLength> tagData;
@@ -141,7 +316,8 @@ OpenSSLEVPCipher<EVPImpl>::tryDecrypt(
       iv,
       tagOut,
       EVPImpl::kOperatesInBlocks,
-      decryptCtx_.get());
+      getDecryptCtx(),
+      inPlace);
 }
 
 template <typename EVPImpl>
@@ -150,14 +326,26 @@ size_t OpenSSLEVPCipher<EVPImpl>::getCipherOverhead() const {
 }
 
 template <typename EVPImpl>
-std::array<uint8_t, EVPImpl::kIVLength> OpenSSLEVPCipher<EVPImpl>::createIV(
+typename OpenSSLEVPCipher<EVPImpl>::Nonce OpenSSLEVPCipher<EVPImpl>::createIV(
     uint64_t seqNum) const {
-  std::array<uint8_t, EVPImpl::kIVLength> iv;
-  uint64_t bigEndianSeqNum = folly::Endian::big(seqNum);
-  const size_t prefixLength = EVPImpl::kIVLength - sizeof(uint64_t);
-  memset(iv.data(), 0, prefixLength);
-  memcpy(iv.data() + prefixLength, &bigEndianSeqNum, 8);
-  XOR(trafficKey_.iv->coalesce(), folly::range(iv));
+  Nonce iv;
+  createIVs(seqNum, 1, &iv);
   return iv;
 }
+
+template <typename EVPImpl>
+void OpenSSLEVPCipher<EVPImpl>::createIVs(
+    uint64_t firstSeqNum,
+    size_t count,
+    Nonce* nonces) const {
+  // The nonce is the iv with the big endian sequence number xored into its
+  // last 8 bytes.
+  const size_t prefixLength = EVPImpl::kIVLength - sizeof(uint64_t);
+  for (size_t i = 0; i < count; ++i) {
+    memcpy(nonces[i].data(), iv_.data(), prefixLength);
+    folly::storeUnaligned<uint64_t>(
+        nonces[i].data() + prefixLength,
+        ivSuffix_ ^ folly::Endian::big(firstSeqNum + i));
+  }
+}
 } // namespace fizz
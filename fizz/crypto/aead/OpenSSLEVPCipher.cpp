@@ -183,30 +183,10 @@ bool decFunc(
              decryptCtx, output.writableData() + numWritten, &outLen) == 1;
 }
 
-std::unique_ptr<folly::IOBuf> evpEncrypt(
-    std::unique_ptr<folly::IOBuf>&& plaintext,
-    const folly::IOBuf* associatedData,
+static void encryptInit(
+    EVP_CIPHER_CTX* encryptCtx,
     folly::ByteRange iv,
-    size_t tagLen,
-    bool useBlockOps,
-    size_t headroom,
-    EVP_CIPHER_CTX* encryptCtx) {
-  auto inputLength = plaintext->computeChainDataLength();
-  // Setup input and output buffers.
-  std::unique_ptr<folly::IOBuf> output;
-  folly::IOBuf* input;
-
-  if (plaintext->isShared()) {
-    // create enough to also fit the tag and headroom
-    output = folly::IOBuf::create(headroom + inputLength + tagLen);
-    output->advance(headroom);
-    output->append(inputLength);
-    input = plaintext.get();
-  } else {
-    output = std::move(plaintext);
-    input = output.get();
-  }
-
+    const folly::IOBuf* associatedData) {
   if (EVP_EncryptInit_ex(encryptCtx, nullptr, nullptr, nullptr, iv.data()) !=
       1) {
     throw std::runtime_error("Encryption error");
@@ -228,6 +208,61 @@ std::unique_ptr<folly::IOBuf> evpEncrypt(
       }
     }
   }
+}
+
+static void decryptInit(
+    EVP_CIPHER_CTX* decryptCtx,
+    folly::ByteRange iv,
+    const folly::IOBuf* associatedData) {
+  if (EVP_DecryptInit_ex(decryptCtx, nullptr, nullptr, nullptr, iv.data()) !=
+      1) {
+    throw std::runtime_error("Decryption error");
+  }
+
+  if (associatedData) {
+    for (auto current : *associatedData) {
+      if (current.size() > std::numeric_limits<int>::max()) {
+        throw std::runtime_error("too much associated data");
+      }
+      int len;
+      if (EVP_DecryptUpdate(
+              decryptCtx,
+              nullptr,
+              &len,
+              current.data(),
+              static_cast<int>(current.size())) != 1) {
+        throw std::runtime_error("Decryption error");
+      }
+    }
+  }
+}
+
+std::unique_ptr<folly::IOBuf> evpEncrypt(
+    std::unique_ptr<folly::IOBuf>&& plaintext,
+    const folly::IOBuf* associatedData,
+    folly::ByteRange iv,
+    size_t tagLen,
+    bool useBlockOps,
+    size_t headroom,
+    EVP_CIPHER_CTX* encryptCtx,
+    BufferPool* bufferPool) {
+  auto inputLength = plaintext->computeChainDataLength();
+  // Setup input and output buffers.
+  std::unique_ptr<folly::IOBuf> output;
+  folly::IOBuf* input;
+
+  if (plaintext->isShared()) {
+    // create enough to also fit the tag and headroom
+    output = allocateBuffer(bufferPool, headroom + inputLength + tagLen);
+    output->advance(headroom);
+    output->append(inputLength);
+    input = plaintext.get();
+  } else {
+    output = std::move(plaintext);
+    input = output.get();
+  }
+
+  encryptInit(encryptCtx, iv, associatedData);
 
   if (useBlockOps) {
     encFuncBlocks(encryptCtx, *input, *output);
@@ -238,7 +273,7 @@ std::unique_ptr<folly::IOBuf> evpEncrypt(
   // output is always something we can modify
   auto tailRoom = output->prev()->tailroom();
   if (tailRoom < tagLen) {
-    std::unique_ptr<folly::IOBuf> tag = folly::IOBuf::create(tagLen);
+    std::unique_ptr<folly::IOBuf> tag = allocateBuffer(bufferPool, tagLen);
     tag->append(tagLen);
     if (EVP_CIPHER_CTX_ctrl(
             encryptCtx, EVP_CTRL_GCM_GET_TAG, tagLen, tag->writableData()) !=
@@ -261,13 +296,51 @@ std::unique_ptr<folly::IOBuf> evpEncrypt(
   return output;
 }
 
+size_t evpEncryptIovecs(
+    const struct iovec* plaintext,
+    size_t plaintextCount,
+    const struct iovec* ciphertext,
+    size_t ciphertextCount,
+    const folly::IOBuf* associatedData,
+    folly::ByteRange iv,
+    folly::MutableByteRange tag,
+    bool useBlockOps,
+    EVP_CIPHER_CTX* encryptCtx) {
+  // The wrapped buffers don't own the memory, so nothing here allocates or
+  // copies the (potentially shared) plaintext.
+  auto input = folly::IOBuf::wrapIov(plaintext, plaintextCount);
+  auto output = folly::IOBuf::wrapIov(ciphertext, ciphertextCount);
+  auto inputLength = input->computeChainDataLength();
+  if (output->computeChainDataLength() < inputLength + tag.size()) {
+    throw std::runtime_error("ciphertext iovecs too small");
+  }
+
+  encryptInit(encryptCtx, iv, associatedData);
+
+  if (useBlockOps) {
+    encFuncBlocks(encryptCtx, *input, *output);
+  } else {
+    encFunc(encryptCtx, *input, *output);
+  }
+
+  if (EVP_CIPHER_CTX_ctrl(
+          encryptCtx, EVP_CTRL_GCM_GET_TAG, tag.size(), tag.begin()) != 1) {
+    throw std::runtime_error("Encryption error");
+  }
+  folly::io::RWPrivateCursor cursor(output.get());
+  cursor.skip(inputLength);
+  cursor.push(tag.begin(), tag.size());
+  return inputLength + tag.size();
+}
+
 folly::Optional<std::unique_ptr<folly::IOBuf>> evpDecrypt(
     std::unique_ptr<folly::IOBuf>&& ciphertext,
     const folly::IOBuf* associatedData,
     folly::ByteRange iv,
     folly::MutableByteRange tagOut,
     bool useBlockOps,
-    EVP_CIPHER_CTX* decryptCtx) {
+    EVP_CIPHER_CTX* decryptCtx,
+    bool inPlace) {
   auto tagLen = tagOut.size();
   auto inputLength = ciphertext->computeChainDataLength();
   if (inputLength < tagLen) {
@@ -278,46 +351,64 @@ folly::Optional<std::unique_ptr<folly::IOBuf>> evpDecrypt(
   folly::IOBuf* input;
   std::unique_ptr<folly::IOBuf> output;
   trimBytes(*ciphertext, tagOut);
-  if (ciphertext->isShared()) {
+  if (ciphertext->isShared() && !inPlace) {
     // If in is shared, then we have to make a copy of it.
     output = folly::IOBuf::create(inputLength);
     output->append(inputLength);
     input = ciphertext.get();
   } else {
-    // If in is not shared we can do decryption in-place.
+    // If in is not shared (or the caller owns the bytes) we can do decryption
+    // in-place.
     output = std::move(ciphertext);
     input = output.get();
   }
 
-  if (EVP_DecryptInit_ex(decryptCtx, nullptr, nullptr, nullptr, iv.data()) !=
-      1) {
-    throw std::runtime_error("Decryption error");
+  decryptInit(decryptCtx, iv, associatedData);
+
+  auto decrypted = useBlockOps
+      ? decFuncBlocks(decryptCtx, *input, *output, tagOut)
+      : decFunc(decryptCtx, *input, *output, tagOut);
+  if (!decrypted) {
+    return folly::none;
   }
+  return std::move(output);
+}
 
-  if (associatedData) {
-    for (auto current : *associatedData) {
-      if (current.size() > std::numeric_limits<int>::max()) {
-        throw std::runtime_error("too much associated data");
-      }
-      int len;
-      if (EVP_DecryptUpdate(
-              decryptCtx,
-              nullptr,
-              &len,
-              current.data(),
-              static_cast<int>(current.size())) != 1) {
-        throw std::runtime_error("Decryption error");
-      }
-    }
+folly::Optional<size_t> evpDecryptIovecs(
+    const folly::IOBuf& ciphertext,
+    const folly::IOBuf* associatedData,
+    folly::ByteRange iv,
+    folly::MutableByteRange tagOut,
+    bool useBlockOps,
+    EVP_CIPHER_CTX* decryptCtx,
+    const struct iovec* plaintext,
+    size_t plaintextCount) {
+  auto tagLen = tagOut.size();
+  auto inputLength = ciphertext.computeChainDataLength();
+  if (inputLength < tagLen) {
+    return folly::none;
+  }
+  inputLength -= tagLen;
+
+  // The clone only shares the ciphertext so that the tag can be trimmed off
+  // without modifying the caller's buffer.
+  auto input = ciphertext.clone();
+  trimBytes(*input, tagOut);
+
+  auto output = folly::IOBuf::wrapIov(plaintext, plaintextCount);
+  if (output->computeChainDataLength() < inputLength) {
+    throw std::runtime_error("plaintext iovecs too small");
   }
 
+  decryptInit(decryptCtx, iv, associatedData);
+
   auto decrypted = useBlockOps
       ? decFuncBlocks(decryptCtx, *input, *output, tagOut)
       : decFunc(decryptCtx, *input, *output, tagOut);
   if (!decrypted) {
     return folly::none;
   }
-  return std::move(output);
+  return inputLength;
 }
 } // namespace detail
 } // namespace fizz
@@ -16,6 +16,7 @@
 #include <folly/Range.h>
 #include <folly/String.h>
 #include <folly/lang/Bits.h>
+#include <folly/portability/OpenSSL.h>
 #include <glog/logging.h>
 #include <openssl/evp.h>
 
@@ -33,13 +34,16 @@ namespace fizz {
  *         with the input
  *   - kRequiresPresetTagLen: if the cipher requires setting the tag length
  *         explicitly
+ *
+ * If an engine is passed in, the cipher contexts are initialized with it so
+ * that encryption and decryption are done by the engine's implementation.
  */
 template <typename EVPImpl>
 class OpenSSLEVPCipher : public Aead {
   static_assert(EVPImpl::kIVLength >= sizeof(uint64_t), "iv too small");
 
  public:
-  OpenSSLEVPCipher();
+  explicit OpenSSLEVPCipher(ENGINE* engine = nullptr);
   ~OpenSSLEVPCipher() override = default;
 
   OpenSSLEVPCipher(OpenSSLEVPCipher&& other) = default;
@@ -47,6 +51,21 @@ class OpenSSLEVPCipher : public Aead {
 
   void setKey(TrafficKey trafficKey) override;
 
+  folly::Optional<TrafficKey> getKey() const override {
+    if (!trafficKey_.key || !trafficKey_.iv) {
+      return folly::none;
+    }
+    return trafficKey_.clone();
+  }
+
+  std::unique_ptr<Aead> clone() const override {
+    auto copy = std::make_unique<OpenSSLEVPCipher<EVPImpl>>(engine_);
+    if (trafficKey_.key && trafficKey_.iv) {
+      copy->setKey(trafficKey_.clone());
+    }
+    return std::move(copy);
+  }
+
   size_t keyLength() const override {
     return EVPImpl::kKeyLength;
   }
@@ -64,28 +83,115 @@ class OpenSSLEVPCipher : public Aead {
       const folly::IOBuf* associatedData,
       uint64_t seqNum) const override;
 
+  // Builds the nonces for the whole batch up front.
+  std::vector<std::unique_ptr<folly::IOBuf>> encryptBatch(
+      std::vector<std::unique_ptr<folly::IOBuf>>&& plaintexts,
+      const std::vector<const folly::IOBuf*>& associatedData,
+      uint64_t firstSeqNum) const override;
+
+  // Encrypts straight from the plaintext iovecs into the ciphertext iovecs,
+  // without copying or allocating.
+  size_t encryptIovecs(
+      const struct iovec* plaintext,
+      size_t plaintextCount,
+      const struct iovec* ciphertext,
+      size_t ciphertextCount,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  bool supportsEncryptIovecs() const override {
+    return true;
+  }
+
   folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
       std::unique_ptr<folly::IOBuf>&& ciphertext,
       const folly::IOBuf* associatedData,
       uint64_t seqNum) const override;
 
+  // Decrypts straight into the plaintext iovecs, leaving the ciphertext
+  // untouched.
+  folly::Optional<size_t> tryDecryptIovecs(
+      const folly::IOBuf& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum,
+      const struct iovec* plaintext,
+      size_t plaintextCount) const override;
+
+  bool supportsDecryptIovecs() const override {
+    return true;
+  }
+
+  // Same as tryDecrypt, but decrypts in place even if ciphertext is shared.
+  std::unique_ptr<folly::IOBuf> decryptInPlace(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecryptInPlace(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
   size_t getCipherOverhead() const override;
 
   void setEncryptedBufferHeadroom(size_t headroom) override {
     headroom_ = headroom;
   }
 
+  void setBufferPool(std::shared_ptr<BufferPool> pool) override {
+    bufferPool_ = std::move(pool);
+  }
+
+  // Frees the cipher contexts. They are recreated, and the key set on them
+  // again, on the next encryption or decryption.
+  void releaseIdleResources() override {
+    encryptCtx_.reset();
+    decryptCtx_.reset();
+  }
+
+  // The cipher contexts themselves are opaque, only the cipher specific state
+  // they allocate is counted.
+  size_t getMemoryUsage() const override;
+
  private:
-  std::array<uint8_t, EVPImpl::kIVLength> createIV(uint64_t seqNum) const;
+  using Nonce = std::array<uint8_t, EVPImpl::kIVLength>;
+
+  Nonce createIV(uint64_t seqNum) const;
+
+  // Writes the nonces for count consecutive sequence numbers starting at
+  // firstSeqNum into nonces.
+  void createIVs(uint64_t firstSeqNum, size_t count, Nonce* nonces) const;
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> doDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum,
+      bool inPlace) const;
 
   using CipherCtxDeleter =
       folly::static_function_deleter<EVP_CIPHER_CTX, &EVP_CIPHER_CTX_free>;
+  using CipherCtxPtr = std::unique_ptr<EVP_CIPHER_CTX, CipherCtxDeleter>;
+
+  // Creates a context for encryption or decryption, with the key set if we
+  // have one.
+  CipherCtxPtr makeCtx(bool encrypt) const;
+
+  EVP_CIPHER_CTX* getEncryptCtx() const;
+  EVP_CIPHER_CTX* getDecryptCtx() const;
 
   TrafficKey trafficKey_;
+  // Copy of trafficKey_.iv, so that building the per-record nonce doesn't
+  // need to go through the IOBuf. The last 8 bytes, which the sequence number
+  // is xored into, are also kept as a word in ivSuffix_.
+  Nonce iv_{};
+  uint64_t ivSuffix_{0};
   size_t headroom_{5};
+  std::shared_ptr<BufferPool> bufferPool_;
 
-  std::unique_ptr<EVP_CIPHER_CTX, CipherCtxDeleter> encryptCtx_;
-  std::unique_ptr<EVP_CIPHER_CTX, CipherCtxDeleter> decryptCtx_;
+  ENGINE* engine_;
+  // Released by releaseIdleResources() and lazily recreated.
+  mutable CipherCtxPtr encryptCtx_;
+  mutable CipherCtxPtr decryptCtx_;
 };
 } // namespace fizz
 #include <fizz/crypto/aead/OpenSSLEVPCipher-inl.h>
@@ -0,0 +1,297 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/aead/SodiumChaCha20Poly1305.h>
+
+#include <fizz/crypto/aead/IOBufUtil.h>
+#include <folly/lang/Bits.h>
+
+#include <sodium.h>
+
+namespace fizz {
+
+namespace {
+
+constexpr size_t kChaChaBlockSize = 64;
+constexpr size_t kPolyBlockSize = 16;
+
+struct ChaChaPolyState {
+  const uint8_t* key;
+  const uint8_t* nonce;
+  // Block counter of the next keystream block. Block 0 is used for the
+  // Poly1305 key, so data starts at block 1.
+  uint32_t counter{1};
+  // Keystream left over from a block that was only partially used by the
+  // end of the previous input range.
+  std::array<uint8_t, kChaChaBlockSize> keystream;
+  size_t keystreamOffset{kChaChaBlockSize};
+  crypto_onetimeauth_poly1305_state poly;
+  bool encrypt;
+};
+
+void xorKeystream(
+    ChaChaPolyState& state,
+    uint8_t* out,
+    const uint8_t* in,
+    size_t len) {
+  if (state.keystreamOffset < kChaChaBlockSize) {
+    auto n = std::min(len, kChaChaBlockSize - state.keystreamOffset);
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = in[i] ^ state.keystream[state.keystreamOffset + i];
+    }
+    state.keystreamOffset += n;
+    in += n;
+    out += n;
+    len -= n;
+  }
+
+  // Whole blocks go through libsodium directly, which processes several
+  // blocks at a time with the widest instructions available.
+  auto blockBytes = len - (len % kChaChaBlockSize);
+  if (blockBytes > 0) {
+    crypto_stream_chacha20_ietf_xor_ic(
+        out, in, blockBytes, state.nonce, state.counter, state.key);
+    state.counter += blockBytes / kChaChaBlockSize;
+    in += blockBytes;
+    out += blockBytes;
+    len -= blockBytes;
+  }
+
+  if (len > 0) {
+    state.keystream.fill(0);
+    crypto_stream_chacha20_ietf_xor_ic(
+        state.keystream.data(),
+        state.keystream.data(),
+        kChaChaBlockSize,
+        state.nonce,
+        state.counter,
+        state.key);
+    state.counter++;
+    for (size_t i = 0; i < len; ++i) {
+      out[i] = in[i] ^ state.keystream[i];
+    }
+    state.keystreamOffset = len;
+  }
+}
+
+void processBytes(
+    ChaChaPolyState& state,
+    uint8_t* out,
+    const uint8_t* in,
+    size_t len) {
+  // Poly1305 authenticates the ciphertext. When decrypting in place it has to
+  // see the bytes before they are overwritten.
+  if (!state.encrypt) {
+    crypto_onetimeauth_poly1305_update(&state.poly, in, len);
+  }
+  xorKeystream(state, out, in, len);
+  if (state.encrypt) {
+    crypto_onetimeauth_poly1305_update(&state.poly, out, len);
+  }
+}
+
+void padPoly(ChaChaPolyState& state, size_t length) {
+  static const std::array<uint8_t, kPolyBlockSize> zeros{};
+  auto remainder = length % kPolyBlockSize;
+  if (remainder != 0) {
+    crypto_onetimeauth_poly1305_update(
+        &state.poly, zeros.data(), kPolyBlockSize - remainder);
+  }
+}
+} // namespace
+
+SodiumChaCha20Poly1305::SodiumChaCha20Poly1305() {
+  // Selects the fastest stream cipher and poly1305 implementations for this
+  // cpu. Safe to call multiple times.
+  if (sodium_init() == -1) {
+    throw std::runtime_error("Could not initialize sodium");
+  }
+}
+
+SodiumChaCha20Poly1305::~SodiumChaCha20Poly1305() {
+  sodium_memzero(key_.data(), key_.size());
+}
+
+void SodiumChaCha20Poly1305::setKey(TrafficKey trafficKey) {
+  trafficKey.key->coalesce();
+  trafficKey.iv->coalesce();
+  if (trafficKey.key->length() != ChaCha20Poly1305::kKeyLength) {
+    throw std::runtime_error("Invalid key");
+  }
+  if (trafficKey.iv->length() != ChaCha20Poly1305::kIVLength) {
+    throw std::runtime_error("Invalid IV");
+  }
+  trafficKey_ = std::move(trafficKey);
+  memcpy(key_.data(), trafficKey_.key->data(), key_.size());
+  memcpy(iv_.data(), trafficKey_.iv->data(), iv_.size());
+}
+
+std::unique_ptr<folly::IOBuf> SodiumChaCha20Poly1305::encrypt(
+    std::unique_ptr<folly::IOBuf>&& plaintext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  auto nonce = createNonce(seqNum);
+  auto inputLength = plaintext->computeChainDataLength();
+  constexpr auto tagLen = ChaCha20Poly1305::kTagLength;
+
+  std::unique_ptr<folly::IOBuf> output;
+  folly::IOBuf* input;
+  if (plaintext->isShared()) {
+    output =
+        allocateBuffer(bufferPool_.get(), headroom_ + inputLength + tagLen);
+    output->advance(headroom_);
+    output->append(inputLength);
+    input = plaintext.get();
+  } else {
+    output = std::move(plaintext);
+    input = output.get();
+  }
+
+  Tag tag;
+  crypt(nonce, associatedData, *input, *output, true, tag);
+
+  auto lastBuf = output->prev();
+  if (lastBuf->tailroom() < tagLen) {
+    auto tagBuf = allocateBuffer(bufferPool_.get(), tagLen);
+    memcpy(tagBuf->writableData(), tag.data(), tagLen);
+    tagBuf->append(tagLen);
+    output->prependChain(std::move(tagBuf));
+  } else {
+    memcpy(lastBuf->writableTail(), tag.data(), tagLen);
+    lastBuf->append(tagLen);
+  }
+  return output;
+}
+
+size_t SodiumChaCha20Poly1305::encryptIovecs(
+    const struct iovec* plaintext,
+    size_t plaintextCount,
+    const struct iovec* ciphertext,
+    size_t ciphertextCount,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  constexpr auto tagLen = ChaCha20Poly1305::kTagLength;
+  auto input = folly::IOBuf::wrapIov(plaintext, plaintextCount);
+  auto output = folly::IOBuf::wrapIov(ciphertext, ciphertextCount);
+  auto inputLength = input->computeChainDataLength();
+  if (output->computeChainDataLength() < inputLength + tagLen) {
+    throw std::runtime_error("ciphertext iovecs too small");
+  }
+
+  Tag tag;
+  crypt(createNonce(seqNum), associatedData, *input, *output, true, tag);
+
+  folly::io::RWPrivateCursor cursor(output.get());
+  cursor.skip(inputLength);
+  cursor.push(tag.data(), tagLen);
+  return inputLength + tagLen;
+}
+
+std::unique_ptr<folly::IOBuf> SodiumChaCha20Poly1305::decryptInPlace(
+    std::unique_ptr<folly::IOBuf>&& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum) const {
+  auto plaintext =
+      doDecrypt(std::move(ciphertext), associatedData, seqNum, true);
+  if (!plaintext) {
+    throw std::runtime_error("decryption failed");
+  }
+  return std::move(*plaintext);
+}
+
+folly::Optional<std::unique_ptr<folly::IOBuf>>
+SodiumChaCha20Poly1305::doDecrypt(
+    std::unique_ptr<folly::IOBuf>&& ciphertext,
+    const folly::IOBuf* associatedData,
+    uint64_t seqNum,
+    bool inPlace) const {
+  constexpr auto tagLen = ChaCha20Poly1305::kTagLength;
+  auto inputLength = ciphertext->computeChainDataLength();
+  if (inputLength < tagLen) {
+    return folly::none;
+  }
+  inputLength -= tagLen;
+
+  Tag expectedTag;
+  trimBytes(*ciphertext, folly::range(expectedTag));
+
+  std::unique_ptr<folly::IOBuf> output;
+  folly::IOBuf* input;
+  if (ciphertext->isShared() && !inPlace) {
+    output = folly::IOBuf::create(inputLength);
+    output->append(inputLength);
+    input = ciphertext.get();
+  } else {
+    output = std::move(ciphertext);
+    input = output.get();
+  }
+
+  Tag tag;
+  crypt(createNonce(seqNum), associatedData, *input, *output, false, tag);
+  if (sodium_memcmp(tag.data(), expectedTag.data(), tagLen) != 0) {
+    return folly::none;
+  }
+  return std::move(output);
+}
+
+void SodiumChaCha20Poly1305::crypt(
+    const Nonce& nonce,
+    const folly::IOBuf* associatedData,
+    const folly::IOBuf& in,
+    folly::IOBuf& out,
+    bool encrypt,
+    Tag& tag) const {
+  ChaChaPolyState state;
+  state.key = key_.data();
+  state.nonce = nonce.data();
+  state.encrypt = encrypt;
+
+  std::array<uint8_t, 32> polyKey;
+  crypto_stream_chacha20_ietf(
+      polyKey.data(), polyKey.size(), nonce.data(), key_.data());
+  crypto_onetimeauth_poly1305_init(&state.poly, polyKey.data());
+  sodium_memzero(polyKey.data(), polyKey.size());
+
+  uint64_t aadLength = 0;
+  if (associatedData) {
+    for (auto current : *associatedData) {
+      crypto_onetimeauth_poly1305_update(
+          &state.poly, current.data(), current.size());
+      aadLength += current.size();
+    }
+  }
+  padPoly(state, aadLength);
+
+  transformBuffer(
+      in, out, [&state](uint8_t* output, const uint8_t* input, size_t len) {
+        processBytes(state, output, input, len);
+      });
+  uint64_t dataLength = in.computeChainDataLength();
+  padPoly(state, dataLength);
+
+  std::array<uint8_t, 2 * sizeof(uint64_t)> lengths;
+  folly::storeUnaligned<uint64_t>(
+      lengths.data(), folly::Endian::little(aadLength));
+  folly::storeUnaligned<uint64_t>(
+      lengths.data() + sizeof(uint64_t), folly::Endian::little(dataLength));
+  crypto_onetimeauth_poly1305_update(
+      &state.poly, lengths.data(), lengths.size());
+  crypto_onetimeauth_poly1305_final(&state.poly, tag.data());
+  sodium_memzero(state.keystream.data(), state.keystream.size());
+}
+
+SodiumChaCha20Poly1305::Nonce SodiumChaCha20Poly1305::createNonce(
+    uint64_t seqNum) const {
+  Nonce nonce = iv_;
+  const size_t prefixLength = nonce.size() - sizeof(uint64_t);
+  auto suffix = folly::loadUnaligned<uint64_t>(nonce.data() + prefixLength);
+  folly::storeUnaligned<uint64_t>(
+      nonce.data() + prefixLength, suffix ^ folly::Endian::big(seqNum));
+  return nonce;
+}
+} // namespace fizz
@@ -0,0 +1,132 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/aead/Aead.h>
+#include <fizz/crypto/aead/ChaCha20Poly1305.h>
+
+#include <array>
+
+namespace fizz {
+
+/**
+ * ChaCha20-Poly1305 (RFC 7539) implemented on libsodium's ChaCha20 stream
+ * cipher and incremental Poly1305, which pick vectorized (SSSE3/AVX2)
+ * implementations at runtime. Unlike libsodium's one-shot AEAD functions this
+ * works directly on chained IOBufs, so no coalescing is needed.
+ */
+class SodiumChaCha20Poly1305 : public Aead {
+ public:
+  SodiumChaCha20Poly1305();
+  ~SodiumChaCha20Poly1305() override;
+
+  size_t keyLength() const override {
+    return ChaCha20Poly1305::kKeyLength;
+  }
+
+  size_t ivLength() const override {
+    return ChaCha20Poly1305::kIVLength;
+  }
+
+  void setKey(TrafficKey trafficKey) override;
+
+  folly::Optional<TrafficKey> getKey() const override {
+    if (!trafficKey_.key || !trafficKey_.iv) {
+      return folly::none;
+    }
+    return trafficKey_.clone();
+  }
+
+  std::unique_ptr<Aead> clone() const override {
+    auto copy = std::make_unique<SodiumChaCha20Poly1305>();
+    if (trafficKey_.key && trafficKey_.iv) {
+      copy->setKey(trafficKey_.clone());
+    }
+    return std::move(copy);
+  }
+
+  std::unique_ptr<folly::IOBuf> encrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  size_t encryptIovecs(
+      const struct iovec* plaintext,
+      size_t plaintextCount,
+      const struct iovec* ciphertext,
+      size_t ciphertextCount,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  bool supportsEncryptIovecs() const override {
+    return true;
+  }
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    return doDecrypt(std::move(ciphertext), associatedData, seqNum, false);
+  }
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecryptInPlace(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    return doDecrypt(std::move(ciphertext), associatedData, seqNum, true);
+  }
+
+  std::unique_ptr<folly::IOBuf> decryptInPlace(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override;
+
+  size_t getCipherOverhead() const override {
+    return ChaCha20Poly1305::kTagLength;
+  }
+
+  void setEncryptedBufferHeadroom(size_t headroom) override {
+    headroom_ = headroom;
+  }
+
+  void setBufferPool(std::shared_ptr<BufferPool> pool) override {
+    bufferPool_ = std::move(pool);
+  }
+
+  size_t getMemoryUsage() const override {
+    return sizeof(*this);
+  }
+
+ private:
+  using Nonce = std::array<uint8_t, ChaCha20Poly1305::kIVLength>;
+  using Tag = std::array<uint8_t, ChaCha20Poly1305::kTagLength>;
+
+  Nonce createNonce(uint64_t seqNum) const;
+
+  void crypt(
+      const Nonce& nonce,
+      const folly::IOBuf* associatedData,
+      const folly::IOBuf& in,
+      folly::IOBuf& out,
+      bool encrypt,
+      Tag& tag) const;
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> doDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum,
+      bool inPlace) const;
+
+  TrafficKey trafficKey_;
+  std::array<uint8_t, ChaCha20Poly1305::kKeyLength> key_{};
+  Nonce iv_{};
+  size_t headroom_{5};
+  std::shared_ptr<BufferPool> bufferPool_;
+};
+} // namespace fizz
@@ -0,0 +1,212 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/Random.h>
+#include <folly/String.h>
+#include <folly/init/Init.h>
+#include <folly/ssl/Init.h>
+
+#include <fizz/crypto/aead/AESGCM128.h>
+#include <fizz/crypto/aead/AESGCM256.h>
+#include <fizz/crypto/aead/AESOCB128.h>
+#include <fizz/crypto/aead/ChaCha20Poly1305.h>
+#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
+
+using namespace fizz;
+
+namespace {
+
+// Room the record layer leaves for the record header and the tag.
+constexpr size_t kHeadroom = 5;
+constexpr size_t kTailroom = 17;
+// Number of buffers a chained input is split into.
+constexpr size_t kChainLength = 4;
+
+enum class Shape {
+  // One buffer owned by the aead.
+  Contiguous,
+  // kChainLength buffers owned by the aead.
+  Chained,
+  // One buffer that is also referenced by the caller, so it can't be
+  // transformed in place.
+  Shared,
+};
+
+std::unique_ptr<folly::IOBuf> toIOBuf(std::string hexData) {
+  std::string out;
+  CHECK(folly::unhexlify(hexData, out));
+  return folly::IOBuf::copyBuffer(out);
+}
+
+template <typename EVPImpl>
+std::unique_ptr<Aead> makeAead() {
+  auto aead = std::make_unique<OpenSSLEVPCipher<EVPImpl>>();
+  TrafficKey trafficKey;
+  trafficKey.key = folly::IOBuf::create(EVPImpl::kKeyLength);
+  trafficKey.key->append(EVPImpl::kKeyLength);
+  memset(trafficKey.key->writableData(), 0x11, EVPImpl::kKeyLength);
+  trafficKey.iv = toIOBuf("000102030405060708090A0B");
+  aead->setKey(std::move(trafficKey));
+  return aead;
+}
+
+std::unique_ptr<folly::IOBuf> makeRandom(size_t n) {
+  std::string data;
+  data.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    data.push_back(folly::Random::rand32() & 0xff);
+  }
+  return folly::IOBuf::copyBuffer(data);
+}
+
+/**
+ * Returns a copy of buf in the given shape. For Shared inputs, the extra
+ * reference is added to keepAlive.
+ */
+std::unique_ptr<folly::IOBuf> shapeInput(
+    const folly::IOBuf& buf,
+    Shape shape,
+    bool room,
+    std::vector<std::unique_ptr<folly::IOBuf>>& keepAlive) {
+  auto data = buf.cloneCoalescedAsValue();
+  auto length = data.length();
+  switch (shape) {
+    case Shape::Contiguous:
+      return room
+          ? folly::IOBuf::copyBuffer(data.data(), length, kHeadroom, kTailroom)
+          : folly::IOBuf::copyBuffer(data.data(), length);
+    case Shape::Chained: {
+      std::unique_ptr<folly::IOBuf> chain;
+      size_t offset = 0;
+      for (size_t i = 0; i < kChainLength; ++i) {
+        auto chunk =
+            i == kChainLength - 1 ? length - offset : length / kChainLength;
+        auto next = room
+            ? folly::IOBuf::copyBuffer(
+                  data.data() + offset, chunk, kHeadroom, kTailroom)
+            : folly::IOBuf::copyBuffer(data.data() + offset, chunk);
+        offset += chunk;
+        if (chain) {
+          chain->prependChain(std::move(next));
+        } else {
+          chain = std::move(next);
+        }
+      }
+      return chain;
+    }
+    case Shape::Shared: {
+      auto owned = room
+          ? folly::IOBuf::copyBuffer(data.data(), length, kHeadroom, kTailroom)
+          : folly::IOBuf::copyBuffer(data.data(), length);
+      auto shared = owned->clone();
+      keepAlive.push_back(std::move(owned));
+      return shared;
+    }
+  }
+  return nullptr;
+}
+
+template <typename EVPImpl>
+void encrypt(uint32_t n, size_t size, Shape shape, bool room) {
+  std::unique_ptr<Aead> aead;
+  std::vector<std::unique_ptr<folly::IOBuf>> inputs;
+  std::vector<std::unique_ptr<folly::IOBuf>> keepAlive;
+  auto aad = folly::IOBuf::copyBuffer("aadaa");
+  BENCHMARK_SUSPEND {
+    aead = makeAead<EVPImpl>();
+    aead->setEncryptedBufferHeadroom(room ? kHeadroom : 0);
+    auto plaintext = makeRandom(size);
+    for (size_t i = 0; i < n; ++i) {
+      inputs.push_back(shapeInput(*plaintext, shape, room, keepAlive));
+    }
+  }
+
+  std::unique_ptr<folly::IOBuf> out;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    out = aead->encrypt(std::move(inputs[i]), aad.get(), i);
+  }
+  folly::doNotOptimizeAway(out);
+  BENCHMARK_SUSPEND {
+    inputs.clear();
+    keepAlive.clear();
+  }
+}
+
+template <typename EVPImpl>
+void decrypt(uint32_t n, size_t size, Shape shape, bool room) {
+  std::unique_ptr<Aead> aead;
+  std::vector<std::unique_ptr<folly::IOBuf>> inputs;
+  std::vector<std::unique_ptr<folly::IOBuf>> keepAlive;
+  auto aad = folly::IOBuf::copyBuffer("aadaa");
+  BENCHMARK_SUSPEND {
+    aead = makeAead<EVPImpl>();
+    auto plaintext = makeRandom(size);
+    for (size_t i = 0; i < n; ++i) {
+      auto ciphertext = aead->encrypt(plaintext->clone(), aad.get(), i);
+      inputs.push_back(shapeInput(*ciphertext, shape, room, keepAlive));
+    }
+  }
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> out;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    out = aead->tryDecrypt(std::move(inputs[i]), aad.get(), i);
+    CHECK(out);
+  }
+  folly::doNotOptimizeAway(out);
+  BENCHMARK_SUSPEND {
+    inputs.clear();
+    keepAlive.clear();
+  }
+}
+} // namespace
+
+// "room" variants leave headroom and tailroom in the input like the record
+// layer does, so the aead can encrypt in place and append the tag without
+// allocating.
+#define AEAD_BENCHMARK_SHAPES(func, size)                                  \
+  BENCHMARK_NAMED_PARAM(                                                   \
+      func, size##_contiguous, size, Shape::Contiguous, false)             \
+  BENCHMARK_NAMED_PARAM(                                                   \
+      func, size##_contiguous_room, size, Shape::Contiguous, true)         \
+  BENCHMARK_NAMED_PARAM(func, size##_chained, size, Shape::Chained, false) \
+  BENCHMARK_NAMED_PARAM(                                                   \
+      func, size##_chained_room, size, Shape::Chained, true)               \
+  BENCHMARK_NAMED_PARAM(func, size##_shared, size, Shape::Shared, false)   \
+  BENCHMARK_NAMED_PARAM(func, size##_shared_room, size, Shape::Shared, true)
+
+#define AEAD_BENCHMARKS(name, EVPImpl)                                  \
+  void encrypt##name(uint32_t n, size_t size, Shape shape, bool room) { \
+    encrypt<EVPImpl>(n, size, shape, room);                             \
+  }                                                                     \
+  void decrypt##name(uint32_t n, size_t size, Shape shape, bool room) { \
+    decrypt<EVPImpl>(n, size, shape, room);                             \
+  }                                                                     \
+  AEAD_BENCHMARK_SHAPES(encrypt##name, 16)                              \
+  AEAD_BENCHMARK_SHAPES(encrypt##name, 256)                             \
+  AEAD_BENCHMARK_SHAPES(encrypt##name, 1024)                            \
+  AEAD_BENCHMARK_SHAPES(encrypt##name, 4096)                            \
+  AEAD_BENCHMARK_SHAPES(encrypt##name, 16384)                           \
+  BENCHMARK_DRAW_LINE();                                                \
+  AEAD_BENCHMARK_SHAPES(decrypt##name, 16)                              \
+  AEAD_BENCHMARK_SHAPES(decrypt##name, 256)                             \
+  AEAD_BENCHMARK_SHAPES(decrypt##name, 1024)                            \
+  AEAD_BENCHMARK_SHAPES(decrypt##name, 4096)                            \
+  AEAD_BENCHMARK_SHAPES(decrypt##name, 16384)                           \
+  BENCHMARK_DRAW_LINE();
+
+AEAD_BENCHMARKS(AESGCM128, AESGCM128)
+AEAD_BENCHMARKS(AESGCM256, AESGCM256)
+#if FOLLY_OPENSSL_IS_110
+AEAD_BENCHMARKS(ChaCha20Poly1305, ChaCha20Poly1305)
+#endif
+#if FOLLY_OPENSSL_IS_110 && !defined(OPENSSL_NO_OCB)
+AEAD_BENCHMARKS(AESOCB128, AESOCB128)
+#endif
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::ssl::init();
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/aead/BufferPool.h>
+
+#include <thread>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+TEST(BufferPoolTest, TestReuse) {
+  SizeClassedBufferPool pool;
+  auto buf = pool.allocate(17);
+  EXPECT_TRUE(buf->empty());
+  EXPECT_GE(buf->tailroom(), 17);
+  EXPECT_FALSE(buf->isShared());
+  auto data = buf->data();
+  buf.reset();
+  EXPECT_EQ(pool.cachedBuffers(), 1);
+
+  buf = pool.allocate(20);
+  EXPECT_EQ(buf->data(), data);
+  EXPECT_EQ(pool.cachedBuffers(), 0);
+}
+
+TEST(BufferPoolTest, TestSizeClasses) {
+  SizeClassedBufferPool pool;
+  auto small = pool.allocate(10);
+  auto large = pool.allocate(5000);
+  EXPECT_GE(large->tailroom(), 5000);
+  auto smallData = small->data();
+  small.reset();
+  large.reset();
+  EXPECT_EQ(pool.cachedBuffers(), 2);
+  auto buf = pool.allocate(4000);
+  EXPECT_NE(buf->data(), smallData);
+}
+
+TEST(BufferPoolTest, TestMaxCached) {
+  SizeClassedBufferPool pool(1);
+  auto buf1 = pool.allocate(10);
+  auto buf2 = pool.allocate(10);
+  buf1.reset();
+  buf2.reset();
+  EXPECT_EQ(pool.cachedBuffers(), 1);
+}
+
+TEST(BufferPoolTest, TestTooLarge) {
+  SizeClassedBufferPool pool;
+  auto buf = pool.allocate(SizeClassedBufferPool::kMaxSizeClass + 1);
+  EXPECT_GE(buf->tailroom(), SizeClassedBufferPool::kMaxSizeClass + 1);
+  buf.reset();
+  EXPECT_EQ(pool.cachedBuffers(), 0);
+}
+
+TEST(BufferPoolTest, TestReleaseOnOtherThread) {
+  SizeClassedBufferPool pool;
+  auto buf = pool.allocate(10);
+  auto data = buf->data();
+  std::thread([&buf] { buf.reset(); }).join();
+  EXPECT_EQ(pool.cachedBuffers(), 1);
+
+  buf = pool.allocate(10);
+  EXPECT_EQ(buf->data(), data);
+  EXPECT_EQ(pool.cachedBuffers(), 0);
+}
+
+TEST(BufferPoolTest, TestOutlivePoolOnOtherThread) {
+  std::unique_ptr<IOBuf> buf;
+  {
+    SizeClassedBufferPool pool;
+    buf = pool.allocate(10);
+  }
+  std::thread([&buf] { buf.reset(); }).join();
+}
+
+TEST(BufferPoolTest, TestOutlivePool) {
+  std::unique_ptr<IOBuf> buf;
+  {
+    SizeClassedBufferPool pool;
+    buf = pool.allocate(10);
+    buf->append(1);
+  }
+  buf.reset();
+}
+} // namespace test
+} // namespace fizz
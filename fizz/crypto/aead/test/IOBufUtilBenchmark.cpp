@@ -0,0 +1,163 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <fizz/crypto/aead/IOBufUtil.h>
+
+#include <vector>
+
+using namespace fizz;
+
+namespace {
+
+constexpr size_t kBlockSize = 16;
+constexpr size_t kRecordSize = 16384;
+// What a record looks like when it is read in kMinReadSize (1460 byte) reads.
+constexpr size_t kReadSize = 1460;
+// The largest block aligned segment size below kReadSize.
+constexpr size_t kAlignedReadSize = kReadSize - kReadSize % kBlockSize;
+
+std::vector<uint8_t> makeKeystream() {
+  std::vector<uint8_t> keystream(kRecordSize + kBlockSize);
+  for (size_t i = 0; i < keystream.size(); ++i) {
+    keystream[i] = static_cast<uint8_t>(i * 31 + 7);
+  }
+  return keystream;
+}
+
+std::unique_ptr<folly::IOBuf> makeChain(size_t length, size_t segmentSize) {
+  std::unique_ptr<folly::IOBuf> chain;
+  for (size_t offset = 0; offset < length; offset += segmentSize) {
+    auto segmentLength = std::min(segmentSize, length - offset);
+    auto segment = folly::IOBuf::create(segmentLength);
+    memset(segment->writableData(), 0x5a, segmentLength);
+    segment->append(segmentLength);
+    if (chain) {
+      chain->prependChain(std::move(segment));
+    } else {
+      chain = std::move(segment);
+    }
+  }
+  return chain;
+}
+
+/**
+ * XORs with a keystream a block at a time, buffering partial blocks like a
+ * block cipher mode would.
+ */
+struct BlockXor {
+  explicit BlockXor(const std::vector<uint8_t>& keystreamIn)
+      : keystream(keystreamIn) {}
+
+  size_t operator()(uint8_t* out, const uint8_t* in, size_t len) {
+    size_t written = 0;
+    if (buffered > 0) {
+      auto toCopy = std::min(len, kBlockSize - buffered);
+      memcpy(block + buffered, in, toCopy);
+      buffered += toCopy;
+      in += toCopy;
+      len -= toCopy;
+      if (buffered < kBlockSize) {
+        return 0;
+      }
+      xorOut(out, block, kBlockSize);
+      written += kBlockSize;
+      buffered = 0;
+    }
+    auto blocks = len - len % kBlockSize;
+    xorOut(out + written, in, blocks);
+    written += blocks;
+    memcpy(block, in + blocks, len - blocks);
+    buffered = len - blocks;
+    return written;
+  }
+
+  void xorOut(uint8_t* out, const uint8_t* in, size_t len) {
+    memmove(out, in, len);
+    auto stream = keystream.data() + position;
+    XOR(folly::range(stream, stream + len), folly::MutableByteRange(out, len));
+    position += len;
+  }
+
+  const std::vector<uint8_t>& keystream;
+  size_t position{0};
+  uint8_t block[kBlockSize];
+  size_t buffered{0};
+};
+
+void xorBytes(uint32_t n, size_t length) {
+  std::vector<uint8_t> keystream;
+  std::vector<uint8_t> data;
+  BENCHMARK_SUSPEND {
+    keystream = makeKeystream();
+    data.resize(length);
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    XOR(folly::range(keystream.data(), keystream.data() + length),
+        folly::range(data));
+  }
+  folly::doNotOptimizeAway(data);
+}
+
+void transformStream(uint32_t n, size_t segmentSize) {
+  std::vector<uint8_t> keystream;
+  std::unique_ptr<folly::IOBuf> chain;
+  BENCHMARK_SUSPEND {
+    keystream = makeKeystream();
+    chain = makeChain(kRecordSize, segmentSize);
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    size_t position = 0;
+    transformBuffer(
+        *chain,
+        *chain,
+        [&](uint8_t* out, const uint8_t* /* in */, size_t len) {
+          auto stream = keystream.data() + position;
+          XOR(folly::range(stream, stream + len),
+              folly::MutableByteRange(out, len));
+          position += len;
+        });
+  }
+  folly::doNotOptimizeAway(chain);
+}
+
+void transformBlocks(uint32_t n, size_t segmentSize) {
+  std::vector<uint8_t> keystream;
+  std::unique_ptr<folly::IOBuf> chain;
+  BENCHMARK_SUSPEND {
+    keystream = makeKeystream();
+    chain = makeChain(kRecordSize, segmentSize);
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    BlockXor func(keystream);
+    transformBufferBlocks<kBlockSize>(*chain, *chain, std::ref(func));
+  }
+  folly::doNotOptimizeAway(chain);
+}
+} // namespace
+
+BENCHMARK_PARAM(xorBytes, 16)
+BENCHMARK_PARAM(xorBytes, 1460)
+BENCHMARK_PARAM(xorBytes, 16384)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(transformStream, contiguous, kRecordSize)
+BENCHMARK_NAMED_PARAM(transformStream, read_sized, kReadSize)
+BENCHMARK_NAMED_PARAM(transformStream, 100_byte, 100)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(transformBlocks, contiguous, kRecordSize)
+BENCHMARK_NAMED_PARAM(transformBlocks, read_sized, kReadSize)
+BENCHMARK_NAMED_PARAM(transformBlocks, read_sized_aligned, kAlignedReadSize)
+BENCHMARK_NAMED_PARAM(transformBlocks, 100_byte, 100)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
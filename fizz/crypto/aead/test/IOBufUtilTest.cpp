@@ -245,5 +245,44 @@ TEST(IOBufUtilTest, TransformBufferBlocksFragmented) {
   EXPECT_TRUE(eq(buf, output));
 }
 
+TEST(IOBufUtilTest, TransformBufferBlocksInPlaceAligned) {
+  auto buf = IOBuf::copyBuffer("0000111122223333");
+  buf->prependChain(IOBuf::create(0));
+  buf->prependChain(IOBuf::copyBuffer("44445555"));
+  buf->prependChain(IOBuf::copyBuffer("666"));
+  auto expected = buf->clone();
+  expected->coalesce();
+
+  BlockWriter writer;
+  size_t calls = 0;
+  auto cursor = transformBufferBlocks<8>(
+      *buf,
+      *buf,
+      [&writer, &calls](uint8_t* out, const uint8_t* in, size_t len) {
+        ++calls;
+        return writer.copy(out, in, len);
+      });
+  // One call per buffer, with the partial block left buffered.
+  EXPECT_EQ(calls, 4);
+  EXPECT_EQ(writer.internalOffset, 3);
+  EXPECT_EQ(cursor.totalLength(), 3);
+  IOBufEqualTo eq;
+  EXPECT_TRUE(eq(expected, buf));
+}
+
+TEST(IOBufUtilTest, XOR) {
+  for (size_t len : {0, 1, 7, 8, 9, 63, 64, 65, 200}) {
+    std::vector<uint8_t> first(len);
+    std::vector<uint8_t> second(len);
+    std::vector<uint8_t> expected(len);
+    for (size_t i = 0; i < len; ++i) {
+      first[i] = static_cast<uint8_t>(i * 7 + 1);
+      second[i] = static_cast<uint8_t>(i * 13 + 5);
+      expected[i] = first[i] ^ second[i];
+    }
+    XOR(folly::range(first), folly::range(second));
+    EXPECT_EQ(expected, second) << len;
+  }
+}
 } // namespace test
 } // namespace fizz
@@ -42,6 +42,18 @@ class MockAead : public Aead {
     return _encrypt(plaintext, associatedData, seqNum);
   }
 
+  MOCK_CONST_METHOD6(
+      encryptIovecs,
+      size_t(
+          const struct iovec* plaintext,
+          size_t plaintextCount,
+          const struct iovec* ciphertext,
+          size_t ciphertextCount,
+          const folly::IOBuf* associatedData,
+          uint64_t seqNum));
+  MOCK_CONST_METHOD0(supportsEncryptIovecs, bool());
+  MOCK_METHOD0(releaseIdleResources, void());
+
   MOCK_CONST_METHOD3(
       _decrypt,
       std::unique_ptr<folly::IOBuf>(
@@ -68,6 +80,16 @@ class MockAead : public Aead {
     return _tryDecrypt(ciphertext, associatedData, seqNum);
   }
 
+  MOCK_CONST_METHOD5(
+      tryDecryptIovecs,
+      folly::Optional<size_t>(
+          const folly::IOBuf& ciphertext,
+          const folly::IOBuf* associatedData,
+          uint64_t seqNum,
+          const struct iovec* plaintext,
+          size_t plaintextCount));
+  MOCK_CONST_METHOD0(supportsDecryptIovecs, bool());
+
   void setDefaults() {
     ON_CALL(*this, _encrypt(_, _, _)).WillByDefault(InvokeWithoutArgs([]() {
       return folly::IOBuf::copyBuffer("ciphertext");
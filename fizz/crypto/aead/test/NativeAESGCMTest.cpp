@@ -0,0 +1,249 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/aead/NativeAESGCM.h>
+#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
+#include <fizz/crypto/aead/test/TestUtil.h>
+#include <fizz/record/Types.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+struct NativeParams {
+  std::string key;
+  std::string iv;
+  uint64_t seqNum;
+  std::string aad;
+  std::string plaintext;
+  std::string ciphertext;
+  CipherSuite cipher;
+};
+
+class NativeAESGCMTest : public ::testing::TestWithParam<NativeParams> {
+ public:
+  void SetUp() override {
+    supported_ = NativeAESGCM<AESGCM128>::isSupported();
+  }
+
+ protected:
+  bool supported_{false};
+};
+
+template <typename T>
+std::unique_ptr<Aead> makeCipher(
+    const std::unique_ptr<IOBuf>& key,
+    const std::unique_ptr<IOBuf>& iv) {
+  auto cipher = std::make_unique<T>();
+  TrafficKey trafficKey;
+  trafficKey.key = key->clone();
+  trafficKey.iv = iv->clone();
+  cipher->setKey(std::move(trafficKey));
+  return cipher;
+}
+
+std::unique_ptr<Aead> getNative(const NativeParams& params) {
+  auto key = toIOBuf(params.key);
+  auto iv = toIOBuf(params.iv);
+  if (params.cipher == CipherSuite::TLS_AES_128_GCM_SHA256) {
+    return makeCipher<NativeAESGCM<AESGCM128>>(key, iv);
+  }
+  return makeCipher<NativeAESGCM<AESGCM256>>(key, iv);
+}
+
+std::unique_ptr<Aead> getOpenSSL(const NativeParams& params) {
+  auto key = toIOBuf(params.key);
+  auto iv = toIOBuf(params.iv);
+  if (params.cipher == CipherSuite::TLS_AES_128_GCM_SHA256) {
+    return makeCipher<OpenSSLEVPCipher<AESGCM128>>(key, iv);
+  }
+  return makeCipher<OpenSSLEVPCipher<AESGCM256>>(key, iv);
+}
+
+std::unique_ptr<IOBuf> aadFor(const NativeParams& params) {
+  return params.aad.empty() ? nullptr : toIOBuf(params.aad);
+}
+
+TEST_P(NativeAESGCMTest, TestEncrypt) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto out = cipher->encrypt(
+      toIOBuf(GetParam().plaintext), aad.get(), GetParam().seqNum);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().ciphertext), out));
+}
+
+TEST_P(NativeAESGCMTest, TestEncryptChunkedInput) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto plaintext = toIOBuf(GetParam().plaintext);
+  auto out = cipher->encrypt(
+      chunkIOBuf(std::move(plaintext), 3), aad.get(), GetParam().seqNum);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().ciphertext), out));
+}
+
+TEST_P(NativeAESGCMTest, TestEncryptSharedInput) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto plaintext = toIOBuf(GetParam().plaintext);
+  auto shared = plaintext->clone();
+  auto out =
+      cipher->encrypt(std::move(plaintext), aad.get(), GetParam().seqNum);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().ciphertext), out));
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), shared));
+}
+
+TEST_P(NativeAESGCMTest, TestEncryptIovecs) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto input = chunkIOBuf(toIOBuf(GetParam().plaintext), 3);
+  auto shared = input->clone();
+  auto inputIov = shared->getIov();
+  auto outputLength =
+      input->computeChainDataLength() + cipher->getCipherOverhead();
+  auto output = IOBuf::create(outputLength);
+  output->append(outputLength);
+  struct iovec outputIov[2] = {
+      {output->writableData(), outputLength / 2},
+      {output->writableData() + outputLength / 2,
+       outputLength - outputLength / 2}};
+  EXPECT_EQ(
+      cipher->encryptIovecs(
+          inputIov.data(),
+          inputIov.size(),
+          outputIov,
+          2,
+          aad.get(),
+          GetParam().seqNum),
+      outputLength);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().ciphertext), output));
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), input));
+}
+
+TEST_P(NativeAESGCMTest, TestDecrypt) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto out = cipher->decrypt(
+      toIOBuf(GetParam().ciphertext), aad.get(), GetParam().seqNum);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), out));
+}
+
+TEST_P(NativeAESGCMTest, TestDecryptWithChunkedInput) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto ciphertext = toIOBuf(GetParam().ciphertext);
+  auto out = cipher->decrypt(
+      chunkIOBuf(std::move(ciphertext), 5), aad.get(), GetParam().seqNum);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), out));
+}
+
+TEST_P(NativeAESGCMTest, TestTryDecryptBadTag) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto ciphertext = toIOBuf(GetParam().ciphertext);
+  ciphertext->writableTail()[-1] ^= 0x01;
+  EXPECT_FALSE(cipher->tryDecrypt(
+      std::move(ciphertext), aad.get(), GetParam().seqNum));
+}
+
+TEST_P(NativeAESGCMTest, TestMatchesOpenSSL) {
+  if (!supported_) {
+    return;
+  }
+  auto native = getNative(GetParam());
+  auto openssl = getOpenSSL(GetParam());
+  for (size_t len : {0, 1, 15, 16, 17, 127, 128, 129, 1000, 16384}) {
+    auto plaintext = IOBuf::create(len);
+    for (size_t i = 0; i < len; ++i) {
+      plaintext->writableData()[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+    plaintext->append(len);
+    auto aad = IOBuf::copyBuffer("associated data");
+    auto nativeIn = len < 2
+        ? plaintext->clone()
+        : chunkIOBuf(plaintext->clone(), std::max<size_t>(2, len / 100));
+    auto nativeOut = native->encrypt(std::move(nativeIn), aad.get(), len);
+    auto opensslOut = openssl->encrypt(plaintext->clone(), aad.get(), len);
+    EXPECT_TRUE(IOBufEqualTo()(nativeOut, opensslOut)) << len;
+
+    auto decrypted = native->decrypt(std::move(opensslOut), aad.get(), len);
+    EXPECT_TRUE(IOBufEqualTo()(decrypted, plaintext)) << len;
+  }
+}
+
+TEST_P(NativeAESGCMTest, TestGetKey) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto key = cipher->getKey();
+  ASSERT_TRUE(key.hasValue());
+  EXPECT_TRUE(IOBufEqualTo()(key->key, toIOBuf(GetParam().key)));
+  EXPECT_TRUE(IOBufEqualTo()(key->iv, toIOBuf(GetParam().iv)));
+}
+
+// Test vectors from the GCM specification and the TLS 1.3 traces used in
+// OpenSSLEVPCipherTest.
+INSTANTIATE_TEST_CASE_P(
+    AESGCMTestVectors,
+    NativeAESGCMTest,
+    ::testing::Values(
+        NativeParams{"87f6c12b1ae8a9b7efafc65af0f5c994",
+                     "479e25839c19e0476f95a6f5",
+                     1,
+                     "",
+                     "010015",
+                     "9d4db5ecd768198892531eebac72cf1d477dd0",
+                     CipherSuite::TLS_AES_128_GCM_SHA256},
+        NativeParams{
+            "feffe9928665731c6d6a8f9467308308",
+            "cafebabefacedbaddecaf888",
+            0,
+            "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+            "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+            "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+            "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+            "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091"
+            "5bc94fbc3221a5db94fae95ae7121a47",
+            CipherSuite::TLS_AES_128_GCM_SHA256},
+        NativeParams{
+            "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+            "cafebabefacedbaddecaf888",
+            0,
+            "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+            "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+            "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+            "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+            "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662"
+            "76fc6ece0f4e1768cddf8853bb2d551b",
+            CipherSuite::TLS_AES_256_GCM_SHA384}));
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,194 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/aead/NativeAESOCB.h>
+#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
+#include <fizz/crypto/aead/test/TestUtil.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+struct OCBParams {
+  std::string key;
+  std::string iv;
+  uint64_t seqNum;
+  std::string aad;
+  std::string plaintext;
+  std::string ciphertext;
+};
+
+class NativeAESOCBTest : public ::testing::TestWithParam<OCBParams> {
+ public:
+  void SetUp() override {
+    supported_ = NativeAESOCB<AESOCB128>::isSupported();
+  }
+
+ protected:
+  bool supported_{false};
+};
+
+template <typename T>
+std::unique_ptr<Aead> makeCipher(const std::string& key, const std::string& iv) {
+  auto cipher = std::make_unique<T>();
+  TrafficKey trafficKey;
+  trafficKey.key = toIOBuf(key);
+  trafficKey.iv = toIOBuf(iv);
+  cipher->setKey(std::move(trafficKey));
+  return cipher;
+}
+
+std::unique_ptr<Aead> getNative(const OCBParams& params) {
+  return makeCipher<NativeAESOCB<AESOCB128>>(params.key, params.iv);
+}
+
+std::unique_ptr<IOBuf> aadFor(const OCBParams& params) {
+  return params.aad.empty() ? nullptr : toIOBuf(params.aad);
+}
+
+TEST_P(NativeAESOCBTest, TestEncrypt) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto out = cipher->encrypt(
+      toIOBuf(GetParam().plaintext), aad.get(), GetParam().seqNum);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().ciphertext), out));
+}
+
+TEST_P(NativeAESOCBTest, TestEncryptChunkedInput) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto plaintext = toIOBuf(GetParam().plaintext);
+  auto out = cipher->encrypt(
+      chunkIOBuf(std::move(plaintext), 3), aad.get(), GetParam().seqNum);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().ciphertext), out));
+}
+
+TEST_P(NativeAESOCBTest, TestEncryptSharedInput) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto plaintext = toIOBuf(GetParam().plaintext);
+  auto shared = plaintext->clone();
+  auto out =
+      cipher->encrypt(std::move(plaintext), aad.get(), GetParam().seqNum);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().ciphertext), out));
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), shared));
+}
+
+TEST_P(NativeAESOCBTest, TestDecrypt) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto out = cipher->decrypt(
+      toIOBuf(GetParam().ciphertext), aad.get(), GetParam().seqNum);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), out));
+}
+
+TEST_P(NativeAESOCBTest, TestDecryptWithChunkedInput) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto ciphertext = toIOBuf(GetParam().ciphertext);
+  auto out = cipher->decrypt(
+      chunkIOBuf(std::move(ciphertext), 5), aad.get(), GetParam().seqNum);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), out));
+}
+
+TEST_P(NativeAESOCBTest, TestTryDecryptBadTag) {
+  if (!supported_) {
+    return;
+  }
+  auto cipher = getNative(GetParam());
+  auto aad = aadFor(GetParam());
+  auto ciphertext = toIOBuf(GetParam().ciphertext);
+  ciphertext->writableTail()[-1] ^= 0x01;
+  EXPECT_FALSE(cipher->tryDecrypt(
+      std::move(ciphertext), aad.get(), GetParam().seqNum));
+}
+
+#if FOLLY_OPENSSL_IS_110 && !defined(OPENSSL_NO_OCB)
+TEST_P(NativeAESOCBTest, TestMatchesOpenSSL) {
+  if (!supported_) {
+    return;
+  }
+  auto native = getNative(GetParam());
+  auto openssl =
+      makeCipher<OpenSSLEVPCipher<AESOCB128>>(GetParam().key, GetParam().iv);
+  for (size_t len : {0, 1, 15, 16, 17, 127, 128, 129, 1000, 16384}) {
+    auto plaintext = IOBuf::create(len);
+    for (size_t i = 0; i < len; ++i) {
+      plaintext->writableData()[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+    plaintext->append(len);
+    auto aad = IOBuf::copyBuffer("associated data");
+    auto nativeIn = len < 2
+        ? plaintext->clone()
+        : chunkIOBuf(plaintext->clone(), std::max<size_t>(2, len / 100));
+    auto nativeOut = native->encrypt(std::move(nativeIn), aad.get(), len);
+    auto opensslOut = openssl->encrypt(plaintext->clone(), aad.get(), len);
+    EXPECT_TRUE(IOBufEqualTo()(nativeOut, opensslOut)) << len;
+
+    auto decrypted = native->decrypt(std::move(opensslOut), aad.get(), len);
+    EXPECT_TRUE(IOBufEqualTo()(decrypted, plaintext)) << len;
+  }
+}
+#endif
+
+// The valid AES OCB vectors from OpenSSLEVPCipherTest.
+INSTANTIATE_TEST_CASE_P(
+    OCBTestVectors,
+    NativeAESOCBTest,
+    ::testing::Values(
+        OCBParams{"000102030405060708090A0B0C0D0E0F",
+                  "000102030405060708090A0B",
+                  0,
+                  "0001020304050607",
+                  "0001020304050607",
+                  "92B657130A74B85A16DC76A46D47E1EAD537209E8A96D14E"},
+        OCBParams{
+            "000102030405060708090A0B0C0D0E0F",
+            "000102030405060708090A0B",
+            0,
+            "000102030405060708090A0B0C0D0E0F",
+            "000102030405060708090A0B0C0D0E0F",
+            "BEA5E8798DBE7110031C144DA0B26122776C9924D6723A1FC4524532AC3E5BEB"},
+        OCBParams{
+            "000102030405060708090A0B0C0D0E0F",
+            "000102030405060708090A0B",
+            0,
+            "000102030405060708090A0B0C0D0E0F1011121314151617",
+            "000102030405060708090A0B0C0D0E0F1011121314151617",
+            "BEA5E8798DBE7110031C144DA0B26122FCFCEE7A2A8D4D485FA94FC3F38820F1"
+            "DC3F3D1FD4E55E1C"},
+        OCBParams{
+            "000102030405060708090A0B0C0D0E0F",
+            "000102030405060708090A0B",
+            0,
+            "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+            "2021222324252627",
+            "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+            "2021222324252627",
+            "BEA5E8798DBE7110031C144DA0B26122CEAAB9B05DF771A657149D53773463CB"
+            "68C65778B058A635659C623211DEEA0DE30D2C381879F4C8"}));
+} // namespace test
+} // namespace fizz
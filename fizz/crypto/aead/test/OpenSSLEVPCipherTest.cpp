@@ -215,6 +215,84 @@ TEST_P(OpenSSLEVPCipherTest, TestEncryptChunkedAad) {
   callEncrypt(cipher, GetParam(), nullptr, std::move(chunkedAad));
 }
 
+TEST_P(OpenSSLEVPCipherTest, TestEncryptIovecs) {
+  auto cipher = getCipher(GetParam());
+  auto input = chunkIOBuf(toIOBuf(GetParam().plaintext), 3);
+  auto shared = input->clone();
+  auto aad = toIOBuf(GetParam().aad);
+  auto inputIov = shared->getIov();
+
+  auto outputLength =
+      input->computeChainDataLength() + cipher->getCipherOverhead();
+  auto output = IOBuf::create(outputLength);
+  output->append(outputLength);
+  // split the output across two iovecs
+  struct iovec outputIov[2] = {
+      {output->writableData(), outputLength / 2},
+      {output->writableData() + outputLength / 2,
+       outputLength - outputLength / 2}};
+  EXPECT_EQ(
+      cipher->encryptIovecs(
+          inputIov.data(),
+          inputIov.size(),
+          outputIov,
+          2,
+          aad.get(),
+          GetParam().seqNum),
+      outputLength);
+  EXPECT_EQ(
+      IOBufEqualTo()(toIOBuf(GetParam().ciphertext), output),
+      GetParam().valid);
+  // the input is left untouched
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), input));
+}
+
+TEST_P(OpenSSLEVPCipherTest, TestEncryptIovecsTooSmall) {
+  auto cipher = getCipher(GetParam());
+  auto input = toIOBuf(GetParam().plaintext);
+  auto inputIov = input->getIov();
+  auto output = IOBuf::create(input->length());
+  struct iovec outputIov = {output->writableData(), input->length()};
+  EXPECT_THROW(
+      cipher->encryptIovecs(
+          inputIov.data(), inputIov.size(), &outputIov, 1, nullptr, 0),
+      std::runtime_error);
+}
+
+TEST_P(OpenSSLEVPCipherTest, TestEncryptBatch) {
+  auto cipher = getCipher(GetParam());
+  auto reference = getCipher(GetParam());
+  auto aad = toIOBuf(GetParam().aad);
+  // Enough records to need more than one run of nonces.
+  const size_t numRecords = 20;
+  std::vector<std::unique_ptr<IOBuf>> plaintexts;
+  std::vector<const IOBuf*> associatedData;
+  for (size_t i = 0; i < numRecords; ++i) {
+    plaintexts.push_back(toIOBuf(GetParam().plaintext));
+    associatedData.push_back(aad.get());
+  }
+  auto ciphertexts = cipher->encryptBatch(
+      std::move(plaintexts), associatedData, GetParam().seqNum);
+  ASSERT_EQ(ciphertexts.size(), numRecords);
+  EXPECT_EQ(
+      IOBufEqualTo()(toIOBuf(GetParam().ciphertext), ciphertexts[0]),
+      GetParam().valid);
+  for (size_t i = 0; i < numRecords; ++i) {
+    auto expected = reference->encrypt(
+        toIOBuf(GetParam().plaintext), aad.get(), GetParam().seqNum + i);
+    EXPECT_TRUE(IOBufEqualTo()(expected, ciphertexts[i]));
+  }
+}
+
+TEST_P(OpenSSLEVPCipherTest, TestEncryptBatchAadMismatch) {
+  auto cipher = getCipher(GetParam());
+  std::vector<std::unique_ptr<IOBuf>> plaintexts;
+  plaintexts.push_back(toIOBuf(GetParam().plaintext));
+  EXPECT_THROW(
+      cipher->encryptBatch(std::move(plaintexts), {}, GetParam().seqNum),
+      std::runtime_error);
+}
+
 TEST_P(OpenSSLEVPCipherTest, TestDecrypt) {
   auto cipher = getCipher(GetParam());
   callDecrypt(cipher, GetParam());
@@ -227,6 +305,24 @@ TEST_P(OpenSSLEVPCipherTest, TestDecryptReusedCipher) {
   callDecrypt(cipher, GetParam());
 }
 
+TEST_P(OpenSSLEVPCipherTest, TestReleaseIdleResources) {
+  auto cipher = getCipher(GetParam());
+  callEncrypt(cipher, GetParam());
+  callDecrypt(cipher, GetParam());
+  cipher->releaseIdleResources();
+  callEncrypt(cipher, GetParam());
+  callDecrypt(cipher, GetParam());
+}
+
+TEST_P(OpenSSLEVPCipherTest, TestSetKeyAfterReleaseIdleResources) {
+  auto cipher = getCipher(GetParam());
+  auto key = cipher->getKey();
+  cipher->releaseIdleResources();
+  cipher->setKey(std::move(*key));
+  callEncrypt(cipher, GetParam());
+  callDecrypt(cipher, GetParam());
+}
+
 TEST_P(OpenSSLEVPCipherTest, TestDecryptInputTooSmall) {
   auto cipher = getCipher(GetParam());
   auto in = IOBuf::copyBuffer("in");
@@ -277,6 +373,63 @@ TEST_P(OpenSSLEVPCipherTest, TestTryDecrypt) {
   }
 }
 
+TEST_P(OpenSSLEVPCipherTest, TestTryDecryptInPlaceShared) {
+  auto cipher = getCipher(GetParam());
+  auto input = toIOBuf(GetParam().ciphertext);
+  auto shared = input->clone();
+  auto out = cipher->tryDecryptInPlace(
+      std::move(shared), toIOBuf(GetParam().aad).get(), GetParam().seqNum);
+  if (out) {
+    EXPECT_TRUE(GetParam().valid);
+    EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), *out));
+    // decrypted into the shared buffer rather than a copy
+    EXPECT_EQ((*out)->data(), input->data());
+  } else {
+    EXPECT_FALSE(GetParam().valid);
+  }
+}
+
+TEST_P(OpenSSLEVPCipherTest, TestTryDecryptIovecs) {
+  auto cipher = getCipher(GetParam());
+  auto input = chunkIOBuf(toIOBuf(GetParam().ciphertext), 3);
+  auto shared = input->clone();
+
+  auto outputLength =
+      input->computeChainDataLength() - cipher->getCipherOverhead();
+  auto output = IOBuf::create(outputLength);
+  output->append(outputLength);
+  // split the output across two iovecs
+  struct iovec outputIov[2] = {
+      {output->writableData(), outputLength / 2},
+      {output->writableData() + outputLength / 2,
+       outputLength - outputLength / 2}};
+  auto written = cipher->tryDecryptIovecs(
+      *shared,
+      toIOBuf(GetParam().aad).get(),
+      GetParam().seqNum,
+      outputIov,
+      2);
+  if (written) {
+    EXPECT_TRUE(GetParam().valid);
+    EXPECT_EQ(*written, outputLength);
+    EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().plaintext), output));
+  } else {
+    EXPECT_FALSE(GetParam().valid);
+  }
+  // the input is left untouched
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(GetParam().ciphertext), input));
+}
+
+TEST_P(OpenSSLEVPCipherTest, TestTryDecryptIovecsTooSmall) {
+  auto cipher = getCipher(GetParam());
+  auto input = toIOBuf(GetParam().ciphertext);
+  auto output = IOBuf::create(input->length());
+  struct iovec outputIov = {output->writableData(), 1};
+  EXPECT_THROW(
+      cipher->tryDecryptIovecs(*input, nullptr, 0, &outputIov, 1),
+      std::runtime_error);
+}
+
 // Adapted from draft-thomson-tls-tls13-vectors
 INSTANTIATE_TEST_CASE_P(
     AESGCM128TestVectors,
@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
+#include <fizz/crypto/aead/SodiumChaCha20Poly1305.h>
+#include <fizz/crypto/aead/test/TestUtil.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+// RFC 7539, section 2.8.2.
+constexpr auto kKey =
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f";
+constexpr auto kIV = "070000004041424344454647";
+constexpr auto kAad = "50515253c0c1c2c3c4c5c6c7";
+constexpr auto kPlaintext =
+    "4c616469657320616e642047656e746c656d656e206f662074686520636c6173"
+    "73206f66202739393a204966204920636f756c64206f6666657220796f75206f"
+    "6e6c79206f6e652074697020666f7220746865206675747572652c2073756e73"
+    "637265656e20776f756c642062652069742e";
+constexpr auto kCiphertext =
+    "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+    "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+    "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+    "3ff4def08e4b7a9de576d26586cec64b6116"
+    "1ae10b594f09e26a7e902ecbd0600691";
+
+template <typename T>
+std::unique_ptr<Aead> getCipher() {
+  auto cipher = std::make_unique<T>();
+  TrafficKey trafficKey;
+  trafficKey.key = toIOBuf(kKey);
+  trafficKey.iv = toIOBuf(kIV);
+  cipher->setKey(std::move(trafficKey));
+  return cipher;
+}
+
+TEST(SodiumChaCha20Poly1305Test, TestEncrypt) {
+  auto cipher = getCipher<SodiumChaCha20Poly1305>();
+  auto aad = toIOBuf(kAad);
+  auto out = cipher->encrypt(toIOBuf(kPlaintext), aad.get(), 0);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(kCiphertext), out));
+}
+
+TEST(SodiumChaCha20Poly1305Test, TestEncryptChunked) {
+  auto cipher = getCipher<SodiumChaCha20Poly1305>();
+  auto aad = chunkIOBuf(toIOBuf(kAad), 5);
+  auto out =
+      cipher->encrypt(chunkIOBuf(toIOBuf(kPlaintext), 13), aad.get(), 0);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(kCiphertext), out));
+}
+
+TEST(SodiumChaCha20Poly1305Test, TestEncryptShared) {
+  auto cipher = getCipher<SodiumChaCha20Poly1305>();
+  auto aad = toIOBuf(kAad);
+  auto plaintext = chunkIOBuf(toIOBuf(kPlaintext), 3);
+  auto out = cipher->encrypt(plaintext->clone(), aad.get(), 0);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(kCiphertext), out));
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(kPlaintext), plaintext));
+}
+
+TEST(SodiumChaCha20Poly1305Test, TestDecrypt) {
+  auto cipher = getCipher<SodiumChaCha20Poly1305>();
+  auto aad = toIOBuf(kAad);
+  auto out =
+      cipher->decrypt(chunkIOBuf(toIOBuf(kCiphertext), 7), aad.get(), 0);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(kPlaintext), out));
+}
+
+TEST(SodiumChaCha20Poly1305Test, TestDecryptShared) {
+  auto cipher = getCipher<SodiumChaCha20Poly1305>();
+  auto aad = toIOBuf(kAad);
+  auto ciphertext = toIOBuf(kCiphertext);
+  auto out = cipher->decrypt(ciphertext->clone(), aad.get(), 0);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(kPlaintext), out));
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(kCiphertext), ciphertext));
+}
+
+TEST(SodiumChaCha20Poly1305Test, TestDecryptFailure) {
+  auto cipher = getCipher<SodiumChaCha20Poly1305>();
+  auto aad = toIOBuf(kAad);
+  auto ciphertext = toIOBuf(kCiphertext);
+  ciphertext->writableData()[0] ^= 0x01;
+  EXPECT_FALSE(cipher->tryDecrypt(std::move(ciphertext), aad.get(), 0));
+  EXPECT_FALSE(cipher->tryDecrypt(IOBuf::copyBuffer("short"), aad.get(), 0));
+  // wrong sequence number
+  EXPECT_THROW(
+      cipher->decrypt(toIOBuf(kCiphertext), aad.get(), 1), std::runtime_error);
+}
+
+TEST(SodiumChaCha20Poly1305Test, TestEncryptIovecs) {
+  auto cipher = getCipher<SodiumChaCha20Poly1305>();
+  auto aad = toIOBuf(kAad);
+  auto plaintext = chunkIOBuf(toIOBuf(kPlaintext), 4);
+  auto inputIov = plaintext->getIov();
+  auto outputLength =
+      plaintext->computeChainDataLength() + cipher->getCipherOverhead();
+  auto output = IOBuf::create(outputLength);
+  output->append(outputLength);
+  struct iovec outputIov[2] = {
+      {output->writableData(), 33},
+      {output->writableData() + 33, outputLength - 33}};
+  EXPECT_EQ(
+      cipher->encryptIovecs(
+          inputIov.data(), inputIov.size(), outputIov, 2, aad.get(), 0),
+      outputLength);
+  EXPECT_TRUE(IOBufEqualTo()(toIOBuf(kCiphertext), output));
+}
+
+#if FOLLY_OPENSSL_IS_110
+TEST(SodiumChaCha20Poly1305Test, TestMatchesOpenSSL) {
+  auto sodium = getCipher<SodiumChaCha20Poly1305>();
+  auto openssl = getCipher<OpenSSLEVPCipher<ChaCha20Poly1305>>();
+  for (size_t len : {0, 1, 63, 64, 65, 255, 256, 1000, 16384}) {
+    auto plaintext = IOBuf::create(len);
+    for (size_t i = 0; i < len; ++i) {
+      plaintext->writableData()[i] = static_cast<uint8_t>(i * 13 + 5);
+    }
+    plaintext->append(len);
+    auto aad = IOBuf::copyBuffer("associated data");
+    auto sodiumIn = len < 2
+        ? plaintext->clone()
+        : chunkIOBuf(plaintext->clone(), std::max<size_t>(2, len / 100));
+    auto sodiumOut = sodium->encrypt(std::move(sodiumIn), aad.get(), len);
+    auto opensslOut = openssl->encrypt(plaintext->clone(), aad.get(), len);
+    EXPECT_TRUE(IOBufEqualTo()(sodiumOut, opensslOut)) << len;
+
+    auto decrypted = sodium->decrypt(std::move(opensslOut), aad.get(), len);
+    EXPECT_TRUE(IOBufEqualTo()(decrypted, plaintext)) << len;
+  }
+}
+#endif
+} // namespace test
+} // namespace fizz
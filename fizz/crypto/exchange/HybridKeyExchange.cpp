@@ -0,0 +1,39 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/exchange/HybridKeyExchange.h>
+
+namespace fizz {
+
+void HybridKeyExchange::generateKeyPair() {
+  first_->generateKeyPair();
+  second_->generateKeyPair();
+}
+
+std::unique_ptr<folly::IOBuf> HybridKeyExchange::getKeyShare() const {
+  auto share = first_->getKeyShare();
+  if (share->computeChainDataLength() != firstShareLength_) {
+    throw std::runtime_error("Invalid key share length");
+  }
+  // Chained rather than copied, the record layer coalesces when encoding.
+  share->prependChain(second_->getKeyShare());
+  return share;
+}
+
+std::unique_ptr<folly::IOBuf> HybridKeyExchange::generateSharedSecret(
+    folly::ByteRange keyShare) const {
+  if (keyShare.size() <= firstShareLength_) {
+    throw std::runtime_error("Invalid external public key");
+  }
+  auto secret =
+      first_->generateSharedSecret(keyShare.subpiece(0, firstShareLength_));
+  secret->prependChain(
+      second_->generateSharedSecret(keyShare.subpiece(firstShareLength_)));
+  return secret;
+}
+} // namespace fizz
@@ -0,0 +1,52 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/exchange/KeyExchange.h>
+
+namespace fizz {
+
+/**
+ * Key exchange that runs two key exchanges side by side, as used by the
+ * hybrid post-quantum groups. Key shares are the first share followed by the
+ * second, and the shared secret is the first secret followed by the second.
+ *
+ * Either part may be a key encapsulation mechanism, with separate client and
+ * server implementations (see Kyber768ClientKeyExchange and
+ * Kyber768ServerKeyExchange): the client's share is its encapsulation key,
+ * and the server's is the ciphertext of its encapsulation.
+ *
+ * firstShareLength is the size of the first key exchange's shares, which
+ * must be the same in both directions.
+ */
+class HybridKeyExchange : public KeyExchange {
+ public:
+  HybridKeyExchange(
+      std::unique_ptr<KeyExchange> first,
+      size_t firstShareLength,
+      std::unique_ptr<KeyExchange> second)
+      : first_(std::move(first)),
+        second_(std::move(second)),
+        firstShareLength_(firstShareLength) {}
+
+  ~HybridKeyExchange() override = default;
+
+  void generateKeyPair() override;
+
+  std::unique_ptr<folly::IOBuf> getKeyShare() const override;
+
+  std::unique_ptr<folly::IOBuf> generateSharedSecret(
+      folly::ByteRange keyShare) const override;
+
+ private:
+  std::unique_ptr<KeyExchange> first_;
+  std::unique_ptr<KeyExchange> second_;
+  size_t firstShareLength_;
+};
+} // namespace fizz
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <folly/Range.h>
+#include <folly/futures/Future.h>
 #include <folly/io/IOBuf.h>
 
 namespace fizz {
@@ -42,5 +43,19 @@ class KeyExchange {
    */
   virtual std::unique_ptr<folly::IOBuf> generateSharedSecret(
       folly::ByteRange keyShare) const = 0;
+
+  /**
+   * Asynchronous version of generateSharedSecret(), for implementations that
+   * offload the computation to another thread or to hardware. keyShare is
+   * only guaranteed to be valid until this returns, and this object is kept
+   * alive until the returned future completes. getKeyShare() may not be
+   * called until then.
+   *
+   * The default implementation calls generateSharedSecret() synchronously.
+   */
+  virtual folly::SemiFuture<std::unique_ptr<folly::IOBuf>>
+  generateSharedSecretAsync(folly::ByteRange keyShare) const {
+    return folly::makeSemiFuture(generateSharedSecret(keyShare));
+  }
 };
 } // namespace fizz
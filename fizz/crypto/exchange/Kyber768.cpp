@@ -0,0 +1,580 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/exchange/Kyber768.h>
+
+#include <folly/ssl/OpenSSLPtrTypes.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include <array>
+#include <initializer_list>
+#include <stdexcept>
+
+namespace fizz {
+namespace kyber768 {
+
+namespace {
+
+constexpr size_t kN = 256;
+constexpr uint32_t kQ = 3329;
+constexpr size_t kK = 3;
+
+constexpr size_t kPolyBytes = 384;
+constexpr size_t kPolyVecBytes = kK * kPolyBytes;
+constexpr size_t kPolyCompressedBytes = 128;
+constexpr size_t kPolyVecCompressedBytes = kK * 320;
+constexpr size_t kIndCpaSecretKeyBytes = kPolyVecBytes;
+constexpr size_t kShake128Rate = 168;
+constexpr size_t kNoiseBytes = 2 * kN / 4;
+
+static_assert(kPublicKeyBytes == kPolyVecBytes + kSeedBytes, "pk size");
+static_assert(
+    kCiphertextBytes == kPolyVecCompressedBytes + kPolyCompressedBytes,
+    "ct size");
+static_assert(
+    kSecretKeyBytes == kIndCpaSecretKeyBytes + kPublicKeyBytes + 2 * kSeedBytes,
+    "sk size");
+
+// Coefficients are always kept reduced to [0, q). Unlike the reference
+// implementation there is no Montgomery form: every product is reduced
+// directly, which gives the same values mod q.
+//
+// Coefficients of secrets must not go through a division (which takes a
+// variable number of cycles on many CPUs, see KyberSlash), so nothing below
+// divides by q: reductions multiply by 2^32 / q and shift instead.
+using Poly = std::array<uint16_t, kN>;
+using PolyVec = std::array<Poly, kK>;
+
+// floor(2^32 / q)
+constexpr uint64_t kBarrettMultiplier = 1290167;
+
+// x - q if x >= q, for x < 2q.
+inline uint16_t condSubQ(uint32_t x) {
+  uint32_t r = x - kQ;
+  return r + ((0 - (r >> 31)) & kQ);
+}
+
+// x mod q, for x < 2^24. The estimated quotient is at most one too small.
+inline uint16_t reduce(uint32_t x) {
+  uint32_t quotient = (x * kBarrettMultiplier) >> 32;
+  return condSubQ(x - quotient * kQ);
+}
+
+inline uint16_t add(uint32_t a, uint32_t b) {
+  return condSubQ(a + b);
+}
+
+inline uint16_t sub(uint32_t a, uint32_t b) {
+  return condSubQ(a + kQ - b);
+}
+
+inline uint16_t mul(uint32_t a, uint32_t b) {
+  return reduce(a * b);
+}
+
+constexpr uint32_t bitReverse7(uint32_t i) {
+  uint32_t r = 0;
+  for (int bit = 0; bit < 7; bit++) {
+    r |= ((i >> bit) & 1) << (6 - bit);
+  }
+  return r;
+}
+
+// zetas[i] = 17^bitReverse7(i) mod q, 17 being a primitive 256th root of
+// unity.
+struct Zetas {
+  constexpr Zetas() : v() {
+    for (uint32_t i = 0; i < 128; i++) {
+      uint32_t zeta = 1;
+      for (uint32_t e = 0; e < bitReverse7(i); e++) {
+        zeta = (zeta * 17) % kQ;
+      }
+      v[i] = zeta;
+    }
+  }
+  uint16_t v[128];
+};
+constexpr Zetas kZetas;
+
+// 128^-1 mod q, the scaling of the inverse NTT.
+constexpr uint32_t kInvNttScale = 3303;
+
+void ntt(Poly& r) {
+  size_t k = 1;
+  for (size_t len = 128; len >= 2; len >>= 1) {
+    for (size_t start = 0; start < kN; start += 2 * len) {
+      uint32_t zeta = kZetas.v[k++];
+      for (size_t j = start; j < start + len; j++) {
+        uint16_t t = mul(zeta, r[j + len]);
+        r[j + len] = sub(r[j], t);
+        r[j] = add(r[j], t);
+      }
+    }
+  }
+}
+
+void invNtt(Poly& r) {
+  size_t k = 127;
+  for (size_t len = 2; len <= 128; len <<= 1) {
+    for (size_t start = 0; start < kN; start += 2 * len) {
+      uint32_t zeta = kZetas.v[k--];
+      for (size_t j = start; j < start + len; j++) {
+        uint16_t t = r[j];
+        r[j] = add(t, r[j + len]);
+        r[j + len] = mul(zeta, sub(r[j + len], t));
+      }
+    }
+  }
+  for (auto& coeff : r) {
+    coeff = mul(coeff, kInvNttScale);
+  }
+}
+
+// r += a * b, for polynomials in the NTT domain, which multiply as 128
+// degree one polynomials mod (X^2 - zeta).
+void baseMulAcc(Poly& r, const Poly& a, const Poly& b) {
+  for (size_t i = 0; i < kN / 4; i++) {
+    uint32_t zeta = kZetas.v[64 + i];
+    for (size_t half = 0; half < 2; half++) {
+      size_t j = 4 * i + 2 * half;
+      uint32_t z = half == 0 ? zeta : kQ - zeta;
+      uint16_t r0 = add(mul(mul(a[j + 1], b[j + 1]), z), mul(a[j], b[j]));
+      uint16_t r1 = add(mul(a[j], b[j + 1]), mul(a[j + 1], b[j]));
+      r[j] = add(r[j], r0);
+      r[j + 1] = add(r[j + 1], r1);
+    }
+  }
+}
+
+void innerProduct(Poly& r, const PolyVec& a, const PolyVec& b) {
+  r.fill(0);
+  for (size_t i = 0; i < kK; i++) {
+    baseMulAcc(r, a[i], b[i]);
+  }
+}
+
+void addTo(Poly& r, const Poly& a) {
+  for (size_t i = 0; i < kN; i++) {
+    r[i] = add(r[i], a[i]);
+  }
+}
+
+void digest(
+    const EVP_MD* md,
+    std::initializer_list<folly::ByteRange> in,
+    uint8_t* out,
+    size_t outLength) {
+  folly::ssl::EvpMdCtxUniquePtr ctx(EVP_MD_CTX_new());
+  if (!ctx || EVP_DigestInit_ex(ctx.get(), md, nullptr) != 1) {
+    throw std::runtime_error("failed to initialize digest");
+  }
+  for (auto range : in) {
+    if (EVP_DigestUpdate(ctx.get(), range.data(), range.size()) != 1) {
+      throw std::runtime_error("failed to update digest");
+    }
+  }
+  int ret;
+  if (EVP_MD_flags(md) & EVP_MD_FLAG_XOF) {
+    ret = EVP_DigestFinalXOF(ctx.get(), out, outLength);
+  } else {
+    unsigned int length = 0;
+    ret = EVP_DigestFinal_ex(ctx.get(), out, &length);
+    if (length != outLength) {
+      ret = 0;
+    }
+  }
+  if (ret != 1) {
+    throw std::runtime_error("failed to finalize digest");
+  }
+}
+
+// H
+void hash256(std::initializer_list<folly::ByteRange> in, uint8_t* out) {
+  digest(EVP_sha3_256(), in, out, 32);
+}
+
+// G
+void hash512(std::initializer_list<folly::ByteRange> in, uint8_t* out) {
+  digest(EVP_sha3_512(), in, out, 64);
+}
+
+// KDF
+void kdf(const uint8_t* in, uint8_t* out) {
+  digest(EVP_shake256(), {folly::ByteRange(in, 2 * kSeedBytes)}, out, 32);
+}
+
+// Samples the matrix entry generated from seed, i and j by rejection from
+// SHAKE128. Three blocks are almost always enough; since a longer output of
+// an XOF extends a shorter one, the rare entry that needs more just squeezes
+// again with a longer output.
+void sampleUniform(Poly& r, const uint8_t* seed, uint8_t i, uint8_t j) {
+  uint8_t indices[2] = {i, j};
+  std::array<uint8_t, 8 * kShake128Rate> buf;
+  for (size_t blocks = 3; blocks <= 8; blocks++) {
+    size_t length = blocks * kShake128Rate;
+    digest(
+        EVP_shake128(),
+        {folly::ByteRange(seed, kSeedBytes), folly::range(indices)},
+        buf.data(),
+        length);
+    size_t count = 0;
+    for (size_t pos = 0; pos + 3 <= length && count < kN; pos += 3) {
+      uint16_t val0 = (buf[pos] | (uint16_t(buf[pos + 1]) << 8)) & 0xfff;
+      uint16_t val1 = ((buf[pos + 1] >> 4) | (uint16_t(buf[pos + 2]) << 4));
+      if (val0 < kQ) {
+        r[count++] = val0;
+      }
+      if (val1 < kQ && count < kN) {
+        r[count++] = val1;
+      }
+    }
+    if (count == kN) {
+      return;
+    }
+  }
+  throw std::runtime_error("failed to sample matrix");
+}
+
+// a[i][j] is sampled from (seed, j, i), or (seed, i, j) for the transpose.
+void generateMatrix(
+    std::array<PolyVec, kK>& a,
+    const uint8_t* seed,
+    bool transposed) {
+  for (uint8_t i = 0; i < kK; i++) {
+    for (uint8_t j = 0; j < kK; j++) {
+      if (transposed) {
+        sampleUniform(a[i][j], seed, i, j);
+      } else {
+        sampleUniform(a[i][j], seed, j, i);
+      }
+    }
+  }
+}
+
+// Centered binomial distribution with eta = 2, from SHAKE256(seed, nonce).
+void sampleNoise(Poly& r, const uint8_t* seed, uint8_t nonce) {
+  std::array<uint8_t, kNoiseBytes> buf;
+  digest(
+      EVP_shake256(),
+      {folly::ByteRange(seed, kSeedBytes), folly::ByteRange(&nonce, 1)},
+      buf.data(),
+      buf.size());
+  for (size_t i = 0; i < kN / 8; i++) {
+    uint32_t t = uint32_t(buf[4 * i]) | (uint32_t(buf[4 * i + 1]) << 8) |
+        (uint32_t(buf[4 * i + 2]) << 16) | (uint32_t(buf[4 * i + 3]) << 24);
+    uint32_t d = (t & 0x55555555) + ((t >> 1) & 0x55555555);
+    for (size_t j = 0; j < 8; j++) {
+      uint32_t a = (d >> (4 * j)) & 3;
+      uint32_t b = (d >> (4 * j + 2)) & 3;
+      r[8 * i + j] = sub(a, b);
+    }
+  }
+}
+
+void polyToBytes(uint8_t* r, const Poly& a) {
+  for (size_t i = 0; i < kN / 2; i++) {
+    uint16_t t0 = a[2 * i];
+    uint16_t t1 = a[2 * i + 1];
+    r[3 * i] = t0 & 0xff;
+    r[3 * i + 1] = (t0 >> 8) | ((t1 << 4) & 0xff);
+    r[3 * i + 2] = t1 >> 4;
+  }
+}
+
+// Encoded coefficients may be up to 4095, they are reduced mod q.
+void polyFromBytes(Poly& r, const uint8_t* a) {
+  for (size_t i = 0; i < kN / 2; i++) {
+    uint16_t t0 = (a[3 * i] | (uint16_t(a[3 * i + 1]) << 8)) & 0xfff;
+    uint16_t t1 = (a[3 * i + 1] >> 4) | (uint16_t(a[3 * i + 2]) << 4);
+    r[2 * i] = condSubQ(t0);
+    r[2 * i + 1] = condSubQ(t1);
+  }
+}
+
+void polyVecToBytes(uint8_t* r, const PolyVec& a) {
+  for (size_t i = 0; i < kK; i++) {
+    polyToBytes(r + i * kPolyBytes, a[i]);
+  }
+}
+
+void polyVecFromBytes(PolyVec& r, const uint8_t* a) {
+  for (size_t i = 0; i < kK; i++) {
+    polyFromBytes(r[i], a + i * kPolyBytes);
+  }
+}
+
+// Compression to d bits: round(2^d / q * x) mod 2^d. Computed as in the
+// reference implementation since KyberSlash; rounding with (q + 1) / 2
+// rather than q / 2 makes up for the multiplier being rounded down, which
+// gives the exact result for every x < q and d <= 10.
+template <unsigned D>
+inline uint16_t compress(uint16_t x) {
+  static_assert(D <= 10, "compress");
+  uint64_t scaled = (uint64_t(x) << D) + (kQ + 1) / 2;
+  return ((scaled * kBarrettMultiplier) >> 32) & ((1 << D) - 1);
+}
+
+template <unsigned D>
+inline uint16_t decompress(uint16_t x) {
+  return (uint32_t(x) * kQ + (1 << (D - 1))) >> D;
+}
+
+// Compressed to 4 bits per coefficient.
+void polyCompress(uint8_t* r, const Poly& a) {
+  for (size_t i = 0; i < kN / 2; i++) {
+    r[i] = compress<4>(a[2 * i]) | (compress<4>(a[2 * i + 1]) << 4);
+  }
+}
+
+void polyDecompress(Poly& r, const uint8_t* a) {
+  for (size_t i = 0; i < kN / 2; i++) {
+    r[2 * i] = decompress<4>(a[i] & 0xf);
+    r[2 * i + 1] = decompress<4>(a[i] >> 4);
+  }
+}
+
+// Compressed to 10 bits per coefficient.
+void polyVecCompress(uint8_t* r, const PolyVec& a) {
+  for (const auto& poly : a) {
+    for (size_t i = 0; i < kN / 4; i++) {
+      uint16_t t[4];
+      for (size_t j = 0; j < 4; j++) {
+        t[j] = compress<10>(poly[4 * i + j]);
+      }
+      r[0] = t[0] & 0xff;
+      r[1] = ((t[0] >> 8) | (t[1] << 2)) & 0xff;
+      r[2] = ((t[1] >> 6) | (t[2] << 4)) & 0xff;
+      r[3] = ((t[2] >> 4) | (t[3] << 6)) & 0xff;
+      r[4] = t[3] >> 2;
+      r += 5;
+    }
+  }
+}
+
+void polyVecDecompress(PolyVec& r, const uint8_t* a) {
+  for (auto& poly : r) {
+    for (size_t i = 0; i < kN / 4; i++) {
+      uint16_t t[4];
+      t[0] = a[0] | (uint16_t(a[1]) << 8);
+      t[1] = (a[1] >> 2) | (uint16_t(a[2]) << 6);
+      t[2] = (a[2] >> 4) | (uint16_t(a[3]) << 4);
+      t[3] = (a[3] >> 6) | (uint16_t(a[4]) << 2);
+      for (size_t j = 0; j < 4; j++) {
+        poly[4 * i + j] = decompress<10>(t[j] & 0x3ff);
+      }
+      a += 5;
+    }
+  }
+}
+
+void polyFromMessage(Poly& r, const uint8_t* msg) {
+  for (size_t i = 0; i < kN / 8; i++) {
+    for (size_t j = 0; j < 8; j++) {
+      uint16_t mask = -uint16_t((msg[i] >> j) & 1);
+      r[8 * i + j] = mask & ((kQ + 1) / 2);
+    }
+  }
+}
+
+void polyToMessage(uint8_t* msg, const Poly& a) {
+  for (size_t i = 0; i < kN / 8; i++) {
+    msg[i] = 0;
+    for (size_t j = 0; j < 8; j++) {
+      msg[i] |= compress<1>(a[8 * i + j]) << j;
+    }
+  }
+}
+
+void indCpaGenerateKeyPair(uint8_t* pk, uint8_t* sk, const uint8_t* d) {
+  uint8_t seeds[2 * kSeedBytes];
+  hash512({folly::ByteRange(d, kSeedBytes)}, seeds);
+  const uint8_t* publicSeed = seeds;
+  const uint8_t* noiseSeed = seeds + kSeedBytes;
+
+  std::array<PolyVec, kK> a;
+  generateMatrix(a, publicSeed, false);
+  PolyVec s;
+  PolyVec e;
+  uint8_t nonce = 0;
+  for (auto& poly : s) {
+    sampleNoise(poly, noiseSeed, nonce++);
+  }
+  for (auto& poly : e) {
+    sampleNoise(poly, noiseSeed, nonce++);
+  }
+  for (size_t i = 0; i < kK; i++) {
+    ntt(s[i]);
+    ntt(e[i]);
+  }
+
+  PolyVec t;
+  for (size_t i = 0; i < kK; i++) {
+    innerProduct(t[i], a[i], s);
+    addTo(t[i], e[i]);
+  }
+
+  polyVecToBytes(sk, s);
+  polyVecToBytes(pk, t);
+  std::copy(publicSeed, publicSeed + kSeedBytes, pk + kPolyVecBytes);
+  OPENSSL_cleanse(seeds, sizeof(seeds));
+  OPENSSL_cleanse(s.data(), sizeof(s));
+}
+
+void indCpaEncrypt(
+    uint8_t* ct,
+    const uint8_t* msg,
+    const uint8_t* pk,
+    const uint8_t* coins) {
+  PolyVec t;
+  polyVecFromBytes(t, pk);
+  std::array<PolyVec, kK> at;
+  generateMatrix(at, pk + kPolyVecBytes, true);
+
+  PolyVec r;
+  PolyVec e1;
+  Poly e2;
+  uint8_t nonce = 0;
+  for (auto& poly : r) {
+    sampleNoise(poly, coins, nonce++);
+  }
+  for (auto& poly : e1) {
+    sampleNoise(poly, coins, nonce++);
+  }
+  sampleNoise(e2, coins, nonce++);
+  for (auto& poly : r) {
+    ntt(poly);
+  }
+
+  PolyVec u;
+  for (size_t i = 0; i < kK; i++) {
+    innerProduct(u[i], at[i], r);
+    invNtt(u[i]);
+    addTo(u[i], e1[i]);
+  }
+  Poly v;
+  innerProduct(v, t, r);
+  invNtt(v);
+  addTo(v, e2);
+  Poly m;
+  polyFromMessage(m, msg);
+  addTo(v, m);
+
+  polyVecCompress(ct, u);
+  polyCompress(ct + kPolyVecCompressedBytes, v);
+}
+
+void indCpaDecrypt(uint8_t* msg, const uint8_t* ct, const uint8_t* sk) {
+  PolyVec u;
+  polyVecDecompress(u, ct);
+  Poly v;
+  polyDecompress(v, ct + kPolyVecCompressedBytes);
+  PolyVec s;
+  polyVecFromBytes(s, sk);
+
+  for (auto& poly : u) {
+    ntt(poly);
+  }
+  Poly w;
+  innerProduct(w, s, u);
+  invNtt(w);
+  for (size_t i = 0; i < kN; i++) {
+    w[i] = sub(v[i], w[i]);
+  }
+  polyToMessage(msg, w);
+  OPENSSL_cleanse(s.data(), sizeof(s));
+}
+
+void checkSize(folly::ByteRange range, size_t size) {
+  if (range.size() != size) {
+    throw std::invalid_argument("kyber768: invalid length");
+  }
+}
+} // namespace
+
+void generateKeyPair(
+    folly::MutableByteRange publicKey,
+    folly::MutableByteRange secretKey,
+    folly::ByteRange d,
+    folly::ByteRange z) {
+  checkSize(publicKey, kPublicKeyBytes);
+  checkSize(secretKey, kSecretKeyBytes);
+  checkSize(d, kSeedBytes);
+  checkSize(z, kSeedBytes);
+
+  // sk = indcpa sk || pk || H(pk) || z
+  indCpaGenerateKeyPair(publicKey.data(), secretKey.data(), d.data());
+  auto sk = secretKey.data() + kIndCpaSecretKeyBytes;
+  std::copy(publicKey.begin(), publicKey.end(), sk);
+  sk += kPublicKeyBytes;
+  hash256({publicKey}, sk);
+  sk += kSeedBytes;
+  std::copy(z.begin(), z.end(), sk);
+}
+
+void encapsulate(
+    folly::MutableByteRange ciphertext,
+    folly::MutableByteRange sharedSecret,
+    folly::ByteRange publicKey,
+    folly::ByteRange m) {
+  checkSize(ciphertext, kCiphertextBytes);
+  checkSize(sharedSecret, kSharedSecretBytes);
+  checkSize(publicKey, kPublicKeyBytes);
+  checkSize(m, kSeedBytes);
+
+  // buf = H(m) || H(pk), kr = G(buf) = K || coins
+  uint8_t buf[2 * kSeedBytes];
+  uint8_t kr[2 * kSeedBytes];
+  hash256({m}, buf);
+  hash256({publicKey}, buf + kSeedBytes);
+  hash512({folly::range(buf)}, kr);
+
+  indCpaEncrypt(ciphertext.data(), buf, publicKey.data(), kr + kSeedBytes);
+
+  // ss = KDF(K || H(c))
+  hash256({ciphertext}, kr + kSeedBytes);
+  kdf(kr, sharedSecret.data());
+  OPENSSL_cleanse(buf, sizeof(buf));
+  OPENSSL_cleanse(kr, sizeof(kr));
+}
+
+void decapsulate(
+    folly::MutableByteRange sharedSecret,
+    folly::ByteRange ciphertext,
+    folly::ByteRange secretKey) {
+  checkSize(sharedSecret, kSharedSecretBytes);
+  checkSize(ciphertext, kCiphertextBytes);
+  checkSize(secretKey, kSecretKeyBytes);
+
+  auto pk = secretKey.data() + kIndCpaSecretKeyBytes;
+  auto hashedPk = pk + kPublicKeyBytes;
+  auto z = hashedPk + kSeedBytes;
+
+  uint8_t buf[2 * kSeedBytes];
+  uint8_t kr[2 * kSeedBytes];
+  indCpaDecrypt(buf, ciphertext.data(), secretKey.data());
+  std::copy(hashedPk, hashedPk + kSeedBytes, buf + kSeedBytes);
+  hash512({folly::range(buf)}, kr);
+
+  // Re-encrypt and, if the ciphertext doesn't match, derive the secret from
+  // z instead of K, without branching on the result.
+  std::array<uint8_t, kCiphertextBytes> cmp;
+  indCpaEncrypt(cmp.data(), buf, pk, kr + kSeedBytes);
+  uint8_t mask =
+      -uint8_t(CRYPTO_memcmp(cmp.data(), ciphertext.data(), cmp.size()) != 0);
+  for (size_t i = 0; i < kSeedBytes; i++) {
+    kr[i] ^= mask & (kr[i] ^ z[i]);
+  }
+
+  hash256({ciphertext}, kr + kSeedBytes);
+  kdf(kr, sharedSecret.data());
+  OPENSSL_cleanse(buf, sizeof(buf));
+  OPENSSL_cleanse(kr, sizeof(kr));
+}
+} // namespace kyber768
+} // namespace fizz
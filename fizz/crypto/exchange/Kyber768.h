@@ -0,0 +1,60 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+
+namespace fizz {
+namespace kyber768 {
+
+/**
+ * Kyber768 key encapsulation, as specified for round 3 of the NIST process
+ * (version 3.02), which is the post-quantum half of the
+ * X25519Kyber768Draft00 hybrid group.
+ *
+ * The randomness is passed in so that callers pick the source (and tests can
+ * be deterministic). All functions throw std::invalid_argument if a range
+ * has the wrong size.
+ */
+
+constexpr size_t kPublicKeyBytes = 1184;
+constexpr size_t kSecretKeyBytes = 2400;
+constexpr size_t kCiphertextBytes = 1088;
+constexpr size_t kSharedSecretBytes = 32;
+// Size of each of the random inputs below.
+constexpr size_t kSeedBytes = 32;
+
+/**
+ * Generates a key pair from the random seeds d and z.
+ */
+void generateKeyPair(
+    folly::MutableByteRange publicKey,
+    folly::MutableByteRange secretKey,
+    folly::ByteRange d,
+    folly::ByteRange z);
+
+/**
+ * Encapsulates a shared secret to publicKey using the random message m.
+ */
+void encapsulate(
+    folly::MutableByteRange ciphertext,
+    folly::MutableByteRange sharedSecret,
+    folly::ByteRange publicKey,
+    folly::ByteRange m);
+
+/**
+ * Decapsulates ciphertext with secretKey. An invalid ciphertext yields a
+ * pseudorandom shared secret (implicit rejection) rather than an error.
+ */
+void decapsulate(
+    folly::MutableByteRange sharedSecret,
+    folly::ByteRange ciphertext,
+    folly::ByteRange secretKey);
+} // namespace kyber768
+} // namespace fizz
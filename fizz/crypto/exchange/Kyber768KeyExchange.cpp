@@ -0,0 +1,98 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/exchange/Kyber768KeyExchange.h>
+
+#include <openssl/crypto.h>
+#include <sodium.h>
+
+using namespace folly;
+
+namespace fizz {
+
+namespace {
+std::unique_ptr<IOBuf> makeSecret() {
+  auto secret = IOBuf::create(kyber768::kSharedSecretBytes);
+  secret->append(kyber768::kSharedSecretBytes);
+  return secret;
+}
+} // namespace
+
+Kyber768ClientKeyExchange::~Kyber768ClientKeyExchange() {
+  if (secretKey_) {
+    OPENSSL_cleanse(secretKey_->data(), secretKey_->size());
+  }
+}
+
+void Kyber768ClientKeyExchange::generateKeyPair() {
+  std::array<uint8_t, kyber768::kSeedBytes> d;
+  std::array<uint8_t, kyber768::kSeedBytes> z;
+  randombytes_buf(d.data(), d.size());
+  randombytes_buf(z.data(), z.size());
+  auto publicKey = std::make_unique<PublicKey>();
+  auto secretKey = std::make_unique<SecretKey>();
+  kyber768::generateKeyPair(
+      range(*publicKey), range(*secretKey), range(d), range(z));
+  OPENSSL_cleanse(d.data(), d.size());
+  OPENSSL_cleanse(z.data(), z.size());
+  if (secretKey_) {
+    OPENSSL_cleanse(secretKey_->data(), secretKey_->size());
+  }
+  publicKey_ = std::move(publicKey);
+  secretKey_ = std::move(secretKey);
+}
+
+std::unique_ptr<IOBuf> Kyber768ClientKeyExchange::getKeyShare() const {
+  if (!publicKey_) {
+    throw std::runtime_error("Key not generated");
+  }
+  return IOBuf::copyBuffer(publicKey_->data(), publicKey_->size());
+}
+
+std::unique_ptr<IOBuf> Kyber768ClientKeyExchange::generateSharedSecret(
+    ByteRange keyShare) const {
+  if (!secretKey_) {
+    throw std::runtime_error("Key not generated");
+  }
+  if (keyShare.size() != kyber768::kCiphertextBytes) {
+    throw std::runtime_error("Invalid external public key");
+  }
+  auto secret = makeSecret();
+  kyber768::decapsulate(
+      MutableByteRange(secret->writableData(), secret->length()),
+      keyShare,
+      range(*secretKey_));
+  return secret;
+}
+
+std::unique_ptr<IOBuf> Kyber768ServerKeyExchange::getKeyShare() const {
+  if (!ciphertext_) {
+    throw std::runtime_error("Key not generated");
+  }
+  return IOBuf::copyBuffer(ciphertext_->data(), ciphertext_->size());
+}
+
+std::unique_ptr<IOBuf> Kyber768ServerKeyExchange::generateSharedSecret(
+    ByteRange keyShare) const {
+  if (keyShare.size() != kyber768::kPublicKeyBytes) {
+    throw std::runtime_error("Invalid external public key");
+  }
+  std::array<uint8_t, kyber768::kSeedBytes> m;
+  randombytes_buf(m.data(), m.size());
+  auto ciphertext = std::make_unique<Ciphertext>();
+  auto secret = makeSecret();
+  kyber768::encapsulate(
+      range(*ciphertext),
+      MutableByteRange(secret->writableData(), secret->length()),
+      keyShare,
+      range(m));
+  OPENSSL_cleanse(m.data(), m.size());
+  ciphertext_ = std::move(ciphertext);
+  return secret;
+}
+} // namespace fizz
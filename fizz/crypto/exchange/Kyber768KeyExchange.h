@@ -0,0 +1,63 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/exchange/KeyExchange.h>
+#include <fizz/crypto/exchange/Kyber768.h>
+
+#include <array>
+
+namespace fizz {
+
+/**
+ * The client side of Kyber768 as a KeyExchange: generateKeyPair() generates
+ * the decapsulation key, getKeyShare() returns the encapsulation key and
+ * generateSharedSecret() decapsulates the server's ciphertext.
+ */
+class Kyber768ClientKeyExchange : public KeyExchange {
+ public:
+  ~Kyber768ClientKeyExchange() override;
+
+  void generateKeyPair() override;
+
+  std::unique_ptr<folly::IOBuf> getKeyShare() const override;
+
+  std::unique_ptr<folly::IOBuf> generateSharedSecret(
+      folly::ByteRange keyShare) const override;
+
+ private:
+  using PublicKey = std::array<uint8_t, kyber768::kPublicKeyBytes>;
+  using SecretKey = std::array<uint8_t, kyber768::kSecretKeyBytes>;
+
+  std::unique_ptr<PublicKey> publicKey_;
+  std::unique_ptr<SecretKey> secretKey_;
+};
+
+/**
+ * The server side of Kyber768 as a KeyExchange. There is no key pair:
+ * generateKeyPair() does nothing, generateSharedSecret() encapsulates to the
+ * client's encapsulation key and getKeyShare() then returns the ciphertext.
+ */
+class Kyber768ServerKeyExchange : public KeyExchange {
+ public:
+  void generateKeyPair() override {}
+
+  std::unique_ptr<folly::IOBuf> getKeyShare() const override;
+
+  std::unique_ptr<folly::IOBuf> generateSharedSecret(
+      folly::ByteRange keyShare) const override;
+
+ private:
+  using Ciphertext = std::array<uint8_t, kyber768::kCiphertextBytes>;
+
+  // The server's share is an output of the encapsulation, so it is set by
+  // generateSharedSecret(), which the interface declares const.
+  mutable std::unique_ptr<Ciphertext> ciphertext_;
+};
+} // namespace fizz
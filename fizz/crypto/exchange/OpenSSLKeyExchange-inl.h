@@ -12,8 +12,10 @@ namespace detail {
 template <class T>
 class OpenSSLECKeyExchange {
  public:
+  explicit OpenSSLECKeyExchange(ENGINE* engine = nullptr) : engine_(engine) {}
+
   void generateKeyPair() {
-    key_ = generateECKeyPair(T::curveNid);
+    key_ = generateECKeyPair(T::curveNid, engine_);
   }
 
   void setPrivateKey(folly::ssl::EvpPkeyUniquePtr privateKey) {
@@ -30,11 +32,44 @@ class OpenSSLECKeyExchange {
     if (!key_) {
       throw std::runtime_error("Key not generated");
     }
-    return generateEvpSharedSecret(key_, peerKey);
+    return generateEvpSharedSecret(key_, peerKey, engine_);
+  }
+
+  /**
+   * Same as above, with the peer's encoded public key. Unless an engine is
+   * set, the point is used directly instead of being decoded into a key.
+   * Only uncompressed points (T::keyShareLength bytes) are accepted.
+   */
+  std::unique_ptr<folly::IOBuf> generateSharedSecret(
+      folly::ByteRange peerShare) const {
+    if (!key_) {
+      throw std::runtime_error("Key not generated");
+    }
+    if (peerShare.size() != T::keyShareLength) {
+      throw std::runtime_error("Invalid key share length");
+    }
+    if (engine_) {
+      return generateEvpSharedSecret(
+          key_, decodeECPublicKey(peerShare, T::curveNid), engine_);
+    }
+    return generateECDHSharedSecret(
+        key_, peerShare, getECGroup(T::curveNid));
+  }
+
+  /**
+   * Writes the encoded public key, T::keyShareLength bytes, into out.
+   * Returns the length written.
+   */
+  size_t getKeyShare(folly::MutableByteRange out) const {
+    if (!key_) {
+      throw std::runtime_error("Key not initialized");
+    }
+    return encodeECPublicKey(key_, out);
   }
 
  private:
   folly::ssl::EvpPkeyUniquePtr key_;
+  ENGINE* engine_;
 };
 
 template <class T>
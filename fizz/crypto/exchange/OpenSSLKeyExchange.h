@@ -20,10 +20,15 @@ namespace fizz {
  *
  * The template struct requires the following parameters:
  *   - curveNid: OpenSSL NID for the named curve
+ *
+ * If engine is set, key generation and derivation are done with it.
  */
 template <class T>
 class OpenSSLKeyExchange : public KeyExchange {
  public:
+  explicit OpenSSLKeyExchange(ENGINE* engine = nullptr)
+      : keyExchange_(engine) {}
+
   ~OpenSSLKeyExchange() override = default;
 
   void generateKeyPair() override {
@@ -31,17 +36,23 @@ class OpenSSLKeyExchange : public KeyExchange {
   }
 
   std::unique_ptr<folly::IOBuf> getKeyShare() const override {
-    const auto& key = keyExchange_.getKey();
-    if (!key) {
-      throw std::runtime_error("Key not initialized");
-    }
-    return detail::OpenSSLECKeyEncoder::encode(key);
+    auto buf = folly::IOBuf::create(T::keyShareLength);
+    buf->append(keyExchange_.getKeyShare(
+        folly::MutableByteRange(buf->writableData(), T::keyShareLength)));
+    return buf;
+  }
+
+  /**
+   * Writes the key share into out, which must be at least T::keyShareLength
+   * bytes. Returns the length written.
+   */
+  size_t getKeyShare(folly::MutableByteRange out) const {
+    return keyExchange_.getKeyShare(out);
   }
 
   std::unique_ptr<folly::IOBuf> generateSharedSecret(
       folly::ByteRange keyShare) const override {
-    auto key = detail::OpenSSLECKeyDecoder<T>::decode(keyShare);
-    return keyExchange_.generateSharedSecret(key);
+    return keyExchange_.generateSharedSecret(keyShare);
   }
 
  private:
@@ -20,8 +20,9 @@ namespace fizz {
 void X25519KeyExchange::generateKeyPair() {
   auto privKey = PrivKey();
   auto pubKey = PubKey();
-  auto err = crypto_box_curve25519xsalsa20poly1305_keypair(
-      pubKey.data(), privKey.data());
+  randombytes_buf(privKey.data(), privKey.size());
+  // Fixed base multiplication, which libsodium does with precomputed tables.
+  auto err = crypto_scalarmult_base(pubKey.data(), privKey.data());
   if (err != 0) {
     throw std::runtime_error(to<std::string>("Could not generate keys ", err));
   }
@@ -53,4 +54,18 @@ std::unique_ptr<folly::IOBuf> X25519KeyExchange::generateSharedSecret(
   }
   return key;
 }
+
+folly::SemiFuture<std::unique_ptr<folly::IOBuf>>
+X25519KeyExchange::generateSharedSecretAsync(folly::ByteRange keyShare) const {
+  if (!batcher_) {
+    return KeyExchange::generateSharedSecretAsync(keyShare);
+  }
+  if (!privKey_ || !pubKey_) {
+    throw std::runtime_error("Key not generated");
+  }
+  if (keyShare.size() != crypto_scalarmult_BYTES) {
+    throw std::runtime_error("Invalid external public key");
+  }
+  return batcher_->scalarMult(range(*privKey_), keyShare);
+}
 } // namespace fizz
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <fizz/crypto/exchange/KeyExchange.h>
+#include <fizz/crypto/exchange/X25519Batch.h>
 
 #include <folly/Optional.h>
 #include <folly/Range.h>
@@ -19,6 +20,9 @@ namespace fizz {
 
 /**
  * X25519 key exchange implementation using libsodium.
+ *
+ * If a batcher is set, generateSharedSecretAsync() queues the computation on
+ * it so that it runs together with those of other handshakes.
  */
 class X25519KeyExchange : public KeyExchange {
  public:
@@ -27,6 +31,16 @@ class X25519KeyExchange : public KeyExchange {
   std::unique_ptr<folly::IOBuf> getKeyShare() const override;
   std::unique_ptr<folly::IOBuf> generateSharedSecret(
       folly::ByteRange keyShare) const override;
+  folly::SemiFuture<std::unique_ptr<folly::IOBuf>> generateSharedSecretAsync(
+      folly::ByteRange keyShare) const override;
+
+  /**
+   * Sets the batcher used by generateSharedSecretAsync(). It must only be
+   * used from the thread running the batcher's EventBase.
+   */
+  void setBatcher(X25519Batcher* batcher) {
+    batcher_ = batcher;
+  }
 
  private:
   using PrivKey = std::array<uint8_t, crypto_scalarmult_SCALARBYTES>;
@@ -34,5 +48,6 @@ class X25519KeyExchange : public KeyExchange {
 
   folly::Optional<PrivKey> privKey_;
   folly::Optional<PubKey> pubKey_;
+  X25519Batcher* batcher_{nullptr};
 };
 } // namespace fizz
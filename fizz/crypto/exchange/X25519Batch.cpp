@@ -0,0 +1,528 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/exchange/X25519Batch.h>
+
+#include <folly/io/async/EventBaseLocal.h>
+#include <sodium.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FIZZ_HAVE_X25519_IFMA 1
+#else
+#define FIZZ_HAVE_X25519_IFMA 0
+#endif
+
+#if FIZZ_HAVE_X25519_IFMA
+#include <folly/CpuId.h>
+#include <immintrin.h>
+
+#define FIZZ_IFMA_TARGET __attribute__((target("avx512f,avx512ifma")))
+#endif
+
+namespace fizz {
+namespace detail {
+
+#if FIZZ_HAVE_X25519_IFMA
+namespace {
+
+/**
+ * Field elements mod 2^255 - 19 as 5 limbs of 51 bits. Each limb is a vector
+ * holding that limb of the 8 lanes, so every operation works on the 8 lanes
+ * at once. Limbs are kept below 2^52, which is as wide as the inputs of the
+ * 52 bit multiply-add instructions go.
+ *
+ * Loops over limbs are unrolled explicitly: left rolled (as -O2 does), the
+ * limbs are kept on the stack instead of in registers, which makes the ladder
+ * several times slower.
+ */
+struct Fe {
+  __m512i v[5];
+};
+
+constexpr int kLimbBits = 51;
+constexpr uint64_t kLimbMask = (1ULL << kLimbBits) - 1;
+
+FIZZ_IFMA_TARGET inline __m512i splat(uint64_t x) {
+  return _mm512_set1_epi64(x);
+}
+
+FIZZ_IFMA_TARGET inline __m512i times19(__m512i x) {
+  // x * 16 + x * 2 + x
+  return _mm512_add_epi64(
+      _mm512_add_epi64(_mm512_slli_epi64(x, 4), _mm512_slli_epi64(x, 1)), x);
+}
+
+/**
+ * Moves the bits above 51 of every limb into the next one, all limbs at once,
+ * folding the carry out of the top limb into the bottom one multiplied by 19
+ * (as 2^255 = 19 mod p). Leaves every limb below 2^51 plus a small excess as
+ * long as the inputs are below 2^60.
+ */
+FIZZ_IFMA_TARGET inline void carry(Fe& h) {
+  __m512i c[5];
+#pragma GCC unroll 10
+  for (int i = 0; i < 5; ++i) {
+    c[i] = _mm512_srli_epi64(h.v[i], kLimbBits);
+    h.v[i] = _mm512_and_si512(h.v[i], splat(kLimbMask));
+  }
+  h.v[0] = _mm512_add_epi64(h.v[0], times19(c[4]));
+#pragma GCC unroll 10
+  for (int i = 1; i < 5; ++i) {
+    h.v[i] = _mm512_add_epi64(h.v[i], c[i - 1]);
+  }
+}
+
+FIZZ_IFMA_TARGET inline void add(Fe& h, const Fe& f, const Fe& g) {
+#pragma GCC unroll 10
+  for (int i = 0; i < 5; ++i) {
+    h.v[i] = _mm512_add_epi64(f.v[i], g.v[i]);
+  }
+  carry(h);
+}
+
+/**
+ * h = f - g, computed as f + 2p - g so that no limb goes negative.
+ */
+FIZZ_IFMA_TARGET inline void sub(Fe& h, const Fe& f, const Fe& g) {
+#pragma GCC unroll 10
+  for (int i = 0; i < 5; ++i) {
+    uint64_t twoP = i == 0 ? 0xfffffffffffdaULL : 0xffffffffffffeULL;
+    h.v[i] =
+        _mm512_sub_epi64(_mm512_add_epi64(f.v[i], splat(twoP)), g.v[i]);
+  }
+  carry(h);
+}
+
+FIZZ_IFMA_TARGET inline void
+mulAdd(__m512i& lo, __m512i& hi, __m512i a, __m512i b) {
+  lo = _mm512_madd52lo_epu64(lo, a, b);
+  hi = _mm512_madd52hi_epu64(hi, a, b);
+}
+
+/**
+ * Turns the 10 limb product accumulated by mulAdd() into a field element. The
+ * multiply-add instructions split each 104 bit product at bit 52, one bit
+ * above the limb size, so hi[i] lands at limb i but counts double. Limbs past
+ * the top one wrap around multiplied by 19.
+ */
+FIZZ_IFMA_TARGET inline void reduce(Fe& h, __m512i* lo, __m512i* hi) {
+  __m512i t[10];
+#pragma GCC unroll 10
+  for (int i = 0; i < 10; ++i) {
+    t[i] = _mm512_add_epi64(lo[i], _mm512_slli_epi64(hi[i], 1));
+  }
+#pragma GCC unroll 10
+  for (int i = 0; i < 5; ++i) {
+    h.v[i] = _mm512_add_epi64(t[i], times19(t[i + 5]));
+  }
+  carry(h);
+}
+
+/**
+ * Schoolbook multiplication, written out so that the accumulators stay in
+ * registers without relying on the compiler to unroll loops.
+ */
+FIZZ_IFMA_TARGET inline void mul(Fe& h, const Fe& f, const Fe& g) {
+  __m512i lo[10];
+  __m512i hi[10];
+#pragma GCC unroll 10
+  for (int i = 0; i < 10; ++i) {
+    lo[i] = _mm512_setzero_si512();
+    hi[i] = _mm512_setzero_si512();
+  }
+  mulAdd(lo[0], hi[1], f.v[0], g.v[0]);
+  mulAdd(lo[1], hi[2], f.v[0], g.v[1]);
+  mulAdd(lo[2], hi[3], f.v[0], g.v[2]);
+  mulAdd(lo[3], hi[4], f.v[0], g.v[3]);
+  mulAdd(lo[4], hi[5], f.v[0], g.v[4]);
+  mulAdd(lo[1], hi[2], f.v[1], g.v[0]);
+  mulAdd(lo[2], hi[3], f.v[1], g.v[1]);
+  mulAdd(lo[3], hi[4], f.v[1], g.v[2]);
+  mulAdd(lo[4], hi[5], f.v[1], g.v[3]);
+  mulAdd(lo[5], hi[6], f.v[1], g.v[4]);
+  mulAdd(lo[2], hi[3], f.v[2], g.v[0]);
+  mulAdd(lo[3], hi[4], f.v[2], g.v[1]);
+  mulAdd(lo[4], hi[5], f.v[2], g.v[2]);
+  mulAdd(lo[5], hi[6], f.v[2], g.v[3]);
+  mulAdd(lo[6], hi[7], f.v[2], g.v[4]);
+  mulAdd(lo[3], hi[4], f.v[3], g.v[0]);
+  mulAdd(lo[4], hi[5], f.v[3], g.v[1]);
+  mulAdd(lo[5], hi[6], f.v[3], g.v[2]);
+  mulAdd(lo[6], hi[7], f.v[3], g.v[3]);
+  mulAdd(lo[7], hi[8], f.v[3], g.v[4]);
+  mulAdd(lo[4], hi[5], f.v[4], g.v[0]);
+  mulAdd(lo[5], hi[6], f.v[4], g.v[1]);
+  mulAdd(lo[6], hi[7], f.v[4], g.v[2]);
+  mulAdd(lo[7], hi[8], f.v[4], g.v[3]);
+  mulAdd(lo[8], hi[9], f.v[4], g.v[4]);
+  reduce(h, lo, hi);
+}
+
+/**
+ * Like mul(h, f, f), but computes each cross product once and doubles it.
+ */
+FIZZ_IFMA_TARGET inline void square(Fe& h, const Fe& f) {
+  __m512i lo[10];
+  __m512i hi[10];
+#pragma GCC unroll 10
+  for (int i = 0; i < 10; ++i) {
+    lo[i] = _mm512_setzero_si512();
+    hi[i] = _mm512_setzero_si512();
+  }
+  mulAdd(lo[1], hi[2], f.v[0], f.v[1]);
+  mulAdd(lo[2], hi[3], f.v[0], f.v[2]);
+  mulAdd(lo[3], hi[4], f.v[0], f.v[3]);
+  mulAdd(lo[4], hi[5], f.v[0], f.v[4]);
+  mulAdd(lo[3], hi[4], f.v[1], f.v[2]);
+  mulAdd(lo[4], hi[5], f.v[1], f.v[3]);
+  mulAdd(lo[5], hi[6], f.v[1], f.v[4]);
+  mulAdd(lo[5], hi[6], f.v[2], f.v[3]);
+  mulAdd(lo[6], hi[7], f.v[2], f.v[4]);
+  mulAdd(lo[7], hi[8], f.v[3], f.v[4]);
+#pragma GCC unroll 10
+  for (int i = 0; i < 10; ++i) {
+    lo[i] = _mm512_slli_epi64(lo[i], 1);
+    hi[i] = _mm512_slli_epi64(hi[i], 1);
+  }
+  mulAdd(lo[0], hi[1], f.v[0], f.v[0]);
+  mulAdd(lo[2], hi[3], f.v[1], f.v[1]);
+  mulAdd(lo[4], hi[5], f.v[2], f.v[2]);
+  mulAdd(lo[6], hi[7], f.v[3], f.v[3]);
+  mulAdd(lo[8], hi[9], f.v[4], f.v[4]);
+  reduce(h, lo, hi);
+}
+
+FIZZ_IFMA_TARGET inline void squareTimes(Fe& h, const Fe& f, int n) {
+  square(h, f);
+  for (int i = 1; i < n; ++i) {
+    square(h, h);
+  }
+}
+
+/**
+ * Swaps f and g in the lanes set in mask.
+ */
+FIZZ_IFMA_TARGET inline void cswap(Fe& f, Fe& g, __mmask8 mask) {
+#pragma GCC unroll 10
+  for (int i = 0; i < 5; ++i) {
+    auto newF = _mm512_mask_blend_epi64(mask, f.v[i], g.v[i]);
+    g.v[i] = _mm512_mask_blend_epi64(mask, g.v[i], f.v[i]);
+    f.v[i] = newF;
+  }
+}
+
+FIZZ_IFMA_TARGET inline void setSmall(Fe& h, uint64_t n) {
+  h.v[0] = splat(n);
+  for (int i = 1; i < 5; ++i) {
+    h.v[i] = _mm512_setzero_si512();
+  }
+}
+
+/**
+ * out = z^(p - 2) = 1 / z, with the addition chain from ref10.
+ */
+FIZZ_IFMA_TARGET void invert(Fe& out, const Fe& z) {
+  Fe t0, t1, t2, t3;
+  square(t0, z);
+  squareTimes(t1, t0, 2);
+  mul(t1, z, t1);
+  mul(t0, t0, t1);
+  square(t2, t0);
+  mul(t1, t1, t2);
+  squareTimes(t2, t1, 5);
+  mul(t1, t2, t1);
+  squareTimes(t2, t1, 10);
+  mul(t2, t2, t1);
+  squareTimes(t3, t2, 20);
+  mul(t2, t3, t2);
+  squareTimes(t2, t2, 10);
+  mul(t1, t2, t1);
+  squareTimes(t2, t1, 50);
+  mul(t2, t2, t1);
+  squareTimes(t3, t2, 100);
+  mul(t2, t3, t2);
+  squareTimes(t2, t2, 50);
+  mul(t1, t2, t1);
+  squareTimes(t1, t1, 5);
+  mul(out, t1, t0);
+}
+
+FIZZ_IFMA_TARGET void load(
+    Fe& h,
+    const std::array<folly::ByteRange, kX25519BatchLanes>& points) {
+  alignas(64) uint64_t limbs[5][kX25519BatchLanes];
+  for (size_t lane = 0; lane < kX25519BatchLanes; ++lane) {
+    // Padded so that every limb can be read with one 64 bit load.
+    uint8_t bytes[kX25519Bytes + 8] = {};
+    std::memcpy(bytes, points[lane].data(), kX25519Bytes);
+    bytes[kX25519Bytes - 1] &= 0x7f;
+    for (int i = 0; i < 5; ++i) {
+      int offset = i * kLimbBits;
+      uint64_t word;
+      std::memcpy(&word, bytes + offset / 8, sizeof(word));
+      limbs[i][lane] = (word >> (offset % 8)) & kLimbMask;
+    }
+  }
+  for (int i = 0; i < 5; ++i) {
+    h.v[i] = _mm512_load_si512(limbs[i]);
+  }
+}
+
+/**
+ * Fully reduces the value in one lane and encodes it little endian.
+ */
+void storeLane(folly::MutableByteRange out, uint64_t* h) {
+  for (int pass = 0; pass < 3; ++pass) {
+    for (int i = 0; i < 4; ++i) {
+      h[i + 1] += h[i] >> kLimbBits;
+      h[i] &= kLimbMask;
+    }
+    h[0] += 19 * (h[4] >> kLimbBits);
+    h[4] &= kLimbMask;
+  }
+  // The value is now below 2^255. Subtract p if it is at least p, that is if
+  // adding 19 carries out of bit 255.
+  uint64_t q = (h[0] + 19) >> kLimbBits;
+  for (int i = 1; i < 5; ++i) {
+    q = (h[i] + q) >> kLimbBits;
+  }
+  h[0] += 19 * q;
+  for (int i = 0; i < 4; ++i) {
+    h[i + 1] += h[i] >> kLimbBits;
+    h[i] &= kLimbMask;
+  }
+  h[4] &= kLimbMask;
+
+  uint64_t words[4] = {};
+  for (int i = 0; i < 5; ++i) {
+    int offset = i * kLimbBits;
+    int word = offset / 64;
+    int shift = offset % 64;
+    words[word] |= h[i] << shift;
+    if (shift + kLimbBits > 64) {
+      words[word + 1] |= h[i] >> (64 - shift);
+    }
+  }
+  for (size_t i = 0; i < kX25519Bytes; ++i) {
+    out.data()[i] = static_cast<uint8_t>(words[i / 8] >> (8 * (i % 8)));
+  }
+}
+
+FIZZ_IFMA_TARGET void store(
+    const std::array<folly::MutableByteRange, kX25519BatchLanes>& out,
+    const Fe& h) {
+  alignas(64) uint64_t limbs[5][kX25519BatchLanes];
+  for (int i = 0; i < 5; ++i) {
+    _mm512_store_si512(limbs[i], h.v[i]);
+  }
+  for (size_t lane = 0; lane < kX25519BatchLanes; ++lane) {
+    uint64_t laneLimbs[5];
+    for (int i = 0; i < 5; ++i) {
+      laneLimbs[i] = limbs[i][lane];
+    }
+    storeLane(out[lane], laneLimbs);
+  }
+}
+
+/**
+ * The Montgomery ladder from RFC 7748, section 5, run on 8 lanes with a
+ * conditional swap mask bit per lane.
+ */
+FIZZ_IFMA_TARGET void ladder(
+    const std::array<folly::MutableByteRange, kX25519BatchLanes>& out,
+    const std::array<folly::ByteRange, kX25519BatchLanes>& scalars,
+    const std::array<folly::ByteRange, kX25519BatchLanes>& points) {
+  uint8_t k[kX25519BatchLanes][kX25519Bytes];
+  for (size_t lane = 0; lane < kX25519BatchLanes; ++lane) {
+    std::memcpy(k[lane], scalars[lane].data(), kX25519Bytes);
+    k[lane][0] &= 248;
+    k[lane][31] &= 127;
+    k[lane][31] |= 64;
+  }
+
+  Fe x1, x2, z2, x3, z3, a24;
+  load(x1, points);
+  setSmall(x2, 1);
+  setSmall(z2, 0);
+  x3 = x1;
+  setSmall(z3, 1);
+  setSmall(a24, 121665);
+
+  Fe a, aa, b, bb, e, c, d, da, cb, t;
+  __mmask8 swap = 0;
+  for (int pos = 254; pos >= 0; --pos) {
+    __mmask8 kt = 0;
+    for (size_t lane = 0; lane < kX25519BatchLanes; ++lane) {
+      kt |= ((k[lane][pos / 8] >> (pos % 8)) & 1) << lane;
+    }
+    swap ^= kt;
+    cswap(x2, x3, swap);
+    cswap(z2, z3, swap);
+    swap = kt;
+
+    add(a, x2, z2);
+    square(aa, a);
+    sub(b, x2, z2);
+    square(bb, b);
+    sub(e, aa, bb);
+    add(c, x3, z3);
+    sub(d, x3, z3);
+    mul(da, d, a);
+    mul(cb, c, b);
+    add(t, da, cb);
+    square(x3, t);
+    sub(t, da, cb);
+    square(t, t);
+    mul(z3, x1, t);
+    mul(x2, aa, bb);
+    mul(t, e, a24);
+    add(t, aa, t);
+    mul(z2, e, t);
+  }
+  cswap(x2, x3, swap);
+  cswap(z2, z3, swap);
+
+  invert(z2, z2);
+  mul(x2, x2, z2);
+  store(out, x2);
+
+  sodium_memzero(k, sizeof(k));
+}
+} // namespace
+
+bool x25519BatchSupported() {
+  static const bool supported = [] {
+    folly::CpuId cpu;
+    return cpu.avx512f() && cpu.avx512ifma();
+  }();
+  return supported;
+}
+
+void x25519Batch(
+    const std::array<folly::MutableByteRange, kX25519BatchLanes>& out,
+    const std::array<folly::ByteRange, kX25519BatchLanes>& scalars,
+    const std::array<folly::ByteRange, kX25519BatchLanes>& points) {
+  if (!x25519BatchSupported()) {
+    throw std::runtime_error("batched x25519 not supported");
+  }
+  for (size_t lane = 0; lane < kX25519BatchLanes; ++lane) {
+    if (out[lane].size() != kX25519Bytes ||
+        scalars[lane].size() != kX25519Bytes ||
+        points[lane].size() != kX25519Bytes) {
+      throw std::invalid_argument("x25519 inputs must be 32 bytes");
+    }
+  }
+  ladder(out, scalars, points);
+}
+#else
+bool x25519BatchSupported() {
+  return false;
+}
+
+void x25519Batch(
+    const std::array<folly::MutableByteRange, kX25519BatchLanes>&,
+    const std::array<folly::ByteRange, kX25519BatchLanes>&,
+    const std::array<folly::ByteRange, kX25519BatchLanes>&) {
+  throw std::runtime_error("batched x25519 not supported");
+}
+#endif
+} // namespace detail
+
+X25519Batcher& X25519Batcher::get(folly::EventBase& evb) {
+  static folly::EventBaseLocal<X25519Batcher> batchers;
+  return batchers.getOrCreate(evb, &evb);
+}
+
+X25519Batcher::~X25519Batcher() {
+  flush();
+}
+
+folly::SemiFuture<std::unique_ptr<folly::IOBuf>> X25519Batcher::scalarMult(
+    folly::ByteRange scalar,
+    folly::ByteRange point) {
+  if (scalar.size() != detail::kX25519Bytes ||
+      point.size() != detail::kX25519Bytes) {
+    throw std::invalid_argument("x25519 inputs must be 32 bytes");
+  }
+  ops_.emplace_back();
+  auto& op = ops_.back();
+  std::memcpy(op.scalar.data(), scalar.data(), scalar.size());
+  std::memcpy(op.point.data(), point.data(), point.size());
+  auto future = op.promise.getSemiFuture();
+  if (ops_.size() == detail::kX25519BatchLanes) {
+    flush();
+  } else if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this);
+  }
+  return future;
+}
+
+void X25519Batcher::flush() {
+  cancelLoopCallback();
+  // Fulfilling a promise may run callbacks that queue more operations, so
+  // take the queued ones first.
+  auto ops = std::move(ops_);
+  ops_.clear();
+  for (size_t i = 0; i < ops.size(); i += detail::kX25519BatchLanes) {
+    computeBatch(
+        ops.data() + i,
+        std::min(detail::kX25519BatchLanes, ops.size() - i));
+  }
+}
+
+void X25519Batcher::runLoopCallback() noexcept {
+  flush();
+}
+
+void X25519Batcher::computeBatch(Op* ops, size_t count) {
+  std::array<std::unique_ptr<folly::IOBuf>, detail::kX25519BatchLanes> results;
+  for (size_t i = 0; i < count; ++i) {
+    results[i] = folly::IOBuf::create(detail::kX25519Bytes);
+    results[i]->append(detail::kX25519Bytes);
+  }
+
+  if (count >= kMinBatch && detail::x25519BatchSupported()) {
+    // Unused lanes repeat the first operation.
+    std::array<uint8_t, detail::kX25519Bytes> scratch;
+    std::array<folly::MutableByteRange, detail::kX25519BatchLanes> out;
+    std::array<folly::ByteRange, detail::kX25519BatchLanes> scalars;
+    std::array<folly::ByteRange, detail::kX25519BatchLanes> points;
+    for (size_t i = 0; i < detail::kX25519BatchLanes; ++i) {
+      auto& op = ops[i < count ? i : 0];
+      out[i] = i < count
+          ? folly::MutableByteRange(
+                results[i]->writableData(), detail::kX25519Bytes)
+          : folly::range(scratch);
+      scalars[i] = folly::range(op.scalar);
+      points[i] = folly::range(op.point);
+    }
+    detail::x25519Batch(out, scalars, points);
+    sodium_memzero(scratch.data(), scratch.size());
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      // The zero output check is done below for both paths.
+      crypto_scalarmult(
+          results[i]->writableData(),
+          ops[i].scalar.data(),
+          ops[i].point.data());
+    }
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    sodium_memzero(ops[i].scalar.data(), ops[i].scalar.size());
+    if (sodium_is_zero(results[i]->data(), detail::kX25519Bytes)) {
+      ops[i].promise.setException(std::runtime_error("Invalid point"));
+    } else {
+      ops[i].promise.setValue(std::move(results[i]));
+    }
+  }
+}
+} // namespace fizz
@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/futures/Future.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+
+#include <array>
+#include <vector>
+
+namespace fizz {
+namespace detail {
+
+constexpr size_t kX25519BatchLanes = 8;
+constexpr size_t kX25519Bytes = 32;
+
+/**
+ * Returns true if the 8-way X25519 implementation was compiled in and the CPU
+ * supports AVX-512 IFMA (52 bit integer multiply-add).
+ */
+bool x25519BatchSupported();
+
+/**
+ * Computes out[i] = X25519(scalars[i], points[i]) as in RFC 7748 for the 8
+ * lanes at once. Every range must be 32 bytes. Scalars are clamped and the
+ * top bit of each point is ignored. Does not check for an all-zero output.
+ *
+ * Throws if x25519BatchSupported() is false.
+ */
+void x25519Batch(
+    const std::array<folly::MutableByteRange, kX25519BatchLanes>& out,
+    const std::array<folly::ByteRange, kX25519BatchLanes>& scalars,
+    const std::array<folly::ByteRange, kX25519BatchLanes>& points);
+} // namespace detail
+
+/**
+ * Collects the X25519 shared secret computations of the handshakes running on
+ * one EventBase and computes them 8 at a time with AVX-512 IFMA. A batch is
+ * computed as soon as it is full, or at the end of the current loop
+ * iteration, so an operation is never held back past the loop that queued it.
+ *
+ * Without AVX-512 IFMA, or when too few operations were queued for a batch to
+ * pay off, operations are computed one at a time with libsodium instead.
+ *
+ * Not thread safe; only use from the thread running the EventBase.
+ */
+class X25519Batcher : private folly::EventBase::LoopCallback {
+ public:
+  /**
+   * Returns the batcher for evb, creating it if needed. It is destroyed with
+   * the EventBase, after computing the operations still queued.
+   */
+  static X25519Batcher& get(folly::EventBase& evb);
+
+  explicit X25519Batcher(folly::EventBase* evb) : evb_(evb) {}
+
+  ~X25519Batcher() override;
+
+  X25519Batcher(const X25519Batcher&) = delete;
+  X25519Batcher& operator=(const X25519Batcher&) = delete;
+
+  /**
+   * Queues X25519(scalar, point). Both must be 32 bytes and are copied. The
+   * future fails if the result is all zeros, which means point has small
+   * order.
+   */
+  folly::SemiFuture<std::unique_ptr<folly::IOBuf>> scalarMult(
+      folly::ByteRange scalar,
+      folly::ByteRange point);
+
+  /**
+   * Computes all queued operations now.
+   */
+  void flush();
+
+  size_t pending() const {
+    return ops_.size();
+  }
+
+ private:
+  // A batch costs about as much as this many operations computed one at a
+  // time, so smaller ones are computed one at a time.
+  static constexpr size_t kMinBatch = 4;
+
+  struct Op {
+    std::array<uint8_t, detail::kX25519Bytes> scalar;
+    std::array<uint8_t, detail::kX25519Bytes> point;
+    folly::Promise<std::unique_ptr<folly::IOBuf>> promise;
+  };
+
+  void runLoopCallback() noexcept override;
+
+  void computeBatch(Op* ops, size_t count);
+
+  folly::EventBase* evb_;
+  std::vector<Op> ops_;
+};
+} // namespace fizz
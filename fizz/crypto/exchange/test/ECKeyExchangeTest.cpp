@@ -118,6 +118,70 @@ TYPED_TEST(Key, SharedSecret) {
   EXPECT_TRUE(shared);
 }
 
+TYPED_TEST(Key, SharedSecretFromShare) {
+  OpenSSLKeyExchange<TypeParam> kex;
+  OpenSSLKeyExchange<TypeParam> peer;
+  kex.generateKeyPair();
+  peer.generateKeyPair();
+  auto share = kex.getKeyShare();
+  auto peerShare = peer.getKeyShare();
+  EXPECT_EQ(share->length(), TypeParam::keyShareLength);
+
+  auto shared = kex.generateSharedSecret(peerShare->coalesce());
+  EXPECT_TRUE(IOBufEqualTo()(
+      shared, peer.generateSharedSecret(share->coalesce())));
+
+  // Same as decoding the share into a key first.
+  typename TestFixture::KeyExch evpKex;
+  evpKex.setPrivateKey(getPrivateKey(this->getKeyParams().privateKey));
+  auto evpShared = evpKex.generateSharedSecret(
+      detail::OpenSSLECKeyDecoder<TypeParam>::decode(peerShare->coalesce()));
+  EXPECT_TRUE(IOBufEqualTo()(
+      evpShared, evpKex.generateSharedSecret(peerShare->coalesce())));
+}
+
+TYPED_TEST(Key, SharedSecretFromInvalidShare) {
+  OpenSSLKeyExchange<TypeParam> kex;
+  kex.generateKeyPair();
+  std::string invalid = unhexlify(this->getKeyParams().invalidEncodedShare);
+  EXPECT_THROW(kex.generateSharedSecret(range(invalid)), std::runtime_error);
+  std::string tooSmall = unhexlify(this->getKeyParams().tooSmallEncodedShare);
+  EXPECT_THROW(kex.generateSharedSecret(range(tooSmall)), std::runtime_error);
+  // The point at infinity.
+  std::string infinity(1, '\0');
+  EXPECT_THROW(kex.generateSharedSecret(range(infinity)), std::runtime_error);
+}
+
+TYPED_TEST(Key, SharedSecretFromShareWrongLength) {
+  OpenSSLKeyExchange<TypeParam> kex;
+  OpenSSLKeyExchange<TypeParam> peer;
+  kex.generateKeyPair();
+  peer.generateKeyPair();
+  auto peerShare = peer.getKeyShare()->moveToFbString().toStdString();
+
+  std::string trailing = peerShare + '\0';
+  EXPECT_THROW(kex.generateSharedSecret(range(trailing)), std::runtime_error);
+  std::string truncated = peerShare.substr(0, peerShare.size() - 1);
+  EXPECT_THROW(kex.generateSharedSecret(range(truncated)), std::runtime_error);
+
+  // The same point in compressed form is on the curve but not allowed.
+  std::string compressed = peerShare.substr(0, (peerShare.size() + 1) / 2);
+  compressed[0] = (peerShare.back() & 1) ? 0x03 : 0x02;
+  EXPECT_THROW(kex.generateSharedSecret(range(compressed)), std::runtime_error);
+}
+
+TYPED_TEST(Key, KeyShareIntoRange) {
+  OpenSSLKeyExchange<TypeParam> kex;
+  kex.generateKeyPair();
+  std::array<uint8_t, TypeParam::keyShareLength> out;
+  EXPECT_EQ(kex.getKeyShare(range(out)), TypeParam::keyShareLength);
+  EXPECT_TRUE(
+      IOBufEqualTo()(kex.getKeyShare(), IOBuf::wrapBuffer(range(out))));
+
+  std::array<uint8_t, TypeParam::keyShareLength - 1> small;
+  EXPECT_THROW(kex.getKeyShare(range(small)), std::runtime_error);
+}
+
 TYPED_TEST(Key, ReadFromKey) {
   typename TestFixture::KeyExch kex;
   auto pkey = getPrivateKey(this->getKeyParams().privateKey);
@@ -0,0 +1,54 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/exchange/HybridKeyExchange.h>
+#include <fizz/crypto/exchange/X25519.h>
+#include <folly/Range.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+static std::unique_ptr<HybridKeyExchange> makeHybrid() {
+  return std::make_unique<HybridKeyExchange>(
+      std::make_unique<X25519KeyExchange>(),
+      crypto_scalarmult_BYTES,
+      std::make_unique<X25519KeyExchange>());
+}
+
+TEST(HybridKeyExchange, KeyExchange) {
+  auto client = makeHybrid();
+  auto server = makeHybrid();
+  client->generateKeyPair();
+  server->generateKeyPair();
+
+  auto clientShare = client->getKeyShare();
+  auto serverShare = server->getKeyShare();
+  EXPECT_EQ(clientShare->computeChainDataLength(), 2 * crypto_scalarmult_BYTES);
+
+  auto clientSecret = client->generateSharedSecret(serverShare->coalesce());
+  auto serverSecret = server->generateSharedSecret(clientShare->coalesce());
+  EXPECT_EQ(
+      clientSecret->computeChainDataLength(), 2 * crypto_scalarmult_BYTES);
+  EXPECT_TRUE(IOBufEqualTo()(clientSecret, serverSecret));
+}
+
+TEST(HybridKeyExchange, ShortKeyShare) {
+  auto kex = makeHybrid();
+  kex->generateKeyPair();
+  auto share = kex->getKeyShare();
+  EXPECT_THROW(
+      kex->generateSharedSecret(
+          share->coalesce().subpiece(0, crypto_scalarmult_BYTES)),
+      std::runtime_error);
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,218 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/Sha256.h>
+#include <fizz/crypto/exchange/Kyber768KeyExchange.h>
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/Factory.h>
+#include <folly/Range.h>
+#include <folly/String.h>
+
+#include <array>
+#include <cstring>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+using PublicKey = std::array<uint8_t, kyber768::kPublicKeyBytes>;
+using SecretKey = std::array<uint8_t, kyber768::kSecretKeyBytes>;
+using Ciphertext = std::array<uint8_t, kyber768::kCiphertextBytes>;
+using Secret = std::array<uint8_t, kyber768::kSharedSecretBytes>;
+using Seed = std::array<uint8_t, kyber768::kSeedBytes>;
+
+static Seed makeSeed(uint8_t value) {
+  Seed seed;
+  seed.fill(value);
+  return seed;
+}
+
+template <size_t N>
+static std::array<uint8_t, N> fromHex(StringPiece hex) {
+  auto buf = toIOBuf(hex);
+  std::array<uint8_t, N> out;
+  EXPECT_EQ(buf->length(), N);
+  memcpy(out.data(), buf->data(), N);
+  return out;
+}
+
+template <size_t N>
+static std::string sha256Hex(const std::array<uint8_t, N>& data) {
+  std::array<uint8_t, Sha256::HashLen> digest;
+  Sha256::hash(*IOBuf::wrapBuffer(range(data)), range(digest));
+  return hexlify(range(digest));
+}
+
+// Count 0 of PQCkemKAT_2400.rsp from the round 3 Kyber768 submission. d, z
+// and m are the outputs of the submission's AES-256 CTR DRBG seeded with the
+// listed seed, in the order the reference implementation draws them. The
+// keys and ciphertext are compared by their SHA-256.
+TEST(Kyber768, KnownAnswer) {
+  // seed = 061550234D158C5EC95595FE04EF7A25767F2E24CC2BC479D09D86DC9ABCFDE7
+  //        056A8C266F9EF97ED08541DBD2E1FFA1
+  auto d = fromHex<kyber768::kSeedBytes>(
+      "7c9935a0b07694aa0c6d10e4db6b1add2fd81a25ccb148032dcd739936737f2d");
+  auto z = fromHex<kyber768::kSeedBytes>(
+      "8626ed79d451140800e03b59b956f8210e556067407d13dc90fa9e8b872bfb8f");
+  auto m = fromHex<kyber768::kSeedBytes>(
+      "147c03f7a5bebba406c8fae1874d7f13c80efe79a3a9a874cc09fe76f6997615");
+
+  PublicKey pk;
+  SecretKey sk;
+  kyber768::generateKeyPair(range(pk), range(sk), range(d), range(z));
+  EXPECT_EQ(
+      sha256Hex(pk),
+      "de5713a43cd0a032f5bd42f9c88a9e77651ab2dfcc39c15bfb311828f59c7011");
+  EXPECT_EQ(
+      sha256Hex(sk),
+      "db9d8342dc72a6102c90d111dc34c210524f6cb73eee989848e38711f8a04031");
+
+  Ciphertext ct;
+  Secret encapsulated;
+  kyber768::encapsulate(range(ct), range(encapsulated), range(pk), range(m));
+  EXPECT_EQ(
+      sha256Hex(ct),
+      "ded7f7c48b92fc887f6a378e44b21cecdf909a606ef140c13e8716803edb5a6d");
+  EXPECT_EQ(
+      hexlify(range(encapsulated)),
+      "914cb67fe5c38e73bf74181c0ac50428dedf7750a98058f7d536708774535b29");
+
+  Secret decapsulated;
+  kyber768::decapsulate(range(decapsulated), range(ct), range(sk));
+  EXPECT_EQ(decapsulated, encapsulated);
+}
+
+TEST(Kyber768, EncapsulateDecapsulate) {
+  PublicKey pk;
+  SecretKey sk;
+  auto d = makeSeed(1);
+  auto z = makeSeed(2);
+  kyber768::generateKeyPair(range(pk), range(sk), range(d), range(z));
+
+  for (uint8_t i = 0; i < 16; i++) {
+    Ciphertext ct;
+    Secret encapsulated;
+    Secret decapsulated;
+    auto m = makeSeed(i);
+    kyber768::encapsulate(range(ct), range(encapsulated), range(pk), range(m));
+    kyber768::decapsulate(range(decapsulated), range(ct), range(sk));
+    EXPECT_EQ(encapsulated, decapsulated);
+  }
+}
+
+TEST(Kyber768, Deterministic) {
+  PublicKey pk1;
+  PublicKey pk2;
+  SecretKey sk1;
+  SecretKey sk2;
+  auto d = makeSeed(3);
+  auto z = makeSeed(4);
+  kyber768::generateKeyPair(range(pk1), range(sk1), range(d), range(z));
+  kyber768::generateKeyPair(range(pk2), range(sk2), range(d), range(z));
+  EXPECT_EQ(pk1, pk2);
+  EXPECT_EQ(sk1, sk2);
+}
+
+TEST(Kyber768, ImplicitRejection) {
+  PublicKey pk;
+  SecretKey sk;
+  auto d = makeSeed(5);
+  auto z = makeSeed(6);
+  kyber768::generateKeyPair(range(pk), range(sk), range(d), range(z));
+
+  Ciphertext ct;
+  Secret encapsulated;
+  auto m = makeSeed(7);
+  kyber768::encapsulate(range(ct), range(encapsulated), range(pk), range(m));
+  ct[0] ^= 1;
+  Secret rejected;
+  Secret rejectedAgain;
+  kyber768::decapsulate(range(rejected), range(ct), range(sk));
+  kyber768::decapsulate(range(rejectedAgain), range(ct), range(sk));
+  EXPECT_NE(encapsulated, rejected);
+  EXPECT_EQ(rejected, rejectedAgain);
+}
+
+TEST(Kyber768, InvalidLength) {
+  PublicKey pk;
+  SecretKey sk;
+  auto d = makeSeed(8);
+  auto z = makeSeed(9);
+  kyber768::generateKeyPair(range(pk), range(sk), range(d), range(z));
+  Ciphertext ct;
+  Secret secret;
+  EXPECT_THROW(
+      kyber768::decapsulate(range(secret), range(ct).subpiece(1), range(sk)),
+      std::invalid_argument);
+}
+
+TEST(Kyber768KeyExchange, KeyExchange) {
+  Kyber768ClientKeyExchange client;
+  Kyber768ServerKeyExchange server;
+  client.generateKeyPair();
+  server.generateKeyPair();
+
+  auto clientShare = client.getKeyShare();
+  EXPECT_EQ(clientShare->computeChainDataLength(), kyber768::kPublicKeyBytes);
+  auto serverSecret = server.generateSharedSecret(clientShare->coalesce());
+  auto serverShare = server.getKeyShare();
+  EXPECT_EQ(serverShare->computeChainDataLength(), kyber768::kCiphertextBytes);
+  auto clientSecret = client.generateSharedSecret(serverShare->coalesce());
+  EXPECT_TRUE(IOBufEqualTo()(clientSecret, serverSecret));
+}
+
+TEST(Kyber768KeyExchange, ServerHasNoShareBeforeEncapsulating) {
+  Kyber768ServerKeyExchange server;
+  server.generateKeyPair();
+  EXPECT_THROW(server.getKeyShare(), std::runtime_error);
+}
+
+TEST(Kyber768KeyExchange, InvalidShare) {
+  Kyber768ClientKeyExchange client;
+  client.generateKeyPair();
+  Kyber768ServerKeyExchange server;
+  server.generateKeyPair();
+
+  // Each side only accepts the other side's share.
+  auto clientShare = client.getKeyShare();
+  EXPECT_THROW(
+      client.generateSharedSecret(clientShare->coalesce()),
+      std::runtime_error);
+  Ciphertext ct{};
+  EXPECT_THROW(server.generateSharedSecret(range(ct)), std::runtime_error);
+}
+
+TEST(Kyber768KeyExchange, Hybrid) {
+  Factory factory;
+  auto client = factory.makeKeyExchange(
+      NamedGroup::x25519_kyber768_draft00, Factory::KeyExchangeMode::Client);
+  auto server = factory.makeKeyExchange(
+      NamedGroup::x25519_kyber768_draft00, Factory::KeyExchangeMode::Server);
+  client->generateKeyPair();
+  server->generateKeyPair();
+
+  auto clientShare = client->getKeyShare();
+  EXPECT_EQ(
+      clientShare->computeChainDataLength(),
+      crypto_scalarmult_BYTES + kyber768::kPublicKeyBytes);
+  auto serverSecret = server->generateSharedSecret(clientShare->coalesce());
+  auto serverShare = server->getKeyShare();
+  EXPECT_EQ(
+      serverShare->computeChainDataLength(),
+      crypto_scalarmult_BYTES + kyber768::kCiphertextBytes);
+  auto clientSecret = client->generateSharedSecret(serverShare->coalesce());
+  EXPECT_EQ(
+      clientSecret->computeChainDataLength(),
+      crypto_scalarmult_BYTES + kyber768::kSharedSecretBytes);
+  EXPECT_TRUE(IOBufEqualTo()(clientSecret, serverSecret));
+}
+} // namespace test
+} // namespace fizz
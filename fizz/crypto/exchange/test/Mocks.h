@@ -33,4 +33,12 @@ class MockKeyExchange : public KeyExchange {
   }
 };
 
+class MockAsyncKeyExchange : public MockKeyExchange {
+ public:
+  MOCK_CONST_METHOD1(
+      generateSharedSecretAsync,
+      folly::SemiFuture<std::unique_ptr<folly::IOBuf>>(
+          folly::ByteRange keyShare));
+};
+
 } // namespace fizz
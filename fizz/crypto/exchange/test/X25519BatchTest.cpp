@@ -0,0 +1,173 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/exchange/X25519.h>
+#include <fizz/crypto/exchange/X25519Batch.h>
+#include <folly/Optional.h>
+#include <folly/String.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+using Bytes = std::array<uint8_t, detail::kX25519Bytes>;
+
+static Bytes randomBytes() {
+  Bytes bytes;
+  randombytes_buf(bytes.data(), bytes.size());
+  return bytes;
+}
+
+static Bytes expectedResult(const Bytes& scalar, const Bytes& point) {
+  Bytes out;
+  crypto_scalarmult(out.data(), scalar.data(), point.data());
+  return out;
+}
+
+TEST(X25519BatchTest, TestRfcVector) {
+  if (!detail::x25519BatchSupported()) {
+    return;
+  }
+  // RFC 7748, section 5.2.
+  auto scalar = unhexlify(
+      "a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4");
+  auto point = unhexlify(
+      "e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c");
+  auto expected =
+      "c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552";
+  std::array<Bytes, detail::kX25519BatchLanes> results;
+  std::array<MutableByteRange, detail::kX25519BatchLanes> out;
+  std::array<ByteRange, detail::kX25519BatchLanes> scalars;
+  std::array<ByteRange, detail::kX25519BatchLanes> points;
+  for (size_t i = 0; i < detail::kX25519BatchLanes; ++i) {
+    out[i] = range(results[i]);
+    scalars[i] = StringPiece(scalar);
+    points[i] = StringPiece(point);
+  }
+  detail::x25519Batch(out, scalars, points);
+  for (const auto& result : results) {
+    EXPECT_EQ(hexlify(result), expected);
+  }
+}
+
+TEST(X25519BatchTest, TestMatchesLibsodium) {
+  if (!detail::x25519BatchSupported()) {
+    return;
+  }
+  for (int iteration = 0; iteration < 100; ++iteration) {
+    std::array<Bytes, detail::kX25519BatchLanes> scalarBytes;
+    std::array<Bytes, detail::kX25519BatchLanes> pointBytes;
+    std::array<Bytes, detail::kX25519BatchLanes> results;
+    std::array<MutableByteRange, detail::kX25519BatchLanes> out;
+    std::array<ByteRange, detail::kX25519BatchLanes> scalars;
+    std::array<ByteRange, detail::kX25519BatchLanes> points;
+    for (size_t i = 0; i < detail::kX25519BatchLanes; ++i) {
+      scalarBytes[i] = randomBytes();
+      pointBytes[i] = randomBytes();
+      pointBytes[i][31] &= 0x7f;
+      out[i] = range(results[i]);
+      scalars[i] = range(scalarBytes[i]);
+      points[i] = range(pointBytes[i]);
+    }
+    // A non-canonical point, at least p.
+    pointBytes[1].fill(0xff);
+    pointBytes[1][31] = 0x7f;
+    detail::x25519Batch(out, scalars, points);
+    for (size_t i = 0; i < detail::kX25519BatchLanes; ++i) {
+      EXPECT_EQ(results[i], expectedResult(scalarBytes[i], pointBytes[i]));
+    }
+  }
+}
+
+TEST(X25519BatchTest, TestFullBatchComputedImmediately) {
+  EventBase evb;
+  auto& batcher = X25519Batcher::get(evb);
+  std::vector<std::pair<Bytes, Bytes>> inputs;
+  std::vector<SemiFuture<std::unique_ptr<IOBuf>>> futures;
+  for (size_t i = 0; i < detail::kX25519BatchLanes; ++i) {
+    inputs.emplace_back(randomBytes(), randomBytes());
+    futures.push_back(batcher.scalarMult(
+        range(inputs.back().first), range(inputs.back().second)));
+  }
+  EXPECT_EQ(batcher.pending(), 0u);
+  for (size_t i = 0; i < futures.size(); ++i) {
+    ASSERT_TRUE(futures[i].isReady());
+    auto expected = expectedResult(inputs[i].first, inputs[i].second);
+    EXPECT_EQ(hexlify(futures[i].value()->coalesce()), hexlify(expected));
+  }
+}
+
+TEST(X25519BatchTest, TestPartialBatchComputedAtLoopEnd) {
+  EventBase evb;
+  auto& batcher = X25519Batcher::get(evb);
+  auto scalar = randomBytes();
+  auto point = randomBytes();
+  auto first = batcher.scalarMult(range(scalar), range(point));
+  auto second = batcher.scalarMult(range(scalar), range(point));
+  EXPECT_EQ(batcher.pending(), 2u);
+  EXPECT_FALSE(first.isReady());
+  evb.loopOnce();
+  EXPECT_EQ(batcher.pending(), 0u);
+  auto expected = hexlify(expectedResult(scalar, point));
+  EXPECT_EQ(hexlify(first.value()->coalesce()), expected);
+  EXPECT_EQ(hexlify(second.value()->coalesce()), expected);
+}
+
+TEST(X25519BatchTest, TestSmallOrderPoint) {
+  EventBase evb;
+  auto& batcher = X25519Batcher::get(evb);
+  auto scalar = randomBytes();
+  Bytes point{};
+  point[0] = 1;
+  std::vector<SemiFuture<std::unique_ptr<IOBuf>>> futures;
+  for (size_t i = 0; i < detail::kX25519BatchLanes; ++i) {
+    futures.push_back(batcher.scalarMult(range(scalar), range(point)));
+  }
+  for (auto& future : futures) {
+    ASSERT_TRUE(future.isReady());
+    EXPECT_THROW(std::move(future).get(), std::runtime_error);
+  }
+}
+
+TEST(X25519BatchTest, TestPendingComputedOnDestruction) {
+  auto scalar = randomBytes();
+  auto point = randomBytes();
+  Optional<SemiFuture<std::unique_ptr<IOBuf>>> future;
+  {
+    EventBase evb;
+    future = X25519Batcher::get(evb).scalarMult(range(scalar), range(point));
+  }
+  ASSERT_TRUE(future->isReady());
+  EXPECT_EQ(
+      hexlify(future->value()->coalesce()),
+      hexlify(expectedResult(scalar, point)));
+}
+
+TEST(X25519BatchTest, TestKeyExchangeWithBatcher) {
+  EventBase evb;
+  X25519KeyExchange server;
+  server.generateKeyPair();
+  server.setBatcher(&X25519Batcher::get(evb));
+  X25519KeyExchange client;
+  client.generateKeyPair();
+
+  auto future = server.generateSharedSecretAsync(
+      client.getKeyShare()->coalesce());
+  EXPECT_FALSE(future.isReady());
+  evb.loopOnce();
+  auto expected =
+      client.generateSharedSecret(server.getKeyShare()->coalesce());
+  EXPECT_EQ(
+      hexlify(std::move(future).get()->coalesce()),
+      hexlify(expected->coalesce()));
+}
+} // namespace test
+} // namespace fizz
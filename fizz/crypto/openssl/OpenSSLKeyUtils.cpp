@@ -8,6 +8,7 @@
 
 #include <fizz/crypto/openssl/OpenSSLKeyUtils.h>
 
+#include <openssl/ecdh.h>
 #include <openssl/err.h>
 
 namespace fizz {
@@ -33,8 +34,9 @@ void validateECKey(const folly::ssl::EvpPkeyUniquePtr& key, int curveNid) {
 
 std::unique_ptr<folly::IOBuf> generateEvpSharedSecret(
     const folly::ssl::EvpPkeyUniquePtr& key,
-    const folly::ssl::EvpPkeyUniquePtr& peerKey) {
-  folly::ssl::EvpPkeyCtxUniquePtr ctx(EVP_PKEY_CTX_new(key.get(), nullptr));
+    const folly::ssl::EvpPkeyUniquePtr& peerKey,
+    ENGINE* engine) {
+  folly::ssl::EvpPkeyCtxUniquePtr ctx(EVP_PKEY_CTX_new(key.get(), engine));
   if (EVP_PKEY_derive_init(ctx.get()) != 1) {
     throw std::runtime_error("Initializing derive context failed");
   }
@@ -55,7 +57,7 @@ std::unique_ptr<folly::IOBuf> generateEvpSharedSecret(
   return buf;
 }
 
-folly::ssl::EvpPkeyUniquePtr generateECKeyPair(int curveNid) {
+folly::ssl::EvpPkeyUniquePtr generateECKeyPair(int curveNid, ENGINE* engine) {
   folly::ssl::EcKeyUniquePtr ecParamKey(EC_KEY_new_by_curve_name(curveNid));
   folly::ssl::EvpPkeyUniquePtr params(EVP_PKEY_new());
   if (!ecParamKey || !params) {
@@ -64,7 +66,7 @@ folly::ssl::EvpPkeyUniquePtr generateECKeyPair(int curveNid) {
   if (EVP_PKEY_set1_EC_KEY(params.get(), ecParamKey.get()) != 1) {
     throw std::runtime_error("Error setting ec key for params");
   }
-  folly::ssl::EvpPkeyCtxUniquePtr kctx(EVP_PKEY_CTX_new(params.get(), nullptr));
+  folly::ssl::EvpPkeyCtxUniquePtr kctx(EVP_PKEY_CTX_new(params.get(), engine));
   if (!kctx) {
     throw std::runtime_error("Error creating kctx");
   }
@@ -144,6 +146,88 @@ std::unique_ptr<folly::IOBuf> encodeECPublicKey(
   return buf;
 }
 
+size_t encodeECPublicKey(
+    const folly::ssl::EvpPkeyUniquePtr& key,
+    folly::MutableByteRange out) {
+  folly::ssl::EcKeyUniquePtr ecKey(EVP_PKEY_get1_EC_KEY(key.get()));
+  if (!ecKey) {
+    throw std::runtime_error("Wrong key type");
+  }
+  auto len = EC_POINT_point2oct(
+      EC_KEY_get0_group(ecKey.get()),
+      EC_KEY_get0_public_key(ecKey.get()),
+      POINT_CONVERSION_UNCOMPRESSED,
+      out.data(),
+      out.size(),
+      nullptr);
+  if (len == 0) {
+    throw std::runtime_error("Failed to encode key");
+  }
+  return len;
+}
+
+namespace {
+struct ECGroups {
+  const EC_GROUP* p256{EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1)};
+  const EC_GROUP* p384{EC_GROUP_new_by_curve_name(NID_secp384r1)};
+  const EC_GROUP* p521{EC_GROUP_new_by_curve_name(NID_secp521r1)};
+};
+} // namespace
+
+const EC_GROUP* getECGroup(int curveNid) {
+  // Deliberately leaked, so that the groups can be used during shutdown.
+  static const auto groups = new ECGroups();
+  const EC_GROUP* group;
+  switch (curveNid) {
+    case NID_X9_62_prime256v1:
+      group = groups->p256;
+      break;
+    case NID_secp384r1:
+      group = groups->p384;
+      break;
+    case NID_secp521r1:
+      group = groups->p521;
+      break;
+    default:
+      throw std::runtime_error("Unsupported curve");
+  }
+  if (!group) {
+    throw std::runtime_error("Failed to create curve");
+  }
+  return group;
+}
+
+std::unique_ptr<folly::IOBuf> generateECDHSharedSecret(
+    const folly::ssl::EvpPkeyUniquePtr& key,
+    folly::ByteRange peerShare,
+    const EC_GROUP* group) {
+  folly::ssl::EcKeyUniquePtr ecKey(EVP_PKEY_get1_EC_KEY(key.get()));
+  if (!ecKey) {
+    throw std::runtime_error("Wrong key type");
+  }
+  folly::ssl::EcPointUniquePtr point(EC_POINT_new(group));
+  if (!point) {
+    throw std::runtime_error("Error initializing point");
+  }
+  if (EC_POINT_oct2point(
+          group, point.get(), peerShare.data(), peerShare.size(), nullptr) !=
+      1) {
+    throw std::runtime_error("Error decoding peer key");
+  }
+  if (EC_POINT_is_on_curve(group, point.get(), nullptr) != 1) {
+    throw std::runtime_error("Peer key is not on curve");
+  }
+  size_t secretLen = (EC_GROUP_get_degree(group) + 7) / 8;
+  auto buf = folly::IOBuf::create(secretLen);
+  auto len = ECDH_compute_key(
+      buf->writableData(), secretLen, point.get(), ecKey.get(), nullptr);
+  if (len <= 0) {
+    throw std::runtime_error("Error deriving key");
+  }
+  buf->append(len);
+  return buf;
+}
+
 std::string getOpenSSLError() {
   auto err = ERR_get_error();
   if (err == 0) {
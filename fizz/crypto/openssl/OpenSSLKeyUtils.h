@@ -22,10 +22,12 @@ namespace detail {
 void validateECKey(const folly::ssl::EvpPkeyUniquePtr& key, int curveNid);
 
 /**
- * Generates an new EVP_PKEY on the curve.
+ * Generates an new EVP_PKEY on the curve, using engine if set.
  * Throws an exception on error.
  */
-folly::ssl::EvpPkeyUniquePtr generateECKeyPair(int curveNid);
+folly::ssl::EvpPkeyUniquePtr generateECKeyPair(
+    int curveNid,
+    ENGINE* engine = nullptr);
 
 /**
  * Decodes a EC public key specified as a member of the curve
@@ -45,13 +47,38 @@ std::unique_ptr<folly::IOBuf> encodeECPublicKey(
 std::unique_ptr<folly::IOBuf> encodeECPublicKey(
     const folly::ssl::EcKeyUniquePtr& ecKey);
 
+/**
+ * Writes the uncompressed encoding of the public key into out, and returns
+ * the length written. Throws if out is too small.
+ */
+size_t encodeECPublicKey(
+    const folly::ssl::EvpPkeyUniquePtr& key,
+    folly::MutableByteRange out);
+
+/**
+ * Returns the group for curveNid. It is created once per curve and shared,
+ * and must not be modified or freed.
+ */
+const EC_GROUP* getECGroup(int curveNid);
+
+/**
+ * Generates the ECDH shared secret of the private key and the encoded public
+ * point peerShare on group. The peer point is decoded and validated directly,
+ * without creating key objects for it.
+ */
+std::unique_ptr<folly::IOBuf> generateECDHSharedSecret(
+    const folly::ssl::EvpPkeyUniquePtr& key,
+    folly::ByteRange peerShare,
+    const EC_GROUP* group);
+
 /**
  * Generates a shared secred from a private key, key and the
- * peerKey public key.
+ * peerKey public key, using engine if set.
  */
 std::unique_ptr<folly::IOBuf> generateEvpSharedSecret(
     const folly::ssl::EvpPkeyUniquePtr& key,
-    const folly::ssl::EvpPkeyUniquePtr& peerKey);
+    const folly::ssl::EvpPkeyUniquePtr& peerKey,
+    ENGINE* engine = nullptr);
 
 /**
  * Returns the current error in the thread queue as a string.
@@ -17,7 +17,8 @@ namespace detail {
 std::unique_ptr<folly::IOBuf> ecSign(
     folly::ByteRange data,
     const folly::ssl::EvpPkeyUniquePtr& pkey,
-    int hashNid);
+    int hashNid,
+    ENGINE* engine = nullptr);
 
 void ecVerify(
     folly::ByteRange data,
@@ -28,13 +29,35 @@ void ecVerify(
 std::unique_ptr<folly::IOBuf> rsaPssSign(
     folly::ByteRange data,
     const folly::ssl::EvpPkeyUniquePtr& pkey,
-    int hashNid);
+    int hashNid,
+    ENGINE* engine = nullptr);
+
+std::vector<std::unique_ptr<folly::IOBuf>> rsaPssSignBatch(
+    const std::vector<folly::ByteRange>& data,
+    const folly::ssl::EvpPkeyUniquePtr& pkey,
+    int hashNid,
+    ENGINE* engine = nullptr);
 
 void rsaPssVerify(
     folly::ByteRange data,
     folly::ByteRange signature,
     const folly::ssl::EvpPkeyUniquePtr& pkey,
     int hashNid);
+
+std::unique_ptr<folly::IOBuf> edSign(
+    folly::ByteRange data,
+    const folly::ssl::EvpPkeyUniquePtr& pkey,
+    ENGINE* engine = nullptr);
+
+void edVerify(
+    folly::ByteRange data,
+    folly::ByteRange signature,
+    const folly::ssl::EvpPkeyUniquePtr& pkey);
+
+/**
+ * Throws if key is not an ED25519 or ED448 key, as given by type.
+ */
+void validateEdKey(const folly::ssl::EvpPkeyUniquePtr& key, KeyType type);
 } // namespace detail
 
 template <SignatureScheme Scheme>
@@ -64,6 +87,19 @@ struct SigAlg<SignatureScheme::ecdsa_secp521r1_sha512> {
   static constexpr KeyType type = KeyType::P521;
 };
 
+// EdDSA hashes internally, there is no separate digest.
+template <>
+struct SigAlg<SignatureScheme::ed25519> {
+  static constexpr int HashNid = NID_undef;
+  static constexpr KeyType type = KeyType::ED25519;
+};
+
+template <>
+struct SigAlg<SignatureScheme::ed448> {
+  static constexpr int HashNid = NID_undef;
+  static constexpr KeyType type = KeyType::ED448;
+};
+
 template <KeyType Type>
 template <SignatureScheme Scheme>
 inline std::unique_ptr<folly::IOBuf> OpenSSLSignature<Type>::sign(
@@ -74,9 +110,40 @@ inline std::unique_ptr<folly::IOBuf> OpenSSLSignature<Type>::sign(
     case KeyType::P256:
     case KeyType::P384:
     case KeyType::P521:
-      return detail::ecSign(data, pkey_, SigAlg<Scheme>::HashNid);
+      return detail::ecSign(data, pkey_, SigAlg<Scheme>::HashNid, engine_);
     case KeyType::RSA:
-      return detail::rsaPssSign(data, pkey_, SigAlg<Scheme>::HashNid);
+      return detail::rsaPssSign(
+          data, pkey_, SigAlg<Scheme>::HashNid, engine_);
+    case KeyType::ED25519:
+    case KeyType::ED448:
+      return detail::edSign(data, pkey_, engine_);
+  }
+  folly::assume_unreachable();
+}
+
+template <KeyType Type>
+template <SignatureScheme Scheme>
+inline std::vector<std::unique_ptr<folly::IOBuf>>
+OpenSSLSignature<Type>::signBatch(
+    const std::vector<folly::ByteRange>& data) const {
+  static_assert(
+      SigAlg<Scheme>::type == Type, "Called with mismatched type and scheme");
+  switch (Type) {
+    case KeyType::P256:
+    case KeyType::P384:
+    case KeyType::P521:
+    case KeyType::ED25519:
+    case KeyType::ED448: {
+      std::vector<std::unique_ptr<folly::IOBuf>> signatures;
+      signatures.reserve(data.size());
+      for (const auto& toSign : data) {
+        signatures.push_back(sign<Scheme>(toSign));
+      }
+      return signatures;
+    }
+    case KeyType::RSA:
+      return detail::rsaPssSignBatch(
+          data, pkey_, SigAlg<Scheme>::HashNid, engine_);
   }
   folly::assume_unreachable();
 }
@@ -94,6 +161,9 @@ inline void OpenSSLSignature<Type>::verify(
     case KeyType::RSA:
       return detail::rsaPssVerify(
           data, signature, pkey_, SigAlg<Scheme>::HashNid);
+    case KeyType::ED25519:
+    case KeyType::ED448:
+      return detail::edVerify(data, signature, pkey_);
   }
   folly::assume_unreachable();
 }
@@ -127,4 +197,18 @@ inline void OpenSSLSignature<KeyType::RSA>::setKey(
   }
   pkey_ = std::move(pkey);
 }
+
+template <>
+inline void OpenSSLSignature<KeyType::ED25519>::setKey(
+    folly::ssl::EvpPkeyUniquePtr pkey) {
+  detail::validateEdKey(pkey, KeyType::ED25519);
+  pkey_ = std::move(pkey);
+}
+
+template <>
+inline void OpenSSLSignature<KeyType::ED448>::setKey(
+    folly::ssl::EvpPkeyUniquePtr pkey) {
+  detail::validateEdKey(pkey, KeyType::ED448);
+  pkey_ = std::move(pkey);
+}
 } // namespace fizz
@@ -30,7 +30,8 @@ static const EVP_MD* getHash(int hashNid) {
 std::unique_ptr<folly::IOBuf> ecSign(
     folly::ByteRange data,
     const folly::ssl::EvpPkeyUniquePtr& pkey,
-    int hashNid) {
+    int hashNid,
+    ENGINE* engine) {
   folly::ssl::EvpMdCtxUniquePtr mdCtx(EVP_MD_CTX_new());
   if (!mdCtx) {
     throw std::runtime_error(
@@ -39,17 +40,18 @@ std::unique_ptr<folly::IOBuf> ecSign(
 
   auto hash = getHash(hashNid);
 
-  if (EVP_SignInit(mdCtx.get(), hash) != 1) {
+  if (EVP_DigestSignInit(mdCtx.get(), nullptr, hash, engine, pkey.get()) !=
+      1) {
     throw std::runtime_error("Could not initialize signature");
   }
-  if (EVP_SignUpdate(mdCtx.get(), data.data(), data.size()) != 1) {
+  if (EVP_DigestSignUpdate(mdCtx.get(), data.data(), data.size()) != 1) {
     throw std::runtime_error(
         to<std::string>("Could not sign data ", getOpenSSLError()));
   }
-  auto out = folly::IOBuf::create(EVP_PKEY_size(pkey.get()));
-  unsigned int bytesWritten = 0;
-  if (EVP_SignFinal(
-          mdCtx.get(), out->writableData(), &bytesWritten, pkey.get()) != 1) {
+  size_t bytesWritten = EVP_PKEY_size(pkey.get());
+  auto out = folly::IOBuf::create(bytesWritten);
+  if (EVP_DigestSignFinal(mdCtx.get(), out->writableData(), &bytesWritten) !=
+      1) {
     throw std::runtime_error("Failed to sign");
   }
   out->append(bytesWritten);
@@ -85,7 +87,8 @@ void ecVerify(
 std::unique_ptr<folly::IOBuf> rsaPssSign(
     folly::ByteRange data,
     const folly::ssl::EvpPkeyUniquePtr& pkey,
-    int hashNid) {
+    int hashNid,
+    ENGINE* engine) {
   auto hash = getHash(hashNid);
   folly::ssl::EvpMdCtxUniquePtr mdCtx(EVP_MD_CTX_new());
   if (!mdCtx) {
@@ -94,7 +97,7 @@ std::unique_ptr<folly::IOBuf> rsaPssSign(
   }
 
   EVP_PKEY_CTX* ctx;
-  if (EVP_DigestSignInit(mdCtx.get(), &ctx, hash, nullptr, pkey.get()) != 1) {
+  if (EVP_DigestSignInit(mdCtx.get(), &ctx, hash, engine, pkey.get()) != 1) {
     throw std::runtime_error("Could not initialize signature");
   }
 
@@ -120,6 +123,58 @@ std::unique_ptr<folly::IOBuf> rsaPssSign(
   return out;
 }
 
+std::vector<std::unique_ptr<folly::IOBuf>> rsaPssSignBatch(
+    const std::vector<folly::ByteRange>& data,
+    const folly::ssl::EvpPkeyUniquePtr& pkey,
+    int hashNid,
+    ENGINE* engine) {
+  auto hash = getHash(hashNid);
+  folly::ssl::EvpMdCtxUniquePtr initCtx(EVP_MD_CTX_new());
+  folly::ssl::EvpMdCtxUniquePtr mdCtx(EVP_MD_CTX_new());
+  if (!initCtx || !mdCtx) {
+    throw std::runtime_error(
+        to<std::string>("Could not allocate EVP_MD_CTX", getOpenSSLError()));
+  }
+
+  // Set up the key and padding once, each signature then starts from a copy.
+  EVP_PKEY_CTX* ctx;
+  if (EVP_DigestSignInit(initCtx.get(), &ctx, hash, engine, pkey.get()) !=
+      1) {
+    throw std::runtime_error("Could not initialize signature");
+  }
+
+  if (EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PSS_PADDING) <= 0) {
+    throw std::runtime_error("Could not set pss padding");
+  }
+
+  if (EVP_PKEY_CTX_set_rsa_pss_saltlen(ctx, -1) <= 0) {
+    throw std::runtime_error("Could not set pss salt length");
+  }
+
+  std::vector<std::unique_ptr<folly::IOBuf>> signatures;
+  signatures.reserve(data.size());
+  for (const auto& toSign : data) {
+    if (EVP_MD_CTX_copy_ex(mdCtx.get(), initCtx.get()) != 1) {
+      throw std::runtime_error("Could not copy signature context");
+    }
+
+    if (EVP_DigestSignUpdate(mdCtx.get(), toSign.data(), toSign.size()) !=
+        1) {
+      throw std::runtime_error("Could not update signature");
+    }
+
+    size_t bytesWritten = EVP_PKEY_size(pkey.get());
+    auto out = folly::IOBuf::create(bytesWritten);
+    if (EVP_DigestSignFinal(
+            mdCtx.get(), out->writableData(), &bytesWritten) != 1) {
+      throw std::runtime_error("Failed to sign");
+    }
+    out->append(bytesWritten);
+    signatures.push_back(std::move(out));
+  }
+  return signatures;
+}
+
 void rsaPssVerify(
     folly::ByteRange data,
     folly::ByteRange signature,
@@ -154,5 +209,89 @@ void rsaPssVerify(
     throw std::runtime_error("Signature verification failed");
   }
 }
+
+std::unique_ptr<folly::IOBuf> edSign(
+    folly::ByteRange data,
+    const folly::ssl::EvpPkeyUniquePtr& pkey,
+    ENGINE* engine) {
+#if FIZZ_OPENSSL_HAS_ED25519
+  folly::ssl::EvpMdCtxUniquePtr mdCtx(EVP_MD_CTX_new());
+  if (!mdCtx) {
+    throw std::runtime_error(
+        to<std::string>("Could not allocate EVP_MD_CTX", getOpenSSLError()));
+  }
+
+  // EdDSA only supports one-shot signing, without a digest.
+  if (EVP_DigestSignInit(mdCtx.get(), nullptr, nullptr, engine, pkey.get()) !=
+      1) {
+    throw std::runtime_error("Could not initialize signature");
+  }
+
+  size_t bytesWritten = EVP_PKEY_size(pkey.get());
+  auto out = folly::IOBuf::create(bytesWritten);
+  if (EVP_DigestSign(
+          mdCtx.get(),
+          out->writableData(),
+          &bytesWritten,
+          data.data(),
+          data.size()) != 1) {
+    throw std::runtime_error(
+        to<std::string>("Failed to sign ", getOpenSSLError()));
+  }
+  out->append(bytesWritten);
+  return out;
+#else
+  (void)data;
+  (void)pkey;
+  (void)engine;
+  throw std::runtime_error("EdDSA requires OpenSSL 1.1.1");
+#endif
+}
+
+void edVerify(
+    folly::ByteRange data,
+    folly::ByteRange signature,
+    const folly::ssl::EvpPkeyUniquePtr& pkey) {
+#if FIZZ_OPENSSL_HAS_ED25519
+  folly::ssl::EvpMdCtxUniquePtr mdCtx(EVP_MD_CTX_new());
+  if (!mdCtx) {
+    throw std::runtime_error(
+        to<std::string>("Could not allocate EVP_MD_CTX", getOpenSSLError()));
+  }
+
+  if (EVP_DigestVerifyInit(
+          mdCtx.get(), nullptr, nullptr, nullptr, pkey.get()) != 1) {
+    throw std::runtime_error("Could not initialize verification");
+  }
+
+  if (EVP_DigestVerify(
+          mdCtx.get(),
+          signature.data(),
+          signature.size(),
+          data.data(),
+          data.size()) != 1) {
+    throw std::runtime_error("Signature verification failed");
+  }
+#else
+  (void)data;
+  (void)signature;
+  (void)pkey;
+  throw std::runtime_error("EdDSA requires OpenSSL 1.1.1");
+#endif
+}
+
+void validateEdKey(const folly::ssl::EvpPkeyUniquePtr& key, KeyType type) {
+#if FIZZ_OPENSSL_HAS_ED25519
+  auto id = type == KeyType::ED448 ? EVP_PKEY_ED448 : EVP_PKEY_ED25519;
+  if (!key || EVP_PKEY_id(key.get()) != id) {
+    throw std::runtime_error(
+        type == KeyType::ED448 ? "key not ed448" : "key not ed25519");
+  }
+#else
+  (void)key;
+  (void)type;
+  throw std::runtime_error("EdDSA requires OpenSSL 1.1.1");
+#endif
+}
 } // namespace detail
 } // namespace fizz
@@ -11,10 +11,21 @@
 #include <fizz/record/Types.h>
 #include <folly/Range.h>
 #include <folly/ssl/OpenSSLPtrTypes.h>
+#include <openssl/opensslv.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+#define FIZZ_OPENSSL_HAS_ED25519 1
+#else
+#define FIZZ_OPENSSL_HAS_ED25519 0
+#endif
 
 namespace fizz {
 
-enum class KeyType { RSA, P256, P384, P521 };
+/**
+ * ED25519 and ED448 keys require OpenSSL 1.1.1 (FIZZ_OPENSSL_HAS_ED25519).
+ * With older versions setting such a key throws.
+ */
+enum class KeyType { RSA, P256, P384, P521, ED25519, ED448 };
 
 /**
  * Signature implementation using OpenSSL.
@@ -24,6 +35,16 @@ class OpenSSLSignature {
  public:
   void setKey(folly::ssl::EvpPkeyUniquePtr pkey);
 
+  /**
+   * Sets the OpenSSL engine that signatures are computed with, for example
+   * to offload them to a hardware crypto device. nullptr (the default) uses
+   * OpenSSL's built in implementation. The engine is not owned and must
+   * outlive this object.
+   */
+  void setEngine(ENGINE* engine) {
+    engine_ = engine;
+  }
+
   /**
    * Returns a signature of data.
    *
@@ -34,6 +55,16 @@ class OpenSSLSignature {
   template <SignatureScheme Scheme>
   std::unique_ptr<folly::IOBuf> sign(folly::ByteRange data) const;
 
+  /**
+   * Returns a signature of each of data, in order. Cheaper than signing each
+   * separately for RSA, where the key and padding are only set up once.
+   *
+   * Same requirements as sign().
+   */
+  template <SignatureScheme Scheme>
+  std::vector<std::unique_ptr<folly::IOBuf>> signBatch(
+      const std::vector<folly::ByteRange>& data) const;
+
   /**
    * Verifies that signature is a valid signature over data. Throws if it's not.
    *
@@ -46,6 +77,7 @@ class OpenSSLSignature {
 
  private:
   folly::ssl::EvpPkeyUniquePtr pkey_;
+  ENGINE* engine_{nullptr};
 };
 } // namespace fizz
 
@@ -0,0 +1,105 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/signature/Signature.h>
+#include <folly/String.h>
+
+#if FIZZ_OPENSSL_HAS_ED25519
+
+using namespace folly;
+using namespace folly::ssl;
+
+namespace fizz {
+namespace testing {
+
+// Test vectors from RFC 8032.
+struct Params {
+  std::string msg;
+  std::string priv;
+  std::string sig;
+};
+
+static const Params kEd25519Params{
+    "72",
+    "4ccd089b28ff96da9db6c346ec114e0f5b8a319f35aba624da8cf6ed4fb8a6fb",
+    "92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da"
+    "085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00"};
+
+static const Params kEd448Params{
+    "03",
+    "c4eab05d357007c632f3dbb48489924d552b08fe0c353a0d4a1f00acda2c463a"
+    "fbea67c5e8d2877c5e3bc397a659949ef8021e954e0a12274e",
+    "26b8f91727bd62897af15e41eb43c377efb9c610d48f2335cb0bd0087810f435"
+    "2541b143c4b981b7e18f62de8ccdf633fc1bf037ab7cd779805e0dbcc0aae1cb"
+    "cee1afb2e027df36bc04dcecbf154336c19f0af7e0a6472905e799f1953d2a0f"
+    "f3348ab21aa4adafd1d234441cf807c03a00"};
+
+static EvpPkeyUniquePtr getKey(int type, const Params& params) {
+  auto priv = unhexlify(params.priv);
+  return EvpPkeyUniquePtr(EVP_PKEY_new_raw_private_key(
+      type, nullptr, (const uint8_t*)priv.data(), priv.size()));
+}
+
+template <KeyType Type, SignatureScheme Scheme>
+static void testKnownAnswer(int pkeyType, const Params& params) {
+  OpenSSLSignature<Type> ed;
+  ed.setKey(getKey(pkeyType, params));
+  auto msg = unhexlify(params.msg);
+  auto sig = ed.template sign<Scheme>(range(StringPiece(msg)));
+  EXPECT_EQ(hexlify(sig->coalesce()), params.sig);
+  ed.template verify<Scheme>(range(StringPiece(msg)), sig->coalesce());
+
+  sig->writableData()[10] ^= 0x01;
+  EXPECT_THROW(
+      ed.template verify<Scheme>(range(StringPiece(msg)), sig->coalesce()),
+      std::runtime_error);
+  sig->writableData()[10] ^= 0x01;
+  msg[0] ^= 0x01;
+  EXPECT_THROW(
+      ed.template verify<Scheme>(range(StringPiece(msg)), sig->coalesce()),
+      std::runtime_error);
+}
+
+TEST(EdSignatureTest, TestEd25519) {
+  testKnownAnswer<KeyType::ED25519, SignatureScheme::ed25519>(
+      EVP_PKEY_ED25519, kEd25519Params);
+}
+
+TEST(EdSignatureTest, TestEd448) {
+  testKnownAnswer<KeyType::ED448, SignatureScheme::ed448>(
+      EVP_PKEY_ED448, kEd448Params);
+}
+
+TEST(EdSignatureTest, TestSignBatch) {
+  OpenSSLSignature<KeyType::ED25519> ed;
+  ed.setKey(getKey(EVP_PKEY_ED25519, kEd25519Params));
+  auto msg = unhexlify(kEd25519Params.msg);
+  auto sigs = ed.signBatch<SignatureScheme::ed25519>(
+      {range(StringPiece(msg)), range(StringPiece(msg))});
+  EXPECT_EQ(sigs.size(), 2);
+  for (auto& sig : sigs) {
+    EXPECT_EQ(hexlify(sig->coalesce()), kEd25519Params.sig);
+  }
+}
+
+TEST(EdSignatureTest, TestWrongKeyType) {
+  OpenSSLSignature<KeyType::ED25519> ed25519;
+  EXPECT_THROW(
+      ed25519.setKey(getKey(EVP_PKEY_ED448, kEd448Params)),
+      std::runtime_error);
+  OpenSSLSignature<KeyType::ED448> ed448;
+  EXPECT_THROW(
+      ed448.setKey(getKey(EVP_PKEY_ED25519, kEd25519Params)),
+      std::runtime_error);
+}
+} // namespace testing
+} // namespace fizz
+
+#endif
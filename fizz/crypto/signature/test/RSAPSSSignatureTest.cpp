@@ -64,5 +64,21 @@ TEST_F(RSAPSSTest, TestVerifyFailure) {
       rsa.verify<SignatureScheme::rsa_pss_sha256>(msg, sig->coalesce()),
       std::runtime_error);
 }
+
+TEST_F(RSAPSSTest, TestSignBatch) {
+  OpenSSLSignature<KeyType::RSA> rsa;
+  rsa.setKey(generateKey());
+  static constexpr StringPiece msg1{"message"};
+  static constexpr StringPiece msg2{"somethingelse"};
+  auto sigs = rsa.signBatch<SignatureScheme::rsa_pss_sha256>(
+      {ByteRange(msg1), ByteRange(msg2), ByteRange(msg1)});
+  ASSERT_EQ(sigs.size(), 3);
+  rsa.verify<SignatureScheme::rsa_pss_sha256>(msg1, sigs[0]->coalesce());
+  rsa.verify<SignatureScheme::rsa_pss_sha256>(msg2, sigs[1]->coalesce());
+  rsa.verify<SignatureScheme::rsa_pss_sha256>(msg1, sigs[2]->coalesce());
+  EXPECT_THROW(
+      rsa.verify<SignatureScheme::rsa_pss_sha256>(msg2, sigs[0]->coalesce()),
+      std::runtime_error);
+}
 } // namespace test
 } // namespace fizz
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/BufferedRandom.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <set>
+
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+TEST(BufferedRandomTest, TestFillSizes) {
+  for (size_t size : {size_t(1),
+                      size_t(32),
+                      BufferedRandom::kBufferSize - 1,
+                      BufferedRandom::kBufferSize + 7,
+                      3 * BufferedRandom::kBufferSize}) {
+    std::vector<uint8_t> out(size);
+    BufferedRandom::fill(folly::range(out));
+    if (size >= 32) {
+      EXPECT_NE(
+          std::count(out.begin(), out.end(), 0), static_cast<ssize_t>(size));
+    }
+  }
+}
+
+TEST(BufferedRandomTest, TestDistinct) {
+  std::set<std::array<uint8_t, 32>> seen;
+  for (size_t i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(seen.insert(BufferedRandom::generateRandom<32>()).second);
+  }
+}
+
+TEST(BufferedRandomTest, TestForkedChildDiffers) {
+  // Make sure the parent has buffered output before forking.
+  BufferedRandom::generateRandomNum<uint32_t>();
+
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  auto pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    auto random = BufferedRandom::generateRandom<32>();
+    auto written = write(fds[1], random.data(), random.size());
+    _exit(written == static_cast<ssize_t>(random.size()) ? 0 : 1);
+  }
+  close(fds[1]);
+  auto parent = BufferedRandom::generateRandom<32>();
+  std::array<uint8_t, 32> child;
+  ASSERT_EQ(
+      read(fds[0], child.data(), child.size()),
+      static_cast<ssize_t>(child.size()));
+  close(fds[0]);
+  int status;
+  waitpid(pid, &status, 0);
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+  EXPECT_NE(parent, child);
+}
+} // namespace test
+} // namespace fizz
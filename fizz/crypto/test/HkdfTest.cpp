@@ -43,6 +43,38 @@ TEST_P(HkdfTest, TestHkdfSha256Expand) {
   EXPECT_FALSE(memcmp(actualOkm->data(), expectedOkm->data(), outputBytes));
 }
 
+TEST_P(HkdfTest, TestHkdfSha256ExpandIntoRange) {
+  auto ikm = toIOBuf(GetParam().ikm);
+  auto salt = toIOBuf(GetParam().salt);
+  auto info = toIOBuf(GetParam().info);
+  auto expectedOkm = toIOBuf(GetParam().okm);
+
+  std::array<uint8_t, Sha256::HashLen> prk;
+  HkdfImpl<Sha256>().extract(
+      salt->coalesce(), ikm->coalesce(), folly::range(prk));
+  std::vector<uint8_t> okm(GetParam().outputBytes);
+  HkdfImpl<Sha256>().expand(
+      folly::range(prk), info->coalesce(), folly::range(okm));
+  EXPECT_EQ(
+      StringPiece(folly::range(okm)), StringPiece(expectedOkm->coalesce()));
+}
+
+TEST_P(HkdfTest, TestHkdfSha256ExpandKeyedHmac) {
+  auto ikm = toIOBuf(GetParam().ikm);
+  auto salt = toIOBuf(GetParam().salt);
+  auto info = toIOBuf(GetParam().info);
+  auto expectedOkm = toIOBuf(GetParam().okm);
+
+  auto prk = HkdfImpl<Sha256>().extract(salt->coalesce(), ikm->coalesce());
+  Sha256::KeyedHmac keyed(folly::range(prk));
+  for (size_t i = 0; i < 2; ++i) {
+    std::vector<uint8_t> okm(GetParam().outputBytes);
+    HkdfImpl<Sha256>().expand(keyed, info->coalesce(), folly::range(okm));
+    EXPECT_EQ(
+        StringPiece(folly::range(okm)), StringPiece(expectedOkm->coalesce()));
+  }
+}
+
 // Test cases from https://tools.ietf.org/html/rfc5869
 INSTANTIATE_TEST_CASE_P(
     TestVectors,
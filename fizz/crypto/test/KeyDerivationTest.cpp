@@ -44,6 +44,49 @@ TEST_P(KeyDerivationTest, ExpandLabel) {
   EXPECT_EQ(GetParam().result, hexOut);
 }
 
+TEST_P(KeyDerivationTest, ExpandLabelIntoRange) {
+  auto prk = unhexlify(GetParam().secret);
+  auto hashValue = unhexlify(GetParam().hashValue);
+
+  auto deriver = KeyDerivationImpl<Sha256>();
+  std::vector<uint8_t> out(GetParam().result.size() / 2);
+  deriver.expandLabel(
+      ByteRange(StringPiece(prk)),
+      GetParam().label,
+      ByteRange(StringPiece(hashValue)),
+      range(out));
+  EXPECT_EQ(GetParam().result, hexlify(range(out)));
+}
+
+TEST_P(KeyDerivationTest, KeyedSecretExpandLabel) {
+  auto prk = unhexlify(GetParam().secret);
+  auto hashValue = unhexlify(GetParam().hashValue);
+
+  auto deriver = KeyDerivationImpl<Sha256>();
+  auto keyed = deriver.keySecret(ByteRange(StringPiece(prk)));
+  // The keyed state must be reusable, so expand with it twice.
+  for (size_t i = 0; i < 2; ++i) {
+    std::vector<uint8_t> out(GetParam().result.size() / 2);
+    keyed->expandLabel(
+        GetParam().label, ByteRange(StringPiece(hashValue)), range(out));
+    EXPECT_EQ(GetParam().result, hexlify(range(out)));
+  }
+}
+
+TEST_P(KeyDerivationTest, KeyedSecretRekey) {
+  auto prk = unhexlify(GetParam().secret);
+  auto hashValue = unhexlify(GetParam().hashValue);
+
+  auto deriver = KeyDerivationImpl<Sha256>();
+  std::vector<uint8_t> other(deriver.hashLength(), 1);
+  auto keyed = deriver.keySecret(range(other));
+  keyed->rekey(ByteRange(StringPiece(prk)));
+  std::vector<uint8_t> out(GetParam().result.size() / 2);
+  keyed->expandLabel(
+      GetParam().label, ByteRange(StringPiece(hashValue)), range(out));
+  EXPECT_EQ(GetParam().result, hexlify(range(out)));
+}
+
 TEST(KeyDerivation, DeriveSecret) {
   // dummy prk
   std::vector<uint8_t> secret(KeyDerivationImpl<Sha256>().hashLength());
@@ -52,6 +95,18 @@ TEST(KeyDerivation, DeriveSecret) {
   deriver.deriveSecret(range(secret), "hey", range(messageHash));
 }
 
+TEST(KeyDerivation, DeriveSecretIntoRange) {
+  std::vector<uint8_t> secret(KeyDerivationImpl<Sha256>().hashLength(), 1);
+  std::vector<uint8_t> messageHash(KeyDerivationImpl<Sha256>().hashLength());
+  auto deriver = KeyDerivationImpl<Sha256>();
+  auto expected =
+      deriver.deriveSecret(range(secret), "hey", range(messageHash));
+  InlineSecret out(deriver.hashLength());
+  deriver.deriveSecret(
+      range(secret), "hey", range(messageHash), out.writableRange());
+  EXPECT_EQ(StringPiece(range(expected)), StringPiece(out.range()));
+}
+
 TEST(KeyDerivation, Sha256BlankHash) {
   std::vector<uint8_t> computed(KeyDerivationImpl<Sha256>().hashLength());
   folly::IOBuf blankBuf;
@@ -61,6 +116,44 @@ TEST(KeyDerivation, Sha256BlankHash) {
       StringPiece(folly::range(computed)));
 }
 
+TEST(KeyDerivation, NoPskDerivedSecret) {
+  // The SHA-256 value is from https://tools.ietf.org/html/rfc8448
+  EXPECT_EQ(
+      hexlify(KeyDerivationImpl<Sha256>().noPskDerivedSecret()),
+      "6f2615a108c702c5678f54fc9dbab69716c076189c48250cebeac3576c3611ba");
+  EXPECT_EQ(
+      hexlify(KeyDerivationImpl<Sha384>().noPskDerivedSecret()),
+      "1591dac5cbbf0330a4a84de9c753330e92d01f0a88214b4464972fd668049e93"
+      "e52f2b16fad922fdc0584478428f282b");
+}
+
+TEST(KeyDerivation, DtlsLabelPrefix) {
+  std::vector<uint8_t> secret(KeyDerivationImpl<Sha256>().hashLength(), 1);
+  // HkdfLabel {length = 16, label = "dtls13" + "key", context = ""}.
+  auto info = unhexlify("0010" "09" "64746c733133" "6b6579" "00");
+  auto expected = HkdfImpl<Sha256>().expand(
+      range(secret), *IOBuf::copyBuffer(info), 16);
+
+  KeyDerivationImpl<Sha256> deriver(kDtls13LabelPrefix);
+  auto out = deriver.expandLabel(range(secret), "key", IOBuf::create(0), 16);
+  EXPECT_EQ(hexlify(expected->coalesce()), hexlify(out->coalesce()));
+
+  std::array<uint8_t, 16> intoRange;
+  deriver.expandLabel(range(secret), "key", ByteRange(), range(intoRange));
+  EXPECT_EQ(hexlify(expected->coalesce()), hexlify(intoRange));
+
+  deriver.keySecret(range(secret))
+      ->expandLabel("key", ByteRange(), range(intoRange));
+  EXPECT_EQ(hexlify(expected->coalesce()), hexlify(intoRange));
+
+  auto tlsOut = KeyDerivationImpl<Sha256>().expandLabel(
+      range(secret), "key", IOBuf::create(0), 16);
+  EXPECT_NE(hexlify(expected->coalesce()), hexlify(tlsOut->coalesce()));
+
+  // The cached value is only valid for the TLS 1.3 labels.
+  EXPECT_TRUE(deriver.noPskDerivedSecret().empty());
+}
+
 // These are taken by dumping mint's internal state
 INSTANTIATE_TEST_CASE_P(
     KeyDerivation,
@@ -0,0 +1,89 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/SecretArena.h>
+
+#include <cstring>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+static bool allZero(ByteRange range) {
+  for (auto b : range) {
+    if (b != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST(SecretArenaTest, TestAllocate) {
+  SecretArena arena;
+  auto a = arena.allocate(32);
+  auto b = arena.allocate(48);
+  EXPECT_EQ(a.size(), 32);
+  EXPECT_EQ(b.size(), 48);
+  EXPECT_TRUE(allZero(a));
+  EXPECT_TRUE(allZero(b));
+  EXPECT_TRUE(b.data() >= a.end() || a.data() >= b.end());
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(a.data()) % 16, 0);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(b.data()) % 16, 0);
+}
+
+TEST(SecretArenaTest, TestWipe) {
+  SecretArena arena;
+  auto a = arena.allocate(32);
+  memset(a.data(), 0xaa, a.size());
+  arena.wipe();
+  EXPECT_TRUE(allZero(a));
+  auto b = arena.allocate(32);
+  EXPECT_EQ(b.data(), a.data());
+  EXPECT_TRUE(allZero(b));
+}
+
+TEST(SecretArenaTest, TestReuseAcrossArenas) {
+  uint8_t* first;
+  {
+    SecretArena arena;
+    auto a = arena.allocate(32);
+    memset(a.data(), 0xaa, a.size());
+    first = a.data();
+  }
+  SecretArena arena;
+  auto b = arena.allocate(SecretArena::kMaxAllocation);
+  EXPECT_EQ(b.data(), first);
+  EXPECT_TRUE(allZero(b));
+}
+
+TEST(SecretArenaTest, TestTooLarge) {
+  SecretArena arena;
+  EXPECT_THROW(
+      arena.allocate(SecretArena::kMaxAllocation + 1), std::runtime_error);
+  EXPECT_NO_THROW(arena.allocate(SecretArena::kMaxAllocation));
+}
+
+TEST(SecretArenaTest, TestStats) {
+  auto before = SecretArena::getStats();
+  {
+    SecretArena arena;
+    arena.allocate(32);
+    arena.allocate(32);
+    auto stats = SecretArena::getStats();
+    EXPECT_EQ(stats.slotsInUse, before.slotsInUse + 2);
+    EXPECT_GE(stats.chunks, 1);
+    EXPECT_LE(stats.unlockedChunks, stats.chunks);
+  }
+  EXPECT_EQ(SecretArena::getStats().slotsInUse, before.slotsInUse);
+}
+} // namespace test
+} // namespace fizz
@@ -16,6 +16,7 @@ jclass clazz;
 jmethodID constructor;
 jmethodID getIdentityMethod;
 jmethodID verifyMethod;
+jstring sha256WithEcdsa;
 } // namespace
 
 void JavaCryptoPeerCert::onLoad(JNIEnv* env) {
@@ -25,6 +26,7 @@ void JavaCryptoPeerCert::onLoad(JNIEnv* env) {
       jni::getMethodID(env, clazz, "getIdentity", "()Ljava/lang/String;");
   verifyMethod =
       jni::getMethodID(env, clazz, "verify", "(Ljava/lang/String;[B[B)V");
+  sha256WithEcdsa = jni::createGlobalString(env, "SHA256withECDSA");
 }
 
 JavaCryptoPeerCert::JavaCryptoPeerCert(Buf certData) {
@@ -32,10 +34,21 @@ JavaCryptoPeerCert::JavaCryptoPeerCert(Buf certData) {
   auto env = jni::getEnv(&shouldDetach);
 
   auto byteArray = jni::createByteArray(env, std::move(certData));
-  jobject_ = env->NewObject(clazz, constructor, byteArray);
+  auto localObject = env->NewObject(clazz, constructor, byteArray);
   env->DeleteLocalRef(byteArray);
-
   jni::maybeThrowException(env, shouldDetach);
+
+  // Local references are only valid for the duration of the native call that
+  // created them, the cert outlives it.
+  jobject_ = env->NewGlobalRef(localObject);
+  env->DeleteLocalRef(localObject);
+  jni::releaseEnv(shouldDetach);
+}
+
+JavaCryptoPeerCert::~JavaCryptoPeerCert() {
+  bool shouldDetach;
+  auto env = jni::getEnv(&shouldDetach);
+  env->DeleteGlobalRef(jobject_);
   jni::releaseEnv(shouldDetach);
 }
 
@@ -61,25 +74,24 @@ void JavaCryptoPeerCert::verify(
   bool shouldDetach;
   auto env = jni::getEnv(&shouldDetach);
 
-  std::string algorithm;
+  jstring jAlgorithm;
   switch (scheme) {
     case SignatureScheme::ecdsa_secp256r1_sha256:
-      algorithm = "SHA256withECDSA";
+      jAlgorithm = sha256WithEcdsa;
       break;
     default:
+      jni::releaseEnv(shouldDetach);
       throw std::runtime_error("Unsupported signature scheme");
   }
-  auto jAlgorithm = env->NewStringUTF(algorithm.c_str());
   auto signData = CertUtils::prepareSignData(context, toBeSigned);
   auto jSignData = jni::createByteArray(env, std::move(signData));
   auto jSignature = jni::createByteArray(env, signature);
 
-  env->CallObjectMethod(
+  env->CallVoidMethod(
       jobject_, verifyMethod, jAlgorithm, jSignData, jSignature);
 
   env->DeleteLocalRef(jSignature);
   env->DeleteLocalRef(jSignData);
-  env->DeleteLocalRef(jAlgorithm);
 
   jni::maybeThrowException(env, shouldDetach);
   jni::releaseEnv(shouldDetach);
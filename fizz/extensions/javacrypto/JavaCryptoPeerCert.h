@@ -24,7 +24,7 @@ class JavaCryptoPeerCert : public PeerCert {
 
   explicit JavaCryptoPeerCert(Buf certData);
 
-  ~JavaCryptoPeerCert() override = default;
+  ~JavaCryptoPeerCert() override;
 
   // Returns the full Distinguished Name of the certificate
   std::string getIdentity() const override;
@@ -14,7 +14,20 @@ namespace jni {
 
 namespace {
 JavaVM* vm;
-}
+
+// Attaching a thread to the VM is expensive, so a native thread that calls
+// into Java is attached the first time and stays attached until it exits.
+struct ThreadAttachment {
+  bool attached{false};
+
+  ~ThreadAttachment() {
+    if (attached) {
+      vm->DetachCurrentThread();
+    }
+  }
+};
+thread_local ThreadAttachment threadAttachment;
+} // namespace
 
 void setVM(JavaVM* jvm) {
   vm = jvm;
@@ -31,7 +44,7 @@ JNIEnv* getEnv(bool* shouldDetach) {
     status = vm->AttachCurrentThread(
         reinterpret_cast<void**>(&env), nullptr /*args*/);
     CHECK_EQ(status, JNI_OK);
-    *shouldDetach = true;
+    threadAttachment.attached = true;
   }
 
   return env;
@@ -69,6 +82,15 @@ void maybeThrowException(JNIEnv* env, bool shouldDetach) {
   throw std::runtime_error("JNI exception");
 }
 
+jstring createGlobalString(JNIEnv* env, const std::string& str) {
+  auto localStr = env->NewStringUTF(str.c_str());
+  CHECK(localStr);
+  auto globalStr = reinterpret_cast<jstring>(env->NewGlobalRef(localStr));
+  env->DeleteLocalRef(localStr);
+  CHECK(globalStr);
+  return globalStr;
+}
+
 jbyteArray createByteArray(JNIEnv* env, folly::ByteRange byteRange) {
   auto byteArray = env->NewByteArray(byteRange.size());
   env->SetByteArrayRegion(
@@ -17,6 +17,8 @@ namespace jni {
 
 void setVM(JavaVM* vm);
 
+// Threads that are not attached to the VM are attached on first use and
+// detached when they exit, so shouldDetach is only set for compatibility.
 JNIEnv* getEnv(bool* shouldDetach);
 void releaseEnv(bool shouldDetach);
 
@@ -30,6 +32,9 @@ jmethodID getMethodID(
 
 void maybeThrowException(JNIEnv* env, bool shouldDetach);
 
+// Returns a global reference, for strings that are passed on every call.
+jstring createGlobalString(JNIEnv* env, const std::string& str);
+
 jbyteArray createByteArray(JNIEnv* env, folly::ByteRange byteRange);
 jbyteArray createByteArray(JNIEnv* env, Buf buf);
 
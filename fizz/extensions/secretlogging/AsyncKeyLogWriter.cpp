@@ -0,0 +1,169 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/extensions/secretlogging/AsyncKeyLogWriter.h>
+
+#include <folly/Random.h>
+#include <folly/String.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace fizz {
+
+AsyncKeyLogWriter::AsyncKeyLogWriter(Options options)
+    : options_(std::move(options)) {
+  file_ = fopen(options_.path.c_str(), "a");
+  if (!file_) {
+    throw std::runtime_error(
+        folly::to<std::string>("unable to open key log ", options_.path));
+  }
+  // ProducerConsumerQueue keeps one slot empty.
+  options_.ringSize = std::max<size_t>(options_.ringSize, 1) + 1;
+  thread_ = std::thread([this]() { run(); });
+}
+
+AsyncKeyLogWriter::~AsyncKeyLogWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+  fclose(file_);
+}
+
+bool AsyncKeyLogWriter::sample() const {
+  if (options_.sampleRate >= 1.0) {
+    return true;
+  }
+  return folly::Random::randDouble01() < options_.sampleRate;
+}
+
+void AsyncKeyLogWriter::write(
+    const Random& clientRandom,
+    Label label,
+    folly::ByteRange secret) {
+  if (secret.size() > kMaxHashLength) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Record record;
+  record.label = label;
+  record.secretLength = static_cast<uint8_t>(secret.size());
+  record.clientRandom = clientRandom;
+  memcpy(record.secret.data(), secret.data(), secret.size());
+  if (!localRing().write(record)) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void AsyncKeyLogWriter::write(
+    const Random& clientRandom,
+    const LoggingKeyScheduler& scheduler) {
+  auto log = [&](Label label, const std::vector<uint8_t>& secret) {
+    if (!secret.empty()) {
+      write(clientRandom, label, folly::range(secret));
+    }
+  };
+  log(Label::CLIENT_EARLY_TRAFFIC_SECRET,
+      scheduler.getClientEarlyTrafficSecret());
+  log(Label::CLIENT_HANDSHAKE_TRAFFIC_SECRET,
+      scheduler.getClientHandshakeTrafficSecret());
+  log(Label::SERVER_HANDSHAKE_TRAFFIC_SECRET,
+      scheduler.getServerHandshakeTrafficSecret());
+  log(Label::CLIENT_TRAFFIC_SECRET_0, scheduler.getClientTrafficSecret());
+  log(Label::SERVER_TRAFFIC_SECRET_0, scheduler.getServerTrafficSecret());
+}
+
+folly::StringPiece AsyncKeyLogWriter::labelName(Label label) {
+  switch (label) {
+    case Label::CLIENT_EARLY_TRAFFIC_SECRET:
+      return "CLIENT_EARLY_TRAFFIC_SECRET";
+    case Label::CLIENT_HANDSHAKE_TRAFFIC_SECRET:
+      return "CLIENT_HANDSHAKE_TRAFFIC_SECRET";
+    case Label::SERVER_HANDSHAKE_TRAFFIC_SECRET:
+      return "SERVER_HANDSHAKE_TRAFFIC_SECRET";
+    case Label::CLIENT_TRAFFIC_SECRET_0:
+      return "CLIENT_TRAFFIC_SECRET_0";
+    case Label::SERVER_TRAFFIC_SECRET_0:
+      return "SERVER_TRAFFIC_SECRET_0";
+  }
+  return "UNKNOWN";
+}
+
+void AsyncKeyLogWriter::formatLine(
+    std::string& out,
+    Label label,
+    const Random& clientRandom,
+    folly::ByteRange secret) {
+  auto labelStr = labelName(label);
+  out.append(labelStr.data(), labelStr.size());
+  out.push_back(' ');
+  out += folly::hexlify(folly::range(clientRandom));
+  out.push_back(' ');
+  out += folly::hexlify(secret);
+  out.push_back('\n');
+}
+
+AsyncKeyLogWriter::Ring& AsyncKeyLogWriter::localRing() {
+  auto& local = *localRings_;
+  if (!local.ring) {
+    // First write from this thread. The writer thread keeps its own
+    // reference so records left by exiting threads are still flushed.
+    local.ring = std::make_shared<Ring>(options_.ringSize);
+    rings_.wlock()->push_back(local.ring);
+  }
+  return *local.ring;
+}
+
+void AsyncKeyLogWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    cv_.wait_for(lock, options_.flushInterval, [this]() { return stop_; });
+    lock.unlock();
+    flush();
+    lock.lock();
+  }
+}
+
+void AsyncKeyLogWriter::flush() {
+  std::vector<std::shared_ptr<Ring>> rings;
+  {
+    auto locked = rings_.wlock();
+    // Forget the rings of threads that have exited once they are drained.
+    locked->erase(
+        std::remove_if(
+            locked->begin(),
+            locked->end(),
+            [](const std::shared_ptr<Ring>& ring) {
+              return ring.use_count() == 1 && ring->isEmpty();
+            }),
+        locked->end());
+    rings = *locked;
+  }
+
+  std::string out;
+  Record record;
+  for (auto& ring : rings) {
+    while (ring->read(record)) {
+      formatLine(
+          out,
+          record.label,
+          record.clientRandom,
+          folly::ByteRange(record.secret.data(), record.secretLength));
+    }
+  }
+  if (!out.empty()) {
+    if (fwrite(out.data(), 1, out.size(), file_) != out.size()) {
+      LOG(ERROR) << "failed to write key log " << options_.path;
+    }
+    fflush(file_);
+  }
+}
+} // namespace fizz
@@ -0,0 +1,129 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/KeyDerivation.h>
+#include <fizz/extensions/secretlogging/LoggingKeyScheduler.h>
+#include <fizz/record/Types.h>
+#include <folly/ProducerConsumerQueue.h>
+#include <folly/Synchronized.h>
+#include <folly/ThreadLocal.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+namespace fizz {
+
+/**
+ * Writes secrets in the NSS key log format, as understood by Wireshark and
+ * similar tools, without formatting or doing I/O on the thread that logs
+ * them.
+ *
+ * write() copies a fixed size record into a lock free ring buffer owned by
+ * the calling thread. A background thread drains the rings every
+ * flushInterval, formats the lines and appends them to the file in one
+ * write. If a ring is full the record is dropped and counted rather than
+ * blocking the handshake.
+ *
+ * sample() can be used when a connection starts to only log a fraction of
+ * connections.
+ */
+class AsyncKeyLogWriter {
+ public:
+  enum class Label : uint8_t {
+    CLIENT_EARLY_TRAFFIC_SECRET,
+    CLIENT_HANDSHAKE_TRAFFIC_SECRET,
+    SERVER_HANDSHAKE_TRAFFIC_SECRET,
+    CLIENT_TRAFFIC_SECRET_0,
+    SERVER_TRAFFIC_SECRET_0,
+  };
+
+  struct Options {
+    std::string path;
+    // Fraction of connections sample() selects, between 0 and 1.
+    double sampleRate{1.0};
+    // Records each thread can buffer between flushes.
+    size_t ringSize{1024};
+    std::chrono::milliseconds flushInterval{100};
+  };
+
+  explicit AsyncKeyLogWriter(Options options);
+
+  /**
+   * Flushes everything written before the call, then stops the background
+   * thread.
+   */
+  ~AsyncKeyLogWriter();
+
+  AsyncKeyLogWriter(const AsyncKeyLogWriter&) = delete;
+  AsyncKeyLogWriter& operator=(const AsyncKeyLogWriter&) = delete;
+
+  bool sample() const;
+
+  void write(
+      const Random& clientRandom,
+      Label label,
+      folly::ByteRange secret);
+
+  /**
+   * Writes every secret scheduler has derived so far.
+   */
+  void write(const Random& clientRandom, const LoggingKeyScheduler& scheduler);
+
+  /**
+   * Records dropped because a ring was full, or the secret too long.
+   */
+  uint64_t getDroppedRecords() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  static folly::StringPiece labelName(Label label);
+
+  /**
+   * Formats one line of the key log, including the newline.
+   */
+  static void formatLine(
+      std::string& out,
+      Label label,
+      const Random& clientRandom,
+      folly::ByteRange secret);
+
+ private:
+  struct Record {
+    Label label;
+    uint8_t secretLength;
+    Random clientRandom;
+    std::array<uint8_t, kMaxHashLength> secret;
+  };
+
+  using Ring = folly::ProducerConsumerQueue<Record>;
+  struct LocalRing {
+    std::shared_ptr<Ring> ring;
+  };
+
+  Ring& localRing();
+  void run();
+  void flush();
+
+  Options options_;
+  FILE* file_;
+  std::atomic<uint64_t> dropped_{0};
+  folly::ThreadLocal<LocalRing> localRings_;
+  folly::Synchronized<std::vector<std::shared_ptr<Ring>>> rings_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_{false};
+  std::thread thread_;
+};
+} // namespace fizz
@@ -0,0 +1,133 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/extensions/secretlogging/AsyncKeyLogWriter.h>
+
+#include <folly/FileUtil.h>
+#include <folly/experimental/TestUtil.h>
+
+#include <algorithm>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+class AsyncKeyLogWriterTest : public testing::Test {
+ protected:
+  AsyncKeyLogWriter::Options options() {
+    AsyncKeyLogWriter::Options options;
+    options.path = file_.path().string();
+    options.flushInterval = std::chrono::milliseconds(1);
+    return options;
+  }
+
+  std::string contents() {
+    std::string out;
+    readFile(file_.path().string().c_str(), out);
+    return out;
+  }
+
+  Random random_{{0x01, 0x02}};
+  std::vector<uint8_t> secret_{0xaa, 0xbb, 0xcc};
+  folly::test::TemporaryFile file_;
+};
+
+TEST_F(AsyncKeyLogWriterTest, TestFormatLine) {
+  std::string out;
+  AsyncKeyLogWriter::formatLine(
+      out,
+      AsyncKeyLogWriter::Label::CLIENT_HANDSHAKE_TRAFFIC_SECRET,
+      random_,
+      range(secret_));
+  EXPECT_EQ(
+      out,
+      "CLIENT_HANDSHAKE_TRAFFIC_SECRET "
+      "0102000000000000000000000000000000000000000000000000000000000000 "
+      "aabbcc\n");
+}
+
+TEST_F(AsyncKeyLogWriterTest, TestWriteFlushedOnDestruction) {
+  std::string expected;
+  {
+    AsyncKeyLogWriter writer(options());
+    for (auto label : {AsyncKeyLogWriter::Label::CLIENT_TRAFFIC_SECRET_0,
+                       AsyncKeyLogWriter::Label::SERVER_TRAFFIC_SECRET_0}) {
+      writer.write(random_, label, range(secret_));
+      AsyncKeyLogWriter::formatLine(expected, label, random_, range(secret_));
+    }
+  }
+  EXPECT_EQ(contents(), expected);
+}
+
+TEST_F(AsyncKeyLogWriterTest, TestWriteFromThreads) {
+  {
+    AsyncKeyLogWriter writer(options());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 4; ++i) {
+      threads.emplace_back([&]() {
+        for (size_t j = 0; j < 10; ++j) {
+          writer.write(
+              random_,
+              AsyncKeyLogWriter::Label::CLIENT_TRAFFIC_SECRET_0,
+              range(secret_));
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    EXPECT_EQ(writer.getDroppedRecords(), 0);
+  }
+  auto out = contents();
+  EXPECT_EQ(std::count(out.begin(), out.end(), '\n'), 40);
+}
+
+TEST_F(AsyncKeyLogWriterTest, TestRingFull) {
+  auto opts = options();
+  opts.ringSize = 2;
+  opts.flushInterval = std::chrono::hours(1);
+  {
+    AsyncKeyLogWriter writer(opts);
+    for (size_t i = 0; i < 3; ++i) {
+      writer.write(
+          random_,
+          AsyncKeyLogWriter::Label::CLIENT_TRAFFIC_SECRET_0,
+          range(secret_));
+    }
+    EXPECT_EQ(writer.getDroppedRecords(), 1);
+  }
+  auto out = contents();
+  EXPECT_EQ(std::count(out.begin(), out.end(), '\n'), 2);
+}
+
+TEST_F(AsyncKeyLogWriterTest, TestSecretTooLong) {
+  AsyncKeyLogWriter writer(options());
+  std::vector<uint8_t> secret(kMaxHashLength + 1);
+  writer.write(
+      random_,
+      AsyncKeyLogWriter::Label::CLIENT_TRAFFIC_SECRET_0,
+      range(secret));
+  EXPECT_EQ(writer.getDroppedRecords(), 1);
+}
+
+TEST_F(AsyncKeyLogWriterTest, TestSample) {
+  auto opts = options();
+  opts.sampleRate = 0;
+  AsyncKeyLogWriter never(opts);
+  opts.sampleRate = 1;
+  AsyncKeyLogWriter always(opts);
+  for (size_t i = 0; i < 10; ++i) {
+    EXPECT_FALSE(never.sample());
+    EXPECT_TRUE(always.sample());
+  }
+}
+} // namespace test
+} // namespace fizz
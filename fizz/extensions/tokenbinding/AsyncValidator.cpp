@@ -0,0 +1,124 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/extensions/tokenbinding/AsyncValidator.h>
+
+#include <fizz/extensions/tokenbinding/Utils.h>
+
+#include <algorithm>
+
+using namespace folly;
+
+namespace fizz {
+namespace extensions {
+
+AsyncValidator::AsyncValidator(
+    std::shared_ptr<folly::Executor> executor,
+    size_t maxBatchSize,
+    size_t maxCachedKeys)
+    : executor_(std::move(executor)),
+      maxBatchSize_(std::max<size_t>(maxBatchSize, 1)),
+      keys_(folly::in_place, std::max<size_t>(maxCachedKeys, 1)) {}
+
+Future<Optional<TokenBindingID>> AsyncValidator::validateTokenBinding(
+    TokenBinding tokenBinding,
+    Buf ekm,
+    const TokenBindingKeyParameters& negotiatedParameters) {
+  if (tokenBinding.tokenbindingid.key_parameters != negotiatedParameters) {
+    VLOG(2) << "sent parameters: "
+            << toString(tokenBinding.tokenbindingid.key_parameters)
+            << " don't match negotiated parameters: "
+            << toString(negotiatedParameters);
+    return makeFuture<Optional<TokenBindingID>>(folly::none);
+  }
+
+  VerifyRequest request;
+  request.tokenBinding = std::move(tokenBinding);
+  request.ekm = std::move(ekm);
+  request.negotiatedParameters = negotiatedParameters;
+  auto future = request.promise.getFuture();
+
+  bool schedule;
+  {
+    auto pending = pending_.wlock();
+    pending->requests.push_back(std::move(request));
+    schedule = !pending->scheduled;
+    pending->scheduled = true;
+  }
+  if (schedule) {
+    executor_->add([self = shared_from_this()]() { self->runBatch(); });
+  }
+  return future;
+}
+
+void AsyncValidator::runBatch() {
+  std::vector<VerifyRequest> batch;
+  bool more;
+  {
+    auto pending = pending_.wlock();
+    auto count = std::min(maxBatchSize_, pending->requests.size());
+    batch.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      batch.push_back(std::move(pending->requests.front()));
+      pending->requests.pop_front();
+    }
+    more = !pending->requests.empty();
+    pending->scheduled = more;
+  }
+  if (more) {
+    executor_->add([self = shared_from_this()]() { self->runBatch(); });
+  }
+  verifyRequests(batch);
+}
+
+void AsyncValidator::verifyRequests(std::vector<VerifyRequest>& batch) {
+  for (auto& request : batch) {
+    auto& id = request.tokenBinding.tokenbindingid;
+    try {
+      if (id.key_parameters != TokenBindingKeyParameters::ecdsap256) {
+        // rsa_pss and rsa_pkcs
+        throw std::runtime_error(folly::to<std::string>(
+            "key params not implemented: ", id.key_parameters));
+      }
+      auto key = getKey(id);
+      auto message = TokenBindingUtils::constructMessage(
+          request.tokenBinding.tokenbinding_type,
+          id.key_parameters,
+          request.ekm);
+      Validator::verifyEcdsa(
+          key.get(), request.tokenBinding.signature, message);
+      request.promise.setValue(std::move(id));
+    } catch (const std::exception& e) {
+      VLOG(1) << "Token Binding Verification Failed: " << e.what();
+      request.promise.setValue(folly::none);
+    }
+  }
+}
+
+std::shared_ptr<EC_KEY> AsyncValidator::getKey(const TokenBindingID& id) {
+  std::string cacheKey;
+  for (auto range : *id.key) {
+    cacheKey.append(reinterpret_cast<const char*>(range.data()), range.size());
+  }
+  {
+    auto keys = keys_.wlock();
+    auto it = keys->find(cacheKey);
+    if (it != keys->end()) {
+      return it->second;
+    }
+  }
+
+  // Decode outside the lock; if two batches race on a new key, both decode
+  // it and the second insert wins.
+  std::shared_ptr<EC_KEY> key(
+      Validator::constructEcKeyFromBuf(id.key).release(), EC_KEY_free);
+  keys_.wlock()->set(cacheKey, key);
+  return key;
+}
+} // namespace extensions
+} // namespace fizz
@@ -0,0 +1,89 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/extensions/tokenbinding/Validator.h>
+#include <folly/Executor.h>
+#include <folly/Synchronized.h>
+#include <folly/container/EvictingCacheMap.h>
+#include <folly/futures/Future.h>
+
+#include <deque>
+
+namespace fizz {
+namespace extensions {
+
+/*
+ * Validates Token Binding messages from any number of connections on an
+ * executor, so that the ECDSA verification is not done on the thread serving
+ * the request. A batch is started when a request is queued with no batch
+ * pending, and takes every request queued before it runs, up to maxBatchSize.
+ *
+ * Parsed keys are shared between connections in an LRU cache of up to
+ * maxCachedKeys entries, so a recurring TokenBindingID is only decoded once.
+ * verifyRequests() can be overridden to hand batches to a different
+ * verification backend.
+ *
+ * Thread safe. Must be owned by a shared_ptr so that pending batches can
+ * outlive the caller's reference.
+ */
+class AsyncValidator : public std::enable_shared_from_this<AsyncValidator> {
+ public:
+  struct VerifyRequest {
+    TokenBinding tokenBinding;
+    Buf ekm;
+    TokenBindingKeyParameters negotiatedParameters;
+    folly::Promise<folly::Optional<TokenBindingID>> promise;
+  };
+
+  AsyncValidator(
+      std::shared_ptr<folly::Executor> executor,
+      size_t maxBatchSize,
+      size_t maxCachedKeys);
+
+  virtual ~AsyncValidator() = default;
+
+  /*
+   * Same contract as Validator::validateTokenBinding: the future holds the
+   * TokenBindingID if the signature verifies, and folly::none otherwise.
+   */
+  folly::Future<folly::Optional<TokenBindingID>> validateTokenBinding(
+      TokenBinding tokenBinding,
+      Buf ekm,
+      const TokenBindingKeyParameters& negotiatedParameters);
+
+ protected:
+  /*
+   * Verifies a batch of requests, fulfilling each request's promise. Called
+   * on the executor. The promises may be fulfilled after this returns.
+   */
+  virtual void verifyRequests(std::vector<VerifyRequest>& batch);
+
+  /*
+   * Returns the parsed key of id, decoding and caching it if needed.
+   */
+  std::shared_ptr<EC_KEY> getKey(const TokenBindingID& id);
+
+ private:
+  void runBatch();
+
+  struct Pending {
+    std::deque<VerifyRequest> requests;
+    bool scheduled{false};
+  };
+
+  std::shared_ptr<folly::Executor> executor_;
+  size_t maxBatchSize_;
+  folly::Synchronized<Pending> pending_;
+  folly::Synchronized<
+      folly::EvictingCacheMap<std::string, std::shared_ptr<EC_KEY>>>
+      keys_;
+};
+} // namespace extensions
+} // namespace fizz
@@ -10,9 +10,9 @@
 
 #include <fizz/extensions/tokenbinding/TokenBindingConstructor.h>
 
-#include <fizz/crypto/Sha256.h>
 #include <fizz/crypto/openssl/OpenSSLKeyUtils.h>
 #include <fizz/extensions/tokenbinding/Utils.h>
+#include <folly/io/Cursor.h>
 
 using namespace folly;
 using namespace folly::io;
@@ -21,20 +21,24 @@ using namespace folly::ssl;
 namespace fizz {
 namespace extensions {
 
+namespace {
+// The signer precomputes tables on its key, so it works on a copy rather than
+// the EC_KEY it shares with the caller's EVP_PKEY.
+EcKeyUniquePtr copyEcKey(const EcKeyUniquePtr& ecKey) {
+  EcKeyUniquePtr copy(EC_KEY_dup(ecKey.get()));
+  if (!copy) {
+    throw std::runtime_error("Unable to copy EC Key");
+  }
+  return copy;
+}
+} // namespace
+
 TokenBinding TokenBindingConstructor::createTokenBinding(
     EVP_PKEY& keyPair,
     const Buf& ekm,
     TokenBindingKeyParameters negotiatedParameters,
     TokenBindingType type) {
-  if (negotiatedParameters != TokenBindingKeyParameters::ecdsap256) {
-    throw std::runtime_error(folly::to<std::string>(
-        "key params not implemented: ", negotiatedParameters));
-  }
-
-  EcKeyUniquePtr ecKey(EVP_PKEY_get1_EC_KEY(&keyPair));
-  if (!ecKey) {
-    throw std::runtime_error("Unable to retrieve EC Key");
-  }
+  auto ecKey = getEcKey(keyPair, negotiatedParameters);
 
   TokenBinding binding;
   binding.tokenbinding_type = type;
@@ -51,6 +55,21 @@ TokenBinding TokenBindingConstructor::createTokenBinding(
   return binding;
 }
 
+EcKeyUniquePtr TokenBindingConstructor::getEcKey(
+    EVP_PKEY& keyPair,
+    TokenBindingKeyParameters negotiatedParameters) {
+  if (negotiatedParameters != TokenBindingKeyParameters::ecdsap256) {
+    throw std::runtime_error(folly::to<std::string>(
+        "key params not implemented: ", negotiatedParameters));
+  }
+
+  EcKeyUniquePtr ecKey(EVP_PKEY_get1_EC_KEY(&keyPair));
+  if (!ecKey) {
+    throw std::runtime_error("Unable to retrieve EC Key");
+  }
+  return ecKey;
+}
+
 Buf TokenBindingConstructor::signWithEcKey(
     const EcKeyUniquePtr& key,
     const Buf& message) {
@@ -58,7 +77,12 @@ Buf TokenBindingConstructor::signWithEcKey(
   fizz::Sha256::hash(
       *message,
       folly::MutableByteRange(hashedMessage.data(), hashedMessage.size()));
+  return signHashWithEcKey(key, folly::range(hashedMessage));
+}
 
+Buf TokenBindingConstructor::signHashWithEcKey(
+    const EcKeyUniquePtr& key,
+    folly::ByteRange hashedMessage) {
   EcdsaSigUniquePtr ecSignature(
       ECDSA_do_sign(hashedMessage.data(), hashedMessage.size(), key.get()));
   if (!ecSignature.get()) {
@@ -113,5 +137,63 @@ Buf TokenBindingConstructor::encodeEcKey(const EcKeyUniquePtr& ecKey) {
   ecKeyBuf->writableData()[0] = TokenBindingUtils::kP256EcKeySize;
   return ecKeyBuf;
 }
+
+TokenBindingSigner::TokenBindingSigner(
+    EVP_PKEY& keyPair,
+    TokenBindingKeyParameters negotiatedParameters)
+    : negotiatedParameters_(negotiatedParameters),
+      ecKey_(copyEcKey(
+          TokenBindingConstructor::getEcKey(keyPair, negotiatedParameters))),
+      encodedKey_(TokenBindingConstructor::encodeEcKey(ecKey_)) {
+  // Only speeds up signing, so failing to precompute is not an error.
+  if (EC_KEY_precompute_mult(ecKey_.get(), nullptr) != 1) {
+    VLOG(4) << "Unable to precompute EC key tables";
+  }
+}
+
+TokenBinding TokenBindingSigner::createTokenBinding(
+    const Buf& ekm,
+    TokenBindingType type) {
+  TokenBinding binding;
+  binding.tokenbinding_type = type;
+  binding.extensions = folly::IOBuf::create(0);
+  binding.signature = TokenBindingConstructor::signHashWithEcKey(
+      ecKey_, folly::range(getHashedMessage(ekm, type)));
+
+  TokenBindingID id;
+  id.key_parameters = negotiatedParameters_;
+  id.key = encodedKey_->clone();
+  binding.tokenbindingid = std::move(id);
+  return binding;
+}
+
+const TokenBindingSigner::HashedMessage& TokenBindingSigner::getHashedMessage(
+    const Buf& ekm,
+    TokenBindingType type) {
+  auto index = static_cast<size_t>(type);
+  if (index >= hashedMessages_.size()) {
+    throw std::runtime_error("unknown token binding type");
+  }
+  if (!ekm_ || !folly::IOBufEqualTo()(*ekm_, *ekm)) {
+    // Copied rather than coalesced, since ekm belongs to the caller.
+    auto length = ekm->computeChainDataLength();
+    ekm_ = folly::IOBuf::create(length);
+    Cursor(ekm.get()).pull(ekm_->writableData(), length);
+    ekm_->append(length);
+    for (auto& hashedMessage : hashedMessages_) {
+      hashedMessage.clear();
+    }
+  }
+  auto& hashedMessage = hashedMessages_[index];
+  if (!hashedMessage) {
+    auto message = TokenBindingUtils::constructMessage(
+        type, negotiatedParameters_, ekm);
+    hashedMessage.emplace();
+    fizz::Sha256::hash(
+        *message,
+        folly::MutableByteRange(hashedMessage->data(), hashedMessage->size()));
+  }
+  return *hashedMessage;
+}
 } // namespace extensions
 } // namespace fizz
@@ -8,9 +8,12 @@
 
 #pragma once
 
+#include <fizz/crypto/Sha256.h>
 #include <fizz/extensions/tokenbinding/Types.h>
 #include <folly/ssl/OpenSSLPtrTypes.h>
 
+#include <array>
+
 namespace fizz {
 namespace extensions {
 
@@ -23,6 +26,12 @@ class TokenBindingConstructor {
       TokenBindingType type);
 
  private:
+  friend class TokenBindingSigner;
+
+  static folly::ssl::EcKeyUniquePtr getEcKey(
+      EVP_PKEY& keyPair,
+      TokenBindingKeyParameters negotiatedParameters);
+
   static Buf encodeEcKey(const folly::ssl::EcKeyUniquePtr& ecKey);
 
   static Buf encodeEcdsaSignature(
@@ -32,7 +41,43 @@ class TokenBindingConstructor {
       const folly::ssl::EcKeyUniquePtr& key,
       const Buf& message);
 
+  static Buf signHashWithEcKey(
+      const folly::ssl::EcKeyUniquePtr& key,
+      folly::ByteRange hashedMessage);
+
   static void addBignumToSignature(const Buf& signature, BIGNUM* bigNum);
 };
+
+/**
+ * Creates token bindings with one key, for clients that send a binding on
+ * every request. The EC key, its encoding and its precomputed tables are set
+ * up once, and the hashed message is kept for the last EKM used (EKMs are per
+ * connection), so a binding only costs a signature. Not thread safe.
+ */
+class TokenBindingSigner {
+ public:
+  TokenBindingSigner(
+      EVP_PKEY& keyPair,
+      TokenBindingKeyParameters negotiatedParameters);
+
+  /**
+   * Same as TokenBindingConstructor::createTokenBinding() with this signer's
+   * key and parameters.
+   */
+  TokenBinding createTokenBinding(const Buf& ekm, TokenBindingType type);
+
+ private:
+  using HashedMessage = std::array<uint8_t, Sha256::HashLen>;
+
+  const HashedMessage& getHashedMessage(const Buf& ekm, TokenBindingType type);
+
+  TokenBindingKeyParameters negotiatedParameters_;
+  folly::ssl::EcKeyUniquePtr ecKey_;
+  Buf encodedKey_;
+
+  Buf ekm_;
+  // Indexed by TokenBindingType.
+  std::array<folly::Optional<HashedMessage>, 2> hashedMessages_;
+};
 } // namespace extensions
 } // namespace fizz
@@ -11,6 +11,7 @@
 #include <fizz/crypto/Sha256.h>
 #include <fizz/crypto/openssl/OpenSSLKeyUtils.h>
 #include <fizz/extensions/tokenbinding/Utils.h>
+#include <folly/io/IOBuf.h>
 
 using namespace folly;
 using namespace folly::io;
@@ -55,20 +56,7 @@ void Validator::verify(
     const Buf& message) {
   if (keyParams == TokenBindingKeyParameters::ecdsap256) {
     auto pkey = constructEcKeyFromBuf(key);
-    auto ecdsa = constructECDSASig(signature);
-
-    std::array<uint8_t, fizz::Sha256::HashLen> hashedMessage;
-    fizz::Sha256::hash(
-        *message,
-        folly::MutableByteRange(hashedMessage.data(), hashedMessage.size()));
-    if (ECDSA_do_verify(
-            hashedMessage.data(),
-            hashedMessage.size(),
-            ecdsa.get(),
-            pkey.get()) != 1) {
-      throw std::runtime_error(folly::to<std::string>(
-          "Verification failed: ", detail::getOpenSSLError()));
-    }
+    verifyEcdsa(pkey.get(), signature, message);
   } else {
     // rsa_pss and rsa_pkcs
     throw std::runtime_error(
@@ -76,6 +64,26 @@ void Validator::verify(
   }
 }
 
+void Validator::verifyEcdsa(
+    const EC_KEY* key,
+    const Buf& signature,
+    const Buf& message) {
+  auto ecdsa = constructECDSASig(signature);
+
+  std::array<uint8_t, fizz::Sha256::HashLen> hashedMessage;
+  fizz::Sha256::hash(
+      *message,
+      folly::MutableByteRange(hashedMessage.data(), hashedMessage.size()));
+  if (ECDSA_do_verify(
+          hashedMessage.data(),
+          hashedMessage.size(),
+          ecdsa.get(),
+          const_cast<EC_KEY*>(key)) != 1) {
+    throw std::runtime_error(folly::to<std::string>(
+        "Verification failed: ", detail::getOpenSSLError()));
+  }
+}
+
 EcdsaSigUniquePtr Validator::constructECDSASig(const Buf& signature) {
   EcdsaSigUniquePtr ecdsaSignature(ECDSA_SIG_new());
   if (!ecdsaSignature) {
@@ -132,5 +140,77 @@ EcKeyUniquePtr Validator::constructEcKeyFromBuf(const Buf& key) {
   }
   return publicKey;
 }
+
+constexpr size_t ValidatorContext::kMaxCachedKeys;
+
+ValidatorContext::ValidatorContext(std::function<Buf()> getEkm)
+    : getEkm_(std::move(getEkm)) {}
+
+ValidatorContext::ValidatorContext(Buf ekm) : ekm_(std::move(ekm)) {}
+
+Optional<TokenBindingID> ValidatorContext::validateTokenBinding(
+    TokenBinding tokenBinding,
+    const TokenBindingKeyParameters& negotiatedParameters) {
+  if (tokenBinding.tokenbindingid.key_parameters != negotiatedParameters) {
+    VLOG(2) << "sent parameters: "
+            << toString(tokenBinding.tokenbindingid.key_parameters)
+            << " don't match negotiated parameters: "
+            << toString(negotiatedParameters);
+    return folly::none;
+  }
+
+  try {
+    if (tokenBinding.tokenbindingid.key_parameters !=
+        TokenBindingKeyParameters::ecdsap256) {
+      // rsa_pss and rsa_pkcs
+      throw std::runtime_error(folly::to<std::string>(
+          "key params not implemented: ",
+          tokenBinding.tokenbindingid.key_parameters));
+    }
+    auto message = TokenBindingUtils::constructMessage(
+        tokenBinding.tokenbinding_type,
+        tokenBinding.tokenbindingid.key_parameters,
+        getEkm());
+    Validator::verifyEcdsa(
+        getKey(tokenBinding.tokenbindingid), tokenBinding.signature, message);
+    return std::move(tokenBinding.tokenbindingid);
+  } catch (const std::exception& e) {
+    VLOG(1) << "Token Binding Verification Failed: " << e.what();
+    return folly::none;
+  }
+}
+
+const Buf& ValidatorContext::getEkm() {
+  if (!ekm_) {
+    if (!getEkm_) {
+      throw std::runtime_error("no ekm");
+    }
+    ekm_ = getEkm_();
+    getEkm_ = nullptr;
+    if (!ekm_) {
+      throw std::runtime_error("unable to get ekm");
+    }
+  }
+  return ekm_;
+}
+
+const EC_KEY* ValidatorContext::getKey(const TokenBindingID& id) {
+  folly::IOBufEqualTo eq;
+  for (const auto& cached : keys_) {
+    if (cached.keyParameters == id.key_parameters &&
+        eq(*cached.key, *id.key)) {
+      return cached.ecKey.get();
+    }
+  }
+
+  // Only keys that parse are cached.
+  auto ecKey = Validator::constructEcKeyFromBuf(id.key);
+  if (keys_.size() == kMaxCachedKeys) {
+    keys_.erase(keys_.begin());
+  }
+  keys_.push_back(
+      CachedKey{id.key_parameters, id.key->clone(), std::move(ecKey)});
+  return keys_.back().ecKey.get();
+}
 } // namespace extensions
 } // namespace fizz
@@ -12,6 +12,9 @@
 #include <fizz/extensions/tokenbinding/Types.h>
 #include <fizz/record/Types.h>
 
+#include <functional>
+#include <vector>
+
 namespace fizz {
 namespace extensions {
 
@@ -29,15 +32,68 @@ class Validator {
       const TokenBindingKeyParameters& negotiatedParameters);
 
  private:
+  friend class AsyncValidator;
+  friend class ValidatorContext;
+
   static void verify(
       const TokenBindingKeyParameters& keyParams,
       const Buf& key,
       const Buf& signature,
       const Buf& message);
 
+  static void verifyEcdsa(
+      const EC_KEY* key,
+      const Buf& signature,
+      const Buf& message);
+
   static folly::ssl::EcdsaSigUniquePtr constructECDSASig(const Buf& signature);
 
   static folly::ssl::EcKeyUniquePtr constructEcKeyFromBuf(const Buf& key);
 };
+
+/*
+ * Validates the Token Binding messages of a single connection. The EKM is
+ * derived the first time it is needed, and the keys of the TokenBindingIDs
+ * seen on the connection are kept parsed, so validating further messages
+ * that reuse an ID costs a signature verification.
+ *
+ * Not thread safe; use one per connection.
+ */
+class ValidatorContext {
+ public:
+  /*
+   * getEkm is called at most once, on the first validation, and should return
+   * the connection's Token Binding exporter value.
+   */
+  explicit ValidatorContext(std::function<Buf()> getEkm);
+
+  explicit ValidatorContext(Buf ekm);
+
+  folly::Optional<TokenBindingID> validateTokenBinding(
+      TokenBinding tokenBinding,
+      const TokenBindingKeyParameters& negotiatedParameters);
+
+  size_t numCachedKeys() const {
+    return keys_.size();
+  }
+
+  // A connection normally only uses a provided and a referred ID.
+  static constexpr size_t kMaxCachedKeys = 4;
+
+ private:
+  const Buf& getEkm();
+
+  const EC_KEY* getKey(const TokenBindingID& id);
+
+  struct CachedKey {
+    TokenBindingKeyParameters keyParameters;
+    Buf key;
+    folly::ssl::EcKeyUniquePtr ecKey;
+  };
+
+  std::function<Buf()> getEkm_;
+  Buf ekm_;
+  std::vector<CachedKey> keys_;
+};
 } // namespace extensions
 } // namespace fizz
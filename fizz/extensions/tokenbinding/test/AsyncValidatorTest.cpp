@@ -0,0 +1,127 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/extensions/tokenbinding/AsyncValidator.h>
+
+#include <folly/executors/ManualExecutor.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace extensions {
+namespace test {
+
+// Same values as ValidatorTest
+StringPiece chrome_session_ekm{
+    "9d20b2acf86f893a240642593cfc53102b9fb76b37f059d4bff47a0e6fee25e7"};
+StringPiece chrome_session_key{
+    "40dd2fa2430a0f54ca96454bdf23c264353a252812bc5fa7b851a6fa9d620424bf43e20e50a4ca0a1769f4024db346ca5075eecdb7f62d0018cf1642b75f679d98"};
+StringPiece chrome_session_signature{
+    "d2c9c04957013f38369a18a5d5b47d6492f0f0f5c8772a27cc3770f23dda94d30fc3a6d0dc110c78e668a44c3b8b61842a6e72795f61f51f398f8dedd2ceb9a3"};
+
+class TestAsyncValidator : public AsyncValidator {
+ public:
+  using AsyncValidator::AsyncValidator;
+
+  std::vector<size_t> batchSizes;
+
+ protected:
+  void verifyRequests(std::vector<VerifyRequest>& batch) override {
+    batchSizes.push_back(batch.size());
+    AsyncValidator::verifyRequests(batch);
+  }
+};
+
+class AsyncValidatorTest : public Test {
+ public:
+  void SetUp() override {
+    OpenSSL_add_all_algorithms();
+    executor_ = std::make_shared<ManualExecutor>();
+    validator_ = std::make_shared<TestAsyncValidator>(executor_, 2, 8);
+  }
+
+  TokenBinding getBinding() {
+    TokenBinding tokenBinding;
+    tokenBinding.tokenbinding_type = TokenBindingType::provided_token_binding;
+    tokenBinding.extensions = IOBuf::create(0);
+    tokenBinding.tokenbindingid.key_parameters =
+        TokenBindingKeyParameters::ecdsap256;
+    tokenBinding.tokenbindingid.key = getBuf(chrome_session_key);
+    tokenBinding.signature = getBuf(chrome_session_signature);
+    return tokenBinding;
+  }
+
+  Future<Optional<TokenBindingID>> validate(
+      TokenBinding binding,
+      TokenBindingKeyParameters params = TokenBindingKeyParameters::ecdsap256) {
+    return validator_->validateTokenBinding(
+        std::move(binding), getBuf(chrome_session_ekm), params);
+  }
+
+  Buf getBuf(StringPiece hex) {
+    auto data = unhexlify(hex);
+    return IOBuf::copyBuffer(data.data(), data.size());
+  }
+
+ protected:
+  std::shared_ptr<ManualExecutor> executor_;
+  std::shared_ptr<TestAsyncValidator> validator_;
+};
+
+TEST_F(AsyncValidatorTest, TestValidateOnExecutor) {
+  auto result = validate(getBinding());
+  EXPECT_FALSE(result.isReady());
+  executor_->drain();
+  ASSERT_TRUE(result.isReady());
+  ASSERT_TRUE(result.value().hasValue());
+  EXPECT_TRUE(
+      IOBufEqualTo()(result.value()->key, getBuf(chrome_session_key)));
+  EXPECT_EQ(validator_->batchSizes, std::vector<size_t>({1}));
+}
+
+TEST_F(AsyncValidatorTest, TestBatches) {
+  std::vector<Future<Optional<TokenBindingID>>> results;
+  for (size_t i = 0; i < 3; ++i) {
+    results.push_back(validate(getBinding()));
+  }
+  auto bad = getBinding();
+  *bad.signature->writableData() ^= 0x04;
+  results.push_back(validate(std::move(bad)));
+  executor_->drain();
+  EXPECT_EQ(validator_->batchSizes, std::vector<size_t>({2, 2}));
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_TRUE(results[i].value().hasValue());
+  }
+  EXPECT_FALSE(results[3].value().hasValue());
+}
+
+TEST_F(AsyncValidatorTest, TestBadKey) {
+  StringPiece bad_ecdsa_key{
+      "3060FED4BA255A9D31C961EB74C6356D68C049B8923B41AE9E95628BC64F2F1B20C2D7E9F5177A3C294D4461FA6CE669622E60F29FB67903FE1008B8BC99A62299"};
+  auto binding = getBinding();
+  binding.tokenbindingid.key = getBuf(bad_ecdsa_key);
+  auto result = validate(std::move(binding));
+  executor_->drain();
+  ASSERT_TRUE(result.isReady());
+  EXPECT_FALSE(result.value().hasValue());
+}
+
+TEST_F(AsyncValidatorTest, TestMismatchKeyParams) {
+  auto result =
+      validate(getBinding(), TokenBindingKeyParameters::rsa2048_pss);
+  ASSERT_TRUE(result.isReady());
+  EXPECT_FALSE(result.value().hasValue());
+  EXPECT_EQ(executor_->run(), 0);
+}
+} // namespace test
+} // namespace extensions
+} // namespace fizz
@@ -73,6 +73,65 @@ TEST_F(TokenBindingConstructorTest, TestBadEcKey) {
           TokenBindingType::provided_token_binding),
       std::runtime_error);
 }
+
+TEST_F(TokenBindingConstructorTest, TestSignerSignAndValidate) {
+  TokenBindingSigner signer(*key_.get(), TokenBindingKeyParameters::ecdsap256);
+  auto ekmBuf = getBuf(ekm);
+  for (auto type :
+       {TokenBindingType::provided_token_binding,
+        TokenBindingType::referred_token_binding,
+        TokenBindingType::provided_token_binding}) {
+    auto binding = signer.createTokenBinding(ekmBuf, type);
+    EXPECT_EQ(binding.tokenbinding_type, type);
+    EXPECT_TRUE(
+        Validator::validateTokenBinding(
+            std::move(binding), ekmBuf, TokenBindingKeyParameters::ecdsap256)
+            .hasValue());
+  }
+}
+
+TEST_F(TokenBindingConstructorTest, TestSignerNewEkm) {
+  TokenBindingSigner signer(*key_.get(), TokenBindingKeyParameters::ecdsap256);
+  auto ekmBuf = getBuf(ekm);
+  signer.createTokenBinding(ekmBuf, TokenBindingType::provided_token_binding);
+
+  auto newEkm = IOBuf::copyBuffer(std::string(ekmBuf->length(), 'e'));
+  EXPECT_TRUE(Validator::validateTokenBinding(
+                  signer.createTokenBinding(
+                      newEkm, TokenBindingType::provided_token_binding),
+                  newEkm,
+                  TokenBindingKeyParameters::ecdsap256)
+                  .hasValue());
+  EXPECT_FALSE(Validator::validateTokenBinding(
+                   signer.createTokenBinding(
+                       newEkm, TokenBindingType::provided_token_binding),
+                   ekmBuf,
+                   TokenBindingKeyParameters::ecdsap256)
+                   .hasValue());
+}
+
+TEST_F(TokenBindingConstructorTest, TestSignerChainedEkm) {
+  TokenBindingSigner signer(*key_.get(), TokenBindingKeyParameters::ecdsap256);
+  auto ekmBuf = getBuf(ekm);
+  auto chainedEkm = IOBuf::copyBuffer(ekmBuf->data(), ekmBuf->length() / 2);
+  chainedEkm->prependChain(IOBuf::copyBuffer(
+      ekmBuf->data() + ekmBuf->length() / 2,
+      ekmBuf->length() - ekmBuf->length() / 2));
+  EXPECT_TRUE(Validator::validateTokenBinding(
+                  signer.createTokenBinding(
+                      chainedEkm, TokenBindingType::provided_token_binding),
+                  ekmBuf,
+                  TokenBindingKeyParameters::ecdsap256)
+                  .hasValue());
+  EXPECT_TRUE(chainedEkm->isChained());
+}
+
+TEST_F(TokenBindingConstructorTest, TestSignerBadEcKey) {
+  auto badKey = EvpPkeyUniquePtr(EVP_PKEY_new());
+  EXPECT_THROW(
+      TokenBindingSigner(*badKey.get(), TokenBindingKeyParameters::ecdsap256),
+      std::runtime_error);
+}
 } // namespace test
 } // namespace extensions
 } // namespace fizz
@@ -109,6 +109,65 @@ TEST_F(ValidatorTest, TestTruncatedSignature) {
           std::move(binding), ekm_, TokenBindingKeyParameters::ecdsap256)
           .hasValue());
 }
+
+TEST_F(ValidatorTest, TestContextEkmDerivedOnce) {
+  size_t ekmCalls = 0;
+  ValidatorContext context([this, &ekmCalls]() {
+    ++ekmCalls;
+    return ekm_->clone();
+  });
+  for (size_t i = 0; i < 3; ++i) {
+    auto binding =
+        setUpWithKeyParameters(TokenBindingKeyParameters::ecdsap256);
+    EXPECT_TRUE(context
+                    .validateTokenBinding(
+                        std::move(binding),
+                        TokenBindingKeyParameters::ecdsap256)
+                    .hasValue());
+  }
+  EXPECT_EQ(ekmCalls, 1);
+  EXPECT_EQ(context.numCachedKeys(), 1);
+}
+
+TEST_F(ValidatorTest, TestContextInvalidSignatureWithCachedKey) {
+  ValidatorContext context(ekm_->clone());
+  auto binding = setUpWithKeyParameters(TokenBindingKeyParameters::ecdsap256);
+  EXPECT_TRUE(context
+                  .validateTokenBinding(
+                      std::move(binding), TokenBindingKeyParameters::ecdsap256)
+                  .hasValue());
+
+  binding = setUpWithKeyParameters(TokenBindingKeyParameters::ecdsap256);
+  *binding.signature->writableData() ^= 0x04;
+  EXPECT_FALSE(context
+                   .validateTokenBinding(
+                       std::move(binding), TokenBindingKeyParameters::ecdsap256)
+                   .hasValue());
+  EXPECT_EQ(context.numCachedKeys(), 1);
+}
+
+TEST_F(ValidatorTest, TestContextBadKeyNotCached) {
+  StringPiece bad_ecdsa_key{
+      "3060FED4BA255A9D31C961EB74C6356D68C049B8923B41AE9E95628BC64F2F1B20C2D7E9F5177A3C294D4461FA6CE669622E60F29FB67903FE1008B8BC99A62299"};
+  ValidatorContext context(ekm_->clone());
+  auto binding = setUpWithKeyParameters(TokenBindingKeyParameters::ecdsap256);
+  binding.tokenbindingid.key = getBuf(bad_ecdsa_key);
+  EXPECT_FALSE(context
+                   .validateTokenBinding(
+                       std::move(binding), TokenBindingKeyParameters::ecdsap256)
+                   .hasValue());
+  EXPECT_EQ(context.numCachedKeys(), 0);
+}
+
+TEST_F(ValidatorTest, TestContextMismatchKeyParams) {
+  ValidatorContext context(ekm_->clone());
+  auto binding = setUpWithKeyParameters(TokenBindingKeyParameters::ecdsap256);
+  EXPECT_FALSE(context
+                   .validateTokenBinding(
+                       std::move(binding),
+                       TokenBindingKeyParameters::rsa2048_pss)
+                   .hasValue());
+}
 } // namespace test
 } // namespace extensions
 } // namespace fizz
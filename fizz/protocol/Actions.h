@@ -14,6 +14,8 @@
 
 namespace fizz {
 
+struct RecordIovecs;
+
 /**
  * Application data to deliver to the application.
  */
@@ -22,12 +24,14 @@ struct DeliverAppData {
 };
 
 /**
- * Raw data that must be written to the transport.
+ * Raw data that must be written to the transport. Either data or, for app
+ * writes that asked for it, iovecs is set.
  */
 struct WriteToSocket {
   folly::AsyncTransportWrapper::WriteCallback* callback{nullptr};
   std::unique_ptr<folly::IOBuf> data;
   folly::WriteFlags flags{folly::WriteFlags::NONE};
+  std::shared_ptr<RecordIovecs> iovecs;
 };
 
 /**
@@ -0,0 +1,28 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/AllocationStats.h>
+
+namespace fizz {
+
+AllocationStats::ThreadState& AllocationStats::local() {
+  // Zero initialized, so no dynamic initialization (or allocation) is needed
+  // on first use.
+  static thread_local ThreadState state;
+  return state;
+}
+
+AllocationStats::Snapshot AllocationStats::getThreadSnapshot() {
+  Snapshot snapshot;
+  auto& state = local();
+  for (size_t i = 0; i < snapshot.sites.size(); ++i) {
+    snapshot.sites[i] = state.counts[i];
+  }
+  return snapshot;
+}
+} // namespace fizz
@@ -0,0 +1,130 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace fizz {
+
+/**
+ * Parts of fizz that allocations are attributed to by AllocationStats.
+ */
+enum class AllocationSite : size_t {
+  Other,
+  RecordLayer,
+  Codec,
+  KeySchedule,
+  Certificates,
+  Actions,
+  NumSites
+};
+
+/**
+ * Thread local tally of allocations by the part of fizz they were made from,
+ * for profiling and for tests that hold allocation budgets.
+ *
+ * fizz marks its subsystems with Scopes, but does not count allocations
+ * itself: a binary that wants the numbers hooks the allocator so that it
+ * calls recordAllocation(), and enables counting on the threads it is
+ * interested in. Hooking malloc rather than operator new also counts IOBuf
+ * buffers and OpenSSL's allocations. Without a hook, the cost is a thread
+ * local store per Scope.
+ *
+ * The state is plain thread local data so that recordAllocation() can be
+ * called from an allocator without allocating.
+ */
+class AllocationStats {
+ public:
+  struct Counts {
+    uint64_t allocations;
+    uint64_t bytes;
+  };
+
+  struct Snapshot {
+    std::array<Counts, static_cast<size_t>(AllocationSite::NumSites)> sites{};
+
+    const Counts& get(AllocationSite site) const {
+      return sites[static_cast<size_t>(site)];
+    }
+
+    Counts total() const {
+      Counts counts{0, 0};
+      for (const auto& site : sites) {
+        counts.allocations += site.allocations;
+        counts.bytes += site.bytes;
+      }
+      return counts;
+    }
+
+    /**
+     * Counts since earlier, a snapshot of the same thread.
+     */
+    Snapshot since(const Snapshot& earlier) const {
+      Snapshot diff;
+      for (size_t i = 0; i < sites.size(); ++i) {
+        diff.sites[i].allocations =
+            sites[i].allocations - earlier.sites[i].allocations;
+        diff.sites[i].bytes = sites[i].bytes - earlier.sites[i].bytes;
+      }
+      return diff;
+    }
+  };
+
+  /**
+   * Counts an allocation of bytes against the current site of the calling
+   * thread, if counting is enabled on it.
+   */
+  static void recordAllocation(size_t bytes) {
+    auto& state = local();
+    if (state.enabled) {
+      auto& counts = state.counts[state.site];
+      ++counts.allocations;
+      counts.bytes += bytes;
+    }
+  }
+
+  static void setEnabled(bool enabled) {
+    local().enabled = enabled;
+  }
+
+  static Snapshot getThreadSnapshot();
+
+  /**
+   * Attributes allocations on this thread to site while in scope. Scopes
+   * nest, the innermost one wins.
+   */
+  class Scope {
+   public:
+    explicit Scope(AllocationSite site) : previous_(local().site) {
+      local().site = static_cast<size_t>(site);
+    }
+
+    ~Scope() {
+      local().site = previous_;
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    size_t previous_;
+  };
+
+ private:
+  struct ThreadState {
+    bool enabled;
+    size_t site;
+    Counts counts[static_cast<size_t>(AllocationSite::NumSites)];
+  };
+
+  static ThreadState& local();
+};
+} // namespace fizz
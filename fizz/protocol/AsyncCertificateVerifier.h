@@ -0,0 +1,36 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/CertificateVerifier.h>
+#include <folly/futures/Future.h>
+
+namespace fizz {
+
+/**
+ * CertificateVerifier that can verify asynchronously, for example to build
+ * the chain or check revocation off of the EventBase. The client keeps
+ * processing the handshake while verification runs and only writes its
+ * Finished once the returned future completes.
+ *
+ * The future is continued inline, so it should be completed on the
+ * connection's EventBase (for example by running the work on a pool and using
+ * via() to come back). certs is only valid for the duration of the call, any
+ * certificates needed later must be copied.
+ */
+class AsyncCertificateVerifier : public CertificateVerifier {
+ public:
+  /**
+   * Verifies the certificates in certs, with the same semantics as verify().
+   * The future is completed with an exception if verification fails.
+   */
+  virtual folly::Future<folly::Unit> verifyFuture(
+      const std::vector<std::shared_ptr<const PeerCert>>& certs) const = 0;
+};
+} // namespace fizz
@@ -8,8 +8,15 @@
 
 #include <fizz/protocol/AsyncFizzBase.h>
 
+#include <fizz/protocol/LazyPeerCert.h>
+#include <fizz/protocol/TLSStats.h>
+#include <fizz/record/EncryptedRecordLayer.h>
+#include <fizz/record/Types.h>
 #include <folly/Conv.h>
 #include <folly/io/Cursor.h>
+#include <folly/portability/Unistd.h>
+
+#include <algorithm>
 
 namespace fizz {
 
@@ -22,21 +29,222 @@ static const uint32_t kMinReadSize = 1460;
 static const uint32_t kMaxReadSize = 4000;
 
 /**
- * Buffer size above which we should unset our read callback to apply back
- * pressure on the transport.
+ * Largest read size adaptive read sizing grows to.
+ */
+static const uint32_t kMaxAdaptiveReadSize = 64 * 1024;
+
+/**
+ * TLS record header (content type, legacy version and length) and the
+ * largest record length allowed after encryption.
+ */
+static const size_t kRecordHeaderSize = 5;
+static const size_t kMaxRecordLength = 0x4000 + 256;
+
+/**
+ * Default buffer size above which we should unset our read callback to apply
+ * back pressure on the transport.
  */
 static const uint32_t kMaxBufSize = 64 * 1024;
 
+/**
+ * Size of the chunks writeFile() reads the file region in.
+ */
+static const size_t kFileChunkSize = 64 * 1024;
+
+/**
+ * Writes a file region for writeFile() one chunk at a time, reading the next
+ * chunk with pread() once the previous one has been written, so that at most
+ * one chunk of the region is buffered at a time. Owns a duplicate of the
+ * file descriptor and deletes itself once the region is written or a write
+ * fails. A region that can no longer be read in full (for example because the
+ * file was truncated) fails the write with the bytes written so far.
+ */
+class AsyncFizzBase::FileWriter
+    : public folly::AsyncTransportWrapper::WriteCallback {
+ public:
+  FileWriter(
+      AsyncFizzBase& transport,
+      folly::AsyncTransportWrapper::WriteCallback* callback,
+      int fd,
+      off_t offset,
+      size_t length,
+      folly::WriteFlags flags)
+      : transport_(transport),
+        callback_(callback),
+        fd_(fd),
+        offset_(offset),
+        remaining_(length),
+        flags_(flags) {}
+
+  ~FileWriter() override {
+    close(fd_);
+  }
+
+  void writeChunks() {
+    while (remaining_ > 0) {
+      auto chunk = readChunk();
+      if (!chunk) {
+        fail(
+            written_,
+            AsyncSocketException(
+                AsyncSocketException::INTERNAL_ERROR,
+                "unable to read file region",
+                errno));
+        return;
+      }
+      chunkLength_ = chunk->length();
+      offset_ += chunkLength_;
+      remaining_ -= chunkLength_;
+
+      auto flags = flags_;
+      if (remaining_ > 0) {
+        flags = (flags & ~folly::WriteFlags::EOR) | folly::WriteFlags::CORK;
+      }
+      // The chunk may be written before writeChain() returns; continue from
+      // here in that case instead of recursing once per chunk.
+      writing_ = true;
+      chunkWritten_ = false;
+      transport_.writeChain(this, std::move(chunk), flags);
+      writing_ = false;
+      if (error_) {
+        fail(written_ + errorBytes_, *error_);
+        return;
+      }
+      if (!chunkWritten_) {
+        return;
+      }
+    }
+    auto callback = callback_;
+    delete this;
+    if (callback) {
+      callback->writeSuccess();
+    }
+  }
+
+  void writeSuccess() noexcept override {
+    written_ += chunkLength_;
+    if (writing_) {
+      chunkWritten_ = true;
+    } else {
+      writeChunks();
+    }
+  }
+
+  void writeErr(size_t bytesWritten, const AsyncSocketException& ex) noexcept
+      override {
+    if (writing_) {
+      errorBytes_ = bytesWritten;
+      error_ = ex;
+    } else {
+      fail(written_ + bytesWritten, ex);
+    }
+  }
+
+ private:
+  std::unique_ptr<folly::IOBuf> readChunk() {
+    auto length = std::min(remaining_, kFileChunkSize);
+    auto buf = allocateBuffer(transport_.readBufferPool_.get(), length);
+    while (buf->length() < length) {
+      auto bytesRead = pread(
+          fd_,
+          buf->writableTail(),
+          length - buf->length(),
+          offset_ + buf->length());
+      if (bytesRead < 0 && errno == EINTR) {
+        continue;
+      } else if (bytesRead <= 0) {
+        return nullptr;
+      }
+      buf->append(bytesRead);
+    }
+    return buf;
+  }
+
+  void fail(size_t bytesWritten, const AsyncSocketException& ex) {
+    auto callback = callback_;
+    delete this;
+    if (callback) {
+      callback->writeErr(bytesWritten, ex);
+    }
+  }
+
+  AsyncFizzBase& transport_;
+  folly::AsyncTransportWrapper::WriteCallback* callback_;
+  int fd_;
+  off_t offset_;
+  size_t remaining_;
+  folly::WriteFlags flags_;
+  size_t chunkLength_{0};
+  size_t written_{0};
+  bool writing_{false};
+  bool chunkWritten_{false};
+  size_t errorBytes_{0};
+  folly::Optional<AsyncSocketException> error_;
+};
+
+/**
+ * Write callback that takes the bytes of a write off the write buffer
+ * accounting once it completes, and then reports to the original callback.
+ */
+class AsyncFizzBase::BufferedWriteCallback
+    : public folly::AsyncTransportWrapper::WriteCallback {
+ public:
+  BufferedWriteCallback(
+      AsyncFizzBase& transport,
+      folly::AsyncTransportWrapper::WriteCallback* callback,
+      size_t bytes)
+      : transport_(transport),
+        callback_(callback),
+        bytes_(bytes),
+        epoch_(transport.writeBufferEpoch_) {}
+
+  void writeSuccess() noexcept override {
+    drained();
+    if (callback_) {
+      callback_->writeSuccess();
+    }
+    delete this;
+  }
+
+  void writeErr(size_t bytesWritten, const AsyncSocketException& ex) noexcept
+      override {
+    drained();
+    if (callback_) {
+      callback_->writeErr(bytesWritten, ex);
+    }
+    delete this;
+  }
+
+ private:
+  void drained() {
+    if (epoch_ == transport_.writeBufferEpoch_) {
+      transport_.writeBufferDrained(bytes_);
+    }
+  }
+
+  AsyncFizzBase& transport_;
+  folly::AsyncTransportWrapper::WriteCallback* callback_;
+  size_t bytes_;
+  uint64_t epoch_;
+};
+
 AsyncFizzBase::AsyncFizzBase(folly::AsyncTransportWrapper::UniquePtr transport)
     : folly::WriteChainAsyncTransportWrapper<folly::AsyncTransportWrapper>(
           std::move(transport)),
+      memoryUsageReportCallback_(*this),
+      readHighWatermark_(kMaxBufSize),
+      readLowWatermark_(kMaxBufSize),
+      corkFlushCallback_(*this),
+      pacingTimeout_(*this, transport_->getEventBase()),
       handshakeTimeout_(*this, transport_->getEventBase()) {}
 
 AsyncFizzBase::~AsyncFizzBase() {
+  stopTrackingMemoryUsage();
   transport_->setReadCB(nullptr);
 }
 
 void AsyncFizzBase::destroy() {
+  flushCorkedWrites();
   transport_->closeNow();
   transport_->setReadCB(nullptr);
   DelayedDestruction::destroy();
@@ -70,7 +278,418 @@ void AsyncFizzBase::writeChain(
     folly::AsyncTransportWrapper::WriteCallback* callback,
     std::unique_ptr<folly::IOBuf>&& buf,
     folly::WriteFlags flags) {
-  appBytesWritten_ += buf->computeChainDataLength();
+  auto length = buf->computeChainDataLength();
+  appBytesWritten_ += length;
+  scheduleMemoryUsageReport();
+
+  if (writeBufferCallback_) {
+    callback = new BufferedWriteCallback(*this, callback, length);
+    writeBufferedBytes_ += length;
+    TLSStats::updateHighWatermark(
+        TLSHighWatermark::WriteBuffer, writeBufferedBytes_);
+    if (!writeBufferAboveHighWatermark_ &&
+        writeBufferedBytes_ >= writeHighWatermark_) {
+      writeBufferAboveHighWatermark_ = true;
+      writeBufferCallback_->writeBufferAboveHighWatermark();
+    }
+  }
+
+  if (corkFlushThreshold_ == 0) {
+    return writeToTransport(callback, std::move(buf), flags);
+  }
+
+  corkedWrites_.append(std::move(buf));
+  corkedCallbacks_.push_back({callback, length});
+  corkedFlags_ = corkedFlags_ | flags;
+  if (corkedWrites_.chainLength() >= corkFlushThreshold_ ||
+      isSet(flags, folly::WriteFlags::EOR)) {
+    writeCorkedWrites();
+  } else if (!corkFlushCallback_.isLoopCallbackScheduled()) {
+    transport_->getEventBase()->runInLoop(&corkFlushCallback_);
+  }
+}
+
+void AsyncFizzBase::writeFile(
+    folly::AsyncTransportWrapper::WriteCallback* callback,
+    int fd,
+    off_t offset,
+    size_t length,
+    folly::WriteFlags flags) {
+  if (length == 0) {
+    return writeChain(callback, folly::IOBuf::create(0), flags);
+  }
+
+  auto dupFd = dup(fd);
+  if (dupFd < 0) {
+    AsyncSocketException ex(
+        AsyncSocketException::INTERNAL_ERROR,
+        "unable to read file region",
+        errno);
+    if (callback) {
+      callback->writeErr(0, ex);
+    }
+    return;
+  }
+  (new FileWriter(*this, callback, dupFd, offset, length, flags))
+      ->writeChunks();
+}
+
+void AsyncFizzBase::setCorkWrites(size_t flushThreshold) {
+  corkFlushThreshold_ = flushThreshold;
+  if (corkFlushThreshold_ == 0) {
+    writeCorkedWrites();
+  }
+}
+
+void AsyncFizzBase::setWritePacing(uint64_t bytesPerSecond, size_t burst) {
+  if (bytesPerSecond == 0) {
+    releasePacedWrites(true);
+    pacingBucket_.clear();
+    return;
+  }
+  if (burst < kMaxPlaintextRecordSize) {
+    throw std::runtime_error("pacing burst smaller than a record");
+  }
+  pacingBucket_.emplace(
+      bytesPerSecond, burst, std::chrono::steady_clock::now());
+  releasePacedWrites();
+}
+
+void AsyncFizzBase::setAdaptiveReadSize(bool enabled) {
+  adaptiveReadSize_ = enabled;
+  readSize_ = kMaxReadSize;
+}
+
+void AsyncFizzBase::setZeroCopyWriteThreshold(size_t threshold) {
+  zeroCopyWriteThreshold_ = threshold;
+  if (threshold != 0) {
+    auto socket = transport_->getUnderlyingTransport<folly::AsyncSocket>();
+    if (socket) {
+      socket->setZeroCopy(true);
+    }
+  }
+}
+
+void AsyncFizzBase::releaseIdleResources() {
+  // Empty queues may still hold preallocated buffers.
+  if (transportReadBuf_.empty()) {
+    transportReadBuf_.move();
+  }
+  if (corkedWrites_.empty()) {
+    corkedWrites_.move();
+  }
+  if (pacedWrites_.empty()) {
+    pacedWrites_.move();
+  }
+  if (adaptiveReadSize_) {
+    readSize_ = kMaxReadSize;
+  }
+  reportMemoryUsage();
+}
+
+namespace {
+size_t bufferedBytes(const folly::IOBufQueue& queue) {
+  // Empty queues may still hold preallocated buffers.
+  auto buf = queue.front();
+  return buf ? buf->computeChainCapacity() : 0;
+}
+
+size_t getCertBytes(const Cert& cert) {
+  // Don't parse a certificate that is only kept encoded.
+  auto lazyCert = dynamic_cast<const LazyPeerCert*>(&cert);
+  if (lazyCert && !lazyCert->isParsed()) {
+    return lazyCert->getEncodedLength();
+  }
+  auto x509 = cert.getX509();
+  if (!x509) {
+    return 0;
+  }
+  auto length = i2d_X509(x509.get(), nullptr);
+  return length > 0 ? length : 0;
+}
+} // namespace
+
+MemoryUsage AsyncFizzBase::getMemoryUsage() const {
+  MemoryUsage usage;
+  usage.readBufferBytes = bufferedBytes(transportReadBuf_);
+  if (appDataBuf_) {
+    usage.readBufferBytes += appDataBuf_->computeChainCapacity();
+  }
+  usage.writeBufferBytes =
+      bufferedBytes(corkedWrites_) + bufferedBytes(pacedWrites_);
+  auto peerCert = getPeerCertificate();
+  if (peerCert) {
+    usage.peerCertBytes = getCertBytes(*peerCert);
+  }
+  return usage;
+}
+
+void AsyncFizzBase::setTrackMemoryUsage(bool enabled) {
+  trackMemoryUsage_ = enabled;
+  if (!enabled) {
+    stopTrackingMemoryUsage();
+  } else if (!memoryUsageTracker_ && getEventBase()) {
+    startTrackingMemoryUsage(*getEventBase());
+  }
+}
+
+void AsyncFizzBase::reportMemoryUsage() {
+  if (!memoryUsageTracker_) {
+    return;
+  }
+  auto usage = getMemoryUsage();
+  memoryUsageTracker_->update(reportedMemoryUsage_, usage);
+  reportedMemoryUsage_ = usage;
+}
+
+void AsyncFizzBase::scheduleMemoryUsageReport() {
+  if (memoryUsageTracker_ &&
+      !memoryUsageReportCallback_.isLoopCallbackScheduled()) {
+    transport_->getEventBase()->runInLoop(&memoryUsageReportCallback_);
+  }
+}
+
+size_t AsyncFizzBase::getCertChainBytes(
+    const std::vector<std::shared_ptr<const PeerCert>>& chain,
+    const Cert* counted) {
+  size_t bytes = 0;
+  for (const auto& cert : chain) {
+    if (cert && cert.get() != counted) {
+      bytes += getCertBytes(*cert);
+    }
+  }
+  return bytes;
+}
+
+void AsyncFizzBase::startTrackingMemoryUsage(folly::EventBase& evb) {
+  memoryUsageTracker_ = &MemoryUsageTracker::get(evb);
+  memoryUsageTracker_->addConnection();
+  reportMemoryUsage();
+}
+
+void AsyncFizzBase::stopTrackingMemoryUsage() {
+  if (!memoryUsageTracker_) {
+    return;
+  }
+  memoryUsageReportCallback_.cancelLoopCallback();
+  memoryUsageTracker_->removeConnection(reportedMemoryUsage_);
+  memoryUsageTracker_ = nullptr;
+  reportedMemoryUsage_ = MemoryUsage();
+}
+
+void AsyncFizzBase::setReadBufferWatermarks(size_t high, size_t low) {
+  if (low > high) {
+    throw std::runtime_error("low read watermark above high watermark");
+  }
+  readHighWatermark_ = high;
+  readLowWatermark_ = low;
+  checkBufLen();
+}
+
+void AsyncFizzBase::setWriteBufferWatermarks(
+    size_t high,
+    size_t low,
+    WriteBufferCallback* callback) {
+  if (low > high) {
+    throw std::runtime_error("low write watermark above high watermark");
+  }
+  writeHighWatermark_ = high;
+  writeLowWatermark_ = low;
+  writeBufferCallback_ = callback;
+  writeBufferedBytes_ = 0;
+  writeBufferAboveHighWatermark_ = false;
+  writeBufferEpoch_++;
+}
+
+void AsyncFizzBase::writeBufferDrained(size_t bytes) {
+  DCHECK_GE(writeBufferedBytes_, bytes);
+  writeBufferedBytes_ -= bytes;
+  if (writeBufferAboveHighWatermark_ &&
+      writeBufferedBytes_ <= writeLowWatermark_) {
+    writeBufferAboveHighWatermark_ = false;
+    writeBufferCallback_->writeBufferBelowLowWatermark();
+  }
+}
+
+void AsyncFizzBase::flushCorkedWrites() {
+  writeCorkedWrites();
+  releasePacedWrites(true);
+}
+
+void AsyncFizzBase::writeCorkedWrites() {
+  corkFlushCallback_.cancelLoopCallback();
+  if (corkedWrites_.empty() && corkedCallbacks_.empty()) {
+    return;
+  }
+  scheduleMemoryUsageReport();
+
+  auto callback = combineWriteCallbacks(std::move(corkedCallbacks_));
+  corkedCallbacks_.clear();
+  auto flags = corkedFlags_;
+  corkedFlags_ = folly::WriteFlags::NONE;
+
+  auto buf = corkedWrites_.move();
+  if (!buf) {
+    buf = folly::IOBuf::create(0);
+  }
+  writeToTransport(callback, std::move(buf), flags);
+}
+
+void AsyncFizzBase::writeRecordsToTransport(
+    folly::AsyncTransportWrapper::WriteCallback* callback,
+    std::unique_ptr<folly::IOBuf>&& records,
+    folly::WriteFlags flags) {
+  if (zeroCopyWriteThreshold_ != 0 && records &&
+      records->computeChainDataLength() >= zeroCopyWriteThreshold_) {
+    flags = flags | folly::WriteFlags::WRITE_MSG_ZEROCOPY;
+  }
+  transport_->writeChain(callback, std::move(records), flags);
+}
+
+namespace {
+/**
+ * Write callback that keeps the iovecs of a vectored write, and the records
+ * they point into, alive until the write completes, and then reports to the
+ * original callback.
+ */
+class IovecsWriteCallback
+    : public folly::AsyncTransportWrapper::WriteCallback {
+ public:
+  IovecsWriteCallback(
+      folly::AsyncTransportWrapper::WriteCallback* callback,
+      std::shared_ptr<RecordIovecs> records)
+      : callback_(callback), records_(std::move(records)) {}
+
+  void writeSuccess() noexcept override {
+    if (callback_) {
+      callback_->writeSuccess();
+    }
+    delete this;
+  }
+
+  void writeErr(size_t bytesWritten, const AsyncSocketException& ex) noexcept
+      override {
+    if (callback_) {
+      callback_->writeErr(bytesWritten, ex);
+    }
+    delete this;
+  }
+
+ private:
+  folly::AsyncTransportWrapper::WriteCallback* callback_;
+  std::shared_ptr<RecordIovecs> records_;
+};
+} // namespace
+
+void AsyncFizzBase::writeRecordsToTransport(
+    folly::AsyncTransportWrapper::WriteCallback* callback,
+    std::shared_ptr<RecordIovecs> records,
+    folly::WriteFlags flags) {
+  if (records->iovecs.empty()) {
+    transport_->writeChain(callback, folly::IOBuf::create(0), flags);
+    return;
+  }
+  auto iov = records->iovecs.data();
+  auto count = records->iovecs.size();
+  transport_->writev(
+      new IovecsWriteCallback(callback, std::move(records)),
+      iov,
+      count,
+      flags);
+}
+
+std::shared_ptr<RecordIovecs> AsyncFizzBase::makeWriteIovecs() const {
+  if (!vectoredWrites_ || zeroCopyWriteThreshold_ != 0) {
+    return nullptr;
+  }
+  return std::make_shared<RecordIovecs>();
+}
+
+folly::AsyncTransportWrapper::WriteCallback*
+AsyncFizzBase::combineWriteCallbacks(std::vector<MergedWrite> writes) {
+  return fizz::combineWriteCallbacks(std::move(writes));
+}
+
+void AsyncFizzBase::writeToTransport(
+    folly::AsyncTransportWrapper::WriteCallback* callback,
+    std::unique_ptr<folly::IOBuf>&& buf,
+    folly::WriteFlags flags) {
+  if (!pacingBucket_) {
+    return writeUnpaced(callback, std::move(buf), flags);
+  }
+
+  pacedBytesQueued_ += buf->computeChainDataLength();
+  pacedWrites_.append(std::move(buf));
+  pacedWriteEnds_.push_back(PacedWrite{pacedBytesQueued_, callback, flags});
+  if (!pacingTimeout_.isScheduled()) {
+    releasePacedWrites();
+  }
+}
+
+void AsyncFizzBase::releasePacedWrites(bool force) {
+  pacingTimeout_.cancelTimeout();
+  if (pacedWriteEnds_.empty()) {
+    return;
+  }
+
+  DelayedDestruction::DestructorGuard dg(this);
+  scheduleMemoryUsageReport();
+  auto now = std::chrono::steady_clock::now();
+  while (!pacedWriteEnds_.empty()) {
+    size_t queued = pacedWrites_.chainLength();
+    size_t release = queued;
+    if (!force && pacingBucket_ && queued > 0) {
+      auto tokens = pacingBucket_->available(now);
+      if (queued > kMaxPlaintextRecordSize) {
+        // Only release whole records while more than one is queued.
+        release = std::min(
+            queued,
+            static_cast<size_t>(tokens) / kMaxPlaintextRecordSize *
+                kMaxPlaintextRecordSize);
+      } else if (tokens < queued) {
+        release = 0;
+      }
+      if (release == 0) {
+        auto wait = pacingBucket_->timeUntil(
+            std::min<size_t>(queued, kMaxPlaintextRecordSize), now);
+        pacingTimeout_.scheduleTimeout(std::max(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                wait + std::chrono::milliseconds(1) -
+                std::chrono::nanoseconds(1)),
+            std::chrono::milliseconds(1)));
+        return;
+      }
+      pacingBucket_->consume(release);
+    }
+
+    auto buf = release > 0 ? pacedWrites_.split(release)
+                           : folly::IOBuf::create(0);
+    // The first write may have been partly released earlier, so its part of
+    // buf starts at the bytes released so far.
+    auto offset = pacedBytesReleased_;
+    pacedBytesReleased_ += release;
+    std::vector<MergedWrite> writes;
+    auto flags = folly::WriteFlags::NONE;
+    while (!pacedWriteEnds_.empty() &&
+           pacedWriteEnds_.front().end <= pacedBytesReleased_) {
+      auto& write = pacedWriteEnds_.front();
+      writes.push_back({write.callback, write.end - offset});
+      offset = write.end;
+      flags = flags | write.flags;
+      pacedWriteEnds_.pop_front();
+    }
+    writeUnpaced(
+        combineWriteCallbacks(std::move(writes)), std::move(buf), flags);
+  }
+}
+
+void AsyncFizzBase::writeUnpaced(
+    folly::AsyncTransportWrapper::WriteCallback* callback,
+    std::unique_ptr<folly::IOBuf>&& buf,
+    folly::WriteFlags flags) {
+  if (kTLSEnabled_) {
+    return transport_->writeChain(callback, std::move(buf), flags);
+  }
 
   // TODO: break up buf into multiple records
 
@@ -86,17 +705,45 @@ size_t AsyncFizzBase::getAppBytesReceived() const {
 }
 
 void AsyncFizzBase::startTransportReads() {
+  readsPaused_ = false;
   transport_->setReadCB(this);
 }
 
+void AsyncFizzBase::stopTransportReads() {
+  readsPaused_ = true;
+  transport_->setReadCB(nullptr);
+}
+
 void AsyncFizzBase::startHandshakeTimeout(std::chrono::milliseconds timeout) {
+  handshakeDeadline_ = std::chrono::steady_clock::now() + timeout;
   handshakeTimeout_.scheduleTimeout(timeout);
 }
 
 void AsyncFizzBase::cancelHandshakeTimeout() {
+  handshakeDeadline_.clear();
   handshakeTimeout_.cancelTimeout();
 }
 
+void AsyncFizzBase::suspendHandshakeTimeout() {
+  if (handshakeDeadline_) {
+    handshakeTimeout_.cancelTimeout();
+  }
+}
+
+void AsyncFizzBase::resumeHandshakeTimeout() {
+  if (handshakeDeadline_) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        *handshakeDeadline_ - std::chrono::steady_clock::now());
+    handshakeTimeout_.scheduleTimeout(
+        std::max(remaining, std::chrono::milliseconds(0)));
+  }
+}
+
+void AsyncFizzBase::startKTLSPassthrough() {
+  DCHECK(transportReadBuf_.empty());
+  kTLSEnabled_ = true;
+}
+
 void AsyncFizzBase::deliverAppData(std::unique_ptr<folly::IOBuf> data) {
   if (data) {
     appBytesReceived_ += data->computeChainDataLength();
@@ -109,6 +756,26 @@ void AsyncFizzBase::deliverAppData(std::unique_ptr<folly::IOBuf> data) {
     data = std::move(appDataBuf_);
   }
 
+  if (providedBuffer_) {
+    auto provided = providedBuffer_;
+    providedBuffer_ = nullptr;
+    if (data && data->data() == provided &&
+        readCallback_ == providedBufferCallback_ &&
+        !readCallback_->isBufferMovable()) {
+      // The first record was decrypted straight into the read callback's
+      // buffer, so it only needs to be told how much was written.
+      auto length = data->length();
+      data = data->pop();
+      if (length != 0) {
+        readCallback_->readDataAvailable(length);
+      }
+    } else if (data) {
+      // The provided memory is no longer ours to deliver from, so nothing may
+      // be left pointing into it.
+      data->makeManaged();
+    }
+  }
+
   if (readCallback_ && data) {
     if (readCallback_->isBufferMovable()) {
       return readCallback_->readBufferAvailable(std::move(data));
@@ -175,18 +842,62 @@ void AsyncFizzBase::deliverError(
 }
 
 void AsyncFizzBase::getReadBuffer(void** bufReturn, size_t* lenReturn) {
-  std::pair<void*, uint32_t> readSpace =
-      transportReadBuf_.preallocate(kMinReadSize, kMaxReadSize);
+  size_t minReadSize = kMinReadSize;
+  size_t maxReadSize = kMaxReadSize;
+  if (adaptiveReadSize_) {
+    minReadSize = std::max<size_t>(kMinReadSize, getPendingRecordBytes());
+    maxReadSize = std::max(minReadSize, readSize_);
+  }
+  if (readBufferPool_ && transportReadBuf_.tailroom() < minReadSize) {
+    // Give the queue a pooled buffer to preallocate from instead of letting
+    // it allocate one.
+    transportReadBuf_.append(readBufferPool_->allocate(maxReadSize));
+  }
+  auto readSpace = transportReadBuf_.preallocate(minReadSize, maxReadSize);
+  lastReadBufferSize_ = readSpace.second;
   *bufReturn = readSpace.first;
   *lenReturn = readSpace.second;
 }
 
+folly::MutableByteRange AsyncFizzBase::getPlaintextBuffer(size_t length) {
+  // Only hand out one buffer at a time, and only if the plaintext would be
+  // delivered to the read callback right away.
+  if (!decryptIntoReadBuffers_ || !readCallback_ || appDataBuf_ ||
+      providedBuffer_ || readCallback_->isBufferMovable()) {
+    return folly::MutableByteRange();
+  }
+  void* buf = nullptr;
+  size_t buflen = 0;
+  try {
+    readCallback_->getReadBuffer(&buf, &buflen);
+  } catch (const std::exception&) {
+    // Reported when the data is delivered the usual way.
+    return folly::MutableByteRange();
+  }
+  if (buf == nullptr || buflen < length) {
+    return folly::MutableByteRange();
+  }
+  providedBuffer_ = static_cast<uint8_t*>(buf);
+  providedBufferCallback_ = readCallback_;
+  return folly::MutableByteRange(providedBuffer_, buflen);
+}
+
 void AsyncFizzBase::readDataAvailable(size_t len) noexcept {
   DelayedDestruction::DestructorGuard dg(this);
 
+  providedBuffer_ = nullptr;
+
   transportReadBuf_.postallocate(len);
-  transportDataAvailable();
+  if (adaptiveReadSize_) {
+    updateReadSize(len);
+  }
+  if (kTLSEnabled_) {
+    deliverAppData(transportReadBuf_.move());
+  } else {
+    transportDataAvailable();
+  }
   checkBufLen();
+  scheduleMemoryUsageReport();
 }
 
 bool AsyncFizzBase::isBufferMovable() noexcept {
@@ -197,9 +908,16 @@ void AsyncFizzBase::readBufferAvailable(
     std::unique_ptr<folly::IOBuf> data) noexcept {
   DelayedDestruction::DestructorGuard dg(this);
 
-  transportReadBuf_.append(std::move(data));
-  transportDataAvailable();
+  providedBuffer_ = nullptr;
+
+  if (kTLSEnabled_) {
+    deliverAppData(std::move(data));
+  } else {
+    transportReadBuf_.append(std::move(data));
+    transportDataAvailable();
+  }
   checkBufLen();
+  scheduleMemoryUsageReport();
 }
 
 void AsyncFizzBase::readEOF() noexcept {
@@ -220,14 +938,57 @@ void AsyncFizzBase::writeErr(
 }
 
 void AsyncFizzBase::checkBufLen() {
-  if (!readCallback_ &&
-      (transportReadBuf_.chainLength() >= kMaxBufSize ||
-       (appDataBuf_ && appDataBuf_->computeChainDataLength() >= kMaxBufSize))) {
-    transport_->setReadCB(nullptr);
+  auto transportBuffered = transportReadBuf_.chainLength();
+  auto appBuffered = appDataBuf_ ? appDataBuf_->computeChainDataLength() : 0;
+  TLSStats::updateHighWatermark(
+      TLSHighWatermark::TransportReadBuffer, transportBuffered);
+  TLSStats::updateHighWatermark(TLSHighWatermark::AppDataBuffer, appBuffered);
+  if (!readsPaused_) {
+    if (!readCallback_ &&
+        (transportBuffered >= readHighWatermark_ ||
+         appBuffered >= readHighWatermark_)) {
+      readsPaused_ = true;
+      transport_->setReadCB(nullptr);
+    }
+  } else if (
+      transportBuffered <= readLowWatermark_ &&
+      appBuffered <= readLowWatermark_ && good()) {
+    startTransportReads();
+  }
+}
+
+size_t AsyncFizzBase::getPendingRecordBytes() const {
+  auto buffered = transportReadBuf_.chainLength();
+  if (buffered < kRecordHeaderSize) {
+    return 0;
+  }
+  folly::io::Cursor cursor(transportReadBuf_.front());
+  auto contentType = cursor.read<uint8_t>();
+  // Only trust the length if this looks like a record header.
+  if (contentType < static_cast<uint8_t>(ContentType::change_cipher_spec) ||
+      contentType > static_cast<uint8_t>(ContentType::application_data)) {
+    return 0;
+  }
+  cursor.skip(sizeof(uint16_t));
+  auto length = cursor.readBE<uint16_t>();
+  if (length > kMaxRecordLength) {
+    return 0;
+  }
+  auto recordSize = kRecordHeaderSize + length;
+  return recordSize > buffered ? recordSize - buffered : 0;
+}
+
+void AsyncFizzBase::updateReadSize(size_t bytesRead) {
+  if (bytesRead >= lastReadBufferSize_) {
+    // The transport may have more for us, read more at once next time.
+    readSize_ = std::min<size_t>(readSize_ * 2, kMaxAdaptiveReadSize);
+  } else if (bytesRead < readSize_ / 4) {
+    readSize_ = std::max<size_t>(readSize_ / 2, kMaxReadSize);
   }
 }
 
 void AsyncFizzBase::handshakeTimeoutExpired() noexcept {
+  handshakeDeadline_.clear();
   AsyncSocketException eof(
       AsyncSocketException::TIMED_OUT, "handshake timeout expired");
   transportError(eof);
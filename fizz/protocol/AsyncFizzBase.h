@@ -8,13 +8,24 @@
 
 #pragma once
 
+#include <fizz/crypto/aead/BufferPool.h>
+#include <fizz/protocol/MemoryUsage.h>
+#include <fizz/protocol/MergedWriteCallback.h>
+#include <fizz/protocol/TokenBucket.h>
+#include <fizz/record/RecordLayer.h>
+#include <folly/Optional.h>
 #include <folly/io/IOBufQueue.h>
 #include <folly/io/async/AsyncSocket.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
 #include <folly/io/async/WriteChainAsyncTransportWrapper.h>
 
+#include <deque>
+
 namespace fizz {
 
 using Cert = folly::AsyncTransportCertificate;
+class PeerCert;
 
 /**
  * This class is a wrapper around AsyncTransportWrapper to handle most app level
@@ -23,7 +34,8 @@ using Cert = folly::AsyncTransportCertificate;
 class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
                           folly::AsyncTransportWrapper>,
                       protected folly::AsyncTransportWrapper::WriteCallback,
-                      private folly::AsyncTransportWrapper::ReadCallback {
+                      private folly::AsyncTransportWrapper::ReadCallback,
+                      private PlaintextBufferProvider {
  public:
   using UniquePtr =
       std::unique_ptr<AsyncFizzBase, folly::DelayedDestruction::Destructor>;
@@ -44,6 +56,72 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
     AsyncFizzBase& transport_;
   };
 
+  /**
+   * Flushes corked app writes at the end of the event loop iteration.
+   */
+  class CorkFlushCallback : public folly::EventBase::LoopCallback {
+   public:
+    explicit CorkFlushCallback(AsyncFizzBase& transport)
+        : transport_(transport) {}
+
+    void runLoopCallback() noexcept override {
+      transport_.writeCorkedWrites();
+    }
+
+   private:
+    AsyncFizzBase& transport_;
+  };
+
+  /**
+   * Reports memory usage at the end of the event loop iteration, so that
+   * usage is reported at most once per loop however much changed.
+   */
+  class MemoryUsageReportCallback : public folly::EventBase::LoopCallback {
+   public:
+    explicit MemoryUsageReportCallback(AsyncFizzBase& transport)
+        : transport_(transport) {}
+
+    void runLoopCallback() noexcept override {
+      transport_.reportMemoryUsage();
+    }
+
+   private:
+    AsyncFizzBase& transport_;
+  };
+
+  class PacingTimeout : public folly::AsyncTimeout {
+   public:
+    PacingTimeout(AsyncFizzBase& transport, folly::EventBase* eventBase)
+        : folly::AsyncTimeout(eventBase), transport_(transport) {}
+
+    void timeoutExpired() noexcept override {
+      transport_.releasePacedWrites();
+    }
+
+   private:
+    AsyncFizzBase& transport_;
+  };
+
+  /**
+   * Notified when the app bytes written but not yet sent cross the write
+   * buffer watermarks.
+   */
+  class WriteBufferCallback {
+   public:
+    virtual ~WriteBufferCallback() = default;
+
+    /**
+     * Called once the buffered bytes reach the high watermark.
+     */
+    virtual void writeBufferAboveHighWatermark() noexcept = 0;
+
+    /**
+     * Called once the buffered bytes drop back to the low watermark, after
+     * writeBufferAboveHighWatermark().
+     */
+    virtual void writeBufferBelowLowWatermark() noexcept = 0;
+  };
+
   explicit AsyncFizzBase(folly::AsyncTransportWrapper::UniquePtr transport);
 
   ~AsyncFizzBase() override;
@@ -58,6 +136,158 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
       std::unique_ptr<folly::IOBuf>&& buf,
       folly::WriteFlags flags = folly::WriteFlags::NONE) override;
 
+  /**
+   * Write length bytes of the file fd, starting at offset, as app data. The
+   * region is read with pread() in bounded chunks, each read once the previous
+   * one has been written, so only one chunk is buffered at a time and it can
+   * be encrypted in place. Chunks use the read buffer pool if one is set. fd
+   * is duplicated and only needs to remain open for the duration of the call.
+   * callback, if set, is called once the whole region is written; if the
+   * region can no longer be read (e.g. the file was truncated), it gets
+   * writeErr() with the bytes written so far.
+   */
+  void writeFile(
+      folly::AsyncTransportWrapper::WriteCallback* callback,
+      int fd,
+      off_t offset,
+      size_t length,
+      folly::WriteFlags flags = folly::WriteFlags::NONE);
+
+  /**
+   * Enable corking of app writes. Writes made during one event loop iteration
+   * are buffered and written together (and therefore in as few records as
+   * possible) at the end of the iteration, or as soon as flushThreshold bytes
+   * are buffered or a write with WriteFlags::EOR is made. A threshold of 0
+   * disables corking.
+   */
+  void setCorkWrites(size_t flushThreshold);
+
+  /**
+   * Pace app writes with a token bucket that fills at bytesPerSecond up to
+   * burst bytes. Written data is queued, after corking, and handed to the
+   * record layer as tokens become available: in multiples of the maximum
+   * record size while more than one record is queued, so paced data still
+   * goes out in full records, and on a timer while the bucket is empty. A
+   * write callback is called once the last of its bytes has been released
+   * and written. burst must be at least the maximum record size. A rate of 0
+   * disables pacing and releases whatever is queued.
+   */
+  void setWritePacing(uint64_t bytesPerSecond, size_t burst);
+
+  /**
+   * App bytes queued for pacing.
+   */
+  size_t getPacedBytes() const {
+    return pacedWrites_.chainLength();
+  }
+
+  /**
+   * Enable adaptive sizing of transport reads. The read size doubles, up to
+   * 64KB, while the transport keeps filling the buffers it is given, and is
+   * halved again when reads come back mostly empty. Once the header of a
+   * record has been read, the buffer for the next read is made large enough
+   * for the rest of that record.
+   */
+  void setAdaptiveReadSize(bool enabled);
+
+  /**
+   * When enabled and the read callback does not accept moved buffers, app
+   * data records are decrypted straight into the memory returned by the read
+   * callback's getReadBuffer() whenever it is large enough for the whole
+   * record, rather than being decrypted into a separate buffer and copied.
+   */
+  void setDecryptIntoReadBuffers(bool enabled) {
+    decryptIntoReadBuffers_ = enabled;
+  }
+
+  /**
+   * Allocate the buffers transport reads land in from pool (for example one
+   * backed by memory registered with the kernel) rather than from the heap.
+   * Transports that hand over their own buffers through readBufferAvailable()
+   * are unaffected. Pass nullptr to go back to heap buffers.
+   */
+  void setReadBufferPool(std::shared_ptr<BufferPool> pool) {
+    readBufferPool_ = std::move(pool);
+  }
+
+  /**
+   * Request MSG_ZEROCOPY sends for writes of at least threshold bytes of
+   * encrypted records, and enable zerocopy on the underlying AsyncSocket if
+   * there is one. The records are never touched again once written, and the
+   * transport holds on to them until the kernel reports the send complete.
+   * Transports that do not support zerocopy send them as usual. 0 (the
+   * default) disables this.
+   */
+  void setZeroCopyWriteThreshold(size_t threshold);
+
+  /**
+   * Encrypt app data straight into iovecs and write them with writev(),
+   * rather than building a chain of records with an IOBuf for every record
+   * header. Ignored while zerocopy writes are enabled, since those need the
+   * records in IOBufs the transport can hold on to.
+   */
+  void setVectoredWrites(bool enabled) {
+    vectoredWrites_ = enabled;
+  }
+
+  /**
+   * Frees memory held by an idle connection: empty read and write buffers
+   * and, in the derived classes, record layer state such as cipher contexts
+   * that can be rebuilt from the keys. Everything is rebuilt when the
+   * connection is next used. Meant for connections that are expected to stay
+   * quiet for a while, such as idle keep-alive connections.
+   */
+  virtual void releaseIdleResources();
+
+  /**
+   * Approximate bytes of memory held by this connection. Derived classes add
+   * the state machine, record layer and cipher state.
+   */
+  virtual MemoryUsage getMemoryUsage() const;
+
+  /**
+   * Count this connection in the MemoryUsageTracker of its EventBase. The
+   * tracker is given the change in getMemoryUsage() at the end of each loop
+   * iteration in which the connection read, wrote, flushed buffered writes
+   * or changed handshake state, and on every reportMemoryUsage() and
+   * releaseIdleResources() call. The connection's usage is removed again
+   * when tracking is disabled, the connection is destroyed or its EventBase
+   * is detached (tracking resumes on the new EventBase once attached).
+   */
+  void setTrackMemoryUsage(bool enabled);
+
+  /**
+   * Report the current memory usage to the tracker, if tracking is enabled.
+   */
+  void reportMemoryUsage();
+
+  /**
+   * Set the read buffer watermarks. Reads from the transport stop once high
+   * bytes of transport data or of undelivered app data are buffered while no
+   * read callback is installed, and start again once both drop to low bytes
+   * or a read callback is installed. Both default to 64KB.
+   */
+  void setReadBufferWatermarks(size_t high, size_t low);
+
+  /**
+   * Track the app bytes that have been written but whose writes have not yet
+   * completed (including corked writes), and notify callback as they cross
+   * high and low. Pass a null callback to stop tracking; writes already in
+   * flight are then no longer counted.
+   */
+  void setWriteBufferWatermarks(
+      size_t high,
+      size_t low,
+      WriteBufferCallback* callback);
+
+  /**
+   * App bytes written but not yet completed. Only tracked while a write
+   * buffer callback is set.
+   */
+  size_t getWriteBufferedBytes() const {
+    return writeBufferedBytes_;
+  }
+
   /**
    * App data usage accounting.
    */
@@ -92,6 +322,14 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
       folly::AsyncTransport::ReplaySafetyCallback* callback) override = 0;
   std::string getApplicationProtocol() noexcept override = 0;
 
+  /**
+   * Whether record protection has been handed over to the kernel, in which
+   * case app data is passed through to and from the transport unchanged.
+   */
+  bool kTLSEnabled() const {
+    return kTLSEnabled_;
+  }
+
   /**
    * Clean up transport on destruction
    */
@@ -106,15 +344,32 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
 
   /**
    * EventBase operations.
+   *
+   * A pending handshake timeout is suspended on detach and rescheduled for
+   * its remaining time on attach, so a connection may be moved to another
+   * EventBase mid-handshake. Paced writes likewise stay queued while
+   * detached.
    */
   void attachTimeoutManager(folly::TimeoutManager* manager) {
     handshakeTimeout_.attachTimeoutManager(manager);
+    resumeHandshakeTimeout();
+    pacingTimeout_.attachTimeoutManager(manager);
+    releasePacedWrites();
   }
   void detachTimeoutManager() {
+    suspendHandshakeTimeout();
     handshakeTimeout_.detachTimeoutManager();
+    pacingTimeout_.cancelTimeout();
+    pacingTimeout_.detachTimeoutManager();
   }
   void attachEventBase(folly::EventBase* eventBase) override {
+    if (trackMemoryUsage_) {
+      startTrackingMemoryUsage(*eventBase);
+    }
     handshakeTimeout_.attachEventBase(eventBase);
+    resumeHandshakeTimeout();
+    pacingTimeout_.attachEventBase(eventBase);
+    releasePacedWrites();
     transport_->attachEventBase(eventBase);
     // we want to avoid setting a read cb on a bad transport (i.e. closed or
     // disconnected) unless we have a read callback we can pass the errors to.
@@ -123,14 +378,16 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
     }
   }
   void detachEventBase() override {
+    writeCorkedWrites();
+    stopTrackingMemoryUsage();
+    suspendHandshakeTimeout();
     handshakeTimeout_.detachEventBase();
+    pacingTimeout_.cancelTimeout();
+    pacingTimeout_.detachEventBase();
     transport_->setReadCB(nullptr);
     transport_->detachEventBase();
   }
   bool isDetachable() const override {
-    if (handshakeTimeout_.isScheduled()) {
-      return false;
-    }
     // Since we always have a read callback on the underlying transport,
     // transport_->isDetachable() would always return false.  We need to see if
     // the transport is detachable independent of our callback.
@@ -147,6 +404,32 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
    */
   virtual void startTransportReads();
 
+  /**
+   * Stop reading raw data from the transport.
+   */
+  void stopTransportReads();
+
+  /**
+   * Report memory usage at the end of this loop iteration, if tracking is
+   * enabled.
+   */
+  void scheduleMemoryUsageReport();
+
+  /**
+   * Encoded size of the certificates in chain, other than counted.
+   */
+  static size_t getCertChainBytes(
+      const std::vector<std::shared_ptr<const PeerCert>>& chain,
+      const Cert* counted);
+
+  /**
+   * Whether app writes are still corked or waiting to be paced.
+   */
+  bool hasHeldWrites() const {
+    return !corkedWrites_.empty() || !corkedCallbacks_.empty() ||
+        !pacedWrites_.empty();
+  }
+
   /**
    * Interface for the derived class to schedule a handshake timeout.
    *
@@ -156,6 +439,70 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
   virtual void startHandshakeTimeout(std::chrono::milliseconds);
   virtual void cancelHandshakeTimeout();
 
+  /**
+   * Switch to passing app data through to the transport without going through
+   * the record layer. To be called by the derived class once kTLS has been
+   * set up on the underlying socket. Any data already in transportReadBuf_
+   * must have been processed before this is called.
+   */
+  void startKTLSPassthrough();
+
+  /**
+   * Write encrypted records produced by the state machine to the transport.
+   */
+  void writeRecordsToTransport(
+      folly::AsyncTransportWrapper::WriteCallback* callback,
+      std::unique_ptr<folly::IOBuf>&& records,
+      folly::WriteFlags flags);
+
+  /**
+   * As above, for records the state machine wrote into the iovecs returned
+   * by makeWriteIovecs(). They are kept alive until the write completes.
+   */
+  void writeRecordsToTransport(
+      folly::AsyncTransportWrapper::WriteCallback* callback,
+      std::shared_ptr<RecordIovecs> records,
+      folly::WriteFlags flags);
+
+  /**
+   * Storage for the state machine to write the records of an app write into
+   * (AppWrite::iovecs), or nullptr if they should be returned as a chain.
+   */
+  std::shared_ptr<RecordIovecs> makeWriteIovecs() const;
+
+  /**
+   * Make this object the provider of memory to decrypt records into for
+   * recordLayer (see setDecryptIntoReadBuffers()). Derived classes should call
+   * this whenever the state machine may have installed a new read record
+   * layer.
+   */
+  void attachReadRecordLayer(ReadRecordLayer* recordLayer) {
+    if (recordLayer) {
+      recordLayer->setPlaintextBufferProvider(this);
+    }
+  }
+
+  /**
+   * Pause or resume transport reads according to the read buffer watermarks.
+   * Derived classes should call this once the state machine has consumed
+   * what it can of transportReadBuf_.
+   */
+  void checkBufLen();
+
+  /**
+   * Write out any corked and paced app writes now, regardless of the pacing
+   * rate. Derived classes should call this before closing so that buffered
+   * data is not reordered with close_notify.
+   */
+  void flushCorkedWrites();
+
+  /**
+   * Returns a single callback for a write made by merging several writes, see
+   * fizz::combineWriteCallbacks().
+   */
+  static folly::AsyncTransportWrapper::WriteCallback* combineWriteCallbacks(
+      std::vector<MergedWrite> writes);
+
   /**
    * Interfaces for the derived class to interact with the app level read
    * callback.
@@ -180,7 +527,7 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
   virtual void transportError(const folly::AsyncSocketException& ex) = 0;
   /**
    * Alert the derived class that additional data is available in
-   * transportReadBuf_.
+   * transportReadBuf_. Called with a DestructorGuard held on this.
    */
   virtual void transportDataAvailable() = 0;
 
@@ -198,6 +545,11 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
   void readEOF() noexcept override;
   void readErr(const folly::AsyncSocketException& ex) noexcept override;
 
+  /**
+   * PlaintextBufferProvider implementation.
+   */
+  folly::MutableByteRange getPlaintextBuffer(size_t length) override;
+
   /**
    * WriteCallback implementation, for use with handshake messages.
    */
@@ -206,16 +558,110 @@ class AsyncFizzBase : public folly::WriteChainAsyncTransportWrapper<
       size_t bytesWritten,
       const folly::AsyncSocketException& ex) noexcept override;
 
-  void checkBufLen();
+  class BufferedWriteCallback;
+  class FileWriter;
+
+  void writeBufferDrained(size_t bytes);
+
+  /**
+   * Returns how many more bytes are needed to complete the record at the
+   * front of transportReadBuf_, or 0 if that is not known.
+   */
+  size_t getPendingRecordBytes() const;
+  void updateReadSize(size_t bytesRead);
+
+  void writeToTransport(
+      folly::AsyncTransportWrapper::WriteCallback* callback,
+      std::unique_ptr<folly::IOBuf>&& buf,
+      folly::WriteFlags flags);
+
+  /**
+   * Write out corked app writes, through pacing if it is enabled.
+   */
+  void writeCorkedWrites();
+
+  void writeUnpaced(
+      folly::AsyncTransportWrapper::WriteCallback* callback,
+      std::unique_ptr<folly::IOBuf>&& buf,
+      folly::WriteFlags flags);
+
+  /**
+   * Release as much paced data as the token bucket allows (or all of it if
+   * force is set), and schedule the pacing timeout for the rest.
+   */
+  void releasePacedWrites(bool force = false);
 
   void handshakeTimeoutExpired() noexcept;
 
+  void startTrackingMemoryUsage(folly::EventBase& evb);
+  void stopTrackingMemoryUsage();
+
+  void suspendHandshakeTimeout();
+  void resumeHandshakeTimeout();
+
   ReadCallback* readCallback_{nullptr};
   std::unique_ptr<folly::IOBuf> appDataBuf_;
 
   size_t appBytesWritten_{0};
   size_t appBytesReceived_{0};
 
+  bool kTLSEnabled_{false};
+
+  bool adaptiveReadSize_{false};
+  size_t readSize_{0};
+  size_t lastReadBufferSize_{0};
+
+  std::shared_ptr<BufferPool> readBufferPool_;
+
+  size_t zeroCopyWriteThreshold_{0};
+
+  bool vectoredWrites_{false};
+
+  bool trackMemoryUsage_{false};
+  // Set while the connection is counted, along with what it last reported.
+  MemoryUsageTracker* memoryUsageTracker_{nullptr};
+  MemoryUsage reportedMemoryUsage_;
+  MemoryUsageReportCallback memoryUsageReportCallback_;
+
+  bool decryptIntoReadBuffers_{false};
+  // Read callback memory handed to the record layer that has not been
+  // delivered yet, and the callback it came from.
+  uint8_t* providedBuffer_{nullptr};
+  ReadCallback* providedBufferCallback_{nullptr};
+
+  size_t readHighWatermark_;
+  size_t readLowWatermark_;
+  bool readsPaused_{false};
+
+  size_t writeHighWatermark_{0};
+  size_t writeLowWatermark_{0};
+  WriteBufferCallback* writeBufferCallback_{nullptr};
+  size_t writeBufferedBytes_{0};
+  bool writeBufferAboveHighWatermark_{false};
+  // Bumped when tracking is reset, so writes from before no longer count.
+  uint64_t writeBufferEpoch_{0};
+
+  size_t corkFlushThreshold_{0};
+  folly::IOBufQueue corkedWrites_{folly::IOBufQueue::cacheChainLength()};
+  std::vector<MergedWrite> corkedCallbacks_;
+  folly::WriteFlags corkedFlags_{folly::WriteFlags::NONE};
+  CorkFlushCallback corkFlushCallback_;
+
+  struct PacedWrite {
+    // Offset, in paced bytes, just past the end of the write.
+    size_t end;
+    folly::AsyncTransportWrapper::WriteCallback* callback;
+    folly::WriteFlags flags;
+  };
+
+  folly::Optional<TokenBucket> pacingBucket_;
+  folly::IOBufQueue pacedWrites_{folly::IOBufQueue::cacheChainLength()};
+  std::deque<PacedWrite> pacedWriteEnds_;
+  size_t pacedBytesQueued_{0};
+  size_t pacedBytesReleased_{0};
+  PacingTimeout pacingTimeout_;
+
   HandshakeTimeout handshakeTimeout_;
+  folly::Optional<std::chrono::steady_clock::time_point> handshakeDeadline_;
 };
 } // namespace fizz
@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/AsyncFizzStream.h>
+
+using folly::AsyncSocketException;
+
+namespace fizz {
+
+namespace {
+constexpr size_t kReadBufferSize = 4000;
+} // namespace
+
+AsyncFizzStream::~AsyncFizzStream() {
+  if (readPromise_) {
+    transport_.setReadCB(nullptr);
+  }
+}
+
+folly::Future<std::unique_ptr<folly::IOBuf>> AsyncFizzStream::read() {
+  if (readPromise_) {
+    return folly::makeFuture<std::unique_ptr<folly::IOBuf>>(
+        std::logic_error("read already outstanding"));
+  }
+  readPromise_.emplace();
+  auto future = readPromise_->getFuture();
+  // Delivers anything already buffered in the transport right away.
+  transport_.setReadCB(this);
+  return future;
+}
+
+folly::Future<folly::Unit> AsyncFizzStream::write(
+    std::unique_ptr<folly::IOBuf> buf,
+    folly::WriteFlags flags) {
+  writePromises_.emplace_back();
+  auto future = writePromises_.back().getFuture();
+  transport_.writeChain(this, std::move(buf), flags);
+  return future;
+}
+
+folly::Promise<std::unique_ptr<folly::IOBuf>> AsyncFizzStream::finishRead() {
+  transport_.setReadCB(nullptr);
+  auto promise = std::move(*readPromise_);
+  readPromise_.clear();
+  return promise;
+}
+
+void AsyncFizzStream::getReadBuffer(void** bufReturn, size_t* lenReturn) {
+  auto range = readBuf_.preallocate(kReadBufferSize, kReadBufferSize);
+  *bufReturn = range.first;
+  *lenReturn = range.second;
+}
+
+void AsyncFizzStream::readDataAvailable(size_t len) noexcept {
+  readBuf_.postallocate(len);
+  if (readPromise_) {
+    finishRead().setValue(readBuf_.move());
+  }
+}
+
+bool AsyncFizzStream::isBufferMovable() noexcept {
+  return true;
+}
+
+void AsyncFizzStream::readBufferAvailable(
+    std::unique_ptr<folly::IOBuf> data) noexcept {
+  if (readPromise_) {
+    finishRead().setValue(std::move(data));
+  }
+}
+
+void AsyncFizzStream::readEOF() noexcept {
+  if (readPromise_) {
+    finishRead().setValue(nullptr);
+  }
+}
+
+void AsyncFizzStream::readErr(const AsyncSocketException& ex) noexcept {
+  if (readPromise_) {
+    finishRead().setException(ex);
+  }
+}
+
+void AsyncFizzStream::writeSuccess() noexcept {
+  DCHECK(!writePromises_.empty());
+  auto promise = std::move(writePromises_.front());
+  writePromises_.pop_front();
+  promise.setValue();
+}
+
+void AsyncFizzStream::writeErr(
+    size_t /* bytesWritten */,
+    const AsyncSocketException& ex) noexcept {
+  DCHECK(!writePromises_.empty());
+  auto promise = std::move(writePromises_.front());
+  writePromises_.pop_front();
+  promise.setException(ex);
+}
+} // namespace fizz
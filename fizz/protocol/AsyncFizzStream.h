@@ -0,0 +1,95 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/AsyncFizzBase.h>
+#include <folly/futures/Future.h>
+
+#include <deque>
+
+namespace fizz {
+
+/**
+ * Future based interface to the app data of an AsyncFizzBase, for code that
+ * would rather chain (or, with folly::coro, co_await) reads and writes than
+ * implement ReadCallback and WriteCallback.
+ *
+ * Reads are pulled: the transport's read callback is only installed while a
+ * read is outstanding, so data the app has not asked for stays buffered in
+ * the transport and is subject to its read buffer watermarks. Decrypted
+ * records are handed out as the IOBufs the record layer produced, without
+ * copying.
+ *
+ * Not thread safe; only use from the thread running the transport's
+ * EventBase. The stream must outlive its outstanding reads and writes (the
+ * transport's closeNow() completes them).
+ */
+class AsyncFizzStream : private folly::AsyncTransportWrapper::ReadCallback,
+                        private folly::AsyncTransportWrapper::WriteCallback {
+ public:
+  explicit AsyncFizzStream(AsyncFizzBase& transport) : transport_(transport) {}
+
+  ~AsyncFizzStream() override;
+
+  AsyncFizzStream(const AsyncFizzStream&) = delete;
+  AsyncFizzStream& operator=(const AsyncFizzStream&) = delete;
+
+  /**
+   * Returns the next app data received, which may span several records.
+   * Completes with nullptr at the end of the stream, and with an
+   * AsyncSocketException on transport errors (a read made after the
+   * transport has already closed fails with NOT_OPEN). Only one read may be
+   * outstanding at a time.
+   */
+  folly::Future<std::unique_ptr<folly::IOBuf>> read();
+
+  /**
+   * Writes buf as app data. Completes once the transport reports the write
+   * done, or with an AsyncSocketException if it failed. Any number of writes
+   * may be outstanding; they complete in order.
+   */
+  folly::Future<folly::Unit> write(
+      std::unique_ptr<folly::IOBuf> buf,
+      folly::WriteFlags flags = folly::WriteFlags::NONE);
+
+ private:
+  /**
+   * ReadCallback implementation.
+   */
+  void getReadBuffer(void** bufReturn, size_t* lenReturn) override;
+  void readDataAvailable(size_t len) noexcept override;
+  bool isBufferMovable() noexcept override;
+  void readBufferAvailable(
+      std::unique_ptr<folly::IOBuf> data) noexcept override;
+  void readEOF() noexcept override;
+  void readErr(const folly::AsyncSocketException& ex) noexcept override;
+
+  /**
+   * WriteCallback implementation.
+   */
+  void writeSuccess() noexcept override;
+  void writeErr(
+      size_t bytesWritten,
+      const folly::AsyncSocketException& ex) noexcept override;
+
+  /**
+   * Uninstalls the read callback and returns the outstanding read.
+   */
+  folly::Promise<std::unique_ptr<folly::IOBuf>> finishRead();
+
+  AsyncFizzBase& transport_;
+
+  folly::Optional<folly::Promise<std::unique_ptr<folly::IOBuf>>> readPromise_;
+  // Only used if the transport asks for a read buffer, which it does not do
+  // while we accept moved buffers.
+  folly::IOBufQueue readBuf_{folly::IOBufQueue::cacheChainLength()};
+
+  std::deque<folly::Promise<folly::Unit>> writePromises_;
+};
+} // namespace fizz
@@ -0,0 +1,34 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+
+namespace fizz {
+
+/**
+ * Returns a shared_ptr to p that doesn't own it and has no control block, so
+ * copying and destroying it doesn't touch a reference count.
+ *
+ * Objects shared by every connection in the process, like a server's
+ * FizzServerContext and its certificates, otherwise have their reference
+ * count cache line bounced between cores on every connection. If such an
+ * object is guaranteed to outlive its connections, handing a borrowed
+ * pointer to e.g. AsyncFizzServer avoids that:
+ *
+ *   auto server = new AsyncFizzServer(
+ *       std::move(socket), borrowedPtr(context.get()));
+ *
+ * Weak pointers can't be made from a borrowed pointer.
+ */
+template <typename T>
+std::shared_ptr<T> borrowedPtr(T* p) {
+  return std::shared_ptr<T>(std::shared_ptr<T>(), p);
+}
+} // namespace fizz
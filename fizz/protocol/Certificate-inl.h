@@ -6,6 +6,7 @@
  *  LICENSE file in the root directory of this source tree.
  */
 
+#include <fizz/protocol/AllocationStats.h>
 #include <folly/ScopeGuard.h>
 #include <folly/ssl/OpenSSLCertUtils.h>
 #include <openssl/x509.h>
@@ -33,10 +34,22 @@ inline std::vector<SignatureScheme> CertUtils::getSigSchemes<KeyType::RSA>() {
   return {SignatureScheme::rsa_pss_sha256};
 }
 
+template <>
+inline std::vector<SignatureScheme>
+CertUtils::getSigSchemes<KeyType::ED25519>() {
+  return {SignatureScheme::ed25519};
+}
+
+template <>
+inline std::vector<SignatureScheme> CertUtils::getSigSchemes<KeyType::ED448>() {
+  return {SignatureScheme::ed448};
+}
+
 template <KeyType T>
 SelfCertImpl<T>::SelfCertImpl(
     folly::ssl::EvpPkeyUniquePtr pkey,
-    std::vector<folly::ssl::X509UniquePtr> certs) {
+    std::vector<folly::ssl::X509UniquePtr> certs,
+    ENGINE* engine) {
   if (certs.size() == 0) {
     throw std::runtime_error("Must supply at least 1 cert");
   }
@@ -45,18 +58,23 @@ SelfCertImpl<T>::SelfCertImpl(
   }
   // TODO: more strict validation of chaining requirements.
   signature_.setKey(std::move(pkey));
+  signature_.setEngine(engine);
   certs_ = std::move(certs);
+  identity_ = folly::ssl::OpenSSLCertUtils::getCommonName(*certs_.front())
+                  .value_or("");
+  altIdentities_ =
+      folly::ssl::OpenSSLCertUtils::getSubjectAltNames(*certs_.front());
+  encodedCertMessage_ = encodeHandshake(getCertMessage());
 }
 
 template <KeyType T>
 std::string SelfCertImpl<T>::getIdentity() const {
-  return folly::ssl::OpenSSLCertUtils::getCommonName(*certs_.front())
-      .value_or("");
+  return identity_;
 }
 
 template <KeyType T>
 std::vector<std::string> SelfCertImpl<T>::getAltIdentities() const {
-  return folly::ssl::OpenSSLCertUtils::getSubjectAltNames(*certs_.front());
+  return altIdentities_;
 }
 
 template <KeyType T>
@@ -66,150 +84,247 @@ CertificateMsg SelfCertImpl<T>::getCertMessage(
       certs_, std::move(certificateRequestContext));
 }
 
+template <KeyType T>
+Buf SelfCertImpl<T>::getEncodedCertMessage() const {
+  return encodedCertMessage_->clone();
+}
+
 template <KeyType T>
 std::vector<SignatureScheme> SelfCertImpl<T>::getSigSchemes() const {
   return CertUtils::getSigSchemes<T>();
 }
 
+namespace detail {
 template <>
-inline Buf SelfCertImpl<KeyType::P256>::sign(
+inline Buf sign<KeyType::P256>(
+    const OpenSSLSignature<KeyType::P256>& signature,
     SignatureScheme scheme,
-    CertificateVerifyContext context,
-    folly::ByteRange toBeSigned) const {
-  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+    folly::ByteRange signData) {
   switch (scheme) {
     case SignatureScheme::ecdsa_secp256r1_sha256:
-      return signature_.sign<SignatureScheme::ecdsa_secp256r1_sha256>(
-          signData->coalesce());
+      return signature.sign<SignatureScheme::ecdsa_secp256r1_sha256>(signData);
     default:
       throw std::runtime_error("Unsupported signature scheme");
   }
 }
 
 template <>
-inline Buf SelfCertImpl<KeyType::P384>::sign(
+inline Buf sign<KeyType::P384>(
+    const OpenSSLSignature<KeyType::P384>& signature,
     SignatureScheme scheme,
-    CertificateVerifyContext context,
-    folly::ByteRange toBeSigned) const {
-  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+    folly::ByteRange signData) {
   switch (scheme) {
     case SignatureScheme::ecdsa_secp384r1_sha384:
-      return signature_.sign<SignatureScheme::ecdsa_secp384r1_sha384>(
-          signData->coalesce());
+      return signature.sign<SignatureScheme::ecdsa_secp384r1_sha384>(signData);
     default:
       throw std::runtime_error("Unsupported signature scheme");
   }
 }
 
 template <>
-inline Buf SelfCertImpl<KeyType::P521>::sign(
+inline Buf sign<KeyType::P521>(
+    const OpenSSLSignature<KeyType::P521>& signature,
     SignatureScheme scheme,
-    CertificateVerifyContext context,
-    folly::ByteRange toBeSigned) const {
-  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+    folly::ByteRange signData) {
   switch (scheme) {
     case SignatureScheme::ecdsa_secp521r1_sha512:
-      return signature_.sign<SignatureScheme::ecdsa_secp521r1_sha512>(
-          signData->coalesce());
+      return signature.sign<SignatureScheme::ecdsa_secp521r1_sha512>(signData);
     default:
       throw std::runtime_error("Unsupported signature scheme");
   }
 }
 
 template <>
-inline Buf SelfCertImpl<KeyType::RSA>::sign(
+inline Buf sign<KeyType::RSA>(
+    const OpenSSLSignature<KeyType::RSA>& signature,
     SignatureScheme scheme,
-    CertificateVerifyContext context,
-    folly::ByteRange toBeSigned) const {
-  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+    folly::ByteRange signData) {
   switch (scheme) {
     case SignatureScheme::rsa_pss_sha256:
-      return signature_.sign<SignatureScheme::rsa_pss_sha256>(
-          signData->coalesce());
+      return signature.sign<SignatureScheme::rsa_pss_sha256>(signData);
     default:
       throw std::runtime_error("Unsupported signature scheme");
   }
 }
 
-template <KeyType T>
-PeerCertImpl<T>::PeerCertImpl(folly::ssl::X509UniquePtr cert) {
-  folly::ssl::EvpPkeyUniquePtr key(X509_get_pubkey(cert.get()));
-  if (!key) {
-    throw std::runtime_error("could not get key from cert");
+template <>
+inline Buf sign<KeyType::ED25519>(
+    const OpenSSLSignature<KeyType::ED25519>& signature,
+    SignatureScheme scheme,
+    folly::ByteRange signData) {
+  switch (scheme) {
+    case SignatureScheme::ed25519:
+      return signature.sign<SignatureScheme::ed25519>(signData);
+    default:
+      throw std::runtime_error("Unsupported signature scheme");
   }
-  signature_.setKey(std::move(key));
-  cert_ = std::move(cert);
 }
 
-template <KeyType T>
-std::string PeerCertImpl<T>::getIdentity() const {
-  return folly::ssl::OpenSSLCertUtils::getCommonName(*cert_).value_or("");
+template <>
+inline Buf sign<KeyType::ED448>(
+    const OpenSSLSignature<KeyType::ED448>& signature,
+    SignatureScheme scheme,
+    folly::ByteRange signData) {
+  switch (scheme) {
+    case SignatureScheme::ed448:
+      return signature.sign<SignatureScheme::ed448>(signData);
+    default:
+      throw std::runtime_error("Unsupported signature scheme");
+  }
 }
 
 template <>
-inline void PeerCertImpl<KeyType::P256>::verify(
+inline void verify<KeyType::P256>(
+    const OpenSSLSignature<KeyType::P256>& signature,
     SignatureScheme scheme,
-    CertificateVerifyContext context,
-    folly::ByteRange toBeSigned,
-    folly::ByteRange signature) const {
-  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+    folly::ByteRange signData,
+    folly::ByteRange sig) {
   switch (scheme) {
     case SignatureScheme::ecdsa_secp256r1_sha256:
-      return signature_.verify<SignatureScheme::ecdsa_secp256r1_sha256>(
-          signData->coalesce(), signature);
+      return signature.verify<SignatureScheme::ecdsa_secp256r1_sha256>(
+          signData, sig);
     default:
       throw std::runtime_error("Unsupported signature scheme");
   }
 }
 
 template <>
-inline void PeerCertImpl<KeyType::P384>::verify(
+inline void verify<KeyType::P384>(
+    const OpenSSLSignature<KeyType::P384>& signature,
     SignatureScheme scheme,
-    CertificateVerifyContext context,
-    folly::ByteRange toBeSigned,
-    folly::ByteRange signature) const {
-  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+    folly::ByteRange signData,
+    folly::ByteRange sig) {
   switch (scheme) {
     case SignatureScheme::ecdsa_secp384r1_sha384:
-      return signature_.verify<SignatureScheme::ecdsa_secp384r1_sha384>(
-          signData->coalesce(), signature);
+      return signature.verify<SignatureScheme::ecdsa_secp384r1_sha384>(
+          signData, sig);
     default:
       throw std::runtime_error("Unsupported signature scheme");
   }
 }
 
 template <>
-inline void PeerCertImpl<KeyType::P521>::verify(
+inline void verify<KeyType::P521>(
+    const OpenSSLSignature<KeyType::P521>& signature,
     SignatureScheme scheme,
-    CertificateVerifyContext context,
-    folly::ByteRange toBeSigned,
-    folly::ByteRange signature) const {
-  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+    folly::ByteRange signData,
+    folly::ByteRange sig) {
   switch (scheme) {
     case SignatureScheme::ecdsa_secp521r1_sha512:
-      return signature_.verify<SignatureScheme::ecdsa_secp521r1_sha512>(
-          signData->coalesce(), signature);
+      return signature.verify<SignatureScheme::ecdsa_secp521r1_sha512>(
+          signData, sig);
     default:
       throw std::runtime_error("Unsupported signature scheme");
   }
 }
 
 template <>
-inline void PeerCertImpl<KeyType::RSA>::verify(
+inline void verify<KeyType::RSA>(
+    const OpenSSLSignature<KeyType::RSA>& signature,
+    SignatureScheme scheme,
+    folly::ByteRange signData,
+    folly::ByteRange sig) {
+  switch (scheme) {
+    case SignatureScheme::rsa_pss_sha256:
+      return signature.verify<SignatureScheme::rsa_pss_sha256>(signData, sig);
+    default:
+      throw std::runtime_error("Unsupported signature scheme");
+  }
+}
+
+template <>
+inline void verify<KeyType::ED25519>(
+    const OpenSSLSignature<KeyType::ED25519>& signature,
+    SignatureScheme scheme,
+    folly::ByteRange signData,
+    folly::ByteRange sig) {
+  switch (scheme) {
+    case SignatureScheme::ed25519:
+      return signature.verify<SignatureScheme::ed25519>(signData, sig);
+    default:
+      throw std::runtime_error("Unsupported signature scheme");
+  }
+}
+
+template <>
+inline void verify<KeyType::ED448>(
+    const OpenSSLSignature<KeyType::ED448>& signature,
+    SignatureScheme scheme,
+    folly::ByteRange signData,
+    folly::ByteRange sig) {
+  switch (scheme) {
+    case SignatureScheme::ed448:
+      return signature.verify<SignatureScheme::ed448>(signData, sig);
+    default:
+      throw std::runtime_error("Unsupported signature scheme");
+  }
+}
+} // namespace detail
+
+template <KeyType T>
+Buf SelfCertImpl<T>::sign(
     SignatureScheme scheme,
     CertificateVerifyContext context,
-    folly::ByteRange toBeSigned,
-    folly::ByteRange signature) const {
+    folly::ByteRange toBeSigned) const {
+  AllocationStats::Scope allocationScope(AllocationSite::Certificates);
   auto signData = CertUtils::prepareSignData(context, toBeSigned);
+  return detail::sign<T>(signature_, scheme, signData->coalesce());
+}
+
+template <KeyType T>
+std::vector<Buf> SelfCertImpl<T>::signBatch(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    const std::vector<folly::ByteRange>& toBeSigned) const {
+  return SelfCert::signBatch(scheme, context, toBeSigned);
+}
+
+template <>
+inline std::vector<Buf> SelfCertImpl<KeyType::RSA>::signBatch(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    const std::vector<folly::ByteRange>& toBeSigned) const {
+  std::vector<Buf> signData;
+  std::vector<folly::ByteRange> ranges;
+  signData.reserve(toBeSigned.size());
+  ranges.reserve(toBeSigned.size());
+  for (const auto& data : toBeSigned) {
+    signData.push_back(CertUtils::prepareSignData(context, data));
+    ranges.push_back(signData.back()->coalesce());
+  }
   switch (scheme) {
     case SignatureScheme::rsa_pss_sha256:
-      return signature_.verify<SignatureScheme::rsa_pss_sha256>(
-          signData->coalesce(), signature);
+      return signature_.signBatch<SignatureScheme::rsa_pss_sha256>(ranges);
     default:
       throw std::runtime_error("Unsupported signature scheme");
   }
 }
 
+template <KeyType T>
+PeerCertImpl<T>::PeerCertImpl(folly::ssl::X509UniquePtr cert) {
+  folly::ssl::EvpPkeyUniquePtr key(X509_get_pubkey(cert.get()));
+  if (!key) {
+    throw std::runtime_error("could not get key from cert");
+  }
+  signature_.setKey(std::move(key));
+  cert_ = std::move(cert);
+}
+
+template <KeyType T>
+std::string PeerCertImpl<T>::getIdentity() const {
+  return folly::ssl::OpenSSLCertUtils::getCommonName(*cert_).value_or("");
+}
+
+template <KeyType T>
+void PeerCertImpl<T>::verify(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    folly::ByteRange toBeSigned,
+    folly::ByteRange signature) const {
+  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+  detail::verify<T>(signature_, scheme, signData->coalesce(), signature);
+}
+
 template <KeyType T>
 folly::ssl::X509UniquePtr PeerCertImpl<T>::getX509() const {
   X509_up_ref(cert_.get());
@@ -221,4 +336,99 @@ folly::ssl::X509UniquePtr SelfCertImpl<T>::getX509() const {
   X509_up_ref(certs_.front().get());
   return folly::ssl::X509UniquePtr(certs_.front().get());
 }
+
+template <KeyType T>
+RawPublicKeySelfCert<T>::RawPublicKeySelfCert(
+    folly::ssl::EvpPkeyUniquePtr pkey,
+    std::string identity)
+    : identity_(std::move(identity)) {
+  spki_ = CertUtils::getSubjectPublicKeyInfo(pkey.get());
+  signature_.setKey(std::move(pkey));
+  encodedCertMessage_ = encodeHandshake(getCertMessage());
+}
+
+template <KeyType T>
+std::string RawPublicKeySelfCert<T>::getIdentity() const {
+  return identity_;
+}
+
+template <KeyType T>
+std::vector<std::string> RawPublicKeySelfCert<T>::getAltIdentities() const {
+  return {};
+}
+
+template <KeyType T>
+std::vector<SignatureScheme> RawPublicKeySelfCert<T>::getSigSchemes() const {
+  return CertUtils::getSigSchemes<T>();
+}
+
+template <KeyType T>
+CertificateMsg RawPublicKeySelfCert<T>::getCertMessage(
+    Buf certificateRequestContext) const {
+  CertificateEntry entry;
+  entry.cert_data = spki_->clone();
+  CertificateMsg msg;
+  msg.certificate_request_context = std::move(certificateRequestContext);
+  msg.certificate_list.push_back(std::move(entry));
+  return msg;
+}
+
+template <KeyType T>
+Buf RawPublicKeySelfCert<T>::getEncodedCertMessage() const {
+  return encodedCertMessage_->clone();
+}
+
+template <KeyType T>
+CertificateType RawPublicKeySelfCert<T>::getCertificateType() const {
+  return CertificateType::RawPublicKey;
+}
+
+template <KeyType T>
+Buf RawPublicKeySelfCert<T>::sign(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    folly::ByteRange toBeSigned) const {
+  AllocationStats::Scope allocationScope(AllocationSite::Certificates);
+  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+  return detail::sign<T>(signature_, scheme, signData->coalesce());
+}
+
+template <KeyType T>
+folly::ssl::X509UniquePtr RawPublicKeySelfCert<T>::getX509() const {
+  return nullptr;
+}
+
+template <KeyType T>
+RawPublicKeyPeerCertImpl<T>::RawPublicKeyPeerCertImpl(
+    folly::ssl::EvpPkeyUniquePtr key,
+    Buf spki)
+    : spki_(std::move(spki)) {
+  signature_.setKey(std::move(key));
+  identity_ = CertUtils::getSpkiHash(spki_->coalesce());
+}
+
+template <KeyType T>
+std::string RawPublicKeyPeerCertImpl<T>::getIdentity() const {
+  return identity_;
+}
+
+template <KeyType T>
+void RawPublicKeyPeerCertImpl<T>::verify(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    folly::ByteRange toBeSigned,
+    folly::ByteRange signature) const {
+  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+  detail::verify<T>(signature_, scheme, signData->coalesce(), signature);
+}
+
+template <KeyType T>
+folly::ByteRange RawPublicKeyPeerCertImpl<T>::getSubjectPublicKeyInfo() const {
+  return spki_->coalesce();
+}
+
+template <KeyType T>
+folly::ssl::X509UniquePtr RawPublicKeyPeerCertImpl<T>::getX509() const {
+  return nullptr;
+}
 } // namespace fizz
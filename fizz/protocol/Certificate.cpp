@@ -8,6 +8,10 @@
 
 #include <fizz/protocol/Certificate.h>
 
+#include <fizz/crypto/Sha256.h>
+#include <fizz/protocol/AllocationStats.h>
+#include <folly/String.h>
+
 namespace {
 int getCurveName(EVP_PKEY* key) {
   auto ecKey = EVP_PKEY_get0_EC_KEY(key);
@@ -16,10 +20,36 @@ int getCurveName(EVP_PKEY* key) {
   }
   return 0;
 }
+
 } // namespace
 
 namespace fizz {
 
+KeyType CertUtils::getKeyType(EVP_PKEY* key) {
+  if (EVP_PKEY_id(key) == EVP_PKEY_RSA) {
+    return KeyType::RSA;
+  } else if (EVP_PKEY_id(key) == EVP_PKEY_EC) {
+    switch (getCurveName(key)) {
+      case NID_X9_62_prime256v1:
+        return KeyType::P256;
+      case NID_secp384r1:
+        return KeyType::P384;
+      case NID_secp521r1:
+        return KeyType::P521;
+      default:
+        break;
+    }
+  }
+#if FIZZ_OPENSSL_HAS_ED25519
+  if (EVP_PKEY_id(key) == EVP_PKEY_ED25519) {
+    return KeyType::ED25519;
+  } else if (EVP_PKEY_id(key) == EVP_PKEY_ED448) {
+    return KeyType::ED448;
+  }
+#endif
+  throw std::runtime_error("unsupported key type");
+}
+
 Buf CertUtils::prepareSignData(
     CertificateVerifyContext context,
     folly::ByteRange toBeSigned) {
@@ -27,14 +57,22 @@ Buf CertUtils::prepareSignData(
       "TLS 1.3, server CertificateVerify";
   static constexpr folly::StringPiece kClientLabel =
       "TLS 1.3, client CertificateVerify";
+  static constexpr folly::StringPiece kDelegatedCredentialLabel =
+      "TLS, server delegated credentials";
   static constexpr size_t kSigPrefixLen = 64;
   static constexpr uint8_t kSigPrefix = 32;
 
   folly::StringPiece label;
-  if (context == CertificateVerifyContext::Server) {
-    label = kServerLabel;
-  } else {
-    label = kClientLabel;
+  switch (context) {
+    case CertificateVerifyContext::Server:
+      label = kServerLabel;
+      break;
+    case CertificateVerifyContext::Client:
+      label = kClientLabel;
+      break;
+    case CertificateVerifyContext::DelegatedCredential:
+      label = kDelegatedCredentialLabel;
+      break;
   }
 
   size_t sigDataLen = kSigPrefixLen + label.size() + 1 + toBeSigned.size();
@@ -82,6 +120,7 @@ CertificateMsg CertUtils::getCertMessage(
 }
 
 std::unique_ptr<PeerCert> CertUtils::makePeerCert(Buf certData) {
+  AllocationStats::Scope allocationScope(AllocationSite::Certificates);
   if (certData->empty()) {
     throw std::runtime_error("empty peer cert");
   }
@@ -100,26 +139,123 @@ std::unique_ptr<PeerCert> CertUtils::makePeerCert(Buf certData) {
   if (!pubKey) {
     throw std::runtime_error("couldn't get pubkey from peer cert");
   }
-  if (EVP_PKEY_id(pubKey.get()) == EVP_PKEY_RSA) {
-    return std::make_unique<PeerCertImpl<KeyType::RSA>>(std::move(cert));
-  } else if (EVP_PKEY_id(pubKey.get()) == EVP_PKEY_EC) {
-    switch (getCurveName(pubKey.get())) {
-      case NID_X9_62_prime256v1:
-        return std::make_unique<PeerCertImpl<KeyType::P256>>(std::move(cert));
-      case NID_secp384r1:
-        return std::make_unique<PeerCertImpl<KeyType::P384>>(std::move(cert));
-      case NID_secp521r1:
-        return std::make_unique<PeerCertImpl<KeyType::P521>>(std::move(cert));
-      default:
-        break;
-    }
+  switch (getKeyType(pubKey.get())) {
+    case KeyType::RSA:
+      return std::make_unique<PeerCertImpl<KeyType::RSA>>(std::move(cert));
+    case KeyType::P256:
+      return std::make_unique<PeerCertImpl<KeyType::P256>>(std::move(cert));
+    case KeyType::P384:
+      return std::make_unique<PeerCertImpl<KeyType::P384>>(std::move(cert));
+    case KeyType::P521:
+      return std::make_unique<PeerCertImpl<KeyType::P521>>(std::move(cert));
+    case KeyType::ED25519:
+      return std::make_unique<PeerCertImpl<KeyType::ED25519>>(std::move(cert));
+    case KeyType::ED448:
+      return std::make_unique<PeerCertImpl<KeyType::ED448>>(std::move(cert));
   }
   throw std::runtime_error("unknown peer cert type");
 }
 
+std::unique_ptr<RawPublicKeyPeerCert> CertUtils::makeRawPublicKeyPeerCert(
+    Buf spki) {
+  if (spki->empty()) {
+    throw std::runtime_error("empty peer raw public key");
+  }
+
+  auto range = spki->coalesce();
+  const unsigned char* begin = range.data();
+  folly::ssl::EvpPkeyUniquePtr key(d2i_PUBKEY(nullptr, &begin, range.size()));
+  if (!key) {
+    throw std::runtime_error("could not read raw public key");
+  }
+  if (begin != range.data() + range.size()) {
+    throw std::runtime_error("trailing data after raw public key");
+  }
+
+  switch (getKeyType(key.get())) {
+    case KeyType::RSA:
+      return std::make_unique<RawPublicKeyPeerCertImpl<KeyType::RSA>>(
+          std::move(key), std::move(spki));
+    case KeyType::P256:
+      return std::make_unique<RawPublicKeyPeerCertImpl<KeyType::P256>>(
+          std::move(key), std::move(spki));
+    case KeyType::P384:
+      return std::make_unique<RawPublicKeyPeerCertImpl<KeyType::P384>>(
+          std::move(key), std::move(spki));
+    case KeyType::P521:
+      return std::make_unique<RawPublicKeyPeerCertImpl<KeyType::P521>>(
+          std::move(key), std::move(spki));
+    case KeyType::ED25519:
+      return std::make_unique<RawPublicKeyPeerCertImpl<KeyType::ED25519>>(
+          std::move(key), std::move(spki));
+    case KeyType::ED448:
+      return std::make_unique<RawPublicKeyPeerCertImpl<KeyType::ED448>>(
+          std::move(key), std::move(spki));
+  }
+  throw std::runtime_error("unknown raw public key type");
+}
+
+std::unique_ptr<SelfCert> CertUtils::makeRawPublicKeySelfCert(
+    std::string keyData,
+    std::string identity) {
+  folly::ssl::BioUniquePtr b(BIO_new_mem_buf(keyData.data(), keyData.size()));
+  if (!b) {
+    throw std::runtime_error("failed to create BIO");
+  }
+  folly::ssl::EvpPkeyUniquePtr key(
+      PEM_read_bio_PrivateKey(b.get(), nullptr, nullptr, nullptr));
+  if (!key) {
+    throw std::runtime_error("Failed to read key");
+  }
+
+  switch (getKeyType(key.get())) {
+    case KeyType::RSA:
+      return std::make_unique<RawPublicKeySelfCert<KeyType::RSA>>(
+          std::move(key), std::move(identity));
+    case KeyType::P256:
+      return std::make_unique<RawPublicKeySelfCert<KeyType::P256>>(
+          std::move(key), std::move(identity));
+    case KeyType::P384:
+      return std::make_unique<RawPublicKeySelfCert<KeyType::P384>>(
+          std::move(key), std::move(identity));
+    case KeyType::P521:
+      return std::make_unique<RawPublicKeySelfCert<KeyType::P521>>(
+          std::move(key), std::move(identity));
+    case KeyType::ED25519:
+      return std::make_unique<RawPublicKeySelfCert<KeyType::ED25519>>(
+          std::move(key), std::move(identity));
+    case KeyType::ED448:
+      return std::make_unique<RawPublicKeySelfCert<KeyType::ED448>>(
+          std::move(key), std::move(identity));
+  }
+  throw std::runtime_error("unknown self cert type");
+}
+
+std::string CertUtils::getSpkiHash(folly::ByteRange spki) {
+  std::array<uint8_t, Sha256::HashLen> hash;
+  Sha256::hash(*folly::IOBuf::wrapBuffer(spki), folly::range(hash));
+  return folly::hexlify(folly::range(hash));
+}
+
+Buf CertUtils::getSubjectPublicKeyInfo(EVP_PKEY* key) {
+  int len = i2d_PUBKEY(key, nullptr);
+  if (len < 0) {
+    throw std::runtime_error("Error computing length");
+  }
+  auto spki = folly::IOBuf::create(len);
+  auto dataPtr = spki->writableData();
+  len = i2d_PUBKEY(key, &dataPtr);
+  if (len < 0) {
+    throw std::runtime_error("Error converting key to DER");
+  }
+  spki->append(len);
+  return spki;
+}
+
 std::unique_ptr<SelfCert> CertUtils::makeSelfCert(
     std::string certData,
-    std::string keyData) {
+    std::string keyData,
+    ENGINE* engine) {
   auto certs = folly::ssl::OpenSSLCertUtils::readCertsFromBuffer(
       folly::StringPiece(certData));
   if (certs.empty()) {
@@ -138,34 +274,37 @@ std::unique_ptr<SelfCert> CertUtils::makeSelfCert(
     throw std::runtime_error("Failed to read key");
   }
 
-  return makeSelfCert(std::move(certs), std::move(key));
+  return makeSelfCert(std::move(certs), std::move(key), engine);
 }
 
 std::unique_ptr<SelfCert> CertUtils::makeSelfCert(
     std::vector<folly::ssl::X509UniquePtr> certs,
-    folly::ssl::EvpPkeyUniquePtr key) {
+    folly::ssl::EvpPkeyUniquePtr key,
+    ENGINE* engine) {
   folly::ssl::EvpPkeyUniquePtr pubKey(X509_get_pubkey(certs.front().get()));
   if (!pubKey) {
     throw std::runtime_error("Failed to read public key");
   }
 
-  if (EVP_PKEY_id(pubKey.get()) == EVP_PKEY_RSA) {
-    return std::make_unique<SelfCertImpl<KeyType::RSA>>(
-        std::move(key), std::move(certs));
-  } else if (EVP_PKEY_id(pubKey.get()) == EVP_PKEY_EC) {
-    switch (getCurveName(pubKey.get())) {
-      case NID_X9_62_prime256v1:
-        return std::make_unique<SelfCertImpl<KeyType::P256>>(
-            std::move(key), std::move(certs));
-      case NID_secp384r1:
-        return std::make_unique<SelfCertImpl<KeyType::P384>>(
-            std::move(key), std::move(certs));
-      case NID_secp521r1:
-        return std::make_unique<SelfCertImpl<KeyType::P521>>(
-            std::move(key), std::move(certs));
-      default:
-        break;
-    }
+  switch (getKeyType(pubKey.get())) {
+    case KeyType::RSA:
+      return std::make_unique<SelfCertImpl<KeyType::RSA>>(
+          std::move(key), std::move(certs), engine);
+    case KeyType::P256:
+      return std::make_unique<SelfCertImpl<KeyType::P256>>(
+          std::move(key), std::move(certs), engine);
+    case KeyType::P384:
+      return std::make_unique<SelfCertImpl<KeyType::P384>>(
+          std::move(key), std::move(certs), engine);
+    case KeyType::P521:
+      return std::make_unique<SelfCertImpl<KeyType::P521>>(
+          std::move(key), std::move(certs), engine);
+    case KeyType::ED25519:
+      return std::make_unique<SelfCertImpl<KeyType::ED25519>>(
+          std::move(key), std::move(certs), engine);
+    case KeyType::ED448:
+      return std::make_unique<SelfCertImpl<KeyType::ED448>>(
+          std::move(key), std::move(certs), engine);
   }
   throw std::runtime_error("unknown self cert type");
 }
@@ -14,7 +14,11 @@
 
 namespace fizz {
 
-enum class CertificateVerifyContext { Server, Client };
+/**
+ * What a signature made with a SelfCert is for. DelegatedCredential is the
+ * leaf certificate's signature over a delegated credential.
+ */
+enum class CertificateVerifyContext { Server, Client, DelegatedCredential };
 
 using Cert = folly::AsyncTransportCertificate;
 
@@ -49,10 +53,69 @@ class SelfCert : public Cert {
   virtual CertificateMsg getCertMessage(
       Buf certificateRequestContext = nullptr) const = 0;
 
+  /**
+   * Returns the type of certificate getCertMessage() carries.
+   */
+  virtual CertificateType getCertificateType() const {
+    return CertificateType::X509;
+  }
+
+  /**
+   * Returns the encoded Certificate handshake message with an empty
+   * certificate_request_context. Implementations can override this to return
+   * a shared copy of a message encoded ahead of time.
+   */
+  virtual Buf getEncodedCertMessage() const {
+    return encodeHandshake(getCertMessage());
+  }
+
+  /**
+   * Returns the encoded Certificate message with the leaf's OCSP staple
+   * and/or SCTs attached, for a peer that requested the given CertificateEntry
+   * extensions (status_request, signed_certificate_timestamp). Returns
+   * nullptr if there is nothing to attach, in which case
+   * getEncodedCertMessage() is used. Called during the handshake, so must not
+   * block.
+   */
+  virtual Buf getStapledCertMessage(
+      const std::vector<ExtensionType>& /* requestedExtensions */) const {
+    return nullptr;
+  }
+
+  /**
+   * Returns a SelfCert for a delegated credential of this certificate that a
+   * peer can accept, or nullptr to use this certificate. peerCredentialSchemes
+   * are the schemes the peer accepts for the credential's CertificateVerify,
+   * peerSigSchemes the ones it accepts for the leaf's signature over the
+   * credential.
+   */
+  virtual std::shared_ptr<const SelfCert> getDelegatedCert(
+      const std::vector<SignatureScheme>& /* peerCredentialSchemes */,
+      const std::vector<SignatureScheme>& /* peerSigSchemes */) const {
+    return nullptr;
+  }
+
   virtual Buf sign(
       SignatureScheme scheme,
       CertificateVerifyContext context,
       folly::ByteRange toBeSigned) const = 0;
+
+  /**
+   * Signs each of toBeSigned, returning the signatures in order.
+   * Implementations can override this to amortize work across the batch, by
+   * default each is signed with sign().
+   */
+  virtual std::vector<Buf> signBatch(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      const std::vector<folly::ByteRange>& toBeSigned) const {
+    std::vector<Buf> signatures;
+    signatures.reserve(toBeSigned.size());
+    for (const auto& data : toBeSigned) {
+      signatures.push_back(sign(scheme, context, data));
+    }
+    return signatures;
+  }
 };
 
 class PeerCert : public Cert {
@@ -70,6 +133,18 @@ class PeerCert : public Cert {
       folly::ByteRange signature) const = 0;
 };
 
+/**
+ * A peer's raw public key (RFC 7250). The only thing known about the peer is
+ * its SubjectPublicKeyInfo, which a verifier has to check directly.
+ */
+class RawPublicKeyPeerCert : public PeerCert {
+ public:
+  /**
+   * Returns the DER encoded SubjectPublicKeyInfo.
+   */
+  virtual folly::ByteRange getSubjectPublicKeyInfo() const = 0;
+};
+
 class CertUtils {
  public:
   /**
@@ -92,29 +167,86 @@ class CertUtils {
    */
   static std::unique_ptr<PeerCert> makePeerCert(Buf certData);
 
+  /**
+   * Create a RawPublicKeyPeerCert from a DER encoded SubjectPublicKeyInfo.
+   */
+  static std::unique_ptr<RawPublicKeyPeerCert> makeRawPublicKeyPeerCert(
+      Buf spki);
+
+  /**
+   * Creates a raw public key SelfCert from PEM key data. identity is only
+   * used locally (for example to select it in a CertManager), it is not sent
+   * to the peer.
+   */
+  static std::unique_ptr<SelfCert> makeRawPublicKeySelfCert(
+      std::string keyData,
+      std::string identity);
+
+  /**
+   * Returns the hex encoded SHA-256 of a SubjectPublicKeyInfo, as used for
+   * raw public key identities and pins.
+   */
+  static std::string getSpkiHash(folly::ByteRange spki);
+
+  /**
+   * Returns the DER encoded SubjectPublicKeyInfo of key.
+   */
+  static Buf getSubjectPublicKeyInfo(EVP_PKEY* key);
+
+  /**
+   * Returns the KeyType of key. Throws std::runtime_error if it is not
+   * supported.
+   */
+  static KeyType getKeyType(EVP_PKEY* key);
+
   /**
    * Creates a SelfCert using the supplied certificate and key file data.
+   * Signatures are computed with engine if set (see Factory::getEngine()).
    * Throws std::runtime_error on error.
    */
   static std::unique_ptr<SelfCert> makeSelfCert(
       std::string certData,
-      std::string keyData);
+      std::string keyData,
+      ENGINE* engine = nullptr);
 
   static std::unique_ptr<SelfCert> makeSelfCert(
       std::vector<folly::ssl::X509UniquePtr> certs,
-      folly::ssl::EvpPkeyUniquePtr key);
+      folly::ssl::EvpPkeyUniquePtr key,
+      ENGINE* engine = nullptr);
 };
 
+namespace detail {
+/**
+ * Signs or verifies data that was already prepared with
+ * CertUtils::prepareSignData(). Throws if scheme is not one of
+ * CertUtils::getSigSchemes<T>().
+ */
+template <KeyType T>
+Buf sign(
+    const OpenSSLSignature<T>& signature,
+    SignatureScheme scheme,
+    folly::ByteRange signData);
+
+template <KeyType T>
+void verify(
+    const OpenSSLSignature<T>& signature,
+    SignatureScheme scheme,
+    folly::ByteRange signData,
+    folly::ByteRange sig);
+} // namespace detail
+
 template <KeyType T>
 class SelfCertImpl : public SelfCert {
  public:
   /**
    * Private key is the private key associated with the leaf cert.
    * certs is a list of certs in the chain with the leaf first.
+   * If engine is set, signatures are computed with it.
    */
   SelfCertImpl(
       folly::ssl::EvpPkeyUniquePtr pkey,
-      std::vector<folly::ssl::X509UniquePtr> certs);
+      std::vector<folly::ssl::X509UniquePtr> certs,
+      ENGINE* engine = nullptr);
 
   ~SelfCertImpl() override = default;
 
@@ -127,16 +259,30 @@ class SelfCertImpl : public SelfCert {
   CertificateMsg getCertMessage(
       Buf certificateRequestContext = nullptr) const override;
 
+  /**
+   * Returns a clone of the message encoded when this was constructed.
+   */
+  Buf getEncodedCertMessage() const override;
+
   Buf sign(
       SignatureScheme scheme,
       CertificateVerifyContext context,
       folly::ByteRange toBeSigned) const override;
 
+  std::vector<Buf> signBatch(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      const std::vector<folly::ByteRange>& toBeSigned) const override;
+
   folly::ssl::X509UniquePtr getX509() const override;
 
  private:
   OpenSSLSignature<T> signature_;
   std::vector<folly::ssl::X509UniquePtr> certs_;
+  // Extracted from the leaf once, rather than on every call.
+  std::string identity_;
+  std::vector<std::string> altIdentities_;
+  Buf encodedCertMessage_;
 };
 
 template <KeyType T>
@@ -161,6 +307,78 @@ class PeerCertImpl : public PeerCert {
   folly::ssl::X509UniquePtr cert_;
 };
 
+/**
+ * SelfCert for a raw public key (RFC 7250), the Certificate message only
+ * carries the SubjectPublicKeyInfo of the key.
+ */
+template <KeyType T>
+class RawPublicKeySelfCert : public SelfCert {
+ public:
+  RawPublicKeySelfCert(folly::ssl::EvpPkeyUniquePtr pkey, std::string identity);
+
+  ~RawPublicKeySelfCert() override = default;
+
+  std::string getIdentity() const override;
+
+  std::vector<std::string> getAltIdentities() const override;
+
+  std::vector<SignatureScheme> getSigSchemes() const override;
+
+  CertificateMsg getCertMessage(
+      Buf certificateRequestContext = nullptr) const override;
+
+  Buf getEncodedCertMessage() const override;
+
+  CertificateType getCertificateType() const override;
+
+  Buf sign(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      folly::ByteRange toBeSigned) const override;
+
+  /**
+   * Returns nullptr, there is no certificate.
+   */
+  folly::ssl::X509UniquePtr getX509() const override;
+
+ private:
+  OpenSSLSignature<T> signature_;
+  std::string identity_;
+  Buf spki_;
+  Buf encodedCertMessage_;
+};
+
+template <KeyType T>
+class RawPublicKeyPeerCertImpl : public RawPublicKeyPeerCert {
+ public:
+  RawPublicKeyPeerCertImpl(folly::ssl::EvpPkeyUniquePtr key, Buf spki);
+
+  ~RawPublicKeyPeerCertImpl() override = default;
+
+  /**
+   * Returns CertUtils::getSpkiHash() of the key.
+   */
+  std::string getIdentity() const override;
+
+  void verify(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      folly::ByteRange toBeSigned,
+      folly::ByteRange signature) const override;
+
+  folly::ByteRange getSubjectPublicKeyInfo() const override;
+
+  /**
+   * Returns nullptr, there is no certificate.
+   */
+  folly::ssl::X509UniquePtr getX509() const override;
+
+ private:
+  OpenSSLSignature<T> signature_;
+  Buf spki_;
+  std::string identity_;
+};
+
 } // namespace fizz
 
 #include <fizz/protocol/Certificate-inl.h>
@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/CertificateCompressor.h>
+
+#include <folly/Conv.h>
+
+namespace fizz {
+
+namespace {
+folly::Optional<folly::io::CodecType> getCodecType(
+    CertificateCompressionAlgorithm algorithm) {
+  switch (algorithm) {
+    case CertificateCompressionAlgorithm::zlib:
+      return folly::io::CodecType::ZLIB;
+    case CertificateCompressionAlgorithm::brotli:
+      return folly::io::CodecType::BROTLI;
+    case CertificateCompressionAlgorithm::zstd:
+      return folly::io::CodecType::ZSTD;
+  }
+  return folly::none;
+}
+
+void checkSupported(CertificateCompressionAlgorithm algorithm) {
+  if (!CodecCertificateCompressor::supports(algorithm)) {
+    throw std::runtime_error(folly::to<std::string>(
+        "certificate compression not supported: ", toString(algorithm)));
+  }
+}
+} // namespace
+
+constexpr uint32_t CodecCertificateDecompressor::kMaxUncompressedLength;
+
+CodecCertificateCompressor::CodecCertificateCompressor(
+    CertificateCompressionAlgorithm algorithm,
+    int level)
+    : algorithm_(algorithm), level_(level) {
+  checkSupported(algorithm_);
+}
+
+CertificateCompressionAlgorithm CodecCertificateCompressor::getAlgorithm()
+    const {
+  return algorithm_;
+}
+
+CompressedCertificate CodecCertificateCompressor::compress(
+    CertificateMsg cert) {
+  auto encoded = encode(std::move(cert));
+  CompressedCertificate cc;
+  cc.algorithm = algorithm_;
+  cc.uncompressed_length = encoded->computeChainDataLength();
+  cc.compressed_certificate_message =
+      folly::io::getCodec(*getCodecType(algorithm_), level_)
+          ->compress(encoded.get());
+  return cc;
+}
+
+bool CodecCertificateCompressor::supports(
+    CertificateCompressionAlgorithm algorithm) {
+  auto type = getCodecType(algorithm);
+  return type && folly::io::hasCodec(*type);
+}
+
+CodecCertificateDecompressor::CodecCertificateDecompressor(
+    CertificateCompressionAlgorithm algorithm,
+    uint32_t maxUncompressedLength)
+    : algorithm_(algorithm),
+      maxUncompressedLength_(maxUncompressedLength) {
+  checkSupported(algorithm_);
+}
+
+CertificateCompressionAlgorithm CodecCertificateDecompressor::getAlgorithm()
+    const {
+  return algorithm_;
+}
+
+CertificateMsg CodecCertificateDecompressor::decompress(
+    const CompressedCertificate& cc) {
+  if (cc.algorithm != algorithm_) {
+    throw std::runtime_error("certificate compression algorithm mismatch");
+  }
+  if (cc.uncompressed_length > maxUncompressedLength_) {
+    throw std::runtime_error("compressed certificate too large");
+  }
+  // Passing the expected length lets the codec stop once it has produced
+  // that much output rather than inflating an unbounded stream.
+  auto codec = folly::io::getCodec(*getCodecType(algorithm_));
+  auto uncompressed = codec->uncompress(
+      cc.compressed_certificate_message.get(),
+      folly::Optional<uint64_t>(cc.uncompressed_length));
+  if (uncompressed->computeChainDataLength() != cc.uncompressed_length) {
+    throw std::runtime_error("compressed certificate length mismatch");
+  }
+  return decode<CertificateMsg>(std::move(uncompressed));
+}
+} // namespace fizz
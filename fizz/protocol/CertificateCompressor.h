@@ -0,0 +1,95 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/record/Types.h>
+#include <folly/io/Compression.h>
+
+namespace fizz {
+
+/**
+ * Compresses Certificate messages for certificate compression (RFC 8879).
+ */
+class CertificateCompressor {
+ public:
+  virtual ~CertificateCompressor() = default;
+
+  virtual CertificateCompressionAlgorithm getAlgorithm() const = 0;
+
+  /**
+   * Compresses the encoded Certificate message body (without the handshake
+   * header). Throws on error.
+   */
+  virtual CompressedCertificate compress(CertificateMsg cert) = 0;
+};
+
+class CertificateDecompressor {
+ public:
+  virtual ~CertificateDecompressor() = default;
+
+  virtual CertificateCompressionAlgorithm getAlgorithm() const = 0;
+
+  /**
+   * Decompresses and decodes the Certificate message in cc. Throws on error
+   * or if the message does not decompress to exactly uncompressed_length.
+   */
+  virtual CertificateMsg decompress(const CompressedCertificate& cc) = 0;
+};
+
+/**
+ * Certificate compression backed by a folly::io::Codec (zlib, brotli or
+ * zstd, depending on what folly was built with). A codec is created for
+ * each call, so instances can be shared between threads.
+ */
+class CodecCertificateCompressor : public CertificateCompressor {
+ public:
+  /**
+   * Throws if folly does not support a codec for algorithm.
+   */
+  explicit CodecCertificateCompressor(
+      CertificateCompressionAlgorithm algorithm,
+      int level = folly::io::COMPRESSION_LEVEL_DEFAULT);
+
+  CertificateCompressionAlgorithm getAlgorithm() const override;
+
+  CompressedCertificate compress(CertificateMsg cert) override;
+
+  /**
+   * Returns whether folly was built with support for algorithm.
+   */
+  static bool supports(CertificateCompressionAlgorithm algorithm);
+
+ private:
+  CertificateCompressionAlgorithm algorithm_;
+  int level_;
+};
+
+class CodecCertificateDecompressor : public CertificateDecompressor {
+ public:
+  /**
+   * Certificate messages that claim to decompress to more than
+   * maxUncompressedLength are rejected without being decompressed. This
+   * bounds the memory a peer can make us allocate.
+   */
+  explicit CodecCertificateDecompressor(
+      CertificateCompressionAlgorithm algorithm,
+      uint32_t maxUncompressedLength = kMaxUncompressedLength);
+
+  CertificateCompressionAlgorithm getAlgorithm() const override;
+
+  CertificateMsg decompress(const CompressedCertificate& cc) override;
+
+  // Matches the largest handshake message the record layer will accept.
+  static constexpr uint32_t kMaxUncompressedLength = 0x20000;
+
+ private:
+  CertificateCompressionAlgorithm algorithm_;
+  uint32_t maxUncompressedLength_;
+};
+} // namespace fizz
@@ -0,0 +1,62 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/KeyDerivation.h>
+#include <fizz/crypto/Sha256.h>
+#include <fizz/crypto/Sha384.h>
+#include <fizz/crypto/aead/AESGCM128.h>
+#include <fizz/crypto/aead/AESGCM256.h>
+#include <fizz/crypto/aead/AESOCB128.h>
+#include <fizz/crypto/aead/ChaCha20Poly1305.h>
+#include <fizz/protocol/HandshakeContext.h>
+#include <fizz/record/Types.h>
+
+namespace fizz {
+
+/**
+ * The crypto used by a cipher suite, fixed at compile time. Code written
+ * against the traits calls the hash, HKDF and key derivation directly
+ * instead of through their virtual interfaces.
+ *
+ *   - Hash: hash (and HMAC) of the suite
+ *   - AeadCipher: EVPImpl for the record protection aead
+ *   - KeyDeriver: KeyDerivation implementation
+ *   - HandshakeContextType: HandshakeContext implementation
+ */
+template <typename H, typename A>
+struct CipherSuiteTraits {
+  using Hash = H;
+  using AeadCipher = A;
+  using KeyDeriver = KeyDerivationImpl<Hash>;
+  using HandshakeContextType = HandshakeContextImpl<Hash>;
+};
+
+/**
+ * Calls func with the CipherSuiteTraits of cipher, so that a single switch
+ * selects the statically typed crypto for a negotiated cipher suite. Throws
+ * if the cipher suite is not supported.
+ */
+template <typename Func>
+auto withCipherSuiteTraits(CipherSuite cipher, Func&& func)
+    -> decltype(func(CipherSuiteTraits<Sha256, AESGCM128>())) {
+  switch (cipher) {
+    case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
+      return func(CipherSuiteTraits<Sha256, ChaCha20Poly1305>());
+    case CipherSuite::TLS_AES_128_GCM_SHA256:
+      return func(CipherSuiteTraits<Sha256, AESGCM128>());
+    case CipherSuite::TLS_AES_256_GCM_SHA384:
+      return func(CipherSuiteTraits<Sha384, AESGCM256>());
+    case CipherSuite::TLS_AES_128_OCB_SHA256_EXPERIMENTAL:
+      return func(CipherSuiteTraits<Sha256, AESOCB128>());
+    default:
+      throw std::runtime_error("cipher suite not implemented");
+  }
+}
+} // namespace fizz
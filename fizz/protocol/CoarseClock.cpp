@@ -0,0 +1,41 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/CoarseClock.h>
+
+#include <folly/Optional.h>
+#include <folly/io/async/EventBaseManager.h>
+
+namespace fizz {
+
+namespace {
+// Cleared by the loop callbacks of the iteration it was filled in.
+class CachedTime : public folly::EventBase::LoopCallback {
+ public:
+  void runLoopCallback() noexcept override {
+    time.clear();
+  }
+
+  folly::Optional<std::chrono::system_clock::time_point> time;
+};
+} // namespace
+
+std::chrono::system_clock::time_point CoarseClock::now() {
+  auto evb = folly::EventBaseManager::get()->getExistingEventBase();
+  if (!evb || !evb->isRunning() || !evb->isInEventBaseThread()) {
+    return std::chrono::system_clock::now();
+  }
+
+  static thread_local CachedTime cached;
+  if (!cached.time) {
+    cached.time = std::chrono::system_clock::now();
+    evb->runInLoop(&cached);
+  }
+  return *cached.time;
+}
+} // namespace fizz
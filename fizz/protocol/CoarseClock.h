@@ -0,0 +1,32 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+
+namespace fizz {
+
+/**
+ * Wall clock that reads the system clock at most once per EventBase loop
+ * iteration. The first call in an iteration reads the clock and caches it
+ * until the iteration's loop callbacks run, so everything handled in one
+ * iteration (a ClientHello's ticket age check, ticket decryption, replay
+ * checks and new tickets) shares a single clock_gettime.
+ *
+ * Only threads running an EventBase registered with the EventBaseManager
+ * are cached, elsewhere this is std::chrono::system_clock::now(). Handlers
+ * that run for a long time see a time up to that long in the past.
+ *
+ * Used by returning it from Factory::now().
+ */
+class CoarseClock {
+ public:
+  static std::chrono::system_clock::time_point now();
+};
+} // namespace fizz
@@ -7,6 +7,10 @@
  */
 
 #include <fizz/protocol/DefaultCertificateVerifier.h>
+
+#include <fizz/crypto/Sha256.h>
+#include <fizz/protocol/AllocationStats.h>
+#include <folly/io/IOBufQueue.h>
 #include <folly/ssl/OpenSSLCertUtils.h>
 
 namespace fizz {
@@ -26,13 +30,147 @@ DefaultCertificateVerifier::createFromCAFile(
       context, std::move(store));
 }
 
+/**
+ * Returns the X509 of cert, or throws if it has none (e.g. it is a raw public
+ * key, which this verifier can't check).
+ */
+static folly::ssl::X509UniquePtr getX509(const fizz::PeerCert& cert) {
+  auto x509 = cert.getX509();
+  if (!x509) {
+    throw std::runtime_error("certificate is not an X509 certificate");
+  }
+  return x509;
+}
+
+static std::string getChainHash(
+    const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs) {
+  folly::IOBufQueue encoded;
+  for (const auto& cert : certs) {
+    auto x509 = getX509(*cert);
+    int len = i2d_X509(x509.get(), nullptr);
+    if (len < 0) {
+      throw std::runtime_error("failed to encode certificate");
+    }
+    auto der = folly::IOBuf::create(len);
+    auto derData = der->writableData();
+    if (i2d_X509(x509.get(), &derData) != len) {
+      throw std::runtime_error("failed to encode certificate");
+    }
+    der->append(len);
+    encoded.append(std::move(der));
+  }
+
+  std::string chainHash(Sha256::HashLen, '\0');
+  Sha256::hash(
+      *encoded.front(),
+      folly::MutableByteRange(
+          reinterpret_cast<uint8_t*>(&chainHash[0]), chainHash.size()));
+  return chainHash;
+}
+
+void DefaultCertificateVerifier::setVerificationCache(
+    size_t capacity,
+    std::chrono::seconds ttl) {
+  if (capacity == 0) {
+    verifiedChains_.reset();
+    pendingVerifications_.reset();
+    return;
+  }
+  verifiedChains_ = std::make_unique<folly::Synchronized<VerifiedChainCache>>(
+      VerifiedChainCache(capacity));
+  pendingVerifications_ =
+      std::make_unique<folly::Synchronized<PendingVerifications>>();
+  verifiedChainTtl_ = ttl;
+}
+
+void DefaultCertificateVerifier::clearVerificationCache() {
+  if (verifiedChains_) {
+    verifiedChains_->wlock()->clear();
+  }
+}
+
+bool DefaultCertificateVerifier::isVerifiedChain(
+    const std::string& chainHash,
+    const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs) const {
+  {
+    auto cache = verifiedChains_->wlock();
+    auto it = cache->find(chainHash);
+    if (it == cache->end()) {
+      return false;
+    }
+    if (it->second <= now()) {
+      cache->erase(chainHash);
+      return false;
+    }
+  }
+
+  // The chain was valid when it was cached, but it may have expired since.
+  for (const auto& cert : certs) {
+    auto x509 = getX509(*cert);
+    if (X509_cmp_current_time(X509_get0_notAfter(x509.get())) <= 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void DefaultCertificateVerifier::verify(
     const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs) const {
+  AllocationStats::Scope allocationScope(AllocationSite::Certificates);
   if (certs.empty()) {
     throw std::runtime_error("no certificates to verify");
   }
 
-  auto leafCert = certs.front()->getX509();
+  if (!verifiedChains_) {
+    verifyChain(certs);
+    return;
+  }
+
+  auto chainHash = getChainHash(certs);
+  if (isVerifiedChain(chainHash, certs)) {
+    return;
+  }
+
+  // Join a verification of this chain that is already in progress. The
+  // pending entry acts as the chain's once-flag: only the caller that adds it
+  // verifies.
+  std::shared_ptr<folly::SharedPromise<folly::Unit>> joined;
+  std::shared_ptr<folly::SharedPromise<folly::Unit>> pending;
+  {
+    auto pendingVerifications = pendingVerifications_->wlock();
+    auto it = pendingVerifications->find(chainHash);
+    if (it != pendingVerifications->end()) {
+      joined = it->second;
+    } else if (isVerifiedChain(chainHash, certs)) {
+      // A verification finished since the check above. Chains are cached
+      // before their entry is removed, so checking again here is enough.
+      return;
+    } else {
+      pending = std::make_shared<folly::SharedPromise<folly::Unit>>();
+      pendingVerifications->emplace(chainHash, pending);
+    }
+  }
+  if (joined) {
+    joined->getFuture().get();
+    return;
+  }
+
+  try {
+    verifyChain(certs);
+  } catch (const std::exception& e) {
+    pendingVerifications_->wlock()->erase(chainHash);
+    pending->setException(
+        folly::exception_wrapper(std::current_exception(), e));
+    throw;
+  }
+  verifiedChains_->wlock()->set(chainHash, now() + verifiedChainTtl_);
+  pendingVerifications_->wlock()->erase(chainHash);
+  pending->setValue();
+}
+
+void DefaultCertificateVerifier::verifyChain(
+    const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs) const {
+  auto leafCert = getX509(*certs.front());
 
   auto certChainStack = std::unique_ptr<STACK_OF(X509), STACK_OF_X509_deleter>(
       sk_X509_new_null());
@@ -40,8 +178,11 @@ void DefaultCertificateVerifier::verify(
     throw std::bad_alloc();
   }
 
+  // The stack does not own its certificates, so keep them alive here.
+  std::vector<folly::ssl::X509UniquePtr> chain;
   for (size_t i = 1; i < certs.size(); i++) {
-    sk_X509_push(certChainStack.get(), certs[i]->getX509().get());
+    chain.push_back(getX509(*certs[i]));
+    sk_X509_push(certChainStack.get(), chain.back().get());
   }
 
   auto ctx = folly::ssl::X509StoreCtxUniquePtr(X509_STORE_CTX_new());
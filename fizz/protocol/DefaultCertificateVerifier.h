@@ -9,6 +9,12 @@
 #pragma once
 
 #include <fizz/protocol/CertificateVerifier.h>
+#include <folly/Synchronized.h>
+#include <folly/container/EvictingCacheMap.h>
+#include <folly/futures/SharedPromise.h>
+
+#include <chrono>
+#include <unordered_map>
 
 namespace fizz {
 
@@ -45,13 +51,31 @@ class DefaultCertificateVerifier : public CertificateVerifier {
 
   void setCustomVerifyCallback(X509VerifyCallback cb) {
     customVerifyCallback_ = cb;
+    clearVerificationCache();
   }
 
   void setX509Store(folly::ssl::X509StoreUniquePtr&& store) {
     x509Store_ = std::move(store);
     createAuthorities();
+    clearVerificationCache();
   }
 
+  /**
+   * Remembers up to capacity successfully verified chains, by a hash of their
+   * encoding, for up to ttl. A chain seen again within that time is not
+   * verified against the store again. Failed verifications are never cached,
+   * and a cached chain is verified again once any of its certificates has
+   * expired. A capacity of 0 (the default) disables the cache.
+   *
+   * With the cache enabled, concurrent verifications of the same chain (for
+   * example from many connections opened at once to one server) are also
+   * joined: the chain is verified once and the other callers wait for its
+   * result.
+   *
+   * Changing the store or the verify callback clears the cache.
+   */
+  void setVerificationCache(size_t capacity, std::chrono::seconds ttl);
+
   std::vector<Extension> getCertificateRequestExtensions() const override;
 
   static X509_STORE* getDefaultX509Store();
@@ -60,12 +84,37 @@ class DefaultCertificateVerifier : public CertificateVerifier {
       VerificationContext context,
       const std::string& caFile);
 
+ protected:
+  virtual std::chrono::steady_clock::time_point now() const {
+    return std::chrono::steady_clock::now();
+  }
+
  private:
+  using VerifiedChainCache = folly::
+      EvictingCacheMap<std::string, std::chrono::steady_clock::time_point>;
+  using PendingVerifications = std::unordered_map<
+      std::string,
+      std::shared_ptr<folly::SharedPromise<folly::Unit>>>;
+
   void createAuthorities();
 
+  void verifyChain(
+      const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs) const;
+
+  bool isVerifiedChain(
+      const std::string& chainHash,
+      const std::vector<std::shared_ptr<const fizz::PeerCert>>& certs) const;
+
+  void clearVerificationCache();
+
   CertificateAuthorities authorities_;
   VerificationContext context_;
   folly::ssl::X509StoreUniquePtr x509Store_;
   X509VerifyCallback customVerifyCallback_{nullptr};
+
+  std::unique_ptr<folly::Synchronized<VerifiedChainCache>> verifiedChains_;
+  std::unique_ptr<folly::Synchronized<PendingVerifications>>
+      pendingVerifications_;
+  std::chrono::seconds verifiedChainTtl_{0};
 };
 } // namespace fizz
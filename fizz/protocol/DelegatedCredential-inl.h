@@ -0,0 +1,132 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+namespace fizz {
+
+template <KeyType T>
+DelegatedSelfCertImpl<T>::DelegatedSelfCertImpl(
+    std::shared_ptr<const SelfCert> parent,
+    folly::ssl::EvpPkeyUniquePtr key,
+    DelegatedCredential credential)
+    : parent_(std::move(parent)), credential_(std::move(credential)) {
+  auto schemes = CertUtils::getSigSchemes<T>();
+  if (std::find(
+          schemes.begin(),
+          schemes.end(),
+          credential_.expected_verify_scheme) == schemes.end()) {
+    throw std::runtime_error("credential scheme does not match key");
+  }
+  auto spki = CertUtils::getSubjectPublicKeyInfo(key.get());
+  if (!folly::IOBufEqualTo()(spki, credential_.public_key)) {
+    throw std::runtime_error("credential is not for key");
+  }
+  signature_.setKey(std::move(key));
+
+  auto x509 = parent_->getX509();
+  if (!x509) {
+    throw std::runtime_error("delegated credential requires an X509 parent");
+  }
+  auto now = std::chrono::system_clock::now();
+  expiry_ = now + std::chrono::seconds(credential_.valid_time) -
+      DelegatedCredentialUtils::getCertAge(x509.get(), now);
+  encodedCertMessage_ = encodeHandshake(getCertMessage());
+}
+
+template <KeyType T>
+std::string DelegatedSelfCertImpl<T>::getIdentity() const {
+  return parent_->getIdentity();
+}
+
+template <KeyType T>
+std::vector<std::string> DelegatedSelfCertImpl<T>::getAltIdentities() const {
+  return parent_->getAltIdentities();
+}
+
+template <KeyType T>
+std::vector<SignatureScheme> DelegatedSelfCertImpl<T>::getSigSchemes() const {
+  return {credential_.expected_verify_scheme};
+}
+
+template <KeyType T>
+CertificateMsg DelegatedSelfCertImpl<T>::getCertMessage(
+    Buf certificateRequestContext) const {
+  auto msg = parent_->getCertMessage(std::move(certificateRequestContext));
+  if (msg.certificate_list.empty()) {
+    throw std::runtime_error("no leaf certificate for delegated credential");
+  }
+  msg.certificate_list.front().extensions.push_back(
+      encodeExtension(credential_));
+  return msg;
+}
+
+template <KeyType T>
+Buf DelegatedSelfCertImpl<T>::getEncodedCertMessage() const {
+  return encodedCertMessage_->clone();
+}
+
+template <KeyType T>
+Buf DelegatedSelfCertImpl<T>::sign(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    folly::ByteRange toBeSigned) const {
+  if (scheme != credential_.expected_verify_scheme) {
+    throw std::runtime_error("signature scheme does not match credential");
+  }
+  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+  return detail::sign<T>(signature_, scheme, signData->coalesce());
+}
+
+template <KeyType T>
+folly::ssl::X509UniquePtr DelegatedSelfCertImpl<T>::getX509() const {
+  return parent_->getX509();
+}
+
+template <KeyType T>
+const DelegatedCredential& DelegatedSelfCertImpl<T>::getDelegatedCredential()
+    const {
+  return credential_;
+}
+
+template <KeyType T>
+std::chrono::system_clock::time_point DelegatedSelfCertImpl<T>::getExpiry()
+    const {
+  return expiry_;
+}
+
+template <KeyType T>
+DelegatedPeerCertImpl<T>::DelegatedPeerCertImpl(
+    std::shared_ptr<const PeerCert> leaf,
+    folly::ssl::EvpPkeyUniquePtr key,
+    SignatureScheme verifyScheme)
+    : leaf_(std::move(leaf)), verifyScheme_(verifyScheme) {
+  signature_.setKey(std::move(key));
+}
+
+template <KeyType T>
+std::string DelegatedPeerCertImpl<T>::getIdentity() const {
+  return leaf_->getIdentity();
+}
+
+template <KeyType T>
+void DelegatedPeerCertImpl<T>::verify(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    folly::ByteRange toBeSigned,
+    folly::ByteRange signature) const {
+  if (scheme != verifyScheme_) {
+    throw std::runtime_error("signature scheme does not match credential");
+  }
+  auto signData = CertUtils::prepareSignData(context, toBeSigned);
+  detail::verify<T>(signature_, scheme, signData->coalesce(), signature);
+}
+
+template <KeyType T>
+folly::ssl::X509UniquePtr DelegatedPeerCertImpl<T>::getX509() const {
+  return leaf_->getX509();
+}
+} // namespace fizz
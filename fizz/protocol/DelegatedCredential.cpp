@@ -0,0 +1,201 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/DelegatedCredential.h>
+
+#include <folly/Conv.h>
+#include <folly/ScopeGuard.h>
+#include <openssl/x509v3.h>
+
+namespace fizz {
+
+constexpr std::chrono::hours DelegatedCredentialUtils::kMaxValidity;
+
+Buf DelegatedCredentialUtils::prepareSignatureBuffer(
+    const DelegatedCredential& credential,
+    const Buf& certData) {
+  auto buf = certData->clone();
+  auto toSign = folly::IOBuf::create(0);
+  folly::io::Appender appender(toSign.get(), 20);
+  detail::write(credential.valid_time, appender);
+  detail::write(credential.expected_verify_scheme, appender);
+  detail::writeBuf<detail::bits24>(credential.public_key, appender);
+  detail::write(credential.credential_scheme, appender);
+  buf->prependChain(std::move(toSign));
+  return buf;
+}
+
+bool DelegatedCredentialUtils::hasDelegationUsage(X509* cert) {
+  static constexpr auto kDelegationUsageOid = "1.3.6.1.4.1.44363.44";
+  folly::ssl::ASN1ObjUniquePtr oid(OBJ_txt2obj(kDelegationUsageOid, 1));
+  if (!oid) {
+    throw std::runtime_error("could not create delegation usage oid");
+  }
+  if (X509_get_ext_by_OBJ(cert, oid.get(), -1) < 0) {
+    return false;
+  }
+
+  auto keyUsage = static_cast<ASN1_BIT_STRING*>(
+      X509_get_ext_d2i(cert, NID_key_usage, nullptr, nullptr));
+  if (!keyUsage) {
+    return true;
+  }
+  SCOPE_EXIT {
+    ASN1_BIT_STRING_free(keyUsage);
+  };
+  // digitalSignature is the first bit of KeyUsage.
+  return ASN1_BIT_STRING_get_bit(keyUsage, 0) == 1;
+}
+
+std::chrono::seconds DelegatedCredentialUtils::getCertAge(
+    X509* cert,
+    std::chrono::system_clock::time_point now) {
+  folly::ssl::ASN1TimeUniquePtr asnNow(
+      ASN1_TIME_set(nullptr, std::chrono::system_clock::to_time_t(now)));
+  auto notBefore = X509_get_notBefore(cert);
+  int days;
+  int seconds;
+  if (!asnNow || !ASN1_TIME_diff(&days, &seconds, notBefore, asnNow.get())) {
+    throw std::runtime_error("could not compute certificate age");
+  }
+  return std::chrono::hours(24) * days + std::chrono::seconds(seconds);
+}
+
+DelegatedCredential DelegatedCredentialUtils::generate(
+    const SelfCert& parent,
+    SignatureScheme credentialScheme,
+    EVP_PKEY* key,
+    SignatureScheme verifyScheme,
+    std::chrono::seconds validity,
+    std::chrono::system_clock::time_point now) {
+  if (validity > kMaxValidity) {
+    throw std::runtime_error("delegated credential validity too long");
+  }
+  auto x509 = parent.getX509();
+  if (!x509 || !hasDelegationUsage(x509.get())) {
+    throw std::runtime_error("certificate cannot issue delegated credentials");
+  }
+  auto age = getCertAge(x509.get(), now);
+  if (age.count() < 0) {
+    throw std::runtime_error("certificate is not yet valid");
+  }
+
+  DelegatedCredential credential;
+  credential.valid_time = folly::to<uint32_t>((age + validity).count());
+  credential.expected_verify_scheme = verifyScheme;
+  credential.public_key = CertUtils::getSubjectPublicKeyInfo(key);
+  credential.credential_scheme = credentialScheme;
+
+  auto certMsg = parent.getCertMessage();
+  auto toSign = prepareSignatureBuffer(
+      credential, certMsg.certificate_list.front().cert_data);
+  credential.signature = parent.sign(
+      credentialScheme,
+      CertificateVerifyContext::DelegatedCredential,
+      toSign->coalesce());
+  return credential;
+}
+
+void DelegatedCredentialUtils::verify(
+    const PeerCert& leaf,
+    const Buf& certData,
+    const DelegatedCredential& credential,
+    std::chrono::system_clock::time_point now) {
+  auto x509 = leaf.getX509();
+  if (!x509 || !hasDelegationUsage(x509.get())) {
+    throw std::runtime_error("certificate cannot issue delegated credentials");
+  }
+
+  auto remaining =
+      std::chrono::seconds(credential.valid_time) - getCertAge(x509.get(), now);
+  if (remaining.count() <= 0) {
+    throw std::runtime_error("delegated credential expired");
+  }
+  if (remaining > kMaxValidity) {
+    throw std::runtime_error("delegated credential validity too long");
+  }
+
+  auto toSign = prepareSignatureBuffer(credential, certData);
+  leaf.verify(
+      credential.credential_scheme,
+      CertificateVerifyContext::DelegatedCredential,
+      toSign->coalesce(),
+      credential.signature->coalesce());
+}
+
+std::unique_ptr<PeerCert> DelegatedCredentialUtils::makeDelegatedPeerCert(
+    std::shared_ptr<const PeerCert> leaf,
+    const DelegatedCredential& credential) {
+  auto spki = credential.public_key->coalesce();
+  const unsigned char* begin = spki.data();
+  folly::ssl::EvpPkeyUniquePtr key(d2i_PUBKEY(nullptr, &begin, spki.size()));
+  if (!key || begin != spki.data() + spki.size()) {
+    throw std::runtime_error("could not read delegated credential key");
+  }
+
+  auto scheme = credential.expected_verify_scheme;
+  switch (CertUtils::getKeyType(key.get())) {
+    case KeyType::RSA:
+      return std::make_unique<DelegatedPeerCertImpl<KeyType::RSA>>(
+          std::move(leaf), std::move(key), scheme);
+    case KeyType::P256:
+      return std::make_unique<DelegatedPeerCertImpl<KeyType::P256>>(
+          std::move(leaf), std::move(key), scheme);
+    case KeyType::P384:
+      return std::make_unique<DelegatedPeerCertImpl<KeyType::P384>>(
+          std::move(leaf), std::move(key), scheme);
+    case KeyType::P521:
+      return std::make_unique<DelegatedPeerCertImpl<KeyType::P521>>(
+          std::move(leaf), std::move(key), scheme);
+    case KeyType::ED25519:
+      return std::make_unique<DelegatedPeerCertImpl<KeyType::ED25519>>(
+          std::move(leaf), std::move(key), scheme);
+    case KeyType::ED448:
+      return std::make_unique<DelegatedPeerCertImpl<KeyType::ED448>>(
+          std::move(leaf), std::move(key), scheme);
+  }
+  throw std::runtime_error("unknown delegated credential key type");
+}
+
+std::unique_ptr<DelegatedSelfCert> DelegatedSelfCert::make(
+    std::shared_ptr<const SelfCert> parent,
+    std::string keyData,
+    DelegatedCredential credential) {
+  folly::ssl::BioUniquePtr b(BIO_new_mem_buf(keyData.data(), keyData.size()));
+  if (!b) {
+    throw std::runtime_error("failed to create BIO");
+  }
+  folly::ssl::EvpPkeyUniquePtr key(
+      PEM_read_bio_PrivateKey(b.get(), nullptr, nullptr, nullptr));
+  if (!key) {
+    throw std::runtime_error("Failed to read key");
+  }
+
+  switch (CertUtils::getKeyType(key.get())) {
+    case KeyType::RSA:
+      return std::make_unique<DelegatedSelfCertImpl<KeyType::RSA>>(
+          std::move(parent), std::move(key), std::move(credential));
+    case KeyType::P256:
+      return std::make_unique<DelegatedSelfCertImpl<KeyType::P256>>(
+          std::move(parent), std::move(key), std::move(credential));
+    case KeyType::P384:
+      return std::make_unique<DelegatedSelfCertImpl<KeyType::P384>>(
+          std::move(parent), std::move(key), std::move(credential));
+    case KeyType::P521:
+      return std::make_unique<DelegatedSelfCertImpl<KeyType::P521>>(
+          std::move(parent), std::move(key), std::move(credential));
+    case KeyType::ED25519:
+      return std::make_unique<DelegatedSelfCertImpl<KeyType::ED25519>>(
+          std::move(parent), std::move(key), std::move(credential));
+    case KeyType::ED448:
+      return std::make_unique<DelegatedSelfCertImpl<KeyType::ED448>>(
+          std::move(parent), std::move(key), std::move(credential));
+  }
+  throw std::runtime_error("unknown delegated credential key type");
+}
+} // namespace fizz
@@ -0,0 +1,186 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/Certificate.h>
+#include <fizz/record/Extensions.h>
+
+#include <chrono>
+
+namespace fizz {
+
+/**
+ * Delegated credentials (draft-ietf-tls-subcerts). A delegated credential is
+ * a short lived key, signed by the leaf certificate, that the server signs
+ * CertificateVerify with instead of the certificate's own key. This lets
+ * the leaf key (for example an RSA key) stay offline or be slow, while
+ * handshakes are signed with a cheaper key.
+ */
+class DelegatedCredentialUtils {
+ public:
+  /**
+   * Longest a credential may be valid for from the time it is checked.
+   */
+  static constexpr std::chrono::hours kMaxValidity{24 * 7};
+
+  /**
+   * Returns the data the leaf certificate signs (before
+   * CertUtils::prepareSignData()): the DER encoded leaf, the credential and
+   * its credential_scheme.
+   */
+  static Buf prepareSignatureBuffer(
+      const DelegatedCredential& credential,
+      const Buf& certData);
+
+  /**
+   * Returns whether cert may issue delegated credentials: it must have the
+   * DelegationUsage extension and, if it has key usage, digitalSignature.
+   */
+  static bool hasDelegationUsage(X509* cert);
+
+  /**
+   * Returns how long cert has been valid for at now.
+   */
+  static std::chrono::seconds getCertAge(
+      X509* cert,
+      std::chrono::system_clock::time_point now);
+
+  /**
+   * Creates a credential for key, valid for validity from now, signed by
+   * parent with credentialScheme. CertificateVerify will be signed with
+   * verifyScheme. Throws std::runtime_error if parent's leaf cannot issue
+   * credentials or validity is longer than kMaxValidity.
+   */
+  static DelegatedCredential generate(
+      const SelfCert& parent,
+      SignatureScheme credentialScheme,
+      EVP_PKEY* key,
+      SignatureScheme verifyScheme,
+      std::chrono::seconds validity,
+      std::chrono::system_clock::time_point now =
+          std::chrono::system_clock::now());
+
+  /**
+   * Checks that credential was issued by leaf, whose DER encoding is
+   * certData, and that it is valid at now. Throws std::runtime_error if not.
+   */
+  static void verify(
+      const PeerCert& leaf,
+      const Buf& certData,
+      const DelegatedCredential& credential,
+      std::chrono::system_clock::time_point now);
+
+  /**
+   * Creates a PeerCert that verifies CertificateVerify with the credential's
+   * key, and is otherwise leaf. credential must have been checked with
+   * verify().
+   */
+  static std::unique_ptr<PeerCert> makeDelegatedPeerCert(
+      std::shared_ptr<const PeerCert> leaf,
+      const DelegatedCredential& credential);
+};
+
+/**
+ * SelfCert for a delegated credential: it sends parent's chain with the
+ * credential attached to the leaf, and signs with the credential's key.
+ */
+class DelegatedSelfCert : public SelfCert {
+ public:
+  virtual const DelegatedCredential& getDelegatedCredential() const = 0;
+
+  /**
+   * Time after which peers will reject the credential.
+   */
+  virtual std::chrono::system_clock::time_point getExpiry() const = 0;
+
+  /**
+   * Creates a DelegatedSelfCert from the credential and the PEM encoded
+   * private key it delegates to.
+   */
+  static std::unique_ptr<DelegatedSelfCert> make(
+      std::shared_ptr<const SelfCert> parent,
+      std::string keyData,
+      DelegatedCredential credential);
+};
+
+template <KeyType T>
+class DelegatedSelfCertImpl : public DelegatedSelfCert {
+ public:
+  DelegatedSelfCertImpl(
+      std::shared_ptr<const SelfCert> parent,
+      folly::ssl::EvpPkeyUniquePtr key,
+      DelegatedCredential credential);
+
+  ~DelegatedSelfCertImpl() override = default;
+
+  std::string getIdentity() const override;
+
+  std::vector<std::string> getAltIdentities() const override;
+
+  /**
+   * Returns the credential's expected_verify_scheme.
+   */
+  std::vector<SignatureScheme> getSigSchemes() const override;
+
+  CertificateMsg getCertMessage(
+      Buf certificateRequestContext = nullptr) const override;
+
+  Buf getEncodedCertMessage() const override;
+
+  Buf sign(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      folly::ByteRange toBeSigned) const override;
+
+  folly::ssl::X509UniquePtr getX509() const override;
+
+  const DelegatedCredential& getDelegatedCredential() const override;
+
+  std::chrono::system_clock::time_point getExpiry() const override;
+
+ private:
+  std::shared_ptr<const SelfCert> parent_;
+  OpenSSLSignature<T> signature_;
+  DelegatedCredential credential_;
+  std::chrono::system_clock::time_point expiry_;
+  Buf encodedCertMessage_;
+};
+
+template <KeyType T>
+class DelegatedPeerCertImpl : public PeerCert {
+ public:
+  DelegatedPeerCertImpl(
+      std::shared_ptr<const PeerCert> leaf,
+      folly::ssl::EvpPkeyUniquePtr key,
+      SignatureScheme verifyScheme);
+
+  ~DelegatedPeerCertImpl() override = default;
+
+  std::string getIdentity() const override;
+
+  /**
+   * Verifies with the credential's key. Throws if scheme is not the
+   * credential's expected_verify_scheme.
+   */
+  void verify(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      folly::ByteRange toBeSigned,
+      folly::ByteRange signature) const override;
+
+  folly::ssl::X509UniquePtr getX509() const override;
+
+ private:
+  std::shared_ptr<const PeerCert> leaf_;
+  OpenSSLSignature<T> signature_;
+  SignatureScheme verifyScheme_;
+};
+} // namespace fizz
+
+#include <fizz/protocol/DelegatedCredential-inl.h>
@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/Factory.h>
+#include <fizz/record/DtlsRecordLayer.h>
+
+namespace fizz {
+
+/**
+ * Factory that runs the client and server state machines over DTLS 1.3
+ * records (RFC 9147): DTLSPlaintext and DTLSCiphertext framing, epochs,
+ * encrypted sequence numbers, replay protection, and the "dtls13" key
+ * schedule labels. Set it on both contexts with setFactory().
+ *
+ * Only the record layer is DTLS. Handshake messages keep their TLS framing,
+ * and there are no ACKs, retransmissions or handshake fragmentation, so the
+ * handshake needs a datagram path that doesn't lose or reorder it. Each read
+ * of the transport must deliver whole datagrams. Compatibility mode must not
+ * be enabled, since its change_cipher_spec records are TLS records, and
+ * ConnectionHandoff doesn't carry the DTLS epochs and replay state.
+ */
+class DtlsFactory : public Factory {
+ public:
+  std::unique_ptr<PlaintextReadRecordLayer> makePlaintextReadRecordLayer()
+      const override {
+    return std::make_unique<DtlsPlaintextReadRecordLayer>();
+  }
+
+  std::unique_ptr<PlaintextWriteRecordLayer> makePlaintextWriteRecordLayer()
+      const override {
+    return std::make_unique<DtlsPlaintextWriteRecordLayer>();
+  }
+
+  std::unique_ptr<EncryptedReadRecordLayer> makeEncryptedReadRecordLayer(
+      EncryptionLevel encryptionLevel) const override {
+    return std::make_unique<DtlsReadRecordLayer>(encryptionLevel);
+  }
+
+  std::unique_ptr<EncryptedWriteRecordLayer> makeEncryptedWriteRecordLayer(
+      EncryptionLevel encryptionLevel) const override {
+    auto writeRecordLayer =
+        std::make_unique<DtlsWriteRecordLayer>(encryptionLevel);
+    auto recordSizePolicy = makeRecordSizePolicy();
+    if (recordSizePolicy) {
+      writeRecordLayer->setRecordSizePolicy(std::move(recordSizePolicy));
+    }
+    auto bufferPool = getBufferPool();
+    if (bufferPool) {
+      writeRecordLayer->setBufferPool(std::move(bufferPool));
+    }
+    return std::move(writeRecordLayer);
+  }
+
+  std::unique_ptr<KeyDerivation> makeKeyDeriver(
+      CipherSuite cipher) const override {
+    return withCipherSuiteTraits(
+        cipher, [](auto traits) -> std::unique_ptr<KeyDerivation> {
+          return std::make_unique<typename decltype(traits)::KeyDeriver>(
+              kDtls13LabelPrefix);
+        });
+  }
+
+  std::unique_ptr<HandshakeContext> makeHandshakeContext(
+      CipherSuite cipher) const override {
+    return withCipherSuiteTraits(
+        cipher, [](auto traits) -> std::unique_ptr<HandshakeContext> {
+          return std::make_unique<
+              typename decltype(traits)::HandshakeContextType>(
+              kDtls13LabelPrefix);
+        });
+  }
+};
+} // namespace fizz
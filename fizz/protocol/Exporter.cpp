@@ -16,19 +16,45 @@ Buf Exporter::getEkm(
     folly::StringPiece label,
     Buf context,
     uint16_t length) {
-  if (!context) {
-    context = folly::IOBuf::create(0);
-  }
-  auto deriver = Factory().makeKeyDeriver(cipher);
-  std::vector<uint8_t> base(deriver->hashLength());
-  folly::MutableByteRange hashedContext(base.data(), base.size());
-  deriver->hash(*context, hashedContext);
-  auto secret =
-      deriver->deriveSecret(exporterMaster, label, deriver->blankHash());
-  return deriver->expandLabel(
-      folly::range(secret),
-      "exporter",
-      folly::IOBuf::wrapBuffer(hashedContext),
-      length);
+  return getEkm(
+      Factory(), cipher, exporterMaster, label, std::move(context), length);
+}
+
+Buf Exporter::getEkm(
+    const Factory& factory,
+    CipherSuite cipher,
+    folly::ByteRange exporterMaster,
+    folly::StringPiece label,
+    Buf context,
+    uint16_t length) {
+  auto deriver = factory.makeKeyDeriver(cipher);
+  auto ekm = folly::IOBuf::create(length);
+  getEkm(
+      *deriver,
+      exporterMaster,
+      label,
+      context ? context->coalesce() : folly::ByteRange(),
+      folly::MutableByteRange(ekm->writableData(), length));
+  ekm->append(length);
+  return ekm;
+}
+
+void Exporter::getEkm(
+    KeyDerivation& deriver,
+    folly::ByteRange exporterMaster,
+    folly::StringPiece label,
+    folly::ByteRange context,
+    folly::MutableByteRange out) {
+  auto hashLength = deriver.hashLength();
+  std::array<uint8_t, kMaxHashLength> hashedContext;
+  std::array<uint8_t, kMaxHashLength> secret;
+  folly::MutableByteRange hashedContextRange(hashedContext.data(), hashLength);
+  folly::MutableByteRange secretRange(secret.data(), hashLength);
+
+  folly::IOBuf contextBuf(folly::IOBuf::WRAP_BUFFER, context);
+  deriver.hash(contextBuf, hashedContextRange);
+  deriver.deriveSecret(
+      exporterMaster, label, deriver.blankHash(), secretRange);
+  deriver.expandLabel(secretRange, "exporter", hashedContextRange, out);
 }
 } // namespace fizz
@@ -15,11 +15,35 @@ namespace fizz {
 
 class Exporter {
  public:
+  /**
+   * Derives the keying material with factory's key deriver for cipher, which
+   * must be the key deriver the connection's key schedule used.
+   */
   static Buf getEkm(
+      const Factory& factory,
       CipherSuite cipher,
       folly::ByteRange exporterMaster,
       folly::StringPiece label,
       Buf context,
       uint16_t length);
+
+  static Buf getEkm(
+      CipherSuite cipher,
+      folly::ByteRange exporterMaster,
+      folly::StringPiece label,
+      Buf context,
+      uint16_t length);
+
+  /**
+   * Same as getEkm() above, but with a deriver for the cipher's hash, which
+   * can be reused between calls, and writing out.size() bytes of keying
+   * material into out rather than allocating it.
+   */
+  static void getEkm(
+      KeyDerivation& deriver,
+      folly::ByteRange exporterMaster,
+      folly::StringPiece label,
+      folly::ByteRange context,
+      folly::MutableByteRange out);
 };
 } // namespace fizz
@@ -8,18 +8,25 @@
 
 #pragma once
 
+#include <fizz/crypto/BufferedRandom.h>
 #include <fizz/crypto/RandomGenerator.h>
 #include <fizz/crypto/aead/AESGCM128.h>
 #include <fizz/crypto/aead/AESGCM256.h>
 #include <fizz/crypto/aead/AESOCB128.h>
 #include <fizz/crypto/aead/ChaCha20Poly1305.h>
 #include <fizz/crypto/aead/OpenSSLEVPCipher.h>
+#include <fizz/crypto/aead/SodiumChaCha20Poly1305.h>
 #include <fizz/crypto/exchange/ECCurveKeyExchange.h>
+#include <fizz/crypto/exchange/HybridKeyExchange.h>
 #include <fizz/crypto/exchange/KeyExchange.h>
+#include <fizz/crypto/exchange/Kyber768KeyExchange.h>
 #include <fizz/crypto/exchange/X25519.h>
 #include <fizz/protocol/Certificate.h>
+#include <fizz/protocol/CipherSuiteTraits.h>
 #include <fizz/protocol/HandshakeContext.h>
+#include <fizz/protocol/KeyExchangePool.h>
 #include <fizz/protocol/KeyScheduler.h>
+#include <fizz/protocol/PeerCertCache.h>
 #include <fizz/record/EncryptedRecordLayer.h>
 #include <fizz/record/PlaintextRecordLayer.h>
 
@@ -42,14 +49,49 @@ class Factory {
     return std::make_unique<PlaintextWriteRecordLayer>();
   }
 
+  /**
+   * Record layers for each encryption level of a connection. A QUIC stack,
+   * which has packet protection of its own and no use for TLS records, can
+   * return record layers that pass handshake messages through unframed and
+   * take their keys from trafficSecretAvailable().
+   */
   virtual std::unique_ptr<EncryptedReadRecordLayer>
-  makeEncryptedReadRecordLayer() const {
-    return std::make_unique<EncryptedReadRecordLayer>();
+  makeEncryptedReadRecordLayer(EncryptionLevel encryptionLevel) const {
+    return std::make_unique<EncryptedReadRecordLayer>(encryptionLevel);
   }
 
   virtual std::unique_ptr<EncryptedWriteRecordLayer>
-  makeEncryptedWriteRecordLayer() const {
-    return std::make_unique<EncryptedWriteRecordLayer>();
+  makeEncryptedWriteRecordLayer(EncryptionLevel encryptionLevel) const {
+    auto writeRecordLayer =
+        std::make_unique<EncryptedWriteRecordLayer>(encryptionLevel);
+    auto recordSizePolicy = makeRecordSizePolicy();
+    if (recordSizePolicy) {
+      writeRecordLayer->setRecordSizePolicy(std::move(recordSizePolicy));
+    }
+    auto bufferPool = getBufferPool();
+    if (bufferPool) {
+      writeRecordLayer->setBufferPool(std::move(bufferPool));
+    }
+    return writeRecordLayer;
+  }
+
+  /**
+   * Record size policy installed on each encrypted write record layer. Returns
+   * nullptr (fixed record sizes) by default; return a DynamicRecordSizePolicy
+   * to enable dynamic record sizing.
+   */
+  virtual std::unique_ptr<RecordSizePolicy> makeRecordSizePolicy() const {
+    return nullptr;
+  }
+
+  /**
+   * Buffer pool used by encrypted write record layers and their aeads. Returns
+   * nullptr (allocate from the heap) by default. Since the pools are not meant
+   * to be shared across threads, implementations would typically return a
+   * pool for the calling thread or EventBase.
+   */
+  virtual std::shared_ptr<BufferPool> getBufferPool() const {
+    return nullptr;
   }
 
   virtual std::unique_ptr<KeyScheduler> makeKeyScheduler(
@@ -60,72 +102,184 @@ class Factory {
 
   virtual std::unique_ptr<KeyDerivation> makeKeyDeriver(
       CipherSuite cipher) const {
-    switch (cipher) {
-      case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
-      case CipherSuite::TLS_AES_128_GCM_SHA256:
-      case CipherSuite::TLS_AES_128_OCB_SHA256_EXPERIMENTAL:
-        return std::make_unique<KeyDerivationImpl<Sha256>>();
-      case CipherSuite::TLS_AES_256_GCM_SHA384:
-        return std::make_unique<KeyDerivationImpl<Sha384>>();
-      default:
-        throw std::runtime_error("ks: not implemented");
-    }
+    return withCipherSuiteTraits(
+        cipher, [](auto traits) -> std::unique_ptr<KeyDerivation> {
+          return std::make_unique<typename decltype(traits)::KeyDeriver>();
+        });
   }
 
   virtual std::unique_ptr<HandshakeContext> makeHandshakeContext(
       CipherSuite cipher) const {
-    switch (cipher) {
-      case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
-      case CipherSuite::TLS_AES_128_GCM_SHA256:
-      case CipherSuite::TLS_AES_128_OCB_SHA256_EXPERIMENTAL:
-        return std::make_unique<HandshakeContextImpl<Sha256>>();
-      case CipherSuite::TLS_AES_256_GCM_SHA384:
-        return std::make_unique<HandshakeContextImpl<Sha384>>();
-      default:
-        throw std::runtime_error("hs: not implemented");
+    return withCipherSuiteTraits(
+        cipher, [](auto traits) -> std::unique_ptr<HandshakeContext> {
+          return std::make_unique<
+              typename decltype(traits)::HandshakeContextType>();
+        });
+  }
+
+  /**
+   * OpenSSL engine used by the key exchanges and aeads made below, for
+   * example to offload them to a hardware crypto device. Returns nullptr
+   * (OpenSSL's built in implementations) by default. The engine must be
+   * initialized and outlive everything made with it. To sign with it as well,
+   * pass it to CertUtils::makeSelfCert().
+   */
+  virtual ENGINE* getEngine() const {
+    return nullptr;
+  }
+
+  /**
+   * Pool of pregenerated ephemeral key pairs that makeKeyExchange() takes
+   * from. Returns nullptr (generate key pairs during the handshake) by
+   * default.
+   */
+  virtual std::shared_ptr<KeyExchangePool> getKeyExchangePool() const {
+    return nullptr;
+  }
+
+  /**
+   * Which side of the handshake a key exchange is for. Groups built on a key
+   * encapsulation mechanism use a different implementation on each side.
+   */
+  enum class KeyExchangeMode { Server, Client };
+
+  virtual std::unique_ptr<KeyExchange> makeKeyExchange(
+      NamedGroup group,
+      KeyExchangeMode mode) const {
+    // Pooled key exchanges have their key pair generated, which the server
+    // side of a key encapsulation mechanism doesn't have.
+    auto pool = mode == KeyExchangeMode::Client || !isKemGroup(group)
+        ? getKeyExchangePool()
+        : nullptr;
+    if (pool) {
+      auto kex = pool->get(group);
+      if (kex) {
+        return kex;
+      }
     }
+    return makeDefaultKeyExchange(group, mode, getEngine());
   }
 
-  virtual std::unique_ptr<KeyExchange> makeKeyExchange(NamedGroup group) const {
+  /**
+   * The key exchange implementation for group, without a generated key pair.
+   * Can be passed to KeyExchangePool::create() (in client mode) to fill a
+   * pool.
+   */
+  static std::unique_ptr<KeyExchange> makeDefaultKeyExchange(
+      NamedGroup group,
+      KeyExchangeMode mode,
+      ENGINE* engine = nullptr) {
     switch (group) {
       case NamedGroup::secp256r1:
-        return std::make_unique<OpenSSLKeyExchange<P256>>();
+        return std::make_unique<OpenSSLKeyExchange<P256>>(engine);
       case NamedGroup::secp384r1:
-        return std::make_unique<OpenSSLKeyExchange<P384>>();
+        return std::make_unique<OpenSSLKeyExchange<P384>>(engine);
       case NamedGroup::secp521r1:
-        return std::make_unique<OpenSSLKeyExchange<P521>>();
+        return std::make_unique<OpenSSLKeyExchange<P521>>(engine);
       case NamedGroup::x25519:
         return std::make_unique<X25519KeyExchange>();
+      case NamedGroup::x25519_kyber768_draft00: {
+        std::unique_ptr<KeyExchange> kem;
+        if (mode == KeyExchangeMode::Client) {
+          kem = std::make_unique<Kyber768ClientKeyExchange>();
+        } else {
+          kem = std::make_unique<Kyber768ServerKeyExchange>();
+        }
+        return std::make_unique<HybridKeyExchange>(
+            std::make_unique<X25519KeyExchange>(),
+            crypto_scalarmult_BYTES,
+            std::move(kem));
+      }
       default:
         throw std::runtime_error("ke: not implemented");
     }
   }
 
+  /**
+   * Whether group uses a key encapsulation mechanism, whose client and server
+   * sides differ.
+   */
+  static bool isKemGroup(NamedGroup group) {
+    return group == NamedGroup::x25519_kyber768_draft00;
+  }
+
   virtual std::unique_ptr<Aead> makeAead(CipherSuite cipher) const {
     switch (cipher) {
       case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
-        return std::make_unique<OpenSSLEVPCipher<ChaCha20Poly1305>>();
+#if FOLLY_OPENSSL_IS_110
+        // OpenSSL's chacha20/poly1305 kernels are faster than libsodium's on
+        // records of a few KB and up, so prefer them when available.
+        return std::make_unique<OpenSSLEVPCipher<ChaCha20Poly1305>>(
+            getEngine());
+#else
+        return std::make_unique<SodiumChaCha20Poly1305>();
+#endif
       case CipherSuite::TLS_AES_128_GCM_SHA256:
-        return std::make_unique<OpenSSLEVPCipher<AESGCM128>>();
+        return std::make_unique<OpenSSLEVPCipher<AESGCM128>>(getEngine());
       case CipherSuite::TLS_AES_256_GCM_SHA384:
-        return std::make_unique<OpenSSLEVPCipher<AESGCM256>>();
+        return std::make_unique<OpenSSLEVPCipher<AESGCM256>>(getEngine());
       case CipherSuite::TLS_AES_128_OCB_SHA256_EXPERIMENTAL:
-        return std::make_unique<OpenSSLEVPCipher<AESOCB128>>();
+        return std::make_unique<OpenSSLEVPCipher<AESOCB128>>(getEngine());
       default:
         throw std::runtime_error("aead: not implemented");
     }
   }
 
   virtual Random makeRandom() const {
+    if (useBufferedRandom()) {
+      return BufferedRandom::generateRandom<Random().size()>();
+    }
     return RandomGenerator<Random().size()>().generateRandom();
   }
 
   virtual uint32_t makeTicketAgeAdd() const {
+    if (useBufferedRandom()) {
+      return BufferedRandom::generateRandomNum<uint32_t>();
+    }
     return RandomNumGenerator<uint32_t>().generateRandom();
   }
 
+  /**
+   * Whether makeRandom() and makeTicketAgeAdd() draw from the per thread
+   * BufferedRandom generator rather than calling the system RNG each time.
+   * False by default.
+   */
+  virtual bool useBufferedRandom() const {
+    return false;
+  }
+
+  /**
+   * Wall clock time used for ticket issue times and ticket age checks.
+   * Implementations handling many resumptions can return CoarseClock::now()
+   * instead.
+   */
+  virtual std::chrono::system_clock::time_point now() const {
+    return std::chrono::system_clock::now();
+  }
+
   virtual std::shared_ptr<PeerCert> makePeerCert(Buf certData) const {
+    auto cache = getPeerCertCache();
+    if (cache) {
+      return cache->getPeerCert(std::move(certData));
+    }
     return CertUtils::makePeerCert(std::move(certData));
   }
+
+  /**
+   * Cache that makePeerCert() interns parsed certificates in. Returns nullptr
+   * (parse every certificate) by default, implementations would typically
+   * return one cache shared by all connections.
+   */
+  virtual std::shared_ptr<PeerCertCache> getPeerCertCache() const {
+    return nullptr;
+  }
+
+  /**
+   * Makes a PeerCert from a raw public key (RFC 7250) the peer presented in
+   * place of a certificate.
+   */
+  virtual std::shared_ptr<PeerCert> makeRawPublicKeyPeerCert(Buf spki) const {
+    return CertUtils::makeRawPublicKeyPeerCert(std::move(spki));
+  }
 };
 } // namespace fizz
@@ -6,10 +6,46 @@
  *  LICENSE file in the root directory of this source tree.
  */
 
+#include <fizz/crypto/Utils.h>
 #include <fizz/protocol/Exporter.h>
 
 namespace fizz {
 
+namespace detail {
+/**
+ * Returns the WriteToSocket held by an action, or nullptr.
+ */
+struct GetWriteToSocket : boost::static_visitor<WriteToSocket*> {
+  WriteToSocket* operator()(WriteToSocket& write) const {
+    return &write;
+  }
+
+  template <typename T>
+  WriteToSocket* operator()(T&) const {
+    return nullptr;
+  }
+};
+
+/**
+ * Sets WriteFlags::CORK on every write in actions but the last, so that a
+ * flight that leaves as several writes is sent in as few segments as
+ * possible. The last write releases the cork.
+ */
+template <typename Actions>
+void corkAllButLastWrite(Actions& actions) {
+  WriteToSocket* previous = nullptr;
+  for (auto& action : actions) {
+    auto write = boost::apply_visitor(GetWriteToSocket(), action);
+    if (write) {
+      if (previous) {
+        previous->flags = previous->flags | folly::WriteFlags::CORK;
+      }
+      previous = write;
+    }
+  }
+}
+} // namespace detail
+
 template <typename Derived, typename ActionMoveVisitor, typename StateMachine>
 void FizzBase<Derived, ActionMoveVisitor, StateMachine>::writeNewSessionTicket(
     WriteNewSessionTicket w) {
@@ -80,20 +116,75 @@ bool FizzBase<Derived, ActionMoveVisitor, StateMachine>::inErrorState() const {
 template <typename Derived, typename ActionMoveVisitor, typename StateMachine>
 bool FizzBase<Derived, ActionMoveVisitor, StateMachine>::actionProcessing()
     const {
-  return actionGuard_.hasValue();
+  return actionProcessing_;
+}
+
+template <typename Derived, typename ActionMoveVisitor, typename StateMachine>
+FizzBase<Derived, ActionMoveVisitor, StateMachine>::~FizzBase() {
+  clearEkmCache();
+}
+
+template <typename Derived, typename ActionMoveVisitor, typename StateMachine>
+void FizzBase<Derived, ActionMoveVisitor, StateMachine>::
+    releaseIdleResources() {
+  if (actionProcessing() || !pendingEvents_.empty()) {
+    return;
+  }
+  clearEkmCache();
+  if (state_.readRecordLayer()) {
+    state_.readRecordLayer()->releaseIdleResources();
+  }
+  if (state_.writeRecordLayer()) {
+    state_.writeRecordLayer()->releaseIdleResources();
+  }
+}
+
+template <typename Derived, typename ActionMoveVisitor, typename StateMachine>
+void FizzBase<Derived, ActionMoveVisitor, StateMachine>::addMemoryUsage(
+    MemoryUsage& usage) const {
+  usage.stateBytes += sizeof(state_);
+  if (pendingEvents_.onHeap()) {
+    usage.pendingEventBytes += pendingEvents_.capacity() * sizeof(PendingEvent);
+  }
+  for (size_t i = 0; i < pendingEvents_.size(); ++i) {
+    const folly::IOBuf* data = nullptr;
+    if (auto appWrite = boost::get<AppWrite>(&pendingEvents_[i])) {
+      data = appWrite->data.get();
+    } else if (auto early = boost::get<EarlyAppWrite>(&pendingEvents_[i])) {
+      data = early->data.get();
+    }
+    if (data) {
+      usage.pendingEventBytes += data->computeChainCapacity();
+    }
+  }
+  if (state_.readRecordLayer()) {
+    usage.readBufferBytes += state_.readRecordLayer()->getBufferMemoryUsage();
+    usage.cipherBytes += state_.readRecordLayer()->getCipherMemoryUsage();
+  }
+  if (state_.writeRecordLayer()) {
+    usage.cipherBytes += state_.writeRecordLayer()->getCipherMemoryUsage();
+  }
 }
 
 template <typename Derived, typename ActionMoveVisitor, typename StateMachine>
 void FizzBase<Derived, ActionMoveVisitor, StateMachine>::processActions(
     typename StateMachine::CompletedActions actions) {
   // This extra DestructorGuard is needed due to the gap between clearing
-  // actionGuard_ and potentially processing another action.
-  folly::DelayedDestruction::DestructorGuard dg(owner_);
+  // actionGuard_ and potentially processing another action, unless the caller
+  // already holds one.
+  folly::Optional<folly::DelayedDestruction::DestructorGuard> dg;
+  if (!ownerGuarded_) {
+    dg.emplace(owner_);
+  }
 
+  TLSStats::add(TLSCounter::ActionsProcessed, actions.size());
+  AllocationStats::Scope allocationScope(AllocationSite::Actions);
+  detail::corkAllButLastWrite(actions);
   for (auto& action : actions) {
     boost::apply_visitor(visitor_, action);
   }
 
+  actionProcessing_ = false;
   actionGuard_.clear();
   processPendingEvents();
 }
@@ -101,10 +192,11 @@ void FizzBase<Derived, ActionMoveVisitor, StateMachine>::processActions(
 template <typename Derived, typename ActionMoveVisitor, typename StateMachine>
 void FizzBase<Derived, ActionMoveVisitor, StateMachine>::addProcessingActions(
     typename StateMachine::ProcessingActions actions) {
-  if (actionGuard_) {
+  if (actionProcessing_) {
     throw std::runtime_error("actions already processing");
   }
 
+  actionProcessing_ = true;
   actionGuard_ = folly::DelayedDestruction::DestructorGuard(owner_);
 
   static_cast<Derived*>(this)->startActions(std::move(actions));
@@ -117,15 +209,21 @@ void FizzBase<Derived, ActionMoveVisitor, StateMachine>::
     return;
   }
 
-  folly::DelayedDestruction::DestructorGuard dg(owner_);
+  folly::Optional<folly::DelayedDestruction::DestructorGuard> dg;
+  if (!ownerGuarded_) {
+    dg.emplace(owner_);
+  }
+  auto prevOwnerGuarded = ownerGuarded_;
+  ownerGuarded_ = true;
   inProcessPendingEvents_ = true;
   SCOPE_EXIT {
     inProcessPendingEvents_ = false;
+    ownerGuarded_ = prevOwnerGuarded;
   };
 
-  while (!actionGuard_ && !inErrorState()) {
+  while (!actionProcessing_ && !inErrorState()) {
     folly::Optional<typename StateMachine::ProcessingActions> actions;
-    actionGuard_ = folly::DelayedDestruction::DestructorGuard(owner_);
+    actionProcessing_ = true;
     if (!waitForData_) {
       actions = machine_.processSocketData(state_, transportReadBuf_);
     } else if (!pendingEvents_.empty()) {
@@ -138,6 +236,9 @@ void FizzBase<Derived, ActionMoveVisitor, StateMachine>::
                 machine_.processWriteNewSessionTicket(state_, std::move(write));
           },
           [&actions, this](AppWrite& write) {
+            if (coalesceAppWrites_) {
+              coalescePendingAppWrites(write);
+            }
             actions = machine_.processAppWrite(state_, std::move(write));
           },
           [&actions, this](EarlyAppWrite& write) {
@@ -147,11 +248,48 @@ void FizzBase<Derived, ActionMoveVisitor, StateMachine>::
             actions = machine_.processAppClose(state_);
           });
     } else {
-      actionGuard_.clear();
+      actionProcessing_ = false;
       return;
     }
 
     static_cast<Derived*>(this)->startActions(std::move(*actions));
+    if (actionProcessing_) {
+      // The actions complete asynchronously, after the guard held here is
+      // released.
+      actionGuard_.emplace(owner_);
+    }
+  }
+}
+
+template <typename Derived, typename ActionMoveVisitor, typename StateMachine>
+void FizzBase<Derived, ActionMoveVisitor, StateMachine>::
+    coalescePendingAppWrites(AppWrite& write) {
+  if (pendingEvents_.empty() ||
+      !boost::get<AppWrite>(&pendingEvents_.front())) {
+    return;
+  }
+
+  std::vector<MergedWrite> writes;
+  folly::IOBufQueue data{folly::IOBufQueue::cacheChainLength()};
+  writes.push_back(
+      {write.callback, write.data ? write.data->computeChainDataLength() : 0});
+  data.append(std::move(write.data));
+  while (!pendingEvents_.empty()) {
+    auto next = boost::get<AppWrite>(&pendingEvents_.front());
+    if (!next) {
+      break;
+    }
+    writes.push_back({next->callback,
+                      next->data ? next->data->computeChainDataLength() : 0});
+    data.append(std::move(next->data));
+    write.flags = write.flags | next->flags;
+    pendingEvents_.pop_front();
+  }
+
+  write.callback = combineWriteCallbacks(std::move(writes));
+  write.data = data.move();
+  if (!write.data) {
+    write.data = folly::IOBuf::create(0);
   }
 }
 
@@ -160,11 +298,69 @@ Buf FizzBase<Derived, ActionMoveVisitor, StateMachine>::getEkm(
     folly::StringPiece label,
     const Buf& context,
     uint16_t length) const {
-  return Exporter::getEkm(
-      *state_.cipher(),
+  folly::IOBuf coalescedContext;
+  if (context) {
+    coalescedContext = context->cloneCoalescedAsValue();
+  }
+  auto ekm = folly::IOBuf::create(length);
+  getEkm(
+      label,
+      coalescedContext.coalesce(),
+      folly::MutableByteRange(ekm->writableData(), length));
+  ekm->append(length);
+  return ekm;
+}
+
+template <typename Derived, typename ActionMoveVisitor, typename StateMachine>
+constexpr size_t
+    FizzBase<Derived, ActionMoveVisitor, StateMachine>::kMaxCachedEkms;
+
+template <typename Derived, typename ActionMoveVisitor, typename StateMachine>
+void FizzBase<Derived, ActionMoveVisitor, StateMachine>::getEkm(
+    folly::StringPiece label,
+    folly::ByteRange context,
+    folly::MutableByteRange out) const {
+  folly::StringPiece contextStr(context);
+  std::lock_guard<std::mutex> lock(ekmMutex_);
+  for (const auto& cached : ekmCache_) {
+    if (cached.ekm->length() == out.size() && cached.label == label &&
+        cached.context == contextStr) {
+      memcpy(out.data(), cached.ekm->data(), out.size());
+      return;
+    }
+  }
+
+  if (!ekmDeriver_) {
+    ekmDeriver_ =
+        state_.context()->getFactory()->makeKeyDeriver(*state_.cipher());
+  }
+  Exporter::getEkm(
+      *ekmDeriver_,
       (*state_.exporterMasterSecret())->coalesce(),
       label,
-      context ? context->clone() : nullptr,
-      length);
+      context,
+      out);
+
+  if (ekmCache_.size() == kMaxCachedEkms) {
+    auto& evicted = *ekmCache_.front().ekm;
+    CryptoUtils::clean(
+        folly::MutableByteRange(evicted.writableData(), evicted.length()));
+    ekmCache_.erase(ekmCache_.begin());
+  }
+  CachedEkm cached;
+  cached.label = label.str();
+  cached.context = contextStr.str();
+  cached.ekm = folly::IOBuf::copyBuffer(out.data(), out.size());
+  ekmCache_.push_back(std::move(cached));
+}
+
+template <typename Derived, typename ActionMoveVisitor, typename StateMachine>
+void FizzBase<Derived, ActionMoveVisitor, StateMachine>::clearEkmCache() const {
+  std::lock_guard<std::mutex> lock(ekmMutex_);
+  for (auto& cached : ekmCache_) {
+    CryptoUtils::clean(folly::MutableByteRange(
+        cached.ekm->writableData(), cached.ekm->length()));
+  }
+  ekmCache_.clear();
 }
 } // namespace fizz
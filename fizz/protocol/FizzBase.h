@@ -8,9 +8,18 @@
 
 #pragma once
 
+#include <fizz/crypto/KeyDerivation.h>
+#include <fizz/protocol/Actions.h>
+#include <fizz/protocol/AllocationStats.h>
+#include <fizz/protocol/MemoryUsage.h>
+#include <fizz/protocol/MergedWriteCallback.h>
 #include <fizz/protocol/Params.h>
+#include <fizz/protocol/RingQueue.h>
+#include <fizz/protocol/TLSStats.h>
 #include <folly/Overload.h>
 
+#include <mutex>
+
 namespace fizz {
 
 /**
@@ -35,6 +44,8 @@ class FizzBase {
         visitor_(visitor),
         owner_(owner) {}
 
+  ~FizzBase();
+
   /**
    * Server only: Called to write new session ticket to client.
    */
@@ -67,6 +78,32 @@ class FizzBase {
    */
   void newTransportData();
 
+  /**
+   * Declares, for as long as it is in scope, that the caller holds a
+   * DestructorGuard on owner (as the transport does for each socket read).
+   * Events and actions that complete immediately are then processed without
+   * taking guards of their own, so a steady state read pays for one guard
+   * rather than several per record.
+   */
+  class OwnerGuardedScope {
+   public:
+    explicit OwnerGuardedScope(FizzBase& base)
+        : base_(base), prev_(base.ownerGuarded_) {
+      base_.ownerGuarded_ = true;
+    }
+
+    ~OwnerGuardedScope() {
+      base_.ownerGuarded_ = prev_;
+    }
+
+    OwnerGuardedScope(const OwnerGuardedScope&) = delete;
+    OwnerGuardedScope& operator=(const OwnerGuardedScope&) = delete;
+
+   private:
+    FizzBase& base_;
+    bool prev_;
+  };
+
   /**
    * Calls error callbacks on any pending events and prevents any further events
    * from being processed. Should be called when an error is received from
@@ -86,6 +123,29 @@ class FizzBase {
    */
   bool actionProcessing() const;
 
+  /**
+   * Releases state held by the record layers that they can rebuild when next
+   * used, for connections that are idle, and wipes remembered exported keying
+   * material. Has no effect while an event or action is being processed.
+   */
+  void releaseIdleResources();
+
+  /**
+   * Add the memory held by the state, its record layers and the events
+   * waiting to be processed to usage.
+   */
+  void addMemoryUsage(MemoryUsage& usage) const;
+
+  /**
+   * When enabled, app writes that queue up while the state machine is busy
+   * (for example writes made from inside a read callback) are merged into a
+   * single write when they are processed. The merged write completes the
+   * original write callbacks in order.
+   */
+  void setCoalesceAppWrites(bool enabled) {
+    coalesceAppWrites_ = enabled;
+  }
+
   /**
    * Returns an exported key material derived from the 1-RTT secret of the TLS
    * connection.
@@ -93,6 +153,24 @@ class FizzBase {
   Buf getEkm(folly::StringPiece label, const Buf& context, uint16_t length)
       const;
 
+  /**
+   * Same as getEkm() above, but writes out.size() bytes of exported key
+   * material into out.
+   *
+   * Both versions remember the last few (label, context, length) values
+   * requested, so asking for the same keying material again is a copy. The
+   * remembered material is wiped when it is evicted, when the connection is
+   * idle (see releaseIdleResources()) and on destruction.
+   *
+   * Both read the connection's state, so like the rest of this class they
+   * must not run while another thread is processing events. Concurrent
+   * getEkm() calls on their own are safe.
+   */
+  void getEkm(
+      folly::StringPiece label,
+      folly::ByteRange context,
+      folly::MutableByteRange out) const;
+
  protected:
   void processActions(typename StateMachine::CompletedActions actions);
 
@@ -105,16 +183,36 @@ class FizzBase {
  private:
   void processPendingEvents();
 
+  void coalescePendingAppWrites(AppWrite& write);
+
+  void clearEkmCache() const;
+
+  struct CachedEkm {
+    std::string label;
+    std::string context;
+    Buf ekm;
+  };
+  static constexpr size_t kMaxCachedEkms = 4;
+
   ActionMoveVisitor& visitor_;
   folly::DelayedDestructionBase* owner_;
 
   using PendingEvent =
       boost::variant<AppWrite, EarlyAppWrite, AppClose, WriteNewSessionTicket>;
-  std::deque<PendingEvent> pendingEvents_;
+  // Writes rarely queue up behind more than a couple of events.
+  RingQueue<PendingEvent, 4> pendingEvents_;
   bool waitForData_{true};
+  bool actionProcessing_{false};
+  // Only held while actions are completing asynchronously.
   folly::Optional<folly::DelayedDestruction::DestructorGuard> actionGuard_;
+  bool ownerGuarded_{false};
   bool inProcessPendingEvents_{false};
   bool inErrorState_{false};
+  bool coalesceAppWrites_{false};
+  // Guards ekmDeriver_ and ekmCache_ between concurrent getEkm() calls.
+  mutable std::mutex ekmMutex_;
+  mutable std::unique_ptr<KeyDerivation> ekmDeriver_;
+  mutable std::vector<CachedEkm> ekmCache_;
 };
 } // namespace fizz
 
@@ -11,7 +11,9 @@
 namespace fizz {
 
 template <typename Hash>
-HandshakeContextImpl<Hash>::HandshakeContextImpl() {
+HandshakeContextImpl<Hash>::HandshakeContextImpl(
+    folly::StringPiece labelPrefix)
+    : labelPrefix_(labelPrefix) {
   hashState_ = folly::ssl::OpenSSLHash::Digest();
   hashState_.hash_init(Hash::HashEngine());
 }
@@ -21,26 +23,45 @@ void HandshakeContextImpl<Hash>::appendToTranscript(const Buf& data) {
   hashState_.hash_update(*data);
 }
 
+template <typename Hash>
+void HandshakeContextImpl<Hash>::appendToTranscript(folly::ByteRange data) {
+  hashState_.hash_update(data);
+}
+
 template <typename Hash>
 Buf HandshakeContextImpl<Hash>::getHandshakeContext() const {
-  folly::ssl::OpenSSLHash::Digest copied(hashState_);
   auto out = folly::IOBuf::create(Hash::HashLen);
   out->append(Hash::HashLen);
-  folly::MutableByteRange outRange(out->writableData(), out->length());
-  copied.hash_final(outRange);
+  getHandshakeContext(
+      folly::MutableByteRange(out->writableData(), out->length()));
   return out;
 }
 
+template <typename Hash>
+folly::ByteRange HandshakeContextImpl<Hash>::getHandshakeContext(
+    folly::MutableByteRange out) const {
+  CHECK_GE(out.size(), Hash::HashLen);
+  folly::MutableByteRange context(out.data(), Hash::HashLen);
+  folly::ssl::OpenSSLHash::Digest copied(hashState_);
+  copied.hash_final(context);
+  return context;
+}
+
 template <typename Hash>
 Buf HandshakeContextImpl<Hash>::getFinishedData(
     folly::ByteRange baseKey) const {
-  auto context = getHandshakeContext();
-  auto finishedKey = KeyDerivationImpl<Hash>().expandLabel(
-      baseKey, "finished", folly::IOBuf::create(0), Hash::HashLen);
+  std::array<uint8_t, Hash::HashLen> context;
+  getHandshakeContext(folly::range(context));
+  std::array<uint8_t, Hash::HashLen> finishedKey;
+  KeyDerivationImpl<Hash>(labelPrefix_).expandLabel(
+      baseKey, "finished", folly::ByteRange(), folly::range(finishedKey));
   auto data = folly::IOBuf::create(Hash::HashLen);
   data->append(Hash::HashLen);
   auto outRange = folly::MutableByteRange(data->writableData(), data->length());
-  Hash::hmac(finishedKey->coalesce(), *context, outRange);
+  Hash::hmac(
+      folly::range(finishedKey),
+      folly::IOBuf::wrapBufferAsValue(folly::range(context)),
+      outRange);
   return data;
 }
 } // namespace fizz
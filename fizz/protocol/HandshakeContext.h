@@ -8,7 +8,9 @@
 
 #pragma once
 
+#include <fizz/crypto/KeyDerivation.h>
 #include <fizz/record/Types.h>
+#include <folly/io/Cursor.h>
 #include <folly/ssl/OpenSSLHash.h>
 
 namespace fizz {
@@ -26,11 +28,37 @@ class HandshakeContext {
    */
   virtual void appendToTranscript(const Buf& transcript) = 0;
 
+  /**
+   * Same as above, but hashes the bytes in place, so that a slice of a
+   * message as read from the record layer can be added without splitting it
+   * off into its own Buf. The default implementation copies transcript.
+   */
+  virtual void appendToTranscript(folly::ByteRange transcript) {
+    appendToTranscript(folly::IOBuf::copyBuffer(transcript));
+  }
+
   /**
    * Returns the handshake context for the current transcript.
    */
   virtual Buf getHandshakeContext() const = 0;
 
+  /**
+   * Same as above, but writes the handshake context into out and returns the
+   * written prefix of out. out must be large enough for the context, which
+   * kMaxHashLength always is. The default implementation copies the result of
+   * getHandshakeContext().
+   */
+  virtual folly::ByteRange getHandshakeContext(
+      folly::MutableByteRange out) const {
+    auto context = getHandshakeContext();
+    auto length = context->computeChainDataLength();
+    if (length > out.size()) {
+      throw std::runtime_error("handshake context too long");
+    }
+    folly::io::Cursor(context.get()).pull(out.data(), length);
+    return folly::ByteRange(out.data(), length);
+  }
+
   /**
    * Returns the finished verify_data from the current handshake context and
    * baseKey.
@@ -44,14 +72,24 @@ class HandshakeContext {
 };
 
 template <typename Hash>
-class HandshakeContextImpl : public HandshakeContext {
+class HandshakeContextImpl final : public HandshakeContext {
  public:
-  HandshakeContextImpl();
+  /**
+   * labelPrefix is the HkdfLabel prefix the finished key is derived with,
+   * see KeyDerivationImpl.
+   */
+  explicit HandshakeContextImpl(
+      folly::StringPiece labelPrefix = kTls13LabelPrefix);
 
   void appendToTranscript(const Buf& data) override;
 
+  void appendToTranscript(folly::ByteRange data) override;
+
   Buf getHandshakeContext() const override;
 
+  folly::ByteRange getHandshakeContext(
+      folly::MutableByteRange out) const override;
+
   Buf getFinishedData(folly::ByteRange baseKey) const override;
 
   folly::ByteRange getBlankContext() const override {
@@ -59,6 +97,7 @@ class HandshakeContextImpl : public HandshakeContext {
   }
 
  private:
+  folly::StringPiece labelPrefix_;
   folly::ssl::OpenSSLHash::Digest hashState_;
 };
 } // namespace fizz
@@ -0,0 +1,34 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+namespace fizz {
+namespace detail {
+
+template <typename F>
+auto traceAsyncStep(
+    const std::shared_ptr<HandshakeTracer>& tracer,
+    uint64_t handshakeId,
+    HandshakeStep step,
+    F&& startStep) -> decltype(startStep()) {
+  if (!tracer) {
+    return startStep();
+  }
+  auto finished = [tracer, handshakeId, step]() {
+    tracer->asyncStepFinished(
+        handshakeId, HandshakeTracer::Clock::now(), step);
+  };
+  tracer->asyncStepStarted(handshakeId, HandshakeTracer::Clock::now(), step);
+  try {
+    return startStep().ensure(std::move(finished));
+  } catch (...) {
+    finished();
+    throw;
+  }
+}
+} // namespace detail
+} // namespace fizz
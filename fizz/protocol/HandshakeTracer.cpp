@@ -0,0 +1,37 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/HandshakeTracer.h>
+
+#include <atomic>
+
+namespace fizz {
+
+uint64_t HandshakeTracer::newHandshakeId() {
+  static std::atomic<uint64_t> nextId{1};
+  return nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+folly::StringPiece toString(HandshakeStep step) {
+  switch (step) {
+    case HandshakeStep::TicketDecrypt:
+      return "TicketDecrypt";
+    case HandshakeStep::ReplayCache:
+      return "ReplayCache";
+    case HandshakeStep::KeyExchange:
+      return "KeyExchange";
+    case HandshakeStep::Sign:
+      return "Sign";
+    case HandshakeStep::TicketEncrypt:
+      return "TicketEncrypt";
+    case HandshakeStep::CertificateVerify:
+      return "CertificateVerify";
+  }
+  return "Invalid HandshakeStep";
+}
+} // namespace fizz
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/futures/Future.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace fizz {
+
+/**
+ * Asynchronous steps of a handshake that may complete on a later loop.
+ */
+enum class HandshakeStep {
+  TicketDecrypt,
+  ReplayCache,
+  KeyExchange,
+  Sign,
+  TicketEncrypt,
+  CertificateVerify,
+};
+
+folly::StringPiece toString(HandshakeStep step);
+
+/**
+ * Receives timestamped handshake events for latency analysis. Set on a
+ * FizzServerContext or FizzClientContext; when none is set the state machines
+ * only pay a null pointer check.
+ *
+ * Callbacks are invoked on the thread that runs the handshake step, which for
+ * a step that completes asynchronously is the thread completing it, so an
+ * implementation shared between connections must be thread safe. Each
+ * callback gets the id of the handshake it belongs to (see newHandshakeId()),
+ * so that events of concurrent handshakes can be told apart.
+ */
+class HandshakeTracer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  virtual ~HandshakeTracer() = default;
+
+  /**
+   * Called when a state machine moves from one state to another.
+   */
+  virtual void stateTransition(
+      uint64_t handshakeId,
+      Clock::time_point time,
+      folly::StringPiece from,
+      folly::StringPiece to) = 0;
+
+  virtual void asyncStepStarted(
+      uint64_t handshakeId,
+      Clock::time_point time,
+      HandshakeStep step) = 0;
+
+  virtual void asyncStepFinished(
+      uint64_t handshakeId,
+      Clock::time_point time,
+      HandshakeStep step) = 0;
+
+  /**
+   * Returns an id unique within the process. The state machines give one to
+   * each connection when it starts, if their context has a tracer.
+   */
+  static uint64_t newHandshakeId();
+};
+
+namespace detail {
+
+/**
+ * Reports step of handshakeId as started, then calls startStep(), which
+ * starts the step and returns a Future for its result, and reports step as
+ * finished once that completes (or startStep() throws). Only calls
+ * startStep() if tracer is null.
+ */
+template <typename F>
+auto traceAsyncStep(
+    const std::shared_ptr<HandshakeTracer>& tracer,
+    uint64_t handshakeId,
+    HandshakeStep step,
+    F&& startStep) -> decltype(startStep());
+} // namespace detail
+} // namespace fizz
+
+#include <fizz/protocol/HandshakeTracer-inl.h>
@@ -0,0 +1,271 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/KTLS.h>
+
+#include <fizz/record/EncryptedRecordLayer.h>
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/io/Cursor.h>
+#include <folly/lang/Bits.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/tls.h>)
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#if defined(TLS_1_3_VERSION)
+#define FIZZ_HAVE_KTLS 1
+#endif
+#endif
+#endif
+
+#ifndef FIZZ_HAVE_KTLS
+#define FIZZ_HAVE_KTLS 0
+#endif
+
+#if FIZZ_HAVE_KTLS
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#endif
+
+namespace fizz {
+
+namespace {
+
+template <typename RecordLayer>
+folly::Optional<KTLSDirectionalCryptoParams> extractParams(
+    const RecordLayer* recordLayer,
+    CipherSuite cipher) {
+  if (!recordLayer) {
+    return folly::none;
+  }
+  auto aead = recordLayer->getAead();
+  if (!aead) {
+    return folly::none;
+  }
+  auto key = aead->getKey();
+  if (!key) {
+    return folly::none;
+  }
+  KTLSDirectionalCryptoParams params;
+  params.cipher = cipher;
+  params.key = std::move(*key);
+  params.seqNum = recordLayer->getSequenceNumber();
+  return std::move(params);
+}
+
+#if FIZZ_HAVE_KTLS
+template <typename CryptoInfo>
+bool setCryptoInfo(
+    int fd,
+    int direction,
+    uint16_t cipherType,
+    const KTLSDirectionalCryptoParams& params) {
+  CryptoInfo info;
+  memset(&info, 0, sizeof(info));
+  info.info.version = TLS_1_3_VERSION;
+  info.info.cipher_type = cipherType;
+
+  // The kernel splits the 12 byte TLS 1.3 iv into an implicit salt and an
+  // explicit iv part.
+  if (params.key.key->computeChainDataLength() != sizeof(info.key) ||
+      params.key.iv->computeChainDataLength() !=
+          sizeof(info.salt) + sizeof(info.iv)) {
+    return false;
+  }
+  folly::io::Cursor keyCursor(params.key.key.get());
+  keyCursor.pull(info.key, sizeof(info.key));
+  folly::io::Cursor ivCursor(params.key.iv.get());
+  ivCursor.pull(info.salt, sizeof(info.salt));
+  ivCursor.pull(info.iv, sizeof(info.iv));
+
+  uint64_t seqNum = folly::Endian::big(params.seqNum);
+  static_assert(sizeof(info.rec_seq) == sizeof(seqNum), "bad rec_seq size");
+  memcpy(info.rec_seq, &seqNum, sizeof(seqNum));
+
+  auto ret = setsockopt(fd, SOL_TLS, direction, &info, sizeof(info));
+  memset(&info, 0, sizeof(info));
+  return ret == 0;
+}
+
+bool setDirection(
+    int fd,
+    int direction,
+    const KTLSDirectionalCryptoParams& params) {
+  switch (params.cipher) {
+#ifdef TLS_CIPHER_AES_GCM_128
+    case CipherSuite::TLS_AES_128_GCM_SHA256:
+      return setCryptoInfo<tls12_crypto_info_aes_gcm_128>(
+          fd, direction, TLS_CIPHER_AES_GCM_128, params);
+#endif
+#ifdef TLS_CIPHER_AES_GCM_256
+    case CipherSuite::TLS_AES_256_GCM_SHA384:
+      return setCryptoInfo<tls12_crypto_info_aes_gcm_256>(
+          fd, direction, TLS_CIPHER_AES_GCM_256, params);
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
+      return setCryptoInfo<tls12_crypto_info_chacha20_poly1305>(
+          fd, direction, TLS_CIPHER_CHACHA20_POLY1305, params);
+#endif
+    default:
+      return false;
+  }
+}
+
+bool cipherSupported(CipherSuite cipher) {
+  switch (cipher) {
+#ifdef TLS_CIPHER_AES_GCM_128
+    case CipherSuite::TLS_AES_128_GCM_SHA256:
+      return true;
+#endif
+#ifdef TLS_CIPHER_AES_GCM_256
+    case CipherSuite::TLS_AES_256_GCM_SHA384:
+      return true;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+void setOptions(int fd, const KTLSOptions& options) {
+  // Only failing on old kernels, which still work without the hints.
+#ifdef TLS_TX_ZEROCOPY_RO
+  if (options.txZeroCopyReadOnly) {
+    int value = 1;
+    if (setsockopt(
+            fd, SOL_TLS, TLS_TX_ZEROCOPY_RO, &value, sizeof(value)) != 0) {
+      VLOG(4) << "TLS_TX_ZEROCOPY_RO not supported";
+    }
+  }
+#endif
+#ifdef TLS_RX_EXPECT_NO_PAD
+  if (options.rxExpectNoPad) {
+    int value = 1;
+    if (setsockopt(
+            fd, SOL_TLS, TLS_RX_EXPECT_NO_PAD, &value, sizeof(value)) != 0) {
+      VLOG(4) << "TLS_RX_EXPECT_NO_PAD not supported";
+    }
+  }
+#endif
+  (void)fd;
+  (void)options;
+}
+#endif
+} // namespace
+
+bool KTLS::isSupported() {
+  return FIZZ_HAVE_KTLS;
+}
+
+folly::Optional<KTLSDirectionalCryptoParams> KTLS::extractReadParams(
+    const ReadRecordLayer* recordLayer,
+    CipherSuite cipher) {
+  return extractParams(
+      dynamic_cast<const EncryptedReadRecordLayer*>(recordLayer), cipher);
+}
+
+folly::Optional<KTLSDirectionalCryptoParams> KTLS::extractWriteParams(
+    const WriteRecordLayer* recordLayer,
+    CipherSuite cipher) {
+  return extractParams(
+      dynamic_cast<const EncryptedWriteRecordLayer*>(recordLayer), cipher);
+}
+
+#if FIZZ_HAVE_KTLS
+bool KTLS::setupSocket(
+    int fd,
+    const KTLSDirectionalCryptoParams& rx,
+    const KTLSDirectionalCryptoParams& tx,
+    const KTLSOptions& options) {
+  if (!cipherSupported(rx.cipher) || !cipherSupported(tx.cipher)) {
+    return false;
+  }
+  static const char kTlsUlp[] = "tls";
+  if (setsockopt(fd, SOL_TCP, TCP_ULP, kTlsUlp, sizeof(kTlsUlp)) != 0) {
+    return false;
+  }
+  // Until keys are installed the tls ulp passes data through unchanged, so
+  // failing here still leaves a usable socket.
+  if (!setDirection(fd, TLS_TX, tx)) {
+    return false;
+  }
+  if (!setDirection(fd, TLS_RX, rx)) {
+    throw std::runtime_error("failed to set kTLS rx after tx");
+  }
+  setOptions(fd, options);
+  return true;
+}
+#else
+bool KTLS::setupSocket(
+    int /* fd */,
+    const KTLSDirectionalCryptoParams& /* rx */,
+    const KTLSDirectionalCryptoParams& /* tx */,
+    const KTLSOptions& /* options */) {
+  return false;
+}
+#endif
+
+folly::Optional<KTLSStats> KTLS::getStats() {
+  std::string contents;
+  if (!folly::readFile("/proc/net/tls_stat", contents)) {
+    return folly::none;
+  }
+  return parseStats(contents);
+}
+
+KTLSStats KTLS::parseStats(folly::StringPiece contents) {
+  static const std::pair<folly::StringPiece, uint64_t KTLSStats::*>
+      kCounters[] = {
+          {"TlsCurrTxSw", &KTLSStats::currTxSw},
+          {"TlsCurrRxSw", &KTLSStats::currRxSw},
+          {"TlsCurrTxDevice", &KTLSStats::currTxDevice},
+          {"TlsCurrRxDevice", &KTLSStats::currRxDevice},
+          {"TlsTxSw", &KTLSStats::txSw},
+          {"TlsRxSw", &KTLSStats::rxSw},
+          {"TlsTxDevice", &KTLSStats::txDevice},
+          {"TlsRxDevice", &KTLSStats::rxDevice},
+          {"TlsDecryptError", &KTLSStats::decryptError},
+          {"TlsRxDeviceResync", &KTLSStats::rxDeviceResync},
+          {"TlsDecryptRetry", &KTLSStats::decryptRetry},
+          {"TlsRxNoPadViolation", &KTLSStats::rxNoPadViolation},
+      };
+  KTLSStats stats;
+  std::vector<folly::StringPiece> lines;
+  folly::split('\n', contents, lines);
+  for (auto line : lines) {
+    // Names and values are separated by any amount of whitespace.
+    std::vector<folly::StringPiece> fields;
+    folly::splitTo<folly::StringPiece>(
+        " \t", line, std::back_inserter(fields), true);
+    if (fields.size() != 2) {
+      continue;
+    }
+    auto value = folly::tryTo<uint64_t>(fields[1]);
+    if (!value) {
+      continue;
+    }
+    for (const auto& counter : kCounters) {
+      if (counter.first == fields[0]) {
+        stats.*counter.second = *value;
+      }
+    }
+  }
+  return stats;
+}
+} // namespace fizz
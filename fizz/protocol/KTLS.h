@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/record/RecordLayer.h>
+
+#include <fizz/crypto/aead/Aead.h>
+#include <folly/Range.h>
+
+namespace fizz {
+
+/**
+ * Record protection state for one direction of a connection.
+ */
+struct KTLSDirectionalCryptoParams {
+  CipherSuite cipher;
+  TrafficKey key;
+  uint64_t seqNum;
+};
+
+/**
+ * Hints for the kernel that matter most when the NIC does the record
+ * protection inline (device offload, used automatically by the kernel when
+ * the NIC has tls-hw-tx-offload / tls-hw-rx-offload enabled). They are best
+ * effort: kernels that don't know them ignore them.
+ */
+struct KTLSOptions {
+  // Send sendfile() data straight from the page cache instead of copying it
+  // for the NIC to encrypt (TLS_TX_ZEROCOPY_RO). The file must not be
+  // modified while it is being sent, or the record sent may not match the
+  // tag the NIC computed.
+  bool txZeroCopyReadOnly{false};
+
+  // The peer is not expected to pad records (TLS_RX_EXPECT_NO_PAD), which
+  // lets the kernel decrypt TLS 1.3 records straight into the app buffer. A
+  // padded record still works, it is just decrypted again.
+  bool rxExpectNoPad{false};
+};
+
+/**
+ * Counters from /proc/net/tls_stat, for all sockets of the network
+ * namespace. Sw vs Device tells how many sessions are protected by the
+ * kernel and how many by the NIC. Once a NIC loses track of the record
+ * stream (eg on retransmissions or reordering) the kernel decrypts in
+ * software until it resyncs the NIC, counted in rxDeviceResync.
+ */
+struct KTLSStats {
+  uint64_t currTxSw{0};
+  uint64_t currRxSw{0};
+  uint64_t currTxDevice{0};
+  uint64_t currRxDevice{0};
+  uint64_t txSw{0};
+  uint64_t rxSw{0};
+  uint64_t txDevice{0};
+  uint64_t rxDevice{0};
+  uint64_t decryptError{0};
+  uint64_t rxDeviceResync{0};
+  uint64_t decryptRetry{0};
+  uint64_t rxNoPadViolation{0};
+};
+
+/**
+ * Helpers to hand record protection for an established connection over to
+ * the kernel (Linux kernel TLS). Once installed on a socket, plaintext app
+ * data can be written to and read from the socket directly (which also
+ * allows sendfile/zero copy sends).
+ *
+ * The kernel only handles application data records. Receiving any other
+ * record type (post-handshake messages such as NewSessionTicket or
+ * KeyUpdate, or alerts) will fail the read, so kTLS should only be used on
+ * connections where the peer is not expected to send these.
+ */
+class KTLS {
+ public:
+  /**
+   * Returns true if fizz was built with kernel TLS support. The running kernel
+   * may still not support it, in which case setupSocket() will fail.
+   */
+  static bool isSupported();
+
+  /**
+   * Export the current crypto state of an encrypted record layer. Returns none
+   * if the record layer is not encrypted or its aead does not support
+   * exporting keys.
+   */
+  static folly::Optional<KTLSDirectionalCryptoParams> extractReadParams(
+      const ReadRecordLayer* recordLayer,
+      CipherSuite cipher);
+  static folly::Optional<KTLSDirectionalCryptoParams> extractWriteParams(
+      const WriteRecordLayer* recordLayer,
+      CipherSuite cipher);
+
+  /**
+   * Install rx and tx on the socket. Returns false if kernel TLS is not
+   * available for this socket or cipher, in which case the socket can still be
+   * used as before. Throws if the socket was left partially configured.
+   */
+  static bool setupSocket(
+      int fd,
+      const KTLSDirectionalCryptoParams& rx,
+      const KTLSDirectionalCryptoParams& tx,
+      const KTLSOptions& options = KTLSOptions());
+
+  /**
+   * Reads the kernel's TLS counters. Returns none if they aren't available.
+   */
+  static folly::Optional<KTLSStats> getStats();
+
+  /**
+   * Parses the contents of /proc/net/tls_stat. Unknown counters are ignored.
+   */
+  static KTLSStats parseStats(folly::StringPiece contents);
+};
+} // namespace fizz
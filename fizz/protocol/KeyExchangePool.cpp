@@ -0,0 +1,142 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/KeyExchangePool.h>
+
+#include <folly/ScopeGuard.h>
+
+namespace fizz {
+
+namespace {
+
+/**
+ * Key exchange whose key pair was generated by the pool. Regenerates only if
+ * generateKeyPair() is called again.
+ */
+class PregeneratedKeyExchange : public KeyExchange {
+ public:
+  explicit PregeneratedKeyExchange(std::unique_ptr<KeyExchange> kex)
+      : kex_(std::move(kex)) {}
+
+  void generateKeyPair() override {
+    if (pregenerated_) {
+      pregenerated_ = false;
+      return;
+    }
+    kex_->generateKeyPair();
+  }
+
+  std::unique_ptr<folly::IOBuf> getKeyShare() const override {
+    return kex_->getKeyShare();
+  }
+
+  std::unique_ptr<folly::IOBuf> generateSharedSecret(
+      folly::ByteRange keyShare) const override {
+    return kex_->generateSharedSecret(keyShare);
+  }
+
+  folly::SemiFuture<std::unique_ptr<folly::IOBuf>> generateSharedSecretAsync(
+      folly::ByteRange keyShare) const override {
+    return kex_->generateSharedSecretAsync(keyShare);
+  }
+
+ private:
+  std::unique_ptr<KeyExchange> kex_;
+  bool pregenerated_{true};
+};
+} // namespace
+
+std::shared_ptr<KeyExchangePool> KeyExchangePool::create(
+    std::shared_ptr<folly::Executor> executor,
+    const std::vector<NamedGroup>& groups,
+    size_t poolSize,
+    MakeKeyExchange make) {
+  return std::shared_ptr<KeyExchangePool>(new KeyExchangePool(
+      std::move(executor), groups, poolSize, std::move(make)));
+}
+
+KeyExchangePool::KeyExchangePool(
+    std::shared_ptr<folly::Executor> executor,
+    const std::vector<NamedGroup>& groups,
+    size_t poolSize,
+    MakeKeyExchange make)
+    : executor_(std::move(executor)),
+      poolSize_(poolSize),
+      make_(std::move(make)) {
+  for (auto group : groups) {
+    groups_.emplace(group, std::make_unique<Group>());
+  }
+}
+
+std::unique_ptr<KeyExchange> KeyExchangePool::get(NamedGroup group) {
+  auto it = groups_.find(group);
+  if (it == groups_.end()) {
+    return nullptr;
+  }
+  auto& pool = *it->second;
+
+  std::unique_ptr<KeyExchange> kex;
+  size_t left;
+  {
+    auto ready = pool.ready.wlock();
+    if (!ready->empty()) {
+      kex = std::move(ready->front());
+      ready->pop_front();
+    }
+    left = ready->size();
+  }
+
+  if (executor_ && left < (poolSize_ + 1) / 2 &&
+      !pool.refilling.exchange(true)) {
+    std::weak_ptr<KeyExchangePool> weak = shared_from_this();
+    try {
+      executor_->add([weak, group, &pool]() {
+        auto self = weak.lock();
+        if (!self) {
+          return;
+        }
+        // Reset even if make_ or key generation throws, so that a later get()
+        // can try again.
+        SCOPE_EXIT {
+          pool.refilling = false;
+        };
+        self->fill(group, pool);
+      });
+    } catch (...) {
+      pool.refilling = false;
+      throw;
+    }
+  }
+  return kex;
+}
+
+void KeyExchangePool::fill() {
+  for (auto& group : groups_) {
+    fill(group.first, *group.second);
+  }
+}
+
+void KeyExchangePool::fill(NamedGroup group, Group& pool) {
+  while (pool.ready.rlock()->size() < poolSize_) {
+    // Generate outside the lock so that handshakes taking key pairs are not
+    // held up.
+    auto kex = make_(group);
+    kex->generateKeyPair();
+    pool.ready.wlock()->push_back(
+        std::make_unique<PregeneratedKeyExchange>(std::move(kex)));
+  }
+}
+
+size_t KeyExchangePool::available(NamedGroup group) const {
+  auto it = groups_.find(group);
+  if (it == groups_.end()) {
+    return 0;
+  }
+  return it->second->ready.rlock()->size();
+}
+} // namespace fizz
@@ -0,0 +1,86 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/exchange/KeyExchange.h>
+#include <fizz/record/Types.h>
+#include <folly/Executor.h>
+#include <folly/Synchronized.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+
+namespace fizz {
+
+/**
+ * Ephemeral key pairs generated ahead of the handshakes that use them, so
+ * that key generation is not on the handshake path. Every key pair is handed
+ * out only once. Once fewer than half of a group's key pairs are left, the
+ * group is refilled with a task on the executor.
+ *
+ * Thread safe. Must be owned by a shared_ptr (see create()) so that refill
+ * tasks can outlive it.
+ */
+class KeyExchangePool : public std::enable_shared_from_this<KeyExchangePool> {
+ public:
+  using MakeKeyExchange =
+      std::function<std::unique_ptr<KeyExchange>(NamedGroup)>;
+
+  /**
+   * Creates a pool that keeps up to poolSize key pairs for each of groups,
+   * made with make. If executor is null the pool is only refilled by fill().
+   */
+  static std::shared_ptr<KeyExchangePool> create(
+      std::shared_ptr<folly::Executor> executor,
+      const std::vector<NamedGroup>& groups,
+      size_t poolSize,
+      MakeKeyExchange make);
+
+  /**
+   * Returns a key exchange for group with its key pair already generated, or
+   * nullptr if there is none available. The first generateKeyPair() call on
+   * it is a no-op.
+   */
+  std::unique_ptr<KeyExchange> get(NamedGroup group);
+
+  /**
+   * Generates key pairs on the calling thread until every group is full, for
+   * example to warm up the pool at startup.
+   */
+  void fill();
+
+  /**
+   * Number of key pairs available for group.
+   */
+  size_t available(NamedGroup group) const;
+
+ private:
+  struct Group {
+    folly::Synchronized<std::deque<std::unique_ptr<KeyExchange>>> ready;
+    std::atomic<bool> refilling{false};
+  };
+
+  KeyExchangePool(
+      std::shared_ptr<folly::Executor> executor,
+      const std::vector<NamedGroup>& groups,
+      size_t poolSize,
+      MakeKeyExchange make);
+
+  void fill(NamedGroup group, Group& pool);
+
+  std::shared_ptr<folly::Executor> executor_;
+  size_t poolSize_;
+  MakeKeyExchange make_;
+
+  // Not modified after construction.
+  std::map<NamedGroup, std::unique_ptr<Group>> groups_;
+};
+} // namespace fizz
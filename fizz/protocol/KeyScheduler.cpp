@@ -8,6 +8,9 @@
 
 #include <fizz/protocol/KeyScheduler.h>
 
+#include <fizz/crypto/Utils.h>
+#include <fizz/protocol/AllocationStats.h>
+
 using folly::StringPiece;
 
 static constexpr StringPiece kTrafficKey{"key"};
@@ -29,56 +32,142 @@ static constexpr StringPiece kResumption{"resumption"};
 
 namespace fizz {
 
+static constexpr std::array<uint8_t, kMaxHashLength> kZeros{};
+
+folly::ByteRange KeyScheduler::zeros() const {
+  return folly::range(kZeros).subpiece(0, deriver_->hashLength());
+}
+
+InlineSecret KeyScheduler::extract(folly::ByteRange salt, folly::ByteRange ikm)
+    const {
+  InlineSecret secret(deriver_->hashLength());
+  deriver_->hkdfExtract(salt, ikm, secret.writableRange());
+  return secret;
+}
+
+namespace {
+struct KeyedSecretOf : boost::static_visitor<std::shared_ptr<KeyedSecret>&> {
+  template <typename Secret>
+  std::shared_ptr<KeyedSecret>& operator()(Secret& secret) const {
+    return secret.secret;
+  }
+};
+} // namespace
+
+std::shared_ptr<KeyedSecret> KeyScheduler::keyed(const InlineSecret& secret) {
+  if (secret_) {
+    auto& current = boost::apply_visitor(KeyedSecretOf(), *secret_);
+    if (current && current.use_count() == 1) {
+      auto rekeyed = std::move(current);
+      rekeyed->rekey(secret.range());
+      return rekeyed;
+    }
+  }
+  return deriver_->keySecret(secret.range());
+}
+
+InlineSecret KeyScheduler::deriveSecret(
+    KeyedSecret& secret,
+    folly::StringPiece label,
+    folly::ByteRange messageHash) const {
+  InlineSecret derived(deriver_->hashLength());
+  secret.deriveSecret(label, messageHash, derived.writableRange());
+  return derived;
+}
+
+Buf KeyScheduler::expandLabel(
+    KeyedSecret& secret,
+    folly::StringPiece label,
+    size_t length) const {
+  auto buf = folly::IOBuf::create(length);
+  buf->append(length);
+  secret.expandLabel(
+      label,
+      folly::ByteRange(),
+      folly::MutableByteRange(buf->writableData(), length));
+  return buf;
+}
+
 void KeyScheduler::deriveEarlySecret(folly::ByteRange psk) {
+  AllocationStats::Scope allocationScope(AllocationSite::KeySchedule);
   if (secret_) {
     throw std::runtime_error("secret already set");
   }
 
-  auto zeros = std::vector<uint8_t>(deriver_->hashLength(), 0);
-  secret_ = EarlySecret{deriver_->hkdfExtract(folly::range(zeros), psk)};
+  secret_ = EarlySecret{keyed(extract(zeros(), psk))};
 }
 
 void KeyScheduler::deriveHandshakeSecret() {
+  AllocationStats::Scope allocationScope(AllocationSite::KeySchedule);
   auto& earlySecret = boost::get<EarlySecret>(*secret_);
-  auto zeros = std::vector<uint8_t>(deriver_->hashLength(), 0);
-  auto preSecret = deriver_->deriveSecret(
-      folly::range(earlySecret.secret), kDerivedSecret, deriver_->blankHash());
-  secret_ = HandshakeSecret{
-      deriver_->hkdfExtract(folly::range(preSecret), folly::range(zeros))};
+  auto preSecret = deriveSecret(
+      *earlySecret.secret, kDerivedSecret, deriver_->blankHash());
+  secret_ = HandshakeSecret{keyed(extract(preSecret.range(), zeros()))};
 }
 
 void KeyScheduler::deriveHandshakeSecret(folly::ByteRange ecdhe) {
+  AllocationStats::Scope allocationScope(AllocationSite::KeySchedule);
   if (!secret_) {
-    auto zeros = std::vector<uint8_t>(deriver_->hashLength(), 0);
-    secret_ = EarlySecret{
-        deriver_->hkdfExtract(folly::range(zeros), folly::range(zeros))};
+    // Without a PSK the early secret, and so the salt of the handshake
+    // secret, only depend on the hash.
+    auto derivedSecret = deriver_->noPskDerivedSecret();
+    if (!derivedSecret.empty()) {
+      secret_ = HandshakeSecret{keyed(extract(derivedSecret, ecdhe))};
+      return;
+    }
+    secret_ = EarlySecret{keyed(extract(zeros(), zeros()))};
   }
 
   auto& earlySecret = boost::get<EarlySecret>(*secret_);
-  auto preSecret = deriver_->deriveSecret(
-      folly::range(earlySecret.secret), kDerivedSecret, deriver_->blankHash());
-  secret_ =
-      HandshakeSecret{deriver_->hkdfExtract(folly::range(preSecret), ecdhe)};
+  auto preSecret = deriveSecret(
+      *earlySecret.secret, kDerivedSecret, deriver_->blankHash());
+  secret_ = HandshakeSecret{keyed(extract(preSecret.range(), ecdhe))};
 }
 
 void KeyScheduler::deriveMasterSecret() {
-  auto zeros = std::vector<uint8_t>(deriver_->hashLength(), 0);
+  AllocationStats::Scope allocationScope(AllocationSite::KeySchedule);
   auto& handshakeSecret = boost::get<HandshakeSecret>(*secret_);
-  auto preSecret = deriver_->deriveSecret(
-      folly::range(handshakeSecret.secret),
-      kDerivedSecret,
-      deriver_->blankHash());
-  secret_ = MasterSecret{
-      deriver_->hkdfExtract(folly::range(preSecret), folly::range(zeros))};
+  auto preSecret = deriveSecret(
+      *handshakeSecret.secret, kDerivedSecret, deriver_->blankHash());
+  secret_ = MasterSecret{keyed(extract(preSecret.range(), zeros()))};
 }
 
 void KeyScheduler::deriveAppTrafficSecrets(folly::ByteRange transcript) {
+  AllocationStats::Scope allocationScope(AllocationSite::KeySchedule);
   auto& masterSecret = boost::get<MasterSecret>(*secret_);
+  if (arena_) {
+    arena_->wipe();
+  } else {
+    arena_ = std::make_unique<SecretArena>();
+  }
+  AppTrafficSecret trafficSecret;
+  trafficSecret.client = arena_->allocate(deriver_->hashLength());
+  masterSecret.secret->deriveSecret(
+      kClientAppTraffic, transcript, trafficSecret.client);
+  trafficSecret.server = arena_->allocate(deriver_->hashLength());
+  masterSecret.secret->deriveSecret(
+      kServerAppTraffic, transcript, trafficSecret.server);
+  appTrafficSecret_ = std::move(trafficSecret);
+}
+
+void KeyScheduler::setAppTrafficSecrets(
+    folly::ByteRange clientSecret,
+    folly::ByteRange serverSecret) {
+  if (clientSecret.size() != deriver_->hashLength() ||
+      serverSecret.size() != deriver_->hashLength()) {
+    throw std::runtime_error("traffic secret length mismatch");
+  }
+  secret_ = folly::none;
+  if (arena_) {
+    arena_->wipe();
+  } else {
+    arena_ = std::make_unique<SecretArena>();
+  }
   AppTrafficSecret trafficSecret;
-  trafficSecret.client = deriver_->deriveSecret(
-      folly::range(masterSecret.secret), kClientAppTraffic, transcript);
-  trafficSecret.server = deriver_->deriveSecret(
-      folly::range(masterSecret.secret), kServerAppTraffic, transcript);
+  trafficSecret.client = arena_->allocate(deriver_->hashLength());
+  memcpy(trafficSecret.client.data(), clientSecret.data(), clientSecret.size());
+  trafficSecret.server = arena_->allocate(deriver_->hashLength());
+  memcpy(trafficSecret.server.data(), serverSecret.data(), serverSecret.size());
   appTrafficSecret_ = std::move(trafficSecret);
 }
 
@@ -87,59 +176,102 @@ void KeyScheduler::clearMasterSecret() {
   secret_ = folly::none;
 }
 
+void KeyScheduler::updateTrafficSecret(folly::MutableByteRange secret) const {
+  InlineSecret updated(deriver_->hashLength());
+  deriver_->expandLabel(
+      secret, kTrafficKeyUpdate, folly::ByteRange(), updated.writableRange());
+  memcpy(secret.data(), updated.range().data(), secret.size());
+  CryptoUtils::clean(updated.writableRange());
+}
+
 uint32_t KeyScheduler::clientKeyUpdate() {
   auto& appTrafficSecret = *appTrafficSecret_;
-  auto buf = deriver_->expandLabel(
-      folly::range(appTrafficSecret.client),
-      kTrafficKeyUpdate,
-      folly::IOBuf::create(0),
-      deriver_->hashLength());
-  buf->coalesce();
-  appTrafficSecret.client = std::vector<uint8_t>(buf->data(), buf->tail());
+  updateTrafficSecret(appTrafficSecret.client);
   return ++appTrafficSecret.clientGeneration;
 }
 
 uint32_t KeyScheduler::serverKeyUpdate() {
   auto& appTrafficSecret = *appTrafficSecret_;
-  auto buf = deriver_->expandLabel(
-      folly::range(appTrafficSecret.server),
-      kTrafficKeyUpdate,
-      folly::IOBuf::create(0),
-      deriver_->hashLength());
-  buf->coalesce();
-  appTrafficSecret.server = std::vector<uint8_t>(buf->data(), buf->tail());
+  updateTrafficSecret(appTrafficSecret.server);
   return ++appTrafficSecret.serverGeneration;
 }
 
+std::vector<uint8_t> KeyScheduler::getNextSecret(AppTrafficSecrets s) const {
+  auto& appTrafficSecret = *appTrafficSecret_;
+  folly::ByteRange secret;
+  switch (s) {
+    case AppTrafficSecrets::ClientAppTraffic:
+      secret = appTrafficSecret.client;
+      break;
+    case AppTrafficSecrets::ServerAppTraffic:
+      secret = appTrafficSecret.server;
+      break;
+    default:
+      LOG(FATAL) << "unknown secret";
+  }
+  std::vector<uint8_t> next(deriver_->hashLength());
+  deriver_->expandLabel(
+      secret, kTrafficKeyUpdate, folly::ByteRange(), folly::range(next));
+  return next;
+}
+
 std::vector<uint8_t> KeyScheduler::getSecret(
     EarlySecrets s,
     folly::ByteRange transcript) const {
-  StringPiece label;
+  std::vector<uint8_t> secret(deriver_->hashLength());
+  getSecret(s, transcript, folly::range(secret));
+  return secret;
+}
+
+std::vector<uint8_t> KeyScheduler::getSecret(
+    HandshakeSecrets s,
+    folly::ByteRange transcript) const {
+  std::vector<uint8_t> secret(deriver_->hashLength());
+  getSecret(s, transcript, folly::range(secret));
+  return secret;
+}
+
+std::vector<uint8_t> KeyScheduler::getSecret(
+    MasterSecrets s,
+    folly::ByteRange transcript) const {
+  std::vector<uint8_t> secret(deriver_->hashLength());
+  getSecret(s, transcript, folly::range(secret));
+  return secret;
+}
+
+std::vector<uint8_t> KeyScheduler::getSecret(AppTrafficSecrets s) const {
+  std::vector<uint8_t> secret(deriver_->hashLength());
+  getSecret(s, folly::range(secret));
+  return secret;
+}
+
+static StringPiece getLabel(EarlySecrets s) {
   switch (s) {
     case EarlySecrets::ExternalPskBinder:
-      label = kExternalPskBinder;
-      break;
+      return kExternalPskBinder;
     case EarlySecrets::ResumptionPskBinder:
-      label = kResumptionPskBinder;
-      break;
+      return kResumptionPskBinder;
     case EarlySecrets::ClientEarlyTraffic:
-      label = kClientEarlyTraffic;
-      break;
+      return kClientEarlyTraffic;
     case EarlySecrets::EarlyExporter:
-      label = kEarlyExporter;
-      break;
+      return kEarlyExporter;
     default:
       LOG(FATAL) << "unknown secret";
   }
+}
 
+void KeyScheduler::getSecret(
+    EarlySecrets s,
+    folly::ByteRange transcript,
+    folly::MutableByteRange out) const {
   auto& earlySecret = boost::get<EarlySecret>(*secret_);
-  return deriver_->deriveSecret(
-      folly::range(earlySecret.secret), label, transcript);
+  earlySecret.secret->deriveSecret(getLabel(s), transcript, out);
 }
 
-std::vector<uint8_t> KeyScheduler::getSecret(
+void KeyScheduler::getSecret(
     HandshakeSecrets s,
-    folly::ByteRange transcript) const {
+    folly::ByteRange transcript,
+    folly::MutableByteRange out) const {
   StringPiece label;
   switch (s) {
     case HandshakeSecrets::ClientHandshakeTraffic:
@@ -153,61 +285,112 @@ std::vector<uint8_t> KeyScheduler::getSecret(
   }
 
   auto& handshakeSecret = boost::get<HandshakeSecret>(*secret_);
-  return deriver_->deriveSecret(
-      folly::range(handshakeSecret.secret), label, transcript);
+  handshakeSecret.secret->deriveSecret(label, transcript, out);
 }
 
-std::vector<uint8_t> KeyScheduler::getSecret(
-    MasterSecrets s,
-    folly::ByteRange transcript) const {
-  StringPiece label;
+static StringPiece getLabel(MasterSecrets s) {
   switch (s) {
     case MasterSecrets::ExporterMaster:
-      label = kExporterMaster;
-      break;
+      return kExporterMaster;
     case MasterSecrets::ResumptionMaster:
-      label = kResumptionMaster;
-      break;
+      return kResumptionMaster;
     default:
       LOG(FATAL) << "unknown secret";
   }
+}
 
+void KeyScheduler::getSecret(
+    MasterSecrets s,
+    folly::ByteRange transcript,
+    folly::MutableByteRange out) const {
   auto& masterSecret = boost::get<MasterSecret>(*secret_);
-  return deriver_->deriveSecret(
-      folly::range(masterSecret.secret), label, transcript);
+  masterSecret.secret->deriveSecret(getLabel(s), transcript, out);
 }
 
-std::vector<uint8_t> KeyScheduler::getSecret(AppTrafficSecrets s) const {
+folly::Function<std::vector<uint8_t>()> KeyScheduler::defer(
+    std::shared_ptr<KeyedSecret> secret,
+    folly::StringPiece label,
+    folly::ByteRange transcript) const {
+  InlineSecret transcriptHash(transcript.size());
+  memcpy(
+      transcriptHash.writableRange().data(),
+      transcript.data(),
+      transcript.size());
+  return [secret = std::move(secret),
+          label,
+          transcriptHash,
+          length = deriver_->hashLength()]() {
+    std::vector<uint8_t> derived(length);
+    secret->deriveSecret(label, transcriptHash.range(), folly::range(derived));
+    return derived;
+  };
+}
+
+folly::Function<std::vector<uint8_t>()> KeyScheduler::getDeferredSecret(
+    EarlySecrets s,
+    folly::ByteRange transcript) const {
+  auto& earlySecret = boost::get<EarlySecret>(*secret_);
+  return defer(earlySecret.secret, getLabel(s), transcript);
+}
+
+folly::Function<std::vector<uint8_t>()> KeyScheduler::getDeferredSecret(
+    MasterSecrets s,
+    folly::ByteRange transcript) const {
+  auto& masterSecret = boost::get<MasterSecret>(*secret_);
+  return defer(masterSecret.secret, getLabel(s), transcript);
+}
+
+void KeyScheduler::getSecret(AppTrafficSecrets s, folly::MutableByteRange out)
+    const {
   auto& appTrafficSecret = *appTrafficSecret_;
+  folly::ByteRange secret;
   switch (s) {
     case AppTrafficSecrets::ClientAppTraffic:
-      return appTrafficSecret.client;
+      secret = appTrafficSecret.client;
+      break;
     case AppTrafficSecrets::ServerAppTraffic:
-      return appTrafficSecret.server;
+      secret = appTrafficSecret.server;
+      break;
     default:
       LOG(FATAL) << "unknown secret";
   }
+  if (secret.size() != out.size()) {
+    throw std::runtime_error("secret length mismatch");
+  }
+  memcpy(out.data(), secret.data(), out.size());
 }
 
 TrafficKey KeyScheduler::getTrafficKey(
     folly::ByteRange trafficSecret,
     size_t keyLength,
     size_t ivLength) const {
+  AllocationStats::Scope allocationScope(AllocationSite::KeySchedule);
+  if (trafficKeyed_) {
+    trafficKeyed_->rekey(trafficSecret);
+  } else {
+    trafficKeyed_ = deriver_->keySecret(trafficSecret);
+  }
   TrafficKey trafficKey;
-  trafficKey.key = deriver_->expandLabel(
-      trafficSecret, kTrafficKey, folly::IOBuf::create(0), keyLength);
-  trafficKey.iv = deriver_->expandLabel(
-      trafficSecret, kTrafficIv, folly::IOBuf::create(0), ivLength);
+  trafficKey.key = expandLabel(*trafficKeyed_, kTrafficKey, keyLength);
+  trafficKey.iv = expandLabel(*trafficKeyed_, kTrafficIv, ivLength);
   return trafficKey;
 }
 
 Buf KeyScheduler::getResumptionSecret(
     folly::ByteRange resumptionMasterSecret,
     folly::ByteRange ticketNonce) const {
+  AllocationStats::Scope allocationScope(AllocationSite::KeySchedule);
   return deriver_->expandLabel(
       resumptionMasterSecret,
       kResumption,
       folly::IOBuf::wrapBuffer(ticketNonce),
       deriver_->hashLength());
 }
+
+void KeyScheduler::getResumptionSecret(
+    folly::ByteRange resumptionMasterSecret,
+    folly::ByteRange ticketNonce,
+    folly::MutableByteRange out) const {
+  deriver_->expandLabel(resumptionMasterSecret, kResumption, ticketNonce, out);
+}
 } // namespace fizz
@@ -9,7 +9,9 @@
 #pragma once
 
 #include <fizz/crypto/KeyDerivation.h>
+#include <fizz/crypto/SecretArena.h>
 #include <fizz/crypto/aead/Aead.h>
+#include <folly/Function.h>
 #include <folly/Optional.h>
 
 namespace fizz {
@@ -27,6 +29,53 @@ enum class MasterSecrets { ExporterMaster, ResumptionMaster };
 
 enum class AppTrafficSecrets { ClientAppTraffic, ServerAppTraffic };
 
+/**
+ * A secret that is derived the first time it is used rather than when the
+ * handshake reaches it, for secrets that a connection may never need. It can
+ * also hold an already derived secret.
+ */
+template <typename T>
+class DeferredSecret {
+ public:
+  DeferredSecret() = default;
+
+  /* implicit */ DeferredSecret(T secret) : secret_(std::move(secret)) {}
+
+  explicit DeferredSecret(folly::Function<T()> derive)
+      : derive_(std::move(derive)) {}
+
+  bool hasValue() const {
+    return secret_.hasValue() || derive_;
+  }
+
+  explicit operator bool() const {
+    return hasValue();
+  }
+
+  /**
+   * Returns the secret, deriving it on the first call. Throws if there is no
+   * secret.
+   */
+  const T& value() const {
+    if (!secret_) {
+      if (!derive_) {
+        throw std::runtime_error("secret not available");
+      }
+      secret_ = derive_();
+      derive_ = nullptr;
+    }
+    return *secret_;
+  }
+
+  const T& operator*() const {
+    return value();
+  }
+
+ private:
+  mutable folly::Optional<T> secret_;
+  mutable folly::Function<T()> derive_;
+};
+
 /**
  * Keeps track of the TLS 1.3 key derivation schedule.
  */
@@ -63,6 +112,15 @@ class KeyScheduler {
    */
   virtual void deriveAppTrafficSecrets(folly::ByteRange transcript);
 
+  /**
+   * Sets the current app traffic secrets directly, to continue a connection
+   * whose handshake was done elsewhere (eg by another process before a
+   * restart). Clears any other secret.
+   */
+  virtual void setAppTrafficSecrets(
+      folly::ByteRange clientSecret,
+      folly::ByteRange serverSecret);
+
   /**
    * Clears the master secret. Must be in master secret state.
    */
@@ -80,6 +138,12 @@ class KeyScheduler {
    */
   virtual uint32_t serverKeyUpdate();
 
+  /**
+   * Returns the traffic secret that the next clientKeyUpdate() or
+   * serverKeyUpdate() will produce, without performing the update.
+   */
+  virtual std::vector<uint8_t> getNextSecret(AppTrafficSecrets s) const;
+
   /**
    * Retreive a secret from the scheduler. Must be in the appropriate state.
    */
@@ -94,6 +158,45 @@ class KeyScheduler {
       folly::ByteRange transcript) const;
   virtual std::vector<uint8_t> getSecret(AppTrafficSecrets s) const;
 
+  /**
+   * Same as getSecret() above, but writes the secret into out, which must be
+   * secretLength() bytes, instead of allocating it.
+   */
+  virtual void getSecret(
+      EarlySecrets s,
+      folly::ByteRange transcript,
+      folly::MutableByteRange out) const;
+  virtual void getSecret(
+      HandshakeSecrets s,
+      folly::ByteRange transcript,
+      folly::MutableByteRange out) const;
+  virtual void getSecret(
+      MasterSecrets s,
+      folly::ByteRange transcript,
+      folly::MutableByteRange out) const;
+  virtual void getSecret(AppTrafficSecrets s, folly::MutableByteRange out)
+      const;
+
+  /**
+   * Same as getSecret() above, but returns a function that derives the secret
+   * when called. It keeps the current secret and transcript, so it can be
+   * called after the schedule has moved on (or clearMasterSecret()), but must
+   * not outlive this scheduler.
+   */
+  virtual folly::Function<std::vector<uint8_t>()> getDeferredSecret(
+      EarlySecrets s,
+      folly::ByteRange transcript) const;
+  virtual folly::Function<std::vector<uint8_t>()> getDeferredSecret(
+      MasterSecrets s,
+      folly::ByteRange transcript) const;
+
+  /**
+   * Length of the secrets in this schedule (the hash length).
+   */
+  size_t secretLength() const {
+    return deriver_->hashLength();
+  }
+
   /**
    * Derive a traffic key and iv from a traffic secret.
    */
@@ -110,25 +213,59 @@ class KeyScheduler {
       folly::ByteRange resumptionMasterSecret,
       folly::ByteRange ticketNonce) const;
 
+  /**
+   * Same as above, but writes the resumption secret into out, which must be
+   * secretLength() bytes.
+   */
+  virtual void getResumptionSecret(
+      folly::ByteRange resumptionMasterSecret,
+      folly::ByteRange ticketNonce,
+      folly::MutableByteRange out) const;
+
  private:
+  // The early, handshake and master secrets are each expanded several times,
+  // so they are kept keyed into the HMAC rather than as raw bytes. Each stage
+  // rekeys the previous stage's KeyedSecret unless a deferred derivation
+  // still holds it.
   struct EarlySecret {
-    std::vector<uint8_t> secret;
+    std::shared_ptr<KeyedSecret> secret;
   };
   struct HandshakeSecret {
-    std::vector<uint8_t> secret;
+    std::shared_ptr<KeyedSecret> secret;
   };
   struct MasterSecret {
-    std::vector<uint8_t> secret;
+    std::shared_ptr<KeyedSecret> secret;
   };
+  // The traffic secrets live for the whole connection, so they are kept in
+  // arena_ and wiped with it.
   struct AppTrafficSecret {
-    std::vector<uint8_t> client;
+    folly::MutableByteRange client;
     uint32_t clientGeneration{0};
-    std::vector<uint8_t> server;
+    folly::MutableByteRange server;
     uint32_t serverGeneration{0};
   };
 
+  void updateTrafficSecret(folly::MutableByteRange secret) const;
+
+  InlineSecret extract(folly::ByteRange salt, folly::ByteRange ikm) const;
+  std::shared_ptr<KeyedSecret> keyed(const InlineSecret& secret);
+  InlineSecret deriveSecret(
+      KeyedSecret& secret,
+      folly::StringPiece label,
+      folly::ByteRange messageHash) const;
+  Buf expandLabel(KeyedSecret& secret, folly::StringPiece label, size_t length)
+      const;
+  folly::ByteRange zeros() const;
+  folly::Function<std::vector<uint8_t>()> defer(
+      std::shared_ptr<KeyedSecret> secret,
+      folly::StringPiece label,
+      folly::ByteRange transcript) const;
+
   folly::Optional<boost::variant<EarlySecret, HandshakeSecret, MasterSecret>>
       secret_;
+  std::unique_ptr<SecretArena> arena_;
+  // Reused by getTrafficKey() for each traffic secret.
+  mutable std::unique_ptr<KeyedSecret> trafficKeyed_;
   folly::Optional<AppTrafficSecret> appTrafficSecret_;
 
   std::unique_ptr<KeyDerivation> deriver_;
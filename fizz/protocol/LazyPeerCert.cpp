@@ -0,0 +1,83 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/LazyPeerCert.h>
+
+#include <folly/ssl/OpenSSLCertUtils.h>
+
+namespace fizz {
+
+LazyPeerCert::LazyPeerCert(Buf certData, Parser parser)
+    : certData_(std::move(certData)), parser_(std::move(parser)) {}
+
+LazyPeerCert::LazyPeerCert(Buf certData, Parser parser, std::string identity)
+    : certData_(std::move(certData)),
+      parser_(std::move(parser)),
+      identity_(std::move(identity)) {}
+
+std::shared_ptr<const PeerCert> LazyPeerCert::getCert() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (cert_) {
+    return cert_;
+  }
+  // Parse a clone so that a failed parse throws again on the next use.
+  auto cert = parser_(certData_->clone());
+  if (!cert) {
+    throw std::runtime_error("could not parse peer cert");
+  }
+  if (!identity_) {
+    cert_ = cert;
+    certData_.reset();
+  }
+  return std::move(cert);
+}
+
+std::string LazyPeerCert::getIdentity() const {
+  if (identity_) {
+    return *identity_;
+  }
+  return getCert()->getIdentity();
+}
+
+void LazyPeerCert::verify(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    folly::ByteRange toBeSigned,
+    folly::ByteRange signature) const {
+  getCert()->verify(scheme, context, toBeSigned, signature);
+}
+
+folly::ssl::X509UniquePtr LazyPeerCert::getX509() const {
+  return getCert()->getX509();
+}
+
+std::shared_ptr<const Cert> retainPeerCert(
+    std::shared_ptr<const PeerCert> cert,
+    PeerCertRetention retention) {
+  switch (retention) {
+    case PeerCertRetention::Parsed:
+      break;
+    case PeerCertRetention::Encoded: {
+      auto x509 = cert->getX509();
+      if (!x509) {
+        break;
+      }
+      return std::make_shared<const LazyPeerCert>(
+          folly::ssl::OpenSSLCertUtils::derEncode(*x509),
+          [](Buf certData) {
+            return std::shared_ptr<PeerCert>(
+                CertUtils::makePeerCert(std::move(certData)));
+          },
+          cert->getIdentity());
+    }
+    case PeerCertRetention::IdentityOnly:
+      return std::make_shared<const IdentityCert>(cert->getIdentity());
+  }
+  return std::move(cert);
+}
+} // namespace fizz
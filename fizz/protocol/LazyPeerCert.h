@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/Certificate.h>
+
+#include <functional>
+#include <mutex>
+
+namespace fizz {
+
+/**
+ * PeerCert that holds on to the encoded certificate (typically a slice of
+ * the received Certificate message) and only parses it, with parser, the
+ * first time it is used. Used for the non-leaf entries of a peer's chain,
+ * which are only needed if a verifier looks at them. Throws from any method
+ * if the certificate can't be parsed.
+ */
+class LazyPeerCert : public PeerCert {
+ public:
+  using Parser = std::function<std::shared_ptr<PeerCert>(Buf)>;
+
+  LazyPeerCert(Buf certData, Parser parser);
+
+  /**
+   * Only ever keeps the encoded certificate, for certificates that are kept
+   * for the lifetime of a connection: each use parses it again and drops
+   * the parse afterwards. getIdentity() returns identity without parsing.
+   */
+  LazyPeerCert(Buf certData, Parser parser, std::string identity);
+
+  ~LazyPeerCert() override = default;
+
+  std::string getIdentity() const override;
+
+  void verify(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      folly::ByteRange toBeSigned,
+      folly::ByteRange signature) const override;
+
+  folly::ssl::X509UniquePtr getX509() const override;
+
+  bool isParsed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cert_ != nullptr;
+  }
+
+  /**
+   * Returns a copy of the encoded certificate if it hasn't been parsed yet,
+   * and nullptr otherwise.
+   */
+  Buf getUnparsedCertData() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cert_ ? nullptr : certData_->clone();
+  }
+
+  /**
+   * Size of the encoded certificate still held, 0 once it has been parsed.
+   */
+  size_t getEncodedLength() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return certData_ ? certData_->computeChainDataLength() : 0;
+  }
+
+ private:
+  /**
+   * Returns the parsed certificate, parsing it if needed.
+   */
+  std::shared_ptr<const PeerCert> getCert() const;
+
+  mutable std::mutex mutex_;
+  mutable Buf certData_;
+  Parser parser_;
+  folly::Optional<std::string> identity_;
+  mutable std::shared_ptr<PeerCert> cert_;
+};
+
+/**
+ * How much of a peer's leaf certificate a connection keeps once it has been
+ * verified. The rest of the chain is always dropped after verification.
+ */
+enum class PeerCertRetention {
+  // The certificate as parsed during the handshake.
+  Parsed,
+  // Only its DER encoding and identity, as a LazyPeerCert that parses the
+  // encoding again each time the certificate itself is used.
+  Encoded,
+  // Only its identity, as an IdentityCert. getX509() returns nullptr.
+  IdentityOnly
+};
+
+/**
+ * Returns what to keep of a verified peer certificate under retention.
+ * Certificates without an X509 (raw public keys) are kept parsed under
+ * Encoded.
+ */
+std::shared_ptr<const Cert> retainPeerCert(
+    std::shared_ptr<const PeerCert> cert,
+    PeerCertRetention retention);
+} // namespace fizz
@@ -0,0 +1,39 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/MemoryUsage.h>
+
+#include <folly/io/async/EventBaseLocal.h>
+
+namespace fizz {
+
+MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other) {
+  readBufferBytes += other.readBufferBytes;
+  writeBufferBytes += other.writeBufferBytes;
+  pendingEventBytes += other.pendingEventBytes;
+  stateBytes += other.stateBytes;
+  cipherBytes += other.cipherBytes;
+  peerCertBytes += other.peerCertBytes;
+  return *this;
+}
+
+MemoryUsage& MemoryUsage::operator-=(const MemoryUsage& other) {
+  readBufferBytes -= other.readBufferBytes;
+  writeBufferBytes -= other.writeBufferBytes;
+  pendingEventBytes -= other.pendingEventBytes;
+  stateBytes -= other.stateBytes;
+  cipherBytes -= other.cipherBytes;
+  peerCertBytes -= other.peerCertBytes;
+  return *this;
+}
+
+MemoryUsageTracker& MemoryUsageTracker::get(folly::EventBase& evb) {
+  static folly::EventBaseLocal<MemoryUsageTracker> trackers;
+  return trackers.getOrCreate(evb);
+}
+} // namespace fizz
@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/io/async/EventBase.h>
+
+namespace fizz {
+
+/**
+ * Approximate bytes of memory held by a connection, by what holds them.
+ * Buffers are counted by capacity, and buffers shared with other connections
+ * or with the app are counted in full.
+ */
+struct MemoryUsage {
+  // Transport data not yet processed and app data not yet delivered.
+  size_t readBufferBytes{0};
+  // App writes corked or queued for pacing.
+  size_t writeBufferBytes{0};
+  // Events queued behind the state machine, including their data.
+  size_t pendingEventBytes{0};
+  // The transport and state machine objects themselves.
+  size_t stateBytes{0};
+  // Record protection state, such as cipher contexts.
+  size_t cipherBytes{0};
+  // The DER encoding of the peer's certificate, and of the rest of its chain
+  // while it is being verified.
+  size_t peerCertBytes{0};
+
+  size_t total() const {
+    return readBufferBytes + writeBufferBytes + pendingEventBytes +
+        stateBytes + cipherBytes + peerCertBytes;
+  }
+
+  MemoryUsage& operator+=(const MemoryUsage& other);
+  MemoryUsage& operator-=(const MemoryUsage& other);
+};
+
+/**
+ * Sum of the memory usage of the connections on one EventBase that have
+ * memory usage tracking enabled. Each connection adds the change in its usage
+ * whenever it reports it, so reading the total is cheap however many
+ * connections there are.
+ *
+ * Not thread safe; only use from the thread running the EventBase.
+ */
+class MemoryUsageTracker {
+ public:
+  /**
+   * Returns the tracker for evb, creating it if needed. It is destroyed with
+   * the EventBase.
+   */
+  static MemoryUsageTracker& get(folly::EventBase& evb);
+
+  void addConnection() {
+    ++connections_;
+  }
+
+  /**
+   * Remove a connection along with the usage it last reported.
+   */
+  void removeConnection(const MemoryUsage& reported) {
+    total_ -= reported;
+    --connections_;
+  }
+
+  /**
+   * Replace the usage previously reported by a connection with current.
+   */
+  void update(const MemoryUsage& previous, const MemoryUsage& current) {
+    total_ -= previous;
+    total_ += current;
+  }
+
+  const MemoryUsage& getTotal() const {
+    return total_;
+  }
+
+  size_t getConnections() const {
+    return connections_;
+  }
+
+ private:
+  MemoryUsage total_;
+  size_t connections_{0};
+};
+} // namespace fizz
@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/io/async/AsyncTransport.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace fizz {
+
+/**
+ * One of the writes merged into a single write: its callback (which may be
+ * null) and how many bytes it contributed.
+ */
+struct MergedWrite {
+  folly::AsyncTransportWrapper::WriteCallback* callback;
+  size_t bytes;
+};
+
+/**
+ * Write callback for a write made of several merged writes. Reports the
+ * result to each of the original callbacks, in order, and then deletes itself.
+ * On error, the bytes written are attributed to the writes in order.
+ */
+class MergedWriteCallback : public folly::AsyncTransportWrapper::WriteCallback {
+ public:
+  explicit MergedWriteCallback(std::vector<MergedWrite> writes)
+      : writes_(std::move(writes)) {}
+
+  void writeSuccess() noexcept override {
+    for (const auto& write : writes_) {
+      if (write.callback) {
+        write.callback->writeSuccess();
+      }
+    }
+    delete this;
+  }
+
+  void writeErr(
+      size_t bytesWritten,
+      const folly::AsyncSocketException& ex) noexcept override {
+    for (const auto& write : writes_) {
+      auto written = std::min(bytesWritten, write.bytes);
+      bytesWritten -= written;
+      if (write.callback) {
+        write.callback->writeErr(written, ex);
+      }
+    }
+    delete this;
+  }
+
+ private:
+  std::vector<MergedWrite> writes_;
+};
+
+/**
+ * Returns a single callback for a write made by merging several writes, in
+ * order: null if none of them has a callback, the callback of the first write
+ * if no other write has one, and a MergedWriteCallback otherwise.
+ */
+inline folly::AsyncTransportWrapper::WriteCallback* combineWriteCallbacks(
+    std::vector<MergedWrite> writes) {
+  // Writes after the last callback don't affect what any callback is told.
+  while (!writes.empty() && !writes.back().callback) {
+    writes.pop_back();
+  }
+  if (writes.empty()) {
+    return nullptr;
+  } else if (writes.size() == 1) {
+    return writes.front().callback;
+  } else {
+    return new MergedWriteCallback(std::move(writes));
+  }
+}
+} // namespace fizz
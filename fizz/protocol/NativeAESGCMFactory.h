@@ -0,0 +1,48 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/aead/NativeAESGCM.h>
+#include <fizz/crypto/aead/NativeAESOCB.h>
+#include <fizz/protocol/Factory.h>
+
+namespace fizz {
+
+/**
+ * Factory that uses NativeAESGCM for the AES-GCM cipher suites, and
+ * NativeAESOCB for the experimental AES-OCB suite, when the CPU supports it.
+ * Everything else (and these suites on CPUs without AES-NI and PCLMULQDQ)
+ * goes through the default OpenSSL implementations.
+ */
+class NativeAESGCMFactory : public Factory {
+ public:
+  std::unique_ptr<Aead> makeAead(CipherSuite cipher) const override {
+    switch (cipher) {
+      case CipherSuite::TLS_AES_128_GCM_SHA256:
+        if (NativeAESGCM<AESGCM128>::isSupported()) {
+          return std::make_unique<NativeAESGCM<AESGCM128>>();
+        }
+        break;
+      case CipherSuite::TLS_AES_256_GCM_SHA384:
+        if (NativeAESGCM<AESGCM256>::isSupported()) {
+          return std::make_unique<NativeAESGCM<AESGCM256>>();
+        }
+        break;
+      case CipherSuite::TLS_AES_128_OCB_SHA256_EXPERIMENTAL:
+        if (NativeAESOCB<AESOCB128>::isSupported()) {
+          return std::make_unique<NativeAESOCB<AESOCB128>>();
+        }
+        break;
+      default:
+        break;
+    }
+    return Factory::makeAead(cipher);
+  }
+};
+} // namespace fizz
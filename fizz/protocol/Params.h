@@ -19,6 +19,7 @@
 namespace fizz {
 
 class CertificateVerifier;
+struct RecordIovecs;
 class ServerExtensions;
 
 namespace server {
@@ -53,6 +54,10 @@ struct AppWrite : EventType<Event::AppWrite> {
   folly::AsyncTransportWrapper::WriteCallback* callback{nullptr};
   std::unique_ptr<folly::IOBuf> data;
   folly::WriteFlags flags;
+  // If set, the records are appended to it and passed on in
+  // WriteToSocket::iovecs for a vectored write, instead of being returned in
+  // WriteToSocket::data.
+  std::shared_ptr<RecordIovecs> iovecs;
 };
 
 struct AppData : EventType<Event::AppData> {
@@ -76,6 +81,7 @@ using Param = boost::variant<
     EncryptedExtensions,
     CertificateRequest,
     CertificateMsg,
+    CompressedCertificate,
     CertificateVerify,
     Finished,
     NewSessionTicket,
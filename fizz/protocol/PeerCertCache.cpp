@@ -0,0 +1,42 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/PeerCertCache.h>
+
+#include <fizz/crypto/Sha256.h>
+
+namespace fizz {
+
+PeerCertCache::PeerCertCache(size_t capacity) : cache_(Cache(capacity)) {}
+
+std::shared_ptr<PeerCert> PeerCertCache::getPeerCert(Buf certData) {
+  std::string certHash(Sha256::HashLen, '\0');
+  Sha256::hash(
+      *certData,
+      folly::MutableByteRange(
+          reinterpret_cast<uint8_t*>(&certHash[0]), certHash.size()));
+
+  {
+    auto cache = cache_.wlock();
+    auto it = cache->find(certHash);
+    if (it != cache->end()) {
+      return it->second;
+    }
+  }
+
+  // Parse outside of the lock. If another thread races us for the same
+  // certificate one of the (identical) results wins.
+  std::shared_ptr<PeerCert> cert = CertUtils::makePeerCert(std::move(certData));
+  cache_.wlock()->set(certHash, cert);
+  return cert;
+}
+
+size_t PeerCertCache::size() const {
+  return cache_.rlock()->size();
+}
+} // namespace fizz
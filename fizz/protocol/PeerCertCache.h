@@ -0,0 +1,39 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/Certificate.h>
+#include <folly/Synchronized.h>
+#include <folly/container/EvictingCacheMap.h>
+
+namespace fizz {
+
+/**
+ * Interns parsed peer certificates by the SHA-256 of their DER encoding, so
+ * that certificates seen on many connections (typically intermediates) are
+ * parsed once and shared. Safe to use from multiple threads.
+ */
+class PeerCertCache {
+ public:
+  explicit PeerCertCache(size_t capacity);
+
+  /**
+   * Returns the cached PeerCert for certData, parsing and caching it with
+   * CertUtils::makePeerCert() if it is not cached. Throws if certData can't
+   * be parsed.
+   */
+  std::shared_ptr<PeerCert> getPeerCert(Buf certData);
+
+  size_t size() const;
+
+ private:
+  using Cache = folly::EvictingCacheMap<std::string, std::shared_ptr<PeerCert>>;
+  folly::Synchronized<Cache> cache_;
+};
+} // namespace fizz
@@ -0,0 +1,38 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/PinnedKeyVerifier.h>
+
+namespace fizz {
+
+PinnedKeyVerifier::PinnedKeyVerifier(
+    std::unordered_set<std::string> pinnedSpkiHashes)
+    : pinnedSpkiHashes_(std::move(pinnedSpkiHashes)) {}
+
+void PinnedKeyVerifier::verify(
+    const std::vector<std::shared_ptr<const PeerCert>>& certs) const {
+  if (certs.size() != 1) {
+    throw std::runtime_error("expected a single raw public key");
+  }
+  auto rawKey = dynamic_cast<const RawPublicKeyPeerCert*>(certs.front().get());
+  if (!rawKey) {
+    throw std::runtime_error("peer did not present a raw public key");
+  }
+  // getIdentity() is the SPKI hash, but recompute it rather than trust a
+  // PeerCert implementation to have derived it correctly.
+  auto hash = CertUtils::getSpkiHash(rawKey->getSubjectPublicKeyInfo());
+  if (pinnedSpkiHashes_.find(hash) == pinnedSpkiHashes_.end()) {
+    throw std::runtime_error("raw public key is not pinned");
+  }
+}
+
+std::vector<Extension> PinnedKeyVerifier::getCertificateRequestExtensions()
+    const {
+  return std::vector<Extension>();
+}
+} // namespace fizz
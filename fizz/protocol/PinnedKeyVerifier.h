@@ -0,0 +1,35 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/CertificateVerifier.h>
+
+#include <unordered_set>
+
+namespace fizz {
+
+/**
+ * Verifies raw public keys (RFC 7250) against a set of pinned keys. A peer
+ * is accepted if it presented exactly one raw public key whose
+ * CertUtils::getSpkiHash() is pinned, no chain building is done. X509
+ * certificates are always rejected.
+ */
+class PinnedKeyVerifier : public CertificateVerifier {
+ public:
+  explicit PinnedKeyVerifier(std::unordered_set<std::string> pinnedSpkiHashes);
+
+  void verify(const std::vector<std::shared_ptr<const PeerCert>>& certs)
+      const override;
+
+  std::vector<Extension> getCertificateRequestExtensions() const override;
+
+ private:
+  std::unordered_set<std::string> pinnedSpkiHashes_;
+};
+} // namespace fizz
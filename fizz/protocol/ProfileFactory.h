@@ -0,0 +1,123 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/Factory.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace fizz {
+
+/**
+ * The cipher suites of a profile, in order of preference.
+ */
+template <CipherSuite... Suites>
+struct ProfileCiphers {
+  static bool contains(CipherSuite cipher) {
+    const std::array<CipherSuite, sizeof...(Suites)> suites = {{Suites...}};
+    return std::find(suites.begin(), suites.end(), cipher) != suites.end();
+  }
+
+  static std::vector<CipherSuite> list() {
+    std::array<CipherSuite, sizeof...(Suites)> suites = {{Suites...}};
+    return std::vector<CipherSuite>(suites.begin(), suites.end());
+  }
+};
+
+/**
+ * The named groups of a profile, in order of preference.
+ */
+template <NamedGroup... Groups>
+struct ProfileGroups {
+  static bool contains(NamedGroup group) {
+    const std::array<NamedGroup, sizeof...(Groups)> groups = {{Groups...}};
+    return std::find(groups.begin(), groups.end(), group) != groups.end();
+  }
+
+  static std::vector<NamedGroup> list() {
+    std::array<NamedGroup, sizeof...(Groups)> groups = {{Groups...}};
+    return std::vector<NamedGroup>(groups.begin(), groups.end());
+  }
+};
+
+/**
+ * Factory for deployments that only need a few cipher suites and groups,
+ * fixed at compile time by Profile, which provides:
+ *
+ *   - Ciphers: a ProfileCiphers
+ *   - Groups: a ProfileGroups
+ *
+ * Requests for anything outside the profile throw; everything else is made
+ * by the base Factory, so getEngine() and the key exchange pool are used as
+ * usual. This restricts what a context can negotiate even if it's
+ * configured to offer more, it doesn't remove the other implementations
+ * from the binary.
+ *
+ * Contexts using it should only offer what it supports:
+ *
+ *   context->setFactory(std::make_shared<ProfileFactory<MinimalProfile>>());
+ *   context->setSupportedCiphers(
+ *       {ProfileFactory<MinimalProfile>::cipherSuites()});
+ *   context->setSupportedGroups(ProfileFactory<MinimalProfile>::namedGroups());
+ */
+template <typename Profile>
+class ProfileFactory : public Factory {
+ public:
+  static std::vector<CipherSuite> cipherSuites() {
+    return Profile::Ciphers::list();
+  }
+
+  static std::vector<NamedGroup> namedGroups() {
+    return Profile::Groups::list();
+  }
+
+  std::unique_ptr<KeyDerivation> makeKeyDeriver(
+      CipherSuite cipher) const override {
+    if (!Profile::Ciphers::contains(cipher)) {
+      throw std::runtime_error("cipher suite not in profile");
+    }
+    return Factory::makeKeyDeriver(cipher);
+  }
+
+  std::unique_ptr<HandshakeContext> makeHandshakeContext(
+      CipherSuite cipher) const override {
+    if (!Profile::Ciphers::contains(cipher)) {
+      throw std::runtime_error("cipher suite not in profile");
+    }
+    return Factory::makeHandshakeContext(cipher);
+  }
+
+  std::unique_ptr<KeyExchange> makeKeyExchange(
+      NamedGroup group,
+      KeyExchangeMode mode) const override {
+    if (!Profile::Groups::contains(group)) {
+      throw std::runtime_error("ke: not in profile");
+    }
+    return Factory::makeKeyExchange(group, mode);
+  }
+
+  std::unique_ptr<Aead> makeAead(CipherSuite cipher) const override {
+    if (!Profile::Ciphers::contains(cipher)) {
+      throw std::runtime_error("aead: not in profile");
+    }
+    return Factory::makeAead(cipher);
+  }
+};
+
+/**
+ * AES-128-GCM with X25519, enough for most modern clients. The signature
+ * scheme is fixed by the certificate (e.g. a SelfCertImpl<KeyType::P256>).
+ */
+struct MinimalProfile {
+  using Ciphers = ProfileCiphers<CipherSuite::TLS_AES_128_GCM_SHA256>;
+  using Groups = ProfileGroups<NamedGroup::x25519>;
+};
+} // namespace fizz
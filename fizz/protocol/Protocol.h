@@ -23,11 +23,20 @@ class Protocol {
       folly::ByteRange secret,
       const Factory& factory,
       const KeyScheduler& scheduler) {
+    recordLayer.trafficSecretAvailable(cipher, secret);
+    recordLayer.setAead(deriveAead(cipher, secret, factory, scheduler));
+  }
+
+  static std::unique_ptr<Aead> deriveAead(
+      CipherSuite cipher,
+      folly::ByteRange secret,
+      const Factory& factory,
+      const KeyScheduler& scheduler) {
     auto aead = factory.makeAead(cipher);
     auto trafficKey =
         scheduler.getTrafficKey(secret, aead->keyLength(), aead->ivLength());
     aead->setKey(std::move(trafficKey));
-    recordLayer.setAead(std::move(aead));
+    return aead;
   }
 
   static Buf getFinished(
@@ -0,0 +1,127 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace fizz {
+
+/**
+ * FIFO queue that holds up to N elements without allocating, and doubles
+ * into a heap ring buffer beyond that. Unlike std::deque an empty or small
+ * queue never allocates, and queueing after a pop reuses the slot.
+ */
+template <typename T, size_t N>
+class RingQueue {
+  static_assert(N > 0, "RingQueue needs inline capacity");
+
+ public:
+  RingQueue() = default;
+
+  RingQueue(const RingQueue&) = delete;
+  RingQueue& operator=(const RingQueue&) = delete;
+
+  ~RingQueue() {
+    clear();
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  T& front() {
+    return *slot(head_);
+  }
+
+  const T& front() const {
+    return *slot(head_);
+  }
+
+  /**
+   * The element index places from the front.
+   */
+  const T& operator[](size_t index) const {
+    return *slot((head_ + index) % capacity_);
+  }
+
+  /**
+   * Whether the elements have outgrown the inline storage.
+   */
+  bool onHeap() const {
+    return heap_ != nullptr;
+  }
+
+  void push_back(T value) {
+    if (size_ == capacity_) {
+      grow();
+    }
+    new (slot((head_ + size_) % capacity_)) T(std::move(value));
+    ++size_;
+  }
+
+  void pop_front() {
+    slot(head_)->~T();
+    head_ = (head_ + 1) % capacity_;
+    --size_;
+    if (size_ == 0) {
+      head_ = 0;
+    }
+  }
+
+  void clear() {
+    while (!empty()) {
+      pop_front();
+    }
+  }
+
+ private:
+  using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+  T* slot(size_t index) {
+    return reinterpret_cast<T*>(&data_[index]);
+  }
+
+  const T* slot(size_t index) const {
+    return reinterpret_cast<const T*>(&data_[index]);
+  }
+
+  void grow() {
+    auto capacity = capacity_ * 2;
+    std::unique_ptr<Storage[]> heap(new Storage[capacity]);
+    for (size_t i = 0; i < size_; ++i) {
+      auto from = slot((head_ + i) % capacity_);
+      new (&heap[i]) T(std::move(*from));
+      from->~T();
+    }
+    heap_ = std::move(heap);
+    data_ = heap_.get();
+    capacity_ = capacity;
+    head_ = 0;
+  }
+
+  Storage inline_[N];
+  std::unique_ptr<Storage[]> heap_;
+  Storage* data_{inline_};
+  size_t capacity_{N};
+  size_t head_{0};
+  size_t size_{0};
+};
+} // namespace fizz
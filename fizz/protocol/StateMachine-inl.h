@@ -35,6 +35,14 @@ class EventHandlerBase {
         Or<StateSame<SM, to, AllowedStates>...>::value, "Transition invalid");
     CHECK_EQ(stateStruct.state(), state);
     VLOG(8) << "Transition from " << toString(state) << " to " << toString(to);
+    auto context = stateStruct.context();
+    if (context && context->getHandshakeTracer()) {
+      context->getHandshakeTracer()->stateTransition(
+          stateStruct.handshakeId(),
+          std::chrono::steady_clock::now(),
+          toString(state),
+          toString(to));
+    }
     stateStruct.state() = to;
   }
 };
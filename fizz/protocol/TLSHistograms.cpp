@@ -0,0 +1,278 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/TLSHistograms.h>
+
+#include <folly/hash/Hash.h>
+#include <folly/lang/Bits.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace fizz {
+
+constexpr size_t HistogramSnapshot::kSubBucketBits;
+constexpr size_t HistogramSnapshot::kSubBuckets;
+constexpr size_t HistogramSnapshot::kMaxValueBits;
+constexpr uint64_t HistogramSnapshot::kMaxValue;
+constexpr size_t HistogramSnapshot::kNumBuckets;
+constexpr size_t HandshakeTimings::kNumSteps;
+
+std::atomic<bool> TLSHistograms::enabled_{false};
+
+TLSHistogram toHistogram(HandshakeStep step) {
+  switch (step) {
+    case HandshakeStep::TicketDecrypt:
+      return TLSHistogram::TicketDecryptNanos;
+    case HandshakeStep::ReplayCache:
+      return TLSHistogram::ReplayCacheNanos;
+    case HandshakeStep::KeyExchange:
+      return TLSHistogram::KeyExchangeNanos;
+    case HandshakeStep::Sign:
+      return TLSHistogram::SignNanos;
+    case HandshakeStep::TicketEncrypt:
+      return TLSHistogram::TicketEncryptNanos;
+    case HandshakeStep::CertificateVerify:
+      return TLSHistogram::CertificateVerifyNanos;
+  }
+  return TLSHistogram::NumHistograms;
+}
+
+size_t HistogramSnapshot::bucketIndex(uint64_t value) {
+  if (value >= kMaxValue) {
+    return kNumBuckets - 1;
+  }
+  if (value < kSubBuckets) {
+    return value;
+  }
+  // Position of the highest set bit, which is at least kSubBucketBits.
+  size_t shift = folly::findLastSet(value) - 1 - kSubBucketBits;
+  return (shift + 1) * kSubBuckets + ((value >> shift) & (kSubBuckets - 1));
+}
+
+uint64_t HistogramSnapshot::bucketLowerBound(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  size_t shift = index / kSubBuckets - 1;
+  return (kSubBuckets + index % kSubBuckets) << shift;
+}
+
+uint64_t HistogramSnapshot::percentile(double percentile) const {
+  if (count == 0) {
+    return 0;
+  }
+  auto rank = std::max<uint64_t>(
+      1,
+      static_cast<uint64_t>(
+          std::ceil(std::min(percentile, 100.0) / 100.0 * count)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return bucketLowerBound(i);
+    }
+  }
+  return bucketLowerBound(buckets.size() - 1);
+}
+
+namespace {
+struct TLSHistogramKeyHash {
+  size_t operator()(const TLSHistogramKey& key) const {
+    return folly::hash::hash_combine(
+        key.cipher ? static_cast<uint16_t>(*key.cipher) + 1 : 0,
+        key.group ? static_cast<uint16_t>(*key.group) + 1 : 0,
+        key.pskType ? static_cast<int>(*key.pskType) + 1 : 0,
+        key.alpn ? std::hash<std::string>()(*key.alpn) : 0);
+  }
+};
+
+struct Histogram {
+  std::array<std::atomic<uint64_t>, HistogramSnapshot::kNumBuckets> buckets{};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> sum{0};
+};
+
+// Only the owning thread writes, so a relaxed load and store is enough.
+void increment(std::atomic<uint64_t>& stat, uint64_t value) {
+  stat.store(
+      stat.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+} // namespace
+
+struct TLSHistograms::Histograms {
+  std::array<Histogram, static_cast<size_t>(TLSHistogram::NumHistograms)>
+      histograms;
+
+  void accumulate(Snapshot& snapshot) const {
+    for (size_t i = 0; i < histograms.size(); ++i) {
+      auto& histogram = histograms[i];
+      auto& merged = snapshot[i];
+      for (size_t b = 0; b < histogram.buckets.size(); ++b) {
+        merged.buckets[b] +=
+            histogram.buckets[b].load(std::memory_order_relaxed);
+      }
+      merged.count += histogram.count.load(std::memory_order_relaxed);
+      merged.sum += histogram.sum.load(std::memory_order_relaxed);
+    }
+  }
+};
+
+using MergedHistograms = std::
+    unordered_map<TLSHistogramKey, TLSHistograms::Snapshot, TLSHistogramKeyHash>;
+
+struct TLSHistograms::Registry {
+  std::mutex mutex;
+  std::vector<const ThreadHistograms*> threads;
+  // Totals of the threads that have exited.
+  MergedHistograms exited;
+};
+
+/**
+ * Histograms of one thread, registered for aggregation for the lifetime of
+ * the thread. The owning thread looks keys up without locking, as it is the
+ * only writer of the map, and locks to add keys so that getAggregate() can
+ * iterate the map.
+ */
+struct TLSHistograms::ThreadHistograms {
+  ThreadHistograms() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.threads.push_back(this);
+  }
+
+  ~ThreadHistograms() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    accumulate(reg.exited);
+    reg.threads.erase(std::find(reg.threads.begin(), reg.threads.end(), this));
+  }
+
+  Histograms& get(const TLSHistogramKey& key) {
+    auto it = map.find(key);
+    if (it != map.end()) {
+      return *it->second;
+    }
+    auto histograms = std::make_unique<Histograms>();
+    auto& result = *histograms;
+    std::lock_guard<std::mutex> lock(mutex);
+    map.emplace(key, std::move(histograms));
+    return result;
+  }
+
+  void accumulate(MergedHistograms& merged) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& entry : map) {
+      entry.second->accumulate(merged[entry.first]);
+    }
+  }
+
+  mutable std::mutex mutex;
+  std::unordered_map<
+      TLSHistogramKey,
+      std::unique_ptr<Histograms>,
+      TLSHistogramKeyHash>
+      map;
+};
+
+TLSHistograms::ThreadHistograms& TLSHistograms::local() {
+  static thread_local ThreadHistograms threadHistograms;
+  return threadHistograms;
+}
+
+TLSHistograms::Registry& TLSHistograms::registry() {
+  // Leaked so that it outlives the thread local histograms of every thread.
+  static auto reg = new Registry();
+  return *reg;
+}
+
+void TLSHistograms::record(
+    const TLSHistogramKey& key,
+    TLSHistogram histogram,
+    uint64_t value) {
+  auto& stat = local().get(key).histograms[static_cast<size_t>(histogram)];
+  increment(stat.buckets[HistogramSnapshot::bucketIndex(value)], 1);
+  increment(stat.count, 1);
+  increment(stat.sum, value);
+}
+
+std::vector<std::pair<TLSHistogramKey, TLSHistograms::Snapshot>>
+TLSHistograms::getAggregate() {
+  auto& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  auto merged = reg.exited;
+  for (auto thread : reg.threads) {
+    thread->accumulate(merged);
+  }
+  return std::vector<std::pair<TLSHistogramKey, Snapshot>>(
+      std::make_move_iterator(merged.begin()),
+      std::make_move_iterator(merged.end()));
+}
+
+HandshakeTimings::HandshakeTimings(std::shared_ptr<HandshakeTracer> next)
+    : next_(std::move(next)), start_(Clock::now()) {}
+
+void HandshakeTimings::stateTransition(
+    uint64_t handshakeId,
+    Clock::time_point time,
+    folly::StringPiece from,
+    folly::StringPiece to) {
+  if (next_) {
+    next_->stateTransition(handshakeId, time, from, to);
+  }
+}
+
+void HandshakeTimings::asyncStepStarted(
+    uint64_t handshakeId,
+    Clock::time_point time,
+    HandshakeStep step) {
+  stepStarts_[static_cast<size_t>(step)].store(
+      time.time_since_epoch().count(), std::memory_order_relaxed);
+  if (next_) {
+    next_->asyncStepStarted(handshakeId, time, step);
+  }
+}
+
+void HandshakeTimings::asyncStepFinished(
+    uint64_t handshakeId,
+    Clock::time_point time,
+    HandshakeStep step) {
+  auto index = static_cast<size_t>(step);
+  Clock::time_point started(Clock::duration(
+      stepStarts_[index].load(std::memory_order_relaxed)));
+  stepNanos_[index].fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(time - started)
+          .count(),
+      std::memory_order_relaxed);
+  stepsRun_[index].store(true, std::memory_order_release);
+  if (next_) {
+    next_->asyncStepFinished(handshakeId, time, step);
+  }
+}
+
+void HandshakeTimings::record(const TLSHistogramKey& key) const {
+  TLSHistograms::record(
+      key,
+      TLSHistogram::HandshakeNanos,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          Clock::now() - start_)
+          .count());
+  for (size_t i = 0; i < kNumSteps; ++i) {
+    if (stepsRun_[i].load(std::memory_order_acquire)) {
+      TLSHistograms::record(
+          key,
+          toHistogram(static_cast<HandshakeStep>(i)),
+          std::max<int64_t>(
+              0, stepNanos_[i].load(std::memory_order_relaxed)));
+    }
+  }
+}
+} // namespace fizz
@@ -0,0 +1,177 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/HandshakeTracer.h>
+#include <fizz/protocol/Types.h>
+#include <fizz/record/Types.h>
+#include <folly/Optional.h>
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fizz {
+
+/**
+ * Latencies kept by TLSHistograms, in nanoseconds: the whole handshake and
+ * each of its asynchronous steps (see HandshakeStep).
+ */
+enum class TLSHistogram : size_t {
+  HandshakeNanos,
+  TicketDecryptNanos,
+  ReplayCacheNanos,
+  KeyExchangeNanos,
+  SignNanos,
+  TicketEncryptNanos,
+  CertificateVerifyNanos,
+  NumHistograms
+};
+
+/**
+ * The histogram for the time spent in step.
+ */
+TLSHistogram toHistogram(HandshakeStep step);
+
+/**
+ * Negotiated parameters that TLSHistograms are bucketed by.
+ */
+struct TLSHistogramKey {
+  folly::Optional<CipherSuite> cipher;
+  folly::Optional<NamedGroup> group;
+  folly::Optional<PskType> pskType;
+  folly::Optional<std::string> alpn;
+
+  bool operator==(const TLSHistogramKey& other) const {
+    return cipher == other.cipher && group == other.group &&
+        pskType == other.pskType && alpn == other.alpn;
+  }
+};
+
+/**
+ * Merged view of a histogram. Values are bucketed log-linearly, with
+ * kSubBuckets buckets per power of two, so a bucket's lower bound is within
+ * 12.5% of the values in it. Values of kMaxValue and above share the last
+ * bucket.
+ */
+struct HistogramSnapshot {
+  static constexpr size_t kSubBucketBits = 3;
+  static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+  static constexpr size_t kMaxValueBits = 40;
+  static constexpr uint64_t kMaxValue = uint64_t(1) << kMaxValueBits;
+  static constexpr size_t kNumBuckets =
+      (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+
+  static size_t bucketIndex(uint64_t value);
+
+  static uint64_t bucketLowerBound(size_t index);
+
+  /**
+   * Lower bound of the bucket holding the given percentile (0 to 100) of the
+   * recorded values, or 0 if nothing was recorded.
+   */
+  uint64_t percentile(double percentile) const;
+
+  std::array<uint64_t, kNumBuckets> buckets{};
+  uint64_t count{0};
+  uint64_t sum{0};
+};
+
+/**
+ * Thread local latency histograms, bucketed by the negotiated parameters of
+ * the connection they were recorded for, to find which combinations drive
+ * tail latency. Recording only touches the calling thread's histograms, with
+ * relaxed atomic updates, and takes a lock only the first time a thread sees
+ * a key. getAggregate() merges the histograms of all threads.
+ *
+ * Off by default. While enabled, servers time each handshake (from
+ * accepting the connection to reporting success) and its asynchronous steps
+ * with a HandshakeTimings.
+ */
+class TLSHistograms {
+ public:
+  using Snapshot = std::array<
+      HistogramSnapshot,
+      static_cast<size_t>(TLSHistogram::NumHistograms)>;
+
+  static void setEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  static bool enabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Adds value to histogram for key on the calling thread.
+   */
+  static void
+  record(const TLSHistogramKey& key, TLSHistogram histogram, uint64_t value);
+
+  /**
+   * Returns the histograms of every key, merged across all threads including
+   * threads that have exited.
+   */
+  static std::vector<std::pair<TLSHistogramKey, Snapshot>> getAggregate();
+
+ private:
+  struct Histograms;
+  struct ThreadHistograms;
+  struct Registry;
+
+  static ThreadHistograms& local();
+  static Registry& registry();
+
+  static std::atomic<bool> enabled_;
+};
+
+/**
+ * HandshakeTracer for one handshake that adds up the time spent in each
+ * asynchronous step, forwarding all events to next (which may be null).
+ * Steps may finish on other threads.
+ */
+class HandshakeTimings : public HandshakeTracer {
+ public:
+  explicit HandshakeTimings(std::shared_ptr<HandshakeTracer> next);
+
+  void stateTransition(
+      uint64_t handshakeId,
+      Clock::time_point time,
+      folly::StringPiece from,
+      folly::StringPiece to) override;
+
+  void asyncStepStarted(
+      uint64_t handshakeId,
+      Clock::time_point time,
+      HandshakeStep step) override;
+
+  void asyncStepFinished(
+      uint64_t handshakeId,
+      Clock::time_point time,
+      HandshakeStep step) override;
+
+  /**
+   * Records the time since construction and the time spent in each step
+   * that ran in TLSHistograms under key.
+   */
+  void record(const TLSHistogramKey& key) const;
+
+ private:
+  static constexpr size_t kNumSteps =
+      static_cast<size_t>(HandshakeStep::CertificateVerify) + 1;
+
+  std::shared_ptr<HandshakeTracer> next_;
+  Clock::time_point start_;
+  std::array<std::atomic<int64_t>, kNumSteps> stepStarts_{};
+  std::array<std::atomic<int64_t>, kNumSteps> stepNanos_{};
+  std::array<std::atomic<bool>, kNumSteps> stepsRun_{};
+};
+} // namespace fizz
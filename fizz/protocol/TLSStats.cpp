@@ -0,0 +1,85 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/protocol/TLSStats.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace fizz {
+
+std::atomic<bool> TLSStats::timingEnabled_{false};
+
+struct TLSStats::Registry {
+  std::mutex mutex;
+  std::vector<const ThreadCounters*> threads;
+  // Totals of the threads that have exited.
+  Snapshot exited;
+};
+
+/**
+ * Counters of one thread, registered for aggregation for the lifetime of the
+ * thread.
+ */
+struct TLSStats::ThreadCounters {
+  ThreadCounters() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.threads.push_back(this);
+  }
+
+  ~ThreadCounters() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    accumulate(counters, reg.exited);
+    reg.threads.erase(std::find(reg.threads.begin(), reg.threads.end(), this));
+  }
+
+  Counters counters;
+};
+
+TLSStats::Counters& TLSStats::local() {
+  static thread_local ThreadCounters threadCounters;
+  return threadCounters.counters;
+}
+
+TLSStats::Registry& TLSStats::registry() {
+  // Leaked so that it outlives the thread local counters of every thread.
+  static auto reg = new Registry();
+  return *reg;
+}
+
+void TLSStats::accumulate(const Counters& counters, Snapshot& snapshot) {
+  for (size_t i = 0; i < snapshot.counters.size(); ++i) {
+    snapshot.counters[i] +=
+        counters.counters[i].load(std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < snapshot.highWatermarks.size(); ++i) {
+    snapshot.highWatermarks[i] = std::max<uint64_t>(
+        snapshot.highWatermarks[i],
+        counters.highWatermarks[i].load(std::memory_order_relaxed));
+  }
+}
+
+TLSStats::Snapshot TLSStats::getThreadSnapshot() {
+  Snapshot snapshot;
+  accumulate(local(), snapshot);
+  return snapshot;
+}
+
+TLSStats::Snapshot TLSStats::getAggregate() {
+  auto& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  auto snapshot = reg.exited;
+  for (auto thread : reg.threads) {
+    accumulate(thread->counters, snapshot);
+  }
+  return snapshot;
+}
+} // namespace fizz
@@ -0,0 +1,168 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace fizz {
+
+/**
+ * Counters kept by TLSStats. The time counters are in nanoseconds and are only
+ * updated while timing is enabled (see TLSStats::setTimingEnabled()).
+ */
+enum class TLSCounter : size_t {
+  RecordsEncrypted,
+  BytesEncrypted,
+  RecordsDecrypted,
+  BytesDecrypted,
+  EncryptNanos,
+  DecryptNanos,
+  ClientHelloParseNanos,
+  KeyExchangeNanos,
+  SignNanos,
+  TicketNanos,
+  ActionsProcessed,
+  NumCounters
+};
+
+/**
+ * Largest values seen by TLSStats, in bytes.
+ */
+enum class TLSHighWatermark : size_t {
+  TransportReadBuffer,
+  AppDataBuffer,
+  WriteBuffer,
+  NumHighWatermarks
+};
+
+/**
+ * Thread local TLS counters. The record layers, state machines and transports
+ * update the counters of the thread they run on, so per-EventBase numbers are
+ * those of the EventBase's thread, and getAggregate() sums them across all
+ * threads for a process wide view. Updates are relaxed stores to counters no
+ * other thread writes, so they are cheap enough to leave on in production.
+ * Timing needs two clock reads per measurement and is off by default.
+ *
+ * Time spent in asynchronous operations (such as offloaded signing) is only
+ * counted up to the point the operation is started.
+ */
+class TLSStats {
+ public:
+  struct Snapshot {
+    std::array<uint64_t, static_cast<size_t>(TLSCounter::NumCounters)>
+        counters{};
+    std::array<
+        uint64_t,
+        static_cast<size_t>(TLSHighWatermark::NumHighWatermarks)>
+        highWatermarks{};
+
+    uint64_t get(TLSCounter counter) const {
+      return counters[static_cast<size_t>(counter)];
+    }
+
+    uint64_t get(TLSHighWatermark watermark) const {
+      return highWatermarks[static_cast<size_t>(watermark)];
+    }
+  };
+
+  /**
+   * Adds value to counter on the calling thread.
+   */
+  static void add(TLSCounter counter, uint64_t value) {
+    auto& stat = local().counters[static_cast<size_t>(counter)];
+    stat.store(
+        stat.load(std::memory_order_relaxed) + value,
+        std::memory_order_relaxed);
+  }
+
+  /**
+   * Raises watermark on the calling thread to value if it is larger.
+   */
+  static void updateHighWatermark(TLSHighWatermark watermark, uint64_t value) {
+    auto& stat = local().highWatermarks[static_cast<size_t>(watermark)];
+    if (value > stat.load(std::memory_order_relaxed)) {
+      stat.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  static void setTimingEnabled(bool enabled) {
+    timingEnabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  static bool timingEnabled() {
+    return timingEnabled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Returns the counters of the calling thread.
+   */
+  static Snapshot getThreadSnapshot();
+
+  /**
+   * Returns the counters summed across all threads, including threads that
+   * have exited. High watermarks are the largest value seen on any thread.
+   */
+  static Snapshot getAggregate();
+
+  /**
+   * Adds the time between construction and destruction to counter, if timing
+   * was enabled at construction.
+   */
+  class Timer {
+   public:
+    explicit Timer(TLSCounter counter) : counter_(counter) {
+      if (timingEnabled()) {
+        start_ = std::chrono::steady_clock::now();
+        running_ = true;
+      }
+    }
+
+    ~Timer() {
+      if (running_) {
+        add(counter_,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_)
+                .count());
+      }
+    }
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+   private:
+    TLSCounter counter_;
+    bool running_{false};
+    std::chrono::steady_clock::time_point start_;
+  };
+
+ private:
+  struct Counters {
+    std::array<
+        std::atomic<uint64_t>,
+        static_cast<size_t>(TLSCounter::NumCounters)>
+        counters{};
+    std::array<
+        std::atomic<uint64_t>,
+        static_cast<size_t>(TLSHighWatermark::NumHighWatermarks)>
+        highWatermarks{};
+  };
+
+  struct ThreadCounters;
+  struct Registry;
+
+  static Counters& local();
+  static Registry& registry();
+  static void accumulate(const Counters& counters, Snapshot& snapshot);
+
+  static std::atomic<bool> timingEnabled_;
+};
+} // namespace fizz
@@ -0,0 +1,81 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace fizz {
+
+/**
+ * Token bucket that fills at rate tokens per second up to burst tokens. The
+ * current time is passed in so that callers (and tests) control the clock.
+ */
+class TokenBucket {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  TokenBucket(uint64_t rate, uint64_t burst, Clock::time_point now)
+      : rate_(rate), burst_(burst), tokens_(burst), lastRefill_(now) {}
+
+  /**
+   * Tokens available at now.
+   */
+  uint64_t available(Clock::time_point now) {
+    refill(now);
+    return static_cast<uint64_t>(tokens_);
+  }
+
+  /**
+   * Take tokens, which must have been available.
+   */
+  void consume(uint64_t tokens) {
+    tokens_ = std::max(tokens_ - static_cast<double>(tokens), 0.0);
+  }
+
+  /**
+   * Time from now until tokens are available. tokens must not exceed the
+   * burst size.
+   */
+  std::chrono::nanoseconds timeUntil(uint64_t tokens, Clock::time_point now) {
+    refill(now);
+    auto needed = static_cast<double>(tokens) - tokens_;
+    if (needed <= 0) {
+      return std::chrono::nanoseconds(0);
+    }
+    return std::chrono::nanoseconds(
+        static_cast<int64_t>(needed * 1e9 / rate_) + 1);
+  }
+
+  uint64_t getRate() const {
+    return rate_;
+  }
+
+  uint64_t getBurst() const {
+    return burst_;
+  }
+
+ private:
+  void refill(Clock::time_point now) {
+    if (now <= lastRefill_) {
+      return;
+    }
+    std::chrono::duration<double> elapsed = now - lastRefill_;
+    tokens_ = std::min(
+        tokens_ + elapsed.count() * rate_, static_cast<double>(burst_));
+    lastRefill_ = now;
+  }
+
+  uint64_t rate_;
+  uint64_t burst_;
+  double tokens_;
+  Clock::time_point lastRefill_;
+};
+} // namespace fizz
@@ -0,0 +1,305 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/client/AsyncFizzClient.h>
+#include <fizz/protocol/AllocationStats.h>
+#include <fizz/protocol/test/Utilities.h>
+#include <fizz/record/test/RecordLayerHarness.h>
+#include <fizz/server/AsyncFizzServer.h>
+#include <fizz/test/LocalTransport.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#ifdef __GLIBC__
+// Count every allocation made by this test binary, including the ones made
+// with malloc() directly (IOBuf buffers, OpenSSL), by hooking the malloc
+// family and forwarding to glibc's implementation. operator new calls malloc.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+
+void* malloc(size_t size) {
+  fizz::AllocationStats::recordAllocation(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  fizz::AllocationStats::recordAllocation(count * size);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+  fizz::AllocationStats::recordAllocation(size);
+  return __libc_realloc(p, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+  fizz::AllocationStats::recordAllocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  return memalign(alignment, size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size) {
+  *p = memalign(alignment, size);
+  return *p ? 0 : ENOMEM;
+}
+
+void free(void* p) {
+  __libc_free(p);
+}
+}
+#else
+// Without glibc, only allocations made with operator new are counted.
+void* operator new(size_t size) {
+  fizz::AllocationStats::recordAllocation(size);
+  if (auto p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  std::free(p);
+}
+#endif
+
+using namespace fizz::client;
+using namespace fizz::server;
+
+namespace fizz {
+namespace test {
+
+// Budgets for the steady state app data path. Raising them needs a reason.
+static constexpr double kMaxWriteAllocationsPerRecord = 6;
+static constexpr double kMaxReadAllocationsPerRecord = 4;
+// Ceiling for a full handshake, client and server together, including the
+// allocations made by OpenSSL. Handshakes after the first must also not
+// allocate more than the second one, which is the baseline.
+static constexpr uint64_t kMaxAllocationsPerHandshake = 6000;
+
+class AllocationStatsTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    AllocationStats::setEnabled(true);
+  }
+
+  void TearDown() override {
+    AllocationStats::setEnabled(false);
+  }
+
+  static void log(const std::string& what, const AllocationStats::Snapshot& s) {
+    static const char* names[] = {"other",
+                                  "record_layer",
+                                  "codec",
+                                  "key_schedule",
+                                  "certificates",
+                                  "actions"};
+    std::string out = what + ":";
+    for (size_t i = 0; i < s.sites.size(); ++i) {
+      out += folly::to<std::string>(
+          " ",
+          names[i],
+          " ",
+          s.sites[i].allocations,
+          " (",
+          s.sites[i].bytes,
+          "B)");
+    }
+    LOG(INFO) << out;
+  }
+};
+
+TEST_F(AllocationStatsTest, TestScopes) {
+  auto before = AllocationStats::getThreadSnapshot();
+  std::unique_ptr<int> outer;
+  std::unique_ptr<int> inner;
+  {
+    AllocationStats::Scope scope(AllocationSite::RecordLayer);
+    outer = std::make_unique<int>(1);
+    {
+      AllocationStats::Scope nested(AllocationSite::Codec);
+      inner = std::make_unique<int>(2);
+    }
+  }
+  auto other = std::make_unique<int>(3);
+  auto diff = AllocationStats::getThreadSnapshot().since(before);
+  EXPECT_EQ(diff.get(AllocationSite::RecordLayer).allocations, 1);
+  EXPECT_EQ(diff.get(AllocationSite::RecordLayer).bytes, sizeof(int));
+  EXPECT_EQ(diff.get(AllocationSite::Codec).allocations, 1);
+  EXPECT_EQ(diff.get(AllocationSite::Other).allocations, 1);
+  EXPECT_EQ(diff.total().allocations, 3);
+}
+
+TEST_F(AllocationStatsTest, TestDisabled) {
+  AllocationStats::setEnabled(false);
+  auto before = AllocationStats::getThreadSnapshot();
+  auto p = std::make_unique<int>(1);
+  auto diff = AllocationStats::getThreadSnapshot().since(before);
+  EXPECT_EQ(diff.total().allocations, 0);
+}
+
+TEST_F(AllocationStatsTest, TestAppDataBudget) {
+  constexpr size_t kRecords = 64;
+  constexpr size_t kRecordSize = 16384;
+
+  EncryptedWriteRecordLayer write;
+  write.setAead(RecordLayerHarness::makeAead());
+  EncryptedReadRecordLayer read;
+  read.setAead(RecordLayerHarness::makeAead());
+  std::vector<Buf> data;
+  for (size_t i = 0; i < kRecords; ++i) {
+    data.push_back(RecordLayerHarness::makeData(kRecordSize));
+  }
+  folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+
+  auto before = AllocationStats::getThreadSnapshot();
+  for (auto& buf : data) {
+    queue.append(write.write(
+        TLSMessage{ContentType::application_data, std::move(buf)}));
+  }
+  auto written = AllocationStats::getThreadSnapshot();
+  size_t records = 0;
+  while (auto msg = read.read(queue)) {
+    ++records;
+  }
+  auto done = AllocationStats::getThreadSnapshot();
+  EXPECT_EQ(records, kRecords);
+
+  auto writeAllocations = written.since(before);
+  auto readAllocations = done.since(written);
+  log("write 1MB", writeAllocations);
+  log("read 1MB", readAllocations);
+  EXPECT_LE(
+      double(writeAllocations.total().allocations) / kRecords,
+      kMaxWriteAllocationsPerRecord);
+  EXPECT_LE(
+      double(readAllocations.total().allocations) / kRecords,
+      kMaxReadAllocationsPerRecord);
+  // Everything the record layer allocates is attributed to it.
+  EXPECT_EQ(
+      writeAllocations.get(AllocationSite::RecordLayer).allocations,
+      writeAllocations.total().allocations);
+}
+
+namespace {
+class ClientCallback : public AsyncFizzClient::HandshakeCallback {
+ public:
+  void fizzHandshakeSuccess(AsyncFizzClient*) noexcept override {}
+
+  void fizzHandshakeError(
+      AsyncFizzClient*,
+      folly::exception_wrapper ex) noexcept override {
+    ADD_FAILURE() << "client error: " << ex.what();
+  }
+};
+
+class ServerCallback : public AsyncFizzServer::HandshakeCallback {
+ public:
+  void fizzHandshakeSuccess(AsyncFizzServer*) noexcept override {
+    success = true;
+  }
+
+  void fizzHandshakeError(
+      AsyncFizzServer*,
+      folly::exception_wrapper ex) noexcept override {
+    ADD_FAILURE() << "server error: " << ex.what();
+  }
+
+  void fizzHandshakeAttemptFallback(std::unique_ptr<folly::IOBuf>) override {
+    ADD_FAILURE() << "unexpected fallback";
+  }
+
+  bool success{false};
+};
+
+AllocationStats::Snapshot runHandshake(
+    std::shared_ptr<FizzServerContext> serverContext,
+    std::shared_ptr<FizzClientContext> clientContext) {
+  folly::EventBase evb;
+  auto clientTransport = LocalTransport::UniquePtr(new LocalTransport());
+  auto serverTransport = LocalTransport::UniquePtr(new LocalTransport());
+  clientTransport->attachEventBase(&evb);
+  serverTransport->attachEventBase(&evb);
+  clientTransport->setPeer(serverTransport.get());
+  serverTransport->setPeer(clientTransport.get());
+  AsyncFizzClient::UniquePtr client(
+      new AsyncFizzClient(std::move(clientTransport), clientContext));
+  AsyncFizzServer::UniquePtr server(
+      new AsyncFizzServer(std::move(serverTransport), serverContext));
+  ClientCallback clientCallback;
+  ServerCallback serverCallback;
+
+  auto before = AllocationStats::getThreadSnapshot();
+  client->connect(&clientCallback, nullptr, folly::none, folly::none);
+  server->accept(&serverCallback);
+  evb.loop();
+  auto diff = AllocationStats::getThreadSnapshot().since(before);
+  EXPECT_TRUE(serverCallback.success);
+  return diff;
+}
+} // namespace
+
+TEST_F(AllocationStatsTest, TestHandshakeBudget) {
+  auto certData = createCert("fizz-alloc-test", false, nullptr);
+  std::vector<folly::ssl::X509UniquePtr> certChain;
+  certChain.push_back(std::move(certData.cert));
+  auto certManager = std::make_unique<CertManager>();
+  certManager->addCert(
+      std::make_shared<SelfCertImpl<KeyType::P256>>(
+          std::move(certData.key), std::move(certChain)),
+      true);
+  auto serverContext = std::make_shared<FizzServerContext>();
+  serverContext->setCertManager(std::move(certManager));
+  auto clientContext = std::make_shared<FizzClientContext>();
+
+  // The first handshake also pays for one time initialization (OpenSSL
+  // tables, thread locals), so the second one is the baseline.
+  log("first handshake", runHandshake(serverContext, clientContext));
+  auto baseline = runHandshake(serverContext, clientContext);
+  log("handshake (client and server)", baseline);
+  EXPECT_LE(baseline.total().allocations, kMaxAllocationsPerHandshake);
+  EXPECT_GT(baseline.get(AllocationSite::RecordLayer).allocations, 0);
+  EXPECT_GT(baseline.get(AllocationSite::Codec).allocations, 0);
+  EXPECT_GT(baseline.get(AllocationSite::KeySchedule).allocations, 0);
+  EXPECT_GT(baseline.get(AllocationSite::Certificates).allocations, 0);
+
+  // Nothing accumulates across connections.
+  for (size_t i = 0; i < 3; ++i) {
+    auto diff = runHandshake(serverContext, clientContext);
+    EXPECT_LE(
+        diff.total().allocations, baseline.total().allocations * 21 / 20);
+  }
+}
+} // namespace test
+} // namespace fizz
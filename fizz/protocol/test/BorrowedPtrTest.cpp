@@ -0,0 +1,31 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/BorrowedPtr.h>
+
+namespace fizz {
+namespace test {
+
+TEST(BorrowedPtrTest, TestNoOwnership) {
+  auto owner = std::make_shared<int>(5);
+  auto borrowed = borrowedPtr(owner.get());
+  auto copy = borrowed;
+  EXPECT_TRUE(copy);
+  EXPECT_EQ(*copy, 5);
+  EXPECT_EQ(copy.use_count(), 0);
+  EXPECT_EQ(owner.use_count(), 1);
+}
+
+TEST(BorrowedPtrTest, TestNull) {
+  auto borrowed = borrowedPtr<int>(nullptr);
+  EXPECT_FALSE(borrowed);
+}
+} // namespace test
+} // namespace fizz
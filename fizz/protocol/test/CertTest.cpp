@@ -51,6 +51,20 @@ struct RSATest {
   using Invalid = P256Test;
 };
 
+struct Ed25519Test {
+  static constexpr KeyType Type = KeyType::ED25519;
+  static constexpr SignatureScheme Scheme = SignatureScheme::ed25519;
+
+  using Invalid = P256Test;
+};
+
+struct Ed448Test {
+  static constexpr KeyType Type = KeyType::ED448;
+  static constexpr SignatureScheme Scheme = SignatureScheme::ed448;
+
+  using Invalid = Ed25519Test;
+};
+
 template <typename T>
 static ssl::X509UniquePtr getCert();
 
@@ -74,6 +88,16 @@ ssl::X509UniquePtr getCert<RSATest>() {
   return fizz::test::getCert(kRSACertificate);
 }
 
+template <>
+ssl::X509UniquePtr getCert<Ed25519Test>() {
+  return fizz::test::getCert(kEd25519Certificate);
+}
+
+template <>
+ssl::X509UniquePtr getCert<Ed448Test>() {
+  return fizz::test::getCert(kEd448Certificate);
+}
+
 template <typename T>
 static ssl::EvpPkeyUniquePtr getKey();
 
@@ -97,6 +121,16 @@ ssl::EvpPkeyUniquePtr getKey<RSATest>() {
   return getPrivateKey(kRSAKey);
 }
 
+template <>
+ssl::EvpPkeyUniquePtr getKey<Ed25519Test>() {
+  return getPrivateKey(kEd25519Key);
+}
+
+template <>
+ssl::EvpPkeyUniquePtr getKey<Ed448Test>() {
+  return getPrivateKey(kEd448Key);
+}
+
 template <typename T>
 class CertTestTyped : public Test {
  public:
@@ -105,7 +139,12 @@ class CertTestTyped : public Test {
   }
 };
 
+#if FIZZ_OPENSSL_HAS_ED25519
+using KeyTypes =
+    Types<P256Test, P384Test, P521Test, RSATest, Ed25519Test, Ed448Test>;
+#else
 using KeyTypes = Types<P256Test, P384Test, P521Test, RSATest>;
+#endif
 TYPED_TEST_CASE(CertTestTyped, KeyTypes);
 
 TEST(CertTest, GetIdentity) {
@@ -151,6 +190,19 @@ TEST(CertTest, GetCertMessage) {
   EXPECT_EQ(X509_cmp(firstEncodedCert.get(), certCopy.get()), 0);
 }
 
+TEST(CertTest, GetEncodedCertMessage) {
+  auto cert = getCert(kP256Certificate);
+  auto key = getPrivateKey(kP256Key);
+  std::vector<folly::ssl::X509UniquePtr> certs;
+  certs.push_back(std::move(cert));
+  SelfCertImpl<KeyType::P256> certificate(std::move(key), std::move(certs));
+  auto encoded = certificate.getEncodedCertMessage();
+  EXPECT_TRUE(IOBufEqualTo()(
+      encoded, encodeHandshake(certificate.getCertMessage())));
+  EXPECT_TRUE(encoded->isShared());
+  EXPECT_TRUE(IOBufEqualTo()(encoded, certificate.getEncodedCertMessage()));
+}
+
 // example taken from https://tlswg.github.io/tls13-spec/#certificate-verify
 TEST(CertTest, PrepareSignData) {
   std::array<uint8_t, 32> toBeSigned;
@@ -300,5 +352,65 @@ TYPED_TEST(CertTestTyped, TestVerifyDecodedCert) {
       tbs,
       sig->coalesce());
 }
+
+TEST(CertTest, RawPublicKeySignVerify) {
+  auto selfCert = CertUtils::makeRawPublicKeySelfCert(kP256Key.str(), "id");
+  EXPECT_EQ(selfCert->getCertificateType(), CertificateType::RawPublicKey);
+  EXPECT_EQ(selfCert->getIdentity(), "id");
+  EXPECT_EQ(selfCert->getX509(), nullptr);
+
+  auto msg = selfCert->getCertMessage();
+  EXPECT_EQ(msg.certificate_list.size(), 1);
+  auto peerCert = CertUtils::makeRawPublicKeyPeerCert(
+      std::move(msg.certificate_list.front().cert_data));
+  EXPECT_EQ(
+      peerCert->getIdentity(),
+      CertUtils::getSpkiHash(peerCert->getSubjectPublicKeyInfo()));
+  EXPECT_EQ(peerCert->getX509(), nullptr);
+
+  StringPiece tbs{"ToBeSigned"};
+  auto sig = selfCert->sign(
+      SignatureScheme::ecdsa_secp256r1_sha256,
+      CertificateVerifyContext::Server,
+      tbs);
+  peerCert->verify(
+      SignatureScheme::ecdsa_secp256r1_sha256,
+      CertificateVerifyContext::Server,
+      tbs,
+      sig->coalesce());
+  sig->writableData()[1] ^= 0x20;
+  EXPECT_THROW(
+      peerCert->verify(
+          SignatureScheme::ecdsa_secp256r1_sha256,
+          CertificateVerifyContext::Server,
+          tbs,
+          sig->coalesce()),
+      std::runtime_error);
+}
+
+TEST(CertTest, MakeRawPublicKeyPeerCertJunk) {
+  EXPECT_THROW(
+      CertUtils::makeRawPublicKeyPeerCert(IOBuf::copyBuffer("")),
+      std::runtime_error);
+  EXPECT_THROW(
+      CertUtils::makeRawPublicKeyPeerCert(IOBuf::copyBuffer("blah")),
+      std::runtime_error);
+}
+
+TEST(CertTest, MakeRawPublicKeyPeerCertTrailingData) {
+  auto selfCert = CertUtils::makeRawPublicKeySelfCert(kP256Key.str(), "id");
+  auto msg = selfCert->getCertMessage();
+  auto spki = std::move(msg.certificate_list.front().cert_data);
+  spki->prependChain(IOBuf::copyBuffer("x"));
+  EXPECT_THROW(
+      CertUtils::makeRawPublicKeyPeerCert(std::move(spki)),
+      std::runtime_error);
+}
+
+TEST(CertTest, X509CertificateType) {
+  auto selfCert =
+      CertUtils::makeSelfCert(kP256Certificate.str(), kP256Key.str());
+  EXPECT_EQ(selfCert->getCertificateType(), CertificateType::X509);
+}
 } // namespace test
 } // namespace fizz
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/CertificateCompressor.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+class CertificateCompressorTest
+    : public TestWithParam<CertificateCompressionAlgorithm> {
+ protected:
+  static CertificateMsg getCertMessage() {
+    CertificateMsg cert;
+    cert.certificate_request_context = IOBuf::create(0);
+    for (size_t i = 0; i < 3; i++) {
+      CertificateEntry entry;
+      entry.cert_data = IOBuf::copyBuffer(std::string(500, 'a' + i));
+      cert.certificate_list.push_back(std::move(entry));
+    }
+    return cert;
+  }
+};
+
+TEST_P(CertificateCompressorTest, TestRoundTrip) {
+  CodecCertificateCompressor compressor(GetParam());
+  CodecCertificateDecompressor decompressor(GetParam());
+  auto encoded = encode(getCertMessage());
+
+  auto cc = compressor.compress(getCertMessage());
+  EXPECT_EQ(cc.algorithm, GetParam());
+  EXPECT_EQ(cc.uncompressed_length, encoded->computeChainDataLength());
+  EXPECT_LT(
+      cc.compressed_certificate_message->computeChainDataLength(),
+      cc.uncompressed_length);
+
+  auto cert = decompressor.decompress(cc);
+  EXPECT_TRUE(IOBufEqualTo()(encode(std::move(cert)), encoded));
+}
+
+TEST_P(CertificateCompressorTest, TestTooLarge) {
+  CodecCertificateCompressor compressor(GetParam());
+  CodecCertificateDecompressor decompressor(GetParam(), 1000);
+  auto cc = compressor.compress(getCertMessage());
+  EXPECT_THROW(decompressor.decompress(cc), std::runtime_error);
+}
+
+TEST_P(CertificateCompressorTest, TestLengthMismatch) {
+  CodecCertificateCompressor compressor(GetParam());
+  CodecCertificateDecompressor decompressor(GetParam());
+  auto cc = compressor.compress(getCertMessage());
+  cc.uncompressed_length -= 1;
+  EXPECT_THROW(decompressor.decompress(cc), std::runtime_error);
+  cc.uncompressed_length += 2;
+  EXPECT_THROW(decompressor.decompress(cc), std::runtime_error);
+}
+
+TEST_P(CertificateCompressorTest, TestAlgorithmMismatch) {
+  CodecCertificateDecompressor decompressor(GetParam());
+  CompressedCertificate cc;
+  cc.algorithm = static_cast<CertificateCompressionAlgorithm>(0xff);
+  cc.uncompressed_length = 10;
+  cc.compressed_certificate_message = IOBuf::copyBuffer("data");
+  EXPECT_THROW(decompressor.decompress(cc), std::runtime_error);
+}
+
+// Not all folly builds include every codec, only test the available ones.
+static std::vector<CertificateCompressionAlgorithm> getSupportedAlgorithms() {
+  std::vector<CertificateCompressionAlgorithm> algos;
+  for (auto algo : {CertificateCompressionAlgorithm::zlib,
+                    CertificateCompressionAlgorithm::brotli,
+                    CertificateCompressionAlgorithm::zstd}) {
+    if (CodecCertificateCompressor::supports(algo)) {
+      algos.push_back(algo);
+    }
+  }
+  return algos;
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Algorithms,
+    CertificateCompressorTest,
+    ValuesIn(getSupportedAlgorithms()));
+} // namespace test
+} // namespace fizz
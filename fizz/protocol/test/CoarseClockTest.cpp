@@ -0,0 +1,58 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/CoarseClock.h>
+
+#include <folly/io/async/EventBaseManager.h>
+
+#include <thread>
+
+namespace fizz {
+namespace test {
+
+static void waitForClock() {
+  auto start = std::chrono::system_clock::now();
+  while (std::chrono::system_clock::now() == start) {
+    std::this_thread::yield();
+  }
+}
+
+TEST(CoarseClockTest, TestNoEventBase) {
+  auto first = CoarseClock::now();
+  waitForClock();
+  EXPECT_GT(CoarseClock::now(), first);
+}
+
+TEST(CoarseClockTest, TestCachedPerIteration) {
+  auto evb = folly::EventBaseManager::get()->getEventBase();
+  std::chrono::system_clock::time_point first;
+  std::chrono::system_clock::time_point second;
+  std::chrono::system_clock::time_point next;
+  evb->runInEventBaseThread([&]() {
+    first = CoarseClock::now();
+    waitForClock();
+    second = CoarseClock::now();
+  });
+  evb->loopOnce();
+  evb->runInEventBaseThread([&]() { next = CoarseClock::now(); });
+  evb->loopOnce();
+
+  EXPECT_EQ(first, second);
+  EXPECT_GT(next, first);
+}
+
+TEST(CoarseClockTest, TestNotLooping) {
+  folly::EventBaseManager::get()->getEventBase();
+  auto first = CoarseClock::now();
+  waitForClock();
+  EXPECT_GT(CoarseClock::now(), first);
+}
+} // namespace test
+} // namespace fizz
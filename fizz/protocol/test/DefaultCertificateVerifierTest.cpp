@@ -8,8 +8,13 @@
 
 #include <gtest/gtest.h>
 
+#include <fizz/crypto/test/TestUtil.h>
 #include <fizz/protocol/DefaultCertificateVerifier.h>
 #include <fizz/protocol/test/Utilities.h>
+#include <folly/synchronization/Baton.h>
+
+#include <atomic>
+#include <thread>
 
 using namespace folly;
 using namespace folly::ssl;
@@ -18,6 +23,17 @@ using namespace testing;
 namespace fizz {
 namespace test {
 
+class ClockedCertificateVerifier : public DefaultCertificateVerifier {
+ public:
+  using DefaultCertificateVerifier::DefaultCertificateVerifier;
+
+  std::chrono::steady_clock::time_point now() const override {
+    return now_;
+  }
+
+  std::chrono::steady_clock::time_point now_{std::chrono::steady_clock::now()};
+};
+
 class DefaultCertificateVerifierTest : public testing::Test {
  public:
   void SetUp() override {
@@ -27,7 +43,7 @@ class DefaultCertificateVerifierTest : public testing::Test {
     rootCertAndKey_ = createCert("root", true, nullptr);
     leafCertAndKey_ = createCert("leaf", false, &rootCertAndKey_);
     ASSERT_EQ(X509_STORE_add_cert(store.get(), rootCertAndKey_.cert.get()), 1);
-    verifier_ = std::make_unique<DefaultCertificateVerifier>(
+    verifier_ = std::make_unique<ClockedCertificateVerifier>(
         VerificationContext::Client, std::move(store));
   }
 
@@ -41,12 +57,72 @@ class DefaultCertificateVerifierTest : public testing::Test {
     return ok;
   }
 
+  static int countingCallback(int ok, X509_STORE_CTX*) {
+    callbackCount_++;
+    return ok;
+  }
+
+  // Holds verifications in the callback until gate_ is posted, so that the
+  // test controls when they finish.
+  static int gatedCountingCallback(int ok, X509_STORE_CTX*) {
+    gatedCallbackCount_++;
+    if (!entered_.exchange(true)) {
+      enteredBaton_.post();
+    }
+    gate_.wait();
+    return ok;
+  }
+
+  static void resetGate() {
+    gatedCallbackCount_ = 0;
+    entered_ = false;
+    enteredBaton_.reset();
+    gate_.reset();
+  }
+
+  /**
+   * Verifies leaf on several threads at once. The first verification to
+   * reach the callback is held there until all the threads have started.
+   */
+  void verifyConcurrently(const CertAndKey& leaf, size_t threads) {
+    std::atomic<size_t> failures{0};
+    std::vector<std::thread> verifiers;
+    for (size_t i = 0; i < threads; i++) {
+      verifiers.emplace_back([&]() {
+        try {
+          verifier_->verify({getPeerCert(leaf)});
+        } catch (const std::runtime_error&) {
+          failures++;
+        }
+      });
+    }
+    enteredBaton_.wait();
+    gate_.post();
+    for (auto& verifier : verifiers) {
+      verifier.join();
+    }
+    concurrentFailures_ = failures;
+  }
+
  protected:
+  static size_t callbackCount_;
+  static std::atomic<size_t> gatedCallbackCount_;
+  static std::atomic<bool> entered_;
+  static folly::Baton<> enteredBaton_;
+  static folly::Baton<> gate_;
+  size_t concurrentFailures_{0};
+
   CertAndKey rootCertAndKey_;
   CertAndKey leafCertAndKey_;
-  std::unique_ptr<DefaultCertificateVerifier> verifier_;
+  std::unique_ptr<ClockedCertificateVerifier> verifier_;
 };
 
+size_t DefaultCertificateVerifierTest::callbackCount_ = 0;
+std::atomic<size_t> DefaultCertificateVerifierTest::gatedCallbackCount_{0};
+std::atomic<bool> DefaultCertificateVerifierTest::entered_{false};
+folly::Baton<> DefaultCertificateVerifierTest::enteredBaton_;
+folly::Baton<> DefaultCertificateVerifierTest::gate_;
+
 TEST_F(DefaultCertificateVerifierTest, TestVerifySuccess) {
   verifier_->verify({getPeerCert(leafCertAndKey_)});
 }
@@ -57,6 +133,20 @@ TEST_F(DefaultCertificateVerifierTest, TestVerifyWithIntermediates) {
   verifier_->verify({getPeerCert(subleaf), getPeerCert(subauth)});
 }
 
+TEST_F(DefaultCertificateVerifierTest, TestVerifyRawPublicKey) {
+  auto selfCert = CertUtils::makeRawPublicKeySelfCert(kP256Key.str(), "id");
+  auto msg = selfCert->getCertMessage();
+  std::shared_ptr<const PeerCert> rawKey = CertUtils::makeRawPublicKeyPeerCert(
+      std::move(msg.certificate_list.front().cert_data));
+  EXPECT_THROW(verifier_->verify({rawKey}), std::runtime_error);
+  EXPECT_THROW(
+      verifier_->verify({getPeerCert(leafCertAndKey_), rawKey}),
+      std::runtime_error);
+
+  verifier_->setVerificationCache(10, std::chrono::seconds(60));
+  EXPECT_THROW(verifier_->verify({rawKey}), std::runtime_error);
+}
+
 TEST_F(DefaultCertificateVerifierTest, TestVerifySelfSignedCert) {
   auto selfsigned = createCert("self", false, nullptr);
   EXPECT_THROW(
@@ -102,5 +192,99 @@ TEST_F(DefaultCertificateVerifierTest, TestVerifyWithBadRoot) {
       verifier_->verify({getPeerCert(subleaf), getPeerCert(subauth)}),
       std::runtime_error);
 }
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationCache) {
+  verifier_->setCustomVerifyCallback(
+      &DefaultCertificateVerifierTest::countingCallback);
+  verifier_->setVerificationCache(10, std::chrono::seconds(60));
+  callbackCount_ = 0;
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  auto count = callbackCount_;
+  EXPECT_GT(count, 0);
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  EXPECT_EQ(callbackCount_, count);
+
+  auto otherLeaf = createCert("otherleaf", false, &rootCertAndKey_);
+  verifier_->verify({getPeerCert(otherLeaf)});
+  EXPECT_GT(callbackCount_, count);
+}
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationCacheExpired) {
+  verifier_->setCustomVerifyCallback(
+      &DefaultCertificateVerifierTest::countingCallback);
+  verifier_->setVerificationCache(10, std::chrono::seconds(0));
+  callbackCount_ = 0;
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  auto count = callbackCount_;
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  EXPECT_EQ(callbackCount_, 2 * count);
+}
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationCacheTtl) {
+  verifier_->setCustomVerifyCallback(
+      &DefaultCertificateVerifierTest::countingCallback);
+  verifier_->setVerificationCache(10, std::chrono::seconds(60));
+  callbackCount_ = 0;
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  auto count = callbackCount_;
+
+  verifier_->now_ += std::chrono::seconds(59);
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  EXPECT_EQ(callbackCount_, count);
+
+  verifier_->now_ += std::chrono::seconds(1);
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  EXPECT_EQ(callbackCount_, 2 * count);
+}
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationCacheFailure) {
+  verifier_->setVerificationCache(10, std::chrono::seconds(60));
+  auto selfsigned = createCert("self", false, nullptr);
+  EXPECT_THROW(
+      verifier_->verify({getPeerCert(selfsigned)}), std::runtime_error);
+  EXPECT_THROW(
+      verifier_->verify({getPeerCert(selfsigned)}), std::runtime_error);
+}
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationJoined) {
+  verifier_->setCustomVerifyCallback(
+      &DefaultCertificateVerifierTest::gatedCountingCallback);
+  verifier_->setVerificationCache(10, std::chrono::seconds(60));
+  auto otherLeaf = createCert("otherleaf", false, &rootCertAndKey_);
+  resetGate();
+  gate_.post();
+  verifier_->verify({getPeerCert(otherLeaf)});
+  auto count = gatedCallbackCount_.load();
+  EXPECT_GT(count, 0);
+
+  // Whether the other threads join the held verification or find the chain
+  // cached once it is released, it is only verified once.
+  resetGate();
+  verifyConcurrently(leafCertAndKey_, 8);
+  EXPECT_EQ(concurrentFailures_, 0);
+  EXPECT_EQ(gatedCallbackCount_, count);
+}
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationJoinedFailure) {
+  verifier_->setCustomVerifyCallback(
+      &DefaultCertificateVerifierTest::gatedCountingCallback);
+  verifier_->setVerificationCache(10, std::chrono::seconds(60));
+  resetGate();
+  auto selfsigned = createCert("self", false, nullptr);
+  verifyConcurrently(selfsigned, 8);
+  EXPECT_EQ(concurrentFailures_, 8);
+
+  // Failures are not remembered.
+  EXPECT_THROW(
+      verifier_->verify({getPeerCert(selfsigned)}), std::runtime_error);
+}
+
+TEST_F(DefaultCertificateVerifierTest, TestVerificationCacheClearedOnStore) {
+  verifier_->setVerificationCache(10, std::chrono::seconds(60));
+  verifier_->verify({getPeerCert(leafCertAndKey_)});
+  verifier_->setX509Store(folly::ssl::X509StoreUniquePtr(X509_STORE_new()));
+  EXPECT_THROW(
+      verifier_->verify({getPeerCert(leafCertAndKey_)}), std::runtime_error);
+}
 } // namespace test
 } // namespace fizz
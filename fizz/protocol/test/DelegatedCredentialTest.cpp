@@ -0,0 +1,180 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/DelegatedCredential.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+class DelegatedCredentialTest : public Test {
+ public:
+  void SetUp() override {
+    parent_ = CertUtils::makeSelfCert(
+        kP256DelegationCertificate.str(), kP256Key.str());
+    certData_ = getCertData(kP256DelegationCertificate);
+    leaf_ = CertUtils::makePeerCert(certData_->clone());
+    now_ = std::chrono::system_clock::from_time_t(1800000000);
+  }
+
+ protected:
+  DelegatedCredential generate(
+      std::chrono::seconds validity = std::chrono::hours(1)) {
+    auto key = getPrivateKey(kP384Key);
+    return DelegatedCredentialUtils::generate(
+        *parent_,
+        SignatureScheme::ecdsa_secp256r1_sha256,
+        key.get(),
+        SignatureScheme::ecdsa_secp384r1_sha384,
+        validity,
+        now_);
+  }
+
+  std::shared_ptr<const SelfCert> parent_;
+  Buf certData_;
+  std::shared_ptr<const PeerCert> leaf_;
+  std::chrono::system_clock::time_point now_;
+};
+
+TEST_F(DelegatedCredentialTest, TestDelegationUsage) {
+  EXPECT_TRUE(DelegatedCredentialUtils::hasDelegationUsage(
+      getCert(kP256DelegationCertificate).get()));
+  EXPECT_FALSE(DelegatedCredentialUtils::hasDelegationUsage(
+      getCert(kP256Certificate).get()));
+}
+
+TEST_F(DelegatedCredentialTest, TestPrepareSignatureBuffer) {
+  DelegatedCredential credential;
+  credential.valid_time = 0x01020304;
+  credential.expected_verify_scheme = SignatureScheme::ecdsa_secp256r1_sha256;
+  credential.public_key = IOBuf::copyBuffer("key");
+  credential.credential_scheme = SignatureScheme::rsa_pss_sha256;
+  credential.signature = IOBuf::copyBuffer("sig");
+  auto buf = DelegatedCredentialUtils::prepareSignatureBuffer(
+      credential, IOBuf::copyBuffer("cert"));
+  EXPECT_EQ(hexlify(buf->coalesce()), "636572740102030404030000036b65790804");
+}
+
+TEST_F(DelegatedCredentialTest, TestGenerateVerify) {
+  auto credential = generate();
+  EXPECT_EQ(
+      credential.expected_verify_scheme,
+      SignatureScheme::ecdsa_secp384r1_sha384);
+  EXPECT_EQ(
+      credential.credential_scheme, SignatureScheme::ecdsa_secp256r1_sha256);
+  DelegatedCredentialUtils::verify(*leaf_, certData_, credential, now_);
+}
+
+TEST_F(DelegatedCredentialTest, TestVerifyExpired) {
+  auto credential = generate();
+  EXPECT_THROW(
+      DelegatedCredentialUtils::verify(
+          *leaf_, certData_, credential, now_ + std::chrono::hours(2)),
+      std::runtime_error);
+}
+
+TEST_F(DelegatedCredentialTest, TestVerifyValidityTooLong) {
+  auto credential = generate();
+  EXPECT_THROW(
+      DelegatedCredentialUtils::verify(
+          *leaf_, certData_, credential, now_ - std::chrono::hours(24 * 8)),
+      std::runtime_error);
+}
+
+TEST_F(DelegatedCredentialTest, TestVerifyTampered) {
+  auto credential = generate();
+  credential.valid_time++;
+  EXPECT_THROW(
+      DelegatedCredentialUtils::verify(*leaf_, certData_, credential, now_),
+      std::runtime_error);
+}
+
+TEST_F(DelegatedCredentialTest, TestVerifyNoDelegationUsage) {
+  auto credential = generate();
+  auto certData = getCertData(kP256Certificate);
+  auto leaf = CertUtils::makePeerCert(certData->clone());
+  EXPECT_THROW(
+      DelegatedCredentialUtils::verify(*leaf, certData, credential, now_),
+      std::runtime_error);
+}
+
+TEST_F(DelegatedCredentialTest, TestGenerateValidityTooLong) {
+  EXPECT_THROW(generate(std::chrono::hours(24 * 8)), std::runtime_error);
+}
+
+TEST_F(DelegatedCredentialTest, TestGenerateNoDelegationUsage) {
+  parent_ = CertUtils::makeSelfCert(kP256Certificate.str(), kP256Key.str());
+  EXPECT_THROW(generate(), std::runtime_error);
+}
+
+TEST_F(DelegatedCredentialTest, TestSelfCert) {
+  auto delegated =
+      DelegatedSelfCert::make(parent_, kP384Key.str(), generate());
+  EXPECT_EQ(delegated->getIdentity(), parent_->getIdentity());
+  EXPECT_EQ(
+      delegated->getSigSchemes(),
+      std::vector<SignatureScheme>{SignatureScheme::ecdsa_secp384r1_sha384});
+
+  auto msg = delegated->getCertMessage();
+  EXPECT_EQ(msg.certificate_list.size(), 1);
+  auto& leafEntry = msg.certificate_list.front();
+  EXPECT_TRUE(IOBufEqualTo()(leafEntry.cert_data, certData_));
+  auto credential = getExtension<DelegatedCredential>(leafEntry.extensions);
+  EXPECT_TRUE(credential.hasValue());
+
+  auto peer =
+      DelegatedCredentialUtils::makeDelegatedPeerCert(leaf_, *credential);
+  EXPECT_EQ(peer->getIdentity(), leaf_->getIdentity());
+  auto sig = delegated->sign(
+      SignatureScheme::ecdsa_secp384r1_sha384,
+      CertificateVerifyContext::Server,
+      range(StringPiece("hello")));
+  peer->verify(
+      SignatureScheme::ecdsa_secp384r1_sha384,
+      CertificateVerifyContext::Server,
+      range(StringPiece("hello")),
+      sig->coalesce());
+  EXPECT_THROW(
+      peer->verify(
+          SignatureScheme::ecdsa_secp256r1_sha256,
+          CertificateVerifyContext::Server,
+          range(StringPiece("hello")),
+          sig->coalesce()),
+      std::runtime_error);
+  EXPECT_THROW(
+      leaf_->verify(
+          SignatureScheme::ecdsa_secp256r1_sha256,
+          CertificateVerifyContext::Server,
+          range(StringPiece("hello")),
+          sig->coalesce()),
+      std::runtime_error);
+}
+
+TEST_F(DelegatedCredentialTest, TestSelfCertWrongScheme) {
+  auto delegated =
+      DelegatedSelfCert::make(parent_, kP384Key.str(), generate());
+  EXPECT_THROW(
+      delegated->sign(
+          SignatureScheme::ecdsa_secp256r1_sha256,
+          CertificateVerifyContext::Server,
+          range(StringPiece("hello"))),
+      std::runtime_error);
+}
+
+TEST_F(DelegatedCredentialTest, TestSelfCertWrongKey) {
+  EXPECT_THROW(
+      DelegatedSelfCert::make(parent_, kP256Key.str(), generate()),
+      std::runtime_error);
+}
+} // namespace test
+} // namespace fizz
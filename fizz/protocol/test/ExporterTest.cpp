@@ -31,5 +31,38 @@ TEST(ExporterTest, TestExporterBasic) {
 
   EXPECT_EQ(StringPiece(ekm->coalesce()), unhexlify(basic_expected_ekm));
 }
+
+TEST(ExporterTest, TestExporterInPlace) {
+  auto deriver = Factory().makeKeyDeriver(CipherSuite::TLS_AES_128_GCM_SHA256);
+  std::array<uint8_t, 32> ekm;
+  Exporter::getEkm(
+      *deriver,
+      folly::Range<const char*>(exporter_master),
+      label,
+      folly::ByteRange(),
+      folly::range(ekm));
+  EXPECT_EQ(StringPiece(folly::range(ekm)), unhexlify(basic_expected_ekm));
+}
+
+TEST(ExporterTest, TestExporterInPlaceWithContext) {
+  auto context = IOBuf::copyBuffer("some");
+  context->prependChain(IOBuf::copyBuffer("context"));
+  auto expected = Exporter::getEkm(
+      CipherSuite::TLS_AES_256_GCM_SHA384,
+      folly::Range<const char*>(exporter_master),
+      label,
+      context->clone(),
+      20);
+
+  auto deriver = Factory().makeKeyDeriver(CipherSuite::TLS_AES_256_GCM_SHA384);
+  std::array<uint8_t, 20> ekm;
+  Exporter::getEkm(
+      *deriver,
+      folly::Range<const char*>(exporter_master),
+      label,
+      StringPiece("somecontext"),
+      folly::range(ekm));
+  EXPECT_EQ(StringPiece(folly::range(ekm)), StringPiece(expected->coalesce()));
+}
 } // namespace test
 } // namespace fizz
@@ -326,6 +326,112 @@ TEST_F(FizzBaseTest, TestWriteThenCloseInCallback) {
   testFizz_->appWrite(appWrite("write1"));
 }
 
+TEST_F(FizzBaseTest, TestCoalesceWritesInCallback) {
+  testFizz_->setCoalesceAppWrites(true);
+  MockWriteCallback writeCallback2;
+  AsyncTransportWrapper::WriteCallback* mergedCallback = nullptr;
+  EXPECT_CALL(
+      *TestStateMachine::instance, processAppWrite_(_, WriteMatches("write1")))
+      .InSequence(s_)
+      .WillOnce(InvokeWithoutArgs([]() { return Actions{A1()}; }));
+  EXPECT_CALL(testFizz_->visitor_, a1())
+      .InSequence(s_)
+      .WillOnce(Invoke([this, &writeCallback2]() {
+        auto write2 = appWrite("write2");
+        write2.callback = &writeCallback_;
+        testFizz_->appWrite(std::move(write2));
+        testFizz_->appWrite(appWrite("write3"));
+        auto write4 = appWrite("write4");
+        write4.callback = &writeCallback2;
+        testFizz_->appWrite(std::move(write4));
+      }));
+  EXPECT_CALL(
+      *TestStateMachine::instance,
+      processAppWrite_(_, WriteMatches("write2write3write4")))
+      .InSequence(s_)
+      .WillOnce(Invoke([&mergedCallback](const State&, AppWrite& write) {
+        mergedCallback = write.callback;
+        return Actions{};
+      }));
+  testFizz_->appWrite(appWrite("write1"));
+
+  ASSERT_NE(mergedCallback, nullptr);
+  EXPECT_CALL(writeCallback_, writeSuccess_()).InSequence(s_);
+  EXPECT_CALL(writeCallback2, writeSuccess_()).InSequence(s_);
+  mergedCallback->writeSuccess();
+}
+
+TEST_F(FizzBaseTest, TestCoalescedWriteErrorBytes) {
+  testFizz_->setCoalesceAppWrites(true);
+  MockWriteCallback writeCallback2;
+  MockWriteCallback writeCallback3;
+  AsyncTransportWrapper::WriteCallback* mergedCallback = nullptr;
+  EXPECT_CALL(
+      *TestStateMachine::instance, processAppWrite_(_, WriteMatches("write1")))
+      .InSequence(s_)
+      .WillOnce(InvokeWithoutArgs([]() { return Actions{A1()}; }));
+  EXPECT_CALL(testFizz_->visitor_, a1())
+      .InSequence(s_)
+      .WillOnce(Invoke([&]() {
+        auto write2 = appWrite("write2");
+        write2.callback = &writeCallback_;
+        testFizz_->appWrite(std::move(write2));
+        testFizz_->appWrite(appWrite("write3"));
+        auto write4 = appWrite("write4");
+        write4.callback = &writeCallback2;
+        testFizz_->appWrite(std::move(write4));
+        auto write5 = appWrite("write5");
+        write5.callback = &writeCallback3;
+        testFizz_->appWrite(std::move(write5));
+      }));
+  EXPECT_CALL(
+      *TestStateMachine::instance,
+      processAppWrite_(_, WriteMatches("write2write3write4write5")))
+      .InSequence(s_)
+      .WillOnce(Invoke([&mergedCallback](const State&, AppWrite& write) {
+        mergedCallback = write.callback;
+        return Actions{};
+      }));
+  testFizz_->appWrite(appWrite("write1"));
+
+  // 14 bytes: all of write2 and write3, and 2 bytes of write4.
+  ASSERT_NE(mergedCallback, nullptr);
+  EXPECT_CALL(writeCallback_, writeErr_(6, _)).InSequence(s_);
+  EXPECT_CALL(writeCallback2, writeErr_(2, _)).InSequence(s_);
+  EXPECT_CALL(writeCallback3, writeErr_(0, _)).InSequence(s_);
+  mergedCallback->writeErr(
+      14, AsyncSocketException(AsyncSocketException::UNKNOWN, "unit test"));
+}
+
+TEST_F(FizzBaseTest, TestCoalesceWritesStopAtClose) {
+  testFizz_->setCoalesceAppWrites(true);
+  EXPECT_CALL(
+      *TestStateMachine::instance, processAppWrite_(_, WriteMatches("write1")))
+      .InSequence(s_)
+      .WillOnce(InvokeWithoutArgs([]() { return Actions{A1()}; }));
+  EXPECT_CALL(testFizz_->visitor_, a1())
+      .InSequence(s_)
+      .WillOnce(Invoke([this]() {
+        testFizz_->appWrite(appWrite("write2"));
+        testFizz_->appWrite(appWrite("write3"));
+        testFizz_->appClose();
+        testFizz_->appWrite(appWrite("write4"));
+      }));
+  EXPECT_CALL(
+      *TestStateMachine::instance,
+      processAppWrite_(_, WriteMatches("write2write3")))
+      .InSequence(s_)
+      .WillOnce(InvokeWithoutArgs([]() { return Actions{}; }));
+  EXPECT_CALL(*TestStateMachine::instance, processAppClose(_))
+      .InSequence(s_)
+      .WillOnce(InvokeWithoutArgs([]() { return Actions{}; }));
+  EXPECT_CALL(
+      *TestStateMachine::instance, processAppWrite_(_, WriteMatches("write4")))
+      .InSequence(s_)
+      .WillOnce(InvokeWithoutArgs([]() { return Actions{}; }));
+  testFizz_->appWrite(appWrite("write1"));
+}
+
 TEST_F(FizzBaseTest, TestDeleteInCallback) {
   EXPECT_CALL(*TestStateMachine::instance, processSocketData(_, _))
       .InSequence(s_)
@@ -407,6 +513,37 @@ TEST_F(FizzBaseTest, TestActionProcessingAsync) {
   EXPECT_FALSE(testFizz_->actionProcessing());
 }
 
+TEST_F(FizzBaseTest, TestOwnerGuardedScope) {
+  EXPECT_CALL(*TestStateMachine::instance, processAppClose(_))
+      .WillOnce(InvokeWithoutArgs([this]() {
+        EXPECT_EQ(testFizz_->getDestructorGuardCount(), 1);
+        return Actions{A1()};
+      }));
+  EXPECT_CALL(testFizz_->visitor_, a1()).WillOnce(InvokeWithoutArgs([this]() {
+    EXPECT_EQ(testFizz_->getDestructorGuardCount(), 1);
+  }));
+  DelayedDestruction::DestructorGuard dg(testFizz_.get());
+  TestFizzBase::OwnerGuardedScope guarded(*testFizz_);
+  testFizz_->appClose();
+  EXPECT_FALSE(testFizz_->actionProcessing());
+}
+
+TEST_F(FizzBaseTest, TestOwnerGuardedScopeAsync) {
+  Promise<Actions> p;
+  EXPECT_CALL(*TestStateMachine::instance, processAppClose(_))
+      .WillOnce(InvokeWithoutArgs([&p]() { return p.getFuture(); }));
+  {
+    DelayedDestruction::DestructorGuard dg(testFizz_.get());
+    TestFizzBase::OwnerGuardedScope guarded(*testFizz_);
+    testFizz_->appClose();
+  }
+  EXPECT_TRUE(testFizz_->actionProcessing());
+  EXPECT_EQ(testFizz_->getDestructorGuardCount(), 1);
+  p.setValue(Actions{});
+  EXPECT_FALSE(testFizz_->actionProcessing());
+  EXPECT_EQ(testFizz_->getDestructorGuardCount(), 0);
+}
+
 TEST_F(FizzBaseTest, TestErrorPendingEvents) {
   EXPECT_CALL(
       *TestStateMachine::instance, processAppWrite_(_, WriteMatches("write1")))
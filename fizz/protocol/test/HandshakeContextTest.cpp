@@ -8,6 +8,7 @@
 
 #include <gtest/gtest.h>
 
+#include <fizz/protocol/CipherSuiteTraits.h>
 #include <fizz/protocol/HandshakeContext.h>
 
 using namespace folly;
@@ -32,6 +33,24 @@ TEST_F(HandshakeContextTest, TestHandshakeContextMultiple) {
   context.getHandshakeContext();
 }
 
+TEST_F(HandshakeContextTest, TestHandshakeContextIntoRange) {
+  HandshakeContextImpl<Sha256> bufContext;
+  bufContext.appendToTranscript(folly::IOBuf::copyBuffer("ClientHello"));
+  bufContext.appendToTranscript(folly::IOBuf::copyBuffer("ServerHello"));
+
+  HandshakeContextImpl<Sha256> rangeContext;
+  StringPiece transcript{"ClientHelloServerHello"};
+  rangeContext.appendToTranscript(ByteRange(transcript.subpiece(0, 11)));
+  rangeContext.appendToTranscript(ByteRange(transcript.subpiece(11)));
+
+  std::array<uint8_t, kMaxHashLength> out;
+  auto context = rangeContext.getHandshakeContext(folly::range(out));
+  EXPECT_EQ(context.size(), Sha256::HashLen);
+  EXPECT_EQ(
+      StringPiece(context),
+      StringPiece(bufContext.getHandshakeContext()->coalesce()));
+}
+
 TEST_F(HandshakeContextTest, TestFinished) {
   HandshakeContextImpl<Sha256> context;
   context.appendToTranscript(folly::IOBuf::copyBuffer("ClientHello"));
@@ -45,5 +64,33 @@ TEST_F(HandshakeContextTest, TestEmpty) {
   std::array<uint8_t, Sha256::HashLen> key{4};
   context.getFinishedData(folly::range(key));
 }
+
+TEST_F(HandshakeContextTest, TestFinishedDataMatchesExpandLabel) {
+  HandshakeContextImpl<Sha256> context;
+  context.appendToTranscript(folly::IOBuf::copyBuffer("ClientHello"));
+  std::array<uint8_t, Sha256::HashLen> key{4};
+  auto finishedKey = KeyDerivationImpl<Sha256>().expandLabel(
+      folly::range(key), "finished", folly::IOBuf::create(0), Sha256::HashLen);
+  std::array<uint8_t, Sha256::HashLen> expected;
+  Sha256::hmac(
+      finishedKey->coalesce(),
+      *context.getHandshakeContext(),
+      folly::range(expected));
+  auto finished = context.getFinishedData(folly::range(key));
+  EXPECT_EQ(
+      StringPiece(folly::range(expected)), StringPiece(finished->coalesce()));
+}
+
+TEST_F(HandshakeContextTest, TestCipherSuiteTraits) {
+  auto hashLength = [](CipherSuite cipher) {
+    return withCipherSuiteTraits(
+        cipher, [](auto traits) { return decltype(traits)::Hash::HashLen; });
+  };
+  EXPECT_EQ(hashLength(CipherSuite::TLS_AES_128_GCM_SHA256), 32);
+  EXPECT_EQ(hashLength(CipherSuite::TLS_CHACHA20_POLY1305_SHA256), 32);
+  EXPECT_EQ(hashLength(CipherSuite::TLS_AES_256_GCM_SHA384), 48);
+  EXPECT_THROW(
+      hashLength(static_cast<CipherSuite>(0x1399)), std::runtime_error);
+}
 } // namespace test
 } // namespace fizz
@@ -0,0 +1,57 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/KTLS.h>
+
+namespace fizz {
+namespace test {
+
+TEST(KTLSTest, TestParseStats) {
+  auto stats = KTLS::parseStats(
+      "TlsCurrTxSw                     \t1\n"
+      "TlsCurrRxSw                     \t2\n"
+      "TlsCurrTxDevice                 \t3\n"
+      "TlsCurrRxDevice                 \t4\n"
+      "TlsTxSw                         \t5\n"
+      "TlsRxSw                         \t6\n"
+      "TlsTxDevice                     \t7\n"
+      "TlsRxDevice                     \t8\n"
+      "TlsDecryptError                 \t9\n"
+      "TlsRxDeviceResync               \t10\n"
+      "TlsDecryptRetry                 \t11\n"
+      "TlsRxNoPadViolation             \t12\n");
+  EXPECT_EQ(stats.currTxSw, 1);
+  EXPECT_EQ(stats.currRxSw, 2);
+  EXPECT_EQ(stats.currTxDevice, 3);
+  EXPECT_EQ(stats.currRxDevice, 4);
+  EXPECT_EQ(stats.txSw, 5);
+  EXPECT_EQ(stats.rxSw, 6);
+  EXPECT_EQ(stats.txDevice, 7);
+  EXPECT_EQ(stats.rxDevice, 8);
+  EXPECT_EQ(stats.decryptError, 9);
+  EXPECT_EQ(stats.rxDeviceResync, 10);
+  EXPECT_EQ(stats.decryptRetry, 11);
+  EXPECT_EQ(stats.rxNoPadViolation, 12);
+}
+
+TEST(KTLSTest, TestParseStatsOldKernel) {
+  auto stats = KTLS::parseStats(
+      "TlsCurrTxSw 1\n"
+      "TlsTxDevice 2\n"
+      "TlsSomethingNew 3\n"
+      "garbage\n"
+      "TlsRxSw notanumber\n");
+  EXPECT_EQ(stats.currTxSw, 1);
+  EXPECT_EQ(stats.txDevice, 2);
+  EXPECT_EQ(stats.rxSw, 0);
+  EXPECT_EQ(stats.rxDeviceResync, 0);
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,160 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/exchange/test/Mocks.h>
+#include <fizz/protocol/Factory.h>
+#include <fizz/protocol/KeyExchangePool.h>
+#include <folly/executors/ManualExecutor.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+class KeyExchangePoolTest : public Test {
+ public:
+  void SetUp() override {
+    executor_ = std::make_shared<ManualExecutor>();
+    pool_ = KeyExchangePool::create(
+        executor_, {NamedGroup::x25519}, 4, [this](NamedGroup group) {
+          EXPECT_EQ(group, NamedGroup::x25519);
+          auto kex = std::make_unique<MockKeyExchange>();
+          EXPECT_CALL(*kex, generateKeyPair());
+          made_++;
+          return kex;
+        });
+  }
+
+ protected:
+  std::shared_ptr<ManualExecutor> executor_;
+  std::shared_ptr<KeyExchangePool> pool_;
+  size_t made_{0};
+};
+
+TEST_F(KeyExchangePoolTest, TestFill) {
+  EXPECT_EQ(pool_->available(NamedGroup::x25519), 0);
+  pool_->fill();
+  EXPECT_EQ(made_, 4);
+  EXPECT_EQ(pool_->available(NamedGroup::x25519), 4);
+
+  // The key pair was generated by the pool, so generating it again during
+  // the handshake is a no-op.
+  auto kex = pool_->get(NamedGroup::x25519);
+  ASSERT_NE(kex, nullptr);
+  kex->generateKeyPair();
+  EXPECT_EQ(made_, 4);
+  EXPECT_EQ(pool_->available(NamedGroup::x25519), 3);
+}
+
+TEST_F(KeyExchangePoolTest, TestSingleUse) {
+  pool_->fill();
+  std::set<KeyExchange*> seen;
+  for (size_t i = 0; i < 4; i++) {
+    auto kex = pool_->get(NamedGroup::x25519);
+    ASSERT_NE(kex, nullptr);
+    EXPECT_TRUE(seen.insert(kex.get()).second);
+  }
+  EXPECT_EQ(pool_->get(NamedGroup::x25519), nullptr);
+}
+
+TEST_F(KeyExchangePoolTest, TestRefill) {
+  EXPECT_EQ(pool_->get(NamedGroup::x25519), nullptr);
+  EXPECT_EQ(made_, 0);
+  executor_->drain();
+  EXPECT_EQ(made_, 4);
+  EXPECT_EQ(pool_->available(NamedGroup::x25519), 4);
+
+  pool_->get(NamedGroup::x25519);
+  pool_->get(NamedGroup::x25519);
+  executor_->drain();
+  EXPECT_EQ(pool_->available(NamedGroup::x25519), 2);
+  pool_->get(NamedGroup::x25519);
+  executor_->drain();
+  EXPECT_EQ(pool_->available(NamedGroup::x25519), 4);
+}
+
+TEST_F(KeyExchangePoolTest, TestUnknownGroup) {
+  EXPECT_EQ(pool_->get(NamedGroup::secp256r1), nullptr);
+  EXPECT_EQ(pool_->available(NamedGroup::secp256r1), 0);
+}
+
+TEST_F(KeyExchangePoolTest, TestPoolDestroyedBeforeRefill) {
+  pool_->get(NamedGroup::x25519);
+  pool_.reset();
+  executor_->drain();
+  EXPECT_EQ(made_, 0);
+}
+
+TEST_F(KeyExchangePoolTest, TestRefillAfterMakeThrows) {
+  bool fail = true;
+  pool_ = KeyExchangePool::create(
+      executor_, {NamedGroup::x25519}, 4, [&](NamedGroup) {
+        if (fail) {
+          throw std::runtime_error("make failed");
+        }
+        auto kex = std::make_unique<MockKeyExchange>();
+        EXPECT_CALL(*kex, generateKeyPair());
+        return kex;
+      });
+  EXPECT_EQ(pool_->get(NamedGroup::x25519), nullptr);
+  try {
+    executor_->drain();
+  } catch (const std::exception&) {
+  }
+  EXPECT_EQ(pool_->available(NamedGroup::x25519), 0);
+
+  fail = false;
+  EXPECT_EQ(pool_->get(NamedGroup::x25519), nullptr);
+  executor_->drain();
+  EXPECT_EQ(pool_->available(NamedGroup::x25519), 4);
+}
+
+class PooledFactory : public Factory {
+ public:
+  explicit PooledFactory(std::shared_ptr<KeyExchangePool> pool)
+      : pool_(std::move(pool)) {}
+
+  std::shared_ptr<KeyExchangePool> getKeyExchangePool() const override {
+    return pool_;
+  }
+
+ private:
+  std::shared_ptr<KeyExchangePool> pool_;
+};
+
+TEST(KeyExchangePoolFactoryTest, TestMakeKeyExchange) {
+  auto pool = KeyExchangePool::create(
+      nullptr, {NamedGroup::x25519}, 1, [](NamedGroup group) {
+        return Factory::makeDefaultKeyExchange(
+            group, Factory::KeyExchangeMode::Client);
+      });
+  pool->fill();
+  PooledFactory factory(pool);
+
+  auto pooled = factory.makeKeyExchange(
+      NamedGroup::x25519, Factory::KeyExchangeMode::Client);
+  pooled->generateKeyPair();
+  auto share = pooled->getKeyShare();
+  EXPECT_EQ(pool->available(NamedGroup::x25519), 0);
+
+  // Falls back to generating on demand when the pool is empty.
+  auto peer = factory.makeKeyExchange(
+      NamedGroup::x25519, Factory::KeyExchangeMode::Client);
+  peer->generateKeyPair();
+  auto peerShare = peer->getKeyShare();
+  EXPECT_FALSE(IOBufEqualTo()(share, peerShare));
+  EXPECT_TRUE(IOBufEqualTo()(
+      pooled->generateSharedSecret(peerShare->coalesce()),
+      peer->generateSharedSecret(share->coalesce())));
+}
+} // namespace test
+} // namespace fizz
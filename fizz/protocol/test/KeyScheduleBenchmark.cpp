@@ -0,0 +1,273 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include <folly/ssl/Init.h>
+
+#include <fizz/crypto/Hkdf.h>
+#include <fizz/crypto/KeyDerivation.h>
+#include <fizz/protocol/HandshakeContext.h>
+#include <fizz/protocol/KeyScheduler.h>
+
+#include <array>
+
+using namespace fizz;
+
+namespace {
+
+// Stand ins for the inputs of a handshake: a 32 byte secret (an ECDHE shared
+// secret or PSK), a transcript hash, and a ClientHello sized message.
+const std::array<uint8_t, 48> kSecret = {{0x42}};
+const std::array<uint8_t, 48> kTranscript = {{0x24}};
+const std::string kMessage(512, 'm');
+
+template <typename Hash>
+void hkdfExtract(uint32_t n) {
+  HkdfImpl<Hash> hkdf;
+  for (uint32_t i = 0; i < n; ++i) {
+    auto prk = hkdf.extract(
+        folly::range(kSecret).subpiece(0, Hash::HashLen),
+        folly::range(kSecret).subpiece(0, 32));
+    folly::doNotOptimizeAway(prk);
+  }
+}
+
+template <typename Hash>
+void hkdfExpand(uint32_t n, size_t length) {
+  HkdfImpl<Hash> hkdf;
+  auto info = folly::IOBuf::copyBuffer("tls13 c hs traffic");
+  for (uint32_t i = 0; i < n; ++i) {
+    auto okm = hkdf.expand(
+        folly::range(kSecret).subpiece(0, Hash::HashLen), *info, length);
+    folly::doNotOptimizeAway(okm);
+  }
+}
+
+template <typename Hash>
+void expandLabel(uint32_t n) {
+  KeyDerivationImpl<Hash> deriver;
+  std::array<uint8_t, Hash::HashLen> out;
+  for (uint32_t i = 0; i < n; ++i) {
+    deriver.expandLabel(
+        folly::range(kSecret).subpiece(0, Hash::HashLen),
+        "key",
+        folly::ByteRange(),
+        folly::MutableByteRange(out.data(), 16));
+    folly::doNotOptimizeAway(out);
+  }
+}
+
+template <typename Hash>
+void expandLabelAllocating(uint32_t n) {
+  KeyDerivationImpl<Hash> deriver;
+  for (uint32_t i = 0; i < n; ++i) {
+    auto out = deriver.expandLabel(
+        folly::range(kSecret).subpiece(0, Hash::HashLen),
+        "key",
+        folly::IOBuf::create(0),
+        16);
+    folly::doNotOptimizeAway(out);
+  }
+}
+
+template <typename Hash>
+void deriveSecret(uint32_t n) {
+  KeyDerivationImpl<Hash> deriver;
+  for (uint32_t i = 0; i < n; ++i) {
+    auto out = deriver.deriveSecret(
+        folly::range(kSecret).subpiece(0, Hash::HashLen),
+        "c hs traffic",
+        folly::range(kTranscript).subpiece(0, Hash::HashLen));
+    folly::doNotOptimizeAway(out);
+  }
+}
+
+/**
+ * Every derivation the key schedule does for one side of a handshake: the
+ * handshake and traffic secrets and their keys, the exporter and resumption
+ * master secrets, and with a PSK the early secret and binder key.
+ */
+template <typename Hash>
+void keySchedule(uint32_t n, bool psk) {
+  auto transcript = folly::range(kTranscript).subpiece(0, Hash::HashLen);
+  for (uint32_t i = 0; i < n; ++i) {
+    KeyScheduler scheduler(std::make_unique<KeyDerivationImpl<Hash>>());
+    if (psk) {
+      scheduler.deriveEarlySecret(
+          folly::range(kSecret).subpiece(0, Hash::HashLen));
+      auto binderKey = scheduler.getSecret(
+          EarlySecrets::ResumptionPskBinder, Hash::BlankHash);
+      folly::doNotOptimizeAway(binderKey);
+    }
+    scheduler.deriveHandshakeSecret(folly::range(kSecret).subpiece(0, 32));
+    for (auto secret : {HandshakeSecrets::ClientHandshakeTraffic,
+                        HandshakeSecrets::ServerHandshakeTraffic}) {
+      auto trafficSecret = scheduler.getSecret(secret, transcript);
+      auto key = scheduler.getTrafficKey(folly::range(trafficSecret), 16, 12);
+      folly::doNotOptimizeAway(key);
+    }
+    scheduler.deriveMasterSecret();
+    scheduler.deriveAppTrafficSecrets(transcript);
+    for (auto secret : {AppTrafficSecrets::ClientAppTraffic,
+                        AppTrafficSecrets::ServerAppTraffic}) {
+      auto trafficSecret = scheduler.getSecret(secret);
+      auto key = scheduler.getTrafficKey(folly::range(trafficSecret), 16, 12);
+      folly::doNotOptimizeAway(key);
+    }
+    auto exporter =
+        scheduler.getSecret(MasterSecrets::ExporterMaster, transcript);
+    auto resumption =
+        scheduler.getSecret(MasterSecrets::ResumptionMaster, transcript);
+    folly::doNotOptimizeAway(exporter);
+    folly::doNotOptimizeAway(resumption);
+    scheduler.clearMasterSecret();
+  }
+}
+
+template <typename Hash>
+void keyUpdate(uint32_t n) {
+  KeyScheduler scheduler(std::make_unique<KeyDerivationImpl<Hash>>());
+  BENCHMARK_SUSPEND {
+    scheduler.deriveHandshakeSecret(folly::range(kSecret).subpiece(0, 32));
+    scheduler.deriveMasterSecret();
+    scheduler.deriveAppTrafficSecrets(
+        folly::range(kTranscript).subpiece(0, Hash::HashLen));
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    scheduler.clientKeyUpdate();
+    auto trafficSecret =
+        scheduler.getSecret(AppTrafficSecrets::ClientAppTraffic);
+    auto key = scheduler.getTrafficKey(folly::range(trafficSecret), 16, 12);
+    folly::doNotOptimizeAway(key);
+  }
+}
+
+template <typename Hash>
+void handshakeContext(uint32_t n) {
+  HandshakeContextImpl<Hash> context;
+  std::array<uint8_t, kMaxHashLength> out;
+  for (uint32_t i = 0; i < n; ++i) {
+    context.appendToTranscript(folly::ByteRange(folly::StringPiece(kMessage)));
+    auto hash = context.getHandshakeContext(folly::range(out));
+    folly::doNotOptimizeAway(hash);
+  }
+}
+
+template <typename Hash>
+void handshakeContextAllocating(uint32_t n) {
+  HandshakeContextImpl<Hash> context;
+  for (uint32_t i = 0; i < n; ++i) {
+    context.appendToTranscript(folly::ByteRange(folly::StringPiece(kMessage)));
+    auto hash = context.getHandshakeContext();
+    folly::doNotOptimizeAway(hash);
+  }
+}
+
+template <typename Hash>
+void finishedData(uint32_t n) {
+  HandshakeContextImpl<Hash> context;
+  BENCHMARK_SUSPEND {
+    context.appendToTranscript(folly::ByteRange(folly::StringPiece(kMessage)));
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    auto data = context.getFinishedData(
+        folly::range(kSecret).subpiece(0, Hash::HashLen));
+    folly::doNotOptimizeAway(data);
+  }
+}
+} // namespace
+
+BENCHMARK(hkdfExtractSha256, n) {
+  hkdfExtract<Sha256>(n);
+}
+
+BENCHMARK(hkdfExtractSha384, n) {
+  hkdfExtract<Sha384>(n);
+}
+
+BENCHMARK(hkdfExpandSha256_16, n) {
+  hkdfExpand<Sha256>(n, 16);
+}
+
+BENCHMARK(hkdfExpandSha256_32, n) {
+  hkdfExpand<Sha256>(n, 32);
+}
+
+BENCHMARK(hkdfExpandSha384_48, n) {
+  hkdfExpand<Sha384>(n, 48);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(expandLabelSha256, n) {
+  expandLabel<Sha256>(n);
+}
+
+BENCHMARK(expandLabelSha256Allocating, n) {
+  expandLabelAllocating<Sha256>(n);
+}
+
+BENCHMARK(expandLabelSha384, n) {
+  expandLabel<Sha384>(n);
+}
+
+BENCHMARK(deriveSecretSha256, n) {
+  deriveSecret<Sha256>(n);
+}
+
+BENCHMARK(deriveSecretSha384, n) {
+  deriveSecret<Sha384>(n);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(keyScheduleFullSha256, n) {
+  keySchedule<Sha256>(n, false);
+}
+
+BENCHMARK(keySchedulePskSha256, n) {
+  keySchedule<Sha256>(n, true);
+}
+
+BENCHMARK(keyScheduleFullSha384, n) {
+  keySchedule<Sha384>(n, false);
+}
+
+BENCHMARK(keyUpdateSha256, n) {
+  keyUpdate<Sha256>(n);
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(handshakeContextSha256, n) {
+  handshakeContext<Sha256>(n);
+}
+
+BENCHMARK(handshakeContextSha256Allocating, n) {
+  handshakeContextAllocating<Sha256>(n);
+}
+
+BENCHMARK(handshakeContextSha384, n) {
+  handshakeContext<Sha384>(n);
+}
+
+BENCHMARK(finishedDataSha256, n) {
+  finishedData<Sha256>(n);
+}
+
+BENCHMARK(finishedDataSha384, n) {
+  finishedData<Sha384>(n);
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::ssl::init();
+  folly::runBenchmarks();
+  return 0;
+}
@@ -25,7 +25,14 @@ class KeySchedulerTest : public testing::Test {
     kd_ = kd.get();
     ON_CALL(*kd_, hashLength()).WillByDefault(Return(4));
     ON_CALL(*kd_, _expandLabel(_, _, _, _))
-        .WillByDefault(InvokeWithoutArgs([]() { return IOBuf::create(0); }));
+        .WillByDefault(
+            Invoke([](ByteRange, StringPiece, Buf&, uint16_t length) {
+              return IOBuf::copyBuffer(std::string(length, 0));
+            }));
+    ON_CALL(*kd_, deriveSecret(_, _, _))
+        .WillByDefault(Return(std::vector<uint8_t>(4)));
+    ON_CALL(*kd_, hkdfExtract(_, _))
+        .WillByDefault(Return(std::vector<uint8_t>(4)));
     ks_ = std::make_unique<KeyScheduler>(std::move(kd));
   }
 
@@ -140,5 +147,47 @@ TEST_F(KeySchedulerTest, TestTrafficKey) {
   StringPiece trafficSecret{"secret"};
   ks_->getTrafficKey(trafficSecret, 10, 10);
 }
+TEST(KeySchedulerRealTest, TestSecretIntoRange) {
+  KeyScheduler ks(std::make_unique<KeyDerivationImpl<Sha256>>());
+  std::vector<uint8_t> transcript(Sha256::HashLen, 0x11);
+  ks.deriveHandshakeSecret(StringPiece("ecdhe"));
+  ks.deriveMasterSecret();
+  ks.deriveAppTrafficSecrets(range(transcript));
+  ASSERT_EQ(ks.secretLength(), Sha256::HashLen);
+
+  InlineSecret out(ks.secretLength());
+  ks.getSecret(
+      MasterSecrets::ExporterMaster, range(transcript), out.writableRange());
+  auto expected =
+      ks.getSecret(MasterSecrets::ExporterMaster, range(transcript));
+  EXPECT_EQ(StringPiece(range(expected)), StringPiece(out.range()));
+
+  ks.getSecret(AppTrafficSecrets::ServerAppTraffic, out.writableRange());
+  expected = ks.getSecret(AppTrafficSecrets::ServerAppTraffic);
+  EXPECT_EQ(StringPiece(range(expected)), StringPiece(out.range()));
+
+  std::vector<uint8_t> nonce{1, 2, 3};
+  ks.getResumptionSecret(range(expected), range(nonce), out.writableRange());
+  auto resumption = ks.getResumptionSecret(range(expected), range(nonce));
+  EXPECT_EQ(StringPiece(resumption->coalesce()), StringPiece(out.range()));
+}
+
+TEST(KeySchedulerRealTest, TestDeferredSecret) {
+  KeyScheduler ks(std::make_unique<KeyDerivationImpl<Sha256>>());
+  std::vector<uint8_t> transcript(Sha256::HashLen, 0x22);
+  ks.deriveHandshakeSecret(StringPiece("ecdhe"));
+  ks.deriveMasterSecret();
+  auto expected =
+      ks.getSecret(MasterSecrets::ExporterMaster, range(transcript));
+  DeferredSecret<std::vector<uint8_t>> deferred(
+      ks.getDeferredSecret(MasterSecrets::ExporterMaster, range(transcript)));
+  transcript.assign(transcript.size(), 0);
+  ks.clearMasterSecret();
+
+  EXPECT_TRUE(deferred.hasValue());
+  EXPECT_EQ(*deferred, expected);
+  EXPECT_EQ(*deferred, expected);
+  EXPECT_THROW(DeferredSecret<std::vector<uint8_t>>().value(), std::exception);
+}
 } // namespace test
 } // namespace fizz
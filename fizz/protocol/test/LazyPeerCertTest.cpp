@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/LazyPeerCert.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+TEST(LazyPeerCertTest, TestParsedOnFirstUse) {
+  int parses = 0;
+  LazyPeerCert cert(getCertData(kP256Certificate), [&parses](Buf certData) {
+    parses++;
+    return std::shared_ptr<PeerCert>(
+        CertUtils::makePeerCert(std::move(certData)));
+  });
+  EXPECT_FALSE(cert.isParsed());
+  EXPECT_EQ(parses, 0);
+
+  EXPECT_EQ(cert.getIdentity(), "Fizz");
+  EXPECT_TRUE(cert.isParsed());
+  EXPECT_TRUE(cert.getX509());
+  EXPECT_EQ(parses, 1);
+}
+
+TEST(LazyPeerCertTest, TestBadCert) {
+  int parses = 0;
+  LazyPeerCert cert(IOBuf::copyBuffer("notacert"), [&parses](Buf certData) {
+    parses++;
+    return std::shared_ptr<PeerCert>(
+        CertUtils::makePeerCert(std::move(certData)));
+  });
+  EXPECT_THROW(cert.getIdentity(), std::runtime_error);
+  EXPECT_THROW(cert.getX509(), std::runtime_error);
+  EXPECT_FALSE(cert.isParsed());
+  EXPECT_EQ(parses, 2);
+}
+
+TEST(LazyPeerCertTest, TestRetainParsed) {
+  std::shared_ptr<const PeerCert> cert =
+      CertUtils::makePeerCert(getCertData(kP256Certificate));
+  auto retained = retainPeerCert(cert, PeerCertRetention::Parsed);
+  EXPECT_EQ(retained, cert);
+}
+
+TEST(LazyPeerCertTest, TestRetainEncoded) {
+  auto retained = retainPeerCert(
+      CertUtils::makePeerCert(getCertData(kP256Certificate)),
+      PeerCertRetention::Encoded);
+  auto lazyCert = std::dynamic_pointer_cast<const LazyPeerCert>(retained);
+  ASSERT_TRUE(lazyCert);
+  EXPECT_FALSE(lazyCert->isParsed());
+  auto encodedLength = lazyCert->getEncodedLength();
+  EXPECT_GT(encodedLength, 0);
+  EXPECT_EQ(retained->getIdentity(), "Fizz");
+  EXPECT_TRUE(retained->getX509());
+  // The parse isn't kept.
+  EXPECT_FALSE(lazyCert->isParsed());
+  EXPECT_EQ(lazyCert->getEncodedLength(), encodedLength);
+}
+
+TEST(LazyPeerCertTest, TestEncodedOnly) {
+  int parses = 0;
+  LazyPeerCert cert(
+      getCertData(kP256Certificate),
+      [&parses](Buf certData) {
+        parses++;
+        return std::shared_ptr<PeerCert>(
+            CertUtils::makePeerCert(std::move(certData)));
+      },
+      "Fizz");
+  EXPECT_EQ(cert.getIdentity(), "Fizz");
+  EXPECT_EQ(parses, 0);
+  EXPECT_TRUE(cert.getX509());
+  EXPECT_TRUE(cert.getX509());
+  EXPECT_EQ(parses, 2);
+  EXPECT_FALSE(cert.isParsed());
+  EXPECT_TRUE(cert.getUnparsedCertData());
+}
+
+TEST(LazyPeerCertTest, TestRetainIdentityOnly) {
+  auto retained = retainPeerCert(
+      CertUtils::makePeerCert(getCertData(kP256Certificate)),
+      PeerCertRetention::IdentityOnly);
+  EXPECT_TRUE(std::dynamic_pointer_cast<const IdentityCert>(retained));
+  EXPECT_EQ(retained->getIdentity(), "Fizz");
+  EXPECT_FALSE(retained->getX509());
+}
+} // namespace test
+} // namespace fizz
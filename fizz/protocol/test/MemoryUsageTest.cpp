@@ -0,0 +1,57 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/MemoryUsage.h>
+
+namespace fizz {
+namespace test {
+
+TEST(MemoryUsageTest, TestTotal) {
+  MemoryUsage usage;
+  usage.readBufferBytes = 1;
+  usage.writeBufferBytes = 2;
+  usage.pendingEventBytes = 3;
+  usage.stateBytes = 4;
+  usage.cipherBytes = 5;
+  usage.peerCertBytes = 6;
+  EXPECT_EQ(usage.total(), 21);
+}
+
+TEST(MemoryUsageTest, TestTrackerIncremental) {
+  folly::EventBase evb;
+  auto& tracker = MemoryUsageTracker::get(evb);
+  EXPECT_EQ(&tracker, &MemoryUsageTracker::get(evb));
+
+  MemoryUsage first;
+  first.stateBytes = 100;
+  tracker.addConnection();
+  tracker.update(MemoryUsage(), first);
+
+  MemoryUsage second;
+  second.cipherBytes = 50;
+  tracker.addConnection();
+  tracker.update(MemoryUsage(), second);
+  EXPECT_EQ(tracker.getConnections(), 2);
+  EXPECT_EQ(tracker.getTotal().total(), 150);
+
+  MemoryUsage grown = first;
+  grown.readBufferBytes = 4096;
+  tracker.update(first, grown);
+  EXPECT_EQ(tracker.getTotal().readBufferBytes, 4096);
+  EXPECT_EQ(tracker.getTotal().total(), 4246);
+
+  tracker.removeConnection(grown);
+  EXPECT_EQ(tracker.getConnections(), 1);
+  EXPECT_EQ(tracker.getTotal().total(), 50);
+  tracker.removeConnection(second);
+  EXPECT_EQ(tracker.getTotal().total(), 0);
+}
+} // namespace test
+} // namespace fizz
@@ -11,10 +11,13 @@
 #include <fizz/crypto/aead/test/Mocks.h>
 #include <fizz/crypto/exchange/test/Mocks.h>
 #include <fizz/crypto/test/Mocks.h>
+#include <fizz/protocol/AsyncCertificateVerifier.h>
 #include <fizz/protocol/Certificate.h>
+#include <fizz/protocol/CertificateCompressor.h>
 #include <fizz/protocol/CertificateVerifier.h>
 #include <fizz/protocol/Factory.h>
 #include <fizz/protocol/HandshakeContext.h>
+#include <fizz/protocol/HandshakeTracer.h>
 #include <fizz/protocol/KeyScheduler.h>
 #include <fizz/record/test/Mocks.h>
 
@@ -33,9 +36,13 @@ class MockKeyScheduler : public KeyScheduler {
   MOCK_METHOD1(deriveHandshakeSecret, void(folly::ByteRange ecdhe));
   MOCK_METHOD0(deriveMasterSecret, void());
   MOCK_METHOD1(deriveAppTrafficSecrets, void(folly::ByteRange transcript));
+  MOCK_METHOD2(
+      setAppTrafficSecrets,
+      void(folly::ByteRange clientSecret, folly::ByteRange serverSecret));
   MOCK_METHOD0(clearMasterSecret, void());
   MOCK_METHOD0(clientKeyUpdate, uint32_t());
   MOCK_METHOD0(serverKeyUpdate, uint32_t());
+  MOCK_CONST_METHOD1(getNextSecret, std::vector<uint8_t>(AppTrafficSecrets s));
   MOCK_CONST_METHOD2(
       getSecret,
       std::vector<uint8_t>(EarlySecrets s, folly::ByteRange transcript));
@@ -56,6 +63,22 @@ class MockKeyScheduler : public KeyScheduler {
       getResumptionSecret,
       Buf(folly::ByteRange, folly::ByteRange));
 
+  // Deferred secrets call the mocked getSecret() once they are used.
+  folly::Function<std::vector<uint8_t>()> getDeferredSecret(
+      EarlySecrets s,
+      folly::ByteRange transcript) const override {
+    return [this, s, transcript = folly::IOBuf::copyBuffer(transcript)]() {
+      return getSecret(s, transcript->coalesce());
+    };
+  }
+  folly::Function<std::vector<uint8_t>()> getDeferredSecret(
+      MasterSecrets s,
+      folly::ByteRange transcript) const override {
+    return [this, s, transcript = folly::IOBuf::copyBuffer(transcript)]() {
+      return getSecret(s, transcript->coalesce());
+    };
+  }
+
   void setDefaults() {
     ON_CALL(*this, getTrafficKey(_, _, _))
         .WillByDefault(InvokeWithoutArgs([]() {
@@ -109,6 +132,15 @@ class MockSelfCert : public SelfCert {
           CertificateVerifyContext context,
           folly::ByteRange toBeSigned));
   MOCK_CONST_METHOD0(getX509, folly::ssl::X509UniquePtr());
+  MOCK_CONST_METHOD0(getCertificateType, CertificateType());
+  MOCK_CONST_METHOD1(
+      getStapledCertMessage,
+      Buf(const std::vector<ExtensionType>& requestedExtensions));
+  MOCK_CONST_METHOD2(
+      getDelegatedCert,
+      std::shared_ptr<const SelfCert>(
+          const std::vector<SignatureScheme>& peerCredentialSchemes,
+          const std::vector<SignatureScheme>& peerSigSchemes));
 };
 
 class MockPeerCert : public PeerCert {
@@ -133,6 +165,53 @@ class MockCertificateVerifier : public CertificateVerifier {
   MOCK_CONST_METHOD0(getCertificateRequestExtensions, std::vector<Extension>());
 };
 
+class MockAsyncCertificateVerifier : public AsyncCertificateVerifier {
+ public:
+  MOCK_CONST_METHOD1(
+      verify,
+      void(const std::vector<std::shared_ptr<const PeerCert>>&));
+
+  MOCK_CONST_METHOD1(
+      verifyFuture,
+      folly::Future<folly::Unit>(
+          const std::vector<std::shared_ptr<const PeerCert>>&));
+
+  MOCK_CONST_METHOD0(getCertificateRequestExtensions, std::vector<Extension>());
+};
+
+class MockCertificateCompressor : public CertificateCompressor {
+ public:
+  MOCK_CONST_METHOD0(getAlgorithm, CertificateCompressionAlgorithm());
+
+  MOCK_METHOD1(_compress, CompressedCertificate(CertificateMsg&));
+  CompressedCertificate compress(CertificateMsg cert) override {
+    return _compress(cert);
+  }
+};
+
+class MockCertificateDecompressor : public CertificateDecompressor {
+ public:
+  MOCK_CONST_METHOD0(getAlgorithm, CertificateCompressionAlgorithm());
+  MOCK_METHOD1(decompress, CertificateMsg(const CompressedCertificate&));
+};
+
+class MockHandshakeTracer : public HandshakeTracer {
+ public:
+  MOCK_METHOD4(
+      stateTransition,
+      void(
+          uint64_t,
+          Clock::time_point,
+          folly::StringPiece,
+          folly::StringPiece));
+  MOCK_METHOD3(
+      asyncStepStarted,
+      void(uint64_t, Clock::time_point, HandshakeStep));
+  MOCK_METHOD3(
+      asyncStepFinished,
+      void(uint64_t, Clock::time_point, HandshakeStep));
+};
+
 class MockFactory : public Factory {
  public:
   MOCK_CONST_METHOD0(
@@ -141,21 +220,21 @@ class MockFactory : public Factory {
   MOCK_CONST_METHOD0(
       makePlaintextWriteRecordLayer,
       std::unique_ptr<PlaintextWriteRecordLayer>());
-  MOCK_CONST_METHOD0(
+  MOCK_CONST_METHOD1(
       makeEncryptedReadRecordLayer,
-      std::unique_ptr<EncryptedReadRecordLayer>());
-  MOCK_CONST_METHOD0(
+      std::unique_ptr<EncryptedReadRecordLayer>(EncryptionLevel));
+  MOCK_CONST_METHOD1(
       makeEncryptedWriteRecordLayer,
-      std::unique_ptr<EncryptedWriteRecordLayer>());
+      std::unique_ptr<EncryptedWriteRecordLayer>(EncryptionLevel));
   MOCK_CONST_METHOD1(
       makeKeyScheduler,
       std::unique_ptr<KeyScheduler>(CipherSuite cipher));
   MOCK_CONST_METHOD1(
       makeHandshakeContext,
       std::unique_ptr<HandshakeContext>(CipherSuite cipher));
-  MOCK_CONST_METHOD1(
+  MOCK_CONST_METHOD2(
       makeKeyExchange,
-      std::unique_ptr<KeyExchange>(NamedGroup group));
+      std::unique_ptr<KeyExchange>(NamedGroup group, KeyExchangeMode mode));
   MOCK_CONST_METHOD1(makeAead, std::unique_ptr<Aead>(CipherSuite cipher));
   MOCK_CONST_METHOD0(makeRandom, Random());
   MOCK_CONST_METHOD0(makeTicketAgeAdd, uint32_t());
@@ -165,6 +244,13 @@ class MockFactory : public Factory {
     return _makePeerCert(certData);
   }
 
+  MOCK_CONST_METHOD1(
+      _makeRawPublicKeyPeerCert,
+      std::shared_ptr<PeerCert>(Buf&));
+  std::shared_ptr<PeerCert> makeRawPublicKeyPeerCert(Buf spki) const override {
+    return _makeRawPublicKeyPeerCert(spki);
+  }
+
   void setDefaults() {
     ON_CALL(*this, makePlaintextReadRecordLayer())
         .WillByDefault(InvokeWithoutArgs(
@@ -176,13 +262,14 @@ class MockFactory : public Factory {
           ret->setDefaults();
           return ret;
         }));
-    ON_CALL(*this, makeEncryptedReadRecordLayer())
-        .WillByDefault(InvokeWithoutArgs(
-            []() { return std::make_unique<MockEncryptedReadRecordLayer>(); }));
+    ON_CALL(*this, makeEncryptedReadRecordLayer(_))
+        .WillByDefault(Invoke([](EncryptionLevel level) {
+          return std::make_unique<MockEncryptedReadRecordLayer>(level);
+        }));
 
-    ON_CALL(*this, makeEncryptedWriteRecordLayer())
-        .WillByDefault(InvokeWithoutArgs([]() {
-          auto ret = std::make_unique<MockEncryptedWriteRecordLayer>();
+    ON_CALL(*this, makeEncryptedWriteRecordLayer(_))
+        .WillByDefault(Invoke([](EncryptionLevel level) {
+          auto ret = std::make_unique<MockEncryptedWriteRecordLayer>(level);
           ret->setDefaults();
           return ret;
         }));
@@ -198,7 +285,7 @@ class MockFactory : public Factory {
           ret->setDefaults();
           return ret;
         }));
-    ON_CALL(*this, makeKeyExchange(_)).WillByDefault(InvokeWithoutArgs([]() {
+    ON_CALL(*this, makeKeyExchange(_, _)).WillByDefault(InvokeWithoutArgs([]() {
       auto ret = std::make_unique<MockKeyExchange>();
       ret->setDefaults();
       return ret;
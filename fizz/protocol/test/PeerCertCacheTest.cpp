@@ -0,0 +1,49 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/PeerCertCache.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+TEST(PeerCertCacheTest, TestSameCertShared) {
+  PeerCertCache cache(10);
+  auto cert1 = cache.getPeerCert(getCertData(kP256Certificate));
+  auto cert2 = cache.getPeerCert(getCertData(kP256Certificate));
+  EXPECT_EQ(cert1, cert2);
+  EXPECT_EQ(cache.size(), 1);
+
+  auto cert3 = cache.getPeerCert(getCertData(kRSACertificate));
+  EXPECT_NE(cert1, cert3);
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cert1->getIdentity(), "Fizz");
+}
+
+TEST(PeerCertCacheTest, TestEviction) {
+  PeerCertCache cache(1);
+  auto cert1 = cache.getPeerCert(getCertData(kP256Certificate));
+  cache.getPeerCert(getCertData(kRSACertificate));
+  EXPECT_EQ(cache.size(), 1);
+  auto cert2 = cache.getPeerCert(getCertData(kP256Certificate));
+  EXPECT_NE(cert1, cert2);
+}
+
+TEST(PeerCertCacheTest, TestBadCert) {
+  PeerCertCache cache(10);
+  EXPECT_THROW(
+      cache.getPeerCert(IOBuf::copyBuffer("notacert")), std::runtime_error);
+  EXPECT_EQ(cache.size(), 0);
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,60 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/PinnedKeyVerifier.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+class PinnedKeyVerifierTest : public Test {
+ public:
+  void SetUp() override {
+    auto selfCert = CertUtils::makeRawPublicKeySelfCert(kP256Key.str(), "id");
+    auto msg = selfCert->getCertMessage();
+    rawKey_ = CertUtils::makeRawPublicKeyPeerCert(
+        std::move(msg.certificate_list.front().cert_data));
+  }
+
+ protected:
+  std::shared_ptr<const PeerCert> rawKey_;
+};
+
+TEST_F(PinnedKeyVerifierTest, TestPinned) {
+  PinnedKeyVerifier verifier({rawKey_->getIdentity()});
+  verifier.verify({rawKey_});
+}
+
+TEST_F(PinnedKeyVerifierTest, TestNotPinned) {
+  PinnedKeyVerifier verifier({std::string(64, '0')});
+  EXPECT_THROW(verifier.verify({rawKey_}), std::runtime_error);
+}
+
+TEST_F(PinnedKeyVerifierTest, TestNoKeys) {
+  PinnedKeyVerifier verifier({rawKey_->getIdentity()});
+  EXPECT_THROW(verifier.verify({}), std::runtime_error);
+}
+
+TEST_F(PinnedKeyVerifierTest, TestMultipleKeys) {
+  PinnedKeyVerifier verifier({rawKey_->getIdentity()});
+  EXPECT_THROW(verifier.verify({rawKey_, rawKey_}), std::runtime_error);
+}
+
+TEST_F(PinnedKeyVerifierTest, TestX509Rejected) {
+  std::shared_ptr<const PeerCert> cert =
+      CertUtils::makePeerCert(getCertData(kP256Certificate));
+  PinnedKeyVerifier verifier({rawKey_->getIdentity()});
+  EXPECT_THROW(verifier.verify({cert}), std::runtime_error);
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/ProfileFactory.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+namespace {
+struct TwoEntryProfile {
+  using Ciphers = ProfileCiphers<
+      CipherSuite::TLS_AES_128_GCM_SHA256,
+      CipherSuite::TLS_AES_256_GCM_SHA384>;
+  using Groups = ProfileGroups<NamedGroup::secp256r1, NamedGroup::x25519>;
+};
+
+class EngineFactory : public ProfileFactory<MinimalProfile> {
+ public:
+  MOCK_CONST_METHOD0(getEngine, ENGINE*());
+};
+} // namespace
+
+TEST(ProfileFactoryTest, TestMinimalProfile) {
+  ProfileFactory<MinimalProfile> factory;
+  EXPECT_EQ(
+      ProfileFactory<MinimalProfile>::cipherSuites(),
+      std::vector<CipherSuite>({CipherSuite::TLS_AES_128_GCM_SHA256}));
+  EXPECT_EQ(
+      ProfileFactory<MinimalProfile>::namedGroups(),
+      std::vector<NamedGroup>({NamedGroup::x25519}));
+
+  auto aead = factory.makeAead(CipherSuite::TLS_AES_128_GCM_SHA256);
+  EXPECT_EQ(aead->keyLength(), AESGCM128::kKeyLength);
+  auto deriver = factory.makeKeyDeriver(CipherSuite::TLS_AES_128_GCM_SHA256);
+  EXPECT_EQ(deriver->hashLength(), Sha256::HashLen);
+  auto context =
+      factory.makeHandshakeContext(CipherSuite::TLS_AES_128_GCM_SHA256);
+  EXPECT_EQ(
+      context->getHandshakeContext()->computeChainDataLength(),
+      Sha256::HashLen);
+  auto kex = factory.makeKeyExchange(
+      NamedGroup::x25519, Factory::KeyExchangeMode::Client);
+  EXPECT_NE(dynamic_cast<X25519KeyExchange*>(kex.get()), nullptr);
+}
+
+TEST(ProfileFactoryTest, TestNotInProfile) {
+  ProfileFactory<MinimalProfile> factory;
+  EXPECT_THROW(
+      factory.makeAead(CipherSuite::TLS_AES_256_GCM_SHA384),
+      std::runtime_error);
+  EXPECT_THROW(
+      factory.makeKeyDeriver(CipherSuite::TLS_AES_256_GCM_SHA384),
+      std::runtime_error);
+  EXPECT_THROW(
+      factory.makeHandshakeContext(CipherSuite::TLS_AES_256_GCM_SHA384),
+      std::runtime_error);
+  EXPECT_THROW(
+      factory.makeKeyExchange(
+          NamedGroup::secp256r1, Factory::KeyExchangeMode::Client),
+      std::runtime_error);
+}
+
+TEST(ProfileFactoryTest, TestMultipleEntries) {
+  ProfileFactory<TwoEntryProfile> factory;
+  EXPECT_EQ(
+      ProfileFactory<TwoEntryProfile>::cipherSuites(),
+      std::vector<CipherSuite>({CipherSuite::TLS_AES_128_GCM_SHA256,
+                                CipherSuite::TLS_AES_256_GCM_SHA384}));
+  EXPECT_EQ(
+      ProfileFactory<TwoEntryProfile>::namedGroups(),
+      std::vector<NamedGroup>({NamedGroup::secp256r1, NamedGroup::x25519}));
+
+  auto aead = factory.makeAead(CipherSuite::TLS_AES_256_GCM_SHA384);
+  EXPECT_EQ(aead->keyLength(), AESGCM256::kKeyLength);
+  auto deriver = factory.makeKeyDeriver(CipherSuite::TLS_AES_256_GCM_SHA384);
+  EXPECT_EQ(deriver->hashLength(), Sha384::HashLen);
+  auto kex = factory.makeKeyExchange(
+      NamedGroup::secp256r1, Factory::KeyExchangeMode::Client);
+  EXPECT_NE(dynamic_cast<OpenSSLKeyExchange<P256>*>(kex.get()), nullptr);
+  EXPECT_THROW(
+      factory.makeAead(CipherSuite::TLS_CHACHA20_POLY1305_SHA256),
+      std::runtime_error);
+}
+TEST(ProfileFactoryTest, TestUsesEngine) {
+  EngineFactory factory;
+  EXPECT_CALL(factory, getEngine()).Times(AtLeast(1));
+  factory.makeAead(CipherSuite::TLS_AES_128_GCM_SHA256);
+}
+} // namespace test
+} // namespace fizz
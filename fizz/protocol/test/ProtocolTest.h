@@ -123,10 +123,10 @@ class ProtocolTest : public testing::Test {
       MockAead** readAead,
       folly::Optional<bool> skipFailedDecryption = folly::none,
       Sequence* s = nullptr) {
-    EXPECT_CALL(*factory_, makeEncryptedReadRecordLayer())
+    EXPECT_CALL(*factory_, makeEncryptedReadRecordLayer(_))
         .InSequence(s ? *s : Sequence())
-        .WillOnce(Invoke([=]() {
-          auto ret = std::make_unique<MockEncryptedReadRecordLayer>();
+        .WillOnce(Invoke([=](EncryptionLevel level) {
+          auto ret = std::make_unique<MockEncryptedReadRecordLayer>(level);
           *recordLayer = ret.get();
           EXPECT_CALL(*ret, _setAead(_)).WillOnce(Invoke([=](Aead* aead) {
             EXPECT_EQ(aead, *readAead);
@@ -143,10 +143,10 @@ class ProtocolTest : public testing::Test {
       MockAead** writeAead,
       Buf (*expectedWrite)(TLSMessage&) = nullptr,
       Sequence* s = nullptr) {
-    EXPECT_CALL(*factory_, makeEncryptedWriteRecordLayer())
+    EXPECT_CALL(*factory_, makeEncryptedWriteRecordLayer(_))
         .InSequence(s ? *s : Sequence())
-        .WillOnce(Invoke([=]() {
-          auto ret = std::make_unique<MockEncryptedWriteRecordLayer>();
+        .WillOnce(Invoke([=](EncryptionLevel level) {
+          auto ret = std::make_unique<MockEncryptedWriteRecordLayer>(level);
           ret->setDefaults();
           *recordLayer = ret.get();
           EXPECT_CALL(*ret, _setAead(_)).WillOnce(Invoke([=](Aead* aead) {
@@ -0,0 +1,76 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/RingQueue.h>
+
+namespace fizz {
+namespace test {
+
+TEST(RingQueueTest, TestInline) {
+  RingQueue<int, 4> queue;
+  EXPECT_TRUE(queue.empty());
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 3; ++i) {
+      queue.push_back(i);
+    }
+    EXPECT_EQ(queue.size(), 3);
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_EQ(queue.front(), i);
+      queue.pop_front();
+    }
+    EXPECT_TRUE(queue.empty());
+  }
+  EXPECT_EQ(queue.capacity(), 4);
+}
+
+TEST(RingQueueTest, TestWrapAround) {
+  RingQueue<int, 4> queue;
+  queue.push_back(0);
+  queue.push_back(1);
+  queue.push_back(2);
+  queue.pop_front();
+  queue.push_back(3);
+  queue.push_back(4);
+  EXPECT_EQ(queue.capacity(), 4);
+  for (int i = 1; i <= 4; ++i) {
+    EXPECT_EQ(queue.front(), i);
+    queue.pop_front();
+  }
+}
+
+TEST(RingQueueTest, TestGrow) {
+  RingQueue<std::unique_ptr<int>, 2> queue;
+  queue.push_back(std::make_unique<int>(0));
+  queue.push_back(std::make_unique<int>(1));
+  queue.pop_front();
+  for (int i = 2; i < 10; ++i) {
+    queue.push_back(std::make_unique<int>(i));
+  }
+  EXPECT_EQ(queue.size(), 9);
+  EXPECT_GE(queue.capacity(), 9);
+  for (int i = 1; i < 10; ++i) {
+    EXPECT_EQ(*queue.front(), i);
+    queue.pop_front();
+  }
+}
+
+TEST(RingQueueTest, TestDestroysElements) {
+  auto counter = std::make_shared<int>(0);
+  {
+    RingQueue<std::shared_ptr<int>, 2> queue;
+    for (int i = 0; i < 5; ++i) {
+      queue.push_back(counter);
+    }
+    EXPECT_EQ(counter.use_count(), 6);
+  }
+  EXPECT_EQ(counter.use_count(), 1);
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/TLSHistograms.h>
+
+#include <limits>
+#include <thread>
+
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+static TLSHistograms::Snapshot getAggregate(const TLSHistogramKey& key) {
+  for (auto& entry : TLSHistograms::getAggregate()) {
+    if (entry.first == key) {
+      return entry.second;
+    }
+  }
+  return TLSHistograms::Snapshot();
+}
+
+static const HistogramSnapshot& get(
+    const TLSHistograms::Snapshot& snapshot,
+    TLSHistogram histogram) {
+  return snapshot[static_cast<size_t>(histogram)];
+}
+
+TEST(TLSHistogramsTest, TestBuckets) {
+  for (uint64_t value : {0, 1, 7, 8, 9, 15, 16, 17, 1000, 123456789}) {
+    auto index = HistogramSnapshot::bucketIndex(value);
+    auto lower = HistogramSnapshot::bucketLowerBound(index);
+    EXPECT_LE(lower, value);
+    EXPECT_GE(lower, value - value / HistogramSnapshot::kSubBuckets);
+    EXPECT_GT(HistogramSnapshot::bucketLowerBound(index + 1), value);
+  }
+  EXPECT_EQ(
+      HistogramSnapshot::bucketIndex(HistogramSnapshot::kMaxValue - 1),
+      HistogramSnapshot::kNumBuckets - 1);
+  EXPECT_EQ(
+      HistogramSnapshot::bucketIndex(std::numeric_limits<uint64_t>::max()),
+      HistogramSnapshot::kNumBuckets - 1);
+}
+
+TEST(TLSHistogramsTest, TestPercentile) {
+  HistogramSnapshot snapshot;
+  EXPECT_EQ(snapshot.percentile(50), 0);
+  for (uint64_t value = 1; value <= 100; ++value) {
+    snapshot.buckets[HistogramSnapshot::bucketIndex(value)]++;
+    snapshot.count++;
+  }
+  EXPECT_EQ(snapshot.percentile(0), 1);
+  EXPECT_EQ(snapshot.percentile(5), 5);
+  EXPECT_EQ(snapshot.percentile(100), 96);
+}
+
+TEST(TLSHistogramsTest, TestAggregateByKey) {
+  TLSHistogramKey key;
+  key.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+  key.group = NamedGroup::x25519;
+  key.pskType = PskType::NotAttempted;
+  key.alpn = std::string("TestAggregateByKey");
+  auto otherKey = key;
+  otherKey.pskType = PskType::Resumption;
+
+  TLSHistograms::record(key, TLSHistogram::HandshakeNanos, 100);
+  std::thread([&] {
+    TLSHistograms::record(key, TLSHistogram::HandshakeNanos, 300);
+    TLSHistograms::record(otherKey, TLSHistogram::SignNanos, 5);
+  }).join();
+
+  auto snapshot = getAggregate(key);
+  EXPECT_EQ(get(snapshot, TLSHistogram::HandshakeNanos).count, 2);
+  EXPECT_EQ(get(snapshot, TLSHistogram::HandshakeNanos).sum, 400);
+  EXPECT_EQ(get(snapshot, TLSHistogram::SignNanos).count, 0);
+
+  auto otherSnapshot = getAggregate(otherKey);
+  EXPECT_EQ(get(otherSnapshot, TLSHistogram::HandshakeNanos).count, 0);
+  EXPECT_EQ(get(otherSnapshot, TLSHistogram::SignNanos).count, 1);
+}
+
+TEST(TLSHistogramsTest, TestHandshakeTimings) {
+  TLSHistogramKey key;
+  key.alpn = std::string("TestHandshakeTimings");
+  HandshakeTimings timings(nullptr);
+  auto start = HandshakeTracer::Clock::now();
+  timings.asyncStepStarted(1, start, HandshakeStep::Sign);
+  timings.asyncStepFinished(
+      1, start + std::chrono::microseconds(10), HandshakeStep::Sign);
+  timings.record(key);
+
+  auto snapshot = getAggregate(key);
+  EXPECT_EQ(get(snapshot, TLSHistogram::HandshakeNanos).count, 1);
+  EXPECT_EQ(get(snapshot, TLSHistogram::SignNanos).count, 1);
+  EXPECT_EQ(get(snapshot, TLSHistogram::SignNanos).sum, 10000);
+  EXPECT_EQ(get(snapshot, TLSHistogram::TicketDecryptNanos).count, 0);
+}
+} // namespace test
+} // namespace fizz
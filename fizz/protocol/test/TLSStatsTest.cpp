@@ -0,0 +1,89 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/TLSStats.h>
+
+#include <limits>
+#include <thread>
+
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+TEST(TLSStatsTest, TestAdd) {
+  auto before = TLSStats::getThreadSnapshot();
+  TLSStats::add(TLSCounter::RecordsEncrypted, 1);
+  TLSStats::add(TLSCounter::BytesEncrypted, 100);
+  TLSStats::add(TLSCounter::BytesEncrypted, 50);
+  auto after = TLSStats::getThreadSnapshot();
+  EXPECT_EQ(
+      after.get(TLSCounter::RecordsEncrypted),
+      before.get(TLSCounter::RecordsEncrypted) + 1);
+  EXPECT_EQ(
+      after.get(TLSCounter::BytesEncrypted),
+      before.get(TLSCounter::BytesEncrypted) + 150);
+  EXPECT_EQ(
+      after.get(TLSCounter::RecordsDecrypted),
+      before.get(TLSCounter::RecordsDecrypted));
+}
+
+TEST(TLSStatsTest, TestHighWatermark) {
+  auto base = TLSStats::getThreadSnapshot().get(TLSHighWatermark::WriteBuffer);
+  TLSStats::updateHighWatermark(TLSHighWatermark::WriteBuffer, base + 10);
+  TLSStats::updateHighWatermark(TLSHighWatermark::WriteBuffer, base + 5);
+  EXPECT_EQ(
+      TLSStats::getThreadSnapshot().get(TLSHighWatermark::WriteBuffer),
+      base + 10);
+}
+
+TEST(TLSStatsTest, TestTimerDisabled) {
+  TLSStats::setTimingEnabled(false);
+  auto before = TLSStats::getThreadSnapshot().get(TLSCounter::SignNanos);
+  {
+    TLSStats::Timer timer(TLSCounter::SignNanos);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(TLSStats::getThreadSnapshot().get(TLSCounter::SignNanos), before);
+}
+
+TEST(TLSStatsTest, TestTimerEnabled) {
+  TLSStats::setTimingEnabled(true);
+  auto before = TLSStats::getThreadSnapshot().get(TLSCounter::SignNanos);
+  {
+    TLSStats::Timer timer(TLSCounter::SignNanos);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  TLSStats::setTimingEnabled(false);
+  EXPECT_GE(
+      TLSStats::getThreadSnapshot().get(TLSCounter::SignNanos),
+      before + 1000000);
+}
+
+TEST(TLSStatsTest, TestAggregate) {
+  auto before = TLSStats::getAggregate();
+  TLSStats::add(TLSCounter::TicketNanos, 1);
+  std::thread([] {
+    TLSStats::add(TLSCounter::TicketNanos, 2);
+    TLSStats::updateHighWatermark(
+        TLSHighWatermark::AppDataBuffer,
+        std::numeric_limits<uint64_t>::max());
+    EXPECT_EQ(TLSStats::getThreadSnapshot().get(TLSCounter::TicketNanos), 2);
+  }).join();
+  auto after = TLSStats::getAggregate();
+  EXPECT_EQ(
+      after.get(TLSCounter::TicketNanos),
+      before.get(TLSCounter::TicketNanos) + 3);
+  EXPECT_EQ(
+      after.get(TLSHighWatermark::AppDataBuffer),
+      std::numeric_limits<uint64_t>::max());
+}
+} // namespace test
+} // namespace fizz
@@ -162,6 +162,15 @@ struct TestMessages {
     return certificate;
   }
 
+  static CompressedCertificate compressedCertificate() {
+    CompressedCertificate cc;
+    cc.algorithm = CertificateCompressionAlgorithm::zstd;
+    cc.uncompressed_length = 20;
+    cc.compressed_certificate_message = folly::IOBuf::copyBuffer("compressed");
+    cc.originalEncoding = folly::IOBuf::copyBuffer("compcertencoding");
+    return cc;
+  }
+
   static CertificateVerify certificateVerify() {
     CertificateVerify verify;
     verify.algorithm = SignatureScheme::ecdsa_secp256r1_sha256;
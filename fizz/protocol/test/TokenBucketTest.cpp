@@ -0,0 +1,52 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/TokenBucket.h>
+
+using namespace std::chrono;
+
+namespace fizz {
+namespace test {
+
+TEST(TokenBucketTest, TestStartsFull) {
+  auto now = TokenBucket::Clock::now();
+  TokenBucket bucket(1000, 100, now);
+  EXPECT_EQ(bucket.available(now), 100);
+  EXPECT_EQ(bucket.timeUntil(100, now), nanoseconds(0));
+}
+
+TEST(TokenBucketTest, TestRefill) {
+  auto now = TokenBucket::Clock::now();
+  TokenBucket bucket(1000, 100, now);
+  bucket.consume(100);
+  EXPECT_EQ(bucket.available(now), 0);
+  EXPECT_EQ(bucket.available(now + milliseconds(50)), 50);
+  EXPECT_EQ(bucket.available(now + seconds(10)), 100);
+}
+
+TEST(TokenBucketTest, TestTimeUntil) {
+  auto now = TokenBucket::Clock::now();
+  TokenBucket bucket(1000, 100, now);
+  bucket.consume(80);
+  auto wait = bucket.timeUntil(50, now);
+  EXPECT_GT(wait, milliseconds(29));
+  EXPECT_LE(wait, milliseconds(31));
+  EXPECT_GE(bucket.available(now + wait), 50);
+}
+
+TEST(TokenBucketTest, TestClockGoingBack) {
+  auto now = TokenBucket::Clock::now();
+  TokenBucket bucket(1000, 100, now);
+  bucket.consume(100);
+  EXPECT_EQ(bucket.available(now - seconds(1)), 0);
+  EXPECT_EQ(bucket.available(now + milliseconds(10)), 10);
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,160 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/record/ClientHelloCheck.h>
+
+namespace fizz {
+
+namespace {
+
+constexpr size_t kMaxSessionIdLength = 32;
+
+[[noreturn]] void fail(const char* msg) {
+  throw FizzException(msg, AlertDescription::decode_error);
+}
+
+class Checker {
+ public:
+  explicit Checker(const folly::IOBuf& body) : cursor_(&body) {}
+
+  void need(size_t length) {
+    if (!cursor_.canAdvance(length)) {
+      fail("truncated client hello");
+    }
+  }
+
+  template <class T>
+  T read() {
+    need(sizeof(T));
+    return cursor_.readBE<T>();
+  }
+
+  void skip(size_t length) {
+    need(length);
+    cursor_.skip(length);
+  }
+
+  size_t remaining() {
+    return cursor_.totalLength();
+  }
+
+  bool isAtEnd() {
+    return cursor_.isAtEnd();
+  }
+
+ private:
+  folly::io::Cursor cursor_;
+};
+} // namespace
+
+void checkClientHello(
+    const folly::IOBuf& body,
+    const ClientHelloLimits& limits) {
+  Checker checker(body);
+  checker.skip(sizeof(ProtocolVersion) + sizeof(Random));
+
+  auto sessionIdLength = checker.read<uint8_t>();
+  if (sessionIdLength > kMaxSessionIdLength) {
+    fail("session id too long");
+  }
+  checker.skip(sessionIdLength);
+
+  auto ciphersLength = checker.read<uint16_t>();
+  if (ciphersLength % sizeof(CipherSuite) != 0) {
+    fail("odd cipher suites length");
+  }
+  if (ciphersLength / sizeof(CipherSuite) > limits.maxCipherSuites) {
+    fail("too many cipher suites");
+  }
+  checker.skip(ciphersLength);
+
+  auto compressionLength = checker.read<uint8_t>();
+  checker.skip(compressionLength);
+
+  // Extensions may be omitted before TLS 1.3.
+  if (checker.isAtEnd()) {
+    return;
+  }
+
+  size_t extensionsLength = checker.read<uint16_t>();
+  if (extensionsLength != checker.remaining()) {
+    fail("extensions length mismatch");
+  }
+
+  size_t extensions = 0;
+  while (!checker.isAtEnd()) {
+    if (++extensions > limits.maxExtensions) {
+      fail("too many extensions");
+    }
+    auto type = static_cast<ExtensionType>(checker.read<uint16_t>());
+    size_t extLength = checker.read<uint16_t>();
+    checker.need(extLength);
+    switch (type) {
+      case ExtensionType::key_share:
+      case ExtensionType::key_share_old: {
+        if (extLength < sizeof(uint16_t)) {
+          fail("extension too short");
+        }
+        size_t listLength = checker.read<uint16_t>();
+        if (listLength != extLength - sizeof(uint16_t)) {
+          fail("key share length mismatch");
+        }
+        size_t shares = 0;
+        while (listLength > 0) {
+          if (++shares > limits.maxKeyShares) {
+            fail("too many key shares");
+          }
+          if (listLength < sizeof(NamedGroup) + sizeof(uint16_t)) {
+            fail("truncated key share");
+          }
+          checker.skip(sizeof(NamedGroup));
+          size_t shareLength = checker.read<uint16_t>();
+          listLength -= sizeof(NamedGroup) + sizeof(uint16_t);
+          if (shareLength > listLength) {
+            fail("key share longer than list");
+          }
+          checker.skip(shareLength);
+          listLength -= shareLength;
+        }
+        break;
+      }
+      case ExtensionType::pre_shared_key: {
+        // Only the identities are counted, the binders follow them.
+        if (extLength < sizeof(uint16_t)) {
+          fail("extension too short");
+        }
+        size_t listLength = checker.read<uint16_t>();
+        if (listLength > extLength - sizeof(uint16_t)) {
+          fail("psk identities longer than extension");
+        }
+        size_t bindersLength = extLength - sizeof(uint16_t) - listLength;
+        size_t identities = 0;
+        while (listLength > 0) {
+          if (++identities > limits.maxPskIdentities) {
+            fail("too many psk identities");
+          }
+          if (listLength < sizeof(uint16_t)) {
+            fail("truncated psk identity");
+          }
+          size_t identityLength = checker.read<uint16_t>();
+          listLength -= sizeof(uint16_t);
+          if (identityLength + sizeof(uint32_t) > listLength) {
+            fail("psk identity longer than list");
+          }
+          checker.skip(identityLength + sizeof(uint32_t));
+          listLength -= identityLength + sizeof(uint32_t);
+        }
+        checker.skip(bindersLength);
+        break;
+      }
+      default:
+        checker.skip(extLength);
+    }
+  }
+}
+} // namespace fizz
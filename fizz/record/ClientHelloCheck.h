@@ -0,0 +1,39 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/record/Types.h>
+
+namespace fizz {
+
+/**
+ * Caps on the number of elements a ClientHello may carry. Real clients send
+ * a few dozen of each; hostile ones send thousands to make parsing expensive.
+ */
+struct ClientHelloLimits {
+  size_t maxCipherSuites{128};
+  size_t maxExtensions{64};
+  size_t maxKeyShares{8};
+  size_t maxPskIdentities{8};
+};
+
+/**
+ * Checks the structure of an encoded ClientHello body (without the handshake
+ * header) in a single pass, without allocating. Throws a FizzException with
+ * decode_error if it is malformed or over the limits, in which case it should
+ * not be decoded.
+ *
+ * Only the framing (lengths of vectors and extensions, and the key share and
+ * pre_shared_key lists) is checked, everything else is left to decode() and
+ * the handshake.
+ */
+void checkClientHello(
+    const folly::IOBuf& body,
+    const ClientHelloLimits& limits);
+} // namespace fizz
@@ -0,0 +1,227 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/record/ClientHelloInspector.h>
+
+#include <folly/lang/Bits.h>
+
+namespace fizz {
+
+namespace {
+
+constexpr size_t kRecordHeaderSize =
+    sizeof(ContentType) + sizeof(ProtocolVersion) + sizeof(uint16_t);
+constexpr size_t kHandshakeHeaderSize = sizeof(HandshakeType) + 3;
+constexpr size_t kMaxRecordLength = 0x4000;
+
+class Reader {
+ public:
+  explicit Reader(folly::ByteRange data) : data_(data) {}
+
+  template <class T>
+  bool read(T& out) {
+    if (data_.size() < sizeof(T)) {
+      return false;
+    }
+    out = folly::Endian::big(folly::loadUnaligned<T>(data_.data()));
+    data_.advance(sizeof(T));
+    return true;
+  }
+
+  bool readBits24(size_t& out) {
+    if (data_.size() < 3) {
+      return false;
+    }
+    out = (static_cast<size_t>(data_[0]) << 16) |
+        (static_cast<size_t>(data_[1]) << 8) | data_[2];
+    data_.advance(3);
+    return true;
+  }
+
+  bool take(size_t length, folly::ByteRange& out) {
+    if (data_.size() < length) {
+      return false;
+    }
+    out = data_.subpiece(0, length);
+    data_.advance(length);
+    return true;
+  }
+
+  template <class Length>
+  bool takeVector(folly::ByteRange& out) {
+    Length length;
+    return read(length) && take(length, out);
+  }
+
+  bool skip(size_t length) {
+    folly::ByteRange skipped;
+    return take(length, skipped);
+  }
+
+  bool empty() const {
+    return data_.empty();
+  }
+
+ private:
+  folly::ByteRange data_;
+};
+
+bool readServerName(folly::ByteRange ext, folly::ByteRange& serverName) {
+  Reader reader(ext);
+  folly::ByteRange list;
+  if (!reader.takeVector<uint16_t>(list) || !reader.empty()) {
+    return false;
+  }
+  Reader entries(list);
+  while (!entries.empty()) {
+    uint8_t type;
+    folly::ByteRange name;
+    if (!entries.read(type) || !entries.takeVector<uint16_t>(name)) {
+      return false;
+    }
+    if (static_cast<ServerNameType>(type) == ServerNameType::host_name &&
+        serverName.empty()) {
+      serverName = name;
+    }
+  }
+  return true;
+}
+
+bool readExtensions(folly::ByteRange extensions, ClientHelloInfo& info) {
+  Reader reader(extensions);
+  while (!reader.empty()) {
+    uint16_t type;
+    folly::ByteRange ext;
+    if (!reader.read(type) || !reader.takeVector<uint16_t>(ext)) {
+      return false;
+    }
+    switch (static_cast<ExtensionType>(type)) {
+      case ExtensionType::server_name:
+      case ExtensionType::alternate_server_name:
+        if (!readServerName(ext, info.serverName)) {
+          return false;
+        }
+        break;
+      case ExtensionType::application_layer_protocol_negotiation: {
+        Reader alpn(ext);
+        if (!alpn.takeVector<uint16_t>(info.alpnProtocols) || !alpn.empty()) {
+          return false;
+        }
+        break;
+      }
+      case ExtensionType::supported_versions: {
+        Reader versions(ext);
+        if (!versions.takeVector<uint8_t>(info.supportedVersions) ||
+            !versions.empty() ||
+            info.supportedVersions.size() % sizeof(ProtocolVersion) != 0) {
+          return false;
+        }
+        break;
+      }
+      case ExtensionType::pre_shared_key:
+        info.hasPsk = true;
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+} // namespace
+
+bool ClientHelloInfo::offersAlpn(folly::StringPiece protocol) const {
+  Reader reader(alpnProtocols);
+  while (!reader.empty()) {
+    folly::ByteRange name;
+    if (!reader.takeVector<uint8_t>(name)) {
+      return false;
+    }
+    if (folly::StringPiece(name) == protocol) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ClientHelloInfo::supportsVersion(ProtocolVersion version) const {
+  Reader reader(supportedVersions);
+  uint16_t offered;
+  while (reader.read(offered)) {
+    if (static_cast<ProtocolVersion>(offered) == version) {
+      return true;
+    }
+  }
+  return false;
+}
+
+ClientHelloInspection inspectClientHello(
+    folly::ByteRange data,
+    ClientHelloInfo& info) {
+  info = ClientHelloInfo();
+  if (!data.empty() &&
+      static_cast<ContentType>(data[0]) != ContentType::handshake) {
+    return ClientHelloInspection::Invalid;
+  }
+  if (data.size() > kRecordHeaderSize &&
+      static_cast<HandshakeType>(data[kRecordHeaderSize]) !=
+          HandshakeType::client_hello) {
+    return ClientHelloInspection::Invalid;
+  }
+
+  Reader record(data);
+  uint8_t type;
+  uint16_t recordVersion;
+  uint16_t recordLength;
+  if (!record.read(type) || !record.read(recordVersion) ||
+      !record.read(recordLength)) {
+    return ClientHelloInspection::NeedMoreData;
+  }
+  if ((recordVersion >> 8) != 0x03 || recordLength > kMaxRecordLength ||
+      recordLength < kHandshakeHeaderSize) {
+    return ClientHelloInspection::Invalid;
+  }
+  folly::ByteRange fragment;
+  if (!record.take(recordLength, fragment)) {
+    return ClientHelloInspection::NeedMoreData;
+  }
+
+  Reader handshake(fragment);
+  uint8_t handshakeType;
+  size_t helloLength;
+  folly::ByteRange hello;
+  handshake.read(handshakeType);
+  handshake.readBits24(helloLength);
+  if (!handshake.take(helloLength, hello)) {
+    // The hello continues in the next record.
+    return ClientHelloInspection::Invalid;
+  }
+
+  Reader reader(hello);
+  uint16_t legacyVersion;
+  folly::ByteRange skipped;
+  if (!reader.read(legacyVersion) || !reader.skip(sizeof(Random)) ||
+      !reader.takeVector<uint8_t>(skipped) ||
+      !reader.takeVector<uint16_t>(skipped) ||
+      !reader.takeVector<uint8_t>(skipped)) {
+    return ClientHelloInspection::Invalid;
+  }
+  info.legacyVersion = static_cast<ProtocolVersion>(legacyVersion);
+
+  // Extensions may be omitted before TLS 1.3.
+  if (reader.empty()) {
+    return ClientHelloInspection::Done;
+  }
+  folly::ByteRange extensions;
+  if (!reader.takeVector<uint16_t>(extensions) || !reader.empty() ||
+      !readExtensions(extensions, info)) {
+    info = ClientHelloInfo();
+    return ClientHelloInspection::Invalid;
+  }
+  return ClientHelloInspection::Done;
+}
+} // namespace fizz
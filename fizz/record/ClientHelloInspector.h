@@ -0,0 +1,61 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/record/Types.h>
+#include <folly/Range.h>
+
+namespace fizz {
+
+/**
+ * What inspectClientHello() found in a ClientHello. The ranges point into the
+ * inspected data and are empty if the extension was absent.
+ */
+struct ClientHelloInfo {
+  ProtocolVersion legacyVersion{ProtocolVersion::tls_1_0};
+
+  // First host_name entry of the server_name extension.
+  folly::ByteRange serverName;
+
+  // Body of the ALPN protocol_name_list: each name prefixed by its length.
+  folly::ByteRange alpnProtocols;
+
+  // Body of the supported_versions list: 2 byte versions.
+  folly::ByteRange supportedVersions;
+
+  bool hasPsk{false};
+
+  bool offersAlpn(folly::StringPiece protocol) const;
+
+  bool supportsVersion(ProtocolVersion version) const;
+};
+
+enum class ClientHelloInspection {
+  // info is filled in.
+  Done,
+  // data holds the start of a ClientHello record but not all of it.
+  NeedMoreData,
+  // data is not a TLS ClientHello this inspector can read, eg another
+  // protocol, a malformed hello, or a hello split over several records.
+  Invalid,
+};
+
+/**
+ * Extracts the fields a load balancer routes on from the first bytes a client
+ * sends, without allocating and without decoding the rest of the hello. data
+ * must begin with the TLS record header and the ClientHello must fit in the
+ * first record, which is the case for all but very large hellos.
+ *
+ * Only the framing of the parts read is validated; the hello must still be
+ * checked by whichever server terminates the connection.
+ */
+ClientHelloInspection inspectClientHello(
+    folly::ByteRange data,
+    ClientHelloInfo& info);
+} // namespace fizz
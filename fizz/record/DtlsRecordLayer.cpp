@@ -0,0 +1,407 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/record/DtlsRecordLayer.h>
+
+#include <fizz/protocol/CipherSuiteTraits.h>
+
+namespace fizz {
+
+using ContentTypeType = typename std::underlying_type<ContentType>::type;
+using ProtocolVersionType =
+    typename std::underlying_type<ProtocolVersion>::type;
+
+static constexpr uint16_t kMaxEncryptedRecordSize =
+    kMaxPlaintextRecordSize + 256;
+
+// Unified header flags (RFC 9147 section 4): the fixed bits 001, then
+// connection ID present, 16 bit sequence number, length present and the low
+// 2 bits of the epoch.
+static constexpr uint8_t kUnifiedHeaderMask = 0xe0;
+static constexpr uint8_t kUnifiedHeaderBits = 0x20;
+static constexpr uint8_t kConnectionIdBit = 0x10;
+static constexpr uint8_t kLongSeqNumBit = 0x08;
+static constexpr uint8_t kLengthBit = 0x04;
+static constexpr uint8_t kEpochMask = 0x03;
+
+// DTLSPlaintext header: type, version, epoch, 48 bit sequence number, length.
+static constexpr size_t kDtlsPlaintextHeaderSize = 13;
+static constexpr uint64_t kMaxDtlsPlaintextSeqNum = (uint64_t(1) << 48) - 1;
+
+// legacy_record_version of every DTLS 1.3 record, DTLS 1.2.
+static constexpr ProtocolVersionType kDtlsRecordVersion = 0xfefd;
+
+uint64_t dtlsEpoch(EncryptionLevel encryptionLevel) {
+  switch (encryptionLevel) {
+    case EncryptionLevel::Plaintext:
+      return 0;
+    case EncryptionLevel::EarlyData:
+      return 1;
+    case EncryptionLevel::Handshake:
+      return 2;
+    case EncryptionLevel::AppTraffic:
+      return 3;
+  }
+  throw std::runtime_error("unknown encryption level");
+}
+
+void DtlsSequenceNumberCipher::setKey(
+    CipherSuite cipher,
+    folly::ByteRange trafficSecret) {
+  const EVP_CIPHER* evpCipher;
+  switch (cipher) {
+    case CipherSuite::TLS_AES_128_GCM_SHA256:
+    case CipherSuite::TLS_AES_128_OCB_SHA256_EXPERIMENTAL:
+      evpCipher = EVP_aes_128_ecb();
+      chacha_ = false;
+      break;
+    case CipherSuite::TLS_AES_256_GCM_SHA384:
+      evpCipher = EVP_aes_256_ecb();
+      chacha_ = false;
+      break;
+    case CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
+      evpCipher = EVP_chacha20();
+      chacha_ = true;
+      break;
+    default:
+      throw std::runtime_error("cipher suite not implemented");
+  }
+
+  auto key = withCipherSuiteTraits(cipher, [&](auto traits) {
+    using Traits = decltype(traits);
+    typename Traits::KeyDeriver deriver(kDtls13LabelPrefix);
+    return deriver.expandLabel(
+        trafficSecret,
+        "sn",
+        folly::IOBuf::create(0),
+        Traits::AeadCipher::kKeyLength);
+  });
+  key->coalesce();
+
+  ctx_.reset(EVP_CIPHER_CTX_new());
+  if (!ctx_) {
+    throw std::runtime_error("unable to allocate cipher context");
+  }
+  if (EVP_EncryptInit_ex(
+          ctx_.get(), evpCipher, nullptr, key->data(), nullptr) != 1) {
+    throw std::runtime_error("unable to set sequence number key");
+  }
+  if (!chacha_) {
+    EVP_CIPHER_CTX_set_padding(ctx_.get(), 0);
+  }
+}
+
+void DtlsSequenceNumberCipher::apply(
+    const folly::IOBuf& ciphertext,
+    folly::MutableByteRange seqNum) const {
+  if (!ctx_) {
+    throw std::runtime_error("no sequence number key");
+  }
+  DCHECK_LE(seqNum.size(), kDtlsSequenceNumberSample);
+
+  std::array<uint8_t, kDtlsSequenceNumberSample> sample;
+  folly::io::Cursor(&ciphertext).pull(sample.data(), sample.size());
+
+  // AES encrypts the sample itself, ChaCha20 uses it as counter and nonce to
+  // produce key stream.
+  std::array<uint8_t, kDtlsSequenceNumberSample> mask;
+  int outLen;
+  if (chacha_) {
+    std::array<uint8_t, kDtlsSequenceNumberSample> zeros{};
+    if (EVP_EncryptInit_ex(
+            ctx_.get(), nullptr, nullptr, nullptr, sample.data()) != 1 ||
+        EVP_EncryptUpdate(
+            ctx_.get(), mask.data(), &outLen, zeros.data(), zeros.size()) !=
+            1) {
+      throw std::runtime_error("sequence number encryption failed");
+    }
+  } else if (
+      EVP_EncryptUpdate(
+          ctx_.get(), mask.data(), &outLen, sample.data(), sample.size()) !=
+      1) {
+    throw std::runtime_error("sequence number encryption failed");
+  }
+
+  for (size_t i = 0; i < seqNum.size(); ++i) {
+    seqNum[i] ^= mask[i];
+  }
+}
+
+folly::Optional<TLSMessage> DtlsReadRecordLayer::read(
+    folly::IOBufQueue& buf) {
+  auto aead = getAead();
+  if (!aead) {
+    throw std::runtime_error("no aead set");
+  }
+
+  while (!buf.empty()) {
+    folly::io::Cursor cursor(buf.front());
+    auto flags = cursor.read<uint8_t>();
+
+    if ((flags & kUnifiedHeaderMask) != kUnifiedHeaderBits) {
+      // A DTLSPlaintext record of epoch 0 carries its length, so it can be
+      // skipped. Anything else leaves us unable to find the next record.
+      if (cursor.canAdvance(kDtlsPlaintextHeaderSize - 1)) {
+        cursor.skip(kDtlsPlaintextHeaderSize - 3);
+        auto length = cursor.readBE<uint16_t>();
+        if (buf.chainLength() >= kDtlsPlaintextHeaderSize + length) {
+          buf.trimStart(kDtlsPlaintextHeaderSize + length);
+          continue;
+        }
+      }
+      buf.move();
+      return folly::none;
+    }
+    if (flags & kConnectionIdBit) {
+      // Without a negotiated connection ID we don't know its length.
+      buf.move();
+      return folly::none;
+    }
+
+    size_t seqLen = (flags & kLongSeqNumBit) ? 2 : 1;
+    size_t headerLen = 1 + seqLen + ((flags & kLengthBit) ? 2 : 0);
+    if (!cursor.canAdvance(headerLen - 1)) {
+      buf.move();
+      return folly::none;
+    }
+    cursor.skip(seqLen);
+    size_t length = (flags & kLengthBit) ? cursor.readBE<uint16_t>()
+                                         : buf.chainLength() - headerLen;
+    if (buf.chainLength() < headerLen + length) {
+      // Records never span datagrams, so a truncated record is dropped along
+      // with whatever follows it.
+      buf.move();
+      return folly::none;
+    }
+
+    std::array<uint8_t, kDtlsHeaderSize> header;
+    folly::io::Cursor(buf.front()).pull(header.data(), headerLen);
+    buf.trimStart(headerLen);
+    auto encrypted = buf.split(length);
+
+    if ((flags & kEpochMask) != (epoch_ & kEpochMask)) {
+      continue;
+    }
+    if (length < kDtlsSequenceNumberSample ||
+        length > kMaxEncryptedRecordSize) {
+      continue;
+    }
+
+    seqNumCipher_.apply(
+        *encrypted, folly::MutableByteRange(header.data() + 1, seqLen));
+    uint16_t truncated = header[1];
+    if (seqLen == 2) {
+      truncated = (truncated << 8) | header[2];
+    }
+    auto seqNum = reconstructSeqNum(truncated, seqLen * 8);
+    if (seqNum == std::numeric_limits<uint64_t>::max() || isReplay(seqNum)) {
+      continue;
+    }
+
+    // The additional data is the header with the sequence number in the
+    // clear, as it was before the writer encrypted it.
+    folly::IOBuf adBuf{
+        folly::IOBuf::wrapBufferAsValue(header.data(), headerLen)};
+    auto decrypted = aead->tryDecrypt(std::move(encrypted), &adBuf, seqNum);
+    if (!decrypted) {
+      continue;
+    }
+    markReceived(seqNum);
+
+    auto& plaintext = *decrypted;
+    plaintext->coalesce();
+    auto data = plaintext->data();
+    size_t contentLen = plaintext->length();
+    while (contentLen > 0 && data[contentLen - 1] == 0) {
+      contentLen--;
+    }
+    if (contentLen == 0) {
+      throw FizzException(
+          "No content type found", AlertDescription::unexpected_message);
+    }
+    contentLen--;
+    if (contentLen > kMaxPlaintextRecordSize) {
+      throw FizzException(
+          "received too long record", AlertDescription::record_overflow);
+    }
+
+    TLSMessage msg;
+    msg.type = static_cast<ContentType>(data[contentLen]);
+    switch (msg.type) {
+      case ContentType::handshake:
+      case ContentType::alert:
+      case ContentType::application_data:
+        break;
+      default:
+        throw FizzException(
+            folly::to<std::string>(
+                "received encrypted content type ",
+                static_cast<ContentTypeType>(msg.type)),
+            AlertDescription::unexpected_message);
+    }
+    plaintext->trimEnd(plaintext->length() - contentLen);
+    msg.fragment = std::move(plaintext);
+    return std::move(msg);
+  }
+  return folly::none;
+}
+
+uint64_t DtlsReadRecordLayer::reconstructSeqNum(
+    uint16_t truncated,
+    size_t bits) const {
+  // Pick the sequence number closest to the one following the highest
+  // received so far (RFC 9147 section 4.2.2).
+  uint64_t window = uint64_t(1) << bits;
+  uint64_t halfWindow = window / 2;
+  uint64_t candidate = (nextSeqNum_ & ~(window - 1)) | truncated;
+  if (candidate + halfWindow <= nextSeqNum_ &&
+      candidate <= std::numeric_limits<uint64_t>::max() - window) {
+    return candidate + window;
+  }
+  if (candidate > nextSeqNum_ + halfWindow && candidate >= window) {
+    return candidate - window;
+  }
+  return candidate;
+}
+
+bool DtlsReadRecordLayer::isReplay(uint64_t seqNum) const {
+  if (seqNum >= nextSeqNum_) {
+    return false;
+  }
+  auto age = nextSeqNum_ - 1 - seqNum;
+  if (age >= 64) {
+    return true;
+  }
+  return replayWindow_ & (uint64_t(1) << age);
+}
+
+void DtlsReadRecordLayer::markReceived(uint64_t seqNum) {
+  if (seqNum >= nextSeqNum_) {
+    auto shift = seqNum + 1 - nextSeqNum_;
+    replayWindow_ = shift >= 64 ? 0 : replayWindow_ << shift;
+    replayWindow_ |= 1;
+    nextSeqNum_ = seqNum + 1;
+  } else {
+    replayWindow_ |= uint64_t(1) << (nextSeqNum_ - 1 - seqNum);
+  }
+}
+
+void DtlsWriteRecordLayer::writeHeader(
+    folly::IOBuf& header,
+    size_t dataLength,
+    uint64_t seqNum) const {
+  // The header is the additional data, so the sequence number is left in the
+  // clear until protectHeader().
+  auto length =
+      dataLength + sizeof(ContentType) + getAead()->getCipherOverhead();
+  header.clear();
+  folly::io::Appender appender(&header, 0);
+  appender.writeBE<uint8_t>(
+      kUnifiedHeaderBits | kLongSeqNumBit | kLengthBit |
+      (epoch_ & kEpochMask));
+  appender.writeBE<uint16_t>(seqNum & 0xffff);
+  appender.writeBE<uint16_t>(length);
+}
+
+void DtlsWriteRecordLayer::protectHeader(
+    folly::IOBuf& header,
+    const folly::IOBuf& cipherText) const {
+  DCHECK_EQ(header.length(), kDtlsHeaderSize);
+  seqNumCipher_.apply(
+      cipherText, folly::MutableByteRange(header.writableData() + 1, 2));
+}
+
+folly::Optional<TLSMessage> DtlsPlaintextReadRecordLayer::read(
+    folly::IOBufQueue& buf) {
+  while (!buf.empty()) {
+    folly::io::Cursor cursor(buf.front());
+    auto flags = cursor.read<uint8_t>();
+
+    if ((flags & kUnifiedHeaderMask) == kUnifiedHeaderBits) {
+      // A record of a later epoch, such as early data. It can only be skipped
+      // if it carries its length.
+      size_t seqLen = (flags & kLongSeqNumBit) ? 2 : 1;
+      size_t headerLen = 1 + seqLen + 2;
+      if ((flags & kConnectionIdBit) || !(flags & kLengthBit) ||
+          !cursor.canAdvance(headerLen - 1)) {
+        buf.move();
+        return folly::none;
+      }
+      cursor.skip(seqLen);
+      size_t length = cursor.readBE<uint16_t>();
+      if (buf.chainLength() < headerLen + length) {
+        buf.move();
+        return folly::none;
+      }
+      buf.trimStart(headerLen + length);
+      continue;
+    }
+
+    if (!cursor.canAdvance(kDtlsPlaintextHeaderSize - 1)) {
+      buf.move();
+      return folly::none;
+    }
+    TLSMessage msg;
+    msg.type = static_cast<ContentType>(flags);
+    cursor.skip(sizeof(ProtocolVersion));
+    auto epoch = cursor.readBE<uint16_t>();
+    cursor.skip(6);
+    size_t length = cursor.readBE<uint16_t>();
+    if (buf.chainLength() < kDtlsPlaintextHeaderSize + length) {
+      buf.move();
+      return folly::none;
+    }
+    buf.trimStart(kDtlsPlaintextHeaderSize);
+    auto fragment = buf.split(length);
+
+    if (epoch != 0 || length == 0 || length > kMaxPlaintextRecordSize) {
+      continue;
+    }
+    // Also drops change_cipher_spec, which DTLS 1.3 doesn't use.
+    if (msg.type != ContentType::handshake && msg.type != ContentType::alert) {
+      continue;
+    }
+    msg.fragment = std::move(fragment);
+    return std::move(msg);
+  }
+  return folly::none;
+}
+
+Buf DtlsPlaintextWriteRecordLayer::write(TLSMessage&& msg) const {
+  if (msg.type == ContentType::application_data) {
+    throw std::runtime_error("refusing to send plaintext application data");
+  }
+
+  folly::io::Cursor cursor(msg.fragment.get());
+  folly::IOBufQueue out{folly::IOBufQueue::cacheChainLength()};
+  while (!cursor.isAtEnd()) {
+    if (seqNum_ > kMaxDtlsPlaintextSeqNum) {
+      throw std::runtime_error("max write seq num");
+    }
+    Buf fragment;
+    auto length = cursor.cloneAtMost(fragment, kMaxPlaintextRecordSize);
+
+    auto header = folly::IOBuf::create(kDtlsPlaintextHeaderSize);
+    folly::io::Appender appender(header.get(), 0);
+    appender.writeBE(static_cast<ContentTypeType>(msg.type));
+    appender.writeBE(kDtlsRecordVersion);
+    appender.writeBE<uint16_t>(0);
+    appender.writeBE<uint16_t>(seqNum_ >> 32);
+    appender.writeBE<uint32_t>(seqNum_ & 0xffffffff);
+    appender.writeBE<uint16_t>(length);
+    seqNum_++;
+
+    out.append(std::move(header));
+    out.append(std::move(fragment));
+  }
+  if (out.empty()) {
+    return folly::IOBuf::create(0);
+  }
+  return out.move();
+}
+} // namespace fizz
@@ -0,0 +1,200 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/record/EncryptedRecordLayer.h>
+#include <fizz/record/PlaintextRecordLayer.h>
+
+#include <folly/ssl/OpenSSLPtrTypes.h>
+
+namespace fizz {
+
+/**
+ * Length of the DTLS 1.3 unified header written by DtlsWriteRecordLayer: the
+ * flags byte, a 16 bit sequence number and a 16 bit length.
+ */
+constexpr size_t kDtlsHeaderSize = 5;
+static_assert(
+    kDtlsHeaderSize == kEncryptedHeaderSize,
+    "DTLS records reuse the TLS record header space");
+
+/**
+ * Bytes of ciphertext the sequence number mask is computed from.
+ */
+constexpr size_t kDtlsSequenceNumberSample = 16;
+
+/**
+ * Epoch DTLS 1.3 uses for the keys of an encryption level. Application
+ * traffic starts at epoch 3, each key update moves to the next epoch.
+ */
+uint64_t dtlsEpoch(EncryptionLevel encryptionLevel);
+
+/**
+ * Encrypts the sequence numbers in DTLS 1.3 record headers (RFC 9147 section
+ * 4.2.3) with a key derived from the traffic secret with the "dtls13" label
+ * prefix.
+ */
+class DtlsSequenceNumberCipher {
+ public:
+  void setKey(CipherSuite cipher, folly::ByteRange trafficSecret);
+
+  bool hasKey() const {
+    return ctx_ != nullptr;
+  }
+
+  /**
+   * XORs seqNum with the mask computed from the first
+   * kDtlsSequenceNumberSample bytes of ciphertext.
+   */
+  void apply(const folly::IOBuf& ciphertext, folly::MutableByteRange seqNum)
+      const;
+
+ private:
+  folly::ssl::EvpCipherCtxUniquePtr ctx_;
+  bool chacha_{false};
+};
+
+/**
+ * Reads DTLS 1.3 records (DTLSCiphertext with the unified header) of one
+ * epoch. buf passed to read() should hold whole datagrams. As required for
+ * datagram transports, records that are malformed, belong to another epoch,
+ * fail to decrypt or are replayed are silently dropped. Connection IDs are
+ * not supported.
+ *
+ * The aead must come from the DTLS 1.3 key schedule, see DtlsFactory.
+ */
+class DtlsReadRecordLayer : public EncryptedReadRecordLayer {
+ public:
+  explicit DtlsReadRecordLayer(
+      EncryptionLevel encryptionLevel = EncryptionLevel::AppTraffic)
+      : EncryptedReadRecordLayer(encryptionLevel),
+        epoch_(dtlsEpoch(encryptionLevel)) {}
+
+  folly::Optional<TLSMessage> read(folly::IOBufQueue& buf) override;
+
+  // Malformed records are dropped rather than reported, so read() only
+  // throws on misuse.
+  RecordLayerResult<folly::Optional<TLSMessage>> tryRead(
+      folly::IOBufQueue& buf) override {
+    return ReadRecordLayer::tryRead(buf);
+  }
+
+  void trafficSecretAvailable(CipherSuite cipher, folly::ByteRange secret)
+      override {
+    seqNumCipher_.setKey(cipher, secret);
+  }
+
+  void setKeyUpdateGeneration(uint32_t generation) override {
+    epoch_ = dtlsEpoch(getEncryptionLevel()) + generation;
+  }
+
+  /**
+   * Sets the epoch of the records to accept.
+   */
+  void setEpoch(uint64_t epoch) {
+    epoch_ = epoch;
+  }
+
+  uint64_t getEpoch() const {
+    return epoch_;
+  }
+
+ private:
+  uint64_t reconstructSeqNum(uint16_t truncated, size_t bits) const;
+
+  bool isReplay(uint64_t seqNum) const;
+
+  void markReceived(uint64_t seqNum);
+
+  uint64_t epoch_;
+  DtlsSequenceNumberCipher seqNumCipher_;
+
+  // One plus the highest sequence number received, and a bitmap of the 64
+  // sequence numbers below it (bit 0 is the highest) that were received.
+  uint64_t nextSeqNum_{0};
+  uint64_t replayWindow_{0};
+};
+
+/**
+ * Writes DTLS 1.3 records (DTLSCiphertext with the unified header) of one
+ * epoch, on every write path of EncryptedWriteRecordLayer. Records are
+ * returned back to back; each carries its length, so a caller can place them
+ * in datagrams whole. Use setMaxRecord() to keep records within the path MTU.
+ *
+ * The aead must come from the DTLS 1.3 key schedule, see DtlsFactory.
+ */
+class DtlsWriteRecordLayer : public EncryptedWriteRecordLayer {
+ public:
+  explicit DtlsWriteRecordLayer(
+      EncryptionLevel encryptionLevel = EncryptionLevel::AppTraffic)
+      : EncryptedWriteRecordLayer(encryptionLevel),
+        epoch_(dtlsEpoch(encryptionLevel)) {}
+
+  void trafficSecretAvailable(CipherSuite cipher, folly::ByteRange secret)
+      override {
+    seqNumCipher_.setKey(cipher, secret);
+  }
+
+  void setKeyUpdateGeneration(uint32_t generation) override {
+    epoch_ = dtlsEpoch(getEncryptionLevel()) + generation;
+  }
+
+  void setEpoch(uint64_t epoch) {
+    epoch_ = epoch;
+  }
+
+  uint64_t getEpoch() const {
+    return epoch_;
+  }
+
+ protected:
+  void writeHeader(folly::IOBuf& header, size_t dataLength, uint64_t seqNum)
+      const override;
+
+  void protectHeader(folly::IOBuf& header, const folly::IOBuf& cipherText)
+      const override;
+
+ private:
+  uint64_t epoch_;
+  DtlsSequenceNumberCipher seqNumCipher_;
+};
+
+/**
+ * Reads DTLSPlaintext records (epoch 0). As with DtlsReadRecordLayer, buf
+ * passed to read() should hold whole datagrams, and malformed records and
+ * records of other epochs are silently dropped, so setSkipEncryptedRecords()
+ * makes no difference. Plaintext records are not protected against replay.
+ */
+class DtlsPlaintextReadRecordLayer : public PlaintextReadRecordLayer {
+ public:
+  folly::Optional<TLSMessage> read(folly::IOBufQueue& buf) override;
+
+  RecordLayerResult<folly::Optional<TLSMessage>> tryRead(
+      folly::IOBufQueue& buf) override {
+    return ReadRecordLayer::tryRead(buf);
+  }
+};
+
+/**
+ * Writes DTLSPlaintext records (epoch 0) with consecutive sequence numbers.
+ */
+class DtlsPlaintextWriteRecordLayer : public PlaintextWriteRecordLayer {
+ public:
+  Buf write(TLSMessage&& msg) const override;
+
+  // DTLS uses the same record version for the initial ClientHello.
+  Buf writeInitialClientHello(Buf encodedClientHello) const override {
+    return write(
+        TLSMessage{ContentType::handshake, std::move(encodedClientHello)});
+  }
+
+ private:
+  mutable uint64_t seqNum_{0};
+};
+} // namespace fizz
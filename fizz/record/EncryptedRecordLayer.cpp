@@ -8,6 +8,18 @@
 
 #include <fizz/record/EncryptedRecordLayer.h>
 
+#include <fizz/protocol/AllocationStats.h>
+#include <fizz/protocol/TLSStats.h>
+#include <folly/Function.h>
+#include <folly/futures/Future.h>
+#include <folly/lang/Bits.h>
+
+#include <atomic>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace fizz {
 
 using ContentTypeType = typename std::underlying_type<ContentType>::type;
@@ -15,11 +27,199 @@ using ProtocolVersionType =
     typename std::underlying_type<ProtocolVersion>::type;
 
 static constexpr uint16_t kMaxEncryptedRecordSize = 0x4000 + 256; // 16k + 256
-static constexpr size_t kEncryptedHeaderSize =
-    sizeof(ContentType) + sizeof(ProtocolVersion) + sizeof(uint16_t);
 
-folly::Optional<Buf> EncryptedReadRecordLayer::getDecryptedBuf(
-    folly::IOBufQueue& buf) {
+/**
+ * Returns the length of data once trailing zero bytes are removed. Padding is
+ * skipped 16 (or 8) bytes at a time so that a record full of padding costs a
+ * small fraction of decrypting it.
+ */
+static size_t trimZeroPadding(const uint8_t* data, size_t length) {
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  while (length >= sizeof(__m128i)) {
+    auto block = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(data + length - sizeof(__m128i)));
+    auto zeroMask = static_cast<unsigned int>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero)));
+    if (zeroMask != 0xffff) {
+      auto nonZeroMask = ~zeroMask & 0xffff;
+      return length - sizeof(__m128i) + folly::findLastSet(nonZeroMask);
+    }
+    length -= sizeof(__m128i);
+  }
+#endif
+  while (length >= sizeof(uint64_t) &&
+         folly::loadUnaligned<uint64_t>(data + length - sizeof(uint64_t)) ==
+             0) {
+    length -= sizeof(uint64_t);
+  }
+  while (length > 0 && data[length - 1] == 0) {
+    length--;
+  }
+  return length;
+}
+
+/**
+ * Runs tasks on executor and returns once all of them are done, rethrowing
+ * the first failure. The calling thread runs every task that hasn't started
+ * by then itself, so this doesn't deadlock when the executor runs on the
+ * calling thread (eg it is the caller's EventBase) or is too busy to get to
+ * them. Tasks the executor runs later find them done and return right away.
+ */
+static void runTasks(
+    folly::Executor* executor,
+    std::vector<folly::Function<void()>>& tasks) {
+  auto started =
+      std::make_shared<std::vector<std::atomic<bool>>>(tasks.size());
+  std::vector<folly::Future<folly::Unit>> done;
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    folly::Promise<folly::Unit> promise;
+    done.push_back(promise.getFuture());
+    auto task = &tasks[i];
+    try {
+      executor->add(
+          [started, i, task, promise = std::move(promise)]() mutable {
+            // task is only touched while the caller waits for it.
+            if (!(*started)[i].exchange(true)) {
+              promise.setWith(std::move(*task));
+            }
+          });
+    } catch (const std::exception& ex) {
+      VLOG(4) << "executor rejected record task: " << ex.what();
+      break;
+    }
+  }
+  // Whatever wasn't handed to the executor is run below.
+  while (done.size() < tasks.size()) {
+    done.push_back(folly::makeFuture());
+  }
+
+  // Start from the back, the executor picks tasks up from the front.
+  for (size_t i = tasks.size(); i-- > 0;) {
+    if (!(*started)[i].exchange(true)) {
+      done[i] = folly::makeFutureWith(std::move(tasks[i]));
+    }
+  }
+  // The rest are running on the executor.
+  for (auto& task : done) {
+    task.wait();
+  }
+  for (auto& task : done) {
+    task.value();
+  }
+}
+
+bool EncryptedReadRecordLayer::decryptRecordsParallel(
+    const folly::IOBufQueue& buf) {
+  const auto& options = parallelDecryption_;
+  if (!options.executor || options.parallelism < 2 || skipFailedDecryption_ ||
+      buf.chainLength() < options.minBytes) {
+    return false;
+  }
+
+  // Find the complete records at the front of the queue. Anything unusual
+  // ends the run and is left to the serial path.
+  std::vector<std::unique_ptr<folly::IOBuf>> ciphertexts;
+  std::deque<std::array<uint8_t, kEncryptedHeaderSize>> headers;
+  std::vector<size_t> lengths;
+  size_t totalLength = 0;
+  folly::io::Cursor cursor(buf.front());
+  while (cursor.canAdvance(kEncryptedHeaderSize) &&
+         seqNum_ + ciphertexts.size() <
+             std::numeric_limits<uint64_t>::max()) {
+    std::array<uint8_t, kEncryptedHeaderSize> header;
+    folly::io::Cursor headerCursor(cursor);
+    headerCursor.pull(header.data(), header.size());
+    folly::io::Cursor lengthCursor(cursor);
+    auto contentType =
+        static_cast<ContentType>(lengthCursor.readBE<ContentTypeType>());
+    lengthCursor.skip(sizeof(ProtocolVersion));
+    auto length = lengthCursor.readBE<uint16_t>();
+    if (contentType != ContentType::application_data || length == 0 ||
+        length > kMaxEncryptedRecordSize ||
+        !cursor.canAdvance(kEncryptedHeaderSize + length)) {
+      break;
+    }
+    cursor.skip(kEncryptedHeaderSize);
+    std::unique_ptr<folly::IOBuf> ciphertext;
+    cursor.clone(ciphertext, length);
+    ciphertexts.push_back(std::move(ciphertext));
+    headers.push_back(header);
+    lengths.push_back(kEncryptedHeaderSize + length);
+    totalLength += kEncryptedHeaderSize + length;
+  }
+  if (ciphertexts.size() < 2 || totalLength < options.minBytes) {
+    return false;
+  }
+
+  if (workerAeads_.empty()) {
+    for (size_t i = 0; i < options.parallelism; ++i) {
+      auto worker = aead_->clone();
+      if (!worker) {
+        workerAeads_.clear();
+        return false;
+      }
+      workerAeads_.push_back(std::move(worker));
+    }
+  }
+
+  std::vector<folly::IOBuf> headerBufs;
+  for (auto& header : headers) {
+    headerBufs.push_back(folly::IOBuf::wrapBufferAsValue(folly::range(header)));
+  }
+
+  // The ciphertexts share memory with the queue, so the aead decrypts them
+  // into new buffers and the queue is left as it is.
+  std::vector<folly::Optional<Buf>> plaintexts(ciphertexts.size());
+  auto numTasks = std::min(workerAeads_.size(), ciphertexts.size());
+  auto perTask = (ciphertexts.size() + numTasks - 1) / numTasks;
+  auto firstSeqNum = seqNum_;
+  std::vector<folly::Function<void()>> tasks;
+  for (size_t task = 0, begin = 0; begin < ciphertexts.size(); ++task) {
+    auto end = std::min(begin + perTask, ciphertexts.size());
+    tasks.push_back([&, worker = workerAeads_[task].get(), begin, end]() {
+      for (size_t i = begin; i < end; ++i) {
+        plaintexts[i] = worker->tryDecrypt(
+            std::move(ciphertexts[i]),
+            useAdditionalData_ ? &headerBufs[i] : nullptr,
+            firstSeqNum + i);
+        if (!plaintexts[i]) {
+          // Nothing past a failed record is returned.
+          break;
+        }
+      }
+    });
+    begin = end;
+  }
+  runTasks(options.executor.get(), tasks);
+
+  for (size_t i = 0; i < plaintexts.size(); ++i) {
+    parallelRecords_.push_back(
+        ParallelRecord{lengths[i], std::move(plaintexts[i])});
+    if (!parallelRecords_.back().plaintext) {
+      break;
+    }
+  }
+  return true;
+}
+
+RecordLayerResult<folly::Optional<Buf>>
+EncryptedReadRecordLayer::getDecryptedBuf(folly::IOBufQueue& buf) {
+  if (!parallelRecords_.empty() || decryptRecordsParallel(buf)) {
+    auto record = std::move(parallelRecords_.front());
+    parallelRecords_.pop_front();
+    if (record.plaintext) {
+      buf.trimStart(record.length);
+      inPlaceFront_ = nullptr;
+      inPlaceRef_.reset();
+      seqNum_++;
+      return std::move(record.plaintext);
+    }
+    // Leave the record that failed to the serial path below, which reports
+    // the error (or, after a KeyUpdate, the next record layer decrypts it).
+    parallelRecords_.clear();
+  }
+
   while (true) {
     folly::io::Cursor cursor(buf.front());
 
@@ -38,10 +238,12 @@ folly::Optional<Buf> EncryptedReadRecordLayer::getDecryptedBuf(
 
     auto length = cursor.readBE<uint16_t>();
     if (length == 0) {
-      throw std::runtime_error("received 0 length encrypted record");
+      return folly::makeUnexpected(
+          RecordLayerError{"received 0 length encrypted record", folly::none});
     }
     if (length > kMaxEncryptedRecordSize) {
-      throw std::runtime_error("received too long encrypted record");
+      return folly::makeUnexpected(RecordLayerError{
+          "received too long encrypted record", folly::none});
     }
     if (buf.chainLength() < (cursor - buf.front()) + length) {
       return folly::none;
@@ -49,153 +251,555 @@ folly::Optional<Buf> EncryptedReadRecordLayer::getDecryptedBuf(
 
     if (contentType == ContentType::alert && length == 2) {
       auto alert = decode<Alert>(cursor);
-      throw std::runtime_error(folly::to<std::string>(
-          "received plaintext alert in encrypted record: ",
-          toString(alert.description)));
+      return folly::makeUnexpected(RecordLayerError{
+          folly::to<std::string>(
+              "received plaintext alert in encrypted record: ",
+              toString(alert.description)),
+          folly::none});
     }
 
+    // If the whole record sits in the front buffer and we own that buffer we
+    // can split the record out and decrypt it in place. Splitting leaves the
+    // remainder of the front buffer sharing memory with the record we split
+    // out, but those bytes are disjoint, so we remember the front buffer to
+    // keep decrypting subsequent records in it in place. inPlaceRef_ holds a
+    // reference to its memory meanwhile, so that a buffer at the same address
+    // is the same allocation rather than a reused one.
+    auto front = buf.front();
+    bool remembered = front == inPlaceFront_ && inPlaceRef_ &&
+        front->buffer() == inPlaceRef_->buffer();
+    bool inPlace = front->length() >= kEncryptedHeaderSize + length &&
+        (!front->isShared() || remembered);
+
     std::unique_ptr<folly::IOBuf> encrypted;
-    cursor.clone(encrypted, length);
-    buf.trimStart(cursor - buf.front());
+    if (inPlace) {
+      buf.trimStart(kEncryptedHeaderSize);
+      encrypted = buf.split(length);
+      // front was either left at the head of the queue or moved into
+      // encrypted, so comparing against it here is safe.
+      if (!buf.empty() && buf.front() == front) {
+        if (!remembered) {
+          inPlaceFront_ = front;
+          inPlaceRef_ = front->cloneOne();
+        }
+      } else {
+        inPlaceFront_ = nullptr;
+        inPlaceRef_.reset();
+      }
+    } else {
+      inPlaceFront_ = nullptr;
+      inPlaceRef_.reset();
+      cursor.clone(encrypted, length);
+      buf.trimStart(cursor - buf.front());
+    }
 
     if (contentType == ContentType::change_cipher_spec) {
       encrypted->coalesce();
       if (encrypted->length() == 1 && *encrypted->data() == 0x01) {
         continue;
       } else {
-        throw FizzException(
-            "received ccs", AlertDescription::illegal_parameter);
+        return folly::makeUnexpected(RecordLayerError{
+            "received ccs", AlertDescription::illegal_parameter});
       }
     }
 
-    TLSMessage msg;
-    folly::IOBufQueue decrypted;
     if (seqNum_ == std::numeric_limits<uint64_t>::max()) {
-      throw std::runtime_error("max read seq num");
+      return folly::makeUnexpected(
+          RecordLayerError{"max read seq num", folly::none});
+    }
+    auto provider = getPlaintextBufferProvider();
+    if (provider && !skipFailedDecryption_ &&
+        aead_->supportsDecryptIovecs() &&
+        length > aead_->getCipherOverhead()) {
+      // Decrypt straight into the provided memory, saving the caller from
+      // copying the plaintext out of our buffer.
+      size_t plaintextLength = length - aead_->getCipherOverhead();
+      auto plaintext = provider->getPlaintextBuffer(plaintextLength);
+      if (plaintext.size() >= plaintextLength) {
+        struct iovec iov;
+        iov.iov_base = plaintext.data();
+        iov.iov_len = plaintextLength;
+        auto written = aead_->tryDecryptIovecs(
+            *encrypted,
+            useAdditionalData_ ? &adBuf : nullptr,
+            seqNum_,
+            &iov,
+            1);
+        if (!written) {
+          return folly::makeUnexpected(
+              RecordLayerError{"decryption failed", folly::none});
+        }
+        seqNum_++;
+        return folly::Optional<Buf>(
+            folly::IOBuf::wrapBuffer(plaintext.data(), *written));
+      }
     }
+    auto additionalData = useAdditionalData_ ? &adBuf : nullptr;
     if (skipFailedDecryption_) {
-      auto decryptAttempt = aead_->tryDecrypt(
-          std::move(encrypted), useAdditionalData_ ? &adBuf : nullptr, seqNum_);
+      auto overhead = aead_->getCipherOverhead();
+      size_t skippedLength = length > overhead ? length - overhead : 0;
+      folly::Optional<Buf> decryptAttempt;
+      if (fastSkipLength_ == 0 || skippedLength <= fastSkipLength_) {
+        decryptAttempt = inPlace
+            ? aead_->tryDecryptInPlace(
+                  std::move(encrypted), additionalData, seqNum_)
+            : aead_->tryDecrypt(std::move(encrypted), additionalData, seqNum_);
+      }
       if (decryptAttempt) {
         seqNum_++;
         skipFailedDecryption_ = false;
         return decryptAttempt;
-      } else {
-        continue;
       }
-    } else {
-      return aead_->decrypt(
-          std::move(encrypted),
-          useAdditionalData_ ? &adBuf : nullptr,
-          seqNum_++);
+      skippedBytes_ += skippedLength;
+      if (skippedBytes_ > maxSkippedBytes_) {
+        return folly::makeUnexpected(RecordLayerError{
+            "skipped too many undecryptable records", folly::none});
+      }
+      continue;
+    }
+
+    auto decrypted = inPlace
+        ? aead_->tryDecryptInPlace(
+              std::move(encrypted), additionalData, seqNum_)
+        : aead_->tryDecrypt(std::move(encrypted), additionalData, seqNum_);
+    if (!decrypted) {
+      return folly::makeUnexpected(
+          RecordLayerError{"decryption failed", folly::none});
     }
+    seqNum_++;
+    return decrypted;
   }
 }
 
 folly::Optional<TLSMessage> EncryptedReadRecordLayer::read(
     folly::IOBufQueue& buf) {
-  auto decryptedBuf = getDecryptedBuf(buf);
-  if (!decryptedBuf) {
+  auto msg = tryRead(buf);
+  if (msg.hasError()) {
+    throwRecordLayerError(std::move(msg.error()));
+  }
+  return std::move(msg.value());
+}
+
+RecordLayerResult<folly::Optional<TLSMessage>>
+EncryptedReadRecordLayer::tryRead(folly::IOBufQueue& buf) {
+  AllocationStats::Scope allocationScope(AllocationSite::RecordLayer);
+  RecordLayerResult<folly::Optional<Buf>> decryptedBuf;
+  {
+    TLSStats::Timer timer(TLSCounter::DecryptNanos);
+    decryptedBuf = getDecryptedBuf(buf);
+  }
+  if (decryptedBuf.hasError()) {
+    return folly::makeUnexpected(std::move(decryptedBuf.error()));
+  }
+  if (!*decryptedBuf) {
     return folly::none;
   }
+  TLSStats::add(TLSCounter::RecordsDecrypted, 1);
+  auto& decrypted = **decryptedBuf;
+  TLSStats::add(
+      TLSCounter::BytesDecrypted, decrypted->computeChainDataLength());
 
-  folly::IOBufQueue decrypted;
-  decrypted.append(std::move(*decryptedBuf));
+  TLSMessage msg;
+  if (!decrypted->isChained()) {
+    // Fast path: scan for the content type directly in the single buffer
+    // rather than walking the chain.
+    auto data = decrypted->data();
+    size_t contentLength = trimZeroPadding(data, decrypted->length());
+    if (contentLength == 0) {
+      return folly::makeUnexpected(
+          RecordLayerError{"no content type found", folly::none});
+    }
+    msg.type = static_cast<ContentType>(data[contentLength - 1]);
+    decrypted->trimEnd(decrypted->length() - (contentLength - 1));
+    if (msg.type != ContentType::application_data &&
+        !decrypted->isManagedOne()) {
+      // Only app data may stay in memory from a PlaintextBufferProvider.
+      decrypted->makeManaged();
+    }
+    if (!decrypted->empty() || msg.type == ContentType::application_data) {
+      msg.fragment = std::move(decrypted);
+    }
+    return checkDecryptedMessage(std::move(msg));
+  }
 
-  folly::io::Cursor paddingCursor(decrypted.front());
-  paddingCursor.advanceToEnd();
-  while (!*(paddingCursor -= 1).data()) {
+  // Walk the chain backwards to find the buffer holding the last non-zero
+  // byte, which is the content type.
+  folly::IOBuf* current = decrypted->prev();
+  size_t paddingLength = 0;
+  size_t contentLength;
+  while (true) {
+    contentLength = trimZeroPadding(current->data(), current->length());
+    if (contentLength != 0 || current == decrypted.get()) {
+      break;
+    }
+    paddingLength += current->length();
+    current = current->prev();
   }
-  TLSMessage msg;
-  msg.type = static_cast<ContentType>(paddingCursor.readBE<ContentTypeType>());
-  decrypted.trimEnd(paddingCursor.totalLength() + sizeof(ContentType));
-  msg.fragment = decrypted.move();
+  if (contentLength == 0) {
+    return folly::makeUnexpected(
+        RecordLayerError{"no content type found", folly::none});
+  }
+  msg.type = static_cast<ContentType>(current->data()[contentLength - 1]);
+  paddingLength += current->length() - contentLength;
+
+  folly::IOBufQueue queue;
+  queue.append(std::move(decrypted));
+  queue.trimEnd(paddingLength + sizeof(ContentType));
+  msg.fragment = queue.move();
+
+  return checkDecryptedMessage(std::move(msg));
+}
 
+RecordLayerResult<folly::Optional<TLSMessage>>
+EncryptedReadRecordLayer::checkDecryptedMessage(TLSMessage msg) {
   switch (msg.type) {
     case ContentType::handshake:
     case ContentType::alert:
     case ContentType::application_data:
       break;
     default:
-      throw std::runtime_error(folly::to<std::string>(
-          "received encrypted content type ",
-          static_cast<ContentTypeType>(msg.type)));
+      return folly::makeUnexpected(RecordLayerError{
+          folly::to<std::string>(
+              "received encrypted content type ",
+              static_cast<ContentTypeType>(msg.type)),
+          folly::none});
   }
 
   if (!msg.fragment) {
     if (msg.type == ContentType::application_data) {
       msg.fragment = folly::IOBuf::create(0);
     } else {
-      throw std::runtime_error("received empty fragment");
+      return folly::makeUnexpected(
+          RecordLayerError{"received empty fragment", folly::none});
     }
   }
 
-  return std::move(msg);
+  return folly::Optional<TLSMessage>(std::move(msg));
+}
+
+void EncryptedReadRecordLayer::releaseIdleResources() {
+  ReadRecordLayer::releaseIdleResources();
+  if (aead_) {
+    aead_->releaseIdleResources();
+  }
+  // Recreated from aead_ by the next parallel read.
+  workerAeads_.clear();
+}
+
+size_t EncryptedReadRecordLayer::getCipherMemoryUsage() const {
+  size_t usage = aead_ ? aead_->getMemoryUsage() : 0;
+  for (const auto& aead : workerAeads_) {
+    usage += aead->getMemoryUsage();
+  }
+  return usage;
 }
 
 Buf EncryptedWriteRecordLayer::write(TLSMessage&& msg) const {
   folly::IOBufQueue queue;
   queue.append(std::move(msg.fragment));
-  std::unique_ptr<folly::IOBuf> outBuf;
-  std::array<uint8_t, kEncryptedHeaderSize> headerBuf;
-  auto header = folly::IOBuf::wrapBufferAsValue(folly::range(headerBuf));
-  aead_->setEncryptedBufferHeadroom(kEncryptedHeaderSize);
-  while (!queue.empty()) {
-    auto dataBuf = getBufToEncrypt(queue);
-    // Currently we never send padding.
-
-    // check if we have enough room to add the encrypted footer.
-    if (!dataBuf->isShared() &&
-        dataBuf->prev()->tailroom() >= sizeof(ContentType)) {
-      // extend it and add it
-      folly::io::Appender appender(dataBuf.get(), 0);
-      appender.writeBE(static_cast<ContentTypeType>(msg.type));
-    } else {
-      // not enough or shared - let's add enough for the tag as well
-      auto encryptedFooter = folly::IOBuf::create(
-          sizeof(ContentType) + aead_->getCipherOverhead());
-      folly::io::Appender appender(encryptedFooter.get(), 0);
-      appender.writeBE(static_cast<ContentTypeType>(msg.type));
-      dataBuf->prependChain(std::move(encryptedFooter));
+  return writeBatch(msg.type, queue);
+}
+
+bool EncryptedWriteRecordLayer::keyUpdateDue() const {
+  return keyUpdateLimitReached(0);
+}
+
+bool EncryptedWriteRecordLayer::keyUpdateLimitReached(
+    size_t pendingRecords) const {
+  return (keyUpdateLimits_.maxRecords != 0 &&
+          seqNum_ + pendingRecords >= keyUpdateLimits_.maxRecords) ||
+      (keyUpdateLimits_.maxBytes != 0 &&
+       bytesWritten_ >= keyUpdateLimits_.maxBytes);
+}
+
+Buf EncryptedWriteRecordLayer::writeAppDataUntilKeyUpdate(
+    folly::IOBufQueue& queue) const {
+  return writeRecords(ContentType::application_data, queue, true);
+}
+
+void EncryptedWriteRecordLayer::releaseIdleResources() const {
+  if (aead_) {
+    aead_->releaseIdleResources();
+  }
+  // Recreated from aead_ by the next parallel write.
+  workerAeads_.clear();
+}
+
+size_t EncryptedWriteRecordLayer::getCipherMemoryUsage() const {
+  size_t usage = aead_ ? aead_->getMemoryUsage() : 0;
+  for (const auto& aead : workerAeads_) {
+    usage += aead->getMemoryUsage();
+  }
+  return usage;
+}
+
+void EncryptedWriteRecordLayer::recordWritten(size_t dataLength) const {
+  if (recordSizePolicy_) {
+    recordSizePolicy_->recordWritten(dataLength);
+  }
+  bytesWritten_ += dataLength;
+  TLSStats::add(TLSCounter::RecordsEncrypted, 1);
+  TLSStats::add(TLSCounter::BytesEncrypted, dataLength);
+}
+
+void EncryptedWriteRecordLayer::writeHeader(
+    folly::IOBuf& header,
+    size_t dataLength,
+    uint64_t /* seqNum */) const {
+  header.clear();
+  folly::io::Appender appender(&header, 0);
+  appender.writeBE(static_cast<ContentTypeType>(ContentType::application_data));
+  appender.writeBE(static_cast<ProtocolVersionType>(recordVersion_));
+  auto ciphertextLength =
+      dataLength + sizeof(ContentType) + aead_->getCipherOverhead();
+  appender.writeBE<uint16_t>(ciphertextLength);
+}
+
+static void appendFooter(
+    folly::IOBuf& dataBuf,
+    ContentType type,
+    BufferPool* pool,
+    size_t cipherOverhead) {
+  // check if we have enough room to add the encrypted footer.
+  if (!dataBuf.isShared() &&
+      dataBuf.prev()->tailroom() >= sizeof(ContentType)) {
+    // extend it and add it
+    folly::io::Appender appender(&dataBuf, 0);
+    appender.writeBE(static_cast<ContentTypeType>(type));
+  } else {
+    // not enough or shared - let's add enough for the tag as well
+    auto encryptedFooter =
+        allocateBuffer(pool, sizeof(ContentType) + cipherOverhead);
+    folly::io::Appender appender(encryptedFooter.get(), 0);
+    appender.writeBE(static_cast<ContentTypeType>(type));
+    dataBuf.prependChain(std::move(encryptedFooter));
+  }
+}
+
+template <typename Func>
+bool EncryptedWriteRecordLayer::encryptRecordsParallel(
+    ContentType type,
+    folly::IOBufQueue& queue,
+    bool stopAtKeyUpdate,
+    Func onRecord) const {
+  const auto& options = parallelEncryption_;
+  if (!options.executor || options.parallelism < 2 ||
+      queue.chainLength() < options.minBytes) {
+    return false;
+  }
+  if (workerAeads_.empty()) {
+    for (size_t i = 0; i < options.parallelism; ++i) {
+      auto worker = aead_->clone();
+      if (!worker) {
+        workerAeads_.clear();
+        return false;
+      }
+      worker->setEncryptedBufferHeadroom(kEncryptedHeaderSize);
+      workerAeads_.push_back(std::move(worker));
     }
+  }
 
-    if (seqNum_ == std::numeric_limits<uint64_t>::max()) {
+  // Split the whole write into records on this thread, so that the record
+  // size policy and buffer pool are only ever used from here.
+  std::vector<std::unique_ptr<folly::IOBuf>> plaintexts;
+  std::deque<std::array<uint8_t, kEncryptedHeaderSize>> headers;
+  std::vector<folly::IOBuf> headerBufs;
+  std::vector<const folly::IOBuf*> associatedData;
+  while (!queue.empty() &&
+         !(stopAtKeyUpdate && keyUpdateLimitReached(plaintexts.size()))) {
+    auto dataBuf = getBufToEncrypt(queue);
+    auto dataLength = dataBuf->computeChainDataLength();
+    recordWritten(dataLength);
+    if (seqNum_ + plaintexts.size() == std::numeric_limits<uint64_t>::max()) {
       throw std::runtime_error("max write seq num");
     }
+    appendFooter(*dataBuf, type, bufferPool_.get(), aead_->getCipherOverhead());
+    headers.emplace_back();
+    headerBufs.push_back(
+        folly::IOBuf::wrapBufferAsValue(folly::range(headers.back())));
+    writeHeader(headerBufs.back(), dataLength, seqNum_ + plaintexts.size());
+    plaintexts.push_back(std::move(dataBuf));
+  }
+  // headerBufs is complete, so it is safe to take pointers into it now.
+  for (auto& header : headerBufs) {
+    associatedData.push_back(useAdditionalData_ ? &header : nullptr);
+  }
 
-    // we will either be able to memcpy directly into the ciphertext or
-    // need to create a new buf to insert before the ciphertext but we need
-    // it for additional data
-    header.clear();
-    folly::io::Appender appender(&header, 0);
-    appender.writeBE(
-        static_cast<ContentTypeType>(ContentType::application_data));
-    appender.writeBE(static_cast<ProtocolVersionType>(recordVersion_));
-    auto ciphertextLength =
-        dataBuf->computeChainDataLength() + aead_->getCipherOverhead();
-    appender.writeBE<uint16_t>(ciphertextLength);
-
-    auto cipherText = aead_->encrypt(
-        std::move(dataBuf), useAdditionalData_ ? &header : nullptr, seqNum_++);
-
-    std::unique_ptr<folly::IOBuf> record;
-    if (!cipherText->isShared() &&
-        cipherText->headroom() >= kEncryptedHeaderSize) {
-      // prepend and then write it in
-      cipherText->prepend(kEncryptedHeaderSize);
-      memcpy(cipherText->writableData(), header.data(), header.length());
-      record = std::move(cipherText);
-    } else {
-      record = folly::IOBuf::copyBuffer(header.data(), header.length());
-      record->prependChain(std::move(cipherText));
+  // Reserve the sequence numbers of every record before handing them out.
+  auto firstSeqNum = seqNum_;
+  seqNum_ += plaintexts.size();
+
+  std::vector<std::unique_ptr<folly::IOBuf>> cipherTexts(plaintexts.size());
+  auto numTasks = std::min(workerAeads_.size(), plaintexts.size());
+  auto perTask = (plaintexts.size() + numTasks - 1) / numTasks;
+  std::vector<folly::Function<void()>> tasks;
+  for (size_t task = 0, begin = 0; begin < plaintexts.size(); ++task) {
+    auto end = std::min(begin + perTask, plaintexts.size());
+    tasks.push_back([&, worker = workerAeads_[task].get(), begin, end]() {
+      for (size_t i = begin; i < end; i += kMaxRecordsPerBatch) {
+        auto batchEnd = std::min(i + kMaxRecordsPerBatch, end);
+        std::vector<std::unique_ptr<folly::IOBuf>> batch(
+            std::make_move_iterator(plaintexts.begin() + i),
+            std::make_move_iterator(plaintexts.begin() + batchEnd));
+        std::vector<const folly::IOBuf*> batchData(
+            associatedData.begin() + i, associatedData.begin() + batchEnd);
+        auto encrypted = worker->encryptBatch(
+            std::move(batch), batchData, firstSeqNum + i);
+        std::move(encrypted.begin(), encrypted.end(), cipherTexts.begin() + i);
+      }
+    });
+    begin = end;
+  }
+  runTasks(options.executor.get(), tasks);
+
+  for (size_t i = 0; i < cipherTexts.size(); ++i) {
+    protectHeader(headerBufs[i], *cipherTexts[i]);
+    onRecord(headerBufs[i], std::move(cipherTexts[i]));
+  }
+  return true;
+}
+
+template <typename Func>
+void EncryptedWriteRecordLayer::encryptRecords(
+    ContentType type,
+    folly::IOBufQueue& queue,
+    bool stopAtKeyUpdate,
+    Func onRecord) const {
+  if (!aead_) {
+    throw std::runtime_error("no aead set");
+  }
+  TLSStats::Timer timer(TLSCounter::EncryptNanos);
+  if (encryptRecordsParallel(type, queue, stopAtKeyUpdate, onRecord)) {
+    return;
+  }
+
+  std::vector<std::unique_ptr<folly::IOBuf>> plaintexts;
+  std::vector<std::array<uint8_t, kEncryptedHeaderSize>> headers;
+  std::vector<folly::IOBuf> headerBufs;
+  std::vector<const folly::IOBuf*> associatedData;
+  // The header bufs wrap the arrays in headers, so neither may reallocate
+  // while a batch is being built.
+  headers.reserve(kMaxRecordsPerBatch);
+  headerBufs.reserve(kMaxRecordsPerBatch);
+  aead_->setEncryptedBufferHeadroom(kEncryptedHeaderSize);
+
+  // Whether another record may be taken from queue. With stopAtKeyUpdate
+  // the limits are checked before each record, counting the records of the
+  // batch being built.
+  auto moreRecords = [&]() {
+    return !queue.empty() &&
+        !(stopAtKeyUpdate && keyUpdateLimitReached(plaintexts.size()));
+  };
+
+  // A shared record that ended the previous batch, waiting to be encrypted.
+  Buf sharedBuf;
+  while (moreRecords() || sharedBuf) {
+    plaintexts.clear();
+    headers.clear();
+    headerBufs.clear();
+    associatedData.clear();
+
+    while ((sharedBuf || moreRecords()) &&
+           plaintexts.size() < kMaxRecordsPerBatch) {
+      auto dataBuf = sharedBuf ? std::move(sharedBuf) : getBufToEncrypt(queue);
+      bool encryptShared =
+          dataBuf->isShared() && aead_->supportsEncryptIovecs();
+      if (encryptShared && !plaintexts.empty()) {
+        // Encrypt what we have so far first so that sequence numbers stay in
+        // order.
+        sharedBuf = std::move(dataBuf);
+        break;
+      }
+
+      auto dataLength = dataBuf->computeChainDataLength();
+      recordWritten(dataLength);
+      // Currently we never send padding.
+
+      if (seqNum_ + plaintexts.size() ==
+          std::numeric_limits<uint64_t>::max()) {
+        throw std::runtime_error("max write seq num");
+      }
+
+      if (encryptShared) {
+        // The data belongs to someone else (for example app data that is
+        // still referenced by the caller). Rather than chaining a footer and
+        // having the aead allocate and copy, encrypt straight from the
+        // shared memory into one output buffer with room for the header.
+        std::array<uint8_t, kEncryptedHeaderSize> headerData;
+        auto header = folly::IOBuf::wrapBufferAsValue(folly::range(headerData));
+        writeHeader(header, dataLength, seqNum_);
+        auto ciphertextLength =
+            dataLength + sizeof(ContentType) + aead_->getCipherOverhead();
+
+        auto iovecs = dataBuf->getIov();
+        auto footer = static_cast<ContentTypeType>(type);
+        iovecs.push_back({&footer, sizeof(footer)});
+        auto cipherText = allocateBuffer(
+            bufferPool_.get(), kEncryptedHeaderSize + ciphertextLength);
+        cipherText->advance(kEncryptedHeaderSize);
+        cipherText->append(ciphertextLength);
+        struct iovec output = {cipherText->writableData(), ciphertextLength};
+        aead_->encryptIovecs(
+            iovecs.data(),
+            iovecs.size(),
+            &output,
+            1,
+            useAdditionalData_ ? &header : nullptr,
+            seqNum_++);
+        protectHeader(header, *cipherText);
+        onRecord(header, std::move(cipherText));
+        continue;
+      }
+
+      appendFooter(
+          *dataBuf, type, bufferPool_.get(), aead_->getCipherOverhead());
+
+      // we will either be able to memcpy directly into the ciphertext or
+      // need to create a new buf to insert before the ciphertext but we need
+      // it for additional data
+      headers.emplace_back();
+      headerBufs.push_back(
+          folly::IOBuf::wrapBufferAsValue(folly::range(headers.back())));
+      auto& header = headerBufs.back();
+      writeHeader(header, dataLength, seqNum_ + plaintexts.size());
+      associatedData.push_back(useAdditionalData_ ? &header : nullptr);
+
+      plaintexts.push_back(std::move(dataBuf));
     }
 
-    if (!outBuf) {
-      outBuf = std::move(record);
-    } else {
-      outBuf->prependChain(std::move(record));
+    auto firstSeqNum = seqNum_;
+    seqNum_ += plaintexts.size();
+    auto cipherTexts = aead_->encryptBatch(
+        std::move(plaintexts), associatedData, firstSeqNum);
+    // Now counted in seqNum_.
+    plaintexts.clear();
+
+    for (size_t i = 0; i < cipherTexts.size(); ++i) {
+      protectHeader(headerBufs[i], *cipherTexts[i]);
+      onRecord(headerBufs[i], std::move(cipherTexts[i]));
     }
   }
+}
+
+Buf EncryptedWriteRecordLayer::writeBatch(
+    ContentType type,
+    folly::IOBufQueue& queue) const {
+  return writeRecords(type, queue, false);
+}
+
+Buf EncryptedWriteRecordLayer::writeRecords(
+    ContentType type,
+    folly::IOBufQueue& queue,
+    bool stopAtKeyUpdate) const {
+  AllocationStats::Scope allocationScope(AllocationSite::RecordLayer);
+  std::unique_ptr<folly::IOBuf> outBuf;
+  encryptRecords(
+      type,
+      queue,
+      stopAtKeyUpdate,
+      [&](const folly::IOBuf& header, Buf cipherText) {
+        appendRecord(outBuf, header, std::move(cipherText));
+      });
 
   if (!outBuf) {
     outBuf = folly::IOBuf::create(0);
@@ -204,14 +808,79 @@ Buf EncryptedWriteRecordLayer::write(TLSMessage&& msg) const {
   return outBuf;
 }
 
+void EncryptedWriteRecordLayer::appendRecord(
+    Buf& outBuf,
+    const folly::IOBuf& header,
+    Buf cipherText) {
+  std::unique_ptr<folly::IOBuf> record;
+  if (!cipherText->isShared() &&
+      cipherText->headroom() >= kEncryptedHeaderSize) {
+    // prepend and then write it in
+    cipherText->prepend(kEncryptedHeaderSize);
+    memcpy(cipherText->writableData(), header.data(), header.length());
+    record = std::move(cipherText);
+  } else {
+    record = folly::IOBuf::copyBuffer(header.data(), header.length());
+    record->prependChain(std::move(cipherText));
+  }
+
+  if (!outBuf) {
+    outBuf = std::move(record);
+  } else {
+    outBuf->prependChain(std::move(record));
+  }
+}
+
+size_t EncryptedWriteRecordLayer::writeIovecs(
+    TLSMessage&& msg,
+    RecordIovecs& out) const {
+  folly::IOBufQueue queue;
+  queue.append(std::move(msg.fragment));
+  writeRecordIovecs(msg.type, queue, false, out);
+  return out.iovecs.size();
+}
+
+void EncryptedWriteRecordLayer::writeAppDataIovecsUntilKeyUpdate(
+    folly::IOBufQueue& queue,
+    RecordIovecs& out) const {
+  writeRecordIovecs(ContentType::application_data, queue, true, out);
+}
+
+void EncryptedWriteRecordLayer::writeRecordIovecs(
+    ContentType type,
+    folly::IOBufQueue& queue,
+    bool stopAtKeyUpdate,
+    RecordIovecs& out) const {
+  AllocationStats::Scope allocationScope(AllocationSite::RecordLayer);
+  encryptRecords(
+      type,
+      queue,
+      stopAtKeyUpdate,
+      [&](const folly::IOBuf& header, Buf cipherText) {
+        // headers is a deque so references to earlier headers stay valid as
+        // it grows.
+        out.headers.emplace_back();
+        auto& headerData = out.headers.back();
+        memcpy(headerData.data(), header.data(), headerData.size());
+        out.iovecs.push_back({headerData.data(), headerData.size()});
+        out.append(std::move(cipherText));
+      });
+}
+
 Buf EncryptedWriteRecordLayer::getBufToEncrypt(folly::IOBufQueue& queue) const {
   static constexpr size_t kMinSuggestedRecordSize = 1500;
-  if (queue.front()->length() > maxRecord_) {
-    return queue.splitAtMost(maxRecord_);
-  } else if (queue.front()->length() >= kMinSuggestedRecordSize) {
+  size_t maxRecord = maxRecord_;
+  if (recordSizePolicy_) {
+    maxRecord =
+        std::min<size_t>(maxRecord, recordSizePolicy_->getMaxRecordSize());
+  }
+  auto minSuggestedRecord = std::min(maxRecord, kMinSuggestedRecordSize);
+  if (queue.front()->length() > maxRecord) {
+    return queue.splitAtMost(maxRecord);
+  } else if (queue.front()->length() >= minSuggestedRecord) {
     return queue.pop_front();
   } else {
-    return queue.splitAtMost(kMinSuggestedRecordSize);
+    return queue.splitAtMost(minSuggestedRecord);
   }
 }
 } // namespace fizz
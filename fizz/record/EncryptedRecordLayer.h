@@ -11,28 +11,209 @@
 #include <fizz/record/RecordLayer.h>
 
 #include <fizz/crypto/aead/Aead.h>
+#include <fizz/record/RecordSizePolicy.h>
+#include <folly/Executor.h>
+#include <sys/uio.h>
+
+#include <array>
+#include <cstring>
+#include <deque>
+#include <limits>
 
 namespace fizz {
 
 constexpr uint16_t kMaxPlaintextRecordSize = 0x4000; // 16k
+constexpr size_t kEncryptedHeaderSize =
+    sizeof(ContentType) + sizeof(ProtocolVersion) + sizeof(uint16_t);
+
+/**
+ * Caller owned output of WriteRecordLayer::writeIovecs. Records are appended
+ * to it, so it can hold the output of several writes, and it can be clear()ed
+ * and reused to avoid reallocating the iovec and header storage.
+ */
+struct RecordIovecs {
+  // Slices of the encoded records, in order. They point into headers and data.
+  std::vector<iovec> iovecs;
+
+  // Record headers referenced by iovecs.
+  std::deque<std::array<uint8_t, kEncryptedHeaderSize>> headers;
+
+  // Ciphertexts referenced by iovecs. Must be kept alive until the iovecs
+  // have been written.
+  Buf data;
+
+  /**
+   * Append already encoded records.
+   */
+  void append(Buf records) {
+    if (!records) {
+      return;
+    }
+    for (auto range : *records) {
+      if (!range.empty()) {
+        iovecs.push_back({const_cast<uint8_t*>(range.data()), range.size()});
+      }
+    }
+    if (!data) {
+      data = std::move(records);
+    } else {
+      data->prependChain(std::move(records));
+    }
+  }
+
+  /**
+   * Copies the records into a single buffer, for callers that need to write
+   * them along with other data.
+   */
+  Buf copyRecords() const {
+    size_t length = 0;
+    for (const auto& iov : iovecs) {
+      length += iov.iov_len;
+    }
+    auto buf = folly::IOBuf::create(length);
+    for (const auto& iov : iovecs) {
+      memcpy(buf->writableTail(), iov.iov_base, iov.iov_len);
+      buf->append(iov.iov_len);
+    }
+    return buf;
+  }
+
+  void clear() {
+    iovecs.clear();
+    headers.clear();
+    data.reset();
+  }
+};
+
+/**
+ * Settings for encrypting large writes on a pool of threads. Writes of at
+ * least minBytes are split into records up front, and contiguous runs of
+ * records are encrypted concurrently with copies of the aead. The writing
+ * thread waits for all of them before returning the records in order, and
+ * encrypts the runs the executor hasn't started yet itself, so the executor
+ * may be the writing thread's own EventBase.
+ */
+struct ParallelEncryptionOptions {
+  std::shared_ptr<folly::Executor> executor;
+
+  // Smallest write, in bytes, that is encrypted in parallel.
+  size_t minBytes{256 * 1024};
+
+  // Maximum number of concurrent encryption tasks per write.
+  size_t parallelism{4};
+};
+
+/**
+ * Settings for decrypting records on a pool of threads. Once at least
+ * minBytes of complete records are buffered, they are decrypted concurrently
+ * with copies of the aead, in contiguous runs, and then returned one at a
+ * time in order. The reading thread waits for all of them, decrypting the
+ * runs the executor hasn't started yet itself.
+ */
+struct ParallelDecryptionOptions {
+  std::shared_ptr<folly::Executor> executor;
+
+  // Smallest amount of complete records, in bytes, decrypted in parallel.
+  size_t minBytes{64 * 1024};
+
+  // Maximum number of concurrent decryption tasks.
+  size_t parallelism{4};
+};
+
+/**
+ * Usage limits for the keys of an EncryptedWriteRecordLayer. Once either is
+ * reached the record layer reports that a key update is due. A limit of 0 is
+ * not enforced.
+ */
+struct KeyUpdateLimits {
+  // Records protected with the same key.
+  uint64_t maxRecords{0};
+
+  // Plaintext bytes protected with the same key.
+  uint64_t maxBytes{0};
+};
 
 class EncryptedReadRecordLayer : public ReadRecordLayer {
  public:
+  explicit EncryptedReadRecordLayer(
+      EncryptionLevel encryptionLevel = EncryptionLevel::AppTraffic)
+      : encryptionLevel_(encryptionLevel) {}
+
   ~EncryptedReadRecordLayer() override = default;
 
   folly::Optional<TLSMessage> read(folly::IOBufQueue& buf) override;
 
+  RecordLayerResult<folly::Optional<TLSMessage>> tryRead(
+      folly::IOBufQueue& buf) override;
+
+  EncryptionLevel getEncryptionLevel() const override {
+    return encryptionLevel_;
+  }
+
+  /**
+   * Called with the traffic secret this record layer's aead is derived from,
+   * just before setAead(). Does nothing by default. Record layers that leave
+   * protection to their user, such as those a QUIC stack returns from its
+   * Factory, can take the secret here and derive their own keys.
+   */
+  virtual void trafficSecretAvailable(
+      CipherSuite /* cipher */,
+      folly::ByteRange /* secret */) {}
+
+  /**
+   * Called on the record layers made for the application traffic keys that
+   * the generation-th key update produced, before trafficSecretAvailable().
+   * Does nothing by default; DTLS derives the epoch from it.
+   */
+  virtual void setKeyUpdateGeneration(uint32_t /* generation */) {}
+
   virtual void setAead(std::unique_ptr<Aead> aead) {
     if (seqNum_ != 0) {
       throw std::runtime_error("aead set after read");
     }
     aead_ = std::move(aead);
+    workerAeads_.clear();
   }
 
   virtual void setSkipFailedDecryption(bool enabled) {
     skipFailedDecryption_ = enabled;
   }
 
+  /**
+   * Limits how much setSkipFailedDecryption() skips (counted as ciphertext
+   * less the aead overhead), eg to the max_early_data_size when early data
+   * is rejected. Reading fails once more has been skipped.
+   */
+  void setMaxSkippedBytes(size_t maxSkippedBytes) {
+    maxSkippedBytes_ = maxSkippedBytes;
+  }
+
+  /**
+   * While skipping failed decryptions, records longer than
+   * maxPlaintextLength (plus the aead overhead) are skipped without trying to
+   * decrypt them. For when the first record that decrypts is known to be
+   * small. 0 (the default) tries every record.
+   */
+  void setFastSkipLength(size_t maxPlaintextLength) {
+    fastSkipLength_ = maxPlaintextLength;
+  }
+
+  /**
+   * Decrypt large amounts of buffered records on options.executor. Only takes
+   * effect if the aead supports clone(), and not while failed decryptions are
+   * skipped. Records decrypted this way are not decrypted into a
+   * PlaintextBufferProvider's memory. Pass default options to disable.
+   */
+  void setParallelDecryption(ParallelDecryptionOptions options) {
+    parallelDecryption_ = std::move(options);
+    workerAeads_.clear();
+  }
+
+  void releaseIdleResources() override;
+
+  // Includes the copies of the aead used for parallel decryption.
+  size_t getCipherMemoryUsage() const override;
+
   void setProtocolVersion(ProtocolVersion version) {
     auto realVersion = getRealDraftVersion(version);
     if (realVersion == ProtocolVersion::tls_1_3_23 ||
@@ -45,28 +226,137 @@ class EncryptedReadRecordLayer : public ReadRecordLayer {
     }
   }
 
+  /**
+   * The aead and the sequence number of the next record to be read. Used to
+   * export the record protection state, eg to hand it over to the kernel.
+   */
+  const Aead* getAead() const {
+    return aead_.get();
+  }
+
+  uint64_t getSequenceNumber() const {
+    return seqNum_;
+  }
+
+  /**
+   * Continue from seqNum, for a record protection state imported from
+   * elsewhere. Must be called after setAead().
+   */
+  void setSequenceNumber(uint64_t seqNum) {
+    seqNum_ = seqNum;
+    parallelRecords_.clear();
+  }
+
  private:
-  folly::Optional<Buf> getDecryptedBuf(folly::IOBufQueue& buf);
+  RecordLayerResult<folly::Optional<Buf>> getDecryptedBuf(
+      folly::IOBufQueue& buf);
+
+  /**
+   * Decrypts the complete records at the front of buf in parallel into
+   * parallelRecords_, if parallel decryption is enabled and enough of them
+   * are buffered. buf is left untouched. Returns whether it did.
+   */
+  bool decryptRecordsParallel(const folly::IOBufQueue& buf);
+
+  static RecordLayerResult<folly::Optional<TLSMessage>> checkDecryptedMessage(
+      TLSMessage msg);
+
+  EncryptionLevel encryptionLevel_;
 
   std::unique_ptr<Aead> aead_;
   bool skipFailedDecryption_{false};
+  size_t maxSkippedBytes_{std::numeric_limits<size_t>::max()};
+  size_t skippedBytes_{0};
+  size_t fastSkipLength_{0};
+
+  // Front buffer of the read queue that only shares memory with records we
+  // already split out of it (and inPlaceRef_), and can therefore still be
+  // decrypted in place. inPlaceRef_ keeps its memory from being reused.
+  const folly::IOBuf* inPlaceFront_{nullptr};
+  std::unique_ptr<folly::IOBuf> inPlaceRef_;
 
   bool useAdditionalData_{true};
 
+  ParallelDecryptionOptions parallelDecryption_;
+  // Copies of aead_ used by parallel decryption tasks, one per task.
+  std::vector<std::unique_ptr<Aead>> workerAeads_;
+
+  // A record at the front of the read queue that has already been decrypted
+  // in parallel. It is only removed from the queue when returned.
+  struct ParallelRecord {
+    // Header and ciphertext.
+    size_t length;
+    // none if decryption failed.
+    folly::Optional<Buf> plaintext;
+  };
+  std::deque<ParallelRecord> parallelRecords_;
+
   mutable uint64_t seqNum_{0};
 };
 
 class EncryptedWriteRecordLayer : public WriteRecordLayer {
  public:
+  static constexpr size_t kMaxRecordsPerBatch = 16;
+
+  explicit EncryptedWriteRecordLayer(
+      EncryptionLevel encryptionLevel = EncryptionLevel::AppTraffic)
+      : encryptionLevel_(encryptionLevel) {}
+
   ~EncryptedWriteRecordLayer() override = default;
 
   Buf write(TLSMessage&& msg) const override;
 
+  EncryptionLevel getEncryptionLevel() const override {
+    return encryptionLevel_;
+  }
+
+  /**
+   * Called with the traffic secret this record layer's aead is derived from,
+   * just before setAead(). Does nothing by default; see
+   * EncryptedReadRecordLayer::trafficSecretAvailable().
+   */
+  virtual void trafficSecretAvailable(
+      CipherSuite /* cipher */,
+      folly::ByteRange /* secret */) {}
+
+  /**
+   * See EncryptedReadRecordLayer::setKeyUpdateGeneration().
+   */
+  virtual void setKeyUpdateGeneration(uint32_t /* generation */) {}
+
+  /**
+   * Encrypts all of queue as records of the given content type. Records are
+   * handed to the aead in batches of up to kMaxRecordsPerBatch so that
+   * implementations can amortize setup across multiple records.
+   */
+  Buf writeBatch(ContentType type, folly::IOBufQueue& queue) const;
+
+  /**
+   * Record headers are written into out.headers instead of separately
+   * allocated IOBufs.
+   */
+  size_t writeIovecs(TLSMessage&& msg, RecordIovecs& out) const override;
+
   virtual void setAead(std::unique_ptr<Aead> aead) {
     if (seqNum_ != 0) {
       throw std::runtime_error("aead set after write");
     }
     aead_ = std::move(aead);
+    if (bufferPool_) {
+      aead_->setBufferPool(bufferPool_);
+    }
+    workerAeads_.clear();
+  }
+
+  /**
+   * Set a pool to allocate record footers from. It is also passed on to the
+   * aead for ciphertext and tag allocations.
+   */
+  void setBufferPool(std::shared_ptr<BufferPool> pool) {
+    bufferPool_ = std::move(pool);
+    if (aead_) {
+      aead_->setBufferPool(bufferPool_);
+    }
   }
 
   void setMaxRecord(uint16_t size) {
@@ -75,13 +365,141 @@ class EncryptedWriteRecordLayer : public WriteRecordLayer {
     maxRecord_ = size;
   }
 
+  /**
+   * Set a policy that decides the size of each record. Records will never be
+   * larger than the max record size set above.
+   */
+  void setRecordSizePolicy(std::unique_ptr<RecordSizePolicy> policy) {
+    recordSizePolicy_ = std::move(policy);
+  }
+
+  /**
+   * Encrypt large writes on options.executor. Only takes effect if the aead
+   * supports clone(). Pass default options to disable.
+   */
+  void setParallelEncryption(ParallelEncryptionOptions options) {
+    parallelEncryption_ = std::move(options);
+    workerAeads_.clear();
+  }
+
+  /**
+   * Set the limits after which keyUpdateDue() returns true. Limits are
+   * checked against everything written with the current aead.
+   */
+  void setKeyUpdateLimits(KeyUpdateLimits limits) {
+    keyUpdateLimits_ = limits;
+  }
+
+  bool keyUpdateDue() const override;
+
+  Buf writeAppDataUntilKeyUpdate(folly::IOBufQueue& queue) const override;
+
+  void writeAppDataIovecsUntilKeyUpdate(
+      folly::IOBufQueue& queue,
+      RecordIovecs& out) const override;
+
+  void releaseIdleResources() const override;
+
+  // Includes the copies of the aead used for parallel encryption.
+  size_t getCipherMemoryUsage() const override;
+
+  /**
+   * The aead and the sequence number of the next record to be written.
+   */
+  const Aead* getAead() const {
+    return aead_.get();
+  }
+
+  uint64_t getSequenceNumber() const {
+    return seqNum_;
+  }
+
+  /**
+   * Continue from seqNum; see EncryptedReadRecordLayer::setSequenceNumber().
+   */
+  void setSequenceNumber(uint64_t seqNum) {
+    seqNum_ = seqNum;
+  }
+
+  /**
+   * Plaintext bytes written with the current aead.
+   */
+  uint64_t getBytesWritten() const {
+    return bytesWritten_;
+  }
+
+ protected:
+  /**
+   * Writes the kEncryptedHeaderSize byte header of the record with sequence
+   * number seqNum and dataLength bytes of content into header. It is the
+   * additional data of the record.
+   */
+  virtual void
+  writeHeader(folly::IOBuf& header, size_t dataLength, uint64_t seqNum) const;
+
+  /**
+   * Called with the header and ciphertext of each record once it is
+   * encrypted, before it is written out. Does nothing by default; DTLS
+   * encrypts the sequence number in the header here.
+   */
+  virtual void protectHeader(
+      folly::IOBuf& /* header */,
+      const folly::IOBuf& /* cipherText */) const {}
+
  private:
   Buf getBufToEncrypt(folly::IOBufQueue& queue) const;
 
+  void recordWritten(size_t dataLength) const;
+
+  /**
+   * Whether the key update limits are reached once pendingRecords records,
+   * already counted in bytesWritten_ but not yet in seqNum_, are encrypted.
+   */
+  bool keyUpdateLimitReached(size_t pendingRecords) const;
+
+  Buf writeRecords(
+      ContentType type,
+      folly::IOBufQueue& queue,
+      bool stopAtKeyUpdate) const;
+
+  template <typename Func>
+  void encryptRecords(
+      ContentType type,
+      folly::IOBufQueue& queue,
+      bool stopAtKeyUpdate,
+      Func onRecord) const;
+
+  template <typename Func>
+  bool encryptRecordsParallel(
+      ContentType type,
+      folly::IOBufQueue& queue,
+      bool stopAtKeyUpdate,
+      Func onRecord) const;
+
+  static void
+  appendRecord(Buf& outBuf, const folly::IOBuf& header, Buf cipherText);
+
+  void writeRecordIovecs(
+      ContentType type,
+      folly::IOBufQueue& queue,
+      bool stopAtKeyUpdate,
+      RecordIovecs& out) const;
+
+  EncryptionLevel encryptionLevel_;
+
   std::unique_ptr<Aead> aead_;
 
   uint16_t maxRecord_{kMaxPlaintextRecordSize};
+  std::unique_ptr<RecordSizePolicy> recordSizePolicy_;
+  std::shared_ptr<BufferPool> bufferPool_;
+
+  ParallelEncryptionOptions parallelEncryption_;
+  // Copies of aead_ used by parallel encryption tasks, one per task.
+  mutable std::vector<std::unique_ptr<Aead>> workerAeads_;
+
+  KeyUpdateLimits keyUpdateLimits_;
 
   mutable uint64_t seqNum_{0};
+  mutable uint64_t bytesWritten_{0};
 };
 } // namespace fizz
@@ -6,6 +6,7 @@
  *  LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
 #include <vector>
 
 #include <fizz/record/Types.h>
@@ -143,6 +144,73 @@ inline PskKeyExchangeModes getExtension(folly::io::Cursor& cs) {
   return modes;
 }
 
+template <>
+inline CertificateStatusRequest getExtension(folly::io::Cursor& cs) {
+  CertificateStatusRequest request;
+  detail::read(request.status_type, cs);
+  detail::readBuf<uint16_t>(request.responder_id_list, cs);
+  detail::readBuf<uint16_t>(request.request_extensions, cs);
+  return request;
+}
+
+template <>
+inline CertificateStatus getExtension(folly::io::Cursor& cs) {
+  CertificateStatus status;
+  detail::read(status.status_type, cs);
+  detail::readBuf<detail::bits24>(status.ocsp_response, cs);
+  return status;
+}
+
+template <>
+inline SignedCertificateTimestamps getExtension(folly::io::Cursor& cs) {
+  SignedCertificateTimestamps scts;
+  if (cs.isAtEnd()) {
+    scts.sct_list = folly::IOBuf::create(0);
+  } else {
+    detail::readBuf<uint16_t>(scts.sct_list, cs);
+  }
+  return scts;
+}
+
+template <>
+inline ServerCertTypeList getExtension(folly::io::Cursor& cs) {
+  ServerCertTypeList types;
+  detail::readVector<uint8_t>(types.certificate_types, cs);
+  return types;
+}
+
+template <>
+inline ServerCertType getExtension(folly::io::Cursor& cs) {
+  ServerCertType type;
+  detail::read(type.certificate_type, cs);
+  return type;
+}
+
+template <>
+inline DelegatedCredentialSupport getExtension(folly::io::Cursor& cs) {
+  DelegatedCredentialSupport support;
+  detail::readVector<uint16_t>(support.supported_signature_algorithms, cs);
+  return support;
+}
+
+template <>
+inline DelegatedCredential getExtension(folly::io::Cursor& cs) {
+  DelegatedCredential credential;
+  detail::read(credential.valid_time, cs);
+  detail::read(credential.expected_verify_scheme, cs);
+  detail::readBuf<detail::bits24>(credential.public_key, cs);
+  detail::read(credential.credential_scheme, cs);
+  detail::readBuf<uint16_t>(credential.signature, cs);
+  return credential;
+}
+
+template <>
+inline CertificateCompressionAlgorithms getExtension(folly::io::Cursor& cs) {
+  CertificateCompressionAlgorithms cca;
+  detail::readVector<uint8_t>(cca.algorithms, cs);
+  return cca;
+}
+
 template <>
 inline ProtocolNameList getExtension(folly::io::Cursor& cs) {
   ProtocolNameList names;
@@ -184,12 +252,25 @@ inline Extension encodeExtension(const SupportedGroups& groups) {
   return ext;
 }
 
+namespace detail {
+inline size_t getKeyShareEntrySize(const KeyShareEntry& entry) {
+  return sizeof(NamedGroup) + sizeof(uint16_t) +
+      (entry.key_exchange ? entry.key_exchange->computeChainDataLength() : 0);
+}
+} // namespace detail
+
 template <>
 inline Extension encodeExtension(const ClientKeyShare& share) {
   Extension ext;
   ext.extension_type = share.preDraft23 ? ExtensionType::key_share_old
                                         : ExtensionType::key_share;
-  ext.extension_data = folly::IOBuf::create(0);
+  // Shares can be large (for post-quantum groups), so size the buffer up
+  // front rather than growing it in small chunks.
+  size_t len = sizeof(uint16_t);
+  for (const auto& entry : share.client_shares) {
+    len += detail::getKeyShareEntrySize(entry);
+  }
+  ext.extension_data = folly::IOBuf::create(len);
   folly::io::Appender appender(ext.extension_data.get(), 10);
   detail::writeVector<uint16_t>(share.client_shares, appender);
   return ext;
@@ -200,7 +281,8 @@ inline Extension encodeExtension(const ServerKeyShare& share) {
   Extension ext;
   ext.extension_type = share.preDraft23 ? ExtensionType::key_share_old
                                         : ExtensionType::key_share;
-  ext.extension_data = folly::IOBuf::create(0);
+  ext.extension_data =
+      folly::IOBuf::create(detail::getKeyShareEntrySize(share.server_share));
   folly::io::Appender appender(ext.extension_data.get(), 10);
   detail::write(share.server_share, appender);
   return ext;
@@ -304,6 +386,96 @@ inline Extension encodeExtension(const PskKeyExchangeModes& modes) {
   return ext;
 }
 
+template <>
+inline Extension encodeExtension(const CertificateStatusRequest& request) {
+  Extension ext;
+  ext.extension_type = ExtensionType::status_request;
+  ext.extension_data = folly::IOBuf::create(0);
+  folly::io::Appender appender(ext.extension_data.get(), 10);
+  detail::write(request.status_type, appender);
+  detail::writeBuf<uint16_t>(request.responder_id_list, appender);
+  detail::writeBuf<uint16_t>(request.request_extensions, appender);
+  return ext;
+}
+
+template <>
+inline Extension encodeExtension(const CertificateStatus& status) {
+  Extension ext;
+  ext.extension_type = ExtensionType::status_request;
+  ext.extension_data = folly::IOBuf::create(0);
+  folly::io::Appender appender(ext.extension_data.get(), 10);
+  detail::write(status.status_type, appender);
+  detail::writeBuf<detail::bits24>(status.ocsp_response, appender);
+  return ext;
+}
+
+template <>
+inline Extension encodeExtension(const SignedCertificateTimestamps& scts) {
+  Extension ext;
+  ext.extension_type = ExtensionType::signed_certificate_timestamp;
+  ext.extension_data = folly::IOBuf::create(0);
+  if (scts.sct_list && !scts.sct_list->empty()) {
+    folly::io::Appender appender(ext.extension_data.get(), 10);
+    detail::writeBuf<uint16_t>(scts.sct_list, appender);
+  }
+  return ext;
+}
+
+template <>
+inline Extension encodeExtension(const ServerCertTypeList& types) {
+  Extension ext;
+  ext.extension_type = ExtensionType::server_certificate_type;
+  ext.extension_data = folly::IOBuf::create(0);
+  folly::io::Appender appender(ext.extension_data.get(), 10);
+  detail::writeVector<uint8_t>(types.certificate_types, appender);
+  return ext;
+}
+
+template <>
+inline Extension encodeExtension(const ServerCertType& type) {
+  Extension ext;
+  ext.extension_type = ExtensionType::server_certificate_type;
+  ext.extension_data = folly::IOBuf::create(0);
+  folly::io::Appender appender(ext.extension_data.get(), 10);
+  detail::write(type.certificate_type, appender);
+  return ext;
+}
+
+template <>
+inline Extension encodeExtension(const DelegatedCredentialSupport& support) {
+  Extension ext;
+  ext.extension_type = ExtensionType::delegated_credential;
+  ext.extension_data = folly::IOBuf::create(0);
+  folly::io::Appender appender(ext.extension_data.get(), 10);
+  detail::writeVector<uint16_t>(
+      support.supported_signature_algorithms, appender);
+  return ext;
+}
+
+template <>
+inline Extension encodeExtension(const DelegatedCredential& credential) {
+  Extension ext;
+  ext.extension_type = ExtensionType::delegated_credential;
+  ext.extension_data = folly::IOBuf::create(0);
+  folly::io::Appender appender(ext.extension_data.get(), 10);
+  detail::write(credential.valid_time, appender);
+  detail::write(credential.expected_verify_scheme, appender);
+  detail::writeBuf<detail::bits24>(credential.public_key, appender);
+  detail::write(credential.credential_scheme, appender);
+  detail::writeBuf<uint16_t>(credential.signature, appender);
+  return ext;
+}
+
+template <>
+inline Extension encodeExtension(const CertificateCompressionAlgorithms& cca) {
+  Extension ext;
+  ext.extension_type = ExtensionType::compress_certificate;
+  ext.extension_data = folly::IOBuf::create(0);
+  folly::io::Appender appender(ext.extension_data.get(), 10);
+  detail::writeVector<uint8_t>(cca.algorithms, appender);
+  return ext;
+}
+
 template <>
 inline Extension encodeExtension(const ProtocolNameList& names) {
   Extension ext;
@@ -357,6 +529,86 @@ inline size_t getBinderLength(const ClientHello& chlo) {
   return sizeof(binderLen) + binderLen;
 }
 
+inline ExtensionIndex::ExtensionIndex(
+    const std::vector<Extension>& extensions) {
+  for (const auto& ext : extensions) {
+    auto type = static_cast<uint16_t>(ext.extension_type);
+    if (type < kDirectTypes) {
+      if (!direct_[type]) {
+        direct_[type] = &ext;
+      }
+    } else if (!find(ext.extension_type)) {
+      auto it = std::upper_bound(
+          sparse_.begin(),
+          sparse_.end(),
+          ext.extension_type,
+          [](ExtensionType t, const Extension* e) {
+            return t < e->extension_type;
+          });
+      sparse_.insert(it, &ext);
+    }
+  }
+}
+
+inline const Extension* ExtensionIndex::find(ExtensionType type) const {
+  auto value = static_cast<uint16_t>(type);
+  if (value < kDirectTypes) {
+    return direct_[value];
+  }
+  auto it = std::lower_bound(
+      sparse_.begin(),
+      sparse_.end(),
+      type,
+      [](const Extension* e, ExtensionType t) {
+        return e->extension_type < t;
+      });
+  if (it != sparse_.end() && (*it)->extension_type == type) {
+    return *it;
+  }
+  return nullptr;
+}
+
+template <class T>
+const folly::Optional<T>& ExtensionIndex::get() const {
+  auto& slot = parsed_[std::type_index(typeid(T))];
+  if (!slot) {
+    // Only memoized once decoded successfully.
+    auto parsed = std::make_shared<folly::Optional<T>>(parse<T>());
+    slot = std::move(parsed);
+  }
+  return *static_cast<const folly::Optional<T>*>(slot.get());
+}
+
+template <class T>
+folly::Optional<T> ExtensionIndex::parse() const {
+  auto ext = find(T::extension_type);
+  if (!ext) {
+    return folly::none;
+  }
+  folly::io::Cursor cs{ext->extension_data.get()};
+  auto ret = getExtension<T>(cs);
+  if (!cs.isAtEnd()) {
+    throw std::runtime_error("didn't read entire extension");
+  }
+  return std::move(ret);
+}
+
+template <>
+inline folly::Optional<ClientKeyShare> ExtensionIndex::parse() const {
+  ClientKeyShare share;
+  auto ext = find(ExtensionType::key_share);
+  if (!ext) {
+    ext = find(ExtensionType::key_share_old);
+    if (!ext) {
+      return folly::none;
+    }
+    share.preDraft23 = true;
+  }
+  folly::io::Cursor cs{ext->extension_data.get()};
+  detail::readVector<uint16_t>(share.client_shares, cs);
+  return std::move(share);
+}
+
 namespace detail {
 
 template <>
@@ -11,6 +11,11 @@
 #include <fizz/record/Types.h>
 #include <folly/Optional.h>
 
+#include <array>
+#include <memory>
+#include <typeindex>
+#include <unordered_map>
+
 namespace fizz {
 
 struct SignatureAlgorithms {
@@ -107,6 +112,85 @@ struct PskKeyExchangeModes {
       ExtensionType::psk_key_exchange_modes;
 };
 
+/**
+ * delegated_credential as sent in a ClientHello, listing the signature
+ * schemes the client accepts in a CertificateVerify made with a delegated
+ * credential.
+ */
+struct DelegatedCredentialSupport {
+  std::vector<SignatureScheme> supported_signature_algorithms;
+  static constexpr ExtensionType extension_type =
+      ExtensionType::delegated_credential;
+};
+
+/**
+ * delegated_credential as sent in the leaf CertificateEntry.
+ * public_key is the DER encoded SubjectPublicKeyInfo of the credential and
+ * valid_time is in seconds from the leaf certificate's notBefore. signature
+ * is made by the leaf certificate with credential_scheme.
+ */
+struct DelegatedCredential {
+  uint32_t valid_time;
+  SignatureScheme expected_verify_scheme;
+  Buf public_key;
+  SignatureScheme credential_scheme;
+  Buf signature;
+  static constexpr ExtensionType extension_type =
+      ExtensionType::delegated_credential;
+};
+
+struct CertificateCompressionAlgorithms {
+  std::vector<CertificateCompressionAlgorithm> algorithms;
+  static constexpr ExtensionType extension_type =
+      ExtensionType::compress_certificate;
+};
+
+/**
+ * status_request as sent in a ClientHello. responder_id_list and
+ * request_extensions are kept encoded.
+ */
+struct CertificateStatusRequest {
+  CertificateStatusType status_type;
+  Buf responder_id_list;
+  Buf request_extensions;
+  static constexpr ExtensionType extension_type =
+      ExtensionType::status_request;
+};
+
+/**
+ * status_request as sent in the leaf CertificateEntry, carrying the stapled
+ * OCSP response.
+ */
+struct CertificateStatus {
+  CertificateStatusType status_type;
+  Buf ocsp_response;
+  static constexpr ExtensionType extension_type =
+      ExtensionType::status_request;
+};
+
+/**
+ * signed_certificate_timestamp (RFC 6962). Empty in a ClientHello, in the
+ * leaf CertificateEntry sct_list holds the contents of the
+ * SignedCertificateTimestampList.
+ */
+struct SignedCertificateTimestamps {
+  Buf sct_list;
+  static constexpr ExtensionType extension_type =
+      ExtensionType::signed_certificate_timestamp;
+};
+
+struct ServerCertTypeList {
+  std::vector<CertificateType> certificate_types;
+  static constexpr ExtensionType extension_type =
+      ExtensionType::server_certificate_type;
+};
+
+struct ServerCertType {
+  CertificateType certificate_type;
+  static constexpr ExtensionType extension_type =
+      ExtensionType::server_certificate_type;
+};
+
 struct ProtocolName {
   Buf name;
 };
@@ -158,6 +242,43 @@ std::vector<Extension>::const_iterator findExtension(
     ExtensionType type);
 
 size_t getBinderLength(const ClientHello& chlo);
+
+/**
+ * Index over a message's extensions, for messages whose extensions are looked
+ * up many times, such as the ClientHello on the server. Lookups by type are
+ * constant time for the common (small) extension types, and each extension is
+ * decoded at most once, on first use.
+ *
+ * The index points at the extensions themselves, which must outlive it.
+ * Moving the vector holding them is fine. Not thread safe.
+ */
+class ExtensionIndex {
+ public:
+  explicit ExtensionIndex(const std::vector<Extension>& extensions);
+
+  /**
+   * Returns the first extension of type, or nullptr.
+   */
+  const Extension* find(ExtensionType type) const;
+
+  /**
+   * Returns the decoded extension T, same as getExtension<T>(extensions).
+   * Decoding errors are thrown on every call.
+   */
+  template <class T>
+  const folly::Optional<T>& get() const;
+
+ private:
+  template <class T>
+  folly::Optional<T> parse() const;
+
+  static constexpr size_t kDirectTypes = 64;
+
+  std::array<const Extension*, kDirectTypes> direct_{};
+  // Extensions with larger types, sorted by type.
+  std::vector<const Extension*> sparse_;
+  mutable std::unordered_map<std::type_index, std::shared_ptr<void>> parsed_;
+};
 } // namespace fizz
 
 #include <fizz/record/Extensions-inl.h>
@@ -8,7 +8,10 @@
 
 #include <fizz/record/PlaintextRecordLayer.h>
 
+#include <fizz/protocol/AllocationStats.h>
+
 #include <folly/String.h>
+#include <folly/lang/Bits.h>
 
 namespace fizz {
 
@@ -20,28 +23,73 @@ static constexpr uint16_t kMaxPlaintextRecordSize = 0x4000; // 16k
 static constexpr size_t kPlaintextHeaderSize =
     sizeof(ContentType) + sizeof(ProtocolVersion) + sizeof(uint16_t);
 
+namespace {
+struct RecordHeader {
+  ContentType type;
+  ProtocolVersion version;
+  uint16_t length;
+};
+
+/**
+ * Parses the record header at the front of buf. Returns false if the whole
+ * header is not available yet.
+ */
+bool parseRecordHeader(const folly::IOBufQueue& buf, RecordHeader& header) {
+  auto front = buf.front();
+  if (!front) {
+    return false;
+  }
+  if (front->length() >= kPlaintextHeaderSize) {
+    // Fast path: the header is contiguous so we can load it directly.
+    auto data = front->data();
+    header.type = static_cast<ContentType>(data[0]);
+    header.version = static_cast<ProtocolVersion>(folly::Endian::big(
+        folly::loadUnaligned<ProtocolVersionType>(data + sizeof(ContentType))));
+    header.length = folly::Endian::big(folly::loadUnaligned<uint16_t>(
+        data + sizeof(ContentType) + sizeof(ProtocolVersion)));
+    return true;
+  }
+
+  // The header spans multiple buffers.
+  folly::io::Cursor cursor(front);
+  if (!cursor.canAdvance(kPlaintextHeaderSize)) {
+    return false;
+  }
+  header.type = static_cast<ContentType>(cursor.readBE<ContentTypeType>());
+  header.version =
+      static_cast<ProtocolVersion>(cursor.readBE<ProtocolVersionType>());
+  header.length = cursor.readBE<uint16_t>();
+  return true;
+}
+} // namespace
+
 folly::Optional<TLSMessage> PlaintextReadRecordLayer::read(
     folly::IOBufQueue& buf) {
-  while (true) {
-    folly::io::Cursor cursor(buf.front());
+  auto msg = tryRead(buf);
+  if (msg.hasError()) {
+    throwRecordLayerError(std::move(msg.error()));
+  }
+  return std::move(msg.value());
+}
 
-    if (buf.empty() || !cursor.canAdvance(kPlaintextHeaderSize)) {
+RecordLayerResult<folly::Optional<TLSMessage>>
+PlaintextReadRecordLayer::tryRead(folly::IOBufQueue& buf) {
+  AllocationStats::Scope allocationScope(AllocationSite::RecordLayer);
+  while (true) {
+    RecordHeader header;
+    if (buf.empty() || !parseRecordHeader(buf, header)) {
       return folly::none;
     }
 
     TLSMessage msg;
-    msg.type = static_cast<ContentType>(cursor.readBE<ContentTypeType>());
+    msg.type = header.type;
 
     if (skipEncryptedRecords_) {
       if (msg.type == ContentType::application_data) {
-        cursor.skip(sizeof(ProtocolVersion));
-        auto length = cursor.readBE<uint16_t>();
-        if (buf.chainLength() < (cursor - buf.front()) + length) {
+        if (buf.chainLength() < kPlaintextHeaderSize + header.length) {
           return folly::none;
         }
-        length +=
-            sizeof(ContentType) + sizeof(ProtocolVersion) + sizeof(uint16_t);
-        buf.trimStart(length);
+        buf.trimStart(kPlaintextHeaderSize + header.length);
         continue;
       } else if (msg.type != ContentType::change_cipher_spec) {
         skipEncryptedRecords_ = false;
@@ -55,42 +103,44 @@ folly::Optional<TLSMessage> PlaintextReadRecordLayer::read(
       case ContentType::change_cipher_spec:
         break;
       default:
-        throw std::runtime_error(folly::to<std::string>(
-            "received plaintext content type ",
-            static_cast<ContentTypeType>(msg.type),
-            ", header: ",
-            folly::hexlify(buf.splitAtMost(10)->coalesce())));
+        return folly::makeUnexpected(RecordLayerError{
+            folly::to<std::string>(
+                "received plaintext content type ",
+                static_cast<ContentTypeType>(msg.type),
+                ", header: ",
+                folly::hexlify(buf.splitAtMost(10)->coalesce())),
+            folly::none});
     }
 
-    receivedRecordVersion_ =
-        static_cast<ProtocolVersion>(cursor.readBE<ProtocolVersionType>());
+    receivedRecordVersion_ = header.version;
 
-    auto length = cursor.readBE<uint16_t>();
+    auto length = header.length;
     if (length > kMaxPlaintextRecordSize) {
-      throw std::runtime_error("received too long plaintext record");
+      return folly::makeUnexpected(RecordLayerError{
+          "received too long plaintext record", folly::none});
     }
     if (length == 0) {
-      throw std::runtime_error("received empty plaintext record");
+      return folly::makeUnexpected(
+          RecordLayerError{"received empty plaintext record", folly::none});
     }
-    if (buf.chainLength() < (cursor - buf.front()) + length) {
+    if (buf.chainLength() < kPlaintextHeaderSize + length) {
       return folly::none;
     }
 
-    cursor.clone(msg.fragment, length);
-
-    buf.trimStart(cursor - buf.front());
+    buf.trimStart(kPlaintextHeaderSize);
+    msg.fragment = buf.split(length);
 
     if (msg.type == ContentType::change_cipher_spec) {
       msg.fragment->coalesce();
       if (msg.fragment->length() == 1 && *msg.fragment->data() == 0x01) {
         continue;
       } else {
-        throw FizzException(
-            "received ccs", AlertDescription::illegal_parameter);
+        return folly::makeUnexpected(RecordLayerError{
+            "received ccs", AlertDescription::illegal_parameter});
       }
     }
 
-    return std::move(msg);
+    return folly::Optional<TLSMessage>(std::move(msg));
   }
 }
 
@@ -108,6 +158,7 @@ Buf PlaintextWriteRecordLayer::writeInitialClientHello(
 Buf PlaintextWriteRecordLayer::write(
     TLSMessage msg,
     ProtocolVersion recordVersion) const {
+  AllocationStats::Scope allocationScope(AllocationSite::RecordLayer);
   if (msg.type == ContentType::application_data) {
     throw std::runtime_error("refusing to send plaintext application data");
   }
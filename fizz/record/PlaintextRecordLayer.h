@@ -25,6 +25,13 @@ class PlaintextReadRecordLayer : public ReadRecordLayer {
 
   folly::Optional<TLSMessage> read(folly::IOBufQueue& buf) override;
 
+  RecordLayerResult<folly::Optional<TLSMessage>> tryRead(
+      folly::IOBufQueue& buf) override;
+
+  EncryptionLevel getEncryptionLevel() const override {
+    return EncryptionLevel::Plaintext;
+  }
+
   /**
    * Get the record protocol version of the most recent received record.
    * Should only be used for logging.
@@ -45,6 +52,10 @@ class PlaintextWriteRecordLayer : public WriteRecordLayer {
 
   Buf write(TLSMessage&& msg) const override;
 
+  EncryptionLevel getEncryptionLevel() const override {
+    return EncryptionLevel::Plaintext;
+  }
+
   /**
    * Write the initial ClientHello handshake message. This is a separate method
    * as the record encoding can be slightly different since the version has not
@@ -8,6 +8,12 @@
 
 #include <fizz/record/RecordLayer.h>
 
+#include <fizz/protocol/AllocationStats.h>
+#include <fizz/protocol/TLSStats.h>
+#include <fizz/record/EncryptedRecordLayer.h>
+
+#include <algorithm>
+
 namespace fizz {
 
 using HandshakeTypeType = typename std::underlying_type<HandshakeType>::type;
@@ -17,13 +23,43 @@ static constexpr size_t kHandshakeHeaderSize =
 
 static constexpr size_t kMaxHandshakeSize = 0x20000; // 128k
 
+void throwRecordLayerError(RecordLayerError error) {
+  if (error.alert) {
+    throw FizzException(error.message, error.alert);
+  }
+  throw std::runtime_error(error.message);
+}
+
+RecordLayerResult<folly::Optional<TLSMessage>> ReadRecordLayer::tryRead(
+    folly::IOBufQueue& buf) {
+  try {
+    return read(buf);
+  } catch (const FizzException& e) {
+    return folly::makeUnexpected(RecordLayerError{e.what(), e.getAlert()});
+  } catch (const std::exception& e) {
+    return folly::makeUnexpected(RecordLayerError{e.what(), folly::none});
+  }
+}
+
 folly::Optional<Param> ReadRecordLayer::readEvent(
     folly::IOBufQueue& socketBuf) {
+  auto param = tryReadEvent(socketBuf);
+  if (param.hasError()) {
+    throwRecordLayerError(std::move(param.error()));
+  }
+  return std::move(param.value());
+}
+
+RecordLayerResult<folly::Optional<Param>> ReadRecordLayer::tryReadEvent(
+    folly::IOBufQueue& socketBuf) {
   if (!unparsedHandshakeData_.empty()) {
     auto param = decodeHandshakeMessage(unparsedHandshakeData_);
-    if (param) {
+    if (param.hasError()) {
+      return param;
+    } else if (*param) {
+      onHandshakeMessage(**param);
       VLOG(8) << "Received handshake message "
-              << toString(boost::apply_visitor(EventVisitor(), *param));
+              << toString(boost::apply_visitor(EventVisitor(), **param));
       return param;
     }
   }
@@ -31,41 +67,180 @@ folly::Optional<Param> ReadRecordLayer::readEvent(
   while (true) {
     // Read one record. We read one record at a time since records could cause
     // a change in the record layer.
-    auto message = read(socketBuf);
+    auto next = readNext(socketBuf);
+    if (next.hasError()) {
+      return folly::makeUnexpected(std::move(next.error()));
+    }
+    auto& message = next.value();
     if (!message) {
       return folly::none;
     }
 
     if (!unparsedHandshakeData_.empty() &&
         message->type != ContentType::handshake) {
-      throw std::runtime_error("spliced handshake data");
+      return folly::makeUnexpected(
+          RecordLayerError{"spliced handshake data", folly::none});
     }
 
     switch (message->type) {
       case ContentType::alert:
         return Param(decode<Alert>(std::move(message->fragment)));
       case ContentType::handshake: {
-        unparsedHandshakeData_.append(std::move(message->fragment));
+        // Messages are parsed from a chain of the record fragments and are
+        // never coalesced, but small fragments are packed into the tail room
+        // of the previous one so that a message split over many tiny records
+        // doesn't build a chain of as many buffers. Fragments that share
+        // memory (eg with the transport's read buffer) are never written to.
+        bool pack = !message->fragment->isSharedOne() &&
+            (unparsedHandshakeData_.empty() ||
+             !unparsedHandshakeData_.front()->prev()->isSharedOne());
+        unparsedHandshakeData_.append(std::move(message->fragment), pack);
+        // The length prefix is checked as soon as the header is complete, so
+        // at most kMaxHandshakeSize bytes of one message are ever buffered.
         auto param = decodeHandshakeMessage(unparsedHandshakeData_);
-        if (param) {
+        if (param.hasError()) {
+          return param;
+        } else if (*param) {
+          onHandshakeMessage(**param);
           VLOG(8) << "Received handshake message "
-                  << toString(boost::apply_visitor(EventVisitor(), *param));
+                  << toString(boost::apply_visitor(EventVisitor(), **param));
           return param;
         } else {
           // If we read handshake data but didn't have enough to get a full
           // message we immediately try to read another record.
-          // TODO: add limits on number of records we buffer
+          parseCertificateEntries();
           continue;
         }
       }
-      case ContentType::application_data:
-        return Param(AppData(std::move(message->fragment)));
+      case ContentType::application_data: {
+        if (!coalesceAppData_) {
+          return Param(AppData(std::move(message->fragment)));
+        }
+        auto data = std::move(message->fragment);
+        while (true) {
+          auto more = tryRead(socketBuf);
+          if (more.hasError()) {
+            // Deliver what we already decrypted and surface the error on the
+            // next read.
+            pendingError_ = std::move(more.error());
+            break;
+          }
+          auto& record = more.value();
+          if (!record) {
+            break;
+          }
+          if (record->type != ContentType::application_data) {
+            // This record may cause a change in the record layer, so it has to
+            // go through the state machine on its own.
+            pendingMessage_ = std::move(record);
+            break;
+          }
+          if (!data) {
+            data = std::move(record->fragment);
+          } else if (record->fragment) {
+            data->prependChain(std::move(record->fragment));
+          }
+        }
+        return Param(AppData(std::move(data)));
+      }
       default:
-        throw std::runtime_error("unknown content type");
+        return folly::makeUnexpected(
+            RecordLayerError{"unknown content type", folly::none});
+    }
+  }
+}
+
+RecordLayerResult<folly::Optional<TLSMessage>> ReadRecordLayer::readNext(
+    folly::IOBufQueue& socketBuf) {
+  if (pendingError_) {
+    auto error = std::move(*pendingError_);
+    pendingError_.clear();
+    return folly::makeUnexpected(std::move(error));
+  }
+  if (pendingMessage_) {
+    auto message = std::move(pendingMessage_);
+    pendingMessage_.clear();
+    return message;
+  }
+  return tryRead(socketBuf);
+}
+
+void ReadRecordLayer::parseCertificateEntries() {
+  if (!certificateParser_ || certParseFailed_) {
+    return;
+  }
+  folly::io::Cursor cursor(unparsedHandshakeData_.front());
+  if (!cursor.canAdvance(kHandshakeHeaderSize) ||
+      static_cast<HandshakeType>(cursor.readBE<HandshakeTypeType>()) !=
+          HandshakeType::certificate) {
+    return;
+  }
+  auto length = detail::readBits24(cursor);
+
+  if (nextCertEntryOffset_ == 0) {
+    // Skip certificate_request_context and the certificate_list length.
+    if (!cursor.canAdvance(sizeof(uint8_t))) {
+      return;
+    }
+    auto offset =
+        sizeof(uint8_t) + cursor.read<uint8_t>() + detail::bits24::size;
+    cursor.retreat(sizeof(uint8_t));
+    if (!cursor.canAdvance(offset)) {
+      return;
     }
+    nextCertEntryOffset_ = offset;
+  }
+  if (!cursor.canAdvance(nextCertEntryOffset_)) {
+    return;
+  }
+  cursor.skip(nextCertEntryOffset_);
+
+  // Only entries that end within the message are parsed, anything malformed
+  // is left for decoding the complete message to reject.
+  while (cursor.canAdvance(detail::bits24::size)) {
+    auto certLength = detail::readBits24(cursor);
+    auto entryLength = detail::bits24::size + certLength + sizeof(uint16_t);
+    if (nextCertEntryOffset_ + entryLength > length ||
+        !cursor.canAdvance(certLength + sizeof(uint16_t))) {
+      return;
+    }
+    Buf certData;
+    cursor.clone(certData, certLength);
+    auto extensionsLength = cursor.readBE<uint16_t>();
+    entryLength += extensionsLength;
+    if (nextCertEntryOffset_ + entryLength > length ||
+        !cursor.canAdvance(extensionsLength)) {
+      return;
+    }
+    cursor.skip(extensionsLength);
+
+    try {
+      parsedCerts_.push_back(certificateParser_(std::move(certData)));
+    } catch (const std::exception& e) {
+      VLOG(8) << "Failed to parse certificate early: " << e.what();
+      certParseFailed_ = true;
+      return;
+    }
+    nextCertEntryOffset_ += entryLength;
   }
 }
 
+void ReadRecordLayer::onHandshakeMessage(Param& param) {
+  if (!parsedCerts_.empty()) {
+    auto certMsg = boost::get<CertificateMsg>(&param);
+    if (certMsg) {
+      auto count =
+          std::min(parsedCerts_.size(), certMsg->certificate_list.size());
+      for (size_t i = 0; i < count; ++i) {
+        certMsg->certificate_list[i].parsedCert = std::move(parsedCerts_[i]);
+      }
+    }
+    parsedCerts_.clear();
+  }
+  nextCertEntryOffset_ = 0;
+  certParseFailed_ = false;
+}
+
 template <typename T>
 static Param parse(Buf handshakeMsg, Buf original) {
   auto msg = decode<T>(std::move(handshakeMsg));
@@ -92,32 +267,61 @@ Param parse<ServerHello>(Buf handshakeMsg, Buf original) {
   }
 }
 
-folly::Optional<Param> ReadRecordLayer::decodeHandshakeMessage(
-    folly::IOBufQueue& buf) {
-  folly::io::Cursor cursor(buf.front());
-
-  if (!cursor.canAdvance(kHandshakeHeaderSize)) {
+RecordLayerResult<folly::Optional<Param>>
+ReadRecordLayer::decodeHandshakeMessage(folly::IOBufQueue& buf) const {
+  AllocationStats::Scope allocationScope(AllocationSite::Codec);
+  auto front = buf.front();
+  if (!front) {
     return folly::none;
   }
 
-  auto handshakeType =
-      static_cast<HandshakeType>(cursor.readBE<HandshakeTypeType>());
-  auto length = detail::readBits24(cursor);
+  HandshakeType handshakeType;
+  size_t length;
+  if (front->length() >= kHandshakeHeaderSize) {
+    // Fast path: the header is contiguous so we can load it directly.
+    auto data = front->data();
+    handshakeType = static_cast<HandshakeType>(data[0]);
+    length = (static_cast<size_t>(data[1]) << 16) |
+        (static_cast<size_t>(data[2]) << 8) | data[3];
+  } else {
+    folly::io::Cursor cursor(front);
+    if (!cursor.canAdvance(kHandshakeHeaderSize)) {
+      return folly::none;
+    }
+    handshakeType =
+        static_cast<HandshakeType>(cursor.readBE<HandshakeTypeType>());
+    length = detail::readBits24(cursor);
+  }
 
   if (length > kMaxHandshakeSize) {
-    throw std::runtime_error("handshake record too big");
+    return folly::makeUnexpected(
+        RecordLayerError{"handshake record too big", folly::none});
   }
-  if (buf.chainLength() < (cursor - buf.front()) + length) {
+  if (buf.chainLength() < kHandshakeHeaderSize + length) {
     return folly::none;
   }
 
   Buf handshakeMsg;
-  cursor.clone(handshakeMsg, length);
+  if (front->length() >= kHandshakeHeaderSize + length) {
+    // The whole message is contiguous, clone just the one buffer.
+    handshakeMsg = front->cloneOne();
+    handshakeMsg->trimStart(kHandshakeHeaderSize);
+    handshakeMsg->trimEnd(handshakeMsg->length() - length);
+  } else {
+    folly::io::Cursor cursor(front);
+    cursor.skip(kHandshakeHeaderSize);
+    cursor.clone(handshakeMsg, length);
+  }
   auto original = buf.split(kHandshakeHeaderSize + length);
 
   switch (handshakeType) {
-    case HandshakeType::client_hello:
+    case HandshakeType::client_hello: {
+      TLSStats::Timer timer(TLSCounter::ClientHelloParseNanos);
+      if (clientHelloLimits_) {
+        checkClientHello(*handshakeMsg, *clientHelloLimits_);
+      }
       return parse<ClientHello>(std::move(handshakeMsg), std::move(original));
+    }
     case HandshakeType::server_hello:
       return parse<ServerHello>(std::move(handshakeMsg), std::move(original));
     case HandshakeType::end_of_early_data:
@@ -132,6 +336,9 @@ folly::Optional<Param> ReadRecordLayer::decodeHandshakeMessage(
     case HandshakeType::certificate:
       return parse<CertificateMsg>(
           std::move(handshakeMsg), std::move(original));
+    case HandshakeType::compressed_certificate:
+      return parse<CompressedCertificate>(
+          std::move(handshakeMsg), std::move(original));
     case HandshakeType::certificate_request:
       return parse<CertificateRequest>(
           std::move(handshakeMsg), std::move(original));
@@ -143,11 +350,37 @@ folly::Optional<Param> ReadRecordLayer::decodeHandshakeMessage(
     case HandshakeType::key_update:
       return parse<KeyUpdate>(std::move(handshakeMsg), std::move(original));
     default:
-      throw std::runtime_error("unknown handshake type");
+      return folly::makeUnexpected(
+          RecordLayerError{"unknown handshake type", folly::none});
   };
 }
 
 bool ReadRecordLayer::hasUnparsedHandshakeData() const {
-  return !unparsedHandshakeData_.empty();
+  return !unparsedHandshakeData_.empty() || pendingMessage_.hasValue() ||
+      pendingError_.hasValue();
+}
+
+void ReadRecordLayer::releaseIdleResources() {
+  // An empty queue may still hold buffers with tail room.
+  if (unparsedHandshakeData_.empty()) {
+    unparsedHandshakeData_.move();
+  }
+}
+
+size_t ReadRecordLayer::getBufferMemoryUsage() const {
+  auto buf = unparsedHandshakeData_.front();
+  return buf ? buf->computeChainCapacity() : 0;
+}
+
+size_t WriteRecordLayer::writeIovecs(TLSMessage&& msg, RecordIovecs& out)
+    const {
+  out.append(write(std::move(msg)));
+  return out.iovecs.size();
+}
+
+void WriteRecordLayer::writeAppDataIovecsUntilKeyUpdate(
+    folly::IOBufQueue& queue,
+    RecordIovecs& out) const {
+  out.append(writeAppDataUntilKeyUpdate(queue));
 }
 } // namespace fizz
@@ -9,12 +9,55 @@
 #pragma once
 
 #include <fizz/protocol/Params.h>
+#include <fizz/record/ClientHelloCheck.h>
 #include <fizz/record/Types.h>
+#include <folly/Expected.h>
 #include <folly/Optional.h>
 #include <folly/io/IOBufQueue.h>
 
+#include <functional>
+
 namespace fizz {
 
+struct RecordIovecs;
+
+/**
+ * A malformed record or a record that failed to decrypt, reported without
+ * throwing so that garbage from the network doesn't cost an exception per
+ * connection. alert is set when a specific alert should be sent to the peer
+ * rather than the default for the failure.
+ */
+struct RecordLayerError {
+  std::string message;
+  folly::Optional<AlertDescription> alert;
+};
+
+template <typename T>
+using RecordLayerResult = folly::Expected<T, RecordLayerError>;
+
+/**
+ * Throws error as a FizzException if it has an alert, and as a
+ * std::runtime_error otherwise.
+ */
+[[noreturn]] void throwRecordLayerError(RecordLayerError error);
+
+/**
+ * Supplies memory for a record layer to decrypt a record into.
+ */
+class PlaintextBufferProvider {
+ public:
+  virtual ~PlaintextBufferProvider() = default;
+
+  /**
+   * Returns memory to decrypt a record of length plaintext bytes (content
+   * type and padding included) into, or an empty range to have the record
+   * decrypted into a buffer allocated by the record layer as usual. The memory
+   * must remain valid until the record is delivered as app data. Records of
+   * other content types are copied out of it.
+   */
+  virtual folly::MutableByteRange getPlaintextBuffer(size_t length) = 0;
+};
+
 class ReadRecordLayer {
  public:
   virtual ~ReadRecordLayer() = default;
@@ -26,22 +69,135 @@ class ReadRecordLayer {
    */
   virtual folly::Optional<TLSMessage> read(folly::IOBufQueue& buf) = 0;
 
+  /**
+   * Same as read(), but returns an error instead of throwing if data is
+   * malformed. The default implementation catches what read() throws; record
+   * layers that expect to see malformed data override it to avoid throwing
+   * in the first place.
+   */
+  virtual RecordLayerResult<folly::Optional<TLSMessage>> tryRead(
+      folly::IOBufQueue& buf);
+
+  /**
+   * The keys protecting the data this record layer reads.
+   */
+  virtual EncryptionLevel getEncryptionLevel() const = 0;
+
   /**
    * Get a message from the record layer. Returns none if insufficient data was
    * available on the socket. Throws on parse error.
    */
   virtual folly::Optional<Param> readEvent(folly::IOBufQueue& socketBuf);
 
+  /**
+   * Same as readEvent(), but returns an error instead of throwing if a record
+   * is malformed or fails to decrypt, since that's what garbage from the
+   * network usually produces. Errors decoding the handshake messages
+   * themselves are still thrown.
+   */
+  virtual RecordLayerResult<folly::Optional<Param>> tryReadEvent(
+      folly::IOBufQueue& socketBuf);
+
   /**
    * Check if there is decrypted but unparsed handshake data buffered.
    */
   virtual bool hasUnparsedHandshakeData() const;
 
+  /**
+   * Frees buffers and other state that can be rebuilt when the record layer
+   * is next used. Meant for connections that are idle.
+   */
+  virtual void releaseIdleResources();
+
+  /**
+   * Bytes of memory held by handshake data buffered for the next message.
+   */
+  size_t getBufferMemoryUsage() const;
+
+  /**
+   * Approximate bytes of memory held by the record protection state, 0 for
+   * plaintext record layers.
+   */
+  virtual size_t getCipherMemoryUsage() const {
+    return 0;
+  }
+
+  /**
+   * When enabled, readEvent() decrypts every complete application data record
+   * already available in socketBuf and returns them as a single AppData event,
+   * rather than returning one event per record.
+   */
+  void setCoalesceAppData(bool enabled) {
+    coalesceAppData_ = enabled;
+  }
+
+  /**
+   * Set a provider of memory to decrypt records into. Record layers that do
+   * not decrypt ignore it. Pass nullptr to unset it.
+   */
+  void setPlaintextBufferProvider(PlaintextBufferProvider* provider) {
+    plaintextBufferProvider_ = provider;
+  }
+
+  /**
+   * When set, ClientHellos are checked against limits with checkClientHello()
+   * before they are decoded.
+   */
+  void setClientHelloLimits(folly::Optional<ClientHelloLimits> limits) {
+    clientHelloLimits_ = std::move(limits);
+  }
+
+  using CertificateParser =
+      std::function<std::shared_ptr<const PeerCert>(Buf certData)>;
+
+  /**
+   * When set, each entry of a Certificate message is parsed with parser as
+   * soon as it has been received, so that parsing a long chain overlaps with
+   * receiving the rest of it, and the results are delivered as the entries'
+   * parsedCert. Entries that arrive with the end of the message, or that
+   * parser throws on, are left for the caller to parse.
+   */
+  void setCertificateParser(CertificateParser parser) {
+    certificateParser_ = std::move(parser);
+  }
+
+ protected:
+  PlaintextBufferProvider* getPlaintextBufferProvider() const {
+    return plaintextBufferProvider_;
+  }
+
  private:
-  static folly::Optional<Param> decodeHandshakeMessage(folly::IOBufQueue& buf);
+  RecordLayerResult<folly::Optional<Param>> decodeHandshakeMessage(
+      folly::IOBufQueue& buf) const;
+
+  RecordLayerResult<folly::Optional<TLSMessage>> readNext(
+      folly::IOBufQueue& socketBuf);
+
+  void parseCertificateEntries();
+
+  void onHandshakeMessage(Param& param);
 
   folly::IOBufQueue unparsedHandshakeData_{
       folly::IOBufQueue::cacheChainLength()};
+
+  bool coalesceAppData_{false};
+
+  PlaintextBufferProvider* plaintextBufferProvider_{nullptr};
+
+  folly::Optional<ClientHelloLimits> clientHelloLimits_;
+
+  CertificateParser certificateParser_;
+  // Certificates parsed from the partially received Certificate message at
+  // the front of unparsedHandshakeData_, and the offset of the next entry
+  // in its body (0 until the certificate list has been reached).
+  std::vector<std::shared_ptr<const PeerCert>> parsedCerts_;
+  size_t nextCertEntryOffset_{0};
+  bool certParseFailed_{false};
+
+  // A record (or read error) encountered after the end of a coalesced run of
+  // application data. It is returned by the next read.
+  folly::Optional<TLSMessage> pendingMessage_;
+  folly::Optional<RecordLayerError> pendingError_;
 };
 
 class WriteRecordLayer {
@@ -50,6 +206,11 @@ class WriteRecordLayer {
 
   virtual Buf write(TLSMessage&& msg) const = 0;
 
+  /**
+   * The keys protecting the data this record layer writes.
+   */
+  virtual EncryptionLevel getEncryptionLevel() const = 0;
+
   Buf writeAlert(Alert&& alert) const {
     return write(TLSMessage{ContentType::alert, encode(std::move(alert))});
   }
@@ -65,6 +226,51 @@ class WriteRecordLayer {
     return write(std::move(msg));
   }
 
+  /**
+   * Whether this record layer has protected enough data that its keys should
+   * be updated before writing more.
+   */
+  virtual bool keyUpdateDue() const {
+    return false;
+  }
+
+  /**
+   * Writes app data from queue, checking keyUpdateDue() before each record
+   * and stopping once it is true. Whatever is left in queue should be
+   * written with the updated keys.
+   */
+  virtual Buf writeAppDataUntilKeyUpdate(folly::IOBufQueue& queue) const {
+    return writeAppData(queue.move());
+  }
+
+  /**
+   * Encodes msg into iovecs suitable for a vectored socket write (writev),
+   * appended to out. Returns the number of iovecs in out.
+   */
+  virtual size_t writeIovecs(TLSMessage&& msg, RecordIovecs& out) const;
+
+  /**
+   * Same as writeAppDataUntilKeyUpdate(), but appends the records to out
+   * instead of returning them.
+   */
+  virtual void writeAppDataIovecsUntilKeyUpdate(
+      folly::IOBufQueue& queue,
+      RecordIovecs& out) const;
+
+  /**
+   * Frees state that can be rebuilt when the record layer is next used.
+   * Meant for connections that are idle.
+   */
+  virtual void releaseIdleResources() const {}
+
+  /**
+   * Approximate bytes of memory held by the record protection state, 0 for
+   * plaintext record layers.
+   */
+  virtual size_t getCipherMemoryUsage() const {
+    return 0;
+  }
+
   void setProtocolVersion(ProtocolVersion version) const {
     auto realVersion = getRealDraftVersion(version);
     if (realVersion == ProtocolVersion::tls_1_3_21 ||
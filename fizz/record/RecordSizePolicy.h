@@ -0,0 +1,97 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace fizz {
+
+/**
+ * Decides how much plaintext the encrypted write record layer puts in each
+ * record.
+ */
+class RecordSizePolicy {
+ public:
+  virtual ~RecordSizePolicy() = default;
+
+  /**
+   * Returns the maximum plaintext size of the next record to be written.
+   */
+  virtual uint16_t getMaxRecordSize() = 0;
+
+  /**
+   * Called after a record containing size bytes of plaintext was written.
+   */
+  virtual void recordWritten(size_t size) = 0;
+};
+
+/**
+ * TLS dynamic record sizing. Starts out with small records that fit in a
+ * single TCP segment to minimize time to first byte, then switches to full size
+ * records once enough data has been written. The ramp is reset if the
+ * connection has been idle for longer than the idle timeout.
+ */
+class DynamicRecordSizePolicy : public RecordSizePolicy {
+ public:
+  struct Options {
+    // Plaintext size of the initial records. The default fits a record in a
+    // single 1460 byte TCP segment with room for TCP options.
+    uint16_t smallRecordSize{1369};
+    uint16_t largeRecordSize{0x4000};
+    // Number of bytes to write in small records before switching to large
+    // records.
+    size_t rampThreshold{1024 * 1024};
+    std::chrono::milliseconds idleTimeout{1000};
+  };
+
+  DynamicRecordSizePolicy() = default;
+
+  explicit DynamicRecordSizePolicy(Options options) : options_(options) {}
+
+  /**
+   * Sets the small record size so that a record fills a TCP segment of the
+   * given maximum segment size, given the per record overhead (header, content
+   * type, and aead tag).
+   */
+  void alignToSegmentSize(uint16_t mss, uint16_t recordOverhead) {
+    if (mss > recordOverhead) {
+      options_.smallRecordSize = std::min<uint16_t>(
+          mss - recordOverhead, options_.largeRecordSize);
+    }
+  }
+
+  uint16_t getMaxRecordSize() override {
+    auto current = now();
+    if (lastWrite_ && current - *lastWrite_ > options_.idleTimeout) {
+      bytesWritten_ = 0;
+    }
+    lastWrite_ = current;
+    return bytesWritten_ >= options_.rampThreshold ? options_.largeRecordSize
+                                                   : options_.smallRecordSize;
+  }
+
+  void recordWritten(size_t size) override {
+    bytesWritten_ += size;
+  }
+
+ protected:
+  virtual std::chrono::steady_clock::time_point now() const {
+    return std::chrono::steady_clock::now();
+  }
+
+ private:
+  Options options_;
+  size_t bytesWritten_{0};
+  folly::Optional<std::chrono::steady_clock::time_point> lastWrite_;
+};
+} // namespace fizz
@@ -6,6 +6,7 @@
  *  LICENSE file in the root directory of this source tree.
  */
 
+#include <fizz/protocol/AllocationStats.h>
 #include <folly/Conv.h>
 #include <folly/String.h>
 #include <folly/io/Cursor.h>
@@ -30,13 +31,19 @@ struct Sizer {
 };
 
 template <class N>
-size_t getBufSize(const Buf& buf) {
-  return sizeof(N) + buf->computeChainDataLength();
+constexpr size_t getLengthSize() {
+  return sizeof(N);
 }
 
 template <>
-inline size_t getBufSize<bits24>(const Buf& buf) {
-  return bits24::size + buf->computeChainDataLength();
+constexpr size_t getLengthSize<bits24>() {
+  return bits24::size;
+}
+
+// A null buf is written as empty.
+template <class N>
+size_t getBufSize(const Buf& buf) {
+  return getLengthSize<N>() + (buf ? buf->computeChainDataLength() : 0);
 }
 
 template <class T>
@@ -52,20 +59,162 @@ struct Sizer<Extension> {
   }
 };
 
+template <class N, class T>
+size_t getVectorSize(const std::vector<T>& data) {
+  size_t len = getLengthSize<N>();
+  for (const auto& t : data) {
+    len += getSize<T>(t);
+  }
+  return len;
+}
+
+template <>
+struct Sizer<Random> {
+  template <class T>
+  size_t getSize(const Random& random) {
+    return random.size();
+  }
+};
+
 template <>
 struct Sizer<CertificateEntry> {
   template <class T>
   size_t getSize(const CertificateEntry& entry) {
-    size_t len = 0;
-    len += getBufSize<bits24>(entry.cert_data);
-    len += sizeof(uint16_t);
-    for (const auto& ext : entry.extensions) {
-      len += detail::getSize(ext);
+    return getBufSize<bits24>(entry.cert_data) +
+        getVectorSize<uint16_t>(entry.extensions);
+  }
+};
+
+/**
+ * Sizes of encoded handshake message bodies, used to encode them into a
+ * single buffer of exactly the right size.
+ */
+template <>
+struct Sizer<ClientHello> {
+  template <class T>
+  size_t getSize(const ClientHello& chlo) {
+    return sizeof(ProtocolVersion) + sizeof(Random) +
+        getBufSize<uint8_t>(chlo.legacy_session_id) +
+        getVectorSize<uint16_t>(chlo.cipher_suites) +
+        getVectorSize<uint8_t>(chlo.legacy_compression_methods) +
+        getVectorSize<uint16_t>(chlo.extensions);
+  }
+};
+
+template <>
+struct Sizer<ServerHello> {
+  template <class T>
+  size_t getSize(const ServerHello& shlo) {
+    size_t len = sizeof(ProtocolVersion) + sizeof(Random) +
+        sizeof(CipherSuite) + getVectorSize<uint16_t>(shlo.extensions);
+    if (shlo.legacy_session_id_echo) {
+      len += getBufSize<uint8_t>(shlo.legacy_session_id_echo) +
+          sizeof(shlo.legacy_compression_method);
+    }
+    return len;
+  }
+};
+
+template <>
+struct Sizer<HelloRetryRequest> {
+  template <class T>
+  size_t getSize(const HelloRetryRequest& hrr) {
+    return sizeof(ProtocolVersion) + sizeof(Random) +
+        getBufSize<uint8_t>(hrr.legacy_session_id_echo) + sizeof(CipherSuite) +
+        sizeof(hrr.legacy_compression_method) +
+        getVectorSize<uint16_t>(hrr.extensions);
+  }
+};
+
+template <>
+struct Sizer<EndOfEarlyData> {
+  template <class T>
+  size_t getSize(const EndOfEarlyData&) {
+    return 0;
+  }
+};
+
+template <>
+struct Sizer<EncryptedExtensions> {
+  template <class T>
+  size_t getSize(const EncryptedExtensions& ee) {
+    return getVectorSize<uint16_t>(ee.extensions);
+  }
+};
+
+template <>
+struct Sizer<CertificateRequest> {
+  template <class T>
+  size_t getSize(const CertificateRequest& cr) {
+    return getBufSize<uint8_t>(cr.certificate_request_context) +
+        getVectorSize<uint16_t>(cr.extensions);
+  }
+};
+
+template <>
+struct Sizer<CertificateMsg> {
+  template <class T>
+  size_t getSize(const CertificateMsg& cert) {
+    return getBufSize<uint8_t>(cert.certificate_request_context) +
+        getVectorSize<bits24>(cert.certificate_list);
+  }
+};
+
+template <>
+struct Sizer<CompressedCertificate> {
+  template <class T>
+  size_t getSize(const CompressedCertificate& cc) {
+    return sizeof(CertificateCompressionAlgorithm) + bits24::size +
+        getBufSize<bits24>(cc.compressed_certificate_message);
+  }
+};
+
+template <>
+struct Sizer<CertificateVerify> {
+  template <class T>
+  size_t getSize(const CertificateVerify& certVerify) {
+    return sizeof(SignatureScheme) + getBufSize<uint16_t>(certVerify.signature);
+  }
+};
+
+template <>
+struct Sizer<Finished> {
+  template <class T>
+  size_t getSize(const Finished& fin) {
+    return fin.verify_data->computeChainDataLength();
+  }
+};
+
+template <>
+struct Sizer<NewSessionTicket> {
+  template <class T>
+  size_t getSize(const NewSessionTicket& nst) {
+    size_t len = sizeof(nst.ticket_lifetime) + sizeof(nst.ticket_age_add) +
+        getBufSize<uint16_t>(nst.ticket) +
+        getVectorSize<uint16_t>(nst.extensions);
+    if (nst.ticket_nonce) {
+      len += getBufSize<uint8_t>(nst.ticket_nonce);
     }
     return len;
   }
 };
 
+template <>
+struct Sizer<KeyUpdate> {
+  template <class T>
+  size_t getSize(const KeyUpdate&) {
+    return sizeof(KeyUpdateRequest);
+  }
+};
+
+template <>
+struct Sizer<message_hash> {
+  template <class T>
+  size_t getSize(const message_hash& hash) {
+    return hash.hash->computeChainDataLength();
+  }
+};
+
 template <class U>
 struct Writer {
   template <class T>
@@ -150,6 +299,12 @@ void writeVector(const std::vector<T>& data, folly::io::Appender& out) {
   return WriterVector<N, T>().writeVector(data, out);
 }
 
+inline void writeChain(const Buf& buf, folly::io::Appender& out) {
+  for (auto range : *buf) {
+    out.push(range.data(), range.size());
+  }
+}
+
 template <class N>
 void writeBuf(const Buf& buf, folly::io::Appender& out) {
   if (!buf) {
@@ -157,14 +312,7 @@ void writeBuf(const Buf& buf, folly::io::Appender& out) {
     return;
   }
   out.writeBE<N>(folly::to<N>(buf->computeChainDataLength()));
-  auto current = buf.get();
-  size_t chainElements = buf->countChainElements();
-  for (size_t i = 0; i < chainElements; ++i) {
-    // TODO: fina a better way not to require copying all the buffers into
-    // the cursor
-    out.push(current->data(), current->length());
-    current = current->next();
-  }
+  writeChain(buf, out);
 }
 
 template <>
@@ -182,12 +330,7 @@ inline void writeBuf<bits24>(const Buf& buf, folly::io::Appender& out) {
     return;
   }
   writeBits24(buf->computeChainDataLength(), out);
-  auto current = buf.get();
-  size_t chainElements = buf->countChainElements();
-  for (size_t i = 0; i < chainElements; ++i) {
-    out.push(current->data(), current->length());
-    current = current->next();
-  }
+  writeChain(buf, out);
 }
 
 template <>
@@ -207,6 +350,150 @@ inline void write<CertificateEntry>(
   writeVector<uint16_t>(entry.extensions, out);
 }
 
+template <>
+struct Writer<ClientHello> {
+  template <class T>
+  void write(const ClientHello& chlo, folly::io::Appender& out) {
+    detail::write(chlo.legacy_version, out);
+    detail::write(chlo.random, out);
+    writeBuf<uint8_t>(chlo.legacy_session_id, out);
+    writeVector<uint16_t>(chlo.cipher_suites, out);
+    writeVector<uint8_t>(chlo.legacy_compression_methods, out);
+    writeVector<uint16_t>(chlo.extensions, out);
+  }
+};
+
+template <>
+struct Writer<ServerHello> {
+  template <class T>
+  void write(const ServerHello& shlo, folly::io::Appender& out) {
+    detail::write(shlo.legacy_version, out);
+    detail::write(shlo.random, out);
+    if (shlo.legacy_session_id_echo) {
+      writeBuf<uint8_t>(shlo.legacy_session_id_echo, out);
+    }
+    detail::write(shlo.cipher_suite, out);
+    if (shlo.legacy_session_id_echo) {
+      detail::write(shlo.legacy_compression_method, out);
+    }
+    writeVector<uint16_t>(shlo.extensions, out);
+  }
+};
+
+template <>
+struct Writer<HelloRetryRequest> {
+  template <class T>
+  void write(const HelloRetryRequest& hrr, folly::io::Appender& out) {
+    detail::write(hrr.legacy_version, out);
+    detail::write(HelloRetryRequest::HrrRandom, out);
+    writeBuf<uint8_t>(hrr.legacy_session_id_echo, out);
+    detail::write(hrr.cipher_suite, out);
+    detail::write(hrr.legacy_compression_method, out);
+    writeVector<uint16_t>(hrr.extensions, out);
+  }
+};
+
+template <>
+struct Writer<EndOfEarlyData> {
+  template <class T>
+  void write(const EndOfEarlyData&, folly::io::Appender&) {}
+};
+
+template <>
+struct Writer<EncryptedExtensions> {
+  template <class T>
+  void write(const EncryptedExtensions& ee, folly::io::Appender& out) {
+    writeVector<uint16_t>(ee.extensions, out);
+  }
+};
+
+template <>
+struct Writer<CertificateRequest> {
+  template <class T>
+  void write(const CertificateRequest& cr, folly::io::Appender& out) {
+    writeBuf<uint8_t>(cr.certificate_request_context, out);
+    writeVector<uint16_t>(cr.extensions, out);
+  }
+};
+
+template <>
+struct Writer<CertificateMsg> {
+  template <class T>
+  void write(const CertificateMsg& cert, folly::io::Appender& out) {
+    writeBuf<uint8_t>(cert.certificate_request_context, out);
+    writeVector<bits24>(cert.certificate_list, out);
+  }
+};
+
+template <>
+struct Writer<CompressedCertificate> {
+  template <class T>
+  void write(const CompressedCertificate& cc, folly::io::Appender& out) {
+    detail::write(cc.algorithm, out);
+    writeBits24(cc.uncompressed_length, out);
+    writeBuf<bits24>(cc.compressed_certificate_message, out);
+  }
+};
+
+template <>
+struct Writer<CertificateVerify> {
+  template <class T>
+  void write(const CertificateVerify& certVerify, folly::io::Appender& out) {
+    detail::write(certVerify.algorithm, out);
+    writeBuf<uint16_t>(certVerify.signature, out);
+  }
+};
+
+template <>
+struct Writer<Finished> {
+  template <class T>
+  void write(const Finished& fin, folly::io::Appender& out) {
+    writeChain(fin.verify_data, out);
+  }
+};
+
+template <>
+struct Writer<NewSessionTicket> {
+  template <class T>
+  void write(const NewSessionTicket& nst, folly::io::Appender& out) {
+    detail::write(nst.ticket_lifetime, out);
+    detail::write(nst.ticket_age_add, out);
+    if (nst.ticket_nonce) {
+      writeBuf<uint8_t>(nst.ticket_nonce, out);
+    }
+    writeBuf<uint16_t>(nst.ticket, out);
+    writeVector<uint16_t>(nst.extensions, out);
+  }
+};
+
+template <>
+struct Writer<KeyUpdate> {
+  template <class T>
+  void write(const KeyUpdate& keyUpdate, folly::io::Appender& out) {
+    detail::write(keyUpdate.request_update, out);
+  }
+};
+
+template <>
+struct Writer<message_hash> {
+  template <class T>
+  void write(const message_hash& hash, folly::io::Appender& out) {
+    writeChain(hash.hash, out);
+  }
+};
+
+/**
+ * Encodes msg into a single buffer of exactly its encoded size. The appender
+ * can't grow, so a size mismatch throws instead of chaining small buffers.
+ */
+template <class T>
+Buf encodeExact(const T& msg) {
+  auto buf = folly::IOBuf::create(getSize(msg));
+  folly::io::Appender appender(buf.get(), 0);
+  write(msg, appender);
+  return buf;
+}
+
 inline uint32_t readBits24(folly::io::Cursor& cursor) {
   uint32_t data = 0;
   uint8_t offset = sizeof(data) - 3;
@@ -216,6 +503,7 @@ inline uint32_t readBits24(folly::io::Cursor& cursor) {
   return length;
 }
 
+// The read buf shares the cursor's memory, no data is copied.
 template <class N>
 size_t readBuf(Buf& buf, folly::io::Cursor& cursor) {
   auto len = cursor.readBE<N>();
@@ -337,34 +625,12 @@ struct Reader<CertificateEntry> {
 
 template <>
 inline Buf encode<ServerHello>(ServerHello&& shlo) {
-  auto buf = folly::IOBuf::create(
-      sizeof(ProtocolVersion) + sizeof(Random) + sizeof(CipherSuite) + 20);
-  folly::io::Appender appender(buf.get(), 20);
-  detail::write(shlo.legacy_version, appender);
-  detail::write(shlo.random, appender);
-  if (shlo.legacy_session_id_echo) {
-    detail::writeBuf<uint8_t>(shlo.legacy_session_id_echo, appender);
-  }
-  detail::write(shlo.cipher_suite, appender);
-  if (shlo.legacy_session_id_echo) {
-    detail::write(shlo.legacy_compression_method, appender);
-  }
-  detail::writeVector<uint16_t>(shlo.extensions, appender);
-  return buf;
+  return detail::encodeExact(shlo);
 }
 
 template <>
-inline Buf encode<HelloRetryRequest>(HelloRetryRequest&& shlo) {
-  auto buf = folly::IOBuf::create(
-      sizeof(ProtocolVersion) + sizeof(Random) + sizeof(CipherSuite) + 20);
-  folly::io::Appender appender(buf.get(), 20);
-  detail::write(shlo.legacy_version, appender);
-  detail::write(HelloRetryRequest::HrrRandom, appender);
-  detail::writeBuf<uint8_t>(shlo.legacy_session_id_echo, appender);
-  detail::write(shlo.cipher_suite, appender);
-  detail::write(shlo.legacy_compression_method, appender);
-  detail::writeVector<uint16_t>(shlo.extensions, appender);
-  return buf;
+inline Buf encode<HelloRetryRequest>(HelloRetryRequest&& hrr) {
+  return detail::encodeExact(hrr);
 }
 
 template <>
@@ -374,37 +640,27 @@ inline Buf encode<EndOfEarlyData>(EndOfEarlyData&&) {
 
 template <>
 inline Buf encode<EncryptedExtensions>(EncryptedExtensions&& extensions) {
-  auto buf = folly::IOBuf::create(20);
-  folly::io::Appender appender(buf.get(), 20);
-  detail::writeVector<uint16_t>(extensions.extensions, appender);
-  return buf;
+  return detail::encodeExact(extensions);
 }
 
 template <>
 inline Buf encode<CertificateRequest>(CertificateRequest&& cr) {
-  auto buf = folly::IOBuf::create(20);
-  folly::io::Appender appender(buf.get(), 20);
-  detail::writeBuf<uint8_t>(cr.certificate_request_context, appender);
-  detail::writeVector<uint16_t>(cr.extensions, appender);
-  return buf;
+  return detail::encodeExact(cr);
 }
 
 template <>
 inline Buf encode<CertificateMsg>(CertificateMsg&& cert) {
-  auto buf = folly::IOBuf::create(20);
-  folly::io::Appender appender(buf.get(), 20);
-  detail::writeBuf<uint8_t>(cert.certificate_request_context, appender);
-  detail::writeVector<detail::bits24>(cert.certificate_list, appender);
-  return buf;
+  return detail::encodeExact(cert);
+}
+
+template <>
+inline Buf encode<CompressedCertificate>(CompressedCertificate&& cc) {
+  return detail::encodeExact(cc);
 }
 
 template <>
 inline Buf encode<CertificateVerify>(CertificateVerify&& certVerify) {
-  auto buf = folly::IOBuf::create(20);
-  folly::io::Appender appender(buf.get(), 20);
-  detail::write(certVerify.algorithm, appender);
-  detail::writeBuf<uint16_t>(certVerify.signature, appender);
-  return buf;
+  return detail::encodeExact(certVerify);
 }
 
 template <>
@@ -418,17 +674,7 @@ inline Buf encode<Alert>(Alert&& alert) {
 
 template <>
 inline Buf encode<const ClientHello&>(const ClientHello& chlo) {
-  auto buf = folly::IOBuf::create(
-      sizeof(ProtocolVersion) + sizeof(Random) + sizeof(uint8_t) +
-      sizeof(CipherSuite) * chlo.cipher_suites.size() + sizeof(uint8_t) + 20);
-  folly::io::Appender appender(buf.get(), 20);
-  detail::write(chlo.legacy_version, appender);
-  detail::write(chlo.random, appender);
-  detail::writeBuf<uint8_t>(chlo.legacy_session_id, appender);
-  detail::writeVector<uint16_t>(chlo.cipher_suites, appender);
-  detail::writeVector<uint8_t>(chlo.legacy_compression_methods, appender);
-  detail::writeVector<uint16_t>(chlo.extensions, appender);
-  return buf;
+  return detail::encodeExact(chlo);
 }
 
 template <>
@@ -448,16 +694,7 @@ inline Buf encode<Finished>(Finished&& fin) {
 
 template <>
 inline Buf encode<NewSessionTicket>(NewSessionTicket&& nst) {
-  auto buf = folly::IOBuf::create(20);
-  folly::io::Appender appender(buf.get(), 20);
-  detail::write(nst.ticket_lifetime, appender);
-  detail::write(nst.ticket_age_add, appender);
-  if (nst.ticket_nonce) {
-    detail::writeBuf<uint8_t>(nst.ticket_nonce, appender);
-  }
-  detail::writeBuf<uint16_t>(nst.ticket, appender);
-  detail::writeVector<uint16_t>(nst.extensions, appender);
-  return buf;
+  return detail::encodeExact(nst);
 }
 
 template <>
@@ -465,7 +702,9 @@ inline Buf encode<HkdfLabel>(HkdfLabel&& label) {
   static constexpr folly::StringPiece kLabelPrefix = "tls13 ";
   auto labelBuf = folly::IOBuf::copyBuffer(
       folly::to<std::string>(kLabelPrefix, label.label));
-  auto buf = folly::IOBuf::create(sizeof(label.length) + label.label.size());
+  auto buf = folly::IOBuf::create(
+      sizeof(label.length) + detail::getBufSize<uint8_t>(labelBuf) +
+      detail::getBufSize<uint8_t>(label.hash_value));
   folly::io::Appender appender(buf.get(), 20);
   detail::write(label.length, appender);
   detail::writeBuf<uint8_t>(labelBuf, appender);
@@ -475,10 +714,7 @@ inline Buf encode<HkdfLabel>(HkdfLabel&& label) {
 
 template <>
 inline Buf encode<KeyUpdate>(KeyUpdate&& keyUpdate) {
-  auto buf = folly::IOBuf::create(20);
-  folly::io::Appender appender(buf.get(), 20);
-  detail::write(keyUpdate.request_update, appender);
-  return buf;
+  return detail::encodeExact(keyUpdate);
 }
 
 template <>
@@ -488,13 +724,16 @@ inline Buf encode<message_hash>(message_hash&& hash) {
 
 template <class T>
 Buf encodeHandshake(T&& handshakeMsg) {
-  auto body = encode(std::forward<T>(handshakeMsg));
-  auto buf = folly::IOBuf::create(sizeof(HandshakeType) + detail::bits24::size);
+  AllocationStats::Scope allocationScope(AllocationSite::Codec);
+  // Header and body are written into a single buffer, sized up front.
+  auto bodyLength = detail::getSize(handshakeMsg);
+  auto buf = folly::IOBuf::create(
+      sizeof(HandshakeType) + detail::bits24::size + bodyLength);
   folly::io::Appender appender(buf.get(), 0);
   constexpr auto handshakeType = std::remove_reference<T>::type::handshake_type;
   detail::write(handshakeType, appender);
-  detail::writeBits24(body->computeChainDataLength(), appender);
-  buf->prependChain(std::move(body));
+  detail::writeBits24(bodyLength, appender);
+  detail::write(handshakeMsg, appender);
   return buf;
 }
 
@@ -555,6 +794,15 @@ inline CertificateMsg decode(folly::io::Cursor& cursor) {
   return cert;
 }
 
+template <>
+inline CompressedCertificate decode(folly::io::Cursor& cursor) {
+  CompressedCertificate cc;
+  detail::read(cc.algorithm, cursor);
+  cc.uncompressed_length = detail::readBits24(cursor);
+  detail::readBuf<detail::bits24>(cc.compressed_certificate_message, cursor);
+  return cc;
+}
+
 template <>
 inline CertificateVerify decode(folly::io::Cursor& cursor) {
   CertificateVerify certVerify;
@@ -608,6 +856,198 @@ T decode(std::unique_ptr<folly::IOBuf>&& buf) {
   return decoded;
 }
 
+namespace detail {
+template <class T>
+struct EnumEntry {
+  T value;
+  folly::StringPiece name;
+};
+} // namespace detail
+
+template <>
+struct EnumNames<ProtocolVersion> {
+  static constexpr detail::EnumEntry<ProtocolVersion> values[] = {
+      {ProtocolVersion::tls_1_0, "TLSv1.0"},
+      {ProtocolVersion::tls_1_1, "TLSv1.1"},
+      {ProtocolVersion::tls_1_2, "TLSv1.2"},
+      {ProtocolVersion::tls_1_3, "TLSv1.3"},
+      {ProtocolVersion::tls_1_3_20, "TLSv1.3-draft-20"},
+      {ProtocolVersion::tls_1_3_20_fb, "TLSv1.3-draft-20-fb"},
+      {ProtocolVersion::tls_1_3_21, "TLSv1.3-draft-21"},
+      {ProtocolVersion::tls_1_3_21_fb, "TLSv1.3-draft-21-fb"},
+      {ProtocolVersion::tls_1_3_22, "TLSv1.3-draft-22"},
+      {ProtocolVersion::tls_1_3_22_fb, "TLSv1.3-draft-22-fb"},
+      {ProtocolVersion::tls_1_3_23, "TLSv1.3-draft-23"},
+      {ProtocolVersion::tls_1_3_23_fb, "TLSv1.3-draft-23-fb"},
+      {ProtocolVersion::tls_1_3_26, "TLSv1.3-draft-26"},
+      {ProtocolVersion::tls_1_3_26_fb, "TLSv1.3-draft-26-fb"},
+      {ProtocolVersion::tls_1_3_28, "TLSv1.3-draft-28"},
+  };
+};
+
+template <>
+struct EnumNames<ExtensionType> {
+  static constexpr detail::EnumEntry<ExtensionType> values[] = {
+      {ExtensionType::server_name, "server_name"},
+      {ExtensionType::status_request, "status_request"},
+      {ExtensionType::supported_groups, "supported_groups"},
+      {ExtensionType::signature_algorithms, "signature_algorithms"},
+      {ExtensionType::application_layer_protocol_negotiation,
+       "application_layer_protocol_negotiation"},
+      {ExtensionType::signed_certificate_timestamp,
+       "signed_certificate_timestamp"},
+      {ExtensionType::client_certificate_type, "client_certificate_type"},
+      {ExtensionType::server_certificate_type, "server_certificate_type"},
+      {ExtensionType::token_binding, "token_binding"},
+      {ExtensionType::quic_transport_parameters, "quic_transport_parameters"},
+      {ExtensionType::compress_certificate, "compress_certificate"},
+      {ExtensionType::delegated_credential, "delegated_credential"},
+      {ExtensionType::key_share_old, "key_share_old"},
+      {ExtensionType::pre_shared_key, "pre_shared_key"},
+      {ExtensionType::early_data, "early_data"},
+      {ExtensionType::supported_versions, "supported_version"},
+      {ExtensionType::cookie, "cookie"},
+      {ExtensionType::psk_key_exchange_modes, "psk_key_exchange_modes"},
+      {ExtensionType::certificate_authorities, "certificate_authorities"},
+      {ExtensionType::post_handshake_auth, "post_handshake_auth"},
+      {ExtensionType::signature_algorithms_cert, "signature_algorithms_cert"},
+      {ExtensionType::key_share, "key_share"},
+      {ExtensionType::alternate_server_name, "alternate_server_name"},
+  };
+};
+
+template <>
+struct EnumNames<AlertDescription> {
+  static constexpr detail::EnumEntry<AlertDescription> values[] = {
+      {AlertDescription::close_notify, "close_notify"},
+      {AlertDescription::end_of_early_data, "end_of_early_data"},
+      {AlertDescription::unexpected_message, "unexpected_message"},
+      {AlertDescription::bad_record_mac, "bad_record_mac"},
+      {AlertDescription::record_overflow, "record_overflow"},
+      {AlertDescription::handshake_failure, "handshake_failure"},
+      {AlertDescription::bad_certificate, "bad_certificate"},
+      {AlertDescription::unsupported_certificate, "unsupported_certificate"},
+      {AlertDescription::certificate_revoked, "certificate_revoked"},
+      {AlertDescription::certificate_expired, "certificate_expired"},
+      {AlertDescription::certificate_unknown, "certificate_unknown"},
+      {AlertDescription::illegal_parameter, "illegal_parameter"},
+      {AlertDescription::unknown_ca, "unknown_ca"},
+      {AlertDescription::access_denied, "access_denied"},
+      {AlertDescription::decode_error, "decode_error"},
+      {AlertDescription::decrypt_error, "decrypt_error"},
+      {AlertDescription::protocol_version, "protocol_version"},
+      {AlertDescription::insufficient_security, "insufficient_security"},
+      {AlertDescription::internal_error, "internal_error"},
+      {AlertDescription::inappropriate_fallback, "inappropriate_fallback"},
+      {AlertDescription::user_canceled, "user_canceled"},
+      {AlertDescription::missing_extension, "missing_extension"},
+      {AlertDescription::unsupported_extension, "unsupported_extension"},
+      {AlertDescription::certificate_unobtainable, "certificate_unobtainable"},
+      {AlertDescription::unrecognized_name, "unrecognized_name"},
+      {AlertDescription::bad_certificate_status_response,
+       "bad_certificate_status_response"},
+      {AlertDescription::bad_certificate_hash_value,
+       "bad_certificate_hash_value"},
+      {AlertDescription::unknown_psk_identity, "unknown_psk_identity"},
+      {AlertDescription::certificate_required, "certificate_required"},
+  };
+};
+
+template <>
+struct EnumNames<CipherSuite> {
+  static constexpr detail::EnumEntry<CipherSuite> values[] = {
+      {CipherSuite::TLS_AES_128_GCM_SHA256, "TLS_AES_128_GCM_SHA256"},
+      {CipherSuite::TLS_AES_256_GCM_SHA384, "TLS_AES_256_GCM_SHA384"},
+      {CipherSuite::TLS_CHACHA20_POLY1305_SHA256,
+       "TLS_CHACHA20_POLY1305_SHA256"},
+      {CipherSuite::TLS_AES_128_OCB_SHA256_EXPERIMENTAL,
+       "TLS_AES_128_OCB_SHA256_EXPERIMENTAL"},
+  };
+};
+
+template <>
+struct EnumNames<EncryptionLevel> {
+  static constexpr detail::EnumEntry<EncryptionLevel> values[] = {
+      {EncryptionLevel::Plaintext, "Plaintext"},
+      {EncryptionLevel::Handshake, "Handshake"},
+      {EncryptionLevel::EarlyData, "EarlyData"},
+      {EncryptionLevel::AppTraffic, "AppTraffic"},
+  };
+};
+
+template <>
+struct EnumNames<PskKeyExchangeMode> {
+  static constexpr detail::EnumEntry<PskKeyExchangeMode> values[] = {
+      {PskKeyExchangeMode::psk_ke, "psk_ke"},
+      {PskKeyExchangeMode::psk_dhe_ke, "psk_dhe_ke"},
+  };
+};
+
+template <>
+struct EnumNames<SignatureScheme> {
+  static constexpr detail::EnumEntry<SignatureScheme> values[] = {
+      {SignatureScheme::ecdsa_secp256r1_sha256, "ecdsa_secp256r1_sha256"},
+      {SignatureScheme::ecdsa_secp384r1_sha384, "ecdsa_secp384r1_sha384"},
+      {SignatureScheme::ecdsa_secp521r1_sha512, "ecdsa_secp521r1_sha512"},
+      {SignatureScheme::rsa_pss_sha256, "rsa_pss_sha256"},
+      {SignatureScheme::rsa_pss_sha384, "rsa_pss_sha384"},
+      {SignatureScheme::rsa_pss_sha512, "rsa_pss_sha512"},
+      {SignatureScheme::ed25519, "ed25519"},
+      {SignatureScheme::ed448, "ed448"},
+  };
+};
+
+template <>
+struct EnumNames<CertificateType> {
+  static constexpr detail::EnumEntry<CertificateType> values[] = {
+      {CertificateType::X509, "X509"},
+      {CertificateType::RawPublicKey, "RawPublicKey"},
+  };
+};
+
+template <>
+struct EnumNames<CertificateStatusType> {
+  static constexpr detail::EnumEntry<CertificateStatusType> values[] = {
+      {CertificateStatusType::ocsp, "ocsp"},
+  };
+};
+
+template <>
+struct EnumNames<CertificateCompressionAlgorithm> {
+  static constexpr detail::EnumEntry<CertificateCompressionAlgorithm>
+      values[] = {
+          {CertificateCompressionAlgorithm::zlib, "zlib"},
+          {CertificateCompressionAlgorithm::brotli, "brotli"},
+          {CertificateCompressionAlgorithm::zstd, "zstd"},
+      };
+};
+
+template <>
+struct EnumNames<NamedGroup> {
+  static constexpr detail::EnumEntry<NamedGroup> values[] = {
+      {NamedGroup::secp256r1, "secp256r1"},
+      {NamedGroup::secp384r1, "secp384r1"},
+      {NamedGroup::secp521r1, "secp521r1"},
+      {NamedGroup::x25519, "x25519"},
+      {NamedGroup::x25519_kyber768_draft00, "x25519_kyber768_draft00"},
+  };
+};
+
+template <class T>
+constexpr folly::StringPiece enumName(T value) {
+  for (const auto& entry : EnumNames<T>::values) {
+    if (entry.value == value) {
+      return entry.name;
+    }
+  }
+  return folly::StringPiece();
+}
+
+template <class T>
+constexpr bool isKnownValue(T value) {
+  return !enumName(value).empty();
+}
+
 template <typename T>
 std::string enumToHex(T enumValue) {
   auto value = folly::Endian::big(
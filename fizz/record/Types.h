@@ -49,6 +49,18 @@ enum class ContentType : uint8_t {
   change_cipher_spec = 20,
 };
 
+/**
+ * The keys a record layer protects its data with.
+ */
+enum class EncryptionLevel : uint8_t {
+  Plaintext,
+  Handshake,
+  EarlyData,
+  AppTraffic,
+};
+
+std::string toString(EncryptionLevel);
+
 struct TLSMessage {
   ContentType type;
   Buf fragment;
@@ -69,6 +81,7 @@ enum class HandshakeType : uint8_t {
   certificate_verify = 15,
   finished = 20,
   key_update = 24,
+  compressed_certificate = 25,
   message_hash = 254
 };
 
@@ -89,11 +102,17 @@ struct HandshakeStruct : EventType<e> {
 
 enum class ExtensionType : uint16_t {
   server_name = 0,
+  status_request = 5,
   supported_groups = 10,
   signature_algorithms = 13,
   application_layer_protocol_negotiation = 16,
+  signed_certificate_timestamp = 18,
+  client_certificate_type = 19,
+  server_certificate_type = 20,
   token_binding = 24,
   quic_transport_parameters = 26,
+  compress_certificate = 27,
+  delegated_credential = 34,
   key_share_old = 40,
   pre_shared_key = 41,
   early_data = 42,
@@ -216,9 +235,15 @@ struct EncryptedExtensions : HandshakeStruct<
   std::vector<Extension> extensions;
 };
 
+class PeerCert;
+
 struct CertificateEntry {
   Buf cert_data;
   std::vector<Extension> extensions;
+
+  // cert_data as parsed by the record layer while the rest of the message was
+  // still arriving (see ReadRecordLayer::setCertificateParser()), or null.
+  std::shared_ptr<const PeerCert> parsedCert;
 };
 
 struct CertificateMsg
@@ -227,6 +252,35 @@ struct CertificateMsg
   std::vector<CertificateEntry> certificate_list;
 };
 
+enum class CertificateType : uint8_t {
+  X509 = 0,
+  RawPublicKey = 2,
+};
+
+std::string toString(CertificateType);
+
+enum class CertificateStatusType : uint8_t {
+  ocsp = 1,
+};
+
+std::string toString(CertificateStatusType);
+
+enum class CertificateCompressionAlgorithm : uint16_t {
+  zlib = 1,
+  brotli = 2,
+  zstd = 3,
+};
+
+std::string toString(CertificateCompressionAlgorithm);
+
+struct CompressedCertificate : HandshakeStruct<
+                                   Event::CompressedCertificate,
+                                   HandshakeType::compressed_certificate> {
+  CertificateCompressionAlgorithm algorithm;
+  uint32_t uncompressed_length; // Limited to 2^24-1.
+  Buf compressed_certificate_message;
+};
+
 struct CertificateRequest : HandshakeStruct<
                                 Event::CertificateRequest,
                                 HandshakeType::certificate_request> {
@@ -283,7 +337,9 @@ enum class NamedGroup : uint16_t {
   secp256r1 = 23,
   secp384r1 = 24,
   secp521r1 = 25,
-  x25519 = 29
+  x25519 = 29,
+  // X25519 combined with Kyber768, draft-tls-westerbaan-xyber768d00.
+  x25519_kyber768_draft00 = 0x6399
 };
 
 std::string toString(NamedGroup);
@@ -319,6 +375,24 @@ template <class T>
 T decode(folly::io::Cursor& cursor);
 template <typename T>
 std::string enumToHex(T enumValue);
+
+/**
+ * Compile time tables of the names of an enum's known values, specialized
+ * with a constexpr list of {value, name} entries for each enum that has a
+ * toString(). enumName() and isKnownValue() are derived from the table and
+ * don't allocate, toString() falls back to hex for unknown values.
+ */
+template <class T>
+struct EnumNames;
+
+/**
+ * Name of value, or an empty StringPiece if it is not a known value.
+ */
+template <class T>
+constexpr folly::StringPiece enumName(T value);
+
+template <class T>
+constexpr bool isKnownValue(T value);
 } // namespace fizz
 
 #include <fizz/record/Types-inl.h>
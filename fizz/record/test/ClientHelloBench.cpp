@@ -0,0 +1,81 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <fizz/record/ClientHelloCheck.h>
+#include <fizz/record/Extensions.h>
+
+using namespace fizz;
+
+// A ClientHello with size cipher suites and size empty extensions.
+std::unique_ptr<folly::IOBuf> makeHostileClientHello(size_t size) {
+  ClientHello chlo;
+  chlo.random.fill(0x44);
+  chlo.legacy_session_id = folly::IOBuf::create(0);
+  chlo.legacy_compression_methods.push_back(0x00);
+  chlo.cipher_suites.resize(size, CipherSuite::TLS_AES_128_GCM_SHA256);
+  SupportedVersions supportedVersions;
+  supportedVersions.versions.push_back(ProtocolVersion::tls_1_3);
+  chlo.extensions.push_back(encodeExtension(std::move(supportedVersions)));
+  for (size_t i = 0; i < size; ++i) {
+    Extension ext;
+    ext.extension_type = static_cast<ExtensionType>(0xff00);
+    ext.extension_data = folly::IOBuf::create(0);
+    chlo.extensions.push_back(std::move(ext));
+  }
+  return encode(std::move(chlo));
+}
+
+void decodeClientHello(uint32_t n, size_t size) {
+  std::unique_ptr<folly::IOBuf> encoded;
+  BENCHMARK_SUSPEND {
+    encoded = makeHostileClientHello(size);
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    auto chlo = decode<ClientHello>(encoded->clone());
+    folly::doNotOptimizeAway(chlo);
+  }
+}
+
+void checkAndRejectClientHello(uint32_t n, size_t size) {
+  std::unique_ptr<folly::IOBuf> encoded;
+  BENCHMARK_SUSPEND {
+    encoded = makeHostileClientHello(size);
+  }
+  ClientHelloLimits limits;
+  for (uint32_t i = 0; i < n; ++i) {
+    try {
+      checkClientHello(*encoded, limits);
+    } catch (const FizzException& e) {
+      folly::doNotOptimizeAway(e);
+    }
+  }
+}
+
+void checkClientHelloOnly(uint32_t n, size_t size) {
+  std::unique_ptr<folly::IOBuf> encoded;
+  BENCHMARK_SUSPEND {
+    encoded = makeHostileClientHello(size);
+  }
+  ClientHelloLimits limits;
+  limits.maxCipherSuites = size;
+  limits.maxExtensions = size + 1;
+  for (uint32_t i = 0; i < n; ++i) {
+    checkClientHello(*encoded, limits);
+  }
+}
+
+BENCHMARK_PARAM(decodeClientHello, 10);
+BENCHMARK_PARAM(decodeClientHello, 1000);
+BENCHMARK_PARAM(decodeClientHello, 10000);
+BENCHMARK_PARAM(checkAndRejectClientHello, 1000);
+BENCHMARK_PARAM(checkAndRejectClientHello, 10000);
+BENCHMARK_PARAM(checkClientHelloOnly, 10);
+BENCHMARK_PARAM(checkClientHelloOnly, 1000);
+BENCHMARK_PARAM(checkClientHelloOnly, 10000);
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
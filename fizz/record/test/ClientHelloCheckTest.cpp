@@ -0,0 +1,164 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/test/TestMessages.h>
+#include <fizz/record/ClientHelloCheck.h>
+
+#include <random>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+class ClientHelloCheckTest : public testing::Test {
+ protected:
+  void expectRejected(const ClientHello& chlo) {
+    EXPECT_THROW(checkClientHello(*encode(chlo), limits_), FizzException);
+  }
+
+  ClientHelloLimits limits_;
+};
+
+TEST_F(ClientHelloCheckTest, TestValid) {
+  checkClientHello(*encode(TestMessages::clientHello()), limits_);
+  checkClientHello(*encode(TestMessages::clientHelloPskEarly()), limits_);
+
+  auto noExtensions = TestMessages::clientHello();
+  noExtensions.extensions.clear();
+  auto encoded = encode(noExtensions);
+  encoded->trimEnd(sizeof(uint16_t));
+  checkClientHello(*encoded, limits_);
+}
+
+TEST_F(ClientHelloCheckTest, TestChained) {
+  auto encoded = encode(TestMessages::clientHelloPsk());
+  auto chain = IOBuf::create(0);
+  for (auto byte : encoded->coalesce()) {
+    chain->prependChain(IOBuf::copyBuffer(&byte, 1));
+  }
+  checkClientHello(*chain, limits_);
+  chain->prev()->trimEnd(1);
+  EXPECT_THROW(checkClientHello(*chain, limits_), FizzException);
+}
+
+TEST_F(ClientHelloCheckTest, TestTooManyCipherSuites) {
+  auto chlo = TestMessages::clientHello();
+  chlo.cipher_suites.resize(
+      limits_.maxCipherSuites, CipherSuite::TLS_AES_128_GCM_SHA256);
+  checkClientHello(*encode(chlo), limits_);
+  chlo.cipher_suites.push_back(CipherSuite::TLS_AES_128_GCM_SHA256);
+  expectRejected(chlo);
+}
+
+TEST_F(ClientHelloCheckTest, TestTooManyExtensions) {
+  auto chlo = TestMessages::clientHello();
+  while (chlo.extensions.size() <= limits_.maxExtensions) {
+    Extension ext;
+    ext.extension_type = static_cast<ExtensionType>(0xff00);
+    ext.extension_data = IOBuf::create(0);
+    chlo.extensions.push_back(std::move(ext));
+  }
+  expectRejected(chlo);
+}
+
+TEST_F(ClientHelloCheckTest, TestTooManyKeyShares) {
+  auto chlo = TestMessages::clientHello();
+  ClientKeyShare keyShare;
+  for (size_t i = 0; i <= limits_.maxKeyShares; ++i) {
+    KeyShareEntry entry;
+    entry.group = NamedGroup::x25519;
+    entry.key_exchange = IOBuf::copyBuffer("keyshare");
+    keyShare.client_shares.push_back(std::move(entry));
+  }
+  auto it = findExtension(chlo.extensions, ExtensionType::key_share);
+  chlo.extensions.erase(it);
+  chlo.extensions.push_back(encodeExtension(std::move(keyShare)));
+  expectRejected(chlo);
+}
+
+TEST_F(ClientHelloCheckTest, TestTooManyPskIdentities) {
+  auto chlo = TestMessages::clientHello();
+  ClientPresharedKey psk;
+  for (size_t i = 0; i <= limits_.maxPskIdentities; ++i) {
+    PskIdentity identity;
+    identity.psk_identity = IOBuf::copyBuffer("ident");
+    identity.obfuscated_ticket_age = 0;
+    psk.identities.push_back(std::move(identity));
+  }
+  PskBinder binder;
+  binder.binder = IOBuf::copyBuffer("binder");
+  psk.binders.push_back(std::move(binder));
+  chlo.extensions.push_back(encodeExtension(std::move(psk)));
+  expectRejected(chlo);
+
+  limits_.maxPskIdentities++;
+  checkClientHello(*encode(chlo), limits_);
+}
+
+TEST_F(ClientHelloCheckTest, TestBadFraming) {
+  auto encoded = encode(TestMessages::clientHello())->coalesce().str();
+  auto noExtensions = TestMessages::clientHello();
+  noExtensions.extensions.clear();
+  // Stopping right before the extensions is valid.
+  auto extensionsStart =
+      encode(noExtensions)->computeChainDataLength() - sizeof(uint16_t);
+  for (size_t length = 0; length < encoded.size(); ++length) {
+    if (length == extensionsStart) {
+      continue;
+    }
+    EXPECT_THROW(
+        checkClientHello(*IOBuf::copyBuffer(encoded.data(), length), limits_),
+        FizzException);
+  }
+  encoded.push_back(0);
+  EXPECT_THROW(
+      checkClientHello(*IOBuf::copyBuffer(encoded), limits_), FizzException);
+}
+
+TEST_F(ClientHelloCheckTest, TestFuzz) {
+  // Whatever the check accepts, decoding must accept too.
+  std::mt19937 gen(12345);
+  auto original =
+      encode(TestMessages::clientHelloPskEarly())->coalesce().str();
+  limits_.maxPskIdentities = 2;
+  for (size_t i = 0; i < 20000; ++i) {
+    auto mutated = original;
+    auto mutations = gen() % 4 + 1;
+    for (size_t j = 0; j < mutations; ++j) {
+      auto pos = gen() % mutated.size();
+      switch (gen() % 3) {
+        case 0:
+          mutated[pos] = static_cast<char>(gen());
+          break;
+        case 1:
+          mutated.erase(pos, 1);
+          break;
+        default:
+          mutated.insert(pos, 1, static_cast<char>(gen()));
+      }
+      if (mutated.empty()) {
+        break;
+      }
+    }
+    auto buf = IOBuf::copyBuffer(mutated);
+    bool accepted = true;
+    try {
+      checkClientHello(*buf, limits_);
+    } catch (const FizzException&) {
+      accepted = false;
+    }
+    if (accepted) {
+      EXPECT_NO_THROW(decode<ClientHello>(std::move(buf)));
+    }
+  }
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/test/TestMessages.h>
+#include <fizz/record/ClientHelloInspector.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace test {
+
+class ClientHelloInspectorTest : public testing::Test {
+ protected:
+  static std::string record(ClientHello chlo) {
+    auto hello = encodeHandshake(std::move(chlo));
+    std::string out{0x16, 0x03, 0x01, 0x00, 0x00};
+    for (auto range : *hello) {
+      out.append(reinterpret_cast<const char*>(range.data()), range.size());
+    }
+    setRecordLength(out, out.size() - 5);
+    return out;
+  }
+
+  static void setRecordLength(std::string& data, size_t length) {
+    data[3] = static_cast<char>(length >> 8);
+    data[4] = static_cast<char>(length & 0xff);
+  }
+
+  ClientHelloInspection inspect(StringPiece data) {
+    return inspectClientHello(ByteRange(data), info_);
+  }
+
+  ClientHelloInfo info_;
+};
+
+TEST_F(ClientHelloInspectorTest, TestInspect) {
+  auto data = record(TestMessages::clientHello());
+  EXPECT_EQ(inspect(data), ClientHelloInspection::Done);
+  EXPECT_EQ(info_.legacyVersion, ProtocolVersion::tls_1_2);
+  EXPECT_EQ(StringPiece(info_.serverName), "www.hostname.com");
+  EXPECT_TRUE(info_.offersAlpn("h2"));
+  EXPECT_FALSE(info_.offersAlpn("h3"));
+  EXPECT_TRUE(info_.supportsVersion(TestProtocolVersion));
+  EXPECT_FALSE(info_.supportsVersion(ProtocolVersion::tls_1_2));
+  EXPECT_FALSE(info_.hasPsk);
+}
+
+TEST_F(ClientHelloInspectorTest, TestPsk) {
+  auto data = record(TestMessages::clientHelloPsk());
+  EXPECT_EQ(inspect(data), ClientHelloInspection::Done);
+  EXPECT_TRUE(info_.hasPsk);
+}
+
+TEST_F(ClientHelloInspectorTest, TestNoExtensions) {
+  auto chlo = TestMessages::clientHello();
+  chlo.extensions.clear();
+  auto data = record(std::move(chlo));
+  // Drop the empty extensions vector, and fix up both lengths.
+  data.resize(data.size() - 2);
+  setRecordLength(data, data.size() - 5);
+  data[8] -= 2;
+  EXPECT_EQ(inspect(data), ClientHelloInspection::Done);
+  EXPECT_TRUE(info_.serverName.empty());
+  EXPECT_TRUE(info_.alpnProtocols.empty());
+  EXPECT_FALSE(info_.supportsVersion(TestProtocolVersion));
+}
+
+TEST_F(ClientHelloInspectorTest, TestNeedMoreData) {
+  auto data = record(TestMessages::clientHello());
+  for (size_t i = 0; i < data.size(); ++i) {
+    EXPECT_EQ(
+        inspect(StringPiece(data).subpiece(0, i)),
+        ClientHelloInspection::NeedMoreData);
+  }
+}
+
+TEST_F(ClientHelloInspectorTest, TestNotClientHello) {
+  EXPECT_EQ(inspect("GET / HTTP/1.1\r\n"), ClientHelloInspection::Invalid);
+  auto data = record(TestMessages::clientHello());
+  data[5] = static_cast<char>(HandshakeType::server_hello);
+  EXPECT_EQ(inspect(data), ClientHelloInspection::Invalid);
+}
+
+TEST_F(ClientHelloInspectorTest, TestSplitOverRecords) {
+  auto data = record(TestMessages::clientHello());
+  // Shorten the record so the hello continues past it.
+  setRecordLength(data, data.size() - 6);
+  EXPECT_EQ(inspect(data), ClientHelloInspection::Invalid);
+}
+
+TEST_F(ClientHelloInspectorTest, TestMalformedExtension) {
+  auto chlo = TestMessages::clientHello();
+  Extension ext;
+  ext.extension_type = ExtensionType::application_layer_protocol_negotiation;
+  ext.extension_data = IOBuf::copyBuffer(std::string("\x00\x05\x02h2", 5));
+  chlo.extensions.push_back(std::move(ext));
+  auto data = record(std::move(chlo));
+  EXPECT_EQ(inspect(data), ClientHelloInspection::Invalid);
+  EXPECT_TRUE(info_.serverName.empty());
+}
+} // namespace test
+} // namespace fizz
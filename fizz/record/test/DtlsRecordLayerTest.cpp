@@ -0,0 +1,336 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/record/DtlsRecordLayer.h>
+
+#include <fizz/crypto/aead/AESGCM128.h>
+#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
+#include <folly/String.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+
+using namespace folly;
+using namespace folly::io;
+
+namespace fizz {
+namespace test {
+
+static const std::string kSecret(32, '\x01');
+
+static std::unique_ptr<Aead> makeAead() {
+  auto aead = std::make_unique<OpenSSLEVPCipher<AESGCM128>>();
+  TrafficKey key;
+  key.key = IOBuf::copyBuffer(unhexlify("000102030405060708090a0b0c0d0e0f"));
+  key.iv = IOBuf::copyBuffer(unhexlify("000102030405060708090a0b"));
+  aead->setKey(std::move(key));
+  return std::move(aead);
+}
+
+template <typename RecordLayer>
+static void setKeys(RecordLayer& recordLayer) {
+  recordLayer.trafficSecretAvailable(
+      CipherSuite::TLS_AES_128_GCM_SHA256, StringPiece(kSecret));
+  recordLayer.setAead(makeAead());
+}
+
+class DtlsRecordLayerTest : public testing::Test {
+  void SetUp() override {
+    setKeys(read_);
+    setKeys(write_);
+  }
+
+ protected:
+  DtlsReadRecordLayer read_;
+  DtlsWriteRecordLayer write_;
+
+  IOBufQueue queue_{IOBufQueue::cacheChainLength()};
+
+  IOBufEqualTo eq_;
+
+  Buf writeAppData(const std::string& data) {
+    TLSMessage msg{ContentType::application_data, IOBuf::copyBuffer(data)};
+    return write_.write(std::move(msg));
+  }
+
+  void expectAppData(const std::string& data) {
+    auto msg = read_.read(queue_);
+    ASSERT_TRUE(msg.hasValue());
+    EXPECT_EQ(msg->type, ContentType::application_data);
+    EXPECT_TRUE(eq_(msg->fragment, IOBuf::copyBuffer(data)));
+  }
+};
+
+TEST_F(DtlsRecordLayerTest, TestRoundTrip) {
+  auto buf = writeAppData("hello");
+  buf->coalesce();
+  // Unified header, 16 bit sequence number, length, epoch 3. The record is
+  // the content, the content type and the tag.
+  EXPECT_EQ(buf->data()[0], 0x2f);
+  EXPECT_EQ(buf->length(), kDtlsHeaderSize + 5 + 1 + 16);
+  Cursor cursor(buf.get());
+  cursor.skip(3);
+  EXPECT_EQ(cursor.readBE<uint16_t>(), 5 + 1 + 16);
+
+  queue_.append(std::move(buf));
+  expectAppData("hello");
+  EXPECT_TRUE(queue_.empty());
+  EXPECT_FALSE(read_.read(queue_).hasValue());
+}
+
+TEST_F(DtlsRecordLayerTest, TestHandshakeRoundTrip) {
+  TLSMessage msg{ContentType::handshake, IOBuf::copyBuffer("finished")};
+  queue_.append(write_.write(std::move(msg)));
+  auto read = read_.read(queue_);
+  ASSERT_TRUE(read.hasValue());
+  EXPECT_EQ(read->type, ContentType::handshake);
+  EXPECT_TRUE(eq_(read->fragment, IOBuf::copyBuffer("finished")));
+}
+
+TEST_F(DtlsRecordLayerTest, TestSequenceNumberEncrypted) {
+  DtlsSequenceNumberCipher cipher;
+  cipher.setKey(CipherSuite::TLS_AES_128_GCM_SHA256, StringPiece(kSecret));
+  for (uint8_t i = 0; i < 3; ++i) {
+    auto buf = writeAppData("data");
+    buf->coalesce();
+    auto header = buf->writableData();
+    auto ciphertext = IOBuf::wrapBuffer(
+        buf->data() + kDtlsHeaderSize, buf->length() - kDtlsHeaderSize);
+    cipher.apply(*ciphertext, MutableByteRange(header + 1, 2));
+    EXPECT_EQ(header[1], 0);
+    EXPECT_EQ(header[2], i);
+  }
+}
+
+TEST_F(DtlsRecordLayerTest, TestSplitRecords) {
+  write_.setMaxRecord(4);
+  auto buf = writeAppData("0123456789");
+  EXPECT_EQ(
+      buf->computeChainDataLength(), 3 * (kDtlsHeaderSize + 1 + 16) + 10);
+  queue_.append(std::move(buf));
+  expectAppData("0123");
+  expectAppData("4567");
+  expectAppData("89");
+  EXPECT_FALSE(read_.read(queue_).hasValue());
+}
+
+TEST_F(DtlsRecordLayerTest, TestEpochMismatchDropped) {
+  DtlsReadRecordLayer handshakeRead(EncryptionLevel::Handshake);
+  setKeys(handshakeRead);
+  EXPECT_EQ(handshakeRead.getEpoch(), 2);
+  queue_.append(writeAppData("hello"));
+  EXPECT_FALSE(handshakeRead.read(queue_).hasValue());
+  EXPECT_TRUE(queue_.empty());
+}
+
+TEST_F(DtlsRecordLayerTest, TestAllWritePaths) {
+  std::string data(192, 'a');
+  auto makeWrite = []() {
+    auto write = std::make_unique<DtlsWriteRecordLayer>();
+    setKeys(*write);
+    write->setMaxRecord(16);
+    return write;
+  };
+  auto appData = [&]() {
+    return TLSMessage{ContentType::application_data, IOBuf::copyBuffer(data)};
+  };
+  auto expected = makeWrite()->write(appData());
+  auto expectRecords = [&](Buf buf) {
+    EXPECT_TRUE(eq_(buf, expected));
+    DtlsReadRecordLayer read;
+    setKeys(read);
+    queue_.append(std::move(buf));
+    size_t records = 0;
+    while (auto msg = read.read(queue_)) {
+      EXPECT_EQ(msg->fragment->computeChainDataLength(), 16);
+      records++;
+    }
+    EXPECT_EQ(records, 12);
+  };
+
+  {
+    // Data still referenced by the caller is encrypted from where it is.
+    auto shared = IOBuf::copyBuffer(data);
+    expectRecords(makeWrite()->write(
+        TLSMessage{ContentType::application_data, shared->clone()}));
+  }
+  {
+    IOBufQueue queue;
+    queue.append(IOBuf::copyBuffer(data));
+    expectRecords(
+        makeWrite()->writeBatch(ContentType::application_data, queue));
+  }
+  {
+    RecordIovecs iov;
+    makeWrite()->writeIovecs(appData(), iov);
+    std::string written;
+    for (const auto& vec : iov.iovecs) {
+      written.append(static_cast<const char*>(vec.iov_base), vec.iov_len);
+    }
+    expectRecords(IOBuf::copyBuffer(written));
+  }
+  {
+    auto write = makeWrite();
+    ParallelEncryptionOptions options;
+    options.executor = std::make_shared<CPUThreadPoolExecutor>(2);
+    options.minBytes = 100;
+    write->setParallelEncryption(std::move(options));
+    expectRecords(write->write(appData()));
+  }
+}
+
+TEST_F(DtlsRecordLayerTest, TestKeyUpdateGeneration) {
+  DtlsWriteRecordLayer write;
+  write.setKeyUpdateGeneration(2);
+  EXPECT_EQ(write.getEpoch(), 5);
+  DtlsReadRecordLayer read;
+  read.setKeyUpdateGeneration(2);
+  EXPECT_EQ(read.getEpoch(), 5);
+}
+
+TEST_F(DtlsRecordLayerTest, TestKeyUpdateEpoch) {
+  write_.setEpoch(4);
+  queue_.append(writeAppData("hello"));
+  EXPECT_FALSE(read_.read(queue_).hasValue());
+  EXPECT_TRUE(queue_.empty());
+
+  DtlsReadRecordLayer updated;
+  setKeys(updated);
+  updated.setEpoch(4);
+  queue_.append(writeAppData("world"));
+  auto msg = updated.read(queue_);
+  ASSERT_TRUE(msg.hasValue());
+  EXPECT_TRUE(eq_(msg->fragment, IOBuf::copyBuffer("world")));
+}
+
+TEST_F(DtlsRecordLayerTest, TestReplayDropped) {
+  auto buf = writeAppData("hello");
+  queue_.append(buf->clone());
+  expectAppData("hello");
+  queue_.append(std::move(buf));
+  EXPECT_FALSE(read_.read(queue_).hasValue());
+  EXPECT_TRUE(queue_.empty());
+}
+
+TEST_F(DtlsRecordLayerTest, TestReordering) {
+  auto first = writeAppData("first");
+  auto second = writeAppData("second");
+  auto third = writeAppData("third");
+
+  queue_.append(std::move(third));
+  expectAppData("third");
+  queue_.append(first->clone());
+  expectAppData("first");
+  queue_.append(std::move(second));
+  expectAppData("second");
+
+  queue_.append(std::move(first));
+  EXPECT_FALSE(read_.read(queue_).hasValue());
+}
+
+TEST_F(DtlsRecordLayerTest, TestOutsideReplayWindow) {
+  auto old = writeAppData("old");
+  for (size_t i = 0; i < 64; ++i) {
+    queue_.append(writeAppData("new"));
+    expectAppData("new");
+  }
+  queue_.append(std::move(old));
+  EXPECT_FALSE(read_.read(queue_).hasValue());
+}
+
+TEST_F(DtlsRecordLayerTest, TestDecryptionFailureDropped) {
+  auto bad = writeAppData("bad");
+  bad->coalesce();
+  bad->writableData()[bad->length() - 1] ^= 0x01;
+  queue_.append(std::move(bad));
+  queue_.append(writeAppData("good"));
+  expectAppData("good");
+  EXPECT_TRUE(queue_.empty());
+}
+
+TEST_F(DtlsRecordLayerTest, TestTruncatedDropped) {
+  auto buf = writeAppData("hello");
+  buf->coalesce();
+  buf->trimEnd(1);
+  queue_.append(std::move(buf));
+  EXPECT_FALSE(read_.read(queue_).hasValue());
+  EXPECT_TRUE(queue_.empty());
+}
+
+TEST_F(DtlsRecordLayerTest, TestPlaintextRecordSkipped) {
+  queue_.append(IOBuf::copyBuffer(unhexlify("16fefd000000000000000000020101")));
+  queue_.append(writeAppData("hello"));
+  expectAppData("hello");
+}
+
+TEST(DtlsPlaintextRecordLayerTest, TestRoundTrip) {
+  DtlsPlaintextWriteRecordLayer write;
+  auto first = write.writeInitialClientHello(IOBuf::copyBuffer("hello"));
+  // Type, version, epoch, sequence number, length.
+  EXPECT_EQ(
+      hexlify(first->coalesce()),
+      "16" "fefd" "0000" "000000000000" "0005" "68656c6c6f");
+  auto second =
+      write.write(TLSMessage{ContentType::alert, IOBuf::copyBuffer("bye")});
+  EXPECT_EQ(
+      hexlify(second->coalesce()),
+      "15" "fefd" "0000" "000000000001" "0003" "627965");
+
+  DtlsPlaintextReadRecordLayer read;
+  IOBufQueue queue{IOBufQueue::cacheChainLength()};
+  queue.append(std::move(first));
+  queue.append(std::move(second));
+  auto msg = read.read(queue);
+  ASSERT_TRUE(msg.hasValue());
+  EXPECT_EQ(msg->type, ContentType::handshake);
+  EXPECT_TRUE(IOBufEqualTo()(msg->fragment, IOBuf::copyBuffer("hello")));
+  msg = read.read(queue);
+  ASSERT_TRUE(msg.hasValue());
+  EXPECT_EQ(msg->type, ContentType::alert);
+  EXPECT_TRUE(IOBufEqualTo()(msg->fragment, IOBuf::copyBuffer("bye")));
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(DtlsPlaintextRecordLayerTest, TestOtherRecordsDropped) {
+  DtlsPlaintextReadRecordLayer read;
+  IOBufQueue queue{IOBufQueue::cacheChainLength()};
+  // Epoch 1, a change_cipher_spec, a DTLSCiphertext record and then a
+  // handshake record.
+  queue.append(IOBuf::copyBuffer(unhexlify(
+      "16" "fefd" "0001" "000000000000" "0001" "aa"
+      "14" "fefd" "0000" "000000000001" "0001" "01"
+      "2d" "0001" "0002" "00ff"
+      "16" "fefd" "0000" "000000000002" "0001" "01")));
+  auto msg = read.read(queue);
+  ASSERT_TRUE(msg.hasValue());
+  EXPECT_EQ(msg->type, ContentType::handshake);
+  EXPECT_TRUE(IOBufEqualTo()(msg->fragment, IOBuf::copyBuffer("\x01")));
+  EXPECT_TRUE(queue.empty());
+
+  // Truncated.
+  queue.append(IOBuf::copyBuffer(
+      unhexlify("16" "fefd" "0000" "000000000003" "0005" "0101")));
+  EXPECT_FALSE(read.read(queue).hasValue());
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(DtlsPlaintextRecordLayerTest, TestRefusesAppData) {
+  DtlsPlaintextWriteRecordLayer write;
+  EXPECT_THROW(
+      write.write(TLSMessage{ContentType::application_data,
+                             IOBuf::copyBuffer("data")}),
+      std::runtime_error);
+}
+
+TEST_F(DtlsRecordLayerTest, TestNoAead) {
+  DtlsWriteRecordLayer write;
+  TLSMessage msg{ContentType::application_data, IOBuf::copyBuffer("hello")};
+  EXPECT_THROW(write.write(std::move(msg)), std::runtime_error);
+}
+} // namespace test
+} // namespace fizz
@@ -11,8 +11,12 @@
 
 #include <fizz/record/EncryptedRecordLayer.h>
 
+#include <fizz/crypto/aead/AESGCM128.h>
+#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
 #include <fizz/crypto/aead/test/Mocks.h>
 #include <folly/String.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/io/async/EventBase.h>
 
 using namespace folly;
 using namespace folly::io;
@@ -23,6 +27,11 @@ using namespace testing;
 namespace fizz {
 namespace test {
 
+class MockPlaintextBufferProvider : public PlaintextBufferProvider {
+ public:
+  MOCK_METHOD1(getPlaintextBuffer, folly::MutableByteRange(size_t));
+};
+
 class EncryptedRecordTest : public testing::Test {
   void SetUp() override {
     auto readAead = std::make_unique<MockAead>();
@@ -59,13 +68,22 @@ class EncryptedRecordTest : public testing::Test {
   }
 };
 
+TEST_F(EncryptedRecordTest, TestEncryptionLevel) {
+  EXPECT_EQ(read_.getEncryptionLevel(), EncryptionLevel::AppTraffic);
+  EXPECT_EQ(write_.getEncryptionLevel(), EncryptionLevel::AppTraffic);
+  EncryptedReadRecordLayer read(EncryptionLevel::Handshake);
+  EncryptedWriteRecordLayer write(EncryptionLevel::EarlyData);
+  EXPECT_EQ(read.getEncryptionLevel(), EncryptionLevel::Handshake);
+  EXPECT_EQ(write.getEncryptionLevel(), EncryptionLevel::EarlyData);
+}
+
 TEST_F(EncryptedRecordTest, TestReadEmpty) {
   EXPECT_FALSE(read_.read(queue_).hasValue());
 }
 
 TEST_F(EncryptedRecordTest, TestReadHandshake) {
   addToQueue("17030100050123456789");
-  EXPECT_CALL(*readAead_, _decrypt(_, _, 0))
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
       .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
         expectSame(buf, "0123456789");
         return getBuf("abcdef16");
@@ -78,7 +96,7 @@ TEST_F(EncryptedRecordTest, TestReadHandshake) {
 
 TEST_F(EncryptedRecordTest, TestReadAlert) {
   addToQueue("17030100050123456789");
-  EXPECT_CALL(*readAead_, _decrypt(_, _, 0))
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
       .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
         expectSame(buf, "0123456789");
         return getBuf("020215");
@@ -91,7 +109,7 @@ TEST_F(EncryptedRecordTest, TestReadAlert) {
 
 TEST_F(EncryptedRecordTest, TestReadAppData) {
   addToQueue("17030100050123456789");
-  EXPECT_CALL(*readAead_, _decrypt(_, _, 0))
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
       .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
         expectSame(buf, "0123456789");
         return getBuf("1234abcd17");
@@ -104,7 +122,7 @@ TEST_F(EncryptedRecordTest, TestReadAppData) {
 
 TEST_F(EncryptedRecordTest, TestReadUnknown) {
   addToQueue("17030100050123456789");
-  EXPECT_CALL(*readAead_, _decrypt(_, _, 0))
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
       .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
         expectSame(buf, "0123456789");
         return getBuf("1234abcd20");
@@ -112,6 +130,35 @@ TEST_F(EncryptedRecordTest, TestReadUnknown) {
   EXPECT_ANY_THROW(read_.read(queue_));
 }
 
+TEST_F(EncryptedRecordTest, TestTryReadDecryptFailure) {
+  addToQueue("17030100050123456789");
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
+      .WillOnce(
+          Invoke([](std::unique_ptr<IOBuf>& /*buf*/, const IOBuf*, uint64_t) {
+            return folly::none;
+          }));
+  auto msg = read_.tryRead(queue_);
+  ASSERT_TRUE(msg.hasError());
+  EXPECT_EQ(msg.error().message, "decryption failed");
+  EXPECT_EQ(read_.getSequenceNumber(), 0);
+}
+
+TEST_F(EncryptedRecordTest, TestTryReadOverSize) {
+  addToQueue("1603015000");
+  auto msg = read_.tryRead(queue_);
+  ASSERT_TRUE(msg.hasError());
+  EXPECT_FALSE(msg.error().alert.hasValue());
+}
+
+TEST_F(EncryptedRecordTest, TestTryReadBadCcs) {
+  addToQueue("140303000102");
+  auto msg = read_.tryRead(queue_);
+  ASSERT_TRUE(msg.hasError());
+  EXPECT_EQ(*msg.error().alert, AlertDescription::illegal_parameter);
+  addToQueue("140303000102");
+  EXPECT_THROW(read_.read(queue_), FizzException);
+}
+
 TEST_F(EncryptedRecordTest, TestWaitForData) {
   addToQueue("1703010010012345");
   EXPECT_FALSE(read_.read(queue_).hasValue());
@@ -137,7 +184,7 @@ TEST_F(EncryptedRecordTest, TestOverSize) {
 
 TEST_F(EncryptedRecordTest, TestDataRemaining) {
   addToQueue("17030100050123456789aa");
-  EXPECT_CALL(*readAead_, _decrypt(_, _, 0))
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
       .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
         expectSame(buf, "0123456789");
         return getBuf("abcdef16");
@@ -148,7 +195,7 @@ TEST_F(EncryptedRecordTest, TestDataRemaining) {
 
 TEST_F(EncryptedRecordTest, TestPadding) {
   addToQueue("17030100050123456789");
-  EXPECT_CALL(*readAead_, _decrypt(_, _, 0))
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
       .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
         expectSame(buf, "0123456789");
         return getBuf("1234abcd17000000");
@@ -159,9 +206,39 @@ TEST_F(EncryptedRecordTest, TestPadding) {
   EXPECT_TRUE(queue_.empty());
 }
 
+TEST_F(EncryptedRecordTest, TestLongPadding) {
+  addToQueue("17030100050123456789");
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        expectSame(buf, "0123456789");
+        return getBuf("1234abcd16" + std::string(2 * 45, '0'));
+      }));
+  auto msg = read_.read(queue_);
+  EXPECT_EQ(msg->type, ContentType::handshake);
+  expectSame(msg->fragment, "1234abcd");
+  EXPECT_TRUE(queue_.empty());
+}
+
+TEST_F(EncryptedRecordTest, TestPaddingChained) {
+  addToQueue("17030100050123456789");
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        expectSame(buf, "0123456789");
+        auto decrypted = getBuf("1234");
+        decrypted->prependChain(getBuf("abcd1700"));
+        decrypted->prependChain(getBuf(std::string(2 * 20, '0')));
+        decrypted->prependChain(getBuf("000000"));
+        return decrypted;
+      }));
+  auto msg = read_.read(queue_);
+  EXPECT_EQ(msg->type, ContentType::application_data);
+  expectSame(msg->fragment, "1234abcd");
+  EXPECT_TRUE(queue_.empty());
+}
+
 TEST_F(EncryptedRecordTest, TestAllPaddingAppData) {
   addToQueue("17030100050123456789");
-  EXPECT_CALL(*readAead_, _decrypt(_, _, 0))
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
       .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
         expectSame(buf, "0123456789");
         return getBuf("17000000");
@@ -174,7 +251,7 @@ TEST_F(EncryptedRecordTest, TestAllPaddingAppData) {
 
 TEST_F(EncryptedRecordTest, TestAllPaddingHandshake) {
   addToQueue("17030100050123456789");
-  EXPECT_CALL(*readAead_, _decrypt(_, _, 0))
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
       .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
         expectSame(buf, "0123456789");
         return getBuf("16000000");
@@ -184,7 +261,7 @@ TEST_F(EncryptedRecordTest, TestAllPaddingHandshake) {
 
 TEST_F(EncryptedRecordTest, TestNoContentType) {
   addToQueue("17030100050123456789");
-  EXPECT_CALL(*readAead_, _decrypt(_, _, 0))
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
       .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
         expectSame(buf, "0123456789");
         return getBuf("00000000");
@@ -195,7 +272,7 @@ TEST_F(EncryptedRecordTest, TestNoContentType) {
 TEST_F(EncryptedRecordTest, TestReadSeqNum) {
   for (int i = 0; i < 10; i++) {
     addToQueue("17030100050123456789");
-    EXPECT_CALL(*readAead_, _decrypt(_, _, i))
+    EXPECT_CALL(*readAead_, _tryDecrypt(_, _, i))
         .WillOnce(
             Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
               expectSame(buf, "0123456789");
@@ -237,7 +314,7 @@ TEST_F(EncryptedRecordTest, TestSkipAndRead) {
   EXPECT_EQ(msg->type, ContentType::application_data);
   expectSame(msg->fragment, "1234abcd");
   EXPECT_EQ(queue_.chainLength(), 10);
-  EXPECT_CALL(*readAead_, _decrypt(_, _, 1))
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 1))
       .InSequence(s)
       .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
         expectSame(buf, "01234567aa");
@@ -249,6 +326,65 @@ TEST_F(EncryptedRecordTest, TestSkipAndRead) {
   EXPECT_TRUE(queue_.empty());
 }
 
+TEST_F(EncryptedRecordTest, TestSkipTooMuch) {
+  read_.setSkipFailedDecryption(true);
+  read_.setMaxSkippedBytes(8);
+  EXPECT_CALL(*readAead_, getCipherOverhead()).WillRepeatedly(Return(2));
+  addToQueue("1703010005012345678917030100050123456789");
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
+      .Times(3)
+      .WillRepeatedly(
+          Invoke([](std::unique_ptr<IOBuf>& /*buf*/, const IOBuf*, uint64_t) {
+            return folly::none;
+          }));
+  EXPECT_FALSE(read_.read(queue_).hasValue());
+  addToQueue("17030100050123456789");
+  EXPECT_ANY_THROW(read_.read(queue_));
+}
+
+TEST_F(EncryptedRecordTest, TestFastSkip) {
+  read_.setSkipFailedDecryption(true);
+  read_.setFastSkipLength(3);
+  EXPECT_CALL(*readAead_, getCipherOverhead()).WillRepeatedly(Return(2));
+  addToQueue("170301000601234567890a1703010005012345678917030100050123456789");
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        expectSame(buf, "0123456789");
+        return getBuf("1234abcd17");
+      }));
+  auto msg = read_.read(queue_);
+  EXPECT_EQ(msg->type, ContentType::application_data);
+  expectSame(msg->fragment, "1234abcd");
+  EXPECT_EQ(queue_.chainLength(), 10);
+}
+
+TEST_F(EncryptedRecordTest, TestReadCoalescedRecords) {
+  addToQueue("1703010005012345678917030100050123456789");
+  auto front = queue_.front()->data();
+  Sequence s;
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
+      .InSequence(s)
+      .WillOnce(Invoke([=](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        EXPECT_EQ(buf->data(), front + 5);
+        expectSame(buf, "0123456789");
+        return getBuf("abcdef16");
+      }));
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 1))
+      .InSequence(s)
+      .WillOnce(Invoke([=](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        EXPECT_EQ(buf->data(), front + 15);
+        expectSame(buf, "0123456789");
+        return getBuf("1234abcd17000000");
+      }));
+  auto msg = read_.read(queue_);
+  EXPECT_EQ(msg->type, ContentType::handshake);
+  expectSame(msg->fragment, "abcdef");
+  msg = read_.read(queue_);
+  EXPECT_EQ(msg->type, ContentType::application_data);
+  expectSame(msg->fragment, "1234abcd");
+  EXPECT_TRUE(queue_.empty());
+}
+
 TEST_F(EncryptedRecordTest, TestWriteHandshake) {
   TLSMessage msg{ContentType::handshake, getBuf("1234567890")};
   EXPECT_CALL(*writeAead_, _encrypt(_, _, 0))
@@ -271,6 +407,157 @@ TEST_F(EncryptedRecordTest, TestWriteAppData) {
   expectSame(buf, "1703030006abcd1234abcd");
 }
 
+TEST_F(EncryptedRecordTest, TestKeyUpdateDueRecords) {
+  write_.setKeyUpdateLimits(KeyUpdateLimits{2, 0});
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, _))
+      .Times(2)
+      .WillRepeatedly(
+          Invoke([](std::unique_ptr<IOBuf>&, const IOBuf*, uint64_t) {
+            return getBuf("abcd1234abcd");
+          }));
+  EXPECT_FALSE(write_.keyUpdateDue());
+  write_.write(TLSMessage{ContentType::application_data, getBuf("1234")});
+  EXPECT_FALSE(write_.keyUpdateDue());
+  write_.write(TLSMessage{ContentType::application_data, getBuf("1234")});
+  EXPECT_TRUE(write_.keyUpdateDue());
+}
+
+TEST_F(EncryptedRecordTest, TestKeyUpdateDueBytes) {
+  write_.setKeyUpdateLimits(KeyUpdateLimits{0, 8});
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, _))
+      .Times(2)
+      .WillRepeatedly(
+          Invoke([](std::unique_ptr<IOBuf>&, const IOBuf*, uint64_t) {
+            return getBuf("abcd1234abcd");
+          }));
+  write_.write(TLSMessage{ContentType::application_data, getBuf("12345678")});
+  EXPECT_EQ(write_.getBytesWritten(), 4);
+  EXPECT_FALSE(write_.keyUpdateDue());
+  write_.write(TLSMessage{ContentType::application_data, getBuf("12345678")});
+  EXPECT_EQ(write_.getBytesWritten(), 8);
+  EXPECT_TRUE(write_.keyUpdateDue());
+}
+
+TEST_F(EncryptedRecordTest, TestWriteAppDataUntilKeyUpdate) {
+  write_.setMaxRecord(2);
+  write_.setKeyUpdateLimits(KeyUpdateLimits{2, 0});
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, _))
+      .Times(2)
+      .WillRepeatedly(
+          Invoke([](std::unique_ptr<IOBuf>&, const IOBuf*, uint64_t) {
+            return getBuf("abcd1234abcd");
+          }));
+  IOBufQueue queue;
+  queue.append(getBuf("123456789abc"));
+  auto buf = write_.writeAppDataUntilKeyUpdate(queue);
+  expectSame(buf, "1703030006abcd1234abcd1703030006abcd1234abcd");
+  EXPECT_TRUE(write_.keyUpdateDue());
+  expectSame(queue.move(), "9abc");
+}
+
+TEST_F(EncryptedRecordTest, TestKeyUpdateNoLimits) {
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, _))
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>&, const IOBuf*, uint64_t) {
+        return getBuf("abcd1234abcd");
+      }));
+  write_.write(TLSMessage{ContentType::application_data, getBuf("1234")});
+  EXPECT_FALSE(write_.keyUpdateDue());
+}
+
+TEST_F(EncryptedRecordTest, TestReadIntoProvidedBuffer) {
+  MockPlaintextBufferProvider provider;
+  read_.setPlaintextBufferProvider(&provider);
+  std::array<uint8_t, 8> provided;
+  addToQueue("17030100050123456789");
+  EXPECT_CALL(*readAead_, supportsDecryptIovecs()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*readAead_, getCipherOverhead()).WillRepeatedly(Return(1));
+  EXPECT_CALL(provider, getPlaintextBuffer(4))
+      .WillOnce(Return(folly::range(provided)));
+  EXPECT_CALL(*readAead_, tryDecryptIovecs(_, _, 0, _, 1))
+      .WillOnce(Invoke([&](const IOBuf& buf,
+                           const IOBuf*,
+                           uint64_t,
+                           const struct iovec* iov,
+                           size_t) {
+        EXPECT_TRUE(eq_(buf, *getBuf("0123456789")));
+        EXPECT_EQ(iov->iov_base, provided.data());
+        EXPECT_EQ(iov->iov_len, 4);
+        memcpy(iov->iov_base, unhexlify("123417").data(), 3);
+        return folly::Optional<size_t>(3);
+      }));
+  auto msg = read_.read(queue_);
+  EXPECT_EQ(msg->type, ContentType::application_data);
+  EXPECT_EQ(msg->fragment->data(), provided.data());
+  expectSame(msg->fragment, "1234");
+  EXPECT_TRUE(queue_.empty());
+}
+
+TEST_F(EncryptedRecordTest, TestReadHandshakeFromProvidedBuffer) {
+  MockPlaintextBufferProvider provider;
+  read_.setPlaintextBufferProvider(&provider);
+  std::array<uint8_t, 8> provided;
+  addToQueue("17030100050123456789");
+  EXPECT_CALL(*readAead_, supportsDecryptIovecs()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*readAead_, getCipherOverhead()).WillRepeatedly(Return(1));
+  EXPECT_CALL(provider, getPlaintextBuffer(4))
+      .WillOnce(Return(folly::range(provided)));
+  EXPECT_CALL(*readAead_, tryDecryptIovecs(_, _, 0, _, 1))
+      .WillOnce(Invoke([](const IOBuf&,
+                          const IOBuf*,
+                          uint64_t,
+                          const struct iovec* iov,
+                          size_t) {
+        memcpy(iov->iov_base, unhexlify("abcd16").data(), 3);
+        return folly::Optional<size_t>(3);
+      }));
+  auto msg = read_.read(queue_);
+  EXPECT_EQ(msg->type, ContentType::handshake);
+  // handshake data is copied out of the provided memory
+  EXPECT_NE(msg->fragment->data(), provided.data());
+  expectSame(msg->fragment, "abcd");
+}
+
+TEST_F(EncryptedRecordTest, TestReadProvidedBufferTooSmall) {
+  MockPlaintextBufferProvider provider;
+  read_.setPlaintextBufferProvider(&provider);
+  std::array<uint8_t, 2> provided;
+  addToQueue("17030100050123456789");
+  EXPECT_CALL(*readAead_, supportsDecryptIovecs()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*readAead_, getCipherOverhead()).WillRepeatedly(Return(1));
+  EXPECT_CALL(provider, getPlaintextBuffer(4))
+      .WillOnce(Return(folly::range(provided)));
+  EXPECT_CALL(*readAead_, tryDecryptIovecs(_, _, _, _, _)).Times(0);
+  EXPECT_CALL(*readAead_, _tryDecrypt(_, _, 0))
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        expectSame(buf, "0123456789");
+        return getBuf("1234abcd17");
+      }));
+  auto msg = read_.read(queue_);
+  EXPECT_EQ(msg->type, ContentType::application_data);
+  expectSame(msg->fragment, "1234abcd");
+}
+
+TEST_F(EncryptedRecordTest, TestReadProvidedBufferDecryptFailure) {
+  MockPlaintextBufferProvider provider;
+  read_.setPlaintextBufferProvider(&provider);
+  std::array<uint8_t, 8> provided;
+  addToQueue("17030100050123456789");
+  EXPECT_CALL(*readAead_, supportsDecryptIovecs()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*readAead_, getCipherOverhead()).WillRepeatedly(Return(1));
+  EXPECT_CALL(provider, getPlaintextBuffer(4))
+      .WillOnce(Return(folly::range(provided)));
+  EXPECT_CALL(*readAead_, tryDecryptIovecs(_, _, 0, _, 1))
+      .WillOnce(Return(folly::none));
+  EXPECT_THROW(read_.read(queue_), std::runtime_error);
+}
+
+TEST_F(EncryptedRecordTest, TestReleaseIdleResources) {
+  EXPECT_CALL(*readAead_, releaseIdleResources());
+  read_.releaseIdleResources();
+  EXPECT_CALL(*writeAead_, releaseIdleResources());
+  write_.releaseIdleResources();
+}
+
 TEST_F(EncryptedRecordTest, TestWriteAppDataInPlace) {
   TLSMessage msg{ContentType::application_data, getBuf("1234567890", 5, 17)};
   EXPECT_CALL(*writeAead_, _encrypt(_, _, 0))
@@ -286,6 +573,280 @@ TEST_F(EncryptedRecordTest, TestWriteAppDataInPlace) {
   expectSame(buf, "1703030006abcd1234abcd");
 }
 
+TEST_F(EncryptedRecordTest, TestWriteIovecs) {
+  write_.setMaxRecord(4);
+  TLSMessage msg{ContentType::application_data, getBuf("1234567890")};
+  Sequence s;
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, 0))
+      .InSequence(s)
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        expectSame(buf, "1234567817");
+        return getBuf("abcd1234abcd");
+      }));
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, 1))
+      .InSequence(s)
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        expectSame(buf, "9017");
+        auto out = getBuf("ef");
+        out->prependChain(getBuf("01"));
+        return out;
+      }));
+  RecordIovecs iov;
+  EXPECT_EQ(write_.writeIovecs(std::move(msg), iov), 5);
+  std::string written;
+  for (const auto& vec : iov.iovecs) {
+    written.append(static_cast<const char*>(vec.iov_base), vec.iov_len);
+  }
+  EXPECT_EQ(hexlify(written), "1703030005abcd1234abcd1703030003ef01");
+}
+
+TEST_F(EncryptedRecordTest, TestWriteAppDataIovecsUntilKeyUpdate) {
+  write_.setMaxRecord(4);
+  write_.setKeyUpdateLimits(KeyUpdateLimits{1, 0});
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, 0))
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        expectSame(buf, "1234567817");
+        return getBuf("abcd1234abcd");
+      }));
+  IOBufQueue queue;
+  queue.append(getBuf("1234567890"));
+  RecordIovecs iov;
+  iov.append(getBuf("aa"));
+  write_.writeAppDataIovecsUntilKeyUpdate(queue, iov);
+  EXPECT_TRUE(write_.keyUpdateDue());
+  expectSame(queue.move(), "90");
+  std::string written;
+  for (const auto& vec : iov.iovecs) {
+    written.append(static_cast<const char*>(vec.iov_base), vec.iov_len);
+  }
+  // Records are appended to what was already there.
+  EXPECT_EQ(hexlify(written), "aa1703030005abcd1234abcd");
+}
+
+TEST_F(EncryptedRecordTest, TestWriteSharedAppData) {
+  auto data = getBuf("1234567890");
+  TLSMessage msg{ContentType::application_data, data->clone()};
+  EXPECT_CALL(*writeAead_, supportsEncryptIovecs())
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*writeAead_, getCipherOverhead()).WillRepeatedly(Return(1));
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, _)).Times(0);
+  EXPECT_CALL(*writeAead_, encryptIovecs(_, _, _, 1, _, 0))
+      .WillOnce(Invoke([](const struct iovec* plaintext,
+                          size_t plaintextCount,
+                          const struct iovec* ciphertext,
+                          size_t,
+                          const IOBuf* aad,
+                          uint64_t) {
+        // The shared data is passed as is, followed by the content type.
+        EXPECT_EQ(plaintextCount, 2);
+        std::string in;
+        for (size_t i = 0; i < plaintextCount; ++i) {
+          in.append(
+              static_cast<const char*>(plaintext[i].iov_base),
+              plaintext[i].iov_len);
+        }
+        EXPECT_EQ(hexlify(in), "123456789017");
+        expectSame(aad->clone(), "1703030007");
+        EXPECT_EQ(ciphertext->iov_len, 7);
+        memcpy(ciphertext->iov_base, unhexlify("abcd1234abcdef").data(), 7);
+        return 7;
+      }));
+  auto buf = write_.write(std::move(msg));
+  EXPECT_FALSE(buf->isChained());
+  expectSame(buf, "1703030007abcd1234abcdef");
+  expectSame(data, "1234567890");
+}
+
+TEST_F(EncryptedRecordTest, TestWriteSharedAppDataOrdering) {
+  write_.setMaxRecord(4);
+  auto data = getBuf("1234567890");
+  TLSMessage msg{ContentType::application_data, data->clone()};
+  EXPECT_CALL(*writeAead_, supportsEncryptIovecs())
+      .WillRepeatedly(Return(true));
+  // Every record split off the shared buffer goes through encryptIovecs with
+  // consecutive sequence numbers.
+  Sequence s;
+  for (uint64_t i = 0; i < 3; ++i) {
+    EXPECT_CALL(*writeAead_, encryptIovecs(_, _, _, 1, _, i))
+        .InSequence(s)
+        .WillOnce(Invoke([](const struct iovec*,
+                            size_t,
+                            const struct iovec* ciphertext,
+                            size_t,
+                            const IOBuf*,
+                            uint64_t) {
+          memset(ciphertext->iov_base, 0xaa, ciphertext->iov_len);
+          return ciphertext->iov_len;
+        }));
+  }
+  auto buf = write_.write(std::move(msg));
+  expectSame(buf, "1703030005aaaaaaaaaa1703030005aaaaaaaaaa1703030003aaaaaa");
+}
+
+static std::unique_ptr<Aead> makeRealAead() {
+  auto aead = std::make_unique<OpenSSLEVPCipher<AESGCM128>>();
+  TrafficKey key;
+  key.key = IOBuf::copyBuffer(unhexlify("000102030405060708090a0b0c0d0e0f"));
+  key.iv = IOBuf::copyBuffer(unhexlify("000102030405060708090a0b"));
+  aead->setKey(std::move(key));
+  return std::move(aead);
+}
+
+TEST_F(EncryptedRecordTest, TestWriteParallel) {
+  EncryptedWriteRecordLayer serial;
+  serial.setAead(makeRealAead());
+  serial.setMaxRecord(16);
+  EncryptedWriteRecordLayer parallel;
+  parallel.setAead(makeRealAead());
+  parallel.setMaxRecord(16);
+  ParallelEncryptionOptions options;
+  options.executor = std::make_shared<CPUThreadPoolExecutor>(2);
+  options.minBytes = 100;
+  options.parallelism = 3;
+  parallel.setParallelEncryption(std::move(options));
+
+  auto data = IOBuf::create(1000);
+  data->append(1000);
+  for (size_t i = 0; i < data->length(); ++i) {
+    data->writableData()[i] = i;
+  }
+
+  // One write large enough to be encrypted in parallel, followed by one that
+  // is encrypted inline, must match a purely serial encryption.
+  for (size_t length : {1000, 20}) {
+    auto expected = serial.write(
+        TLSMessage{ContentType::application_data,
+                   IOBuf::copyBuffer(data->data(), length)});
+    auto actual = parallel.write(
+        TLSMessage{ContentType::application_data,
+                   IOBuf::copyBuffer(data->data(), length)});
+    EXPECT_TRUE(eq_(expected, actual));
+    EXPECT_EQ(serial.getSequenceNumber(), parallel.getSequenceNumber());
+  }
+  EXPECT_EQ(parallel.getSequenceNumber(), 65);
+}
+
+TEST_F(EncryptedRecordTest, TestWriteParallelIdleExecutor) {
+  // The EventBase never loops, like when it is the writing thread's own, so
+  // the writing thread has to encrypt every run itself.
+  EncryptedWriteRecordLayer serial;
+  serial.setAead(makeRealAead());
+  serial.setMaxRecord(16);
+  EncryptedWriteRecordLayer parallel;
+  parallel.setAead(makeRealAead());
+  parallel.setMaxRecord(16);
+  ParallelEncryptionOptions options;
+  options.executor = std::make_shared<EventBase>();
+  options.minBytes = 100;
+  parallel.setParallelEncryption(std::move(options));
+
+  auto data = IOBuf::copyBuffer(std::string(1000, 'a'));
+  auto expected =
+      serial.write(TLSMessage{ContentType::application_data, data->clone()});
+  auto actual =
+      parallel.write(TLSMessage{ContentType::application_data, data->clone()});
+  EXPECT_TRUE(eq_(expected, actual));
+  EXPECT_EQ(parallel.getSequenceNumber(), 63);
+}
+
+TEST_F(EncryptedRecordTest, TestWriteParallelNoClone) {
+  // MockAead does not support clone(), so the write is encrypted inline.
+  ParallelEncryptionOptions options;
+  options.executor = std::make_shared<CPUThreadPoolExecutor>(1);
+  options.minBytes = 1;
+  write_.setParallelEncryption(std::move(options));
+  TLSMessage msg{ContentType::application_data, getBuf("1234567890")};
+  EXPECT_CALL(*writeAead_, _encrypt(_, _, 0))
+      .WillOnce(Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+        expectSame(buf, "123456789017");
+        return getBuf("abcd1234abcd");
+      }));
+  auto buf = write_.write(std::move(msg));
+  expectSame(buf, "1703030006abcd1234abcd");
+}
+
+TEST_F(EncryptedRecordTest, TestReadParallel) {
+  EncryptedWriteRecordLayer write;
+  write.setAead(makeRealAead());
+  write.setMaxRecord(16);
+  EncryptedReadRecordLayer read;
+  read.setAead(makeRealAead());
+  ParallelDecryptionOptions options;
+  options.executor = std::make_shared<CPUThreadPoolExecutor>(2);
+  options.minBytes = 100;
+  options.parallelism = 3;
+  read.setParallelDecryption(std::move(options));
+
+  auto data = IOBuf::copyBuffer(std::string(1000, 'a'));
+  queue_.append(
+      write.write(TLSMessage{ContentType::application_data, data->clone()}));
+  // A partial record at the end is left in the queue.
+  auto partial =
+      write.write(TLSMessage{ContentType::application_data, data->clone()});
+  partial->coalesce();
+  partial->trimEnd(partial->length() - 10);
+  queue_.append(std::move(partial));
+
+  IOBufQueue received;
+  while (auto msg = read.read(queue_)) {
+    EXPECT_EQ(msg->type, ContentType::application_data);
+    received.append(std::move(msg->fragment));
+  }
+  EXPECT_TRUE(eq_(received.move(), data));
+  EXPECT_EQ(read.getSequenceNumber(), 63);
+  EXPECT_EQ(queue_.chainLength(), 10);
+}
+
+TEST_F(EncryptedRecordTest, TestReadParallelIdleExecutor) {
+  EncryptedWriteRecordLayer write;
+  write.setAead(makeRealAead());
+  write.setMaxRecord(16);
+  EncryptedReadRecordLayer read;
+  read.setAead(makeRealAead());
+  ParallelDecryptionOptions options;
+  options.executor = std::make_shared<EventBase>();
+  options.minBytes = 100;
+  read.setParallelDecryption(std::move(options));
+
+  auto data = IOBuf::copyBuffer(std::string(1000, 'a'));
+  queue_.append(
+      write.write(TLSMessage{ContentType::application_data, data->clone()}));
+
+  IOBufQueue received;
+  while (auto msg = read.read(queue_)) {
+    received.append(std::move(msg->fragment));
+  }
+  EXPECT_TRUE(eq_(received.move(), data));
+  EXPECT_EQ(read.getSequenceNumber(), 63);
+}
+
+TEST_F(EncryptedRecordTest, TestReadParallelDecryptFailure) {
+  EncryptedWriteRecordLayer write;
+  write.setAead(makeRealAead());
+  write.setMaxRecord(16);
+  EncryptedReadRecordLayer read;
+  read.setAead(makeRealAead());
+  ParallelDecryptionOptions options;
+  options.executor = std::make_shared<CPUThreadPoolExecutor>(2);
+  options.minBytes = 100;
+  read.setParallelDecryption(std::move(options));
+
+  auto records = write.write(TLSMessage{
+      ContentType::application_data, IOBuf::copyBuffer(std::string(160, 'a'))});
+  records->coalesce();
+  // Corrupt the tag of the third record.
+  size_t recordLength = kEncryptedHeaderSize + 16 + 1 + 16;
+  records->writableData()[3 * recordLength - 1] ^= 0x01;
+  queue_.append(std::move(records));
+
+  EXPECT_TRUE(read.tryRead(queue_).value().hasValue());
+  EXPECT_TRUE(read.tryRead(queue_).value().hasValue());
+  auto result = read.tryRead(queue_);
+  ASSERT_TRUE(result.hasError());
+  EXPECT_EQ(result.error().message, "decryption failed");
+  EXPECT_EQ(read.getSequenceNumber(), 2);
+}
+
 TEST_F(EncryptedRecordTest, TestFragmentedWrite) {
   TLSMessage msg{ContentType::application_data, IOBuf::create(0x4a00)};
   msg.fragment->append(0x4a00);
@@ -375,5 +936,71 @@ TEST_F(EncryptedRecordTest, TestWriteMaxSize) {
           }));
   write_.write(std::move(msg));
 }
+
+TEST_F(EncryptedRecordTest, TestWriteMultipleBatches) {
+  write_.setMaxRecord(1);
+  auto numRecords = EncryptedWriteRecordLayer::kMaxRecordsPerBatch + 4;
+
+  TLSMessage msg{ContentType::application_data, IOBuf::create(numRecords)};
+  msg.fragment->append(numRecords);
+  memset(msg.fragment->writableData(), 0x1, msg.fragment->length());
+
+  Sequence s;
+  for (size_t i = 0; i < numRecords; i++) {
+    EXPECT_CALL(*writeAead_, _encrypt(_, _, i))
+        .InSequence(s)
+        .WillOnce(
+            Invoke([](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+              expectSame(buf, "0117");
+              return getBuf("aaaa");
+            }));
+  }
+  auto outBuf = write_.write(std::move(msg));
+  EXPECT_EQ(outBuf->computeChainDataLength(), numRecords * 9);
+}
+
+class TestDynamicRecordSizePolicy : public DynamicRecordSizePolicy {
+ public:
+  using DynamicRecordSizePolicy::DynamicRecordSizePolicy;
+
+  std::chrono::steady_clock::time_point now() const override {
+    return now_;
+  }
+
+  std::chrono::steady_clock::time_point now_;
+};
+
+TEST_F(EncryptedRecordTest, TestWriteDynamicRecordSize) {
+  DynamicRecordSizePolicy::Options options;
+  options.smallRecordSize = 1000;
+  options.rampThreshold = 2000;
+  options.idleTimeout = std::chrono::milliseconds(100);
+  auto policy = std::make_unique<TestDynamicRecordSizePolicy>(options);
+  auto policyPtr = policy.get();
+  write_.setRecordSizePolicy(std::move(policy));
+
+  auto expectRecords = [this](std::vector<size_t> sizes, size_t total) {
+    TLSMessage msg{ContentType::application_data, IOBuf::create(total)};
+    msg.fragment->append(total);
+    memset(msg.fragment->writableData(), 0x1, msg.fragment->length());
+    Sequence s;
+    for (auto size : sizes) {
+      EXPECT_CALL(*writeAead_, _encrypt(_, _, _))
+          .InSequence(s)
+          .WillOnce(Invoke(
+              [size](std::unique_ptr<IOBuf>& buf, const IOBuf*, uint64_t) {
+                EXPECT_EQ(buf->computeChainDataLength(), size + 1);
+                return getBuf("aaaa");
+              }));
+    }
+    write_.write(std::move(msg));
+  };
+
+  expectRecords({1000, 1000, 0x4000, 1000}, 0x4000 + 3000);
+
+  // Idle connections restart with small records.
+  policyPtr->now_ += std::chrono::milliseconds(200);
+  expectRecords({1000, 1000}, 2000);
+}
 } // namespace test
 } // namespace fizz
@@ -26,6 +26,16 @@ StringPiece clientEarlyData{"002a0000"};
 StringPiece serverEarlyData{"002a0000"};
 StringPiece ticketEarlyData{"002a000400000005"};
 StringPiece cookie{"002c00080006636f6f6b6965"};
+StringPiece certCompression{"001b00050400030001"};
+StringPiece statusRequest{"000500050100000000"};
+StringPiece certificateStatus{"00050008010000046f637370"};
+StringPiece sctRequest{"00120000"};
+StringPiece scts{"001200050003736374"};
+StringPiece serverCertTypeList{"00140003020200"};
+StringPiece serverCertType{"0014000102"};
+StringPiece delegatedCredentialSupport{"0022000400020403"};
+StringPiece delegatedCredential{
+    "0022001300000e1004030000036b657908040003736967"};
 StringPiece authorities{
     "002f005400520028434e3d4c696d696e616c6974792c204f553d46697a7a2c204f3d46616365626f6f6b2c20433d55530026434e3d457465726e6974792c204f553d46697a7a2c204f3d46616365626f6f6b2c20433d5553"};
 
@@ -115,6 +125,102 @@ TEST_F(ExtensionsTest, TestCertificateAuthorities) {
   checkEncode(std::move(*ext), authorities);
 }
 
+TEST_F(ExtensionsTest, TestCertificateCompressionAlgorithms) {
+  auto exts = getExtensions(certCompression);
+  auto ext = getExtension<CertificateCompressionAlgorithms>(exts);
+
+  EXPECT_EQ(ext->algorithms.size(), 2);
+  EXPECT_EQ(ext->algorithms[0], CertificateCompressionAlgorithm::zstd);
+  EXPECT_EQ(ext->algorithms[1], CertificateCompressionAlgorithm::zlib);
+
+  checkEncode(std::move(*ext), certCompression);
+}
+
+TEST_F(ExtensionsTest, TestCertificateStatusRequest) {
+  auto exts = getExtensions(statusRequest);
+  auto ext = getExtension<CertificateStatusRequest>(exts);
+
+  EXPECT_EQ(ext->status_type, CertificateStatusType::ocsp);
+  EXPECT_TRUE(ext->responder_id_list->empty());
+  EXPECT_TRUE(ext->request_extensions->empty());
+
+  checkEncode(std::move(*ext), statusRequest);
+}
+
+TEST_F(ExtensionsTest, TestCertificateStatus) {
+  auto exts = getExtensions(certificateStatus);
+  auto ext = getExtension<CertificateStatus>(exts);
+
+  EXPECT_EQ(ext->status_type, CertificateStatusType::ocsp);
+  EXPECT_EQ(StringPiece(ext->ocsp_response->coalesce()), "ocsp");
+
+  checkEncode(std::move(*ext), certificateStatus);
+}
+
+TEST_F(ExtensionsTest, TestSignedCertificateTimestampsRequest) {
+  auto exts = getExtensions(sctRequest);
+  auto ext = getExtension<SignedCertificateTimestamps>(exts);
+
+  EXPECT_TRUE(ext->sct_list->empty());
+
+  checkEncode(std::move(*ext), sctRequest);
+}
+
+TEST_F(ExtensionsTest, TestSignedCertificateTimestamps) {
+  auto exts = getExtensions(scts);
+  auto ext = getExtension<SignedCertificateTimestamps>(exts);
+
+  EXPECT_EQ(StringPiece(ext->sct_list->coalesce()), "sct");
+
+  checkEncode(std::move(*ext), scts);
+}
+
+TEST_F(ExtensionsTest, TestDelegatedCredentialSupport) {
+  auto exts = getExtensions(delegatedCredentialSupport);
+  auto ext = getExtension<DelegatedCredentialSupport>(exts);
+
+  EXPECT_EQ(ext->supported_signature_algorithms.size(), 1);
+  EXPECT_EQ(
+      ext->supported_signature_algorithms[0],
+      SignatureScheme::ecdsa_secp256r1_sha256);
+
+  checkEncode(std::move(*ext), delegatedCredentialSupport);
+}
+
+TEST_F(ExtensionsTest, TestDelegatedCredential) {
+  auto exts = getExtensions(delegatedCredential);
+  auto ext = getExtension<DelegatedCredential>(exts);
+
+  EXPECT_EQ(ext->valid_time, 3600);
+  EXPECT_EQ(
+      ext->expected_verify_scheme, SignatureScheme::ecdsa_secp256r1_sha256);
+  EXPECT_EQ(StringPiece(ext->public_key->coalesce()), "key");
+  EXPECT_EQ(ext->credential_scheme, SignatureScheme::rsa_pss_sha256);
+  EXPECT_EQ(StringPiece(ext->signature->coalesce()), "sig");
+
+  checkEncode(std::move(*ext), delegatedCredential);
+}
+
+TEST_F(ExtensionsTest, TestServerCertTypeList) {
+  auto exts = getExtensions(serverCertTypeList);
+  auto ext = getExtension<ServerCertTypeList>(exts);
+
+  EXPECT_EQ(ext->certificate_types.size(), 2);
+  EXPECT_EQ(ext->certificate_types[0], CertificateType::RawPublicKey);
+  EXPECT_EQ(ext->certificate_types[1], CertificateType::X509);
+
+  checkEncode(std::move(*ext), serverCertTypeList);
+}
+
+TEST_F(ExtensionsTest, TestServerCertType) {
+  auto exts = getExtensions(serverCertType);
+  auto ext = getExtension<ServerCertType>(exts);
+
+  EXPECT_EQ(ext->certificate_type, CertificateType::RawPublicKey);
+
+  checkEncode(std::move(*ext), serverCertType);
+}
+
 TEST_F(ExtensionsTest, TestBadlyFormedExtension) {
   auto buf = getBuf(sni);
   buf->reserve(0, 1);
@@ -125,6 +231,44 @@ TEST_F(ExtensionsTest, TestBadlyFormedExtension) {
   ext.extension_data = std::move(buf);
   exts.push_back(std::move(ext));
   EXPECT_THROW(getExtension<ServerNameList>(exts), std::runtime_error);
+  ExtensionIndex index(exts);
+  EXPECT_THROW(index.get<ServerNameList>(), std::runtime_error);
+  EXPECT_THROW(index.get<ServerNameList>(), std::runtime_error);
+}
+
+TEST_F(ExtensionsTest, TestExtensionIndex) {
+  auto exts = getExtensions(sni);
+  auto more = getExtensions(cookie);
+  exts.push_back(std::move(more.front()));
+  Extension renegotiation;
+  renegotiation.extension_type = static_cast<ExtensionType>(0xff01);
+  renegotiation.extension_data = getBuf("00");
+  exts.push_back(std::move(renegotiation));
+  auto duplicate = getExtensions(cookie);
+  exts.push_back(std::move(duplicate.front()));
+
+  ExtensionIndex index(exts);
+  EXPECT_EQ(index.find(ExtensionType::server_name), &exts[0]);
+  EXPECT_EQ(index.find(ExtensionType::cookie), &exts[1]);
+  EXPECT_EQ(index.find(static_cast<ExtensionType>(0xff01)), &exts[2]);
+  EXPECT_EQ(
+      index.find(ExtensionType::application_layer_protocol_negotiation),
+      nullptr);
+  EXPECT_EQ(index.find(static_cast<ExtensionType>(0xff02)), nullptr);
+
+  const auto& serverNames = index.get<ServerNameList>();
+  ASSERT_TRUE(serverNames.hasValue());
+  EXPECT_EQ(
+      StringPiece(serverNames->server_name_list[0].hostname->coalesce()),
+      StringPiece("www.facebook.com"));
+  // Decoded once.
+  EXPECT_EQ(&index.get<ServerNameList>(), &serverNames);
+  EXPECT_FALSE(index.get<ProtocolNameList>().hasValue());
+  EXPECT_FALSE(index.get<ClientKeyShare>().hasValue());
+
+  // Still valid after the extensions are moved.
+  auto moved = std::move(exts);
+  EXPECT_EQ(StringPiece(index.get<Cookie>()->cookie->coalesce()), "cookie");
 }
 } // namespace test
 } // namespace fizz
@@ -80,6 +80,8 @@ static const std::string nst =
 static const std::string encodedKeyUpdate = "00";
 
 static const std::string encodedCertRequest = "00000a000d0006000406030807";
+static const std::string encodedCompressedCertificate =
+    "0003000100000004deadbeef";
 
 namespace fizz {
 namespace test {
@@ -151,6 +153,29 @@ TEST_F(HandshakeTypesTest, ChloEncodeCopy) {
   EXPECT_EQ(encodeHex(clientHello), chlo);
 }
 
+TEST_F(HandshakeTypesTest, EncodeSingleBuffer) {
+  auto clientHello = decodeHex<ClientHello>(chlo);
+  auto bodyLength = detail::getSize(clientHello);
+  auto encoded = encode(clientHello);
+  EXPECT_FALSE(encoded->isChained());
+  EXPECT_EQ(encoded->length(), bodyLength);
+
+  auto handshake = encodeHandshake(std::move(clientHello));
+  EXPECT_FALSE(handshake->isChained());
+  EXPECT_EQ(handshake->length(), 4 + bodyLength);
+  EXPECT_EQ(hexlify(handshake->coalesce()), "01000213" + chlo);
+}
+
+TEST_F(HandshakeTypesTest, DecodeZeroCopy) {
+  auto data = unhexlify(nst);
+  auto buf = IOBuf::copyBuffer(data.data(), data.size());
+  auto start = buf->data();
+  auto end = buf->tail();
+  auto ticket = decode<NewSessionTicket>(std::move(buf));
+  EXPECT_GE(ticket.ticket->data(), start);
+  EXPECT_LE(ticket.ticket->tail(), end);
+}
+
 TEST_F(HandshakeTypesTest, NstEncodeDecode) {
   auto ticket = decodeHex<NewSessionTicket>(nst);
 
@@ -252,5 +277,15 @@ TEST_F(HandshakeTypesTest, EncodedAndDecodeCertificateRequest) {
   auto reencoded = encodeHex(std::move(cr));
   EXPECT_EQ(reencoded, encodedCertRequest);
 }
+
+TEST_F(HandshakeTypesTest, EncodeAndDecodeCompressedCertificate) {
+  auto cc = decodeHex<CompressedCertificate>(encodedCompressedCertificate);
+  EXPECT_EQ(cc.algorithm, CertificateCompressionAlgorithm::zstd);
+  EXPECT_EQ(cc.uncompressed_length, 256);
+  EXPECT_EQ(
+      hexlify(cc.compressed_certificate_message->coalesce()), "deadbeef");
+  auto reencoded = encodeHex(std::move(cc));
+  EXPECT_EQ(reencoded, encodedCompressedCertificate);
+}
 } // namespace test
 } // namespace fizz
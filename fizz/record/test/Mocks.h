@@ -39,13 +39,27 @@ class MockPlaintextReadRecordLayer : public PlaintextReadRecordLayer {
   MOCK_METHOD1(read, folly::Optional<TLSMessage>(folly::IOBufQueue& buf));
   MOCK_CONST_METHOD0(hasUnparsedHandshakeData, bool());
   MOCK_METHOD1(setSkipEncryptedRecords, void(bool));
+
+  // Go through the mocked read().
+  RecordLayerResult<folly::Optional<TLSMessage>> tryRead(
+      folly::IOBufQueue& buf) override {
+    return ReadRecordLayer::tryRead(buf);
+  }
 };
 
 class MockEncryptedReadRecordLayer : public EncryptedReadRecordLayer {
  public:
+  using EncryptedReadRecordLayer::EncryptedReadRecordLayer;
+
   MOCK_METHOD1(read, folly::Optional<TLSMessage>(folly::IOBufQueue& buf));
   MOCK_CONST_METHOD0(hasUnparsedHandshakeData, bool());
 
+  // Go through the mocked read().
+  RecordLayerResult<folly::Optional<TLSMessage>> tryRead(
+      folly::IOBufQueue& buf) override {
+    return ReadRecordLayer::tryRead(buf);
+  }
+
   MOCK_METHOD1(_setAead, void(Aead*));
   void setAead(std::unique_ptr<Aead> aead) override {
     _setAead(aead.get());
@@ -61,6 +75,8 @@ class MockPlaintextWriteRecordLayer : public PlaintextWriteRecordLayer {
     return _write(msg);
   }
 
+  MOCK_CONST_METHOD0(keyUpdateDue, bool());
+
   MOCK_CONST_METHOD1(_writeInitialClientHello, Buf(Buf&));
   Buf writeInitialClientHello(Buf encoded) const override {
     return _writeInitialClientHello(encoded);
@@ -76,11 +92,27 @@ class MockPlaintextWriteRecordLayer : public PlaintextWriteRecordLayer {
 
 class MockEncryptedWriteRecordLayer : public EncryptedWriteRecordLayer {
  public:
+  using EncryptedWriteRecordLayer::EncryptedWriteRecordLayer;
+
   MOCK_CONST_METHOD1(_write, Buf(TLSMessage& msg));
   Buf write(TLSMessage&& msg) const override {
     return _write(msg);
   }
 
+  Buf writeAppDataUntilKeyUpdate(folly::IOBufQueue& queue) const override {
+    return WriteRecordLayer::writeAppDataUntilKeyUpdate(queue);
+  }
+
+  size_t writeIovecs(TLSMessage&& msg, RecordIovecs& out) const override {
+    return WriteRecordLayer::writeIovecs(std::move(msg), out);
+  }
+
+  void writeAppDataIovecsUntilKeyUpdate(
+      folly::IOBufQueue& queue,
+      RecordIovecs& out) const override {
+    WriteRecordLayer::writeAppDataIovecsUntilKeyUpdate(queue, out);
+  }
+
   MOCK_METHOD1(_setAead, void(Aead*));
   void setAead(std::unique_ptr<Aead> aead) override {
     _setAead(aead.get());
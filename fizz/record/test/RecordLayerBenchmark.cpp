@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include <folly/ssl/Init.h>
+
+#include <fizz/record/test/RecordLayerHarness.h>
+
+using namespace fizz;
+using namespace fizz::test;
+
+// Each iteration moves this much plaintext through the record layer, so that
+// results for different chunk and record sizes are comparable.
+static constexpr size_t kBytesPerIteration = 256 * 1024;
+
+static void
+encryptedRead(uint32_t n, size_t chunkSize, size_t recordSize, size_t padding) {
+  Buf records;
+  BENCHMARK_SUSPEND {
+    records = RecordLayerHarness::makeEncryptedRecords(
+        recordSize, padding, kBytesPerIteration / recordSize);
+  }
+  size_t total = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    std::vector<Buf> input;
+    EncryptedReadRecordLayer read;
+    BENCHMARK_SUSPEND {
+      input = RecordLayerHarness::fragment(*records, chunkSize);
+      read.setAead(RecordLayerHarness::makeAead());
+    }
+    total += RecordLayerHarness::readAll(read, std::move(input));
+  }
+  folly::doNotOptimizeAway(total);
+}
+
+static void encryptedWrite(uint32_t n, size_t chunkSize, size_t recordSize) {
+  EncryptedWriteRecordLayer write;
+  Buf data;
+  BENCHMARK_SUSPEND {
+    write.setAead(RecordLayerHarness::makeAead());
+    write.setMaxRecord(recordSize);
+    data = RecordLayerHarness::makeData(kBytesPerIteration);
+  }
+  Buf out;
+  for (uint32_t i = 0; i < n; ++i) {
+    // App data handed over as a chain of chunkSize buffers.
+    Buf chain;
+    BENCHMARK_SUSPEND {
+      for (auto& chunk : RecordLayerHarness::fragment(*data, chunkSize)) {
+        if (chain) {
+          chain->prependChain(std::move(chunk));
+        } else {
+          chain = std::move(chunk);
+        }
+      }
+    }
+    out = write.write(
+        TLSMessage{ContentType::application_data, std::move(chain)});
+  }
+  folly::doNotOptimizeAway(out);
+}
+
+static void plaintextRead(uint32_t n, size_t chunkSize, size_t recordSize) {
+  Buf records;
+  BENCHMARK_SUSPEND {
+    records = RecordLayerHarness::makePlaintextRecords(
+        recordSize, kBytesPerIteration / recordSize);
+  }
+  size_t total = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    std::vector<Buf> input;
+    BENCHMARK_SUSPEND {
+      input = RecordLayerHarness::fragment(*records, chunkSize);
+    }
+    PlaintextReadRecordLayer read;
+    total += RecordLayerHarness::readAll(read, std::move(input));
+  }
+  folly::doNotOptimizeAway(total);
+}
+
+static void plaintextWrite(uint32_t n, size_t recordSize) {
+  PlaintextWriteRecordLayer write;
+  Buf out;
+  for (uint32_t i = 0; i < n; ++i) {
+    Buf input;
+    BENCHMARK_SUSPEND {
+      input = RecordLayerHarness::makeData(kBytesPerIteration);
+    }
+    // Plaintext records can't be larger than 16k, so split the input up the
+    // way the handshake would.
+    while (!input->empty()) {
+      auto length = std::min(recordSize, input->length());
+      auto record = input->cloneOne();
+      record->trimEnd(record->length() - length);
+      input->trimStart(length);
+      out = write.write(TLSMessage{ContentType::handshake, std::move(record)});
+    }
+  }
+  folly::doNotOptimizeAway(out);
+}
+
+BENCHMARK_NAMED_PARAM(encryptedRead, chunk_1B_record_16k, 1, 16384, 0)
+BENCHMARK_NAMED_PARAM(encryptedRead, chunk_100B_record_16k, 100, 16384, 0)
+BENCHMARK_NAMED_PARAM(encryptedRead, chunk_1460B_record_16k, 1460, 16384, 0)
+BENCHMARK_NAMED_PARAM(encryptedRead, chunk_16k_record_16k, 16384, 16384, 0)
+BENCHMARK_NAMED_PARAM(encryptedRead, chunk_64k_record_16k, 65536, 16384, 0)
+BENCHMARK_NAMED_PARAM(encryptedRead, chunk_1460B_record_1k, 1460, 1024, 0)
+BENCHMARK_NAMED_PARAM(encryptedRead, chunk_64k_record_1k, 65536, 1024, 0)
+BENCHMARK_NAMED_PARAM(encryptedRead, chunk_64k_record_100B, 65536, 100, 0)
+BENCHMARK_NAMED_PARAM(encryptedRead, chunk_64k_pad_16B, 65536, 16384, 16)
+BENCHMARK_NAMED_PARAM(encryptedRead, chunk_64k_pad_1k, 65536, 15360, 1024)
+BENCHMARK_NAMED_PARAM(encryptedRead, chunk_1460B_pad_1k, 1460, 15360, 1024)
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(encryptedWrite, chunk_1B_record_16k, 1, 16384)
+BENCHMARK_NAMED_PARAM(encryptedWrite, chunk_100B_record_16k, 100, 16384)
+BENCHMARK_NAMED_PARAM(encryptedWrite, chunk_4k_record_16k, 4096, 16384)
+BENCHMARK_NAMED_PARAM(encryptedWrite, chunk_64k_record_16k, 65536, 16384)
+BENCHMARK_NAMED_PARAM(encryptedWrite, chunk_64k_record_1k, 65536, 1024)
+BENCHMARK_NAMED_PARAM(encryptedWrite, chunk_64k_record_100B, 65536, 100)
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(plaintextRead, chunk_1B_record_16k, 1, 16384)
+BENCHMARK_NAMED_PARAM(plaintextRead, chunk_1460B_record_16k, 1460, 16384)
+BENCHMARK_NAMED_PARAM(plaintextRead, chunk_64k_record_16k, 65536, 16384)
+BENCHMARK_NAMED_PARAM(plaintextRead, chunk_64k_record_100B, 65536, 100)
+BENCHMARK_NAMED_PARAM(plaintextWrite, record_16k, 16384)
+BENCHMARK_NAMED_PARAM(plaintextWrite, record_100B, 100)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::ssl::init();
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/ssl/Init.h>
+
+#include <fizz/record/test/RecordLayerHarness.h>
+
+using namespace fizz;
+using namespace fizz::test;
+
+/**
+ * libFuzzer entry point. The first two bytes of the input pick the chunk size
+ * the rest of it is delivered in. The rest is read as wire data by a
+ * plaintext and an encrypted read record layer, which may reject it but must
+ * not crash. It is then also written as app data, and reading the records
+ * back in chunks must give back the same number of bytes.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  static bool initialized = [] {
+    folly::ssl::init();
+    return true;
+  }();
+  (void)initialized;
+
+  if (size < 2) {
+    return 0;
+  }
+  size_t chunkSize = ((static_cast<size_t>(data[0]) << 8) | data[1]) + 1;
+  auto input = folly::IOBuf::copyBuffer(data + 2, size - 2);
+
+  try {
+    PlaintextReadRecordLayer read;
+    RecordLayerHarness::readAll(
+        read, RecordLayerHarness::fragment(*input, chunkSize));
+  } catch (const std::exception&) {
+  }
+
+  try {
+    EncryptedReadRecordLayer read;
+    read.setAead(RecordLayerHarness::makeAead());
+    RecordLayerHarness::readAll(
+        read, RecordLayerHarness::fragment(*input, chunkSize));
+  } catch (const std::exception&) {
+  }
+
+  if (input->empty()) {
+    return 0;
+  }
+  EncryptedWriteRecordLayer write;
+  write.setAead(RecordLayerHarness::makeAead());
+  write.setMaxRecord(std::min<size_t>(chunkSize, kMaxPlaintextRecordSize));
+  auto records = write.write(
+      TLSMessage{ContentType::application_data, input->clone()});
+  EncryptedReadRecordLayer read;
+  read.setAead(RecordLayerHarness::makeAead());
+  auto total = RecordLayerHarness::readAll(
+      read, RecordLayerHarness::fragment(*records, chunkSize));
+  CHECK_EQ(total, input->length());
+  return 0;
+}
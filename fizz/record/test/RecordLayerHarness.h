@@ -0,0 +1,129 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/crypto/aead/AESGCM128.h>
+#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
+#include <fizz/record/EncryptedRecordLayer.h>
+#include <fizz/record/PlaintextRecordLayer.h>
+
+#include <folly/io/Cursor.h>
+
+#include <algorithm>
+
+namespace fizz {
+namespace test {
+
+/**
+ * Shared setup for the record layer benchmark and fuzzer: records built with
+ * a given plaintext size and padding, and delivery of the wire bytes to a
+ * read record layer in chunks of a given size, the way they would arrive
+ * from a socket.
+ */
+class RecordLayerHarness {
+ public:
+  static std::unique_ptr<Aead> makeAead() {
+    static const uint8_t kKey[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+                                     0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+                                     0x0c, 0x0d, 0x0e, 0x0f};
+    static const uint8_t kIv[12] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b};
+    TrafficKey key;
+    key.key = folly::IOBuf::copyBuffer(kKey, sizeof(kKey));
+    key.iv = folly::IOBuf::copyBuffer(kIv, sizeof(kIv));
+    auto aead = std::make_unique<OpenSSLEVPCipher<AESGCM128>>();
+    aead->setKey(std::move(key));
+    return std::move(aead);
+  }
+
+  static Buf makeData(size_t length) {
+    auto buf = folly::IOBuf::create(length);
+    std::fill_n(buf->writableData(), length, 'a');
+    buf->append(length);
+    return buf;
+  }
+
+  /**
+   * Encrypts numRecords application data records with recordSize bytes of
+   * plaintext and padding zero bytes of padding each, as the aead from
+   * makeAead() starting at sequence number 0. The write record layer never
+   * pads, so the records are built here.
+   */
+  static Buf makeEncryptedRecords(
+      size_t recordSize,
+      size_t padding,
+      size_t numRecords) {
+    auto aead = makeAead();
+    folly::IOBufQueue out{folly::IOBufQueue::cacheChainLength()};
+    for (size_t i = 0; i < numRecords; ++i) {
+      auto inner = makeData(recordSize + sizeof(ContentType) + padding);
+      inner->writableData()[recordSize] =
+          static_cast<uint8_t>(ContentType::application_data);
+      std::fill_n(inner->writableData() + recordSize + 1, padding, 0);
+
+      auto header = folly::IOBuf::create(kEncryptedHeaderSize);
+      folly::io::Appender appender(header.get(), 0);
+      appender.writeBE(static_cast<uint8_t>(ContentType::application_data));
+      appender.writeBE(static_cast<uint16_t>(ProtocolVersion::tls_1_2));
+      appender.writeBE<uint16_t>(
+          inner->length() + aead->getCipherOverhead());
+      auto ciphertext = aead->encrypt(std::move(inner), header.get(), i);
+      out.append(std::move(header));
+      out.append(std::move(ciphertext));
+    }
+    return out.move();
+  }
+
+  static Buf makePlaintextRecords(size_t recordSize, size_t numRecords) {
+    PlaintextWriteRecordLayer write;
+    folly::IOBufQueue out{folly::IOBufQueue::cacheChainLength()};
+    for (size_t i = 0; i < numRecords; ++i) {
+      out.append(write.write(
+          TLSMessage{ContentType::handshake, makeData(recordSize)}));
+    }
+    return out.move();
+  }
+
+  /**
+   * Splits data into separately allocated buffers of chunkSize bytes.
+   */
+  static std::vector<Buf> fragment(const folly::IOBuf& data, size_t chunkSize) {
+    std::vector<Buf> chunks;
+    folly::io::Cursor cursor(&data);
+    while (!cursor.isAtEnd()) {
+      auto length = std::min(chunkSize, cursor.totalLength());
+      auto chunk = folly::IOBuf::create(length);
+      cursor.pull(chunk->writableData(), length);
+      chunk->append(length);
+      chunks.push_back(std::move(chunk));
+    }
+    return chunks;
+  }
+
+  /**
+   * Appends the chunks to a socket queue one at a time, reading every
+   * complete record after each. Returns the number of plaintext bytes read.
+   * Errors from the record layer are propagated.
+   */
+  static size_t readAll(ReadRecordLayer& read, std::vector<Buf> chunks) {
+    folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+    size_t total = 0;
+    for (auto& chunk : chunks) {
+      queue.append(std::move(chunk));
+      while (auto msg = read.read(queue)) {
+        if (msg->fragment) {
+          total += msg->fragment->computeChainDataLength();
+        }
+      }
+    }
+    return total;
+  }
+};
+} // namespace test
+} // namespace fizz
@@ -9,6 +9,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <fizz/protocol/test/Mocks.h>
 #include <fizz/record/RecordLayer.h>
 #include <fizz/record/test/Mocks.h>
 
@@ -26,6 +27,11 @@ namespace test {
 class ConcreteReadRecordLayer : public PlaintextReadRecordLayer {
  public:
   MOCK_METHOD1(read, folly::Optional<TLSMessage>(folly::IOBufQueue& buf));
+
+  RecordLayerResult<folly::Optional<TLSMessage>> tryRead(
+      folly::IOBufQueue& buf) override {
+    return ReadRecordLayer::tryRead(buf);
+  }
 };
 
 class ConcreteWriteRecordLayer : public PlaintextWriteRecordLayer {
@@ -72,6 +78,73 @@ TEST_F(RecordTest, TestReadAppData) {
   EXPECT_TRUE(eq_(appData.data, IOBuf::copyBuffer("hi")));
 }
 
+TEST_F(RecordTest, TestReadAppDataCoalesced) {
+  read_.setCoalesceAppData(true);
+  Sequence s;
+  EXPECT_CALL(read_, read(_))
+      .InSequence(s)
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::application_data,
+                          IOBuf::copyBuffer("hello")};
+      }));
+  EXPECT_CALL(read_, read(_))
+      .InSequence(s)
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::application_data,
+                          IOBuf::copyBuffer("world")};
+      }));
+  EXPECT_CALL(read_, read(_)).InSequence(s).WillOnce(InvokeWithoutArgs([]() {
+    return none;
+  }));
+  auto param = read_.readEvent(queue_);
+  auto& appData = boost::get<AppData>(*param);
+  EXPECT_TRUE(eq_(appData.data, IOBuf::copyBuffer("helloworld")));
+}
+
+TEST_F(RecordTest, TestReadAppDataCoalescedStopsAtHandshake) {
+  read_.setCoalesceAppData(true);
+  Sequence s;
+  EXPECT_CALL(read_, read(_))
+      .InSequence(s)
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::application_data,
+                          IOBuf::copyBuffer("hello")};
+      }));
+  EXPECT_CALL(read_, read(_))
+      .InSequence(s)
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::handshake, getBuf("14000002aaaa")};
+      }));
+  auto param = read_.readEvent(queue_);
+  auto& appData = boost::get<AppData>(*param);
+  EXPECT_TRUE(eq_(appData.data, IOBuf::copyBuffer("hello")));
+  EXPECT_TRUE(read_.hasUnparsedHandshakeData());
+
+  // The buffered handshake record is returned without another read.
+  param = read_.readEvent(queue_);
+  auto& finished = boost::get<Finished>(*param);
+  expectSame(*finished.originalEncoding, "14000002aaaa");
+  EXPECT_FALSE(read_.hasUnparsedHandshakeData());
+}
+
+TEST_F(RecordTest, TestReadAppDataCoalescedError) {
+  read_.setCoalesceAppData(true);
+  Sequence s;
+  EXPECT_CALL(read_, read(_))
+      .InSequence(s)
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::application_data,
+                          IOBuf::copyBuffer("hello")};
+      }));
+  EXPECT_CALL(read_, read(_))
+      .InSequence(s)
+      .WillOnce(Throw(std::runtime_error("bad record")));
+  auto param = read_.readEvent(queue_);
+  auto& appData = boost::get<AppData>(*param);
+  EXPECT_TRUE(eq_(appData.data, IOBuf::copyBuffer("hello")));
+  EXPECT_THROW(read_.readEvent(queue_), std::runtime_error);
+}
+
 TEST_F(RecordTest, TestAlert) {
   EXPECT_CALL(read_, read(_)).WillOnce(InvokeWithoutArgs([]() {
     return TLSMessage{ContentType::alert, getBuf("0202")};
@@ -97,6 +170,54 @@ TEST_F(RecordTest, TestHandshakeTooLong) {
   EXPECT_ANY_THROW(read_.readEvent(queue_));
 }
 
+TEST_F(RecordTest, TestHandshakeTooLongFragmentedHeader) {
+  EXPECT_CALL(read_, read(_))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::handshake, getBuf("0b")};
+      }))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::handshake, getBuf("020001")};
+      }));
+  // Rejected once the header is complete, without waiting for the body.
+  EXPECT_ANY_THROW(read_.readEvent(queue_));
+}
+
+TEST_F(RecordTest, TestHandshakeManyFragments) {
+  std::string body(1000, 'a');
+  auto message = hexlify(unhexlify("140003e8") + body);
+  size_t offset = 0;
+  EXPECT_CALL(read_, read(_)).WillRepeatedly(InvokeWithoutArgs([&]() {
+    auto fragment = getBuf(message.substr(offset, 2));
+    offset += 2;
+    return TLSMessage{ContentType::handshake, std::move(fragment)};
+  }));
+  auto param = read_.readEvent(queue_);
+  EXPECT_EQ(offset, message.size());
+  EXPECT_FALSE(read_.hasUnparsedHandshakeData());
+  auto& finished = boost::get<Finished>(*param);
+  expectSame(finished.verify_data, hexlify(body));
+  expectSame(*finished.originalEncoding, message);
+}
+
+TEST_F(RecordTest, TestHandshakeFragmentsShareReadBuffer) {
+  // The first fragment's tail room is the rest of the read buffer, which
+  // must not be packed into.
+  auto readBuf = getBuf("14000008aabbccdd11223344");
+  EXPECT_CALL(read_, read(_))
+      .WillOnce(InvokeWithoutArgs([&]() {
+        auto fragment = readBuf->clone();
+        fragment->trimEnd(4);
+        return TLSMessage{ContentType::handshake, std::move(fragment)};
+      }))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::handshake, getBuf("55667788")};
+      }));
+  auto param = read_.readEvent(queue_);
+  auto& finished = boost::get<Finished>(*param);
+  expectSame(finished.verify_data, "aabbccdd55667788");
+  expectSame(readBuf, "14000008aabbccdd11223344");
+}
+
 TEST_F(RecordTest, TestHandshakeFragmentedImmediate) {
   EXPECT_CALL(read_, read(_))
       .WillOnce(InvokeWithoutArgs([]() {
@@ -142,6 +263,62 @@ TEST_F(RecordTest, TestHandshakeCoalesced) {
   EXPECT_FALSE(read_.hasUnparsedHandshakeData());
 }
 
+TEST_F(RecordTest, TestCertificateParsedAsReceived) {
+  std::vector<std::string> parsed;
+  read_.setCertificateParser([&](Buf certData) {
+    parsed.push_back(hexlify(certData->moveToFbString().toStdString()));
+    return std::make_shared<MockPeerCert>();
+  });
+  EXPECT_CALL(read_, read(_))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::handshake, getBuf("0b000012000000")};
+      }))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::handshake,
+                          getBuf("0e000002aabb0000000002cc")};
+      }))
+      .WillOnce(InvokeWithoutArgs([]() { return folly::none; }));
+  EXPECT_FALSE(read_.readEvent(queue_).hasValue());
+  EXPECT_EQ(parsed, std::vector<std::string>({"aabb"}));
+
+  EXPECT_CALL(read_, read(_)).WillOnce(InvokeWithoutArgs([]() {
+    return TLSMessage{ContentType::handshake, getBuf("dd0000")};
+  }));
+  auto param = read_.readEvent(queue_);
+  EXPECT_EQ(parsed, std::vector<std::string>({"aabb"}));
+  auto& certMsg = boost::get<CertificateMsg>(*param);
+  ASSERT_EQ(certMsg.certificate_list.size(), 2);
+  EXPECT_TRUE(certMsg.certificate_list[0].parsedCert);
+  expectSame(certMsg.certificate_list[0].cert_data, "aabb");
+  EXPECT_FALSE(certMsg.certificate_list[1].parsedCert);
+  expectSame(certMsg.certificate_list[1].cert_data, "ccdd");
+}
+
+TEST_F(RecordTest, TestCertificateParserThrows) {
+  size_t calls = 0;
+  read_.setCertificateParser([&](Buf) -> std::shared_ptr<const PeerCert> {
+    calls++;
+    throw std::runtime_error("bad cert");
+  });
+  EXPECT_CALL(read_, read(_))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::handshake,
+                          getBuf("0b0000120000000e000002aabb0000")};
+      }))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::handshake, getBuf("000002cc")};
+      }))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::handshake, getBuf("dd0000")};
+      }));
+  auto param = read_.readEvent(queue_);
+  EXPECT_EQ(calls, 1);
+  auto& certMsg = boost::get<CertificateMsg>(*param);
+  ASSERT_EQ(certMsg.certificate_list.size(), 2);
+  EXPECT_FALSE(certMsg.certificate_list[0].parsedCert);
+  EXPECT_FALSE(certMsg.certificate_list[1].parsedCert);
+}
+
 TEST_F(RecordTest, TestHandshakeSpliced) {
   EXPECT_CALL(read_, read(_))
       .WillOnce(InvokeWithoutArgs([]() {
@@ -154,6 +331,32 @@ TEST_F(RecordTest, TestHandshakeSpliced) {
   EXPECT_ANY_THROW(read_.readEvent(queue_));
 }
 
+TEST_F(RecordTest, TestTryReadEventSpliced) {
+  EXPECT_CALL(read_, read(_))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::handshake, getBuf("01000010abcd")};
+      }))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TLSMessage{ContentType::application_data,
+                          IOBuf::copyBuffer("hi")};
+      }));
+  auto param = read_.tryReadEvent(queue_);
+  ASSERT_TRUE(param.hasError());
+  EXPECT_EQ(param.error().message, "spliced handshake data");
+  EXPECT_FALSE(param.error().alert.hasValue());
+}
+
+TEST_F(RecordTest, TestTryReadEventReadThrows) {
+  EXPECT_CALL(read_, read(_)).WillOnce(InvokeWithoutArgs([]() {
+    throw FizzException("bad", AlertDescription::illegal_parameter);
+    return folly::none;
+  }));
+  auto param = read_.tryReadEvent(queue_);
+  ASSERT_TRUE(param.hasError());
+  EXPECT_EQ(param.error().message, "bad");
+  EXPECT_EQ(*param.error().alert, AlertDescription::illegal_parameter);
+}
+
 TEST_F(RecordTest, TestWriteAppData) {
   EXPECT_CALL(write_, _write(_)).WillOnce(Invoke([](TLSMessage& msg) {
     EXPECT_EQ(msg.type, ContentType::application_data);
@@ -79,5 +79,18 @@ TEST(TestTypes, WriteBuf) {
   detail::writeBuf<uint64_t>(buf, appender2);
   EXPECT_EQ(8 + buf->length(), out2->computeChainDataLength());
 }
+
+static_assert(isKnownValue(CipherSuite::TLS_AES_128_GCM_SHA256), "");
+static_assert(!isKnownValue(static_cast<CipherSuite>(0x1234)), "");
+
+TEST(TestTypes, EnumNames) {
+  EXPECT_EQ(enumName(NamedGroup::x25519), "x25519");
+  EXPECT_EQ(enumName(ExtensionType::supported_versions), "supported_version");
+  EXPECT_TRUE(enumName(static_cast<NamedGroup>(0xfafa)).empty());
+  EXPECT_FALSE(isKnownValue(static_cast<AlertDescription>(0xfe)));
+
+  EXPECT_EQ(toString(AlertDescription::decode_error), "decode_error");
+  EXPECT_EQ(toString(static_cast<SignatureScheme>(0xfafa)), "fafa");
+}
 } // namespace test
 } // namespace fizz
@@ -10,6 +10,7 @@
 
 #include <boost/variant.hpp>
 #include <fizz/protocol/Actions.h>
+#include <fizz/record/Types.h>
 #include <folly/futures/Future.h>
 #include <folly/small_vector.h>
 
@@ -27,6 +28,16 @@ struct AttemptVersionFallback {
   std::unique_ptr<folly::IOBuf> clientHello;
 };
 
+/**
+ * Reports that the ClientHello router chose to hand the connection off. chlo
+ * is the parsed ClientHello and clientHello its re-encoded record, as in
+ * AttemptVersionFallback.
+ */
+struct RouteClientHello {
+  ClientHello chlo;
+  std::unique_ptr<folly::IOBuf> clientHello;
+};
+
 /**
  * Reports that early data was received and accepted. Application data delivered
  * after ReportEarlyHandshakeSuccess but before ReportHandshakeSuccess was
@@ -47,7 +58,8 @@ using Action = boost::variant<
     ReportError,
     MutateState,
     WaitForData,
-    AttemptVersionFallback>;
+    AttemptVersionFallback,
+    RouteClientHello>;
 using Actions = folly::small_vector<Action, 4>;
 using AsyncActions = boost::variant<Actions, folly::Future<Actions>>;
 
@@ -6,8 +6,11 @@
  *  LICENSE file in the root directory of this source tree.
  */
 
+#include <fizz/crypto/Utils.h>
 #include <fizz/record/Extensions.h>
 
+#include <openssl/crypto.h>
+
 namespace fizz {
 namespace server {
 namespace detail {
@@ -89,9 +92,75 @@ AeadCookieCipher<AeadType, HkdfType>::getTokenOrRetry(
   }
 }
 
+/*
+ * With the MAC precheck enabled, cookies are:
+ *
+ * 8 bytes truncated HMAC(mac key, encrypted cookie)
+ * remaining data encrypted cookie
+ *
+ * mac key = HKDF-Extract("Fizz Cookie MAC v1", cookie secret)
+ */
+
+static constexpr folly::StringPiece kCookieMacLabel{"Fizz Cookie MAC v1"};
+
+template <typename AeadType, typename HkdfType>
+bool AeadCookieCipher<AeadType, HkdfType>::setCookieSecrets(
+    const std::vector<folly::ByteRange>& cookieSecrets) {
+  if (!tokenCipher_.setSecrets(cookieSecrets)) {
+    return false;
+  }
+  clearMacKeys();
+  for (const auto& cookieSecret : cookieSecrets) {
+    macKeys_.push_back(
+        HkdfType().extract(folly::range(kCookieMacLabel), cookieSecret));
+  }
+  return true;
+}
+
+template <typename AeadType, typename HkdfType>
+typename AeadCookieCipher<AeadType, HkdfType>::CookieMac
+AeadCookieCipher<AeadType, HkdfType>::computeMac(
+    const std::vector<uint8_t>& macKey,
+    folly::ByteRange data) const {
+  // HKDF-Extract(salt, ikm) is HMAC(salt, ikm).
+  auto mac = HkdfType().extract(folly::range(macKey), data);
+  CookieMac truncated;
+  std::copy(mac.begin(), mac.begin() + truncated.size(), truncated.begin());
+  return truncated;
+}
+
+template <typename AeadType, typename HkdfType>
+void AeadCookieCipher<AeadType, HkdfType>::clearMacKeys() {
+  for (auto& macKey : macKeys_) {
+    CryptoUtils::clean(folly::range(macKey));
+  }
+  macKeys_.clear();
+}
+
 template <typename AeadType, typename HkdfType>
 folly::Optional<CookieState> AeadCookieCipher<AeadType, HkdfType>::decrypt(
     Buf cookie) const {
+  if (macPrecheck_) {
+    auto data = cookie->coalesce();
+    if (data.size() < kCookieMacLength) {
+      return folly::none;
+    }
+    auto encrypted = data.subpiece(kCookieMacLength);
+    bool matched = false;
+    for (const auto& macKey : macKeys_) {
+      auto mac = computeMac(macKey, encrypted);
+      if (CRYPTO_memcmp(mac.data(), data.data(), kCookieMacLength) == 0) {
+        matched = true;
+        break;
+      }
+    }
+    if (!matched) {
+      VLOG(6) << "Cookie failed MAC precheck.";
+      return folly::none;
+    }
+    cookie->trimStart(kCookieMacLength);
+  }
+
   auto plaintext = tokenCipher_.decrypt(std::move(cookie));
   if (plaintext) {
     return detail::decodeCookie(std::move(*plaintext));
@@ -100,6 +169,20 @@ folly::Optional<CookieState> AeadCookieCipher<AeadType, HkdfType>::decrypt(
   }
 }
 
+template <typename AeadType, typename HkdfType>
+folly::Optional<Buf> AeadCookieCipher<AeadType, HkdfType>::encrypt(
+    const CookieState& state) const {
+  auto cookie = tokenCipher_.encrypt(detail::encodeCookie(state));
+  if (!cookie || !macPrecheck_) {
+    return cookie;
+  }
+
+  auto mac = computeMac(macKeys_.front(), (*cookie)->coalesce());
+  auto withMac = folly::IOBuf::copyBuffer(mac.data(), mac.size());
+  withMac->prependChain(std::move(*cookie));
+  return std::move(withMac);
+}
+
 template <typename AeadType, typename HkdfType>
 Buf AeadCookieCipher<AeadType, HkdfType>::getStatelessResponse(
     const ClientHello& chlo,
@@ -112,14 +195,17 @@ Buf AeadCookieCipher<AeadType, HkdfType>::getStatelessResponse(
       chlo,
       std::move(appToken));
 
-  auto encoded = detail::encodeCookie(state);
-  auto cookie = tokenCipher_.encrypt(std::move(encoded));
+  auto cookie = encrypt(state);
   if (!cookie) {
     throw std::runtime_error("could not encrypt cookie");
   }
 
   auto statelessMessage = getStatelessHelloRetryRequest(
-      state.version, state.cipher, state.group, std::move(*cookie));
+      state.version,
+      state.cipher,
+      state.group,
+      std::move(*cookie),
+      chlo.legacy_session_id);
 
   return PlaintextWriteRecordLayer().writeHandshake(
       std::move(statelessMessage));
@@ -30,8 +30,29 @@ class AeadCookieCipher : public CookieCipher {
   /**
    * Set cookie secrets to use for cookie encryption/decryption.
    */
-  bool setCookieSecrets(const std::vector<folly::ByteRange>& cookieSecrets) {
-    return tokenCipher_.setSecrets(cookieSecrets);
+  bool setCookieSecrets(const std::vector<folly::ByteRange>& cookieSecrets);
+
+  ~AeadCookieCipher() override {
+    clearMacKeys();
+  }
+
+  /**
+   * Prefix cookies with the id of their secret, see
+   * AeadTokenCipher::setUseKeyIds.
+   */
+  void setUseKeyIds(bool useKeyIds) {
+    tokenCipher_.setUseKeyIds(useKeyIds);
+  }
+
+  /**
+   * Prefix cookies with a truncated HMAC of the encrypted cookie, keyed
+   * separately from the encryption key, so that forged or garbage cookies
+   * are rejected with one HMAC per secret before any key derivation, AEAD
+   * or decoding work. This changes the cookie format and must be set the
+   * same way on all servers sharing the secrets.
+   */
+  void setMacPrecheck(bool macPrecheck) {
+    macPrecheck_ = macPrecheck;
   }
 
   /**
@@ -52,11 +73,26 @@ class AeadCookieCipher : public CookieCipher {
 
   folly::Optional<CookieState> decrypt(Buf cookie) const override;
 
+  folly::Optional<Buf> encrypt(const CookieState& state) const override;
+
  private:
+  static constexpr size_t kCookieMacLength = 8;
+  using CookieMac = std::array<uint8_t, kCookieMacLength>;
+
   Buf getStatelessResponse(const ClientHello& chlo, Buf appToken) const;
 
+  CookieMac computeMac(
+      const std::vector<uint8_t>& macKey,
+      folly::ByteRange data) const;
+
+  void clearMacKeys();
+
   AeadTokenCipher<AeadType, HkdfType> tokenCipher_;
 
+  // One per cookie secret, the first one is used for new cookies.
+  std::vector<std::vector<uint8_t>> macKeys_;
+  bool macPrecheck_{false};
+
   const FizzServerContext* context_ = nullptr;
 };
 } // namespace server
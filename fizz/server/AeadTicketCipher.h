@@ -8,9 +8,12 @@
 
 #pragma once
 
+#include <fizz/crypto/Sha256.h>
 #include <fizz/server/AeadTokenCipher.h>
 #include <fizz/server/FizzServerContext.h>
 #include <fizz/server/TicketCipher.h>
+#include <folly/Synchronized.h>
+#include <folly/ThreadLocal.h>
 
 namespace fizz {
 namespace server {
@@ -37,7 +40,15 @@ class AeadTicketCipher : public TicketCipher {
    * All secrets must be at least kMinTicketSecretLength long.
    */
   bool setTicketSecrets(const std::vector<folly::ByteRange>& ticketSecrets) {
-    return tokenCipher_.setSecrets(ticketSecrets);
+    if (!tokenCipher_.setSecrets(ticketSecrets)) {
+      return false;
+    }
+    auto cache = resumptionCache_.copy();
+    if (cache) {
+      // Tickets from removed secrets must not keep resuming.
+      setResumptionCache(cache->size, cache->ttl);
+    }
+    return true;
   }
 
   void setContext(const FizzServerContext* context) {
@@ -48,6 +59,50 @@ class AeadTicketCipher : public TicketCipher {
     validity_ = validity;
   }
 
+  /**
+   * Set how many tickets share one salt and AEAD key, see
+   * AeadTokenCipher::setMaxTokensPerSalt.
+   */
+  void setMaxTicketsPerSalt(uint32_t maxTicketsPerSalt) {
+    tokenCipher_.setMaxTokensPerSalt(maxTicketsPerSalt);
+  }
+
+  /**
+   * See AeadTokenCipher::setSaltLifetime.
+   */
+  void setSaltLifetime(std::chrono::milliseconds lifetime) {
+    tokenCipher_.setSaltLifetime(lifetime);
+  }
+
+  /**
+   * Prefix tickets with the id of their secret, see
+   * AeadTokenCipher::setUseKeyIds.
+   */
+  void setUseKeyIds(bool useKeyIds) {
+    tokenCipher_.setUseKeyIds(useKeyIds);
+  }
+
+  /**
+   * See AeadTokenCipher::setDecryptCacheSize.
+   */
+  void setDecryptCacheSize(size_t size) {
+    tokenCipher_.setDecryptCacheSize(size);
+  }
+
+  /**
+   * Keep the decoded state of up to size recently decrypted tickets per
+   * thread for ttl, keyed by ticket hash, so that a client resuming with the
+   * same ticket several times in a short window skips key derivation,
+   * decryption and decoding. Cached state is dropped once the ticket is
+   * older than the validity. 0 (the default) disables the cache.
+   */
+  void setResumptionCache(size_t size, std::chrono::milliseconds ttl) {
+    std::shared_ptr<ResumptionCache> cache = size > 0 && ttl.count() > 0
+        ? std::make_shared<ResumptionCache>(size, ttl)
+        : nullptr;
+    resumptionCache_.wlock()->swap(cache);
+  }
+
   folly::Future<folly::Optional<std::pair<Buf, std::chrono::seconds>>> encrypt(
       ResumptionState resState) const override {
     auto encoded = CodecType::encode(std::move(resState));
@@ -61,10 +116,32 @@ class AeadTicketCipher : public TicketCipher {
 
   folly::Future<std::pair<PskType, folly::Optional<ResumptionState>>> decrypt(
       std::unique_ptr<folly::IOBuf> encryptedTicket) const override {
+    auto cache = resumptionCache_.copy();
+    std::string cacheKey;
+    if (cache) {
+      cacheKey = hashTicket(*encryptedTicket);
+      auto& entries = *cache->entries;
+      auto it = entries.find(cacheKey);
+      if (it != entries.end()) {
+        if (it->second.expires > std::chrono::steady_clock::now() &&
+            it->second.state.ticketIssueTime + validity_ >
+                std::chrono::system_clock::now()) {
+          return std::make_pair(
+              PskType::Resumption, cloneResumptionState(it->second.state));
+        }
+        entries.erase(it);
+      }
+    }
+
     auto plaintext = tokenCipher_.decrypt(std::move(encryptedTicket));
     if (plaintext) {
       try {
         auto decoded = CodecType::decode(std::move(*plaintext), context_);
+        if (cache) {
+          CachedState cached{cloneResumptionState(decoded),
+                             std::chrono::steady_clock::now() + cache->ttl};
+          cache->entries->set(cacheKey, std::move(cached));
+        }
         return std::make_pair(PskType::Resumption, std::move(decoded));
       } catch (const std::exception& ex) {
         VLOG(6) << "Failed to decode ticket, ex=" << ex.what();
@@ -75,11 +152,42 @@ class AeadTicketCipher : public TicketCipher {
   }
 
  private:
+  struct CachedState {
+    ResumptionState state;
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  using CachedStates = folly::EvictingCacheMap<std::string, CachedState>;
+
+  struct ResumptionCache {
+    ResumptionCache(size_t cacheSize, std::chrono::milliseconds cacheTtl)
+        : size(cacheSize),
+          ttl(cacheTtl),
+          entries([cacheSize]() { return new CachedStates(cacheSize); }) {}
+
+    size_t size;
+    std::chrono::milliseconds ttl;
+    folly::ThreadLocal<CachedStates> entries;
+  };
+
+  static std::string hashTicket(const folly::IOBuf& ticket) {
+    std::string hash(Sha256::HashLen, '\0');
+    Sha256::hash(
+        ticket,
+        folly::MutableByteRange(
+            reinterpret_cast<uint8_t*>(&hash[0]), hash.size()));
+    return hash;
+  }
+
   AeadTokenCipher<AeadType, HkdfType> tokenCipher_;
 
   std::chrono::seconds validity_{std::chrono::hours(1)};
 
   const FizzServerContext* context_ = nullptr;
+
+  // Replaced whenever the secrets change, possibly while other threads are
+  // decrypting. Each decrypt works on the cache it copied out.
+  folly::Synchronized<std::shared_ptr<ResumptionCache>> resumptionCache_;
 };
 } // namespace server
 } // namespace fizz
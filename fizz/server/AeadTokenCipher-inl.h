@@ -16,6 +16,7 @@ namespace server {
 /*
  * Token structure:
  *
+ * 4 bytes key id, if enabled
  * 32 bytes salt
  * 4 bytes sequence number
  * remaining data ciphertext
@@ -29,10 +30,15 @@ namespace server {
  *
  * The 32 byte salt is used to derive an aead key with sufficient space such
  * that the salts can be generated randomly without worry of collisions. The
- * sequence number is currently always 0 when encrypting tokens, however it
- * could be incremented to avoid an extra HKDF-Expand on every token.
+ * sequence number is 0 unless the cipher is set to encrypt several tokens
+ * under one salt, in which case it is incremented for each of them to avoid
+ * an extra HKDF-Expand on every token.
+ *
+ * key id = first 4 bytes of HKDF-Expand(secret, "token key id", 4)
  */
 
+static constexpr folly::StringPiece kTokenKeyIdLabel{"token key id"};
+
 template <typename AeadType, typename HkdfType>
 bool AeadTokenCipher<AeadType, HkdfType>::setSecrets(
     const std::vector<folly::ByteRange>& tokenSecrets) {
@@ -53,6 +59,10 @@ bool AeadTokenCipher<AeadType, HkdfType>::setSecrets(
       extracted = HkdfType().extract(
           folly::range(contextString), folly::range(extracted));
     }
+    auto info = folly::IOBuf::wrapBuffer(folly::range(kTokenKeyIdLabel));
+    auto keyId = HkdfType().expand(
+        folly::range(extracted), *info, sizeof(KeyId));
+    keyIds_.push_back(folly::io::Cursor(keyId.get()).readBE<KeyId>());
     secrets_.push_back(std::move(extracted));
   }
   return true;
@@ -65,39 +75,90 @@ folly::Optional<Buf> AeadTokenCipher<AeadType, HkdfType>::encrypt(
     return folly::none;
   }
 
-  auto salt = RandomGenerator<kSaltLength>().generateRandom();
-  auto aead = createAead(folly::range(secrets_.front()), folly::range(salt));
-
-  // For now we always use sequence number 0.
-  SeqNum seqNum = 0;
-  auto token = folly::IOBuf::create(kTokenHeaderLength);
-  folly::io::Appender appender(token.get(), kTokenHeaderLength);
-  appender.push(folly::range(salt));
-  appender.writeBE(seqNum);
-  token->prependChain(aead.encrypt(std::move(plaintext), nullptr, seqNum));
+  auto writeToken = [this](const Salt& salt, SeqNum seqNum, Buf ciphertext) {
+    auto headerLength =
+        kTokenHeaderLength + (useKeyIds_ ? sizeof(KeyId) : 0);
+    auto token = folly::IOBuf::create(headerLength);
+    folly::io::Appender appender(token.get(), headerLength);
+    if (useKeyIds_) {
+      appender.writeBE(keyIds_.front());
+    }
+    appender.push(folly::range(salt));
+    appender.writeBE(seqNum);
+    token->prependChain(std::move(ciphertext));
+    return token;
+  };
+
+  if (maxTokensPerSalt_ == 1) {
+    auto salt = RandomGenerator<kSaltLength>().generateRandom();
+    auto aead = createAead(folly::range(secrets_.front()), folly::range(salt));
+    return writeToken(salt, 0, aead.encrypt(std::move(plaintext), nullptr, 0));
+  }
 
-  return std::move(token);
+  // The AEAD is not safe to use concurrently, so the whole encryption happens
+  // under the lock.
+  std::lock_guard<std::mutex> lock(saltKey_->mutex);
+  auto now = std::chrono::steady_clock::now();
+  if (!saltKey_->aead || saltKey_->nextSeqNum >= maxTokensPerSalt_ ||
+      (saltLifetime_.count() > 0 &&
+       now - saltKey_->created >= saltLifetime_)) {
+    saltKey_->salt = RandomGenerator<kSaltLength>().generateRandom();
+    saltKey_->aead = std::make_unique<AeadType>(createAead(
+        folly::range(secrets_.front()), folly::range(saltKey_->salt)));
+    saltKey_->nextSeqNum = 0;
+    saltKey_->created = now;
+  }
+  auto seqNum = saltKey_->nextSeqNum++;
+  return writeToken(
+      saltKey_->salt,
+      seqNum,
+      saltKey_->aead->encrypt(std::move(plaintext), nullptr, seqNum));
 }
 
 template <typename AeadType, typename HkdfType>
 folly::Optional<Buf> AeadTokenCipher<AeadType, HkdfType>::decrypt(
     Buf token) const {
   folly::io::Cursor cursor(token.get());
-  if (secrets_.empty() || !cursor.canAdvance(kTokenHeaderLength)) {
+  auto headerLength = kTokenHeaderLength + (useKeyIds_ ? sizeof(KeyId) : 0);
+  if (secrets_.empty() || !cursor.canAdvance(headerLength)) {
     return folly::none;
   }
 
+  folly::Optional<size_t> secretIndex;
+  if (useKeyIds_) {
+    auto keyId = cursor.readBE<KeyId>();
+    auto it = std::find(keyIds_.begin(), keyIds_.end(), keyId);
+    if (it == keyIds_.end()) {
+      VLOG(6) << "Unknown token key id.";
+      return folly::none;
+    }
+    secretIndex = it - keyIds_.begin();
+  }
+
   Salt salt;
   cursor.pull(salt.data(), salt.size());
   auto seqNum = cursor.readBE<SeqNum>();
   Buf ciphertext;
   cursor.clone(ciphertext, cursor.totalLength());
 
-  for (const auto& secret : secrets_) {
-    auto aead = createAead(folly::range(secret), folly::range(salt));
-    auto result = aead.tryDecrypt(ciphertext->clone(), nullptr, seqNum);
+  if (secretIndex) {
+    auto result =
+        decryptWithSecret(*secretIndex, salt, seqNum, std::move(ciphertext));
+    if (!result) {
+      VLOG(6) << "Failed to decrypt token.";
+    }
+    return result;
+  }
+
+  for (size_t i = 0; i < secrets_.size(); ++i) {
+    // Only the last attempt may consume the ciphertext.
+    auto result = decryptWithSecret(
+        i,
+        salt,
+        seqNum,
+        i + 1 < secrets_.size() ? ciphertext->clone() : std::move(ciphertext));
     if (result) {
-      return std::move(result);
+      return result;
     }
   }
 
@@ -105,6 +166,42 @@ folly::Optional<Buf> AeadTokenCipher<AeadType, HkdfType>::decrypt(
   return folly::none;
 }
 
+template <typename AeadType, typename HkdfType>
+folly::Optional<Buf> AeadTokenCipher<AeadType, HkdfType>::decryptWithSecret(
+    size_t secretIndex,
+    const Salt& salt,
+    SeqNum seqNum,
+    Buf ciphertext) const {
+  auto cache = decryptCache_;
+  if (!cache) {
+    auto aead =
+        createAead(folly::range(secrets_[secretIndex]), folly::range(salt));
+    return aead.tryDecrypt(std::move(ciphertext), nullptr, seqNum);
+  }
+
+  std::string cacheKey(salt.begin(), salt.end());
+  cacheKey.append(
+      reinterpret_cast<const char*>(&secretIndex), sizeof(secretIndex));
+  {
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    auto it = cache->aeads.find(cacheKey);
+    if (it != cache->aeads.end()) {
+      return it->second->tryDecrypt(std::move(ciphertext), nullptr, seqNum);
+    }
+  }
+
+  // Derive the key outside the lock, and only cache it for tokens that
+  // decrypt so that garbage can't evict useful entries.
+  auto aead = std::make_unique<AeadType>(
+      createAead(folly::range(secrets_[secretIndex]), folly::range(salt)));
+  auto result = aead->tryDecrypt(std::move(ciphertext), nullptr, seqNum);
+  if (result) {
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    cache->aeads.set(cacheKey, std::move(aead));
+  }
+  return result;
+}
+
 template <typename AeadType, typename HkdfType>
 AeadType AeadTokenCipher<AeadType, HkdfType>::createAead(
     folly::ByteRange secret,
@@ -127,6 +224,12 @@ void AeadTokenCipher<AeadType, HkdfType>::clearSecrets() {
     CryptoUtils::clean(folly::range(secret));
   }
   secrets_.clear();
+  keyIds_.clear();
+  saltKey_ = std::make_shared<SaltKey>();
+  if (decryptCache_) {
+    decryptCache_ =
+        std::make_shared<DecryptCache>(decryptCache_->aeads.getMaxSize());
+  }
 }
 } // namespace server
 } // namespace fizz
@@ -10,8 +10,14 @@
 
 #include <fizz/record/Types.h>
 #include <folly/Optional.h>
+#include <folly/container/EvictingCacheMap.h>
 #include <folly/io/IOBuf.h>
 
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
 namespace fizz {
 namespace server {
 
@@ -43,6 +49,47 @@ class AeadTokenCipher {
    */
   bool setSecrets(const std::vector<folly::ByteRange>& tokenSecrets);
 
+  /**
+   * Set how many tokens are encrypted under one salt before a new one is
+   * generated. Tokens after the first reuse the salt's AEAD key with the next
+   * sequence number, saving an HKDF-Expand and a key setup per token. Default
+   * is 1, a new salt for every token.
+   */
+  void setMaxTokensPerSalt(uint32_t maxTokensPerSalt) {
+    maxTokensPerSalt_ = std::max<uint32_t>(maxTokensPerSalt, 1);
+  }
+
+  /**
+   * When tokens share salts (see setMaxTokensPerSalt()), also move to a new
+   * salt once the current one has been in use for lifetime, so that a salt
+   * covers a bounded time window even at low token rates. 0 (the default)
+   * only limits the number of tokens.
+   */
+  void setSaltLifetime(std::chrono::milliseconds lifetime) {
+    saltLifetime_ = lifetime;
+  }
+
+  /**
+   * Prefix tokens with a 4 byte id derived from the secret they are
+   * encrypted with, so that decryption tries only that secret instead of
+   * each configured secret in turn. This changes the token format: tokens
+   * made with key ids disabled do not decrypt with them enabled, and vice
+   * versa. Must be set the same way on all servers sharing the secrets.
+   */
+  void setUseKeyIds(bool useKeyIds) {
+    useKeyIds_ = useKeyIds;
+  }
+
+  /**
+   * Keep the AEADs derived for the salts of up to size recently decrypted
+   * tokens, so that tokens sharing a salt are decrypted without deriving the
+   * key again. Decryptions through a cached AEAD are serialized. 0 (the
+   * default) disables the cache.
+   */
+  void setDecryptCacheSize(size_t size) {
+    decryptCache_ = size > 0 ? std::make_shared<DecryptCache>(size) : nullptr;
+  }
+
   folly::Optional<Buf> encrypt(Buf plaintext) const;
 
   folly::Optional<Buf> decrypt(Buf) const;
@@ -52,14 +99,50 @@ class AeadTokenCipher {
   static constexpr size_t kSaltLength = HkdfType::HashLen;
   using Salt = std::array<uint8_t, kSaltLength>;
   using SeqNum = uint32_t;
+  using KeyId = uint32_t;
   static constexpr size_t kTokenHeaderLength = kSaltLength + sizeof(SeqNum);
 
   AeadType createAead(folly::ByteRange secret, folly::ByteRange salt) const;
 
+  folly::Optional<Buf> decryptWithSecret(
+      size_t secretIndex,
+      const Salt& salt,
+      SeqNum seqNum,
+      Buf ciphertext) const;
+
   void clearSecrets();
 
+  struct SaltKey {
+    std::mutex mutex;
+    Salt salt;
+    std::unique_ptr<AeadType> aead;
+    SeqNum nextSeqNum{0};
+    std::chrono::steady_clock::time_point created;
+  };
+
+  struct DecryptCache {
+    explicit DecryptCache(size_t size) : aeads(size) {}
+
+    std::mutex mutex;
+    // Keyed by salt and secret index.
+    folly::EvictingCacheMap<std::string, std::unique_ptr<AeadType>> aeads;
+  };
+
   // First secret is the one used to encrypt.
   std::vector<Secret> secrets_;
+  // Key id of each secret.
+  std::vector<KeyId> keyIds_;
+
+  uint32_t maxTokensPerSalt_{1};
+  std::chrono::milliseconds saltLifetime_{0};
+  bool useKeyIds_{false};
+
+  // Key for the current salt when maxTokensPerSalt_ > 1. Shared so that the
+  // cipher stays copyable, replaced whenever the secrets change.
+  std::shared_ptr<SaltKey> saltKey_{std::make_shared<SaltKey>()};
+
+  // Shared like saltKey_, replaced whenever the secrets change.
+  std::shared_ptr<DecryptCache> decryptCache_;
 
   std::vector<std::string> contextStrings_;
 };
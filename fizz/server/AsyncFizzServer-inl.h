@@ -14,7 +14,7 @@ namespace server {
 template <typename SM>
 AsyncFizzServerT<SM>::AsyncFizzServerT(
     folly::AsyncTransportWrapper::UniquePtr socket,
-    const std::shared_ptr<FizzServerContext>& fizzContext,
+    const std::shared_ptr<const FizzServerContext>& fizzContext,
     const std::shared_ptr<ServerExtensions>& extensions)
     : AsyncFizzBase(std::move(socket)),
       fizzContext_(fizzContext),
@@ -30,6 +30,102 @@ void AsyncFizzServerT<SM>::accept(HandshakeCallback* callback) {
   startTransportReads();
 }
 
+/**
+ * Completes a promise with the outcome of the handshake, deleting itself once
+ * done.
+ */
+template <typename SM>
+class AsyncFizzServerT<SM>::FutureHandshakeCallback
+    : public AsyncFizzServerT<SM>::HandshakeCallback {
+ public:
+  folly::Future<folly::Unit> getFuture() {
+    return promise_.getFuture();
+  }
+
+  void fizzHandshakeSuccess(AsyncFizzServerT* /* transport */) noexcept
+      override {
+    complete(folly::Try<folly::Unit>(folly::unit));
+  }
+
+  void fizzHandshakeError(
+      AsyncFizzServerT* /* transport */,
+      folly::exception_wrapper ex) noexcept override {
+    complete(folly::Try<folly::Unit>(std::move(ex)));
+  }
+
+  void fizzHandshakeAttemptFallback(
+      std::unique_ptr<folly::IOBuf> clientHello) override {
+    complete(folly::Try<folly::Unit>(
+        folly::make_exception_wrapper<HandshakeFallbackException>(
+            std::move(clientHello))));
+  }
+
+ private:
+  void complete(folly::Try<folly::Unit> result) {
+    auto promise = std::move(promise_);
+    delete this;
+    promise.setTry(std::move(result));
+  }
+
+  folly::Promise<folly::Unit> promise_;
+};
+
+template <typename SM>
+folly::Future<folly::Unit> AsyncFizzServerT<SM>::accept() {
+  auto callback = new FutureHandshakeCallback();
+  auto future = callback->getFuture();
+  accept(callback);
+  return future;
+}
+
+template <typename SM>
+void AsyncFizzServerT<SM>::acceptHandoff(ConnectionHandoff handoff) {
+  auto pendingData = std::move(handoff.pendingData);
+  fizzServer_.acceptHandoff(
+      transport_->getEventBase(),
+      fizzContext_,
+      extensions_,
+      std::move(handoff));
+  startTransportReads();
+  if (pendingData && !pendingData->empty()) {
+    folly::DelayedDestruction::DestructorGuard dg(this);
+    transportReadBuf_.append(std::move(pendingData));
+    transportDataAvailable();
+  }
+}
+
+template <typename SM>
+folly::Optional<ConnectionHandoff> AsyncFizzServerT<SM>::exportHandoff() {
+  if (handedOff_ || kTLSEnabled() || error()) {
+    return folly::none;
+  }
+  DelayedDestruction::DestructorGuard dg(this);
+  // Records the app already wrote must be encrypted with the sequence
+  // numbers we hand off, not after them.
+  flushCorkedWrites();
+  // Like enableKTLS(), everything the state machine produced must have
+  // reached the app or the socket for the sequence numbers to line up.
+  if (error() || state_.state() != StateEnum::AcceptingData ||
+      fizzServer_.actionProcessing() || hasHeldWrites() ||
+      !state_.readRecordLayer() ||
+      state_.readRecordLayer()->hasUnparsedHandshakeData() ||
+      transport_->getRawBytesBuffered() != 0) {
+    return folly::none;
+  }
+  // Nothing may be read past the snapshot.
+  stopTransportReads();
+  try {
+    auto handoff = server::exportConnection(state_);
+    handoff.pendingData = transportReadBuf_.move();
+    handedOff_ = true;
+    return std::move(handoff);
+  } catch (const std::exception& ex) {
+    VLOG(3) << "unable to export connection: " << ex.what();
+    startTransportReads();
+    return folly::none;
+  }
+}
+
 template <typename SM>
 bool AsyncFizzServerT<SM>::good() const {
   return !error() && transport_->good();
@@ -93,14 +189,21 @@ const Cert* AsyncFizzServerT<SM>::getSelfCertificate() const {
 
 template <typename SM>
 bool AsyncFizzServerT<SM>::isReplaySafe() const {
-  // Server always provides replay protection.
-  return true;
+  // Unless the app asked to be told about early data, the replay cache is
+  // relied on and the server is always replay safe.
+  if (!fizzContext_->getEarlyDataReplaySafetyReporting() ||
+      getState().earlyDataType() != EarlyDataType::Accepted) {
+    return true;
+  }
+  return getState().state() != StateEnum::AcceptingEarlyData &&
+      getState().state() != StateEnum::ExpectingFinished;
 }
 
 template <typename SM>
 void AsyncFizzServerT<SM>::setReplaySafetyCallback(
-    folly::AsyncTransport::ReplaySafetyCallback*) {
-  LOG(FATAL) << "setReplaySafetyCallback() called on replay safe transport";
+    folly::AsyncTransport::ReplaySafetyCallback* callback) {
+  DCHECK(!callback || !isReplaySafe());
+  replaySafetyCallback_ = callback;
 }
 
 template <typename SM>
@@ -114,10 +217,11 @@ std::string AsyncFizzServerT<SM>::getApplicationProtocol() noexcept {
 
 template <typename SM>
 void AsyncFizzServerT<SM>::close() {
-  if (transport_->good()) {
+  DelayedDestruction::DestructorGuard dg(this);
+  flushCorkedWrites();
+  if (transport_->good() && !kTLSEnabled() && !handedOff_) {
     fizzServer_.appClose();
   } else {
-    DelayedDestruction::DestructorGuard dg(this);
     folly::AsyncSocketException ase(
         folly::AsyncSocketException::END_OF_FILE, "socket closed locally");
     deliverAllErrors(ase, false);
@@ -128,7 +232,8 @@ void AsyncFizzServerT<SM>::close() {
 template <typename SM>
 void AsyncFizzServerT<SM>::closeWithReset() {
   DelayedDestruction::DestructorGuard dg(this);
-  if (transport_->good()) {
+  flushCorkedWrites();
+  if (transport_->good() && !kTLSEnabled() && !handedOff_) {
     fizzServer_.appClose();
   }
   folly::AsyncSocketException ase(
@@ -140,7 +245,8 @@ void AsyncFizzServerT<SM>::closeWithReset() {
 template <typename SM>
 void AsyncFizzServerT<SM>::closeNow() {
   DelayedDestruction::DestructorGuard dg(this);
-  if (transport_->good()) {
+  flushCorkedWrites();
+  if (transport_->good() && !kTLSEnabled() && !handedOff_) {
     fizzServer_.appClose();
   }
   folly::AsyncSocketException ase(
@@ -149,6 +255,56 @@ void AsyncFizzServerT<SM>::closeNow() {
   transport_->closeNow();
 }
 
+template <typename SM>
+void AsyncFizzServerT<SM>::releaseIdleResources() {
+  fizzServer_.releaseIdleResources();
+  AsyncFizzBase::releaseIdleResources();
+}
+
+template <typename SM>
+MemoryUsage AsyncFizzServerT<SM>::getMemoryUsage() const {
+  auto usage = AsyncFizzBase::getMemoryUsage();
+  usage.stateBytes += sizeof(*this);
+  fizzServer_.addMemoryUsage(usage);
+  if (state_.hasHandshakeState() && state_.unverifiedCertChain()) {
+    usage.peerCertBytes += getCertChainBytes(
+        *state_.unverifiedCertChain(), getPeerCertificate());
+  }
+  return usage;
+}
+
+template <typename SM>
+bool AsyncFizzServerT<SM>::enableKTLS(const KTLSOptions& options) {
+  if (kTLSEnabled()) {
+    return true;
+  }
+  // Everything the record layers have processed so far must have been handed
+  // to the app or the socket, so that the exported sequence numbers line up
+  // with what the kernel will see next.
+  if (error() || state_.state() != StateEnum::AcceptingData ||
+      fizzServer_.actionProcessing() || !transportReadBuf_.empty() ||
+      !state_.cipher() || !state_.readRecordLayer() ||
+      state_.readRecordLayer()->hasUnparsedHandshakeData() ||
+      transport_->getRawBytesBuffered() != 0) {
+    return false;
+  }
+  auto socket = transport_->getUnderlyingTransport<folly::AsyncSocket>();
+  if (!socket) {
+    return false;
+  }
+  auto rx = KTLS::extractReadParams(state_.readRecordLayer(), *state_.cipher());
+  auto tx =
+      KTLS::extractWriteParams(state_.writeRecordLayer(), *state_.cipher());
+  if (!rx || !tx) {
+    return false;
+  }
+  if (!KTLS::setupSocket(socket->getFd(), *rx, *tx, options)) {
+    return false;
+  }
+  startKTLSPassthrough();
+  return true;
+}
+
 template <typename SM>
 Buf AsyncFizzServerT<SM>::getEkm(
     folly::StringPiece label,
@@ -185,7 +341,13 @@ void AsyncFizzServerT<SM>::writeAppData(
   write.callback = callback;
   write.data = std::move(buf);
   write.flags = flags;
+  write.iovecs = makeWriteIovecs();
   fizzServer_.appWrite(std::move(write));
+
+  if (newSessionTicketDeferred_) {
+    newSessionTicketDeferred_ = false;
+    fizzServer_.writeNewSessionTicket(WriteNewSessionTicket());
+  }
 }
 
 template <typename SM>
@@ -197,6 +359,8 @@ void AsyncFizzServerT<SM>::transportError(
 
 template <typename SM>
 void AsyncFizzServerT<SM>::transportDataAvailable() {
+  typename FizzServer<ActionMoveVisitor, SM>::OwnerGuardedScope guarded(
+      fizzServer_);
   fizzServer_.newTransportData();
 }
 
@@ -205,6 +369,7 @@ void AsyncFizzServerT<SM>::deliverAllErrors(
     const folly::AsyncSocketException& ex,
     bool closeTransport) {
   deliverHandshakeError(ex);
+  replaySafetyCallback_ = nullptr;
   fizzServer_.moveToErrorState(ex);
   deliverError(ex, closeTransport);
 }
@@ -225,7 +390,12 @@ void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(DeliverAppData& data) {
 
 template <typename SM>
 void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(WriteToSocket& data) {
-  server_.transport_->writeChain(
+  if (data.iovecs) {
+    server_.writeRecordsToTransport(
+        data.callback, std::move(data.iovecs), data.flags);
+    return;
+  }
+  server_.writeRecordsToTransport(
       data.callback, std::move(data.data), data.flags);
 }
 
@@ -242,11 +412,19 @@ void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(
 template <typename SM>
 void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(
     ReportHandshakeSuccess&) {
+  server_.newSessionTicketDeferred_ =
+      server_.fizzContext_->getSendNewSessionTicket() &&
+      server_.fizzContext_->getDeferNewSessionTicket();
   if (server_.handshakeCallback_) {
     auto callback = server_.handshakeCallback_;
     server_.handshakeCallback_ = nullptr;
     callback->fizzHandshakeSuccess(&server_);
   }
+  if (server_.replaySafetyCallback_) {
+    auto callback = server_.replaySafetyCallback_;
+    server_.replaySafetyCallback_ = nullptr;
+    callback->onReplaySafe();
+  }
 }
 
 template <typename SM>
@@ -264,12 +442,16 @@ void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(WaitForData&) {
   if (server_.handshakeCallback_) {
     // Make sure that the read callback is installed.
     server_.startTransportReads();
+  } else {
+    server_.checkBufLen();
   }
 }
 
 template <typename SM>
 void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(MutateState& mutator) {
   mutator(server_.state_);
+  server_.attachReadRecordLayer(server_.state_.readRecordLayer());
+  server_.scheduleMemoryUsageReport();
 }
 
 template <typename SM>
@@ -286,5 +468,21 @@ void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(
   }
   callback->fizzHandshakeAttemptFallback(std::move(fallback.clientHello));
 }
+
+template <typename SM>
+void AsyncFizzServerT<SM>::ActionMoveVisitor::operator()(
+    RouteClientHello& route) {
+  if (!server_.handshakeCallback_) {
+    VLOG(2) << "fizz route without callback";
+    return;
+  }
+  auto callback = server_.handshakeCallback_;
+  server_.handshakeCallback_ = nullptr;
+  if (!server_.transportReadBuf_.empty()) {
+    route.clientHello->prependChain(server_.transportReadBuf_.move());
+  }
+  callback->fizzHandshakeRoute(
+      std::move(route.chlo), std::move(route.clientHello));
+}
 } // namespace server
 } // namespace fizz
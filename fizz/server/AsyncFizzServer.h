@@ -10,6 +10,7 @@
 
 #include <fizz/protocol/AsyncFizzBase.h>
 #include <fizz/protocol/Exporter.h>
+#include <fizz/protocol/KTLS.h>
 #include <fizz/server/FizzServer.h>
 #include <fizz/server/FizzServerContext.h>
 #include <fizz/server/ServerProtocol.h>
@@ -17,6 +18,25 @@
 namespace fizz {
 namespace server {
 
+/**
+ * The error the future returned by AsyncFizzServerT::accept() fails with
+ * where a HandshakeCallback would have been asked to fall back or to route
+ * the connection. It carries the ClientHello bytes read so far.
+ */
+class HandshakeFallbackException : public std::runtime_error {
+ public:
+  explicit HandshakeFallbackException(std::unique_ptr<folly::IOBuf> clientHello)
+      : std::runtime_error("handshake fallback"),
+        clientHello_(std::move(clientHello)) {}
+
+  std::unique_ptr<folly::IOBuf> getClientHello() const {
+    return clientHello_ ? clientHello_->clone() : nullptr;
+  }
+
+ private:
+  std::shared_ptr<folly::IOBuf> clientHello_;
+};
+
 template <typename SM>
 class AsyncFizzServerT : public AsyncFizzBase {
  public:
@@ -32,6 +52,18 @@ class AsyncFizzServerT : public AsyncFizzBase {
 
     virtual void fizzHandshakeAttemptFallback(
         std::unique_ptr<folly::IOBuf> clientHello) = 0;
+
+    /**
+     * Called instead of continuing the handshake when the context's
+     * ClientHello router hands the connection off. clientHello holds the
+     * bytes read so far, as for fizzHandshakeAttemptFallback. Defaults to
+     * fizzHandshakeAttemptFallback.
+     */
+    virtual void fizzHandshakeRoute(
+        ClientHello /* chlo */,
+        std::unique_ptr<folly::IOBuf> clientHello) {
+      fizzHandshakeAttemptFallback(std::move(clientHello));
+    }
   };
 
   using UniquePtr =
@@ -39,15 +71,47 @@ class AsyncFizzServerT : public AsyncFizzBase {
 
   AsyncFizzServerT(
       folly::AsyncTransportWrapper::UniquePtr socket,
-      const std::shared_ptr<FizzServerContext>& fizzContext,
+      const std::shared_ptr<const FizzServerContext>& fizzContext,
       const std::shared_ptr<ServerExtensions>& extensions = nullptr);
 
   virtual void accept(HandshakeCallback* callback);
 
+  /**
+   * Same as accept(HandshakeCallback*), completing the returned future
+   * instead of calling a callback. The future fails with a
+   * HandshakeFallbackException where the callback would have been asked to
+   * fall back or route the connection.
+   */
+  folly::Future<folly::Unit> accept();
+
+  /**
+   * Instead of accept(), continue a connection that another process handed
+   * off with exportHandoff(). The transport must be the same connection.
+   */
+  void acceptHandoff(ConnectionHandoff handoff);
+
+  /**
+   * Captures the connection so that another process can continue it (see
+   * ConnectionHandoff). Returns none if the connection can't be handed off
+   * right now, eg because actions are still being processed, written data is
+   * still buffered, or kTLS is enabled. Corked and paced writes are flushed
+   * first. On success reads are stopped and this object must not be used for
+   * the connection any more, other than to detach its socket or close it;
+   * closing it doesn't send close_notify.
+   */
+  folly::Optional<ConnectionHandoff> exportHandoff();
+
   bool good() const override;
   bool readable() const override;
   bool connecting() const override;
   bool error() const override;
+  /**
+   * The connection may be moved to another EventBase (detachEventBase() then
+   * attachEventBase() on the new thread) whenever isDetachable() is true. It
+   * is false while the state machine is processing actions, which covers any
+   * events queued behind them and asynchronous work such as the replay cache
+   * check or signing. A pending handshake timeout moves with the connection.
+   */
   bool isDetachable() const override;
   void attachEventBase(folly::EventBase* evb) override;
 
@@ -62,6 +126,31 @@ class AsyncFizzServerT : public AsyncFizzBase {
   void closeWithReset() override;
   void closeNow() override;
 
+  void releaseIdleResources() override;
+
+  MemoryUsage getMemoryUsage() const override;
+
+  /**
+   * Merge app writes that queue up behind the state machine into a single
+   * write. See FizzBase::setCoalesceAppWrites().
+   */
+  void setCoalesceAppWrites(bool enabled) {
+    fizzServer_.setCoalesceAppWrites(enabled);
+  }
+
+  /**
+   * Hand record protection over to the kernel (see KTLS.h) and pass app data
+   * through to the socket from now on. Only possible once the handshake is
+   * complete, with no buffered reads or writes in flight, and when the
+   * underlying transport is an AsyncSocket. Returns false (and keeps using
+   * userspace record protection) if kTLS could not be enabled.
+   *
+   * Once enabled, closing the transport no longer sends a close_notify alert.
+   * options are passed on to the kernel, and mostly matter when the NIC
+   * offloads record protection.
+   */
+  bool enableKTLS(const KTLSOptions& options = KTLSOptions());
+
   /**
    * Internal state access for logging/testing.
    */
@@ -79,6 +168,16 @@ class AsyncFizzServerT : public AsyncFizzBase {
       const Buf& hashedContext,
       uint16_t length) const;
 
+  /**
+   * Same as getEkm(), writing out.size() bytes into out.
+   */
+  void getEkm(
+      folly::StringPiece label,
+      folly::ByteRange context,
+      folly::MutableByteRange out) const {
+    fizzServer_.getEkm(label, context, out);
+  }
+
   const Cert* getPeerCertificate() const override;
   const Cert* getSelfCertificate() const override;
 
@@ -98,6 +197,8 @@ class AsyncFizzServerT : public AsyncFizzBase {
       bool closeTransport = true);
   void deliverHandshakeError(folly::exception_wrapper ex);
 
+  class FutureHandshakeCallback;
+
   class ActionMoveVisitor : public boost::static_visitor<> {
    public:
     explicit ActionMoveVisitor(AsyncFizzServerT<SM>& server)
@@ -111,6 +212,7 @@ class AsyncFizzServerT : public AsyncFizzBase {
     void operator()(WaitForData&);
     void operator()(MutateState&);
     void operator()(AttemptVersionFallback&);
+    void operator()(RouteClientHello&);
 
    private:
     AsyncFizzServerT<SM>& server_;
@@ -118,7 +220,16 @@ class AsyncFizzServerT : public AsyncFizzBase {
 
   HandshakeCallback* handshakeCallback_{nullptr};
 
-  std::shared_ptr<FizzServerContext> fizzContext_;
+  folly::AsyncTransport::ReplaySafetyCallback* replaySafetyCallback_{nullptr};
+
+  // Set once the handshake is done if the NewSessionTicket is to be sent
+  // behind the first app write.
+  bool newSessionTicketDeferred_{false};
+
+  // Set once the connection was exported with exportHandoff().
+  bool handedOff_{false};
+
+  std::shared_ptr<const FizzServerContext> fizzContext_;
 
   std::shared_ptr<ServerExtensions> extensions_;
 
@@ -0,0 +1,160 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/BatchingSelfCert.h>
+
+#include <algorithm>
+#include <map>
+
+namespace fizz {
+
+BatchingSelfCert::BatchingSelfCert(
+    std::shared_ptr<const SelfCert> cert,
+    std::shared_ptr<folly::Executor> executor,
+    size_t maxBatchSize)
+    : cert_(std::move(cert)),
+      executor_(std::move(executor)),
+      maxBatchSize_(std::max<size_t>(maxBatchSize, 1)) {}
+
+std::string BatchingSelfCert::getIdentity() const {
+  return cert_->getIdentity();
+}
+
+std::vector<std::string> BatchingSelfCert::getAltIdentities() const {
+  return cert_->getAltIdentities();
+}
+
+std::vector<SignatureScheme> BatchingSelfCert::getSigSchemes() const {
+  return cert_->getSigSchemes();
+}
+
+CertificateMsg BatchingSelfCert::getCertMessage(
+    Buf certificateRequestContext) const {
+  return cert_->getCertMessage(std::move(certificateRequestContext));
+}
+
+CertificateType BatchingSelfCert::getCertificateType() const {
+  return cert_->getCertificateType();
+}
+
+Buf BatchingSelfCert::getEncodedCertMessage() const {
+  return cert_->getEncodedCertMessage();
+}
+
+Buf BatchingSelfCert::getStapledCertMessage(
+    const std::vector<ExtensionType>& requestedExtensions) const {
+  return cert_->getStapledCertMessage(requestedExtensions);
+}
+
+std::shared_ptr<const SelfCert> BatchingSelfCert::getDelegatedCert(
+    const std::vector<SignatureScheme>& peerCredentialSchemes,
+    const std::vector<SignatureScheme>& peerSigSchemes) const {
+  return cert_->getDelegatedCert(peerCredentialSchemes, peerSigSchemes);
+}
+
+folly::ssl::X509UniquePtr BatchingSelfCert::getX509() const {
+  return cert_->getX509();
+}
+
+Buf BatchingSelfCert::sign(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    folly::ByteRange toBeSigned) const {
+  return cert_->sign(scheme, context, toBeSigned);
+}
+
+std::vector<Buf> BatchingSelfCert::signBatch(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    const std::vector<folly::ByteRange>& toBeSigned) const {
+  return cert_->signBatch(scheme, context, toBeSigned);
+}
+
+folly::Future<folly::Optional<Buf>> BatchingSelfCert::signFuture(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    folly::ByteRange toBeSigned) const {
+  SignRequest request;
+  request.scheme = scheme;
+  request.context = context;
+  request.toBeSigned = folly::IOBuf::copyBuffer(toBeSigned);
+  auto future = request.promise.getFuture();
+
+  bool schedule;
+  {
+    auto pending = pending_.wlock();
+    pending->requests.push_back(std::move(request));
+    schedule = !pending->scheduled;
+    pending->scheduled = true;
+  }
+  if (schedule) {
+    executor_->add([self = shared_from_this()]() { self->runBatch(); });
+  }
+  return future;
+}
+
+void BatchingSelfCert::runBatch() const {
+  std::vector<SignRequest> batch;
+  bool more;
+  {
+    auto pending = pending_.wlock();
+    auto count = std::min(maxBatchSize_, pending->requests.size());
+    batch.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      batch.push_back(std::move(pending->requests.front()));
+      pending->requests.pop_front();
+    }
+    more = !pending->requests.empty();
+    pending->scheduled = more;
+  }
+  if (more) {
+    executor_->add([self = shared_from_this()]() { self->runBatch(); });
+  }
+  signRequests(batch);
+}
+
+void BatchingSelfCert::signRequests(std::vector<SignRequest>& batch) const {
+  // Requests can only be signed together if they use the same scheme and
+  // context, which is almost always the case for a server's certificate.
+  std::map<
+      std::pair<SignatureScheme, CertificateVerifyContext>,
+      std::vector<SignRequest*>>
+      groups;
+  for (auto& request : batch) {
+    groups[std::make_pair(request.scheme, request.context)].push_back(
+        &request);
+  }
+
+  for (auto& group : groups) {
+    auto& requests = group.second;
+    std::vector<folly::ByteRange> toBeSigned;
+    toBeSigned.reserve(requests.size());
+    for (auto request : requests) {
+      toBeSigned.push_back(request->toBeSigned->coalesce());
+    }
+
+    std::vector<Buf> signatures;
+    try {
+      signatures =
+          cert_->signBatch(group.first.first, group.first.second, toBeSigned);
+      if (signatures.size() != requests.size()) {
+        throw std::runtime_error("wrong number of signatures");
+      }
+    } catch (const std::exception& e) {
+      for (auto request : requests) {
+        request->promise.setException(
+            folly::exception_wrapper(std::current_exception(), e));
+      }
+      continue;
+    }
+    for (size_t i = 0; i < requests.size(); ++i) {
+      requests[i]->promise.setValue(std::move(signatures[i]));
+    }
+  }
+}
+} // namespace fizz
@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/AsyncSelfCert.h>
+#include <folly/Executor.h>
+#include <folly/Synchronized.h>
+
+#include <deque>
+
+namespace fizz {
+
+/**
+ * AsyncSelfCert that queues CertificateVerify signing requests and signs
+ * them in batches on an executor, so that signing is not done on the thread
+ * running the handshake. A batch is started when a request is queued with no
+ * batch pending, and takes every request queued before it runs, up to
+ * maxBatchSize.
+ *
+ * By default the requests in a batch are signed with the wrapped
+ * certificate's signBatch(). signRequests() can be overridden to hand batches
+ * to a worker pool or a remote signing service instead.
+ *
+ * Thread safe. Must be owned by a shared_ptr so that pending batches can
+ * outlive the caller's reference.
+ */
+class BatchingSelfCert
+    : public AsyncSelfCert,
+      public std::enable_shared_from_this<BatchingSelfCert> {
+ public:
+  struct SignRequest {
+    SignatureScheme scheme;
+    CertificateVerifyContext context;
+    Buf toBeSigned;
+    folly::Promise<folly::Optional<Buf>> promise;
+  };
+
+  BatchingSelfCert(
+      std::shared_ptr<const SelfCert> cert,
+      std::shared_ptr<folly::Executor> executor,
+      size_t maxBatchSize);
+
+  ~BatchingSelfCert() override = default;
+
+  std::string getIdentity() const override;
+
+  std::vector<std::string> getAltIdentities() const override;
+
+  std::vector<SignatureScheme> getSigSchemes() const override;
+
+  CertificateMsg getCertMessage(
+      Buf certificateRequestContext = nullptr) const override;
+
+  CertificateType getCertificateType() const override;
+
+  Buf getEncodedCertMessage() const override;
+
+  Buf getStapledCertMessage(
+      const std::vector<ExtensionType>& requestedExtensions) const override;
+
+  std::shared_ptr<const SelfCert> getDelegatedCert(
+      const std::vector<SignatureScheme>& peerCredentialSchemes,
+      const std::vector<SignatureScheme>& peerSigSchemes) const override;
+
+  folly::ssl::X509UniquePtr getX509() const override;
+
+  /**
+   * Signs synchronously with the wrapped certificate, bypassing the queue.
+   */
+  Buf sign(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      folly::ByteRange toBeSigned) const override;
+
+  std::vector<Buf> signBatch(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      const std::vector<folly::ByteRange>& toBeSigned) const override;
+
+  folly::Future<folly::Optional<Buf>> signFuture(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      folly::ByteRange toBeSigned) const override;
+
+ protected:
+  /**
+   * Signs a batch of requests, fulfilling each request's promise. Called on
+   * the executor. The promises may be fulfilled after this returns.
+   */
+  virtual void signRequests(std::vector<SignRequest>& batch) const;
+
+  std::shared_ptr<const SelfCert> cert_;
+
+ private:
+  void runBatch() const;
+
+  struct Pending {
+    std::deque<SignRequest> requests;
+    bool scheduled{false};
+  };
+
+  std::shared_ptr<folly::Executor> executor_;
+  size_t maxBatchSize_;
+  mutable folly::Synchronized<Pending> pending_;
+};
+} // namespace fizz
@@ -0,0 +1,284 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/CertLoader.h>
+
+#include <fizz/crypto/Sha256.h>
+#include <folly/FileUtil.h>
+#include <folly/futures/Future.h>
+#include <folly/io/Cursor.h>
+#include <folly/ssl/OpenSSLCertUtils.h>
+
+namespace fizz {
+namespace server {
+
+namespace {
+
+constexpr uint8_t kCacheFormat = 1;
+
+using Digest = std::array<uint8_t, Sha256::HashLen>;
+
+struct ParsedCert {
+  std::vector<folly::ssl::X509UniquePtr> certs;
+  folly::ssl::EvpPkeyUniquePtr key;
+};
+
+ParsedCert parsePem(const CertSource& source) {
+  ParsedCert parsed;
+  parsed.certs = folly::ssl::OpenSSLCertUtils::readCertsFromBuffer(
+      folly::StringPiece(source.certData));
+  if (parsed.certs.empty()) {
+    throw std::runtime_error("no certificates read");
+  }
+  folly::ssl::BioUniquePtr b(
+      BIO_new_mem_buf(source.keyData.data(), source.keyData.size()));
+  if (!b) {
+    throw std::runtime_error("failed to create BIO");
+  }
+  parsed.key.reset(PEM_read_bio_PrivateKey(b.get(), nullptr, nullptr, nullptr));
+  if (!parsed.key) {
+    throw std::runtime_error("Failed to read key");
+  }
+  return parsed;
+}
+
+template <class T>
+void appendInt(T value, std::string& out) {
+  value = folly::Endian::big(value);
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void appendDer(int length, std::string& out) {
+  if (length <= 0) {
+    throw std::runtime_error("failed to encode DER");
+  }
+  appendInt(static_cast<uint32_t>(length), out);
+}
+
+std::string encodeParsed(const ParsedCert& parsed) {
+  std::string out;
+  appendInt(static_cast<uint8_t>(parsed.certs.size()), out);
+  for (const auto& cert : parsed.certs) {
+    auto length = i2d_X509(cert.get(), nullptr);
+    appendDer(length, out);
+    auto offset = out.size();
+    out.resize(offset + length);
+    auto ptr = reinterpret_cast<unsigned char*>(&out[offset]);
+    i2d_X509(cert.get(), &ptr);
+  }
+  auto length = i2d_PrivateKey(parsed.key.get(), nullptr);
+  appendDer(length, out);
+  auto offset = out.size();
+  out.resize(offset + length);
+  auto ptr = reinterpret_cast<unsigned char*>(&out[offset]);
+  i2d_PrivateKey(parsed.key.get(), &ptr);
+  return out;
+}
+
+folly::ByteRange readDer(folly::io::Cursor& cursor) {
+  auto length = cursor.readBE<uint32_t>();
+  if (!cursor.canAdvance(length)) {
+    throw std::runtime_error("truncated cert cache entry");
+  }
+  auto der = cursor.peekBytes();
+  if (der.size() < length) {
+    throw std::runtime_error("fragmented cert cache entry");
+  }
+  cursor.skip(length);
+  return der.subpiece(0, length);
+}
+
+ParsedCert decodeParsed(folly::ByteRange entry) {
+  auto buf = folly::IOBuf::wrapBufferAsValue(entry);
+  folly::io::Cursor cursor(&buf);
+  ParsedCert parsed;
+  auto count = cursor.read<uint8_t>();
+  if (count == 0) {
+    throw std::runtime_error("no certificates in cert cache entry");
+  }
+  for (uint8_t i = 0; i < count; ++i) {
+    auto der = readDer(cursor);
+    auto ptr = der.data();
+    folly::ssl::X509UniquePtr cert(d2i_X509(nullptr, &ptr, der.size()));
+    if (!cert) {
+      throw std::runtime_error("failed to decode cached certificate");
+    }
+    parsed.certs.push_back(std::move(cert));
+  }
+  auto der = readDer(cursor);
+  auto ptr = der.data();
+  parsed.key.reset(d2i_AutoPrivateKey(nullptr, &ptr, der.size()));
+  if (!parsed.key || !cursor.isAtEnd()) {
+    throw std::runtime_error("failed to decode cached key");
+  }
+  return parsed;
+}
+
+// Lengths are hashed as well, so that moving bytes between fields changes
+// the digest.
+Digest digestSources(const std::vector<CertSource>& sources) {
+  std::string lengths;
+  appendInt(static_cast<uint64_t>(sources.size()), lengths);
+  for (const auto& source : sources) {
+    appendInt(static_cast<uint64_t>(source.certData.size()), lengths);
+    appendInt(static_cast<uint64_t>(source.keyData.size()), lengths);
+  }
+  auto chain = folly::IOBuf::copyBuffer(lengths);
+  for (const auto& source : sources) {
+    chain->prependChain(folly::IOBuf::wrapBuffer(
+        source.certData.data(), source.certData.size()));
+    chain->prependChain(
+        folly::IOBuf::wrapBuffer(source.keyData.data(), source.keyData.size()));
+  }
+  Digest digest;
+  Sha256::hash(*chain, folly::range(digest));
+  return digest;
+}
+
+// Returns the entries of a cache written for digest, or none.
+folly::Optional<std::vector<folly::ByteRange>> splitCache(
+    folly::StringPiece contents,
+    const Digest& digest,
+    size_t count) {
+  auto buf = folly::IOBuf::wrapBufferAsValue(folly::ByteRange(contents));
+  folly::io::Cursor cursor(&buf);
+  if (!cursor.canAdvance(1 + digest.size() + sizeof(uint32_t)) ||
+      cursor.read<uint8_t>() != kCacheFormat) {
+    return folly::none;
+  }
+  Digest cached;
+  cursor.pull(cached.data(), cached.size());
+  if (cached != digest || cursor.readBE<uint32_t>() != count) {
+    return folly::none;
+  }
+  std::vector<folly::ByteRange> entries;
+  entries.reserve(count);
+  try {
+    for (size_t i = 0; i < count; ++i) {
+      entries.push_back(readDer(cursor));
+    }
+  } catch (const std::exception&) {
+    return folly::none;
+  }
+  if (!cursor.isAtEnd()) {
+    return folly::none;
+  }
+  return entries;
+}
+
+void writeCache(
+    const std::string& cachePath,
+    const Digest& digest,
+    const std::vector<std::string>& entries) {
+  std::string contents;
+  appendInt(kCacheFormat, contents);
+  contents.append(reinterpret_cast<const char*>(digest.data()), digest.size());
+  appendInt(static_cast<uint32_t>(entries.size()), contents);
+  for (const auto& entry : entries) {
+    appendInt(static_cast<uint32_t>(entry.size()), contents);
+    contents.append(entry);
+  }
+  try {
+    folly::writeFileAtomic(cachePath, contents, 0600);
+  } catch (const std::exception& e) {
+    LOG(WARNING) << "Failed to write cert cache " << cachePath << ": "
+                 << e.what();
+  }
+}
+
+// Runs makeCert for each index in [0, count) on executor. All tasks are
+// waited for before rethrowing, as they refer to the caller's state.
+template <class F>
+std::vector<std::shared_ptr<SelfCert>>
+parallelMap(size_t count, folly::Executor* executor, F makeCert) {
+  std::vector<std::shared_ptr<SelfCert>> certs;
+  certs.reserve(count);
+  if (!executor) {
+    for (size_t i = 0; i < count; ++i) {
+      certs.push_back(makeCert(i));
+    }
+    return certs;
+  }
+  std::vector<folly::Future<std::shared_ptr<SelfCert>>> futures;
+  futures.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    futures.push_back(
+        folly::via(executor, [&makeCert, i]() { return makeCert(i); }));
+  }
+  for (auto& result : folly::collectAll(futures).get()) {
+    certs.push_back(std::move(result.value()));
+  }
+  return certs;
+}
+} // namespace
+
+std::vector<std::shared_ptr<SelfCert>> CertLoader::load(
+    const std::vector<CertSource>& sources,
+    folly::Executor* executor,
+    ENGINE* engine) {
+  return parallelMap(sources.size(), executor, [&](size_t i) {
+    auto parsed = parsePem(sources[i]);
+    return std::shared_ptr<SelfCert>(CertUtils::makeSelfCert(
+        std::move(parsed.certs), std::move(parsed.key), engine));
+  });
+}
+
+std::vector<std::shared_ptr<SelfCert>> CertLoader::loadWithCache(
+    const std::vector<CertSource>& sources,
+    const std::string& cachePath,
+    folly::Executor* executor,
+    ENGINE* engine) {
+  auto digest = digestSources(sources);
+  std::string contents;
+  if (folly::readFile(cachePath.c_str(), contents)) {
+    auto entries = splitCache(contents, digest, sources.size());
+    if (entries) {
+      try {
+        return parallelMap(sources.size(), executor, [&](size_t i) {
+          auto parsed = decodeParsed((*entries)[i]);
+          return std::shared_ptr<SelfCert>(CertUtils::makeSelfCert(
+              std::move(parsed.certs), std::move(parsed.key), engine));
+        });
+      } catch (const std::exception& e) {
+        LOG(WARNING) << "Ignoring bad cert cache " << cachePath << ": "
+                     << e.what();
+      }
+    } else {
+      VLOG(4) << "Cert cache " << cachePath << " is stale";
+    }
+  }
+
+  std::vector<std::string> encoded(sources.size());
+  auto certs = parallelMap(sources.size(), executor, [&](size_t i) {
+    auto parsed = parsePem(sources[i]);
+    encoded[i] = encodeParsed(parsed);
+    return std::shared_ptr<SelfCert>(CertUtils::makeSelfCert(
+        std::move(parsed.certs), std::move(parsed.key), engine));
+  });
+  writeCache(cachePath, digest, encoded);
+  return certs;
+}
+
+void CertLoader::loadInto(
+    CertManager& manager,
+    const std::vector<CertSource>& sources,
+    folly::Executor* executor,
+    const folly::Optional<std::string>& cachePath,
+    ENGINE* engine) {
+  auto certs = cachePath
+      ? loadWithCache(sources, *cachePath, executor, engine)
+      : load(sources, executor, engine);
+  std::vector<std::pair<std::shared_ptr<SelfCert>, bool>> entries;
+  entries.reserve(certs.size());
+  for (size_t i = 0; i < certs.size(); ++i) {
+    entries.emplace_back(std::move(certs[i]), sources[i].defaultCert);
+  }
+  manager.addCerts(std::move(entries));
+}
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,70 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/CertManager.h>
+#include <folly/Executor.h>
+
+namespace fizz {
+namespace server {
+
+/**
+ * PEM certificate chain and private key of a certificate to load.
+ */
+struct CertSource {
+  std::string certData;
+  std::string keyData;
+  bool defaultCert{false};
+};
+
+/**
+ * Loads large certificate sets at startup. Parsing (and the work done by
+ * the SelfCert constructors) is spread over executor, and the result is
+ * added to a CertManager with a single addCerts() call.
+ *
+ * A cache file can be used to skip PEM decoding on warm restarts. It holds
+ * the DER encoded chains and keys of a set of sources, and is only used if
+ * it was written for exactly the same sources. As it contains the private
+ * keys it is written readable only by its owner.
+ */
+class CertLoader {
+ public:
+  /**
+   * Returns the certificates of sources, in order. Runs inline if executor
+   * is null. Throws the first error encountered.
+   */
+  static std::vector<std::shared_ptr<SelfCert>> load(
+      const std::vector<CertSource>& sources,
+      folly::Executor* executor,
+      ENGINE* engine = nullptr);
+
+  /**
+   * Like load(), but decodes cachePath instead of sources if it was written
+   * for them. Otherwise the cache is (re)written, best effort, after the
+   * sources are parsed.
+   */
+  static std::vector<std::shared_ptr<SelfCert>> loadWithCache(
+      const std::vector<CertSource>& sources,
+      const std::string& cachePath,
+      folly::Executor* executor,
+      ENGINE* engine = nullptr);
+
+  /**
+   * Loads sources (with the cache if cachePath is set) and adds them to
+   * manager.
+   */
+  static void loadInto(
+      CertManager& manager,
+      const std::vector<CertSource>& sources,
+      folly::Executor* executor,
+      const folly::Optional<std::string>& cachePath = folly::none,
+      ENGINE* engine = nullptr);
+};
+} // namespace server
+} // namespace fizz
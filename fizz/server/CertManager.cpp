@@ -8,6 +8,7 @@
 
 #include <fizz/server/CertManager.h>
 
+#include <folly/Conv.h>
 #include <folly/String.h>
 
 using namespace folly;
@@ -42,10 +43,69 @@ CertManager::CertMatch CertManager::findCert(
   return none;
 }
 
+// The raw sig scheme lists are part of the key, so distinct lookups never
+// share an entry.
+static std::string getSelectionKey(
+    const Optional<std::string>& sni,
+    const std::vector<SignatureScheme>& supportedSigSchemes,
+    const std::vector<SignatureScheme>& peerSigSchemes) {
+  std::string key;
+  auto appendSchemes = [&key](const std::vector<SignatureScheme>& schemes) {
+    auto size = folly::to<uint16_t>(schemes.size());
+    key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    key.append(
+        reinterpret_cast<const char*>(schemes.data()),
+        sizeof(SignatureScheme) * schemes.size());
+  };
+  appendSchemes(supportedSigSchemes);
+  appendSchemes(peerSigSchemes);
+  if (sni) {
+    key.push_back('s');
+    key.append(*sni);
+  }
+  return key;
+}
+
+constexpr size_t CertManager::kSelectionCacheShards;
+
 CertManager::CertMatch CertManager::getCert(
     const Optional<std::string>& sni,
     const std::vector<SignatureScheme>& supportedSigSchemes,
     const std::vector<SignatureScheme>& peerSigSchemes) const {
+  if (selectionCache_.empty()) {
+    return selectCert(sni, supportedSigSchemes, peerSigSchemes);
+  }
+
+  auto key = getSelectionKey(sni, supportedSigSchemes, peerSigSchemes);
+  auto& shard = getSelectionCacheShard(key);
+  {
+    auto cache = shard.rlock();
+    auto it = cache->findWithoutPromotion(key);
+    if (it != cache->end()) {
+      return it->second;
+    }
+  }
+  auto ret = selectCert(sni, supportedSigSchemes, peerSigSchemes);
+  shard.wlock()->set(std::move(key), ret, false /* promote */);
+  return ret;
+}
+
+CertManager::SelectionCacheShard& CertManager::getSelectionCacheShard(
+    const std::string& key) const {
+  auto index = std::hash<std::string>()(key) % kSelectionCacheShards;
+  return *selectionCache_[index];
+}
+
+void CertManager::clearSelectionCache() {
+  for (auto& shard : selectionCache_) {
+    shard->wlock()->clear();
+  }
+}
+
+CertManager::CertMatch CertManager::selectCert(
+    const Optional<std::string>& sni,
+    const std::vector<SignatureScheme>& supportedSigSchemes,
+    const std::vector<SignatureScheme>& peerSigSchemes) const {
   CertMatch lastResort;
   if (sni) {
     auto key = *sni;
@@ -57,11 +117,10 @@ CertManager::CertMatch CertManager::getCert(
       return ret;
     }
 
-    auto dot = key.find_first_of('.');
-    if (dot != std::string::npos) {
-      std::string wildcardKey(key, dot);
+    auto wildcardKey = getWildcardKey(key);
+    if (wildcardKey) {
       ret = findCert(
-          wildcardKey, supportedSigSchemes, peerSigSchemes, lastResort);
+          *wildcardKey, supportedSigSchemes, peerSigSchemes, lastResort);
       if (ret) {
         VLOG(8) << "Found wildcard SNI match for: " << key;
         return ret;
@@ -90,7 +149,20 @@ std::shared_ptr<SelfCert> CertManager::getCert(
   return it->second;
 }
 
-static std::string getKeyFromIdent(const std::string& ident) {
+std::shared_ptr<const Cert> CertManager::getOwningCert(
+    const std::shared_ptr<const Cert>& cert) const {
+  // Borrowed pointers have no control block.
+  if (!cert || cert.use_count() != 0) {
+    return cert;
+  }
+  auto it = ownedCerts_.find(cert.get());
+  if (it == ownedCerts_.end()) {
+    return cert;
+  }
+  return it->second;
+}
+
+std::string CertManager::getKeyFromIdent(const std::string& ident) {
   if (ident.empty()) {
     throw std::runtime_error("empty identity");
   }
@@ -103,18 +175,26 @@ static std::string getKeyFromIdent(const std::string& ident) {
   }
   toLowerAscii(key);
 
+  if (key.empty() || key == "." || key.find('*') != std::string::npos) {
+    throw std::runtime_error(to<std::string>("invalid identity: ", ident));
+  }
+
   return key;
 }
 
+Optional<std::string> CertManager::getWildcardKey(const std::string& key) {
+  auto dot = key.find_first_of('.');
+  if (dot == std::string::npos) {
+    return none;
+  }
+  return std::string(key, dot);
+}
+
 void CertManager::addCertIdentity(
     std::shared_ptr<SelfCert> cert,
     const std::string& ident) {
   auto key = getKeyFromIdent(ident);
 
-  if (key.empty() || key == "." || key.find('*') != std::string::npos) {
-    throw std::runtime_error(to<std::string>("invalid identity: ", ident));
-  }
-
   auto sigSchemes = cert->getSigSchemes();
   auto& schemeMap = certs_[key];
   for (auto sigScheme : sigSchemes) {
@@ -127,6 +207,35 @@ void CertManager::addCertIdentity(
 }
 
 void CertManager::addCert(std::shared_ptr<SelfCert> cert, bool defaultCert) {
+  insertCert(std::move(cert), defaultCert);
+
+  clearSelectionCache();
+}
+
+void CertManager::addCerts(
+    std::vector<std::pair<std::shared_ptr<SelfCert>, bool>> certs) {
+  // Most certs have a single identity, so this is close to the final size.
+  certs_.reserve(certs_.size() + certs.size());
+  identMap_.reserve(identMap_.size() + certs.size());
+  if (borrowCerts_) {
+    ownedCerts_.reserve(ownedCerts_.size() + certs.size());
+  }
+  for (auto& cert : certs) {
+    insertCert(std::move(cert.first), cert.second);
+  }
+
+  clearSelectionCache();
+}
+
+void CertManager::insertCert(
+    std::shared_ptr<SelfCert> cert,
+    bool defaultCert) {
+  auto owner = cert;
+  if (borrowCerts_) {
+    ownedCerts_.emplace(cert.get(), cert);
+    cert = borrowedPtr(cert.get());
+  }
+
   auto primaryIdent = cert->getIdentity();
   addCertIdentity(cert, primaryIdent);
 
@@ -142,8 +251,67 @@ void CertManager::addCert(std::shared_ptr<SelfCert> cert, bool defaultCert) {
   }
 
   if (identMap_.find(primaryIdent) == identMap_.end()) {
-    identMap_[primaryIdent] = cert;
+    identMap_[primaryIdent] = std::move(owner);
+  }
+
+  compressCert(*cert);
+}
+
+void CertManager::setCertSelectionCache(size_t capacity) {
+  selectionCache_.clear();
+  if (capacity == 0) {
+    return;
+  }
+  auto shardCapacity =
+      std::max<size_t>(1, (capacity + kSelectionCacheShards - 1) /
+                              kSelectionCacheShards);
+  for (size_t i = 0; i < kSelectionCacheShards; ++i) {
+    selectionCache_.push_back(
+        std::make_unique<SelectionCacheShard>(SelectionCache(shardCapacity)));
+  }
+}
+
+void CertManager::setCertCompressors(
+    std::vector<std::shared_ptr<CertificateCompressor>> compressors) {
+  compressors_ = std::move(compressors);
+  compressedCerts_.clear();
+  for (const auto& schemeMap : certs_) {
+    for (const auto& entry : schemeMap.second) {
+      compressCert(*entry.second);
+    }
+  }
+}
+
+void CertManager::compressCert(const SelfCert& cert) {
+  if (compressors_.empty() ||
+      compressedCerts_.find(&cert) != compressedCerts_.end()) {
+    return;
+  }
+  auto& compressed = compressedCerts_[&cert];
+  for (const auto& compressor : compressors_) {
+    compressed[compressor->getAlgorithm()] =
+        encodeHandshake(compressor->compress(cert.getCertMessage()));
+  }
+}
+
+folly::Optional<Buf> CertManager::getCompressedCert(
+    const SelfCert& cert,
+    const std::vector<CertificateCompressionAlgorithm>& peerAlgos) const {
+  auto it = compressedCerts_.find(&cert);
+  if (it == compressedCerts_.end()) {
+    return folly::none;
+  }
+  for (const auto& compressor : compressors_) {
+    auto algo = compressor->getAlgorithm();
+    if (std::find(peerAlgos.begin(), peerAlgos.end(), algo) !=
+        peerAlgos.end()) {
+      auto compressed = it->second.find(algo);
+      if (compressed != it->second.end()) {
+        return compressed->second->clone();
+      }
+    }
   }
+  return folly::none;
 }
 } // namespace server
 } // namespace fizz
@@ -11,7 +11,12 @@
 #include <map>
 #include <unordered_map>
 
+#include <fizz/protocol/BorrowedPtr.h>
 #include <fizz/protocol/Certificate.h>
+#include <fizz/protocol/CertificateCompressor.h>
+#include <folly/Synchronized.h>
+#include <folly/container/EvictingCacheMap.h>
+#include <folly/futures/Future.h>
 
 namespace fizz {
 namespace server {
@@ -40,9 +45,104 @@ class CertManager {
    */
   virtual std::shared_ptr<SelfCert> getCert(const std::string& identity) const;
 
-  void addCert(std::shared_ptr<SelfCert> cert, bool defaultCert = false);
+  /**
+   * Returns an owning pointer to cert if it was borrowed from this manager
+   * (see setBorrowCerts()), otherwise cert itself.
+   */
+  virtual std::shared_ptr<const Cert> getOwningCert(
+      const std::shared_ptr<const Cert>& cert) const;
+
+  /**
+   * Called before getCert() in the ClientHello path. Implementations that
+   * load certificates on demand can return a future that completes once the
+   * certificate for sni is loaded, so getCert() does not block.
+   */
+  virtual folly::Future<folly::Unit> prefetchCert(
+      const folly::Optional<std::string>& /* sni */) const {
+    return folly::unit;
+  }
+
+  virtual void addCert(
+      std::shared_ptr<SelfCert> cert,
+      bool defaultCert = false);
+
+  /**
+   * Same as calling addCert() for each cert (paired with whether it is the
+   * default), but sizes the index up front and clears the selection cache
+   * only once.
+   */
+  virtual void addCerts(
+      std::vector<std::pair<std::shared_ptr<SelfCert>, bool>> certs);
+
+  /**
+   * Remembers the result of getCert() for up to capacity distinct lookups,
+   * keyed on the SNI and both sig scheme lists. Clients send only a few
+   * distinct sig scheme lists, so most lookups then skip the identity and sig
+   * scheme search. A capacity of 0 (the default) disables the cache.
+   * addCert() clears it.
+   *
+   * The cache is split into shards by key, and hits only take a shard's
+   * read lock, so concurrent handshakes don't serialize on it. Hits don't
+   * refresh an entry, so each shard evicts its oldest entry first.
+   */
+  void setCertSelectionCache(size_t capacity);
+
+  /**
+   * When enabled, certs added afterwards are kept alive by the manager and
+   * handed out by getCert() as borrowed pointers (see borrowedPtr()), so the
+   * per connection copies of the server cert don't contend on its reference
+   * count. Requires the manager to outlive every connection using its certs,
+   * which holds when it's owned by a FizzServerContext that does. Such a
+   * manager can't be installed with ReloadableCertManager::reload(), as
+   * replaced snapshots are freed while connections still use their certs.
+   *
+   * Certs that can outlive the connection are owning: getCert() by identity
+   * returns them, and tickets store the one from getOwningCert(), since
+   * ticket ciphers may keep the ResumptionState they are given.
+   */
+  void setBorrowCerts(bool enabled) {
+    borrowCerts_ = enabled;
+  }
+
+  bool getBorrowCerts() const {
+    return borrowCerts_;
+  }
+
+  /**
+   * Sets the compressors, in preference order, used for certificate
+   * compression. The Certificate message of every cert (including ones added
+   * later) is compressed once up front with each of them.
+   */
+  void setCertCompressors(
+      std::vector<std::shared_ptr<CertificateCompressor>> compressors);
+
+  /**
+   * Returns the encoded CompressedCertificate message for cert using the most
+   * preferred compressor whose algorithm is in peerAlgos, or none if there is
+   * no such compressor.
+   */
+  virtual folly::Optional<Buf> getCompressedCert(
+      const SelfCert& cert,
+      const std::vector<CertificateCompressionAlgorithm>& peerAlgos) const;
+
+ protected:
+  /**
+   * Returns the lookup key for an identity, lowercased and with the * of a
+   * wildcard removed. Throws if ident is not a valid identity.
+   */
+  static std::string getKeyFromIdent(const std::string& ident);
+
+  /**
+   * Returns the wildcard lookup key for a lowercased SNI value.
+   */
+  static folly::Optional<std::string> getWildcardKey(const std::string& key);
 
  private:
+  CertMatch selectCert(
+      const folly::Optional<std::string>& sni,
+      const std::vector<SignatureScheme>& supportedSigSchemes,
+      const std::vector<SignatureScheme>& peerSigSchemes) const;
+
   CertMatch findCert(
       const std::string& key,
       const std::vector<SignatureScheme>& supportedSigSchemes,
@@ -53,10 +153,29 @@ class CertManager {
       std::shared_ptr<SelfCert> cert,
       const std::string& ident);
 
+  void insertCert(std::shared_ptr<SelfCert> cert, bool defaultCert);
+
+  void compressCert(const SelfCert& cert);
+
   using SigSchemeMap = std::map<SignatureScheme, std::shared_ptr<SelfCert>>;
   std::unordered_map<std::string, SigSchemeMap> certs_;
   std::unordered_map<std::string, std::shared_ptr<SelfCert>> identMap_;
   std::string default_;
+  bool borrowCerts_{false};
+  std::unordered_map<const Cert*, std::shared_ptr<SelfCert>> ownedCerts_;
+
+  static constexpr size_t kSelectionCacheShards = 16;
+  using SelectionCache = folly::EvictingCacheMap<std::string, CertMatch>;
+  using SelectionCacheShard = folly::Synchronized<SelectionCache>;
+  SelectionCacheShard& getSelectionCacheShard(const std::string& key) const;
+  void clearSelectionCache();
+  std::vector<std::unique_ptr<SelectionCacheShard>> selectionCache_;
+
+  std::vector<std::shared_ptr<CertificateCompressor>> compressors_;
+  std::unordered_map<
+      const SelfCert*,
+      std::map<CertificateCompressionAlgorithm, Buf>>
+      compressedCerts_;
 };
 } // namespace server
 } // namespace fizz
@@ -0,0 +1,127 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/ClientHelloCapture.h>
+
+namespace fizz {
+namespace server {
+
+namespace {
+
+constexpr uint8_t kCaptureFormat = 1;
+constexpr size_t kHandshakeHeaderSize = sizeof(HandshakeType) + 3;
+
+Buf zeroed(const Buf& buf) {
+  auto length = buf ? buf->computeChainDataLength() : 0;
+  auto out = folly::IOBuf::create(length);
+  memset(out->writableData(), 0, length);
+  out->append(length);
+  return out;
+}
+} // namespace
+
+SampledClientHelloCapture::SampledClientHelloCapture(
+    std::function<bool()> sampler,
+    size_t maxCaptured,
+    bool redact)
+    : sampler_(std::move(sampler)),
+      maxCaptured_(maxCaptured),
+      redact_(redact) {}
+
+void SampledClientHelloCapture::capture(const folly::IOBuf& encodedChlo) {
+  if (sampler_ && !sampler_()) {
+    return;
+  }
+  Buf hello;
+  if (redact_) {
+    try {
+      hello = redactClientHello(encodedChlo);
+    } catch (const std::exception& e) {
+      VLOG(4) << "Not capturing ClientHello: " << e.what();
+      return;
+    }
+  } else {
+    hello = encodedChlo.clone();
+  }
+  auto captured = captured_.wlock();
+  if (captured->size() < maxCaptured_) {
+    captured->push_back(std::move(hello));
+  }
+}
+
+std::vector<Buf> SampledClientHelloCapture::drain() {
+  std::vector<Buf> drained;
+  captured_.wlock()->swap(drained);
+  return drained;
+}
+
+Buf redactClientHello(const folly::IOBuf& encodedChlo) {
+  auto body = encodedChlo.clone();
+  folly::io::Cursor header(body.get());
+  if (!header.canAdvance(kHandshakeHeaderSize) ||
+      header.read<HandshakeType>() != HandshakeType::client_hello) {
+    throw std::runtime_error("not a client hello");
+  }
+  body->coalesce();
+  body->trimStart(kHandshakeHeaderSize);
+  auto chlo = decode<ClientHello>(std::move(body));
+
+  chlo.random.fill(0);
+  chlo.legacy_session_id = zeroed(chlo.legacy_session_id);
+  auto pskIt = findExtension(chlo.extensions, ExtensionType::pre_shared_key);
+  if (pskIt != chlo.extensions.end()) {
+    auto psk = getExtension<ClientPresharedKey>(chlo.extensions);
+    if (!psk) {
+      throw std::runtime_error("malformed pre_shared_key");
+    }
+    for (auto& identity : psk->identities) {
+      identity.psk_identity = zeroed(identity.psk_identity);
+      identity.obfuscated_ticket_age = 0;
+    }
+    for (auto& binder : psk->binders) {
+      binder.binder = zeroed(binder.binder);
+    }
+    auto index = pskIt - chlo.extensions.begin();
+    chlo.extensions[index] = encodeExtension(*psk);
+  }
+  return encodeHandshake(std::move(chlo));
+}
+
+Buf encodeClientHelloCapture(const std::vector<Buf>& hellos) {
+  auto buf = folly::IOBuf::create(0);
+  folly::io::Appender appender(buf.get(), 4096);
+  detail::write(kCaptureFormat, appender);
+  detail::write(static_cast<uint32_t>(hellos.size()), appender);
+  for (const auto& hello : hellos) {
+    detail::writeBuf<uint32_t>(hello, appender);
+  }
+  return buf;
+}
+
+std::vector<Buf> decodeClientHelloCapture(Buf encoded) {
+  folly::io::Cursor cursor(encoded.get());
+  uint8_t format;
+  detail::read(format, cursor);
+  if (format != kCaptureFormat) {
+    throw std::runtime_error("unknown capture format");
+  }
+  uint32_t count;
+  detail::read(count, cursor);
+  std::vector<Buf> hellos;
+  for (uint32_t i = 0; i < count; ++i) {
+    Buf hello;
+    detail::readBuf<uint32_t>(hello, cursor);
+    hellos.push_back(std::move(hello));
+  }
+  if (!cursor.isAtEnd()) {
+    throw std::runtime_error("trailing data after capture");
+  }
+  return hellos;
+}
+} // namespace server
+} // namespace fizz
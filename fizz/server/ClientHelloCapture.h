@@ -0,0 +1,85 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/record/Types.h>
+#include <folly/Synchronized.h>
+
+#include <functional>
+#include <vector>
+
+namespace fizz {
+namespace server {
+
+/**
+ * Receives the encoded ClientHello handshake message of connections, for
+ * replaying the real mix of extensions, key share groups and PSK usage in
+ * benchmarks (see test/ClientHelloReplay.cpp). Set on FizzServerContext,
+ * it is called on the handshake path so must be cheap and thread safe.
+ */
+class ClientHelloCapture {
+ public:
+  virtual ~ClientHelloCapture() = default;
+
+  /**
+   * Called with the first ClientHello of each connection (not the one sent
+   * after a HelloRetryRequest).
+   */
+  virtual void capture(const folly::IOBuf& encodedChlo) = 0;
+};
+
+/**
+ * Keeps a sample of ClientHellos in memory until drained. Hellos are
+ * redacted before they are stored (see redactClientHello()) unless
+ * disabled.
+ */
+class SampledClientHelloCapture : public ClientHelloCapture {
+ public:
+  /**
+   * sampler decides per ClientHello whether it is kept, eg
+   * [] { return folly::Random::oneIn(1000); }. At most maxCaptured hellos
+   * are held at a time, any more are dropped.
+   */
+  SampledClientHelloCapture(
+      std::function<bool()> sampler,
+      size_t maxCaptured,
+      bool redact = true);
+
+  void capture(const folly::IOBuf& encodedChlo) override;
+
+  /**
+   * Returns the hellos captured since the last drain.
+   */
+  std::vector<Buf> drain();
+
+ private:
+  std::function<bool()> sampler_;
+  size_t maxCaptured_;
+  bool redact_;
+  folly::Synchronized<std::vector<Buf>> captured_;
+};
+
+/**
+ * Returns encodedChlo with the client random, legacy session id, and PSK
+ * identities (the tickets) and binders zeroed out. Lengths and everything
+ * else are kept, so it takes the same path through the server, except that
+ * PSKs can't be accepted. Key shares are public values and are kept as is.
+ * Throws if encodedChlo is not a ClientHello.
+ */
+Buf redactClientHello(const folly::IOBuf& encodedChlo);
+
+/**
+ * Serializes captured hellos into a file format read back by
+ * decodeClientHelloCapture(), which throws if it is malformed.
+ */
+Buf encodeClientHelloCapture(const std::vector<Buf>& hellos);
+
+std::vector<Buf> decodeClientHelloCapture(Buf encoded);
+} // namespace server
+} // namespace fizz
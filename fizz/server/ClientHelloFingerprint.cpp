@@ -0,0 +1,97 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/ClientHelloFingerprint.h>
+
+#include <fizz/record/Types.h>
+#include <folly/hash/Hash.h>
+#include <folly/io/Cursor.h>
+
+namespace fizz {
+namespace server {
+
+static bool isGrease(uint16_t value) {
+  return (value & 0x0f0f) == 0x0a0a && (value >> 8) == (value & 0xff);
+}
+
+static uint64_t hashValue(uint64_t hash, uint16_t value) {
+  uint8_t bytes[] = {static_cast<uint8_t>(value >> 8),
+                     static_cast<uint8_t>(value & 0xff)};
+  return folly::hash::fnv64_buf(bytes, sizeof(bytes), hash);
+}
+
+static uint64_t
+hashList(folly::io::Cursor& cursor, size_t length, uint64_t hash) {
+  if (length % sizeof(uint16_t) != 0) {
+    throw std::out_of_range("odd list length");
+  }
+  for (size_t i = 0; i < length; i += sizeof(uint16_t)) {
+    auto value = cursor.readBE<uint16_t>();
+    if (!isGrease(value)) {
+      hash = hashValue(hash, value);
+    }
+  }
+  return hash;
+}
+
+folly::Optional<uint64_t> getClientHelloFingerprint(
+    const folly::IOBuf& encodedChlo) {
+  folly::io::Cursor cursor(&encodedChlo);
+  try {
+    if (static_cast<HandshakeType>(cursor.read<uint8_t>()) !=
+        HandshakeType::client_hello) {
+      return folly::none;
+    }
+    // Handshake message length.
+    cursor.skip(3);
+
+    auto hash = hashValue(folly::hash::FNV_64_HASH_START, 0);
+    hash = hashValue(hash, cursor.readBE<uint16_t>());
+    cursor.skip(sizeof(Random));
+    cursor.skip(cursor.read<uint8_t>());
+    hash = hashList(cursor, cursor.readBE<uint16_t>(), hash);
+    cursor.skip(cursor.read<uint8_t>());
+
+    auto extensionsHash = hashValue(folly::hash::FNV_64_HASH_START, 1);
+    auto groupsHash = hashValue(folly::hash::FNV_64_HASH_START, 2);
+    if (!cursor.isAtEnd()) {
+      auto extensionsLength = cursor.readBE<uint16_t>();
+      size_t consumed = 0;
+      while (consumed < extensionsLength) {
+        auto type = cursor.readBE<uint16_t>();
+        auto length = cursor.readBE<uint16_t>();
+        consumed += 2 * sizeof(uint16_t) + length;
+        if (isGrease(type)) {
+          cursor.skip(length);
+          continue;
+        }
+        extensionsHash = hashValue(extensionsHash, type);
+        if (type == static_cast<uint16_t>(ExtensionType::supported_groups)) {
+          auto groupsLength = cursor.readBE<uint16_t>();
+          if (groupsLength + sizeof(uint16_t) > length) {
+            return folly::none;
+          }
+          groupsHash = hashList(cursor, groupsLength, groupsHash);
+          cursor.skip(length - sizeof(uint16_t) - groupsLength);
+        } else {
+          cursor.skip(length);
+        }
+      }
+      if (consumed != extensionsLength) {
+        return folly::none;
+      }
+    }
+
+    return folly::hash::hash_128_to_64(
+        folly::hash::hash_128_to_64(hash, extensionsHash), groupsHash);
+  } catch (const std::out_of_range&) {
+    return folly::none;
+  }
+}
+} // namespace server
+} // namespace fizz
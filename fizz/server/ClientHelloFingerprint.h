@@ -0,0 +1,28 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/io/IOBuf.h>
+
+namespace fizz {
+namespace server {
+
+/**
+ * Computes a compact fingerprint of an encoded ClientHello handshake message,
+ * in the spirit of JA3. The legacy version, cipher suites, extension types
+ * (in order) and supported groups are hashed in a single pass over the
+ * encoding, without decoding the message. GREASE values are ignored.
+ *
+ * Returns none if the encoding is not a well formed ClientHello.
+ */
+folly::Optional<uint64_t> getClientHelloFingerprint(
+    const folly::IOBuf& encodedChlo);
+} // namespace server
+} // namespace fizz
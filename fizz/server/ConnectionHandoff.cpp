@@ -0,0 +1,217 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/ConnectionHandoff.h>
+
+#include <fizz/crypto/Utils.h>
+#include <fizz/protocol/Protocol.h>
+
+namespace fizz {
+namespace server {
+
+namespace {
+
+constexpr uint8_t kHandoffFormat = 1;
+
+void writeSecret(const std::vector<uint8_t>& secret, folly::io::Appender& out) {
+  auto buf = folly::IOBuf::wrapBuffer(folly::range(secret));
+  detail::writeBuf<uint8_t>(buf, out);
+}
+
+std::vector<uint8_t> readSecret(folly::io::Cursor& cursor) {
+  Buf buf;
+  detail::readBuf<uint8_t>(buf, cursor);
+  auto range = buf->coalesce();
+  return std::vector<uint8_t>(range.begin(), range.end());
+}
+
+void writeString(
+    const folly::Optional<std::string>& str,
+    folly::io::Appender& out) {
+  detail::write(static_cast<uint8_t>(str.hasValue()), out);
+  if (str) {
+    detail::writeBuf<uint16_t>(folly::IOBuf::copyBuffer(*str), out);
+  }
+}
+
+folly::Optional<std::string> readString(folly::io::Cursor& cursor) {
+  uint8_t present;
+  detail::read(present, cursor);
+  if (!present) {
+    return folly::none;
+  }
+  Buf buf;
+  detail::readBuf<uint16_t>(buf, cursor);
+  return buf->moveToFbString().toStdString();
+}
+} // namespace
+
+ConnectionHandoff exportConnection(const State& state) {
+  if (state.state() != StateEnum::AcceptingData) {
+    throw std::runtime_error("connection not established");
+  }
+  auto readRecordLayer =
+      dynamic_cast<const EncryptedReadRecordLayer*>(state.readRecordLayer());
+  auto writeRecordLayer =
+      dynamic_cast<const EncryptedWriteRecordLayer*>(state.writeRecordLayer());
+  if (!readRecordLayer || !writeRecordLayer) {
+    throw std::runtime_error("record layers can't be exported");
+  }
+  if (readRecordLayer->hasUnparsedHandshakeData()) {
+    throw std::runtime_error("unprocessed records buffered");
+  }
+
+  ConnectionHandoff handoff;
+  handoff.version = *state.version();
+  handoff.cipher = *state.cipher();
+  handoff.clientTrafficSecret =
+      state.keyScheduler()->getSecret(AppTrafficSecrets::ClientAppTraffic);
+  handoff.serverTrafficSecret =
+      state.keyScheduler()->getSecret(AppTrafficSecrets::ServerAppTraffic);
+  handoff.readSeqNum = readRecordLayer->getSequenceNumber();
+  handoff.writeSeqNum = writeRecordLayer->getSequenceNumber();
+  handoff.exporterMasterSecret = state.exporterMasterSecret().value()->clone();
+  if (state.resumptionMasterSecret()) {
+    handoff.resumptionMasterSecret = state.resumptionMasterSecret().value();
+  }
+  handoff.pskType = state.pskType().value_or(PskType::NotSupported);
+  handoff.alpn = state.alpn();
+  handoff.sni = state.sni();
+  return handoff;
+}
+
+Buf encodeConnectionHandoff(const ConnectionHandoff& handoff) {
+  auto buf = folly::IOBuf::create(256);
+  folly::io::Appender appender(buf.get(), 256);
+  detail::write(kHandoffFormat, appender);
+  detail::write(handoff.version, appender);
+  detail::write(handoff.cipher, appender);
+  writeSecret(handoff.clientTrafficSecret, appender);
+  writeSecret(handoff.serverTrafficSecret, appender);
+  detail::write(handoff.readSeqNum, appender);
+  detail::write(handoff.writeSeqNum, appender);
+  detail::writeBuf<uint8_t>(handoff.exporterMasterSecret, appender);
+  detail::write(
+      static_cast<uint8_t>(handoff.resumptionMasterSecret.hasValue()),
+      appender);
+  if (handoff.resumptionMasterSecret) {
+    writeSecret(*handoff.resumptionMasterSecret, appender);
+  }
+  detail::write(static_cast<uint8_t>(handoff.pskType), appender);
+  writeString(handoff.alpn, appender);
+  writeString(handoff.sni, appender);
+  detail::writeBuf<uint32_t>(handoff.pendingData, appender);
+  return buf;
+}
+
+ConnectionHandoff decodeConnectionHandoff(Buf encoded) {
+  folly::io::Cursor cursor(encoded.get());
+  uint8_t format;
+  detail::read(format, cursor);
+  if (format != kHandoffFormat) {
+    throw std::runtime_error("unknown handoff format");
+  }
+
+  ConnectionHandoff handoff;
+  detail::read(handoff.version, cursor);
+  detail::read(handoff.cipher, cursor);
+  handoff.clientTrafficSecret = readSecret(cursor);
+  handoff.serverTrafficSecret = readSecret(cursor);
+  detail::read(handoff.readSeqNum, cursor);
+  detail::read(handoff.writeSeqNum, cursor);
+  detail::readBuf<uint8_t>(handoff.exporterMasterSecret, cursor);
+  uint8_t hasResumptionMasterSecret;
+  detail::read(hasResumptionMasterSecret, cursor);
+  if (hasResumptionMasterSecret) {
+    handoff.resumptionMasterSecret = readSecret(cursor);
+  }
+  uint8_t pskType;
+  detail::read(pskType, cursor);
+  if (pskType > static_cast<uint8_t>(PskType::Resumption)) {
+    throw std::runtime_error("invalid psk type");
+  }
+  handoff.pskType = static_cast<PskType>(pskType);
+  handoff.alpn = readString(cursor);
+  handoff.sni = readString(cursor);
+  detail::readBuf<uint32_t>(handoff.pendingData, cursor);
+  if (!cursor.isAtEnd()) {
+    throw std::runtime_error("trailing data after handoff");
+  }
+  return handoff;
+}
+
+Actions importConnection(
+    folly::Executor* executor,
+    std::shared_ptr<const FizzServerContext> context,
+    std::shared_ptr<ServerExtensions> extensions,
+    ConnectionHandoff handoff) {
+  auto factory = context->getFactory();
+  auto scheduler = factory->makeKeyScheduler(handoff.cipher);
+  scheduler->setAppTrafficSecrets(
+      folly::range(handoff.clientTrafficSecret),
+      folly::range(handoff.serverTrafficSecret));
+
+  auto readRecordLayer =
+      factory->makeEncryptedReadRecordLayer(EncryptionLevel::AppTraffic);
+  readRecordLayer->setProtocolVersion(handoff.version);
+  readRecordLayer->setCoalesceAppData(context->getCoalesceAppData());
+  readRecordLayer->setParallelDecryption(context->getParallelDecryption());
+  Protocol::setAead(
+      *readRecordLayer,
+      handoff.cipher,
+      folly::range(handoff.clientTrafficSecret),
+      *factory,
+      *scheduler);
+  readRecordLayer->setSequenceNumber(handoff.readSeqNum);
+
+  auto writeRecordLayer =
+      factory->makeEncryptedWriteRecordLayer(EncryptionLevel::AppTraffic);
+  writeRecordLayer->setProtocolVersion(handoff.version);
+  writeRecordLayer->setParallelEncryption(context->getParallelEncryption());
+  writeRecordLayer->setKeyUpdateLimits(context->getKeyUpdateLimits());
+  Protocol::setAead(
+      *writeRecordLayer,
+      handoff.cipher,
+      folly::range(handoff.serverTrafficSecret),
+      *factory,
+      *scheduler);
+  writeRecordLayer->setSequenceNumber(handoff.writeSeqNum);
+
+  CryptoUtils::clean(folly::range(handoff.clientTrafficSecret));
+  CryptoUtils::clean(folly::range(handoff.serverTrafficSecret));
+
+  return detail::actions(
+      [executor,
+       context = std::move(context),
+       extensions = std::move(extensions),
+       scheduler = std::move(scheduler),
+       rrl = std::move(readRecordLayer),
+       wrl = std::move(writeRecordLayer),
+       handoff = std::move(handoff)](State& newState) mutable {
+        newState.executor() = executor;
+        newState.context() = std::move(context);
+        newState.extensions() = std::move(extensions);
+        newState.keyScheduler() = std::move(scheduler);
+        newState.readRecordLayer() = std::move(rrl);
+        newState.writeRecordLayer() = std::move(wrl);
+        newState.version() = handoff.version;
+        newState.cipher() = handoff.cipher;
+        newState.pskType() = handoff.pskType;
+        newState.alpn() = std::move(handoff.alpn);
+        newState.sni() = std::move(handoff.sni);
+        newState.exporterMasterSecret() =
+            std::move(handoff.exporterMasterSecret);
+        if (handoff.resumptionMasterSecret) {
+          newState.resumptionMasterSecret() =
+              std::move(*handoff.resumptionMasterSecret);
+        }
+        newState.state() = StateEnum::AcceptingData;
+      });
+}
+} // namespace server
+} // namespace fizz
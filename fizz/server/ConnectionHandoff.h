@@ -0,0 +1,71 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/Actions.h>
+#include <fizz/server/State.h>
+
+namespace fizz {
+namespace server {
+
+/**
+ * Everything needed to continue an established connection in another
+ * process, eg to keep connections open across a restart. Together with the
+ * socket (passed over a Unix socket with SCM_RIGHTS) it lets the new process
+ * pick up in AcceptingData without another handshake.
+ *
+ * It holds the traffic secrets of the connection in the clear, so it must
+ * only ever be sent over a channel private to the two processes.
+ */
+struct ConnectionHandoff {
+  ProtocolVersion version;
+  CipherSuite cipher;
+  std::vector<uint8_t> clientTrafficSecret;
+  std::vector<uint8_t> serverTrafficSecret;
+  uint64_t readSeqNum{0};
+  uint64_t writeSeqNum{0};
+  Buf exporterMasterSecret;
+  folly::Optional<std::vector<uint8_t>> resumptionMasterSecret;
+  PskType pskType{PskType::NotAttempted};
+  folly::Optional<std::string> alpn;
+  folly::Optional<std::string> sni;
+
+  // Bytes read from the socket but not yet processed.
+  Buf pendingData;
+};
+
+/**
+ * Captures the state of a connection in AcceptingData. Throws if the
+ * connection can't be handed off, eg because it uses record layers that
+ * don't expose their protection state. The connection must not be used once
+ * it has been exported, and any app data written to it should have been
+ * flushed to the socket first.
+ */
+ConnectionHandoff exportConnection(const State& state);
+
+Buf encodeConnectionHandoff(const ConnectionHandoff& handoff);
+
+/**
+ * Throws if encoded is malformed.
+ */
+ConnectionHandoff decodeConnectionHandoff(Buf encoded);
+
+/**
+ * Actions that move an Uninitialized state to AcceptingData from a handed off
+ * connection. The record layers and key schedule are rebuilt with the
+ * factory of context. pendingData is ignored, it is up to the caller to
+ * process it.
+ */
+Actions importConnection(
+    folly::Executor* executor,
+    std::shared_ptr<const FizzServerContext> context,
+    std::shared_ptr<ServerExtensions> extensions,
+    ConnectionHandoff handoff);
+} // namespace server
+} // namespace fizz
@@ -19,12 +19,14 @@ Buf getStatelessHelloRetryRequest(
     ProtocolVersion version,
     CipherSuite cipher,
     folly::Optional<NamedGroup> group,
-    Buf cookie) {
+    Buf cookie,
+    const Buf& legacySessionId) {
   Buf encodedHelloRetryRequest;
 
   HelloRetryRequest hrr;
   hrr.legacy_version = ProtocolVersion::tls_1_2;
-  hrr.legacy_session_id_echo = folly::IOBuf::create(0);
+  hrr.legacy_session_id_echo =
+      legacySessionId ? legacySessionId->clone() : folly::IOBuf::create(0);
   hrr.cipher_suite = cipher;
 
   ServerSupportedVersions versionExt;
@@ -25,27 +25,37 @@ struct CookieState {
 };
 
 /**
- * Interface for decrypting prior state information from a cookie. These are
- * never sent through the state machine (they are only useful for applications
- * that require a stateless reset), hence the lack of an encrypt method.
+ * Interface for decrypting prior state information from a cookie. Cookies are
+ * usually created outside of the state machine by applications that require a
+ * stateless reset. The state machine only creates them itself when a
+ * HandshakeAdmissionController requires a stateless retry, which needs
+ * encrypt() to be implemented.
  */
 class CookieCipher {
  public:
   virtual ~CookieCipher() = default;
 
   virtual folly::Optional<CookieState> decrypt(Buf) const = 0;
+
+  /**
+   * Encrypts state into a cookie. Returns none if not supported.
+   */
+  virtual folly::Optional<Buf> encrypt(const CookieState& /*state*/) const {
+    return folly::none;
+  }
 };
 
 /**
  * Build a stateless HelloRetryRequest. This is deterministic and will be used
  * to reconstruct the handshake transcript when receiving the second
- * ClientHello.
+ * ClientHello, which carries the same legacySessionId as the first.
  */
 Buf getStatelessHelloRetryRequest(
     ProtocolVersion version,
     CipherSuite cipher,
     folly::Optional<NamedGroup> group,
-    Buf cookie);
+    Buf cookie,
+    const Buf& legacySessionId = nullptr);
 
 /**
  * Negotiate and compute the CookieState to use in response to a ClientHello.
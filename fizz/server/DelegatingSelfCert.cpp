@@ -0,0 +1,91 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/DelegatingSelfCert.h>
+
+#include <algorithm>
+
+namespace fizz {
+
+DelegatingSelfCert::DelegatingSelfCert(std::shared_ptr<const SelfCert> cert)
+    : cert_(std::move(cert)) {}
+
+std::string DelegatingSelfCert::getIdentity() const {
+  return cert_->getIdentity();
+}
+
+std::vector<std::string> DelegatingSelfCert::getAltIdentities() const {
+  return cert_->getAltIdentities();
+}
+
+std::vector<SignatureScheme> DelegatingSelfCert::getSigSchemes() const {
+  return cert_->getSigSchemes();
+}
+
+CertificateMsg DelegatingSelfCert::getCertMessage(
+    Buf certificateRequestContext) const {
+  return cert_->getCertMessage(std::move(certificateRequestContext));
+}
+
+CertificateType DelegatingSelfCert::getCertificateType() const {
+  return cert_->getCertificateType();
+}
+
+Buf DelegatingSelfCert::getEncodedCertMessage() const {
+  return cert_->getEncodedCertMessage();
+}
+
+Buf DelegatingSelfCert::getStapledCertMessage(
+    const std::vector<ExtensionType>& requestedExtensions) const {
+  return cert_->getStapledCertMessage(requestedExtensions);
+}
+
+std::shared_ptr<const SelfCert> DelegatingSelfCert::getDelegatedCert(
+    const std::vector<SignatureScheme>& peerCredentialSchemes,
+    const std::vector<SignatureScheme>& peerSigSchemes) const {
+  auto delegated = delegated_.load();
+  if (!delegated || now() >= delegated->getExpiry()) {
+    return nullptr;
+  }
+  const auto& credential = delegated->getDelegatedCredential();
+  if (std::find(
+          peerCredentialSchemes.begin(),
+          peerCredentialSchemes.end(),
+          credential.expected_verify_scheme) == peerCredentialSchemes.end() ||
+      std::find(
+          peerSigSchemes.begin(),
+          peerSigSchemes.end(),
+          credential.credential_scheme) == peerSigSchemes.end()) {
+    return nullptr;
+  }
+  return delegated;
+}
+
+Buf DelegatingSelfCert::sign(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    folly::ByteRange toBeSigned) const {
+  return cert_->sign(scheme, context, toBeSigned);
+}
+
+std::vector<Buf> DelegatingSelfCert::signBatch(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    const std::vector<folly::ByteRange>& toBeSigned) const {
+  return cert_->signBatch(scheme, context, toBeSigned);
+}
+
+folly::ssl::X509UniquePtr DelegatingSelfCert::getX509() const {
+  return cert_->getX509();
+}
+
+void DelegatingSelfCert::setDelegatedCert(
+    std::shared_ptr<const DelegatedSelfCert> delegated) {
+  delegated_.store(std::move(delegated));
+}
+} // namespace fizz
@@ -0,0 +1,77 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/DelegatedCredential.h>
+#include <folly/concurrency/AtomicSharedPtr.h>
+
+namespace fizz {
+
+/**
+ * SelfCert that offers a delegated credential of the certificate it wraps
+ * to clients that support it. The credential is used if the client accepts
+ * both its expected_verify_scheme and credential_scheme, and it has not
+ * expired. Other clients get the wrapped certificate.
+ *
+ * Credentials are short lived, setDelegatedCert() replaces the current one
+ * atomically and may be called while handshakes are in progress.
+ */
+class DelegatingSelfCert : public SelfCert {
+ public:
+  explicit DelegatingSelfCert(std::shared_ptr<const SelfCert> cert);
+
+  ~DelegatingSelfCert() override = default;
+
+  std::string getIdentity() const override;
+
+  std::vector<std::string> getAltIdentities() const override;
+
+  std::vector<SignatureScheme> getSigSchemes() const override;
+
+  CertificateMsg getCertMessage(
+      Buf certificateRequestContext = nullptr) const override;
+
+  CertificateType getCertificateType() const override;
+
+  Buf getEncodedCertMessage() const override;
+
+  Buf getStapledCertMessage(
+      const std::vector<ExtensionType>& requestedExtensions) const override;
+
+  std::shared_ptr<const SelfCert> getDelegatedCert(
+      const std::vector<SignatureScheme>& peerCredentialSchemes,
+      const std::vector<SignatureScheme>& peerSigSchemes) const override;
+
+  Buf sign(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      folly::ByteRange toBeSigned) const override;
+
+  std::vector<Buf> signBatch(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      const std::vector<folly::ByteRange>& toBeSigned) const override;
+
+  folly::ssl::X509UniquePtr getX509() const override;
+
+  /**
+   * Sets the credential to offer, or stops offering one if nullptr.
+   */
+  void setDelegatedCert(std::shared_ptr<const DelegatedSelfCert> delegated);
+
+ protected:
+  virtual std::chrono::system_clock::time_point now() const {
+    return std::chrono::system_clock::now();
+  }
+
+ private:
+  std::shared_ptr<const SelfCert> cert_;
+  folly::atomic_shared_ptr<const DelegatedSelfCert> delegated_;
+};
+} // namespace fizz
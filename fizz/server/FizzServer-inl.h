@@ -19,6 +19,19 @@ void FizzServer<ActionMoveVisitor, SM>::accept(
       this->state_, executor, std::move(context), std::move(extensions)));
 }
 
+template <typename ActionMoveVisitor, typename SM>
+void FizzServer<ActionMoveVisitor, SM>::acceptHandoff(
+    folly::Executor* executor,
+    std::shared_ptr<const FizzServerContext> context,
+    std::shared_ptr<ServerExtensions> extensions,
+    ConnectionHandoff handoff) {
+  this->addProcessingActions(importConnection(
+      executor,
+      std::move(context),
+      std::move(extensions),
+      std::move(handoff)));
+}
+
 template <typename ActionMoveVisitor, typename SM>
 void FizzServer<ActionMoveVisitor, SM>::newTransportData() {
   // If the first data we receive looks like an SSLv2 Client Hello we trigger
@@ -42,6 +55,17 @@ void FizzServer<ActionMoveVisitor, SM>::newTransportData() {
       newTransportData();
 }
 
+template <typename ActionMoveVisitor, typename SM>
+void FizzServer<ActionMoveVisitor, SM>::moveToErrorState(
+    const folly::AsyncSocketException& ex) {
+  FizzBase<FizzServer<ActionMoveVisitor, SM>, ActionMoveVisitor, SM>::
+      moveToErrorState(ex);
+  if (pendingActions_) {
+    pendingActions_->cancel();
+    pendingActions_.clear();
+  }
+}
+
 template <typename ActionMoveVisitor, typename SM>
 Buf FizzServer<ActionMoveVisitor, SM>::getEarlyEkm(
     folly::StringPiece label,
@@ -51,6 +75,7 @@ Buf FizzServer<ActionMoveVisitor, SM>::getEarlyEkm(
     throw std::runtime_error("early ekm not available");
   }
   return Exporter::getEkm(
+      *this->state_.context()->getFactory(),
       *this->state_.cipher(),
       (*this->state_.earlyExporterMasterSecret())->coalesce(),
       label,
@@ -63,13 +88,16 @@ void FizzServer<ActionMoveVisitor, SM>::startActions(AsyncActions actions) {
   folly::variant_match(
       actions,
       [this](folly::Future<Actions>& futureActions) {
-        std::move(futureActions)
-            .then(
-                &FizzServer::processActions,
-                static_cast<FizzBase<
-                    FizzServer<ActionMoveVisitor, SM>,
-                    ActionMoveVisitor,
-                    SM>*>(this));
+        auto processed = std::move(futureActions)
+                             .then(
+                                 &FizzServer::processActions,
+                                 static_cast<FizzBase<
+                                     FizzServer<ActionMoveVisitor, SM>,
+                                     ActionMoveVisitor,
+                                     SM>*>(this));
+        if (!processed.isReady()) {
+          pendingActions_ = std::move(processed);
+        }
       },
       [this](Actions& immediateActions) {
         this->processActions(std::move(immediateActions));
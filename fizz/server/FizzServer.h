@@ -9,6 +9,7 @@
 #pragma once
 
 #include <fizz/protocol/FizzBase.h>
+#include <fizz/server/ConnectionHandoff.h>
 #include <fizz/server/FizzServerContext.h>
 #include <fizz/server/ServerProtocol.h>
 
@@ -31,8 +32,23 @@ class FizzServer : public FizzBase<
       std::shared_ptr<const FizzServerContext> context,
       std::shared_ptr<ServerExtensions> extensions = nullptr);
 
+  /**
+   * Instead of accept(), continue a connection handed off by another process.
+   */
+  void acceptHandoff(
+      folly::Executor* executor,
+      std::shared_ptr<const FizzServerContext> context,
+      std::shared_ptr<ServerExtensions> extensions,
+      ConnectionHandoff handoff);
+
   void newTransportData();
 
+  /**
+   * As FizzBase::moveToErrorState(), and cancels the actions in progress, so
+   * that signing they still have queued in a HandshakeScheduler is dropped.
+   */
+  void moveToErrorState(const folly::AsyncSocketException& ex);
+
   /**
    * Returns an exported key material derived from the early secret of the TLS
    * connection. Throws if the early secret is not available.
@@ -49,6 +65,9 @@ class FizzServer : public FizzBase<
   void startActions(AsyncActions actions);
 
   bool checkV2Hello_{false};
+
+  // The actions in progress, if they didn't complete immediately.
+  folly::Optional<folly::Future<folly::Unit>> pendingActions_;
 };
 } // namespace server
 } // namespace fizz
@@ -10,12 +10,23 @@
 
 #include <fizz/protocol/Certificate.h>
 #include <fizz/protocol/Factory.h>
+#include <fizz/protocol/HandshakeTracer.h>
+#include <fizz/protocol/LazyPeerCert.h>
+#include <fizz/record/EncryptedRecordLayer.h>
 #include <fizz/record/Types.h>
 #include <fizz/server/CertManager.h>
+#include <fizz/server/ClientHelloCapture.h>
 #include <fizz/server/CookieCipher.h>
+#include <fizz/server/HandshakeAdmissionController.h>
+#include <fizz/server/HandshakeScheduler.h>
 #include <fizz/server/Negotiator.h>
 #include <fizz/server/ReplayCache.h>
+#include <fizz/server/SingleUseTicketReplayCache.h>
 #include <fizz/server/TicketCipher.h>
+#include <folly/Executor.h>
+
+#include <algorithm>
+#include <functional>
 
 namespace fizz {
 namespace server {
@@ -42,11 +53,26 @@ struct ClockSkewTolerance {
  */
 enum class ClientAuthMode { None, Optional, Required };
 
+/**
+ * How much of the ClientHello is recorded in HandshakeLogging. Full records
+ * all of the decoded fields, Fingerprint only records
+ * HandshakeLogging::clientFingerprint (see getClientHelloFingerprint()).
+ */
+enum class HandshakeLoggingMode { Full, Fingerprint };
+
 class FizzServerContext {
  public:
-  FizzServerContext() : factory_(std::make_unique<Factory>()) {}
+  FizzServerContext() : factory_(std::make_shared<Factory>()) {}
   virtual ~FizzServerContext() = default;
 
+  /**
+   * Copies the configuration. Components held by pointer (the factory, cert
+   * manager, ticket cipher, ...) are shared with the copy rather than
+   * duplicated, see FizzServerContextPublisher.
+   */
+  FizzServerContext(const FizzServerContext&) = default;
+  FizzServerContext& operator=(const FizzServerContext&) = delete;
+
   /**
    * Set the supported protocol versions, in preference order.
    */
@@ -62,30 +88,43 @@ class FizzServerContext {
    */
   void setSupportedCiphers(std::vector<std::vector<CipherSuite>> ciphers) {
     supportedCiphers_ = std::move(ciphers);
+    cipherPreferences_ = PreferenceTable<CipherSuite>(supportedCiphers_);
   }
   const auto& getSupportedCiphers() const {
     return supportedCiphers_;
   }
+  const PreferenceTable<CipherSuite>& getCipherPreferences() const {
+    return cipherPreferences_;
+  }
 
   /**
    * Set the supported signature schemes, in preference order.
    */
   void setSupportedSigSchemes(std::vector<SignatureScheme> schemes) {
     supportedSigSchemes_ = std::move(schemes);
+    sigSchemePreferences_ =
+        PreferenceTable<SignatureScheme>(supportedSigSchemes_);
   }
   const auto& getSupportedSigSchemes() const {
     return supportedSigSchemes_;
   }
+  const PreferenceTable<SignatureScheme>& getSigSchemePreferences() const {
+    return sigSchemePreferences_;
+  }
 
   /**
    * Set the supported named groups, in preference order.
    */
   void setSupportedGroups(std::vector<NamedGroup> groups) {
     supportedGroups_ = std::move(groups);
+    groupPreferences_ = PreferenceTable<NamedGroup>(supportedGroups_);
   }
   const auto& getSupportedGroups() const {
     return supportedGroups_;
   }
+  const PreferenceTable<NamedGroup>& getGroupPreferences() const {
+    return groupPreferences_;
+  }
 
   /**
    * Set the supported psk modes, in preference order.
@@ -97,6 +136,36 @@ class FizzServerContext {
     return supportedPskModes_;
   }
 
+  /**
+   * Sets a policy for resuming trusted clients without a key exchange. When
+   * the client offers psk_ke and psk_ke is supported, a resumption whose
+   * decrypted state passes the policy uses psk_ke even if psk_dhe_ke is
+   * preferred, provided the ticket was issued within maxTicketAge. The age
+   * bound limits how much traffic lacks forward secrecy from the ticket key.
+   */
+  void setPskKeResumptionPolicy(
+      std::function<bool(const ResumptionState&)> policy,
+      std::chrono::seconds maxTicketAge) {
+    pskKeResumptionPolicy_ = std::move(policy);
+    pskKeMaxTicketAge_ = maxTicketAge;
+  }
+
+  bool hasPskKeResumptionPolicy() const {
+    return static_cast<bool>(pskKeResumptionPolicy_);
+  }
+
+  /**
+   * Returns whether a resumption with this state should skip the key
+   * exchange under the policy set with setPskKeResumptionPolicy().
+   */
+  bool shouldResumeWithPskKe(const ResumptionState& resState) const {
+    if (!pskKeResumptionPolicy_) {
+      return false;
+    }
+    auto age = factory_->now() - resState.ticketIssueTime;
+    return age <= pskKeMaxTicketAge_ && pskKeResumptionPolicy_(resState);
+  }
+
   /**
    * Set whether to request client authentication.
    */
@@ -120,6 +189,44 @@ class FizzServerContext {
     return versionFallbackEnabled_;
   }
 
+  /**
+   * Sets limits on the number of cipher suites, extensions, key shares and
+   * PSK identities in ClientHellos. ClientHellos over them are rejected before
+   * they are decoded. Unlimited by default.
+   */
+  void setClientHelloLimits(folly::Optional<ClientHelloLimits> limits) {
+    clientHelloLimits_ = std::move(limits);
+  }
+  const folly::Optional<ClientHelloLimits>& getClientHelloLimits() const {
+    return clientHelloLimits_;
+  }
+
+  /**
+   * Sets a router that is called with each ClientHello as soon as it is
+   * parsed, before any key exchange or signing (for example to pick a backend
+   * from the SNI and ALPN). If it returns true the handshake stops and the
+   * connection is handed off to the handshake callback's fizzHandshakeRoute.
+   */
+  void setClientHelloRouter(std::function<bool(const ClientHello&)> router) {
+    clientHelloRouter_ = std::move(router);
+  }
+
+  bool shouldRouteClientHello(const ClientHello& chlo) const {
+    return clientHelloRouter_ && clientHelloRouter_(chlo);
+  }
+
+  /**
+   * Sets a capture that is handed the first ClientHello of every connection
+   * (see ClientHelloCapture.h). Unset by default.
+   */
+  void setClientHelloCapture(std::shared_ptr<ClientHelloCapture> capture) {
+    clientHelloCapture_ = std::move(capture);
+  }
+
+  ClientHelloCapture* getClientHelloCapture() const {
+    return clientHelloCapture_.get();
+  }
+
   /**
    * Sets the supported ALPN supported protocols, in preference order.
    */
@@ -165,10 +272,78 @@ class FizzServerContext {
     return cookieCipher_.get();
   }
 
+  /**
+   * Sets the admission controller to use. When it requires a retry, new
+   * ClientHellos without a cookie are answered with a stateless
+   * HelloRetryRequest, so that no key exchange or signing is done until the
+   * client proves reachability. Requires a cookie cipher that implements
+   * CookieCipher::encrypt(). Disabled if not set.
+   */
+  void setHandshakeAdmissionController(
+      std::shared_ptr<HandshakeAdmissionController> controller) {
+    handshakeAdmissionController_ = std::move(controller);
+  }
+  const HandshakeAdmissionController* getHandshakeAdmissionController() const {
+    return handshakeAdmissionController_.get();
+  }
+
+  /**
+   * Sets the scheduler that full handshakes queue their CertificateVerify
+   * signing on. If not set, signing starts as soon as the ClientHello is
+   * processed.
+   */
+  void setHandshakeScheduler(std::shared_ptr<HandshakeScheduler> scheduler) {
+    handshakeScheduler_ = std::move(scheduler);
+  }
+  const HandshakeScheduler* getHandshakeScheduler() const {
+    return handshakeScheduler_.get();
+  }
+
+  /**
+   * Sets an executor for the CPU bound steps of full handshakes: the key
+   * exchange and, unless a HandshakeScheduler is set, CertificateVerify
+   * signing. Their results are handed back to the connection's executor. If
+   * not set these steps run inline.
+   *
+   * The key exchange uses the synchronous KeyExchange::generateSharedSecret()
+   * on this executor.
+   */
+  void setHandshakeExecutor(std::shared_ptr<folly::Executor> executor) {
+    handshakeExecutor_ = std::move(executor);
+  }
+  folly::Executor* getHandshakeExecutor() const {
+    return handshakeExecutor_.get();
+  }
+
+  /**
+   * Sets whether X25519 shared secrets are computed together with those of
+   * the other handshakes on the connection's EventBase, with an
+   * X25519Batcher, instead of one at a time. Only applies to connections
+   * running on an EventBase when no handshake executor is set. Worth it on
+   * CPUs with AVX-512 IFMA under enough handshake load to fill batches.
+   */
+  void setBatchX25519(bool enabled) {
+    batchX25519_ = enabled;
+  }
+  bool getBatchX25519() const {
+    return batchX25519_;
+  }
+
+  /**
+   * Sets the tracer that receives timestamped state transitions and
+   * asynchronous step events of handshakes using this context.
+   */
+  void setHandshakeTracer(std::shared_ptr<HandshakeTracer> tracer) {
+    handshakeTracer_ = std::move(tracer);
+  }
+  const std::shared_ptr<HandshakeTracer>& getHandshakeTracer() const {
+    return handshakeTracer_;
+  }
+
   /**
    * Sets the CertManager to use.
    */
-  void setCertManager(std::unique_ptr<CertManager> manager) {
+  void setCertManager(std::shared_ptr<CertManager> manager) {
     certManager_ = std::move(manager);
   }
 
@@ -195,6 +370,15 @@ class FizzServerContext {
     return certManager_->getCert(sni, supportedSigSchemes_, peerSigSchemes);
   }
 
+  /**
+   * Returns a future that completes when the certificate for sni is ready to
+   * be chosen by getCert() (see CertManager::prefetchCert()).
+   */
+  folly::Future<folly::Unit> prefetchCert(
+      const folly::Optional<std::string>& sni) const {
+    return certManager_->prefetchCert(sni);
+  }
+
   /**
    * Return a certificate that matches identity. Will return nullptr if a
    * matching certificate is not found.
@@ -203,6 +387,25 @@ class FizzServerContext {
     return certManager_->getCert(identity);
   }
 
+  /**
+   * See CertManager::getOwningCert().
+   */
+  std::shared_ptr<const Cert> getOwningCert(
+      const std::shared_ptr<const Cert>& cert) const {
+    return certManager_->getOwningCert(cert);
+  }
+
+  /**
+   * Returns the encoded CompressedCertificate message for cert if it was
+   * compressed with one of peerAlgos (see
+   * CertManager::setCertCompressors()).
+   */
+  folly::Optional<Buf> getCompressedCert(
+      const SelfCert& cert,
+      const std::vector<CertificateCompressionAlgorithm>& peerAlgos) const {
+    return certManager_->getCompressedCert(cert, peerAlgos);
+  }
+
   /**
    * Sets the early data settings.
    */
@@ -233,6 +436,20 @@ class FizzServerContext {
     return replayCache_.get();
   }
 
+  /**
+   * Issues every ticket with an id from singleUseTickets, and only accepts
+   * early data the first time a ticket's id is seen. This is checked in
+   * addition to the replay cache set with setEarlyDataSettings, which may
+   * then be null.
+   */
+  void setSingleUseTickets(
+      std::shared_ptr<SingleUseTicketReplayCache> singleUseTickets) {
+    singleUseTickets_ = std::move(singleUseTickets);
+  }
+  SingleUseTicketReplayCache* getSingleUseTickets() const {
+    return singleUseTickets_.get();
+  }
+
   void setEarlyDataFbOnly(bool fbOnly) {
     earlyDataFbOnly_ = fbOnly;
   }
@@ -240,7 +457,7 @@ class FizzServerContext {
   /**
    * Sets the max_early_data_size to advertise when sending early data
    * compatible tickets. This limit is currently not enforced when accepting
-   * early data.
+   * early data, but at most this much rejected early data is skipped.
    */
   void setMaxEarlyDataSize(uint32_t maxEarlyDataSize) {
     maxEarlyDataSize_ = maxEarlyDataSize;
@@ -249,10 +466,54 @@ class FizzServerContext {
     return maxEarlyDataSize_;
   }
 
+  /**
+   * When early data is rejected and no client certificate is requested, the
+   * client's next record is its Finished. With this set, rejected early data
+   * records too long to be an unpadded Finished are skipped without trial
+   * decryption. Clients that pad their Finished records can then not
+   * complete handshakes that reject early data.
+   */
+  void setFastSkipRejectedEarlyData(bool fastSkip) {
+    fastSkipRejectedEarlyData_ = fastSkip;
+  }
+  bool getFastSkipRejectedEarlyData() const {
+    return fastSkipRejectedEarlyData_;
+  }
+
+  /**
+   * Sets the most handshake bytes placed in the first encrypted record of the
+   * server flight. Some middleboxes break if that record does not fit in the
+   * first packet, so by default the flight is split after 1000 bytes. A limit
+   * of 0 packs the whole flight into as few records as the record layer
+   * allows.
+   */
+  void setFirstEncryptedRecordLimit(size_t limit) {
+    firstEncryptedRecordLimit_ = limit;
+  }
+  size_t getFirstEncryptedRecordLimit() const {
+    return firstEncryptedRecordLimit_;
+  }
+
+  /**
+   * Sets whether accepted early data is reported as replayable. When enabled,
+   * AsyncFizzServer::isReplaySafe() is false for a connection that accepted
+   * early data until the client's Finished is received, and the replay safety
+   * callback is called then. The app can start on idempotent early data as
+   * soon as fizzHandshakeSuccess() is called and hold back the rest. When
+   * disabled (the default) the replay cache is relied on and the server is
+   * always replay safe.
+   */
+  void setEarlyDataReplaySafetyReporting(bool enabled) {
+    earlyDataReplaySafetyReporting_ = enabled;
+  }
+  bool getEarlyDataReplaySafetyReporting() const {
+    return earlyDataReplaySafetyReporting_;
+  }
+
   /**
    * Set the factory to use. Should generally only be changed for testing.
    */
-  void setFactory(std::unique_ptr<Factory> factory) {
+  void setFactory(std::shared_ptr<Factory> factory) {
     factory_ = std::move(factory);
   }
   const Factory* getFactory() const {
@@ -273,13 +534,148 @@ class FizzServerContext {
     return sendNewSessionTicket_;
   }
 
+  /**
+   * Sets how many NewSessionTickets are issued at a time, for clients that
+   * open parallel connections. They are written in one flight, each with its
+   * own nonce and resumption secret. Combine with the ticket cipher's
+   * setMaxTicketsPerSalt() so they share one AEAD key. Default is 1.
+   */
+  void setNumNewSessionTickets(uint8_t numNewSessionTickets) {
+    numNewSessionTickets_ = std::max<uint8_t>(numNewSessionTickets, 1);
+  }
+  uint8_t getNumNewSessionTickets() const {
+    return numNewSessionTickets_;
+  }
+
+  /**
+   * If this and sendNewSessionTicket are true, AsyncFizzServer sends the
+   * NewSessionTicket behind the application's first write instead of before
+   * reporting handshake success, so that generating it does not hold up the
+   * first response. No ticket is sent if the application never writes.
+   * Default is false.
+   */
+  void setDeferNewSessionTicket(bool deferNewSessionTicket) {
+    deferNewSessionTicket_ = deferNewSessionTicket;
+  }
+  bool getDeferNewSessionTicket() const {
+    return deferNewSessionTicket_;
+  }
+
+  /**
+   * Sets whether to decrypt all complete application data records available
+   * on the socket in one pass and deliver them to the app together, instead
+   * of delivering (and dispatching actions for) one record at a time.
+   */
+  void setCoalesceAppData(bool enabled) {
+    coalesceAppData_ = enabled;
+  }
+
+  bool getCoalesceAppData() const {
+    return coalesceAppData_;
+  }
+
+  /**
+   * Sets options for encrypting large application data writes on a thread
+   * pool. Disabled unless an executor is set.
+   */
+  void setParallelEncryption(ParallelEncryptionOptions options) {
+    parallelEncryption_ = std::move(options);
+  }
+
+  const ParallelEncryptionOptions& getParallelEncryption() const {
+    return parallelEncryption_;
+  }
+
+  /**
+   * Sets options for decrypting large amounts of buffered application data
+   * records on a thread pool. Disabled unless an executor is set.
+   */
+  void setParallelDecryption(ParallelDecryptionOptions options) {
+    parallelDecryption_ = std::move(options);
+  }
+
+  const ParallelDecryptionOptions& getParallelDecryption() const {
+    return parallelDecryption_;
+  }
+
+  /**
+   * Sets how much of the client's leaf certificate connections keep after
+   * verifying it. Encoded and IdentityOnly free the parsed certificate for
+   * apps that only look at the peer identity. Default is Parsed.
+   */
+  void setPeerCertRetention(PeerCertRetention retention) {
+    peerCertRetention_ = retention;
+  }
+
+  PeerCertRetention getPeerCertRetention() const {
+    return peerCertRetention_;
+  }
+
+  /**
+   * Sets whether the aead for the client's next key update is prepared ahead
+   * of time, once the current one is installed, so that a KeyUpdate only
+   * swaps it in. Useful for long lived connections that update keys often.
+   */
+  void setPrepareKeyUpdates(bool enabled) {
+    prepareKeyUpdates_ = enabled;
+  }
+
+  bool getPrepareKeyUpdates() const {
+    return prepareKeyUpdates_;
+  }
+
+  /**
+   * Sets usage limits for the server's application traffic keys. Once a
+   * limit is reached, the next application data write is followed by a
+   * KeyUpdate and later writes use the new keys. Disabled by default.
+   */
+  void setKeyUpdateLimits(KeyUpdateLimits limits) {
+    keyUpdateLimits_ = limits;
+  }
+
+  const KeyUpdateLimits& getKeyUpdateLimits() const {
+    return keyUpdateLimits_;
+  }
+
+  /**
+   * Sets a predicate that is consulted once per connection to decide whether
+   * HandshakeLogging is collected for it. If unset, it is always collected.
+   * For example, to sample roughly 1% of connections:
+   *
+   * context->setHandshakeLoggingSampler(
+   *     [] { return folly::Random::oneIn(100); });
+   */
+  void setHandshakeLoggingSampler(std::function<bool()> sampler) {
+    handshakeLoggingSampler_ = std::move(sampler);
+  }
+
+  bool shouldCollectHandshakeLogging() const {
+    return !handshakeLoggingSampler_ || handshakeLoggingSampler_();
+  }
+
+  /**
+   * Sets what is recorded in HandshakeLogging for connections that collect
+   * it. Default is HandshakeLoggingMode::Full.
+   */
+  void setHandshakeLoggingMode(HandshakeLoggingMode mode) {
+    handshakeLoggingMode_ = mode;
+  }
+
+  HandshakeLoggingMode getHandshakeLoggingMode() const {
+    return handshakeLoggingMode_;
+  }
+
  private:
-  std::unique_ptr<Factory> factory_;
+  std::shared_ptr<Factory> factory_;
 
   std::shared_ptr<TicketCipher> ticketCipher_;
   std::shared_ptr<CookieCipher> cookieCipher_;
+  std::shared_ptr<HandshakeAdmissionController> handshakeAdmissionController_;
+  std::shared_ptr<HandshakeScheduler> handshakeScheduler_;
+  std::shared_ptr<folly::Executor> handshakeExecutor_;
+  std::shared_ptr<HandshakeTracer> handshakeTracer_;
 
-  std::unique_ptr<CertManager> certManager_;
+  std::shared_ptr<CertManager> certManager_;
   std::shared_ptr<const CertificateVerifier> clientCertVerifier_;
 
   std::vector<ProtocolVersion> supportedVersions_ = {
@@ -298,22 +694,51 @@ class FizzServerContext {
       SignatureScheme::rsa_pss_sha256};
   std::vector<NamedGroup> supportedGroups_ = {NamedGroup::x25519,
                                               NamedGroup::secp256r1};
+  PreferenceTable<CipherSuite> cipherPreferences_{supportedCiphers_};
+  PreferenceTable<SignatureScheme> sigSchemePreferences_{supportedSigSchemes_};
+  PreferenceTable<NamedGroup> groupPreferences_{supportedGroups_};
   std::vector<PskKeyExchangeMode> supportedPskModes_ = {
       PskKeyExchangeMode::psk_dhe_ke,
       PskKeyExchangeMode::psk_ke};
+  std::function<bool(const ResumptionState&)> pskKeResumptionPolicy_;
+  std::chrono::seconds pskKeMaxTicketAge_{0};
   std::vector<std::string> supportedAlpns_;
 
   bool versionFallbackEnabled_{false};
+  folly::Optional<ClientHelloLimits> clientHelloLimits_;
   ClientAuthMode clientAuthMode_{ClientAuthMode::None};
 
   bool acceptEarlyData_{false};
   uint32_t maxEarlyDataSize_{std::numeric_limits<uint32_t>::max()};
+  size_t firstEncryptedRecordLimit_{1000};
+  bool earlyDataReplaySafetyReporting_{false};
   ClockSkewTolerance clockSkewTolerance_;
   std::shared_ptr<ReplayCache> replayCache_;
+  std::shared_ptr<SingleUseTicketReplayCache> singleUseTickets_;
 
   bool earlyDataFbOnly_{false};
+  bool fastSkipRejectedEarlyData_{false};
 
   bool sendNewSessionTicket_{true};
+  bool deferNewSessionTicket_{false};
+  uint8_t numNewSessionTickets_{1};
+
+  bool coalesceAppData_{false};
+
+  bool prepareKeyUpdates_{false};
+  bool batchX25519_{false};
+
+  ParallelEncryptionOptions parallelEncryption_;
+  ParallelDecryptionOptions parallelDecryption_;
+
+  PeerCertRetention peerCertRetention_{PeerCertRetention::Parsed};
+
+  KeyUpdateLimits keyUpdateLimits_;
+
+  std::function<bool()> handshakeLoggingSampler_;
+  std::function<bool(const ClientHello&)> clientHelloRouter_;
+  std::shared_ptr<ClientHelloCapture> clientHelloCapture_;
+  HandshakeLoggingMode handshakeLoggingMode_{HandshakeLoggingMode::Full};
 };
 } // namespace server
 } // namespace fizz
@@ -0,0 +1,28 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/FizzServerContextPublisher.h>
+
+namespace fizz {
+namespace server {
+
+FizzServerContextPublisher::FizzServerContextPublisher(
+    std::shared_ptr<FizzServerContext> context) {
+  publish(std::move(context));
+}
+
+void FizzServerContextPublisher::publish(
+    std::shared_ptr<FizzServerContext> context) {
+  if (!context) {
+    throw std::runtime_error("cannot publish a null context");
+  }
+  std::lock_guard<std::mutex> lock(updateMutex_);
+  current_.store(std::move(context), std::memory_order_release);
+}
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/FizzServerContext.h>
+#include <folly/concurrency/AtomicSharedPtr.h>
+
+#include <mutex>
+
+namespace fizz {
+namespace server {
+
+/**
+ * Publishes FizzServerContext snapshots, so that the configuration can be
+ * changed while handshakes are running.
+ *
+ * A published context is never modified again. Acceptors call get() for each
+ * new connection and hand the snapshot to it; connections keep the snapshot
+ * they started with for their lifetime, and new connections see a new
+ * configuration as soon as it's published, without taking a lock.
+ *
+ * update() copies the current snapshot, applies a change to the copy and
+ * publishes it. Components held by pointer that the change doesn't replace
+ * (cert manager, ticket cipher, factory, ...) are shared between the old
+ * and new snapshots, so a reload only allocates what changed.
+ */
+class FizzServerContextPublisher {
+ public:
+  explicit FizzServerContextPublisher(
+      std::shared_ptr<FizzServerContext> context);
+
+  /**
+   * Returns the current snapshot.
+   */
+  std::shared_ptr<const FizzServerContext> get() const {
+    return current_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Publishes context, which must not be modified afterwards.
+   */
+  void publish(std::shared_ptr<FizzServerContext> context);
+
+  /**
+   * Publishes a copy of the current snapshot with fn applied to it, and
+   * returns it. Updates are serialized, so concurrent updates are not lost.
+   */
+  template <typename F>
+  std::shared_ptr<const FizzServerContext> update(F&& fn) {
+    std::lock_guard<std::mutex> lock(updateMutex_);
+    auto next = std::make_shared<FizzServerContext>(*get());
+    fn(*next);
+    std::shared_ptr<const FizzServerContext> published = std::move(next);
+    current_.store(published, std::memory_order_release);
+    return published;
+  }
+
+ private:
+  folly::atomic_shared_ptr<const FizzServerContext> current_;
+  std::mutex updateMutex_;
+};
+} // namespace server
+} // namespace fizz
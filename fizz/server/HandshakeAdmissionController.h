@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace fizz {
+namespace server {
+
+/**
+ * Tracks the number of handshakes in progress and decides when new clients
+ * must prove reachability with a stateless HelloRetryRequest (see
+ * FizzServerContext::setHandshakeAdmissionController()) before the server
+ * does any key exchange or signing for them.
+ *
+ * The default policy requires a retry once more than maxPendingHandshakes
+ * handshakes are pending on all connections using this controller.
+ * Subclasses may override shouldRequireRetry() to use other signals, such as
+ * CPU load.
+ */
+class HandshakeAdmissionController {
+ public:
+  /**
+   * Held by a connection while its handshake is in progress.
+   */
+  class PendingHandshake {
+   public:
+    explicit PendingHandshake(std::shared_ptr<std::atomic<size_t>> pending)
+        : pending_(std::move(pending)) {
+      ++*pending_;
+    }
+
+    ~PendingHandshake() {
+      --*pending_;
+    }
+
+   private:
+    std::shared_ptr<std::atomic<size_t>> pending_;
+  };
+
+  explicit HandshakeAdmissionController(size_t maxPendingHandshakes)
+      : maxPendingHandshakes_(maxPendingHandshakes) {}
+
+  virtual ~HandshakeAdmissionController() = default;
+
+  /**
+   * Called when a connection is accepted. The handshake counts as pending
+   * until the returned object is destroyed.
+   */
+  std::unique_ptr<PendingHandshake> startHandshake() const {
+    return std::make_unique<PendingHandshake>(pending_);
+  }
+
+  size_t getPendingHandshakes() const {
+    return pending_->load();
+  }
+
+  /**
+   * Called for each ClientHello that does not carry a cookie. If this returns
+   * true the client is sent a stateless HelloRetryRequest instead.
+   */
+  virtual bool shouldRequireRetry() const {
+    return getPendingHandshakes() > maxPendingHandshakes_;
+  }
+
+ private:
+  std::shared_ptr<std::atomic<size_t>> pending_{
+      std::make_shared<std::atomic<size_t>>(0)};
+  size_t maxPendingHandshakes_;
+};
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/HandshakeScheduler.h>
+
+#include <folly/ScopeGuard.h>
+
+#include <algorithm>
+
+namespace fizz {
+namespace server {
+
+HandshakeScheduler::HandshakeScheduler(
+    std::shared_ptr<folly::Executor> executor,
+    size_t maxConcurrent,
+    size_t maxQueued)
+    : executor_(std::move(executor)),
+      maxConcurrent_(std::max<size_t>(maxConcurrent, 1)),
+      maxQueued_(maxQueued) {}
+
+folly::Future<folly::Optional<Buf>> HandshakeScheduler::schedule(
+    Priority priority,
+    Work work,
+    std::shared_ptr<const std::atomic<bool>> cancelled) const {
+  Job job;
+  job.work = std::move(work);
+  job.cancelled = std::move(cancelled);
+  auto future = job.promise.getFuture();
+  {
+    auto queue = queue_.wlock();
+    if (queue->running >= maxConcurrent_ && queue->queued >= maxQueued_) {
+      return folly::makeFuture<folly::Optional<Buf>>(FizzException(
+          "handshake queue full", AlertDescription::internal_error));
+    }
+    queue->jobs[static_cast<size_t>(priority)].push_back(std::move(job));
+    queue->queued++;
+  }
+  runNext();
+  return future;
+}
+
+size_t HandshakeScheduler::getRunning() const {
+  return queue_.rlock()->running;
+}
+
+size_t HandshakeScheduler::getQueued() const {
+  return queue_.rlock()->queued;
+}
+
+void HandshakeScheduler::runNext() const {
+  Job job;
+  std::vector<Job> dropped;
+  SCOPE_EXIT {
+    for (auto& droppedJob : dropped) {
+      droppedJob.promise.setException(folly::FutureCancellation());
+    }
+  };
+  {
+    auto queue = queue_.wlock();
+    while (true) {
+      if (queue->running >= maxConcurrent_) {
+        return;
+      }
+      auto jobs = std::find_if(
+          queue->jobs.begin(),
+          queue->jobs.end(),
+          [](const std::deque<Job>& q) { return !q.empty(); });
+      if (jobs == queue->jobs.end()) {
+        return;
+      }
+      job = std::move(jobs->front());
+      jobs->pop_front();
+      queue->queued--;
+      if (job.cancelled && job.cancelled->load()) {
+        dropped.push_back(std::move(job));
+        continue;
+      }
+      queue->running++;
+      break;
+    }
+  }
+  executor_->add([self = shared_from_this(), job = std::move(job)]() mutable {
+    folly::makeFutureWith(std::move(job.work))
+        .then([self, promise = std::move(job.promise)](
+                  folly::Try<folly::Optional<Buf>> result) mutable {
+          promise.setTry(std::move(result));
+          self->finished();
+        });
+  });
+}
+
+void HandshakeScheduler::finished() const {
+  queue_.wlock()->running--;
+  runNext();
+}
+} // namespace server
+} // namespace fizz
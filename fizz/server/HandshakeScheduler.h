@@ -0,0 +1,97 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/record/Types.h>
+#include <folly/Executor.h>
+#include <folly/Function.h>
+#include <folly/Synchronized.h>
+#include <folly/futures/Future.h>
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+namespace fizz {
+namespace server {
+
+/**
+ * Bounded priority queue for the expensive part of a full handshake, signing
+ * the server's CertificateVerify. At most maxConcurrent jobs run at a time on
+ * the executor; the rest wait in the queue, higher priority first, and are
+ * rejected once maxQueued are waiting.
+ *
+ * Resumed and PSK-only handshakes do no signing and never wait here, so they
+ * are not held up behind a burst of full handshakes. Jobs of handshakes that
+ * are abandoned while queued are dropped instead of run, see schedule().
+ *
+ * Thread safe. Must be owned by a shared_ptr so that running jobs can outlive
+ * the caller's reference.
+ */
+class HandshakeScheduler
+    : public std::enable_shared_from_this<HandshakeScheduler> {
+ public:
+  enum class Priority {
+    // Clients that have already spent a round trip on this connection (a
+    // HelloRetryRequest or a rejected ticket).
+    High,
+    Normal,
+  };
+
+  using Work = folly::Function<folly::Future<folly::Optional<Buf>>()>;
+
+  HandshakeScheduler(
+      std::shared_ptr<folly::Executor> executor,
+      size_t maxConcurrent,
+      size_t maxQueued);
+
+  virtual ~HandshakeScheduler() = default;
+
+  /**
+   * Runs work on the executor once a slot is free. The returned future fails
+   * with a FizzException if the queue is full.
+   *
+   * If cancelled is set by the time the job reaches the front of the queue,
+   * work is not run and the future fails with folly::FutureCancellation. A
+   * job that is already running is not interrupted.
+   */
+  folly::Future<folly::Optional<Buf>> schedule(
+      Priority priority,
+      Work work,
+      std::shared_ptr<const std::atomic<bool>> cancelled = nullptr) const;
+
+  size_t getRunning() const;
+
+  size_t getQueued() const;
+
+ private:
+  void runNext() const;
+
+  void finished() const;
+
+  struct Job {
+    Work work;
+    folly::Promise<folly::Optional<Buf>> promise;
+    std::shared_ptr<const std::atomic<bool>> cancelled;
+  };
+
+  struct Queue {
+    std::array<std::deque<Job>, 2> jobs;
+    size_t running{0};
+    size_t queued{0};
+  };
+
+  std::shared_ptr<folly::Executor> executor_;
+  size_t maxConcurrent_;
+  size_t maxQueued_;
+  mutable folly::Synchronized<Queue> queue_;
+};
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,277 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/LazyCertManager.h>
+
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace server {
+
+LazyCertManager::LazyCertManager(
+    std::shared_ptr<Executor> loadExecutor,
+    size_t maxLoadedCerts,
+    std::chrono::milliseconds failedLoadTtl)
+    : loadExecutor_(std::move(loadExecutor)),
+      state_(std::make_shared<LoadState>(maxLoadedCerts, failedLoadTtl)) {}
+
+void LazyCertManager::addLazyCert(
+    std::vector<std::string> identities,
+    Loader loader,
+    bool defaultCert) {
+  if (identities.empty()) {
+    throw std::runtime_error("no identities");
+  }
+  auto index = state_->entries.size();
+  for (const auto& ident : identities) {
+    auto key = getKeyFromIdent(ident);
+    if (!nameIndex_.emplace(key, index).second) {
+      VLOG(1) << "Skipping duplicate certificate for " << key;
+    }
+  }
+  identityIndex_.emplace(identities.front(), index);
+  if (defaultCert) {
+    default_ = index;
+  }
+  state_->entries.push_back(
+      Entry{std::move(identities.front()), std::move(loader)});
+}
+
+void LazyCertManager::addCert(
+    std::shared_ptr<SelfCert> cert,
+    bool defaultCert) {
+  std::vector<std::string> identities{cert->getIdentity()};
+  for (auto& ident : cert->getAltIdentities()) {
+    if (ident != identities.front()) {
+      identities.push_back(std::move(ident));
+    }
+  }
+  addLazyCert(
+      std::move(identities),
+      [cert = std::move(cert)]() { return cert; },
+      defaultCert);
+}
+
+void LazyCertManager::addCerts(
+    std::vector<std::pair<std::shared_ptr<SelfCert>, bool>> certs) {
+  state_->entries.reserve(state_->entries.size() + certs.size());
+  for (auto& cert : certs) {
+    addCert(std::move(cert.first), cert.second);
+  }
+}
+
+static CertManager::CertMatch matchCert(
+    const std::shared_ptr<SelfCert>& cert,
+    const std::vector<SignatureScheme>& supportedSigSchemes,
+    const std::vector<SignatureScheme>& peerSigSchemes,
+    CertManager::CertMatch& lastResort) {
+  auto certSchemes = cert->getSigSchemes();
+  for (auto scheme : supportedSigSchemes) {
+    if (std::find(certSchemes.begin(), certSchemes.end(), scheme) ==
+        certSchemes.end()) {
+      continue;
+    }
+    if (std::find(peerSigSchemes.begin(), peerSigSchemes.end(), scheme) !=
+        peerSigSchemes.end()) {
+      return std::make_pair(cert, scheme);
+    } else if (!lastResort) {
+      lastResort = std::make_pair(cert, scheme);
+    }
+  }
+  return none;
+}
+
+CertManager::CertMatch LazyCertManager::getCert(
+    const Optional<std::string>& sni,
+    const std::vector<SignatureScheme>& supportedSigSchemes,
+    const std::vector<SignatureScheme>& peerSigSchemes) const {
+  CertMatch lastResort;
+  if (sni) {
+    auto key = *sni;
+    toLowerAscii(key);
+
+    auto it = nameIndex_.find(key);
+    if (it != nameIndex_.end()) {
+      auto ret = matchCert(
+          state_->load(it->second),
+          supportedSigSchemes,
+          peerSigSchemes,
+          lastResort);
+      if (ret) {
+        VLOG(8) << "Found exact SNI match for: " << key;
+        return ret;
+      }
+    }
+
+    auto wildcardKey = getWildcardKey(key);
+    if (wildcardKey) {
+      it = nameIndex_.find(*wildcardKey);
+      if (it != nameIndex_.end()) {
+        auto ret = matchCert(
+            state_->load(it->second),
+            supportedSigSchemes,
+            peerSigSchemes,
+            lastResort);
+        if (ret) {
+          VLOG(8) << "Found wildcard SNI match for: " << key;
+          return ret;
+        }
+      }
+    }
+
+    VLOG(8) << "Did not find match for SNI: " << key;
+  }
+
+  if (default_) {
+    auto ret = matchCert(
+        state_->load(*default_),
+        supportedSigSchemes,
+        peerSigSchemes,
+        lastResort);
+    if (ret) {
+      return ret;
+    }
+  }
+
+  VLOG(8) << "No matching cert for client sig schemes found";
+  return lastResort;
+}
+
+std::shared_ptr<SelfCert> LazyCertManager::getCert(
+    const std::string& identity) const {
+  auto it = identityIndex_.find(identity);
+  if (it == identityIndex_.end()) {
+    return nullptr;
+  }
+  return state_->load(it->second);
+}
+
+Future<Unit> LazyCertManager::prefetchCert(
+    const Optional<std::string>& sni) const {
+  auto index = findEntry(sni);
+  if (!index || state_->getLoaded(*index) || state_->recentlyFailed(*index)) {
+    return unit;
+  }
+
+  std::shared_ptr<SharedPromise<Unit>> promise;
+  bool startLoad = false;
+  state_->loading.withWLock([&](auto& loading) {
+    auto& pending = loading[*index];
+    if (!pending) {
+      pending = std::make_shared<SharedPromise<Unit>>();
+      startLoad = true;
+    }
+    promise = pending;
+  });
+
+  if (startLoad) {
+    via(loadExecutor_.get(),
+        [state = state_, index = *index]() { state->load(index); })
+        .then([state = state_, index = *index, promise](Try<Unit> result) {
+          state->loading.wlock()->erase(index);
+          if (result.hasException()) {
+            // getCert() will fail the handshake if there is no other
+            // suitable certificate.
+            LOG(ERROR) << "Failed to load certificate for "
+                       << state->entries[index].identity << ": "
+                       << result.exception().what();
+          }
+          promise->setValue();
+        });
+  }
+  return promise->getFuture();
+}
+
+Optional<size_t> LazyCertManager::findEntry(
+    const Optional<std::string>& sni) const {
+  if (sni) {
+    auto key = *sni;
+    toLowerAscii(key);
+    auto it = nameIndex_.find(key);
+    if (it != nameIndex_.end()) {
+      return it->second;
+    }
+    auto wildcardKey = getWildcardKey(key);
+    if (wildcardKey) {
+      it = nameIndex_.find(*wildcardKey);
+      if (it != nameIndex_.end()) {
+        return it->second;
+      }
+    }
+  }
+  return default_;
+}
+
+std::shared_ptr<SelfCert> LazyCertManager::LoadState::getLoaded(
+    size_t index) {
+  auto loadedCerts = loaded.wlock();
+  auto it = loadedCerts->find(index);
+  if (it == loadedCerts->end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+bool LazyCertManager::LoadState::recentlyFailed(size_t index) {
+  auto failedLoads = failed.wlock();
+  auto it = failedLoads->find(index);
+  if (it == failedLoads->end()) {
+    return false;
+  }
+  if (std::chrono::steady_clock::now() < it->second) {
+    return true;
+  }
+  failedLoads->erase(it);
+  return false;
+}
+
+std::shared_ptr<SelfCert> LazyCertManager::LoadState::load(size_t index) {
+  auto cert = getLoaded(index);
+  if (cert) {
+    return cert;
+  }
+  if (recentlyFailed(index)) {
+    throw std::runtime_error(to<std::string>(
+        "recently failed to load certificate for ", entries[index].identity));
+  }
+  try {
+    cert = entries[index].loader();
+    if (!cert) {
+      throw std::runtime_error(to<std::string>(
+          "failed to load certificate for ", entries[index].identity));
+    }
+  } catch (const std::exception&) {
+    failed.wlock()->emplace(
+        index, std::chrono::steady_clock::now() + failedLoadTtl);
+    throw;
+  }
+  loaded.wlock()->set(index, cert);
+  return cert;
+}
+
+LazyCertManager::Loader LazyCertManager::fileLoader(
+    std::string certPath,
+    std::string keyPath) {
+  return [certPath = std::move(certPath), keyPath = std::move(keyPath)]() {
+    std::string certData;
+    std::string keyData;
+    if (!readFile(certPath.c_str(), certData)) {
+      throw std::runtime_error(to<std::string>("could not read ", certPath));
+    }
+    if (!readFile(keyPath.c_str(), keyData)) {
+      throw std::runtime_error(to<std::string>("could not read ", keyPath));
+    }
+    return std::shared_ptr<SelfCert>(
+        CertUtils::makeSelfCert(std::move(certData), std::move(keyData)));
+  };
+}
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,126 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/CertManager.h>
+#include <folly/Executor.h>
+#include <folly/Synchronized.h>
+#include <folly/container/EvictingCacheMap.h>
+#include <folly/futures/SharedPromise.h>
+
+#include <chrono>
+
+namespace fizz {
+namespace server {
+
+/**
+ * CertManager for very large certificate sets. Only an index from names to
+ * loaders is kept up front, certificates are loaded the first time they are
+ * selected and kept in an LRU of at most maxLoadedCerts.
+ *
+ * prefetchCert() loads on loadExecutor, so the ClientHello path can wait for
+ * a cold certificate without blocking its EventBase. getCert() loads inline
+ * if called for a certificate that is not loaded. Loads still in flight keep
+ * the loaded state alive, so the manager may be destroyed before they finish.
+ *
+ * A failed load is remembered for failedLoadTtl: until then, prefetches of
+ * that certificate complete immediately and getCert() fails without calling
+ * its loader again.
+ *
+ * Unlike CertManager each name maps to a single certificate. addLazyCert()
+ * and addCert() must not be called concurrently with lookups.
+ */
+class LazyCertManager : public CertManager {
+ public:
+  using Loader = std::function<std::shared_ptr<SelfCert>()>;
+
+  LazyCertManager(
+      std::shared_ptr<folly::Executor> loadExecutor,
+      size_t maxLoadedCerts,
+      std::chrono::milliseconds failedLoadTtl = std::chrono::seconds(30));
+
+  /**
+   * Adds a certificate to be loaded by loader when first used. identities
+   * are the names it can be selected by, the first one is its primary
+   * identity.
+   */
+  void addLazyCert(
+      std::vector<std::string> identities,
+      Loader loader,
+      bool defaultCert = false);
+
+  /**
+   * Adds an already loaded certificate. It can still be evicted from the LRU,
+   * but reloading it is free.
+   */
+  void addCert(std::shared_ptr<SelfCert> cert, bool defaultCert = false)
+      override;
+
+  void addCerts(std::vector<std::pair<std::shared_ptr<SelfCert>, bool>> certs)
+      override;
+
+  CertMatch getCert(
+      const folly::Optional<std::string>& sni,
+      const std::vector<SignatureScheme>& supportedSigSchemes,
+      const std::vector<SignatureScheme>& peerSigSchemes) const override;
+
+  std::shared_ptr<SelfCert> getCert(const std::string& identity) const override;
+
+  folly::Future<folly::Unit> prefetchCert(
+      const folly::Optional<std::string>& sni) const override;
+
+  /**
+   * Returns a loader that reads a PEM certificate chain and private key from
+   * disk.
+   */
+  static Loader fileLoader(std::string certPath, std::string keyPath);
+
+ private:
+  struct Entry {
+    std::string identity;
+    Loader loader;
+  };
+
+  /**
+   * Everything an asynchronous load needs, shared with the loads in flight.
+   */
+  struct LoadState {
+    LoadState(size_t maxLoadedCerts, std::chrono::milliseconds ttl)
+        : loaded(LoadedCerts(maxLoadedCerts)), failedLoadTtl(ttl) {}
+
+    std::shared_ptr<SelfCert> getLoaded(size_t index);
+    std::shared_ptr<SelfCert> load(size_t index);
+    bool recentlyFailed(size_t index);
+
+    using LoadedCerts =
+        folly::EvictingCacheMap<size_t, std::shared_ptr<SelfCert>>;
+    using PendingLoads = std::unordered_map<
+        size_t,
+        std::shared_ptr<folly::SharedPromise<folly::Unit>>>;
+    using FailedLoads =
+        std::unordered_map<size_t, std::chrono::steady_clock::time_point>;
+
+    std::vector<Entry> entries;
+    folly::Synchronized<LoadedCerts> loaded;
+    folly::Synchronized<PendingLoads> loading;
+    folly::Synchronized<FailedLoads> failed;
+    std::chrono::milliseconds failedLoadTtl;
+  };
+
+  folly::Optional<size_t> findEntry(
+      const folly::Optional<std::string>& sni) const;
+
+  std::shared_ptr<folly::Executor> loadExecutor_;
+  std::shared_ptr<LoadState> state_;
+  std::unordered_map<std::string, size_t> nameIndex_;
+  std::unordered_map<std::string, size_t> identityIndex_;
+  folly::Optional<size_t> default_;
+};
+} // namespace server
+} // namespace fizz
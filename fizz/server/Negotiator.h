@@ -10,6 +10,9 @@
 
 #include <folly/Optional.h>
 
+#include <unordered_map>
+#include <vector>
+
 namespace fizz {
 namespace server {
 
@@ -56,5 +59,56 @@ folly::Optional<T> negotiate(
   }
   return folly::none;
 }
+
+/**
+ * Server preferences compiled into a rank table, so that negotiating against
+ * a client list is a single pass over it with constant time lookups. The
+ * result matches the corresponding negotiate() overload above.
+ */
+template <typename T>
+class PreferenceTable {
+ public:
+  PreferenceTable() = default;
+
+  /**
+   * Preference tiers, respecting client preference within a tier.
+   */
+  explicit PreferenceTable(const std::vector<std::vector<T>>& serverPref) {
+    for (size_t tier = 0; tier < serverPref.size(); ++tier) {
+      for (const auto& pref : serverPref[tier]) {
+        ranks_.emplace(pref, tier);
+      }
+    }
+  }
+
+  /**
+   * Server preference order, ignoring client preference.
+   */
+  explicit PreferenceTable(const std::vector<T>& serverPref) {
+    for (size_t i = 0; i < serverPref.size(); ++i) {
+      ranks_.emplace(serverPref[i], i);
+    }
+  }
+
+  folly::Optional<T> negotiate(const std::vector<T>& clientPref) const {
+    folly::Optional<T> best;
+    size_t bestRank = 0;
+    for (const auto& pref : clientPref) {
+      auto it = ranks_.find(pref);
+      if (it != ranks_.end() && (!best || it->second < bestRank)) {
+        best = pref;
+        bestRank = it->second;
+      }
+    }
+    return best;
+  }
+
+  bool contains(const T& value) const {
+    return ranks_.find(value) != ranks_.end();
+  }
+
+ private:
+  std::unordered_map<T, size_t> ranks_;
+};
 } // namespace server
 } // namespace fizz
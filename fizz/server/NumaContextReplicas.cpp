@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/NumaContextReplicas.h>
+
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+
+#include <algorithm>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fizz {
+namespace server {
+
+namespace {
+std::string nodePath(size_t node, folly::StringPiece file) {
+  return folly::to<std::string>(
+      "/sys/devices/system/node/node", node, "/", file);
+}
+
+#ifdef __linux__
+bool bindToCpus(const std::vector<size_t>& cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+#endif
+
+std::shared_ptr<FizzServerContext> buildOnNode(
+    size_t node,
+    const NumaContextReplicas::Builder& builder) {
+#ifdef __linux__
+  std::string cpuList;
+  if (folly::readFile(nodePath(node, "cpulist").c_str(), cpuList)) {
+    auto cpus =
+        NumaContextReplicas::parseCpuList(folly::trimWhitespace(cpuList));
+    if (!cpus.empty()) {
+      std::shared_ptr<FizzServerContext> replica;
+      std::exception_ptr error;
+      std::thread thread([&]() {
+        if (!bindToCpus(cpus)) {
+          VLOG(2) << "unable to bind to cpus of node " << node;
+        }
+        try {
+          replica = builder(node);
+        } catch (...) {
+          error = std::current_exception();
+        }
+      });
+      thread.join();
+      if (error) {
+        std::rethrow_exception(error);
+      }
+      return replica;
+    }
+  }
+#endif
+  VLOG(2) << "cpus of node " << node << " unknown, building on this thread";
+  return builder(node);
+}
+} // namespace
+
+NumaContextReplicas::NumaContextReplicas(
+    size_t numNodes,
+    const Builder& builder) {
+  numNodes = std::max<size_t>(numNodes, 1);
+  replicas_.reserve(numNodes);
+  for (size_t node = 0; node < numNodes; ++node) {
+    auto replica = buildOnNode(node, builder);
+    if (!replica) {
+      throw std::runtime_error(
+          folly::to<std::string>("no context built for node ", node));
+    }
+    replicas_.push_back(std::move(replica));
+  }
+}
+
+const std::shared_ptr<FizzServerContext>& NumaContextReplicas::getLocal()
+    const {
+  auto node = getCurrentNode();
+  return replicas_[node < replicas_.size() ? node : 0];
+}
+
+size_t NumaContextReplicas::getNumNodes() {
+  std::string online;
+  if (!folly::readFile("/sys/devices/system/node/online", online)) {
+    return 1;
+  }
+  auto nodes = parseCpuList(folly::trimWhitespace(online));
+  if (nodes.empty()) {
+    return 1;
+  }
+  return *std::max_element(nodes.begin(), nodes.end()) + 1;
+}
+
+size_t NumaContextReplicas::getCurrentNode() {
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu;
+  unsigned node;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    return node;
+  }
+#endif
+  return 0;
+}
+
+std::vector<size_t> NumaContextReplicas::parseCpuList(
+    folly::StringPiece cpuList) {
+  std::vector<size_t> cpus;
+  std::vector<folly::StringPiece> ranges;
+  folly::split(',', cpuList, ranges);
+  for (auto range : ranges) {
+    folly::StringPiece first;
+    folly::StringPiece last;
+    if (!folly::split('-', range, first, last)) {
+      first = last = range;
+    }
+    auto start = folly::tryTo<size_t>(first);
+    auto end = folly::tryTo<size_t>(last);
+    if (!start || !end || *start > *end) {
+      return {};
+    }
+    for (auto cpu = *start; cpu <= *end; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+} // namespace server
+} // namespace fizz
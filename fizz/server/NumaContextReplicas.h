@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/FizzServerContext.h>
+
+#include <functional>
+
+namespace fizz {
+namespace server {
+
+/**
+ * One FizzServerContext per NUMA node, for hosts where threads on every
+ * node run handshakes.
+ *
+ * Everything a handshake reads from the context (the CertManager index, the
+ * SelfCerts and their private keys, the ticket cipher keys) is allocated
+ * where it was built, so with a single context half of the threads read it
+ * from a remote node. Here builder is called once per node, on a thread
+ * bound to that node's CPUs, so that the replica it builds is allocated on
+ * the node (by first touch). The replicas should be independent, ie builder
+ * should load certs and ticket secrets itself rather than share them.
+ *
+ * The exception is anti-replay state. The ReplayCache passed to
+ * setEarlyDataSettings and the SingleUseTicketReplayCache passed to
+ * setSingleUseTickets must be the same instances in every replica: with a
+ * copy per node, a ClientHello replayed to a thread on another node is not
+ * seen as a replay and its early data is accepted twice.
+ *
+ * Each EventBase thread then takes its replica from getLocal() once, when
+ * it starts accepting, and uses it for all of its connections.
+ *
+ * Binding only works on Linux. Elsewhere, or if the node's CPUs can't be
+ * determined, the replicas are built on the calling thread.
+ */
+class NumaContextReplicas {
+ public:
+  using Builder =
+      std::function<std::shared_ptr<FizzServerContext>(size_t node)>;
+
+  NumaContextReplicas(size_t numNodes, const Builder& builder);
+
+  size_t numNodes() const {
+    return replicas_.size();
+  }
+
+  const std::shared_ptr<FizzServerContext>& get(size_t node) const {
+    return replicas_.at(node);
+  }
+
+  /**
+   * The replica of the node the calling thread is running on.
+   */
+  const std::shared_ptr<FizzServerContext>& getLocal() const;
+
+  /**
+   * Number of NUMA nodes on the host, 1 if it can't be determined.
+   */
+  static size_t getNumNodes();
+
+  /**
+   * Node the calling thread is running on, 0 if it can't be determined.
+   */
+  static size_t getCurrentNode();
+
+  /**
+   * Parses a kernel CPU list such as "0-3,8,10-11". Returns an empty list if
+   * it's malformed.
+   */
+  static std::vector<size_t> parseCpuList(folly::StringPiece cpuList);
+
+ private:
+  std::vector<std::shared_ptr<FizzServerContext>> replicas_;
+};
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/ReloadableCertManager.h>
+
+namespace fizz {
+namespace server {
+
+ReloadableCertManager::ReloadableCertManager(
+    std::shared_ptr<const CertManager> certs) {
+  reload(std::move(certs));
+}
+
+CertManager::CertMatch ReloadableCertManager::getCert(
+    const folly::Optional<std::string>& sni,
+    const std::vector<SignatureScheme>& supportedSigSchemes,
+    const std::vector<SignatureScheme>& peerSigSchemes) const {
+  return getSnapshot()->getCert(sni, supportedSigSchemes, peerSigSchemes);
+}
+
+std::shared_ptr<SelfCert> ReloadableCertManager::getCert(
+    const std::string& identity) const {
+  return getSnapshot()->getCert(identity);
+}
+
+folly::Future<folly::Unit> ReloadableCertManager::prefetchCert(
+    const folly::Optional<std::string>& sni) const {
+  return getSnapshot()->prefetchCert(sni);
+}
+
+folly::Optional<Buf> ReloadableCertManager::getCompressedCert(
+    const SelfCert& cert,
+    const std::vector<CertificateCompressionAlgorithm>& peerAlgos) const {
+  return getSnapshot()->getCompressedCert(cert, peerAlgos);
+}
+
+void ReloadableCertManager::addCert(
+    std::shared_ptr<SelfCert> /* cert */,
+    bool /* defaultCert */) {
+  throw std::runtime_error("certificates must be installed with reload()");
+}
+
+void ReloadableCertManager::addCerts(
+    std::vector<std::pair<std::shared_ptr<SelfCert>, bool>> /* certs */) {
+  throw std::runtime_error("certificates must be installed with reload()");
+}
+
+void ReloadableCertManager::reload(std::shared_ptr<const CertManager> certs) {
+  if (!certs) {
+    throw std::runtime_error("null cert manager");
+  }
+  // The old snapshot is freed once the last lookup drops it, while
+  // connections may still be using borrowed pointers to its certs.
+  if (certs->getBorrowCerts()) {
+    throw std::runtime_error("cert manager borrows its certs");
+  }
+  certs_.store(std::move(certs));
+}
+
+std::shared_ptr<const CertManager> ReloadableCertManager::getSnapshot() const {
+  return certs_.load();
+}
+} // namespace server
+} // namespace fizz
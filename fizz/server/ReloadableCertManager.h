@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/CertManager.h>
+#include <folly/concurrency/AtomicSharedPtr.h>
+
+namespace fizz {
+namespace server {
+
+/**
+ * CertManager whose certificates can be replaced while handshakes are in
+ * progress. Lookups are served from an immutable CertManager snapshot that
+ * reload() swaps atomically, so readers never take a lock and a handshake
+ * that started before a reload keeps using the certificates it selected.
+ *
+ * Certificates (and compressors) are configured on the CertManager passed to
+ * reload(), addCert() must not be called on this object.
+ */
+class ReloadableCertManager : public CertManager {
+ public:
+  explicit ReloadableCertManager(
+      std::shared_ptr<const CertManager> certs =
+          std::make_shared<const CertManager>());
+
+  CertMatch getCert(
+      const folly::Optional<std::string>& sni,
+      const std::vector<SignatureScheme>& supportedSigSchemes,
+      const std::vector<SignatureScheme>& peerSigSchemes) const override;
+
+  std::shared_ptr<SelfCert> getCert(const std::string& identity) const override;
+
+  folly::Future<folly::Unit> prefetchCert(
+      const folly::Optional<std::string>& sni) const override;
+
+  folly::Optional<Buf> getCompressedCert(
+      const SelfCert& cert,
+      const std::vector<CertificateCompressionAlgorithm>& peerAlgos)
+      const override;
+
+  /**
+   * Throws, certificates must be installed with reload().
+   */
+  void addCert(std::shared_ptr<SelfCert> cert, bool defaultCert = false)
+      override;
+
+  void addCerts(std::vector<std::pair<std::shared_ptr<SelfCert>, bool>> certs)
+      override;
+
+  /**
+   * Replaces the certificates used for new lookups. certs must not be
+   * modified after this is called, and must not borrow its certs (see
+   * CertManager::setBorrowCerts()).
+   */
+  void reload(std::shared_ptr<const CertManager> certs);
+
+  /**
+   * Returns the snapshot currently serving lookups.
+   */
+  std::shared_ptr<const CertManager> getSnapshot() const;
+
+ private:
+  folly::atomic_shared_ptr<const CertManager> certs_;
+};
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,142 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/RemoteTicketCipher.h>
+
+#include <algorithm>
+
+namespace fizz {
+namespace server {
+
+RemoteTokenCipher::RemoteTokenCipher(
+    std::shared_ptr<TicketKeyService> service,
+    std::shared_ptr<folly::Executor> executor,
+    size_t maxBatchSize)
+    : service_(std::move(service)),
+      executor_(std::move(executor)),
+      maxBatchSize_(std::max<size_t>(maxBatchSize, 1)) {}
+
+void RemoteTokenCipher::setDecryptCache(
+    size_t size,
+    std::chrono::milliseconds ttl) {
+  cacheTtl_ = ttl;
+  if (size > 0 && ttl.count() > 0) {
+    cache_ = std::make_unique<DecryptCache>(folly::in_place, size);
+  } else {
+    cache_.reset();
+  }
+}
+
+folly::Future<Buf> RemoteTokenCipher::encrypt(Buf plaintext) {
+  Request request;
+  request.data = std::move(plaintext);
+  return enqueue(Operation::Encrypt, std::move(request));
+}
+
+folly::Future<Buf> RemoteTokenCipher::decrypt(Buf token) {
+  Request request;
+  if (cache_) {
+    request.token = folly::StringPiece(token->coalesce()).str();
+    auto cache = cache_->wlock();
+    auto it = cache->find(request.token);
+    if (it != cache->end()) {
+      if (it->second.expires > Clock::now()) {
+        return folly::makeFuture(it->second.plaintext->clone());
+      }
+      cache->erase(it);
+    }
+  }
+  request.data = std::move(token);
+  return enqueue(Operation::Decrypt, std::move(request));
+}
+
+folly::Future<Buf> RemoteTokenCipher::enqueue(
+    Operation operation,
+    Request request) {
+  auto future = request.promise.getFuture();
+
+  bool schedule;
+  {
+    auto pendingRequests = pending(operation).wlock();
+    pendingRequests->requests.push_back(std::move(request));
+    schedule = !pendingRequests->scheduled;
+    pendingRequests->scheduled = true;
+  }
+  if (schedule) {
+    executor_->add([self = shared_from_this(), operation]() {
+      self->runBatch(operation);
+    });
+  }
+  return future;
+}
+
+void RemoteTokenCipher::runBatch(Operation operation) {
+  std::vector<Request> batch;
+  bool more;
+  {
+    auto pendingRequests = pending(operation).wlock();
+    auto count = std::min(maxBatchSize_, pendingRequests->requests.size());
+    batch.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      batch.push_back(std::move(pendingRequests->requests.front()));
+      pendingRequests->requests.pop_front();
+    }
+    more = !pendingRequests->requests.empty();
+    pendingRequests->scheduled = more;
+  }
+  if (more) {
+    executor_->add([self = shared_from_this(), operation]() {
+      self->runBatch(operation);
+    });
+  }
+
+  std::vector<Buf> data;
+  data.reserve(batch.size());
+  for (auto& request : batch) {
+    data.push_back(std::move(request.data));
+  }
+
+  auto results = folly::makeFutureWith([&]() {
+    return operation == Operation::Encrypt
+        ? service_->encrypt(std::move(data))
+        : service_->decrypt(std::move(data));
+  });
+  results.then([self = shared_from_this(), operation, batch = std::move(batch)](
+                   folly::Try<std::vector<Buf>> tryResults) mutable {
+    self->finishBatch(operation, std::move(batch), std::move(tryResults));
+  });
+}
+
+void RemoteTokenCipher::finishBatch(
+    Operation operation,
+    std::vector<Request> batch,
+    folly::Try<std::vector<Buf>> results) {
+  if (!results.hasException() && results->size() != batch.size()) {
+    results = folly::Try<std::vector<Buf>>(
+        folly::make_exception_wrapper<std::runtime_error>(
+            "wrong number of ticket service results"));
+  }
+  if (results.hasException()) {
+    for (auto& request : batch) {
+      request.promise.setException(results.exception());
+    }
+    return;
+  }
+
+  auto expires = Clock::now() + cacheTtl_;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    auto& result = (*results)[i];
+    if (operation == Operation::Decrypt && cache_ && result) {
+      CachedPlaintext cached{result->clone(), expires};
+      cache_->wlock()->set(batch[i].token, std::move(cached));
+    }
+    batch[i].promise.setValue(std::move(result));
+  }
+}
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,199 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/FizzServerContext.h>
+#include <fizz/server/TicketCipher.h>
+#include <folly/Executor.h>
+#include <folly/Synchronized.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace fizz {
+namespace server {
+
+/**
+ * Interface to a central ticket key service, which holds the ticket keys so
+ * that servers don't have to. Requests are batches: one RPC carries every
+ * plaintext or ticket in the batch.
+ */
+class TicketKeyService {
+ public:
+  virtual ~TicketKeyService() = default;
+
+  /**
+   * Returns one ticket per plaintext, in order, or nullptr for a plaintext
+   * that couldn't be encrypted.
+   */
+  virtual folly::Future<std::vector<Buf>> encrypt(
+      std::vector<Buf> plaintexts) = 0;
+
+  /**
+   * Returns one plaintext per ticket, in order, or nullptr for a ticket that
+   * wasn't recognized.
+   */
+  virtual folly::Future<std::vector<Buf>> decrypt(std::vector<Buf> tickets) = 0;
+};
+
+/**
+ * Encrypts and decrypts opaque tokens with a TicketKeyService. Requests from
+ * any thread are queued and sent in batches from an executor: a batch is
+ * started when a request is queued with no batch of its kind pending, and
+ * takes every request queued before it runs, up to maxBatchSize.
+ *
+ * Recently decrypted tickets can be cached, so that a client reconnecting
+ * several times with the same ticket only costs one RPC.
+ *
+ * Thread safe. Must be owned by a shared_ptr so that pending batches can
+ * outlive the caller's reference.
+ */
+class RemoteTokenCipher
+    : public std::enable_shared_from_this<RemoteTokenCipher> {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  RemoteTokenCipher(
+      std::shared_ptr<TicketKeyService> service,
+      std::shared_ptr<folly::Executor> executor,
+      size_t maxBatchSize);
+
+  /**
+   * Cache up to size decrypted tickets for ttl. A cached ticket is still
+   * accepted for up to ttl after the service stops recognizing it. 0
+   * disables the cache (the default). Must not be called while requests are
+   * in flight.
+   */
+  void setDecryptCache(size_t size, std::chrono::milliseconds ttl);
+
+  /**
+   * Returns the token, or nullptr if the service couldn't encrypt it.
+   */
+  folly::Future<Buf> encrypt(Buf plaintext);
+
+  /**
+   * Returns the plaintext, or nullptr if the service didn't recognize the
+   * token.
+   */
+  folly::Future<Buf> decrypt(Buf token);
+
+ private:
+  enum class Operation { Encrypt, Decrypt };
+
+  struct Request {
+    Buf data;
+    // Cache key for decrypt requests.
+    std::string token;
+    folly::Promise<Buf> promise;
+  };
+
+  struct Pending {
+    std::deque<Request> requests;
+    bool scheduled{false};
+  };
+
+  struct CachedPlaintext {
+    Buf plaintext;
+    Clock::time_point expires;
+  };
+
+  folly::Future<Buf> enqueue(Operation operation, Request request);
+  void runBatch(Operation operation);
+  void finishBatch(
+      Operation operation,
+      std::vector<Request> batch,
+      folly::Try<std::vector<Buf>> results);
+
+  folly::Synchronized<Pending>& pending(Operation operation) {
+    return operation == Operation::Encrypt ? encrypts_ : decrypts_;
+  }
+
+  std::shared_ptr<TicketKeyService> service_;
+  std::shared_ptr<folly::Executor> executor_;
+  size_t maxBatchSize_;
+
+  folly::Synchronized<Pending> encrypts_;
+  folly::Synchronized<Pending> decrypts_;
+
+  using DecryptCache = folly::Synchronized<
+      folly::EvictingCacheMap<std::string, CachedPlaintext>>;
+
+  std::chrono::milliseconds cacheTtl_{0};
+  std::unique_ptr<DecryptCache> cache_;
+};
+
+/**
+ * TicketCipher that has tickets encrypted and decrypted by a central
+ * TicketKeyService, through a RemoteTokenCipher. Tickets are encoded and
+ * decoded locally with CodecType.
+ */
+template <typename CodecType>
+class RemoteTicketCipher : public TicketCipher {
+ public:
+  explicit RemoteTicketCipher(std::shared_ptr<RemoteTokenCipher> tokenCipher)
+      : tokenCipher_(std::move(tokenCipher)) {}
+
+  void setContext(const FizzServerContext* context) {
+    context_ = context;
+  }
+
+  void setValidity(std::chrono::seconds validity) {
+    validity_ = validity;
+  }
+
+  folly::Future<folly::Optional<std::pair<Buf, std::chrono::seconds>>> encrypt(
+      ResumptionState resState) const override {
+    auto encoded = CodecType::encode(std::move(resState));
+    return tokenCipher_->encrypt(std::move(encoded))
+        .then([validity = validity_](folly::Try<Buf> ticket)
+                  -> folly::Optional<std::pair<Buf, std::chrono::seconds>> {
+          if (ticket.hasException()) {
+            VLOG(6) << "Failed to encrypt ticket, ex="
+                    << ticket.exception().what();
+            return folly::none;
+          }
+          if (!*ticket) {
+            return folly::none;
+          }
+          return std::make_pair(std::move(*ticket), validity);
+        });
+  }
+
+  folly::Future<std::pair<PskType, folly::Optional<ResumptionState>>> decrypt(
+      std::unique_ptr<folly::IOBuf> encryptedTicket) const override {
+    return tokenCipher_->decrypt(std::move(encryptedTicket))
+        .then([context = context_](folly::Try<Buf> plaintext)
+                  -> std::pair<PskType, folly::Optional<ResumptionState>> {
+          if (plaintext.hasException()) {
+            VLOG(6) << "Failed to decrypt ticket, ex="
+                    << plaintext.exception().what();
+          } else if (*plaintext) {
+            try {
+              auto decoded = CodecType::decode(std::move(*plaintext), context);
+              return std::make_pair(PskType::Resumption, std::move(decoded));
+            } catch (const std::exception& ex) {
+              VLOG(6) << "Failed to decode ticket, ex=" << ex.what();
+            }
+          }
+          return std::make_pair(PskType::Rejected, folly::none);
+        });
+  }
+
+ private:
+  std::shared_ptr<RemoteTokenCipher> tokenCipher_;
+
+  std::chrono::seconds validity_{std::chrono::hours(1)};
+
+  const FizzServerContext* context_ = nullptr;
+};
+} // namespace server
+} // namespace fizz
@@ -27,6 +27,33 @@ struct ResumptionState {
   uint32_t ticketAgeAdd;
   std::chrono::system_clock::time_point ticketIssueTime;
   Buf appToken;
+
+  // Set when single-use tickets are enabled, see SingleUseTicketReplayCache.
+  folly::Optional<uint64_t> ticketId;
+
+  // SNI of the connection the ticket is issued on, for ticket ciphers to
+  // select keys with. Not stored in tickets.
+  folly::Optional<std::string> serverName;
 };
+
+/**
+ * Deep copy of state, the certificates are shared.
+ */
+inline ResumptionState cloneResumptionState(const ResumptionState& state) {
+  ResumptionState copy;
+  copy.version = state.version;
+  copy.cipher = state.cipher;
+  copy.resumptionSecret =
+      state.resumptionSecret ? state.resumptionSecret->clone() : nullptr;
+  copy.serverCert = state.serverCert;
+  copy.clientCert = state.clientCert;
+  copy.alpn = state.alpn;
+  copy.ticketAgeAdd = state.ticketAgeAdd;
+  copy.ticketIssueTime = state.ticketIssueTime;
+  copy.appToken = state.appToken ? state.appToken->clone() : nullptr;
+  copy.ticketId = state.ticketId;
+  copy.serverName = state.serverName;
+  return copy;
+}
 } // namespace server
 } // namespace fizz
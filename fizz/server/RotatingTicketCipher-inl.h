@@ -0,0 +1,198 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/crypto/Utils.h>
+
+namespace fizz {
+namespace server {
+
+static constexpr folly::StringPiece kTicketRotationLabel{"ticket rotation"};
+
+template <typename AeadType, typename CodecType, typename HkdfType>
+RotatingTicketCipher<AeadType, CodecType, HkdfType>::RotatingTicketCipher(
+    folly::ByteRange seed,
+    std::chrono::seconds rotationPeriod,
+    std::string pskContext)
+    : seed_(seed.begin(), seed.end()),
+      rotationPeriod_(rotationPeriod),
+      pskContext_(std::move(pskContext)) {
+  if (seed_.size() < kSecretLength) {
+    throw std::runtime_error("ticket rotation seed too small");
+  }
+  if (rotationPeriod_.count() <= 0) {
+    throw std::runtime_error("invalid ticket rotation period");
+  }
+  reset();
+}
+
+template <typename AeadType, typename CodecType, typename HkdfType>
+RotatingTicketCipher<AeadType, CodecType, HkdfType>::~RotatingTicketCipher() {
+  CryptoUtils::clean(folly::range(seed_));
+}
+
+template <typename AeadType, typename CodecType, typename HkdfType>
+uint64_t RotatingTicketCipher<AeadType, CodecType, HkdfType>::getPeriod(
+    Clock::time_point now) const {
+  auto sinceEpoch =
+      std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch());
+  if (sinceEpoch.count() < 0) {
+    return 0;
+  }
+  return sinceEpoch.count() / rotationPeriod_.count();
+}
+
+template <typename AeadType, typename CodecType, typename HkdfType>
+RotatingTicketCipher<AeadType, CodecType, HkdfType>::Params::~Params() {
+  CryptoUtils::clean(folly::range(seed));
+}
+
+template <typename AeadType, typename CodecType, typename HkdfType>
+std::shared_ptr<
+    const typename RotatingTicketCipher<AeadType, CodecType, HkdfType>::
+        Snapshot>
+RotatingTicketCipher<AeadType, CodecType, HkdfType>::getSnapshot(
+    Clock::time_point now) const {
+  auto period = getPeriod(now);
+  auto snapshot = current_.load();
+  // A clock going backwards keeps the current snapshot.
+  if (snapshot->period >= period) {
+    return snapshot;
+  }
+
+  std::unique_lock<std::mutex> lock(rotateMutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return snapshot;
+  }
+  snapshot = current_.load();
+  if (snapshot->period >= period) {
+    return snapshot;
+  }
+
+  auto next = next_->load();
+  if (!next || next->period != period) {
+    if (rotationExecutor_) {
+      prepareNext(period);
+      return snapshot;
+    }
+    next = buildSnapshot(getParams(), period);
+  }
+  current_.store(next);
+  prepareNext(period + 1);
+  VLOG(4) << "Rotated ticket secrets, period=" << period;
+  return next;
+}
+
+template <typename AeadType, typename CodecType, typename HkdfType>
+void RotatingTicketCipher<AeadType, CodecType, HkdfType>::prepareNext(
+    uint64_t period) const {
+  if (!rotationExecutor_) {
+    next_->store(buildSnapshot(getParams(), period));
+    return;
+  }
+  if (preparingPeriod_ == period) {
+    return;
+  }
+  preparingPeriod_ = period;
+  auto params = std::make_shared<const Params>(getParams());
+  std::weak_ptr<SnapshotSlot> weakNext = next_;
+  rotationExecutor_->add([params, weakNext, period]() {
+    auto snapshot = buildSnapshot(*params, period);
+    auto next = weakNext.lock();
+    if (!next) {
+      return;
+    }
+    // Don't replace a snapshot for a later period derived in the meantime.
+    auto expected = next->load();
+    while (!expected || expected->period < period) {
+      if (next->compare_exchange_weak(expected, snapshot)) {
+        break;
+      }
+    }
+  });
+}
+
+template <typename AeadType, typename CodecType, typename HkdfType>
+typename RotatingTicketCipher<AeadType, CodecType, HkdfType>::Params
+RotatingTicketCipher<AeadType, CodecType, HkdfType>::getParams() const {
+  return Params{seed_,
+                rotationPeriod_,
+                pskContext_,
+                validity_,
+                useKeyIds_,
+                context_};
+}
+
+template <typename AeadType, typename CodecType, typename HkdfType>
+std::shared_ptr<
+    const typename RotatingTicketCipher<AeadType, CodecType, HkdfType>::
+        Snapshot>
+RotatingTicketCipher<AeadType, CodecType, HkdfType>::buildSnapshot(
+    const Params& params,
+    uint64_t period) {
+  // Tickets issued up to validity ago are from at most this many periods
+  // back.
+  uint64_t previousPeriods =
+      (params.validity.count() + params.rotationPeriod.count() - 1) /
+      params.rotationPeriod.count();
+
+  // The current period's secret comes first, it is the one that encrypts.
+  std::vector<std::vector<uint8_t>> secrets;
+  secrets.push_back(deriveSecret(params, period));
+  secrets.push_back(deriveSecret(params, period + 1));
+  for (uint64_t i = 1; i <= previousPeriods && i <= period; ++i) {
+    secrets.push_back(deriveSecret(params, period - i));
+  }
+
+  auto snapshot = std::make_shared<Snapshot>(Snapshot{
+      period,
+      params.pskContext.empty() ? Cipher() : Cipher(params.pskContext)});
+  std::vector<folly::ByteRange> ranges;
+  for (const auto& secret : secrets) {
+    ranges.push_back(folly::range(secret));
+  }
+  snapshot->cipher.setTicketSecrets(ranges);
+  snapshot->cipher.setValidity(params.validity);
+  snapshot->cipher.setContext(params.context);
+  snapshot->cipher.setUseKeyIds(params.useKeyIds);
+
+  for (auto& secret : secrets) {
+    CryptoUtils::clean(folly::range(secret));
+  }
+  return snapshot;
+}
+
+template <typename AeadType, typename CodecType, typename HkdfType>
+std::vector<uint8_t>
+RotatingTicketCipher<AeadType, CodecType, HkdfType>::deriveSecret(
+    const Params& params,
+    uint64_t period) {
+  auto length = kTicketRotationLabel.size() + sizeof(uint64_t);
+  auto info = folly::IOBuf::create(length);
+  folly::io::Appender appender(info.get(), length);
+  appender.push(folly::range(kTicketRotationLabel));
+  appender.writeBE<uint64_t>(period);
+  auto secret =
+      HkdfType().expand(folly::range(params.seed), *info, kSecretLength);
+  auto range = secret->coalesce();
+  std::vector<uint8_t> result(range.begin(), range.end());
+  CryptoUtils::clean(
+      folly::MutableByteRange(secret->writableData(), secret->length()));
+  return result;
+}
+
+template <typename AeadType, typename CodecType, typename HkdfType>
+void RotatingTicketCipher<AeadType, CodecType, HkdfType>::reset() {
+  std::lock_guard<std::mutex> lock(rotateMutex_);
+  auto period = getPeriod(Clock::now());
+  auto params = getParams();
+  current_.store(buildSnapshot(params, period));
+  next_->store(buildSnapshot(params, period + 1));
+  preparingPeriod_ = folly::none;
+}
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,175 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/AeadTicketCipher.h>
+#include <folly/Executor.h>
+#include <folly/concurrency/AtomicSharedPtr.h>
+
+#include <mutex>
+
+namespace fizz {
+namespace server {
+
+/**
+ * TicketCipher that rotates its ticket secrets on a fixed schedule. Time is
+ * split into rotation periods, and the secret for each period is derived
+ * from a long-term seed, so that servers sharing the seed agree on the
+ * secrets without coordinating:
+ *
+ * period secret = HKDF-Expand(seed, "ticket rotation" | period number, 32)
+ *
+ * Tickets are encrypted with the current period's secret. Tickets from the
+ * next period (for servers whose clocks are ahead) and from as many
+ * previous periods as the ticket validity spans are accepted.
+ *
+ * The ciphers for a period are built and published atomically as an
+ * immutable snapshot, and the next period's snapshot is derived ahead of
+ * time, so that encrypts and decrypts only load a shared_ptr and never
+ * block on or observe a rotation in progress. With a rotation executor the
+ * snapshots are also derived there rather than by a handshake.
+ *
+ * Setters must be called before the cipher is in use.
+ */
+template <typename AeadType, typename CodecType, typename HkdfType>
+class RotatingTicketCipher : public TicketCipher {
+ public:
+  using Clock = std::chrono::system_clock;
+  using Cipher = AeadTicketCipher<AeadType, CodecType, HkdfType>;
+
+  static constexpr size_t kSecretLength = 32;
+
+  struct Snapshot {
+    uint64_t period;
+    Cipher cipher;
+  };
+
+  /**
+   * seed must be at least kSecretLength long. pskContext is used as for
+   * AeadTicketCipher.
+   */
+  RotatingTicketCipher(
+      folly::ByteRange seed,
+      std::chrono::seconds rotationPeriod,
+      std::string pskContext = "");
+
+  ~RotatingTicketCipher() override;
+
+  void setContext(const FizzServerContext* context) {
+    context_ = context;
+    reset();
+  }
+
+  /**
+   * Also determines how many previous periods' secrets are kept.
+   */
+  void setValidity(std::chrono::seconds validity) {
+    validity_ = validity;
+    reset();
+  }
+
+  /**
+   * See AeadTicketCipher::setUseKeyIds. Recommended, so that a ticket is
+   * only tried with the secret it was encrypted with.
+   */
+  void setUseKeyIds(bool useKeyIds) {
+    useKeyIds_ = useKeyIds;
+    reset();
+  }
+
+  /**
+   * Derive the snapshots for upcoming periods on executor, instead of on the
+   * thread that encrypts or decrypts when a period starts. Until the new
+   * period's snapshot is ready, the previous one keeps being used, as when
+   * another thread is rotating. Without an executor they are derived inline.
+   */
+  void setRotationExecutor(std::shared_ptr<folly::Executor> executor) {
+    rotationExecutor_ = std::move(executor);
+  }
+
+  folly::Future<folly::Optional<std::pair<Buf, std::chrono::seconds>>> encrypt(
+      ResumptionState resState) const override {
+    return getSnapshot(Clock::now())->cipher.encrypt(std::move(resState));
+  }
+
+  folly::Future<std::pair<PskType, folly::Optional<ResumptionState>>> decrypt(
+      std::unique_ptr<folly::IOBuf> encryptedTicket) const override {
+    return getSnapshot(Clock::now())
+        ->cipher.decrypt(std::move(encryptedTicket));
+  }
+
+  /**
+   * Rotation period that now falls in.
+   */
+  uint64_t getPeriod(Clock::time_point now) const;
+
+  /**
+   * Cipher for the period now falls in, rotating first if the published one
+   * is for an earlier period. If another thread is rotating, or the new
+   * period's snapshot is still being derived on the rotation executor, the
+   * previous snapshot is returned rather than waiting; it still encrypts
+   * with the previous period's secret, but already accepts the next
+   * period's tickets.
+   */
+  std::shared_ptr<const Snapshot> getSnapshot(Clock::time_point now) const;
+
+ private:
+  // What snapshots are derived from. Snapshots derived on the rotation
+  // executor hold their own copy, so they never refer back to the cipher.
+  struct Params {
+    ~Params();
+
+    std::vector<uint8_t> seed;
+    std::chrono::seconds rotationPeriod;
+    std::string pskContext;
+    std::chrono::seconds validity;
+    bool useKeyIds;
+    const FizzServerContext* context;
+  };
+
+  using SnapshotSlot = folly::atomic_shared_ptr<const Snapshot>;
+
+  static std::shared_ptr<const Snapshot> buildSnapshot(
+      const Params& params,
+      uint64_t period);
+
+  static std::vector<uint8_t> deriveSecret(
+      const Params& params,
+      uint64_t period);
+
+  Params getParams() const;
+
+  // Must be called with rotateMutex_ held.
+  void prepareNext(uint64_t period) const;
+
+  void reset();
+
+  std::vector<uint8_t> seed_;
+  std::chrono::seconds rotationPeriod_;
+  std::string pskContext_;
+
+  std::chrono::seconds validity_{std::chrono::hours(1)};
+  bool useKeyIds_{false};
+  const FizzServerContext* context_ = nullptr;
+
+  std::shared_ptr<folly::Executor> rotationExecutor_;
+
+  mutable folly::atomic_shared_ptr<const Snapshot> current_;
+  // Snapshot for a later period than current_, derived ahead of time. Shared
+  // with derivations running on the rotation executor.
+  std::shared_ptr<SnapshotSlot> next_{std::make_shared<SnapshotSlot>()};
+  // Only held while rotating. Also guards preparingPeriod_, the period last
+  // handed to the rotation executor.
+  mutable std::mutex rotateMutex_;
+  mutable folly::Optional<uint64_t> preparingPeriod_;
+};
+} // namespace server
+} // namespace fizz
+
+#include <fizz/server/RotatingTicketCipher-inl.h>
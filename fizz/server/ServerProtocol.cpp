@@ -9,19 +9,27 @@
 #include <fizz/server/ServerProtocol.h>
 
 #include <fizz/crypto/Utils.h>
+#include <fizz/crypto/exchange/X25519.h>
 #include <fizz/protocol/CertificateVerifier.h>
+#include <fizz/protocol/HandshakeTracer.h>
 #include <fizz/protocol/Protocol.h>
 #include <fizz/protocol/StateMachine.h>
+#include <fizz/protocol/TLSStats.h>
 #include <fizz/record/Extensions.h>
 #include <fizz/record/PlaintextRecordLayer.h>
 #include <fizz/server/AsyncSelfCert.h>
+#include <fizz/server/ClientHelloFingerprint.h>
 #include <fizz/server/Negotiator.h>
 #include <fizz/server/ReplayCache.h>
 #include <folly/Overload.h>
+#include <folly/executors/InlineExecutor.h>
+#include <folly/io/Cursor.h>
 #include <algorithm>
+#include <atomic>
 
 using folly::Future;
 using folly::Optional;
+using folly::SemiFuture;
 
 using namespace fizz::server;
 using namespace fizz::server::detail;
@@ -118,6 +126,13 @@ FIZZ_DECLARE_EVENT_HANDLER(
 
 namespace server {
 
+namespace detail {
+static AsyncActions processEvent(
+    const State& state,
+    sm::StateMachine<ServerTypes>::EventHandlerFun handler,
+    Param param);
+} // namespace detail
+
 AsyncActions ServerStateMachine::processAccept(
     const State& state,
     folly::Executor* executor,
@@ -140,10 +155,27 @@ AsyncActions ServerStateMachine::processSocketData(
           "attempting to process data without record layer",
           folly::none);
     }
-    auto param = state.readRecordLayer()->readEvent(buf);
+    auto result = state.readRecordLayer()->tryReadEvent(buf);
+    if (result.hasError()) {
+      return detail::handleError(
+          state, result.error().message, AlertDescription::decode_error);
+    }
+    auto& param = result.value();
     if (!param.hasValue()) {
       return actions(WaitForData());
     }
+    // Records read in AcceptingData are nearly all AppData, so call its
+    // handler without going through the event lookup.
+    if (state.state() == StateEnum::AcceptingData &&
+        boost::get<AppData>(&*param)) {
+      return detail::processEvent(
+          state,
+          &sm::EventHandler<
+              ServerTypes,
+              StateEnum::AcceptingData,
+              Event::AppData>::handle,
+          std::move(*param));
+    }
     return detail::processEvent(state, std::move(*param));
   } catch (const std::exception& e) {
     return detail::handleError(state, e.what(), AlertDescription::decode_error);
@@ -159,6 +191,15 @@ AsyncActions ServerStateMachine::processWriteNewSessionTicket(
 AsyncActions ServerStateMachine::processAppWrite(
     const State& state,
     AppWrite write) {
+  if (state.state() == StateEnum::AcceptingData) {
+    return detail::processEvent(
+        state,
+        &sm::EventHandler<
+            ServerTypes,
+            StateEnum::AcceptingData,
+            Event::AppWrite>::handle,
+        std::move(write));
+  }
   return detail::processEvent(state, std::move(write));
 }
 
@@ -176,11 +217,20 @@ namespace detail {
 
 AsyncActions processEvent(const State& state, Param param) {
   auto event = boost::apply_visitor(EventVisitor(), param);
+  return processEvent(
+      state,
+      sm::StateMachine<ServerTypes>::getHandler(state.state(), event),
+      std::move(param));
+}
+
+static AsyncActions processEvent(
+    const State& state,
+    sm::StateMachine<ServerTypes>::EventHandlerFun handler,
+    Param param) {
   // We can have an exception directly in the handler or in a future so we need
   // to handle both types.
   try {
-    auto actions = sm::StateMachine<ServerTypes>::getHandler(
-        state.state(), event)(state, std::move(param));
+    auto actions = handler(state, std::move(param));
 
     return folly::variant_match(
         actions,
@@ -217,6 +267,9 @@ Actions handleError(
     newState.state() = StateEnum::Error;
     newState.writeRecordLayer() = nullptr;
     newState.readRecordLayer() = nullptr;
+    if (newState.handshakeState()) {
+      newState.pendingHandshake() = nullptr;
+    }
   };
   if (alertDesc && state.writeRecordLayer()) {
     Alert alert(*alertDesc);
@@ -276,29 +329,151 @@ EventHandler<ServerTypes, StateEnum::Uninitialized, Event::Accept>::handle(
   auto& accept = boost::get<Accept>(param);
   auto factory = accept.context->getFactory();
   auto readRecordLayer = factory->makePlaintextReadRecordLayer();
+  readRecordLayer->setClientHelloLimits(
+      accept.context->getClientHelloLimits());
   auto writeRecordLayer = factory->makePlaintextWriteRecordLayer();
-  auto handshakeLogging = std::make_unique<HandshakeLogging>();
+  std::unique_ptr<HandshakeLogging> handshakeLogging;
+  if (accept.context->shouldCollectHandshakeLogging()) {
+    handshakeLogging = std::make_unique<HandshakeLogging>();
+  }
+  std::shared_ptr<HandshakeTimings> handshakeTimings;
+  if (TLSHistograms::enabled()) {
+    handshakeTimings = std::make_shared<HandshakeTimings>(
+        accept.context->getHandshakeTracer());
+  }
+  uint64_t handshakeId = 0;
+  if (accept.context->getHandshakeTracer()) {
+    handshakeId = HandshakeTracer::newHandshakeId();
+  }
+  std::unique_ptr<HandshakeAdmissionController::PendingHandshake>
+      pendingHandshake;
+  if (accept.context->getHandshakeAdmissionController()) {
+    pendingHandshake =
+        accept.context->getHandshakeAdmissionController()->startHandshake();
+  }
   return actions(
       [executor = accept.executor,
        rrl = std::move(readRecordLayer),
        wrl = std::move(writeRecordLayer),
        context = std::move(accept.context),
        handshakeLogging = std::move(handshakeLogging),
+       pendingHandshake = std::move(pendingHandshake),
+       handshakeTimings = std::move(handshakeTimings),
+       handshakeId,
        extensions = accept.extensions](State& newState) mutable {
         newState.executor() = executor;
+        newState.handshakeId() = handshakeId;
         newState.context() = std::move(context);
         newState.readRecordLayer() = std::move(rrl);
         newState.writeRecordLayer() = std::move(wrl);
         newState.handshakeLogging() = std::move(handshakeLogging);
+        newState.pendingHandshake() = std::move(pendingHandshake);
+        if (handshakeTimings) {
+          newState.handshakeTimings() = std::move(handshakeTimings);
+        }
         newState.extensions() = std::move(extensions);
       },
       &Transition<StateEnum::ExpectingClientHello>);
 }
 
-static void addHandshakeLogging(const State& state, const ClientHello& chlo) {
+/**
+ * The executor to continue after an asynchronous handshake step on. A step
+ * that has already completed, such as a synchronous signer or key exchange,
+ * is continued inline rather than on another turn of the executor.
+ */
+template <typename FutureType>
+static folly::Executor* getContinuationExecutor(
+    const State& state,
+    const FutureType& step) {
+  if (step.isReady()) {
+    return &folly::InlineExecutor::instance();
+  }
+  return state.executor();
+}
+
+/**
+ * Returns a future for the result of actions that sets cancelled when it is
+ * interrupted, as FizzServer does when the connection fails. Interrupts are
+ * not forwarded to the steps started while the actions are produced.
+ */
+static Future<Actions> setOnInterrupt(
+    Future<Actions> actions,
+    std::shared_ptr<std::atomic<bool>> cancelled) {
+  folly::Promise<Actions> promise;
+  promise.setInterruptHandler(
+      [cancelled = std::move(cancelled)](const folly::exception_wrapper&) {
+        cancelled->store(true);
+      });
+  auto future = promise.getFuture();
+  std::move(actions).then(
+      [promise = std::move(promise)](folly::Try<Actions>&& result) mutable {
+        promise.setTry(std::move(result));
+      });
+  return future;
+}
+
+/**
+ * Generates a key pair for kex and the shared secret with the client's
+ * share, on the handshake executor if there is one. The job owns kex as
+ * well, so that it stays alive if the handshake fails while the job is
+ * queued or running.
+ */
+static SemiFuture<Buf> generateSharedSecret(
+    const State& state,
+    std::shared_ptr<KeyExchange> kex,
+    Buf clientShare) {
+  auto handshakeExecutor = state.context()->getHandshakeExecutor();
+  if (handshakeExecutor) {
+    return folly::via(
+               handshakeExecutor,
+               [kex = std::move(kex), share = std::move(clientShare)]() {
+                 TLSStats::Timer timer(TLSCounter::KeyExchangeNanos);
+                 kex->generateKeyPair();
+                 return kex->generateSharedSecret(share->coalesce());
+               })
+        .semi();
+  }
+  TLSStats::Timer timer(TLSCounter::KeyExchangeNanos);
+  kex->generateKeyPair();
+  if (state.context()->getBatchX25519()) {
+    auto evb = dynamic_cast<folly::EventBase*>(state.executor());
+    auto x25519 = dynamic_cast<X25519KeyExchange*>(kex.get());
+    if (evb && x25519) {
+      x25519->setBatcher(&X25519Batcher::get(*evb));
+    }
+  }
+  return kex->generateSharedSecretAsync(clientShare->coalesce());
+}
+
+/*
+ * The handshake's timings while TLSHistograms are enabled (which forward to
+ * the context's tracer), and the context's tracer otherwise.
+ */
+static std::shared_ptr<HandshakeTracer> getHandshakeTracer(
+    const State& state) {
+  if (auto timings = state.handshakeTimings()) {
+    return timings;
+  }
+  return state.context()->getHandshakeTracer();
+}
+
+static void addHandshakeLogging(
+    const State& state,
+    const ClientHello& chlo,
+    const ExtensionIndex& extensions) {
+  if (state.handshakeLogging() &&
+      state.context()->getHandshakeLoggingMode() ==
+          HandshakeLoggingMode::Fingerprint) {
+    if (chlo.originalEncoding) {
+      state.handshakeLogging()->clientFingerprint =
+          getClientHelloFingerprint(**chlo.originalEncoding);
+    }
+    return;
+  }
+
   if (state.handshakeLogging()) {
     state.handshakeLogging()->clientLegacyVersion = chlo.legacy_version;
-    auto supportedVersions = getExtension<SupportedVersions>(chlo.extensions);
+    const auto& supportedVersions = extensions.get<SupportedVersions>();
     if (supportedVersions) {
       state.handshakeLogging()->clientSupportedVersions =
           supportedVersions->versions;
@@ -315,19 +490,20 @@ static void addHandshakeLogging(const State& state, const ClientHello& chlo) {
       state.handshakeLogging()->clientRecordVersion =
           plaintextReadRecord->getReceivedRecordVersion();
     }
-    auto sni = getExtension<ServerNameList>(chlo.extensions);
+    const auto& sni = extensions.get<ServerNameList>();
     if (sni && !sni->server_name_list.empty()) {
       state.handshakeLogging()->clientSni = sni->server_name_list.front()
-                                                .hostname->moveToFbString()
+                                                .hostname->clone()
+                                                ->moveToFbString()
                                                 .toStdString();
     }
-    auto supportedGroups = getExtension<SupportedGroups>(chlo.extensions);
+    const auto& supportedGroups = extensions.get<SupportedGroups>();
     if (supportedGroups) {
       state.handshakeLogging()->clientSupportedGroups =
-          std::move(supportedGroups->named_group_list);
+          supportedGroups->named_group_list;
     }
 
-    auto keyShare = getExtension<ClientKeyShare>(chlo.extensions);
+    const auto& keyShare = extensions.get<ClientKeyShare>();
     if (keyShare && !state.handshakeLogging()->clientKeyShares) {
       std::vector<NamedGroup> shares;
       for (const auto& entry : keyShare->client_shares) {
@@ -336,16 +512,15 @@ static void addHandshakeLogging(const State& state, const ClientHello& chlo) {
       state.handshakeLogging()->clientKeyShares = std::move(shares);
     }
 
-    auto exchangeModes = getExtension<PskKeyExchangeModes>(chlo.extensions);
+    const auto& exchangeModes = extensions.get<PskKeyExchangeModes>();
     if (exchangeModes) {
-      state.handshakeLogging()->clientKeyExchangeModes =
-          std::move(exchangeModes->modes);
+      state.handshakeLogging()->clientKeyExchangeModes = exchangeModes->modes;
     }
 
-    auto clientSigSchemes = getExtension<SignatureAlgorithms>(chlo.extensions);
+    const auto& clientSigSchemes = extensions.get<SignatureAlgorithms>();
     if (clientSigSchemes) {
       state.handshakeLogging()->clientSignatureAlgorithms =
-          std::move(clientSigSchemes->supported_signature_algorithms);
+          clientSigSchemes->supported_signature_algorithms;
     }
 
     state.handshakeLogging()->clientSessionIdSent =
@@ -365,9 +540,9 @@ static void validateClientHello(const ClientHello& chlo) {
 }
 
 static Optional<ProtocolVersion> negotiateVersion(
-    const ClientHello& chlo,
+    const ExtensionIndex& extensions,
     const std::vector<ProtocolVersion>& versions) {
-  const auto& clientVersions = getExtension<SupportedVersions>(chlo.extensions);
+  const auto& clientVersions = extensions.get<SupportedVersions>();
   if (!clientVersions) {
     return folly::none;
   }
@@ -379,11 +554,11 @@ static Optional<ProtocolVersion> negotiateVersion(
 }
 
 static Optional<CookieState> getCookieState(
-    const ClientHello& chlo,
+    const ExtensionIndex& extensions,
     ProtocolVersion version,
     CipherSuite cipher,
     const CookieCipher* cookieCipher) {
-  auto cookieExt = getExtension<Cookie>(chlo.extensions);
+  const auto& cookieExt = extensions.get<Cookie>();
   if (!cookieExt) {
     return folly::none;
   }
@@ -395,7 +570,7 @@ static Optional<CookieState> getCookieState(
         "no cookie cipher", AlertDescription::unsupported_extension);
   }
 
-  auto cookieState = cookieCipher->decrypt(std::move(cookieExt->cookie));
+  auto cookieState = cookieCipher->decrypt(cookieExt->cookie->clone());
 
   if (!cookieState) {
     throw FizzException(
@@ -415,6 +590,42 @@ static Optional<CookieState> getCookieState(
   return cookieState;
 }
 
+/**
+ * Returns an encoded stateless HelloRetryRequest if the admission controller
+ * requires this client to prove reachability before any key exchange or
+ * signing is done for it.
+ */
+static Optional<Buf> getStatelessRetry(
+    const State& state,
+    const ClientHello& chlo,
+    const Optional<CookieState>& cookieState) {
+  auto admission = state.context()->getHandshakeAdmissionController();
+  auto cookieCipher = state.context()->getCookieCipher();
+  if (!admission || !cookieCipher || cookieState ||
+      state.keyExchangeType().hasValue() ||
+      !admission->shouldRequireRetry()) {
+    return folly::none;
+  }
+
+  auto retryState = fizz::server::getCookieState(
+      *state.context()->getFactory(),
+      state.context()->getSupportedVersions(),
+      state.context()->getSupportedCiphers(),
+      state.context()->getSupportedGroups(),
+      chlo,
+      nullptr);
+  auto cookie = cookieCipher->encrypt(retryState);
+  if (!cookie) {
+    return folly::none;
+  }
+  return getStatelessHelloRetryRequest(
+      retryState.version,
+      retryState.cipher,
+      retryState.group,
+      std::move(*cookie),
+      chlo.legacy_session_id);
+}
+
 namespace {
 struct ResumptionStateResult {
   explicit ResumptionStateResult(
@@ -432,11 +643,14 @@ struct ResumptionStateResult {
 } // namespace
 
 static ResumptionStateResult getResumptionState(
-    const ClientHello& chlo,
+    const ExtensionIndex& extensions,
     const TicketCipher* ticketCipher,
-    const std::vector<PskKeyExchangeMode>& supportedModes) {
-  auto psks = getExtension<ClientPresharedKey>(chlo.extensions);
-  auto clientModes = getExtension<PskKeyExchangeModes>(chlo.extensions);
+    const Optional<std::string>& sni,
+    const std::vector<PskKeyExchangeMode>& supportedModes,
+    const std::shared_ptr<HandshakeTracer>& tracer,
+    uint64_t handshakeId) {
+  const auto& psks = extensions.get<ClientPresharedKey>();
+  const auto& clientModes = extensions.get<PskKeyExchangeModes>();
   if (psks && !clientModes) {
     throw FizzException("no psk modes", AlertDescription::missing_extension);
   }
@@ -461,23 +675,83 @@ static ResumptionStateResult getResumptionState(
         std::make_pair(PskType::Rejected, folly::none));
   } else {
     const auto& ident = psks->identities[kPskIndex].psk_identity;
+    TLSStats::Timer timer(TLSCounter::TicketNanos);
     return ResumptionStateResult(
-        ticketCipher->decrypt(ident->clone()),
+        detail::traceAsyncStep(
+            tracer,
+            handshakeId,
+            HandshakeStep::TicketDecrypt,
+            [&]() {
+              return ticketCipher->decryptForServerName(ident->clone(), sni);
+            }),
         pskMode,
         psks->identities[kPskIndex].obfuscated_ticket_age);
   }
 }
 
+static const Buf* getPskIdentity(const ExtensionIndex& extensions) {
+  const auto& psks = extensions.get<ClientPresharedKey>();
+  if (!psks || psks->identities.size() <= kPskIndex) {
+    return nullptr;
+  }
+  return &psks->identities[kPskIndex].psk_identity;
+}
+
+/*
+ * Reuses the PSK decrypted for the first ClientHello if the second offers the
+ * same one. Only the binder and ticket age are new.
+ */
+static Optional<ResumptionStateResult> getRetryResumptionState(
+    const HelloRetryState& retry,
+    const ExtensionIndex& extensions) {
+  auto ident = getPskIdentity(extensions);
+  if (!ident || !retry.pskIdentity ||
+      !folly::IOBufEqualTo()(*ident, retry.pskIdentity)) {
+    return folly::none;
+  }
+  Optional<ResumptionState> resState;
+  if (retry.resState) {
+    resState = cloneResumptionState(*retry.resState);
+  }
+  return ResumptionStateResult(
+      folly::makeFuture(std::make_pair(retry.pskType, std::move(resState))),
+      retry.pskMode,
+      extensions.get<ClientPresharedKey>()
+          ->identities[kPskIndex]
+          .obfuscated_ticket_age);
+}
+
 Future<ReplayCacheResult> getReplayCacheResult(
     const ClientHello& chlo,
+    const ExtensionIndex& extensions,
     bool zeroRttEnabled,
-    ReplayCache* replayCache) {
+    ReplayCache* replayCache,
+    const std::shared_ptr<HandshakeTracer>& tracer,
+    uint64_t handshakeId) {
   if (!zeroRttEnabled || !replayCache ||
-      !getExtension<ClientEarlyData>(chlo.extensions)) {
+      !extensions.get<ClientEarlyData>()) {
     return ReplayCacheResult::NotChecked;
   }
 
-  return replayCache->check(folly::range(chlo.random));
+  return detail::traceAsyncStep(
+      tracer, handshakeId, HandshakeStep::ReplayCache, [&]() {
+        return replayCache->check(folly::range(chlo.random));
+      });
+}
+
+static bool pskKeOffered(
+    const ExtensionIndex& extensions,
+    const std::vector<PskKeyExchangeMode>& supportedModes) {
+  const auto& clientModes = extensions.get<PskKeyExchangeModes>();
+  return clientModes &&
+      std::find(
+          clientModes->modes.begin(),
+          clientModes->modes.end(),
+          PskKeyExchangeMode::psk_ke) != clientModes->modes.end() &&
+      std::find(
+          supportedModes.begin(),
+          supportedModes.end(),
+          PskKeyExchangeMode::psk_ke) != supportedModes.end();
 }
 
 static bool validateResumptionState(
@@ -500,14 +774,124 @@ static bool validateResumptionState(
 
 static CipherSuite negotiateCipher(
     const ClientHello& chlo,
-    const std::vector<std::vector<CipherSuite>>& supportedCiphers) {
-  auto cipher = negotiate(supportedCiphers, chlo.cipher_suites);
+    const PreferenceTable<CipherSuite>& supportedCiphers) {
+  auto cipher = supportedCiphers.negotiate(chlo.cipher_suites);
   if (!cipher) {
     throw FizzException("no cipher match", AlertDescription::handshake_failure);
   }
   return *cipher;
 }
 
+// padding, not otherwise handled.
+static constexpr uint16_t kPaddingExtension = 21;
+
+static bool mayChangeAfterHelloRetry(ExtensionType type) {
+  switch (type) {
+    case ExtensionType::key_share:
+    case ExtensionType::key_share_old:
+    case ExtensionType::early_data:
+    case ExtensionType::cookie:
+    case ExtensionType::pre_shared_key:
+      return true;
+    default:
+      return static_cast<uint16_t>(type) == kPaddingExtension;
+  }
+}
+
+/*
+ * Checks that a ClientHello sent in response to a HelloRetryRequest only
+ * differs from the first in the ways RFC 8446 allows.
+ */
+static void validateRetryClientHello(
+    const HelloRetryState& retry,
+    const ClientHello& chlo) {
+  folly::IOBufEqualTo eq;
+  bool consistent = eq(retry.legacySessionId, chlo.legacy_session_id) &&
+      retry.cipherSuites == chlo.cipher_suites;
+  size_t unchanged = 0;
+  for (const auto& ext : chlo.extensions) {
+    if (!consistent) {
+      break;
+    }
+    if (mayChangeAfterHelloRetry(ext.extension_type)) {
+      continue;
+    }
+    ++unchanged;
+    auto it = std::find_if(
+        retry.unchangedExtensions.begin(),
+        retry.unchangedExtensions.end(),
+        [&ext](const Extension& previous) {
+          return previous.extension_type == ext.extension_type;
+        });
+    consistent = it != retry.unchangedExtensions.end() &&
+        eq(it->extension_data, ext.extension_data);
+  }
+  if (!consistent || unchanged != retry.unchangedExtensions.size()) {
+    throw FizzException(
+        "client hello changed after hello retry request",
+        AlertDescription::illegal_parameter);
+  }
+}
+
+static std::unique_ptr<HelloRetryState> makeHelloRetryState(
+    const ClientHello& chlo,
+    const ExtensionIndex& extensions,
+    PskType pskType,
+    const Optional<PskKeyExchangeMode>& pskMode,
+    const Optional<ResumptionState>& resState,
+    const Optional<std::string>& alpn,
+    const Optional<std::string>& sni) {
+  auto retry = std::make_unique<HelloRetryState>();
+  retry->legacySessionId =
+      chlo.legacy_session_id ? chlo.legacy_session_id->clone() : nullptr;
+  retry->cipherSuites = chlo.cipher_suites;
+  for (const auto& ext : chlo.extensions) {
+    if (!mayChangeAfterHelloRetry(ext.extension_type)) {
+      Extension copy;
+      copy.extension_type = ext.extension_type;
+      copy.extension_data = ext.extension_data->clone();
+      retry->unchangedExtensions.push_back(std::move(copy));
+    }
+  }
+  auto ident = getPskIdentity(extensions);
+  if (ident && *ident) {
+    retry->pskIdentity = (*ident)->clone();
+  }
+  retry->pskType = pskType;
+  retry->pskMode = pskMode;
+  if (resState) {
+    retry->resState = cloneResumptionState(*resState);
+  }
+  retry->alpn = alpn;
+  retry->sni = sni;
+  return retry;
+}
+
+/*
+ * Hashes length bytes of buf, starting at offset, into the transcript one
+ * buffer of the chain at a time, so a ClientHello spread over several reads
+ * doesn't have to be coalesced first.
+ */
+static void appendToTranscript(
+    HandshakeContext& handshakeContext,
+    const folly::IOBuf& buf,
+    size_t offset,
+    size_t length) {
+  for (auto range : buf) {
+    if (length == 0) {
+      return;
+    }
+    if (offset >= range.size()) {
+      offset -= range.size();
+      continue;
+    }
+    auto slice = range.subpiece(offset, length);
+    offset = 0;
+    length -= slice.size();
+    handshakeContext.appendToTranscript(slice);
+  }
+}
+
 /*
  * Sets up a KeyScheduler and HandshakeContext for the connection. The
  * KeyScheduler will have the early secret derived if applicable, and the
@@ -524,6 +908,7 @@ static std::
         const Factory& factory,
         CipherSuite cipher,
         const ClientHello& chlo,
+        const ExtensionIndex& extensions,
         const Optional<ResumptionState>& resState,
         const Optional<CookieState>& cookieState,
         PskType pskType,
@@ -543,12 +928,13 @@ static std::
     chloHash.hash = cookieState->chloHash->clone();
     handshakeContext->appendToTranscript(encodeHandshake(std::move(chloHash)));
 
-    auto cookie = getExtension<Cookie>(chlo.extensions);
+    const auto& cookie = extensions.get<Cookie>();
     handshakeContext->appendToTranscript(getStatelessHelloRetryRequest(
         cookieState->version,
         cookieState->cipher,
         cookieState->group,
-        std::move(cookie->cookie)));
+        cookie->cookie->clone(),
+        chlo.legacy_session_id));
   } else if (!handshakeContext) {
     handshakeContext = factory.makeHandshakeContext(cipher);
   }
@@ -561,26 +947,44 @@ static std::
                                      : EarlySecrets::ResumptionPskBinder,
         handshakeContext->getBlankContext());
 
-    folly::IOBufQueue chloQueue(folly::IOBufQueue::cacheChainLength());
-    chloQueue.append((*chlo.originalEncoding)->clone());
-    auto chloPrefix =
-        chloQueue.split(chloQueue.chainLength() - getBinderLength(chlo));
-    handshakeContext->appendToTranscript(chloPrefix);
+    // Hash the ClientHello in place, up to the binders for now.
+    const auto& encodedChlo = **chlo.originalEncoding;
+    auto chloLength = encodedChlo.computeChainDataLength();
+    auto binderLength = getBinderLength(chlo);
+    if (binderLength > chloLength) {
+      throw FizzException(
+          "invalid binder length", AlertDescription::illegal_parameter);
+    }
+    auto prefixLength = chloLength - binderLength;
+    appendToTranscript(*handshakeContext, encodedChlo, 0, prefixLength);
 
-    const auto& psks = getExtension<ClientPresharedKey>(chlo.extensions);
+    const auto& psks = extensions.get<ClientPresharedKey>();
     if (!psks || psks->binders.size() <= kPskIndex) {
       throw FizzException("no binders", AlertDescription::illegal_parameter);
     }
     auto expectedBinder =
         handshakeContext->getFinishedData(folly::range(binderKey));
-    if (!CryptoUtils::equal(
-            expectedBinder->coalesce(),
-            psks->binders[kPskIndex].binder->coalesce())) {
+    // The binder may also straddle buffers; compare a copy rather than
+    // coalescing the ClientHello underneath it.
+    const auto& binder = *psks->binders[kPskIndex].binder;
+    folly::ByteRange receivedBinder(binder.data(), binder.length());
+    std::array<uint8_t, kMaxHashLength> binderBuf;
+    if (binder.isChained()) {
+      auto binderSize = binder.computeChainDataLength();
+      if (binderSize > binderBuf.size()) {
+        throw FizzException(
+            "binder does not match", AlertDescription::bad_record_mac);
+      }
+      folly::io::Cursor(&binder).pull(binderBuf.data(), binderSize);
+      receivedBinder = folly::range(binderBuf).subpiece(0, binderSize);
+    }
+    if (!CryptoUtils::equal(expectedBinder->coalesce(), receivedBinder)) {
       throw FizzException(
           "binder does not match", AlertDescription::bad_record_mac);
     }
 
-    handshakeContext->appendToTranscript(chloQueue.move());
+    appendToTranscript(
+        *handshakeContext, encodedChlo, prefixLength, binderLength);
     return std::make_pair(std::move(scheduler), std::move(handshakeContext));
   } else {
     handshakeContext->appendToTranscript(*chlo.originalEncoding);
@@ -603,17 +1007,17 @@ static void validateGroups(const std::vector<KeyShareEntry>& client_shares) {
 
 static std::tuple<NamedGroup, Optional<Buf>> negotiateGroup(
     ProtocolVersion version,
-    const ClientHello& chlo,
-    const std::vector<NamedGroup>& supportedGroups) {
-  auto groups = getExtension<SupportedGroups>(chlo.extensions);
+    const ExtensionIndex& extensions,
+    const PreferenceTable<NamedGroup>& supportedGroups) {
+  const auto& groups = extensions.get<SupportedGroups>();
   if (!groups) {
     throw FizzException("no named groups", AlertDescription::missing_extension);
   }
-  auto group = negotiate(supportedGroups, groups->named_group_list);
+  auto group = supportedGroups.negotiate(groups->named_group_list);
   if (!group) {
     throw FizzException("no group match", AlertDescription::handshake_failure);
   }
-  auto clientShares = getExtension<ClientKeyShare>(chlo.extensions);
+  const auto& clientShares = extensions.get<ClientKeyShare>();
   if (!clientShares) {
     throw FizzException(
         "no client shares", AlertDescription::missing_extension);
@@ -643,18 +1047,6 @@ static std::tuple<NamedGroup, Optional<Buf>> negotiateGroup(
   return std::make_tuple(*group, folly::none);
 }
 
-static Buf doKex(
-    const Factory& factory,
-    NamedGroup group,
-    const Buf& clientShare,
-    KeyScheduler& scheduler) {
-  auto kex = factory.makeKeyExchange(group);
-  kex->generateKeyPair();
-  auto sharedSecret = kex->generateSharedSecret(clientShare->coalesce());
-  scheduler.deriveHandshakeSecret(sharedSecret->coalesce());
-  return kex->getKeyShare();
-}
-
 static Buf getHelloRetryRequest(
     ProtocolVersion version,
     CipherSuite cipher,
@@ -741,14 +1133,15 @@ static Buf getServerHello(
 }
 
 static Optional<std::string> negotiateAlpn(
-    const ClientHello& chlo,
+    const ExtensionIndex& extensions,
     folly::Optional<std::string> zeroRttAlpn,
     const FizzServerContext& context) {
-  auto ext = getExtension<ProtocolNameList>(chlo.extensions);
+  const auto& ext = extensions.get<ProtocolNameList>();
   std::vector<std::string> clientProtocols;
   if (ext) {
-    for (auto& protocol : ext->protocol_name_list) {
-      clientProtocols.push_back(protocol.name->moveToFbString().toStdString());
+    for (const auto& protocol : ext->protocol_name_list) {
+      clientProtocols.push_back(
+          protocol.name->clone()->moveToFbString().toStdString());
     }
   } else {
     VLOG(6) << "Client did not send ALPN extension";
@@ -764,7 +1157,8 @@ static Optional<std::string> negotiateAlpn(
 
 static Optional<std::chrono::milliseconds> getClockSkew(
     const Optional<ResumptionState>& psk,
-    Optional<uint32_t> obfuscatedAge) {
+    Optional<uint32_t> obfuscatedAge,
+    std::chrono::system_clock::time_point now) {
   if (!psk || !obfuscatedAge) {
     return folly::none;
   }
@@ -773,14 +1167,14 @@ static Optional<std::chrono::milliseconds> getClockSkew(
       static_cast<uint32_t>(*obfuscatedAge - psk->ticketAgeAdd));
 
   auto expected = std::chrono::duration_cast<std::chrono::milliseconds>(
-      std::chrono::system_clock::now() - psk->ticketIssueTime);
+      now - psk->ticketIssueTime);
 
   return std::chrono::milliseconds(age - expected);
 }
 
 static EarlyDataType negotiateEarlyDataType(
     bool acceptEarlyData,
-    const ClientHello& chlo,
+    const ExtensionIndex& extensions,
     const Optional<ResumptionState>& psk,
     CipherSuite cipher,
     Optional<KeyExchangeType> keyExchangeType,
@@ -790,7 +1184,7 @@ static EarlyDataType negotiateEarlyDataType(
     Optional<std::chrono::milliseconds> clockSkew,
     ClockSkewTolerance clockSkewTolerance,
     const AppTokenValidator* appTokenValidator) {
-  if (!getExtension<ClientEarlyData>(chlo.extensions)) {
+  if (!extensions.get<ClientEarlyData>()) {
     return EarlyDataType::NotAttempted;
   }
 
@@ -875,21 +1269,25 @@ static Buf getEncryptedExt(
   return encodedEncryptedExt;
 }
 
-static std::pair<std::shared_ptr<SelfCert>, SignatureScheme> chooseCert(
+static Optional<std::string> getSni(const ExtensionIndex& extensions) {
+  const auto& serverNameList = extensions.get<ServerNameList>();
+  if (serverNameList && !serverNameList->server_name_list.empty()) {
+    return serverNameList->server_name_list.front()
+        .hostname->clone()
+        ->moveToFbString()
+        .toStdString();
+  }
+  return folly::none;
+}
+
+static std::pair<std::shared_ptr<const SelfCert>, SignatureScheme> chooseCert(
     const FizzServerContext& context,
-    const ClientHello& chlo) {
-  const auto& clientSigSchemes =
-      getExtension<SignatureAlgorithms>(chlo.extensions);
+    const ExtensionIndex& extensions) {
+  const auto& clientSigSchemes = extensions.get<SignatureAlgorithms>();
   if (!clientSigSchemes) {
     throw FizzException("no sig schemes", AlertDescription::missing_extension);
   }
-  Optional<std::string> sni;
-  auto serverNameList = getExtension<ServerNameList>(chlo.extensions);
-  if (serverNameList && !serverNameList->server_name_list.empty()) {
-    sni = serverNameList->server_name_list.front()
-              .hostname->moveToFbString()
-              .toStdString();
-  }
+  auto sni = getSni(extensions);
 
   auto certAndScheme =
       context.getCert(sni, clientSigSchemes->supported_signature_algorithms);
@@ -897,17 +1295,100 @@ static std::pair<std::shared_ptr<SelfCert>, SignatureScheme> chooseCert(
     throw FizzException(
         "could not find suitable cert", AlertDescription::handshake_failure);
   }
-  return *certAndScheme;
+
+  const auto& credentialSchemes = extensions.get<DelegatedCredentialSupport>();
+  if (credentialSchemes) {
+    auto delegated = certAndScheme->first->getDelegatedCert(
+        credentialSchemes->supported_signature_algorithms,
+        clientSigSchemes->supported_signature_algorithms);
+    if (delegated) {
+      auto scheme = delegated->getSigSchemes().front();
+      return std::make_pair(std::move(delegated), scheme);
+    }
+  }
+  return std::make_pair(
+      std::shared_ptr<const SelfCert>(std::move(certAndScheme->first)),
+      certAndScheme->second);
+}
+
+static Optional<Extension> getServerCertType(
+    const SelfCert& serverCert,
+    const ExtensionIndex& extensions) {
+  auto certType = serverCert.getCertificateType();
+  const auto& clientCertTypes = extensions.get<ServerCertTypeList>();
+  if (!clientCertTypes) {
+    if (certType != CertificateType::X509) {
+      throw FizzException(
+          "client does not support raw public keys",
+          AlertDescription::unsupported_certificate);
+    }
+    return folly::none;
+  }
+  const auto& types = clientCertTypes->certificate_types;
+  if (std::find(types.begin(), types.end(), certType) == types.end()) {
+    throw FizzException(
+        folly::to<std::string>(
+            "client does not support certificate type ", toString(certType)),
+        AlertDescription::unsupported_certificate);
+  }
+  ServerCertType ext;
+  ext.certificate_type = certType;
+  return encodeExtension(std::move(ext));
 }
 
 static Buf getCertificate(
     const std::shared_ptr<const SelfCert>& serverCert,
+    const FizzServerContext& context,
+    const ExtensionIndex& extensions,
     HandshakeContext& handshakeContext) {
-  auto encodedCertificate = encodeHandshake(serverCert->getCertMessage());
+  std::vector<ExtensionType> requestedEntryExtensions;
+  const auto& statusRequest = extensions.get<CertificateStatusRequest>();
+  if (statusRequest &&
+      statusRequest->status_type == CertificateStatusType::ocsp) {
+    requestedEntryExtensions.push_back(ExtensionType::status_request);
+  }
+  if (extensions.get<SignedCertificateTimestamps>()) {
+    requestedEntryExtensions.push_back(
+        ExtensionType::signed_certificate_timestamp);
+  }
+
+  // Stapled messages are not precompressed, so they take precedence over
+  // certificate compression.
+  Buf encodedCertificate;
+  if (!requestedEntryExtensions.empty()) {
+    encodedCertificate =
+        serverCert->getStapledCertMessage(requestedEntryExtensions);
+  }
+  const auto& compressionAlgos =
+      extensions.get<CertificateCompressionAlgorithms>();
+  if (!encodedCertificate && compressionAlgos) {
+    auto compressed =
+        context.getCompressedCert(*serverCert, compressionAlgos->algorithms);
+    if (compressed) {
+      encodedCertificate = std::move(*compressed);
+    }
+  }
+  if (!encodedCertificate) {
+    encodedCertificate = serverCert->getEncodedCertMessage();
+  }
   handshakeContext.appendToTranscript(encodedCertificate);
   return encodedCertificate;
 }
 
+static Future<Optional<Buf>> signCertificateVerify(
+    const std::shared_ptr<const SelfCert>& cert,
+    SignatureScheme sigScheme,
+    folly::ByteRange toBeSigned) {
+  TLSStats::Timer timer(TLSCounter::SignNanos);
+  auto asyncSelfCert = dynamic_cast<const AsyncSelfCert*>(cert.get());
+  if (asyncSelfCert) {
+    return asyncSelfCert->signFuture(
+        sigScheme, CertificateVerifyContext::Server, toBeSigned);
+  } else {
+    return cert->sign(sigScheme, CertificateVerifyContext::Server, toBeSigned);
+  }
+}
+
 static Buf getCertificateVerify(
     SignatureScheme sigScheme,
     Buf signature,
@@ -943,16 +1424,35 @@ AsyncActions
 EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
     handle(const State& state, Param param) {
   auto chlo = std::move(boost::get<ClientHello>(param));
+  // Built once, every lookup below goes through it.
+  ExtensionIndex extensions(chlo.extensions);
 
-  addHandshakeLogging(state, chlo);
+  addHandshakeLogging(state, chlo, extensions);
+
+  if (!state.keyExchangeType() && chlo.originalEncoding &&
+      state.context()->getClientHelloCapture()) {
+    state.context()->getClientHelloCapture()->capture(**chlo.originalEncoding);
+  }
 
   if (state.readRecordLayer()->hasUnparsedHandshakeData()) {
     throw FizzException(
         "data after client hello", AlertDescription::unexpected_message);
   }
 
+  // Routing is only offered before anything has been sent, after a
+  // HelloRetryRequest the connection has to stay here.
+  if (!state.keyExchangeType() &&
+      state.context()->shouldRouteClientHello(chlo)) {
+    VLOG(8) << "Routing ClientHello";
+    RouteClientHello route;
+    route.clientHello = PlaintextWriteRecordLayer().writeInitialClientHello(
+        (*chlo.originalEncoding)->clone());
+    route.chlo = std::move(chlo);
+    return actions(&Transition<StateEnum::Error>, std::move(route));
+  }
+
   auto version =
-      negotiateVersion(chlo, state.context()->getSupportedVersions());
+      negotiateVersion(extensions, state.context()->getSupportedVersions());
 
   if (state.version().hasValue() &&
       (!version || *version != *state.version())) {
@@ -962,7 +1462,7 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
   }
 
   if (!version) {
-    if (getExtension<ClientEarlyData>(chlo.extensions)) {
+    if (extensions.get<ClientEarlyData>()) {
       throw FizzException(
           "supported version mismatch with early data",
           AlertDescription::protocol_version);
@@ -986,36 +1486,140 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
 
   validateClientHello(chlo);
 
-  auto cipher = negotiateCipher(chlo, state.context()->getSupportedCiphers());
+  // After a HelloRetryRequest the second ClientHello only has to be
+  // consistent with the first, and what was negotiated for that is reused.
+  auto retry = state.helloRetryState();
+  if (retry) {
+    validateRetryClientHello(*retry, chlo);
+  }
+
+  auto cipher = retry
+      ? *state.cipher()
+      : negotiateCipher(chlo, state.context()->getCipherPreferences());
 
   auto cookieState = getCookieState(
-      chlo, *version, cipher, state.context()->getCookieCipher());
+      extensions, *version, cipher, state.context()->getCookieCipher());
 
-  auto resStateResult = getResumptionState(
-      chlo,
-      state.context()->getTicketCipher(),
-      state.context()->getSupportedPskModes());
+  auto statelessRetry = getStatelessRetry(state, chlo, cookieState);
+  if (statelessRetry) {
+    VLOG(8) << "Requiring stateless retry";
+    WriteToSocket write;
+    write.data =
+        state.writeRecordLayer()->writeHandshake(std::move(*statelessRetry));
+
+    // Nothing from this ClientHello is kept, the second ClientHello is
+    // validated with the cookie alone. Any early data has to be skipped.
+    auto newReadRecordLayer =
+        state.context()->getFactory()->makePlaintextReadRecordLayer();
+    newReadRecordLayer->setSkipEncryptedRecords(
+        extensions.get<ClientEarlyData>().hasValue());
+    newReadRecordLayer->setClientHelloLimits(
+        state.context()->getClientHelloLimits());
+
+    return actions(
+        [newReadRecordLayer =
+             std::move(newReadRecordLayer)](State& newState) mutable {
+          newState.readRecordLayer() = std::move(newReadRecordLayer);
+        },
+        std::move(write),
+        &Transition<StateEnum::ExpectingClientHello>);
+  }
+
+  auto retryResState =
+      retry ? getRetryResumptionState(*retry, extensions) : folly::none;
+  auto resStateResult = retryResState
+      ? std::move(*retryResState)
+      : getResumptionState(
+            extensions,
+            state.context()->getTicketCipher(),
+            getSni(extensions),
+            state.context()->getSupportedPskModes(),
+            getHandshakeTracer(state),
+            state.handshakeId());
 
   auto replayCacheResultFuture = getReplayCacheResult(
       chlo,
+      extensions,
       state.context()->getAcceptEarlyData(*version),
-      state.context()->getReplayCache());
+      state.context()->getReplayCache(),
+      getHandshakeTracer(state),
+      state.handshakeId());
+
+  // Certificates may be loaded on demand, start loading the one we are likely
+  // to choose while the ticket is decrypted.
+  auto certPrefetch = state.context()->prefetchCert(getSni(extensions));
+
+  // A trusted client may be resumed with psk_ke once its ticket is decrypted.
+  auto pskKeAllowed = resStateResult.pskMode && !state.group() &&
+      state.context()->hasPskKeResumptionPolicy() &&
+      pskKeOffered(extensions, state.context()->getSupportedPskModes());
+
+  // Unless the client only offered psk_ke the key exchange is needed whether
+  // or not its PSK is accepted, so start it while the ticket is decrypted. If
+  // there is no usable key share it is left for the HelloRetryRequest path,
+  // and if the group doesn't match the one negotiated before (by a
+  // HelloRetryRequest or in the cookie) for the checks that reject it.
+  Optional<NamedGroup> speculativeGroup;
+  std::shared_ptr<KeyExchange> speculativeKex;
+  Future<Buf> speculativeSharedSecret = folly::makeFuture<Buf>(nullptr);
+  if (!pskKeAllowed &&
+      (!resStateResult.pskMode ||
+       *resStateResult.pskMode != PskKeyExchangeMode::psk_ke)) {
+    NamedGroup negotiatedGroup;
+    Optional<Buf> clientShare;
+    std::tie(negotiatedGroup, clientShare) = negotiateGroup(
+        *version, extensions, state.context()->getGroupPreferences());
+    auto groupMismatch =
+        (state.group() && negotiatedGroup != *state.group()) ||
+        (cookieState && cookieState->group &&
+         negotiatedGroup != *cookieState->group);
+    if (clientShare && !groupMismatch) {
+      speculativeGroup = negotiatedGroup;
+      speculativeKex =
+          state.context()->getFactory()->makeKeyExchange(
+              negotiatedGroup, Factory::KeyExchangeMode::Server);
+      speculativeSharedSecret = detail::traceAsyncStep(
+          getHandshakeTracer(state),
+          state.handshakeId(),
+          HandshakeStep::KeyExchange,
+          [&]() {
+            auto sharedSecret = generateSharedSecret(
+                state, speculativeKex, std::move(*clientShare));
+            auto executor = getContinuationExecutor(state, sharedSecret);
+            return std::move(sharedSecret).via(executor);
+          });
+    }
+  }
 
-  auto results =
-      collectAll(resStateResult.futureResState, replayCacheResultFuture);
+  auto results = collectAll(
+      resStateResult.futureResState,
+      replayCacheResultFuture,
+      certPrefetch,
+      speculativeSharedSecret);
 
   using FutureResultType = std::tuple<
       folly::Try<std::pair<PskType, Optional<ResumptionState>>>,
-      folly::Try<ReplayCacheResult>>;
-  return results.via(state.executor())
+      folly::Try<ReplayCacheResult>,
+      folly::Try<folly::Unit>,
+      folly::Try<Buf>>;
+  // Set if the connection gives up on the handshake, so that signing still
+  // queued in the HandshakeScheduler is dropped rather than run.
+  auto signingCancelled = std::make_shared<std::atomic<bool>>(false);
+  auto resultsExecutor = getContinuationExecutor(state, results);
+  auto futureActions = results.via(resultsExecutor)
       .then([&state,
              chlo = std::move(chlo),
+             extensions = std::move(extensions),
              cookieState = std::move(cookieState),
              version = *version,
              cipher,
+             retry,
              pskMode = resStateResult.pskMode,
-             obfuscatedAge = resStateResult.obfuscatedAge](
-                FutureResultType result) mutable {
+             pskKeAllowed,
+             obfuscatedAge = resStateResult.obfuscatedAge,
+             speculativeGroup,
+             speculativeKex = std::move(speculativeKex),
+             signingCancelled](FutureResultType result) mutable {
         auto& resumption = *std::get<0>(result);
         auto pskType = resumption.first;
         auto resState = std::move(resumption.second);
@@ -1026,11 +1630,30 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
             pskType = PskType::Rejected;
             pskMode = folly::none;
             resState = folly::none;
+          } else if (
+              pskKeAllowed &&
+              state.context()->shouldResumeWithPskKe(*resState)) {
+            VLOG(8) << "Resuming trusted client with psk_ke.";
+            pskMode = PskKeyExchangeMode::psk_ke;
           }
         } else {
           pskMode = folly::none;
         }
 
+        auto singleUseTickets = state.context()->getSingleUseTickets();
+        if (resState && resState->ticketId && singleUseTickets &&
+            state.context()->getAcceptEarlyData(version) &&
+            extensions.get<ClientEarlyData>()) {
+          // Only consumed when early data is offered, so that tickets can
+          // still be used any number of times for plain resumption.
+          auto ticketResult = singleUseTickets->consume(
+              *resState->ticketId, state.context()->getFactory()->now());
+          if (replayCacheResult == ReplayCacheResult::NotChecked ||
+              ticketResult != ReplayCacheResult::NotReplay) {
+            replayCacheResult = ticketResult;
+          }
+        }
+
         Buf legacySessionId;
         auto realVersion = getRealDraftVersion(version);
         if (realVersion == ProtocolVersion::tls_1_3_20 ||
@@ -1046,6 +1669,7 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
             *state.context()->getFactory(),
             cipher,
             chlo,
+            extensions,
             resState,
             cookieState,
             pskType,
@@ -1058,13 +1682,17 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
               AlertDescription::illegal_parameter);
         }
 
-        auto alpn = negotiateAlpn(chlo, folly::none, *state.context());
+        auto alpn = retry
+            ? retry->alpn
+            : negotiateAlpn(extensions, folly::none, *state.context());
+        auto sni = retry ? retry->sni : getSni(extensions);
 
-        auto clockSkew = getClockSkew(resState, obfuscatedAge);
+        auto clockSkew = getClockSkew(
+            resState, obfuscatedAge, state.context()->getFactory()->now());
 
         auto earlyDataType = negotiateEarlyDataType(
             state.context()->getAcceptEarlyData(version),
-            chlo,
+            extensions,
             resState,
             cipher,
             state.keyExchangeType(),
@@ -1076,13 +1704,16 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
             state.appTokenValidator());
 
         std::unique_ptr<EncryptedReadRecordLayer> earlyReadRecordLayer;
-        Buf earlyExporterMaster;
+        DeferredSecret<Buf> earlyExporterMaster;
         if (earlyDataType == EarlyDataType::Accepted) {
           auto earlyContext = handshakeContext->getHandshakeContext();
 
           earlyReadRecordLayer =
-              state.context()->getFactory()->makeEncryptedReadRecordLayer();
+              state.context()->getFactory()->makeEncryptedReadRecordLayer(
+                  EncryptionLevel::EarlyData);
           earlyReadRecordLayer->setProtocolVersion(version);
+          earlyReadRecordLayer->setCoalesceAppData(
+              state.context()->getCoalesceAppData());
           auto earlyReadSecret = scheduler->getSecret(
               EarlySecrets::ClientEarlyTraffic, earlyContext->coalesce());
           Protocol::setAead(
@@ -1092,18 +1723,28 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
               *state.context()->getFactory(),
               *scheduler);
 
-          earlyExporterMaster =
-              folly::IOBuf::copyBuffer(folly::range(scheduler->getSecret(
-                  EarlySecrets::EarlyExporter, earlyContext->coalesce())));
+          earlyExporterMaster = DeferredSecret<Buf>(
+              [derive = scheduler->getDeferredSecret(
+                   EarlySecrets::EarlyExporter,
+                   earlyContext->coalesce())]() mutable {
+                return folly::IOBuf::copyBuffer(folly::range(derive()));
+              });
         }
 
         Optional<NamedGroup> group;
-        Optional<Buf> serverShare;
+        Optional<Buf> clientShare;
+        std::shared_ptr<KeyExchange> kex;
+        SemiFuture<Buf> sharedSecret = folly::makeSemiFuture<Buf>(nullptr);
         KeyExchangeType keyExchangeType;
-        if (!pskMode || *pskMode != PskKeyExchangeMode::psk_ke) {
-          Optional<Buf> clientShare;
+        if (speculativeKex) {
+          keyExchangeType =
+              state.keyExchangeType().value_or(KeyExchangeType::OneRtt);
+          group = speculativeGroup;
+          kex = std::move(speculativeKex);
+          sharedSecret = folly::makeSemiFuture(std::move(std::get<3>(result)));
+        } else if (!pskMode || *pskMode != PskKeyExchangeMode::psk_ke) {
           std::tie(group, clientShare) = negotiateGroup(
-              version, chlo, state.context()->getSupportedGroups());
+              version, extensions, state.context()->getGroupPreferences());
           if (!clientShare) {
             VLOG(8) << "Did not find key share for " << toString(*group);
             if (state.group().hasValue() || cookieState) {
@@ -1134,6 +1775,9 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
                 legacySessionId ? legacySessionId->clone() : nullptr,
                 *handshakeContext);
 
+            auto helloRetryState = makeHelloRetryState(
+                chlo, extensions, pskType, pskMode, resState, alpn, sni);
+
             WriteToSocket write;
             write.data = state.writeRecordLayer()->writeHandshake(
                 std::move(encodedHelloRetryRequest));
@@ -1148,6 +1792,8 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
                 state.context()->getFactory()->makePlaintextReadRecordLayer();
             newReadRecordLayer->setSkipEncryptedRecords(
                 earlyDataType == EarlyDataType::Rejected);
+            newReadRecordLayer->setClientHelloLimits(
+                state.context()->getClientHelloLimits());
 
             return Future<Actions>(actions(
                 [handshakeContext = std::move(handshakeContext),
@@ -1156,13 +1802,13 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
                  group,
                  earlyDataType,
                  replayCacheResult,
+                 helloRetryState = std::move(helloRetryState),
                  newReadRecordLayer =
                      std::move(newReadRecordLayer)](State& newState) mutable {
-                  // Save some information about the current state to be
-                  // validated when we get the second client hello. We don't
-                  // validate that the second client hello matches the first as
-                  // strictly as we could according to the spec however.
+                  // Save what was negotiated, the second client hello is
+                  // validated against it and reuses it.
                   newState.handshakeContext() = std::move(handshakeContext);
+                  newState.helloRetryState() = std::move(helloRetryState);
                   newState.version() = version;
                   newState.cipher() = cipher;
                   newState.group() = group;
@@ -1182,11 +1828,8 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
             keyExchangeType = KeyExchangeType::OneRtt;
           }
 
-          serverShare = doKex(
-              *state.context()->getFactory(), *group, *clientShare, *scheduler);
         } else {
           keyExchangeType = KeyExchangeType::None;
-          scheduler->deriveHandshakeSecret();
         }
 
         std::vector<Extension> additionalExtensions;
@@ -1210,297 +1853,449 @@ EventHandler<ServerTypes, StateEnum::ExpectingClientHello, Event::ClientHello>::
               AlertDescription::illegal_parameter);
         }
 
-        auto encodedServerHello = getServerHello(
-            version,
-            state.context()->getFactory()->makeRandom(),
-            cipher,
-            resState.hasValue(),
-            group,
-            std::move(serverShare),
-            legacySessionId ? legacySessionId->clone() : nullptr,
-            *handshakeContext);
-
-        // Derive handshake keys.
-        auto handshakeWriteRecordLayer =
-            state.context()->getFactory()->makeEncryptedWriteRecordLayer();
-        handshakeWriteRecordLayer->setProtocolVersion(version);
-        auto handshakeWriteSecret = scheduler->getSecret(
-            HandshakeSecrets::ServerHandshakeTraffic,
-            handshakeContext->getHandshakeContext()->coalesce());
-        Protocol::setAead(
-            *handshakeWriteRecordLayer,
-            cipher,
-            folly::range(handshakeWriteSecret),
-            *state.context()->getFactory(),
-            *scheduler);
-
-        auto handshakeReadRecordLayer =
-            state.context()->getFactory()->makeEncryptedReadRecordLayer();
-        handshakeReadRecordLayer->setProtocolVersion(version);
-        handshakeReadRecordLayer->setSkipFailedDecryption(
-            earlyDataType == EarlyDataType::Rejected);
-        auto handshakeReadSecret = scheduler->getSecret(
-            HandshakeSecrets::ClientHandshakeTraffic,
-            handshakeContext->getHandshakeContext()->coalesce());
-        Protocol::setAead(
-            *handshakeReadRecordLayer,
-            cipher,
-            folly::range(handshakeReadSecret),
-            *state.context()->getFactory(),
-            *scheduler);
-        auto clientHandshakeSecret =
-            folly::IOBuf::copyBuffer(folly::range(handshakeReadSecret));
-
-        auto encodedEncryptedExt = getEncryptedExt(
-            *handshakeContext,
-            alpn,
-            earlyDataType,
-            std::move(additionalExtensions));
-
-        /*
-         * Determine we are requesting client auth.
-         * If yes, add CertificateRequest to handshake write and transcript.
-         */
-        bool requestClientAuth =
-            state.context()->getClientAuthMode() != ClientAuthMode::None &&
-            !resState;
-        Optional<Buf> encodedCertRequest;
-        if (requestClientAuth) {
-          encodedCertRequest = getCertificateRequest(
-              state.context()->getSupportedSigSchemes(),
-              state.context()->getClientCertVerifier().get(),
-              *handshakeContext);
-        }
-
-        /*
-         * Set the cert and signature scheme we are using.
-         * If sending new cert, add Certificate to handshake write and
-         * transcript.
-         */
-        Optional<Buf> encodedCertificate;
-        Future<Optional<Buf>> signature = folly::none;
-        Optional<SignatureScheme> sigScheme;
-        Optional<std::shared_ptr<const Cert>> serverCert;
-        std::shared_ptr<const Cert> clientCert;
-        if (!resState) { // TODO or reauth
-          std::shared_ptr<const SelfCert> originalSelfCert;
-          std::tie(originalSelfCert, sigScheme) =
-              chooseCert(*state.context(), chlo);
-
-          encodedCertificate =
-              getCertificate(originalSelfCert, *handshakeContext);
-
-          auto toBeSigned = handshakeContext->getHandshakeContext();
-          auto asyncSelfCert =
-              dynamic_cast<const AsyncSelfCert*>(originalSelfCert.get());
-          if (asyncSelfCert) {
-            signature = asyncSelfCert->signFuture(
-                *sigScheme,
-                CertificateVerifyContext::Server,
-                toBeSigned->coalesce());
-          } else {
-            signature = originalSelfCert->sign(
-                *sigScheme,
-                CertificateVerifyContext::Server,
-                toBeSigned->coalesce());
-          }
-          serverCert = std::move(originalSelfCert);
-        } else {
-          serverCert = std::move(resState->serverCert);
-          clientCert = std::move(resState->clientCert);
+        // Only start the key exchange once the group is known to be
+        // acceptable.
+        if (clientShare) {
+          kex = state.context()->getFactory()->makeKeyExchange(
+              *group, Factory::KeyExchangeMode::Server);
+          sharedSecret =
+              generateSharedSecret(state, kex, std::move(*clientShare));
         }
 
-        return signature.via(state.executor())
+        // If signing is queued, clients that have already spent a round trip
+        // on this connection go ahead of new ones.
+        auto signingPriority =
+            (cookieState || state.keyExchangeType().hasValue() ||
+             pskType == PskType::Rejected)
+            ? HandshakeScheduler::Priority::High
+            : HandshakeScheduler::Priority::Normal;
+
+        // The key exchange may complete asynchronously, everything from the
+        // ServerHello on depends on its result.
+        auto sharedSecretExecutor =
+            getContinuationExecutor(state, sharedSecret);
+        return std::move(sharedSecret)
+            .via(sharedSecretExecutor)
             .then([&state,
+                   chlo = std::move(chlo),
+                   extensions = std::move(extensions),
+                   kex = std::move(kex),
                    scheduler = std::move(scheduler),
                    handshakeContext = std::move(handshakeContext),
+                   version,
                    cipher,
                    group,
-                   encodedServerHello = std::move(encodedServerHello),
-                   handshakeWriteRecordLayer =
-                       std::move(handshakeWriteRecordLayer),
-                   handshakeWriteSecret = std::move(handshakeWriteSecret),
-                   handshakeReadRecordLayer =
-                       std::move(handshakeReadRecordLayer),
-                   earlyReadRecordLayer = std::move(earlyReadRecordLayer),
-                   earlyExporterMaster = std::move(earlyExporterMaster),
-                   clientHandshakeSecret = std::move(clientHandshakeSecret),
-                   encodedEncryptedExt = std::move(encodedEncryptedExt),
-                   encodedCertificate = std::move(encodedCertificate),
-                   encodedCertRequest = std::move(encodedCertRequest),
-                   requestClientAuth,
-                   pskType,
-                   pskMode,
-                   sigScheme,
-                   version,
                    keyExchangeType,
                    earlyDataType,
                    replayCacheResult,
-                   serverCert = std::move(serverCert),
-                   clientCert = std::move(clientCert),
+                   pskType,
+                   pskMode,
+                   signingPriority,
+                   signingCancelled,
+                   resState = std::move(resState),
                    alpn = std::move(alpn),
+                   sni = std::move(sni),
                    clockSkew,
-                   legacySessionId =
-                       std::move(legacySessionId)](Optional<Buf> sig) mutable {
-              Optional<Buf> encodedCertificateVerify;
-              if (sig) {
-                encodedCertificateVerify = getCertificateVerify(
-                    *sigScheme, std::move(*sig), *handshakeContext);
-              }
-
-              auto encodedFinished = Protocol::getFinished(
-                  folly::range(handshakeWriteSecret), *handshakeContext);
-
-              folly::IOBufQueue combined;
-              if (encodedCertificate) {
-                if (encodedCertRequest) {
-                  combined.append(std::move(encodedEncryptedExt));
-                  combined.append(std::move(*encodedCertRequest));
-                  combined.append(std::move(*encodedCertificate));
-                  combined.append(std::move(*encodedCertificateVerify));
-                  combined.append(std::move(encodedFinished));
-                } else {
-                  combined.append(std::move(encodedEncryptedExt));
-                  combined.append(std::move(*encodedCertificate));
-                  combined.append(std::move(*encodedCertificateVerify));
-                  combined.append(std::move(encodedFinished));
-                }
+                   legacySessionId = std::move(legacySessionId),
+                   earlyReadRecordLayer = std::move(earlyReadRecordLayer),
+                   earlyExporterMaster = std::move(earlyExporterMaster),
+                   additionalExtensions = std::move(additionalExtensions)](
+                      Buf sharedSecretResult) mutable {
+              Optional<Buf> serverShare;
+              if (kex) {
+                scheduler->deriveHandshakeSecret(
+                    sharedSecretResult->coalesce());
+                serverShare = kex->getKeyShare();
               } else {
-                combined.append(std::move(encodedEncryptedExt));
-                combined.append(std::move(encodedFinished));
+                scheduler->deriveHandshakeSecret();
               }
 
-              // Some middleboxes appear to break if the first encrypted record
-              // is larger than ~1300 bytes (likely if it does not fit in the
-              // first packet).
-              auto writtenEncryptedHandshake =
-                  handshakeWriteRecordLayer->writeHandshake(
-                      combined.splitAtMost(1000));
-              if (!combined.empty()) {
-                writtenEncryptedHandshake->prependChain(
-                    handshakeWriteRecordLayer->writeHandshake(combined.move()));
-              }
-
-              WriteToSocket write;
-              write.data = state.writeRecordLayer()->writeHandshake(
-                  std::move(encodedServerHello));
-              if (legacySessionId && !legacySessionId->empty()) {
-                write.data->prependChain(
-                    folly::IOBuf::wrapBuffer(FakeChangeCipherSpec));
-              }
-
-              write.data->prependChain(std::move(writtenEncryptedHandshake));
-
-              scheduler->deriveMasterSecret();
-              auto clientFinishedContext =
-                  handshakeContext->getHandshakeContext();
-              auto exporterMasterVector = scheduler->getSecret(
-                  MasterSecrets::ExporterMaster,
-                  clientFinishedContext->coalesce());
-              auto exporterMaster =
-                  folly::IOBuf::copyBuffer(folly::range(exporterMasterVector));
-
-              scheduler->deriveAppTrafficSecrets(
-                  clientFinishedContext->coalesce());
-              auto appTrafficWriteRecordLayer =
+              auto encodedServerHello = getServerHello(
+                  version,
+                  state.context()->getFactory()->makeRandom(),
+                  cipher,
+                  resState.hasValue(),
+                  group,
+                  std::move(serverShare),
+                  legacySessionId ? legacySessionId->clone() : nullptr,
+                  *handshakeContext);
+
+              // Derive handshake keys.
+              std::array<uint8_t, kMaxHashLength> shloContextBuf;
+              auto handshakeWriteRecordLayer =
                   state.context()
                       ->getFactory()
-                      ->makeEncryptedWriteRecordLayer();
-              appTrafficWriteRecordLayer->setProtocolVersion(version);
-              auto writeSecret =
-                  scheduler->getSecret(AppTrafficSecrets::ServerAppTraffic);
+                      ->makeEncryptedWriteRecordLayer(
+                          EncryptionLevel::Handshake);
+              handshakeWriteRecordLayer->setProtocolVersion(version);
+              auto handshakeWriteSecret = scheduler->getSecret(
+                  HandshakeSecrets::ServerHandshakeTraffic,
+                  handshakeContext->getHandshakeContext(
+                      folly::range(shloContextBuf)));
               Protocol::setAead(
-                  *appTrafficWriteRecordLayer,
+                  *handshakeWriteRecordLayer,
                   cipher,
-                  folly::range(writeSecret),
+                  folly::range(handshakeWriteSecret),
                   *state.context()->getFactory(),
                   *scheduler);
 
-              // If we have previously dealt with early data (before a
-              // HelloRetryRequest), don't overwrite the previous result.
-              auto earlyDataTypeSave = state.earlyDataType()
-                  ? *state.earlyDataType()
-                  : earlyDataType;
-
-              // Save all the necessary state except for the read record layer,
-              // which is done separately as it varies if early data was
-              // accepted.
-              auto saveState = [appTrafficWriteRecordLayer =
-                                    std::move(appTrafficWriteRecordLayer),
-                                handshakeContext = std::move(handshakeContext),
-                                scheduler = std::move(scheduler),
-                                exporterMaster = std::move(exporterMaster),
-                                serverCert = std::move(serverCert),
-                                clientCert = std::move(clientCert),
-                                cipher,
-                                group,
-                                sigScheme,
-                                clientHandshakeSecret =
-                                    std::move(clientHandshakeSecret),
-                                pskType,
-                                pskMode,
-                                version,
-                                keyExchangeType,
-                                alpn = std::move(alpn),
-                                earlyDataTypeSave,
-                                replayCacheResult,
-                                clockSkew](State& newState) mutable {
-                newState.writeRecordLayer() =
-                    std::move(appTrafficWriteRecordLayer);
-                newState.handshakeContext() = std::move(handshakeContext);
-                newState.keyScheduler() = std::move(scheduler);
-                newState.exporterMasterSecret() = std::move(exporterMaster);
-                newState.serverCert() = std::move(*serverCert);
-                newState.clientCert() = std::move(clientCert);
-                newState.version() = version;
-                newState.cipher() = cipher;
-                newState.group() = group;
-                newState.sigScheme() = sigScheme;
-                newState.clientHandshakeSecret() =
-                    std::move(clientHandshakeSecret);
-                newState.pskType() = pskType;
-                newState.pskMode() = pskMode;
-                newState.keyExchangeType() = keyExchangeType;
-                newState.earlyDataType() = earlyDataTypeSave;
-                newState.replayCacheResult() = replayCacheResult;
-                newState.alpn() = std::move(alpn);
-                newState.clientClockSkew() = clockSkew;
-              };
-
-              if (earlyDataType == EarlyDataType::Accepted) {
-                return actions(
-                    [handshakeReadRecordLayer =
-                         std::move(handshakeReadRecordLayer),
-                     earlyReadRecordLayer = std::move(earlyReadRecordLayer),
-                     earlyExporterMaster = std::move(earlyExporterMaster)](
-                        State& newState) mutable {
-                      newState.readRecordLayer() =
-                          std::move(earlyReadRecordLayer);
-                      newState.handshakeReadRecordLayer() =
-                          std::move(handshakeReadRecordLayer);
-                      newState.earlyExporterMasterSecret() =
-                          std::move(earlyExporterMaster);
-                    },
-                    std::move(saveState),
-                    std::move(write),
-                    &Transition<StateEnum::AcceptingEarlyData>,
-                    ReportEarlyHandshakeSuccess());
+              auto handshakeReadRecordLayer =
+                  state.context()->getFactory()->makeEncryptedReadRecordLayer(
+                      EncryptionLevel::Handshake);
+              handshakeReadRecordLayer->setProtocolVersion(version);
+              handshakeReadRecordLayer->setSkipFailedDecryption(
+                  earlyDataType == EarlyDataType::Rejected);
+              if (earlyDataType == EarlyDataType::Rejected) {
+                handshakeReadRecordLayer->setMaxSkippedBytes(
+                    state.context()->getMaxEarlyDataSize());
+                if (state.context()->getFastSkipRejectedEarlyData() &&
+                    (state.context()->getClientAuthMode() ==
+                         ClientAuthMode::None ||
+                     resState)) {
+                  // Finished message and the inner content type.
+                  handshakeReadRecordLayer->setFastSkipLength(
+                      sizeof(HandshakeType) + detail::bits24::size +
+                      getHashSize(getHashFunction(cipher)) +
+                      sizeof(ContentType));
+                }
+              }
+              auto handshakeReadSecret = scheduler->getSecret(
+                  HandshakeSecrets::ClientHandshakeTraffic,
+                  handshakeContext->getHandshakeContext(
+                      folly::range(shloContextBuf)));
+              Protocol::setAead(
+                  *handshakeReadRecordLayer,
+                  cipher,
+                  folly::range(handshakeReadSecret),
+                  *state.context()->getFactory(),
+                  *scheduler);
+              if (state.context()->getClientAuthMode() !=
+                      ClientAuthMode::None &&
+                  !resState) {
+                // Parse client certificates as their records arrive rather
+                // than once the whole chain is buffered. The factory belongs
+                // to the context, which outlives the record layer.
+                handshakeReadRecordLayer->setCertificateParser(
+                    [factory = state.context()->getFactory()](Buf certData) {
+                      return factory->makePeerCert(std::move(certData));
+                    });
+              }
+              auto clientHandshakeSecret =
+                  folly::IOBuf::copyBuffer(folly::range(handshakeReadSecret));
+
+              /*
+               * Choose the cert before EncryptedExtensions, which carries the
+               * negotiated server certificate type.
+               */
+              std::shared_ptr<const SelfCert> originalSelfCert;
+              Optional<SignatureScheme> sigScheme;
+              if (!resState) { // TODO or reauth
+                std::tie(originalSelfCert, sigScheme) =
+                    chooseCert(*state.context(), extensions);
+                auto certTypeExt =
+                    getServerCertType(*originalSelfCert, extensions);
+                if (certTypeExt) {
+                  additionalExtensions.push_back(std::move(*certTypeExt));
+                }
+              }
+
+              auto encodedEncryptedExt = getEncryptedExt(
+                  *handshakeContext,
+                  alpn,
+                  earlyDataType,
+                  std::move(additionalExtensions));
+
+              /*
+               * Determine we are requesting client auth.
+               * If yes, add CertificateRequest to handshake write and
+               * transcript.
+               */
+              bool requestClientAuth =
+                  state.context()->getClientAuthMode() !=
+                      ClientAuthMode::None &&
+                  !resState;
+              Optional<Buf> encodedCertRequest;
+              if (requestClientAuth) {
+                encodedCertRequest = getCertificateRequest(
+                    state.context()->getSupportedSigSchemes(),
+                    state.context()->getClientCertVerifier().get(),
+                    *handshakeContext);
+              }
+
+              /*
+               * Set the cert and signature scheme we are using.
+               * If sending new cert, add Certificate to handshake write and
+               * transcript.
+               */
+              Optional<Buf> encodedCertificate;
+              Future<Optional<Buf>> signature = folly::none;
+              Optional<std::shared_ptr<const Cert>> serverCert;
+              std::shared_ptr<const Cert> clientCert;
+              if (!resState) {
+                encodedCertificate = getCertificate(
+                    originalSelfCert,
+                    *state.context(),
+                    extensions,
+                    *handshakeContext);
+
+                auto toBeSigned = handshakeContext->getHandshakeContext();
+                auto handshakeScheduler =
+                    state.context()->getHandshakeScheduler();
+                signature = detail::traceAsyncStep(
+                    getHandshakeTracer(state),
+                    state.handshakeId(),
+                    HandshakeStep::Sign,
+                    [&]() -> Future<Optional<Buf>> {
+                      if (handshakeScheduler) {
+                        return handshakeScheduler->schedule(
+                            signingPriority,
+                            [cert = originalSelfCert,
+                             sigScheme = *sigScheme,
+                             toBeSigned = std::move(toBeSigned)]() {
+                              return signCertificateVerify(
+                                  cert, sigScheme, toBeSigned->coalesce());
+                            },
+                            signingCancelled);
+                      } else if (state.context()->getHandshakeExecutor()) {
+                        return folly::via(
+                            state.context()->getHandshakeExecutor(),
+                            [cert = originalSelfCert,
+                             sigScheme = *sigScheme,
+                             toBeSigned = std::move(toBeSigned)]() {
+                              return signCertificateVerify(
+                                  cert, sigScheme, toBeSigned->coalesce());
+                            });
+                      } else {
+                        return signCertificateVerify(
+                            originalSelfCert,
+                            *sigScheme,
+                            toBeSigned->coalesce());
+                      }
+                    });
+                serverCert = std::move(originalSelfCert);
               } else {
-                auto transition = requestClientAuth
-                    ? Transition<StateEnum::ExpectingCertificate>
-                    : Transition<StateEnum::ExpectingFinished>;
-                return actions(
-                    [handshakeReadRecordLayer = std::move(
-                         handshakeReadRecordLayer)](State& newState) mutable {
-                      newState.readRecordLayer() =
-                          std::move(handshakeReadRecordLayer);
-                    },
-                    std::move(saveState),
-                    std::move(write),
-                    transition);
+                serverCert = std::move(resState->serverCert);
+                clientCert = std::move(resState->clientCert);
               }
+
+              auto signatureExecutor =
+                  getContinuationExecutor(state, signature);
+              return signature.via(signatureExecutor)
+                  .then([&state,
+                         scheduler = std::move(scheduler),
+                         handshakeContext = std::move(handshakeContext),
+                         cipher,
+                         group,
+                         encodedServerHello = std::move(encodedServerHello),
+                         handshakeWriteRecordLayer =
+                             std::move(handshakeWriteRecordLayer),
+                         handshakeWriteSecret = std::move(handshakeWriteSecret),
+                         handshakeReadRecordLayer =
+                             std::move(handshakeReadRecordLayer),
+                         earlyReadRecordLayer = std::move(earlyReadRecordLayer),
+                         earlyExporterMaster = std::move(earlyExporterMaster),
+                         clientHandshakeSecret =
+                             std::move(clientHandshakeSecret),
+                         encodedEncryptedExt = std::move(encodedEncryptedExt),
+                         encodedCertificate = std::move(encodedCertificate),
+                         encodedCertRequest = std::move(encodedCertRequest),
+                         requestClientAuth,
+                         pskType,
+                         pskMode,
+                         sigScheme,
+                         version,
+                         keyExchangeType,
+                         earlyDataType,
+                         replayCacheResult,
+                         serverCert = std::move(serverCert),
+                         clientCert = std::move(clientCert),
+                         alpn = std::move(alpn),
+                         sni = std::move(sni),
+                         clockSkew,
+                         legacySessionId = std::move(legacySessionId)](
+                            Optional<Buf> sig) mutable {
+                    Optional<Buf> encodedCertificateVerify;
+                    if (sig) {
+                      encodedCertificateVerify = getCertificateVerify(
+                          *sigScheme, std::move(*sig), *handshakeContext);
+                    }
+
+                    auto encodedFinished = Protocol::getFinished(
+                        folly::range(handshakeWriteSecret), *handshakeContext);
+
+                    folly::IOBufQueue combined;
+                    if (encodedCertificate) {
+                      if (encodedCertRequest) {
+                        combined.append(std::move(encodedEncryptedExt));
+                        combined.append(std::move(*encodedCertRequest));
+                        combined.append(std::move(*encodedCertificate));
+                        combined.append(std::move(*encodedCertificateVerify));
+                        combined.append(std::move(encodedFinished));
+                      } else {
+                        combined.append(std::move(encodedEncryptedExt));
+                        combined.append(std::move(*encodedCertificate));
+                        combined.append(std::move(*encodedCertificateVerify));
+                        combined.append(std::move(encodedFinished));
+                      }
+                    } else {
+                      combined.append(std::move(encodedEncryptedExt));
+                      combined.append(std::move(encodedFinished));
+                    }
+
+                    // Some middleboxes appear to break if the first encrypted
+                    // record is larger than ~1300 bytes (likely if it does not
+                    // fit in the first packet).
+                    auto firstRecordLimit =
+                        state.context()->getFirstEncryptedRecordLimit();
+                    auto writtenEncryptedHandshake =
+                        handshakeWriteRecordLayer->writeHandshake(
+                            firstRecordLimit == 0
+                                ? combined.move()
+                                : combined.splitAtMost(firstRecordLimit));
+                    if (!combined.empty()) {
+                      writtenEncryptedHandshake->prependChain(
+                          handshakeWriteRecordLayer->writeHandshake(
+                              combined.move()));
+                    }
+
+                    WriteToSocket write;
+                    write.data = state.writeRecordLayer()->writeHandshake(
+                        std::move(encodedServerHello));
+                    if (legacySessionId && !legacySessionId->empty()) {
+                      write.data->prependChain(
+                          folly::IOBuf::wrapBuffer(FakeChangeCipherSpec));
+                    }
+
+                    write.data->prependChain(
+                        std::move(writtenEncryptedHandshake));
+
+                    scheduler->deriveMasterSecret();
+                    auto clientFinishedContext =
+                        handshakeContext->getHandshakeContext();
+                    DeferredSecret<Buf> exporterMaster(
+                        [derive = scheduler->getDeferredSecret(
+                             MasterSecrets::ExporterMaster,
+                             clientFinishedContext->coalesce())]() mutable {
+                          return folly::IOBuf::copyBuffer(
+                              folly::range(derive()));
+                        });
+
+                    scheduler->deriveAppTrafficSecrets(
+                        clientFinishedContext->coalesce());
+                    auto appTrafficWriteRecordLayer =
+                        state.context()
+                            ->getFactory()
+                            ->makeEncryptedWriteRecordLayer(
+                                EncryptionLevel::AppTraffic);
+                    appTrafficWriteRecordLayer->setProtocolVersion(version);
+                    appTrafficWriteRecordLayer->setParallelEncryption(
+                        state.context()->getParallelEncryption());
+                    appTrafficWriteRecordLayer->setKeyUpdateLimits(
+                        state.context()->getKeyUpdateLimits());
+                    auto writeSecret = scheduler->getSecret(
+                        AppTrafficSecrets::ServerAppTraffic);
+                    Protocol::setAead(
+                        *appTrafficWriteRecordLayer,
+                        cipher,
+                        folly::range(writeSecret),
+                        *state.context()->getFactory(),
+                        *scheduler);
+
+                    // If we have previously dealt with early data (before a
+                    // HelloRetryRequest), don't overwrite the previous result.
+                    auto earlyDataTypeSave = state.earlyDataType()
+                        ? *state.earlyDataType()
+                        : earlyDataType;
+
+                    // Save all the necessary state except for the read record
+                    // layer, which is done separately as it varies if early
+                    // data was accepted.
+                    auto saveState =
+                        [appTrafficWriteRecordLayer =
+                             std::move(appTrafficWriteRecordLayer),
+                         handshakeContext = std::move(handshakeContext),
+                         scheduler = std::move(scheduler),
+                         exporterMaster = std::move(exporterMaster),
+                         serverCert = std::move(serverCert),
+                         clientCert = std::move(clientCert),
+                         cipher,
+                         group,
+                         sigScheme,
+                         clientHandshakeSecret =
+                             std::move(clientHandshakeSecret),
+                         pskType,
+                         pskMode,
+                         version,
+                         keyExchangeType,
+                         alpn = std::move(alpn),
+                         sni = std::move(sni),
+                         earlyDataTypeSave,
+                         replayCacheResult,
+                         clockSkew](State& newState) mutable {
+                          newState.writeRecordLayer() =
+                              std::move(appTrafficWriteRecordLayer);
+                          newState.handshakeContext() =
+                              std::move(handshakeContext);
+                          newState.keyScheduler() = std::move(scheduler);
+                          newState.exporterMasterSecret() =
+                              std::move(exporterMaster);
+                          newState.serverCert() = std::move(*serverCert);
+                          newState.clientCert() = std::move(clientCert);
+                          newState.version() = version;
+                          newState.cipher() = cipher;
+                          newState.group() = group;
+                          newState.sigScheme() = sigScheme;
+                          newState.clientHandshakeSecret() =
+                              std::move(clientHandshakeSecret);
+                          newState.pskType() = pskType;
+                          newState.pskMode() = pskMode;
+                          newState.keyExchangeType() = keyExchangeType;
+                          newState.earlyDataType() = earlyDataTypeSave;
+                          newState.replayCacheResult() = replayCacheResult;
+                          newState.alpn() = std::move(alpn);
+                          newState.sni() = std::move(sni);
+                          newState.clientClockSkew() = clockSkew;
+                        };
+
+                    if (earlyDataType == EarlyDataType::Accepted) {
+                      return actions(
+                          [handshakeReadRecordLayer =
+                               std::move(handshakeReadRecordLayer),
+                           earlyReadRecordLayer =
+                               std::move(earlyReadRecordLayer),
+                           earlyExporterMaster =
+                               std::move(earlyExporterMaster)](
+                              State& newState) mutable {
+                            newState.readRecordLayer() =
+                                std::move(earlyReadRecordLayer);
+                            newState.handshakeReadRecordLayer() =
+                                std::move(handshakeReadRecordLayer);
+                            newState.earlyExporterMasterSecret() =
+                                std::move(earlyExporterMaster);
+                          },
+                          std::move(saveState),
+                          std::move(write),
+                          &Transition<StateEnum::AcceptingEarlyData>,
+                          ReportEarlyHandshakeSuccess());
+                    } else {
+                      auto transition = requestClientAuth
+                          ? Transition<StateEnum::ExpectingCertificate>
+                          : Transition<StateEnum::ExpectingFinished>;
+                      return actions(
+                          [handshakeReadRecordLayer =
+                               std::move(handshakeReadRecordLayer)](
+                              State& newState) mutable {
+                            newState.readRecordLayer() =
+                                std::move(handshakeReadRecordLayer);
+                          },
+                          std::move(saveState),
+                          std::move(write),
+                          transition);
+                    }
+                  });
             });
       });
+  return setOnInterrupt(std::move(futureActions), std::move(signingCancelled));
 }
 
 AsyncActions
@@ -1559,36 +2354,91 @@ EventHandler<ServerTypes, StateEnum::ExpectingFinished, Event::AppWrite>::
   return actions(std::move(write));
 }
 
-static WriteToSocket writeNewSessionTicket(
+static Buf getNewSessionTicket(
     const FizzServerContext& context,
-    const WriteRecordLayer& recordLayer,
     std::chrono::seconds ticketLifetime,
     uint32_t ticketAgeAdd,
     Buf nonce,
     Buf ticket,
     ProtocolVersion version) {
-  NewSessionTicket nst;
-  nst.ticket_lifetime = ticketLifetime.count();
-  nst.ticket_age_add = ticketAgeAdd;
-  nst.ticket_nonce = std::move(nonce);
-  nst.ticket = std::move(ticket);
+  // Everything but the nonce, age_add and ticket is the same for every
+  // ticket, so the message is written straight into a single buffer rather
+  // than built as a NewSessionTicket and encoded piece by piece.
+  bool earlyData = context.getAcceptEarlyData(version);
+  size_t extensionsLength = earlyData
+      ? sizeof(ExtensionType) + sizeof(uint16_t) + sizeof(uint32_t)
+      : 0;
+  size_t nonceLength = nonce ? sizeof(uint8_t) + nonce->computeChainDataLength()
+                             : 0;
+  size_t bodyLength = sizeof(uint32_t) + sizeof(uint32_t) + nonceLength +
+      sizeof(uint16_t) + ticket->computeChainDataLength() + sizeof(uint16_t) +
+      extensionsLength;
+  size_t length = sizeof(HandshakeType) + detail::bits24::size + bodyLength;
+
+  auto buf = folly::IOBuf::create(length);
+  folly::io::Appender appender(buf.get(), 0);
+  detail::write(HandshakeType::new_session_ticket, appender);
+  detail::writeBits24(bodyLength, appender);
+  detail::write(static_cast<uint32_t>(ticketLifetime.count()), appender);
+  detail::write(ticketAgeAdd, appender);
+  if (nonce) {
+    detail::writeBuf<uint8_t>(nonce, appender);
+  }
+  detail::writeBuf<uint16_t>(ticket, appender);
+  detail::write(static_cast<uint16_t>(extensionsLength), appender);
+  if (earlyData) {
+    detail::write(ExtensionType::early_data, appender);
+    detail::write(static_cast<uint16_t>(sizeof(uint32_t)), appender);
+    detail::write(context.getMaxEarlyDataSize(), appender);
+  }
+  return buf;
+}
 
-  if (context.getAcceptEarlyData(version)) {
-    TicketEarlyData early;
-    early.max_early_data_size = context.getMaxEarlyDataSize();
-    nst.extensions.push_back(encodeExtension(std::move(early)));
-  }
+/*
+ * If enabled, adds an action deriving the aead of the client's next key
+ * update. It runs after the other actions, so that the writes they produce
+ * aren't delayed by it.
+ */
+static void addPrepareKeyUpdate(bool enabled, Actions& acts) {
+  if (!enabled) {
+    return;
+  }
+  acts.emplace_back(MutateState([](State& newState) {
+    newState.nextClientAead() = Protocol::deriveAead(
+        *newState.cipher(),
+        folly::range(newState.keyScheduler()->getNextSecret(
+            AppTrafficSecrets::ClientAppTraffic)),
+        *newState.context()->getFactory(),
+        *newState.keyScheduler());
+  }));
+}
+
+static std::unique_ptr<EncryptedWriteRecordLayer> updateServerWriteKey(
+    const State& state) {
+  auto generation = state.keyScheduler()->serverKeyUpdate();
 
-  auto encodedNst = encodeHandshake(std::move(nst));
-  auto writtenNst = recordLayer.writeHandshake(std::move(encodedNst));
-  WriteToSocket nstWrite;
-  nstWrite.data = std::move(writtenNst);
-  return nstWrite;
+  auto writeRecordLayer =
+      state.context()->getFactory()->makeEncryptedWriteRecordLayer(
+          EncryptionLevel::AppTraffic);
+  writeRecordLayer->setKeyUpdateGeneration(generation);
+  writeRecordLayer->setProtocolVersion(*state.version());
+  writeRecordLayer->setParallelEncryption(
+      state.context()->getParallelEncryption());
+  writeRecordLayer->setKeyUpdateLimits(state.context()->getKeyUpdateLimits());
+  auto writeSecret =
+      state.keyScheduler()->getSecret(AppTrafficSecrets::ServerAppTraffic);
+  Protocol::setAead(
+      *writeRecordLayer,
+      *state.cipher(),
+      folly::range(writeSecret),
+      *state.context()->getFactory(),
+      *state.keyScheduler());
+  return writeRecordLayer;
 }
 
 static Future<Optional<WriteToSocket>> generateTicket(
     const State& state,
-    const std::vector<uint8_t>& resumptionMasterSecret,
+    const DeferredSecret<std::vector<uint8_t>>& resumptionMasterSecret,
     Buf appToken = nullptr) {
   auto ticketCipher = state.context()->getTicketCipher();
 
@@ -1596,50 +2446,111 @@ static Future<Optional<WriteToSocket>> generateTicket(
     return folly::none;
   }
 
-  Buf ticketNonce;
-  Buf resumptionSecret;
+  using Ticket = Optional<std::pair<Buf, std::chrono::seconds>>;
+  struct TicketParams {
+    uint32_t ticketAgeAdd;
+    Buf ticketNonce;
+  };
+
+  // Every ticket gets its own nonce, and so its own resumption secret. The
+  // first ticket keeps the empty nonce.
+  auto numTickets = state.context()->getNumNewSessionTickets();
   auto realDraftVersion = getRealDraftVersion(*state.version());
-  if (realDraftVersion == ProtocolVersion::tls_1_3_20) {
-    ticketNonce = nullptr;
-    resumptionSecret =
-        folly::IOBuf::copyBuffer(folly::range(resumptionMasterSecret));
-  } else {
-    ticketNonce = folly::IOBuf::create(0);
-    resumptionSecret = state.keyScheduler()->getResumptionSecret(
-        folly::range(resumptionMasterSecret), ticketNonce->coalesce());
-  }
-
-  ResumptionState resState;
-  resState.version = *state.version();
-  resState.cipher = *state.cipher();
-  resState.resumptionSecret = std::move(resumptionSecret);
-  resState.serverCert = state.serverCert();
-  resState.clientCert = state.clientCert();
-  resState.alpn = state.alpn();
-  resState.ticketAgeAdd = state.context()->getFactory()->makeTicketAgeAdd();
-  resState.ticketIssueTime = std::chrono::system_clock::now();
-  resState.appToken = std::move(appToken);
-
-  auto ticketFuture = ticketCipher->encrypt(std::move(resState));
-  return ticketFuture.via(state.executor())
-      .then(
-          [&state,
-           ticketAgeAdd = resState.ticketAgeAdd,
-           ticketNonce = std::move(ticketNonce)](
-              Optional<std::pair<Buf, std::chrono::seconds>> ticket) mutable
-          -> Optional<WriteToSocket> {
-            if (!ticket) {
-              return folly::none;
-            }
-            return writeNewSessionTicket(
-                *state.context(),
-                *state.writeRecordLayer(),
-                ticket->second,
-                ticketAgeAdd,
-                std::move(ticketNonce),
-                std::move(ticket->first),
-                *state.version());
-          });
+  std::vector<TicketParams> ticketParams;
+  std::vector<Future<Ticket>> ticketFutures;
+  ticketParams.reserve(numTickets);
+  ticketFutures.reserve(numTickets);
+  for (uint8_t i = 0; i < numTickets; ++i) {
+    Buf ticketNonce;
+    Buf resumptionSecret;
+    if (realDraftVersion == ProtocolVersion::tls_1_3_20) {
+      ticketNonce = nullptr;
+      resumptionSecret =
+          folly::IOBuf::copyBuffer(folly::range(*resumptionMasterSecret));
+    } else {
+      ticketNonce = i == 0 ? folly::IOBuf::create(0)
+                           : folly::IOBuf::copyBuffer(&i, sizeof(i));
+      resumptionSecret = state.keyScheduler()->getResumptionSecret(
+          folly::range(*resumptionMasterSecret), ticketNonce->coalesce());
+    }
+
+    ResumptionState resState;
+    resState.version = *state.version();
+    resState.cipher = *state.cipher();
+    resState.resumptionSecret = std::move(resumptionSecret);
+    // The ticket cipher may keep resState after the connection is gone.
+    resState.serverCert = state.context()->getOwningCert(state.serverCert());
+    resState.clientCert = state.clientCert();
+    resState.alpn = state.alpn();
+    resState.serverName = state.sni();
+    resState.ticketAgeAdd = state.context()->getFactory()->makeTicketAgeAdd();
+    resState.ticketIssueTime = state.context()->getFactory()->now();
+    resState.appToken = appToken ? appToken->clone() : nullptr;
+    if (auto singleUseTickets = state.context()->getSingleUseTickets()) {
+      resState.ticketId =
+          singleUseTickets->issueTicketId(state.context()->getFactory()->now());
+    }
+
+    ticketParams.push_back(
+        TicketParams{resState.ticketAgeAdd, std::move(ticketNonce)});
+    TLSStats::Timer timer(TLSCounter::TicketNanos);
+    ticketFutures.push_back(detail::traceAsyncStep(
+        getHandshakeTracer(state),
+        state.handshakeId(),
+        HandshakeStep::TicketEncrypt,
+        [&]() { return ticketCipher->encrypt(std::move(resState)); }));
+  }
+
+  // All the tickets go out in one write. Tickets the cipher could not
+  // encrypt are left out.
+  auto writeTickets = [&state, ticketParams = std::move(ticketParams)](
+                          std::vector<Ticket> tickets) mutable
+      -> Optional<WriteToSocket> {
+    folly::IOBufQueue encodedTickets{folly::IOBufQueue::cacheChainLength()};
+    for (size_t i = 0; i < tickets.size(); ++i) {
+      if (!tickets[i]) {
+        continue;
+      }
+      encodedTickets.append(getNewSessionTicket(
+          *state.context(),
+          tickets[i]->second,
+          ticketParams[i].ticketAgeAdd,
+          std::move(ticketParams[i].ticketNonce),
+          std::move(tickets[i]->first),
+          *state.version()));
+    }
+    if (encodedTickets.empty()) {
+      return folly::none;
+    }
+    WriteToSocket nstWrite;
+    nstWrite.data =
+        state.writeRecordLayer()->writeHandshake(encodedTickets.move());
+    return nstWrite;
+  };
+
+  // Ticket ciphers usually encrypt synchronously, skip the executor hop.
+  if (std::all_of(
+          ticketFutures.begin(), ticketFutures.end(), [](Future<Ticket>& f) {
+            return f.isReady();
+          })) {
+    std::vector<Ticket> tickets;
+    tickets.reserve(ticketFutures.size());
+    for (auto& ticketFuture : ticketFutures) {
+      tickets.push_back(std::move(ticketFuture.value()));
+    }
+    return writeTickets(std::move(tickets));
+  }
+  return collectAll(ticketFutures)
+      .via(state.executor())
+      .then([writeTickets = std::move(writeTickets)](
+                std::vector<folly::Try<Ticket>> results) mutable {
+        std::vector<Ticket> tickets;
+        tickets.reserve(results.size());
+        for (auto& result : results) {
+          tickets.push_back(std::move(result.value()));
+        }
+        return writeTickets(std::move(tickets));
+      });
 }
 
 AsyncActions
@@ -1664,8 +2575,12 @@ EventHandler<ServerTypes, StateEnum::ExpectingCertificate, Event::Certificate>::
           AlertDescription::illegal_parameter);
     }
 
-    clientCerts.emplace_back(state.context()->getFactory()->makePeerCert(
-        std::move(certEntry.cert_data)));
+    if (certEntry.parsedCert) {
+      clientCerts.push_back(std::move(certEntry.parsedCert));
+    } else {
+      clientCerts.emplace_back(state.context()->getFactory()->makePeerCert(
+          std::move(certEntry.cert_data)));
+    }
   }
 
   if (clientCerts.empty()) {
@@ -1694,11 +2609,8 @@ AsyncActions EventHandler<
     Event::CertificateVerify>::handle(const State& state, Param param) {
   auto certVerify = std::move(boost::get<CertificateVerify>(param));
 
-  if (std::find(
-          state.context()->getSupportedSigSchemes().begin(),
-          state.context()->getSupportedSigSchemes().end(),
-          certVerify.algorithm) ==
-      state.context()->getSupportedSigSchemes().end()) {
+  if (!state.context()->getSigSchemePreferences().contains(
+          certVerify.algorithm)) {
     throw FizzException(
         folly::to<std::string>(
             "client chose unsupported sig scheme: ",
@@ -1708,10 +2620,12 @@ AsyncActions EventHandler<
 
   const auto& certs = *state.unverifiedCertChain();
   auto leafCert = certs.front();
+  std::array<uint8_t, kMaxHashLength> certContextBuf;
   leafCert->verify(
       certVerify.algorithm,
       CertificateVerifyContext::Client,
-      state.handshakeContext()->getHandshakeContext()->coalesce(),
+      state.handshakeContext()->getHandshakeContext(
+          folly::range(certContextBuf)),
       certVerify.signature->coalesce());
 
   try {
@@ -1729,8 +2643,11 @@ AsyncActions EventHandler<
 
   state.handshakeContext()->appendToTranscript(*certVerify.originalEncoding);
 
+  auto cert = retainPeerCert(
+      std::move(leafCert), state.context()->getPeerCertRetention());
+
   return actions(
-      [cert = std::move(leafCert)](State& newState) {
+      [cert = std::move(cert)](State& newState) {
         newState.unverifiedCertChain() = folly::none;
         newState.clientCert() = std::move(cert);
       },
@@ -1754,8 +2671,12 @@ EventHandler<ServerTypes, StateEnum::ExpectingFinished, Event::Finished>::
   }
 
   auto readRecordLayer =
-      state.context()->getFactory()->makeEncryptedReadRecordLayer();
+      state.context()->getFactory()->makeEncryptedReadRecordLayer(
+          EncryptionLevel::AppTraffic);
   readRecordLayer->setProtocolVersion(*state.version());
+  readRecordLayer->setCoalesceAppData(state.context()->getCoalesceAppData());
+  readRecordLayer->setParallelDecryption(
+      state.context()->getParallelDecryption());
   auto readSecret =
       state.keyScheduler()->getSecret(AppTrafficSecrets::ClientAppTraffic);
   Protocol::setAead(
@@ -1767,42 +2688,71 @@ EventHandler<ServerTypes, StateEnum::ExpectingFinished, Event::Finished>::
 
   state.handshakeContext()->appendToTranscript(*finished.originalEncoding);
 
-  auto resumptionMasterSecret = state.keyScheduler()->getSecret(
-      MasterSecrets::ResumptionMaster,
-      state.handshakeContext()->getHandshakeContext()->coalesce());
+  // Only derived if a ticket is issued.
+  std::array<uint8_t, kMaxHashLength> clientFinishedContextBuf;
+  DeferredSecret<std::vector<uint8_t>> resumptionMasterSecret(
+      state.keyScheduler()->getDeferredSecret(
+          MasterSecrets::ResumptionMaster,
+          state.handshakeContext()->getHandshakeContext(
+              folly::range(clientFinishedContextBuf))));
   state.keyScheduler()->clearMasterSecret();
 
+  Future<Optional<WriteToSocket>> ticketFuture = folly::none;
+  if (state.context()->getSendNewSessionTicket() &&
+      !state.context()->getDeferNewSessionTicket()) {
+    ticketFuture = generateTicket(state, resumptionMasterSecret);
+  }
+
   auto saveState = [readRecordLayer = std::move(readRecordLayer),
-                    resumptionMasterSecret](State& newState) mutable {
+                    resumptionMasterSecret = std::move(resumptionMasterSecret)](
+                       State& newState) mutable {
     newState.readRecordLayer() = std::move(readRecordLayer);
 
     newState.resumptionMasterSecret() = std::move(resumptionMasterSecret);
+
+    // Nothing in the handshake state is needed past this point.
+    newState.handshakeState().reset();
   };
 
-  if (!state.context()->getSendNewSessionTicket()) {
-    return actions(
+  auto prepareKeyUpdate = state.context()->getPrepareKeyUpdates();
+  TLSHistogramKey histogramKey;
+  auto handshakeTimings = state.handshakeTimings();
+  if (handshakeTimings) {
+    histogramKey.cipher = state.cipher();
+    histogramKey.group = state.group();
+    histogramKey.pskType = state.pskType();
+    histogramKey.alpn = state.alpn();
+  }
+  auto finish = [saveState = std::move(saveState),
+                 prepareKeyUpdate,
+                 handshakeTimings = std::move(handshakeTimings),
+                 histogramKey = std::move(histogramKey)](
+                    Optional<WriteToSocket> nstWrite) mutable {
+    if (handshakeTimings) {
+      handshakeTimings->record(histogramKey);
+    }
+    if (!nstWrite) {
+      auto acts = actions(
+          std::move(saveState),
+          &Transition<StateEnum::AcceptingData>,
+          ReportHandshakeSuccess());
+      addPrepareKeyUpdate(prepareKeyUpdate, acts);
+      return acts;
+    }
+
+    auto acts = actions(
         std::move(saveState),
         &Transition<StateEnum::AcceptingData>,
+        std::move(*nstWrite),
         ReportHandshakeSuccess());
-  } else {
-    auto ticketFuture = generateTicket(state, resumptionMasterSecret);
-    return ticketFuture.via(state.executor())
-        .then([saveState = std::move(saveState)](
-                  Optional<WriteToSocket> nstWrite) mutable {
-          if (!nstWrite) {
-            return actions(
-                std::move(saveState),
-                &Transition<StateEnum::AcceptingData>,
-                ReportHandshakeSuccess());
-          }
+    addPrepareKeyUpdate(prepareKeyUpdate, acts);
+    return acts;
+  };
 
-          return actions(
-              std::move(saveState),
-              &Transition<StateEnum::AcceptingData>,
-              std::move(*nstWrite),
-              ReportHandshakeSuccess());
-        });
+  if (ticketFuture.isReady()) {
+    return finish(std::move(ticketFuture.value()));
   }
+  return ticketFuture.via(state.executor()).then(std::move(finish));
 }
 
 AsyncActions EventHandler<
@@ -1814,13 +2764,17 @@ AsyncActions EventHandler<
       state,
       state.resumptionMasterSecret(),
       std::move(writeNewSessionTicket.appToken));
-  return ticketFuture.via(state.executor())
-      .then([](Optional<WriteToSocket> nstWrite) {
-        if (!nstWrite) {
-          return actions();
-        }
-        return actions(std::move(*nstWrite));
-      });
+  auto toActions = [](Optional<WriteToSocket> nstWrite) {
+    if (!nstWrite) {
+      return actions();
+    }
+    return actions(std::move(*nstWrite));
+  };
+
+  if (ticketFuture.isReady()) {
+    return toActions(std::move(ticketFuture.value()));
+  }
+  return ticketFuture.via(state.executor()).then(std::move(toActions));
 }
 
 AsyncActions
@@ -1840,10 +2794,55 @@ EventHandler<ServerTypes, StateEnum::AcceptingData, Event::AppWrite>::handle(
 
   WriteToSocket write;
   write.callback = appWrite.callback;
-  write.data = state.writeRecordLayer()->writeAppData(std::move(appWrite.data));
   write.flags = appWrite.flags;
 
-  return actions(std::move(write));
+  folly::IOBufQueue appData;
+  appData.append(std::move(appWrite.data));
+  const WriteRecordLayer* writeRecordLayer = state.writeRecordLayer();
+  std::unique_ptr<EncryptedWriteRecordLayer> updatedWriteRecordLayer;
+  folly::IOBufQueue out;
+  auto& iovecs = appWrite.iovecs;
+  while (true) {
+    if (iovecs) {
+      writeRecordLayer->writeAppDataIovecsUntilKeyUpdate(appData, *iovecs);
+    } else {
+      out.append(writeRecordLayer->writeAppDataUntilKeyUpdate(appData));
+    }
+    if (!writeRecordLayer->keyUpdateDue()) {
+      break;
+    }
+    // The write keys have reached their usage limits. Send a KeyUpdate right
+    // behind the records they protected and write the rest of the data with
+    // the new keys, without waiting for the client.
+    TLSMessage keyUpdate{
+        ContentType::handshake,
+        Protocol::getKeyUpdated(KeyUpdateRequest::update_not_requested)};
+    if (iovecs) {
+      writeRecordLayer->writeIovecs(std::move(keyUpdate), *iovecs);
+    } else {
+      out.append(writeRecordLayer->write(std::move(keyUpdate)));
+    }
+    updatedWriteRecordLayer = updateServerWriteKey(state);
+    writeRecordLayer = updatedWriteRecordLayer.get();
+    if (appData.empty()) {
+      break;
+    }
+  }
+  if (iovecs) {
+    write.iovecs = std::move(iovecs);
+  } else {
+    write.data = out.move();
+  }
+
+  if (!updatedWriteRecordLayer) {
+    return actions(std::move(write));
+  }
+  return actions(
+      [wRecordLayer = std::move(updatedWriteRecordLayer)](
+          State& newState) mutable {
+        newState.writeRecordLayer() = std::move(wRecordLayer);
+      },
+      std::move(write));
 }
 
 AsyncActions
@@ -1855,24 +2854,44 @@ EventHandler<ServerTypes, StateEnum::AcceptingData, Event::KeyUpdate>::handle(
   if (state.readRecordLayer()->hasUnparsedHandshakeData()) {
     throw FizzException("data after key_update", folly::none);
   }
-  state.keyScheduler()->clientKeyUpdate();
+  auto generation = state.keyScheduler()->clientKeyUpdate();
   auto readRecordLayer =
-      state.context()->getFactory()->makeEncryptedReadRecordLayer();
+      state.context()->getFactory()->makeEncryptedReadRecordLayer(
+          EncryptionLevel::AppTraffic);
+  readRecordLayer->setKeyUpdateGeneration(generation);
   readRecordLayer->setProtocolVersion(*state.version());
+  readRecordLayer->setCoalesceAppData(state.context()->getCoalesceAppData());
+  readRecordLayer->setParallelDecryption(
+      state.context()->getParallelDecryption());
+  // A prepared aead is swapped in when the state is mutated.
+  auto prepared = state.nextClientAead() != nullptr;
   auto readSecret =
       state.keyScheduler()->getSecret(AppTrafficSecrets::ClientAppTraffic);
-  Protocol::setAead(
-      *readRecordLayer,
-      *state.cipher(),
-      folly::range(readSecret),
-      *state.context()->getFactory(),
-      *state.keyScheduler());
+  if (!prepared) {
+    Protocol::setAead(
+        *readRecordLayer,
+        *state.cipher(),
+        folly::range(readSecret),
+        *state.context()->getFactory(),
+        *state.keyScheduler());
+  } else {
+    readRecordLayer->trafficSecretAvailable(
+        *state.cipher(), folly::range(readSecret));
+  }
+  auto installReadRecordLayer =
+      [rRecordLayer = std::move(readRecordLayer), prepared](
+          State& newState) mutable {
+        if (prepared) {
+          rRecordLayer->setAead(std::move(newState.nextClientAead()));
+        }
+        newState.readRecordLayer() = std::move(rRecordLayer);
+      };
+  auto prepareKeyUpdate = state.context()->getPrepareKeyUpdates();
 
   if (keyUpdate.request_update == KeyUpdateRequest::update_not_requested) {
-    return actions(
-        [rRecordLayer = std::move(readRecordLayer)](State& newState) mutable {
-          newState.readRecordLayer() = std::move(rRecordLayer);
-        });
+    auto acts = actions(std::move(installReadRecordLayer));
+    addPrepareKeyUpdate(prepareKeyUpdate, acts);
+    return std::move(acts);
   }
 
   auto encodedKeyUpdated =
@@ -1881,27 +2900,17 @@ EventHandler<ServerTypes, StateEnum::AcceptingData, Event::KeyUpdate>::handle(
   write.data =
       state.writeRecordLayer()->writeHandshake(std::move(encodedKeyUpdated));
 
-  state.keyScheduler()->serverKeyUpdate();
+  auto writeRecordLayer = updateServerWriteKey(state);
 
-  auto writeRecordLayer =
-      state.context()->getFactory()->makeEncryptedWriteRecordLayer();
-  writeRecordLayer->setProtocolVersion(*state.version());
-  auto writeSecret =
-      state.keyScheduler()->getSecret(AppTrafficSecrets::ServerAppTraffic);
-  Protocol::setAead(
-      *writeRecordLayer,
-      *state.cipher(),
-      folly::range(writeSecret),
-      *state.context()->getFactory(),
-      *state.keyScheduler());
-
-  return actions(
-      [rRecordLayer = std::move(readRecordLayer),
+  auto acts = actions(
+      [installReadRecordLayer = std::move(installReadRecordLayer),
        wRecordLayer = std::move(writeRecordLayer)](State& newState) mutable {
-        newState.readRecordLayer() = std::move(rRecordLayer);
+        installReadRecordLayer(newState);
         newState.writeRecordLayer() = std::move(wRecordLayer);
       },
       std::move(write));
+  addPrepareKeyUpdate(prepareKeyUpdate, acts);
+  return std::move(acts);
 }
 
 } // namespace sm
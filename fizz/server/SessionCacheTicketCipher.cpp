@@ -0,0 +1,121 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/SessionCacheTicketCipher.h>
+
+#include <fizz/crypto/RandomGenerator.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace fizz {
+namespace server {
+
+constexpr size_t SessionCacheTicketCipher::kSessionIdLength;
+
+SessionCacheTicketCipher::SessionCacheTicketCipher(
+    size_t maxSessions,
+    size_t shards,
+    std::shared_ptr<RemoteSessionStore> remote)
+    : remote_(std::move(remote)) {
+  if (maxSessions == 0 || shards == 0) {
+    throw std::runtime_error("invalid session cache size");
+  }
+  shards = std::min(shards, maxSessions);
+  auto sessionsPerShard = (maxSessions + shards - 1) / shards;
+  for (size_t i = 0; i < shards; ++i) {
+    shards_.push_back(std::make_unique<Shard>(sessionsPerShard));
+  }
+}
+
+folly::Future<folly::Optional<std::pair<Buf, std::chrono::seconds>>>
+SessionCacheTicketCipher::encrypt(ResumptionState resState) const {
+  auto random = RandomGenerator<kSessionIdLength>().generateRandom();
+  std::string id(random.begin(), random.end());
+  auto expires = resState.ticketIssueTime + validity_;
+
+  if (remote_) {
+    remote_->put(id, resState, expires);
+  }
+  insert(id, resState, expires);
+
+  return std::make_pair(folly::IOBuf::copyBuffer(id), validity_);
+}
+
+folly::Future<std::pair<PskType, folly::Optional<ResumptionState>>>
+SessionCacheTicketCipher::decrypt(
+    std::unique_ptr<folly::IOBuf> encryptedTicket) const {
+  if (encryptedTicket->computeChainDataLength() != kSessionIdLength) {
+    return std::make_pair(PskType::Rejected, folly::none);
+  }
+  auto id = encryptedTicket->moveToFbString().toStdString();
+  auto now = std::chrono::system_clock::now();
+
+  {
+    auto& shard = getShard(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(id);
+    if (it != shard.sessions.end()) {
+      if (it->second.expires > now) {
+        return std::make_pair(
+            PskType::Resumption, cloneResumptionState(it->second.state));
+      }
+      // The remote store expires the session at the same time.
+      shard.sessions.erase(it);
+      return std::make_pair(PskType::Rejected, folly::none);
+    }
+  }
+
+  if (!remote_) {
+    return std::make_pair(PskType::Rejected, folly::none);
+  }
+  return remote_->get(id).then(
+      [this, id](folly::Try<folly::Optional<ResumptionState>> state)
+          -> std::pair<PskType, folly::Optional<ResumptionState>> {
+        if (state.hasException()) {
+          VLOG(6) << "Remote session lookup failed, ex="
+                  << state.exception().what();
+          return std::make_pair(PskType::Rejected, folly::none);
+        }
+        auto expires = (*state) ? (*state)->ticketIssueTime + validity_
+                                : std::chrono::system_clock::time_point();
+        if (!*state || expires <= std::chrono::system_clock::now()) {
+          return std::make_pair(PskType::Rejected, folly::none);
+        }
+        insert(id, **state, expires);
+        return std::make_pair(PskType::Resumption, std::move(*state));
+      });
+}
+
+size_t SessionCacheTicketCipher::size() const {
+  size_t total = 0;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    total += shard->sessions.size();
+  }
+  return total;
+}
+
+SessionCacheTicketCipher::Shard& SessionCacheTicketCipher::getShard(
+    const std::string& id) const {
+  // Ids are random, so any of their bytes spread sessions evenly.
+  uint64_t index;
+  std::memcpy(&index, id.data(), sizeof(index));
+  return *shards_[index % shards_.size()];
+}
+
+void SessionCacheTicketCipher::insert(
+    const std::string& id,
+    const ResumptionState& state,
+    std::chrono::system_clock::time_point expires) const {
+  auto& shard = getShard(id);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.sessions.set(id, Session{cloneResumptionState(state), expires});
+}
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/TicketCipher.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace fizz {
+namespace server {
+
+/**
+ * Shared session store backing a SessionCacheTicketCipher, e.g. so that
+ * servers behind a load balancer can resume each other's sessions.
+ */
+class RemoteSessionStore {
+ public:
+  virtual ~RemoteSessionStore() = default;
+
+  /**
+   * Stores state under id until expires. Failures only lose the session.
+   */
+  virtual void put(
+      const std::string& id,
+      const ResumptionState& state,
+      std::chrono::system_clock::time_point expires) = 0;
+
+  /**
+   * Returns the state stored under id, or none.
+   */
+  virtual folly::Future<folly::Optional<ResumptionState>> get(
+      const std::string& id) = 0;
+};
+
+/**
+ * TicketCipher that keeps ResumptionState on the server and issues short
+ * random session ids as tickets, for clients that can't handle large
+ * tickets. Resumption is a hash lookup instead of a decryption.
+ *
+ * Sessions are held in sharded in-memory LRUs bounded to maxSessions in
+ * total, and expire when the ticket validity runs out. If a remote store is
+ * set, new sessions are also written to it, and sessions not found locally
+ * are looked up there. The cipher must outlive pending remote lookups.
+ */
+class SessionCacheTicketCipher : public TicketCipher {
+ public:
+  static constexpr size_t kSessionIdLength = 16;
+
+  explicit SessionCacheTicketCipher(
+      size_t maxSessions,
+      size_t shards = 16,
+      std::shared_ptr<RemoteSessionStore> remote = nullptr);
+
+  void setValidity(std::chrono::seconds validity) {
+    validity_ = validity;
+  }
+
+  folly::Future<folly::Optional<std::pair<Buf, std::chrono::seconds>>> encrypt(
+      ResumptionState resState) const override;
+
+  folly::Future<std::pair<PskType, folly::Optional<ResumptionState>>> decrypt(
+      std::unique_ptr<folly::IOBuf> encryptedTicket) const override;
+
+  /**
+   * Number of sessions held locally, including expired ones not yet evicted.
+   */
+  size_t size() const;
+
+ private:
+  struct Session {
+    ResumptionState state;
+    std::chrono::system_clock::time_point expires;
+  };
+
+  struct Shard {
+    explicit Shard(size_t maxSessions) : sessions(maxSessions) {}
+
+    std::mutex mutex;
+    folly::EvictingCacheMap<std::string, Session> sessions;
+  };
+
+  Shard& getShard(const std::string& id) const;
+
+  void insert(
+      const std::string& id,
+      const ResumptionState& state,
+      std::chrono::system_clock::time_point expires) const;
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::shared_ptr<RemoteSessionStore> remote_;
+  std::chrono::seconds validity_{std::chrono::hours(1)};
+};
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,152 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/SingleUseTicketReplayCache.h>
+
+#include <folly/Bits.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace fizz {
+namespace server {
+
+constexpr size_t SingleUseTicketReplayCache::Bitmap::kMaxArraySize;
+constexpr size_t SingleUseTicketReplayCache::Bitmap::kBitsetWords;
+
+SingleUseTicketReplayCache::SingleUseTicketReplayCache(
+    std::chrono::seconds window,
+    std::chrono::seconds ticketValidity)
+    : window_(window) {
+  if (window_.count() <= 0 || ticketValidity.count() < 0) {
+    throw std::runtime_error("invalid single use ticket window");
+  }
+  validWindows_ =
+      (ticketValidity.count() + window_.count() - 1) / window_.count();
+  firstWindow_ = getWindow(Clock::now());
+  nextId_ = static_cast<uint64_t>(firstWindow_) << 32;
+}
+
+uint64_t SingleUseTicketReplayCache::issueTicketId(Clock::time_point now) {
+  uint64_t window = getWindow(now);
+  auto id = nextId_.load();
+  uint64_t next;
+  do {
+    // Keep the issued window if the clock went backwards.
+    next = std::max(id, window << 32);
+    if ((next & std::numeric_limits<uint32_t>::max()) ==
+        std::numeric_limits<uint32_t>::max()) {
+      // The window's counter is exhausted, borrow from the next window.
+      next = ((next >> 32) + 1) << 32;
+    }
+  } while (!nextId_.compare_exchange_weak(id, next + 1));
+  return next;
+}
+
+ReplayCacheResult SingleUseTicketReplayCache::consume(
+    uint64_t id,
+    Clock::time_point now) {
+  uint32_t window = id >> 32;
+  auto current = getWindow(now);
+  if (window > static_cast<uint64_t>(current) + 1) {
+    VLOG(8) << "Ticket id from a future window, id=" << id;
+    return ReplayCacheResult::MaybeReplay;
+  }
+  if (current >= validWindows_ && window < current - validWindows_) {
+    return ReplayCacheResult::DefinitelyReplay;
+  }
+  if (window < firstWindow_) {
+    return ReplayCacheResult::MaybeReplay;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  prune(current);
+  if (!consumed_[window].add(id & std::numeric_limits<uint32_t>::max())) {
+    return ReplayCacheResult::DefinitelyReplay;
+  }
+  return ReplayCacheResult::NotReplay;
+}
+
+folly::Future<ReplayCacheResult> SingleUseTicketReplayCache::check(
+    folly::ByteRange identifier) {
+  if (identifier.size() != sizeof(uint64_t)) {
+    return ReplayCacheResult::MaybeReplay;
+  }
+  uint64_t id;
+  std::memcpy(&id, identifier.data(), sizeof(id));
+  return consume(folly::Endian::big(id));
+}
+
+size_t SingleUseTicketReplayCache::getMemoryUsage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t total = 0;
+  for (const auto& bitmap : consumed_) {
+    total += sizeof(bitmap) + bitmap.second.getMemoryUsage();
+  }
+  return total;
+}
+
+uint32_t SingleUseTicketReplayCache::getWindow(Clock::time_point now) const {
+  auto sinceEpoch =
+      std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch());
+  if (sinceEpoch.count() < 0) {
+    return 0;
+  }
+  return sinceEpoch.count() / window_.count();
+}
+
+void SingleUseTicketReplayCache::prune(uint32_t window) {
+  if (window < validWindows_) {
+    return;
+  }
+  consumed_.erase(
+      consumed_.begin(), consumed_.lower_bound(window - validWindows_));
+}
+
+bool SingleUseTicketReplayCache::Bitmap::add(uint32_t value) {
+  auto& container = containers_[value >> 16];
+  uint16_t low = value & 0xffff;
+
+  if (!container.bitset.empty()) {
+    auto& word = container.bitset[low / 64];
+    uint64_t bit = uint64_t(1) << (low % 64);
+    if (word & bit) {
+      return false;
+    }
+    word |= bit;
+    return true;
+  }
+
+  auto& array = container.array;
+  auto it = std::lower_bound(array.begin(), array.end(), low);
+  if (it != array.end() && *it == low) {
+    return false;
+  }
+  array.insert(it, low);
+  if (array.size() > kMaxArraySize) {
+    // Past this size a bitset is smaller than the array.
+    container.bitset.assign(kBitsetWords, 0);
+    for (auto v : array) {
+      container.bitset[v / 64] |= uint64_t(1) << (v % 64);
+    }
+    std::vector<uint16_t>().swap(array);
+  }
+  return true;
+}
+
+size_t SingleUseTicketReplayCache::Bitmap::getMemoryUsage() const {
+  size_t total = 0;
+  for (const auto& container : containers_) {
+    total += sizeof(container) + container.second.array.capacity() * 2 +
+        container.second.bitset.capacity() * 8;
+  }
+  return total;
+}
+} // namespace server
+} // namespace fizz
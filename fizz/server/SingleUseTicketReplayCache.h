@@ -0,0 +1,108 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/ReplayCache.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace fizz {
+namespace server {
+
+/**
+ * Anti-replay for early data that accepts each ticket at most once, instead
+ * of remembering every ClientHello seen.
+ *
+ * Every issued ticket carries a 64-bit id: the rotation window it was issued
+ * in in the high 32 bits, and a per-window counter in the low 32 bits, so
+ * ids increase monotonically. Consumed ids are tracked per window in a
+ * compressed (Roaring-style) bitmap, and windows older than the ticket
+ * validity are dropped, as their tickets can no longer be resumed. With ids
+ * issued in sequence, a million tickets take about 128KB to track.
+ *
+ * Ids are only unique per instance, so tickets must be resumed on the server
+ * that issued them. Consumed ids are not persisted; tickets from windows
+ * before the cache was created are reported as MaybeReplay.
+ *
+ * Used through FizzServerContext::setSingleUseTickets, which checks the id of
+ * the decrypted ticket. check() can also be called directly with an 8 byte
+ * big endian id.
+ */
+class SingleUseTicketReplayCache : public ReplayCache {
+ public:
+  using Clock = std::chrono::system_clock;
+
+  SingleUseTicketReplayCache(
+      std::chrono::seconds window,
+      std::chrono::seconds ticketValidity);
+
+  /**
+   * Returns the id for a new ticket. Lock free.
+   */
+  uint64_t issueTicketId(Clock::time_point now = Clock::now());
+
+  /**
+   * Marks id as used. Returns DefinitelyReplay if it was already used or is
+   * from a window no longer tracked, and MaybeReplay if it is not from a
+   * window issued yet.
+   */
+  ReplayCacheResult consume(uint64_t id, Clock::time_point now = Clock::now());
+
+  folly::Future<ReplayCacheResult> check(folly::ByteRange identifier) override;
+
+  /**
+   * Approximate bytes used to track consumed ids.
+   */
+  size_t getMemoryUsage() const;
+
+ private:
+  /**
+   * Set of 32-bit values, split by their high 16 bits into containers that
+   * are sorted arrays while sparse and bitsets once dense.
+   */
+  class Bitmap {
+   public:
+    // Returns false if value was already set.
+    bool add(uint32_t value);
+    size_t getMemoryUsage() const;
+
+   private:
+    static constexpr size_t kMaxArraySize = 4096;
+    static constexpr size_t kBitsetWords = 1024;
+
+    struct Container {
+      std::vector<uint16_t> array;
+      std::vector<uint64_t> bitset;
+    };
+
+    std::map<uint16_t, Container> containers_;
+  };
+
+  uint32_t getWindow(Clock::time_point now) const;
+
+  void prune(uint32_t window);
+
+  std::chrono::seconds window_;
+  // Number of previous windows whose tickets may still be valid.
+  uint32_t validWindows_;
+  uint32_t firstWindow_;
+
+  // Window in the high 32 bits, next counter value in the low 32 bits.
+  std::atomic<uint64_t> nextId_;
+
+  mutable std::mutex mutex_;
+  std::map<uint32_t, Bitmap> consumed_;
+};
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,146 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/SlidingBloomReplayCache.h>
+
+#include <fizz/crypto/RandomGenerator.h>
+#include <folly/hash/SpookyHashV2.h>
+
+#include <cmath>
+
+namespace fizz {
+namespace server {
+
+SlidingBloomReplayCache::SlidingBloomReplayCache(
+    std::chrono::seconds window,
+    size_t requestsPerSecond,
+    double falsePositiveRate,
+    std::shared_ptr<ReplayCache> remote)
+    : start_(Clock::now()), remote_(std::move(remote)) {
+  if (window.count() <= 0 || requestsPerSecond == 0) {
+    throw std::runtime_error("invalid replay cache window or rate");
+  }
+  if (falsePositiveRate <= 0 || falsePositiveRate >= 1) {
+    throw std::runtime_error("invalid replay cache false positive rate");
+  }
+
+  // Identifiers are remembered for at least kBucketCount - 2 buckets, so
+  // the filter holds up to kBucketCount / (kBucketCount - 2) windows worth.
+  // Standard Bloom filter sizing for n elements: m = -n ln(p) / ln(2)^2
+  // cells and k = m / n ln(2) hashes.
+  auto checksPerBucket = static_cast<double>(requestsPerSecond) *
+      window.count() / (kBucketCount - 2);
+  auto elements = checksPerBucket * kBucketCount;
+  auto cells = std::ceil(
+      -elements * std::log(falsePositiveRate) / (std::log(2) * std::log(2)));
+  cellCount_ = std::max<size_t>(static_cast<size_t>(cells), 1);
+  hashCount_ = std::max<size_t>(
+      static_cast<size_t>(std::round(cells / elements * std::log(2))), 1);
+  cells_.reset(new Cell[cellCount_]());
+  // The next bucket starts out empty. At the expected rate it is emptied
+  // again within the first half of the current bucket.
+  sweepCursor_ = cellCount_;
+  sweepChunk_ = std::max<size_t>(
+      static_cast<size_t>(std::ceil(2 * cells / checksPerBucket)), 64);
+
+  // Random seeds so that colliding identifiers can't be precomputed.
+  hashSeed1_ = RandomNumGenerator<uint64_t>().generateRandom();
+  hashSeed2_ = RandomNumGenerator<uint64_t>().generateRandom();
+
+  bucketDuration_ = std::chrono::duration_cast<Clock::duration>(window) /
+      (kBucketCount - 2);
+}
+
+SlidingBloomReplayCache::~SlidingBloomReplayCache() = default;
+
+folly::Future<ReplayCacheResult> SlidingBloomReplayCache::check(
+    folly::ByteRange identifier) {
+  if (!testAndSet(identifier, Clock::now())) {
+    if (remote_) {
+      // Let the remote cache know about the identifier; we don't need its
+      // answer.
+      remote_->check(identifier);
+    }
+    return folly::makeFuture(ReplayCacheResult::NotReplay);
+  }
+  if (remote_) {
+    return remote_->check(identifier);
+  }
+  return folly::makeFuture(ReplayCacheResult::MaybeReplay);
+}
+
+bool SlidingBloomReplayCache::testAndSet(
+    folly::ByteRange identifier,
+    Clock::time_point now) {
+  auto bit = advance(now);
+
+  uint64_t hash1 = hashSeed1_;
+  uint64_t hash2 = hashSeed2_;
+  folly::hash::SpookyHashV2::Hash128(
+      identifier.data(), identifier.size(), &hash1, &hash2);
+
+  // An identifier was seen if all its cells share a bucket.
+  uint8_t seen = 0xff;
+  for (size_t i = 0; i < hashCount_; ++i) {
+    auto& cell = cells_[(hash1 + i * hash2) % cellCount_];
+    seen &= cell.fetch_or(bit, std::memory_order_relaxed);
+  }
+  return seen != 0;
+}
+
+void SlidingBloomReplayCache::clear() {
+  for (size_t i = 0; i < cellCount_; ++i) {
+    cells_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+uint8_t SlidingBloomReplayCache::advance(Clock::time_point now) {
+  uint64_t bucket = 0;
+  if (now > start_) {
+    bucket = static_cast<uint64_t>((now - start_) / bucketDuration_);
+  }
+  if (bucket > currentBucket_.load(std::memory_order_acquire) ||
+      sweepCursor_.load(std::memory_order_relaxed) < cellCount_) {
+    std::unique_lock<std::mutex> lock(sweepMutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      // Another check is on it, keep using the current bucket.
+      return bucketBit(currentBucket_.load(std::memory_order_acquire));
+    }
+    auto current = currentBucket_.load(std::memory_order_relaxed);
+    auto cursor = sweepCursor_.load(std::memory_order_relaxed);
+    if (current < bucket) {
+      // Finish emptying the next bucket, and empty any we skip over, before
+      // moving to them. The current bucket's bit is only cleared when it
+      // expired too, i.e. after a whole window without checks.
+      sweep(cursor, cellCount_, bucketBit(current + 1));
+      uint8_t expired = 0;
+      for (auto b = current + 2; b <= bucket && b <= current + kBucketCount;
+           ++b) {
+        expired |= bucketBit(b);
+      }
+      if (expired) {
+        sweep(0, cellCount_, expired);
+      }
+      currentBucket_.store(bucket, std::memory_order_release);
+      current = bucket;
+      cursor = 0;
+    }
+    auto end = std::min(cellCount_, cursor + sweepChunk_);
+    sweep(cursor, end, bucketBit(current + 1));
+    sweepCursor_.store(end, std::memory_order_relaxed);
+  }
+  return bucketBit(currentBucket_.load(std::memory_order_acquire));
+}
+
+void SlidingBloomReplayCache::sweep(size_t begin, size_t end, uint8_t bits) {
+  for (size_t i = begin; i < end; ++i) {
+    cells_[i].fetch_and(~bits, std::memory_order_relaxed);
+  }
+}
+} // namespace server
+} // namespace fizz
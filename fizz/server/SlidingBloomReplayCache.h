@@ -0,0 +1,118 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/ReplayCache.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+namespace fizz {
+namespace server {
+
+/**
+ * Replay cache backed by a time windowed Bloom filter. Each filter cell
+ * holds one bit per time bucket; identifiers are recorded in the current
+ * bucket, and the bucket after it is emptied a few cells per check so that
+ * it is empty by the time it becomes current. Memory is fixed and
+ * identifiers are remembered for between the window and 4/3 of it. Checks
+ * never block and complete synchronously.
+ *
+ * An identifier that is not in the filter is recorded and NotReplay is
+ * returned right away. One that is (either a replay or a false positive)
+ * is reported as MaybeReplay, or resolved by the remote cache if one is
+ * set. The remote cache, typically shared by all servers, is also told
+ * about every new identifier, without waiting for the result, so that it
+ * can recognize replays sent to a server that has seen the original. A
+ * replay sent to a different server than the original is only caught
+ * when the remote cache resolves it, i.e. not on the local fast path.
+ */
+class SlidingBloomReplayCache : public ReplayCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Sizes the filter for requestsPerSecond identifiers per second over
+   * window at the given false positive rate.
+   */
+  SlidingBloomReplayCache(
+      std::chrono::seconds window,
+      size_t requestsPerSecond,
+      double falsePositiveRate,
+      std::shared_ptr<ReplayCache> remote = nullptr);
+
+  ~SlidingBloomReplayCache() override;
+
+  folly::Future<ReplayCacheResult> check(
+      folly::ByteRange identifier) override;
+
+  /**
+   * Records identifier at now and returns whether it may have been recorded
+   * before, within the window.
+   */
+  bool testAndSet(folly::ByteRange identifier, Clock::time_point now);
+
+  /**
+   * Forget all identifiers.
+   */
+  void clear();
+
+  size_t getCellCount() const {
+    return cellCount_;
+  }
+
+  size_t getHashCount() const {
+    return hashCount_;
+  }
+
+ private:
+  using Cell = std::atomic<uint8_t>;
+  static constexpr size_t kBucketCount = 8;
+
+  /**
+   * Moves the current bucket to the one for now, if no other check is
+   * already doing so, empties the next chunk of the bucket after it, and
+   * returns the current bucket's bit.
+   */
+  uint8_t advance(Clock::time_point now);
+
+  /**
+   * Clears bits from the cells in [begin, end).
+   */
+  void sweep(size_t begin, size_t end, uint8_t bits);
+
+  static uint8_t bucketBit(uint64_t bucket) {
+    return 1 << (bucket % kBucketCount);
+  }
+
+  size_t cellCount_;
+  size_t hashCount_;
+  std::unique_ptr<Cell[]> cells_;
+
+  uint64_t hashSeed1_;
+  uint64_t hashSeed2_;
+
+  Clock::time_point start_;
+  Clock::duration bucketDuration_;
+  // Number of the current time bucket since start_.
+  std::atomic<uint64_t> currentBucket_{0};
+
+  // Held while rotating or sweeping; checks that can't take it use the
+  // current bucket as is.
+  std::mutex sweepMutex_;
+  // Cells up to which the bucket after the current one has been emptied.
+  std::atomic<size_t> sweepCursor_;
+  size_t sweepChunk_;
+
+  std::shared_ptr<ReplayCache> remote_;
+};
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,105 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/SniTicketCipher.h>
+
+#include <folly/String.h>
+
+namespace fizz {
+namespace server {
+
+constexpr size_t SniTicketCipher::kMaxCiphers;
+
+void SniTicketCipher::setCipher(
+    const std::string& serverName,
+    std::shared_ptr<TicketCipher> cipher) {
+  auto key = serverName;
+  folly::toLowerAscii(key);
+  auto it = serverNames_.find(key);
+  if (it != serverNames_.end()) {
+    ciphers_[it->second] = std::move(cipher);
+  } else {
+    serverNames_.emplace(std::move(key), addCipher(std::move(cipher)));
+  }
+}
+
+void SniTicketCipher::setDefaultCipher(std::shared_ptr<TicketCipher> cipher) {
+  if (default_) {
+    ciphers_[*default_] = std::move(cipher);
+  } else {
+    default_ = addCipher(std::move(cipher));
+  }
+}
+
+folly::Future<folly::Optional<std::pair<Buf, std::chrono::seconds>>>
+SniTicketCipher::encrypt(ResumptionState resState) const {
+  auto index = getIndex(resState.serverName);
+  if (!index || !ciphers_[*index]) {
+    VLOG(8) << "No ticket cipher for server name";
+    return folly::none;
+  }
+  return ciphers_[*index]->encrypt(std::move(resState));
+}
+
+folly::Future<std::pair<PskType, folly::Optional<ResumptionState>>>
+SniTicketCipher::decrypt(std::unique_ptr<folly::IOBuf> encryptedTicket) const {
+  return decryptForServerName(std::move(encryptedTicket), folly::none);
+}
+
+folly::Future<std::pair<PskType, folly::Optional<ResumptionState>>>
+SniTicketCipher::decryptForServerName(
+    std::unique_ptr<folly::IOBuf> encryptedTicket,
+    const folly::Optional<std::string>& serverName) const {
+  auto index = getIndex(serverName);
+  if (!index || !ciphers_[*index]) {
+    return std::make_pair(PskType::Rejected, folly::none);
+  }
+  auto expected = serverName;
+  if (expected) {
+    folly::toLowerAscii(*expected);
+  }
+  return ciphers_[*index]
+      ->decrypt(std::move(encryptedTicket))
+      .then([expected = std::move(expected)](
+                std::pair<PskType, folly::Optional<ResumptionState>> result) {
+        if (result.second && result.second->serverName) {
+          auto issuedFor = *result.second->serverName;
+          folly::toLowerAscii(issuedFor);
+          if (!expected || issuedFor != *expected) {
+            VLOG(8) << "Ticket issued for another server name";
+            return std::make_pair(
+                PskType::Rejected, folly::Optional<ResumptionState>());
+          }
+        }
+        return result;
+      });
+}
+
+SniTicketCipher::Index SniTicketCipher::addCipher(
+    std::shared_ptr<TicketCipher> cipher) {
+  if (ciphers_.size() >= kMaxCiphers) {
+    throw std::runtime_error("too many ticket ciphers");
+  }
+  ciphers_.push_back(std::move(cipher));
+  return ciphers_.size() - 1;
+}
+
+folly::Optional<SniTicketCipher::Index> SniTicketCipher::getIndex(
+    const folly::Optional<std::string>& serverName) const {
+  if (serverName) {
+    auto key = *serverName;
+    folly::toLowerAscii(key);
+    auto it = serverNames_.find(key);
+    if (it != serverNames_.end()) {
+      return it->second;
+    }
+  }
+  return default_;
+}
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,75 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/TicketCipher.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace fizz {
+namespace server {
+
+/**
+ * TicketCipher that picks a per-tenant cipher (typically an
+ * AeadTicketCipher with the tenant's ticket secrets) by the SNI of the
+ * connection, so tenants get separate ticket keys while sharing one
+ * FizzServerContext.
+ *
+ * Tickets are decrypted with the cipher for the SNI of the connection they
+ * are offered on, so a ticket only resumes connections to the tenant that
+ * issued it, and nothing in the ticket identifies the tenant to observers.
+ * Tickets whose decrypted state names another server are rejected as well,
+ * in case names share a cipher. Server names are matched case
+ * insensitively. Connections without a matching server name use the default
+ * cipher, or get no ticket if there is none.
+ *
+ * Ciphers must be set before the cipher is in use.
+ */
+class SniTicketCipher : public TicketCipher {
+ public:
+  static constexpr size_t kMaxCiphers = 0xffff;
+
+  /**
+   * Sets the cipher for serverName, replacing any previous one.
+   */
+  void setCipher(
+      const std::string& serverName,
+      std::shared_ptr<TicketCipher> cipher);
+
+  void setDefaultCipher(std::shared_ptr<TicketCipher> cipher);
+
+  folly::Future<folly::Optional<std::pair<Buf, std::chrono::seconds>>> encrypt(
+      ResumptionState resState) const override;
+
+  /**
+   * Decrypts with the default cipher, as if offered without SNI.
+   */
+  folly::Future<std::pair<PskType, folly::Optional<ResumptionState>>> decrypt(
+      std::unique_ptr<folly::IOBuf> encryptedTicket) const override;
+
+  folly::Future<std::pair<PskType, folly::Optional<ResumptionState>>>
+  decryptForServerName(
+      std::unique_ptr<folly::IOBuf> encryptedTicket,
+      const folly::Optional<std::string>& serverName) const override;
+
+ private:
+  using Index = uint16_t;
+
+  Index addCipher(std::shared_ptr<TicketCipher> cipher);
+
+  folly::Optional<Index> getIndex(
+      const folly::Optional<std::string>& serverName) const;
+
+  std::vector<std::shared_ptr<TicketCipher>> ciphers_;
+  std::unordered_map<std::string, Index> serverNames_;
+  folly::Optional<Index> default_;
+};
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,175 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/StapledSelfCert.h>
+
+#include <fizz/record/Extensions.h>
+
+#include <algorithm>
+
+namespace fizz {
+
+StapledSelfCert::StapledSelfCert(
+    std::shared_ptr<const SelfCert> cert,
+    Fetcher fetcher)
+    : cert_(std::move(cert)),
+      fetcher_(std::move(fetcher)),
+      messages_(std::make_shared<const StapledMessages>()) {}
+
+std::string StapledSelfCert::getIdentity() const {
+  return cert_->getIdentity();
+}
+
+std::vector<std::string> StapledSelfCert::getAltIdentities() const {
+  return cert_->getAltIdentities();
+}
+
+std::vector<SignatureScheme> StapledSelfCert::getSigSchemes() const {
+  return cert_->getSigSchemes();
+}
+
+CertificateMsg StapledSelfCert::getCertMessage(
+    Buf certificateRequestContext) const {
+  return cert_->getCertMessage(std::move(certificateRequestContext));
+}
+
+CertificateType StapledSelfCert::getCertificateType() const {
+  return cert_->getCertificateType();
+}
+
+Buf StapledSelfCert::getEncodedCertMessage() const {
+  return cert_->getEncodedCertMessage();
+}
+
+Buf StapledSelfCert::getStapledCertMessage(
+    const std::vector<ExtensionType>& requestedExtensions) const {
+  auto requested = [&requestedExtensions](ExtensionType type) {
+    return std::find(
+               requestedExtensions.begin(), requestedExtensions.end(), type) !=
+        requestedExtensions.end();
+  };
+  auto ocsp = requested(ExtensionType::status_request);
+  auto sct = requested(ExtensionType::signed_certificate_timestamp);
+
+  auto messages = messages_.load();
+  if (ocsp && sct && messages->ocspAndSct) {
+    return messages->ocspAndSct->clone();
+  } else if (ocsp && messages->ocsp) {
+    return messages->ocsp->clone();
+  } else if (sct && messages->sct) {
+    return messages->sct->clone();
+  }
+  return nullptr;
+}
+
+std::shared_ptr<const SelfCert> StapledSelfCert::getDelegatedCert(
+    const std::vector<SignatureScheme>& peerCredentialSchemes,
+    const std::vector<SignatureScheme>& peerSigSchemes) const {
+  return cert_->getDelegatedCert(peerCredentialSchemes, peerSigSchemes);
+}
+
+Buf StapledSelfCert::sign(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    folly::ByteRange toBeSigned) const {
+  return cert_->sign(scheme, context, toBeSigned);
+}
+
+std::vector<Buf> StapledSelfCert::signBatch(
+    SignatureScheme scheme,
+    CertificateVerifyContext context,
+    const std::vector<folly::ByteRange>& toBeSigned) const {
+  return cert_->signBatch(scheme, context, toBeSigned);
+}
+
+folly::ssl::X509UniquePtr StapledSelfCert::getX509() const {
+  return cert_->getX509();
+}
+
+void StapledSelfCert::setStaple(Staple staple) {
+  auto hasOcsp = staple.ocspResponse && !staple.ocspResponse->empty();
+  auto hasSct = staple.sctList && !staple.sctList->empty();
+
+  auto messages = std::make_shared<StapledMessages>();
+  if (hasOcsp) {
+    messages->ocsp = encodeStapled(staple.ocspResponse, nullptr);
+  }
+  if (hasSct) {
+    messages->sct = encodeStapled(nullptr, staple.sctList);
+  }
+  if (hasOcsp && hasSct) {
+    messages->ocspAndSct = encodeStapled(staple.ocspResponse, staple.sctList);
+  }
+  messages_.store(std::move(messages));
+}
+
+Buf StapledSelfCert::encodeStapled(
+    const Buf& ocspResponse,
+    const Buf& sctList) const {
+  auto msg = cert_->getCertMessage();
+  if (msg.certificate_list.empty()) {
+    throw std::runtime_error("no leaf certificate to staple");
+  }
+  auto& leaf = msg.certificate_list.front();
+  if (ocspResponse) {
+    CertificateStatus status;
+    status.status_type = CertificateStatusType::ocsp;
+    status.ocsp_response = ocspResponse->clone();
+    leaf.extensions.push_back(encodeExtension(std::move(status)));
+  }
+  if (sctList) {
+    SignedCertificateTimestamps scts;
+    scts.sct_list = sctList->clone();
+    leaf.extensions.push_back(encodeExtension(std::move(scts)));
+  }
+  return encodeHandshake(std::move(msg));
+}
+
+folly::Future<folly::Unit> StapledSelfCert::refresh() {
+  std::weak_ptr<StapledSelfCert> weak = shared_from_this();
+  return folly::makeFutureWith([this]() { return fetcher_(); })
+      .then([weak](folly::Try<Staple> staple) {
+        if (staple.hasException()) {
+          VLOG(2) << "staple refresh failed: " << staple.exception().what();
+          return;
+        }
+        auto self = weak.lock();
+        if (self) {
+          self->setStaple(std::move(*staple));
+        }
+      });
+}
+
+void StapledSelfCert::startRefresh(
+    folly::EventBase* evb,
+    std::chrono::milliseconds interval) {
+  std::weak_ptr<StapledSelfCert> weak = shared_from_this();
+  evb->runInEventBaseThread([weak, evb, interval]() {
+    auto self = weak.lock();
+    if (self) {
+      self->refresh();
+      self->scheduleRefresh(evb, interval);
+    }
+  });
+}
+
+void StapledSelfCert::scheduleRefresh(
+    folly::EventBase* evb,
+    std::chrono::milliseconds interval) {
+  std::weak_ptr<StapledSelfCert> weak = shared_from_this();
+  evb->runAfterDelay(
+      [weak, evb, interval]() {
+        auto self = weak.lock();
+        if (self) {
+          self->refresh();
+          self->scheduleRefresh(evb, interval);
+        }
+      },
+      interval.count());
+}
+} // namespace fizz
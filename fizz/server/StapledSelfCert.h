@@ -0,0 +1,119 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/protocol/Certificate.h>
+#include <folly/concurrency/AtomicSharedPtr.h>
+#include <folly/futures/Future.h>
+#include <folly/io/async/EventBase.h>
+
+#include <chrono>
+#include <functional>
+
+namespace fizz {
+
+/**
+ * SelfCert that attaches an OCSP staple and signed certificate timestamps to
+ * the leaf CertificateEntry for clients that request them. The Certificate
+ * messages carrying the staple are encoded when the staple changes, and
+ * swapped in atomically, so handshakes never wait on fetching a staple and a
+ * handshake in progress keeps the message it already got.
+ *
+ * The staple is fetched with the Fetcher, either on demand with refresh() or
+ * periodically with startRefresh(). A failed fetch keeps the current staple.
+ *
+ * To combine with batched signing, wrap this in a BatchingSelfCert, which
+ * forwards getStapledCertMessage().
+ *
+ * Must be owned by a shared_ptr.
+ */
+class StapledSelfCert : public SelfCert,
+                        public std::enable_shared_from_this<StapledSelfCert> {
+ public:
+  struct Staple {
+    // DER encoded OCSPResponse, or nullptr if not stapling OCSP.
+    Buf ocspResponse;
+    // Contents of the SignedCertificateTimestampList, or nullptr if not
+    // sending SCTs.
+    Buf sctList;
+  };
+
+  using Fetcher = std::function<folly::Future<Staple>()>;
+
+  StapledSelfCert(std::shared_ptr<const SelfCert> cert, Fetcher fetcher);
+
+  ~StapledSelfCert() override = default;
+
+  std::string getIdentity() const override;
+
+  std::vector<std::string> getAltIdentities() const override;
+
+  std::vector<SignatureScheme> getSigSchemes() const override;
+
+  CertificateMsg getCertMessage(
+      Buf certificateRequestContext = nullptr) const override;
+
+  CertificateType getCertificateType() const override;
+
+  Buf getEncodedCertMessage() const override;
+
+  Buf getStapledCertMessage(
+      const std::vector<ExtensionType>& requestedExtensions) const override;
+
+  std::shared_ptr<const SelfCert> getDelegatedCert(
+      const std::vector<SignatureScheme>& peerCredentialSchemes,
+      const std::vector<SignatureScheme>& peerSigSchemes) const override;
+
+  Buf sign(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      folly::ByteRange toBeSigned) const override;
+
+  std::vector<Buf> signBatch(
+      SignatureScheme scheme,
+      CertificateVerifyContext context,
+      const std::vector<folly::ByteRange>& toBeSigned) const override;
+
+  folly::ssl::X509UniquePtr getX509() const override;
+
+  /**
+   * Replaces the staple.
+   */
+  void setStaple(Staple staple);
+
+  /**
+   * Fetches a new staple and installs it. The returned future completes once
+   * the staple is installed, or the fetch failed.
+   */
+  folly::Future<folly::Unit> refresh();
+
+  /**
+   * Refreshes the staple now, and then every interval on evb, until this is
+   * destroyed.
+   */
+  void startRefresh(folly::EventBase* evb, std::chrono::milliseconds interval);
+
+ private:
+  struct StapledMessages {
+    Buf ocsp;
+    Buf sct;
+    Buf ocspAndSct;
+  };
+
+  Buf encodeStapled(const Buf& ocspResponse, const Buf& sctList) const;
+
+  void scheduleRefresh(
+      folly::EventBase* evb,
+      std::chrono::milliseconds interval);
+
+  std::shared_ptr<const SelfCert> cert_;
+  Fetcher fetcher_;
+  folly::atomic_shared_ptr<const StapledMessages> messages_;
+};
+} // namespace fizz
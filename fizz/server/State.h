@@ -12,6 +12,7 @@
 
 #include <fizz/protocol/Certificate.h>
 #include <fizz/protocol/KeyScheduler.h>
+#include <fizz/protocol/TLSHistograms.h>
 #include <fizz/protocol/Types.h>
 #include <fizz/record/Extensions.h>
 #include <fizz/record/RecordLayer.h>
@@ -49,6 +50,47 @@ struct HandshakeLogging {
   std::vector<SignatureScheme> clientSignatureAlgorithms;
   folly::Optional<bool> clientSessionIdSent;
   folly::Optional<Random> clientRandom;
+  folly::Optional<uint64_t> clientFingerprint;
+};
+
+/**
+ * What was negotiated on a ClientHello that was answered with a
+ * HelloRetryRequest. The second ClientHello is only checked for consistency
+ * with the first (RFC 8446 4.1.2) and these results are reused for it, rather
+ * than decrypting the ticket and negotiating again.
+ */
+struct HelloRetryState {
+  Buf legacySessionId;
+  std::vector<CipherSuite> cipherSuites;
+  // The extensions of the first ClientHello that the second has to repeat
+  // byte for byte.
+  std::vector<Extension> unchangedExtensions;
+  // The identity of the PSK offered, if any, and the result of decrypting
+  // and validating it.
+  Buf pskIdentity;
+  PskType pskType;
+  folly::Optional<PskKeyExchangeMode> pskMode;
+  folly::Optional<ResumptionState> resState;
+  folly::Optional<std::string> alpn;
+  folly::Optional<std::string> sni;
+};
+
+/**
+ * State that is only needed while the handshake is in progress. This is kept
+ * in a separate allocation so that it can be released once the connection
+ * reaches AcceptingData, keeping the steady-state State small.
+ */
+struct HandshakeState {
+  // The handshake read record layer, stored here while accepting early data.
+  std::unique_ptr<EncryptedReadRecordLayer> handshakeReadRecordLayer;
+  std::unique_ptr<HandshakeContext> handshakeContext;
+  folly::Optional<std::vector<std::shared_ptr<const PeerCert>>>
+      unverifiedCertChain;
+  folly::Optional<Buf> clientHandshakeSecret;
+  std::unique_ptr<HandshakeAdmissionController::PendingHandshake>
+      pendingHandshake;
+  std::unique_ptr<HelloRetryState> helloRetryState;
+  std::shared_ptr<HandshakeTimings> timings;
 };
 
 /**
@@ -77,6 +119,14 @@ class State {
     return executor_;
   }
 
+  /**
+   * Id passed to the context's HandshakeTracer for this connection, 0 if
+   * the context had no tracer when the connection started.
+   */
+  uint64_t handshakeId() const {
+    return handshakeId_;
+  }
+
   /**
    * The FizzServerContext used on this connection.
    */
@@ -87,7 +137,7 @@ class State {
   /**
    * The certificate used to authenticate the server. May be null.
    */
-  std::shared_ptr<const Cert> serverCert() const {
+  const std::shared_ptr<const Cert>& serverCert() const {
     return serverCert_;
   }
 
@@ -169,6 +219,13 @@ class State {
     return alpn_;
   }
 
+  /**
+   * Server name the client asked for, if any.
+   */
+  const folly::Optional<std::string>& sni() const {
+    return sni_;
+  }
+
   /**
    * How much the client ticket age was off (on a PSK connection). Negative if
    * the client was behind.
@@ -230,7 +287,34 @@ class State {
    * Should not be used outside of the state machine.
    */
   const Buf& clientHandshakeSecret() const {
-    return *clientHandshakeSecret_;
+    return *handshake().clientHandshakeSecret;
+  }
+
+  /**
+   * Results kept from the first ClientHello after a HelloRetryRequest. May be
+   * null.
+   *
+   * Should not be used outside of the state machine.
+   */
+  const HelloRetryState* helloRetryState() const {
+    return handshake().helloRetryState.get();
+  }
+
+  /**
+   * Times the handshake for TLSHistograms. Only set while the handshake is in
+   * progress and TLSHistograms were enabled when it started.
+   *
+   * Should not be used outside of the state machine.
+   */
+  std::shared_ptr<HandshakeTimings> handshakeTimings() const {
+    return handshakeState_ ? handshakeState_->timings : nullptr;
+  }
+
+  /**
+   * Whether the state that is only kept during the handshake is allocated.
+   */
+  bool hasHandshakeState() const {
+    return handshakeState_ != nullptr;
   }
 
   /**
@@ -243,9 +327,9 @@ class State {
   }
 
   /**
-   * Resumption master secret.
+   * Resumption master secret. Derived when a ticket is first issued.
    */
-  const std::vector<uint8_t>& resumptionMasterSecret() const {
+  const DeferredSecret<std::vector<uint8_t>>& resumptionMasterSecret() const {
     return resumptionMasterSecret_;
   }
 
@@ -256,24 +340,32 @@ class State {
    */
   const folly::Optional<std::vector<std::shared_ptr<const PeerCert>>>&
   unverifiedCertChain() const {
-    return unverifiedCertChain_;
+    return handshake().unverifiedCertChain;
   }
 
   /**
    * Get the early exporter master secret. Only available if early data was
-   * accepted.
+   * accepted. Derived on first use.
    */
-  const folly::Optional<Buf>& earlyExporterMasterSecret() const {
+  const DeferredSecret<Buf>& earlyExporterMasterSecret() const {
     return earlyExporterMasterSecret_;
   }
 
   /**
-   * Get the exporter master secret.
+   * Get the exporter master secret. Derived on first use.
    */
-  const folly::Optional<Buf>& exporterMasterSecret() const {
+  const DeferredSecret<Buf>& exporterMasterSecret() const {
     return exporterMasterSecret_;
   }
 
+  /**
+   * Aead for the client's next key update, if prepared ahead of time (see
+   * FizzServerContext::setPrepareKeyUpdates()).
+   */
+  const std::unique_ptr<Aead>& nextClientAead() const {
+    return nextClientAead_;
+  }
+
   /*
    * State setters.
    */
@@ -283,6 +375,9 @@ class State {
   auto& executor() {
     return executor_;
   }
+  auto& handshakeId() {
+    return handshakeId_;
+  }
   auto& context() {
     return context_;
   }
@@ -296,10 +391,13 @@ class State {
     return writeRecordLayer_;
   }
   auto& handshakeReadRecordLayer() const {
-    return handshakeReadRecordLayer_;
+    return handshake().handshakeReadRecordLayer;
   }
   auto& handshakeContext() const {
-    return handshakeContext_;
+    return handshake().handshakeContext;
+  }
+  auto& handshakeState() {
+    return handshakeState_;
   }
   auto& serverCert() {
     return serverCert_;
@@ -308,7 +406,7 @@ class State {
     return clientCert_;
   }
   auto& unverifiedCertChain() {
-    return unverifiedCertChain_;
+    return handshake().unverifiedCertChain;
   }
   auto& version() {
     return version_;
@@ -338,11 +436,23 @@ class State {
     return replayCacheResult_;
   }
   auto& clientHandshakeSecret() {
-    return clientHandshakeSecret_;
+    return handshake().clientHandshakeSecret;
+  }
+  auto& pendingHandshake() {
+    return handshake().pendingHandshake;
+  }
+  auto& helloRetryState() {
+    return handshake().helloRetryState;
+  }
+  auto& handshakeTimings() {
+    return handshake().timings;
   }
   auto& alpn() {
     return alpn_;
   }
+  auto& sni() {
+    return sni_;
+  }
   auto& clientClockSkew() {
     return clientClockSkew_;
   }
@@ -364,12 +474,24 @@ class State {
   auto& exporterMasterSecret() {
     return exporterMasterSecret_;
   }
+  auto& nextClientAead() {
+    return nextClientAead_;
+  }
 
  private:
+  HandshakeState& handshake() const {
+    if (!handshakeState_) {
+      handshakeState_ = std::make_unique<HandshakeState>();
+    }
+    return *handshakeState_;
+  }
+
   StateEnum state_{StateEnum::Uninitialized};
 
   folly::Executor* executor_;
 
+  uint64_t handshakeId_{0};
+
   std::shared_ptr<const FizzServerContext> context_;
 
   std::unique_ptr<KeyScheduler> keyScheduler_;
@@ -377,16 +499,12 @@ class State {
   std::unique_ptr<ReadRecordLayer> readRecordLayer_;
   std::unique_ptr<WriteRecordLayer> writeRecordLayer_;
 
-  // The handshake read record layer, stored here while accepting early data.
-  mutable std::unique_ptr<EncryptedReadRecordLayer> handshakeReadRecordLayer_;
-  mutable std::unique_ptr<HandshakeContext> handshakeContext_;
+  // Allocated on first use and released on reaching AcceptingData.
+  mutable std::unique_ptr<HandshakeState> handshakeState_;
 
   std::shared_ptr<const Cert> serverCert_;
   std::shared_ptr<const Cert> clientCert_;
 
-  folly::Optional<std::vector<std::shared_ptr<const PeerCert>>>
-      unverifiedCertChain_;
-
   folly::Optional<ProtocolVersion> version_;
   folly::Optional<CipherSuite> cipher_;
   folly::Optional<NamedGroup> group_;
@@ -396,17 +514,19 @@ class State {
   folly::Optional<KeyExchangeType> keyExchangeType_;
   folly::Optional<EarlyDataType> earlyDataType_;
   folly::Optional<ReplayCacheResult> replayCacheResult_;
-  folly::Optional<Buf> clientHandshakeSecret_;
   folly::Optional<std::string> alpn_;
+  folly::Optional<std::string> sni_;
   folly::Optional<std::chrono::milliseconds> clientClockSkew_;
   std::unique_ptr<AppTokenValidator> appTokenValidator_;
   std::shared_ptr<ServerExtensions> extensions_;
-  std::vector<uint8_t> resumptionMasterSecret_;
+  DeferredSecret<std::vector<uint8_t>> resumptionMasterSecret_;
 
   std::unique_ptr<HandshakeLogging> handshakeLogging_;
 
-  folly::Optional<Buf> earlyExporterMasterSecret_;
-  folly::Optional<Buf> exporterMasterSecret_;
+  DeferredSecret<Buf> earlyExporterMasterSecret_;
+  DeferredSecret<Buf> exporterMasterSecret_;
+
+  std::unique_ptr<Aead> nextClientAead_;
 };
 } // namespace server
 
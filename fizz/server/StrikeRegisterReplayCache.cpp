@@ -0,0 +1,116 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/server/StrikeRegisterReplayCache.h>
+
+#include <fizz/crypto/RandomGenerator.h>
+#include <folly/hash/SpookyHashV2.h>
+
+namespace fizz {
+namespace server {
+
+// Slots hold the fingerprint in the high 48 bits and the window it was
+// recorded in in the low 16 bits. 0 is an empty slot.
+static constexpr uint64_t kWindowMask = 0xffff;
+
+StrikeRegisterReplayCache::StrikeRegisterReplayCache(
+    std::chrono::seconds window,
+    size_t requestsPerSecond,
+    size_t shards)
+    : start_(Clock::now()),
+      window_(std::chrono::duration_cast<Clock::duration>(window)) {
+  if (window.count() <= 0 || requestsPerSecond == 0 || shards == 0) {
+    throw std::runtime_error("invalid strike register parameters");
+  }
+
+  // Up to two windows of entries are live, keep the tables at most half
+  // full.
+  auto entries = 2 * requestsPerSecond * window.count();
+  slotsPerShard_ = std::max<size_t>((2 * entries + shards - 1) / shards, 1);
+  shards_.reserve(shards);
+  for (size_t i = 0; i < shards; ++i) {
+    shards_.emplace_back(slotsPerShard_);
+  }
+
+  hashSeed1_ = RandomNumGenerator<uint64_t>().generateRandom();
+  hashSeed2_ = RandomNumGenerator<uint64_t>().generateRandom();
+}
+
+folly::Future<ReplayCacheResult> StrikeRegisterReplayCache::check(
+    folly::ByteRange identifier) {
+  return folly::makeFuture(checkAt(identifier, Clock::now()));
+}
+
+ReplayCacheResult StrikeRegisterReplayCache::checkAt(
+    folly::ByteRange identifier,
+    Clock::time_point now) {
+  uint64_t hash1 = hashSeed1_;
+  uint64_t hash2 = hashSeed2_;
+  folly::hash::SpookyHashV2::Hash128(
+      identifier.data(), identifier.size(), &hash1, &hash2);
+
+  auto& slots = shards_[hash2 % shards_.size()].slots;
+  auto home = hash2 / shards_.size();
+  uint64_t fingerprint = hash1 & ~kWindowMask;
+  if (fingerprint == 0) {
+    fingerprint = kWindowMask + 1;
+  }
+  auto window = currentWindow(now);
+  uint64_t entry = fingerprint | window;
+  auto isLive = [window](uint64_t value) {
+    return static_cast<uint16_t>(window - (value & kWindowMask)) <= 1;
+  };
+
+  while (true) {
+    // Look for the identifier along its probe sequence, up to the first
+    // empty slot. Slots never become empty again, so a recorded identifier
+    // can't be past it. Remember the first slot we may record it in.
+    std::atomic<uint64_t>* candidate = nullptr;
+    uint64_t candidateValue = 0;
+    for (size_t i = 0; i < kMaxProbes; ++i) {
+      auto& slot = slots[(home + i) % slotsPerShard_];
+      auto value = slot.load(std::memory_order_acquire);
+      if (value == 0) {
+        if (!candidate) {
+          candidate = &slot;
+          candidateValue = 0;
+        }
+        break;
+      }
+      if (!isLive(value)) {
+        if (!candidate) {
+          candidate = &slot;
+          candidateValue = value;
+        }
+        continue;
+      }
+      if ((value & ~kWindowMask) == fingerprint) {
+        return ReplayCacheResult::DefinitelyReplay;
+      }
+    }
+
+    if (!candidate) {
+      return ReplayCacheResult::MaybeReplay;
+    }
+    if (candidate->compare_exchange_strong(
+            candidateValue, entry, std::memory_order_acq_rel)) {
+      return ReplayCacheResult::NotReplay;
+    }
+    // Another check took the slot first, probe again in case it recorded
+    // the same identifier.
+  }
+}
+
+uint16_t StrikeRegisterReplayCache::currentWindow(Clock::time_point now) const {
+  if (now <= start_) {
+    return 0;
+  }
+  return static_cast<uint16_t>((now - start_) / window_);
+}
+} // namespace server
+} // namespace fizz
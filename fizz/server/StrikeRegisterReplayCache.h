@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fizz/server/ReplayCache.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace fizz {
+namespace server {
+
+/**
+ * Lock free in-process replay cache (strike register) for identifiers such
+ * as PSK binders. Identifiers are kept as 48 bit fingerprints in sharded
+ * open addressing tables of atomic slots, each tagged with the time window
+ * it was recorded in. Entries are remembered for between one and two
+ * windows, after which their slots are reused, so memory is fixed.
+ *
+ * A check reads the identifier's probe sequence and records it with a
+ * single compare and swap. Replays are reported as DefinitelyReplay. If an
+ * identifier can't be recorded because its probe sequence is full of live
+ * entries, MaybeReplay is returned.
+ */
+class StrikeRegisterReplayCache : public ReplayCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Sized for requestsPerSecond identifiers per second, each remembered for
+   * at least window, spread over shards tables.
+   */
+  StrikeRegisterReplayCache(
+      std::chrono::seconds window,
+      size_t requestsPerSecond,
+      size_t shards = 64);
+
+  folly::Future<ReplayCacheResult> check(
+      folly::ByteRange identifier) override;
+
+  /**
+   * Synchronous check of identifier at now.
+   */
+  ReplayCacheResult checkAt(
+      folly::ByteRange identifier,
+      Clock::time_point now);
+
+  size_t getCapacity() const {
+    return shards_.size() * slotsPerShard_;
+  }
+
+ private:
+  static constexpr size_t kMaxProbes = 32;
+
+  struct Shard {
+    explicit Shard(size_t slotCount)
+        : slots(new std::atomic<uint64_t>[slotCount]()) {}
+
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+  };
+
+  uint16_t currentWindow(Clock::time_point now) const;
+
+  std::vector<Shard> shards_;
+  size_t slotsPerShard_;
+
+  uint64_t hashSeed1_;
+  uint64_t hashSeed2_;
+
+  Clock::time_point start_;
+  Clock::duration window_;
+};
+} // namespace server
+} // namespace fizz
@@ -37,6 +37,19 @@ class TicketCipher {
    */
   virtual folly::Future<std::pair<PskType, folly::Optional<ResumptionState>>>
   decrypt(std::unique_ptr<folly::IOBuf> encryptedTicket) const = 0;
+
+  /**
+   * Same as decrypt(), for a PSK offered on a connection for serverName (the
+   * client's SNI, if any). Ciphers with per server name keys override it to
+   * decrypt with that name's keys only, so tickets don't resume on another
+   * name's connections. The default implementation ignores serverName.
+   */
+  virtual folly::Future<std::pair<PskType, folly::Optional<ResumptionState>>>
+  decryptForServerName(
+      std::unique_ptr<folly::IOBuf> encryptedTicket,
+      const folly::Optional<std::string>& /* serverName */) const {
+    return decrypt(std::move(encryptedTicket));
+  }
 };
 } // namespace server
 } // namespace fizz
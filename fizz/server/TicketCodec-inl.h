@@ -40,6 +40,9 @@ Buf TicketCodec<Storage>::encode(ResumptionState resState) {
     fizz::detail::writeBuf<uint8_t>(nullptr, appender);
   }
   fizz::detail::writeBuf<uint16_t>(resState.appToken, appender);
+  if (resState.ticketId) {
+    fizz::detail::write(*resState.ticketId, appender);
+  }
   return buf;
 }
 
@@ -69,14 +72,20 @@ ResumptionState TicketCodec<Storage>::decode(
 
   resState.ticketIssueTime = std::chrono::time_point<std::chrono::system_clock>(
       std::chrono::seconds(seconds));
-  if (context) {
-    resState.serverCert =
-        context->getCert(selfIdentity->moveToFbString().toStdString());
+  if (context && !selfIdentity->empty()) {
+    resState.serverCert = std::make_shared<const LazyServerCert>(
+        selfIdentity->moveToFbString().toStdString(), context);
   }
   if (cursor.isAtEnd()) {
     return resState;
   }
   fizz::detail::readBuf<uint16_t>(resState.appToken, cursor);
+  if (cursor.isAtEnd()) {
+    return resState;
+  }
+  uint64_t ticketId;
+  fizz::detail::read(ticketId, cursor);
+  resState.ticketId = ticketId;
 
   return resState;
 }
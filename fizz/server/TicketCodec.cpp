@@ -8,6 +8,8 @@
 
 #include <fizz/server/TicketCodec.h>
 
+#include <algorithm>
+
 namespace fizz {
 std::string toString(fizz::server::CertificateStorage storage) {
   using fizz::server::CertificateStorage;
@@ -23,14 +25,26 @@ std::string toString(fizz::server::CertificateStorage storage) {
   }
 }
 namespace server {
+static Buf getUnparsedCertData(const Cert& cert) {
+  auto lazyCert = dynamic_cast<const LazyPeerCert*>(&cert);
+  return lazyCert ? lazyCert->getUnparsedCertData() : nullptr;
+}
+
 void appendClientCertificate(
     CertificateStorage storage,
     const std::shared_ptr<const Cert>& cert,
     folly::io::Appender& appender) {
   Buf clientCertBuf = folly::IOBuf::create(0);
+  // Restored from a previous ticket and never used, stored as is.
+  Buf unparsedCert = cert && storage == CertificateStorage::X509
+      ? getUnparsedCertData(*cert)
+      : nullptr;
   CertificateStorage selectedStorage;
   if (!cert || storage == CertificateStorage::None) {
     selectedStorage = CertificateStorage::None;
+  } else if (unparsedCert) {
+    selectedStorage = CertificateStorage::X509;
+    clientCertBuf = std::move(unparsedCert);
   } else if (storage == CertificateStorage::X509 && cert->getX509()) {
     selectedStorage = CertificateStorage::X509;
     clientCertBuf = folly::ssl::OpenSSLCertUtils::derEncode(*cert->getX509());
@@ -53,7 +67,15 @@ std::shared_ptr<const Cert> readClientCertificate(folly::io::Cursor& cursor) {
     case CertificateStorage::X509: {
       Buf clientCertBuf;
       fizz::detail::readBuf<uint16_t>(clientCertBuf, cursor);
-      return CertUtils::makePeerCert(std::move(clientCertBuf));
+      if (clientCertBuf->empty()) {
+        throw std::runtime_error("empty peer cert");
+      }
+      // Only parsed if the certificate is used after resumption.
+      return std::make_shared<const LazyPeerCert>(
+          std::move(clientCertBuf), [](Buf certData) {
+            return std::shared_ptr<PeerCert>(
+                CertUtils::makePeerCert(std::move(certData)));
+          });
     }
     case CertificateStorage::IdentityOnly: {
       Buf ident;
@@ -65,5 +87,207 @@ std::shared_ptr<const Cert> readClientCertificate(folly::io::Cursor& cursor) {
 
   return nullptr;
 }
+
+LazyServerCert::LazyServerCert(
+    std::string identity,
+    const FizzServerContext* context)
+    : identity_(std::move(identity)), context_(context) {}
+
+std::string LazyServerCert::getIdentity() const {
+  return identity_;
+}
+
+folly::ssl::X509UniquePtr LazyServerCert::getX509() const {
+  auto selfCert = getSelfCert();
+  return selfCert ? selfCert->getX509() : nullptr;
+}
+
+std::shared_ptr<const SelfCert> LazyServerCert::getSelfCert() const {
+  std::call_once(
+      resolved_, [this]() { selfCert_ = context_->getCert(identity_); });
+  return selfCert_;
+}
+
+constexpr folly::StringPiece CompactTicketCodec::Label;
+
+// ALPNs CompactTicketCodec stores as an index (plus one). Only ever append
+// to this list, tickets refer to entries by position.
+static const std::array<folly::StringPiece, 6> kCompactTicketAlpns{
+    {"h2", "http/1.1", "h3", "hq-interop", "dot", "acme-tls/1"}};
+static constexpr uint8_t kCompactTicketNoAlpn = 0;
+static constexpr uint8_t kCompactTicketLiteralAlpn = 0xff;
+
+enum class CompactClientCert : uint8_t {
+  None = 0,
+  Identity = 1,
+  IdentityAndFingerprint = 2,
+};
+
+static void writeVarint(uint64_t value, folly::io::Appender& appender) {
+  while (value >= 0x80) {
+    appender.write<uint8_t>(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  appender.write<uint8_t>(static_cast<uint8_t>(value));
+}
+
+static uint64_t readVarint(folly::io::Cursor& cursor) {
+  uint64_t value = 0;
+  for (size_t shift = 0; shift < 64; shift += 7) {
+    auto byte = cursor.read<uint8_t>();
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+  throw std::runtime_error("ticket varint too long");
+}
+
+static void writeBytes(folly::ByteRange bytes, folly::io::Appender& appender) {
+  writeVarint(bytes.size(), appender);
+  appender.push(bytes);
+}
+
+static std::string readString(folly::io::Cursor& cursor) {
+  return cursor.readFixedString(readVarint(cursor));
+}
+
+static Buf readBytes(folly::io::Cursor& cursor) {
+  auto length = readVarint(cursor);
+  if (!cursor.canAdvance(length)) {
+    throw std::out_of_range("ticket field truncated");
+  }
+  auto buf = folly::IOBuf::create(length);
+  cursor.pull(buf->writableData(), length);
+  buf->append(length);
+  return buf;
+}
+
+Buf CompactTicketCodec::encode(ResumptionState resState) {
+  auto buf = folly::IOBuf::create(64);
+  folly::io::Appender appender(buf.get(), 64);
+
+  fizz::detail::write(resState.version, appender);
+  fizz::detail::write(resState.cipher, appender);
+  writeBytes(
+      resState.resumptionSecret ? resState.resumptionSecret->coalesce()
+                                : folly::ByteRange(),
+      appender);
+  writeBytes(
+      folly::StringPiece(
+          resState.serverCert ? resState.serverCert->getIdentity() : ""),
+      appender);
+
+  if (!resState.clientCert) {
+    fizz::detail::write(CompactClientCert::None, appender);
+  } else {
+    auto x509 = resState.clientCert->getX509();
+    auto fingerprintCert =
+        dynamic_cast<const FingerprintCert*>(resState.clientCert.get());
+    FingerprintCert::Fingerprint fingerprint;
+    if (x509) {
+      auto der = folly::ssl::OpenSSLCertUtils::derEncode(*x509);
+      Sha256::hash(*der, folly::range(fingerprint));
+    } else if (fingerprintCert) {
+      fingerprint = fingerprintCert->getFingerprint();
+    }
+    if (x509 || fingerprintCert) {
+      fizz::detail::write(CompactClientCert::IdentityAndFingerprint, appender);
+      writeBytes(
+          folly::StringPiece(resState.clientCert->getIdentity()), appender);
+      appender.push(folly::range(fingerprint));
+    } else {
+      fizz::detail::write(CompactClientCert::Identity, appender);
+      writeBytes(
+          folly::StringPiece(resState.clientCert->getIdentity()), appender);
+    }
+  }
+
+  fizz::detail::write(resState.ticketAgeAdd, appender);
+  writeVarint(
+      std::chrono::duration_cast<std::chrono::seconds>(
+          resState.ticketIssueTime.time_since_epoch())
+          .count(),
+      appender);
+
+  if (!resState.alpn) {
+    appender.write<uint8_t>(kCompactTicketNoAlpn);
+  } else {
+    auto it = std::find(
+        kCompactTicketAlpns.begin(), kCompactTicketAlpns.end(), *resState.alpn);
+    if (it != kCompactTicketAlpns.end()) {
+      appender.write<uint8_t>(it - kCompactTicketAlpns.begin() + 1);
+    } else {
+      appender.write<uint8_t>(kCompactTicketLiteralAlpn);
+      writeBytes(folly::StringPiece(*resState.alpn), appender);
+    }
+  }
+
+  writeBytes(
+      resState.appToken ? resState.appToken->coalesce() : folly::ByteRange(),
+      appender);
+  if (resState.ticketId) {
+    writeVarint(*resState.ticketId, appender);
+  }
+  return buf;
+}
+
+ResumptionState CompactTicketCodec::decode(
+    Buf encoded,
+    const FizzServerContext* context) {
+  folly::io::Cursor cursor(encoded.get());
+
+  ResumptionState resState;
+  fizz::detail::read(resState.version, cursor);
+  fizz::detail::read(resState.cipher, cursor);
+  resState.resumptionSecret = readBytes(cursor);
+  auto selfIdentity = readString(cursor);
+
+  CompactClientCert clientCert;
+  fizz::detail::read(clientCert, cursor);
+  switch (clientCert) {
+    case CompactClientCert::None:
+      break;
+    case CompactClientCert::Identity:
+      resState.clientCert =
+          std::make_shared<const IdentityCert>(readString(cursor));
+      break;
+    case CompactClientCert::IdentityAndFingerprint: {
+      auto identity = readString(cursor);
+      FingerprintCert::Fingerprint fingerprint;
+      cursor.pull(fingerprint.data(), fingerprint.size());
+      resState.clientCert = std::make_shared<const FingerprintCert>(
+          std::move(identity), fingerprint);
+      break;
+    }
+    default:
+      throw std::runtime_error("unknown ticket client cert storage");
+  }
+
+  fizz::detail::read(resState.ticketAgeAdd, cursor);
+  resState.ticketIssueTime = std::chrono::time_point<std::chrono::system_clock>(
+      std::chrono::seconds(readVarint(cursor)));
+
+  auto alpn = cursor.read<uint8_t>();
+  if (alpn == kCompactTicketLiteralAlpn) {
+    resState.alpn = readString(cursor);
+  } else if (alpn != kCompactTicketNoAlpn) {
+    if (alpn > kCompactTicketAlpns.size()) {
+      throw std::runtime_error("unknown ticket alpn index");
+    }
+    resState.alpn = kCompactTicketAlpns[alpn - 1].str();
+  }
+
+  resState.appToken = readBytes(cursor);
+  if (!cursor.isAtEnd()) {
+    resState.ticketId = readVarint(cursor);
+  }
+
+  if (context && !selfIdentity.empty()) {
+    resState.serverCert = std::make_shared<const LazyServerCert>(
+        std::move(selfIdentity), context);
+  }
+  return resState;
+}
 } // namespace server
 } // namespace fizz
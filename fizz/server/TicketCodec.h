@@ -8,10 +8,14 @@
 
 #pragma once
 
+#include <fizz/crypto/Sha256.h>
+#include <fizz/protocol/LazyPeerCert.h>
 #include <fizz/record/Types.h>
 #include <fizz/server/FizzServerContext.h>
 #include <fizz/server/ResumptionState.h>
 
+#include <mutex>
+
 namespace fizz {
 namespace server {
 enum class CertificateStorage : uint8_t {
@@ -32,6 +36,31 @@ void appendClientCertificate(
 
 std::shared_ptr<const Cert> readClientCertificate(folly::io::Cursor& cursor);
 
+/**
+ * Server certificate restored from a ticket by identity. The certificate
+ * is only looked up in the context if its X509 is asked for. The context
+ * must outlive it.
+ */
+class LazyServerCert : public Cert {
+ public:
+  LazyServerCert(std::string identity, const FizzServerContext* context);
+
+  std::string getIdentity() const override;
+
+  folly::ssl::X509UniquePtr getX509() const override;
+
+  /**
+   * The context's certificate for the identity, or nullptr.
+   */
+  std::shared_ptr<const SelfCert> getSelfCert() const;
+
+ private:
+  std::string identity_;
+  const FizzServerContext* context_;
+  mutable std::once_flag resolved_;
+  mutable std::shared_ptr<const SelfCert> selfCert_;
+};
+
 template <CertificateStorage Storage>
 struct TicketCodec {
   /**
@@ -44,6 +73,41 @@ struct TicketCodec {
 
   static ResumptionState decode(Buf encoded, const FizzServerContext* context);
 };
+
+/**
+ * Client certificate restored from a CompactTicketCodec ticket: its identity
+ * and the SHA-256 fingerprint of the DER certificate the ticket was issued
+ * for.
+ */
+class FingerprintCert : public IdentityCert {
+ public:
+  using Fingerprint = std::array<uint8_t, Sha256::HashLen>;
+
+  FingerprintCert(std::string identity, const Fingerprint& fingerprint)
+      : IdentityCert(std::move(identity)), fingerprint_(fingerprint) {}
+
+  const Fingerprint& getFingerprint() const {
+    return fingerprint_;
+  }
+
+ private:
+  Fingerprint fingerprint_;
+};
+
+/**
+ * Smaller ticket encoding than TicketCodec. Lengths and the issue time are
+ * varints, common ALPNs are stored as an index into a fixed list, and
+ * client certificates are stored as their identity and a SHA-256
+ * fingerprint (restored as a FingerprintCert) rather than in full. Decoding
+ * reads the fields straight out of the ticket in a single pass.
+ */
+struct CompactTicketCodec {
+  static constexpr folly::StringPiece Label{"Fizz Compact Ticket Codec v1"};
+
+  static Buf encode(ResumptionState state);
+
+  static ResumptionState decode(Buf encoded, const FizzServerContext* context);
+};
 } // namespace server
 } // namespace fizz
 
@@ -124,6 +124,26 @@ TEST_F(AeadCookieCipherTest, TestDecryptGroup) {
   EXPECT_EQ(*state->group, NamedGroup::secp256r1);
 }
 
+TEST_F(AeadCookieCipherTest, TestEncrypt) {
+  CookieState state;
+  state.version = ProtocolVersion::tls_1_3;
+  state.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+  state.group = NamedGroup::x25519;
+  state.chloHash = IOBuf::copyBuffer("chlohash");
+  state.appToken = IOBuf::copyBuffer("test");
+  auto cookie = cipher_->encrypt(state);
+  EXPECT_TRUE(cookie.hasValue());
+
+  auto decrypted = cipher_->decrypt(std::move(*cookie));
+  EXPECT_TRUE(decrypted.hasValue());
+  EXPECT_EQ(decrypted->version, ProtocolVersion::tls_1_3);
+  EXPECT_EQ(decrypted->cipher, CipherSuite::TLS_AES_128_GCM_SHA256);
+  EXPECT_EQ(*decrypted->group, NamedGroup::x25519);
+  EXPECT_TRUE(
+      IOBufEqualTo()(decrypted->chloHash, IOBuf::copyBuffer("chlohash")));
+  EXPECT_TRUE(IOBufEqualTo()(decrypted->appToken, IOBuf::copyBuffer("test")));
+}
+
 TEST_F(AeadCookieCipherTest, TestDecryptMultipleSecrets) {
   auto s = toIOBuf(secret);
   auto s1 = RandomGenerator<32>().generateRandom();
@@ -146,6 +166,72 @@ TEST_F(AeadCookieCipherTest, TestDecryptFailed) {
   auto state = cipher_->decrypt(toIOBuf(testCookie));
   EXPECT_FALSE(state.hasValue());
 }
+
+TEST_F(AeadCookieCipherTest, TestMacPrecheck) {
+  CookieState state;
+  state.version = ProtocolVersion::tls_1_3;
+  state.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+  state.chloHash = IOBuf::copyBuffer("chlohash");
+  state.appToken = IOBuf::copyBuffer("test");
+  auto plainCookie = cipher_->encrypt(state);
+  ASSERT_TRUE(plainCookie.hasValue());
+
+  cipher_->setMacPrecheck(true);
+  auto cookie = cipher_->encrypt(state);
+  ASSERT_TRUE(cookie.hasValue());
+  EXPECT_EQ(
+      (*cookie)->computeChainDataLength(),
+      (*plainCookie)->computeChainDataLength() + 8);
+
+  auto decrypted = cipher_->decrypt(std::move(*cookie));
+  ASSERT_TRUE(decrypted.hasValue());
+  EXPECT_TRUE(IOBufEqualTo()(decrypted->appToken, IOBuf::copyBuffer("test")));
+
+  // Cookies without the MAC are rejected.
+  EXPECT_FALSE(cipher_->decrypt(toIOBuf(testCookie)).hasValue());
+}
+
+TEST_F(AeadCookieCipherTest, TestMacPrecheckRejects) {
+  cipher_->setMacPrecheck(true);
+  CookieState state;
+  state.version = ProtocolVersion::tls_1_3;
+  state.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+  state.chloHash = IOBuf::copyBuffer("chlohash");
+  state.appToken = IOBuf::copyBuffer("test");
+  auto cookie = cipher_->encrypt(state);
+  ASSERT_TRUE(cookie.hasValue());
+  (*cookie)->coalesce();
+
+  auto forged = (*cookie)->clone();
+  forged->writableData()[forged->length() - 1] ^= 0x01;
+  EXPECT_FALSE(cipher_->decrypt(std::move(forged)).hasValue());
+
+  auto badMac = (*cookie)->clone();
+  badMac->writableData()[0] ^= 0x01;
+  EXPECT_FALSE(cipher_->decrypt(std::move(badMac)).hasValue());
+
+  EXPECT_FALSE(cipher_->decrypt(IOBuf::copyBuffer("short")).hasValue());
+  EXPECT_FALSE(cipher_->decrypt(IOBuf::create(0)).hasValue());
+}
+
+TEST_F(AeadCookieCipherTest, TestMacPrecheckMultipleSecrets) {
+  cipher_->setMacPrecheck(true);
+  CookieState state;
+  state.version = ProtocolVersion::tls_1_3;
+  state.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+  state.chloHash = IOBuf::copyBuffer("chlohash");
+  state.appToken = IOBuf::copyBuffer("test");
+  auto cookie = cipher_->encrypt(state);
+  ASSERT_TRUE(cookie.hasValue());
+
+  auto s = toIOBuf(secret);
+  auto s1 = RandomGenerator<32>().generateRandom();
+  std::vector<ByteRange> cookieSecrets{{range(s1), s->coalesce()}};
+  EXPECT_TRUE(cipher_->setCookieSecrets(std::move(cookieSecrets)));
+  auto decrypted = cipher_->decrypt(std::move(*cookie));
+  ASSERT_TRUE(decrypted.hasValue());
+  EXPECT_TRUE(IOBufEqualTo()(decrypted->appToken, IOBuf::copyBuffer("test")));
+}
 } // namespace test
 } // namespace server
 } // namespace fizz
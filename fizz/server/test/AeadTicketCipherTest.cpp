@@ -16,6 +16,8 @@
 #include <fizz/crypto/test/TestUtil.h>
 #include <folly/String.h>
 
+#include <thread>
+
 using namespace fizz::test;
 using namespace folly;
 using namespace testing;
@@ -133,6 +135,167 @@ TEST_F(AeadTicketCipherTest, TestEncrypt) {
   EXPECT_EQ(result->second, std::chrono::seconds(5));
 }
 
+TEST_F(AeadTicketCipherTest, TestEncryptSharedSalt) {
+  setTicketSecrets();
+  useMockRandom();
+  cipher_.setMaxTicketsPerSalt(2);
+  EXPECT_CALL(codec_, _encode(_)).Times(3).WillRepeatedly(InvokeWithoutArgs(
+      []() { return IOBuf::copyBuffer("encodedticket"); }));
+  auto result = cipher_.encrypt(ResumptionState()).get();
+  EXPECT_TRUE(IOBufEqualTo()(result->first, toIOBuf(ticket1)));
+  result = cipher_.encrypt(ResumptionState()).get();
+  EXPECT_TRUE(IOBufEqualTo()(result->first, toIOBuf(ticket2)));
+  // The third ticket uses a new salt, which is the same here as the salt comes
+  // from the mock random.
+  result = cipher_.encrypt(ResumptionState()).get();
+  EXPECT_TRUE(IOBufEqualTo()(result->first, toIOBuf(ticket1)));
+}
+
+TEST_F(AeadTicketCipherTest, TestEncryptSaltLifetime) {
+  setTicketSecrets();
+  useMockRandom();
+  cipher_.setMaxTicketsPerSalt(2);
+  cipher_.setSaltLifetime(std::chrono::milliseconds(1));
+  EXPECT_CALL(codec_, _encode(_)).Times(2).WillRepeatedly(InvokeWithoutArgs(
+      []() { return IOBuf::copyBuffer("encodedticket"); }));
+  auto result = cipher_.encrypt(ResumptionState()).get();
+  EXPECT_TRUE(IOBufEqualTo()(result->first, toIOBuf(ticket1)));
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  // The salt expired, so the ticket starts a new salt at sequence number 0.
+  result = cipher_.encrypt(ResumptionState()).get();
+  EXPECT_TRUE(IOBufEqualTo()(result->first, toIOBuf(ticket1)));
+}
+
+TEST_F(AeadTicketCipherTest, TestKeyIds) {
+  setTicketSecrets();
+  cipher_.setUseKeyIds(true);
+  EXPECT_CALL(codec_, _encode(_)).WillOnce(InvokeWithoutArgs([]() {
+    return IOBuf::copyBuffer("encodedticket");
+  }));
+  auto ticket = cipher_.encrypt(ResumptionState()).get();
+  ASSERT_TRUE(ticket.hasValue());
+  EXPECT_EQ(
+      ticket->first->computeChainDataLength(),
+      toIOBuf(ticket1)->computeChainDataLength() + 4);
+
+  // A server with the secrets in a different order finds the right one.
+  TestAeadTicketCipher rotated;
+  auto s1 = toIOBuf(ticketSecret1);
+  auto s2 = toIOBuf(ticketSecret2);
+  EXPECT_TRUE(rotated.setTicketSecrets({s2->coalesce(), s1->coalesce()}));
+  rotated.setUseKeyIds(true);
+  expectDecode();
+  auto result = rotated.decrypt(ticket->first->clone()).get();
+  EXPECT_EQ(result.first, PskType::Resumption);
+
+  // Without key ids the format differs.
+  rotated.setUseKeyIds(false);
+  result = rotated.decrypt(ticket->first->clone()).get();
+  EXPECT_EQ(result.first, PskType::Rejected);
+}
+
+TEST_F(AeadTicketCipherTest, TestKeyIdUnknown) {
+  setTicketSecrets();
+  cipher_.setUseKeyIds(true);
+  EXPECT_CALL(codec_, _encode(_)).WillOnce(InvokeWithoutArgs([]() {
+    return IOBuf::copyBuffer("encodedticket");
+  }));
+  auto ticket = cipher_.encrypt(ResumptionState()).get();
+  ASSERT_TRUE(ticket.hasValue());
+
+  TestAeadTicketCipher other;
+  auto s2 = toIOBuf(ticketSecret2);
+  EXPECT_TRUE(other.setTicketSecrets({s2->coalesce()}));
+  other.setUseKeyIds(true);
+  auto result = other.decrypt(std::move(ticket->first)).get();
+  EXPECT_EQ(result.first, PskType::Rejected);
+}
+
+TEST_F(AeadTicketCipherTest, TestDecryptCache) {
+  setTicketSecrets();
+  cipher_.setDecryptCacheSize(2);
+  EXPECT_CALL(codec_, _decode(_, _))
+      .Times(3)
+      .WillRepeatedly(InvokeWithoutArgs([]() { return ResumptionState(); }));
+  // ticket1 and ticket2 share a salt, the second decrypt hits the cache.
+  EXPECT_EQ(
+      cipher_.decrypt(toIOBuf(ticket1)).get().first, PskType::Resumption);
+  EXPECT_EQ(
+      cipher_.decrypt(toIOBuf(ticket2)).get().first, PskType::Resumption);
+  EXPECT_EQ(
+      cipher_.decrypt(toIOBuf(ticket3)).get().first, PskType::Resumption);
+  EXPECT_EQ(
+      cipher_.decrypt(toIOBuf(badTicket)).get().first, PskType::Rejected);
+}
+
+static ResumptionState recentState() {
+  ResumptionState state;
+  state.resumptionSecret = IOBuf::copyBuffer("secret");
+  state.ticketIssueTime = std::chrono::system_clock::now();
+  return state;
+}
+
+TEST_F(AeadTicketCipherTest, TestResumptionCache) {
+  setTicketSecrets();
+  cipher_.setResumptionCache(2, std::chrono::seconds(10));
+  EXPECT_CALL(codec_, _decode(_, _))
+      .Times(2)
+      .WillRepeatedly(InvokeWithoutArgs(recentState));
+  for (size_t i = 0; i < 3; ++i) {
+    auto result = cipher_.decrypt(toIOBuf(ticket1)).get();
+    EXPECT_EQ(result.first, PskType::Resumption);
+    EXPECT_TRUE(IOBufEqualTo()(
+        result.second->resumptionSecret, IOBuf::copyBuffer("secret")));
+  }
+  EXPECT_EQ(
+      cipher_.decrypt(toIOBuf(ticket3)).get().first, PskType::Resumption);
+  EXPECT_EQ(
+      cipher_.decrypt(toIOBuf(ticket3)).get().first, PskType::Resumption);
+  EXPECT_EQ(
+      cipher_.decrypt(toIOBuf(badTicket)).get().first, PskType::Rejected);
+}
+
+TEST_F(AeadTicketCipherTest, TestResumptionCacheExpired) {
+  setTicketSecrets();
+  cipher_.setValidity(std::chrono::seconds(5));
+  cipher_.setResumptionCache(2, std::chrono::seconds(10));
+  // Issued longer ago than the validity, so never served from the cache.
+  EXPECT_CALL(codec_, _decode(_, _))
+      .Times(2)
+      .WillRepeatedly(InvokeWithoutArgs([]() {
+        auto state = recentState();
+        state.ticketIssueTime -= std::chrono::seconds(10);
+        return state;
+      }));
+  cipher_.decrypt(toIOBuf(ticket1)).get();
+  cipher_.decrypt(toIOBuf(ticket1)).get();
+}
+
+TEST_F(AeadTicketCipherTest, TestResumptionCacheSecretsChanged) {
+  setTicketSecrets();
+  cipher_.setResumptionCache(2, std::chrono::seconds(10));
+  EXPECT_CALL(codec_, _decode(_, _))
+      .WillOnce(InvokeWithoutArgs(recentState));
+  EXPECT_EQ(
+      cipher_.decrypt(toIOBuf(ticket1)).get().first, PskType::Resumption);
+
+  auto s2 = toIOBuf(ticketSecret2);
+  std::vector<ByteRange> ticketSecrets{{s2->coalesce()}};
+  EXPECT_TRUE(cipher_.setTicketSecrets(std::move(ticketSecrets)));
+  EXPECT_EQ(cipher_.decrypt(toIOBuf(ticket1)).get().first, PskType::Rejected);
+}
+
+TEST_F(AeadTicketCipherTest, TestResumptionCachePerThread) {
+  setTicketSecrets();
+  cipher_.setResumptionCache(2, std::chrono::seconds(10));
+  EXPECT_CALL(codec_, _decode(_, _))
+      .Times(2)
+      .WillRepeatedly(InvokeWithoutArgs(recentState));
+  cipher_.decrypt(toIOBuf(ticket1)).get();
+  std::thread([this]() { cipher_.decrypt(toIOBuf(ticket1)).get(); }).join();
+  cipher_.decrypt(toIOBuf(ticket1)).get();
+}
+
 TEST_F(AeadTicketCipherTest, TestDecryptNoTicketSecrets) {
   auto result = cipher_.decrypt(toIOBuf(ticket1)).get();
   EXPECT_EQ(result.first, PskType::Rejected);
@@ -12,6 +12,7 @@
 #include <fizz/server/AsyncFizzServer.h>
 
 #include <fizz/extensions/tokenbinding/Types.h>
+#include <fizz/protocol/test/TestMessages.h>
 #include <fizz/server/test/Mocks.h>
 #include <folly/io/async/test/MockAsyncTransport.h>
 
@@ -20,6 +21,7 @@ namespace server {
 namespace test {
 
 using namespace fizz::extensions;
+using namespace fizz::test;
 using namespace folly;
 using namespace folly::test;
 using namespace testing;
@@ -85,8 +87,10 @@ class AsyncFizzServerTest : public Test {
         .WillOnce(InvokeWithoutArgs([clientCert,
                                      serverCert,
                                      cipher = negotiatedCipher_,
-                                     protocolVersion = protocolVersion_]() {
+                                     protocolVersion = protocolVersion_,
+                                     context = context_]() {
           auto addExporterToState = [=](State& newState) {
+            newState.context() = context;
             auto exporterMaster =
                 folly::IOBuf::copyBuffer("12345678901234567890123456789012");
             newState.exporterMasterSecret() = std::move(exporterMaster);
@@ -163,6 +167,24 @@ TEST_F(AsyncFizzServerTest, TestWriteMulti) {
   server_->writeChain(nullptr, IOBuf::copyBuffer("HTTP POST"));
 }
 
+TEST_F(AsyncFizzServerTest, TestWriteDeferredNewSessionTicket) {
+  context_->setDeferNewSessionTicket(true);
+  completeHandshake();
+  Sequence s;
+  EXPECT_CALL(*machine_, _processAppWrite(_, _))
+      .InSequence(s)
+      .WillOnce(InvokeWithoutArgs([]() { return actions(); }));
+  EXPECT_CALL(*machine_, _processWriteNewSessionTicket(_, _))
+      .InSequence(s)
+      .WillOnce(InvokeWithoutArgs([]() { return actions(); }));
+  server_->writeChain(nullptr, IOBuf::copyBuffer("HTTP/1.1 200 OK"));
+
+  EXPECT_CALL(*machine_, _processAppWrite(_, _))
+      .WillOnce(InvokeWithoutArgs([]() { return actions(); }));
+  EXPECT_CALL(*machine_, _processWriteNewSessionTicket(_, _)).Times(0);
+  server_->writeChain(nullptr, IOBuf::copyBuffer("body"));
+}
+
 TEST_F(AsyncFizzServerTest, TestWriteErrorState) {
   accept();
   ON_CALL(*socket_, error()).WillByDefault(Return(true));
@@ -218,6 +240,23 @@ TEST_F(AsyncFizzServerTest, TestWriteToSocket) {
   socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("ClientHello"));
 }
 
+TEST_F(AsyncFizzServerTest, TestWriteToSocketCorked) {
+  completeHandshake();
+  server_->setReadCB(&readCallback_);
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(InvokeWithoutArgs([]() {
+        WriteToSocket first;
+        first.data = IOBuf::copyBuffer("XYZ");
+        WriteToSocket second;
+        second.data = IOBuf::copyBuffer("ABC");
+        return actions(std::move(first), std::move(second), WaitForData());
+      }));
+  Sequence s;
+  EXPECT_CALL(*socket_, writeChain(_, _, WriteFlags::CORK)).InSequence(s);
+  EXPECT_CALL(*socket_, writeChain(_, _, WriteFlags::NONE)).InSequence(s);
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("ClientHello"));
+}
+
 TEST_F(AsyncFizzServerTest, TestMutateState) {
   completeHandshake();
   server_->setReadCB(&readCallback_);
@@ -255,6 +294,28 @@ TEST_F(AsyncFizzServerTest, TestAttemptVersionFallback) {
   socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("ClientHello"));
 }
 
+TEST_F(AsyncFizzServerTest, TestRouteClientHello) {
+  accept();
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(InvokeWithoutArgs([]() {
+        RouteClientHello route;
+        route.chlo = TestMessages::clientHello();
+        route.clientHello = IOBuf::copyBuffer("ClientHello");
+        return actions(
+            [](State& newState) { newState.state() = StateEnum::Error; },
+            std::move(route));
+      }));
+  EXPECT_CALL(handshakeCallback_, _fizzHandshakeRoute(_, _))
+      .WillOnce(Invoke(
+          [&](ClientHello& chlo, std::unique_ptr<IOBuf>& clientHello) {
+            EXPECT_TRUE(getExtension<ServerNameList>(chlo.extensions));
+            EXPECT_TRUE(IOBufEqualTo()(
+                clientHello, IOBuf::copyBuffer("ClientHelloClientHello")));
+            server_.reset();
+          }));
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("ClientHello"));
+}
+
 TEST_F(AsyncFizzServerTest, TestDeleteAsyncEvent) {
   accept();
   Promise<Actions> p1;
@@ -378,6 +439,56 @@ TEST_F(AsyncFizzServerTest, TestEarlySuccess) {
   fullHandshakeSuccess();
 }
 
+TEST_F(AsyncFizzServerTest, TestEarlySuccessReplaySafe) {
+  accept();
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return actions(
+            [](State& newState) {
+              newState.state() = StateEnum::AcceptingEarlyData;
+              newState.earlyDataType() = EarlyDataType::Accepted;
+            },
+            ReportEarlyHandshakeSuccess(),
+            WaitForData());
+      }));
+  EXPECT_CALL(handshakeCallback_, _fizzHandshakeSuccess());
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("ClientHello"));
+  EXPECT_TRUE(server_->isReplaySafe());
+}
+
+TEST_F(AsyncFizzServerTest, TestEarlySuccessReplaySafetyReporting) {
+  context_->setEarlyDataReplaySafetyReporting(true);
+  accept();
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return actions(
+            [](State& newState) {
+              newState.state() = StateEnum::AcceptingEarlyData;
+              newState.earlyDataType() = EarlyDataType::Accepted;
+            },
+            ReportEarlyHandshakeSuccess(),
+            WaitForData());
+      }));
+  EXPECT_CALL(handshakeCallback_, _fizzHandshakeSuccess());
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("ClientHello"));
+  EXPECT_FALSE(server_->isReplaySafe());
+
+  MockReplaySafetyCallback replayCallback;
+  server_->setReplaySafetyCallback(&replayCallback);
+  EXPECT_CALL(*machine_, _processSocketData(_, _))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return actions(
+            [](State& newState) {
+              newState.state() = StateEnum::AcceptingData;
+            },
+            ReportHandshakeSuccess(),
+            WaitForData());
+      }));
+  EXPECT_CALL(replayCallback, onReplaySafe_());
+  socketReadCallback_->readBufferAvailable(IOBuf::copyBuffer("Finished"));
+  EXPECT_TRUE(server_->isReplaySafe());
+}
+
 TEST_F(AsyncFizzServerTest, TestErrorStopsActions) {
   completeHandshake();
   server_->setReadCB(&readCallback_);
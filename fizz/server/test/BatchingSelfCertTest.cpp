@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/server/BatchingSelfCert.h>
+
+#include <fizz/protocol/test/Matchers.h>
+#include <fizz/protocol/test/Mocks.h>
+#include <folly/executors/ManualExecutor.h>
+
+using namespace fizz::test;
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+class TestBatchingSelfCert : public BatchingSelfCert {
+ public:
+  using BatchingSelfCert::BatchingSelfCert;
+
+  mutable std::vector<size_t> batchSizes;
+
+ protected:
+  void signRequests(std::vector<SignRequest>& batch) const override {
+    batchSizes.push_back(batch.size());
+    BatchingSelfCert::signRequests(batch);
+  }
+};
+
+class BatchingSelfCertTest : public Test {
+ public:
+  void SetUp() override {
+    cert_ = std::make_shared<MockSelfCert>();
+    executor_ = std::make_shared<ManualExecutor>();
+    ON_CALL(*cert_, sign(_, _, _))
+        .WillByDefault(Invoke([](SignatureScheme,
+                                 CertificateVerifyContext,
+                                 folly::ByteRange toBeSigned) {
+          auto sig = IOBuf::copyBuffer("sig-");
+          sig->prependChain(IOBuf::copyBuffer(toBeSigned));
+          return sig;
+        }));
+  }
+
+ protected:
+  Future<Optional<Buf>> sign(BatchingSelfCert& cert, StringPiece data) {
+    return cert.signFuture(
+        SignatureScheme::rsa_pss_sha256,
+        CertificateVerifyContext::Server,
+        data);
+  }
+
+  std::shared_ptr<MockSelfCert> cert_;
+  std::shared_ptr<ManualExecutor> executor_;
+};
+
+TEST_F(BatchingSelfCertTest, TestSignOnExecutor) {
+  auto batching = std::make_shared<TestBatchingSelfCert>(cert_, executor_, 8);
+  auto sig = sign(*batching, "data");
+  EXPECT_FALSE(sig.isReady());
+
+  EXPECT_CALL(
+      *cert_,
+      sign(
+          SignatureScheme::rsa_pss_sha256,
+          CertificateVerifyContext::Server,
+          RangeMatches("data")));
+  executor_->drain();
+  ASSERT_TRUE(sig.isReady());
+  EXPECT_TRUE(IOBufEqualTo()(*sig.value(), IOBuf::copyBuffer("sig-data")));
+  EXPECT_EQ(batching->batchSizes, std::vector<size_t>({1}));
+}
+
+TEST_F(BatchingSelfCertTest, TestBatches) {
+  auto batching = std::make_shared<TestBatchingSelfCert>(cert_, executor_, 2);
+  std::vector<Future<Optional<Buf>>> sigs;
+  sigs.push_back(sign(*batching, "a"));
+  sigs.push_back(sign(*batching, "b"));
+  sigs.push_back(sign(*batching, "c"));
+  EXPECT_CALL(*cert_, sign(_, _, _)).Times(3);
+  executor_->drain();
+  EXPECT_EQ(batching->batchSizes, std::vector<size_t>({2, 1}));
+  EXPECT_TRUE(IOBufEqualTo()(*sigs[0].value(), IOBuf::copyBuffer("sig-a")));
+  EXPECT_TRUE(IOBufEqualTo()(*sigs[1].value(), IOBuf::copyBuffer("sig-b")));
+  EXPECT_TRUE(IOBufEqualTo()(*sigs[2].value(), IOBuf::copyBuffer("sig-c")));
+
+  auto sig = sign(*batching, "d");
+  executor_->drain();
+  EXPECT_TRUE(sig.isReady());
+  EXPECT_EQ(batching->batchSizes, std::vector<size_t>({2, 1, 1}));
+}
+
+TEST_F(BatchingSelfCertTest, TestBatchPerScheme) {
+  auto batching = std::make_shared<BatchingSelfCert>(cert_, executor_, 8);
+  auto sig1 = sign(*batching, "a");
+  auto sig2 = batching->signFuture(
+      SignatureScheme::rsa_pss_sha256,
+      CertificateVerifyContext::Client,
+      StringPiece("b"));
+  auto sig3 = sign(*batching, "c");
+  EXPECT_CALL(*cert_, sign(_, CertificateVerifyContext::Server, _)).Times(2);
+  EXPECT_CALL(*cert_, sign(_, CertificateVerifyContext::Client, _));
+  executor_->drain();
+  EXPECT_TRUE(IOBufEqualTo()(*sig1.value(), IOBuf::copyBuffer("sig-a")));
+  EXPECT_TRUE(IOBufEqualTo()(*sig2.value(), IOBuf::copyBuffer("sig-b")));
+  EXPECT_TRUE(IOBufEqualTo()(*sig3.value(), IOBuf::copyBuffer("sig-c")));
+}
+
+TEST_F(BatchingSelfCertTest, TestSignError) {
+  auto batching = std::make_shared<BatchingSelfCert>(cert_, executor_, 8);
+  EXPECT_CALL(*cert_, sign(_, _, _))
+      .WillOnce(Throw(std::runtime_error("no key")));
+  auto sig = sign(*batching, "data");
+  executor_->drain();
+  ASSERT_TRUE(sig.isReady());
+  EXPECT_THROW(sig.value(), std::runtime_error);
+}
+
+TEST_F(BatchingSelfCertTest, TestSyncSign) {
+  auto batching = std::make_shared<BatchingSelfCert>(cert_, executor_, 8);
+  EXPECT_CALL(*cert_, sign(_, _, RangeMatches("data")));
+  auto sig = batching->sign(
+      SignatureScheme::rsa_pss_sha256,
+      CertificateVerifyContext::Server,
+      StringPiece("data"));
+  EXPECT_TRUE(IOBufEqualTo()(sig, IOBuf::copyBuffer("sig-data")));
+  EXPECT_EQ(executor_->run(), 0);
+}
+
+TEST_F(BatchingSelfCertTest, TestForwardsCertificateType) {
+  auto batching = std::make_shared<BatchingSelfCert>(cert_, executor_, 8);
+  EXPECT_CALL(*cert_, getCertificateType())
+      .WillOnce(Return(CertificateType::RawPublicKey));
+  EXPECT_EQ(batching->getCertificateType(), CertificateType::RawPublicKey);
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,129 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/server/CertLoader.h>
+#include <folly/FileUtil.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/experimental/TestUtil.h>
+
+using namespace fizz::test;
+using namespace folly;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+class CertLoaderTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    cachePath_ = (dir_.path() / "certcache").string();
+  }
+
+  static std::vector<CertSource> getSources() {
+    std::vector<CertSource> sources;
+    sources.push_back(CertSource{kP256Certificate.str(), kP256Key.str(), true});
+    sources.push_back(CertSource{kRSACertificate.str(), kRSAKey.str(), false});
+    sources.push_back(
+        CertSource{kEd25519Certificate.str(), kEd25519Key.str(), false});
+    return sources;
+  }
+
+  static void expectSameCerts(
+      const std::vector<std::shared_ptr<SelfCert>>& certs,
+      const std::vector<CertSource>& sources) {
+    auto expected = CertLoader::load(sources, nullptr);
+    ASSERT_EQ(certs.size(), expected.size());
+    for (size_t i = 0; i < certs.size(); ++i) {
+      EXPECT_EQ(certs[i]->getIdentity(), expected[i]->getIdentity());
+      EXPECT_EQ(certs[i]->getSigSchemes(), expected[i]->getSigSchemes());
+    }
+  }
+
+  CPUThreadPoolExecutor executor_{2};
+  folly::test::TemporaryDirectory dir_;
+  std::string cachePath_;
+};
+
+TEST_F(CertLoaderTest, TestLoad) {
+  auto sources = getSources();
+  auto certs = CertLoader::load(sources, &executor_);
+  expectSameCerts(certs, sources);
+  EXPECT_EQ(
+      certs[0]->getSigSchemes(),
+      std::vector<SignatureScheme>{SignatureScheme::ecdsa_secp256r1_sha256});
+}
+
+TEST_F(CertLoaderTest, TestLoadError) {
+  auto sources = getSources();
+  sources[1].keyData = "not a key";
+  EXPECT_THROW(CertLoader::load(sources, &executor_), std::runtime_error);
+  EXPECT_THROW(CertLoader::load(sources, nullptr), std::runtime_error);
+}
+
+TEST_F(CertLoaderTest, TestCache) {
+  auto sources = getSources();
+  expectSameCerts(
+      CertLoader::loadWithCache(sources, cachePath_, &executor_), sources);
+  std::string cache;
+  ASSERT_TRUE(readFile(cachePath_.c_str(), cache));
+
+  // A cache hit leaves the file as it is.
+  expectSameCerts(
+      CertLoader::loadWithCache(sources, cachePath_, &executor_), sources);
+  std::string reread;
+  ASSERT_TRUE(readFile(cachePath_.c_str(), reread));
+  EXPECT_EQ(cache, reread);
+}
+
+TEST_F(CertLoaderTest, TestStaleCache) {
+  auto sources = getSources();
+  CertLoader::loadWithCache(sources, cachePath_, nullptr);
+  std::string cache;
+  ASSERT_TRUE(readFile(cachePath_.c_str(), cache));
+
+  sources.pop_back();
+  expectSameCerts(
+      CertLoader::loadWithCache(sources, cachePath_, &executor_), sources);
+  std::string rewritten;
+  ASSERT_TRUE(readFile(cachePath_.c_str(), rewritten));
+  EXPECT_NE(cache, rewritten);
+}
+
+TEST_F(CertLoaderTest, TestCorruptCache) {
+  auto sources = getSources();
+  CertLoader::loadWithCache(sources, cachePath_, nullptr);
+  std::string cache;
+  ASSERT_TRUE(readFile(cachePath_.c_str(), cache));
+  cache[cache.size() - 10] ^= 0xff;
+  ASSERT_TRUE(writeFile(cache, cachePath_.c_str()));
+  expectSameCerts(
+      CertLoader::loadWithCache(sources, cachePath_, &executor_), sources);
+}
+
+TEST_F(CertLoaderTest, TestLoadInto) {
+  auto sources = getSources();
+  CertManager manager;
+  CertLoader::loadInto(manager, sources, &executor_, cachePath_);
+  for (auto scheme :
+       {SignatureScheme::ecdsa_secp256r1_sha256,
+        SignatureScheme::rsa_pss_sha256,
+        SignatureScheme::ed25519}) {
+    auto res = manager.getCert(std::string("fizz"), {scheme}, {scheme});
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res->second, scheme);
+  }
+  auto res = manager.getCert(folly::none, {SignatureScheme::ed25519}, {});
+  ASSERT_TRUE(res);
+  EXPECT_EQ(res->second, SignatureScheme::ed25519);
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
@@ -12,6 +12,10 @@
 #include <fizz/server/CertManager.h>
 
 #include <fizz/protocol/test/Mocks.h>
+#include <folly/Conv.h>
+
+#include <atomic>
+#include <thread>
 
 using namespace fizz::test;
 using namespace folly;
@@ -36,6 +40,31 @@ class CertManagerTest : public Test {
     return cert;
   }
 
+  std::shared_ptr<MockCertificateCompressor> getCompressor(
+      CertificateCompressionAlgorithm algo) {
+    auto compressor = std::make_shared<MockCertificateCompressor>();
+    ON_CALL(*compressor, getAlgorithm()).WillByDefault(Return(algo));
+    ON_CALL(*compressor, _compress(_))
+        .WillByDefault(Invoke([algo](CertificateMsg&) {
+          CompressedCertificate cc;
+          cc.algorithm = algo;
+          cc.uncompressed_length = 4;
+          cc.compressed_certificate_message = IOBuf::copyBuffer("data");
+          return cc;
+        }));
+    return compressor;
+  }
+
+  static CertificateCompressionAlgorithm getAlgorithm(const Buf& encoded) {
+    io::Cursor cursor(encoded.get());
+    EXPECT_EQ(
+        static_cast<HandshakeType>(cursor.read<uint8_t>()),
+        HandshakeType::compressed_certificate);
+    cursor.skip(3);
+    return static_cast<CertificateCompressionAlgorithm>(
+        cursor.readBE<uint16_t>());
+  }
+
   CertManager manager_;
 };
 
@@ -133,6 +162,99 @@ TEST_F(CertManagerTest, TestClientSigSchemeFallback) {
   EXPECT_EQ(res->second, SignatureScheme::rsa_pss_sha256);
 }
 
+TEST_F(CertManagerTest, TestSelectionCache) {
+  manager_.setCertSelectionCache(10);
+  auto cert1 = getCert("www.test.com", {}, {SignatureScheme::rsa_pss_sha256});
+  auto cert2 = getCert("*.test.com", {}, {SignatureScheme::rsa_pss_sha512});
+  manager_.addCert(cert1);
+  manager_.addCert(cert2);
+  std::vector<SignatureScheme> supported{SignatureScheme::rsa_pss_sha256,
+                                         SignatureScheme::rsa_pss_sha512};
+
+  for (size_t i = 0; i < 2; i++) {
+    auto res = manager_.getCert(
+        std::string("www.test.com"),
+        supported,
+        {SignatureScheme::rsa_pss_sha512});
+    EXPECT_EQ(res->first, cert2);
+    EXPECT_EQ(res->second, SignatureScheme::rsa_pss_sha512);
+
+    res = manager_.getCert(std::string("www.test.com"), supported, kRsa);
+    EXPECT_EQ(res->first, cert1);
+    EXPECT_EQ(res->second, SignatureScheme::rsa_pss_sha256);
+
+    res = manager_.getCert(
+        std::string("foo.test.com"),
+        supported,
+        {SignatureScheme::rsa_pss_sha512});
+    EXPECT_EQ(res->first, cert2);
+  }
+
+  EXPECT_FALSE(
+      manager_.getCert(std::string("blah.com"), supported, kRsa).hasValue());
+}
+
+TEST_F(CertManagerTest, TestSelectionCacheClearedOnAdd) {
+  manager_.setCertSelectionCache(10);
+  auto cert1 = getCert("*.test.com", {}, kRsa);
+  manager_.addCert(cert1);
+  auto res = manager_.getCert(std::string("www.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert1);
+
+  auto cert2 = getCert("www.test.com", {}, kRsa);
+  manager_.addCert(cert2);
+  res = manager_.getCert(std::string("www.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert2);
+}
+
+TEST_F(CertManagerTest, TestSelectionCacheConcurrent) {
+  manager_.setCertSelectionCache(10);
+  auto cert1 = getCert("www.test.com", {}, kRsa);
+  auto cert2 = getCert("*.example.com", {}, kRsa);
+  manager_.addCert(cert1);
+  manager_.addCert(cert2);
+
+  std::atomic<size_t> mismatches{0};
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 8; t++) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = 0; i < 1000; i++) {
+        bool test = (i + t) % 2;
+        auto name = test ? std::string("www.test.com")
+                         : folly::to<std::string>(i % 20, ".example.com");
+        auto expected = test ? cert1 : cert2;
+        auto res = manager_.getCert(name, kRsa, kRsa);
+        if (!res || res->first != expected) {
+          ++mismatches;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(mismatches, 0);
+}
+
+TEST_F(CertManagerTest, TestAddCerts) {
+  manager_.setCertSelectionCache(10);
+  auto cert1 = getCert("*.test.com", {}, kRsa);
+  manager_.addCert(cert1);
+  auto res = manager_.getCert(std::string("www.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert1);
+
+  auto cert2 = getCert("www.test.com", {"www.example.com"}, kRsa);
+  auto cert3 = getCert("default.com", {}, kRsa);
+  manager_.addCerts({{cert2, false}, {cert3, true}});
+  res = manager_.getCert(std::string("www.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert2);
+  res = manager_.getCert(std::string("www.example.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert2);
+  res = manager_.getCert(none, kRsa, kRsa);
+  EXPECT_EQ(res->first, cert3);
+  EXPECT_EQ(manager_.getCert("default.com"), cert3);
+}
+
 TEST_F(CertManagerTest, TestAlts) {
   auto cert = getCert(
       "www.test.com",
@@ -190,6 +312,82 @@ TEST_F(CertManagerTest, TestGetByIdentity) {
   EXPECT_EQ(manager_.getCert("foo.test.com"), nullptr);
   EXPECT_EQ(manager_.getCert("www.blah.com"), nullptr);
 }
+
+TEST_F(CertManagerTest, TestBorrowCerts) {
+  manager_.setBorrowCerts(true);
+  auto cert = getCert("www.test.com", {}, kRsa);
+  manager_.addCert(cert, true);
+  std::weak_ptr<MockSelfCert> weak = cert;
+  cert.reset();
+
+  auto res = manager_.getCert(std::string("www.test.com"), kRsa, kRsa);
+  ASSERT_TRUE(res);
+  EXPECT_EQ(res->first.get(), weak.lock().get());
+  EXPECT_EQ(res->first.use_count(), 0);
+  // The manager keeps the cert alive.
+  EXPECT_FALSE(weak.expired());
+
+  // Certs that can outlive the connection own it.
+  auto byIdentity = manager_.getCert("www.test.com");
+  EXPECT_EQ(byIdentity.get(), res->first.get());
+  EXPECT_GT(byIdentity.use_count(), 0);
+  auto owning = manager_.getOwningCert(res->first);
+  EXPECT_EQ(owning.get(), res->first.get());
+  EXPECT_GT(owning.use_count(), 0);
+
+  std::shared_ptr<const Cert> other = getCert("www.other.com", {}, kRsa);
+  EXPECT_EQ(manager_.getOwningCert(other), other);
+}
+
+TEST_F(CertManagerTest, TestCompressedCertServerPref) {
+  auto zstd = getCompressor(CertificateCompressionAlgorithm::zstd);
+  auto zlib = getCompressor(CertificateCompressionAlgorithm::zlib);
+  manager_.setCertCompressors({zstd, zlib});
+
+  auto cert = getCert("www.test.com", {"www.example.com"}, kRsa);
+  EXPECT_CALL(*cert, _getCertMessage(_)).Times(2);
+  EXPECT_CALL(*zstd, _compress(_));
+  EXPECT_CALL(*zlib, _compress(_));
+  manager_.addCert(cert);
+
+  auto compressed = manager_.getCompressedCert(
+      *cert,
+      {CertificateCompressionAlgorithm::zlib,
+       CertificateCompressionAlgorithm::zstd});
+  ASSERT_TRUE(compressed.hasValue());
+  EXPECT_EQ(getAlgorithm(*compressed), CertificateCompressionAlgorithm::zstd);
+
+  compressed = manager_.getCompressedCert(
+      *cert, {CertificateCompressionAlgorithm::zlib});
+  ASSERT_TRUE(compressed.hasValue());
+  EXPECT_EQ(getAlgorithm(*compressed), CertificateCompressionAlgorithm::zlib);
+
+  EXPECT_FALSE(manager_
+                   .getCompressedCert(
+                       *cert, {CertificateCompressionAlgorithm::brotli})
+                   .hasValue());
+  EXPECT_FALSE(manager_.getCompressedCert(*cert, {}).hasValue());
+}
+
+TEST_F(CertManagerTest, TestCompressorsSetAfterCerts) {
+  auto cert = getCert("www.test.com", {}, kRsa);
+  EXPECT_CALL(*cert, _getCertMessage(_)).Times(0);
+  manager_.addCert(cert);
+  EXPECT_FALSE(manager_
+                   .getCompressedCert(
+                       *cert, {CertificateCompressionAlgorithm::zstd})
+                   .hasValue());
+  Mock::VerifyAndClearExpectations(cert.get());
+
+  auto zstd = getCompressor(CertificateCompressionAlgorithm::zstd);
+  EXPECT_CALL(*cert, _getCertMessage(_));
+  EXPECT_CALL(*zstd, _compress(_));
+  manager_.setCertCompressors({zstd});
+  EXPECT_TRUE(manager_
+                  .getCompressedCert(
+                      *cert, {CertificateCompressionAlgorithm::zstd})
+                  .hasValue());
+}
 } // namespace test
 } // namespace server
 } // namespace fizz
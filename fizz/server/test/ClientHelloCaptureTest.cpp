@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/protocol/test/TestMessages.h>
+#include <fizz/server/ClientHelloCapture.h>
+
+using namespace fizz::test;
+using namespace folly;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+static ClientHello decodeHello(const Buf& encoded) {
+  auto body = encoded->clone();
+  body->coalesce();
+  body->trimStart(4);
+  return decode<ClientHello>(std::move(body));
+}
+
+static bool allZero(const Buf& buf) {
+  auto range = buf->clone()->coalesce();
+  return std::all_of(
+      range.begin(), range.end(), [](uint8_t b) { return b == 0; });
+}
+
+TEST(ClientHelloCaptureTest, TestRedact) {
+  auto chlo = TestMessages::clientHelloPsk();
+  chlo.legacy_session_id = IOBuf::copyBuffer("sessionid");
+  auto encoded = encodeHandshake(std::move(chlo));
+  auto redacted = redactClientHello(*encoded);
+  EXPECT_EQ(
+      redacted->computeChainDataLength(), encoded->computeChainDataLength());
+
+  auto original = decodeHello(encoded);
+  auto decoded = decodeHello(redacted);
+  Random zeroRandom;
+  zeroRandom.fill(0);
+  EXPECT_EQ(decoded.random, zeroRandom);
+  EXPECT_EQ(decoded.legacy_session_id->computeChainDataLength(), 9);
+  EXPECT_TRUE(allZero(decoded.legacy_session_id));
+  EXPECT_EQ(decoded.cipher_suites, original.cipher_suites);
+  ASSERT_EQ(decoded.extensions.size(), original.extensions.size());
+  for (size_t i = 0; i < decoded.extensions.size(); ++i) {
+    EXPECT_EQ(
+        decoded.extensions[i].extension_type,
+        original.extensions[i].extension_type);
+  }
+
+  auto psk = getExtension<ClientPresharedKey>(decoded.extensions);
+  ASSERT_TRUE(psk.hasValue());
+  ASSERT_EQ(psk->identities.size(), 1);
+  EXPECT_TRUE(allZero(psk->identities[0].psk_identity));
+  EXPECT_EQ(psk->identities[0].obfuscated_ticket_age, 0);
+  ASSERT_EQ(psk->binders.size(), 1);
+  EXPECT_TRUE(allZero(psk->binders[0].binder));
+}
+
+TEST(ClientHelloCaptureTest, TestRedactNotClientHello) {
+  auto encoded = encodeHandshake(TestMessages::serverHello());
+  EXPECT_THROW(redactClientHello(*encoded), std::runtime_error);
+}
+
+TEST(ClientHelloCaptureTest, TestSampledCapture) {
+  size_t calls = 0;
+  SampledClientHelloCapture capture([&calls]() { return ++calls % 2 == 0; }, 2);
+  auto encoded = encodeHandshake(TestMessages::clientHello());
+  for (int i = 0; i < 10; ++i) {
+    capture.capture(*encoded);
+  }
+  auto captured = capture.drain();
+  EXPECT_EQ(calls, 10);
+  ASSERT_EQ(captured.size(), 2);
+  EXPECT_TRUE(IOBufEqualTo()(captured[0], redactClientHello(*encoded)));
+  EXPECT_TRUE(capture.drain().empty());
+}
+
+TEST(ClientHelloCaptureTest, TestCaptureUnredacted) {
+  SampledClientHelloCapture capture(nullptr, 10, false);
+  auto encoded = encodeHandshake(TestMessages::clientHello());
+  capture.capture(*encoded);
+  auto captured = capture.drain();
+  ASSERT_EQ(captured.size(), 1);
+  EXPECT_TRUE(IOBufEqualTo()(captured[0], encoded));
+}
+
+TEST(ClientHelloCaptureTest, TestEncodeDecode) {
+  std::vector<Buf> hellos;
+  hellos.push_back(encodeHandshake(TestMessages::clientHello()));
+  hellos.push_back(encodeHandshake(TestMessages::clientHelloPsk()));
+  auto decoded = decodeClientHelloCapture(encodeClientHelloCapture(hellos));
+  ASSERT_EQ(decoded.size(), 2);
+  EXPECT_TRUE(IOBufEqualTo()(decoded[0], hellos[0]));
+  EXPECT_TRUE(IOBufEqualTo()(decoded[1], hellos[1]));
+
+  auto encoded = encodeClientHelloCapture(hellos);
+  encoded->prependChain(IOBuf::copyBuffer("x"));
+  EXPECT_THROW(decodeClientHelloCapture(std::move(encoded)), std::exception);
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,113 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/server/ClientHelloFingerprint.h>
+
+#include <fizz/protocol/test/TestMessages.h>
+#include <fizz/record/Extensions.h>
+
+using namespace fizz::test;
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+static Optional<uint64_t> fingerprint(ClientHello chlo) {
+  return getClientHelloFingerprint(*encodeHandshake(std::move(chlo)));
+}
+
+static Extension greaseExtension() {
+  Extension ext;
+  ext.extension_type = static_cast<ExtensionType>(0x1a1a);
+  ext.extension_data = IOBuf::create(0);
+  return ext;
+}
+
+TEST(ClientHelloFingerprintTest, TestStable) {
+  auto expected = fingerprint(TestMessages::clientHello());
+  EXPECT_TRUE(expected.hasValue());
+
+  auto chlo = TestMessages::clientHello();
+  chlo.random.fill(0x55);
+  chlo.legacy_session_id = IOBuf::copyBuffer("sessionid");
+  ServerNameList sni;
+  ServerName sn;
+  sn.hostname = IOBuf::copyBuffer("www.other.com");
+  sni.server_name_list.push_back(std::move(sn));
+  auto it = findExtension(chlo.extensions, ExtensionType::server_name);
+  chlo.extensions.insert(
+      chlo.extensions.erase(it), encodeExtension(std::move(sni)));
+  EXPECT_EQ(fingerprint(std::move(chlo)), expected);
+}
+
+TEST(ClientHelloFingerprintTest, TestChained) {
+  auto encoded = encodeHandshake(TestMessages::clientHello());
+  auto range = encoded->coalesce();
+  auto chained = IOBuf::copyBuffer(range.subpiece(0, 10));
+  chained->prependChain(IOBuf::copyBuffer(range.subpiece(10)));
+  EXPECT_EQ(
+      getClientHelloFingerprint(*chained), getClientHelloFingerprint(*encoded));
+}
+
+TEST(ClientHelloFingerprintTest, TestCiphers) {
+  auto expected = fingerprint(TestMessages::clientHello());
+  auto chlo = TestMessages::clientHello();
+  std::reverse(chlo.cipher_suites.begin(), chlo.cipher_suites.end());
+  EXPECT_NE(fingerprint(std::move(chlo)), expected);
+}
+
+TEST(ClientHelloFingerprintTest, TestExtensionOrder) {
+  auto expected = fingerprint(TestMessages::clientHello());
+  auto chlo = TestMessages::clientHello();
+  std::reverse(chlo.extensions.begin(), chlo.extensions.end());
+  EXPECT_NE(fingerprint(std::move(chlo)), expected);
+}
+
+TEST(ClientHelloFingerprintTest, TestGroups) {
+  auto chlo = TestMessages::clientHello();
+  TestMessages::removeExtension(chlo, ExtensionType::supported_groups);
+  SupportedGroups groups;
+  groups.named_group_list = {NamedGroup::secp256r1, NamedGroup::x25519};
+  chlo.extensions.push_back(encodeExtension(std::move(groups)));
+  auto empty = TestMessages::clientHello();
+  TestMessages::removeExtension(empty, ExtensionType::supported_groups);
+  empty.extensions.push_back(encodeExtension(SupportedGroups()));
+  EXPECT_NE(fingerprint(std::move(chlo)), fingerprint(std::move(empty)));
+}
+
+TEST(ClientHelloFingerprintTest, TestGreaseIgnored) {
+  auto expected = fingerprint(TestMessages::clientHello());
+  auto chlo = TestMessages::clientHello();
+  chlo.cipher_suites.insert(
+      chlo.cipher_suites.begin(), static_cast<CipherSuite>(0x0a0a));
+  chlo.extensions.insert(chlo.extensions.begin(), greaseExtension());
+  EXPECT_EQ(fingerprint(std::move(chlo)), expected);
+}
+
+TEST(ClientHelloFingerprintTest, TestTruncated) {
+  auto encoded = encodeHandshake(TestMessages::clientHello());
+  encoded->coalesce();
+  encoded->trimEnd(3);
+  EXPECT_FALSE(getClientHelloFingerprint(*encoded).hasValue());
+}
+
+TEST(ClientHelloFingerprintTest, TestNotClientHello) {
+  EXPECT_FALSE(
+      getClientHelloFingerprint(*encodeHandshake(TestMessages::finished()))
+          .hasValue());
+  EXPECT_FALSE(
+      getClientHelloFingerprint(*IOBuf::copyBuffer("clienthelloencoding"))
+          .hasValue());
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
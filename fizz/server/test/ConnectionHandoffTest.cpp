@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/record/EncryptedRecordLayer.h>
+#include <fizz/server/ConnectionHandoff.h>
+
+using namespace folly;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+class ConnectionHandoffTest : public testing::Test {
+ protected:
+  static ConnectionHandoff makeHandoff() {
+    ConnectionHandoff handoff;
+    handoff.version = ProtocolVersion::tls_1_3;
+    handoff.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+    handoff.clientTrafficSecret = std::vector<uint8_t>(32, 0x01);
+    handoff.serverTrafficSecret = std::vector<uint8_t>(32, 0x02);
+    handoff.readSeqNum = 5;
+    handoff.writeSeqNum = 7;
+    handoff.exporterMasterSecret = IOBuf::copyBuffer("exportermaster");
+    handoff.resumptionMasterSecret = std::vector<uint8_t>(32, 0x03);
+    handoff.pskType = PskType::Resumption;
+    handoff.alpn = "h2";
+    handoff.sni = "www.hostname.com";
+    handoff.pendingData = IOBuf::copyBuffer("pending");
+    return handoff;
+  }
+
+  void import(ConnectionHandoff handoff) {
+    auto actions = importConnection(
+        nullptr, context_, nullptr, std::move(handoff));
+    for (auto& action : actions) {
+      boost::get<MutateState>(action)(state_);
+    }
+  }
+
+  std::shared_ptr<FizzServerContext> context_{
+      std::make_shared<FizzServerContext>()};
+  State state_;
+};
+
+TEST_F(ConnectionHandoffTest, TestEncodeDecode) {
+  auto decoded =
+      decodeConnectionHandoff(encodeConnectionHandoff(makeHandoff()));
+  auto expected = makeHandoff();
+  EXPECT_EQ(decoded.version, expected.version);
+  EXPECT_EQ(decoded.cipher, expected.cipher);
+  EXPECT_EQ(decoded.clientTrafficSecret, expected.clientTrafficSecret);
+  EXPECT_EQ(decoded.serverTrafficSecret, expected.serverTrafficSecret);
+  EXPECT_EQ(decoded.readSeqNum, 5);
+  EXPECT_EQ(decoded.writeSeqNum, 7);
+  EXPECT_TRUE(IOBufEqualTo()(
+      decoded.exporterMasterSecret, expected.exporterMasterSecret));
+  EXPECT_EQ(decoded.resumptionMasterSecret, expected.resumptionMasterSecret);
+  EXPECT_EQ(decoded.pskType, PskType::Resumption);
+  EXPECT_EQ(decoded.alpn, expected.alpn);
+  EXPECT_EQ(decoded.sni, expected.sni);
+  EXPECT_TRUE(IOBufEqualTo()(decoded.pendingData, expected.pendingData));
+}
+
+TEST_F(ConnectionHandoffTest, TestEncodeDecodeOptionalFields) {
+  auto handoff = makeHandoff();
+  handoff.resumptionMasterSecret = folly::none;
+  handoff.alpn = folly::none;
+  handoff.sni = folly::none;
+  handoff.pendingData = nullptr;
+  auto decoded = decodeConnectionHandoff(encodeConnectionHandoff(handoff));
+  EXPECT_FALSE(decoded.resumptionMasterSecret.hasValue());
+  EXPECT_FALSE(decoded.alpn.hasValue());
+  EXPECT_FALSE(decoded.sni.hasValue());
+  EXPECT_TRUE(decoded.pendingData->empty());
+}
+
+TEST_F(ConnectionHandoffTest, TestDecodeMalformed) {
+  auto encoded = encodeConnectionHandoff(makeHandoff());
+  auto truncated = encoded->clone();
+  truncated->coalesce();
+  truncated->trimEnd(1);
+  EXPECT_ANY_THROW(decodeConnectionHandoff(std::move(truncated)));
+
+  encoded->prependChain(IOBuf::copyBuffer("x"));
+  EXPECT_THROW(decodeConnectionHandoff(std::move(encoded)), std::exception);
+}
+
+TEST_F(ConnectionHandoffTest, TestImport) {
+  import(makeHandoff());
+  EXPECT_EQ(state_.state(), StateEnum::AcceptingData);
+  EXPECT_EQ(*state_.version(), ProtocolVersion::tls_1_3);
+  EXPECT_EQ(*state_.cipher(), CipherSuite::TLS_AES_128_GCM_SHA256);
+  EXPECT_EQ(*state_.alpn(), "h2");
+  EXPECT_EQ(*state_.sni(), "www.hostname.com");
+  EXPECT_EQ(
+      state_.readRecordLayer()->getEncryptionLevel(),
+      EncryptionLevel::AppTraffic);
+  auto read = dynamic_cast<EncryptedReadRecordLayer*>(state_.readRecordLayer());
+  auto write = dynamic_cast<const EncryptedWriteRecordLayer*>(
+      state_.writeRecordLayer());
+  ASSERT_TRUE(read);
+  ASSERT_TRUE(write);
+  EXPECT_EQ(read->getSequenceNumber(), 5);
+  EXPECT_EQ(write->getSequenceNumber(), 7);
+  EXPECT_EQ(
+      state_.resumptionMasterSecret().value(), std::vector<uint8_t>(32, 0x03));
+}
+
+TEST_F(ConnectionHandoffTest, TestImportExport) {
+  import(makeHandoff());
+  auto exported = exportConnection(state_);
+  auto expected = makeHandoff();
+  EXPECT_EQ(exported.version, expected.version);
+  EXPECT_EQ(exported.cipher, expected.cipher);
+  EXPECT_EQ(exported.clientTrafficSecret, expected.clientTrafficSecret);
+  EXPECT_EQ(exported.serverTrafficSecret, expected.serverTrafficSecret);
+  EXPECT_EQ(exported.readSeqNum, 5);
+  EXPECT_EQ(exported.writeSeqNum, 7);
+  EXPECT_TRUE(IOBufEqualTo()(
+      exported.exporterMasterSecret, expected.exporterMasterSecret));
+  EXPECT_EQ(exported.resumptionMasterSecret, expected.resumptionMasterSecret);
+  EXPECT_EQ(exported.pskType, PskType::Resumption);
+}
+
+TEST_F(ConnectionHandoffTest, TestExportNotEstablished) {
+  EXPECT_THROW(exportConnection(state_), std::runtime_error);
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/server/DelegatingSelfCert.h>
+
+#include <fizz/crypto/test/TestUtil.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+class TestDelegatingSelfCert : public DelegatingSelfCert {
+ public:
+  using DelegatingSelfCert::DelegatingSelfCert;
+
+  std::chrono::system_clock::time_point now() const override {
+    return now_;
+  }
+
+  std::chrono::system_clock::time_point now_;
+};
+
+class DelegatingSelfCertTest : public Test {
+ public:
+  void SetUp() override {
+    cert_ = CertUtils::makeSelfCert(
+        kP256DelegationCertificate.str(), kP256Key.str());
+    delegating_ = std::make_shared<TestDelegatingSelfCert>(cert_);
+    delegating_->now_ = std::chrono::system_clock::from_time_t(1800000000);
+
+    auto key = getPrivateKey(kP384Key);
+    auto credential = DelegatedCredentialUtils::generate(
+        *cert_,
+        SignatureScheme::ecdsa_secp256r1_sha256,
+        key.get(),
+        SignatureScheme::ecdsa_secp384r1_sha384,
+        std::chrono::hours(1),
+        delegating_->now_);
+    delegated_ = DelegatedSelfCert::make(
+        cert_, kP384Key.str(), std::move(credential));
+  }
+
+ protected:
+  std::shared_ptr<const SelfCert> getDelegatedCert() {
+    return delegating_->getDelegatedCert(
+        {SignatureScheme::ecdsa_secp384r1_sha384},
+        {SignatureScheme::ecdsa_secp256r1_sha256});
+  }
+
+  std::shared_ptr<const SelfCert> cert_;
+  std::shared_ptr<const DelegatedSelfCert> delegated_;
+  std::shared_ptr<TestDelegatingSelfCert> delegating_;
+};
+
+TEST_F(DelegatingSelfCertTest, TestNoCredential) {
+  EXPECT_EQ(getDelegatedCert(), nullptr);
+  EXPECT_EQ(delegating_->getSigSchemes(), cert_->getSigSchemes());
+}
+
+TEST_F(DelegatingSelfCertTest, TestForwardsCertificateType) {
+  auto rawKey = std::make_shared<DelegatingSelfCert>(
+      CertUtils::makeRawPublicKeySelfCert(kP256Key.str(), "id"));
+  EXPECT_EQ(rawKey->getCertificateType(), CertificateType::RawPublicKey);
+  EXPECT_EQ(delegating_->getCertificateType(), CertificateType::X509);
+}
+
+TEST_F(DelegatingSelfCertTest, TestCredential) {
+  delegating_->setDelegatedCert(delegated_);
+  EXPECT_EQ(getDelegatedCert(), delegated_);
+}
+
+TEST_F(DelegatingSelfCertTest, TestCredentialCleared) {
+  delegating_->setDelegatedCert(delegated_);
+  delegating_->setDelegatedCert(nullptr);
+  EXPECT_EQ(getDelegatedCert(), nullptr);
+}
+
+TEST_F(DelegatingSelfCertTest, TestVerifySchemeNotSupported) {
+  delegating_->setDelegatedCert(delegated_);
+  EXPECT_EQ(
+      delegating_->getDelegatedCert(
+          {SignatureScheme::ecdsa_secp256r1_sha256},
+          {SignatureScheme::ecdsa_secp256r1_sha256}),
+      nullptr);
+}
+
+TEST_F(DelegatingSelfCertTest, TestCredentialSchemeNotSupported) {
+  delegating_->setDelegatedCert(delegated_);
+  EXPECT_EQ(
+      delegating_->getDelegatedCert(
+          {SignatureScheme::ecdsa_secp384r1_sha384},
+          {SignatureScheme::rsa_pss_sha256}),
+      nullptr);
+}
+
+TEST_F(DelegatingSelfCertTest, TestExpired) {
+  delegating_->setDelegatedCert(delegated_);
+  delegating_->now_ += std::chrono::hours(2);
+  EXPECT_EQ(getDelegatedCert(), nullptr);
+}
+} // namespace test
+} // namespace fizz
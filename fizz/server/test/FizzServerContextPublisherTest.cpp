@@ -0,0 +1,67 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/server/FizzServerContextPublisher.h>
+
+#include <thread>
+
+namespace fizz {
+namespace server {
+namespace test {
+
+TEST(FizzServerContextPublisherTest, TestUpdateKeepsOldSnapshot) {
+  auto initial = std::make_shared<FizzServerContext>();
+  initial->setSupportedAlpns({"h2"});
+  initial->setCertManager(std::make_unique<CertManager>());
+  FizzServerContextPublisher publisher(initial);
+
+  auto inFlight = publisher.get();
+  EXPECT_EQ(inFlight, initial);
+
+  auto next = publisher.update([](FizzServerContext& ctx) {
+    ctx.setSupportedAlpns({"h2", "http/1.1"});
+  });
+  EXPECT_EQ(publisher.get(), next);
+  std::vector<std::string> clientAlpns = {"http/1.1"};
+  EXPECT_FALSE(inFlight->negotiateAlpn(clientAlpns, folly::none));
+  EXPECT_EQ(*next->negotiateAlpn(clientAlpns, folly::none), "http/1.1");
+  // Unchanged components are shared.
+  EXPECT_EQ(next->getFactory(), inFlight->getFactory());
+}
+
+TEST(FizzServerContextPublisherTest, TestPublish) {
+  FizzServerContextPublisher publisher(std::make_shared<FizzServerContext>());
+  auto replacement = std::make_shared<FizzServerContext>();
+  publisher.publish(replacement);
+  EXPECT_EQ(publisher.get(), replacement);
+  EXPECT_THROW(publisher.publish(nullptr), std::runtime_error);
+}
+
+TEST(FizzServerContextPublisherTest, TestConcurrentUpdates) {
+  FizzServerContextPublisher publisher(std::make_shared<FizzServerContext>());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4; ++i) {
+    threads.emplace_back([&]() {
+      for (size_t j = 0; j < 50; ++j) {
+        publisher.update([](FizzServerContext& ctx) {
+          ctx.setNumNewSessionTickets(ctx.getNumNewSessionTickets() + 1);
+        });
+        EXPECT_TRUE(publisher.get());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(publisher.get()->getNumNewSessionTickets(), 201);
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/server/HandshakeScheduler.h>
+
+#include <folly/executors/ManualExecutor.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+class HandshakeSchedulerTest : public Test {
+ public:
+  void SetUp() override {
+    executor_ = std::make_shared<ManualExecutor>();
+  }
+
+ protected:
+  Future<Optional<Buf>> schedule(
+      HandshakeScheduler& scheduler,
+      HandshakeScheduler::Priority priority,
+      std::string name) {
+    return scheduler.schedule(priority, [this, name]() {
+      order_.push_back(name);
+      return Optional<Buf>(IOBuf::copyBuffer(name));
+    });
+  }
+
+  std::shared_ptr<ManualExecutor> executor_;
+  std::vector<std::string> order_;
+};
+
+TEST_F(HandshakeSchedulerTest, TestRunOnExecutor) {
+  auto scheduler = std::make_shared<HandshakeScheduler>(executor_, 1, 1);
+  auto result = schedule(*scheduler, HandshakeScheduler::Priority::Normal, "a");
+  EXPECT_FALSE(result.isReady());
+  EXPECT_EQ(scheduler->getRunning(), 1);
+  EXPECT_EQ(scheduler->getQueued(), 0);
+
+  executor_->drain();
+  ASSERT_TRUE(result.isReady());
+  EXPECT_TRUE(IOBufEqualTo()(*result.value(), IOBuf::copyBuffer("a")));
+  EXPECT_EQ(scheduler->getRunning(), 0);
+}
+
+TEST_F(HandshakeSchedulerTest, TestPriority) {
+  auto scheduler = std::make_shared<HandshakeScheduler>(executor_, 1, 8);
+  auto first = schedule(*scheduler, HandshakeScheduler::Priority::Normal, "a");
+  auto second =
+      schedule(*scheduler, HandshakeScheduler::Priority::Normal, "b");
+  auto third = schedule(*scheduler, HandshakeScheduler::Priority::High, "c");
+  auto fourth = schedule(*scheduler, HandshakeScheduler::Priority::High, "d");
+  EXPECT_EQ(scheduler->getRunning(), 1);
+  EXPECT_EQ(scheduler->getQueued(), 3);
+
+  executor_->drain();
+  EXPECT_EQ(order_, std::vector<std::string>({"a", "c", "d", "b"}));
+  EXPECT_TRUE(second.isReady());
+  EXPECT_EQ(scheduler->getQueued(), 0);
+}
+
+TEST_F(HandshakeSchedulerTest, TestConcurrency) {
+  auto scheduler = std::make_shared<HandshakeScheduler>(executor_, 2, 8);
+  Promise<Optional<Buf>> promise;
+  auto pending = scheduler->schedule(
+      HandshakeScheduler::Priority::Normal,
+      [&promise]() { return promise.getFuture(); });
+  auto first = schedule(*scheduler, HandshakeScheduler::Priority::Normal, "a");
+  auto second =
+      schedule(*scheduler, HandshakeScheduler::Priority::Normal, "b");
+  EXPECT_EQ(scheduler->getRunning(), 2);
+  EXPECT_EQ(scheduler->getQueued(), 1);
+
+  executor_->drain();
+  EXPECT_FALSE(pending.isReady());
+  EXPECT_EQ(order_, std::vector<std::string>({"a", "b"}));
+  EXPECT_EQ(scheduler->getRunning(), 1);
+
+  promise.setValue(IOBuf::copyBuffer("done"));
+  EXPECT_TRUE(pending.isReady());
+  EXPECT_EQ(scheduler->getRunning(), 0);
+}
+
+TEST_F(HandshakeSchedulerTest, TestQueueFull) {
+  auto scheduler = std::make_shared<HandshakeScheduler>(executor_, 1, 1);
+  auto first = schedule(*scheduler, HandshakeScheduler::Priority::Normal, "a");
+  auto second =
+      schedule(*scheduler, HandshakeScheduler::Priority::Normal, "b");
+  auto third = schedule(*scheduler, HandshakeScheduler::Priority::High, "c");
+  ASSERT_TRUE(third.isReady());
+  EXPECT_THROW(std::move(third).get(), FizzException);
+
+  executor_->drain();
+  EXPECT_EQ(order_, std::vector<std::string>({"a", "b"}));
+}
+
+TEST_F(HandshakeSchedulerTest, TestWorkThrows) {
+  auto scheduler = std::make_shared<HandshakeScheduler>(executor_, 1, 1);
+  auto first = scheduler->schedule(
+      HandshakeScheduler::Priority::Normal,
+      []() -> Future<Optional<Buf>> { throw std::runtime_error("error"); });
+  auto second =
+      schedule(*scheduler, HandshakeScheduler::Priority::Normal, "a");
+
+  executor_->drain();
+  ASSERT_TRUE(first.isReady());
+  EXPECT_THROW(std::move(first).get(), std::runtime_error);
+  EXPECT_EQ(order_, std::vector<std::string>({"a"}));
+  EXPECT_EQ(scheduler->getRunning(), 0);
+}
+
+TEST_F(HandshakeSchedulerTest, TestCancelledJobsDropped) {
+  auto scheduler = std::make_shared<HandshakeScheduler>(executor_, 1, 8);
+  auto cancelled = std::make_shared<std::atomic<bool>>(false);
+  auto first = schedule(*scheduler, HandshakeScheduler::Priority::Normal, "a");
+  auto second = scheduler->schedule(
+      HandshakeScheduler::Priority::Normal,
+      [this]() {
+        order_.push_back("b");
+        return Optional<Buf>(IOBuf::copyBuffer("b"));
+      },
+      cancelled);
+  auto third = schedule(*scheduler, HandshakeScheduler::Priority::Normal, "c");
+  EXPECT_EQ(scheduler->getQueued(), 2);
+
+  cancelled->store(true);
+  executor_->drain();
+  EXPECT_EQ(order_, std::vector<std::string>({"a", "c"}));
+  ASSERT_TRUE(second.isReady());
+  EXPECT_THROW(std::move(second).get(), FutureCancellation);
+  EXPECT_TRUE(third.isReady());
+  EXPECT_EQ(scheduler->getQueued(), 0);
+  EXPECT_EQ(scheduler->getRunning(), 0);
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,216 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/server/LazyCertManager.h>
+
+#include <fizz/protocol/test/Mocks.h>
+#include <folly/executors/ManualExecutor.h>
+
+using namespace fizz::test;
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+static const std::vector<SignatureScheme> kRsa{SignatureScheme::rsa_pss_sha256};
+
+class LazyCertManagerTest : public Test {
+ protected:
+  void SetUp() override {
+    executor_ = std::make_shared<ManualExecutor>();
+    manager_ = std::make_unique<LazyCertManager>(executor_, 2);
+  }
+
+  std::shared_ptr<MockSelfCert> getCert(std::vector<SignatureScheme> schemes) {
+    auto cert = std::make_shared<MockSelfCert>();
+    ON_CALL(*cert, getSigSchemes()).WillByDefault(Return(schemes));
+    return cert;
+  }
+
+  LazyCertManager::Loader countingLoader(
+      std::shared_ptr<SelfCert> cert,
+      size_t& loads) {
+    return [cert, &loads]() {
+      loads++;
+      return cert;
+    };
+  }
+
+  std::shared_ptr<ManualExecutor> executor_;
+  std::unique_ptr<LazyCertManager> manager_;
+};
+
+TEST_F(LazyCertManagerTest, TestLoadOnFirstUse) {
+  size_t loads = 0;
+  auto cert = getCert(kRsa);
+  manager_->addLazyCert(
+      {"www.test.com", "alt.test.com"}, countingLoader(cert, loads));
+  EXPECT_EQ(loads, 0);
+
+  auto res = manager_->getCert(std::string("alt.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert);
+  EXPECT_EQ(loads, 1);
+
+  res = manager_->getCert(std::string("WWW.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert);
+  EXPECT_EQ(manager_->getCert("www.test.com"), cert);
+  EXPECT_EQ(manager_->getCert("alt.test.com"), nullptr);
+  EXPECT_EQ(loads, 1);
+}
+
+TEST_F(LazyCertManagerTest, TestWildcardAndDefault) {
+  size_t loads = 0;
+  auto wildcard = getCert(kRsa);
+  auto def = getCert(kRsa);
+  manager_->addLazyCert({"*.test.com"}, countingLoader(wildcard, loads));
+  manager_->addLazyCert({"default.com"}, countingLoader(def, loads), true);
+
+  auto res = manager_->getCert(std::string("foo.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, wildcard);
+  res = manager_->getCert(std::string("foo.bar.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, def);
+  res = manager_->getCert(none, kRsa, kRsa);
+  EXPECT_EQ(res->first, def);
+  EXPECT_EQ(loads, 2);
+}
+
+TEST_F(LazyCertManagerTest, TestSigSchemeLastResort) {
+  size_t loads = 0;
+  auto cert = getCert(kRsa);
+  manager_->addLazyCert({"www.test.com"}, countingLoader(cert, loads));
+
+  auto res = manager_->getCert(
+      std::string("www.test.com"),
+      kRsa,
+      {SignatureScheme::ecdsa_secp256r1_sha256});
+  EXPECT_EQ(res->first, cert);
+  EXPECT_EQ(res->second, SignatureScheme::rsa_pss_sha256);
+}
+
+TEST_F(LazyCertManagerTest, TestEviction) {
+  size_t loads = 0;
+  manager_->addLazyCert({"a.com"}, countingLoader(getCert(kRsa), loads));
+  manager_->addLazyCert({"b.com"}, countingLoader(getCert(kRsa), loads));
+  manager_->addLazyCert({"c.com"}, countingLoader(getCert(kRsa), loads));
+
+  manager_->getCert("a.com");
+  manager_->getCert("b.com");
+  manager_->getCert("c.com");
+  EXPECT_EQ(loads, 3);
+  manager_->getCert("c.com");
+  EXPECT_EQ(loads, 3);
+  manager_->getCert("a.com");
+  EXPECT_EQ(loads, 4);
+}
+
+TEST_F(LazyCertManagerTest, TestPrefetch) {
+  size_t loads = 0;
+  auto cert = getCert(kRsa);
+  manager_->addLazyCert({"www.test.com"}, countingLoader(cert, loads));
+
+  auto prefetch1 = manager_->prefetchCert(std::string("www.test.com"));
+  auto prefetch2 = manager_->prefetchCert(std::string("www.test.com"));
+  EXPECT_FALSE(prefetch1.isReady());
+  EXPECT_FALSE(prefetch2.isReady());
+  EXPECT_EQ(loads, 0);
+
+  executor_->drain();
+  EXPECT_TRUE(prefetch1.isReady());
+  EXPECT_TRUE(prefetch2.isReady());
+  EXPECT_EQ(loads, 1);
+
+  EXPECT_TRUE(manager_->prefetchCert(std::string("www.test.com")).isReady());
+  auto res = manager_->getCert(std::string("www.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert);
+  EXPECT_EQ(loads, 1);
+}
+
+TEST_F(LazyCertManagerTest, TestPrefetchNoMatch) {
+  EXPECT_TRUE(manager_->prefetchCert(std::string("www.test.com")).isReady());
+  EXPECT_TRUE(manager_->prefetchCert(none).isReady());
+}
+
+TEST_F(LazyCertManagerTest, TestPrefetchLoadFailure) {
+  manager_->addLazyCert({"www.test.com"}, []() -> std::shared_ptr<SelfCert> {
+    throw std::runtime_error("no such file");
+  });
+  auto prefetch = manager_->prefetchCert(std::string("www.test.com"));
+  executor_->drain();
+  EXPECT_TRUE(prefetch.hasValue());
+  EXPECT_THROW(
+      manager_->getCert(std::string("www.test.com"), kRsa, kRsa),
+      std::runtime_error);
+}
+
+TEST_F(LazyCertManagerTest, TestFailedLoadCached) {
+  size_t loads = 0;
+  manager_->addLazyCert(
+      {"www.test.com"}, [&loads]() -> std::shared_ptr<SelfCert> {
+        loads++;
+        throw std::runtime_error("no such file");
+      });
+  auto prefetch = manager_->prefetchCert(std::string("www.test.com"));
+  executor_->drain();
+  EXPECT_EQ(loads, 1);
+
+  EXPECT_TRUE(manager_->prefetchCert(std::string("www.test.com")).isReady());
+  EXPECT_THROW(
+      manager_->getCert(std::string("www.test.com"), kRsa, kRsa),
+      std::runtime_error);
+  EXPECT_THROW(manager_->getCert("www.test.com"), std::runtime_error);
+  EXPECT_EQ(loads, 1);
+}
+
+TEST_F(LazyCertManagerTest, TestFailedLoadRetriedAfterTtl) {
+  manager_ = std::make_unique<LazyCertManager>(
+      executor_, 2, std::chrono::milliseconds(0));
+  size_t loads = 0;
+  auto cert = getCert(kRsa);
+  manager_->addLazyCert({"www.test.com"}, [&]() -> std::shared_ptr<SelfCert> {
+    if (loads++ == 0) {
+      throw std::runtime_error("no such file");
+    }
+    return cert;
+  });
+  EXPECT_THROW(
+      manager_->getCert(std::string("www.test.com"), kRsa, kRsa),
+      std::runtime_error);
+  auto res = manager_->getCert(std::string("www.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert);
+  EXPECT_EQ(loads, 2);
+}
+
+TEST_F(LazyCertManagerTest, TestDestroyedDuringPrefetch) {
+  size_t loads = 0;
+  auto cert = getCert(kRsa);
+  manager_->addLazyCert({"www.test.com"}, countingLoader(cert, loads));
+  auto prefetch = manager_->prefetchCert(std::string("www.test.com"));
+  manager_.reset();
+  executor_->drain();
+  EXPECT_TRUE(prefetch.isReady());
+  EXPECT_EQ(loads, 1);
+}
+
+TEST_F(LazyCertManagerTest, TestAddLoadedCert) {
+  auto cert = getCert(kRsa);
+  ON_CALL(*cert, getIdentity()).WillByDefault(Return("www.test.com"));
+  ON_CALL(*cert, getAltIdentities())
+      .WillByDefault(Return(std::vector<std::string>{"alt.test.com"}));
+  manager_->addCert(cert);
+  auto res = manager_->getCert(std::string("alt.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert);
+  EXPECT_EQ(manager_->getCert("www.test.com"), cert);
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
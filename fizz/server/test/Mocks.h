@@ -124,12 +124,45 @@ class MockTicketCipher : public TicketCipher {
   }
 };
 
+// A template so that Label can be defined in this header.
+template <typename T = void>
+struct SecretCodecImpl {
+  static constexpr folly::StringPiece Label{"Secret Codec"};
+
+  static Buf encode(ResumptionState state) {
+    return std::move(state.resumptionSecret);
+  }
+
+  static ResumptionState decode(Buf encoded, const FizzServerContext*) {
+    if (encoded->computeChainDataLength() == 0) {
+      throw std::runtime_error("empty ticket");
+    }
+    ResumptionState state;
+    state.resumptionSecret = std::move(encoded);
+    return state;
+  }
+};
+
+template <typename T>
+constexpr folly::StringPiece SecretCodecImpl<T>::Label;
+
+/**
+ * Ticket codec that encodes a ResumptionState as just its resumption
+ * secret, for testing ticket ciphers.
+ */
+using SecretCodec = SecretCodecImpl<>;
+
 class MockCookieCipher : public CookieCipher {
  public:
   MOCK_CONST_METHOD1(_decrypt, folly::Optional<CookieState>(Buf&));
   folly::Optional<CookieState> decrypt(Buf cookie) const override {
     return _decrypt(cookie);
   }
+
+  MOCK_CONST_METHOD1(_encrypt, folly::Optional<Buf>(const CookieState&));
+  folly::Optional<Buf> encrypt(const CookieState& state) const override {
+    return _encrypt(state);
+  }
 };
 
 template <typename SM>
@@ -154,6 +187,15 @@ class MockHandshakeCallbackT : public AsyncFizzServerT<SM>::HandshakeCallback {
       std::unique_ptr<folly::IOBuf> clientHello) override {
     return _fizzHandshakeAttemptFallback(clientHello);
   }
+
+  MOCK_METHOD2(
+      _fizzHandshakeRoute,
+      void(ClientHello&, std::unique_ptr<folly::IOBuf>&));
+  void fizzHandshakeRoute(
+      ClientHello chlo,
+      std::unique_ptr<folly::IOBuf> clientHello) override {
+    return _fizzHandshakeRoute(chlo, clientHello);
+  }
 };
 
 using MockHandshakeCallback = MockHandshakeCallbackT<ServerStateMachine>;
@@ -185,6 +227,14 @@ class MockCertManager : public CertManager {
   MOCK_CONST_METHOD1(
       getCert,
       std::shared_ptr<SelfCert>(const std::string& identity));
+  MOCK_CONST_METHOD1(
+      prefetchCert,
+      folly::Future<folly::Unit>(const folly::Optional<std::string>& sni));
+  MOCK_CONST_METHOD2(
+      getCompressedCert,
+      folly::Optional<Buf>(
+          const SelfCert& cert,
+          const std::vector<CertificateCompressionAlgorithm>& peerAlgos));
 };
 
 class MockServerExtensions : public ServerExtensions {
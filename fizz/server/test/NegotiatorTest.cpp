@@ -72,6 +72,41 @@ TEST(NegotiateTest, TestServerEmptyTier) {
 
   EXPECT_EQ(*negotiate(server, client), 4);
 }
+
+TEST(PreferenceTableTest, TestTiers) {
+  std::vector<std::vector<int>> server = {{1}, {2, 4}, {3}};
+  PreferenceTable<int> table(server);
+
+  EXPECT_EQ(*table.negotiate({5, 6, 4, 2}), 4);
+  EXPECT_EQ(*table.negotiate({3, 2, 1}), 1);
+  EXPECT_EQ(*table.negotiate({3, 5}), 3);
+  EXPECT_FALSE(table.negotiate({5, 6}).hasValue());
+  EXPECT_FALSE(table.negotiate({}).hasValue());
+}
+
+TEST(PreferenceTableTest, TestServerOrdering) {
+  std::vector<int> server = {4, 5, 3};
+  PreferenceTable<int> table(server);
+
+  EXPECT_EQ(*table.negotiate({3, 1, 2}), 3);
+  EXPECT_EQ(*table.negotiate({3, 5, 2}), 5);
+  EXPECT_FALSE(table.negotiate({1, 2}).hasValue());
+  EXPECT_TRUE(table.contains(5));
+  EXPECT_FALSE(table.contains(1));
+}
+
+TEST(PreferenceTableTest, TestMatchesNegotiate) {
+  std::vector<std::vector<int>> tiers = {{}, {3, 1}, {2}, {1, 5}};
+  std::vector<int> order = {2, 3, 2, 1};
+  PreferenceTable<int> tierTable(tiers);
+  PreferenceTable<int> orderTable(order);
+  std::vector<std::vector<int>> clients = {
+      {1, 2, 3}, {2, 5}, {5, 3}, {5, 4}, {4, 1, 1}, {}};
+  for (const auto& client : clients) {
+    EXPECT_EQ(tierTable.negotiate(client), negotiate(tiers, client));
+    EXPECT_EQ(orderTable.negotiate(client), negotiate(order, client));
+  }
+}
 } // namespace test
 } // namespace server
 } // namespace fizz
@@ -0,0 +1,65 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/server/NumaContextReplicas.h>
+
+namespace fizz {
+namespace server {
+namespace test {
+
+TEST(NumaContextReplicasTest, TestParseCpuList) {
+  EXPECT_EQ(
+      NumaContextReplicas::parseCpuList("0-3,8,10-11"),
+      std::vector<size_t>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(NumaContextReplicas::parseCpuList("5"), std::vector<size_t>({5}));
+  EXPECT_TRUE(NumaContextReplicas::parseCpuList("").empty());
+  EXPECT_TRUE(NumaContextReplicas::parseCpuList("3-1").empty());
+  EXPECT_TRUE(NumaContextReplicas::parseCpuList("a-b").empty());
+}
+
+TEST(NumaContextReplicasTest, TestReplicaPerNode) {
+  std::vector<size_t> built;
+  NumaContextReplicas replicas(2, [&](size_t node) {
+    built.push_back(node);
+    return std::make_shared<FizzServerContext>();
+  });
+  EXPECT_EQ(built, std::vector<size_t>({0, 1}));
+  EXPECT_EQ(replicas.numNodes(), 2);
+  EXPECT_NE(replicas.get(0), replicas.get(1));
+  auto local = replicas.getLocal();
+  EXPECT_TRUE(local == replicas.get(0) || local == replicas.get(1));
+}
+
+TEST(NumaContextReplicasTest, TestBuilderErrors) {
+  EXPECT_THROW(
+      NumaContextReplicas(
+          1,
+          [](size_t) -> std::shared_ptr<FizzServerContext> {
+            return nullptr;
+          }),
+      std::runtime_error);
+  EXPECT_THROW(
+      NumaContextReplicas(
+          1,
+          [](size_t) -> std::shared_ptr<FizzServerContext> {
+            throw std::runtime_error("no certs");
+          }),
+      std::runtime_error);
+}
+
+TEST(NumaContextReplicasTest, TestHostTopology) {
+  EXPECT_GE(NumaContextReplicas::getNumNodes(), 1);
+  EXPECT_LT(
+      NumaContextReplicas::getCurrentNode(),
+      NumaContextReplicas::getNumNodes());
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
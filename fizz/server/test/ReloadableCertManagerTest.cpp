@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/server/ReloadableCertManager.h>
+
+#include <fizz/protocol/test/Mocks.h>
+
+using namespace fizz::test;
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+static const std::vector<SignatureScheme> kRsa{SignatureScheme::rsa_pss_sha256};
+
+class ReloadableCertManagerTest : public Test {
+ protected:
+  std::shared_ptr<MockSelfCert> getCert(std::string identity) {
+    auto cert = std::make_shared<MockSelfCert>();
+    ON_CALL(*cert, getIdentity()).WillByDefault(Return(identity));
+    ON_CALL(*cert, getAltIdentities())
+        .WillByDefault(Return(std::vector<std::string>()));
+    ON_CALL(*cert, getSigSchemes()).WillByDefault(Return(kRsa));
+    return cert;
+  }
+
+  static std::shared_ptr<CertManager> makeCerts(
+      std::vector<std::shared_ptr<SelfCert>> certs) {
+    auto manager = std::make_shared<CertManager>();
+    for (auto& cert : certs) {
+      manager->addCert(std::move(cert));
+    }
+    return manager;
+  }
+
+  ReloadableCertManager manager_;
+};
+
+TEST_F(ReloadableCertManagerTest, TestEmpty) {
+  EXPECT_FALSE(manager_.getCert(std::string("www.test.com"), kRsa, kRsa));
+  EXPECT_EQ(manager_.getCert("www.test.com"), nullptr);
+}
+
+TEST_F(ReloadableCertManagerTest, TestReload) {
+  auto cert1 = getCert("www.test.com");
+  auto cert2 = getCert("*.test.com");
+  manager_.reload(makeCerts({cert1}));
+
+  auto res = manager_.getCert(std::string("www.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert1);
+  EXPECT_FALSE(manager_.getCert(std::string("foo.test.com"), kRsa, kRsa));
+
+  auto oldSnapshot = manager_.getSnapshot();
+  manager_.reload(makeCerts({cert2}));
+
+  res = manager_.getCert(std::string("www.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert2);
+  res = manager_.getCert(std::string("foo.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert2);
+  EXPECT_EQ(manager_.getCert("*.test.com"), cert2);
+  EXPECT_EQ(manager_.getCert("www.test.com"), nullptr);
+
+  // Lookups that already hold the old snapshot are unaffected.
+  res = oldSnapshot->getCert(std::string("www.test.com"), kRsa, kRsa);
+  EXPECT_EQ(res->first, cert1);
+}
+
+TEST_F(ReloadableCertManagerTest, TestAddCertThrows) {
+  EXPECT_THROW(manager_.addCert(getCert("www.test.com")), std::runtime_error);
+}
+
+TEST_F(ReloadableCertManagerTest, TestReloadNull) {
+  EXPECT_THROW(manager_.reload(nullptr), std::runtime_error);
+}
+
+TEST_F(ReloadableCertManagerTest, TestReloadBorrowedThrows) {
+  auto certs = std::make_shared<CertManager>();
+  certs->setBorrowCerts(true);
+  certs->addCert(getCert("www.test.com"), true);
+  EXPECT_THROW(manager_.reload(certs), std::runtime_error);
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
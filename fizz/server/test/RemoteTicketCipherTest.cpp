@@ -0,0 +1,205 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/server/RemoteTicketCipher.h>
+#include <fizz/server/test/Mocks.h>
+
+#include <folly/executors/ManualExecutor.h>
+
+#include <thread>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+// Tickets are "enc:" followed by the plaintext. Results are returned once
+// complete() is called.
+class FakeTicketKeyService : public TicketKeyService {
+ public:
+  Future<std::vector<Buf>> encrypt(std::vector<Buf> plaintexts) override {
+    encryptBatches.push_back(plaintexts.size());
+    std::vector<Buf> tickets;
+    for (auto& plaintext : plaintexts) {
+      auto ticket = IOBuf::copyBuffer("enc:");
+      ticket->prependChain(std::move(plaintext));
+      tickets.push_back(std::move(ticket));
+    }
+    return respond(std::move(tickets));
+  }
+
+  Future<std::vector<Buf>> decrypt(std::vector<Buf> tickets) override {
+    decryptBatches.push_back(tickets.size());
+    std::vector<Buf> plaintexts;
+    for (auto& ticket : tickets) {
+      auto str = ticket->moveToFbString().toStdString();
+      if (StringPiece(str).startsWith("enc:") && !rejectAll) {
+        plaintexts.push_back(IOBuf::copyBuffer(str.substr(4)));
+      } else {
+        plaintexts.push_back(nullptr);
+      }
+    }
+    return respond(std::move(plaintexts));
+  }
+
+  void complete() {
+    auto pending = std::move(pending_);
+    for (auto& response : pending) {
+      response.first.setValue(std::move(response.second));
+    }
+  }
+
+  std::vector<size_t> encryptBatches;
+  std::vector<size_t> decryptBatches;
+  bool rejectAll{false};
+  bool respondShort{false};
+
+ private:
+  Future<std::vector<Buf>> respond(std::vector<Buf> results) {
+    if (respondShort) {
+      results.pop_back();
+    }
+    Promise<std::vector<Buf>> promise;
+    auto future = promise.getFuture();
+    pending_.emplace_back(std::move(promise), std::move(results));
+    return future;
+  }
+
+  std::vector<std::pair<Promise<std::vector<Buf>>, std::vector<Buf>>> pending_;
+};
+
+class RemoteTicketCipherTest : public Test {
+ public:
+  void SetUp() override {
+    service_ = std::make_shared<FakeTicketKeyService>();
+    executor_ = std::make_shared<ManualExecutor>();
+    tokenCipher_ = std::make_shared<RemoteTokenCipher>(service_, executor_, 4);
+    cipher_ = std::make_shared<RemoteTicketCipher<SecretCodec>>(tokenCipher_);
+  }
+
+ protected:
+  static ResumptionState makeState(StringPiece secret) {
+    ResumptionState state;
+    state.resumptionSecret = IOBuf::copyBuffer(secret);
+    return state;
+  }
+
+  void run() {
+    executor_->drain();
+    service_->complete();
+  }
+
+  std::shared_ptr<FakeTicketKeyService> service_;
+  std::shared_ptr<ManualExecutor> executor_;
+  std::shared_ptr<RemoteTokenCipher> tokenCipher_;
+  std::shared_ptr<RemoteTicketCipher<SecretCodec>> cipher_;
+};
+
+TEST_F(RemoteTicketCipherTest, TestEncryptDecrypt) {
+  cipher_->setValidity(std::chrono::seconds(30));
+  auto encrypted = cipher_->encrypt(makeState("secret"));
+  EXPECT_FALSE(encrypted.isReady());
+  run();
+  ASSERT_TRUE(encrypted.isReady());
+  ASSERT_TRUE(encrypted.value().hasValue());
+  EXPECT_EQ(encrypted.value()->second, std::chrono::seconds(30));
+  EXPECT_TRUE(IOBufEqualTo()(
+      encrypted.value()->first, IOBuf::copyBuffer("enc:secret")));
+
+  auto decrypted = cipher_->decrypt(std::move(encrypted.value()->first));
+  run();
+  ASSERT_TRUE(decrypted.isReady());
+  EXPECT_EQ(decrypted.value().first, PskType::Resumption);
+  EXPECT_TRUE(IOBufEqualTo()(
+      decrypted.value().second->resumptionSecret,
+      IOBuf::copyBuffer("secret")));
+}
+
+TEST_F(RemoteTicketCipherTest, TestBatching) {
+  std::vector<Future<std::pair<PskType, Optional<ResumptionState>>>> results;
+  for (size_t i = 0; i < 6; ++i) {
+    results.push_back(
+        cipher_->decrypt(IOBuf::copyBuffer("enc:" + std::to_string(i))));
+  }
+  auto encrypted = cipher_->encrypt(makeState("secret"));
+  run();
+  EXPECT_EQ(service_->decryptBatches, std::vector<size_t>({4, 2}));
+  EXPECT_EQ(service_->encryptBatches, std::vector<size_t>({1}));
+  for (size_t i = 0; i < results.size(); ++i) {
+    ASSERT_TRUE(results[i].isReady());
+    EXPECT_TRUE(IOBufEqualTo()(
+        results[i].value().second->resumptionSecret,
+        IOBuf::copyBuffer(std::to_string(i))));
+  }
+  EXPECT_TRUE(encrypted.isReady());
+}
+
+TEST_F(RemoteTicketCipherTest, TestRejected) {
+  auto unknown = cipher_->decrypt(IOBuf::copyBuffer("garbage"));
+  auto undecodable = cipher_->decrypt(IOBuf::copyBuffer("enc:"));
+  run();
+  EXPECT_EQ(unknown.value().first, PskType::Rejected);
+  EXPECT_FALSE(unknown.value().second.hasValue());
+  EXPECT_EQ(undecodable.value().first, PskType::Rejected);
+}
+
+TEST_F(RemoteTicketCipherTest, TestServiceError) {
+  service_->respondShort = true;
+  auto decrypted = cipher_->decrypt(IOBuf::copyBuffer("enc:secret"));
+  auto encrypted = cipher_->encrypt(makeState("secret"));
+  run();
+  ASSERT_TRUE(decrypted.isReady());
+  EXPECT_EQ(decrypted.value().first, PskType::Rejected);
+  ASSERT_TRUE(encrypted.isReady());
+  EXPECT_FALSE(encrypted.value().hasValue());
+
+  auto token = tokenCipher_->decrypt(IOBuf::copyBuffer("enc:secret"));
+  run();
+  EXPECT_THROW(token.value(), std::runtime_error);
+}
+
+TEST_F(RemoteTicketCipherTest, TestDecryptCache) {
+  tokenCipher_->setDecryptCache(10, std::chrono::seconds(10));
+  auto first = cipher_->decrypt(IOBuf::copyBuffer("enc:secret"));
+  run();
+  EXPECT_EQ(first.value().first, PskType::Resumption);
+
+  service_->rejectAll = true;
+  auto second = cipher_->decrypt(IOBuf::copyBuffer("enc:secret"));
+  EXPECT_TRUE(second.isReady());
+  EXPECT_EQ(second.value().first, PskType::Resumption);
+  EXPECT_TRUE(IOBufEqualTo()(
+      second.value().second->resumptionSecret, IOBuf::copyBuffer("secret")));
+  EXPECT_EQ(service_->decryptBatches, std::vector<size_t>({1}));
+
+  // Rejected tickets aren't cached.
+  auto other = cipher_->decrypt(IOBuf::copyBuffer("enc:other"));
+  run();
+  EXPECT_EQ(other.value().first, PskType::Rejected);
+  other = cipher_->decrypt(IOBuf::copyBuffer("enc:other"));
+  run();
+  EXPECT_EQ(service_->decryptBatches, std::vector<size_t>({1, 1, 1}));
+}
+
+TEST_F(RemoteTicketCipherTest, TestDecryptCacheExpires) {
+  tokenCipher_->setDecryptCache(10, std::chrono::milliseconds(1));
+  cipher_->decrypt(IOBuf::copyBuffer("enc:secret"));
+  run();
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  auto again = cipher_->decrypt(IOBuf::copyBuffer("enc:secret"));
+  EXPECT_FALSE(again.isReady());
+  run();
+  EXPECT_EQ(service_->decryptBatches, std::vector<size_t>({1, 1}));
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,193 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/server/RotatingTicketCipher.h>
+#include <fizz/server/test/Mocks.h>
+
+#include <fizz/crypto/Hkdf.h>
+#include <fizz/crypto/Sha256.h>
+#include <fizz/crypto/aead/AESGCM128.h>
+#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
+#include <folly/executors/ManualExecutor.h>
+
+#include <atomic>
+#include <thread>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+using TestRotatingTicketCipher = RotatingTicketCipher<
+    OpenSSLEVPCipher<AESGCM128>,
+    SecretCodec,
+    HkdfImpl<Sha256>>;
+
+static const std::string kSeed(32, 's');
+
+class RotatingTicketCipherTest : public Test {
+ public:
+  void SetUp() override {
+    cipher_ = std::make_unique<TestRotatingTicketCipher>(
+        range(kSeed), std::chrono::hours(1));
+    cipher_->setValidity(std::chrono::hours(2));
+    cipher_->setUseKeyIds(true);
+    now_ = TestRotatingTicketCipher::Clock::now();
+  }
+
+ protected:
+  using Snapshot = TestRotatingTicketCipher::Snapshot;
+
+  static Buf encrypt(const Snapshot& snapshot, StringPiece secret) {
+    ResumptionState state;
+    state.resumptionSecret = IOBuf::copyBuffer(secret);
+    auto result = snapshot.cipher.encrypt(std::move(state)).get();
+    EXPECT_TRUE(result.hasValue());
+    return std::move(result->first);
+  }
+
+  static bool decrypts(const Snapshot& snapshot, const Buf& ticket) {
+    auto result = snapshot.cipher.decrypt(ticket->clone()).get();
+    return result.first == PskType::Resumption;
+  }
+
+  std::shared_ptr<const Snapshot> at(std::chrono::hours offset) {
+    return cipher_->getSnapshot(now_ + offset);
+  }
+
+  std::unique_ptr<TestRotatingTicketCipher> cipher_;
+  TestRotatingTicketCipher::Clock::time_point now_;
+};
+
+TEST_F(RotatingTicketCipherTest, TestEncryptDecrypt) {
+  ResumptionState state;
+  state.resumptionSecret = IOBuf::copyBuffer("secret");
+  auto encrypted = cipher_->encrypt(std::move(state)).get();
+  ASSERT_TRUE(encrypted.hasValue());
+  EXPECT_EQ(encrypted->second, std::chrono::hours(2));
+
+  auto decrypted = cipher_->decrypt(std::move(encrypted->first)).get();
+  EXPECT_EQ(decrypted.first, PskType::Resumption);
+  EXPECT_TRUE(IOBufEqualTo()(
+      decrypted.second->resumptionSecret, IOBuf::copyBuffer("secret")));
+}
+
+TEST_F(RotatingTicketCipherTest, TestRotation) {
+  auto current = at(std::chrono::hours(0));
+  EXPECT_EQ(current->period, cipher_->getPeriod(now_));
+  EXPECT_EQ(at(std::chrono::hours(0)), current);
+
+  auto next = at(std::chrono::hours(1));
+  EXPECT_NE(next, current);
+  EXPECT_EQ(next->period, current->period + 1);
+  EXPECT_EQ(at(std::chrono::hours(1)), next);
+}
+
+TEST_F(RotatingTicketCipherTest, TestRotationExecutor) {
+  auto executor = std::make_shared<ManualExecutor>();
+  cipher_->setRotationExecutor(executor);
+  auto current = at(std::chrono::hours(0));
+
+  // The next period's snapshot was derived ahead of time.
+  auto next = at(std::chrono::hours(1));
+  EXPECT_EQ(next->period, current->period + 1);
+
+  // A later period keeps the published snapshot until its own is derived.
+  EXPECT_EQ(at(std::chrono::hours(3)), next);
+  executor->drain();
+  auto later = at(std::chrono::hours(3));
+  EXPECT_EQ(later->period, current->period + 3);
+  auto ticket = encrypt(*later, "secret");
+  EXPECT_TRUE(decrypts(*later, ticket));
+}
+
+TEST_F(RotatingTicketCipherTest, TestRotationExecutorOutlivesCipher) {
+  auto executor = std::make_shared<ManualExecutor>();
+  cipher_->setRotationExecutor(executor);
+  at(std::chrono::hours(1));
+  cipher_.reset();
+  executor->drain();
+}
+
+TEST_F(RotatingTicketCipherTest, TestAcceptedPeriods) {
+  auto old = encrypt(*at(std::chrono::hours(0)), "old");
+  auto older = encrypt(*at(std::chrono::hours(1)), "older");
+  auto current = at(std::chrono::hours(3));
+  auto ticket = encrypt(*current, "current");
+
+  // Two hours of validity span two previous periods.
+  EXPECT_TRUE(decrypts(*current, ticket));
+  EXPECT_TRUE(decrypts(*current, older));
+  EXPECT_FALSE(decrypts(*current, old));
+}
+
+TEST_F(RotatingTicketCipherTest, TestNextPeriodAccepted) {
+  auto current = at(std::chrono::hours(0));
+
+  // A server whose clock is an hour ahead.
+  TestRotatingTicketCipher ahead(range(kSeed), std::chrono::hours(1));
+  ahead.setUseKeyIds(true);
+  auto ticket = encrypt(*ahead.getSnapshot(now_ + std::chrono::hours(1)), "a");
+
+  EXPECT_TRUE(decrypts(*current, ticket));
+}
+
+TEST_F(RotatingTicketCipherTest, TestSharedSeed) {
+  TestRotatingTicketCipher other(range(kSeed), std::chrono::hours(1));
+  other.setUseKeyIds(true);
+  std::string otherSeed(32, 'd');
+  TestRotatingTicketCipher different(range(otherSeed), std::chrono::hours(1));
+  different.setUseKeyIds(true);
+
+  auto ticket = encrypt(*at(std::chrono::hours(0)), "secret");
+  EXPECT_TRUE(decrypts(*other.getSnapshot(now_), ticket));
+  EXPECT_FALSE(decrypts(*different.getSnapshot(now_), ticket));
+}
+
+TEST_F(RotatingTicketCipherTest, TestClockBackwards) {
+  auto next = at(std::chrono::hours(1));
+  EXPECT_EQ(at(std::chrono::hours(0)), next);
+}
+
+TEST_F(RotatingTicketCipherTest, TestBadConfig) {
+  std::string shortSeed(31, 's');
+  EXPECT_THROW(
+      TestRotatingTicketCipher(range(shortSeed), std::chrono::hours(1)),
+      std::runtime_error);
+  EXPECT_THROW(
+      TestRotatingTicketCipher(range(kSeed), std::chrono::seconds(0)),
+      std::runtime_error);
+}
+
+TEST_F(RotatingTicketCipherTest, TestConcurrentRotation) {
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4; ++i) {
+    threads.emplace_back([&]() {
+      while (!done) {
+        auto snapshot = at(std::chrono::hours(0));
+        auto ticket = encrypt(*snapshot, "secret");
+        EXPECT_TRUE(decrypts(*snapshot, ticket));
+      }
+    });
+  }
+  for (int hour = 1; hour < 50; ++hour) {
+    at(std::chrono::hours(hour));
+  }
+  done = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
@@ -15,6 +15,7 @@
 #include <fizz/protocol/test/TestMessages.h>
 #include <fizz/record/Extensions.h>
 #include <fizz/record/test/Mocks.h>
+#include <fizz/server/ClientHelloFingerprint.h>
 #include <fizz/server/ServerProtocol.h>
 #include <fizz/server/test/Mocks.h>
 #include <folly/executors/ManualExecutor.h>
@@ -52,6 +53,8 @@ class ServerProtocolTest : public ProtocolTest<ServerTypes, Actions> {
         .WillByDefault(Return(CertManager::CertMatch(
             std::make_pair(cert_, SignatureScheme::ecdsa_secp256r1_sha256))));
     ON_CALL(*certManager_, getCert(_)).WillByDefault(Return(cert_));
+    ON_CALL(*certManager_, prefetchCert(_))
+        .WillByDefault(InvokeWithoutArgs([]() { return folly::makeFuture(); }));
   }
 
  protected:
@@ -103,6 +106,34 @@ class ServerProtocolTest : public ProtocolTest<ServerTypes, Actions> {
     return buf;
   }
 
+  /**
+   * Captures the server_certificate_type extension of the EncryptedExtensions
+   * added to the transcript into eeServerCertType_.
+   */
+  void captureEncryptedExtServerCertType() {
+    auto handshakeContext = new MockHandshakeContext();
+    handshakeContext->setDefaults();
+    EXPECT_CALL(*factory_, makeHandshakeContext(_))
+        .WillOnce(InvokeWithoutArgs([=]() {
+          return std::unique_ptr<HandshakeContext>(handshakeContext);
+        }));
+    EXPECT_CALL(*handshakeContext, appendToTranscript(_))
+        .WillRepeatedly(Invoke([this](const Buf& msg) {
+          auto encoded = msg->clone();
+          encoded->coalesce();
+          if (encoded->data()[0] !=
+              static_cast<uint8_t>(HandshakeType::encrypted_extensions)) {
+            return;
+          }
+          encoded->trimStart(4);
+          auto ee = decode<EncryptedExtensions>(std::move(encoded));
+          auto certType = getExtension<ServerCertType>(ee.extensions);
+          if (certType) {
+            eeServerCertType_ = certType->certificate_type;
+          }
+        }));
+  }
+
   void setMockRecord() {
     mockRead_ = new MockPlaintextReadRecordLayer();
     mockWrite_ = new MockPlaintextWriteRecordLayer();
@@ -182,6 +213,25 @@ class ServerProtocolTest : public ProtocolTest<ServerTypes, Actions> {
     }
   }
 
+  // What the state machine keeps of chlo when answering it with a
+  // HelloRetryRequest, without any PSK.
+  void setHelloRetryState(const ClientHello& chlo) {
+    auto retry = std::make_unique<HelloRetryState>();
+    retry->legacySessionId = chlo.legacy_session_id->clone();
+    retry->cipherSuites = chlo.cipher_suites;
+    for (const auto& ext : chlo.extensions) {
+      if (ext.extension_type != ExtensionType::key_share &&
+          ext.extension_type != ExtensionType::pre_shared_key) {
+        Extension copy;
+        copy.extension_type = ext.extension_type;
+        copy.extension_data = ext.extension_data->clone();
+        retry->unchangedExtensions.push_back(std::move(copy));
+      }
+    }
+    retry->pskType = PskType::NotAttempted;
+    state_.helloRetryState() = std::move(retry);
+  }
+
   void setUpExpectingFinished() {
     setMockRecord();
     setMockKeyScheduler();
@@ -272,6 +322,7 @@ class ServerProtocolTest : public ProtocolTest<ServerTypes, Actions> {
   std::shared_ptr<MockCookieCipher> mockCookieCipher_;
   std::shared_ptr<FizzServerContext> context_;
   std::shared_ptr<MockSelfCert> cert_;
+  folly::Optional<CertificateType> eeServerCertType_;
   std::shared_ptr<MockPeerCert> clientIntCert_;
   std::shared_ptr<MockPeerCert> clientLeafCert_;
   std::shared_ptr<MockCertificateVerifier> certVerifier_;
@@ -334,6 +385,67 @@ TEST_F(ServerProtocolTest, TestAccept) {
   EXPECT_EQ(state_.context().get(), context_.get());
   EXPECT_EQ(state_.readRecordLayer().get(), rrl);
   EXPECT_EQ(state_.writeRecordLayer().get(), wrl);
+  EXPECT_NE(state_.handshakeLogging(), nullptr);
+  EXPECT_EQ(state_.handshakeId(), 0);
+}
+
+TEST_F(ServerProtocolTest, TestAcceptHandshakeTracer) {
+  auto tracer = std::make_shared<MockHandshakeTracer>();
+  context_->setHandshakeTracer(tracer);
+  uint64_t reportedId = 0;
+  EXPECT_CALL(
+      *tracer,
+      stateTransition(
+          _,
+          _,
+          StringPiece("Uninitialized"),
+          StringPiece("ExpectingClientHello")))
+      .WillOnce(SaveArg<0>(&reportedId));
+  auto actions = getActions(ServerStateMachine().processAccept(
+      state_, &executor_, context_, extensions_));
+  processStateMutations(actions);
+  EXPECT_NE(state_.handshakeId(), 0);
+  EXPECT_EQ(reportedId, state_.handshakeId());
+
+  // Every connection gets its own id.
+  State other;
+  EXPECT_CALL(*tracer, stateTransition(_, _, _, _));
+  actions = getActions(ServerStateMachine().processAccept(
+      other, &executor_, context_, extensions_));
+  for (auto& action : actions) {
+    if (auto mutate = boost::get<MutateState>(&action)) {
+      (*mutate)(other);
+    }
+  }
+  EXPECT_NE(other.handshakeId(), 0);
+  EXPECT_NE(other.handshakeId(), state_.handshakeId());
+}
+
+TEST_F(ServerProtocolTest, TestAcceptPendingHandshake) {
+  auto admission = std::make_shared<HandshakeAdmissionController>(1);
+  context_->setHandshakeAdmissionController(admission);
+  auto actions = getActions(ServerStateMachine().processAccept(
+      state_, &executor_, context_, extensions_));
+  processStateMutations(actions);
+  EXPECT_EQ(admission->getPendingHandshakes(), 1);
+  EXPECT_FALSE(admission->shouldRequireRetry());
+
+  auto second = admission->startHandshake();
+  EXPECT_TRUE(admission->shouldRequireRetry());
+  second.reset();
+
+  state_.handshakeState().reset();
+  EXPECT_EQ(admission->getPendingHandshakes(), 0);
+}
+
+TEST_F(ServerProtocolTest, TestAcceptHandshakeLoggingNotSampled) {
+  context_->setHandshakeLoggingSampler([] { return false; });
+  auto actions = getActions(ServerStateMachine().processAccept(
+      state_, &executor_, context_, extensions_));
+  expectActions<MutateState>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingClientHello);
+  EXPECT_EQ(state_.handshakeLogging(), nullptr);
 }
 
 TEST_F(ServerProtocolTest, TestAppClose) {
@@ -378,7 +490,9 @@ TEST_F(ServerProtocolTest, TestClientHelloFullHandshakeFlow) {
       *mockHandshakeContext_,
       appendToTranscript(BufMatches("clienthelloencoding")))
       .InSequence(contextSeq);
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::x25519))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Server))
       .WillOnce(InvokeWithoutArgs([]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -564,6 +678,7 @@ TEST_F(ServerProtocolTest, TestClientHelloFullHandshakeFlow) {
   EXPECT_EQ(state_.replayCacheResult(), ReplayCacheResult::NotChecked);
   EXPECT_FALSE(state_.clientClockSkew().hasValue());
   EXPECT_EQ(*state_.alpn(), "h2");
+  EXPECT_EQ(*state_.sni(), "www.hostname.com");
   EXPECT_TRUE(IOBufEqualTo()(
       *state_.clientHandshakeSecret(), IOBuf::copyBuffer("cht")));
   EXPECT_TRUE(IOBufEqualTo()(
@@ -589,7 +704,9 @@ TEST_F(ServerProtocolTest, TestClientHelloCertRequestFlow) {
       *mockHandshakeContext_,
       appendToTranscript(BufMatches("clienthelloencoding")))
       .InSequence(contextSeq);
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::x25519))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Server))
       .WillOnce(InvokeWithoutArgs([]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -999,7 +1116,9 @@ TEST_F(ServerProtocolTest, TestClientHelloPskDheFlow) {
       .WillOnce(InvokeWithoutArgs([]() {
         return std::vector<uint8_t>({'b', 'd', 'r'});
       }));
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::x25519))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Server))
       .WillOnce(InvokeWithoutArgs([]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -1215,7 +1334,9 @@ TEST_F(ServerProtocolTest, TestRetryClientHelloFullHandshakeFlow) {
       *mockHandshakeContext_,
       appendToTranscript(BufMatches("clienthelloencoding")))
       .InSequence(contextSeq);
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::x25519))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Server))
       .WillOnce(InvokeWithoutArgs([]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -1427,7 +1548,9 @@ TEST_F(ServerProtocolTest, TestRetryClientHelloPskDheFlow) {
       .WillOnce(InvokeWithoutArgs([]() {
         return std::vector<uint8_t>({'b', 'd', 'r'});
       }));
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::x25519))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Server))
       .WillOnce(InvokeWithoutArgs([]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -1632,7 +1755,9 @@ TEST_F(ServerProtocolTest, TestClientHelloPskDheEarlyFlow) {
       .WillOnce(InvokeWithoutArgs([]() {
         return std::vector<uint8_t>({'e', 'e', 'm'});
       }));
-  EXPECT_CALL(*factory_, makeKeyExchange(NamedGroup::x25519))
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Server))
       .WillOnce(InvokeWithoutArgs([]() {
         auto ret = std::make_unique<MockKeyExchange>();
         EXPECT_CALL(*ret, generateKeyPair());
@@ -2018,6 +2143,136 @@ TEST_F(ServerProtocolTest, TestClientHelloFullHandshake) {
   expectActions<MutateState, WriteToSocket>(actions);
 }
 
+TEST_F(ServerProtocolTest, TestClientHelloSyncStepsContinueInline) {
+  setUpExpectingClientHello();
+  auto asyncActions =
+      detail::processEvent(state_, TestMessages::clientHello());
+  // The key exchange and signature completed synchronously, so nothing was
+  // left for the executor.
+  EXPECT_TRUE(boost::get<Future<Actions>>(asyncActions).isReady());
+  EXPECT_EQ(executor_.run(), 0);
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState, WriteToSocket>(actions);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloAsyncKeyExchange) {
+  setUpExpectingClientHello();
+  Promise<std::unique_ptr<IOBuf>> sharedSecret;
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Server))
+      .WillOnce(InvokeWithoutArgs([&sharedSecret]() {
+        auto ret = std::make_unique<MockAsyncKeyExchange>();
+        ret->setDefaults();
+        EXPECT_CALL(*ret, generateSharedSecret(_)).Times(0);
+        EXPECT_CALL(*ret, generateSharedSecretAsync(RangeMatches("keyshare")))
+            .WillOnce(InvokeWithoutArgs(
+                [&sharedSecret]() { return sharedSecret.getSemiFuture(); }));
+        return ret;
+      }));
+
+  auto asyncActions =
+      detail::processEvent(state_, TestMessages::clientHello());
+  while (executor_.run())
+    ;
+  EXPECT_FALSE(boost::get<Future<Actions>>(asyncActions).isReady());
+
+  sharedSecret.setValue(IOBuf::copyBuffer("sharedsecret"));
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloHandshakeExecutor) {
+  auto handshakeExecutor = std::make_shared<ManualExecutor>();
+  context_->setHandshakeExecutor(handshakeExecutor);
+  setUpExpectingClientHello();
+  auto asyncActions =
+      detail::processEvent(state_, TestMessages::clientHello());
+  while (executor_.run())
+    ;
+  EXPECT_FALSE(boost::get<Future<Actions>>(asyncActions).isReady());
+
+  // Key exchange.
+  EXPECT_TRUE(handshakeExecutor->run());
+  while (executor_.run())
+    ;
+  EXPECT_FALSE(boost::get<Future<Actions>>(asyncActions).isReady());
+
+  // CertificateVerify signing.
+  EXPECT_TRUE(handshakeExecutor->run());
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloHandshakeTracer) {
+  auto tracer = std::make_shared<MockHandshakeTracer>();
+  context_->setHandshakeTracer(tracer);
+  setUpExpectingClientHello();
+  state_.handshakeId() = 42;
+  {
+    InSequence seq;
+    EXPECT_CALL(*tracer, asyncStepStarted(42, _, HandshakeStep::KeyExchange));
+    EXPECT_CALL(*tracer, asyncStepFinished(42, _, HandshakeStep::KeyExchange));
+    EXPECT_CALL(*tracer, asyncStepStarted(42, _, HandshakeStep::Sign));
+    // The step is stamped as started before the signing starts.
+    EXPECT_CALL(*cert_, sign(_, _, _))
+        .WillOnce(
+            InvokeWithoutArgs([]() { return IOBuf::copyBuffer("signature"); }));
+    EXPECT_CALL(*tracer, asyncStepFinished(42, _, HandshakeStep::Sign));
+    EXPECT_CALL(
+        *tracer,
+        stateTransition(
+            42,
+            _,
+            StringPiece("ExpectingClientHello"),
+            StringPiece("ExpectingFinished")));
+  }
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+}
+
+class SecretWriteRecordLayer : public MockEncryptedWriteRecordLayer {
+ public:
+  using MockEncryptedWriteRecordLayer::MockEncryptedWriteRecordLayer;
+
+  MOCK_METHOD2(trafficSecretAvailable, void(CipherSuite, folly::ByteRange));
+};
+
+TEST_F(ServerProtocolTest, TestClientHelloEncryptionLevels) {
+  setUpExpectingClientHello();
+  EXPECT_CALL(
+      *factory_, makeEncryptedWriteRecordLayer(EncryptionLevel::Handshake))
+      .WillOnce(InvokeWithoutArgs([]() {
+        auto ret = std::make_unique<SecretWriteRecordLayer>(
+            EncryptionLevel::Handshake);
+        ret->setDefaults();
+        EXPECT_CALL(*ret, trafficSecretAvailable(_, _));
+        EXPECT_CALL(*ret, _setAead(_));
+        return ret;
+      }));
+  EXPECT_CALL(
+      *factory_, makeEncryptedReadRecordLayer(EncryptionLevel::Handshake));
+  EXPECT_CALL(
+      *factory_, makeEncryptedWriteRecordLayer(EncryptionLevel::AppTraffic));
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(
+      state_.writeRecordLayer()->getEncryptionLevel(),
+      EncryptionLevel::AppTraffic);
+  EXPECT_EQ(
+      state_.handshakeReadRecordLayer()->getEncryptionLevel(),
+      EncryptionLevel::Handshake);
+}
+
 TEST_F(ServerProtocolTest, TestClientHelloPsk) {
   context_->setSupportedPskModes({PskKeyExchangeMode::psk_ke});
   setUpExpectingClientHello();
@@ -2026,6 +2281,20 @@ TEST_F(ServerProtocolTest, TestClientHelloPsk) {
   expectActions<MutateState, WriteToSocket>(actions);
 }
 
+TEST_F(ServerProtocolTest, TestClientHelloPskHandshakeScheduler) {
+  context_->setSupportedPskModes({PskKeyExchangeMode::psk_ke});
+  setUpExpectingClientHello();
+  auto signExecutor = std::make_shared<ManualExecutor>();
+  auto handshakeScheduler =
+      std::make_shared<HandshakeScheduler>(signExecutor, 1, 1);
+  context_->setHandshakeScheduler(handshakeScheduler);
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHelloPsk()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  EXPECT_EQ(handshakeScheduler->getRunning(), 0);
+  EXPECT_EQ(handshakeScheduler->getQueued(), 0);
+}
+
 TEST_F(ServerProtocolTest, TestClientHelloPskDhe) {
   context_->setSupportedPskModes({PskKeyExchangeMode::psk_dhe_ke});
   setUpExpectingClientHello();
@@ -2045,174 +2314,709 @@ TEST_F(ServerProtocolTest, TestClientHelloPskModeMismatch) {
   expectActions<MutateState, WriteToSocket>(actions);
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloNoSni) {
+TEST_F(ServerProtocolTest, TestClientHelloCompressedCert) {
   setUpExpectingClientHello();
   auto chlo = TestMessages::clientHello();
-  TestMessages::removeExtension(chlo, ExtensionType::server_name);
+  CertificateCompressionAlgorithms algos;
+  algos.algorithms = {CertificateCompressionAlgorithm::zstd};
+  chlo.extensions.push_back(encodeExtension(std::move(algos)));
+  EXPECT_CALL(*certManager_, getCompressedCert(_, _))
+      .WillOnce(Invoke(
+          [this](
+              const SelfCert& cert,
+              const std::vector<CertificateCompressionAlgorithm>& peerAlgos) {
+            EXPECT_EQ(&cert, cert_.get());
+            EXPECT_EQ(
+                peerAlgos,
+                std::vector<CertificateCompressionAlgorithm>(
+                    {CertificateCompressionAlgorithm::zstd}));
+            return folly::Optional<Buf>(IOBuf::copyBuffer("compressedcert"));
+          }));
+  EXPECT_CALL(*cert_, _getCertMessage(_)).Times(0);
   auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
   expectActions<MutateState, WriteToSocket>(actions);
-}
-
-TEST_F(ServerProtocolTest, TestClientHelloFullHandshakeRejectedPsk) {
-  setUpExpectingClientHello();
-  EXPECT_CALL(*mockTicketCipher_, _decrypt(_)).WillOnce(InvokeWithoutArgs([]() {
-    return std::make_pair(PskType::Rejected, none);
-  }));
-
-  auto actions =
-      getActions(detail::processEvent(state_, TestMessages::clientHelloPsk()));
-  expectActions<MutateState, WriteToSocket>(actions);
   processStateMutations(actions);
   EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
-  EXPECT_EQ(state_.pskType(), PskType::Rejected);
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloPskNoModes) {
+TEST_F(ServerProtocolTest, TestClientHelloCompressedCertNoMatch) {
   setUpExpectingClientHello();
-  auto chlo = TestMessages::clientHelloPsk();
-  TestMessages::removeExtension(chlo, ExtensionType::psk_key_exchange_modes);
+  auto chlo = TestMessages::clientHello();
+  CertificateCompressionAlgorithms algos;
+  algos.algorithms = {CertificateCompressionAlgorithm::brotli};
+  chlo.extensions.push_back(encodeExtension(std::move(algos)));
+  EXPECT_CALL(*certManager_, getCompressedCert(_, _))
+      .WillOnce(InvokeWithoutArgs([]() { return folly::Optional<Buf>(); }));
+  EXPECT_CALL(*cert_, _getCertMessage(_));
   auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
-  expectError(actions, AlertDescription::missing_extension, "no psk modes");
+  expectActions<MutateState, WriteToSocket>(actions);
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloPskNotSupported) {
+TEST_F(ServerProtocolTest, TestClientHelloServerCertType) {
   setUpExpectingClientHello();
+  captureEncryptedExtServerCertType();
   auto chlo = TestMessages::clientHello();
-  TestMessages::removeExtension(chlo, ExtensionType::psk_key_exchange_modes);
+  ServerCertTypeList certTypes;
+  certTypes.certificate_types = {CertificateType::RawPublicKey,
+                                 CertificateType::X509};
+  chlo.extensions.push_back(encodeExtension(std::move(certTypes)));
   auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
   expectActions<MutateState, WriteToSocket>(actions);
   processStateMutations(actions);
-  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
-  EXPECT_EQ(state_.pskType(), PskType::NotSupported);
-  EXPECT_FALSE(state_.pskMode().hasValue());
+  EXPECT_EQ(*eeServerCertType_, CertificateType::X509);
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloPskBadBinder) {
+TEST_F(ServerProtocolTest, TestClientHelloServerCertTypeRawPublicKey) {
   setUpExpectingClientHello();
-  auto chlo = TestMessages::clientHelloPsk();
-  TestMessages::removeExtension(chlo, ExtensionType::pre_shared_key);
-  ClientPresharedKey cpk;
-  PskIdentity ident;
-  ident.psk_identity = folly::IOBuf::copyBuffer("ident");
-  cpk.identities.push_back(std::move(ident));
-  PskBinder binder;
-  binder.binder = folly::IOBuf::copyBuffer("verifyxxxx");
-  cpk.binders.push_back(std::move(binder));
-  chlo.extensions.push_back(encodeExtension(std::move(cpk)));
+  captureEncryptedExtServerCertType();
+  EXPECT_CALL(*cert_, getCertificateType())
+      .WillRepeatedly(Return(CertificateType::RawPublicKey));
+  auto chlo = TestMessages::clientHello();
+  ServerCertTypeList certTypes;
+  certTypes.certificate_types = {CertificateType::RawPublicKey};
+  chlo.extensions.push_back(encodeExtension(std::move(certTypes)));
   auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
-  expectError(
-      actions, AlertDescription::bad_record_mac, "binder does not match");
-}
-
-TEST_F(ServerProtocolTest, TestClientHelloFallback) {
-  context_->setVersionFallbackEnabled(true);
-  setUpExpectingClientHello();
-  auto clientHello = TestMessages::clientHello();
-  TestMessages::removeExtension(clientHello, ExtensionType::supported_versions);
-  auto actions =
-      getActions(detail::processEvent(state_, std::move(clientHello)));
-  expectActions<MutateState, AttemptVersionFallback>(actions);
+  expectActions<MutateState, WriteToSocket>(actions);
   processStateMutations(actions);
-  EXPECT_EQ(state_.state(), StateEnum::Error);
-
-  auto fallback = expectAction<AttemptVersionFallback>(actions);
-  std::string expected(
-      "\x16\x03\x01\x00\x13"
-      "clienthelloencoding",
-      24);
-  EXPECT_EQ(fallback.clientHello->moveToFbString().toStdString(), expected);
+  EXPECT_EQ(*eeServerCertType_, CertificateType::RawPublicKey);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloNoSupportedVersions) {
+TEST_F(ServerProtocolTest, TestClientHelloServerCertTypeMismatch) {
   setUpExpectingClientHello();
-  auto clientHello = TestMessages::clientHello();
-  TestMessages::removeExtension(clientHello, ExtensionType::supported_versions);
-  auto actions =
-      getActions(detail::processEvent(state_, std::move(clientHello)));
+  auto chlo = TestMessages::clientHello();
+  ServerCertTypeList certTypes;
+  certTypes.certificate_types = {CertificateType::RawPublicKey};
+  chlo.extensions.push_back(encodeExtension(std::move(certTypes)));
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
   expectError(
       actions,
-      AlertDescription::protocol_version,
-      "supported version mismatch");
+      AlertDescription::unsupported_certificate,
+      "does not support certificate type");
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloSupportedVersionsMismatch) {
+TEST_F(ServerProtocolTest, TestClientHelloRawPublicKeyNotOffered) {
   setUpExpectingClientHello();
-  auto clientHello = TestMessages::clientHello();
-  TestMessages::removeExtension(clientHello, ExtensionType::supported_versions);
-  SupportedVersions supportedVersions;
-  supportedVersions.versions.push_back(static_cast<ProtocolVersion>(0x0200));
-  clientHello.extensions.push_back(
-      encodeExtension(std::move(supportedVersions)));
+  EXPECT_CALL(*cert_, getCertificateType())
+      .WillRepeatedly(Return(CertificateType::RawPublicKey));
   auto actions =
-      getActions(detail::processEvent(state_, std::move(clientHello)));
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
   expectError(
       actions,
-      AlertDescription::protocol_version,
-      "supported version mismatch");
+      AlertDescription::unsupported_certificate,
+      "does not support raw public keys");
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloCipherMismatch) {
+TEST_F(ServerProtocolTest, TestClientHelloNoServerCertType) {
   setUpExpectingClientHello();
-  auto clientHello = TestMessages::clientHello();
-  clientHello.cipher_suites.clear();
+  captureEncryptedExtServerCertType();
   auto actions =
-      getActions(detail::processEvent(state_, std::move(clientHello)));
-  expectError(actions, AlertDescription::handshake_failure, "no cipher match");
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  EXPECT_FALSE(eeServerCertType_.hasValue());
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloNoSupportedGroups) {
+TEST_F(ServerProtocolTest, TestClientHelloStapledCert) {
   setUpExpectingClientHello();
-  auto clientHello = TestMessages::clientHello();
-  TestMessages::removeExtension(clientHello, ExtensionType::supported_groups);
-  auto actions =
-      getActions(detail::processEvent(state_, std::move(clientHello)));
-  expectError(actions, AlertDescription::missing_extension, "no named groups");
+  auto chlo = TestMessages::clientHello();
+  CertificateStatusRequest statusRequest;
+  statusRequest.status_type = CertificateStatusType::ocsp;
+  chlo.extensions.push_back(encodeExtension(std::move(statusRequest)));
+  chlo.extensions.push_back(encodeExtension(SignedCertificateTimestamps()));
+  CertificateCompressionAlgorithms algos;
+  algos.algorithms = {CertificateCompressionAlgorithm::zstd};
+  chlo.extensions.push_back(encodeExtension(std::move(algos)));
+  EXPECT_CALL(
+      *cert_,
+      getStapledCertMessage(
+          ElementsAre(
+              ExtensionType::status_request,
+              ExtensionType::signed_certificate_timestamp)))
+      .WillOnce(InvokeWithoutArgs(
+          []() { return IOBuf::copyBuffer("stapledcert"); }));
+  EXPECT_CALL(*certManager_, getCompressedCert(_, _)).Times(0);
+  EXPECT_CALL(*cert_, _getCertMessage(_)).Times(0);
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloNamedGroupsMismatch) {
+TEST_F(ServerProtocolTest, TestClientHelloStapledCertNoStaple) {
   setUpExpectingClientHello();
-  auto clientHello = TestMessages::clientHello();
-  TestMessages::removeExtension(clientHello, ExtensionType::supported_groups);
-  SupportedGroups sg;
-  sg.named_group_list.push_back(static_cast<NamedGroup>(0x0707));
-  clientHello.extensions.push_back(encodeExtension(std::move(sg)));
-  auto actions =
-      getActions(detail::processEvent(state_, std::move(clientHello)));
-  expectError(actions, AlertDescription::handshake_failure, "no group match");
+  auto chlo = TestMessages::clientHello();
+  CertificateStatusRequest statusRequest;
+  statusRequest.status_type = CertificateStatusType::ocsp;
+  chlo.extensions.push_back(encodeExtension(std::move(statusRequest)));
+  EXPECT_CALL(
+      *cert_,
+      getStapledCertMessage(ElementsAre(ExtensionType::status_request)))
+      .WillOnce(InvokeWithoutArgs([]() { return Buf(); }));
+  EXPECT_CALL(*cert_, _getCertMessage(_));
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  expectActions<MutateState, WriteToSocket>(actions);
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloNoClientKeyShare) {
+TEST_F(ServerProtocolTest, TestClientHelloDelegatedCredential) {
   setUpExpectingClientHello();
-  auto clientHello = TestMessages::clientHello();
-  TestMessages::removeExtension(clientHello, ExtensionType::key_share);
-  auto actions =
-      getActions(detail::processEvent(state_, std::move(clientHello)));
-  expectError(actions, AlertDescription::missing_extension, "no client share");
+  auto chlo = TestMessages::clientHello();
+  DelegatedCredentialSupport credentialSupport;
+  credentialSupport.supported_signature_algorithms = {
+      SignatureScheme::ecdsa_secp384r1_sha384};
+  chlo.extensions.push_back(encodeExtension(std::move(credentialSupport)));
+  auto delegated = std::make_shared<MockSelfCert>();
+  EXPECT_CALL(*delegated, getSigSchemes())
+      .WillRepeatedly(InvokeWithoutArgs([]() {
+        return std::vector<SignatureScheme>{
+            SignatureScheme::ecdsa_secp384r1_sha384};
+      }));
+  EXPECT_CALL(
+      *cert_,
+      getDelegatedCert(
+          ElementsAre(SignatureScheme::ecdsa_secp384r1_sha384),
+          ElementsAre(
+              SignatureScheme::ecdsa_secp256r1_sha256,
+              SignatureScheme::rsa_pss_sha256)))
+      .WillOnce(Return(delegated));
+  EXPECT_CALL(*delegated, _getCertMessage(_));
+  EXPECT_CALL(*cert_, _getCertMessage(_)).Times(0);
+  EXPECT_CALL(*delegated, sign(SignatureScheme::ecdsa_secp384r1_sha384, _, _))
+      .WillOnce(
+          InvokeWithoutArgs([]() { return IOBuf::copyBuffer("signature"); }));
+  EXPECT_CALL(*cert_, sign(_, _, _)).Times(0);
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+  EXPECT_EQ(state_.serverCert(), delegated);
+  EXPECT_EQ(state_.sigScheme(), SignatureScheme::ecdsa_secp384r1_sha384);
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloNoSigScemes) {
+TEST_F(ServerProtocolTest, TestClientHelloHandshakeScheduler) {
   setUpExpectingClientHello();
-  auto clientHello = TestMessages::clientHello();
-  TestMessages::removeExtension(
-      clientHello, ExtensionType::signature_algorithms);
-  auto actions =
-      getActions(detail::processEvent(state_, std::move(clientHello)));
-  expectError(actions, AlertDescription::missing_extension, "no sig schemes");
+  auto signExecutor = std::make_shared<ManualExecutor>();
+  auto handshakeScheduler =
+      std::make_shared<HandshakeScheduler>(signExecutor, 1, 1);
+  context_->setHandshakeScheduler(handshakeScheduler);
+  auto asyncActions =
+      detail::processEvent(state_, TestMessages::clientHello());
+  while (executor_.run())
+    ;
+  EXPECT_FALSE(boost::get<Future<Actions>>(asyncActions).isReady());
+  EXPECT_EQ(handshakeScheduler->getRunning(), 1);
+
+  EXPECT_CALL(
+      *cert_,
+      sign(
+          SignatureScheme::ecdsa_secp256r1_sha256,
+          CertificateVerifyContext::Server,
+          _))
+      .WillOnce(
+          InvokeWithoutArgs([]() { return IOBuf::copyBuffer("signature"); }));
+  signExecutor->drain();
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+  EXPECT_EQ(handshakeScheduler->getRunning(), 0);
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloDataAfter) {
+TEST_F(ServerProtocolTest, TestClientHelloHandshakeSchedulerFull) {
   setUpExpectingClientHello();
-  EXPECT_CALL(*mockRead_, hasUnparsedHandshakeData())
-      .WillRepeatedly(Return(true));
-  auto actions =
-      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  auto signExecutor = std::make_shared<ManualExecutor>();
+  auto handshakeScheduler =
+      std::make_shared<HandshakeScheduler>(signExecutor, 1, 0);
+  context_->setHandshakeScheduler(handshakeScheduler);
+  auto running = handshakeScheduler->schedule(
+      HandshakeScheduler::Priority::Normal,
+      []() { return folly::Optional<Buf>(IOBuf::copyBuffer("signature")); });
+  auto actions = getActions(
+      detail::processEvent(state_, TestMessages::clientHello()), false);
   expectError(
-      actions, AlertDescription::unexpected_message, "data after client hello");
+      actions, AlertDescription::internal_error, "handshake queue full");
 }
 
-TEST_F(ServerProtocolTest, TestClientHelloNoAlpn) {
+TEST_F(ServerProtocolTest, TestClientHelloHandshakeSchedulerCancelled) {
   setUpExpectingClientHello();
-  auto chlo = TestMessages::clientHello();
+  auto signExecutor = std::make_shared<ManualExecutor>();
+  auto handshakeScheduler =
+      std::make_shared<HandshakeScheduler>(signExecutor, 1, 1);
+  context_->setHandshakeScheduler(handshakeScheduler);
+  auto running = handshakeScheduler->schedule(
+      HandshakeScheduler::Priority::Normal,
+      []() { return folly::Optional<Buf>(IOBuf::copyBuffer("signature")); });
+  auto asyncActions =
+      detail::processEvent(state_, TestMessages::clientHello());
+  while (executor_.run())
+    ;
+  EXPECT_EQ(handshakeScheduler->getQueued(), 1);
+
+  // The connection gives up on the handshake while signing is queued.
+  boost::get<Future<Actions>>(asyncActions).cancel();
+  EXPECT_CALL(*cert_, sign(_, _, _)).Times(0);
+  signExecutor->drain();
+  EXPECT_EQ(handshakeScheduler->getQueued(), 0);
+  EXPECT_EQ(handshakeScheduler->getRunning(), 0);
+  auto actions = getActions(std::move(asyncActions));
+  expectError(actions, AlertDescription::unexpected_message);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloDelegatedCredentialNotOffered) {
+  setUpExpectingClientHello();
+  EXPECT_CALL(*cert_, getDelegatedCert(_, _)).Times(0);
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.serverCert(), cert_);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloCertPrefetch) {
+  setUpExpectingClientHello();
+  Promise<Unit> prefetch;
+  EXPECT_CALL(*certManager_, prefetchCert(_))
+      .WillOnce(Invoke([&prefetch](const Optional<std::string>& sni) {
+        EXPECT_EQ(*sni, "www.hostname.com");
+        return prefetch.getFuture();
+      }));
+  auto asyncActions =
+      detail::processEvent(state_, TestMessages::clientHello());
+  while (executor_.run())
+    ;
+  EXPECT_FALSE(boost::get<Future<Actions>>(asyncActions).isReady());
+
+  prefetch.setValue();
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloKexDuringTicketDecrypt) {
+  context_->setSupportedPskModes({PskKeyExchangeMode::psk_dhe_ke});
+  setUpExpectingClientHello();
+  Promise<std::pair<PskType, Optional<ResumptionState>>> ticket;
+  EXPECT_CALL(*mockTicketCipher_, _decrypt(_))
+      .WillOnce(InvokeWithoutArgs([&ticket]() { return ticket.getFuture(); }));
+  bool kexStarted = false;
+  EXPECT_CALL(
+      *factory_,
+      makeKeyExchange(NamedGroup::x25519, Factory::KeyExchangeMode::Server))
+      .WillOnce(InvokeWithoutArgs([&kexStarted]() {
+        kexStarted = true;
+        auto ret = std::make_unique<MockKeyExchange>();
+        EXPECT_CALL(*ret, generateKeyPair());
+        EXPECT_CALL(*ret, generateSharedSecret(RangeMatches("keyshare")))
+            .WillOnce(InvokeWithoutArgs(
+                []() { return IOBuf::copyBuffer("sharedsecret"); }));
+        EXPECT_CALL(*ret, getKeyShare()).WillOnce(InvokeWithoutArgs([]() {
+          return IOBuf::copyBuffer("servershare");
+        }));
+        return ret;
+      }));
+  auto asyncActions =
+      detail::processEvent(state_, TestMessages::clientHelloPsk());
+  while (executor_.run())
+    ;
+  EXPECT_TRUE(kexStarted);
+  EXPECT_FALSE(boost::get<Future<Actions>>(asyncActions).isReady());
+
+  ResumptionState res;
+  res.version = TestProtocolVersion;
+  res.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+  res.resumptionSecret = IOBuf::copyBuffer("resumesecret");
+  res.alpn = "h2";
+  res.ticketAgeAdd = 0;
+  res.ticketIssueTime =
+      std::chrono::system_clock::now() - std::chrono::seconds(100);
+  ticket.setValue(std::make_pair(PskType::Resumption, std::move(res)));
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+  EXPECT_EQ(state_.pskType(), PskType::Resumption);
+  EXPECT_EQ(state_.keyExchangeType(), KeyExchangeType::OneRtt);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloFirstEncryptedRecordLimit) {
+  setUpExpectingClientHello();
+  context_->setFirstEncryptedRecordLimit(10);
+  size_t encryptedWrites = 0;
+  EXPECT_CALL(*factory_, makeEncryptedWriteRecordLayer(_))
+      .WillRepeatedly(InvokeWithoutArgs([&encryptedWrites]() {
+        auto ret = std::make_unique<MockEncryptedWriteRecordLayer>();
+        ret->setDefaults();
+        ON_CALL(*ret, _write(_))
+            .WillByDefault(Invoke([&encryptedWrites](TLSMessage& msg) {
+              encryptedWrites++;
+              return std::move(msg.fragment);
+            }));
+        return ret;
+      }));
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  EXPECT_EQ(encryptedWrites, 2);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloNoFirstEncryptedRecordLimit) {
+  setUpExpectingClientHello();
+  context_->setFirstEncryptedRecordLimit(0);
+  size_t encryptedWrites = 0;
+  EXPECT_CALL(*factory_, makeEncryptedWriteRecordLayer(_))
+      .WillRepeatedly(InvokeWithoutArgs([&encryptedWrites]() {
+        auto ret = std::make_unique<MockEncryptedWriteRecordLayer>();
+        ret->setDefaults();
+        ON_CALL(*ret, _write(_))
+            .WillByDefault(Invoke([&encryptedWrites](TLSMessage& msg) {
+              encryptedWrites++;
+              return std::move(msg.fragment);
+            }));
+        return ret;
+      }));
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  EXPECT_EQ(encryptedWrites, 1);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloPskKeResumptionPolicy) {
+  setUpExpectingClientHello();
+  context_->setPskKeResumptionPolicy(
+      [](const ResumptionState& res) { return res.alpn == "h2"; },
+      std::chrono::hours(1));
+  EXPECT_CALL(*factory_, makeKeyExchange(_, _)).Times(0);
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHelloPsk()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+  EXPECT_EQ(state_.pskType(), PskType::Resumption);
+  EXPECT_EQ(state_.pskMode(), PskKeyExchangeMode::psk_ke);
+  EXPECT_EQ(state_.keyExchangeType(), KeyExchangeType::None);
+  EXPECT_FALSE(state_.group().hasValue());
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloPskKeResumptionPolicyRejected) {
+  setUpExpectingClientHello();
+  context_->setPskKeResumptionPolicy(
+      [](const ResumptionState&) { return false; }, std::chrono::hours(1));
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHelloPsk()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.pskType(), PskType::Resumption);
+  EXPECT_EQ(state_.pskMode(), PskKeyExchangeMode::psk_dhe_ke);
+  EXPECT_EQ(state_.keyExchangeType(), KeyExchangeType::OneRtt);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloPskKeResumptionPolicyTicketTooOld) {
+  setUpExpectingClientHello();
+  context_->setPskKeResumptionPolicy(
+      [](const ResumptionState&) { return true; }, std::chrono::seconds(10));
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHelloPsk()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.pskType(), PskType::Resumption);
+  EXPECT_EQ(state_.pskMode(), PskKeyExchangeMode::psk_dhe_ke);
+  EXPECT_EQ(state_.keyExchangeType(), KeyExchangeType::OneRtt);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloPskKeResumptionPolicyNotOffered) {
+  setUpExpectingClientHello();
+  context_->setPskKeResumptionPolicy(
+      [](const ResumptionState&) { return true; }, std::chrono::hours(1));
+  auto chlo = TestMessages::clientHello();
+  TestMessages::removeExtension(chlo, ExtensionType::psk_key_exchange_modes);
+  PskKeyExchangeModes modes;
+  modes.modes.push_back(PskKeyExchangeMode::psk_dhe_ke);
+  chlo.extensions.push_back(encodeExtension(std::move(modes)));
+  TestMessages::addPsk(chlo);
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.pskType(), PskType::Resumption);
+  EXPECT_EQ(state_.pskMode(), PskKeyExchangeMode::psk_dhe_ke);
+  EXPECT_EQ(state_.keyExchangeType(), KeyExchangeType::OneRtt);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloNoSni) {
+  setUpExpectingClientHello();
+  auto chlo = TestMessages::clientHello();
+  TestMessages::removeExtension(chlo, ExtensionType::server_name);
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  expectActions<MutateState, WriteToSocket>(actions);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloFullHandshakeRejectedPsk) {
+  setUpExpectingClientHello();
+  EXPECT_CALL(*mockTicketCipher_, _decrypt(_)).WillOnce(InvokeWithoutArgs([]() {
+    return std::make_pair(PskType::Rejected, none);
+  }));
+
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHelloPsk()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+  EXPECT_EQ(state_.pskType(), PskType::Rejected);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloPskNoModes) {
+  setUpExpectingClientHello();
+  auto chlo = TestMessages::clientHelloPsk();
+  TestMessages::removeExtension(chlo, ExtensionType::psk_key_exchange_modes);
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  expectError(actions, AlertDescription::missing_extension, "no psk modes");
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloPskNotSupported) {
+  setUpExpectingClientHello();
+  auto chlo = TestMessages::clientHello();
+  TestMessages::removeExtension(chlo, ExtensionType::psk_key_exchange_modes);
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+  EXPECT_EQ(state_.pskType(), PskType::NotSupported);
+  EXPECT_FALSE(state_.pskMode().hasValue());
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloPskBadBinder) {
+  setUpExpectingClientHello();
+  auto chlo = TestMessages::clientHelloPsk();
+  TestMessages::removeExtension(chlo, ExtensionType::pre_shared_key);
+  ClientPresharedKey cpk;
+  PskIdentity ident;
+  ident.psk_identity = folly::IOBuf::copyBuffer("ident");
+  cpk.identities.push_back(std::move(ident));
+  PskBinder binder;
+  binder.binder = folly::IOBuf::copyBuffer("verifyxxxx");
+  cpk.binders.push_back(std::move(binder));
+  chlo.extensions.push_back(encodeExtension(std::move(cpk)));
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  expectError(
+      actions, AlertDescription::bad_record_mac, "binder does not match");
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloPskChainedBinder) {
+  setUpExpectingClientHello();
+  EXPECT_CALL(*mockTicketCipher_, _decrypt(_))
+      .WillOnce(InvokeWithoutArgs([=]() {
+        ResumptionState res;
+        res.version = TestProtocolVersion;
+        res.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+        res.resumptionSecret = folly::IOBuf::copyBuffer("resumesecret");
+        res.serverCert = cert_;
+        return std::make_pair(PskType::Resumption, std::move(res));
+      }));
+  Sequence contextSeq;
+  mockKeyScheduler_ = new MockKeyScheduler();
+  mockHandshakeContext_ = new MockHandshakeContext();
+  EXPECT_CALL(*factory_, makeKeyScheduler(CipherSuite::TLS_AES_128_GCM_SHA256))
+      .WillOnce(InvokeWithoutArgs(
+          [=]() { return std::unique_ptr<KeyScheduler>(mockKeyScheduler_); }));
+  EXPECT_CALL(
+      *factory_, makeHandshakeContext(CipherSuite::TLS_AES_128_GCM_SHA256))
+      .WillOnce(InvokeWithoutArgs([=]() {
+        return std::unique_ptr<HandshakeContext>(mockHandshakeContext_);
+      }));
+  EXPECT_CALL(
+      *mockKeyScheduler_,
+      getSecret(EarlySecrets::ResumptionPskBinder, RangeMatches("")))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return std::vector<uint8_t>({'b', 'd', 'r'});
+      }));
+  // The ClientHello is hashed a buffer at a time rather than coalesced.
+  EXPECT_CALL(*mockHandshakeContext_, appendToTranscript(BufMatches("cli")))
+      .InSequence(contextSeq);
+  EXPECT_CALL(*mockHandshakeContext_, appendToTranscript(BufMatches("ent")))
+      .InSequence(contextSeq);
+  EXPECT_CALL(*mockHandshakeContext_, getFinishedData(RangeMatches("bdr")))
+      .InSequence(contextSeq)
+      .WillOnce(
+          InvokeWithoutArgs([]() { return IOBuf::copyBuffer("verifydata"); }));
+
+  auto chlo = TestMessages::clientHelloPsk();
+  chlo.originalEncoding = IOBuf::copyBuffer("cli");
+  (*chlo.originalEncoding)->prependChain(IOBuf::copyBuffer("enthello"));
+  (*chlo.originalEncoding)->prependChain(IOBuf::copyBuffer("encoding"));
+  TestMessages::removeExtension(chlo, ExtensionType::pre_shared_key);
+  ClientPresharedKey cpk;
+  PskIdentity ident;
+  ident.psk_identity = folly::IOBuf::copyBuffer("ident");
+  cpk.identities.push_back(std::move(ident));
+  PskBinder binder;
+  binder.binder = folly::IOBuf::copyBuffer("verifyxxxx");
+  cpk.binders.push_back(std::move(binder));
+  auto ext = encodeExtension(std::move(cpk));
+  // Split the extension so that the binder straddles two buffers.
+  auto extData = ext.extension_data->coalesce();
+  ext.extension_data =
+      IOBuf::copyBuffer(extData.subpiece(0, extData.size() - 4));
+  ext.extension_data->prependChain(
+      IOBuf::copyBuffer(extData.subpiece(extData.size() - 4)));
+  chlo.extensions.push_back(std::move(ext));
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  expectError(
+      actions, AlertDescription::bad_record_mac, "binder does not match");
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloFallback) {
+  context_->setVersionFallbackEnabled(true);
+  setUpExpectingClientHello();
+  auto clientHello = TestMessages::clientHello();
+  TestMessages::removeExtension(clientHello, ExtensionType::supported_versions);
+  auto actions =
+      getActions(detail::processEvent(state_, std::move(clientHello)));
+  expectActions<MutateState, AttemptVersionFallback>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::Error);
+
+  auto fallback = expectAction<AttemptVersionFallback>(actions);
+  std::string expected(
+      "\x16\x03\x01\x00\x13"
+      "clienthelloencoding",
+      24);
+  EXPECT_EQ(fallback.clientHello->moveToFbString().toStdString(), expected);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloRoute) {
+  setUpExpectingClientHello();
+  context_->setClientHelloRouter([](const ClientHello& chlo) {
+    auto sni = getExtension<ServerNameList>(chlo.extensions);
+    EXPECT_TRUE(sni.hasValue());
+    return true;
+  });
+  EXPECT_CALL(*factory_, makeKeyExchange(_, _)).Times(0);
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectActions<MutateState, RouteClientHello>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::Error);
+
+  auto route = expectAction<RouteClientHello>(actions);
+  std::string expected(
+      "\x16\x03\x01\x00\x13"
+      "clienthelloencoding",
+      24);
+  EXPECT_EQ(route.clientHello->moveToFbString().toStdString(), expected);
+  EXPECT_EQ(
+      route.chlo.cipher_suites, TestMessages::clientHello().cipher_suites);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloNotRouted) {
+  setUpExpectingClientHello();
+  context_->setClientHelloRouter([](const ClientHello&) { return false; });
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloNotRoutedAfterHrr) {
+  setUpExpectingClientHelloRetry();
+  context_->setClientHelloRouter([](const ClientHello&) {
+    ADD_FAILURE();
+    return true;
+  });
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectActions<MutateState, WriteToSocket>(actions);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloNoSupportedVersions) {
+  setUpExpectingClientHello();
+  auto clientHello = TestMessages::clientHello();
+  TestMessages::removeExtension(clientHello, ExtensionType::supported_versions);
+  auto actions =
+      getActions(detail::processEvent(state_, std::move(clientHello)));
+  expectError(
+      actions,
+      AlertDescription::protocol_version,
+      "supported version mismatch");
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloSupportedVersionsMismatch) {
+  setUpExpectingClientHello();
+  auto clientHello = TestMessages::clientHello();
+  TestMessages::removeExtension(clientHello, ExtensionType::supported_versions);
+  SupportedVersions supportedVersions;
+  supportedVersions.versions.push_back(static_cast<ProtocolVersion>(0x0200));
+  clientHello.extensions.push_back(
+      encodeExtension(std::move(supportedVersions)));
+  auto actions =
+      getActions(detail::processEvent(state_, std::move(clientHello)));
+  expectError(
+      actions,
+      AlertDescription::protocol_version,
+      "supported version mismatch");
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloCipherMismatch) {
+  setUpExpectingClientHello();
+  auto clientHello = TestMessages::clientHello();
+  clientHello.cipher_suites.clear();
+  auto actions =
+      getActions(detail::processEvent(state_, std::move(clientHello)));
+  expectError(actions, AlertDescription::handshake_failure, "no cipher match");
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloNoSupportedGroups) {
+  setUpExpectingClientHello();
+  auto clientHello = TestMessages::clientHello();
+  TestMessages::removeExtension(clientHello, ExtensionType::supported_groups);
+  auto actions =
+      getActions(detail::processEvent(state_, std::move(clientHello)));
+  expectError(actions, AlertDescription::missing_extension, "no named groups");
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloNamedGroupsMismatch) {
+  setUpExpectingClientHello();
+  auto clientHello = TestMessages::clientHello();
+  TestMessages::removeExtension(clientHello, ExtensionType::supported_groups);
+  SupportedGroups sg;
+  sg.named_group_list.push_back(static_cast<NamedGroup>(0x0707));
+  clientHello.extensions.push_back(encodeExtension(std::move(sg)));
+  auto actions =
+      getActions(detail::processEvent(state_, std::move(clientHello)));
+  expectError(actions, AlertDescription::handshake_failure, "no group match");
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloNoClientKeyShare) {
+  setUpExpectingClientHello();
+  auto clientHello = TestMessages::clientHello();
+  TestMessages::removeExtension(clientHello, ExtensionType::key_share);
+  auto actions =
+      getActions(detail::processEvent(state_, std::move(clientHello)));
+  expectError(actions, AlertDescription::missing_extension, "no client share");
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloNoSigScemes) {
+  setUpExpectingClientHello();
+  auto clientHello = TestMessages::clientHello();
+  TestMessages::removeExtension(
+      clientHello, ExtensionType::signature_algorithms);
+  auto actions =
+      getActions(detail::processEvent(state_, std::move(clientHello)));
+  expectError(actions, AlertDescription::missing_extension, "no sig schemes");
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloDataAfter) {
+  setUpExpectingClientHello();
+  EXPECT_CALL(*mockRead_, hasUnparsedHandshakeData())
+      .WillRepeatedly(Return(true));
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectError(
+      actions, AlertDescription::unexpected_message, "data after client hello");
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloNoAlpn) {
+  setUpExpectingClientHello();
+  auto chlo = TestMessages::clientHello();
   TestMessages::removeExtension(
       chlo, ExtensionType::application_layer_protocol_negotiation);
   auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
@@ -2338,8 +3142,8 @@ TEST_F(ServerProtocolTest, TestClientHelloRejectEarlyData) {
   setUpExpectingClientHello();
 
   auto rrl = new MockEncryptedReadRecordLayer();
-  EXPECT_CALL(*factory_, makeEncryptedReadRecordLayer())
-      .WillOnce(Invoke(
+  EXPECT_CALL(*factory_, makeEncryptedReadRecordLayer(_))
+      .WillOnce(InvokeWithoutArgs(
           [rrl]() { return std::unique_ptr<EncryptedReadRecordLayer>(rrl); }));
   EXPECT_CALL(*rrl, setSkipFailedDecryption(true));
 
@@ -2430,6 +3234,72 @@ TEST_F(ServerProtocolTest, TestClientHelloRejectEarlyDataReplayCache) {
   EXPECT_EQ(state_.replayCacheResult(), ReplayCacheResult::DefinitelyReplay);
 }
 
+TEST_F(ServerProtocolTest, TestClientHelloSingleUseTicket) {
+  acceptEarlyData();
+  auto singleUseTickets = std::make_shared<SingleUseTicketReplayCache>(
+      std::chrono::seconds(60), std::chrono::seconds(600));
+  context_->setSingleUseTickets(singleUseTickets);
+  setUpExpectingClientHello();
+
+  auto ticketId = singleUseTickets->issueTicketId();
+  EXPECT_CALL(*mockTicketCipher_, _decrypt(_))
+      .WillOnce(InvokeWithoutArgs([ticketId]() {
+        ResumptionState res;
+        res.version = ProtocolVersion::tls_1_3;
+        res.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+        res.resumptionSecret = folly::IOBuf::copyBuffer("resumesecret");
+        res.alpn = "h2";
+        res.ticketAgeAdd = 0;
+        res.ticketIssueTime =
+            std::chrono::system_clock::now() - std::chrono::seconds(100);
+        res.ticketId = ticketId;
+        return std::make_pair(PskType::Resumption, std::move(res));
+      }));
+
+  auto actions = getActions(
+      detail::processEvent(state_, TestMessages::clientHelloPskEarly()));
+  expectActions<MutateState, WriteToSocket, ReportEarlyHandshakeSuccess>(
+      actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.earlyDataType(), EarlyDataType::Accepted);
+  EXPECT_EQ(
+      singleUseTickets->consume(ticketId),
+      ReplayCacheResult::DefinitelyReplay);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloRejectEarlyDataSingleUseTicket) {
+  acceptEarlyData();
+  auto singleUseTickets = std::make_shared<SingleUseTicketReplayCache>(
+      std::chrono::seconds(60), std::chrono::seconds(600));
+  context_->setSingleUseTickets(singleUseTickets);
+  setUpExpectingClientHello();
+
+  auto ticketId = singleUseTickets->issueTicketId();
+  EXPECT_EQ(singleUseTickets->consume(ticketId), ReplayCacheResult::NotReplay);
+  EXPECT_CALL(*mockTicketCipher_, _decrypt(_))
+      .WillOnce(InvokeWithoutArgs([ticketId]() {
+        ResumptionState res;
+        res.version = ProtocolVersion::tls_1_3;
+        res.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+        res.resumptionSecret = folly::IOBuf::copyBuffer("resumesecret");
+        res.alpn = "h2";
+        res.ticketAgeAdd = 0;
+        res.ticketIssueTime =
+            std::chrono::system_clock::now() - std::chrono::seconds(100);
+        res.ticketId = ticketId;
+        return std::make_pair(PskType::Resumption, std::move(res));
+      }));
+
+  auto actions = getActions(
+      detail::processEvent(state_, TestMessages::clientHelloPskEarly()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+  EXPECT_EQ(state_.pskType(), PskType::Resumption);
+  EXPECT_EQ(state_.earlyDataType(), EarlyDataType::Rejected);
+  EXPECT_EQ(state_.replayCacheResult(), ReplayCacheResult::DefinitelyReplay);
+}
+
 TEST_F(ServerProtocolTest, TestClientHelloRejectEarlyDataNoAlpn) {
   acceptEarlyData();
   setUpExpectingClientHello();
@@ -2652,6 +3522,37 @@ TEST_F(ServerProtocolTest, TestClientHelloHandshakeLogging) {
                                     SignatureScheme::rsa_pss_sha256}));
   EXPECT_EQ(*state_.handshakeLogging()->clientSessionIdSent, false);
   EXPECT_TRUE(state_.handshakeLogging()->clientRandom.hasValue());
+  EXPECT_FALSE(state_.handshakeLogging()->clientFingerprint.hasValue());
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloHandshakeLoggingFingerprint) {
+  setUpExpectingClientHello();
+  context_->setHandshakeLoggingMode(HandshakeLoggingMode::Fingerprint);
+  state_.handshakeLogging() = std::make_unique<HandshakeLogging>();
+  auto chlo = TestMessages::clientHello();
+  chlo.originalEncoding = encodeHandshake(TestMessages::clientHello());
+  auto expected = getClientHelloFingerprint(**chlo.originalEncoding);
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  processStateMutations(actions);
+  EXPECT_TRUE(expected.hasValue());
+  EXPECT_EQ(state_.handshakeLogging()->clientFingerprint, expected);
+  EXPECT_FALSE(state_.handshakeLogging()->clientLegacyVersion.hasValue());
+  EXPECT_TRUE(state_.handshakeLogging()->clientCiphers.empty());
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloCapture) {
+  setUpExpectingClientHello();
+  auto capture =
+      std::make_shared<SampledClientHelloCapture>(nullptr, 10, false);
+  context_->setClientHelloCapture(capture);
+  auto chlo = TestMessages::clientHello();
+  chlo.originalEncoding = encodeHandshake(TestMessages::clientHello());
+  auto expected = (*chlo.originalEncoding)->clone();
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  processStateMutations(actions);
+  auto captured = capture->drain();
+  ASSERT_EQ(captured.size(), 1);
+  EXPECT_TRUE(IOBufEqualTo()(captured[0], expected));
 }
 
 TEST_F(ServerProtocolTest, TestClientHelloHandshakeLoggingError) {
@@ -2748,6 +3649,58 @@ TEST_F(ServerProtocolTest, TestRetryClientHelloDifferentVersion) {
       "version mismatch with previous negotiation");
 }
 
+TEST_F(ServerProtocolTest, TestRetryClientHelloDifferentGroup) {
+  setUpExpectingClientHelloRetry();
+  state_.group() = NamedGroup::secp256r1;
+  // The client's x25519 share must not be used before the group is checked.
+  EXPECT_CALL(*factory_, makeKeyExchange(_, _)).Times(0);
+  auto actions = getActions(
+      detail::processEvent(state_, TestMessages::clientHello()));
+  expectError(
+      actions,
+      AlertDescription::illegal_parameter,
+      "group mismatch with previous negotiation");
+}
+
+TEST_F(ServerProtocolTest, TestRetryClientHelloChanged) {
+  setUpExpectingClientHelloRetry();
+  setHelloRetryState(TestMessages::clientHello());
+  auto clientHello = TestMessages::clientHello();
+  TestMessages::removeExtension(
+      clientHello, ExtensionType::application_layer_protocol_negotiation);
+  auto actions =
+      getActions(detail::processEvent(state_, std::move(clientHello)));
+  expectError(
+      actions,
+      AlertDescription::illegal_parameter,
+      "client hello changed after hello retry request");
+}
+
+TEST_F(ServerProtocolTest, TestRetryClientHelloReusesPsk) {
+  context_->setSupportedPskModes({PskKeyExchangeMode::psk_dhe_ke});
+  setUpExpectingClientHelloRetry();
+  setHelloRetryState(TestMessages::clientHelloPsk());
+  auto& retry = *state_.helloRetryState();
+  retry.pskIdentity = IOBuf::copyBuffer("ident");
+  retry.pskType = PskType::Resumption;
+  retry.pskMode = PskKeyExchangeMode::psk_dhe_ke;
+  ResumptionState res;
+  res.version = TestProtocolVersion;
+  res.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+  res.resumptionSecret = IOBuf::copyBuffer("resumesecret");
+  res.serverCert = cert_;
+  retry.resState = std::move(res);
+  retry.alpn = "h2";
+  EXPECT_CALL(*mockTicketCipher_, _decrypt(_)).Times(0);
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHelloPsk()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.pskType(), PskType::Resumption);
+  EXPECT_EQ(state_.pskMode(), PskKeyExchangeMode::psk_dhe_ke);
+  EXPECT_EQ(*state_.alpn(), "h2");
+}
+
 TEST_F(ServerProtocolTest, TestClientHelloRenegotiatePskCipher) {
   setUpExpectingClientHello();
 
@@ -2814,6 +3767,144 @@ TEST_F(ServerProtocolTest, TestClientHelloCookie) {
   EXPECT_EQ(state_.cipher(), CipherSuite::TLS_AES_128_GCM_SHA256);
 }
 
+TEST_F(ServerProtocolTest, TestClientHelloStatelessRetry) {
+  setUpExpectingClientHello();
+  acceptCookies();
+  auto admission = std::make_shared<HandshakeAdmissionController>(0);
+  auto pending = admission->startHandshake();
+  context_->setHandshakeAdmissionController(admission);
+
+  auto handshakeContext = new MockHandshakeContext();
+  EXPECT_CALL(
+      *factory_, makeHandshakeContext(CipherSuite::TLS_AES_128_GCM_SHA256))
+      .WillOnce(InvokeWithoutArgs([=]() {
+        return std::unique_ptr<HandshakeContext>(handshakeContext);
+      }));
+  EXPECT_CALL(
+      *handshakeContext, appendToTranscript(BufMatches("clienthelloencoding")));
+  EXPECT_CALL(*handshakeContext, getHandshakeContext())
+      .WillOnce(Invoke([]() { return IOBuf::copyBuffer("chlo_hash"); }));
+  EXPECT_CALL(*mockCookieCipher_, _encrypt(_))
+      .WillOnce(Invoke([](const CookieState& cs) {
+        EXPECT_EQ(cs.version, TestProtocolVersion);
+        EXPECT_EQ(cs.cipher, CipherSuite::TLS_AES_128_GCM_SHA256);
+        EXPECT_FALSE(cs.group.hasValue());
+        EXPECT_TRUE(
+            IOBufEqualTo()(cs.chloHash, IOBuf::copyBuffer("chlo_hash")));
+        return folly::Optional<Buf>(IOBuf::copyBuffer("cookie"));
+      }));
+  EXPECT_CALL(*mockWrite_, _write(_)).WillOnce(Invoke([](TLSMessage& msg) {
+    EXPECT_EQ(msg.type, ContentType::handshake);
+    EXPECT_TRUE(IOBufEqualTo()(
+        msg.fragment,
+        getStatelessHelloRetryRequest(
+            TestProtocolVersion,
+            CipherSuite::TLS_AES_128_GCM_SHA256,
+            none,
+            IOBuf::copyBuffer("cookie"))));
+    return IOBuf::copyBuffer("writtenhrr");
+  }));
+  auto newRrl = new MockPlaintextReadRecordLayer();
+  EXPECT_CALL(*factory_, makePlaintextReadRecordLayer())
+      .WillOnce(Invoke([newRrl]() {
+        return std::unique_ptr<PlaintextReadRecordLayer>(newRrl);
+      }));
+  EXPECT_CALL(*newRrl, setSkipEncryptedRecords(false));
+  EXPECT_CALL(*factory_, makeKeyExchange(_, _)).Times(0);
+
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  auto write = expectAction<WriteToSocket>(actions);
+  EXPECT_TRUE(IOBufEqualTo()(write.data, IOBuf::copyBuffer("writtenhrr")));
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingClientHello);
+  EXPECT_EQ(state_.readRecordLayer().get(), newRrl);
+  EXPECT_FALSE(state_.version().hasValue());
+  EXPECT_FALSE(state_.keyExchangeType().hasValue());
+  EXPECT_EQ(state_.handshakeContext(), nullptr);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloStatelessRetryNotRequired) {
+  setUpExpectingClientHello();
+  acceptCookies();
+  context_->setHandshakeAdmissionController(
+      std::make_shared<HandshakeAdmissionController>(1));
+  EXPECT_CALL(*mockCookieCipher_, _encrypt(_)).Times(0);
+
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::clientHello()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloStatelessRetryCookie) {
+  expectCookie();
+  setUpExpectingClientHello();
+  auto admission = std::make_shared<HandshakeAdmissionController>(0);
+  auto pending = admission->startHandshake();
+  context_->setHandshakeAdmissionController(admission);
+  EXPECT_CALL(*mockCookieCipher_, _encrypt(_)).Times(0);
+
+  auto chlo = TestMessages::clientHello();
+  Cookie c;
+  c.cookie = IOBuf::copyBuffer("cookie");
+  chlo.extensions.push_back(encodeExtension(std::move(c)));
+
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+}
+
+TEST_F(ServerProtocolTest, TestClientHelloStatelessRetrySessionId) {
+  setUpExpectingClientHello();
+  acceptCookies();
+  auto admission = std::make_shared<HandshakeAdmissionController>(0);
+  auto pending = admission->startHandshake();
+  context_->setHandshakeAdmissionController(admission);
+
+  auto handshakeContext = new MockHandshakeContext();
+  EXPECT_CALL(
+      *factory_, makeHandshakeContext(CipherSuite::TLS_AES_128_GCM_SHA256))
+      .WillOnce(InvokeWithoutArgs([=]() {
+        return std::unique_ptr<HandshakeContext>(handshakeContext);
+      }));
+  EXPECT_CALL(*handshakeContext, appendToTranscript(_));
+  EXPECT_CALL(*handshakeContext, getHandshakeContext())
+      .WillOnce(Invoke([]() { return IOBuf::copyBuffer("chlo_hash"); }));
+  EXPECT_CALL(*mockCookieCipher_, _encrypt(_))
+      .WillOnce(Invoke([](const CookieState&) {
+        return folly::Optional<Buf>(IOBuf::copyBuffer("cookie"));
+      }));
+  EXPECT_CALL(*mockWrite_, _write(_)).WillOnce(Invoke([](TLSMessage& msg) {
+    // The legacy session id is echoed, like in a stateful retry.
+    EXPECT_TRUE(IOBufEqualTo()(
+        msg.fragment,
+        getStatelessHelloRetryRequest(
+            TestProtocolVersion,
+            CipherSuite::TLS_AES_128_GCM_SHA256,
+            none,
+            IOBuf::copyBuffer("cookie"),
+            IOBuf::copyBuffer("middlebox"))));
+    return IOBuf::copyBuffer("writtenhrr");
+  }));
+  auto newRrl = new MockPlaintextReadRecordLayer();
+  EXPECT_CALL(*factory_, makePlaintextReadRecordLayer())
+      .WillOnce(Invoke([newRrl]() {
+        return std::unique_ptr<PlaintextReadRecordLayer>(newRrl);
+      }));
+  EXPECT_CALL(*newRrl, setSkipEncryptedRecords(false));
+
+  auto chlo = TestMessages::clientHello();
+  chlo.legacy_session_id = IOBuf::copyBuffer("middlebox");
+  auto actions = getActions(detail::processEvent(state_, std::move(chlo)));
+  expectActions<MutateState, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingClientHello);
+}
+
 TEST_F(ServerProtocolTest, TestClientHelloCookieFail) {
   expectCookie();
   setUpExpectingClientHello();
@@ -2907,6 +3998,9 @@ TEST_F(ServerProtocolTest, TestClientHelloCookieGroupMismatch) {
     return folly::Optional<CookieState>(std::move(cs));
   }));
 
+  // The client's x25519 share must not be used before the group is checked.
+  EXPECT_CALL(*factory_, makeKeyExchange(_, _)).Times(0);
+
   auto chlo = TestMessages::clientHello();
   Cookie c;
   c.cookie = IOBuf::copyBuffer("cookie");
@@ -3062,7 +4156,9 @@ TEST_F(ServerProtocolTest, TestFullHandshakeFinished) {
   EXPECT_EQ(state_.state(), StateEnum::AcceptingData);
   EXPECT_EQ(state_.readRecordLayer().get(), rrl);
   EXPECT_EQ(state_.writeRecordLayer().get(), mockWrite_);
-  ASSERT_THAT(state_.resumptionMasterSecret(), ElementsAre('r', 's', 'e', 'c'));
+  ASSERT_THAT(
+      *state_.resumptionMasterSecret(), ElementsAre('r', 's', 'e', 'c'));
+  EXPECT_EQ(state_.handshakeState(), nullptr);
 }
 
 TEST_F(ServerProtocolTest, TestFinishedNoTicket) {
@@ -3076,6 +4172,79 @@ TEST_F(ServerProtocolTest, TestFinishedNoTicket) {
   expectActions<MutateState, ReportHandshakeSuccess>(actions);
   processStateMutations(actions);
   EXPECT_EQ(state_.state(), StateEnum::AcceptingData);
+  EXPECT_EQ(state_.handshakeState(), nullptr);
+}
+
+TEST_F(ServerProtocolTest, TestFinishedDeferTicket) {
+  context_->setDeferNewSessionTicket(true);
+  setUpExpectingFinished();
+  EXPECT_CALL(*mockTicketCipher_, _encrypt(_)).Times(0);
+
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::finished()));
+  expectActions<MutateState, ReportHandshakeSuccess>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::AcceptingData);
+}
+
+TEST_F(ServerProtocolTest, TestFinishedTicketImmediate) {
+  setUpExpectingFinished();
+  auto asyncActions = detail::processEvent(state_, TestMessages::finished());
+  EXPECT_NE(boost::get<Actions>(&asyncActions), nullptr);
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState, ReportHandshakeSuccess, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::AcceptingData);
+}
+
+TEST_F(ServerProtocolTest, TestFinishedTicketAsync) {
+  setUpExpectingFinished();
+  Promise<Optional<std::pair<Buf, std::chrono::seconds>>> ticketPromise;
+  EXPECT_CALL(*mockTicketCipher_, _encrypt(_))
+      .WillOnce(InvokeWithoutArgs([&]() { return ticketPromise.getFuture(); }));
+  auto asyncActions = detail::processEvent(state_, TestMessages::finished());
+  EXPECT_EQ(boost::get<Actions>(&asyncActions), nullptr);
+  ticketPromise.setValue(
+      std::make_pair(IOBuf::copyBuffer("ticket"), std::chrono::seconds(100)));
+  auto actions = getActions(std::move(asyncActions));
+  expectActions<MutateState, ReportHandshakeSuccess, WriteToSocket>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.state(), StateEnum::AcceptingData);
+}
+
+TEST_F(ServerProtocolTest, TestFinishedMultipleTickets) {
+  context_->setNumNewSessionTickets(2);
+  setUpExpectingFinished();
+  EXPECT_CALL(*mockKeyScheduler_, getResumptionSecret(_, RangeMatches("")))
+      .WillOnce(InvokeWithoutArgs([]() { return IOBuf::copyBuffer("rsec0"); }));
+  EXPECT_CALL(
+      *mockKeyScheduler_, getResumptionSecret(_, RangeMatches("\x01")))
+      .WillOnce(InvokeWithoutArgs([]() { return IOBuf::copyBuffer("rsec1"); }));
+  EXPECT_CALL(*factory_, makeTicketAgeAdd())
+      .WillRepeatedly(Return(0x44444444));
+  std::vector<std::string> resumptionSecrets;
+  EXPECT_CALL(*mockTicketCipher_, _encrypt(_))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](ResumptionState& resState) {
+        resumptionSecrets.push_back(
+            resState.resumptionSecret->moveToFbString().toStdString());
+        return std::make_pair(
+            IOBuf::copyBuffer("ticket"), std::chrono::seconds(100));
+      }));
+  EXPECT_CALL(*mockWrite_, _write(_)).WillOnce(Invoke([](TLSMessage& msg) {
+    EXPECT_EQ(msg.type, ContentType::handshake);
+    auto second = TestMessages::newSessionTicket();
+    second.ticket_nonce = IOBuf::copyBuffer("\x01");
+    auto expected = encodeHandshake(TestMessages::newSessionTicket());
+    expected->prependChain(encodeHandshake(std::move(second)));
+    EXPECT_TRUE(IOBufEqualTo()(msg.fragment, expected));
+    return folly::IOBuf::copyBuffer("handshake");
+  }));
+
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::finished()));
+  expectActions<MutateState, ReportHandshakeSuccess, WriteToSocket>(actions);
+  EXPECT_EQ(resumptionSecrets, std::vector<std::string>({"rsec0", "rsec1"}));
 }
 
 TEST_F(ServerProtocolTest, TestFinishedTicketEarly) {
@@ -3100,6 +4269,22 @@ TEST_F(ServerProtocolTest, TestFinishedTicketEarly) {
   EXPECT_EQ(state_.state(), StateEnum::AcceptingData);
 }
 
+TEST_F(ServerProtocolTest, TestFinishedTicketServerName) {
+  setUpExpectingFinished();
+  state_.sni() = "www.hostname.com";
+
+  EXPECT_CALL(*mockTicketCipher_, _encrypt(_))
+      .WillOnce(Invoke([](ResumptionState& resState) {
+        EXPECT_EQ(*resState.serverName, "www.hostname.com");
+        return std::make_pair(
+            IOBuf::copyBuffer("ticket"), std::chrono::seconds(100));
+      }));
+
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::finished()));
+  expectActions<MutateState, ReportHandshakeSuccess, WriteToSocket>(actions);
+}
+
 TEST_F(ServerProtocolTest, TestFinishedPskNotSupported) {
   setUpExpectingFinished();
   state_.pskType() = PskType::NotSupported;
@@ -3321,6 +4506,38 @@ TEST_F(ServerProtocolTest, TestAppData) {
   expectSingleAction<DeliverAppData>(std::move(actions));
 }
 
+TEST_F(ServerProtocolTest, TestSocketDataAppData) {
+  setUpAcceptingData();
+  EXPECT_CALL(*mockRead_, read(_)).WillOnce(InvokeWithoutArgs([]() {
+    TLSMessage msg;
+    msg.type = ContentType::application_data;
+    msg.fragment = IOBuf::copyBuffer("appdata");
+    return msg;
+  }));
+
+  IOBufQueue queue;
+  auto actions =
+      getActions(ServerStateMachine().processSocketData(state_, queue));
+
+  auto appData = expectSingleAction<DeliverAppData>(std::move(actions));
+  EXPECT_TRUE(IOBufEqualTo()(appData.data, IOBuf::copyBuffer("appdata")));
+}
+
+TEST_F(ServerProtocolTest, TestAppWriteStateMachine) {
+  setUpAcceptingData();
+  EXPECT_CALL(*mockWrite_, _write(_)).WillOnce(Invoke([](TLSMessage& msg) {
+    EXPECT_EQ(msg.type, ContentType::application_data);
+    EXPECT_TRUE(IOBufEqualTo()(msg.fragment, IOBuf::copyBuffer("appdata")));
+    return IOBuf::copyBuffer("writtenappdata");
+  }));
+
+  auto actions = getActions(
+      ServerStateMachine().processAppWrite(state_, TestMessages::appWrite()));
+
+  auto write = expectSingleAction<WriteToSocket>(std::move(actions));
+  EXPECT_TRUE(IOBufEqualTo()(write.data, IOBuf::copyBuffer("writtenappdata")));
+}
+
 TEST_F(ServerProtocolTest, TestAppWrite) {
   setUpAcceptingData();
   EXPECT_CALL(*mockWrite_, _write(_)).WillOnce(Invoke([](TLSMessage& msg) {
@@ -3336,6 +4553,76 @@ TEST_F(ServerProtocolTest, TestAppWrite) {
   EXPECT_TRUE(IOBufEqualTo()(write.data, IOBuf::copyBuffer("writtenappdata")));
 }
 
+TEST_F(ServerProtocolTest, TestAppWriteIovecs) {
+  setUpAcceptingData();
+  EXPECT_CALL(*mockWrite_, _write(_)).WillOnce(Invoke([](TLSMessage& msg) {
+    EXPECT_EQ(msg.type, ContentType::application_data);
+    EXPECT_TRUE(IOBufEqualTo()(msg.fragment, IOBuf::copyBuffer("appdata")));
+    auto written = IOBuf::copyBuffer("written");
+    written->prependChain(IOBuf::copyBuffer("appdata"));
+    return written;
+  }));
+
+  auto appWrite = TestMessages::appWrite();
+  appWrite.iovecs = std::make_shared<RecordIovecs>();
+  auto actions = getActions(detail::processEvent(state_, std::move(appWrite)));
+
+  auto write = expectSingleAction<WriteToSocket>(std::move(actions));
+  EXPECT_FALSE(write.data);
+  ASSERT_TRUE(write.iovecs);
+  EXPECT_EQ(write.iovecs->iovecs.size(), 2);
+  std::string written;
+  for (const auto& vec : write.iovecs->iovecs) {
+    written.append(static_cast<const char*>(vec.iov_base), vec.iov_len);
+  }
+  EXPECT_EQ(written, "writtenappdata");
+}
+
+TEST_F(ServerProtocolTest, TestAppWriteKeyUpdateDue) {
+  setUpAcceptingData();
+  Sequence s;
+  EXPECT_CALL(*mockWrite_, _write(_))
+      .InSequence(s)
+      .WillOnce(Invoke([](TLSMessage& msg) {
+        EXPECT_EQ(msg.type, ContentType::application_data);
+        return IOBuf::copyBuffer("writtenappdata");
+      }));
+  EXPECT_CALL(*mockWrite_, keyUpdateDue()).WillOnce(Return(true));
+  EXPECT_CALL(*mockWrite_, _write(_))
+      .InSequence(s)
+      .WillOnce(Invoke([](TLSMessage& msg) {
+        EXPECT_EQ(msg.type, ContentType::handshake);
+        EXPECT_TRUE(IOBufEqualTo()(
+            msg.fragment, encodeHandshake(TestMessages::keyUpdate(false))));
+        return IOBuf::copyBuffer("keyupdate");
+      }));
+  EXPECT_CALL(*mockKeyScheduler_, serverKeyUpdate());
+  EXPECT_CALL(
+      *mockKeyScheduler_, getSecret(AppTrafficSecrets::ServerAppTraffic))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return std::vector<uint8_t>({'s', 'a', 't'});
+      }));
+  EXPECT_CALL(*mockKeyScheduler_, getTrafficKey(RangeMatches("sat"), _, _))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TrafficKey{IOBuf::copyBuffer("serverkey"),
+                          IOBuf::copyBuffer("serveriv")};
+      }));
+  MockAead* waead;
+  MockEncryptedWriteRecordLayer* wrl;
+  expectAeadCreation({{"serverkey", &waead}});
+  expectEncryptedWriteRecordLayerCreation(&wrl, &waead);
+
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::appWrite()));
+  expectActions<MutateState, WriteToSocket>(actions);
+  auto write = expectAction<WriteToSocket>(actions);
+  EXPECT_TRUE(IOBufEqualTo()(
+      write.data, IOBuf::copyBuffer("writtenappdatakeyupdate")));
+  processStateMutations(actions);
+  EXPECT_EQ(state_.writeRecordLayer().get(), wrl);
+  EXPECT_EQ(state_.state(), StateEnum::AcceptingData);
+}
+
 TEST_F(ServerProtocolTest, TestKeyUpdateNotRequested) {
   setUpAcceptingData();
   auto actions =
@@ -3410,6 +4697,43 @@ TEST_F(ServerProtocolTest, TestKeyUpdateRequest) {
   EXPECT_EQ(state_.state(), StateEnum::AcceptingData);
 }
 
+TEST_F(ServerProtocolTest, TestKeyUpdatePrepared) {
+  setUpAcceptingData();
+  context_->setPrepareKeyUpdates(true);
+  auto prepared = std::make_unique<MockAead>();
+  MockAead* preparedAead = prepared.get();
+  state_.nextClientAead() = std::move(prepared);
+  EXPECT_CALL(*mockKeyScheduler_, clientKeyUpdate());
+  EXPECT_CALL(*mockRead_, hasUnparsedHandshakeData()).WillOnce(Return(false));
+  // Only passed to trafficSecretAvailable(), the aead is already derived.
+  EXPECT_CALL(
+      *mockKeyScheduler_, getSecret(AppTrafficSecrets::ClientAppTraffic))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return std::vector<uint8_t>({'c', 'a', 't'});
+      }));
+  EXPECT_CALL(
+      *mockKeyScheduler_, getNextSecret(AppTrafficSecrets::ClientAppTraffic))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return std::vector<uint8_t>({'n', 'c', 'a', 't'});
+      }));
+  EXPECT_CALL(*mockKeyScheduler_, getTrafficKey(RangeMatches("ncat"), _, _))
+      .WillOnce(InvokeWithoutArgs([]() {
+        return TrafficKey{IOBuf::copyBuffer("nextclientkey"),
+                          IOBuf::copyBuffer("nextclientiv")};
+      }));
+
+  MockAead* nextAead;
+  MockEncryptedReadRecordLayer* rrl;
+  expectAeadCreation({{"nextclientkey", &nextAead}});
+  expectEncryptedReadRecordLayerCreation(&rrl, &preparedAead);
+  auto actions =
+      getActions(detail::processEvent(state_, TestMessages::keyUpdate(false)));
+  expectActions<MutateState>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.readRecordLayer().get(), rrl);
+  EXPECT_EQ(state_.nextClientAead().get(), nextAead);
+}
+
 TEST_F(ServerProtocolTest, TestCertificate) {
   setUpExpectingCertificate();
   EXPECT_CALL(
@@ -3439,6 +4763,33 @@ TEST_F(ServerProtocolTest, TestCertificate) {
   EXPECT_EQ(state_.state(), StateEnum::ExpectingCertificateVerify);
 }
 
+TEST_F(ServerProtocolTest, TestCertificatePreParsed) {
+  setUpExpectingCertificate();
+  EXPECT_CALL(
+      *mockHandshakeContext_, appendToTranscript(BufMatches("certencoding")));
+  clientLeafCert_ = std::make_shared<MockPeerCert>();
+  clientIntCert_ = std::make_shared<MockPeerCert>();
+  EXPECT_CALL(*factory_, _makePeerCert(BufMatches("cert2")))
+      .WillOnce(Return(clientIntCert_));
+
+  auto certificate = TestMessages::certificate();
+  CertificateEntry entry1;
+  entry1.cert_data = folly::IOBuf::copyBuffer("cert1");
+  entry1.parsedCert = clientLeafCert_;
+  certificate.certificate_list.push_back(std::move(entry1));
+  CertificateEntry entry2;
+  entry2.cert_data = folly::IOBuf::copyBuffer("cert2");
+  certificate.certificate_list.push_back(std::move(entry2));
+  auto actions =
+      getActions(detail::processEvent(state_, std::move(certificate)));
+
+  expectActions<MutateState>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.unverifiedCertChain()->size(), 2);
+  EXPECT_EQ(state_.unverifiedCertChain()->at(0), clientLeafCert_);
+  EXPECT_EQ(state_.unverifiedCertChain()->at(1), clientIntCert_);
+}
+
 TEST_F(ServerProtocolTest, TestCertificateNonemptyContext) {
   setUpExpectingCertificate();
   EXPECT_CALL(
@@ -3519,6 +4870,30 @@ TEST_F(ServerProtocolTest, TestCertificateVerifyNoVerifier) {
   EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
 }
 
+TEST_F(ServerProtocolTest, TestCertificateVerifyRetainIdentityOnly) {
+  setUpExpectingCertificateVerify();
+  context_->setClientCertVerifier(nullptr);
+  context_->setPeerCertRetention(PeerCertRetention::IdentityOnly);
+  EXPECT_CALL(*mockHandshakeContext_, getHandshakeContext())
+      .WillRepeatedly(
+          Invoke([]() { return IOBuf::copyBuffer("certcontext"); }));
+  EXPECT_CALL(*clientLeafCert_, verify(_, _, _, _));
+  EXPECT_CALL(*mockHandshakeContext_, appendToTranscript(_));
+  EXPECT_CALL(*clientLeafCert_, getIdentity()).WillOnce(Return("client"));
+
+  auto actions = getActions(
+      detail::processEvent(state_, TestMessages::certificateVerify()));
+
+  expectActions<MutateState>(actions);
+  processStateMutations(actions);
+  EXPECT_EQ(state_.unverifiedCertChain(), folly::none);
+  ASSERT_TRUE(state_.clientCert());
+  EXPECT_NE(state_.clientCert(), clientLeafCert_);
+  EXPECT_EQ(state_.clientCert()->getIdentity(), "client");
+  EXPECT_FALSE(state_.clientCert()->getX509());
+  EXPECT_EQ(state_.state(), StateEnum::ExpectingFinished);
+}
+
 TEST_F(ServerProtocolTest, TestCertificateVerifyWithVerifier) {
   setUpExpectingCertificateVerify();
   Sequence contextSeq;
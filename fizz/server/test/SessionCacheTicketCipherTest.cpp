@@ -0,0 +1,174 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/server/SessionCacheTicketCipher.h>
+
+#include <map>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+class FakeRemoteSessionStore : public RemoteSessionStore {
+ public:
+  void put(
+      const std::string& id,
+      const ResumptionState& state,
+      std::chrono::system_clock::time_point /* expires */) override {
+    sessions[id] = cloneResumptionState(state);
+  }
+
+  Future<Optional<ResumptionState>> get(const std::string& id) override {
+    gets++;
+    auto it = sessions.find(id);
+    if (it == sessions.end()) {
+      return Optional<ResumptionState>();
+    }
+    return Optional<ResumptionState>(cloneResumptionState(it->second));
+  }
+
+  std::map<std::string, ResumptionState> sessions;
+  size_t gets{0};
+};
+
+static ResumptionState makeState(StringPiece secret) {
+  ResumptionState state;
+  state.version = ProtocolVersion::tls_1_3;
+  state.cipher = CipherSuite::TLS_AES_128_GCM_SHA256;
+  state.resumptionSecret = IOBuf::copyBuffer(secret);
+  state.alpn = "h2";
+  state.ticketAgeAdd = 0x44444444;
+  state.ticketIssueTime = std::chrono::system_clock::now();
+  return state;
+}
+
+static Buf issue(const SessionCacheTicketCipher& cipher, StringPiece secret) {
+  auto ticket = cipher.encrypt(makeState(secret)).get();
+  EXPECT_TRUE(ticket.hasValue());
+  return std::move(ticket->first);
+}
+
+static bool resumes(
+    const SessionCacheTicketCipher& cipher,
+    const Buf& ticket,
+    StringPiece secret) {
+  auto result = cipher.decrypt(ticket->clone()).get();
+  if (result.first != PskType::Resumption) {
+    return false;
+  }
+  EXPECT_TRUE(IOBufEqualTo()(
+      result.second->resumptionSecret, IOBuf::copyBuffer(secret)));
+  return true;
+}
+
+TEST(SessionCacheTicketCipherTest, TestRoundTrip) {
+  SessionCacheTicketCipher cipher(100);
+  cipher.setValidity(std::chrono::seconds(30));
+  auto ticket = cipher.encrypt(makeState("secret")).get();
+  ASSERT_TRUE(ticket.hasValue());
+  EXPECT_EQ(
+      ticket->first->computeChainDataLength(),
+      SessionCacheTicketCipher::kSessionIdLength);
+  EXPECT_EQ(ticket->second, std::chrono::seconds(30));
+
+  auto result = cipher.decrypt(ticket->first->clone()).get();
+  ASSERT_EQ(result.first, PskType::Resumption);
+  EXPECT_EQ(result.second->version, ProtocolVersion::tls_1_3);
+  EXPECT_EQ(result.second->cipher, CipherSuite::TLS_AES_128_GCM_SHA256);
+  EXPECT_EQ(*result.second->alpn, "h2");
+  EXPECT_EQ(result.second->ticketAgeAdd, 0x44444444);
+
+  // Sessions can be resumed more than once.
+  EXPECT_TRUE(resumes(cipher, ticket->first, "secret"));
+}
+
+TEST(SessionCacheTicketCipherTest, TestUnknownTicket) {
+  SessionCacheTicketCipher cipher(100);
+  issue(cipher, "secret");
+  EXPECT_EQ(
+      cipher.decrypt(IOBuf::copyBuffer(std::string(16, 'x'))).get().first,
+      PskType::Rejected);
+  EXPECT_EQ(
+      cipher.decrypt(IOBuf::copyBuffer("short")).get().first,
+      PskType::Rejected);
+}
+
+TEST(SessionCacheTicketCipherTest, TestEviction) {
+  SessionCacheTicketCipher cipher(2, 1);
+  auto first = issue(cipher, "first");
+  auto second = issue(cipher, "second");
+  auto third = issue(cipher, "third");
+  EXPECT_EQ(cipher.size(), 2);
+  EXPECT_FALSE(resumes(cipher, first, "first"));
+  EXPECT_TRUE(resumes(cipher, second, "second"));
+  EXPECT_TRUE(resumes(cipher, third, "third"));
+}
+
+TEST(SessionCacheTicketCipherTest, TestShardedCapacity) {
+  SessionCacheTicketCipher cipher(64, 8);
+  for (size_t i = 0; i < 1000; ++i) {
+    issue(cipher, "secret");
+  }
+  EXPECT_LE(cipher.size(), 64);
+}
+
+TEST(SessionCacheTicketCipherTest, TestExpiry) {
+  SessionCacheTicketCipher cipher(100);
+  cipher.setValidity(std::chrono::seconds(10));
+  auto state = makeState("secret");
+  state.ticketIssueTime -= std::chrono::seconds(11);
+  auto ticket = cipher.encrypt(std::move(state)).get();
+  ASSERT_TRUE(ticket.hasValue());
+  EXPECT_FALSE(resumes(cipher, ticket->first, "secret"));
+  EXPECT_EQ(cipher.size(), 0);
+}
+
+TEST(SessionCacheTicketCipherTest, TestRemoteStore) {
+  auto remote = std::make_shared<FakeRemoteSessionStore>();
+  SessionCacheTicketCipher cipher(1, 1, remote);
+  SessionCacheTicketCipher other(1, 1, remote);
+
+  auto first = issue(cipher, "first");
+  auto second = issue(cipher, "second");
+  EXPECT_EQ(remote->sessions.size(), 2);
+
+  // Evicted locally, but still in the remote store.
+  EXPECT_TRUE(resumes(cipher, first, "first"));
+  EXPECT_EQ(remote->gets, 1);
+  // Now cached locally again.
+  EXPECT_TRUE(resumes(cipher, first, "first"));
+  EXPECT_EQ(remote->gets, 1);
+
+  EXPECT_TRUE(resumes(other, second, "second"));
+  EXPECT_FALSE(
+      resumes(other, IOBuf::copyBuffer(std::string(16, 'x')), "unknown"));
+}
+
+TEST(SessionCacheTicketCipherTest, TestRemoteExpired) {
+  auto remote = std::make_shared<FakeRemoteSessionStore>();
+  SessionCacheTicketCipher cipher(1, 1, remote);
+  cipher.setValidity(std::chrono::seconds(10));
+  auto state = makeState("secret");
+  state.ticketIssueTime -= std::chrono::seconds(11);
+  remote->sessions[std::string(16, 'a')] = std::move(state);
+  EXPECT_FALSE(
+      resumes(cipher, IOBuf::copyBuffer(std::string(16, 'a')), "secret"));
+}
+
+TEST(SessionCacheTicketCipherTest, TestBadConfig) {
+  EXPECT_THROW(SessionCacheTicketCipher(0), std::runtime_error);
+  EXPECT_THROW(SessionCacheTicketCipher(10, 0), std::runtime_error);
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/server/SingleUseTicketReplayCache.h>
+
+#include <folly/Bits.h>
+
+#include <set>
+#include <thread>
+
+using namespace folly;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+class SingleUseTicketReplayCacheTest : public testing::Test {
+ protected:
+  SingleUseTicketReplayCache cache_{std::chrono::seconds(60),
+                                    std::chrono::seconds(600)};
+  SingleUseTicketReplayCache::Clock::time_point now_{
+      SingleUseTicketReplayCache::Clock::now()};
+
+  uint64_t issueAt(std::chrono::seconds offset = std::chrono::seconds(0)) {
+    return cache_.issueTicketId(now_ + offset);
+  }
+
+  ReplayCacheResult consumeAt(
+      uint64_t id,
+      std::chrono::seconds offset = std::chrono::seconds(0)) {
+    return cache_.consume(id, now_ + offset);
+  }
+};
+
+TEST_F(SingleUseTicketReplayCacheTest, TestMonotonic) {
+  auto first = issueAt();
+  auto second = issueAt();
+  EXPECT_LT(first, second);
+  EXPECT_EQ(first >> 32, second >> 32);
+
+  auto later = issueAt(std::chrono::seconds(60));
+  EXPECT_EQ(later >> 32, (first >> 32) + 1);
+
+  // A clock going backwards doesn't reuse ids.
+  EXPECT_GT(issueAt(), later);
+}
+
+TEST_F(SingleUseTicketReplayCacheTest, TestConsumeOnce) {
+  auto id = issueAt();
+  auto other = issueAt();
+  EXPECT_EQ(consumeAt(id), ReplayCacheResult::NotReplay);
+  EXPECT_EQ(consumeAt(id), ReplayCacheResult::DefinitelyReplay);
+  EXPECT_EQ(consumeAt(other), ReplayCacheResult::NotReplay);
+  EXPECT_EQ(consumeAt(other), ReplayCacheResult::DefinitelyReplay);
+}
+
+TEST_F(SingleUseTicketReplayCacheTest, TestCheck) {
+  auto id = Endian::big(issueAt());
+  ByteRange identifier(reinterpret_cast<const uint8_t*>(&id), sizeof(id));
+  EXPECT_EQ(cache_.check(identifier).get(), ReplayCacheResult::NotReplay);
+  EXPECT_EQ(
+      cache_.check(identifier).get(), ReplayCacheResult::DefinitelyReplay);
+  EXPECT_EQ(
+      cache_.check(StringPiece("hello")).get(),
+      ReplayCacheResult::MaybeReplay);
+}
+
+TEST_F(SingleUseTicketReplayCacheTest, TestExpiry) {
+  auto id = issueAt();
+  auto other = issueAt();
+  EXPECT_EQ(
+      consumeAt(id, std::chrono::seconds(300)), ReplayCacheResult::NotReplay);
+  EXPECT_EQ(
+      consumeAt(other, std::chrono::seconds(700)),
+      ReplayCacheResult::DefinitelyReplay);
+  EXPECT_EQ(
+      consumeAt(id, std::chrono::seconds(700)),
+      ReplayCacheResult::DefinitelyReplay);
+}
+
+TEST_F(SingleUseTicketReplayCacheTest, TestUnknownWindows) {
+  // Issued by an earlier instance, whose consumed ids are lost.
+  auto earlier = issueAt() - (uint64_t(1) << 32);
+  EXPECT_EQ(consumeAt(earlier), ReplayCacheResult::MaybeReplay);
+
+  auto future = issueAt(std::chrono::seconds(180));
+  EXPECT_EQ(consumeAt(future), ReplayCacheResult::MaybeReplay);
+}
+
+TEST_F(SingleUseTicketReplayCacheTest, TestMemoryUsage) {
+  std::vector<uint64_t> ids;
+  for (size_t i = 0; i < 1000000; ++i) {
+    ids.push_back(issueAt());
+  }
+  for (auto id : ids) {
+    EXPECT_EQ(consumeAt(id), ReplayCacheResult::NotReplay);
+  }
+  EXPECT_LT(cache_.getMemoryUsage(), 256 * 1024);
+  for (size_t i = 0; i < ids.size(); i += 997) {
+    EXPECT_EQ(consumeAt(ids[i]), ReplayCacheResult::DefinitelyReplay);
+  }
+
+  // Sparse ids stay in arrays.
+  SingleUseTicketReplayCache sparse(
+      std::chrono::seconds(60), std::chrono::seconds(600));
+  for (size_t i = 0; i < 100; ++i) {
+    sparse.consume((ids[0] & ~uint64_t(0xffffffff)) | (i << 16), now_);
+  }
+  EXPECT_LT(sparse.getMemoryUsage(), 16 * 1024);
+}
+
+TEST_F(SingleUseTicketReplayCacheTest, TestConcurrentIssue) {
+  std::vector<std::vector<uint64_t>> ids(4);
+  std::vector<std::thread> threads;
+  for (auto& threadIds : ids) {
+    threads.emplace_back([&]() {
+      for (size_t i = 0; i < 10000; ++i) {
+        threadIds.push_back(issueAt());
+      }
+    });
+  }
+  std::set<uint64_t> unique;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+    unique.insert(ids[i].begin(), ids[i].end());
+  }
+  EXPECT_EQ(unique.size(), 40000);
+}
+
+TEST_F(SingleUseTicketReplayCacheTest, TestBadConfig) {
+  EXPECT_THROW(
+      SingleUseTicketReplayCache(
+          std::chrono::seconds(0), std::chrono::seconds(600)),
+      std::runtime_error);
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
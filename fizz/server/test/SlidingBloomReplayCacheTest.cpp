@@ -0,0 +1,168 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/server/SlidingBloomReplayCache.h>
+
+#include <fizz/server/test/Mocks.h>
+
+#include <thread>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+class SlidingBloomReplayCacheTest : public Test {
+ protected:
+  SlidingBloomReplayCache cache_{std::chrono::seconds(8), 1000, 0.0001};
+  SlidingBloomReplayCache::Clock::time_point now_{
+      SlidingBloomReplayCache::Clock::now()};
+};
+
+TEST_F(SlidingBloomReplayCacheTest, TestSizing) {
+  // Up to 4/3 of 8000 elements at 1e-4 need about 19.2 bits each, and 13
+  // hashes.
+  EXPECT_GT(cache_.getCellCount(), 200000);
+  EXPECT_LT(cache_.getCellCount(), 210000);
+  EXPECT_EQ(cache_.getHashCount(), 13);
+}
+
+TEST_F(SlidingBloomReplayCacheTest, TestTestAndSet) {
+  EXPECT_FALSE(cache_.testAndSet(StringPiece("hello"), now_));
+  EXPECT_TRUE(cache_.testAndSet(StringPiece("hello"), now_));
+  EXPECT_FALSE(cache_.testAndSet(StringPiece("world"), now_));
+  EXPECT_TRUE(cache_.testAndSet(StringPiece("world"), now_));
+}
+
+TEST_F(SlidingBloomReplayCacheTest, TestExpiry) {
+  EXPECT_FALSE(cache_.testAndSet(StringPiece("hello"), now_));
+  EXPECT_TRUE(
+      cache_.testAndSet(StringPiece("hello"), now_ + std::chrono::seconds(6)));
+  // The second insertion is still remembered.
+  EXPECT_TRUE(
+      cache_.testAndSet(StringPiece("hello"), now_ + std::chrono::seconds(9)));
+  EXPECT_FALSE(
+      cache_.testAndSet(StringPiece("hello"), now_ + std::chrono::seconds(20)));
+}
+
+TEST_F(SlidingBloomReplayCacheTest, TestClockGoingBack) {
+  EXPECT_FALSE(
+      cache_.testAndSet(StringPiece("hello"), now_ + std::chrono::seconds(3)));
+  EXPECT_TRUE(cache_.testAndSet(StringPiece("hello"), now_));
+}
+
+TEST_F(SlidingBloomReplayCacheTest, TestClear) {
+  EXPECT_FALSE(cache_.testAndSet(StringPiece("hello"), now_));
+  cache_.clear();
+  EXPECT_FALSE(cache_.testAndSet(StringPiece("hello"), now_));
+}
+
+TEST_F(SlidingBloomReplayCacheTest, TestFalsePositiveRate) {
+  size_t falsePositives = 0;
+  for (size_t i = 0; i < 8000; ++i) {
+    auto id = folly::to<std::string>("id", i);
+    if (cache_.testAndSet(StringPiece(id), now_)) {
+      falsePositives++;
+    }
+  }
+  EXPECT_LT(falsePositives, 10);
+}
+
+TEST_F(SlidingBloomReplayCacheTest, TestCheck) {
+  EXPECT_EQ(
+      cache_.check(StringPiece("hello")).get(), ReplayCacheResult::NotReplay);
+  EXPECT_EQ(
+      cache_.check(StringPiece("hello")).get(),
+      ReplayCacheResult::MaybeReplay);
+}
+
+TEST_F(SlidingBloomReplayCacheTest, TestRemote) {
+  auto remote = std::make_shared<MockReplayCache>();
+  SlidingBloomReplayCache cache(std::chrono::seconds(8), 1000, 0.0001, remote);
+
+  // New identifiers are reported to the remote cache without waiting.
+  Promise<ReplayCacheResult> recorded;
+  EXPECT_CALL(*remote, check(_))
+      .WillOnce(InvokeWithoutArgs([&]() { return recorded.getFuture(); }));
+  auto result = cache.check(StringPiece("hello"));
+  ASSERT_TRUE(result.isReady());
+  EXPECT_EQ(result.value(), ReplayCacheResult::NotReplay);
+
+  // Seen identifiers are resolved by the remote cache.
+  EXPECT_CALL(*remote, check(_)).WillOnce(InvokeWithoutArgs([]() {
+    return makeFuture(ReplayCacheResult::DefinitelyReplay);
+  }));
+  EXPECT_EQ(
+      cache.check(StringPiece("hello")).get(),
+      ReplayCacheResult::DefinitelyReplay);
+  recorded.setValue(ReplayCacheResult::NotReplay);
+}
+
+TEST_F(SlidingBloomReplayCacheTest, TestConcurrent) {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([this, t] {
+      for (size_t i = 0; i < 1000; ++i) {
+        auto id = folly::to<std::string>("id", t, "-", i);
+        cache_.testAndSet(StringPiece(id), now_);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < 4; ++t) {
+    for (size_t i = 0; i < 1000; ++i) {
+      auto id = folly::to<std::string>("id", t, "-", i);
+      EXPECT_TRUE(cache_.testAndSet(StringPiece(id), now_));
+    }
+  }
+}
+
+TEST_F(SlidingBloomReplayCacheTest, TestConcurrentRotation) {
+  // Identifiers recorded while another check moves to a new bucket must
+  // not be lost.
+  auto at = [this](size_t i) {
+    return now_ + i * std::chrono::milliseconds(4);
+  };
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([this, t, &at] {
+      for (size_t i = 0; i < 1000; ++i) {
+        auto id = folly::to<std::string>("id", t, "-", i);
+        cache_.testAndSet(StringPiece(id), at(i));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < 4; ++t) {
+    for (size_t i = 0; i < 1000; ++i) {
+      auto id = folly::to<std::string>("id", t, "-", i);
+      EXPECT_TRUE(cache_.testAndSet(StringPiece(id), at(1000)));
+    }
+  }
+}
+
+TEST_F(SlidingBloomReplayCacheTest, TestInvalidParams) {
+  EXPECT_THROW(
+      SlidingBloomReplayCache(std::chrono::seconds(0), 1, 0.01),
+      std::runtime_error);
+  EXPECT_THROW(
+      SlidingBloomReplayCache(std::chrono::seconds(1), 1, 1.0),
+      std::runtime_error);
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
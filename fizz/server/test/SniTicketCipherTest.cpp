@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/server/SniTicketCipher.h>
+#include <fizz/server/test/Mocks.h>
+
+#include <fizz/crypto/Hkdf.h>
+#include <fizz/crypto/Sha256.h>
+#include <fizz/crypto/aead/AESGCM128.h>
+#include <fizz/crypto/aead/OpenSSLEVPCipher.h>
+#include <fizz/server/AeadTicketCipher.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+using TestTicketCipher = AeadTicketCipher<
+    OpenSSLEVPCipher<AESGCM128>,
+    SecretCodec,
+    HkdfImpl<Sha256>>;
+
+static std::shared_ptr<TestTicketCipher> makeCipher(char secretByte) {
+  auto cipher = std::make_shared<TestTicketCipher>();
+  std::string secret(32, secretByte);
+  std::vector<ByteRange> secrets{range(secret)};
+  cipher->setTicketSecrets(secrets);
+  return cipher;
+}
+
+class SniTicketCipherTest : public Test {
+ public:
+  void SetUp() override {
+    cipher_.setCipher("a.example.com", makeCipher('a'));
+    cipher_.setCipher("B.example.com", makeCipher('b'));
+  }
+
+ protected:
+  Buf encrypt(Optional<std::string> serverName, StringPiece secret) {
+    ResumptionState state;
+    state.resumptionSecret = IOBuf::copyBuffer(secret);
+    state.serverName = std::move(serverName);
+    auto result = cipher_.encrypt(std::move(state)).get();
+    return result ? std::move(result->first) : nullptr;
+  }
+
+  Optional<std::string> decrypt(
+      const Buf& ticket,
+      Optional<std::string> serverName) {
+    auto result =
+        cipher_.decryptForServerName(ticket->clone(), serverName).get();
+    if (result.first != PskType::Resumption) {
+      return none;
+    }
+    return result.second->resumptionSecret->moveToFbString().toStdString();
+  }
+
+  SniTicketCipher cipher_;
+};
+
+TEST_F(SniTicketCipherTest, TestEncryptDecrypt) {
+  auto a = encrypt(std::string("a.example.com"), "secreta");
+  auto b = encrypt(std::string("b.example.com"), "secretb");
+  ASSERT_TRUE(a);
+  ASSERT_TRUE(b);
+  EXPECT_EQ(*decrypt(a, std::string("a.example.com")), "secreta");
+  EXPECT_EQ(*decrypt(b, std::string("b.example.com")), "secretb");
+}
+
+TEST_F(SniTicketCipherTest, TestOtherServerName) {
+  auto a = encrypt(std::string("a.example.com"), "secreta");
+  EXPECT_FALSE(decrypt(a, std::string("b.example.com")).hasValue());
+  EXPECT_FALSE(decrypt(a, none).hasValue());
+  EXPECT_FALSE(cipher_.decrypt(a->clone()).get().second.hasValue());
+}
+
+TEST_F(SniTicketCipherTest, TestIssuedForOtherServerName) {
+  auto shared = std::make_shared<MockTicketCipher>();
+  cipher_.setCipher("c.example.com", shared);
+  cipher_.setCipher("d.example.com", shared);
+  EXPECT_CALL(*shared, _decrypt(_)).WillRepeatedly(InvokeWithoutArgs([]() {
+    ResumptionState state;
+    state.resumptionSecret = IOBuf::copyBuffer("secretc");
+    state.serverName = "C.example.com";
+    return std::make_pair(PskType::Resumption, std::move(state));
+  }));
+  auto ticket = IOBuf::copyBuffer("ticket");
+  EXPECT_EQ(*decrypt(ticket, std::string("c.example.com")), "secretc");
+  EXPECT_FALSE(decrypt(ticket, std::string("d.example.com")).hasValue());
+}
+
+TEST_F(SniTicketCipherTest, TestCaseInsensitive) {
+  auto a = encrypt(std::string("A.Example.com"), "secreta");
+  ASSERT_TRUE(a);
+  EXPECT_EQ(*decrypt(a, std::string("a.EXAMPLE.com")), "secreta");
+}
+
+TEST_F(SniTicketCipherTest, TestDefault) {
+  EXPECT_FALSE(encrypt(std::string("c.example.com"), "secretc"));
+  EXPECT_FALSE(encrypt(none, "secretc"));
+
+  cipher_.setDefaultCipher(makeCipher('d'));
+  auto c = encrypt(std::string("c.example.com"), "secretc");
+  auto noSni = encrypt(none, "nosni");
+  ASSERT_TRUE(c);
+  ASSERT_TRUE(noSni);
+  EXPECT_EQ(*decrypt(c, std::string("c.example.com")), "secretc");
+  EXPECT_EQ(*decrypt(noSni, none), "nosni");
+  EXPECT_FALSE(decrypt(c, std::string("a.example.com")).hasValue());
+}
+
+TEST_F(SniTicketCipherTest, TestReplaceCipher) {
+  auto a = encrypt(std::string("a.example.com"), "secreta");
+  cipher_.setCipher("a.example.com", makeCipher('a'));
+  EXPECT_EQ(*decrypt(a, std::string("a.example.com")), "secreta");
+
+  cipher_.setCipher("a.example.com", makeCipher('z'));
+  EXPECT_FALSE(decrypt(a, std::string("a.example.com")).hasValue());
+}
+
+TEST_F(SniTicketCipherTest, TestBadTicket) {
+  EXPECT_FALSE(
+      decrypt(IOBuf::copyBuffer("a"), std::string("a.example.com")).hasValue());
+  EXPECT_FALSE(decrypt(IOBuf::copyBuffer("ticket"), none).hasValue());
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
@@ -0,0 +1,233 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/server/StapledSelfCert.h>
+
+#include <fizz/protocol/test/Mocks.h>
+
+using namespace fizz::test;
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+class StapledSelfCertTest : public Test {
+ public:
+  void SetUp() override {
+    cert_ = std::make_shared<MockSelfCert>();
+    ON_CALL(*cert_, _getCertMessage(_)).WillByDefault(InvokeWithoutArgs([]() {
+      CertificateMsg msg;
+      msg.certificate_request_context = IOBuf::create(0);
+      CertificateEntry leaf;
+      leaf.cert_data = IOBuf::copyBuffer("leaf");
+      msg.certificate_list.push_back(std::move(leaf));
+      CertificateEntry intermediate;
+      intermediate.cert_data = IOBuf::copyBuffer("intermediate");
+      msg.certificate_list.push_back(std::move(intermediate));
+      return msg;
+    }));
+    stapled_ = std::make_shared<StapledSelfCert>(cert_, [this]() {
+      fetches_++;
+      return fetcherResult_();
+    });
+  }
+
+ protected:
+  static StapledSelfCert::Staple makeStaple(
+      StringPiece ocsp,
+      StringPiece sct) {
+    StapledSelfCert::Staple staple;
+    if (!ocsp.empty()) {
+      staple.ocspResponse = IOBuf::copyBuffer(ocsp);
+    }
+    if (!sct.empty()) {
+      staple.sctList = IOBuf::copyBuffer(sct);
+    }
+    return staple;
+  }
+
+  static CertificateMsg decodeCertMsg(Buf encoded) {
+    encoded->coalesce();
+    EXPECT_EQ(
+        encoded->data()[0], static_cast<uint8_t>(HandshakeType::certificate));
+    encoded->trimStart(4);
+    return decode<CertificateMsg>(std::move(encoded));
+  }
+
+  static void expectStaple(
+      const CertificateMsg& msg,
+      folly::Optional<std::string> ocsp,
+      folly::Optional<std::string> sct) {
+    ASSERT_EQ(msg.certificate_list.size(), 2);
+    EXPECT_TRUE(msg.certificate_list[1].extensions.empty());
+    const auto& leafExts = msg.certificate_list[0].extensions;
+    auto status = getExtension<CertificateStatus>(leafExts);
+    EXPECT_EQ(status.hasValue(), ocsp.hasValue());
+    if (ocsp) {
+      EXPECT_EQ(status->status_type, CertificateStatusType::ocsp);
+      EXPECT_EQ(StringPiece(status->ocsp_response->coalesce()), *ocsp);
+    }
+    auto scts = getExtension<SignedCertificateTimestamps>(leafExts);
+    EXPECT_EQ(scts.hasValue(), sct.hasValue());
+    if (sct) {
+      EXPECT_EQ(StringPiece(scts->sct_list->coalesce()), *sct);
+    }
+  }
+
+  std::shared_ptr<MockSelfCert> cert_;
+  std::shared_ptr<StapledSelfCert> stapled_;
+  size_t fetches_{0};
+  std::function<Future<StapledSelfCert::Staple>()> fetcherResult_ = []() {
+    return makeFuture(makeStaple("ocsp", "sct"));
+  };
+};
+
+TEST_F(StapledSelfCertTest, TestNoStaple) {
+  EXPECT_EQ(
+      stapled_->getStapledCertMessage(
+          {ExtensionType::status_request,
+           ExtensionType::signed_certificate_timestamp}),
+      nullptr);
+}
+
+TEST_F(StapledSelfCertTest, TestOcsp) {
+  stapled_->setStaple(makeStaple("ocsp", ""));
+  expectStaple(
+      decodeCertMsg(
+          stapled_->getStapledCertMessage({ExtensionType::status_request})),
+      std::string("ocsp"),
+      folly::none);
+  expectStaple(
+      decodeCertMsg(stapled_->getStapledCertMessage(
+          {ExtensionType::status_request,
+           ExtensionType::signed_certificate_timestamp})),
+      std::string("ocsp"),
+      folly::none);
+  EXPECT_EQ(
+      stapled_->getStapledCertMessage(
+          {ExtensionType::signed_certificate_timestamp}),
+      nullptr);
+}
+
+TEST_F(StapledSelfCertTest, TestOcspAndSct) {
+  stapled_->setStaple(makeStaple("ocsp", "sct"));
+  expectStaple(
+      decodeCertMsg(
+          stapled_->getStapledCertMessage({ExtensionType::status_request})),
+      std::string("ocsp"),
+      folly::none);
+  expectStaple(
+      decodeCertMsg(stapled_->getStapledCertMessage(
+          {ExtensionType::signed_certificate_timestamp})),
+      folly::none,
+      std::string("sct"));
+  expectStaple(
+      decodeCertMsg(stapled_->getStapledCertMessage(
+          {ExtensionType::status_request,
+           ExtensionType::signed_certificate_timestamp})),
+      std::string("ocsp"),
+      std::string("sct"));
+  EXPECT_EQ(stapled_->getStapledCertMessage({}), nullptr);
+}
+
+TEST_F(StapledSelfCertTest, TestUnstapledMessageUnchanged) {
+  stapled_->setStaple(makeStaple("ocsp", "sct"));
+  expectStaple(
+      decodeCertMsg(stapled_->getEncodedCertMessage()),
+      folly::none,
+      folly::none);
+}
+
+TEST_F(StapledSelfCertTest, TestRefresh) {
+  stapled_->refresh().get();
+  EXPECT_EQ(fetches_, 1);
+  expectStaple(
+      decodeCertMsg(stapled_->getStapledCertMessage(
+          {ExtensionType::status_request,
+           ExtensionType::signed_certificate_timestamp})),
+      std::string("ocsp"),
+      std::string("sct"));
+
+  fetcherResult_ = []() { return makeFuture(makeStaple("ocsp2", "")); };
+  stapled_->refresh().get();
+  expectStaple(
+      decodeCertMsg(
+          stapled_->getStapledCertMessage({ExtensionType::status_request})),
+      std::string("ocsp2"),
+      folly::none);
+}
+
+TEST_F(StapledSelfCertTest, TestRefreshPending) {
+  Promise<StapledSelfCert::Staple> promise;
+  fetcherResult_ = [&promise]() { return promise.getFuture(); };
+  auto refreshed = stapled_->refresh();
+  EXPECT_FALSE(refreshed.isReady());
+  EXPECT_EQ(
+      stapled_->getStapledCertMessage({ExtensionType::status_request}),
+      nullptr);
+
+  promise.setValue(makeStaple("ocsp", ""));
+  EXPECT_TRUE(refreshed.isReady());
+  EXPECT_NE(
+      stapled_->getStapledCertMessage({ExtensionType::status_request}),
+      nullptr);
+}
+
+TEST_F(StapledSelfCertTest, TestRefreshFailureKeepsStaple) {
+  stapled_->setStaple(makeStaple("ocsp", ""));
+  fetcherResult_ = []() {
+    return makeFuture<StapledSelfCert::Staple>(
+        std::runtime_error("responder down"));
+  };
+  stapled_->refresh().get();
+  expectStaple(
+      decodeCertMsg(
+          stapled_->getStapledCertMessage({ExtensionType::status_request})),
+      std::string("ocsp"),
+      folly::none);
+
+  fetcherResult_ = []() -> Future<StapledSelfCert::Staple> {
+    throw std::runtime_error("fetch threw");
+  };
+  stapled_->refresh().get();
+  EXPECT_NE(
+      stapled_->getStapledCertMessage({ExtensionType::status_request}),
+      nullptr);
+}
+
+TEST_F(StapledSelfCertTest, TestStartRefresh) {
+  EventBase evb;
+  fetcherResult_ = [this, &evb]() {
+    if (fetches_ == 3) {
+      evb.terminateLoopSoon();
+    }
+    return makeFuture(makeStaple("ocsp", ""));
+  };
+  stapled_->startRefresh(&evb, std::chrono::milliseconds(1));
+  evb.loopForever();
+  EXPECT_EQ(fetches_, 3);
+  EXPECT_NE(
+      stapled_->getStapledCertMessage({ExtensionType::status_request}),
+      nullptr);
+}
+
+TEST_F(StapledSelfCertTest, TestStartRefreshStopsOnDestroy) {
+  EventBase evb;
+  stapled_->startRefresh(&evb, std::chrono::milliseconds(1));
+  evb.loopOnce();
+  EXPECT_EQ(fetches_, 1);
+  stapled_.reset();
+  evb.loop();
+  EXPECT_EQ(fetches_, 1);
+}
+} // namespace test
+} // namespace fizz
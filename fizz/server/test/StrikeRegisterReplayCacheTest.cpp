@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <fizz/server/StrikeRegisterReplayCache.h>
+
+#include <folly/Conv.h>
+
+#include <thread>
+
+using namespace folly;
+
+namespace fizz {
+namespace server {
+namespace test {
+
+class StrikeRegisterReplayCacheTest : public testing::Test {
+ protected:
+  StrikeRegisterReplayCache cache_{std::chrono::seconds(10), 100, 4};
+  StrikeRegisterReplayCache::Clock::time_point now_{
+      StrikeRegisterReplayCache::Clock::now()};
+
+  ReplayCacheResult checkAt(
+      StringPiece identifier,
+      std::chrono::seconds offset = std::chrono::seconds(0)) {
+    return cache_.checkAt(identifier, now_ + offset);
+  }
+};
+
+TEST_F(StrikeRegisterReplayCacheTest, TestCapacity) {
+  // Two windows of 1000 identifiers at half load.
+  EXPECT_EQ(cache_.getCapacity(), 4000);
+}
+
+TEST_F(StrikeRegisterReplayCacheTest, TestReplay) {
+  EXPECT_EQ(checkAt("hello"), ReplayCacheResult::NotReplay);
+  EXPECT_EQ(checkAt("hello"), ReplayCacheResult::DefinitelyReplay);
+  EXPECT_EQ(checkAt("world"), ReplayCacheResult::NotReplay);
+  EXPECT_EQ(checkAt("world"), ReplayCacheResult::DefinitelyReplay);
+}
+
+TEST_F(StrikeRegisterReplayCacheTest, TestCheck) {
+  EXPECT_EQ(
+      cache_.check(StringPiece("hello")).get(), ReplayCacheResult::NotReplay);
+  EXPECT_EQ(
+      cache_.check(StringPiece("hello")).get(),
+      ReplayCacheResult::DefinitelyReplay);
+}
+
+TEST_F(StrikeRegisterReplayCacheTest, TestExpiry) {
+  EXPECT_EQ(checkAt("hello"), ReplayCacheResult::NotReplay);
+  EXPECT_EQ(
+      checkAt("hello", std::chrono::seconds(15)),
+      ReplayCacheResult::DefinitelyReplay);
+  EXPECT_EQ(
+      checkAt("hello", std::chrono::seconds(25)), ReplayCacheResult::NotReplay);
+}
+
+TEST_F(StrikeRegisterReplayCacheTest, TestExpiredSlotsReused) {
+  for (size_t i = 0; i < 4000; ++i) {
+    checkAt(folly::to<std::string>("old", i));
+  }
+  // Much later, everything old has expired and the slots can be reused.
+  for (size_t i = 0; i < 1000; ++i) {
+    EXPECT_EQ(
+        checkAt(folly::to<std::string>("new", i), std::chrono::seconds(100)),
+        ReplayCacheResult::NotReplay);
+  }
+}
+
+TEST_F(StrikeRegisterReplayCacheTest, TestFull) {
+  size_t maybeReplay = 0;
+  for (size_t i = 0; i < 5000; ++i) {
+    auto result = checkAt(folly::to<std::string>("id", i));
+    EXPECT_NE(result, ReplayCacheResult::DefinitelyReplay);
+    if (result == ReplayCacheResult::MaybeReplay) {
+      maybeReplay++;
+    }
+  }
+  // More identifiers than slots, the ones that don't fit are not accepted.
+  EXPECT_GE(maybeReplay, 1000);
+}
+
+TEST_F(StrikeRegisterReplayCacheTest, TestConcurrent) {
+  std::atomic<size_t> accepted{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (size_t i = 0; i < 500; ++i) {
+        auto id = folly::to<std::string>("id", i);
+        if (checkAt(id) == ReplayCacheResult::NotReplay) {
+          accepted++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // Every identifier is accepted by exactly one of the threads.
+  EXPECT_EQ(accepted.load(), 500);
+}
+
+TEST_F(StrikeRegisterReplayCacheTest, TestInvalidParams) {
+  EXPECT_THROW(
+      StrikeRegisterReplayCache(std::chrono::seconds(0), 1),
+      std::runtime_error);
+  EXPECT_THROW(
+      StrikeRegisterReplayCache(std::chrono::seconds(1), 1, 0),
+      std::runtime_error);
+}
+} // namespace test
+} // namespace server
+} // namespace fizz
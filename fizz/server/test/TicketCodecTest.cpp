@@ -13,6 +13,7 @@
 
 #include <fizz/crypto/test/TestUtil.h>
 #include <fizz/protocol/test/Mocks.h>
+#include <fizz/server/test/Mocks.h>
 
 using namespace fizz::test;
 using namespace folly;
@@ -121,6 +122,21 @@ TEST(TicketCodecTest, TestEncodeNoX509) {
   EXPECT_EQ(drs.clientCert->getX509(), nullptr);
 }
 
+TEST(TicketCodecTest, TestTicketId) {
+  auto cert = std::make_shared<MockSelfCert>();
+  EXPECT_CALL(*cert, getIdentity()).WillRepeatedly(Return("ident"));
+
+  auto rs = getTestResumptionState(cert, nullptr);
+  rs.ticketId = 0x0102030405060708;
+  auto encoded = TicketCodec<CertificateStorage::X509>::encode(std::move(rs));
+  auto drs = TicketCodec<CertificateStorage::X509>::decode(
+      std::move(encoded), nullptr);
+  EXPECT_EQ(*drs.ticketId, 0x0102030405060708);
+
+  drs = TicketCodec<CertificateStorage::X509>::decode(toIOBuf(ticket), nullptr);
+  EXPECT_FALSE(drs.ticketId.hasValue());
+}
+
 TEST(TicketCodecTest, TestDecodeDifferentStorage) {
   auto cert = std::make_shared<MockSelfCert>();
   auto peerCert = std::make_shared<MockPeerCert>();
@@ -164,6 +180,41 @@ TEST(TicketCodecTest, TestDecode) {
   EXPECT_EQ(rs.clientCert->getIdentity(), "Fizz");
 }
 
+TEST(TicketCodecTest, TestDecodeLazyCerts) {
+  auto certManager = std::make_unique<MockCertManager>();
+  auto certManagerPtr = certManager.get();
+  FizzServerContext context;
+  context.setCertManager(std::move(certManager));
+
+  auto rs = TicketCodec<CertificateStorage::X509>::decode(
+      toIOBuf(ticketClientAuthX509), &context);
+  auto clientCert =
+      std::dynamic_pointer_cast<const LazyPeerCert>(rs.clientCert);
+  ASSERT_TRUE(clientCert);
+  auto serverCert =
+      std::dynamic_pointer_cast<const LazyServerCert>(rs.serverCert);
+  ASSERT_TRUE(serverCert);
+
+  // The identity is known without a lookup, and the stored DER is written
+  // back as is.
+  EXPECT_CALL(*certManagerPtr, getCert(_)).Times(0);
+  EXPECT_EQ(serverCert->getIdentity(), "ident");
+  auto encoded = TicketCodec<CertificateStorage::X509>::encode(std::move(rs));
+  EXPECT_TRUE(IOBufEqualTo()(encoded, toIOBuf(ticketClientAuthX509)));
+  EXPECT_FALSE(clientCert->isParsed());
+  Mock::VerifyAndClearExpectations(certManagerPtr);
+  EXPECT_EQ(clientCert->getIdentity(), "Fizz");
+
+  auto cert = std::make_shared<MockSelfCert>();
+  EXPECT_CALL(*certManagerPtr, getCert("ident")).WillOnce(Return(cert));
+  EXPECT_CALL(*cert, getX509()).Times(2).WillRepeatedly(Invoke([]() {
+    return getCert(kRSACertificate);
+  }));
+  EXPECT_NE(serverCert->getX509(), nullptr);
+  EXPECT_EQ(serverCert->getSelfCert(), cert);
+  EXPECT_NE(serverCert->getX509(), nullptr);
+}
+
 TEST(TicketCodecTest, TestDecodeNoAlpn) {
   auto rs = TicketCodec<CertificateStorage::X509>::decode(
       toIOBuf(ticketNoAlpn), nullptr);
@@ -220,6 +271,150 @@ TEST(TicketCodecTest, TestDecodeWithoutAppToken) {
           std::chrono::seconds(25)));
   EXPECT_EQ(*rs.alpn, "h2");
 }
+
+TEST(TicketCodecTest, TestCompactRoundTrip) {
+  auto cert = std::make_shared<MockSelfCert>();
+  auto rs = getTestResumptionState(cert, nullptr);
+  rs.appToken = IOBuf::copyBuffer("hello world");
+  EXPECT_CALL(*cert, getIdentity()).WillOnce(Return("ident"));
+  auto encoded = CompactTicketCodec::encode(std::move(rs));
+  auto drs = CompactTicketCodec::decode(std::move(encoded), nullptr);
+  EXPECT_EQ(drs.version, ProtocolVersion::tls_1_3);
+  EXPECT_EQ(drs.cipher, CipherSuite::TLS_AES_128_GCM_SHA256);
+  EXPECT_TRUE(
+      IOBufEqualTo()(drs.resumptionSecret, IOBuf::copyBuffer("secret")));
+  EXPECT_EQ(drs.ticketAgeAdd, 0x44444444);
+  EXPECT_EQ(
+      drs.ticketIssueTime,
+      std::chrono::time_point<std::chrono::system_clock>(
+          std::chrono::seconds(25)));
+  EXPECT_EQ(*drs.alpn, "h2");
+  EXPECT_FALSE(drs.clientCert);
+  EXPECT_TRUE(IOBufEqualTo()(drs.appToken, IOBuf::copyBuffer("hello world")));
+}
+
+TEST(TicketCodecTest, TestCompactSmaller) {
+  auto cert = std::make_shared<MockSelfCert>();
+  auto peerCert = std::make_shared<MockPeerCert>();
+  EXPECT_CALL(*cert, getIdentity()).WillRepeatedly(Return("ident"));
+  EXPECT_CALL(*peerCert, getX509()).WillRepeatedly(Invoke([]() {
+    return getCert(kRSACertificate);
+  }));
+  EXPECT_CALL(*peerCert, getIdentity()).WillRepeatedly(Return("Fizz"));
+  auto compact = CompactTicketCodec::encode(
+      getTestResumptionState(cert, peerCert));
+  auto full = TicketCodec<CertificateStorage::X509>::encode(
+      getTestResumptionState(cert, peerCert));
+  EXPECT_LT(compact->computeChainDataLength(), 100);
+  EXPECT_LT(
+      compact->computeChainDataLength(), full->computeChainDataLength());
+
+  compact = CompactTicketCodec::encode(getTestResumptionState(cert, nullptr));
+  EXPECT_LT(compact->computeChainDataLength(), toIOBuf(ticket)->length());
+}
+
+TEST(TicketCodecTest, TestCompactClientCertFingerprint) {
+  auto cert = std::make_shared<MockSelfCert>();
+  auto peerCert = std::make_shared<MockPeerCert>();
+  auto rs = getTestResumptionState(cert, peerCert);
+  EXPECT_CALL(*cert, getIdentity()).WillOnce(Return("ident"));
+  EXPECT_CALL(*peerCert, getX509()).WillOnce(Invoke([]() {
+    return getCert(kRSACertificate);
+  }));
+  EXPECT_CALL(*peerCert, getIdentity()).WillOnce(Return("Fizz"));
+  auto encoded = CompactTicketCodec::encode(std::move(rs));
+  auto drs = CompactTicketCodec::decode(std::move(encoded), nullptr);
+  auto fingerprintCert =
+      std::dynamic_pointer_cast<const FingerprintCert>(drs.clientCert);
+  ASSERT_TRUE(fingerprintCert);
+  EXPECT_EQ(fingerprintCert->getIdentity(), "Fizz");
+  EXPECT_EQ(fingerprintCert->getX509(), nullptr);
+
+  FingerprintCert::Fingerprint expected;
+  auto der = folly::ssl::OpenSSLCertUtils::derEncode(
+      *getCert(kRSACertificate));
+  Sha256::hash(*der, folly::range(expected));
+  EXPECT_EQ(fingerprintCert->getFingerprint(), expected);
+
+  // Re-encoding a resumed connection's ticket keeps the fingerprint.
+  rs = getTestResumptionState(cert, nullptr);
+  rs.clientCert = drs.clientCert;
+  EXPECT_CALL(*cert, getIdentity()).WillOnce(Return("ident"));
+  drs = CompactTicketCodec::decode(
+      CompactTicketCodec::encode(std::move(rs)), nullptr);
+  fingerprintCert =
+      std::dynamic_pointer_cast<const FingerprintCert>(drs.clientCert);
+  ASSERT_TRUE(fingerprintCert);
+  EXPECT_EQ(fingerprintCert->getFingerprint(), expected);
+}
+
+TEST(TicketCodecTest, TestCompactClientCertIdentityOnly) {
+  auto cert = std::make_shared<MockSelfCert>();
+  auto peerCert = std::make_shared<MockPeerCert>();
+  auto rs = getTestResumptionState(cert, peerCert);
+  EXPECT_CALL(*cert, getIdentity()).WillOnce(Return("ident"));
+  EXPECT_CALL(*peerCert, getX509()).WillOnce(Invoke([]() { return nullptr; }));
+  EXPECT_CALL(*peerCert, getIdentity()).WillOnce(Return("clientid"));
+  auto drs = CompactTicketCodec::decode(
+      CompactTicketCodec::encode(std::move(rs)), nullptr);
+  ASSERT_TRUE(drs.clientCert);
+  EXPECT_EQ(drs.clientCert->getIdentity(), "clientid");
+  EXPECT_FALSE(
+      std::dynamic_pointer_cast<const FingerprintCert>(drs.clientCert));
+}
+
+TEST(TicketCodecTest, TestCompactAlpn) {
+  auto cert = std::make_shared<MockSelfCert>();
+  EXPECT_CALL(*cert, getIdentity()).WillRepeatedly(Return("ident"));
+
+  auto rs = getTestResumptionState(cert, nullptr);
+  rs.alpn = "custom-protocol";
+  auto drs = CompactTicketCodec::decode(
+      CompactTicketCodec::encode(std::move(rs)), nullptr);
+  EXPECT_EQ(*drs.alpn, "custom-protocol");
+
+  rs = getTestResumptionState(cert, nullptr);
+  rs.alpn = none;
+  drs = CompactTicketCodec::decode(
+      CompactTicketCodec::encode(std::move(rs)), nullptr);
+  EXPECT_FALSE(drs.alpn.hasValue());
+}
+
+TEST(TicketCodecTest, TestCompactTicketId) {
+  auto cert = std::make_shared<MockSelfCert>();
+  EXPECT_CALL(*cert, getIdentity()).WillRepeatedly(Return("ident"));
+
+  auto rs = getTestResumptionState(cert, nullptr);
+  rs.ticketId = 0x0102030405060708;
+  auto drs = CompactTicketCodec::decode(
+      CompactTicketCodec::encode(std::move(rs)), nullptr);
+  EXPECT_EQ(*drs.ticketId, 0x0102030405060708);
+
+  drs = CompactTicketCodec::decode(
+      CompactTicketCodec::encode(getTestResumptionState(cert, nullptr)),
+      nullptr);
+  EXPECT_FALSE(drs.ticketId.hasValue());
+}
+
+TEST(TicketCodecTest, TestCompactDecodeBadTicket) {
+  auto cert = std::make_shared<MockSelfCert>();
+  EXPECT_CALL(*cert, getIdentity()).WillRepeatedly(Return("ident"));
+  auto encoded =
+      CompactTicketCodec::encode(getTestResumptionState(cert, nullptr));
+  encoded->coalesce();
+
+  auto truncated = encoded->clone();
+  truncated->trimEnd(1);
+  EXPECT_THROW(
+      CompactTicketCodec::decode(std::move(truncated), nullptr),
+      std::exception);
+
+  EXPECT_THROW(
+      CompactTicketCodec::decode(
+          IOBuf::copyBuffer(unhexlify("03041301ffffffffffffffffffff")),
+          nullptr),
+      std::runtime_error);
+}
 } // namespace test
 } // namespace server
 } // namespace fizz
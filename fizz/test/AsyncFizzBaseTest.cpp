@@ -10,6 +10,7 @@
 #include <gtest/gtest.h>
 
 #include <fizz/protocol/AsyncFizzBase.h>
+#include <fizz/record/EncryptedRecordLayer.h>
 
 #include <folly/io/async/test/MockAsyncTransport.h>
 #include <folly/io/async/test/MockTimeoutManager.h>
@@ -151,6 +152,141 @@ TEST_F(AsyncFizzBaseTest, TestWrite) {
   writeChain(nullptr, std::move(buf));
 }
 
+TEST_F(AsyncFizzBaseTest, TestCorkWrites) {
+  EventBase evb;
+  EXPECT_CALL(*socket_, getEventBase()).WillRepeatedly(Return(&evb));
+  setCorkWrites(20);
+
+  MockWriteCallback cb1;
+  MockWriteCallback cb2;
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _)).Times(0);
+  writeChain(&cb1, IOBuf::copyBuffer("hello"));
+  writeChain(&cb2, IOBuf::copyBuffer("world"));
+  Mock::VerifyAndClearExpectations(this);
+
+  auto expected = IOBuf::copyBuffer("helloworld");
+  AsyncTransportWrapper::WriteCallback* writeCallback = nullptr;
+  EXPECT_CALL(*this, writeAppDataInternal(_, BufMatches(expected.get()), _))
+      .WillOnce(SaveArg<0>(&writeCallback));
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  Mock::VerifyAndClearExpectations(this);
+
+  EXPECT_CALL(cb1, writeSuccess_());
+  EXPECT_CALL(cb2, writeSuccess_());
+  writeCallback->writeSuccess();
+}
+
+TEST_F(AsyncFizzBaseTest, TestCorkWritesFlush) {
+  EventBase evb;
+  EXPECT_CALL(*socket_, getEventBase()).WillRepeatedly(Return(&evb));
+  setCorkWrites(10);
+
+  auto threshold = IOBuf::copyBuffer("helloworld");
+  EXPECT_CALL(*this, writeAppDataInternal(_, BufMatches(threshold.get()), _));
+  writeChain(nullptr, IOBuf::copyBuffer("hello"));
+  writeChain(nullptr, IOBuf::copyBuffer("world"));
+
+  auto eor = IOBuf::copyBuffer("eor");
+  EXPECT_CALL(*this, writeAppDataInternal(_, BufMatches(eor.get()), _));
+  writeChain(nullptr, IOBuf::copyBuffer("eor"), WriteFlags::EOR);
+
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _)).Times(0);
+  evb.loopOnce(EVLOOP_NONBLOCK);
+}
+
+TEST_F(AsyncFizzBaseTest, TestWritePacing) {
+  MockTimeoutManager manager;
+  ON_CALL(manager, isInTimeoutManagerThread()).WillByDefault(Return(true));
+  attachTimeoutManager(&manager);
+  setWritePacing(1, kMaxPlaintextRecordSize);
+
+  MockWriteCallback cb1;
+  MockWriteCallback cb2;
+  auto record = IOBuf::create(kMaxPlaintextRecordSize);
+  record->append(kMaxPlaintextRecordSize);
+  EXPECT_CALL(*this, writeAppDataInternal(&cb1, _, _));
+  writeChain(&cb1, std::move(record));
+  Mock::VerifyAndClearExpectations(this);
+
+  // The bucket is empty, so the next write waits for 5 tokens.
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _)).Times(0);
+  EXPECT_CALL(
+      manager,
+      scheduleTimeout(
+          _,
+          AllOf(
+              Gt(std::chrono::milliseconds(4000)),
+              Le(std::chrono::milliseconds(5001)))))
+      .WillOnce(Return(true));
+  writeChain(&cb2, IOBuf::copyBuffer("hello"));
+  EXPECT_EQ(getPacedBytes(), 5);
+  Mock::VerifyAndClearExpectations(this);
+  Mock::VerifyAndClearExpectations(&manager);
+
+  auto expected = IOBuf::copyBuffer("hello");
+  EXPECT_CALL(*this, writeAppDataInternal(&cb2, BufMatches(expected.get()), _));
+  setWritePacing(0, 0);
+  EXPECT_EQ(getPacedBytes(), 0);
+  detachTimeoutManager();
+}
+
+TEST_F(AsyncFizzBaseTest, TestWritePacingFullRecords) {
+  MockTimeoutManager manager;
+  ON_CALL(manager, isInTimeoutManagerThread()).WillByDefault(Return(true));
+  attachTimeoutManager(&manager);
+  setWritePacing(1, 2 * kMaxPlaintextRecordSize + 100);
+
+  // Only whole records are released while more than one is queued.
+  MockWriteCallback cb;
+  EXPECT_CALL(*this, writeAppDataInternal(nullptr, _, _))
+      .WillOnce(Invoke([](AsyncTransportWrapper::WriteCallback*,
+                          std::shared_ptr<IOBuf> buf,
+                          WriteFlags) {
+        EXPECT_EQ(buf->computeChainDataLength(), 2 * kMaxPlaintextRecordSize);
+      }));
+  EXPECT_CALL(manager, scheduleTimeout(_, _)).WillOnce(Return(true));
+  auto data = IOBuf::create(3 * kMaxPlaintextRecordSize);
+  data->append(3 * kMaxPlaintextRecordSize);
+  writeChain(&cb, std::move(data));
+  EXPECT_EQ(getPacedBytes(), kMaxPlaintextRecordSize);
+  Mock::VerifyAndClearExpectations(this);
+
+  // Closing releases the rest regardless of the rate.
+  AsyncTransportWrapper::WriteCallback* writeCallback = nullptr;
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _))
+      .WillOnce(SaveArg<0>(&writeCallback));
+  flushCorkedWrites();
+  EXPECT_EQ(writeCallback, &cb);
+  detachTimeoutManager();
+}
+
+TEST_F(AsyncFizzBaseTest, TestWritePacingSmallBurst) {
+  EXPECT_THROW(setWritePacing(1000, 100), std::runtime_error);
+}
+
+TEST_F(AsyncFizzBaseTest, TestKTLSPassthrough) {
+  EXPECT_FALSE(kTLSEnabled());
+  startKTLSPassthrough();
+  EXPECT_TRUE(kTLSEnabled());
+
+  EXPECT_CALL(*this, writeAppDataInternal(_, _, _)).Times(0);
+  EXPECT_CALL(*socket_, writeChain(_, _, _));
+  writeChain(nullptr, IOBuf::copyBuffer("plaintext"));
+  EXPECT_EQ(getAppBytesWritten(), 9);
+
+  EXPECT_CALL(readCallback_, isBufferMovable_()).WillRepeatedly(Return(true));
+  setReadCB(&readCallback_);
+  expectTransportReadCallback();
+  startTransportReads();
+
+  auto buf = IOBuf::copyBuffer("hello");
+  EXPECT_CALL(*this, transportDataAvailable()).Times(0);
+  EXPECT_CALL(readCallback_, readBufferAvailable_(BufMatches(buf.get())));
+  transportReadCallback_->readBufferAvailable(buf->clone());
+  EXPECT_TRUE(transportReadBuf_.empty());
+  EXPECT_EQ(getAppBytesReceived(), 5);
+}
+
 TEST_F(AsyncFizzBaseTest, TestReadErr) {
   setReadCB(&readCallback_);
 
@@ -428,6 +564,50 @@ TEST_F(AsyncFizzBaseTest, TestHandshakeTimeout) {
   timeout->timeoutExpired();
 }
 
+TEST_F(AsyncFizzBaseTest, TestHandshakeTimeoutMovedOnDetach) {
+  MockTimeoutManager manager;
+  ON_CALL(manager, isInTimeoutManagerThread()).WillByDefault(Return(true));
+  attachTimeoutManager(&manager);
+  EXPECT_CALL(manager, scheduleTimeout(_, std::chrono::milliseconds(10000)))
+      .WillOnce(Return(true));
+  startHandshakeTimeout(std::chrono::milliseconds(10000));
+  detachTimeoutManager();
+
+  MockTimeoutManager newManager;
+  ON_CALL(newManager, isInTimeoutManagerThread()).WillByDefault(Return(true));
+  AsyncTimeout* timeout;
+  EXPECT_CALL(
+      newManager,
+      scheduleTimeout(
+          _,
+          AllOf(
+              Le(std::chrono::milliseconds(10000)),
+              Gt(std::chrono::milliseconds(5000)))))
+      .WillOnce(DoAll(SaveArg<0>(&timeout), Return(true)));
+  attachTimeoutManager(&newManager);
+
+  EXPECT_CALL(*this, transportError(_))
+      .WillOnce(Invoke([](const AsyncSocketException& ex) {
+        EXPECT_EQ(ex.getType(), AsyncSocketException::TIMED_OUT);
+      }));
+  timeout->timeoutExpired();
+}
+
+TEST_F(AsyncFizzBaseTest, TestHandshakeTimeoutNotMovedAfterCancel) {
+  MockTimeoutManager manager;
+  ON_CALL(manager, isInTimeoutManagerThread()).WillByDefault(Return(true));
+  attachTimeoutManager(&manager);
+  EXPECT_CALL(manager, scheduleTimeout(_, _)).WillOnce(Return(true));
+  startHandshakeTimeout(std::chrono::milliseconds(10000));
+  cancelHandshakeTimeout();
+  detachTimeoutManager();
+
+  MockTimeoutManager newManager;
+  ON_CALL(newManager, isInTimeoutManagerThread()).WillByDefault(Return(true));
+  EXPECT_CALL(newManager, scheduleTimeout(_, _)).Times(0);
+  attachTimeoutManager(&newManager);
+}
+
 TEST_F(AsyncFizzBaseTest, TestAttachEventBase) {
   EventBase evb;
   expectTransportReadCallback();
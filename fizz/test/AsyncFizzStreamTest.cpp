@@ -0,0 +1,139 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/client/AsyncFizzClient.h>
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/AsyncFizzStream.h>
+#include <fizz/server/AsyncFizzServer.h>
+#include <fizz/test/SimulatedTransport.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+class AsyncFizzStreamTest : public Test {
+ public:
+  void SetUp() override {
+    network_ = std::make_unique<SimulatedNetwork>(
+        SimulatedNetwork::LinkParams(), &evb_);
+    auto clientTransport = new SimulatedTransport(*network_);
+    auto serverTransport = new SimulatedTransport(*network_);
+    SimulatedTransport::UniquePtr clientPtr(clientTransport);
+    SimulatedTransport::UniquePtr serverPtr(serverTransport);
+    clientTransport->attachEventBase(&evb_);
+    serverTransport->attachEventBase(&evb_);
+    clientTransport->setPeer(serverTransport);
+    serverTransport->setPeer(clientTransport);
+
+    auto certManager = std::make_unique<server::CertManager>();
+    std::vector<ssl::X509UniquePtr> certs;
+    certs.emplace_back(getCert(kP256Certificate));
+    certManager->addCert(
+        std::make_shared<SelfCertImpl<KeyType::P256>>(
+            getPrivateKey(kP256Key), std::move(certs)),
+        true);
+    auto serverContext = std::make_shared<server::FizzServerContext>();
+    serverContext->setCertManager(std::move(certManager));
+    auto clientContext = std::make_shared<client::FizzClientContext>();
+
+    client_.reset(
+        new client::AsyncFizzClient(std::move(clientPtr), clientContext));
+    server_.reset(
+        new server::AsyncFizzServer(std::move(serverPtr), serverContext));
+  }
+
+ protected:
+  void handshake() {
+    auto clientDone = client_->connect(nullptr, folly::none, folly::none);
+    auto serverDone = server_->accept();
+    network_->run();
+    ASSERT_TRUE(clientDone.isReady());
+    ASSERT_TRUE(serverDone.isReady());
+    EXPECT_FALSE(clientDone.hasException());
+    EXPECT_FALSE(serverDone.hasException());
+  }
+
+  static std::string toString(const std::unique_ptr<IOBuf>& buf) {
+    return buf->moveToFbString().toStdString();
+  }
+
+  EventBase evb_;
+  std::unique_ptr<SimulatedNetwork> network_;
+  client::AsyncFizzClient::UniquePtr client_;
+  server::AsyncFizzServer::UniquePtr server_;
+};
+
+TEST_F(AsyncFizzStreamTest, TestReadWrite) {
+  handshake();
+  AsyncFizzStream clientStream(*client_);
+  AsyncFizzStream serverStream(*server_);
+
+  auto serverRead = serverStream.read();
+  EXPECT_FALSE(serverRead.isReady());
+  auto clientWrite = clientStream.write(IOBuf::copyBuffer("ping"));
+  network_->run();
+  ASSERT_TRUE(clientWrite.isReady());
+  EXPECT_FALSE(clientWrite.hasException());
+  ASSERT_TRUE(serverRead.isReady());
+  EXPECT_EQ(toString(std::move(serverRead).get()), "ping");
+  EXPECT_EQ(server_->getReadCallback(), nullptr);
+
+  auto clientRead = clientStream.read();
+  serverStream.write(IOBuf::copyBuffer("pong"));
+  network_->run();
+  ASSERT_TRUE(clientRead.isReady());
+  EXPECT_EQ(toString(std::move(clientRead).get()), "pong");
+}
+
+TEST_F(AsyncFizzStreamTest, TestReadBuffered) {
+  handshake();
+  AsyncFizzStream clientStream(*client_);
+  AsyncFizzStream serverStream(*server_);
+
+  clientStream.write(IOBuf::copyBuffer("hello"));
+  clientStream.write(IOBuf::copyBuffer("world"));
+  network_->run();
+
+  auto serverRead = serverStream.read();
+  ASSERT_TRUE(serverRead.isReady());
+  EXPECT_EQ(toString(std::move(serverRead).get()), "helloworld");
+  EXPECT_FALSE(serverStream.read().isReady());
+}
+
+TEST_F(AsyncFizzStreamTest, TestReadOutstanding) {
+  handshake();
+  AsyncFizzStream serverStream(*server_);
+
+  auto serverRead = serverStream.read();
+  auto secondRead = serverStream.read();
+  ASSERT_TRUE(secondRead.isReady());
+  EXPECT_TRUE(secondRead.hasException());
+  EXPECT_FALSE(serverRead.isReady());
+}
+
+TEST_F(AsyncFizzStreamTest, TestWritesCompleteInOrder) {
+  handshake();
+  AsyncFizzStream clientStream(*client_);
+
+  std::vector<int> completed;
+  clientStream.write(IOBuf::copyBuffer("a")).then([&]() {
+    completed.push_back(1);
+  });
+  clientStream.write(IOBuf::copyBuffer("b")).then([&]() {
+    completed.push_back(2);
+  });
+  network_->run();
+  EXPECT_EQ(completed, std::vector<int>({1, 2}));
+}
+} // namespace test
+} // namespace fizz
@@ -0,0 +1,184 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/FileUtil.h>
+#include <folly/init/Init.h>
+#include <folly/portability/GFlags.h>
+#include <folly/ssl/Init.h>
+
+#include <fizz/crypto/RandomGenerator.h>
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/TLSStats.h>
+#include <fizz/record/PlaintextRecordLayer.h>
+#include <fizz/server/AsyncFizzServer.h>
+#include <fizz/server/ClientHelloCapture.h>
+#include <fizz/server/TicketTypes.h>
+#include <fizz/test/LocalTransport.h>
+
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+using namespace fizz;
+using namespace fizz::server;
+using namespace fizz::test;
+
+DEFINE_string(
+    capture_file,
+    "",
+    "ClientHellos written with encodeClientHelloCapture(), eg from a "
+    "SampledClientHelloCapture");
+DEFINE_uint32(iterations, 10, "Times the whole capture is replayed");
+
+/**
+ * Replays captured ClientHellos into AsyncFizzServer, with the test
+ * certificates, and reports the server's first flight cost for that mix of
+ * hellos. The client side of the handshake is not run: the client's second
+ * flight depends on the server's random and can't be replayed.
+ */
+namespace {
+
+class ReplayCallback : public AsyncFizzServer::HandshakeCallback {
+ public:
+  void fizzHandshakeSuccess(AsyncFizzServer* /* server */) noexcept override {
+    LOG(FATAL) << "handshake can't complete without a client";
+  }
+
+  void fizzHandshakeError(
+      AsyncFizzServer* /* server */,
+      folly::exception_wrapper ex) noexcept override {
+    if (counting) {
+      ++errors[ex.what().toStdString()];
+    }
+  }
+
+  void fizzHandshakeAttemptFallback(
+      std::unique_ptr<folly::IOBuf> /* clientHello */) override {
+    ++errors["fallback"];
+  }
+
+  // Tearing down the connection after the first flight is not an error.
+  bool counting{true};
+  std::map<std::string, size_t> errors;
+};
+
+std::shared_ptr<FizzServerContext> makeContext() {
+  auto context = std::make_shared<FizzServerContext>();
+  auto certManager = std::make_unique<CertManager>();
+  std::vector<folly::ssl::X509UniquePtr> rsaCerts;
+  rsaCerts.emplace_back(getCert(kRSACertificate));
+  certManager->addCert(
+      std::make_shared<SelfCertImpl<KeyType::RSA>>(
+          getPrivateKey(kRSAKey), std::move(rsaCerts)),
+      true);
+  std::vector<folly::ssl::X509UniquePtr> p256Certs;
+  p256Certs.emplace_back(getCert(kP256Certificate));
+  certManager->addCert(std::make_shared<SelfCertImpl<KeyType::P256>>(
+      getPrivateKey(kP256Key), std::move(p256Certs)));
+  context->setCertManager(std::move(certManager));
+
+  // Captured tickets were issued under other keys, so PSKs are rejected and
+  // the hellos fall back to full handshakes after the ticket decrypt.
+  auto ticketCipher = std::make_shared<AES128TicketCipher>();
+  auto ticketSeed = RandomGenerator<32>().generateRandom();
+  ticketCipher->setTicketSecrets({{folly::range(ticketSeed)}});
+  ticketCipher->setValidity(std::chrono::seconds(3600));
+  context->setTicketCipher(std::move(ticketCipher));
+  return context;
+}
+
+void replay(
+    folly::EventBase& evb,
+    const std::shared_ptr<FizzServerContext>& context,
+    const folly::IOBuf& record,
+    ReplayCallback& callback) {
+  auto clientTransport = LocalTransport::UniquePtr(new LocalTransport());
+  auto serverTransport = LocalTransport::UniquePtr(new LocalTransport());
+  clientTransport->attachEventBase(&evb);
+  serverTransport->attachEventBase(&evb);
+  clientTransport->setPeer(serverTransport.get());
+  serverTransport->setPeer(clientTransport.get());
+
+  AsyncFizzServer::UniquePtr server(
+      new AsyncFizzServer(std::move(serverTransport), context));
+  callback.counting = true;
+  server->accept(&callback);
+  clientTransport->writeChain(nullptr, record.clone());
+  evb.loop();
+  callback.counting = false;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::ssl::init();
+
+  std::string contents;
+  if (FLAGS_capture_file.empty() ||
+      !folly::readFile(FLAGS_capture_file.c_str(), contents)) {
+    LOG(ERROR) << "could not read --capture_file";
+    return 1;
+  }
+  auto hellos = decodeClientHelloCapture(folly::IOBuf::copyBuffer(contents));
+  if (hellos.empty()) {
+    LOG(ERROR) << "no ClientHellos in capture";
+    return 1;
+  }
+  std::vector<Buf> records;
+  for (auto& hello : hellos) {
+    records.push_back(
+        PlaintextWriteRecordLayer().writeInitialClientHello(std::move(hello)));
+  }
+
+  const std::vector<std::pair<TLSCounter, const char*>> phases = {
+      {TLSCounter::KeyExchangeNanos, "kex"},
+      {TLSCounter::SignNanos, "sign"},
+      {TLSCounter::TicketNanos, "ticket"},
+      {TLSCounter::ClientHelloParseNanos, "chlo_parse"},
+      {TLSCounter::EncryptNanos, "encrypt"},
+  };
+
+  folly::EventBase evb;
+  auto context = makeContext();
+  ReplayCallback callback;
+  TLSStats::setTimingEnabled(true);
+  auto before = TLSStats::getThreadSnapshot();
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < FLAGS_iterations; ++i) {
+    for (const auto& record : records) {
+      replay(evb, context, *record, callback);
+    }
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  auto after = TLSStats::getThreadSnapshot();
+  TLSStats::setTimingEnabled(false);
+
+  double replayed = double(records.size()) * FLAGS_iterations;
+  double perHello = double(elapsed) / replayed;
+  std::cout << records.size() << " hellos, " << std::fixed
+            << std::setprecision(0) << 1e9 / perHello << " first flights/sec"
+            << std::endl
+            << std::setprecision(1);
+  double other = perHello;
+  for (const auto& phase : phases) {
+    double phaseNanos =
+        double(after.get(phase.first) - before.get(phase.first)) / replayed;
+    other -= phaseNanos;
+    std::cout << std::left << std::setw(12) << phase.second << std::right
+              << std::setw(10) << phaseNanos / 1000 << " us" << std::endl;
+  }
+  std::cout << std::left << std::setw(12) << "other" << std::right
+            << std::setw(10) << other / 1000 << " us" << std::endl;
+  for (const auto& error : callback.errors) {
+    std::cout << "failed " << error.second << "x: " << error.first
+              << std::endl;
+  }
+  return 0;
+}
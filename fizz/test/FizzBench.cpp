@@ -0,0 +1,382 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <fizz/client/AsyncFizzClient.h>
+#include <fizz/server/test/Utils.h>
+#include <folly/Random.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/ssl/Init.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <deque>
+
+DEFINE_string(
+    mode,
+    "loopback",
+    "server: echo data back to clients, client: connect to -host, loopback: "
+    "both in one process");
+DEFINE_string(host, "localhost", "host to connect to in client mode");
+DEFINE_int32(port, 0, "port to listen on or connect to (0: any in loopback)");
+DEFINE_int32(connections, 1, "number of parallel connections");
+DEFINE_int32(write_size, 16384, "bytes per write");
+DEFINE_int32(pipeline, 8, "writes in flight per connection");
+DEFINE_string(pattern, "random", "write payload: zero, text or random");
+DEFINE_int32(duration, 10, "seconds to stream data for");
+
+using namespace fizz;
+using namespace fizz::client;
+using namespace fizz::server;
+using namespace folly;
+
+/**
+ * Benchmark of bulk transfer over AsyncFizz sockets. Clients write
+ * -write_size chunks, keeping -pipeline of them in flight, and the server
+ * echoes everything back. Latency is the time from a write until the last
+ * byte of its echo is read, so it only ever compares timestamps taken on the
+ * client. Throughput is counted in one direction, as echoed bytes read.
+ */
+namespace {
+
+class EchoCallbackFactory
+    : public fizz::server::test::FizzTestServer::CallbackFactory {
+ public:
+  AsyncFizzServer::HandshakeCallback* getCallback(
+      std::shared_ptr<AsyncFizzServer> server) override {
+    return new Callback(std::move(server));
+  }
+
+ private:
+  class Callback : public AsyncFizzServer::HandshakeCallback,
+                   public AsyncTransportWrapper::ReadCallback {
+   public:
+    explicit Callback(std::shared_ptr<AsyncFizzServer> server)
+        : server_(std::move(server)) {}
+
+    void fizzHandshakeSuccess(AsyncFizzServer* server) noexcept override {
+      server->setReadCB(this);
+    }
+
+    void fizzHandshakeError(
+        AsyncFizzServer* /*server*/,
+        folly::exception_wrapper ex) noexcept override {
+      LOG(ERROR) << "Handshake error: " << ex.what();
+      delete this;
+    }
+
+    void fizzHandshakeAttemptFallback(
+        std::unique_ptr<folly::IOBuf> /*clientHello*/) override {
+      LOG(ERROR) << "Unexpected fallback";
+      delete this;
+    }
+
+    void getReadBuffer(void**, size_t*) override {
+      throw std::runtime_error("getReadBuffer not implemented");
+    }
+
+    void readDataAvailable(size_t) noexcept override {
+      throw std::runtime_error("readDataAvailable not implemented");
+    }
+
+    bool isBufferMovable() noexcept override {
+      return true;
+    }
+
+    void readBufferAvailable(std::unique_ptr<IOBuf> buf) noexcept override {
+      server_->writeChain(nullptr, std::move(buf));
+    }
+
+    void readEOF() noexcept override {
+      delete this;
+    }
+
+    void readErr(const AsyncSocketException& ex) noexcept override {
+      LOG(ERROR) << "Read error: " << ex.what();
+      delete this;
+    }
+
+   private:
+    std::shared_ptr<AsyncFizzServer> server_;
+  };
+};
+
+using Clock = std::chrono::steady_clock;
+
+struct Results {
+  uint64_t bytesRead{0};
+  std::vector<uint64_t> latenciesNanos;
+};
+
+class Connection : public AsyncSocket::ConnectCallback,
+                   public AsyncFizzClient::HandshakeCallback,
+                   public AsyncTransportWrapper::ReadCallback {
+ public:
+  Connection(
+      EventBase* evb,
+      std::shared_ptr<FizzClientContext> clientContext,
+      const IOBuf& payload,
+      Results& results,
+      folly::Function<void()> onHandshake)
+      : evb_(evb),
+        clientContext_(std::move(clientContext)),
+        payload_(payload),
+        results_(results),
+        onHandshake_(std::move(onHandshake)) {}
+
+  void connect(const SocketAddress& addr) {
+    sock_ = AsyncSocket::UniquePtr(new AsyncSocket(evb_));
+    sock_->connect(this, addr);
+  }
+
+  void start() {
+    running_ = true;
+    for (int i = 0; i < FLAGS_pipeline; ++i) {
+      write();
+    }
+  }
+
+  void stop() {
+    running_ = false;
+    if (transport_) {
+      transport_->setReadCB(nullptr);
+      transport_->closeNow();
+    }
+  }
+
+  void connectErr(const AsyncSocketException& ex) noexcept override {
+    LOG(FATAL) << "Connect error: " << ex.what();
+  }
+
+  void connectSuccess() noexcept override {
+    sock_->setNoDelay(true);
+    transport_ = AsyncFizzClient::UniquePtr(
+        new AsyncFizzClient(std::move(sock_), clientContext_));
+    transport_->connect(this, nullptr, folly::none, folly::none);
+  }
+
+  void fizzHandshakeSuccess(AsyncFizzClient* /*client*/) noexcept override {
+    transport_->setReadCB(this);
+    onHandshake_();
+  }
+
+  void fizzHandshakeError(
+      AsyncFizzClient* /*client*/,
+      folly::exception_wrapper ex) noexcept override {
+    LOG(FATAL) << "Handshake error: " << ex.what();
+  }
+
+  void getReadBuffer(void**, size_t*) override {
+    CHECK(false) << __func__ << " should not be invoked";
+  }
+
+  void readDataAvailable(size_t) noexcept override {
+    CHECK(false) << __func__ << " should not be invoked";
+  }
+
+  bool isBufferMovable() noexcept override {
+    return true;
+  }
+
+  void readBufferAvailable(std::unique_ptr<IOBuf> buf) noexcept override {
+    bytesRead_ += buf->computeChainDataLength();
+    if (!running_) {
+      return;
+    }
+    auto now = Clock::now();
+    size_t completed = 0;
+    while (!inFlight_.empty() && inFlight_.front().first <= bytesRead_) {
+      results_.bytesRead += FLAGS_write_size;
+      results_.latenciesNanos.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              now - inFlight_.front().second)
+              .count());
+      inFlight_.pop_front();
+      ++completed;
+    }
+    for (size_t i = 0; i < completed; ++i) {
+      write();
+    }
+  }
+
+  void readEOF() noexcept override {
+    if (running_) {
+      LOG(ERROR) << "Unexpected EOF";
+    }
+  }
+
+  void readErr(const AsyncSocketException& ex) noexcept override {
+    if (running_) {
+      LOG(ERROR) << "Read error: " << ex.what();
+    }
+  }
+
+ private:
+  void write() {
+    bytesWritten_ += payload_.length();
+    inFlight_.emplace_back(bytesWritten_, Clock::now());
+    transport_->writeChain(nullptr, payload_.clone());
+  }
+
+  EventBase* evb_;
+  std::shared_ptr<FizzClientContext> clientContext_;
+  const IOBuf& payload_;
+  Results& results_;
+  folly::Function<void()> onHandshake_;
+  AsyncSocket::UniquePtr sock_;
+  AsyncFizzClient::UniquePtr transport_;
+
+  bool running_{false};
+  uint64_t bytesWritten_{0};
+  uint64_t bytesRead_{0};
+  // Stream offset just past each write in flight, and when it was written.
+  std::deque<std::pair<uint64_t, Clock::time_point>> inFlight_;
+};
+
+std::unique_ptr<IOBuf> makePayload() {
+  auto payload = IOBuf::create(FLAGS_write_size);
+  payload->append(FLAGS_write_size);
+  auto data = payload->writableData();
+  if (FLAGS_pattern == "zero") {
+    std::fill_n(data, FLAGS_write_size, 0);
+  } else if (FLAGS_pattern == "text") {
+    for (int i = 0; i < FLAGS_write_size; ++i) {
+      data[i] = 'a' + i % 26;
+    }
+  } else if (FLAGS_pattern == "random") {
+    for (int i = 0; i < FLAGS_write_size; ++i) {
+      data[i] = folly::Random::rand32();
+    }
+  } else {
+    LOG(FATAL) << "Unknown pattern " << FLAGS_pattern;
+  }
+  return payload;
+}
+
+std::chrono::nanoseconds cpuTime() {
+  struct rusage usage;
+  CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+  auto toNanos = [](const struct timeval& tv) {
+    return std::chrono::seconds(tv.tv_sec) +
+        std::chrono::microseconds(tv.tv_usec);
+  };
+  return toNanos(usage.ru_utime) + toNanos(usage.ru_stime);
+}
+
+void printResults(
+    Results& results,
+    std::chrono::nanoseconds elapsed,
+    std::chrono::nanoseconds cpu) {
+  auto& latencies = results.latenciesNanos;
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) -> double {
+    if (latencies.empty()) {
+      return 0;
+    }
+    auto index = std::min<size_t>(latencies.size() * p, latencies.size() - 1);
+    return latencies[index] / 1000.0;
+  };
+
+  LOG(INFO) << "connections: " << FLAGS_connections
+            << ", write size: " << FLAGS_write_size
+            << ", pipeline: " << FLAGS_pipeline
+            << ", pattern: " << FLAGS_pattern;
+  LOG(INFO) << "throughput: "
+            << results.bytesRead * 8.0 / elapsed.count() << " Gbps ("
+            << results.bytesRead << " bytes in "
+            << elapsed.count() / 1e9 << "s)";
+  LOG(INFO) << "cpu: "
+            << (results.bytesRead ? double(cpu.count()) / results.bytesRead
+                                  : 0)
+            << " ns/byte (" << cpu.count() / 1e9 << "s"
+            << (FLAGS_mode == "loopback" ? ", client and server" : "")
+            << ")";
+  LOG(INFO) << "write to read latency: p50 " << percentile(0.5)
+            << "us, p99 " << percentile(0.99) << "us, p999 "
+            << percentile(0.999) << "us (" << latencies.size() << " writes)";
+}
+
+int runClients(const SocketAddress& addr) {
+  auto clientContext = std::make_shared<FizzClientContext>();
+  auto payload = makePayload();
+
+  EventBase evb;
+  Results results;
+  std::vector<std::unique_ptr<Connection>> connections;
+  Clock::time_point start;
+  std::chrono::nanoseconds startCpu;
+  int handshakes = 0;
+  for (int i = 0; i < FLAGS_connections; ++i) {
+    connections.push_back(std::make_unique<Connection>(
+        &evb, clientContext, *payload, results, [&]() {
+          if (++handshakes < FLAGS_connections) {
+            return;
+          }
+          // Only measure once every connection is set up.
+          start = Clock::now();
+          startCpu = cpuTime();
+          for (auto& conn : connections) {
+            conn->start();
+          }
+          evb.runAfterDelay(
+              [&]() {
+                auto elapsed = Clock::now() - start;
+                auto cpu = cpuTime() - startCpu;
+                for (auto& conn : connections) {
+                  conn->stop();
+                }
+                printResults(results, elapsed, cpu);
+                evb.terminateLoopSoon();
+              },
+              FLAGS_duration * 1000);
+        }));
+    connections.back()->connect(addr);
+  }
+  evb.loopForever();
+  return 0;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+  // Works around some platforms where it doesn't log by default.
+  FLAGS_logtostderr = true;
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  folly::ssl::init();
+
+  CHECK_GT(FLAGS_connections, 0);
+  CHECK_GT(FLAGS_write_size, 0);
+  CHECK_GT(FLAGS_pipeline, 0);
+
+  EchoCallbackFactory factory;
+  if (FLAGS_mode == "server") {
+    EventBase evb;
+    fizz::server::test::FizzTestServer server(evb, &factory, FLAGS_port);
+    LOG(INFO) << "Serving on " << server.getAddress();
+    evb.loopForever();
+    return 0;
+  } else if (FLAGS_mode == "client") {
+    return runClients(SocketAddress(FLAGS_host, FLAGS_port, true));
+  } else if (FLAGS_mode == "loopback") {
+    folly::ScopedEventBaseThread serverThread;
+    std::unique_ptr<fizz::server::test::FizzTestServer> server;
+    SocketAddress addr;
+    serverThread.getEventBase()->runInEventBaseThreadAndWait([&]() {
+      server = std::make_unique<fizz::server::test::FizzTestServer>(
+          *serverThread.getEventBase(), &factory, FLAGS_port);
+      addr = server->getAddress();
+    });
+    addr.setFromIpPort("127.0.0.1", addr.getPort());
+    auto ret = runClients(addr);
+    serverThread.getEventBase()->runInEventBaseThreadAndWait(
+        [&]() { server.reset(); });
+    return ret;
+  }
+  LOG(ERROR) << "Unknown mode " << FLAGS_mode;
+  return 1;
+}
@@ -0,0 +1,295 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include <folly/portability/GFlags.h>
+#include <folly/ssl/Init.h>
+
+#include <fizz/client/AsyncFizzClient.h>
+#include <fizz/crypto/RandomGenerator.h>
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/protocol/TLSStats.h>
+#include <fizz/server/AsyncFizzServer.h>
+#include <fizz/server/ReplayCache.h>
+#include <fizz/server/TicketTypes.h>
+#include <fizz/test/LocalTransport.h>
+
+#include <iomanip>
+#include <iostream>
+
+using namespace fizz;
+using namespace fizz::client;
+using namespace fizz::server;
+using namespace fizz::test;
+
+DEFINE_uint32(
+    phase_handshakes,
+    1000,
+    "Handshakes run per scenario for the per-phase CPU breakdown printed "
+    "after the benchmarks, 0 to skip it");
+
+namespace {
+
+enum class Scenario {
+  EcdheRsa,
+  EcdheEcdsa,
+  PskDhe,
+  PskOnly,
+  Hrr,
+  EarlyData,
+};
+
+const char* scenarioName(Scenario scenario) {
+  switch (scenario) {
+    case Scenario::EcdheRsa:
+      return "ecdhe_rsa";
+    case Scenario::EcdheEcdsa:
+      return "ecdhe_ecdsa";
+    case Scenario::PskDhe:
+      return "psk_dhe";
+    case Scenario::PskOnly:
+      return "psk_only";
+    case Scenario::Hrr:
+      return "hrr";
+    case Scenario::EarlyData:
+      return "early_data";
+  }
+  return "unknown";
+}
+
+class ClientCallback : public AsyncFizzClient::HandshakeCallback {
+ public:
+  explicit ClientCallback(bool writeEarlyData)
+      : writeEarlyData_(writeEarlyData) {}
+
+  void fizzHandshakeSuccess(AsyncFizzClient* client) noexcept override {
+    if (writeEarlyData_ && !client->isReplaySafe()) {
+      client->writeChain(nullptr, folly::IOBuf::copyBuffer("early"));
+    }
+  }
+
+  void fizzHandshakeError(
+      AsyncFizzClient* /* client */,
+      folly::exception_wrapper ex) noexcept override {
+    LOG(FATAL) << "client handshake error: " << ex.what();
+  }
+
+ private:
+  bool writeEarlyData_;
+};
+
+class ServerCallback : public AsyncFizzServer::HandshakeCallback {
+ public:
+  void fizzHandshakeSuccess(AsyncFizzServer* /* server */) noexcept override {
+    ++handshakes;
+  }
+
+  void fizzHandshakeError(
+      AsyncFizzServer* /* server */,
+      folly::exception_wrapper ex) noexcept override {
+    LOG(FATAL) << "server handshake error: " << ex.what();
+  }
+
+  void fizzHandshakeAttemptFallback(
+      std::unique_ptr<folly::IOBuf> /* clientHello */) override {
+    LOG(FATAL) << "unexpected fallback";
+  }
+
+  size_t handshakes{0};
+};
+
+/**
+ * A client and server context set up for one scenario, and in-memory
+ * connections between them. Resumption scenarios do a full handshake first
+ * so that the client has a ticket; every resumption then gets a new one.
+ */
+class HandshakeRunner {
+ public:
+  explicit HandshakeRunner(Scenario scenario) : scenario_(scenario) {
+    clientContext_ = std::make_shared<FizzClientContext>();
+    serverContext_ = std::make_shared<FizzServerContext>();
+    clientContext_->setPskCache(std::make_shared<BasicPskCache>());
+
+    auto certManager = std::make_unique<CertManager>();
+    std::vector<folly::ssl::X509UniquePtr> rsaCerts;
+    rsaCerts.emplace_back(getCert(kRSACertificate));
+    certManager->addCert(
+        std::make_shared<SelfCertImpl<KeyType::RSA>>(
+            getPrivateKey(kRSAKey), std::move(rsaCerts)),
+        true);
+    std::vector<folly::ssl::X509UniquePtr> p256Certs;
+    p256Certs.emplace_back(getCert(kP256Certificate));
+    certManager->addCert(std::make_shared<SelfCertImpl<KeyType::P256>>(
+        getPrivateKey(kP256Key), std::move(p256Certs)));
+    serverContext_->setCertManager(std::move(certManager));
+
+    auto ticketCipher = std::make_shared<AES128TicketCipher>();
+    auto ticketSeed = RandomGenerator<32>().generateRandom();
+    ticketCipher->setTicketSecrets({{folly::range(ticketSeed)}});
+    ticketCipher->setValidity(std::chrono::seconds(3600));
+    serverContext_->setTicketCipher(std::move(ticketCipher));
+
+    switch (scenario_) {
+      case Scenario::EcdheRsa:
+        clientContext_->setSupportedSigSchemes(
+            {SignatureScheme::rsa_pss_sha256});
+        serverContext_->setSupportedSigSchemes(
+            {SignatureScheme::rsa_pss_sha256});
+        break;
+      case Scenario::EcdheEcdsa:
+        clientContext_->setSupportedSigSchemes(
+            {SignatureScheme::ecdsa_secp256r1_sha256});
+        serverContext_->setSupportedSigSchemes(
+            {SignatureScheme::ecdsa_secp256r1_sha256});
+        break;
+      case Scenario::PskDhe:
+        break;
+      case Scenario::PskOnly:
+        clientContext_->setSupportedPskModes({PskKeyExchangeMode::psk_ke});
+        serverContext_->setSupportedPskModes({PskKeyExchangeMode::psk_ke});
+        break;
+      case Scenario::Hrr:
+        clientContext_->setDefaultShares({});
+        break;
+      case Scenario::EarlyData:
+        clientContext_->setSendEarlyData(true);
+        serverContext_->setEarlyDataSettings(
+            true,
+            {std::chrono::seconds(-60), std::chrono::seconds(60)},
+            std::make_shared<AllowAllReplayReplayCache>());
+        break;
+    }
+
+    if (resumes()) {
+      handshake();
+    }
+  }
+
+  bool resumes() const {
+    return scenario_ == Scenario::PskDhe || scenario_ == Scenario::PskOnly ||
+        scenario_ == Scenario::EarlyData;
+  }
+
+  void handshake() {
+    auto clientTransport = LocalTransport::UniquePtr(new LocalTransport());
+    auto serverTransport = LocalTransport::UniquePtr(new LocalTransport());
+    clientTransport->attachEventBase(&evb_);
+    serverTransport->attachEventBase(&evb_);
+    clientTransport->setPeer(serverTransport.get());
+    serverTransport->setPeer(clientTransport.get());
+
+    AsyncFizzClient::UniquePtr client(
+        new AsyncFizzClient(std::move(clientTransport), clientContext_));
+    AsyncFizzServer::UniquePtr server(
+        new AsyncFizzServer(std::move(serverTransport), serverContext_));
+
+    ClientCallback clientCallback(scenario_ == Scenario::EarlyData);
+    ServerCallback serverCallback;
+    client->connect(
+        &clientCallback, nullptr, folly::none, std::string("Fizz"));
+    server->accept(&serverCallback);
+    evb_.loop();
+    CHECK_EQ(serverCallback.handshakes, 1);
+  }
+
+ private:
+  Scenario scenario_;
+  folly::EventBase evb_;
+  std::shared_ptr<FizzClientContext> clientContext_;
+  std::shared_ptr<FizzServerContext> serverContext_;
+};
+
+void runHandshakes(uint32_t n, Scenario scenario) {
+  folly::Optional<HandshakeRunner> runner;
+  BENCHMARK_SUSPEND {
+    runner.emplace(scenario);
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    runner->handshake();
+  }
+  BENCHMARK_SUSPEND {
+    runner.clear();
+  }
+}
+
+/**
+ * Prints handshakes/sec for client and server together on this thread, and
+ * the time per handshake spent in each phase TLSStats times.
+ */
+void printPhases(const std::vector<Scenario>& scenarios) {
+  const std::vector<std::pair<TLSCounter, const char*>> phases = {
+      {TLSCounter::KeyExchangeNanos, "kex"},
+      {TLSCounter::SignNanos, "sign"},
+      {TLSCounter::TicketNanos, "ticket"},
+      {TLSCounter::ClientHelloParseNanos, "chlo_parse"},
+      {TLSCounter::EncryptNanos, "encrypt"},
+      {TLSCounter::DecryptNanos, "decrypt"},
+  };
+
+  std::cout << std::endl << std::left << std::setw(14) << "scenario"
+            << std::right << std::setw(12) << "hs/sec";
+  for (const auto& phase : phases) {
+    std::cout << std::setw(12) << phase.second;
+  }
+  std::cout << std::setw(12) << "other" << "  (us per handshake)"
+            << std::endl;
+
+  TLSStats::setTimingEnabled(true);
+  for (auto scenario : scenarios) {
+    HandshakeRunner runner(scenario);
+    auto before = TLSStats::getThreadSnapshot();
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < FLAGS_phase_handshakes; ++i) {
+      runner.handshake();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    auto after = TLSStats::getThreadSnapshot();
+
+    double perHandshake = double(elapsed) / FLAGS_phase_handshakes;
+    std::cout << std::left << std::setw(14) << scenarioName(scenario)
+              << std::right << std::setw(12) << std::fixed
+              << std::setprecision(0) << 1e9 / perHandshake
+              << std::setprecision(1);
+    double other = perHandshake;
+    for (const auto& phase : phases) {
+      double phaseNanos = double(after.get(phase.first) -
+                                 before.get(phase.first)) /
+          FLAGS_phase_handshakes;
+      other -= phaseNanos;
+      std::cout << std::setw(12) << phaseNanos / 1000;
+    }
+    std::cout << std::setw(12) << other / 1000 << std::endl;
+  }
+  TLSStats::setTimingEnabled(false);
+}
+} // namespace
+
+BENCHMARK_NAMED_PARAM(runHandshakes, ecdhe_rsa, Scenario::EcdheRsa)
+BENCHMARK_NAMED_PARAM(runHandshakes, ecdhe_ecdsa, Scenario::EcdheEcdsa)
+BENCHMARK_NAMED_PARAM(runHandshakes, psk_dhe, Scenario::PskDhe)
+BENCHMARK_NAMED_PARAM(runHandshakes, psk_only, Scenario::PskOnly)
+BENCHMARK_NAMED_PARAM(runHandshakes, hrr, Scenario::Hrr)
+BENCHMARK_NAMED_PARAM(runHandshakes, early_data, Scenario::EarlyData)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::ssl::init();
+  folly::runBenchmarks();
+  if (FLAGS_phase_handshakes > 0) {
+    printPhases({Scenario::EcdheRsa,
+                 Scenario::EcdheEcdsa,
+                 Scenario::PskDhe,
+                 Scenario::PskOnly,
+                 Scenario::Hrr,
+                 Scenario::EarlyData});
+  }
+  return 0;
+}
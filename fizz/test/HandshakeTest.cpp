@@ -17,6 +17,7 @@
 #include <fizz/extensions/tokenbinding/TokenBindingClientExtension.h>
 #include <fizz/extensions/tokenbinding/TokenBindingContext.h>
 #include <fizz/extensions/tokenbinding/TokenBindingServerExtension.h>
+#include <fizz/protocol/DtlsFactory.h>
 #include <fizz/protocol/test/Matchers.h>
 #include <fizz/protocol/test/Utilities.h>
 #include <fizz/server/AsyncFizzServer.h>
@@ -79,6 +80,16 @@ class HandshakeTest : public Test {
         getPrivateKey(kP384Key), std::move(p384Certs)));
     certManager->addCert(std::make_shared<SelfCertImpl<KeyType::P521>>(
         getPrivateKey(kP521Key), std::move(p521Certs)));
+#if FIZZ_OPENSSL_HAS_ED25519
+    std::vector<ssl::X509UniquePtr> ed25519Certs;
+    std::vector<ssl::X509UniquePtr> ed448Certs;
+    ed25519Certs.emplace_back(getCert(kEd25519Certificate));
+    ed448Certs.emplace_back(getCert(kEd448Certificate));
+    certManager->addCert(std::make_shared<SelfCertImpl<KeyType::ED25519>>(
+        getPrivateKey(kEd25519Key), std::move(ed25519Certs)));
+    certManager->addCert(std::make_shared<SelfCertImpl<KeyType::ED448>>(
+        getPrivateKey(kEd448Key), std::move(ed448Certs)));
+#endif
     serverContext_->setCertManager(std::move(certManager));
     serverContext_->setEarlyDataSettings(
         true,
@@ -397,6 +408,29 @@ TEST_F(HandshakeTest, BasicHandshakeTrickle) {
   sendAppData();
 }
 
+TEST_F(HandshakeTest, Dtls) {
+  auto factory = std::make_shared<DtlsFactory>();
+  clientContext_->setFactory(factory);
+  serverContext_->setFactory(factory);
+  // Update the server's keys before every write, to move to the next epoch.
+  KeyUpdateLimits limits;
+  limits.maxRecords = 1;
+  serverContext_->setKeyUpdateLimits(limits);
+
+  expectSuccess();
+  doHandshake();
+  verifyParameters();
+  sendAppData();
+  expectClientRead("moreserverdata");
+  expectServerRead("moreclientdata");
+  clientWrite("moreclientdata");
+  serverWrite("moreserverdata");
+
+  auto clientEkm = client_->getEkm("EXPORTER-Some-Label", nullptr, 32);
+  auto serverEkm = server_->getEkm("EXPORTER-Some-Label", nullptr, 32);
+  EXPECT_TRUE(IOBufEqualTo()(clientEkm, serverEkm));
+}
+
 TEST_F(HandshakeTest, P256) {
   clientContext_->setSupportedGroups(
       {NamedGroup::x25519, NamedGroup::secp256r1});
@@ -1014,5 +1048,12 @@ INSTANTIATE_TEST_CASE_P(
         SignatureScheme::ecdsa_secp256r1_sha256,
         SignatureScheme::ecdsa_secp384r1_sha384,
         SignatureScheme::ecdsa_secp521r1_sha512));
+
+#if FIZZ_OPENSSL_HAS_ED25519
+INSTANTIATE_TEST_CASE_P(
+    EdSignatureSchemes,
+    SigSchemeTest,
+    ::testing::Values(SignatureScheme::ed25519, SignatureScheme::ed448));
+#endif
 } // namespace test
 } // namespace fizz
@@ -0,0 +1,327 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <folly/io/async/AsyncTransport.h>
+#include <folly/io/async/EventBase.h>
+
+#include <chrono>
+#include <map>
+#include <random>
+
+namespace fizz {
+namespace test {
+
+class SimulatedTransport;
+
+/**
+ * Virtual clock and in flight data shared by SimulatedTransports. Nothing is
+ * delivered until run() is called, which advances the clock from one
+ * delivery to the next, so the timing of a run depends only on the link
+ * parameters and the seed.
+ */
+class SimulatedNetwork {
+ public:
+  using Duration = std::chrono::microseconds;
+
+  /**
+   * Parameters of each direction of a link.
+   */
+  struct LinkParams {
+    Duration rtt{0};
+    // Bytes per second, 0 for unlimited.
+    uint64_t bandwidth{0};
+    // Each segment is lost with this probability, which is modeled as it
+    // arriving retransmitDelay late (and holding up the segments after it).
+    double lossRate{0};
+    Duration retransmitDelay{std::chrono::milliseconds(200)};
+    size_t mtu{1460};
+    // Most bytes handed to the read callback at once, 0 for no limit.
+    size_t maxReadChunk{0};
+  };
+
+  explicit SimulatedNetwork(
+      LinkParams params,
+      folly::EventBase* evb = nullptr,
+      uint32_t seed = 0)
+      : params_(params), evb_(evb), random_(seed) {}
+
+  const LinkParams& getParams() const {
+    return params_;
+  }
+
+  Duration now() const {
+    return now_;
+  }
+
+  /**
+   * Delivers data until nothing is in flight. Work queued on the EventBase
+   * (if set) is run before every delivery, at the current virtual time.
+   */
+  void run() {
+    drainEventBase();
+    while (!inFlight_.empty()) {
+      auto it = inFlight_.begin();
+      now_ = it->first.first;
+      auto target = it->second.target;
+      auto data = std::move(it->second.data);
+      inFlight_.erase(it);
+      deliver(target, std::move(data));
+      drainEventBase();
+    }
+  }
+
+ private:
+  friend class SimulatedTransport;
+
+  struct Delivery {
+    SimulatedTransport* target;
+    std::unique_ptr<folly::IOBuf> data;
+  };
+
+  void send(
+      SimulatedTransport* target,
+      Duration arrival,
+      std::unique_ptr<folly::IOBuf> data) {
+    inFlight_.emplace(
+        std::make_pair(arrival, nextSeq_++),
+        Delivery{target, std::move(data)});
+  }
+
+  bool lose() {
+    return params_.lossRate > 0 &&
+        std::uniform_real_distribution<double>(0, 1)(random_) <
+        params_.lossRate;
+  }
+
+  void cancel(SimulatedTransport* target) {
+    for (auto it = inFlight_.begin(); it != inFlight_.end();) {
+      if (it->second.target == target) {
+        it = inFlight_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void drainEventBase() {
+    if (evb_) {
+      evb_->loopOnce(EVLOOP_NONBLOCK);
+    }
+  }
+
+  void deliver(SimulatedTransport* target, std::unique_ptr<folly::IOBuf> data);
+
+  LinkParams params_;
+  folly::EventBase* evb_;
+  std::mt19937 random_;
+  Duration now_{0};
+  uint64_t nextSeq_{0};
+  std::map<std::pair<Duration, uint64_t>, Delivery> inFlight_;
+};
+
+/**
+ * Transport over a SimulatedNetwork. Writes are cut into MTU sized segments
+ * that leave at the link bandwidth and arrive in order half an RTT later.
+ * Write callbacks complete immediately, as if the data had been copied to a
+ * socket buffer.
+ */
+class SimulatedTransport : public folly::AsyncTransportWrapper {
+ public:
+  using UniquePtr = std::unique_ptr<SimulatedTransport, Destructor>;
+
+  explicit SimulatedTransport(SimulatedNetwork& network) : network_(network) {}
+
+  void setPeer(SimulatedTransport* peer) {
+    peer_ = peer;
+  }
+
+  /**
+   * Virtual time at which the last byte was received.
+   */
+  SimulatedNetwork::Duration lastReceiveTime() const {
+    return lastReceive_;
+  }
+
+  void receiveData(std::unique_ptr<folly::IOBuf> buf) {
+    received_ += buf->computeChainDataLength();
+    lastReceive_ = network_.now();
+    readBuf_.append(std::move(buf));
+    deliverData();
+  }
+
+  ReadCallback* getReadCallback() const override {
+    return callback_;
+  }
+
+  void setReadCB(ReadCallback* callback) override {
+    callback_ = callback;
+    if (callback_) {
+      CHECK(callback->isBufferMovable());
+      deliverData();
+    }
+  }
+
+  void write(
+      WriteCallback* /*callback*/,
+      const void* /*buf*/,
+      size_t /*bytes*/,
+      folly::WriteFlags /*flags*/ = folly::WriteFlags::NONE) override {
+    LOG(FATAL) << "only writeChain() supported";
+  }
+
+  void writeChain(
+      WriteCallback* callback,
+      std::unique_ptr<folly::IOBuf>&& buf,
+      folly::WriteFlags /*flags*/ = folly::WriteFlags::NONE) override {
+    const auto& params = network_.getParams();
+    folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+    queue.append(std::move(buf));
+    written_ += queue.chainLength();
+    while (!queue.empty()) {
+      auto segment = queue.splitAtMost(std::max<size_t>(params.mtu, 1));
+      auto length = segment->computeChainDataLength();
+      auto departure = std::max(network_.now(), linkFree_);
+      if (params.bandwidth != 0) {
+        departure += SimulatedNetwork::Duration(
+            (length * 1000000 + params.bandwidth - 1) / params.bandwidth);
+      }
+      linkFree_ = departure;
+      auto arrival = departure + params.rtt / 2;
+      if (network_.lose()) {
+        arrival += params.retransmitDelay;
+      }
+      // TCP delivers in order, so a late segment holds up the rest.
+      arrival = std::max(arrival, lastArrival_);
+      lastArrival_ = arrival;
+      network_.send(peer_, arrival, std::move(segment));
+    }
+    if (callback) {
+      callback->writeSuccess();
+    }
+  }
+
+  void writev(
+      WriteCallback* /*callback*/,
+      const iovec* /*vec*/,
+      size_t /*bytes*/,
+      folly::WriteFlags /*flags*/ = folly::WriteFlags::NONE) override {
+    LOG(FATAL) << "only writeChain() supported";
+  }
+
+  folly::EventBase* getEventBase() const override {
+    return evb_;
+  }
+
+  void attachEventBase(folly::EventBase* eventBase) override {
+    evb_ = eventBase;
+  }
+
+  void close() override {}
+
+  void closeNow() override {}
+
+  void closeWithReset() override {}
+
+  bool connecting() const override {
+    return false;
+  }
+
+  void detachEventBase() override {
+    evb_ = nullptr;
+  }
+
+  bool error() const override {
+    return false;
+  }
+
+  size_t getAppBytesReceived() const override {
+    return received_;
+  }
+
+  size_t getAppBytesWritten() const override {
+    return written_;
+  }
+
+  void getLocalAddress(folly::SocketAddress*) const override {}
+
+  void getPeerAddress(folly::SocketAddress*) const override {}
+
+  size_t getRawBytesReceived() const override {
+    return received_;
+  }
+
+  size_t getRawBytesWritten() const override {
+    return written_;
+  }
+
+  uint32_t getSendTimeout() const override {
+    return 0;
+  }
+
+  bool good() const override {
+    return true;
+  }
+
+  bool isDetachable() const override {
+    return true;
+  }
+
+  bool isEorTrackingEnabled() const override {
+    return false;
+  }
+
+  bool readable() const override {
+    return true;
+  }
+
+  void setEorTracking(bool) override {}
+
+  void setSendTimeout(uint32_t) override {}
+
+  void shutdownWrite() override {}
+
+  void shutdownWriteNow() override {}
+
+ protected:
+  ~SimulatedTransport() override {
+    network_.cancel(this);
+  }
+
+ private:
+  void deliverData() {
+    auto chunk = network_.getParams().maxReadChunk;
+    while (callback_ && !readBuf_.empty()) {
+      if (chunk == 0) {
+        callback_->readBufferAvailable(readBuf_.move());
+      } else {
+        callback_->readBufferAvailable(readBuf_.splitAtMost(chunk));
+      }
+    }
+  }
+
+  SimulatedNetwork& network_;
+  SimulatedTransport* peer_{nullptr};
+  folly::EventBase* evb_{nullptr};
+  size_t received_{0};
+  size_t written_{0};
+  SimulatedNetwork::Duration linkFree_{0};
+  SimulatedNetwork::Duration lastArrival_{0};
+  SimulatedNetwork::Duration lastReceive_{0};
+  folly::IOBufQueue readBuf_{folly::IOBufQueue::cacheChainLength()};
+  ReadCallback* callback_{nullptr};
+};
+
+inline void SimulatedNetwork::deliver(
+    SimulatedTransport* target,
+    std::unique_ptr<folly::IOBuf> data) {
+  target->receiveData(std::move(data));
+}
+} // namespace test
+} // namespace fizz
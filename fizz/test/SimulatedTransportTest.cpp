@@ -0,0 +1,196 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fizz/client/AsyncFizzClient.h>
+#include <fizz/client/test/Mocks.h>
+#include <fizz/crypto/test/TestUtil.h>
+#include <fizz/server/AsyncFizzServer.h>
+#include <fizz/server/test/Mocks.h>
+#include <fizz/test/SimulatedTransport.h>
+
+using namespace folly;
+using namespace testing;
+
+namespace fizz {
+namespace test {
+
+using namespace std::chrono;
+
+class RecordingReadCallback : public AsyncTransportWrapper::ReadCallback {
+ public:
+  explicit RecordingReadCallback(const SimulatedNetwork& network)
+      : network_(network) {}
+
+  void getReadBuffer(void**, size_t*) override {
+    LOG(FATAL) << "buffer should be movable";
+  }
+
+  void readDataAvailable(size_t) noexcept override {}
+
+  bool isBufferMovable() noexcept override {
+    return true;
+  }
+
+  void readBufferAvailable(std::unique_ptr<IOBuf> buf) noexcept override {
+    reads.emplace_back(network_.now(), buf->computeChainDataLength());
+  }
+
+  void readEOF() noexcept override {}
+
+  void readErr(const AsyncSocketException&) noexcept override {}
+
+  std::vector<std::pair<SimulatedNetwork::Duration, size_t>> reads;
+
+ private:
+  const SimulatedNetwork& network_;
+};
+
+class SimulatedTransportTest : public Test {
+ protected:
+  void makeNetwork(SimulatedNetwork::LinkParams params, uint32_t seed = 0) {
+    // Transports cancel their deliveries on the network when destroyed.
+    clientPtr_.reset();
+    serverPtr_.reset();
+    network_ = std::make_unique<SimulatedNetwork>(params, &evb_, seed);
+    client_ = new SimulatedTransport(*network_);
+    server_ = new SimulatedTransport(*network_);
+    clientPtr_.reset(client_);
+    serverPtr_.reset(server_);
+    client_->attachEventBase(&evb_);
+    server_->attachEventBase(&evb_);
+    client_->setPeer(server_);
+    server_->setPeer(client_);
+  }
+
+  EventBase evb_;
+  std::unique_ptr<SimulatedNetwork> network_;
+  SimulatedTransport* client_;
+  SimulatedTransport* server_;
+  SimulatedTransport::UniquePtr clientPtr_;
+  SimulatedTransport::UniquePtr serverPtr_;
+};
+
+TEST_F(SimulatedTransportTest, TestDelay) {
+  SimulatedNetwork::LinkParams params;
+  params.rtt = milliseconds(100);
+  makeNetwork(params);
+  RecordingReadCallback read(*network_);
+  server_->setReadCB(&read);
+  client_->writeChain(nullptr, IOBuf::copyBuffer("hello"));
+  EXPECT_TRUE(read.reads.empty());
+  network_->run();
+  ASSERT_EQ(read.reads.size(), 1);
+  EXPECT_EQ(read.reads[0].first, milliseconds(50));
+  EXPECT_EQ(read.reads[0].second, 5);
+  EXPECT_EQ(network_->now(), milliseconds(50));
+}
+
+TEST_F(SimulatedTransportTest, TestBandwidthAndMtu) {
+  SimulatedNetwork::LinkParams params;
+  params.bandwidth = 1000000;
+  params.mtu = 1000;
+  makeNetwork(params);
+  RecordingReadCallback read(*network_);
+  server_->setReadCB(&read);
+  client_->writeChain(nullptr, IOBuf::copyBuffer(std::string(2500, 'a')));
+  network_->run();
+  ASSERT_EQ(read.reads.size(), 3);
+  EXPECT_EQ(read.reads[0], std::make_pair(microseconds(1000), size_t(1000)));
+  EXPECT_EQ(read.reads[1], std::make_pair(microseconds(2000), size_t(1000)));
+  EXPECT_EQ(read.reads[2], std::make_pair(microseconds(2500), size_t(500)));
+}
+
+TEST_F(SimulatedTransportTest, TestReadChunking) {
+  SimulatedNetwork::LinkParams params;
+  params.maxReadChunk = 4;
+  makeNetwork(params);
+  RecordingReadCallback read(*network_);
+  server_->setReadCB(&read);
+  client_->writeChain(nullptr, IOBuf::copyBuffer("helloworld"));
+  network_->run();
+  ASSERT_EQ(read.reads.size(), 3);
+  EXPECT_EQ(read.reads[0].second, 4);
+  EXPECT_EQ(read.reads[1].second, 4);
+  EXPECT_EQ(read.reads[2].second, 2);
+}
+
+TEST_F(SimulatedTransportTest, TestLossDelaysInOrder) {
+  SimulatedNetwork::LinkParams params;
+  params.rtt = milliseconds(10);
+  params.lossRate = 1;
+  params.retransmitDelay = milliseconds(100);
+  params.mtu = 1;
+  makeNetwork(params);
+  RecordingReadCallback read(*network_);
+  server_->setReadCB(&read);
+  client_->writeChain(nullptr, IOBuf::copyBuffer("ab"));
+  network_->run();
+  ASSERT_EQ(read.reads.size(), 2);
+  EXPECT_EQ(read.reads[0].first, milliseconds(105));
+  EXPECT_EQ(read.reads[1].first, milliseconds(105));
+}
+
+TEST_F(SimulatedTransportTest, TestDeterministic) {
+  SimulatedNetwork::LinkParams params;
+  params.rtt = milliseconds(10);
+  params.lossRate = 0.3;
+  params.mtu = 10;
+  auto runOnce = [&]() {
+    makeNetwork(params, 1234);
+    RecordingReadCallback read(*network_);
+    server_->setReadCB(&read);
+    client_->writeChain(nullptr, IOBuf::copyBuffer(std::string(200, 'a')));
+    network_->run();
+    server_->setReadCB(nullptr);
+    return read.reads;
+  };
+  EXPECT_EQ(runOnce(), runOnce());
+}
+
+TEST_F(SimulatedTransportTest, TestHandshakeTiming) {
+  SimulatedNetwork::LinkParams params;
+  params.rtt = milliseconds(100);
+  makeNetwork(params);
+
+  auto certManager = std::make_unique<server::CertManager>();
+  std::vector<ssl::X509UniquePtr> certs;
+  certs.emplace_back(getCert(kP256Certificate));
+  certManager->addCert(
+      std::make_shared<SelfCertImpl<KeyType::P256>>(
+          getPrivateKey(kP256Key), std::move(certs)),
+      true);
+  auto serverContext = std::make_shared<server::FizzServerContext>();
+  serverContext->setCertManager(std::move(certManager));
+  auto clientContext = std::make_shared<client::FizzClientContext>();
+
+  client::AsyncFizzClient::UniquePtr client(new client::AsyncFizzClient(
+      std::move(clientPtr_), clientContext));
+  server::AsyncFizzServer::UniquePtr server(
+      new server::AsyncFizzServer(std::move(serverPtr_), serverContext));
+
+  client::test::MockHandshakeCallback clientCallback;
+  server::test::MockHandshakeCallback serverCallback;
+  SimulatedNetwork::Duration clientDone{-1};
+  SimulatedNetwork::Duration serverDone{-1};
+  EXPECT_CALL(clientCallback, _fizzHandshakeSuccess())
+      .WillOnce(Invoke([&]() { clientDone = network_->now(); }));
+  EXPECT_CALL(serverCallback, _fizzHandshakeSuccess())
+      .WillOnce(Invoke([&]() { serverDone = network_->now(); }));
+
+  client->connect(&clientCallback, nullptr, folly::none, std::string("Fizz"));
+  server->accept(&serverCallback);
+  network_->run();
+
+  EXPECT_EQ(clientDone, milliseconds(100));
+  EXPECT_EQ(serverDone, milliseconds(150));
+}
+} // namespace test
+} // namespace fizz